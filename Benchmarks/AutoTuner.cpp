@@ -0,0 +1,152 @@
+#include "AutoTuner.h"
+
+#include <QtDebug>
+
+#include "BatchPlanningRun.h"
+#include "HierarchicalPlanner/HierarchicalPlanner.h"
+
+//The values tried for each searched parameter, around their defaults (15, 4 and 300)
+const char * const SEARCHED_PARAMETERS[][2] =
+{
+    {"timeslice", "7.5,15,30,60"},
+    {"subflight-branches", "2,3,4,6"},
+    {"lattice-granularity", "150,300,600"}
+};
+const int SEARCHED_PARAMETER_COUNT = sizeof(SEARCHED_PARAMETERS) / sizeof(SEARCHED_PARAMETERS[0]);
+
+//Timings are noisy, so two tunings that are about as fast could otherwise keep taking turns to win
+const int MAX_ROUNDS = 3;
+
+AutoTuner::Score::Score() :
+    meanFitness(0.0), slowest(0), withinBudget(false)
+{
+}
+
+AutoTuner::AutoTuner(qint64 latencyBudget, int repetitions) :
+    _latencyBudget(qMax<qint64>(1, latencyBudget)), _repetitions(qMax<int>(1, repetitions)), _randomSeed(0)
+{
+}
+
+qint64 AutoTuner::latencyBudget() const
+{
+    return _latencyBudget;
+}
+
+int AutoTuner::repetitions() const
+{
+    return _repetitions;
+}
+
+quint64 AutoTuner::randomSeed() const
+{
+    return _randomSeed;
+}
+
+void AutoTuner::setRandomSeed(quint64 seed)
+{
+    _randomSeed = seed;
+}
+
+void AutoTuner::addMission(const QString &name, const QSharedPointer<PlanningProblem> &problem)
+{
+    const QString missionClass = PlannerTuningProfile::missionClass(*problem);
+    _missionNames[missionClass].append(name);
+    _missions[missionClass].append(problem);
+}
+
+PlannerTuningProfile AutoTuner::tune()
+{
+    PlannerTuningProfile toRet;
+    QStringList comment;
+    comment << QString("Auto-tuned for a latency budget of %1 ms with seed %2").arg(_latencyBudget).arg(_randomSeed);
+
+    foreach(const QString& missionClass, _missions.keys())
+    {
+        qDebug() << "Tuning" << missionClass << "on" << _missionNames.value(missionClass);
+
+        PlannerTuning best;
+        Score bestScore = this->_score(missionClass, best);
+        bool improved = true;
+        for (int round = 0; improved && round < MAX_ROUNDS; round++)
+        {
+            improved = false;
+            for (int p = 0; p < SEARCHED_PARAMETER_COUNT; p++)
+            {
+                const QString name = SEARCHED_PARAMETERS[p][0];
+                foreach(const QString& value, QString(SEARCHED_PARAMETERS[p][1]).split(','))
+                {
+                    PlannerTuning candidate = best;
+                    PlannerTuning::parse(name + "=" + value, &candidate);
+                    if (candidate == best)
+                        continue;
+
+                    const Score score = this->_score(missionClass, candidate);
+                    if (!_better(score, bestScore))
+                        continue;
+                    best = candidate;
+                    bestScore = score;
+                    improved = true;
+                }
+            }
+        }
+
+        toRet.setTuning(missionClass, best);
+        comment << QString("%1: mean fitness %2, slowest %3 ms (%4 budget) over %5")
+                   .arg(missionClass)
+                   .arg(bestScore.meanFitness)
+                   .arg(bestScore.slowest)
+                   .arg(bestScore.withinBudget ? "within" : "over")
+                   .arg(_missionNames.value(missionClass).join(" "));
+    }
+
+    toRet.setComment(comment.join("\n"));
+    return toRet;
+}
+
+//private
+AutoTuner::Score AutoTuner::_score(const QString &missionClass, const PlannerTuning &tuning) const
+{
+    Score toRet;
+    toRet.withinBudget = true;
+
+    const QList<QSharedPointer<PlanningProblem> >& problems = _missions.value(missionClass);
+    qreal totalFitness = 0.0;
+    foreach(const QSharedPointer<PlanningProblem>& problem, problems)
+    {
+        qreal fitness = 0.0;
+        for (int rep = 0; rep < _repetitions; rep++)
+        {
+            //A fresh planner every time, so no cache is warm
+            HierarchicalPlanner planner(problem);
+            planner.setRandomSeed(_randomSeed);
+            planner.setTuning(tuning);
+            BatchPlanningRun run(&planner);
+            run.setTimeBudget(_latencyBudget);
+            QString errorString;
+            if (!run.run(&errorString))
+                qWarning() << "HierarchicalPlanner failed with" << tuning.toString() << ":" << errorString;
+
+            toRet.slowest = qMax<qint64>(toRet.slowest, run.elapsed());
+            toRet.withinBudget = toRet.withinBudget && !run.budgetExhausted();
+            fitness = planner.bestFitnessSoFar().combined();
+        }
+        totalFitness += fitness;
+    }
+    toRet.meanFitness = problems.isEmpty() ? 0.0 : totalFitness / problems.size();
+
+    qDebug() << missionClass << tuning.toString() << "fitness" << toRet.meanFitness << "slowest" << toRet.slowest
+             << (toRet.withinBudget ? "ms" : "ms (over budget)");
+    return toRet;
+}
+
+//private static
+bool AutoTuner::_better(const AutoTuner::Score &a, const AutoTuner::Score &b)
+{
+    if (a.withinBudget != b.withinBudget)
+        return a.withinBudget;
+    else if (!a.withinBudget)
+        return a.slowest < b.slowest;
+    else if (a.meanFitness != b.meanFitness)
+        return a.meanFitness > b.meanFitness;
+    return a.slowest < b.slowest;
+}
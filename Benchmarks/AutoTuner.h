@@ -0,0 +1,83 @@
+#ifndef AUTOTUNER_H
+#define AUTOTUNER_H
+
+#include <QList>
+#include <QMap>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+
+#include "PlannerTuning.h"
+#include "PlannerTuningProfile.h"
+#include "PlanningProblem.h"
+
+/**
+ * @brief The AutoTuner class picks a PlannerTuning for each class of mission (see
+ * PlannerTuningProfile::missionClass()) that gets the best flights out of HierarchicalPlanner within a latency
+ * budget. It searches by coordinate descent from the default tuning: each round tries every candidate value of
+ * one parameter at a time, keeping whichever improves on the best so far, until a round changes nothing or a few
+ * rounds have gone by.
+ *
+ * A tuning is scored by planning each of the class's missions with it from scratch. Tunings whose slowest
+ * mission fits in the budget beat those that don't and are ranked by their mean fitness. Among tunings that
+ * don't fit, the fastest wins, so that a class too hard for the budget at least gets its quickest tuning.
+ *
+ * Only the parameters the default transition strategy and sub-flight searches use are searched. The others
+ * keep their defaults.
+ */
+class AutoTuner
+{
+public:
+    /**
+     * @brief AutoTuner makes a tuner for latencyBudget milliseconds per mission
+     * @param latencyBudget
+     * @param repetitions how many times each mission is planned per tuning. The slowest time counts.
+     */
+    explicit AutoTuner(qint64 latencyBudget, int repetitions = 1);
+
+    qint64 latencyBudget() const;
+    int repetitions() const;
+
+    /**
+     * @brief randomSeed is handed to every planner the tuner creates. Defaults to 0.
+     */
+    quint64 randomSeed() const;
+    void setRandomSeed(quint64 seed);
+
+    /**
+     * @brief addMission adds a mission to tune its class with
+     * @param name
+     * @param problem
+     */
+    void addMission(const QString& name, const QSharedPointer<PlanningProblem>& problem);
+
+    /**
+     * @brief tune searches for every class that has missions and returns the profile of the winners, with
+     * a comment saying how each scored
+     * @return
+     */
+    PlannerTuningProfile tune();
+
+private:
+    struct Score
+    {
+        Score();
+
+        qreal meanFitness;
+        qint64 slowest;
+        bool withinBudget;
+    };
+
+    Score _score(const QString& missionClass, const PlannerTuning& tuning) const;
+    static bool _better(const Score& a, const Score& b);
+
+    qint64 _latencyBudget;
+    int _repetitions;
+    quint64 _randomSeed;
+
+    //Names and problems of the missions added, by class
+    QMap<QString, QStringList> _missionNames;
+    QMap<QString, QList<QSharedPointer<PlanningProblem> > > _missions;
+};
+
+#endif // AUTOTUNER_H
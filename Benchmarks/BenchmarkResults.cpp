@@ -0,0 +1,120 @@
+#include "BenchmarkResults.h"
+
+#include <QDateTime>
+#include <QIODevice>
+#include <QTextStream>
+#include <QThread>
+#include <algorithm>
+
+//non-member
+QString jsonString(const QString& value)
+{
+    QString toRet = value;
+    toRet.replace('\\', "\\\\");
+    toRet.replace('"', "\\\"");
+    return '"' + toRet + '"';
+}
+
+BenchmarkResults::BenchmarkResults()
+{
+}
+
+void BenchmarkResults::addSample(const QString &group, const QString &benchmark, qint64 nsecs)
+{
+    const QString key = group + '\n' + benchmark;
+    if (!_resultIndices.contains(key))
+    {
+        Result result;
+        result.group = group;
+        result.benchmark = benchmark;
+        _resultIndices.insert(key, _results.size());
+        _results.append(result);
+    }
+    _results[_resultIndices.value(key)].samples.append(nsecs);
+}
+
+void BenchmarkResults::addValue(const QString &group, const QString &measurement, qreal value, const QString &unit)
+{
+    const QString key = group + '\n' + measurement;
+    if (!_valueIndices.contains(key))
+    {
+        Value entry;
+        entry.group = group;
+        entry.measurement = measurement;
+        entry.unit = unit;
+        _valueIndices.insert(key, _values.size());
+        _values.append(entry);
+    }
+    _values[_valueIndices.value(key)].samples.append(value);
+}
+
+bool BenchmarkResults::writeJSON(QIODevice *device, int repetitions, QString *errorString) const
+{
+    QTextStream out(device);
+    out << "{\n";
+    out << "  \"qt_version\": " << jsonString(qVersion()) << ",\n";
+    out << "  \"ideal_thread_count\": " << QThread::idealThreadCount() << ",\n";
+    out << "  \"date\": " << jsonString(QDateTime::currentDateTime().toUTC().toString(Qt::ISODate)) << ",\n";
+    out << "  \"repetitions\": " << repetitions << ",\n";
+    out << "  \"results\": [";
+
+    for (int i = 0; i < _results.size(); i++)
+    {
+        const Result& result = _results.at(i);
+        QList<qint64> samples = result.samples;
+        std::sort(samples.begin(), samples.end());
+
+        qint64 total = 0;
+        foreach(qint64 sample, samples)
+            total += sample;
+
+        out << (i == 0 ? "\n" : ",\n");
+        out << "    {\"group\": " << jsonString(result.group)
+            << ", \"benchmark\": " << jsonString(result.benchmark)
+            << ", \"samples\": " << samples.size()
+            << ", \"min_ns\": " << samples.first()
+            << ", \"median_ns\": " << samples.at(samples.size() / 2)
+            << ", \"mean_ns\": " << total / samples.size()
+            << ", \"max_ns\": " << samples.last() << "}";
+    }
+    out << "\n  ]";
+
+    //Only benchmarks that record values get the section, so the timing-only output stays as it was
+    if (!_values.isEmpty())
+    {
+        //Enough digits for byte counts to come out exact
+        out.setRealNumberPrecision(15);
+        out << ",\n  \"values\": [";
+        for (int i = 0; i < _values.size(); i++)
+        {
+            const Value& entry = _values.at(i);
+            QList<qreal> samples = entry.samples;
+            std::sort(samples.begin(), samples.end());
+
+            qreal total = 0.0;
+            foreach(qreal sample, samples)
+                total += sample;
+
+            out << (i == 0 ? "\n" : ",\n");
+            out << "    {\"group\": " << jsonString(entry.group)
+                << ", \"measurement\": " << jsonString(entry.measurement)
+                << ", \"unit\": " << jsonString(entry.unit)
+                << ", \"samples\": " << samples.size()
+                << ", \"min\": " << samples.first()
+                << ", \"median\": " << samples.at(samples.size() / 2)
+                << ", \"mean\": " << total / samples.size()
+                << ", \"max\": " << samples.last() << "}";
+        }
+        out << "\n  ]";
+    }
+    out << "\n}\n";
+    out.flush();
+
+    if (out.status() != QTextStream::Ok)
+    {
+        if (errorString)
+            *errorString = "Failed to write benchmark results: " + device->errorString();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,59 @@
+#ifndef BENCHMARKRESULTS_H
+#define BENCHMARKRESULTS_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+
+class QIODevice;
+
+/**
+ * @brief The BenchmarkResults class collects timing samples by group (a mission, or "micro" for the utility
+ * library benchmarks) and benchmark name and writes them as JSON for regression tracking. Every benchmark is
+ * reported as min, median, mean and max in nanoseconds.
+ *
+ * Measurements that aren't times (hit rates, bytes transferred...) are collected the same way with addValue()
+ * and reported separately, with their unit.
+ */
+class BenchmarkResults
+{
+public:
+    BenchmarkResults();
+
+    void addSample(const QString& group, const QString& benchmark, qint64 nsecs);
+
+    /**
+     * @brief addValue records one sample of a measurement that isn't a time
+     * @param unit e.g. "bytes" or "fraction". Every sample of a measurement should use the same one.
+     */
+    void addValue(const QString& group, const QString& measurement, qreal value, const QString& unit);
+
+    /**
+     * @brief writeJSON writes every result so far to device, which must be open for writing. repetitions is
+     * recorded with them. Returns true on success, false on failure with an explanation in errorString.
+     */
+    bool writeJSON(QIODevice * device, int repetitions, QString * errorString = 0) const;
+
+private:
+    struct Result
+    {
+        QString group;
+        QString benchmark;
+        QList<qint64> samples;
+    };
+
+    struct Value
+    {
+        QString group;
+        QString measurement;
+        QString unit;
+        QList<qreal> samples;
+    };
+
+    QList<Result> _results;
+    QHash<QString, int> _resultIndices;
+    QList<Value> _values;
+    QHash<QString, int> _valueIndices;
+};
+
+#endif // BENCHMARKRESULTS_H
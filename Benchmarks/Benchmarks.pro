@@ -0,0 +1,32 @@
+#-------------------------------------------------
+#
+# Planner benchmarks on a reproducible mission corpus, and micro-benchmarks of the utility libraries
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+TARGET = PlanningBenchmarks
+TEMPLATE = app
+CONFIG   += console
+CONFIG   -= app_bundle
+
+include(../PlanningCore/PlanningCore.pri)
+
+SOURCES += main.cpp \
+    MissionCorpus.cpp \
+    PlanningBenchmark.cpp \
+    BenchmarkResults.cpp \
+    MicroBenchmark.cpp \
+    AutoTuner.cpp
+
+HEADERS += \
+    MissionCorpus.h \
+    PlanningBenchmark.h \
+    BenchmarkResults.h \
+    MicroBenchmark.h \
+    AutoTuner.h
+
+#MapGraphics' geographic types, built in directly so we don't link its widgets
+DEFINES += MAPGRAPHICS_LIBRARY
+include(../MapGraphics/Geographic.pri)
@@ -0,0 +1,382 @@
+#include "MicroBenchmark.h"
+
+#include <QElapsedTimer>
+#include <QPointF>
+#include <QVector3D>
+#include <QtDebug>
+#include <cmath>
+
+#include "QKDTree.h"
+#include "QKDTreeNode.h"
+#include "QFlatKDTree.h"
+#include "QKDTreeT.h"
+#include "QVectorND.h"
+#include "QVectorNDFixed.h"
+#include "Dubins.h"
+#include "DubinsBatch.h"
+#include "DubinsSampler.h"
+#include "Position.h"
+#include "guts/Conversions.h"
+#include "guts/ENUConverter.h"
+
+//Number of nearest-neighbor queries per tree
+const int TREE_QUERIES = 10000;
+
+const int VECTOR_OPS = 1000000;
+const int DUBINS_PATHS = 10000;
+const int CONVERSION_POINTS = 1000000;
+
+//Roughly the UAV's: 38 meter turns with a waypoint every 30 meters
+const qreal DUBINS_TURN_RADIUS = 38.0;
+const qreal DUBINS_SPACING = 30.0;
+
+const qreal PI = 3.14159265358979323846;
+
+MicroBenchmark::MicroBenchmark(BenchmarkResults *results, int repetitions) :
+    _results(results), _repetitions(qMax<int>(1, repetitions)), _maxTreeSize(1000000), _randomState(1), _sink(0.0)
+{
+}
+
+int MicroBenchmark::maxTreeSize() const
+{
+    return _maxTreeSize;
+}
+
+void MicroBenchmark::setMaxTreeSize(int size)
+{
+    _maxTreeSize = qMax<int>(1000, size);
+}
+
+void MicroBenchmark::run()
+{
+    _randomState = 1;
+    for (int dimension = 2; dimension <= 3; dimension++)
+    {
+        for (int size = 1000; size <= _maxTreeSize; size *= 10)
+        {
+            qDebug() << "Benchmarking kd-trees of" << size << "points in" << dimension << "dimensions";
+            this->benchmarkKDTree(dimension, size);
+            this->benchmarkFlatKDTree(dimension, size);
+            if (dimension == 2)
+                this->benchmarkKDTreeT<2>(size);
+            else
+                this->benchmarkKDTreeT<3>(size);
+        }
+    }
+
+    this->benchmarkVectorND();
+    this->benchmarkDubins();
+    this->benchmarkConversions();
+}
+
+//private
+void MicroBenchmark::benchmarkKDTree(int dimension, int size)
+{
+    const QString suffix = QString("/%1d/%2").arg(dimension).arg(size);
+    const QVector<qreal> points = this->randomValues(size * dimension, -1000.0, 1000.0);
+    const QVector<qreal> queries = this->randomValues(TREE_QUERIES * dimension, -1000.0, 1000.0);
+
+    for (int rep = 0; rep < _repetitions; rep++)
+    {
+        QElapsedTimer clock;
+
+        //Incremental build
+        {
+            QKDTree tree(dimension, true);
+            clock.start();
+            for (int i = 0; i < size; i++)
+            {
+                QVectorND position(dimension);
+                for (int d = 0; d < dimension; d++)
+                    position[d] = points.at(i * dimension + d);
+                tree.add(position, i);
+            }
+            this->addSample("QKDTree/add" + suffix, clock.nsecsElapsed());
+        }
+
+        //Bulk build, then the queries on that balanced tree
+        QList<QKDTreeNode *> nodes;
+        nodes.reserve(size);
+        for (int i = 0; i < size; i++)
+        {
+            QVectorND position(dimension);
+            for (int d = 0; d < dimension; d++)
+                position[d] = points.at(i * dimension + d);
+            nodes.append(new QKDTreeNode(position, i));
+        }
+
+        QKDTree tree(dimension, true);
+        clock.start();
+        tree.addBatch(nodes);
+        this->addSample("QKDTree/addBatch" + suffix, clock.nsecsElapsed());
+
+        QKDTreeNode nearest;
+        QVectorND query(dimension);
+        clock.start();
+        for (int i = 0; i < TREE_QUERIES; i++)
+        {
+            for (int d = 0; d < dimension; d++)
+                query[d] = queries.at(i * dimension + d);
+            tree.nearestNode(query, &nearest);
+            _sink = _sink + nearest.position().val(0);
+        }
+        this->addSample("QKDTree/nearestNode" + suffix, clock.nsecsElapsed());
+    }
+}
+
+//private
+void MicroBenchmark::benchmarkFlatKDTree(int dimension, int size)
+{
+    const QString suffix = QString("/%1d/%2").arg(dimension).arg(size);
+    const QVector<qreal> points = this->randomValues(size * dimension, -1000.0, 1000.0);
+    const QVector<qreal> queries = this->randomValues(TREE_QUERIES * dimension, -1000.0, 1000.0);
+
+    for (int rep = 0; rep < _repetitions; rep++)
+    {
+        QElapsedTimer clock;
+
+        QFlatKDTree tree(dimension, true);
+        clock.start();
+        for (int i = 0; i < size; i++)
+            tree.add(points.constData() + i * dimension);
+        this->addSample("QFlatKDTree/add" + suffix, clock.nsecsElapsed());
+
+        clock.start();
+        for (int i = 0; i < TREE_QUERIES; i++)
+            _sink = _sink + tree.nearest(queries.constData() + i * dimension);
+        this->addSample("QFlatKDTree/nearest" + suffix, clock.nsecsElapsed());
+
+        clock.start();
+        for (int i = 0; i < TREE_QUERIES; i++)
+            _sink = _sink + tree.nearest(queries.constData() + i * dimension, 0, 0.5, 128);
+        this->addSample("QFlatKDTree/nearestApprox" + suffix, clock.nsecsElapsed());
+    }
+}
+
+//private
+template <int Dim>
+void MicroBenchmark::benchmarkKDTreeT(int size)
+{
+    const QString suffix = QString("/%1d/%2").arg(Dim).arg(size);
+    const QVector<qreal> points = this->randomValues(size * Dim, -1000.0, 1000.0);
+    const QVector<qreal> queries = this->randomValues(TREE_QUERIES * Dim, -1000.0, 1000.0);
+
+    for (int rep = 0; rep < _repetitions; rep++)
+    {
+        QElapsedTimer clock;
+
+        //Same int payloads as QKDTree's QVariant values
+        QKDTreeT<Dim> tree(QKDTreeSquaredEuclidean<Dim>(), true);
+        clock.start();
+        for (int i = 0; i < size; i++)
+            tree.add(points.constData() + i * Dim, i);
+        this->addSample("QKDTreeT/add" + suffix, clock.nsecsElapsed());
+
+        clock.start();
+        for (int i = 0; i < TREE_QUERIES; i++)
+            _sink = _sink + tree.payload(tree.nearest(queries.constData() + i * Dim));
+        this->addSample("QKDTreeT/nearest" + suffix, clock.nsecsElapsed());
+    }
+}
+
+//private
+void MicroBenchmark::benchmarkVectorND()
+{
+    const QVector<qreal> values = this->randomValues(6, -10.0, 10.0);
+
+    for (int rep = 0; rep < _repetitions; rep++)
+    {
+        QElapsedTimer clock;
+
+        const QVectorND a(QVector3D(values[0], values[1], values[2]));
+        const QVectorND b(QVector3D(values[3], values[4], values[5]));
+        clock.start();
+        for (int i = 0; i < VECTOR_OPS; i++)
+        {
+            QVectorND c = a;
+            c += b;
+            c -= a;
+            c *= 0.5;
+            _sink = _sink + (c - b).lengthSquared();
+        }
+        this->addSample(QString("QVectorND/arithmetic/%1").arg(VECTOR_OPS), clock.nsecsElapsed());
+
+        clock.start();
+        uint hash = 0;
+        for (int i = 0; i < VECTOR_OPS; i++)
+            hash ^= qHash(a) + i;
+        _sink = _sink + hash;
+        this->addSample(QString("QVectorND/qHash/%1").arg(VECTOR_OPS), clock.nsecsElapsed());
+
+        const QVectorNDFixed<3> fa(values.constData());
+        const QVectorNDFixed<3> fb(values.constData() + 3);
+        clock.start();
+        for (int i = 0; i < VECTOR_OPS; i++)
+        {
+            QVectorNDFixed<3> c = fa;
+            c += fb;
+            c -= fa;
+            c *= 0.5;
+            _sink = _sink + (c - fb).lengthSquared();
+        }
+        this->addSample(QString("QVectorNDFixed/arithmetic/%1").arg(VECTOR_OPS), clock.nsecsElapsed());
+
+        clock.start();
+        hash = 0;
+        for (int i = 0; i < VECTOR_OPS; i++)
+            hash ^= qHash(fa) + i;
+        _sink = _sink + hash;
+        this->addSample(QString("QVectorNDFixed/qHash/%1").arg(VECTOR_OPS), clock.nsecsElapsed());
+    }
+}
+
+//private
+void MicroBenchmark::benchmarkDubins()
+{
+    //Start and end poses within a couple of kilometers of each other
+    const QVector<qreal> xy = this->randomValues(DUBINS_PATHS * 4, -1000.0, 1000.0);
+    const QVector<qreal> angles = this->randomValues(DUBINS_PATHS * 2, 0.0, 2.0 * PI);
+
+    for (int rep = 0; rep < _repetitions; rep++)
+    {
+        QElapsedTimer clock;
+
+        clock.start();
+        for (int i = 0; i < DUBINS_PATHS; i++)
+        {
+            qreal length;
+            if (Dubins::shortestLength(QPointF(xy[4*i], xy[4*i+1]), angles[2*i],
+                                       QPointF(xy[4*i+2], xy[4*i+3]), angles[2*i+1],
+                                       DUBINS_TURN_RADIUS, &length))
+                _sink = _sink + length;
+        }
+        this->addSample(QString("Dubins/shortestLength/%1").arg(DUBINS_PATHS), clock.nsecsElapsed());
+
+        clock.start();
+        for (int i = 0; i < DUBINS_PATHS; i++)
+        {
+            Dubins path(QPointF(xy[4*i], xy[4*i+1]), angles[2*i],
+                        QPointF(xy[4*i+2], xy[4*i+3]), angles[2*i+1],
+                        DUBINS_TURN_RADIUS);
+            if (!path.isValid())
+                continue;
+
+            QPointF pos;
+            qreal angle;
+            for (qreal t = 0.0; t < path.length(); t += DUBINS_SPACING)
+            {
+                path.sample(t, pos, angle);
+                _sink = _sink + pos.x();
+            }
+        }
+        this->addSample(QString("Dubins/solveAndSample/%1").arg(DUBINS_PATHS), clock.nsecsElapsed());
+
+        clock.start();
+        for (int i = 0; i < DUBINS_PATHS; i++)
+        {
+            Dubins path(QPointF(xy[4*i], xy[4*i+1]), angles[2*i],
+                        QPointF(xy[4*i+2], xy[4*i+3]), angles[2*i+1],
+                        DUBINS_TURN_RADIUS);
+            DubinsSampler sampler(path, DUBINS_SPACING);
+            QPointF pos;
+            while (sampler.next(&pos))
+                _sink = _sink + pos.x();
+        }
+        this->addSample(QString("DubinsSampler/solveAndSample/%1").arg(DUBINS_PATHS), clock.nsecsElapsed());
+
+        clock.start();
+        DubinsBatch batch(DUBINS_TURN_RADIUS);
+        batch.reserve(DUBINS_PATHS);
+        for (int i = 0; i < DUBINS_PATHS; i++)
+            batch.add(QPointF(xy[4*i], xy[4*i+1]), angles[2*i],
+                      QPointF(xy[4*i+2], xy[4*i+3]), angles[2*i+1]);
+        batch.solve();
+        _sink = _sink + batch.sample(DUBINS_SPACING);
+        this->addSample(QString("DubinsBatch/solveAndSample/%1").arg(DUBINS_PATHS), clock.nsecsElapsed());
+    }
+}
+
+//private
+void MicroBenchmark::benchmarkConversions()
+{
+    const Position reference(-111.65, 40.25, 1400.0);
+    const QVector<qreal> lats = this->randomValues(CONVERSION_POINTS, 40.2, 40.3);
+    const QVector<qreal> lons = this->randomValues(CONVERSION_POINTS, -111.7, -111.6);
+    const QVector<qreal> alts = this->randomValues(CONVERSION_POINTS, 1300.0, 1600.0);
+    QVector<qreal> easts(CONVERSION_POINTS);
+    QVector<qreal> norths(CONVERSION_POINTS);
+    QVector<qreal> ups(CONVERSION_POINTS);
+
+    for (int rep = 0; rep < _repetitions; rep++)
+    {
+        QElapsedTimer clock;
+
+        clock.start();
+        for (int i = 0; i < CONVERSION_POINTS; i++)
+            _sink = _sink + Conversions::lla2enu(lats[i], lons[i], alts[i], reference).x();
+        this->addSample(QString("Conversions/lla2enu/%1").arg(CONVERSION_POINTS), clock.nsecsElapsed());
+
+        clock.start();
+        Conversions::lla2enu(lats.constData(), lons.constData(), alts.constData(), CONVERSION_POINTS,
+                             reference,
+                             easts.data(), norths.data(), ups.data());
+        _sink = _sink + easts.last();
+        this->addSample(QString("Conversions/lla2enu-batch/%1").arg(CONVERSION_POINTS), clock.nsecsElapsed());
+
+        const ENUConverter converter(reference);
+        clock.start();
+        for (int i = 0; i < CONVERSION_POINTS; i++)
+            _sink = _sink + converter.lla2enu(lats[i], lons[i], alts[i]).x();
+        this->addSample(QString("ENUConverter/lla2enu/%1").arg(CONVERSION_POINTS), clock.nsecsElapsed());
+
+        QVector<qreal> outLats(CONVERSION_POINTS);
+        QVector<qreal> outLons(CONVERSION_POINTS);
+        QVector<qreal> outAlts(CONVERSION_POINTS);
+        clock.start();
+        converter.enu2lla(easts.constData(), norths.constData(), ups.constData(), CONVERSION_POINTS,
+                          outLats.data(), outLons.data(), outAlts.data());
+        _sink = _sink + outLats.last();
+        this->addSample(QString("ENUConverter/enu2lla-batch/%1").arg(CONVERSION_POINTS), clock.nsecsElapsed());
+
+        QVector<qreal> xs(CONVERSION_POINTS);
+        QVector<qreal> ys(CONVERSION_POINTS);
+        QVector<qreal> zs(CONVERSION_POINTS);
+        Conversions::lla2xyz(lats.constData(), lons.constData(), alts.constData(), CONVERSION_POINTS,
+                             xs.data(), ys.data(), zs.data());
+
+        clock.start();
+        for (int i = 0; i < CONVERSION_POINTS; i++)
+            _sink = _sink + Conversions::xyz2llaIterative(xs[i], ys[i], zs[i]).latitude();
+        this->addSample(QString("Conversions/xyz2llaIterative/%1").arg(CONVERSION_POINTS), clock.nsecsElapsed());
+
+        clock.start();
+        for (int i = 0; i < CONVERSION_POINTS; i++)
+            _sink = _sink + Conversions::xyz2lla(xs[i], ys[i], zs[i]).latitude();
+        this->addSample(QString("Conversions/xyz2lla/%1").arg(CONVERSION_POINTS), clock.nsecsElapsed());
+
+        clock.start();
+        Conversions::xyz2lla(xs.constData(), ys.constData(), zs.constData(), CONVERSION_POINTS,
+                             outLats.data(), outLons.data(), outAlts.data());
+        _sink = _sink + outLats.last();
+        this->addSample(QString("Conversions/xyz2lla-batch/%1").arg(CONVERSION_POINTS), clock.nsecsElapsed());
+    }
+}
+
+//private
+void MicroBenchmark::addSample(const QString &benchmark, qint64 nsecs)
+{
+    _results->addSample("micro", benchmark, nsecs);
+}
+
+//private
+//The same LCG as MissionCorpus, so inputs don't depend on the platform's rand()
+QVector<qreal> MicroBenchmark::randomValues(int count, qreal min, qreal max)
+{
+    QVector<qreal> toRet(count);
+    for (int i = 0; i < count; i++)
+    {
+        _randomState = _randomState * 1664525u + 1013904223u;
+        toRet[i] = min + (max - min) * ((_randomState >> 8) / (qreal) (1u << 24));
+    }
+    return toRet;
+}
@@ -0,0 +1,51 @@
+#ifndef MICROBENCHMARK_H
+#define MICROBENCHMARK_H
+
+#include <QString>
+#include <QVector>
+
+#include "BenchmarkResults.h"
+
+/**
+ * @brief The MicroBenchmark class times the utility libraries that the planners spend their inner loops in:
+ * QKDTree, QFlatKDTree and QKDTreeT build and nearest-neighbor queries from 10^3 to 10^6 points in 2 and 3 dimensions,
+ * QVectorND and QVectorNDFixed arithmetic and hashing, Dubins and DubinsBatch solving and sampling, and
+ * single and batch coordinate conversions (including Conversions::xyz2lla() against xyz2llaIterative()).
+ * Samples go to a BenchmarkResults under the group "micro".
+ *
+ * Inputs come from a fixed pseudo-random sequence so every run times the same work.
+ */
+class MicroBenchmark
+{
+public:
+    explicit MicroBenchmark(BenchmarkResults * results, int repetitions = 3);
+
+    /**
+     * @brief maxTreeSize is the largest number of points the kd-tree benchmarks build trees of
+     */
+    int maxTreeSize() const;
+    void setMaxTreeSize(int size);
+
+    void run();
+
+private:
+    void benchmarkKDTree(int dimension, int size);
+    void benchmarkFlatKDTree(int dimension, int size);
+    template <int Dim> void benchmarkKDTreeT(int size);
+    void benchmarkVectorND();
+    void benchmarkDubins();
+    void benchmarkConversions();
+
+    void addSample(const QString& benchmark, qint64 nsecs);
+    QVector<qreal> randomValues(int count, qreal min, qreal max);
+
+    BenchmarkResults * _results;
+    int _repetitions;
+    int _maxTreeSize;
+    quint32 _randomState;
+
+    //Results are accumulated here so the compiler can't optimize the timed work away
+    volatile qreal _sink;
+};
+
+#endif // MICROBENCHMARK_H
@@ -0,0 +1,138 @@
+#include "MissionCorpus.h"
+
+#include <cmath>
+
+#include "FlightTaskArea.h"
+#include "FlightTasks/CoverageTask.h"
+#include "FlightTasks/FlyThroughTask.h"
+#include "FlightTasks/NoFlyFlightTask.h"
+#include "FlightTasks/SamplingTask.h"
+#include "UAVOrientation.h"
+
+//Every mission is laid out around this point, within MISSION_RADIUS meters of it
+const QPointF MISSION_CENTER(-111.65, 40.25);
+const qreal MISSION_RADIUS = 5000.0;
+
+const qreal METERS_PER_DEGREE_LAT = 111320.0;
+const qreal PI = 3.14159265358979323846;
+
+//static
+QList<MissionCorpus::Mission> MissionCorpus::standardMissions()
+{
+    QList<Mission> toRet;
+
+    const Mission small = {"small", 4, 300.0, 0, 1};
+    const Mission medium = {"medium", 12, 400.0, 2, 2};
+    const Mission large = {"large", 30, 300.0, 4, 3};
+    const Mission coverage = {"large-coverage", 6, 1500.0, 0, 4};
+    const Mission noFly = {"dense-no-fly", 10, 300.0, 15, 5};
+    toRet << small << medium << large << coverage << noFly;
+
+    return toRet;
+}
+
+//static
+QSharedPointer<PlanningProblem> MissionCorpus::generate(const MissionCorpus::Mission &mission)
+{
+    quint32 state = mission.seed;
+
+    //So the tasks' UUIDs, and the problem files written from them, come out the same every time too
+    FlightTask::seedUUIDs(mission.seed);
+
+    QSharedPointer<PlanningProblem> problem(new PlanningProblem());
+    problem->setStartingPosition(Position(MISSION_CENTER));
+    problem->setStartingOrientation(UAVOrientation(0.0));
+
+    QList<QPointF> areaCenters;
+    for (int i = 0; i < mission.areaCount; i++)
+    {
+        const QPointF center = MISSION_CENTER + randomPoint(&state, MISSION_RADIUS);
+        areaCenters.append(center);
+
+        QSharedPointer<FlightTaskArea> area(new FlightTaskArea(randomPolygon(&state, center, mission.areaSize)));
+        area->setAreaName(QString("Area %1").arg(i));
+
+        //Mostly coverage, some sampling and some fly-throughs
+        QSharedPointer<FlightTask> task;
+        const int kind = nextRandom(&state) % 4;
+        if (kind == 0)
+            task = QSharedPointer<FlightTask>(new SamplingTask(uniform(&state, 30.0, 180.0)));
+        else if (kind == 1)
+            task = QSharedPointer<FlightTask>(new FlyThroughTask());
+        else
+            task = QSharedPointer<FlightTask>(new CoverageTask(uniform(&state, 50.0, 150.0)));
+        area->addTask(task);
+
+        problem->addTaskArea(area);
+    }
+
+    //No-fly zones go wherever they don't swallow the start or an area's center
+    for (int i = 0; i < mission.noFlyCount; i++)
+    {
+        QPolygonF poly;
+        for (int attempt = 0; attempt < 100; attempt++)
+        {
+            const QPointF center = MISSION_CENTER + randomPoint(&state, MISSION_RADIUS);
+            poly = randomPolygon(&state, center, uniform(&state, 200.0, 800.0));
+
+            bool clear = !poly.containsPoint(MISSION_CENTER, Qt::OddEvenFill);
+            foreach(const QPointF& areaCenter, areaCenters)
+                clear = clear && !poly.containsPoint(areaCenter, Qt::OddEvenFill);
+            if (clear)
+                break;
+            poly.clear();
+        }
+        if (poly.isEmpty())
+            continue;
+
+        QSharedPointer<FlightTaskArea> area(new FlightTaskArea(poly));
+        area->setAreaName(QString("No-Fly %1").arg(i));
+        area->addTask(QSharedPointer<FlightTask>(new NoFlyFlightTask()));
+        problem->addTaskArea(area);
+    }
+
+    return problem;
+}
+
+//private static
+//A 32-bit linear congruential generator (Numerical Recipes' constants). Good enough for laying out missions.
+quint32 MissionCorpus::nextRandom(quint32 *state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+//private static
+qreal MissionCorpus::uniform(quint32 *state, qreal min, qreal max)
+{
+    return min + (max - min) * (nextRandom(state) / (qreal) (1u << 24));
+}
+
+//private static
+//Returns a lon/lat offset up to radius meters from (0,0)
+QPointF MissionCorpus::randomPoint(quint32 *state, qreal radius)
+{
+    const qreal angle = uniform(state, 0.0, 2.0 * PI);
+    const qreal distance = radius * sqrt(uniform(state, 0.0, 1.0));
+    const qreal metersPerDegreeLon = METERS_PER_DEGREE_LAT * cos(MISSION_CENTER.y() * PI / 180.0);
+    return QPointF(distance * cos(angle) / metersPerDegreeLon,
+                   distance * sin(angle) / METERS_PER_DEGREE_LAT);
+}
+
+//private static
+//Returns a convex-ish polygon with 5 to 8 vertices, about size meters across
+QPolygonF MissionCorpus::randomPolygon(quint32 *state, const QPointF &center, qreal size)
+{
+    const int vertices = 5 + nextRandom(state) % 4;
+    const qreal metersPerDegreeLon = METERS_PER_DEGREE_LAT * cos(MISSION_CENTER.y() * PI / 180.0);
+
+    QPolygonF toRet;
+    for (int i = 0; i < vertices; i++)
+    {
+        const qreal angle = 2.0 * PI * i / vertices;
+        const qreal radius = 0.5 * size * uniform(state, 0.7, 1.0);
+        toRet << center + QPointF(radius * cos(angle) / metersPerDegreeLon,
+                                  radius * sin(angle) / METERS_PER_DEGREE_LAT);
+    }
+    return toRet;
+}
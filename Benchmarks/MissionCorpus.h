@@ -0,0 +1,47 @@
+#ifndef MISSIONCORPUS_H
+#define MISSIONCORPUS_H
+
+#include <QList>
+#include <QPolygonF>
+#include <QSharedPointer>
+#include <QString>
+
+#include "PlanningProblem.h"
+
+/**
+ * @brief The MissionCorpus class generates the synthetic planning problems the benchmarks run on. Each
+ * mission is generated from its own seed with a fixed pseudo-random generator, so the same mission comes
+ * out the same on every machine and with every Qt version.
+ */
+class MissionCorpus
+{
+public:
+    struct Mission
+    {
+        QString name;
+        int areaCount;
+
+        //The rough diameter of each area in meters
+        qreal areaSize;
+
+        int noFlyCount;
+        quint32 seed;
+    };
+
+    /**
+     * @brief standardMissions returns the missions the benchmarks run by default: from a handful of small
+     * areas up to a 30-area mission, plus one dominated by large coverage areas and one dense with no-fly
+     * zones.
+     */
+    static QList<MissionCorpus::Mission> standardMissions();
+
+    static QSharedPointer<PlanningProblem> generate(const MissionCorpus::Mission& mission);
+
+private:
+    static quint32 nextRandom(quint32 * state);
+    static qreal uniform(quint32 * state, qreal min, qreal max);
+    static QPointF randomPoint(quint32 * state, qreal radius);
+    static QPolygonF randomPolygon(quint32 * state, const QPointF& center, qreal size);
+};
+
+#endif // MISSIONCORPUS_H
@@ -0,0 +1,216 @@
+#include "PlanningBenchmark.h"
+
+#include <QElapsedTimer>
+#include <QMap>
+#include <QtDebug>
+
+#include "BatchPlanningRun.h"
+#include "HierarchicalPlanner/HierarchicalPlanner.h"
+#include "HierarchicalPlanner/SubFlightPlanner/SubFlightPlanner.h"
+#include "HierarchicalPlanner/DubinsIntermediate/DubinsIntermediatePlanner.h"
+#include "HierarchicalPlanner/RRTIntermediatePlanner/RRTIntermediatePlanner.h"
+#include "HierarchicalPlanner/RRTStarIntermediatePlanner/RRTStarIntermediatePlanner.h"
+#include "HierarchicalPlanner/VisibilityGraphIntermediatePlanner/VisibilityGraphIntermediatePlanner.h"
+#include "HierarchicalPlanner/AstarPRMIntermediatePlanner/AstarPRMIntermediatePlanner.h"
+#include "HierarchicalPlanner/PhonyIntermediatePlanner/PhonyIntermediatePlanner.h"
+
+PlanningBenchmark::PlanningBenchmark(BenchmarkResults *results, int repetitions) :
+    _results(results), _repetitions(qMax<int>(1, repetitions)), _randomSeed(0)
+{
+}
+
+int PlanningBenchmark::repetitions() const
+{
+    return _repetitions;
+}
+
+quint64 PlanningBenchmark::randomSeed() const
+{
+    return _randomSeed;
+}
+
+void PlanningBenchmark::setRandomSeed(quint64 seed)
+{
+    _randomSeed = seed;
+}
+
+void PlanningBenchmark::run(const QString &mission, const QSharedPointer<PlanningProblem> &problem)
+{
+    qDebug() << "Benchmarking" << mission;
+
+    //The sub-flight and fitness benchmarks score without starting a planner, which is what prepares the tasks
+    problem->prepareScoring();
+
+    const QList<Position> flight = this->benchmarkHierarchical(mission, problem);
+    this->benchmarkSubFlights(mission, problem);
+    this->benchmarkIntermediates(mission, problem);
+    this->benchmarkFitness(mission, problem, flight);
+}
+
+//private
+QList<Position> PlanningBenchmark::benchmarkHierarchical(const QString &mission,
+                                                         const QSharedPointer<PlanningProblem> &problem)
+{
+    QList<Position> toRet;
+    for (int rep = 0; rep < _repetitions; rep++)
+    {
+        HierarchicalPlanner planner(problem);
+        planner.setRandomSeed(_randomSeed);
+        BatchPlanningRun run(&planner);
+        QString errorString;
+        if (!run.run(&errorString))
+        {
+            qWarning() << "HierarchicalPlanner failed on" << mission << ":" << errorString;
+            return toRet;
+        }
+
+        qint64 total = 0;
+        foreach(const PlanningStatistics::Span& stage, planner.statistics().spans())
+        {
+            _results->addSample(mission, "HierarchicalPlanner/" + stage.name, stage.durationNsecs);
+            total += stage.durationNsecs;
+        }
+        _results->addSample(mission, "HierarchicalPlanner/doIteration", total);
+        toRet = planner.bestFlightSoFar();
+    }
+    return toRet;
+}
+
+//private
+void PlanningBenchmark::benchmarkSubFlights(const QString &mission, const QSharedPointer<PlanningProblem> &problem)
+{
+    const QList<QSharedPointer<FlightTaskArea> > areas = PlanningBenchmark::sortedAreas(problem);
+    const UAVOrientation startPose(0.0);
+
+    for (int rep = 0; rep < _repetitions; rep++)
+    {
+        QElapsedTimer clock;
+        clock.start();
+        foreach(const QSharedPointer<FlightTaskArea>& area, areas)
+        {
+            if (area->geoPoly().isEmpty())
+                continue;
+            const Position startPos(area->geoPoly().first());
+            foreach(const QSharedPointer<FlightTask>& task, area->tasks())
+            {
+                if (task->taskType() == "No-Fly Zone")
+                    continue;
+                SubFlightPlanner planner(problem->uavParameters(), task, area, startPos, startPose);
+                planner.setRandomSeed(_randomSeed);
+                planner.plan();
+            }
+        }
+        _results->addSample(mission, "SubFlightPlanner/plan", clock.nsecsElapsed());
+    }
+}
+
+//private
+void PlanningBenchmark::benchmarkIntermediates(const QString &mission,
+                                               const QSharedPointer<PlanningProblem> &problem)
+{
+    const QList<QSharedPointer<FlightTaskArea> > areas = PlanningBenchmark::sortedAreas(problem);
+
+    QList<QPolygonF> obstacles;
+    QList<Position> destinations;
+    foreach(const QSharedPointer<FlightTaskArea>& area, areas)
+    {
+        if (area->geoPoly().isEmpty())
+            continue;
+
+        bool noFly = false;
+        foreach(const QSharedPointer<FlightTask>& task, area->tasks())
+            noFly = noFly || task->taskType() == "No-Fly Zone";
+        if (noFly)
+            obstacles.append(area->geoPoly());
+        else
+            destinations.append(Position(area->geoPoly().first()));
+    }
+
+    QMap<QString, IntermediateKind> kinds;
+    kinds.insert("Dubins", DubinsIntermediate);
+    kinds.insert("RRT", RRTIntermediate);
+    kinds.insert("RRTConnect", RRTConnectIntermediate);
+    kinds.insert("RRTStar", RRTStarIntermediate);
+    kinds.insert("AstarPRM", AstarPRMIntermediate);
+    kinds.insert("VisibilityGraph", VisibilityGraphIntermediate);
+    kinds.insert("Phony", PhonyIntermediate);
+
+    const UAVOrientation pose(0.0);
+    foreach(const QString& name, kinds.keys())
+    {
+        for (int rep = 0; rep < _repetitions; rep++)
+        {
+            QElapsedTimer clock;
+            clock.start();
+            foreach(const Position& destination, destinations)
+            {
+                IntermediatePlanner * planner = PlanningBenchmark::createIntermediate(kinds.value(name),
+                                                                                      problem->uavParameters(),
+                                                                                      problem->startingPosition(),
+                                                                                      problem->startingOrientation(),
+                                                                                      destination,
+                                                                                      pose,
+                                                                                      obstacles);
+                planner->setRandomSeed(_randomSeed);
+                planner->plan();
+                delete planner;
+            }
+            _results->addSample(mission, "IntermediatePlanner/" + name, clock.nsecsElapsed());
+        }
+    }
+}
+
+//private
+void PlanningBenchmark::benchmarkFitness(const QString &mission, const QSharedPointer<PlanningProblem> &problem,
+                                         const QList<Position> &flight)
+{
+    if (flight.isEmpty())
+        return;
+
+    for (int rep = 0; rep < _repetitions; rep++)
+    {
+        QElapsedTimer clock;
+        clock.start();
+        problem->calculateFlightPerformance(flight);
+        _results->addSample(mission, "PlanningProblem/calculateFlightPerformance", clock.nsecsElapsed());
+    }
+}
+
+//private static
+//The problem keeps its areas in a QSet, so put them in an order that doesn't change from run to run
+QList<QSharedPointer<FlightTaskArea> > PlanningBenchmark::sortedAreas(const QSharedPointer<PlanningProblem> &problem)
+{
+    QMap<QString, QSharedPointer<FlightTaskArea> > byName;
+    foreach(const QSharedPointer<FlightTaskArea>& area, problem->areas())
+        byName.insertMulti(area->areaName(), area);
+    return byName.values();
+}
+
+//private static
+IntermediatePlanner *PlanningBenchmark::createIntermediate(PlanningBenchmark::IntermediateKind kind,
+                                                           const UAVParameters &params,
+                                                           const Position &startPos,
+                                                           const UAVOrientation &startPose,
+                                                           const Position &endPos,
+                                                           const UAVOrientation &endPose,
+                                                           const QList<QPolygonF> &obstacles)
+{
+    if (kind == DubinsIntermediate)
+        return new DubinsIntermediatePlanner(params, startPos, startPose, endPos, endPose, obstacles);
+    else if (kind == RRTIntermediate)
+        return new RRTIntermediatePlanner(params, startPos, startPose, endPos, endPose, obstacles);
+    else if (kind == RRTConnectIntermediate)
+    {
+        RRTIntermediatePlanner * planner = new RRTIntermediatePlanner(params, startPos, startPose, endPos, endPose,
+                                                                      obstacles);
+        planner->setBidirectional(true);
+        return planner;
+    }
+    else if (kind == RRTStarIntermediate)
+        return new RRTStarIntermediatePlanner(params, startPos, startPose, endPos, endPose, obstacles);
+    else if (kind == AstarPRMIntermediate)
+        return new AstarPRMIntermediatePlanner(params, startPos, startPose, endPos, endPose, obstacles);
+    else if (kind == VisibilityGraphIntermediate)
+        return new VisibilityGraphIntermediatePlanner(params, startPos, startPose, endPos, endPose, obstacles);
+    return new PhonyIntermediatePlanner(params, startPos, startPose, endPos, endPose, obstacles);
+}
@@ -0,0 +1,71 @@
+#ifndef PLANNINGBENCHMARK_H
+#define PLANNINGBENCHMARK_H
+
+#include <QList>
+#include <QSharedPointer>
+#include <QString>
+
+#include "PlanningProblem.h"
+#include "BenchmarkResults.h"
+
+class IntermediatePlanner;
+
+/**
+ * @brief The PlanningBenchmark class times the expensive parts of planning on one problem at a time and
+ * adds the samples to a BenchmarkResults, grouped by mission. Each benchmark runs repetitions() times from
+ * scratch (a fresh planner, so no cache is warm).
+ *
+ * The benchmarks are:
+ *  - every stage of a HierarchicalPlanner run, and the whole run
+ *  - SubFlightPlanner::plan() for every task, one sample being all the tasks of the problem
+ *  - each IntermediatePlanner, from the start position to the first corner of every area
+ *  - PlanningProblem::calculateFlightPerformance() on the flight HierarchicalPlanner found
+ */
+class PlanningBenchmark
+{
+public:
+    explicit PlanningBenchmark(BenchmarkResults * results, int repetitions = 3);
+
+    int repetitions() const;
+
+    /**
+     * @brief randomSeed is handed to every planner the benchmarks create. Defaults to 0.
+     */
+    quint64 randomSeed() const;
+    void setRandomSeed(quint64 seed);
+
+    void run(const QString& mission, const QSharedPointer<PlanningProblem>& problem);
+
+private:
+    enum IntermediateKind
+    {
+        DubinsIntermediate,
+        RRTIntermediate,
+        RRTConnectIntermediate,
+        RRTStarIntermediate,
+        AstarPRMIntermediate,
+        VisibilityGraphIntermediate,
+        PhonyIntermediate
+    };
+
+    QList<Position> benchmarkHierarchical(const QString& mission, const QSharedPointer<PlanningProblem>& problem);
+    void benchmarkSubFlights(const QString& mission, const QSharedPointer<PlanningProblem>& problem);
+    void benchmarkIntermediates(const QString& mission, const QSharedPointer<PlanningProblem>& problem);
+    void benchmarkFitness(const QString& mission, const QSharedPointer<PlanningProblem>& problem,
+                          const QList<Position>& flight);
+
+    static QList<QSharedPointer<FlightTaskArea> > sortedAreas(const QSharedPointer<PlanningProblem>& problem);
+    static IntermediatePlanner * createIntermediate(IntermediateKind kind,
+                                                    const UAVParameters& params,
+                                                    const Position& startPos,
+                                                    const UAVOrientation& startPose,
+                                                    const Position& endPos,
+                                                    const UAVOrientation& endPose,
+                                                    const QList<QPolygonF>& obstacles);
+
+    BenchmarkResults * _results;
+    int _repetitions;
+    quint64 _randomSeed;
+};
+
+#endif // PLANNINGBENCHMARK_H
@@ -0,0 +1,245 @@
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+#include <QTextStream>
+
+#include "AutoTuner.h"
+#include "BenchmarkResults.h"
+#include "MicroBenchmark.h"
+#include "MissionCorpus.h"
+#include "PlanningBenchmark.h"
+#include "ProblemFile.h"
+
+const char * USAGE =
+        "Usage: PlanningBenchmarks [options]\n"
+        "\n"
+        "Times the planners on the synthetic mission corpus and on any saved problems, and the utility\n"
+        "libraries they're built on, and writes the results as JSON.\n"
+        "\n"
+        "Options:\n"
+        "  --suite <planning|micro|all>  Which benchmarks to run (default all)\n"
+        "  --repetitions <n>       Run every benchmark n times (default 3)\n"
+        "  --max-tree-size <n>     Largest kd-tree the micro-benchmarks build (default 1000000)\n"
+        "  --corpus <directory>    Also benchmark every problem file in directory\n"
+        "  --no-synthetic          Skip the synthetic missions\n"
+        "  --write-corpus <dir>    Save the synthetic missions as problem files in dir and exit\n"
+        "  --seed <n>              Seed for the planners' random choices (default 0)\n"
+        "  --auto-tune <ms>        Instead of benchmarking, find the planner tuning for each mission class that\n"
+        "                          plans the missions best within this many milliseconds, and write them to\n"
+        "                          --output as a tuning profile. Each mission is planned --repetitions times\n"
+        "                          per tuning.\n"
+        "  --output <file>         Write the JSON there instead of to standard output\n"
+        "  --help                  Show this message\n";
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QTextStream err(stderr);
+
+    int repetitions = 3;
+    QString corpusDir;
+    QString writeCorpusDir;
+    QString outputPath;
+    bool synthetic = true;
+    QString suite = "all";
+    int maxTreeSize = 1000000;
+    quint64 seed = 0;
+    qint64 autoTuneBudget = 0;
+
+    const QStringList args = a.arguments();
+    for (int i = 1; i < args.size(); i++)
+    {
+        const QString& arg = args.at(i);
+        const bool hasValue = i + 1 < args.size();
+        if (arg == "--help" || arg == "-h")
+        {
+            QTextStream(stdout) << USAGE;
+            return 0;
+        }
+        else if (arg == "--repetitions" && hasValue)
+        {
+            bool ok;
+            repetitions = args.at(++i).toInt(&ok);
+            if (!ok || repetitions < 1)
+            {
+                err << "Invalid repetition count " << args.at(i) << "\n";
+                return 2;
+            }
+        }
+        else if (arg == "--suite" && hasValue)
+        {
+            suite = args.at(++i).toLower();
+            if (suite != "planning" && suite != "micro" && suite != "all")
+            {
+                err << "Unknown suite " << suite << "\n";
+                return 2;
+            }
+        }
+        else if (arg == "--max-tree-size" && hasValue)
+        {
+            bool ok;
+            maxTreeSize = args.at(++i).toInt(&ok);
+            if (!ok || maxTreeSize < 1000)
+            {
+                err << "Invalid tree size " << args.at(i) << "\n";
+                return 2;
+            }
+        }
+        else if (arg == "--seed" && hasValue)
+        {
+            bool ok;
+            seed = args.at(++i).toULongLong(&ok);
+            if (!ok)
+            {
+                err << "Invalid seed " << args.at(i) << "\n";
+                return 2;
+            }
+        }
+        else if (arg == "--auto-tune" && hasValue)
+        {
+            bool ok;
+            autoTuneBudget = args.at(++i).toLongLong(&ok);
+            if (!ok || autoTuneBudget < 1)
+            {
+                err << "Invalid latency budget " << args.at(i) << "\n";
+                return 2;
+            }
+        }
+        else if (arg == "--corpus" && hasValue)
+            corpusDir = args.at(++i);
+        else if (arg == "--write-corpus" && hasValue)
+            writeCorpusDir = args.at(++i);
+        else if (arg == "--output" && hasValue)
+            outputPath = args.at(++i);
+        else if (arg == "--no-synthetic")
+            synthetic = false;
+        else
+        {
+            err << "Unexpected argument " << arg << "\n\n" << USAGE;
+            return 2;
+        }
+    }
+
+    if (!writeCorpusDir.isEmpty())
+    {
+        QDir dir;
+        if (!dir.mkpath(writeCorpusDir))
+        {
+            err << "Failed to create " << writeCorpusDir << "\n";
+            return 1;
+        }
+        foreach(const MissionCorpus::Mission& mission, MissionCorpus::standardMissions())
+        {
+            QFile fp(QDir(writeCorpusDir).filePath(mission.name + ".problem"));
+            QString errorString;
+            if (!fp.open(QFile::WriteOnly)
+                    || !ProblemFile::write(*MissionCorpus::generate(mission), &fp, &errorString))
+            {
+                err << "Failed to write " << fp.fileName() << ": "
+                    << (errorString.isEmpty() ? fp.errorString() : errorString) << "\n";
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    if (autoTuneBudget > 0)
+    {
+        if (outputPath.isEmpty())
+        {
+            err << "--auto-tune needs an --output file for the profile\n";
+            return 2;
+        }
+
+        AutoTuner tuner(autoTuneBudget, repetitions);
+        tuner.setRandomSeed(seed);
+        if (synthetic)
+        {
+            foreach(const MissionCorpus::Mission& mission, MissionCorpus::standardMissions())
+                tuner.addMission("synthetic/" + mission.name, MissionCorpus::generate(mission));
+        }
+        if (!corpusDir.isEmpty())
+        {
+            const QFileInfoList files = QDir(corpusDir).entryInfoList(QDir::Files, QDir::Name);
+            foreach(const QFileInfo& info, files)
+            {
+                QString errorString;
+                QSharedPointer<PlanningProblem> problem = ProblemFile::load(info.filePath(), 0, &errorString);
+                if (problem.isNull())
+                {
+                    err << "Skipping " << info.filePath() << ": " << errorString << "\n";
+                    continue;
+                }
+                tuner.addMission(info.completeBaseName(), problem);
+            }
+        }
+
+        QString errorString;
+        if (!tuner.tune().save(outputPath, &errorString))
+        {
+            err << errorString << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    BenchmarkResults results;
+
+    if (suite != "micro")
+    {
+        PlanningBenchmark benchmark(&results, repetitions);
+        benchmark.setRandomSeed(seed);
+
+        if (synthetic)
+        {
+            foreach(const MissionCorpus::Mission& mission, MissionCorpus::standardMissions())
+                benchmark.run("synthetic/" + mission.name, MissionCorpus::generate(mission));
+        }
+
+        if (!corpusDir.isEmpty())
+        {
+            const QFileInfoList files = QDir(corpusDir).entryInfoList(QDir::Files, QDir::Name);
+            foreach(const QFileInfo& info, files)
+            {
+                QString errorString;
+                QSharedPointer<PlanningProblem> problem = ProblemFile::load(info.filePath(), 0, &errorString);
+                if (problem.isNull())
+                {
+                    err << "Skipping " << info.filePath() << ": " << errorString << "\n";
+                    continue;
+                }
+                benchmark.run(info.completeBaseName(), problem);
+            }
+        }
+    }
+
+    if (suite != "planning")
+    {
+        MicroBenchmark micro(&results, repetitions);
+        micro.setMaxTreeSize(maxTreeSize);
+        micro.run();
+    }
+
+    QFile output;
+    if (outputPath.isEmpty())
+        output.open(stdout, QFile::WriteOnly);
+    else
+    {
+        output.setFileName(outputPath);
+        if (!output.open(QFile::WriteOnly))
+        {
+            err << "Failed to open " << outputPath << " for writing: " << output.errorString() << "\n";
+            return 1;
+        }
+    }
+
+    QString errorString;
+    if (!results.writeJSON(&output, repetitions, &errorString))
+    {
+        err << errorString << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -62,6 +62,26 @@ bool Dubins::sample(qreal t, QPointF &outPos, qreal &outAngle)
     return (zeroIfGood == 0);
 }
 
+//static
+bool Dubins::shortestLength(const QPointF &posA,
+                            qreal angleA,
+                            const QPointF &posB,
+                            qreal angleB,
+                            qreal minTurnRadius,
+                            qreal *lengthOut)
+{
+    qreal start[3] = {posA.x(), posA.y(), angleA};
+    qreal end[3] = {posB.x(), posB.y(), angleB};
+
+    qreal length;
+    if (dubins_shortest_length(start, end, minTurnRadius, &length) != 0)
+        return false;
+
+    if (lengthOut)
+        *lengthOut = length;
+    return true;
+}
+
 //private
 void Dubins::_solvePath()
 {
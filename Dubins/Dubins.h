@@ -30,8 +30,23 @@ public:
     qreal length() const;
     bool sample(qreal t, QPointF& outPos, qreal& outAngle);
 
+    /**
+     * @brief shortestLength computes the length of the path between two poses without building a Dubins
+     * object or sampling anything.
+     * @param lengthOut set to the length if there is a valid path
+     * @return false if there is no valid path (e.g., the positions are the same)
+     */
+    static bool shortestLength(const QPointF& posA,
+                               qreal angleA,
+                               const QPointF& posB,
+                               qreal angleB,
+                               qreal minTurnRadius,
+                               qreal * lengthOut);
+
 
 private:
+    friend class DubinsSampler;
+
     void _solvePath();
 
     QPointF _posA;
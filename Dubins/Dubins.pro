@@ -13,12 +13,18 @@ DEFINES += DUBINS_LIBRARY
 
 SOURCES += \
     Dubins.cpp \
-    dubinGuts/dubinsSolver.cpp
+    dubinGuts/dubinsSolver.cpp \
+    DubinsBatch.cpp \
+    DubinsTable.cpp \
+    DubinsSampler.cpp
 
 HEADERS +=\
         Dubins_global.h \
     Dubins.h \
-    dubinGuts/dubinsSolver.h
+    dubinGuts/dubinsSolver.h \
+    DubinsBatch.h \
+    DubinsTable.h \
+    DubinsSampler.h
 
 unix:!symbian {
     maemo5 {
@@ -0,0 +1,160 @@
+#include "DubinsBatch.h"
+
+DubinsBatch::DubinsBatch(qreal minTurnRadius) :
+    _minTurnRadius(minTurnRadius), _solved(0)
+{
+}
+
+qreal DubinsBatch::minTurnRadius() const
+{
+    return _minTurnRadius;
+}
+
+void DubinsBatch::setMinTurnRadius(qreal minTurnRadius)
+{
+    //Everything has to be solved again with the new radius
+    _solved = 0;
+    _minTurnRadius = minTurnRadius;
+}
+
+void DubinsBatch::reserve(int count)
+{
+    _starts.reserve(3 * count);
+    _ends.reserve(3 * count);
+    _paths.reserve(count);
+    _errors.reserve(count);
+}
+
+void DubinsBatch::clear()
+{
+    _starts.clear();
+    _ends.clear();
+    _paths.clear();
+    _errors.clear();
+    _solved = 0;
+
+    _sampleOffsets.clear();
+    _sampleCounts.clear();
+    _sampleX.clear();
+    _sampleY.clear();
+    _sampleAngle.clear();
+}
+
+int DubinsBatch::add(const QPointF &posA, qreal angleA, const QPointF &posB, qreal angleB)
+{
+    _starts.append(posA.x());
+    _starts.append(posA.y());
+    _starts.append(angleA);
+
+    _ends.append(posB.x());
+    _ends.append(posB.y());
+    _ends.append(angleB);
+
+    _paths.append(DubinsPath());
+    _errors.append(EDUBPARAM);
+    return _paths.size() - 1;
+}
+
+int DubinsBatch::size() const
+{
+    return _paths.size();
+}
+
+int DubinsBatch::solve()
+{
+    const int count = _paths.size() - _solved;
+    if (count > 0)
+        dubins_init_batch(_starts.constData() + 3 * _solved,
+                          _ends.constData() + 3 * _solved,
+                          count,
+                          _minTurnRadius,
+                          _paths.data() + _solved,
+                          _errors.data() + _solved);
+    _solved = _paths.size();
+
+    int valid = 0;
+    foreach(int error, _errors)
+    {
+        if (error == 0)
+            valid++;
+    }
+    return valid;
+}
+
+bool DubinsBatch::isValid(int index) const
+{
+    return (index >= 0 && index < _solved && _errors.at(index) == 0);
+}
+
+qreal DubinsBatch::length(int index) const
+{
+    if (!this->isValid(index))
+        return 0.0;
+    return dubins_path_length(const_cast<DubinsPath *>(_paths.constData() + index));
+}
+
+int DubinsBatch::sample(qreal spacing)
+{
+    const int count = _paths.size();
+    _sampleOffsets.resize(count);
+    _sampleCounts.resize(count);
+
+    //Size the buffers for every path first so that we only allocate once
+    int total = 0;
+    for (int i = 0; i < count; i++)
+    {
+        _sampleOffsets[i] = total;
+        _sampleCounts[i] = 0;
+        if (this->isValid(i))
+            _sampleCounts[i] = dubins_path_sample_count(_paths.data() + i, spacing);
+        total += _sampleCounts[i];
+    }
+
+    _sampleX.resize(total);
+    _sampleY.resize(total);
+    _sampleAngle.resize(total);
+
+    for (int i = 0; i < count; i++)
+    {
+        if (_sampleCounts[i] == 0)
+            continue;
+        const int offset = _sampleOffsets[i];
+        dubins_path_sample_fixed(_paths.data() + i,
+                                 spacing,
+                                 _sampleX.data() + offset,
+                                 _sampleY.data() + offset,
+                                 _sampleAngle.data() + offset,
+                                 _sampleCounts[i]);
+    }
+    return total;
+}
+
+int DubinsBatch::sampleCount() const
+{
+    return _sampleX.size();
+}
+
+int DubinsBatch::sampleOffset(int index) const
+{
+    return _sampleOffsets.value(index, 0);
+}
+
+int DubinsBatch::sampleCount(int index) const
+{
+    return _sampleCounts.value(index, 0);
+}
+
+const qreal *DubinsBatch::sampleX() const
+{
+    return _sampleX.constData();
+}
+
+const qreal *DubinsBatch::sampleY() const
+{
+    return _sampleY.constData();
+}
+
+const qreal *DubinsBatch::sampleAngle() const
+{
+    return _sampleAngle.constData();
+}
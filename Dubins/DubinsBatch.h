@@ -0,0 +1,86 @@
+#ifndef DUBINSBATCH_H
+#define DUBINSBATCH_H
+
+#include <QPointF>
+#include <QVector>
+
+#include "Dubins_global.h"
+
+#include "dubinGuts/dubinsSolver.h"
+
+/**
+ * @brief The DubinsBatch class solves many Dubins paths with the same turning radius at once and samples
+ * them at a fixed spacing.
+ *
+ * Samples are stored as a structure of arrays: one array of x coordinates, one of y coordinates and one of
+ * headings, with each path's samples stored contiguously. The buffers are sized once for all paths before
+ * sampling, so sampling a batch never reallocates.
+ */
+class DUBINSSHARED_EXPORT DubinsBatch
+{
+public:
+    DubinsBatch(qreal minTurnRadius = 1.0);
+
+    qreal minTurnRadius() const;
+    void setMinTurnRadius(qreal minTurnRadius);
+
+    void reserve(int count);
+    void clear();
+
+    /**
+     * @brief add queues a path from (posA, angleA) to (posB, angleB). It isn't solved until solve() is called.
+     * @return the index of the path within the batch
+     */
+    int add(const QPointF& posA, qreal angleA,
+            const QPointF& posB, qreal angleB);
+
+    int size() const;
+
+    /**
+     * @brief solve solves every path added since the last call to solve().
+     * @return the number of paths in the whole batch that are valid
+     */
+    int solve();
+
+    bool isValid(int index) const;
+    qreal length(int index) const;
+
+    /**
+     * @brief sample samples every valid path at t = 0, spacing, 2 * spacing, ... (up to but not including its
+     * length). Invalid paths get no samples. Replaces the results of any previous call.
+     * @param spacing distance between samples
+     * @return the total number of samples
+     */
+    int sample(qreal spacing);
+
+    int sampleCount() const;
+
+    /**
+     * @brief sampleOffset returns the index of a path's first sample in the sample arrays.
+     */
+    int sampleOffset(int index) const;
+    int sampleCount(int index) const;
+
+    const qreal * sampleX() const;
+    const qreal * sampleY() const;
+    const qreal * sampleAngle() const;
+
+private:
+    qreal _minTurnRadius;
+
+    //Start and end configurations (x, y, theta), three reals per path
+    QVector<qreal> _starts;
+    QVector<qreal> _ends;
+
+    QVector<DubinsPath> _paths;
+    QVector<int> _errors;
+    int _solved;
+
+    QVector<int> _sampleOffsets;
+    QVector<int> _sampleCounts;
+    QVector<qreal> _sampleX;
+    QVector<qreal> _sampleY;
+    QVector<qreal> _sampleAngle;
+};
+
+#endif // DUBINSBATCH_H
@@ -0,0 +1,38 @@
+#include "DubinsSampler.h"
+
+#include "Dubins.h"
+
+DubinsSampler::DubinsSampler(const Dubins &path, qreal spacing)
+{
+    _iterator.count = 0;
+    _iterator.next = 0;
+    if (!path.isValid() || spacing <= 0.0)
+        return;
+    dubins_sample_iterator_init(path._guts.data(), spacing, &_iterator);
+}
+
+int DubinsSampler::count() const
+{
+    return _iterator.count;
+}
+
+bool DubinsSampler::hasNext() const
+{
+    return _iterator.next < _iterator.count;
+}
+
+bool DubinsSampler::next(QPointF *posOut, qreal *angleOut)
+{
+    qreal q[3];
+    if (dubins_sample_iterator_next(&_iterator, q) != 0)
+        return false;
+
+    if (posOut)
+    {
+        posOut->setX(q[0]);
+        posOut->setY(q[1]);
+    }
+    if (angleOut)
+        *angleOut = q[2];
+    return true;
+}
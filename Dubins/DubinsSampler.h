@@ -0,0 +1,52 @@
+#ifndef DUBINSSAMPLER_H
+#define DUBINSSAMPLER_H
+
+#include <QPointF>
+
+#include "Dubins_global.h"
+
+#include "dubinGuts/dubinsSolver.h"
+
+class Dubins;
+
+/**
+ * @brief The DubinsSampler class walks a Dubins path at a fixed spacing, one sample at a time, so callers can
+ * convert each sample straight into whatever they're building. It gives the same samples as Dubins::sample()
+ * at t = 0, spacing, 2 * spacing, ... (up to but not including the path's length), but carries the heading's
+ * sine and cosine from one sample to the next instead of recomputing them.
+ *
+ * The sampler copies what it needs from the path, so the Dubins object doesn't have to outlive it.
+ */
+class DUBINSSHARED_EXPORT DubinsSampler
+{
+public:
+    /**
+     * @brief DubinsSampler prepares to sample path. An invalid path or a spacing <= 0 gives no samples.
+     * @param path
+     * @param spacing distance between samples
+     */
+    DubinsSampler(const Dubins& path, qreal spacing);
+
+    /**
+     * @brief count returns how many samples the walk produces in all
+     */
+    int count() const;
+
+    /**
+     * @brief hasNext returns false once every sample has been produced
+     */
+    bool hasNext() const;
+
+    /**
+     * @brief next produces the next sample
+     * @param posOut set to the sample's position
+     * @param angleOut if not null, set to the heading there
+     * @return false (leaving the outputs alone) if every sample has already been produced
+     */
+    bool next(QPointF * posOut, qreal * angleOut = 0);
+
+private:
+    DubinsSampleIterator _iterator;
+};
+
+#endif // DUBINSSAMPLER_H
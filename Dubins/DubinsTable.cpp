@@ -0,0 +1,204 @@
+#include "DubinsTable.h"
+
+#include "dubinGuts/dubinsSolver.h"
+
+#include <QtGlobal>
+#include <QLineF>
+#include <cmath>
+
+const qreal TWO_PI = 2.0 * 3.14159265358979323846;
+
+//non-member
+static qreal wrapTwoPi(qreal theta)
+{
+    return theta - TWO_PI * floor(theta / TWO_PI);
+}
+
+Q_GLOBAL_STATIC(DubinsTable, sharedTable)
+
+DubinsTable::DubinsTable(int distanceSteps, qreal maxDistance, int angleSteps) :
+    _distanceSteps(qMax<int>(1, distanceSteps)),
+    _maxDistance(qMax<qreal>(0.0, maxDistance)),
+    _angleSteps(qMax<int>(4, angleSteps))
+{
+    _distanceStep = _maxDistance / _distanceSteps;
+    _angleStep = TWO_PI / _angleSteps;
+
+    _lengths.resize((_distanceSteps + 1) * _angleSteps * _angleSteps);
+    for (int di = 0; di <= _distanceSteps; di++)
+        for (int ai = 0; ai < _angleSteps; ai++)
+            for (int bi = 0; bi < _angleSteps; bi++)
+                _lengths[_index(di, ai, bi)] = (float)_exactLength(di * _distanceStep,
+                                                                   ai * _angleStep,
+                                                                   bi * _angleStep);
+
+    /*
+     * Each cell's bound is its lowest corner less the biggest change along any of its edges. Where the length
+     * is smooth that covers how much lower it can get inside the cell. Where it jumps (near d = 0 and where
+     * the shortest word changes) the bound falls far enough that the exact floor in normalizedLowerBound()
+     * takes over.
+    */
+    _lowerBounds.resize(_distanceSteps * _angleSteps * _angleSteps);
+
+    //Right next to each other, the length swings between nearly nothing and a whole loop with the smallest
+    //change in direction, so the first distance step gets nothing but the floor
+    for (int i = 0; i < _angleSteps * _angleSteps; i++)
+        _lowerBounds[i] = 0.0;
+    for (int di = 1; di < _distanceSteps; di++)
+    {
+        for (int ai = 0; ai < _angleSteps; ai++)
+        {
+            for (int bi = 0; bi < _angleSteps; bi++)
+            {
+                const int a1 = (ai + 1) % _angleSteps;
+                const int b1 = (bi + 1) % _angleSteps;
+                float corners[8];
+                corners[0] = _lengths.at(_index(di, ai, bi));
+                corners[1] = _lengths.at(_index(di, ai, b1));
+                corners[2] = _lengths.at(_index(di, a1, bi));
+                corners[3] = _lengths.at(_index(di, a1, b1));
+                corners[4] = _lengths.at(_index(di + 1, ai, bi));
+                corners[5] = _lengths.at(_index(di + 1, ai, b1));
+                corners[6] = _lengths.at(_index(di + 1, a1, bi));
+                corners[7] = _lengths.at(_index(di + 1, a1, b1));
+
+                float lowest = corners[0];
+                for (int i = 1; i < 8; i++)
+                    lowest = qMin<float>(lowest, corners[i]);
+
+                //Corners i and j share an edge when their indices differ in exactly one bit
+                float biggestChange = 0.0;
+                for (int i = 0; i < 8; i++)
+                    for (int bit = 1; bit < 8; bit <<= 1)
+                        if ((i & bit) == 0)
+                            biggestChange = qMax<float>(biggestChange, qAbs<float>(corners[i] - corners[i | bit]));
+
+                _lowerBounds[(di * _angleSteps + ai) * _angleSteps + bi] = lowest - biggestChange;
+            }
+        }
+    }
+}
+
+//static
+const DubinsTable &DubinsTable::shared()
+{
+    return *sharedTable();
+}
+
+int DubinsTable::distanceSteps() const
+{
+    return _distanceSteps;
+}
+
+qreal DubinsTable::maxDistance() const
+{
+    return _maxDistance;
+}
+
+int DubinsTable::angleSteps() const
+{
+    return _angleSteps;
+}
+
+qreal DubinsTable::length(const QPointF &posA, qreal angleA,
+                          const QPointF &posB, qreal angleB,
+                          qreal minTurnRadius) const
+{
+    if (minTurnRadius <= 0.0)
+        return QLineF(posA, posB).length();
+
+    qreal d, alpha, beta;
+    _normalize(posA, angleA, posB, angleB, minTurnRadius, &d, &alpha, &beta);
+    return minTurnRadius * this->normalizedLength(d, alpha, beta);
+}
+
+qreal DubinsTable::lowerBound(const QPointF &posA, qreal angleA,
+                              const QPointF &posB, qreal angleB,
+                              qreal minTurnRadius) const
+{
+    if (minTurnRadius <= 0.0)
+        return QLineF(posA, posB).length();
+
+    qreal d, alpha, beta;
+    _normalize(posA, angleA, posB, angleB, minTurnRadius, &d, &alpha, &beta);
+    return minTurnRadius * this->normalizedLowerBound(d, alpha, beta);
+}
+
+qreal DubinsTable::normalizedLength(qreal d, qreal alpha, qreal beta) const
+{
+    if (d >= _maxDistance)
+        return _exactLength(d, alpha, beta);
+
+    const qreal dCell = qMax<qreal>(0.0, d) / _distanceStep;
+    const qreal aCell = wrapTwoPi(alpha) / _angleStep;
+    const qreal bCell = wrapTwoPi(beta) / _angleStep;
+
+    const int di = qMin<int>(_distanceSteps - 1, (int)dCell);
+    const int ai = qMin<int>(_angleSteps - 1, (int)aCell);
+    const int bi = qMin<int>(_angleSteps - 1, (int)bCell);
+    const int a1 = (ai + 1) % _angleSteps;
+    const int b1 = (bi + 1) % _angleSteps;
+
+    const qreal td = dCell - di;
+    const qreal ta = aCell - ai;
+    const qreal tb = bCell - bi;
+
+    //Trilinear, first along beta, then alpha, then distance
+    qreal atDistance[2];
+    for (int k = 0; k < 2; k++)
+    {
+        const int dk = di + k;
+        const qreal atA = _lengths.at(_index(dk, ai, bi)) * (1.0 - tb) + _lengths.at(_index(dk, ai, b1)) * tb;
+        const qreal atA1 = _lengths.at(_index(dk, a1, bi)) * (1.0 - tb) + _lengths.at(_index(dk, a1, b1)) * tb;
+        atDistance[k] = atA * (1.0 - ta) + atA1 * ta;
+    }
+    return atDistance[0] * (1.0 - td) + atDistance[1] * td;
+}
+
+qreal DubinsTable::normalizedLowerBound(qreal d, qreal alpha, qreal beta) const
+{
+    d = qMax<qreal>(0.0, d);
+    if (d >= _maxDistance)
+        return _exactLength(d, alpha, beta);
+
+    //Any path is at least as long as the straight line, and has to turn at least from one heading to the other
+    qreal turn = wrapTwoPi(beta - alpha);
+    turn = qMin<qreal>(turn, TWO_PI - turn);
+    const qreal floorBound = qMax<qreal>(d, turn);
+
+    const int di = qMin<int>(_distanceSteps - 1, (int)(d / _distanceStep));
+    const int ai = qMin<int>(_angleSteps - 1, (int)(wrapTwoPi(alpha) / _angleStep));
+    const int bi = qMin<int>(_angleSteps - 1, (int)(wrapTwoPi(beta) / _angleStep));
+    return qMax<qreal>(floorBound, _lowerBounds.at((di * _angleSteps + ai) * _angleSteps + bi));
+}
+
+//private static
+void DubinsTable::_normalize(const QPointF &posA, qreal angleA,
+                             const QPointF &posB, qreal angleB,
+                             qreal minTurnRadius,
+                             qreal *d, qreal *alpha, qreal *beta)
+{
+    const qreal dx = posB.x() - posA.x();
+    const qreal dy = posB.y() - posA.y();
+    const qreal distance = sqrt(dx * dx + dy * dy);
+
+    //Same frame as dubins_init. Colocated poses have no line between them, so measure from the x axis.
+    const qreal theta = (distance > 0.0) ? atan2(dy, dx) : 0.0;
+    *d = distance / minTurnRadius;
+    *alpha = wrapTwoPi(angleA - theta);
+    *beta = wrapTwoPi(angleB - theta);
+}
+
+//private static
+qreal DubinsTable::_exactLength(qreal d, qreal alpha, qreal beta)
+{
+    DubinsPath path;
+    dubins_init_normalised(wrapTwoPi(alpha), wrapTwoPi(beta), d, 1.0, &path);
+    return dubins_path_length(&path);
+}
+
+//private
+int DubinsTable::_index(int di, int ai, int bi) const
+{
+    return (di * _angleSteps + ai) * _angleSteps + bi;
+}
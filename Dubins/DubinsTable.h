@@ -0,0 +1,88 @@
+#ifndef DUBINSTABLE_H
+#define DUBINSTABLE_H
+
+#include <QPointF>
+#include <QVector>
+
+#include "Dubins_global.h"
+
+/**
+ * @brief The DubinsTable class looks up Dubins path lengths instead of solving for them.
+ *
+ * A Dubins length only depends on the distance between the two poses in turning radii (d) and on the two
+ * headings relative to the line between them (alpha and beta), so one table over (d, alpha, beta) serves
+ * every turning radius. The table holds the exact length at each grid point. length() interpolates between
+ * them, and lowerBound() returns a value per grid cell meant to stay at or below the length anywhere in the
+ * cell, for use as an A* heuristic. Poses further apart than maxDistance() turning radii are solved exactly.
+ *
+ * A table is immutable once built and safe to use from many threads at once.
+ */
+class DUBINSSHARED_EXPORT DubinsTable
+{
+public:
+    /**
+     * @brief DubinsTable builds a table. Building takes (distanceSteps + 1) * angleSteps^2 Dubins solutions.
+     * @param distanceSteps number of cells between a distance of 0 and maxDistance
+     * @param maxDistance the furthest apart (in turning radii) that poses are looked up rather than solved
+     * @param angleSteps number of cells around the circle for each of the two headings
+     */
+    DubinsTable(int distanceSteps = 48, qreal maxDistance = 6.0, int angleSteps = 64);
+
+    /**
+     * @brief shared returns a table with the default size, built the first time it's asked for
+     */
+    static const DubinsTable& shared();
+
+    int distanceSteps() const;
+    qreal maxDistance() const;
+    int angleSteps() const;
+
+    /**
+     * @brief length returns the approximate length of the shortest path from (posA, angleA) to
+     * (posB, angleB). Angles are in radians counter-clockwise from the x axis, as with Dubins.
+     */
+    qreal length(const QPointF& posA, qreal angleA,
+                 const QPointF& posB, qreal angleB,
+                 qreal minTurnRadius) const;
+
+    /**
+     * @brief lowerBound is like length() but errs low instead of interpolating. It is never more than the
+     * exact length at any corner of the cell the poses fall in, less how much the length changes between
+     * neighboring corners. Where the length jumps within a cell, that drops it to the bounds that hold
+     * everywhere: the straight-line distance and the arc needed to turn from angleA to angleB.
+     */
+    qreal lowerBound(const QPointF& posA, qreal angleA,
+                     const QPointF& posB, qreal angleB,
+                     qreal minTurnRadius) const;
+
+    /**
+     * @brief normalizedLength is length() for a turning radius of 1, given in table coordinates
+     * @param d distance between the poses in turning radii
+     * @param alpha start heading minus the heading from start to end
+     * @param beta end heading minus the heading from start to end
+     */
+    qreal normalizedLength(qreal d, qreal alpha, qreal beta) const;
+    qreal normalizedLowerBound(qreal d, qreal alpha, qreal beta) const;
+
+private:
+    static void _normalize(const QPointF& posA, qreal angleA,
+                           const QPointF& posB, qreal angleB,
+                           qreal minTurnRadius,
+                           qreal * d, qreal * alpha, qreal * beta);
+    static qreal _exactLength(qreal d, qreal alpha, qreal beta);
+    int _index(int di, int ai, int bi) const;
+
+    int _distanceSteps;
+    qreal _maxDistance;
+    int _angleSteps;
+    qreal _distanceStep;
+    qreal _angleStep;
+
+    //Exact lengths at the grid points, (distanceSteps + 1) * angleSteps * angleSteps of them
+    QVector<float> _lengths;
+
+    //One per cell, distanceSteps * angleSteps * angleSteps of them
+    QVector<float> _lowerBounds;
+};
+
+#endif // DUBINSTABLE_H
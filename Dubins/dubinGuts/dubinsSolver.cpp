@@ -22,6 +22,7 @@
 #include <cmath>
 #include <cassert>
 #include <limits>
+#include <algorithm>
 
 using namespace std; 
 
@@ -54,13 +55,6 @@ const int DIRDATA[][3] = {
     { L_SEG, R_SEG, L_SEG }
 };
 
-#define UNPACK_INPUTS(alpha, beta)     \
-    qreal sa = sin(alpha);            \
-    qreal sb = sin(beta);             \
-    qreal ca = cos(alpha);            \
-    qreal cb = cos(beta);             \
-    qreal c_ab = cos(alpha - beta);   \
-    
 #define PACK_OUTPUTS(outputs)       \
     outputs[0]  = t;                \
     outputs[1]  = p;                \
@@ -104,9 +98,47 @@ int dubins_init( qreal q0[3], qreal q1[3], qreal rho, DubinsPath* path )
     return dubins_init_normalised( alpha, beta, d, rho, path );
 }
 
-void dubins_LSL( qreal alpha, qreal beta, qreal d, qreal* outputs )
+/**
+ * Trig terms shared by all six words. Computing them once per path instead of once
+ * per word saves 25 trig calls every time a path is solved.
+ */
+struct DubinsWordInputs
 {
-    UNPACK_INPUTS(alpha, beta);
+    qreal alpha;
+    qreal beta;
+    qreal d;
+    qreal sa;
+    qreal sb;
+    qreal ca;
+    qreal cb;
+    qreal c_ab;
+};
+
+static void dubins_word_inputs( qreal alpha, qreal beta, qreal d, DubinsWordInputs* in )
+{
+    in->alpha = alpha;
+    in->beta  = beta;
+    in->d     = d;
+    in->sa    = sin(alpha);
+    in->sb    = sin(beta);
+    in->ca    = cos(alpha);
+    in->cb    = cos(beta);
+    in->c_ab  = cos(alpha - beta);
+}
+
+#define UNPACK_WORD_INPUTS(in)     \
+    qreal alpha = in.alpha;       \
+    qreal beta  = in.beta;        \
+    qreal d     = in.d;           \
+    qreal sa    = in.sa;          \
+    qreal sb    = in.sb;          \
+    qreal ca    = in.ca;          \
+    qreal cb    = in.cb;          \
+    qreal c_ab  = in.c_ab;        \
+
+static void dubins_word_LSL( const DubinsWordInputs& in, qreal* outputs )
+{
+    UNPACK_WORD_INPUTS(in);
 
     qreal tmp0 = d+sa-sb;
     qreal tmp2 = 2 + (d*d) -(2*c_ab) + (2*d*(sa - sb));
@@ -119,9 +151,9 @@ void dubins_LSL( qreal alpha, qreal beta, qreal d, qreal* outputs )
     }
 }
 
-void dubins_RSR( qreal alpha, qreal beta, qreal d, qreal* outputs )
+static void dubins_word_RSR( const DubinsWordInputs& in, qreal* outputs )
 {
-    UNPACK_INPUTS(alpha, beta);
+    UNPACK_WORD_INPUTS(in);
 
     qreal tmp0 = d-sa+sb;
     qreal tmp2 = 2 + (d*d) -(2*c_ab) + (2*d*(sb-sa));
@@ -134,9 +166,9 @@ void dubins_RSR( qreal alpha, qreal beta, qreal d, qreal* outputs )
     }
 }
 
-void dubins_LSR( qreal alpha, qreal beta, qreal d, qreal* outputs )
+static void dubins_word_LSR( const DubinsWordInputs& in, qreal* outputs )
 {
-    UNPACK_INPUTS(alpha, beta);
+    UNPACK_WORD_INPUTS(in);
 
     qreal tmp1 = -2 + (d*d) + (2*c_ab) + (2*d*(sa+sb));
     if( tmp1 >= 0 ) {
@@ -148,9 +180,9 @@ void dubins_LSR( qreal alpha, qreal beta, qreal d, qreal* outputs )
     }
 }
 
-void dubins_RSL( qreal alpha, qreal beta, qreal d, qreal* outputs )
+static void dubins_word_RSL( const DubinsWordInputs& in, qreal* outputs )
 {
-    UNPACK_INPUTS(alpha, beta);
+    UNPACK_WORD_INPUTS(in);
 
     qreal tmp1 = (d*d) -2 + (2*c_ab) - (2*d*(sa+sb));
     if( tmp1 > 0 ) {
@@ -162,9 +194,9 @@ void dubins_RSL( qreal alpha, qreal beta, qreal d, qreal* outputs )
     }
 }
 
-void dubins_RLR( qreal alpha, qreal beta, qreal d, qreal* outputs )
+static void dubins_word_RLR( const DubinsWordInputs& in, qreal* outputs )
 {
-    UNPACK_INPUTS(alpha, beta);
+    UNPACK_WORD_INPUTS(in);
 
     qreal tmp_rlr = (6. - d*d + 2*c_ab + 2*d*(sa-sb)) / 8.;
     if( fabs(tmp_rlr) < 1) {
@@ -175,9 +207,9 @@ void dubins_RLR( qreal alpha, qreal beta, qreal d, qreal* outputs )
     }
 }
 
-void dubins_LRL( qreal alpha, qreal beta, qreal d, qreal* outputs )
+static void dubins_word_LRL( const DubinsWordInputs& in, qreal* outputs )
 {
-    UNPACK_INPUTS(alpha, beta);
+    UNPACK_WORD_INPUTS(in);
 
     qreal tmp_lrl = (6. - d*d + 2*c_ab + 2*d*(- sa + sb)) / 8.;
 
@@ -190,11 +222,52 @@ void dubins_LRL( qreal alpha, qreal beta, qreal d, qreal* outputs )
 
 }
 
-int dubins_init_normalised( qreal alpha,
-                            qreal beta,
-                            qreal d,
-                            qreal rho,
-                            DubinsPath* path) 
+void dubins_LSL( qreal alpha, qreal beta, qreal d, qreal* outputs )
+{
+    DubinsWordInputs in;
+    dubins_word_inputs( alpha, beta, d, &in );
+    dubins_word_LSL( in, outputs );
+}
+
+void dubins_RSR( qreal alpha, qreal beta, qreal d, qreal* outputs )
+{
+    DubinsWordInputs in;
+    dubins_word_inputs( alpha, beta, d, &in );
+    dubins_word_RSR( in, outputs );
+}
+
+void dubins_LSR( qreal alpha, qreal beta, qreal d, qreal* outputs )
+{
+    DubinsWordInputs in;
+    dubins_word_inputs( alpha, beta, d, &in );
+    dubins_word_LSR( in, outputs );
+}
+
+void dubins_RSL( qreal alpha, qreal beta, qreal d, qreal* outputs )
+{
+    DubinsWordInputs in;
+    dubins_word_inputs( alpha, beta, d, &in );
+    dubins_word_RSL( in, outputs );
+}
+
+void dubins_RLR( qreal alpha, qreal beta, qreal d, qreal* outputs )
+{
+    DubinsWordInputs in;
+    dubins_word_inputs( alpha, beta, d, &in );
+    dubins_word_RLR( in, outputs );
+}
+
+void dubins_LRL( qreal alpha, qreal beta, qreal d, qreal* outputs )
+{
+    DubinsWordInputs in;
+    dubins_word_inputs( alpha, beta, d, &in );
+    dubins_word_LRL( in, outputs );
+}
+
+/**
+ * Evaluate all six words and store the shortest one in path
+ */
+static void dubins_best_word( const DubinsWordInputs& in, qreal rho, DubinsPath* path )
 {
     path->rho = rho;
 
@@ -207,37 +280,29 @@ int dubins_init_normalised( qreal alpha,
     }
 
     // For each trajectory class, find the solution
-    dubins_LSL( alpha, beta, d, results[LSL] ); 
-    dubins_LSR( alpha, beta, d, results[LSR] );
-    dubins_RSL( alpha, beta, d, results[RSL] );
-    dubins_RSR( alpha, beta, d, results[RSR] );
-    dubins_RLR( alpha, beta, d, results[RLR] );
-    dubins_LRL( alpha, beta, d, results[LRL] );
+    dubins_word_LSL( in, results[LSL] );
+    dubins_word_LSR( in, results[LSR] );
+    dubins_word_RSL( in, results[RSL] );
+    dubins_word_RSR( in, results[RSR] );
+    dubins_word_RLR( in, results[RLR] );
+    dubins_word_LRL( in, results[LRL] );
 
     // Generate the total costs for each trajectory class
-    for(int i = 0; i < 6; i++) 
+    for(int i = 0; i < 6; i++)
     {
-        results[i][3] = 0;
-        for(int j = 0; j < 3; j++) {
-            //assert( results[i][j] >= 0. );
-            //std::cout << results[i][j] << " ";
-            results[i][3] += results[i][j];
-        }
-        //std::cout << std::endl;
+        results[i][3] = results[i][0] + results[i][1] + results[i][2];
     }
 
     // Extract the best cost path
     int bestType = 0;
     qreal minCost = results[0][3];
-    for(int i = 1; i < 6; i++) 
+    for(int i = 1; i < 6; i++)
     {
-        //std::cout << i << " " << results[i][3] << std::endl;
         if( results[i][3] < minCost ) {
             minCost = results[i][3];
             bestType = i;
-        } 
+        }
     }
-    //std::cout << "best = " << bestType << std::endl;
 
     // Copy the results into the output structure
     path->type = bestType;
@@ -245,9 +310,126 @@ int dubins_init_normalised( qreal alpha,
     {
         path->param[i] = results[bestType][i];
     }
+}
+
+int dubins_init_normalised( qreal alpha,
+                            qreal beta,
+                            qreal d,
+                            qreal rho,
+                            DubinsPath* path) 
+{
+    DubinsWordInputs in;
+    dubins_word_inputs( alpha, beta, d, &in );
+    dubins_best_word( in, rho, path );
     return 0;
 }
 
+int dubins_shortest_length( qreal q0[3], qreal q1[3], qreal rho, qreal* length )
+{
+    qreal dx = q1[0] - q0[0];
+    qreal dy = q1[1] - q0[1];
+    qreal D = sqrt( dx * dx + dy * dy );
+    qreal d = D / rho;
+    if( rho <= 0. ) {
+        return EDUBBADRHO;
+    }
+    if( (fabs(dx) < EPSILON) && (fabs(dy) < EPSILON) ) {
+        return EDUBCOCONFIGS;
+    }
+    qreal theta = mod2pi(atan2( dy, dx ));
+    qreal alpha = mod2pi(q0[2] - theta);
+    qreal beta  = mod2pi(q1[2] - theta);
+
+    // Same word selection as dubins_init, but the path stays on the stack and only its length escapes
+    DubinsWordInputs in;
+    dubins_word_inputs( alpha, beta, d, &in );
+    DubinsPath path;
+    dubins_best_word( in, rho, &path );
+    *length = dubins_path_length( &path );
+    return 0;
+}
+
+// Number of paths that dubins_init_batch prepares at a time. Sized so the scratch arrays stay on the stack.
+#define BATCH_CHUNK (64)
+
+int dubins_init_batch( const qreal* q0s, const qreal* q1s, int count, qreal rho,
+                       DubinsPath* paths, int* errors )
+{
+    if( rho <= 0. ) {
+        for( int i = 0; i < count; i++ ) {
+            if( errors ) errors[i] = EDUBBADRHO;
+        }
+        return 0;
+    }
+
+    // Structure-of-arrays scratch space. Each stage below is a straight loop over one chunk
+    // with no branches, so the compiler is free to vectorise it.
+    qreal alpha[BATCH_CHUNK];
+    qreal beta[BATCH_CHUNK];
+    qreal d[BATCH_CHUNK];
+    qreal sa[BATCH_CHUNK];
+    qreal sb[BATCH_CHUNK];
+    qreal ca[BATCH_CHUNK];
+    qreal cb[BATCH_CHUNK];
+    qreal c_ab[BATCH_CHUNK];
+
+    int solved = 0;
+    for( int first = 0; first < count; first += BATCH_CHUNK ) {
+        const int n = std::min( BATCH_CHUNK, count - first );
+        const qreal* q0 = q0s + 3 * first;
+        const qreal* q1 = q1s + 3 * first;
+
+        // Stage 1: normalise each pair of configurations
+        for( int i = 0; i < n; i++ ) {
+            const qreal dx = q1[3*i] - q0[3*i];
+            const qreal dy = q1[3*i + 1] - q0[3*i + 1];
+            const qreal theta = mod2pi(atan2( dy, dx ));
+            d[i]     = sqrt( dx * dx + dy * dy ) / rho;
+            alpha[i] = mod2pi(q0[3*i + 2] - theta);
+            beta[i]  = mod2pi(q1[3*i + 2] - theta);
+        }
+
+        // Stage 2: the trig shared by every word
+        for( int i = 0; i < n; i++ ) {
+            sa[i]   = sin(alpha[i]);
+            sb[i]   = sin(beta[i]);
+            ca[i]   = cos(alpha[i]);
+            cb[i]   = cos(beta[i]);
+            c_ab[i] = cos(alpha[i] - beta[i]);
+        }
+
+        // Stage 3: pick the best word for each pair
+        for( int i = 0; i < n; i++ ) {
+            DubinsPath* path = paths + first + i;
+            const qreal dx = q1[3*i] - q0[3*i];
+            const qreal dy = q1[3*i + 1] - q0[3*i + 1];
+            if( (fabs(dx) < EPSILON) && (fabs(dy) < EPSILON) ) {
+                if( errors ) errors[first + i] = EDUBCOCONFIGS;
+                continue;
+            }
+
+            for( int j = 0; j < 3; j++ ) {
+                path->qi[j] = q0[3*i + j];
+            }
+
+            DubinsWordInputs in;
+            in.alpha = alpha[i];
+            in.beta  = beta[i];
+            in.d     = d[i];
+            in.sa    = sa[i];
+            in.sb    = sb[i];
+            in.ca    = ca[i];
+            in.cb    = cb[i];
+            in.c_ab  = c_ab[i];
+            dubins_best_word( in, rho, path );
+
+            if( errors ) errors[first + i] = 0;
+            solved++;
+        }
+    }
+    return solved;
+}
+
 qreal dubins_path_length( DubinsPath* path )
 {
     qreal length = 0.;
@@ -330,6 +512,145 @@ int dubins_path_sample( DubinsPath* path, qreal t, qreal q[3] )
     return 0;
 }
 
+int dubins_path_sample_count( DubinsPath* path, qreal stepSize )
+{
+    const qreal length = dubins_path_length(path);
+    if( stepSize <= 0 || !(length > 0) ) {
+        return 0;
+    }
+
+    // The number of k >= 0 with k * stepSize < length
+    int count = (int)ceil( length / stepSize );
+    while( count * stepSize < length ) {
+        count++;
+    }
+    while( count > 0 && (count - 1) * stepSize >= length ) {
+        count--;
+    }
+    return count;
+}
+
+// How many samples we advance incrementally before recomputing sin/cos exactly
+#define SAMPLE_RESEED_INTERVAL (64)
+
+int dubins_sample_iterator_init( DubinsPath* path, qreal stepSize, DubinsSampleIterator* it )
+{
+    it->path = *path;
+    it->stepSize = stepSize;
+    it->count = dubins_path_sample_count( path, stepSize );
+    it->next = 0;
+    it->segment = -1;
+    it->seeded = 0;
+    it->s = it->c = it->s0 = it->c0 = 0;
+    if( it->count <= 0 ) {
+        it->count = 0;
+        return 0;
+    }
+
+    // Segment start configurations, in the normalised frame used by dubins_path_sample
+    const int* types = DIRDATA[path->type];
+    const qreal p1 = path->param[0];
+    const qreal p2 = path->param[1];
+    it->starts[0][0] = 0;
+    it->starts[0][1] = 0;
+    it->starts[0][2] = path->qi[2];
+    dubins_segment( p1, it->starts[0], it->starts[1], types[0] );
+    dubins_segment( p2, it->starts[1], it->starts[2], types[1] );
+    it->bases[0] = 0;
+    it->bases[1] = p1;
+    it->bases[2] = p1 + p2;
+
+    const qreal du = stepSize / path->rho;
+    it->sdu = sin(du);
+    it->cdu = cos(du);
+    return it->count;
+}
+
+int dubins_sample_iterator_next( DubinsSampleIterator* it, qreal q[3] )
+{
+    if( it->next >= it->count ) {
+        return EDUBPARAM;
+    }
+    const int k = it->next++;
+    const DubinsPath* path = &it->path;
+    const int* types = DIRDATA[path->type];
+
+    /*
+     * Within a segment the samples are evenly spaced in turn angle, so instead of calling sin/cos for
+     * every sample we rotate the previous (sin, cos) pair by the constant step. The pair is recomputed
+     * exactly at the start of each segment and every SAMPLE_RESEED_INTERVAL samples to bound drift.
+     */
+    const qreal tprime = (k * it->stepSize) / path->rho;
+    int newSegment = 2;
+    if( tprime < it->bases[1] ) {
+        newSegment = 0;
+    }
+    else if( tprime < it->bases[2] ) {
+        newSegment = 1;
+    }
+    const qreal u = tprime - it->bases[newSegment];
+    const qreal* qi = it->starts[newSegment];
+    const int type = types[newSegment];
+
+    if( newSegment != it->segment || (k - it->seeded) >= SAMPLE_RESEED_INTERVAL ) {
+        if( newSegment != it->segment ) {
+            it->s0 = sin(qi[2]);
+            it->c0 = cos(qi[2]);
+        }
+        it->segment = newSegment;
+        it->seeded = k;
+        const qreal heading = (type == L_SEG) ? qi[2] + u : qi[2] - u;
+        it->s = sin(heading);
+        it->c = cos(heading);
+    }
+    else if( type == L_SEG ) {
+        const qreal ns = it->s * it->cdu + it->c * it->sdu;
+        it->c = it->c * it->cdu - it->s * it->sdu;
+        it->s = ns;
+    }
+    else if( type == R_SEG ) {
+        const qreal ns = it->s * it->cdu - it->c * it->sdu;
+        it->c = it->c * it->cdu + it->s * it->sdu;
+        it->s = ns;
+    }
+
+    if( type == L_SEG ) {
+        q[0] = qi[0] + it->s - it->s0;
+        q[1] = qi[1] - it->c + it->c0;
+        q[2] = qi[2] + u;
+    }
+    else if( type == R_SEG ) {
+        q[0] = qi[0] - it->s + it->s0;
+        q[1] = qi[1] + it->c - it->c0;
+        q[2] = qi[2] - u;
+    }
+    else { // type == S_SEG
+        q[0] = qi[0] + it->c0 * u;
+        q[1] = qi[1] + it->s0 * u;
+        q[2] = qi[2];
+    }
+
+    q[0] = q[0] * path->rho + path->qi[0];
+    q[1] = q[1] * path->rho + path->qi[1];
+    q[2] = mod2pi(q[2]);
+    return 0;
+}
+
+int dubins_path_sample_fixed( DubinsPath* path, qreal stepSize,
+                              qreal* xs, qreal* ys, qreal* thetas, int maxSamples )
+{
+    DubinsSampleIterator it;
+    const int count = std::min( dubins_sample_iterator_init( path, stepSize, &it ), maxSamples );
+    for( int k = 0; k < count; k++ ) {
+        qreal q[3];
+        dubins_sample_iterator_next( &it, q );
+        xs[k]     = q[0];
+        ys[k]     = q[1];
+        thetas[k] = q[2];
+    }
+    return std::max( count, 0 );
+}
+
 int dubins_path_sample_many( DubinsPath* path, DubinsPathSamplingCallback cb, qreal stepSize )
 {
     // TODO - this implementation could be optimised by caching
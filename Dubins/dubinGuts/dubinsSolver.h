@@ -63,6 +63,18 @@ typedef int (*DubinsPathSamplingCallback)(qreal q[3], qreal t);
  */
 int dubins_init( qreal q0[3], qreal q1[3], qreal rho, DubinsPath* path);
 
+/**
+ * Calculate the length of the shortest path between two configurations
+ * without generating (or sampling) the path itself
+ *
+ * @param q0     - a configuration specified as an array of x, y, theta
+ * @param q1     - a configuration specified as an array of x, y, theta
+ * @param rho    - forward velocity of the vehicle divided by maximum angular velocity
+ * @param length - the resultant length
+ * @return       - 0 on success
+ */
+int dubins_shortest_length( qreal q0[3], qreal q1[3], qreal rho, qreal* length );
+
 /**
  * Calculate the length of an initialised path
  *
@@ -80,6 +92,89 @@ qreal dubins_path_length( DubinsPath* path );
  */
 int dubins_path_sample( DubinsPath* path, qreal t, qreal q[3]);
 
+/**
+ * Generate many paths at once, all with the same turning radius. Cheaper
+ * per path than calling dubins_init in a loop.
+ *
+ * @param q0s    - count configurations (x, y, theta), stored contiguously
+ * @param q1s    - count configurations (x, y, theta), stored contiguously
+ * @param count  - the number of configuration pairs
+ * @param rho    - forward velocity of the vehicle divided by maximum angular velocity
+ * @param paths  - count resultant paths
+ * @param errors - if not null, count error codes (0 on success, as from dubins_init)
+ * @return       - the number of paths successfully generated
+ */
+int dubins_init_batch( const qreal* q0s, const qreal* q1s, int count, qreal rho,
+                       DubinsPath* paths, int* errors );
+
+/**
+ * The number of samples dubins_path_sample_fixed produces for a step size,
+ * i.e. the number of t = k * stepSize with 0 <= t < dubins_path_length(path)
+ *
+ * @param path     - an initialised path
+ * @param stepSize - the distance along the path between samples
+ */
+int dubins_path_sample_count( DubinsPath* path, qreal stepSize );
+
+/**
+ * Sample the path at t = 0, stepSize, 2 * stepSize, ... into separate x, y and
+ * theta arrays. Gives the same configurations as dubins_path_sample() at
+ * those t, but without per-sample trig calls.
+ *
+ * @param path       - an initialised path
+ * @param stepSize   - the distance along the path between samples
+ * @param xs         - at least maxSamples x outputs
+ * @param ys         - at least maxSamples y outputs
+ * @param thetas     - at least maxSamples heading outputs
+ * @param maxSamples - the capacity of the output arrays
+ * @return           - the number of samples written
+ */
+int dubins_path_sample_fixed( DubinsPath* path, qreal stepSize,
+                              qreal* xs, qreal* ys, qreal* thetas, int maxSamples );
+
+/**
+ * State for walking a path at a fixed step, one sample at a time. Set up by
+ * dubins_sample_iterator_init, advanced by dubins_sample_iterator_next.
+ */
+class DubinsSampleIterator
+{
+public:
+    DubinsPath path;
+    qreal stepSize;
+    int count;          // total number of samples
+    int next;           // index of the next sample
+    int segment;        // segment of the previous sample, -1 before the first
+    int seeded;         // sample at which (s, c) were last computed exactly
+    qreal starts[3][3]; // segment start configurations in the normalised frame
+    qreal bases[3];     // normalised distance at which each segment starts
+    qreal sdu;          // sin/cos of the normalised step
+    qreal cdu;
+    qreal s;            // sin/cos of the current heading on arcs
+    qreal c;
+    qreal s0;           // sin/cos of the current segment's starting heading
+    qreal c0;
+};
+
+/**
+ * Prepare to sample a path at t = 0, stepSize, 2 * stepSize, ... as
+ * dubins_path_sample_fixed does. The path is copied into the iterator.
+ *
+ * @param path     - an initialised path
+ * @param stepSize - the distance along the path between samples
+ * @param it       - the iterator to set up
+ * @return         - the number of samples the iterator will produce
+ */
+int dubins_sample_iterator_init( DubinsPath* path, qreal stepSize, DubinsSampleIterator* it );
+
+/**
+ * Produce the next sample
+ *
+ * @param it - an iterator set up by dubins_sample_iterator_init
+ * @param q  - the configuration result
+ * @return   - 0 on success, non-zero once every sample has been produced
+ */
+int dubins_sample_iterator_next( DubinsSampleIterator* it, qreal q[3] );
+
 /**
  * Walk along the path at a fixed sampling interval, calling the
  * callback function at each interval
@@ -1,11 +1,31 @@
 TEMPLATE = subdirs
 
-SUBDIRS = MapGraphics FlightPlanner QVectorND QKDTree GPX Dubins
+SUBDIRS = MapGraphics PlanningCore FlightPlanner FlightPlannerCLI Benchmarks TileBenchmarks QVectorND QKDTree GPX Dubins
 
 FlightPlanner.depends += MapGraphics
+FlightPlanner.depends += PlanningCore
 FlightPlanner.depends += QVectorND
 FlightPlanner.depends += QKDTree
 FlightPlanner.depends += GPX
 FlightPlanner.depends += Dubins
 
+FlightPlannerCLI.depends += PlanningCore
+FlightPlannerCLI.depends += QVectorND
+FlightPlannerCLI.depends += QKDTree
+FlightPlannerCLI.depends += GPX
+FlightPlannerCLI.depends += Dubins
+
+Benchmarks.depends += PlanningCore
+Benchmarks.depends += QVectorND
+Benchmarks.depends += QKDTree
+Benchmarks.depends += GPX
+Benchmarks.depends += Dubins
+
+TileBenchmarks.depends += MapGraphics
+
+PlanningCore.depends += QVectorND
+PlanningCore.depends += QKDTree
+PlanningCore.depends += GPX
+PlanningCore.depends += Dubins
+
 QKDTree.depends += QVectorND
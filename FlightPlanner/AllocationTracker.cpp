@@ -0,0 +1,158 @@
+#include "AllocationTracker.h"
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QtDebug>
+#include <cstring>
+
+#include "PlanningStatistics.h"
+
+//non-member
+static QAtomicInt& trackingEnabled()
+{
+    static QAtomicInt enabled(qgetenv("FLIGHTPLANNER_ALLOCATION_TRACKING").isEmpty() ? 0 : 1);
+    return enabled;
+}
+
+//non-member
+static QMutex& usageLock()
+{
+    static QMutex lock;
+    return lock;
+}
+
+//non-member
+static QHash<QByteArray, AllocationTracker::Usage>& usageTable()
+{
+    static QHash<QByteArray, AllocationTracker::Usage> table;
+    return table;
+}
+
+AllocationTracker::Usage::Usage() :
+    liveBytes(0), peakBytes(0)
+{
+}
+
+//static
+bool AllocationTracker::isEnabled()
+{
+    return trackingEnabled().load() != 0;
+}
+
+//static
+void AllocationTracker::setEnabled(bool enabled)
+{
+    trackingEnabled().store(enabled ? 1 : 0);
+}
+
+//static
+void AllocationTracker::charge(const char *subsystem, qint64 bytes)
+{
+    if (bytes == 0)
+        return;
+
+    QMutexLocker lock(&usageLock());
+
+    //fromRawData() saves copying the name except the first time we see it
+    const QByteArray name = QByteArray::fromRawData(subsystem, (int)strlen(subsystem));
+    QHash<QByteArray, Usage>::iterator iter = usageTable().find(name);
+    if (iter == usageTable().end())
+        iter = usageTable().insert(QByteArray(subsystem), Usage());
+
+    iter->liveBytes += bytes;
+    iter->peakBytes = qMax<qint64>(iter->peakBytes, iter->liveBytes);
+}
+
+//static
+QMap<QString, AllocationTracker::Usage> AllocationTracker::usage()
+{
+    QMap<QString, Usage> toRet;
+    QMutexLocker lock(&usageLock());
+    QHash<QByteArray, Usage>::const_iterator iter;
+    for (iter = usageTable().constBegin(); iter != usageTable().constEnd(); iter++)
+        toRet.insert(QString::fromLatin1(iter.key()), iter.value());
+    return toRet;
+}
+
+//static
+void AllocationTracker::resetPeaks()
+{
+    QMutexLocker lock(&usageLock());
+    QHash<QByteArray, Usage>::iterator iter;
+    for (iter = usageTable().begin(); iter != usageTable().end(); iter++)
+        iter->peakBytes = iter->liveBytes;
+}
+
+//static
+void AllocationTracker::addToStatistics(PlanningStatistics *statistics)
+{
+    if (!AllocationTracker::isEnabled())
+        return;
+
+    const QMap<QString, Usage> current = AllocationTracker::usage();
+    QMap<QString, Usage>::const_iterator iter;
+    for (iter = current.constBegin(); iter != current.constEnd(); iter++)
+    {
+        statistics->setCounter(iter.key() + "LiveBytes", iter.value().liveBytes);
+        statistics->setCounter(iter.key() + "PeakBytes", iter.value().peakBytes);
+    }
+}
+
+//static
+void AllocationTracker::dump()
+{
+    const QMap<QString, Usage> current = AllocationTracker::usage();
+    if (current.isEmpty())
+    {
+        qDebug() << "Allocations: nothing tracked";
+        return;
+    }
+
+    QMap<QString, Usage>::const_iterator iter;
+    for (iter = current.constBegin(); iter != current.constEnd(); iter++)
+        qDebug() << "Allocations:" << iter.key() << iter.value().liveBytes << "bytes live," << iter.value().peakBytes << "peak";
+}
+
+AllocationScope::AllocationScope(const char *subsystem, qint64 bytes) :
+    _subsystem(subsystem), _bytes(0), _tracking(AllocationTracker::isEnabled())
+{
+    this->setBytes(bytes);
+}
+
+AllocationScope::AllocationScope(const AllocationScope &other) :
+    _subsystem(other._subsystem), _bytes(0), _tracking(AllocationTracker::isEnabled())
+{
+    this->setBytes(other._bytes);
+}
+
+AllocationScope::~AllocationScope()
+{
+    this->setBytes(0);
+}
+
+AllocationScope &AllocationScope::operator =(const AllocationScope &other)
+{
+    if (&other == this)
+        return *this;
+
+    this->setBytes(0);
+    _subsystem = other._subsystem;
+    _tracking = AllocationTracker::isEnabled();
+    this->setBytes(other._bytes);
+    return *this;
+}
+
+qint64 AllocationScope::bytes() const
+{
+    return _bytes;
+}
+
+void AllocationScope::setBytes(qint64 bytes)
+{
+    if (_tracking && bytes != _bytes)
+        AllocationTracker::charge(_subsystem, bytes - _bytes);
+    _bytes = bytes;
+}
@@ -0,0 +1,90 @@
+#ifndef ALLOCATIONTRACKER_H
+#define ALLOCATIONTRACKER_H
+
+#include <QtGlobal>
+#include <QMap>
+#include <QString>
+
+class PlanningStatistics;
+
+/**
+ * @brief The AllocationTracker class keeps count of the bytes that the big allocators of each subsystem (the
+ * schedule search's node table, sub-flight node arenas, kd-trees, tile caches...) hold right now and have held
+ * at most, so that a memory spike can be pinned on one of them.
+ *
+ * Subsystems charge and release bytes themselves, usually through an AllocationScope that follows one
+ * container's capacity. It's off (and costs a branch) unless FLIGHTPLANNER_ALLOCATION_TRACKING is set in the
+ * environment or setEnabled() turns it on. Only allocations made while it's on are counted, so turn it on
+ * before planning starts. Everything here is thread-safe.
+ */
+class AllocationTracker
+{
+public:
+    struct Usage
+    {
+        Usage();
+
+        qint64 liveBytes;
+        qint64 peakBytes;
+    };
+
+    static bool isEnabled();
+    static void setEnabled(bool enabled);
+
+    /**
+     * @brief charge records that subsystem now holds bytes more (or, if bytes is negative, fewer)
+     * @param subsystem a name like "ScheduleNodes". Counter names are built from it, so keep it CamelCase.
+     * @param bytes
+     */
+    static void charge(const char * subsystem, qint64 bytes);
+
+    /**
+     * @brief usage returns every subsystem that has charged anything, by name
+     * @return
+     */
+    static QMap<QString, Usage> usage();
+
+    /**
+     * @brief resetPeaks brings each subsystem's peak down to what it holds now, e.g. before a new planning run
+     */
+    static void resetPeaks();
+
+    /**
+     * @brief addToStatistics sets <subsystem>LiveBytes and <subsystem>PeakBytes counters in statistics for
+     * every subsystem. Does nothing while tracking is off.
+     * @param statistics
+     */
+    static void addToStatistics(PlanningStatistics * statistics);
+
+    /**
+     * @brief dump logs each subsystem's live and peak bytes with qDebug()
+     */
+    static void dump();
+};
+
+/**
+ * @brief The AllocationScope class charges some bytes to a subsystem for as long as it lives. Owners of a
+ * growing container keep one beside it and setBytes() when its capacity changes. A copy charges its bytes again,
+ * just as copying the container would allocate them again.
+ */
+class AllocationScope
+{
+public:
+    explicit AllocationScope(const char * subsystem, qint64 bytes = 0);
+    AllocationScope(const AllocationScope& other);
+    ~AllocationScope();
+
+    AllocationScope& operator =(const AllocationScope& other);
+
+    qint64 bytes() const;
+    void setBytes(qint64 bytes);
+
+private:
+    const char * _subsystem;
+    qint64 _bytes;
+
+    //Whether tracking was on when we were made. If not, we never charge anything, so there's nothing to release.
+    bool _tracking;
+};
+
+#endif // ALLOCATIONTRACKER_H
@@ -0,0 +1,206 @@
+#include "BatchFitnessEvaluator.h"
+
+#include <QRunnable>
+#include <QThread>
+#include <QtDebug>
+
+#include "CompiledProblem.h"
+#include "JobSystem.h"
+#include "FlightTasks/FlightTaskScoringState.h"
+
+#ifdef PLANNING_OPENCL
+#include "OpenCLFitnessBackend.h"
+#else
+//Never created without the OpenCL backend, but the scoped pointer still wants a type it can delete
+class OpenCLFitnessBackend
+{
+public:
+    QString deviceName() const
+    {
+        return QString();
+    }
+
+    bool evaluate(const QList<QList<Position> >&, QVector<Fitness> *, QVector<int> *, QString *)
+    {
+        return false;
+    }
+};
+#endif
+
+//Smaller batches cost more to send to the GPU and back than to score on the CPU
+const int MIN_GPU_BATCH = 16;
+
+typedef QList<QSharedPointer<FlightTaskScoringState> > ScoringStates;
+
+/*
+ * Scores one contiguous slice of a batch. Each job has its own scoring states and only writes its own results,
+ * so slices can run concurrently.
+*/
+class BatchEvaluationJob : public QRunnable
+{
+public:
+    BatchEvaluationJob(const CompiledProblem * problem, const QList<QList<Position> >& flights, int first, int end,
+                       Fitness * fitnesses, int * lengths) :
+        _problem(problem), _flights(flights), _first(first), _end(end), _fitnesses(fitnesses), _lengths(lengths)
+    {
+        this->setAutoDelete(false);
+    }
+
+    //virtual from QRunnable
+    virtual void run()
+    {
+        const ScoringStates empty = _problem->createScoringStates();
+        ScoringStates states;
+        foreach(const QSharedPointer<FlightTaskScoringState>& state, empty)
+            states.append(state->clone());
+
+        for (int i = _first; i < _end; i++)
+        {
+            const QList<Position>& flight = _flights.at(i);
+            for (int j = 0; j < states.size(); j++)
+                states.at(j)->copyFrom(*empty.at(j));
+
+            //Every prefix gets scored on the way, and the shortest of the best ones is what the flight is worth
+            _fitnesses[i] = Fitness();
+            _lengths[i] = 0;
+            for (int length = 0; length < flight.size(); length++)
+            {
+                foreach(const QSharedPointer<FlightTaskScoringState>& state, states)
+                    state->append(flight.at(length));
+                const Fitness score = _problem->calculateFlightPerformance(states);
+                if (length == 0 || score > _fitnesses[i])
+                {
+                    _fitnesses[i] = score;
+                    _lengths[i] = length;
+                }
+            }
+        }
+    }
+
+private:
+    const CompiledProblem * _problem;
+    const QList<QList<Position> >& _flights;
+    const int _first;
+    const int _end;
+    Fitness * _fitnesses;
+    int * _lengths;
+};
+
+BatchFitnessEvaluator::BatchFitnessEvaluator(const QSharedPointer<const CompiledProblem> &problem, bool allowGpu) :
+    _problem(problem), _workerCount(0), _cpuFlights(0), _gpuFlights(0)
+{
+#ifdef PLANNING_OPENCL
+    if (allowGpu && !_problem.isNull())
+    {
+        QString errorString;
+        _gpu.reset(OpenCLFitnessBackend::create(_problem.data(), &errorString));
+        if (_gpu.isNull())
+            qDebug() << "Scoring batches on the CPU:" << errorString;
+    }
+#else
+    Q_UNUSED(allowGpu)
+#endif
+}
+
+BatchFitnessEvaluator::~BatchFitnessEvaluator()
+{
+}
+
+const QSharedPointer<const CompiledProblem> &BatchFitnessEvaluator::problem() const
+{
+    return _problem;
+}
+
+BatchFitnessEvaluator::Backend BatchFitnessEvaluator::backend() const
+{
+    return _gpu.isNull() ? CpuBackend : GpuBackend;
+}
+
+QString BatchFitnessEvaluator::backendName() const
+{
+    return _gpu.isNull() ? QString("CPU") : _gpu->deviceName();
+}
+
+int BatchFitnessEvaluator::workerCount() const
+{
+    return _workerCount;
+}
+
+void BatchFitnessEvaluator::setWorkerCount(int count)
+{
+    _workerCount = qMax<int>(0, count);
+}
+
+void BatchFitnessEvaluator::evaluate(const QList<QList<Position> > &flights,
+                                     QVector<Fitness> *fitnessesOut,
+                                     QVector<int> *lengthsOut)
+{
+    fitnessesOut->resize(flights.size());
+    lengthsOut->resize(flights.size());
+    if (flights.isEmpty())
+        return;
+
+    if (!_gpu.isNull() && flights.size() >= MIN_GPU_BATCH)
+    {
+        QString errorString;
+        if (_gpu->evaluate(flights, fitnessesOut, lengthsOut, &errorString))
+        {
+            _gpuFlights += flights.size();
+            return;
+        }
+
+        //Whatever went wrong will most likely go wrong again, so the CPU takes over for good
+        qWarning() << "GPU fitness evaluation failed, falling back to the CPU:" << errorString;
+        _gpu.reset();
+    }
+
+    _evaluateOnCpu(flights, fitnessesOut, lengthsOut);
+    _cpuFlights += flights.size();
+}
+
+quint64 BatchFitnessEvaluator::cpuFlights() const
+{
+    return _cpuFlights;
+}
+
+quint64 BatchFitnessEvaluator::gpuFlights() const
+{
+    return _gpuFlights;
+}
+
+//static
+bool BatchFitnessEvaluator::gpuCompiledIn()
+{
+#ifdef PLANNING_OPENCL
+    return true;
+#else
+    return false;
+#endif
+}
+
+//private
+void BatchFitnessEvaluator::_evaluateOnCpu(const QList<QList<Position> > &flights,
+                                           QVector<Fitness> *fitnessesOut,
+                                           QVector<int> *lengthsOut)
+{
+    const int workers = (_workerCount == 0) ? QThread::idealThreadCount() : _workerCount;
+    const int jobCount = qBound<int>(1, workers, flights.size());
+
+    //One contiguous slice per worker
+    QList<BatchEvaluationJob *> jobs;
+    for (int j = 0; j < jobCount; j++)
+        jobs.append(new BatchEvaluationJob(_problem.data(), flights,
+                                           flights.size() * j / jobCount, flights.size() * (j + 1) / jobCount,
+                                           fitnessesOut->data(), lengthsOut->data()));
+
+    if (jobCount <= 1)
+        jobs.first()->run();
+    else
+    {
+        JobGroup group;
+        foreach(BatchEvaluationJob * job, jobs)
+            group.run(job, "FitnessEvaluation");
+        group.wait();
+    }
+    qDeleteAll(jobs);
+}
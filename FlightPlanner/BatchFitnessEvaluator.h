@@ -0,0 +1,104 @@
+#ifndef BATCHFITNESSEVALUATOR_H
+#define BATCHFITNESSEVALUATOR_H
+
+#include <QtGlobal>
+#include <QList>
+#include <QScopedPointer>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+
+#include "Position.h"
+#include "Fitness.h"
+
+class CompiledProblem;
+class OpenCLFitnessBackend;
+
+/**
+ * @brief The BatchFitnessEvaluator class scores many candidate flights against one CompiledProblem at once, for
+ * the planners that score whole populations of them every iteration. Each flight is scored as the best of its
+ * prefixes (the shortest of them if several tie), which is what EvolutionaryFlightPlanner's genomes are worth.
+ *
+ * Batches are scored on the CPU by default, split into slices that run on JobSystem::shared() with their own
+ * scoring states. PlanningCore built with CONFIG += planning_opencl can also score them on a GPU: every flight
+ * gets a work-group whose work-items check the flight's waypoints against the coverage bins side by side. The
+ * GPU is used when there is one and every task in the problem is a coverage, sampling or no-fly task. Otherwise,
+ * or as soon as the GPU fails, batches go to the CPU instead, so callers never have to care which one they got.
+ * GPU scores are worked out in single precision and can differ from the CPU's in the last digits.
+ *
+ * An evaluator is for one problem and one thread at a time.
+ */
+class BatchFitnessEvaluator
+{
+public:
+    enum Backend
+    {
+        CpuBackend,
+        GpuBackend
+    };
+
+    /**
+     * @brief BatchFitnessEvaluator
+     * @param problem
+     * @param allowGpu false to always score on the CPU
+     */
+    explicit BatchFitnessEvaluator(const QSharedPointer<const CompiledProblem>& problem, bool allowGpu = true);
+    ~BatchFitnessEvaluator();
+
+    const QSharedPointer<const CompiledProblem>& problem() const;
+
+    /**
+     * @brief backend returns where the next batch big enough for the GPU will be scored
+     * @return
+     */
+    BatchFitnessEvaluator::Backend backend() const;
+
+    /**
+     * @brief backendName returns "CPU", or the name of the GPU
+     * @return
+     */
+    QString backendName() const;
+
+    /**
+     * @brief workerCount returns how many slices CPU batches are split into. 0 (the default) means
+     * "use QThread::idealThreadCount()".
+     * @return
+     */
+    int workerCount() const;
+    void setWorkerCount(int count);
+
+    /**
+     * @brief evaluate scores every flight in flights
+     * @param flights each starting with the starting position
+     * @param fitnessesOut resized to flights.size(), the fitness of each flight's best prefix
+     * @param lengthsOut resized to flights.size(), the number of waypoints after the first in that prefix
+     */
+    void evaluate(const QList<QList<Position> >& flights, QVector<Fitness> * fitnessesOut, QVector<int> * lengthsOut);
+
+    //How many flights each backend has scored
+    quint64 cpuFlights() const;
+    quint64 gpuFlights() const;
+
+    /**
+     * @brief gpuCompiledIn returns true if PlanningCore was built with the OpenCL backend
+     * @return
+     */
+    static bool gpuCompiledIn();
+
+private:
+    void _evaluateOnCpu(const QList<QList<Position> >& flights, QVector<Fitness> * fitnessesOut,
+                        QVector<int> * lengthsOut);
+
+    QSharedPointer<const CompiledProblem> _problem;
+    int _workerCount;
+
+    quint64 _cpuFlights;
+    quint64 _gpuFlights;
+
+    //Null when there's no usable GPU, or once it has failed
+    QScopedPointer<OpenCLFitnessBackend> _gpu;
+
+    Q_DISABLE_COPY(BatchFitnessEvaluator)
+};
+
+#endif // BATCHFITNESSEVALUATOR_H
@@ -0,0 +1,113 @@
+#include "BatchPlanningRun.h"
+
+#include <QtDebug>
+
+BatchPlanningRun::BatchPlanningRun(FlightPlanner *planner, QObject *parent) :
+    QObject(parent), _planner(planner), _timeBudget(0), _elapsed(0), _iterations(0), _budgetExhausted(false)
+{
+    _budgetTimer.setSingleShot(true);
+    connect(&_budgetTimer,
+            SIGNAL(timeout()),
+            this,
+            SLOT(handleBudgetTimeout()));
+
+    connect(_planner,
+            SIGNAL(plannerStatusChanged(FlightPlanner::PlanningStatus)),
+            this,
+            SLOT(handlePlannerStatusChanged(FlightPlanner::PlanningStatus)));
+    connect(_planner,
+            SIGNAL(plannerProgressChanged(qreal,quint32)),
+            this,
+            SLOT(handlePlannerProgressChanged(qreal,quint32)));
+}
+
+BatchPlanningRun::~BatchPlanningRun()
+{
+}
+
+qint64 BatchPlanningRun::timeBudget() const
+{
+    return _timeBudget;
+}
+
+void BatchPlanningRun::setTimeBudget(qint64 msecs)
+{
+    _timeBudget = qMax<qint64>(0, msecs);
+}
+
+bool BatchPlanningRun::run(QString *errorString)
+{
+    _elapsed = 0;
+    _iterations = 0;
+    _budgetExhausted = false;
+
+    //The budget timer has to keep ticking while an iteration runs, so iterations go on the worker thread
+    _planner->setExecutionMode(FlightPlanner::ThreadExecution);
+
+    _clock.start();
+    _planner->startPlanning();
+    if (_planner->status() != FlightPlanner::Running)
+    {
+        if (errorString)
+            *errorString = "The planner refused to start. Does the problem have a starting position?";
+        return false;
+    }
+
+    if (_timeBudget > 0)
+        _budgetTimer.start(_timeBudget);
+    _loop.exec();
+    _budgetTimer.stop();
+    _elapsed = _clock.elapsed();
+
+    if (_planner->bestFlightSoFar().isEmpty())
+    {
+        if (errorString)
+        {
+            if (_budgetExhausted)
+                *errorString = QString("No flight found within %1 ms").arg(_timeBudget);
+            else
+                *errorString = "The planner stopped without finding a flight";
+        }
+        return false;
+    }
+    return true;
+}
+
+qint64 BatchPlanningRun::elapsed() const
+{
+    return _elapsed;
+}
+
+quint32 BatchPlanningRun::iterations() const
+{
+    return _iterations;
+}
+
+bool BatchPlanningRun::budgetExhausted() const
+{
+    return _budgetExhausted;
+}
+
+//private slot
+void BatchPlanningRun::handlePlannerStatusChanged(FlightPlanner::PlanningStatus status)
+{
+    if (status != FlightPlanner::Running)
+        _loop.quit();
+}
+
+//private slot
+void BatchPlanningRun::handlePlannerProgressChanged(qreal fitness, quint32 iterations)
+{
+    Q_UNUSED(fitness)
+    _iterations = iterations;
+}
+
+//private slot
+void BatchPlanningRun::handleBudgetTimeout()
+{
+    qDebug() << "Time budget of" << _timeBudget << "ms exhausted, stopping the planner";
+    _budgetExhausted = true;
+
+    //The loop quits once the worker has wound down and the planner announces that it's paused
+    _planner->pausePlanning();
+}
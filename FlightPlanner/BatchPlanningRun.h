@@ -0,0 +1,60 @@
+#ifndef BATCHPLANNINGRUN_H
+#define BATCHPLANNINGRUN_H
+
+#include <QObject>
+#include <QEventLoop>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QString>
+
+#include "FlightPlanner.h"
+
+/**
+ * @brief The BatchPlanningRun class runs a FlightPlanner to completion without a GUI. It starts the planner
+ * on its worker thread and spins an event loop until the planner stops by itself (like HierarchicalPlanner
+ * does after one pass) or until the time budget runs out, whichever comes first.
+ */
+class BatchPlanningRun : public QObject
+{
+    Q_OBJECT
+public:
+    explicit BatchPlanningRun(FlightPlanner * planner, QObject *parent = 0);
+    virtual ~BatchPlanningRun();
+
+    /**
+     * @brief timeBudget is how long in milliseconds run() lets the planner work before pausing it. Zero means
+     * no limit, which only makes sense for planners that stop by themselves.
+     */
+    qint64 timeBudget() const;
+    void setTimeBudget(qint64 msecs);
+
+    /**
+     * @brief run plans until the planner stops or the budget runs out. Returns true if the planner produced a
+     * flight, false otherwise with an explanation in errorString.
+     */
+    bool run(QString * errorString = 0);
+
+    //Statistics of the last run()
+    qint64 elapsed() const;
+    quint32 iterations() const;
+    bool budgetExhausted() const;
+
+private slots:
+    void handlePlannerStatusChanged(FlightPlanner::PlanningStatus status);
+    void handlePlannerProgressChanged(qreal fitness, quint32 iterations);
+    void handleBudgetTimeout();
+
+private:
+    FlightPlanner * _planner;
+    qint64 _timeBudget;
+
+    QEventLoop _loop;
+    QTimer _budgetTimer;
+    QElapsedTimer _clock;
+
+    qint64 _elapsed;
+    quint32 _iterations;
+    bool _budgetExhausted;
+};
+
+#endif // BATCHPLANNINGRUN_H
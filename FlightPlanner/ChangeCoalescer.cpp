@@ -0,0 +1,65 @@
+#include "ChangeCoalescer.h"
+
+ChangeCoalescer::ChangeCoalescer(QObject *parent) :
+    QObject(parent), _updateDepth(0), _pending(false), _queued(false)
+{
+}
+
+void ChangeCoalescer::beginUpdate()
+{
+    _updateDepth++;
+}
+
+void ChangeCoalescer::endUpdate()
+{
+    Q_ASSERT(_updateDepth > 0);
+    if (_updateDepth <= 0)
+        return;
+
+    _updateDepth--;
+    if (_updateDepth == 0 && _pending)
+        this->_queueFlush();
+}
+
+bool ChangeCoalescer::isUpdating() const
+{
+    return _updateDepth > 0;
+}
+
+void ChangeCoalescer::markChanged()
+{
+    _pending = true;
+    if (_updateDepth == 0)
+        this->_queueFlush();
+}
+
+bool ChangeCoalescer::isChangePending() const
+{
+    return _pending;
+}
+
+void ChangeCoalescer::flush()
+{
+    if (!_pending || _updateDepth > 0)
+        return;
+
+    _pending = false;
+    this->changed();
+}
+
+//private slot
+void ChangeCoalescer::handleQueuedFlush()
+{
+    _queued = false;
+    this->flush();
+}
+
+//private
+void ChangeCoalescer::_queueFlush()
+{
+    if (_queued)
+        return;
+
+    _queued = true;
+    QMetaObject::invokeMethod(this, "handleQueuedFlush", Qt::QueuedConnection);
+}
@@ -0,0 +1,75 @@
+#ifndef CHANGECOALESCER_H
+#define CHANGECOALESCER_H
+
+#include <QObject>
+
+/**
+ * @brief The ChangeCoalescer class turns a burst of change notifications into one changed() signal. Dragging a
+ * polygon vertex edits an area dozens of times a second, but whatever listens for changes (planner resets,
+ * editors, the map) only needs to hear about them once.
+ *
+ * markChanged() notes a change, and changed() is emitted once control gets back to the event loop. While an
+ * update is open (see beginUpdate()) it waits until the outermost one ends instead. Any number of changes in
+ * between give one signal.
+ */
+class ChangeCoalescer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ChangeCoalescer(QObject *parent = 0);
+
+    /**
+     * @brief beginUpdate holds changed() back until the matching endUpdate(). Updates nest.
+     */
+    void beginUpdate();
+    void endUpdate();
+    bool isUpdating() const;
+
+    void markChanged();
+    bool isChangePending() const;
+
+    /**
+     * @brief flush emits changed() right away if a change is pending and no update is open, for callers that
+     * can't wait for the event loop
+     */
+    void flush();
+
+signals:
+    void changed();
+
+private slots:
+    void handleQueuedFlush();
+
+private:
+    void _queueFlush();
+
+    int _updateDepth;
+    bool _pending;
+    bool _queued;
+};
+
+/**
+ * @brief The UpdateScope class keeps an update open on target (anything with beginUpdate() and endUpdate(), like
+ * PlanningProblem or FlightTaskArea) for as long as it lives
+ */
+template <typename T>
+class UpdateScope
+{
+public:
+    explicit UpdateScope(T * target) : _target(target)
+    {
+        _target->beginUpdate();
+    }
+
+    ~UpdateScope()
+    {
+        _target->endUpdate();
+    }
+
+private:
+    Q_DISABLE_COPY(UpdateScope)
+
+    T * _target;
+};
+
+#endif // CHANGECOALESCER_H
@@ -0,0 +1,247 @@
+#include "CompiledProblem.h"
+
+#include "PlanningProblem.h"
+#include "FlightTaskArea.h"
+#include "FlightTasks/CoverageTask.h"
+#include "FlightTasks/SamplingTask.h"
+#include "FlightTasks/FlyThroughTask.h"
+#include "FlightTasks/NoFlyFlightTask.h"
+
+CompiledProblem::Changes::Changes() :
+    startChanged(false), uavParametersChanged(false)
+{
+}
+
+bool CompiledProblem::Changes::isEmpty() const
+{
+    return (addedAreas.isEmpty() && changedAreas.isEmpty() && removedAreas.isEmpty()
+            && !startChanged && !uavParametersChanged);
+}
+
+CompiledProblem::CompiledProblem(const PlanningProblem &problem, const CompiledProblem *previous) :
+    _startingPosition(problem.startingPosition()),
+    _startingOrientation(problem.startingOrientation()),
+    _uavParameters(problem.uavParameters()),
+    _version(problem.version())
+{
+    //Areas whose geometry we took from previous, which may not need to go into the local frame again
+    QBitArray sharedGeometry(problem.areas().size());
+
+    //Number the areas and tasks
+    foreach(const QSharedPointer<FlightTaskArea>& sharedArea, problem.areas())
+    {
+        Area area;
+        const int previousId = previous ? previous->areaId(sharedArea.data()) : -1;
+        if (previousId >= 0 && previous->area(previousId).version == sharedArea->version())
+        {
+            //Unchanged since the previous snapshot. Copying shares its polygons and index.
+            area = previous->area(previousId);
+            area.tasks.clear();
+            sharedGeometry.setBit(_areas.size());
+        }
+        else
+        {
+            area.geoPoly = sharedArea->geoPoly();
+            area.boundingRect = area.geoPoly.boundingRect();
+            area.polygonIndex.build(area.geoPoly);
+            area.version = sharedArea->version();
+        }
+
+        foreach(const QSharedPointer<FlightTask>& sharedTask, sharedArea->tasks())
+        {
+            Task task;
+            task.task = sharedTask.data();
+            task.kind = _kindOf(sharedTask.data());
+            task.area = _areas.size();
+            task.timingWindows = sharedTask->timingConstraints().toVector();
+            task.maxPerformance = sharedTask->maxTaskPerformance();
+            task.shortnessRewardApplies = sharedTask->shortnessRewardApplies();
+
+            if (task.kind == NoFlyTaskKind)
+                _obstacles.append(area.geoPoly);
+
+            area.tasks.append(_tasks.size());
+            _taskIds.insert(task.task, _tasks.size());
+            _tasks.append(task);
+            _sharedTasks.append(sharedTask);
+        }
+
+        _areaIds.insert(sharedArea.data(), _areas.size());
+        _areas.append(area);
+        _sharedAreas.append(sharedArea);
+    }
+
+    //One frame for the whole mission, centered so that nothing is far from its reference
+    QRectF missionBounds(_startingPosition.lonLat(), QSizeF(0.0, 0.0));
+    foreach(const Area& area, _areas)
+        missionBounds = missionBounds.united(area.boundingRect);
+    _frame = LocalFrame::around(missionBounds);
+    _localStartingPosition = _frame.toLocal(_startingPosition.lonLat());
+    const bool sameFrame = (previous && previous->frame().reference() == _frame.reference());
+    for (int i = 0; i < _areas.size(); i++)
+    {
+        if (sameFrame && sharedGeometry.testBit(i))
+            continue;
+
+        Area& area = _areas[i];
+        area.localPoly = _frame.toLocal(area.geoPoly);
+        area.localBoundingRect = area.localPoly.boundingRect();
+    }
+
+    //Now that every task has an id we can resolve the dependencies. Ones outside the problem are dropped.
+    for (int i = 0; i < _tasks.size(); i++)
+    {
+        Task& task = _tasks[i];
+        task.dependencyMask.resize(_tasks.size());
+        foreach(const QWeakPointer<FlightTask>& weakDependency, _sharedTasks.at(i)->dependencyConstraints())
+        {
+            const QSharedPointer<FlightTask> dependency = weakDependency.toStrongRef();
+            const int id = _taskIds.value(dependency.data(), -1);
+            if (id < 0 || task.dependencyMask.testBit(id))
+                continue;
+            task.dependencies.append(id);
+            task.dependencyMask.setBit(id);
+        }
+    }
+}
+
+const Position &CompiledProblem::startingPosition() const
+{
+    return _startingPosition;
+}
+
+const UAVOrientation &CompiledProblem::startingOrientation() const
+{
+    return _startingOrientation;
+}
+
+const UAVParameters &CompiledProblem::uavParameters() const
+{
+    return _uavParameters;
+}
+
+quint64 CompiledProblem::version() const
+{
+    return _version;
+}
+
+const LocalFrame &CompiledProblem::frame() const
+{
+    return _frame;
+}
+
+const QPointF &CompiledProblem::localStartingPosition() const
+{
+    return _localStartingPosition;
+}
+
+int CompiledProblem::areaCount() const
+{
+    return _areas.size();
+}
+
+const CompiledProblem::Area &CompiledProblem::area(int id) const
+{
+    return _areas.at(id);
+}
+
+int CompiledProblem::areaId(const FlightTaskArea *area) const
+{
+    return _areaIds.value(area, -1);
+}
+
+int CompiledProblem::taskCount() const
+{
+    return _tasks.size();
+}
+
+const CompiledProblem::Task &CompiledProblem::task(int id) const
+{
+    return _tasks.at(id);
+}
+
+int CompiledProblem::taskId(const FlightTask *task) const
+{
+    return _taskIds.value(task, -1);
+}
+
+const QSharedPointer<FlightTaskArea> &CompiledProblem::sharedArea(int id) const
+{
+    return _sharedAreas.at(id);
+}
+
+const QSharedPointer<FlightTask> &CompiledProblem::sharedTask(int id) const
+{
+    return _sharedTasks.at(id);
+}
+
+const QList<QPolygonF> &CompiledProblem::obstacles() const
+{
+    return _obstacles;
+}
+
+QList<QSharedPointer<FlightTaskScoringState> > CompiledProblem::createScoringStates() const
+{
+    QList<QSharedPointer<FlightTaskScoringState> > toRet;
+    foreach(const Task& task, _tasks)
+        toRet.append(task.task->createScoringState(_areas.at(task.area).geoPoly, _uavParameters));
+    return toRet;
+}
+
+Fitness CompiledProblem::calculateFlightPerformance(const QList<QSharedPointer<FlightTaskScoringState> > &states) const
+{
+    Q_ASSERT(states.size() == _tasks.size());
+
+    qreal taskScore = 0.0;
+    qreal efficiencyScore = 0.0;
+    for (int i = 0; i < states.size(); i++)
+    {
+        const Task& task = _tasks.at(i);
+        const FlightTaskScoringState * state = states.at(i).data();
+        const qreal subScore = state->performance();
+        if (task.shortnessRewardApplies && subScore >= task.maxPerformance)
+            efficiencyScore += subScore / state->positionCount();
+        taskScore += subScore;
+    }
+
+    return Fitness(taskScore, efficiencyScore);
+}
+
+CompiledProblem::Changes CompiledProblem::changesSince(const CompiledProblem &older) const
+{
+    Changes toRet;
+    toRet.startChanged = (older._startingPosition != _startingPosition
+                          || older._startingOrientation != _startingOrientation);
+    toRet.uavParametersChanged = (older._uavParameters != _uavParameters);
+
+    for (int id = 0; id < _areas.size(); id++)
+    {
+        const int olderId = older.areaId(_sharedAreas.at(id).data());
+        if (olderId < 0)
+            toRet.addedAreas.append(id);
+        else if (older._areas.at(olderId).version != _areas.at(id).version)
+            toRet.changedAreas.append(id);
+    }
+
+    for (int olderId = 0; olderId < older._areas.size(); olderId++)
+    {
+        if (this->areaId(older._sharedAreas.at(olderId).data()) < 0)
+            toRet.removedAreas.append(olderId);
+    }
+
+    return toRet;
+}
+
+//private static
+CompiledProblem::TaskKind CompiledProblem::_kindOf(const FlightTask *task)
+{
+    if (qobject_cast<const CoverageTask *>(task))
+        return CoverageTaskKind;
+    else if (qobject_cast<const SamplingTask *>(task))
+        return SamplingTaskKind;
+    else if (qobject_cast<const FlyThroughTask *>(task))
+        return FlyThroughTaskKind;
+    else if (qobject_cast<const NoFlyFlightTask *>(task))
+        return NoFlyTaskKind;
+    return OtherTaskKind;
+}
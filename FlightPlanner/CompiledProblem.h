@@ -0,0 +1,216 @@
+#ifndef COMPILEDPROBLEM_H
+#define COMPILEDPROBLEM_H
+
+#include <QtGlobal>
+#include <QBitArray>
+#include <QHash>
+#include <QList>
+#include <QPolygonF>
+#include <QRectF>
+#include <QSharedPointer>
+#include <QVector>
+
+#include "Position.h"
+#include "UAVOrientation.h"
+#include "UAVParameters.h"
+#include "Fitness.h"
+#include "LocalFrame.h"
+#include "FlightTasks/TimingConstraint.h"
+#include "FlightTasks/FlightTaskScoringState.h"
+#include "FlightTasks/PolygonIndex.h"
+
+class PlanningProblem;
+class FlightTask;
+class FlightTaskArea;
+
+/**
+ * @brief The CompiledProblem class is a flat snapshot of a PlanningProblem for planners to read while planning.
+ *
+ * Areas and tasks are numbered from 0 and refer to each other by number, so planners can keep their own
+ * per-task data in arrays instead of hashing shared pointers. Everything a planner asks about a task in its
+ * inner loops (what kind it is, which tasks it depends on, its timing windows, its best possible score) is
+ * worked out once here.
+ *
+ * Geometry is also kept in a mission-wide LocalFrame (meters east and north of the middle of the mission), so
+ * planners can measure and construct things in meters and only go back to lon/lat for the results.
+ *
+ * Get one from PlanningProblem::compile(). It doesn't follow later edits to the problem, but keeps the
+ * problem's areas and tasks alive. A CompiledProblem is immutable and safe to read from many threads at once.
+ *
+ * Snapshots are copy-on-write. Each one records the version of the problem and of every area it was taken
+ * from, and one compiled with the previous snapshot of the same problem shares the polygons and indices of the
+ * areas that haven't changed since (they're implicitly shared Qt containers, so nothing is copied). Planners can
+ * compare two snapshots with changesSince() to find out what the user edited in between.
+ */
+class CompiledProblem
+{
+public:
+    enum TaskKind
+    {
+        CoverageTaskKind,
+        SamplingTaskKind,
+        FlyThroughTaskKind,
+        NoFlyTaskKind,
+        OtherTaskKind
+    };
+
+    struct Area
+    {
+        QPolygonF geoPoly;
+        QRectF boundingRect;
+        PolygonIndex polygonIndex;
+
+        //geoPoly and its bounds in frame()
+        QPolygonF localPoly;
+        QRectF localBoundingRect;
+
+        //Ids of the area's tasks
+        QVector<int> tasks;
+
+        //FlightTaskArea::version() when we were compiled
+        quint64 version;
+    };
+
+    struct Task
+    {
+        const FlightTask * task;
+        TaskKind kind;
+        int area;
+
+        //Ids of the tasks that have to be finished first, as a list and as a mask over every task id
+        QVector<int> dependencies;
+        QBitArray dependencyMask;
+
+        QVector<TimingConstraint> timingWindows;
+
+        //FlightTask::maxTaskPerformance() and FlightTask::shortnessRewardApplies() at compile time
+        qreal maxPerformance;
+        bool shortnessRewardApplies;
+    };
+
+    /**
+     * @brief The Changes struct is what was edited between two snapshots of the same problem. Areas are matched
+     * by identity, since their ids can differ from one snapshot to the next.
+     */
+    struct Changes
+    {
+        Changes();
+
+        bool isEmpty() const;
+
+        //Ids in the newer snapshot
+        QVector<int> addedAreas;
+        QVector<int> changedAreas;
+
+        //Ids in the older snapshot
+        QVector<int> removedAreas;
+
+        bool startChanged;
+        bool uavParametersChanged;
+    };
+
+    /**
+     * @brief CompiledProblem takes a snapshot of problem.
+     * @param problem
+     * @param previous is an earlier snapshot of the same problem to share unchanged areas with, or null
+     */
+    explicit CompiledProblem(const PlanningProblem& problem, const CompiledProblem * previous = 0);
+
+    /**
+     * @brief version returns PlanningProblem::version() when we were compiled
+     * @return
+     */
+    quint64 version() const;
+
+    const Position& startingPosition() const;
+    const UAVOrientation& startingOrientation() const;
+    const UAVParameters& uavParameters() const;
+
+    /**
+     * @brief frame returns the local frame that every area and the starting position are also given in.
+     * Its reference is the middle of the bounds of all of them.
+     * @return
+     */
+    const LocalFrame& frame() const;
+    const QPointF& localStartingPosition() const;
+
+    int areaCount() const;
+    const Area& area(int id) const;
+
+    /**
+     * @brief areaId returns the id of the given area, or -1 if it wasn't in the problem when we were compiled
+     * @param area
+     * @return
+     */
+    int areaId(const FlightTaskArea * area) const;
+
+    int taskCount() const;
+    const Task& task(int id) const;
+
+    /**
+     * @brief taskId returns the id of the given task, or -1 if it wasn't in the problem when we were compiled.
+     * @param task
+     * @return
+     */
+    int taskId(const FlightTask * task) const;
+
+    /**
+     * @brief sharedArea and sharedTask return the problem's own objects, for the APIs that still take them.
+     * Copying the pointers costs reference counting, so keep them out of inner loops.
+     * @param id
+     * @return
+     */
+    const QSharedPointer<FlightTaskArea>& sharedArea(int id) const;
+    const QSharedPointer<FlightTask>& sharedTask(int id) const;
+
+    /**
+     * @brief obstacles returns the polygon of every area with a no-fly task, once for each such task.
+     * @return
+     */
+    const QList<QPolygonF>& obstacles() const;
+
+    /**
+     * @brief createScoringStates returns an empty incremental scorer for every task, in task id order.
+     * @return
+     */
+    QList<QSharedPointer<FlightTaskScoringState> > createScoringStates() const;
+
+    /**
+     * @brief calculateFlightPerformance is PlanningProblem::calculateFlightPerformance() for states from
+     * createScoringStates(), using the per-task values we precomputed instead of asking every task.
+     * @param states
+     * @return
+     */
+    Fitness calculateFlightPerformance(const QList<QSharedPointer<FlightTaskScoringState> >& states) const;
+
+    /**
+     * @brief changesSince returns what changed between older and us, both snapshots of the same problem. It
+     * only compares versions, so it costs a hash lookup per area.
+     * @param older
+     * @return
+     */
+    Changes changesSince(const CompiledProblem& older) const;
+
+private:
+    static TaskKind _kindOf(const FlightTask * task);
+
+    Position _startingPosition;
+    UAVOrientation _startingOrientation;
+    UAVParameters _uavParameters;
+    quint64 _version;
+
+    LocalFrame _frame;
+    QPointF _localStartingPosition;
+
+    QVector<Area> _areas;
+    QVector<Task> _tasks;
+    QHash<const FlightTaskArea *, int> _areaIds;
+    QHash<const FlightTask *, int> _taskIds;
+
+    QList<QSharedPointer<FlightTaskArea> > _sharedAreas;
+    QList<QSharedPointer<FlightTask> > _sharedTasks;
+
+    QList<QPolygonF> _obstacles;
+};
+
+#endif // COMPILEDPROBLEM_H
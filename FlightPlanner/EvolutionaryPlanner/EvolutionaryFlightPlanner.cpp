@@ -0,0 +1,354 @@
+#include "EvolutionaryFlightPlanner.h"
+
+#include <QPolygonF>
+#include <algorithm>
+#include <cmath>
+
+#include "BatchFitnessEvaluator.h"
+#include "CompiledProblem.h"
+
+//Genomes that survive each generation unchanged, per island
+const int ELITE_COUNT = 2;
+
+//Genomes drawn for each tournament. The fittest of them becomes a parent.
+const int TOURNAMENT_SIZE = 3;
+
+//Chance that a child is bred by crossover rather than copied from one parent
+const qreal CROSSOVER_RATE = 0.9;
+
+//Chance that each gene of a child is mutated
+const qreal MUTATION_RATE = 0.05;
+
+//Islands swap their best genomes every this many generations...
+const int MIGRATION_INTERVAL = 10;
+
+//...this many at a time
+const int MIGRANT_COUNT = 2;
+
+//The 1/5th success rule's step size factor and the step sizes it's kept between
+const qreal SIGMA_FACTOR = 1.22;
+const qreal MIN_SIGMA = 0.02;
+const qreal MAX_SIGMA = 1.0;
+
+const qreal PI = 3.1415926535897932384626433;
+
+//non-member
+//The flight a genome describes, given how many of its genes to fly, starting with the starting position
+static QList<Position> decodeFlight(const CompiledProblem * problem, const QVector<qreal>& genes, int length)
+{
+    const qreal interval = problem->uavParameters().waypointInterval();
+    QPointF pos = problem->localStartingPosition();
+    qreal heading = problem->startingOrientation().radians();
+
+    QPolygonF localFlight;
+    localFlight.reserve(length + 1);
+    localFlight.append(pos);
+    for (int i = 0; i < length; i++)
+    {
+        heading += genes.at(i);
+        pos += QPointF(cos(heading), sin(heading)) * interval;
+        localFlight.append(pos);
+    }
+
+    //Converted in one batch rather than waypoint by waypoint
+    const QPolygonF geoFlight = problem->frame().toGeo(localFlight);
+    const qreal altitude = problem->startingPosition().altitude();
+    QList<Position> toRet;
+    toRet.reserve(geoFlight.size());
+    foreach(const QPointF& lonLat, geoFlight)
+        toRet.append(Position(lonLat, altitude));
+    return toRet;
+}
+
+//non-member
+//Standard normal, by Box-Muller
+static qreal gaussian(PlanningRandom * random)
+{
+    const qreal u1 = qMax<qreal>(random->uniform(), 1e-12);
+    const qreal u2 = random->uniform();
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * PI * u2);
+}
+
+EvolutionaryFlightPlanner::EvolutionaryFlightPlanner(QSharedPointer<PlanningProblem> prob, QObject *parent) :
+    FlightPlanner(prob, parent), _generation(0), _workerCount(0), _islandCount(4), _populationSize(32),
+    _genomeLength(200)
+{
+}
+
+EvolutionaryFlightPlanner::~EvolutionaryFlightPlanner()
+{
+    this->finishPlanningThread();
+}
+
+int EvolutionaryFlightPlanner::workerCount() const
+{
+    return _workerCount;
+}
+
+void EvolutionaryFlightPlanner::setWorkerCount(int count)
+{
+    _workerCount = qMax<int>(0, count);
+}
+
+int EvolutionaryFlightPlanner::islandCount() const
+{
+    return _islandCount;
+}
+
+void EvolutionaryFlightPlanner::setIslandCount(int count)
+{
+    _islandCount = qMax<int>(1, count);
+}
+
+int EvolutionaryFlightPlanner::populationSize() const
+{
+    return _populationSize;
+}
+
+void EvolutionaryFlightPlanner::setPopulationSize(int size)
+{
+    //Room for the elite and at least as many children
+    _populationSize = qMax<int>(2 * ELITE_COUNT, size);
+}
+
+int EvolutionaryFlightPlanner::genomeLength() const
+{
+    return _genomeLength;
+}
+
+void EvolutionaryFlightPlanner::setGenomeLength(int length)
+{
+    _genomeLength = qMax<int>(1, length);
+}
+
+//protected
+//pure-virtual from FlightPlanner
+void EvolutionaryFlightPlanner::doStart()
+{
+    _compiled = this->problem()->compile();
+    _evaluator.reset(new BatchFitnessEvaluator(_compiled));
+
+    //Populations survive pauses, and are only started over on reset
+    if (_islands.isEmpty())
+        _initializeIslands();
+}
+
+//protected
+//pure-virtual from FlightPlanner
+void EvolutionaryFlightPlanner::doIteration()
+{
+    //Breed every island's next generation, then score all of the children at once
+    QList<QList<Individual> > nextPopulations;
+    for (int i = 0; i < _islands.size(); i++)
+    {
+        Island& island = _islands[i];
+        QList<Individual> next;
+        for (int j = 0; j < ELITE_COUNT && j < island.population.size(); j++)
+            next.append(island.population.at(j));
+        while (next.size() < _populationSize)
+            next.append(_breed(&island));
+        nextPopulations.append(next);
+    }
+
+    QList<Individual *> children;
+    for (int i = 0; i < nextPopulations.size(); i++)
+    {
+        for (int j = ELITE_COUNT; j < nextPopulations.at(i).size(); j++)
+            children.append(&nextPopulations[i][j]);
+    }
+    _evaluate(children);
+
+    for (int i = 0; i < _islands.size(); i++)
+    {
+        Island& island = _islands[i];
+        island.population = nextPopulations.at(i);
+
+        //1/5th success rule: bigger steps while they keep paying off, smaller ones once they don't
+        int successes = 0;
+        for (int j = ELITE_COUNT; j < island.population.size(); j++)
+        {
+            const Individual& child = island.population.at(j);
+            if (child.fitness > child.parentFitness)
+                successes++;
+        }
+        const int childCount = island.population.size() - ELITE_COUNT;
+        if (5 * successes > childCount)
+            island.sigma = qMin<qreal>(MAX_SIGMA, island.sigma * SIGMA_FACTOR);
+        else
+            island.sigma = qMax<qreal>(MIN_SIGMA, island.sigma / SIGMA_FACTOR);
+
+        std::stable_sort(island.population.begin(), island.population.end(), _fitterFirst);
+    }
+
+    _generation++;
+    if (_islands.size() > 1 && _generation % MIGRATION_INTERVAL == 0)
+        _migrate();
+
+    _publishBest();
+
+    this->workingStatistics()->addToCounter("Generations");
+    this->workingStatistics()->addToCounter("FitnessEvaluations", children.size());
+    this->planningContext()->chargeNodes(children.size());
+}
+
+//protected
+//pure-virtual from FlightPlanner
+void EvolutionaryFlightPlanner::doReset()
+{
+    _islands.clear();
+    _generation = 0;
+    _evaluator.reset();
+    _compiled.clear();
+}
+
+//private
+void EvolutionaryFlightPlanner::_initializeIslands()
+{
+    const qreal maxTurn = _maxTurn();
+
+    QList<Individual *> individuals;
+    for (int i = 0; i < _islandCount; i++)
+    {
+        Island island;
+        island.random.seed(this->randomSeed(), i);
+        island.sigma = 0.3;
+
+        //Random but smooth: turns drift rather than jump, so the first flights aren't all tight circles
+        for (int j = 0; j < _populationSize; j++)
+        {
+            Individual individual;
+            individual.genes.resize(_genomeLength);
+            individual.length = 0;
+            qreal turn = 0.0;
+            for (int k = 0; k < _genomeLength; k++)
+            {
+                turn = qBound<qreal>(-maxTurn, turn + 0.25 * maxTurn * gaussian(&island.random), maxTurn);
+                individual.genes[k] = turn;
+            }
+            island.population.append(individual);
+        }
+        _islands.append(island);
+    }
+
+    for (int i = 0; i < _islands.size(); i++)
+    {
+        for (int j = 0; j < _islands.at(i).population.size(); j++)
+            individuals.append(&_islands[i].population[j]);
+    }
+    _evaluate(individuals);
+
+    for (int i = 0; i < _islands.size(); i++)
+        std::stable_sort(_islands[i].population.begin(), _islands[i].population.end(), _fitterFirst);
+    _publishBest();
+}
+
+//private
+EvolutionaryFlightPlanner::Individual EvolutionaryFlightPlanner::_breed(Island *island) const
+{
+    const qreal maxTurn = _maxTurn();
+    const Individual& mother = _tournament(island);
+
+    Individual toRet = mother;
+    toRet.parentFitness = mother.fitness;
+    if (island->random.uniform() < CROSSOVER_RATE)
+    {
+        const Individual& father = _tournament(island);
+        const int cut = island->random.bounded(toRet.genes.size());
+        for (int i = cut; i < toRet.genes.size(); i++)
+            toRet.genes[i] = father.genes.at(i);
+        if (father.fitness > toRet.parentFitness)
+            toRet.parentFitness = father.fitness;
+    }
+
+    for (int i = 0; i < toRet.genes.size(); i++)
+    {
+        if (island->random.uniform() >= MUTATION_RATE)
+            continue;
+        const qreal gene = toRet.genes.at(i) + island->sigma * maxTurn * gaussian(&island->random);
+        toRet.genes[i] = qBound<qreal>(-maxTurn, gene, maxTurn);
+    }
+    return toRet;
+}
+
+//private
+const EvolutionaryFlightPlanner::Individual &EvolutionaryFlightPlanner::_tournament(Island *island) const
+{
+    //Populations are sorted fittest first, so the lowest index drawn wins
+    int best = island->random.bounded(island->population.size());
+    for (int i = 1; i < TOURNAMENT_SIZE; i++)
+        best = qMin<int>(best, island->random.bounded(island->population.size()));
+    return island->population.at(best);
+}
+
+//private
+void EvolutionaryFlightPlanner::_evaluate(const QList<Individual *> &individuals)
+{
+    if (individuals.isEmpty())
+        return;
+
+    QList<QList<Position> > flights;
+    foreach(const Individual * individual, individuals)
+        flights.append(decodeFlight(_compiled.data(), individual->genes, individual->genes.size()));
+
+    const quint64 gpuFlights = _evaluator->gpuFlights();
+    QVector<Fitness> fitnesses;
+    QVector<int> lengths;
+    _evaluator->setWorkerCount(_workerCount);
+    _evaluator->evaluate(flights, &fitnesses, &lengths);
+    this->workingStatistics()->addToCounter("GpuFitnessEvaluations", _evaluator->gpuFlights() - gpuFlights);
+
+    for (int i = 0; i < individuals.size(); i++)
+    {
+        individuals.at(i)->fitness = fitnesses.at(i);
+        individuals.at(i)->length = lengths.at(i);
+    }
+}
+
+//private
+void EvolutionaryFlightPlanner::_migrate()
+{
+    //Ring topology: each island's best replace the next island's worst
+    QList<QList<Individual> > migrants;
+    foreach(const Island& island, _islands)
+        migrants.append(island.population.mid(0, MIGRANT_COUNT));
+
+    for (int i = 0; i < _islands.size(); i++)
+    {
+        QList<Individual>& population = _islands[(i + 1) % _islands.size()].population;
+        for (int j = 0; j < migrants.at(i).size() && j < population.size(); j++)
+            population[population.size() - 1 - j] = migrants.at(i).at(j);
+        std::stable_sort(population.begin(), population.end(), _fitterFirst);
+    }
+    this->workingStatistics()->addToCounter("Migrations");
+}
+
+//private
+void EvolutionaryFlightPlanner::_publishBest()
+{
+    const Individual * best = 0;
+    foreach(const Island& island, _islands)
+    {
+        if (!island.population.isEmpty() && (best == 0 || island.population.first().fitness > best->fitness))
+            best = &island.population.first();
+    }
+    if (best == 0 || !(best->fitness > this->bestFitnessSoFar()))
+        return;
+
+    //A flight that strays from the committed prefix isn't taken, so neither is its fitness
+    if (this->setBestFlightSoFar(decodeFlight(_compiled.data(), best->genes, best->length)))
+        this->setBestFitnessSoFar(best->fitness);
+}
+
+//private
+qreal EvolutionaryFlightPlanner::_maxTurn() const
+{
+    //The heading change of an arc one waypoint interval long on the tightest circle we can fly
+    const UAVParameters& params = _compiled->uavParameters();
+    return qMin<qreal>(PI, params.waypointInterval() / qMax<qreal>(1.0, params.minTurningRadius()));
+}
+
+//private static
+bool EvolutionaryFlightPlanner::_fitterFirst(const Individual &a, const Individual &b)
+{
+    return a.fitness > b.fitness;
+}
@@ -0,0 +1,124 @@
+#ifndef EVOLUTIONARYFLIGHTPLANNER_H
+#define EVOLUTIONARYFLIGHTPLANNER_H
+
+#include "FlightPlanner.h"
+#include "PlanningRandom.h"
+
+#include <QList>
+#include <QScopedPointer>
+#include <QSharedPointer>
+#include <QVector>
+
+class BatchFitnessEvaluator;
+class CompiledProblem;
+
+/**
+ * @brief The EvolutionaryFlightPlanner class evolves flights with a genetic algorithm on several islands.
+ *
+ * A flight's genome is the turn it makes at each waypoint, never sharper than the UAV's minimum turning radius
+ * allows, so every flight it can produce is flyable. A genome is scored as the best of its flights' prefixes
+ * and stands for that prefix, so flights can be as short as the tasks allow.
+ *
+ * Each iteration is one generation on every island: the fittest few survive unchanged (elitism), and the rest
+ * are bred by tournament selection, one-point crossover and Gaussian mutation. Each island adapts its mutation
+ * step size with the 1/5th success rule. Every few generations each island's best genomes migrate to the next
+ * island in a ring, replacing its worst. The children of all islands are scored at once by a
+ * BatchFitnessEvaluator, on the GPU if PlanningCore was built with one and on workerCount() threads if not.
+ */
+class EvolutionaryFlightPlanner : public FlightPlanner
+{
+    Q_OBJECT
+public:
+    explicit EvolutionaryFlightPlanner(QSharedPointer<PlanningProblem> prob = QSharedPointer<PlanningProblem>(),
+                                       QObject *parent = 0);
+    virtual ~EvolutionaryFlightPlanner();
+
+    /**
+     * @brief workerCount returns the number of slices children are split into to be scored in parallel when
+     * they're scored on the CPU, on JobSystem::shared(). 0 (the default) means "use QThread::idealThreadCount()".
+     * The flights found are the same either way.
+     * @return
+     */
+    int workerCount() const;
+    void setWorkerCount(int count);
+
+    /**
+     * @brief islandCount returns how many populations evolve side by side. Like populationSize() and
+     * genomeLength(), changes take effect when planning is next reset. Defaults to 4.
+     * @return
+     */
+    int islandCount() const;
+    void setIslandCount(int count);
+
+    /**
+     * @brief populationSize returns how many genomes each island holds. Defaults to 32.
+     * @return
+     */
+    int populationSize() const;
+    void setPopulationSize(int size);
+
+    /**
+     * @brief genomeLength returns the most waypoints a flight may have after the starting position.
+     * Defaults to 200.
+     * @return
+     */
+    int genomeLength() const;
+    void setGenomeLength(int length);
+
+protected:
+    //pure-virtual from FlightPlanner
+    virtual void doStart();
+
+    //pure-virtual from FlightPlanner
+    virtual void doIteration();
+
+    //pure-virtual from FlightPlanner
+    virtual void doReset();
+
+private:
+    struct Individual
+    {
+        //Turn (in radians) at each waypoint
+        QVector<qreal> genes;
+
+        //Of the best prefix, and how many genes that prefix uses
+        Fitness fitness;
+        int length;
+
+        //The fitter parent's, for step size adaptation
+        Fitness parentFitness;
+    };
+
+    struct Island
+    {
+        QList<Individual> population;
+        PlanningRandom random;
+
+        //Mutation step size, as a fraction of the sharpest turn allowed
+        qreal sigma;
+    };
+
+    void _initializeIslands();
+    Individual _breed(Island * island) const;
+    const Individual& _tournament(Island * island) const;
+    void _evaluate(const QList<Individual *>& individuals);
+    void _migrate();
+    void _publishBest();
+    qreal _maxTurn() const;
+
+    static bool _fitterFirst(const Individual& a, const Individual& b);
+
+    //The problem as of doStart()
+    QSharedPointer<const CompiledProblem> _compiled;
+    QScopedPointer<BatchFitnessEvaluator> _evaluator;
+
+    QList<Island> _islands;
+    quint32 _generation;
+
+    int _workerCount;
+    int _islandCount;
+    int _populationSize;
+    int _genomeLength;
+};
+
+#endif // EVOLUTIONARYFLIGHTPLANNER_H
@@ -0,0 +1,68 @@
+#include "BinaryExporter.h"
+
+#include "BinaryFlightPathFormat.h"
+
+#include <QBuffer>
+#include <QIODevice>
+
+//Records are encoded this many at a time before being written
+const int RECORDS_PER_WRITE = 4096;
+
+BinaryExporter::BinaryExporter(const QList<Position> &solution, const UAVParameters &params) :
+    Exporter(solution), _params(params)
+{
+}
+
+//pure-virtual from Exporter
+bool BinaryExporter::doExport(QByteArray *output)
+{
+    QBuffer buffer(output);
+    buffer.open(QIODevice::WriteOnly);
+    return this->doExport(&buffer);
+}
+
+//virtual from Exporter
+bool BinaryExporter::doExport(QIODevice *output, QString *errorString)
+{
+    const QList<Position>& solution = this->solution();
+    QByteArray chunk(RECORDS_PER_WRITE * BinaryFlightPathFormat::RECORD_SIZE, 0);
+    uchar * const records = (uchar *) chunk.data();
+
+    //The checksum goes in the header, so encode once to compute it and again to write the records
+    quint32 checksum = 0;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        if (pass == 1)
+        {
+            uchar header[BinaryFlightPathFormat::HEADER_SIZE];
+            BinaryFlightPathFormat::encodeHeader(header, solution.size(), _params, checksum);
+            if (output->write((const char *) header, sizeof(header)) != (qint64) sizeof(header))
+            {
+                if (errorString)
+                    *errorString = "Failed to write header: " + output->errorString();
+                return false;
+            }
+        }
+
+        BinaryFlightPathFormat::FixedPoint previous = {0, 0, 0};
+        for (int start = 0; start < solution.size(); start += RECORDS_PER_WRITE)
+        {
+            const int count = qMin<int>(RECORDS_PER_WRITE, solution.size() - start);
+            for (int i = 0; i < count; i++)
+                BinaryFlightPathFormat::encodeRecord(records + i * BinaryFlightPathFormat::RECORD_SIZE,
+                                                     BinaryFlightPathFormat::toFixed(solution.at(start + i)),
+                                                     &previous);
+
+            const qint64 bytes = (qint64) count * BinaryFlightPathFormat::RECORD_SIZE;
+            if (pass == 0)
+                checksum = BinaryFlightPathFormat::crc32(records, bytes, checksum);
+            else if (output->write((const char *) records, bytes) != bytes)
+            {
+                if (errorString)
+                    *errorString = "Failed to write points: " + output->errorString();
+                return false;
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,26 @@
+#ifndef BINARYEXPORTER_H
+#define BINARYEXPORTER_H
+
+#include "Exporter.h"
+#include "UAVParameters.h"
+
+/**
+ * @brief The BinaryExporter class writes a solution as a compact .fpath file (see BinaryFlightPathFormat),
+ * along with the UAV parameters it was planned for.
+ */
+class BinaryExporter : public Exporter
+{
+public:
+    BinaryExporter(const QList<Position>& solution, const UAVParameters& params);
+
+    //pure-virtual from Exporter
+    virtual bool doExport(QByteArray * output);
+
+    //virtual from Exporter
+    virtual bool doExport(QIODevice * output, QString * errorString = 0);
+
+private:
+    UAVParameters _params;
+};
+
+#endif // BINARYEXPORTER_H
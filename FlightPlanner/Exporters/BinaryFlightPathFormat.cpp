@@ -0,0 +1,133 @@
+#include "BinaryFlightPathFormat.h"
+
+#include <QtEndian>
+#include <cstring>
+
+const double DEGREE_SCALE = 1.0e7;
+const double ALTITUDE_SCALE = 1000.0;
+
+//non-member
+void writeDouble(uchar * dest, double value)
+{
+    quint64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    qToLittleEndian<quint64>(bits, dest);
+}
+
+//non-member
+double readDouble(const uchar * src)
+{
+    const quint64 bits = qFromLittleEndian<quint64>(src);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+//static
+BinaryFlightPathFormat::FixedPoint BinaryFlightPathFormat::toFixed(const Position &pos)
+{
+    FixedPoint toRet;
+    toRet.longitude = qRound(pos.longitude() * DEGREE_SCALE);
+    toRet.latitude = qRound(pos.latitude() * DEGREE_SCALE);
+    toRet.altitude = qRound(pos.altitude() * ALTITUDE_SCALE);
+    return toRet;
+}
+
+//static
+Position BinaryFlightPathFormat::fromFixed(const FixedPoint &point)
+{
+    return Position(point.longitude / DEGREE_SCALE,
+                    point.latitude / DEGREE_SCALE,
+                    point.altitude / ALTITUDE_SCALE);
+}
+
+//static
+void BinaryFlightPathFormat::encodeRecord(uchar *dest, const FixedPoint &point, FixedPoint *previous)
+{
+    //Unsigned so that the difference wraps instead of overflowing
+    qToLittleEndian<quint32>((quint32)point.longitude - (quint32)previous->longitude, dest);
+    qToLittleEndian<quint32>((quint32)point.latitude - (quint32)previous->latitude, dest + 4);
+    qToLittleEndian<quint32>((quint32)point.altitude - (quint32)previous->altitude, dest + 8);
+    *previous = point;
+}
+
+//static
+void BinaryFlightPathFormat::decodeRecord(const uchar *src, FixedPoint *previous)
+{
+    previous->longitude = (qint32)((quint32)previous->longitude + qFromLittleEndian<quint32>(src));
+    previous->latitude = (qint32)((quint32)previous->latitude + qFromLittleEndian<quint32>(src + 4));
+    previous->altitude = (qint32)((quint32)previous->altitude + qFromLittleEndian<quint32>(src + 8));
+}
+
+//static
+void BinaryFlightPathFormat::encodeHeader(uchar *dest, quint32 pointCount, const UAVParameters &params,
+                                          quint32 checksum)
+{
+    memcpy(dest, "FPTH", 4);
+    qToLittleEndian<quint16>(VERSION, dest + 4);
+    qToLittleEndian<quint16>(HEADER_SIZE, dest + 6);
+    qToLittleEndian<quint32>(pointCount, dest + 8);
+    qToLittleEndian<quint32>(0, dest + 12);
+    writeDouble(dest + 16, params.airspeed());
+    writeDouble(dest + 24, params.minTurningRadius());
+    writeDouble(dest + 32, params.waypointInterval());
+    qToLittleEndian<quint32>(checksum, dest + 40);
+    qToLittleEndian<quint32>(0, dest + 44);
+}
+
+//static
+bool BinaryFlightPathFormat::decodeHeader(const uchar *src, qint64 size,
+                                          quint32 *pointCount, UAVParameters *params, quint32 *checksum,
+                                          QString *errorString)
+{
+    if (size < HEADER_SIZE || memcmp(src, "FPTH", 4) != 0)
+    {
+        if (errorString)
+            *errorString = "Not a binary flight path file";
+        return false;
+    }
+
+    const quint16 version = qFromLittleEndian<quint16>(src + 4);
+    const quint16 headerSize = qFromLittleEndian<quint16>(src + 6);
+    if (version != VERSION || headerSize != HEADER_SIZE)
+    {
+        if (errorString)
+            *errorString = QString("Unsupported binary flight path version %1").arg(version);
+        return false;
+    }
+
+    *pointCount = qFromLittleEndian<quint32>(src + 8);
+    if (size - HEADER_SIZE < (qint64)*pointCount * RECORD_SIZE)
+    {
+        if (errorString)
+            *errorString = "Binary flight path file is truncated";
+        return false;
+    }
+
+    *params = UAVParameters(readDouble(src + 16), readDouble(src + 24), readDouble(src + 32));
+    *checksum = qFromLittleEndian<quint32>(src + 40);
+    return true;
+}
+
+//static
+quint32 BinaryFlightPathFormat::crc32(const uchar *data, qint64 length, quint32 crc)
+{
+    static quint32 table[256];
+    static bool tableReady = false;
+    if (!tableReady)
+    {
+        for (quint32 i = 0; i < 256; i++)
+        {
+            quint32 c = i;
+            for (int bit = 0; bit < 8; bit++)
+                c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+            table[i] = c;
+        }
+        tableReady = true;
+    }
+
+    crc = ~crc;
+    for (qint64 i = 0; i < length; i++)
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
@@ -0,0 +1,70 @@
+#ifndef BINARYFLIGHTPATHFORMAT_H
+#define BINARYFLIGHTPATHFORMAT_H
+
+#include <QtGlobal>
+#include <QString>
+
+#include "Position.h"
+#include "UAVParameters.h"
+
+/**
+ * @brief The BinaryFlightPathFormat class describes the .fpath files written by BinaryExporter and read
+ * by BinaryImporter. It is about ten times smaller than GPX and needs no parsing.
+ *
+ * A file is a HEADER_SIZE byte header followed by pointCount RECORD_SIZE byte records, all little-endian:
+ *
+ *   header:  "FPTH", quint16 version, quint16 header size, quint32 point count, quint32 flags (zero),
+ *            float64 airspeed, float64 min turning radius, float64 waypoint interval,
+ *            quint32 CRC-32 of the records, quint32 reserved (zero)
+ *   record:  qint32 longitude, qint32 latitude, qint32 altitude
+ *
+ * Longitude and latitude are in units of 1e-7 degrees and altitude in millimeters. Each record holds the
+ * difference from the previous point (modulo 2^32), the first one from zero.
+ */
+class BinaryFlightPathFormat
+{
+public:
+    static const int HEADER_SIZE = 48;
+    static const int RECORD_SIZE = 12;
+    static const quint16 VERSION = 1;
+
+    //A point in the file's fixed-point units
+    struct FixedPoint
+    {
+        qint32 longitude;
+        qint32 latitude;
+        qint32 altitude;
+    };
+
+    static FixedPoint toFixed(const Position& pos);
+    static Position fromFixed(const FixedPoint& point);
+
+    /**
+     * @brief encodeRecord writes the record for point to dest and makes point the new previous
+     */
+    static void encodeRecord(uchar * dest, const FixedPoint& point, FixedPoint * previous);
+
+    /**
+     * @brief decodeRecord adds the record at src to previous, which then holds the decoded point
+     */
+    static void decodeRecord(const uchar * src, FixedPoint * previous);
+
+    static void encodeHeader(uchar * dest, quint32 pointCount, const UAVParameters& params,
+                             quint32 checksum);
+
+    /**
+     * @brief decodeHeader reads the header at the start of the size bytes at src and checks that the
+     * records it announces are all there. Returns true on success, false on failure with an explanation in
+     * errorString.
+     */
+    static bool decodeHeader(const uchar * src, qint64 size,
+                             quint32 * pointCount, UAVParameters * params, quint32 * checksum,
+                             QString * errorString = 0);
+
+    /**
+     * @brief crc32 continues the CRC-32 (as used by zlib) crc over length bytes at data. Start with zero.
+     */
+    static quint32 crc32(const uchar * data, qint64 length, quint32 crc = 0);
+};
+
+#endif // BINARYFLIGHTPATHFORMAT_H
@@ -1,5 +1,7 @@
 #include "Exporter.h"
 
+#include <QIODevice>
+
 Exporter::Exporter(const QList<Position> &solution) : _solution(solution)
 {
 }
@@ -12,3 +14,22 @@ const QList<Position> &Exporter::solution() const
 {
     return _solution;
 }
+
+bool Exporter::doExport(QIODevice *output, QString *errorString)
+{
+    QByteArray bytes;
+    if (!this->doExport(&bytes))
+    {
+        if (errorString)
+            *errorString = "Unable to export due to unknown error.";
+        return false;
+    }
+
+    if (output->write(bytes) != bytes.size())
+    {
+        if (errorString)
+            *errorString = "Failed to write all bytes: " + output->errorString();
+        return false;
+    }
+    return true;
+}
@@ -2,8 +2,12 @@
 #define EXPORTER_H
 
 #include <QList>
+#include <QByteArray>
+#include <QString>
 #include "Position.h"
 
+class QIODevice;
+
 class Exporter
 {
 public:
@@ -14,6 +18,13 @@ public:
 
     virtual bool doExport(QByteArray * output)=0;
 
+    /**
+     * @brief doExport writes the solution to output, which must be open for writing. Returns true on success,
+     * false on failure with an explanation in errorString. The default implementation exports to a
+     * QByteArray and writes that; exporters that can stream should reimplement it.
+     */
+    virtual bool doExport(QIODevice * output, QString * errorString = 0);
+
 private:
     QList<Position> _solution;
 };
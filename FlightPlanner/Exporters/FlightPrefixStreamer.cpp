@@ -0,0 +1,160 @@
+#include "FlightPrefixStreamer.h"
+
+#include <QFileDevice>
+#include <QIODevice>
+
+#include "GPXStreamWriter.h"
+
+//The best flight is checked this many times per settle time
+const int SETTLE_CHECKS = 4;
+
+FlightPrefixStreamer::FlightPrefixStreamer(FlightPlanner *planner, QIODevice *sink, QObject *parent) :
+    QObject(parent), _planner(planner), _sink(sink), _writer(0), _settleTime(2000), _minimumCommit(10)
+{
+    connect(&_settleTimer,
+            SIGNAL(timeout()),
+            this,
+            SLOT(handleSettleTimer()));
+}
+
+FlightPrefixStreamer::~FlightPrefixStreamer()
+{
+    delete _writer;
+}
+
+qint64 FlightPrefixStreamer::settleTime() const
+{
+    return _settleTime;
+}
+
+void FlightPrefixStreamer::setSettleTime(qint64 msecs)
+{
+    _settleTime = qMax<qint64>(0, msecs);
+}
+
+int FlightPrefixStreamer::minimumCommit() const
+{
+    return _minimumCommit;
+}
+
+void FlightPrefixStreamer::setMinimumCommit(int waypoints)
+{
+    _minimumCommit = qMax<int>(1, waypoints);
+}
+
+bool FlightPrefixStreamer::start(QString *errorString)
+{
+    if (_planner.isNull())
+    {
+        if (errorString)
+            *errorString = "Can't stream without a planner";
+        return false;
+    }
+
+    delete _writer;
+    _writer = new GPXStreamWriter(_sink);
+    if (!_writer->begin(errorString))
+    {
+        delete _writer;
+        _writer = 0;
+        return false;
+    }
+
+    _committed.clear();
+    _planner->setCommittedPrefix(_committed);
+    _flight.clear();
+    _stableSince.clear();
+    _clock.start();
+
+    connect(_planner.data(),
+            SIGNAL(bestFlightSoFarChanged(QList<Position>)),
+            this,
+            SLOT(handleBestFlightChanged(QList<Position>)),
+            Qt::UniqueConnection);
+    this->handleBestFlightChanged(_planner->bestFlightSoFar());
+    _settleTimer.start(qMax<qint64>(1, _settleTime / SETTLE_CHECKS));
+    return true;
+}
+
+bool FlightPrefixStreamer::finish(QString *errorString)
+{
+    if (!_writer)
+    {
+        if (errorString)
+            *errorString = "The stream was never started";
+        return false;
+    }
+
+    _settleTimer.stop();
+    if (!_planner.isNull())
+    {
+        disconnect(_planner.data(),
+                   SIGNAL(bestFlightSoFarChanged(QList<Position>)),
+                   this,
+                   SLOT(handleBestFlightChanged(QList<Position>)));
+        _flight = _planner->bestFlightSoFar();
+    }
+    _commit(_flight.size());
+
+    const bool toRet = _writer->end(errorString);
+    delete _writer;
+    _writer = 0;
+    return toRet;
+}
+
+int FlightPrefixStreamer::committedCount() const
+{
+    return _committed.size();
+}
+
+//private slot
+void FlightPrefixStreamer::handleBestFlightChanged(const QList<Position> &flight)
+{
+    //Waypoints the new flight shares with the last one keep their age. The rest are new as of now.
+    int same = 0;
+    const int shorter = qMin<int>(flight.size(), _flight.size());
+    while (same < shorter && flight.at(same) == _flight.at(same))
+        same++;
+
+    _stableSince.resize(same);
+    _stableSince.insert(same, flight.size() - same, _clock.elapsed());
+    _flight = flight;
+}
+
+//private slot
+void FlightPrefixStreamer::handleSettleTimer()
+{
+    const qint64 settledBefore = _clock.elapsed() - _settleTime;
+    int settled = _committed.size();
+    while (settled < _stableSince.size() && _stableSince.at(settled) <= settledBefore)
+        settled++;
+
+    if (settled - _committed.size() >= _minimumCommit)
+        _commit(settled);
+}
+
+//private
+void FlightPrefixStreamer::_commit(int count)
+{
+    //The planner only accepts flights that start with what we've committed, so the flight can't disagree with it
+    if (!_writer || count <= _committed.size() || count > _flight.size())
+        return;
+
+    const int first = _committed.size();
+    _committed = _flight.mid(0, count);
+    if (!_planner.isNull())
+        _planner->setCommittedPrefix(_committed);
+
+    for (int i = first; i < count; i++)
+    {
+        const Position& pos = _committed.at(i);
+        _writer->writePoint(pos.longitude(), pos.latitude(), pos.altitude());
+    }
+
+    //Files buffer their writes. Whatever's committed should reach the disk (and whoever's reading it) now.
+    QFileDevice * file = qobject_cast<QFileDevice *>(_sink);
+    if (file)
+        file->flush();
+
+    this->prefixCommitted(_committed.size());
+}
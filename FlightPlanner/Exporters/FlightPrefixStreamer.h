@@ -0,0 +1,87 @@
+#ifndef FLIGHTPREFIXSTREAMER_H
+#define FLIGHTPREFIXSTREAMER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QList>
+#include <QPointer>
+#include <QString>
+#include <QTimer>
+#include <QVector>
+
+#include "FlightPlanner.h"
+#include "Position.h"
+
+class GPXStreamWriter;
+class QIODevice;
+
+/**
+ * @brief The FlightPrefixStreamer class hands the start of a flight to a sink (a file, or a socket to the uplink)
+ * while the planner is still improving the rest of it, so the aircraft can set off before planning is done.
+ *
+ * It watches the planner's best flight. Once the leading waypoints have stayed the same for settleTime() and
+ * there are at least minimumCommit() new ones, they're committed: pinned with FlightPlanner::setCommittedPrefix()
+ * so that no later best flight can change them, and written to the sink as GPX track points. finish() commits
+ * whatever the best flight has left and closes the document.
+ *
+ * Lives on the planner's (usually the GUI) thread. The sink must stay open until finish().
+ */
+class FlightPrefixStreamer : public QObject
+{
+    Q_OBJECT
+public:
+    FlightPrefixStreamer(FlightPlanner * planner, QIODevice * sink, QObject *parent = 0);
+    virtual ~FlightPrefixStreamer();
+
+    qint64 settleTime() const;
+    void setSettleTime(qint64 msecs);
+
+    int minimumCommit() const;
+    void setMinimumCommit(int waypoints);
+
+    /**
+     * @brief start begins the GPX document and starts watching the planner. Anything the planner had committed
+     * before is forgotten, so start before planning. Returns false with an explanation in errorString if the
+     * sink can't be written.
+     */
+    bool start(QString * errorString = 0);
+
+    /**
+     * @brief finish commits the rest of the best flight and ends the document. Returns false with an explanation
+     * in errorString if the sink failed along the way.
+     */
+    bool finish(QString * errorString = 0);
+
+    /**
+     * @brief committedCount returns how many waypoints have been written so far
+     * @return
+     */
+    int committedCount() const;
+
+signals:
+    void prefixCommitted(int committedCount);
+
+private slots:
+    void handleBestFlightChanged(const QList<Position>& flight);
+    void handleSettleTimer();
+
+private:
+    void _commit(int count);
+
+    QPointer<FlightPlanner> _planner;
+    QIODevice * _sink;
+    GPXStreamWriter * _writer;
+
+    qint64 _settleTime;
+    int _minimumCommit;
+
+    //The latest best flight, and since when (on _clock) each of its waypoints has been what it is now
+    QList<Position> _flight;
+    QVector<qint64> _stableSince;
+    QElapsedTimer _clock;
+    QTimer _settleTimer;
+
+    QList<Position> _committed;
+};
+
+#endif // FLIGHTPREFIXSTREAMER_H
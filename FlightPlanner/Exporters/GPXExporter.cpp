@@ -1,24 +1,31 @@
 #include "GPXExporter.h"
 
-#include "GPX.h"
+#include "GPXStreamWriter.h"
+
+#include <QBuffer>
 
 GPXExporter::GPXExporter(const QList<Position>& solution) : Exporter(solution)
 {
 }
 
+//pure-virtual from Exporter
 bool GPXExporter::doExport(QByteArray *output)
 {
-    GPX gpx;
+    QBuffer buffer(output);
+    buffer.open(QIODevice::WriteOnly);
+    return this->doExport(&buffer);
+}
 
-    foreach(const Position& pos, this->solution())
-    {
-        GPXPoint point;
-        point.longitude = pos.longitude();
-        point.latitude = pos.latitude();
-        point.height = pos.altitude();
+//virtual from Exporter
+bool GPXExporter::doExport(QIODevice *output, QString *errorString)
+{
+    //Straight from the solution to the device, without building a GPX or a document first
+    GPXStreamWriter writer(output);
+    if (!writer.begin(errorString))
+        return false;
 
-        gpx.appendPoint(point);
-    }
+    foreach(const Position& pos, this->solution())
+        writer.writePoint(pos.longitude(), pos.latitude(), pos.altitude());
 
-    return gpx.toXML(output);
+    return writer.end(errorString);
 }
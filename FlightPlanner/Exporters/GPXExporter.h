@@ -8,7 +8,11 @@ class GPXExporter : public Exporter
 public:
     GPXExporter(const QList<Position>& solution);
 
+    //pure-virtual from Exporter
     virtual bool doExport(QByteArray * output);
+
+    //virtual from Exporter
+    virtual bool doExport(QIODevice * output, QString * errorString = 0);
 };
 
 #endif // GPXEXPORTER_H
@@ -0,0 +1,301 @@
+#include "PathCompressor.h"
+
+#include <cmath>
+
+#include "LocalFrame.h"
+
+const qreal PI = 3.14159265358979;
+
+//Slack on the turn allowed at a corner, in radians, so that the planner's own turns (which are exactly at the
+//limit) always pass
+const qreal TURN_SLACK = 1e-3;
+
+//Arcs flatter than this many meters of radius are left to straight segments
+const qreal MAX_ARC_RADIUS = 1e5;
+
+//Slack on distances, in meters, so that a zero tolerance still merges points that are in line
+const qreal DISTANCE_SLACK = 1e-9;
+
+//non-member
+static qreal cross(const QPointF& a, const QPointF& b)
+{
+    return a.x() * b.y() - a.y() * b.x();
+}
+
+//non-member
+static qreal dot(const QPointF& a, const QPointF& b)
+{
+    return a.x() * b.x() + a.y() * b.y();
+}
+
+//non-member
+static qreal length(const QPointF& a)
+{
+    return std::sqrt(dot(a, a));
+}
+
+PathSegment::PathSegment() :
+    kind(LineSegment), radius(0.0), clockwise(false)
+{
+}
+
+PathCompressor::PathCompressor(const UAVParameters &params, qreal tolerance) :
+    _params(params)
+{
+    this->setTolerance(tolerance);
+}
+
+qreal PathCompressor::tolerance() const
+{
+    return _tolerance;
+}
+
+void PathCompressor::setTolerance(qreal meters)
+{
+    _tolerance = qMax<qreal>(0.0, meters);
+}
+
+QList<Position> PathCompressor::simplify(const QList<Position> &path) const
+{
+    if (path.size() < 3)
+        return path;
+
+    QVector<QPointF> points;
+    QVector<qreal> altitudes;
+    _toLocal(path, &points, &altitudes);
+
+    QList<Position> toRet;
+    toRet.append(path.first());
+    QPointF previousDirection;
+    qreal previousLength = 0.0;
+    int first = 0;
+    while (first < path.size() - 1)
+    {
+        //The next waypoint is always good enough, even if the planner turned harder than we'd allow
+        int last = _longestFit(LineFit, first, first + 1, points, altitudes, previousDirection, previousLength);
+        if (last < 0)
+            last = first + 1;
+
+        toRet.append(path.at(last));
+        previousDirection = points.at(last) - points.at(first);
+        previousLength = length(previousDirection);
+        first = last;
+    }
+    return toRet;
+}
+
+QList<PathSegment> PathCompressor::segments(const QList<Position> &path) const
+{
+    QList<PathSegment> toRet;
+    if (path.size() < 2)
+        return toRet;
+
+    QVector<QPointF> points;
+    QVector<qreal> altitudes;
+    _toLocal(path, &points, &altitudes);
+    const LocalFrame frame(path.first());
+
+    QPointF previousDirection;
+    qreal previousLength = 0.0;
+    int first = 0;
+    while (first < path.size() - 1)
+    {
+        int lineLast = _longestFit(LineFit, first, first + 1, points, altitudes, previousDirection, previousLength);
+        if (lineLast < 0)
+            lineLast = first + 1;
+        const int arcLast = _longestFit(ArcFit, first, first + 2, points, altitudes, previousDirection, previousLength);
+
+        //Whichever covers more of the path. Lines win ties, since they're simpler to fly.
+        PathSegment segment;
+        if (arcLast > lineLast)
+        {
+            Arc arc;
+            _arcFits(first, arcLast, points, altitudes, &arc);
+            segment.kind = PathSegment::ArcSegment;
+            segment.end = path.at(arcLast);
+            segment.center = frame.toGeo(arc.center);
+            segment.radius = arc.radius;
+            segment.clockwise = arc.clockwise;
+
+            //The next segment turns from the arc's tangent where it ends
+            const QPointF out = points.at(arcLast) - arc.center;
+            previousDirection = arc.clockwise ? QPointF(out.y(), -out.x()) : QPointF(-out.y(), out.x());
+            previousLength = arc.radius * arc.sweep;
+            first = arcLast;
+        }
+        else
+        {
+            segment.kind = PathSegment::LineSegment;
+            segment.end = path.at(lineLast);
+            previousDirection = points.at(lineLast) - points.at(first);
+            previousLength = length(previousDirection);
+            first = lineLast;
+        }
+        toRet.append(segment);
+    }
+    return toRet;
+}
+
+//private
+void PathCompressor::_toLocal(const QList<Position> &path, QVector<QPointF> *points, QVector<qreal> *altitudes) const
+{
+    QPolygonF lonLats(path.size());
+    altitudes->resize(path.size());
+    for (int i = 0; i < path.size(); i++)
+    {
+        lonLats[i] = path.at(i).lonLat();
+        (*altitudes)[i] = path.at(i).altitude();
+    }
+
+    //Converting the whole path at once is much cheaper than point by point
+    const LocalFrame frame(path.first());
+    *points = frame.toLocal(lonLats);
+}
+
+//private
+int PathCompressor::_longestFit(FitKind kind, int first, int minLast, const QVector<QPointF> &points,
+                                const QVector<qreal> &altitudes, const QPointF &previousDirection,
+                                qreal previousLength) const
+{
+    const int count = points.size();
+    if (minLast >= count || !_fits(kind, first, minLast, points, altitudes, previousDirection, previousLength))
+        return -1;
+
+    /*
+     * Checking a run costs its length, so rather than trying every end we gallop out until a run doesn't fit
+     * and then bisect. A run that doesn't fit almost never has a longer one that does.
+    */
+    int good = minLast;
+    int bad = count;
+    int step = 1;
+    while (good + step < count)
+    {
+        if (!_fits(kind, first, good + step, points, altitudes, previousDirection, previousLength))
+        {
+            bad = good + step;
+            break;
+        }
+        good += step;
+        step *= 2;
+    }
+
+    while (bad - good > 1)
+    {
+        const int middle = good + (bad - good) / 2;
+        if (_fits(kind, first, middle, points, altitudes, previousDirection, previousLength))
+            good = middle;
+        else
+            bad = middle;
+    }
+    return good;
+}
+
+//private
+bool PathCompressor::_fits(FitKind kind, int first, int last, const QVector<QPointF> &points,
+                           const QVector<qreal> &altitudes, const QPointF &previousDirection, qreal previousLength,
+                           Arc *arcOut) const
+{
+    if (kind == LineFit)
+        return _lineFits(first, last, points, altitudes, previousDirection, previousLength);
+    return _arcFits(first, last, points, altitudes, arcOut);
+}
+
+//private
+bool PathCompressor::_lineFits(int first, int last, const QVector<QPointF> &points, const QVector<qreal> &altitudes,
+                               const QPointF &previousDirection, qreal previousLength) const
+{
+    const QPointF& start = points.at(first);
+    const QPointF leg = points.at(last) - start;
+    const qreal legLengthSquared = dot(leg, leg);
+    const qreal startAltitude = altitudes.at(first);
+    const qreal climb = altitudes.at(last) - startAltitude;
+
+    //Every point skipped has to be near the leg, and near the altitude the leg has there
+    for (int i = first + 1; i < last; i++)
+    {
+        const QPointF offset = points.at(i) - start;
+        qreal t = 0.0;
+        if (legLengthSquared > 0.0)
+            t = qBound<qreal>(0.0, dot(offset, leg) / legLengthSquared, 1.0);
+        if (length(offset - t * leg) > _tolerance + DISTANCE_SLACK)
+            return false;
+        if (qAbs(altitudes.at(i) - (startAltitude + t * climb)) > _tolerance + DISTANCE_SLACK)
+            return false;
+    }
+
+    //The corner where the leg starts can't be sharper than the UAV can turn over the shorter leg beside it
+    const qreal legLength = std::sqrt(legLengthSquared);
+    if (previousLength > 0.0 && legLength > 0.0)
+    {
+        const qreal turn = qAbs(std::atan2(cross(previousDirection, leg), dot(previousDirection, leg)));
+        const qreal maxTurn = qMin<qreal>(previousLength, legLength) / _params.minTurningRadius();
+        if (turn > maxTurn + TURN_SLACK)
+            return false;
+    }
+    return true;
+}
+
+//private
+bool PathCompressor::_arcFits(int first, int last, const QVector<QPointF> &points, const QVector<qreal> &altitudes,
+                              Arc *arcOut) const
+{
+    if (last - first < 2)
+        return false;
+
+    //The circle through the run's ends and middle, worked out relative to its start to keep the numbers small
+    const QPointF& start = points.at(first);
+    const QPointF middle = points.at(first + (last - first) / 2) - start;
+    const QPointF end = points.at(last) - start;
+    const qreal denominator = 2.0 * cross(middle, end);
+    if (qAbs(denominator) < DISTANCE_SLACK)
+        return false;
+    const qreal middleSquared = dot(middle, middle);
+    const qreal endSquared = dot(end, end);
+    const QPointF center = start + QPointF((end.y() * middleSquared - middle.y() * endSquared) / denominator,
+                                           (middle.x() * endSquared - end.x() * middleSquared) / denominator);
+    const qreal radius = length(start - center);
+    if (radius < _params.minTurningRadius() - _tolerance || radius > MAX_ARC_RADIUS)
+        return false;
+    const bool clockwise = (cross(middle, end - middle) < 0.0);
+
+    //The run has to stay near the circle and keep going around it the same way, less than once
+    QVector<qreal> sweeps(last - first + 1, 0.0);
+    for (int i = first; i <= last; i++)
+    {
+        const QPointF radial = points.at(i) - center;
+        if (qAbs(length(radial) - radius) > _tolerance + DISTANCE_SLACK)
+            return false;
+        if (i == first)
+            continue;
+
+        const QPointF previousRadial = points.at(i - 1) - center;
+        qreal delta = std::atan2(cross(previousRadial, radial), dot(previousRadial, radial));
+        if (clockwise)
+            delta = -delta;
+        if (delta * radius < -(_tolerance + DISTANCE_SLACK))
+            return false;
+        sweeps[i - first] = sweeps.at(i - first - 1) + delta;
+    }
+    const qreal sweep = sweeps.last();
+    if (sweep <= 0.0 || sweep >= 2.0 * PI)
+        return false;
+
+    //Altitude changes evenly around the arc
+    const qreal startAltitude = altitudes.at(first);
+    const qreal climb = altitudes.at(last) - startAltitude;
+    for (int i = first + 1; i < last; i++)
+    {
+        const qreal expected = startAltitude + climb * sweeps.at(i - first) / sweep;
+        if (qAbs(altitudes.at(i) - expected) > _tolerance + DISTANCE_SLACK)
+            return false;
+    }
+
+    if (arcOut)
+    {
+        arcOut->center = center;
+        arcOut->radius = radius;
+        arcOut->clockwise = clockwise;
+        arcOut->sweep = sweep;
+    }
+    return true;
+}
@@ -0,0 +1,101 @@
+#ifndef PATHCOMPRESSOR_H
+#define PATHCOMPRESSOR_H
+
+#include <QList>
+#include <QPointF>
+#include <QVector>
+
+#include "Position.h"
+#include "UAVParameters.h"
+
+/**
+ * @brief The PathSegment struct is one command of a compressed path: fly straight, or along a circular arc, from
+ * where the last segment ended to end
+ */
+struct PathSegment
+{
+    enum Kind
+    {
+        LineSegment,
+        ArcSegment
+    };
+
+    PathSegment();
+
+    Kind kind;
+    Position end;
+
+    //Arcs only
+    Position center;
+    qreal radius;
+    bool clockwise;
+};
+
+/**
+ * @brief The PathCompressor class shrinks a planned flight, which has a waypoint every waypoint interval, before
+ * it's exported.
+ *
+ * simplify() keeps only the waypoints needed for straight legs between them to stay within tolerance() meters
+ * of the flight. segments() describes the flight as straight and arc segments within the same tolerance, for
+ * autopilots that fly such commands. Arcs are never tighter than the UAV's minimum turning radius, and
+ * simplify() never leaves a corner sharper than the UAV could turn over the legs on either side of it.
+ *
+ * Altitude counts towards the tolerance like horizontal distance does.
+ */
+class PathCompressor
+{
+public:
+    PathCompressor(const UAVParameters& params, qreal tolerance = 1.0);
+
+    qreal tolerance() const;
+    void setTolerance(qreal meters);
+
+    /**
+     * @brief simplify returns the waypoints of path that straight legs need, always including its first and last.
+     * Zero tolerance only drops waypoints that are exactly in line.
+     * @param path
+     * @return
+     */
+    QList<Position> simplify(const QList<Position>& path) const;
+
+    /**
+     * @brief segments returns path as segments, starting from its first position
+     * @param path
+     * @return
+     */
+    QList<PathSegment> segments(const QList<Position>& path) const;
+
+private:
+    //A run of the path in the local frame, and the arc fitted to it
+    struct Arc
+    {
+        QPointF center;
+        qreal radius;
+        bool clockwise;
+
+        //Total angle flown around the center, in radians
+        qreal sweep;
+    };
+
+    enum FitKind
+    {
+        LineFit,
+        ArcFit
+    };
+
+    void _toLocal(const QList<Position>& path, QVector<QPointF> * points, QVector<qreal> * altitudes) const;
+
+    int _longestFit(FitKind kind, int first, int minLast, const QVector<QPointF>& points,
+                    const QVector<qreal>& altitudes, const QPointF& previousDirection, qreal previousLength) const;
+    bool _fits(FitKind kind, int first, int last, const QVector<QPointF>& points, const QVector<qreal>& altitudes,
+               const QPointF& previousDirection, qreal previousLength, Arc * arcOut = 0) const;
+    bool _lineFits(int first, int last, const QVector<QPointF>& points, const QVector<qreal>& altitudes,
+                   const QPointF& previousDirection, qreal previousLength) const;
+    bool _arcFits(int first, int last, const QVector<QPointF>& points, const QVector<qreal>& altitudes,
+                  Arc * arcOut) const;
+
+    UAVParameters _params;
+    qreal _tolerance;
+};
+
+#endif // PATHCOMPRESSOR_H
@@ -0,0 +1,59 @@
+#include "SegmentExporter.h"
+
+#include <QTextStream>
+
+#include "PathCompressor.h"
+
+//Enough digits for about a centimeter of longitude or latitude
+const int COORDINATE_DIGITS = 7;
+
+//non-member
+static void writePosition(QTextStream& stream, const Position& pos)
+{
+    stream << qSetRealNumberPrecision(COORDINATE_DIGITS) << fixed << pos.longitude() << " " << pos.latitude();
+    stream << qSetRealNumberPrecision(2) << " " << pos.altitude();
+}
+
+SegmentExporter::SegmentExporter(const QList<Position> &solution, const UAVParameters &params, qreal tolerance) :
+    Exporter(solution), _params(params), _tolerance(tolerance)
+{
+}
+
+//pure-virtual from Exporter
+bool SegmentExporter::doExport(QByteArray *output)
+{
+    const QList<Position>& solution = this->solution();
+    if (solution.isEmpty())
+        return false;
+
+    const PathCompressor compressor(_params, _tolerance);
+    const QList<PathSegment> segments = compressor.segments(solution);
+
+    QTextStream stream(output, QIODevice::WriteOnly);
+    stream << "# FlightPlanner segments: " << solution.size() << " waypoints as " << segments.size() << " segments\n";
+    stream << "# airspeed " << _params.airspeed() << " m/s, min turning radius " << _params.minTurningRadius() << " m\n";
+
+    stream << "START ";
+    writePosition(stream, solution.first());
+    stream << "\n";
+    foreach(const PathSegment& segment, segments)
+    {
+        if (segment.kind == PathSegment::LineSegment)
+        {
+            stream << "LINE ";
+            writePosition(stream, segment.end);
+        }
+        else
+        {
+            stream << "ARC ";
+            writePosition(stream, segment.end);
+            stream << " " << qSetRealNumberPrecision(COORDINATE_DIGITS) << segment.center.longitude();
+            stream << " " << segment.center.latitude();
+            stream << " " << qSetRealNumberPrecision(2) << segment.radius;
+            stream << " " << (segment.clockwise ? "CW" : "CCW");
+        }
+        stream << "\n";
+    }
+    stream.flush();
+    return stream.status() == QTextStream::Ok;
+}
@@ -0,0 +1,31 @@
+#ifndef SEGMENTEXPORTER_H
+#define SEGMENTEXPORTER_H
+
+#include "Exporter.h"
+#include "UAVParameters.h"
+
+/**
+ * @brief The SegmentExporter class writes a solution as straight and arc segment commands (see
+ * PathCompressor::segments()), for autopilots that fly those rather than dense waypoints. The .segments file is
+ * plain text, one command per line, after a line of '#' comments:
+ *
+ *   START <lon> <lat> <alt>
+ *   LINE <lon> <lat> <alt>
+ *   ARC <lon> <lat> <alt> <center lon> <center lat> <radius> CW|CCW
+ *
+ * Each segment ends at the position given and starts where the one before it ended. Degrees, meters.
+ */
+class SegmentExporter : public Exporter
+{
+public:
+    SegmentExporter(const QList<Position>& solution, const UAVParameters& params, qreal tolerance = 1.0);
+
+    //pure-virtual from Exporter
+    virtual bool doExport(QByteArray * output);
+
+private:
+    UAVParameters _params;
+    qreal _tolerance;
+};
+
+#endif // SEGMENTEXPORTER_H
@@ -0,0 +1,421 @@
+#include "FleetPlanner.h"
+
+#include <QBitArray>
+#include <QHash>
+#include <QThread>
+#include <QtDebug>
+#include <algorithm>
+#include <limits>
+
+#include "HierarchicalPlanner/HierarchicalPlanner.h"
+#include "FlightTasks/CoverageTask.h"
+#include "FlightTasks/SamplingTask.h"
+#include "FlightTasks/NoFlyFlightTask.h"
+#include "LocalFrame.h"
+
+//non-member
+//Orders areas by where they are, so that the assignment doesn't depend on the order of the problem's set
+static bool areaLess(const QSharedPointer<FlightTaskArea>& a, const QSharedPointer<FlightTaskArea>& b)
+{
+    const QPointF aCenter = a->geoPoly().boundingRect().center();
+    const QPointF bCenter = b->geoPoly().boundingRect().center();
+    return aCenter.x() < bCenter.x() || (aCenter.x() == bCenter.x() && aCenter.y() < bCenter.y());
+}
+
+//non-member
+static int findRoot(QVector<int>& parents, int i)
+{
+    while (parents.at(i) != i)
+    {
+        parents[i] = parents.at(parents.at(i));
+        i = parents.at(i);
+    }
+    return i;
+}
+
+FleetPlanner::FleetPlanner(QSharedPointer<PlanningProblem> problem, QObject *parent) :
+    QObject(parent), _problem(problem), _timeBudget(0), _workerCount(0), _randomSeed(0), _elapsed(0),
+    _runningPlanners(0)
+{
+    _budgetTimer.setSingleShot(true);
+    connect(&_budgetTimer,
+            SIGNAL(timeout()),
+            this,
+            SLOT(handleBudgetTimeout()));
+}
+
+FleetPlanner::~FleetPlanner()
+{
+    _clearPlanners();
+}
+
+QSharedPointer<PlanningProblem> FleetPlanner::problem() const
+{
+    return _problem;
+}
+
+void FleetPlanner::setProblem(QSharedPointer<PlanningProblem> problem)
+{
+    _problem = problem;
+}
+
+const QList<FleetVehicle> &FleetPlanner::vehicles() const
+{
+    return _vehicles;
+}
+
+void FleetPlanner::setVehicles(const QList<FleetVehicle> &vehicles)
+{
+    _vehicles = vehicles;
+}
+
+void FleetPlanner::addVehicle(const FleetVehicle &vehicle)
+{
+    _vehicles.append(vehicle);
+}
+
+qint64 FleetPlanner::timeBudget() const
+{
+    return _timeBudget;
+}
+
+void FleetPlanner::setTimeBudget(qint64 msecs)
+{
+    _timeBudget = qMax<qint64>(0, msecs);
+}
+
+int FleetPlanner::workerCount() const
+{
+    return _workerCount;
+}
+
+void FleetPlanner::setWorkerCount(int count)
+{
+    _workerCount = qMax<int>(0, count);
+}
+
+quint64 FleetPlanner::randomSeed() const
+{
+    return _randomSeed;
+}
+
+void FleetPlanner::setRandomSeed(quint64 seed)
+{
+    _randomSeed = seed;
+}
+
+bool FleetPlanner::plan(QString *errorString)
+{
+    QElapsedTimer clock;
+    clock.start();
+
+    const int vehicleCount = _vehicles.size();
+    _assignments.clear();
+    _assignments.resize(vehicleCount);
+    _flights.clear();
+    _flights.resize(vehicleCount);
+    _fitnesses.clear();
+    _fitnesses.resize(vehicleCount);
+    _statistics.clear();
+    _statistics.resize(vehicleCount);
+    _elapsed = 0;
+
+    if (_problem.isNull() || vehicleCount == 0)
+    {
+        if (errorString)
+            *errorString = "A fleet plan needs a problem and at least one vehicle";
+        return false;
+    }
+
+    QList<QSharedPointer<FlightTaskArea> > obstacleAreas;
+    _assignGroups(_groupAreas(&obstacleAreas));
+
+    //Share the threads out between the vehicles that have something to do
+    int busyVehicles = 0;
+    for (int v = 0; v < vehicleCount; v++)
+    {
+        if (!_assignments.at(v).isEmpty())
+            busyVehicles++;
+    }
+    const int workers = (_workerCount == 0) ? QThread::idealThreadCount() : _workerCount;
+    const int workersPerPlanner = qMax<int>(1, workers / qMax<int>(1, busyVehicles));
+
+    //One problem and planner per vehicle
+    QVector<int> plannerVehicles;
+    for (int v = 0; v < vehicleCount; v++)
+    {
+        if (_assignments.at(v).isEmpty())
+            continue;
+
+        const FleetVehicle& vehicle = _vehicles.at(v);
+        QSharedPointer<PlanningProblem> vehicleProblem(new PlanningProblem());
+        vehicleProblem->setStartingPosition(vehicle.startingPosition);
+        vehicleProblem->setStartingOrientation(vehicle.startingOrientation);
+        vehicleProblem->setUAVParameters(vehicle.uavParameters);
+        foreach(const QSharedPointer<FlightTaskArea>& area, _assignments.at(v))
+            vehicleProblem->addTaskArea(area);
+        foreach(const QSharedPointer<FlightTaskArea>& area, obstacleAreas)
+            vehicleProblem->addTaskArea(area);
+
+        HierarchicalPlanner * planner = new HierarchicalPlanner(vehicleProblem);
+        planner->setRandomSeed(_randomSeed);
+        planner->setWorkerCount(workersPerPlanner);
+        planner->setExecutionMode(FlightPlanner::ThreadExecution);
+
+        //Each restore adds to what the planner already has, so it gets everything the last fleet worked out
+        foreach(const QByteArray& results, _sharedResults)
+            planner->restoreResults(results);
+
+        connect(planner,
+                SIGNAL(plannerStatusChanged(FlightPlanner::PlanningStatus)),
+                this,
+                SLOT(handlePlannerStatusChanged(FlightPlanner::PlanningStatus)));
+        _planners.append(planner);
+        plannerVehicles.append(v);
+    }
+
+    //All of the vehicles plan at once
+    _runningPlanners = 0;
+    bool started = true;
+    foreach(HierarchicalPlanner * planner, _planners)
+    {
+        planner->startPlanning();
+        if (planner->status() == FlightPlanner::Running)
+            _runningPlanners++;
+        else
+            started = false;
+    }
+
+    if (_runningPlanners > 0)
+    {
+        if (_timeBudget > 0)
+            _budgetTimer.start(_timeBudget);
+        _loop.exec();
+        _budgetTimer.stop();
+    }
+
+    _sharedResults.clear();
+    for (int i = 0; i < _planners.size(); i++)
+    {
+        const HierarchicalPlanner * planner = _planners.at(i);
+        const int v = plannerVehicles.at(i);
+        _flights[v] = planner->bestFlightSoFar();
+        _fitnesses[v] = planner->bestFitnessSoFar();
+        _statistics[v] = planner->statistics();
+        _sharedResults.append(planner->saveResults());
+    }
+    _clearPlanners();
+    _elapsed = clock.elapsed();
+
+    if (!started)
+    {
+        if (errorString)
+            *errorString = "A vehicle's planner refused to start";
+        return false;
+    }
+    return true;
+}
+
+QList<QSharedPointer<FlightTaskArea> > FleetPlanner::assignedAreas(int vehicle) const
+{
+    return _assignments.value(vehicle);
+}
+
+QList<Position> FleetPlanner::flight(int vehicle) const
+{
+    return _flights.value(vehicle);
+}
+
+Fitness FleetPlanner::fitness(int vehicle) const
+{
+    return _fitnesses.value(vehicle);
+}
+
+PlanningStatistics FleetPlanner::statistics(int vehicle) const
+{
+    return _statistics.value(vehicle);
+}
+
+qint64 FleetPlanner::elapsed() const
+{
+    return _elapsed;
+}
+
+//private slot
+void FleetPlanner::handlePlannerStatusChanged(FlightPlanner::PlanningStatus status)
+{
+    //HierarchicalPlanner pauses itself when it's done
+    if (status == FlightPlanner::Running)
+        return;
+
+    _runningPlanners--;
+    if (_runningPlanners <= 0)
+        _loop.quit();
+}
+
+//private slot
+void FleetPlanner::handleBudgetTimeout()
+{
+    qDebug() << "Time budget of" << _timeBudget << "ms exhausted, stopping the fleet's planners";
+
+    //The loop quits once the last of them announces that it's paused
+    foreach(HierarchicalPlanner * planner, _planners)
+    {
+        if (planner->status() == FlightPlanner::Running)
+            planner->pausePlanning();
+    }
+}
+
+//private
+QList<FleetPlanner::AreaGroup> FleetPlanner::_groupAreas(QList<QSharedPointer<FlightTaskArea> > *obstacleAreas) const
+{
+    QList<QSharedPointer<FlightTaskArea> > sortedAreas = _problem->areas().toList();
+    std::sort(sortedAreas.begin(), sortedAreas.end(), areaLess);
+
+    //Areas with nothing but no-fly tasks are everyone's obstacles. The rest are work to share out.
+    QList<QSharedPointer<FlightTaskArea> > workAreas;
+    QHash<const FlightTask *, int> taskAreas;
+    foreach(const QSharedPointer<FlightTaskArea>& area, sortedAreas)
+    {
+        bool isWork = false;
+        foreach(const QSharedPointer<FlightTask>& task, area->tasks())
+        {
+            if (!qobject_cast<const NoFlyFlightTask *>(task.data()))
+                isWork = true;
+        }
+
+        if (!isWork)
+        {
+            if (area->numTasks() > 0)
+                obstacleAreas->append(area);
+            continue;
+        }
+
+        foreach(const QSharedPointer<FlightTask>& task, area->tasks())
+            taskAreas.insert(task.data(), workAreas.size());
+        workAreas.append(area);
+    }
+
+    //A task and the tasks it depends on have to be flown by the same vehicle, so their areas go together
+    QVector<int> parents(workAreas.size());
+    for (int i = 0; i < parents.size(); i++)
+        parents[i] = i;
+    for (int i = 0; i < workAreas.size(); i++)
+    {
+        foreach(const QSharedPointer<FlightTask>& task, workAreas.at(i)->tasks())
+        {
+            foreach(const QWeakPointer<FlightTask>& weakDependency, task->dependencyConstraints())
+            {
+                const QSharedPointer<FlightTask> dependency = weakDependency.toStrongRef();
+                const int j = taskAreas.value(dependency.data(), -1);
+                if (j >= 0)
+                    parents[findRoot(parents, i)] = findRoot(parents, j);
+            }
+        }
+    }
+
+    QList<AreaGroup> toRet;
+    QHash<int, int> rootGroups;
+    for (int i = 0; i < workAreas.size(); i++)
+    {
+        const int root = findRoot(parents, i);
+        if (!rootGroups.contains(root))
+        {
+            rootGroups.insert(root, toRet.size());
+            AreaGroup group;
+            group.work.fill(0.0, _vehicles.size());
+            toRet.append(group);
+        }
+
+        AreaGroup& group = toRet[rootGroups.value(root)];
+        const QSharedPointer<FlightTaskArea>& area = workAreas.at(i);
+        group.areas.append(area);
+        group.center += area->geoPoly().boundingRect().center();
+        for (int v = 0; v < _vehicles.size(); v++)
+            group.work[v] += _workEstimate(*area, _vehicles.at(v).uavParameters);
+    }
+
+    for (int g = 0; g < toRet.size(); g++)
+        toRet[g].center /= toRet.at(g).areas.size();
+    return toRet;
+}
+
+//private
+void FleetPlanner::_assignGroups(const QList<AreaGroup> &groups)
+{
+    //When each vehicle would be done with what it has so far, and where
+    QVector<qreal> readyTimes(_vehicles.size(), 0.0);
+    QVector<Position> ends;
+    foreach(const FleetVehicle& vehicle, _vehicles)
+        ends.append(vehicle.startingPosition);
+
+    //Each round, the group that some vehicle can finish soonest goes to that vehicle
+    QBitArray assigned(groups.size());
+    for (int round = 0; round < groups.size(); round++)
+    {
+        int bestGroup = -1;
+        int bestVehicle = -1;
+        qreal bestFinish = std::numeric_limits<qreal>::max();
+        for (int g = 0; g < groups.size(); g++)
+        {
+            if (assigned.testBit(g))
+                continue;
+
+            const AreaGroup& group = groups.at(g);
+            const Position center(group.center);
+            for (int v = 0; v < _vehicles.size(); v++)
+            {
+                const qreal travel = ends.at(v).flatDistanceEstimate(center) / _vehicles.at(v).uavParameters.airspeed();
+                const qreal finish = readyTimes.at(v) + travel + group.work.at(v);
+                if (finish < bestFinish)
+                {
+                    bestFinish = finish;
+                    bestGroup = g;
+                    bestVehicle = v;
+                }
+            }
+        }
+
+        assigned.setBit(bestGroup);
+        readyTimes[bestVehicle] = bestFinish;
+        ends[bestVehicle] = Position(groups.at(bestGroup).center);
+        _assignments[bestVehicle] += groups.at(bestGroup).areas;
+    }
+}
+
+//private static
+qreal FleetPlanner::_workEstimate(const FlightTaskArea &area, const UAVParameters &uavParams)
+{
+    //The area in square meters
+    const LocalFrame frame = LocalFrame::around(area.geoPoly().boundingRect());
+    const QPolygonF localPoly = frame.toLocal(area.geoPoly());
+    qreal squareMeters = 0.0;
+    for (int i = 0; i < localPoly.size(); i++)
+    {
+        const QPointF& a = localPoly.at(i);
+        const QPointF& b = localPoly.at((i + 1) % localPoly.size());
+        squareMeters += a.x() * b.y() - b.x() * a.y();
+    }
+    squareMeters = qAbs(squareMeters) / 2.0;
+
+    qreal toRet = 0.0;
+    foreach(const QSharedPointer<FlightTask>& task, area.tasks())
+    {
+        //Coverage sweeps the area with a swath twice its max distance wide. Sampling takes its time.
+        const CoverageTask * coverage = qobject_cast<const CoverageTask *>(task.data());
+        const SamplingTask * sampling = qobject_cast<const SamplingTask *>(task.data());
+        if (coverage)
+            toRet += squareMeters / (2.0 * coverage->maxDistance()) / uavParams.airspeed();
+        else if (sampling)
+            toRet += sampling->timeRequired();
+    }
+    return toRet;
+}
+
+//private
+void FleetPlanner::_clearPlanners()
+{
+    qDeleteAll(_planners);
+    _planners.clear();
+    _runningPlanners = 0;
+}
@@ -0,0 +1,155 @@
+#ifndef FLEETPLANNER_H
+#define FLEETPLANNER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QList>
+#include <QSharedPointer>
+#include <QString>
+#include <QTimer>
+#include <QVector>
+
+#include "FlightPlanner.h"
+#include "PlanningProblem.h"
+#include "Position.h"
+#include "UAVOrientation.h"
+#include "UAVParameters.h"
+
+class HierarchicalPlanner;
+
+/**
+ * @brief The FleetVehicle struct is one aircraft of a fleet: where it starts and how it flies
+ */
+struct FleetVehicle
+{
+    QString name;
+    Position startingPosition;
+    UAVOrientation startingOrientation;
+    UAVParameters uavParameters;
+};
+
+/**
+ * @brief The FleetPlanner class plans flights for several aircraft sharing one problem's tasks.
+ *
+ * The problem's task areas are first auctioned off to the vehicles. Areas whose tasks depend on each other go
+ * together. Each round, the area group that some vehicle can finish soonest goes to that vehicle. "Soonest" counts
+ * the vehicle's work so far, its flight from where that work ends, and an estimate of the group's own work, so the
+ * groups spread out and the longest flight stays short. Areas with only no-fly tasks go to every vehicle.
+ *
+ * Each vehicle then gets its own PlanningProblem and HierarchicalPlanner, and all of them run at once on their
+ * worker threads. The sub-flights and transitions that the planners worked out are kept and given to every
+ * planner of the next plan() (see HierarchicalPlanner::restoreResults()). Replanning after the fleet or the
+ * assignment changes only plans what's new.
+ *
+ * The problem's own start and UAV parameters are ignored.
+ */
+class FleetPlanner : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FleetPlanner(QSharedPointer<PlanningProblem> problem = QSharedPointer<PlanningProblem>(),
+                          QObject *parent = 0);
+    virtual ~FleetPlanner();
+
+    QSharedPointer<PlanningProblem> problem() const;
+    void setProblem(QSharedPointer<PlanningProblem> problem);
+
+    const QList<FleetVehicle>& vehicles() const;
+    void setVehicles(const QList<FleetVehicle>& vehicles);
+    void addVehicle(const FleetVehicle& vehicle);
+
+    /**
+     * @brief timeBudget is how long in milliseconds plan() lets the planners work before pausing them and
+     * taking what they have. Zero (the default) means no limit.
+     * @return
+     */
+    qint64 timeBudget() const;
+    void setTimeBudget(qint64 msecs);
+
+    /**
+     * @brief workerCount returns the number of threads shared out between the vehicles' planners.
+     * 0 (the default) means "use QThread::idealThreadCount()". Every planner gets at least one.
+     * @return
+     */
+    int workerCount() const;
+    void setWorkerCount(int count);
+
+    quint64 randomSeed() const;
+    void setRandomSeed(quint64 seed);
+
+    /**
+     * @brief plan assigns the areas and plans every vehicle's flight. Returns false with an explanation in
+     * errorString if there's no problem or no vehicle, or a planner wouldn't start.
+     * @param errorString
+     * @return
+     */
+    bool plan(QString * errorString = 0);
+
+    /**
+     * @brief assignedAreas returns the areas the last plan() gave to a vehicle, not counting no-fly areas
+     * @param vehicle
+     * @return
+     */
+    QList<QSharedPointer<FlightTaskArea> > assignedAreas(int vehicle) const;
+
+    /**
+     * @brief flight returns a vehicle's flight from the last plan(). It's empty if the vehicle had nothing
+     * to do.
+     * @param vehicle
+     * @return
+     */
+    QList<Position> flight(int vehicle) const;
+    Fitness fitness(int vehicle) const;
+    PlanningStatistics statistics(int vehicle) const;
+
+    /**
+     * @brief elapsed returns how many milliseconds the last plan() took, assignment included
+     * @return
+     */
+    qint64 elapsed() const;
+
+private slots:
+    void handlePlannerStatusChanged(FlightPlanner::PlanningStatus status);
+    void handleBudgetTimeout();
+
+private:
+    struct AreaGroup
+    {
+        QList<QSharedPointer<FlightTaskArea> > areas;
+        QPointF center;
+
+        //Seconds of work, by vehicle
+        QVector<qreal> work;
+    };
+
+    QList<AreaGroup> _groupAreas(QList<QSharedPointer<FlightTaskArea> > * obstacleAreas) const;
+    void _assignGroups(const QList<AreaGroup>& groups);
+    static qreal _workEstimate(const FlightTaskArea& area, const UAVParameters& uavParams);
+    void _clearPlanners();
+
+    QSharedPointer<PlanningProblem> _problem;
+    QList<FleetVehicle> _vehicles;
+    qint64 _timeBudget;
+    int _workerCount;
+    quint64 _randomSeed;
+
+    //Results of the last plan(), by vehicle
+    QVector<QList<QSharedPointer<FlightTaskArea> > > _assignments;
+    QVector<QList<Position> > _flights;
+    QVector<Fitness> _fitnesses;
+    QVector<PlanningStatistics> _statistics;
+    qint64 _elapsed;
+
+    //What the last plan()'s planners worked out, for the next one's to start from
+    QList<QByteArray> _sharedResults;
+
+    //Only while plan() runs
+    QList<HierarchicalPlanner *> _planners;
+    int _runningPlanners;
+    QEventLoop _loop;
+    QTimer _budgetTimer;
+};
+
+#endif // FLEETPLANNER_H
@@ -0,0 +1,154 @@
+#include "FlightPath.h"
+
+#include "guts/Conversions.h"
+
+#include <cmath>
+
+FlightPath::FlightPath()
+{
+}
+
+FlightPath::FlightPath(const QList<Position> &positions)
+{
+    this->append(positions);
+}
+
+int FlightPath::size() const
+{
+    return _longitudes.size();
+}
+
+bool FlightPath::isEmpty() const
+{
+    return _longitudes.isEmpty();
+}
+
+void FlightPath::reserve(int size)
+{
+    _longitudes.reserve(size);
+    _latitudes.reserve(size);
+    _altitudes.reserve(size);
+}
+
+void FlightPath::clear()
+{
+    _longitudes.clear();
+    _latitudes.clear();
+    _altitudes.clear();
+}
+
+Position FlightPath::at(int index) const
+{
+    return Position(_longitudes.at(index), _latitudes.at(index), _altitudes.at(index));
+}
+
+qreal FlightPath::longitude(int index) const
+{
+    return _longitudes.at(index);
+}
+
+qreal FlightPath::latitude(int index) const
+{
+    return _latitudes.at(index);
+}
+
+qreal FlightPath::altitude(int index) const
+{
+    return _altitudes.at(index);
+}
+
+qreal FlightPath::heading(int index) const
+{
+    if (this->size() < 2)
+        return 0.0;
+
+    const int from = qMin<int>(index, this->size() - 2);
+    const qreal latitude = _latitudes.at(from);
+    const qreal east = (_longitudes.at(from + 1) - _longitudes.at(from)) / Conversions::degreesLonPerMeter(latitude);
+    const qreal north = (_latitudes.at(from + 1) - latitude) / Conversions::degreesLatPerMeter(latitude);
+    return atan2(north, east);
+}
+
+const qreal *FlightPath::longitudes() const
+{
+    return _longitudes.constData();
+}
+
+const qreal *FlightPath::latitudes() const
+{
+    return _latitudes.constData();
+}
+
+const qreal *FlightPath::altitudes() const
+{
+    return _altitudes.constData();
+}
+
+void FlightPath::append(const Position &position)
+{
+    _longitudes.append(position.longitude());
+    _latitudes.append(position.latitude());
+    _altitudes.append(position.altitude());
+}
+
+void FlightPath::append(const FlightPath &other)
+{
+    if (this->isEmpty())
+    {
+        //Share rather than copy
+        *this = other;
+        return;
+    }
+    _longitudes += other._longitudes;
+    _latitudes += other._latitudes;
+    _altitudes += other._altitudes;
+}
+
+void FlightPath::append(const QList<Position> &positions)
+{
+    this->append(positions, 0, positions.size());
+}
+
+void FlightPath::append(const QList<Position> &positions, int first, int count)
+{
+    first = qBound<int>(0, first, positions.size());
+    const int end = qBound<int>(first, first + count, positions.size());
+    if (_longitudes.capacity() < this->size() + end - first)
+        this->reserve(qMax<int>(this->size() + end - first, 2 * this->size()));
+    for (int i = first; i < end; i++)
+        this->append(positions.at(i));
+}
+
+FlightPath FlightPath::mid(int first, int count) const
+{
+    FlightPath toRet;
+    first = qBound<int>(0, first, this->size());
+    if (count < 0)
+        count = this->size() - first;
+    count = qBound<int>(0, count, this->size() - first);
+    toRet._longitudes = _longitudes.mid(first, count);
+    toRet._latitudes = _latitudes.mid(first, count);
+    toRet._altitudes = _altitudes.mid(first, count);
+    return toRet;
+}
+
+QList<Position> FlightPath::toList() const
+{
+    QList<Position> toRet;
+    toRet.reserve(this->size());
+    for (int i = 0; i < this->size(); i++)
+        toRet.append(this->at(i));
+    return toRet;
+}
+
+bool FlightPath::operator ==(const FlightPath &other) const
+{
+    return _longitudes == other._longitudes
+            && _latitudes == other._latitudes
+            && _altitudes == other._altitudes;
+}
+
+bool FlightPath::operator !=(const FlightPath &other) const
+{
+    return !(*this == other);
+}
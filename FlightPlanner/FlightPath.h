@@ -0,0 +1,67 @@
+#ifndef FLIGHTPATH_H
+#define FLIGHTPATH_H
+
+#include <QList>
+#include <QVector>
+
+#include "Position.h"
+
+/**
+ * @brief The FlightPath class is a sequence of waypoints stored as contiguous arrays of longitudes, latitudes
+ * and altitudes. QList<Position> keeps every waypoint in its own heap allocation, so building a long flight out
+ * of many pieces allocates once per waypoint. A FlightPath reserves once and copies the pieces' arrays.
+ *
+ * Like the Qt containers it is implicitly shared, so passing and returning it by value is cheap.
+ */
+class FlightPath
+{
+public:
+    FlightPath();
+    explicit FlightPath(const QList<Position>& positions);
+
+    int size() const;
+    bool isEmpty() const;
+    void reserve(int size);
+    void clear();
+
+    Position at(int index) const;
+    qreal longitude(int index) const;
+    qreal latitude(int index) const;
+    qreal altitude(int index) const;
+
+    /**
+     * @brief heading returns the direction (radians counter-clockwise from east, like UAVOrientation) from waypoint
+     * index to the next one, or from the previous one for the last waypoint. 0 for paths shorter than two.
+     */
+    qreal heading(int index) const;
+
+    const qreal * longitudes() const;
+    const qreal * latitudes() const;
+    const qreal * altitudes() const;
+
+    void append(const Position& position);
+    void append(const FlightPath& other);
+    void append(const QList<Position>& positions);
+
+    /**
+     * @brief append appends count waypoints of positions starting at first. The range is clamped to positions.
+     */
+    void append(const QList<Position>& positions, int first, int count);
+
+    /**
+     * @brief mid returns count waypoints starting at first (all of the rest if count is negative)
+     */
+    FlightPath mid(int first, int count = -1) const;
+
+    QList<Position> toList() const;
+
+    bool operator ==(const FlightPath& other) const;
+    bool operator !=(const FlightPath& other) const;
+
+private:
+    QVector<qreal> _longitudes;
+    QVector<qreal> _latitudes;
+    QVector<qreal> _altitudes;
+};
+
+#endif // FLIGHTPATH_H
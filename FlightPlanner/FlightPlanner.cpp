@@ -1,19 +1,64 @@
 #include "FlightPlanner.h"
 
+#include <QMutexLocker>
+
+#include "AllocationTracker.h"
+#include "JobSystem.h"
+
+//How often publishStatistics() actually publishes, in milliseconds
+const qint64 STATISTICS_PUBLISH_INTERVAL = 250;
+
+/*
+ * FlightPlannerThread just calls back into the planner's iteration loop. The planner object itself
+ * stays on its original thread so that its slots and timers keep working there.
+*/
+class FlightPlannerThread : public QThread
+{
+public:
+    explicit FlightPlannerThread(FlightPlanner * planner) : QThread(planner), _planner(planner)
+    {
+    }
+
+protected:
+    //virtual from QThread
+    virtual void run()
+    {
+        _planner->_runPlanningLoop();
+    }
+
+private:
+    FlightPlanner * _planner;
+};
+
 FlightPlanner::FlightPlanner(QSharedPointer<PlanningProblem> prob,
                              QObject *parent) :
-    QObject(parent), _prob(prob), _iterations(0)
+    QObject(parent), _prob(prob), _executionMode(TimerExecution), _status(Stopped),
+    _timeBudget(0), _nodeBudget(0), _iterations(0), _randomSeed(0), _bestFlightVersion(0)
 {
+    //So we can emit our signals across threads in ThreadExecution mode
+    qRegisterMetaType<FlightPlanner::PlanningStatus>("FlightPlanner::PlanningStatus");
+    qRegisterMetaType<QList<Position> >("QList<Position>");
+    qRegisterMetaType<PlanningStatistics>("PlanningStatistics");
+
+    _statisticsPublishClock.invalidate();
+
     _planningTimer = new QTimer(this);
     connect(_planningTimer,
             SIGNAL(timeout()),
             this,
             SLOT(handlePlanningTimerTimeout()));
+
+    _planningThread = new FlightPlannerThread(this);
+    connect(_planningThread,
+            SIGNAL(finished()),
+            this,
+            SLOT(handlePlanningThreadFinished()));
 }
 
 FlightPlanner::~FlightPlanner()
 {
-    this->pausePlanning();
+    this->finishPlanningThread();
+    _planningTimer->stop();
     _prob.clear();
 }
 
@@ -24,23 +69,65 @@ QSharedPointer<PlanningProblem> FlightPlanner::problem() const
 
 void FlightPlanner::setProblem(QSharedPointer<PlanningProblem> nProb)
 {
+    //The worker thread must not be looking at the old problem while we swap it out
+    this->finishPlanningThread();
+
     _prob = nProb;
     this->resetPlanning();
 }
 
 Fitness FlightPlanner::bestFitnessSoFar() const
 {
+    QMutexLocker lock(&_bestLock);
     return _bestFitnessSoFar;
 }
 
-const QList<Position> &FlightPlanner::bestFlightSoFar() const
+QList<Position> FlightPlanner::bestFlightSoFar() const
 {
+    QMutexLocker lock(&_bestLock);
     return _bestFlightSoFar;
 }
 
-void FlightPlanner::setBestFlightSoFar(const QList<Position> &nFlight)
+QList<Position> FlightPlanner::bestFlightSoFar(quint32 *versionOut) const
 {
+    QMutexLocker lock(&_bestLock);
+    *versionOut = (quint32) _bestFlightVersion.loadAcquire();
+    return _bestFlightSoFar;
+}
+
+quint32 FlightPlanner::bestFlightVersion() const
+{
+    return (quint32) _bestFlightVersion.loadAcquire();
+}
+
+bool FlightPlanner::setBestFlightSoFar(const QList<Position> &nFlight)
+{
+    //The old flight may hold the last reference to its waypoints. Free them after the lock, not inside it.
+    QList<Position> oldFlight;
+
+    QMutexLocker lock(&_bestLock);
+    if (!_committedPrefix.isEmpty() && nFlight.mid(0, _committedPrefix.size()) != _committedPrefix)
+        return false;
+    oldFlight.swap(_bestFlightSoFar);
     _bestFlightSoFar = nFlight;
+    _bestFlightVersion.fetchAndAddOrdered(1);
+    lock.unlock();
+
+    //Queued automatically if we're on the worker thread. QList is implicitly shared so this is cheap.
+    this->bestFlightSoFarChanged(nFlight);
+    return true;
+}
+
+QList<Position> FlightPlanner::committedPrefix() const
+{
+    QMutexLocker lock(&_bestLock);
+    return _committedPrefix;
+}
+
+void FlightPlanner::setCommittedPrefix(const QList<Position> &prefix)
+{
+    QMutexLocker lock(&_bestLock);
+    _committedPrefix = prefix;
 }
 
 quint32 FlightPlanner::iterations() const
@@ -48,6 +135,75 @@ quint32 FlightPlanner::iterations() const
     return _iterations;
 }
 
+FlightPlanner::PlanningStatus FlightPlanner::status() const
+{
+    return _status;
+}
+
+FlightPlanner::ExecutionMode FlightPlanner::executionMode() const
+{
+    return _executionMode;
+}
+
+void FlightPlanner::setExecutionMode(FlightPlanner::ExecutionMode mode)
+{
+    if (mode == _executionMode)
+        return;
+
+    if (_status == Running)
+    {
+        this->pausePlanning();
+        this->finishPlanningThread();
+    }
+    _executionMode = mode;
+}
+
+quint64 FlightPlanner::randomSeed() const
+{
+    return _randomSeed;
+}
+
+void FlightPlanner::setRandomSeed(quint64 seed)
+{
+    _randomSeed = seed;
+}
+
+PlanningStatistics FlightPlanner::statistics() const
+{
+    QMutexLocker lock(&_bestLock);
+    return _statistics;
+}
+
+qint64 FlightPlanner::timeBudget() const
+{
+    return _timeBudget;
+}
+
+void FlightPlanner::setTimeBudget(qint64 msecs)
+{
+    _timeBudget = qMax<qint64>(0, msecs);
+}
+
+int FlightPlanner::nodeBudget() const
+{
+    return _nodeBudget;
+}
+
+void FlightPlanner::setNodeBudget(int nodes)
+{
+    _nodeBudget = qMax<int>(0, nodes);
+}
+
+const PlannerTuning &FlightPlanner::tuning() const
+{
+    return _tuning;
+}
+
+void FlightPlanner::setTuning(const PlannerTuning &tuning)
+{
+    _tuning = tuning;
+}
+
 //public slot
 void FlightPlanner::startPlanning()
 {
@@ -63,17 +219,47 @@ void FlightPlanner::startPlanning()
         return;
     }
 
+    //If a previous run is still winding down on the worker thread, let it finish first
+    if (_planningThread->isRunning())
+        this->finishPlanningThread();
+
+    _planningContext.setTimeBudget(_timeBudget);
+    _planningContext.setNodeBudget(_nodeBudget);
+    _planningContext.start();
+    _runTuning = _tuning;
+
+    //Nothing else is scoring right now, so this is the time to let the tasks build their scoring data
+    _prob->prepareScoring();
+
     //Have the concrete implementation do its setup
     this->doStart();
 
-    _planningTimer->start(0);
+    _status = Running;
+    if (_executionMode == ThreadExecution)
+        _planningThread->start();
+    else
+        _planningTimer->start(0);
     this->plannerStatusChanged(Running);
 }
 
 //public slot
 void FlightPlanner::pausePlanning()
 {
+    _planningContext.cancel();
+
+    /*
+     * Concrete planners sometimes pause themselves from inside doIteration(), which is on the worker thread
+     * in ThreadExecution mode. The timer and our status belong to our own thread, so leave those alone.
+     * handlePlanningThreadFinished() will announce that we're paused when the worker returns.
+    */
+    if (QThread::currentThread() != this->thread())
+        return;
+
     _planningTimer->stop();
+    if (_executionMode == ThreadExecution && _planningThread->isRunning())
+        return;
+
+    _status = Paused;
     this->plannerStatusChanged(Paused);
 }
 
@@ -81,13 +267,22 @@ void FlightPlanner::pausePlanning()
 void FlightPlanner::resetPlanning()
 {
     this->pausePlanning();
+
+    //doReset() wipes out state that the worker thread may be using
+    this->finishPlanningThread();
+
     this->doReset();
+    _workingStatistics.clear();
 
+    QMutexLocker lock(&_bestLock);
     _bestFitnessSoFar = Fitness();
     _bestFlightSoFar.clear();
+    _bestFlightVersion.fetchAndAddOrdered(1);
+    _statistics = _workingStatistics;
+    lock.unlock();
     _iterations = 0;
 
-
+    _status = Stopped;
     this->plannerProgressChanged(0.0,0);
     this->plannerStatusChanged(Stopped);
 }
@@ -95,17 +290,109 @@ void FlightPlanner::resetPlanning()
 //protected
 void FlightPlanner::setBestFitnessSoFar(const Fitness &nBest)
 {
+    QMutexLocker lock(&_bestLock);
     _bestFitnessSoFar = nBest;
 }
 
-//private slot
-//The timer calls this one, which will call the polymorphic instance
-void FlightPlanner::handlePlanningTimerTimeout()
+//protected
+bool FlightPlanner::planningInterrupted() const
+{
+    return _planningContext.shouldStop();
+}
+
+//protected
+const PlanningContext *FlightPlanner::planningContext() const
+{
+    return &_planningContext;
+}
+
+//protected
+const PlannerTuning &FlightPlanner::runTuning() const
+{
+    return _runTuning;
+}
+
+//protected
+PlanningStatistics *FlightPlanner::workingStatistics()
+{
+    return &_workingStatistics;
+}
+
+//protected
+void FlightPlanner::publishStatistics()
+{
+    if (_statisticsPublishClock.isValid() && _statisticsPublishClock.elapsed() < STATISTICS_PUBLISH_INTERVAL)
+        return;
+    _publishStatistics();
+}
+
+//protected
+void FlightPlanner::finishPlanningThread()
+{
+    if (!_planningThread->isRunning())
+        return;
+
+    _planningContext.cancel();
+    _planningThread->wait();
+}
+
+//private
+//Runs on the worker thread in ThreadExecution mode
+void FlightPlanner::_runPlanningLoop()
+{
+    while (!this->planningInterrupted())
+        _doOneIteration();
+}
+
+//private
+void FlightPlanner::_doOneIteration()
 {
     //Have the concrete implementation do its thing
     this->doIteration();
+    _publishStatistics();
 
     //Then update anyone watching us with the number of iterations we've done and the best fitness so far
     this->plannerProgressChanged(this->bestFitnessSoFar().combined(),
                                   ++_iterations);
 }
+
+//private
+void FlightPlanner::_publishStatistics()
+{
+    //Memory and the job system are process-wide, so every planner reports the same, as of when it publishes
+    AllocationTracker::addToStatistics(&_workingStatistics);
+    JobSystem::shared()->addToStatistics(&_workingStatistics);
+
+    QMutexLocker lock(&_bestLock);
+    _statistics = _workingStatistics;
+    lock.unlock();
+
+    _statisticsPublishClock.start();
+    this->plannerStatisticsChanged(_workingStatistics);
+}
+
+//private slot
+//The timer calls this one, which will call the polymorphic instance
+void FlightPlanner::handlePlanningTimerTimeout()
+{
+    _doOneIteration();
+
+    //The worker thread's loop stops by itself when a budget runs out, but the timer has to be told
+    if (_status == Running && this->planningInterrupted())
+        this->pausePlanning();
+}
+
+//private slot
+void FlightPlanner::handlePlanningThreadFinished()
+{
+    //If we were reset or paused explicitly we've already announced our status
+    if (_status != Running)
+        return;
+
+    //The notice from a run that was paused and started again before it got here
+    if (_planningThread->isRunning())
+        return;
+
+    _status = Paused;
+    this->plannerStatusChanged(Paused);
+}
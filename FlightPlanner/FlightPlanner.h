@@ -4,9 +4,17 @@
 #include <QObject>
 #include <QSharedPointer>
 #include <QTimer>
+#include <QThread>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QMetaType>
+#include <QElapsedTimer>
 
 #include "PlanningProblem.h"
 #include "Fitness.h"
+#include "PlanningStatistics.h"
+#include "PlanningContext.h"
+#include "PlannerTuning.h"
 
 class FlightPlanner : public QObject
 {
@@ -18,6 +26,19 @@ public:
         Running,
         Paused
     };
+
+    /**
+     * @brief The ExecutionMode enum describes where doIteration() runs.
+     * TimerExecution calls it from a zero-interval QTimer on the planner's own thread (usually the GUI thread).
+     * ThreadExecution calls it in a loop on a dedicated QThread. Progress, status and best-flight signals are
+     * then delivered to the planner's thread through queued connections.
+     */
+    enum ExecutionMode
+    {
+        TimerExecution,
+        ThreadExecution
+    };
+
 public:
     explicit FlightPlanner(QSharedPointer<PlanningProblem> prob = QSharedPointer<PlanningProblem>(),
                            QObject *parent = 0);
@@ -28,15 +49,106 @@ public:
 
     Fitness bestFitnessSoFar() const;
 
-    const QList<Position>& bestFlightSoFar() const;
-    void setBestFlightSoFar(const QList<Position>& nFlight);
+    /**
+     * @brief bestFlightSoFar returns a snapshot of the best flight found so far. Safe to call while
+     * the planner is running on its own thread. The snapshot shares its waypoints with the planner until one
+     * side changes them, so taking it copies nothing and only holds the planner up for a reference count.
+     * @return
+     */
+    QList<Position> bestFlightSoFar() const;
+
+    /**
+     * @brief bestFlightSoFar returns the same snapshot as bestFlightSoFar() along with its version
+     * @param versionOut set to the bestFlightVersion() of the returned flight
+     * @return
+     */
+    QList<Position> bestFlightSoFar(quint32 * versionOut) const;
+
+    /**
+     * @brief bestFlightVersion returns a number that changes every time the best flight is replaced. Reading it
+     * never waits on the planner, so consumers that poll or that get behind on bestFlightSoFarChanged() can check
+     * it and skip flights they've already seen.
+     * @return
+     */
+    quint32 bestFlightVersion() const;
+
+    /**
+     * @brief setBestFlightSoFar replaces the best flight, unless it doesn't start with the committed prefix
+     * @param nFlight
+     * @return false if the flight was turned away because of the committed prefix
+     */
+    bool setBestFlightSoFar(const QList<Position>& nFlight);
+
+    /**
+     * @brief committedPrefix returns the waypoints that have already been handed on (e.g., streamed to the aircraft
+     * by a FlightPrefixStreamer) and can't be taken back. Flights that don't start with them never become the
+     * best flight. Empty (the default) allows any flight. Resets keep it.
+     * @return
+     */
+    QList<Position> committedPrefix() const;
+    void setCommittedPrefix(const QList<Position>& prefix);
 
     quint32 iterations() const;
-    
+
+    FlightPlanner::PlanningStatus status() const;
+
+    FlightPlanner::ExecutionMode executionMode() const;
+
+    /**
+     * @brief setExecutionMode chooses between running iterations from a QTimer or on a worker thread.
+     * Planning is paused if it is running when this is called.
+     * @param mode
+     */
+    void setExecutionMode(FlightPlanner::ExecutionMode mode);
+
+    /**
+     * @brief randomSeed is handed to every randomized component the planner creates, so repeating a run with
+     * the same problem and seed gives the same flight. Defaults to 0.
+     * @return
+     */
+    quint64 randomSeed() const;
+    void setRandomSeed(quint64 seed);
+
+    /**
+     * @brief statistics returns a snapshot of the stage timings and counters the planner had collected at the
+     * end of its last iteration. Safe to call while the planner is running on its own thread. While allocation
+     * tracking is on, it includes each subsystem's live and peak bytes (see AllocationTracker::addToStatistics()).
+     * @return
+     */
+    PlanningStatistics statistics() const;
+
+    /**
+     * @brief timeBudget returns how many milliseconds each run (from startPlanning() to pausing) may take. Once
+     * it's spent the planner interrupts its searches and pauses itself, as if pausePlanning() had been called.
+     * 0 (the default) means no limit. Changes apply from the next startPlanning().
+     * @return
+     */
+    qint64 timeBudget() const;
+    void setTimeBudget(qint64 msecs);
+
+    /**
+     * @brief nodeBudget returns how many nodes (samples drawn, states expanded...) each run's searches may charge
+     * to the planning context before the planner pauses itself. 0 (the default) means no limit. Changes apply from
+     * the next startPlanning().
+     * @return
+     */
+    int nodeBudget() const;
+    void setNodeBudget(int nodes);
+
+    /**
+     * @brief tuning returns the search parameters the planner hands to its searches (see PlannerTuning). Planners
+     * use the ones that apply to them and ignore the rest. Changes apply from the next startPlanning().
+     * @return
+     */
+    const PlannerTuning& tuning() const;
+    void setTuning(const PlannerTuning& tuning);
+
 signals:
     void plannerProgressChanged(qreal fitness, quint32 iterations);
     void plannerStatusChanged(FlightPlanner::PlanningStatus status);
-    
+    void bestFlightSoFarChanged(const QList<Position>& flight);
+    void plannerStatisticsChanged(const PlanningStatistics& statistics);
+
 public slots:
     void startPlanning();
     void pausePlanning();
@@ -44,24 +156,108 @@ public slots:
 
 protected:
     virtual void doStart()=0;
+
+    /**
+     * @brief doIteration is called over and over while planning runs. Each call should do a bounded step of
+     * work and return, keeping whatever it needs to pick up where it left off: in TimerExecution mode nothing
+     * else on the planner's thread runs until it does, and progress and statistics are published between calls.
+     * A planner that's finished pauses itself with pausePlanning().
+     */
     virtual void doIteration()=0;
     virtual void doReset()=0;
 
     void setBestFitnessSoFar(const Fitness& nBest);
 
+    /**
+     * @brief planningInterrupted is a cooperative cancellation checkpoint. Long-running loops inside
+     * doIteration() should check it regularly and return early when it is true.
+     * @return true if pausePlanning() or resetPlanning() has been requested since planning started, or if the
+     * run's time or node budget is spent
+     */
+    bool planningInterrupted() const;
+
+    /**
+     * @brief planningContext returns the context planningInterrupted() checks, for handing to the searches (and
+     * jobs on other threads) that doIteration() runs. It lives as long as the planner.
+     * @return
+     */
+    const PlanningContext * planningContext() const;
+
+    /**
+     * @brief runTuning returns the tuning as it was when the current run started, which is what doStart() and
+     * doIteration() should search with
+     * @return
+     */
+    const PlannerTuning& runTuning() const;
+
+    /**
+     * @brief workingStatistics returns the statistics the planner is collecting. Only doIteration() and
+     * doReset() should touch them. They're published after every iteration and cleared on reset.
+     * @return
+     */
+    PlanningStatistics * workingStatistics();
+
+    /**
+     * @brief publishStatistics publishes the working statistics in the middle of an iteration, so that long
+     * iterations show progress. Calls closer together than a quarter second are ignored, so loops can call it
+     * as often as they like.
+     */
+    void publishStatistics();
+
+    /**
+     * @brief finishPlanningThread interrupts the worker thread (if any) and blocks until it is done.
+     * Concrete planners must call this from their destructors so the worker never calls doIteration() on a
+     * partially-destroyed object.
+     */
+    void finishPlanningThread();
+
 private:
+    void _runPlanningLoop();
+    void _doOneIteration();
+    void _publishStatistics();
+
     QSharedPointer<PlanningProblem> _prob;
     QTimer * _planningTimer;
+    QThread * _planningThread;
+
+    ExecutionMode _executionMode;
+    PlanningStatus _status;
+
+    //Cancelled by pausePlanning() and friends. Its budgets are copied from ours by startPlanning().
+    PlanningContext _planningContext;
+    qint64 _timeBudget;
+    int _nodeBudget;
+    PlannerTuning _tuning;
+    PlannerTuning _runTuning;
 
     quint32 _iterations;
+    quint64 _randomSeed;
 
+    //Guards the best fitness/flight and published statistics, which the worker thread writes and anyone may read
+    mutable QMutex _bestLock;
     Fitness _bestFitnessSoFar;
     QList<Position> _bestFlightSoFar;
+    QList<Position> _committedPrefix;
+    //Bumped (inside _bestLock) whenever _bestFlightSoFar is replaced. Read without it.
+    QAtomicInt _bestFlightVersion;
+    PlanningStatistics _statistics;
+
+    //Only the planning thread touches these. They're copied into _statistics after every iteration.
+    PlanningStatistics _workingStatistics;
+    QElapsedTimer _statisticsPublishClock;
+
+    friend class FlightPlannerThread;
 
 private slots:
     //The timer calls this one, which will call the polymorphic instance
     void handlePlanningTimerTimeout();
-    
+
+    //Called (on our thread) when the worker thread returns
+    void handlePlanningThreadFinished();
+
 };
 
+Q_DECLARE_METATYPE(FlightPlanner::PlanningStatus)
+Q_DECLARE_METATYPE(QList<Position>)
+
 #endif // FLIGHTPLANNER_H
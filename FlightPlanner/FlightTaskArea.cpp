@@ -7,18 +7,21 @@
 #include "FlightTasks/NoFlyFlightTask.h"
 #include "FlightTasks/SamplingTask.h"\
 
-FlightTaskArea::FlightTaskArea()
+FlightTaskArea::FlightTaskArea() :
+    _areaName("Untitled"), _version(0)
 {
-    this->setAreaName("Untitled");
+    this->_createChangeCoalescer();
 }
 
 FlightTaskArea::FlightTaskArea(const QPolygonF &geoPoly) :
-    _geoPoly(geoPoly)
+    _geoPoly(geoPoly), _version(0)
 {
+    this->_createChangeCoalescer();
 }
 
 //for de-serializing
-FlightTaskArea::FlightTaskArea(QDataStream &stream)
+FlightTaskArea::FlightTaskArea(QDataStream &stream) :
+    _version(0)
 {
     stream >> _geoPoly;
     stream >> _areaName;
@@ -46,7 +49,15 @@ FlightTaskArea::FlightTaskArea(QDataStream &stream)
         }
         FlightTask::_uuidToWeakTask.insert(task->uuid(), task.toWeakRef()); //For inter-task dependencies
         _tasks.append(task);
+
+        //Same as addTask(), so that edits to loaded tasks count as edits to the area
+        connect(task.data(),
+                SIGNAL(flightTaskChanged()),
+                this,
+                SLOT(handleTaskChanged()));
     }
+
+    this->_createChangeCoalescer();
 }
 
 //pure-virtual from Serializable
@@ -89,12 +100,12 @@ void FlightTaskArea::addTask(QSharedPointer<FlightTask> task)
     _tasks.append(task);
 
     this->taskAdded(task);
-    this->flightTaskAreaChanged();
+    this->_markChanged();
 
     connect(task.data(),
             SIGNAL(flightTaskChanged()),
             this,
-            SIGNAL(flightTaskAreaChanged()));
+            SLOT(handleTaskChanged()));
 }
 
 void FlightTaskArea::removeTask(QSharedPointer<FlightTask> task)
@@ -108,9 +119,10 @@ void FlightTaskArea::removeTask(QSharedPointer<FlightTask> task)
 
     this->taskAboutToRemove(index);
     _tasks.removeOne(task);
+    disconnect(task.data(), 0, this, 0);
     this->taskRemoved(task);
 
-    this->flightTaskAreaChanged();
+    this->_markChanged();
 }
 
 int FlightTaskArea::numTasks() const
@@ -123,19 +135,65 @@ const QString &FlightTaskArea::areaName() const
     return _areaName;
 }
 
+quint64 FlightTaskArea::version() const
+{
+    return _version;
+}
+
+void FlightTaskArea::beginUpdate()
+{
+    _changes->beginUpdate();
+}
+
+void FlightTaskArea::endUpdate()
+{
+    _changes->endUpdate();
+}
+
 //public slot
 void FlightTaskArea::setGeoPoly(const QPolygonF &nPoly)
 {
+    //The map object sends back what it's just been given
+    if (nPoly == _geoPoly)
+        return;
+
     _geoPoly = nPoly;
 
     this->geoPolyChanged(_geoPoly);
-    this->flightTaskAreaChanged();
+    this->_markChanged();
 }
 
 //public slot
 void FlightTaskArea::setAreaName(const QString &nName)
 {
+    if (nName == _areaName)
+        return;
+
     _areaName = nName;
     this->flightTaskAreaNameChanged();
-    this->flightTaskAreaChanged();
+    this->_markChanged();
+}
+
+//private slot
+void FlightTaskArea::handleTaskChanged()
+{
+    this->_markChanged();
+}
+
+//private
+void FlightTaskArea::_createChangeCoalescer()
+{
+    _changes = new ChangeCoalescer(this);
+    connect(_changes,
+            SIGNAL(changed()),
+            this,
+            SIGNAL(flightTaskAreaChanged()));
+}
+
+//private
+void FlightTaskArea::_markChanged()
+{
+    _version++;
+    this->flightTaskAreaEdited();
+    _changes->markChanged();
 }
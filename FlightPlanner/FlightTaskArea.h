@@ -9,6 +9,7 @@
 
 #include "FlightTasks/FlightTask.h"
 #include "Serializable.h"
+#include "ChangeCoalescer.h"
 
 class FlightTaskArea : public QObject, public Serializable
 {
@@ -35,9 +36,30 @@ public:
 
     const QString& areaName() const;
 
+    /**
+     * @brief version counts the edits to the area, including edits to its tasks. Snapshots of the problem
+     * remember it so that they can tell which areas changed since they were taken (see CompiledProblem).
+     * @return
+     */
+    quint64 version() const;
+
+    /**
+     * @brief beginUpdate holds flightTaskAreaChanged() back until the matching endUpdate(), so that many edits
+     * give one signal. Updates nest. See also UpdateScope.
+     */
+    void beginUpdate();
+    void endUpdate();
     
 signals:
+    /**
+     * @brief flightTaskAreaChanged is emitted once per event-loop turn in which the area or its tasks were edited
+     * (and only once no update is open), however many edits that turn made
+     */
     void flightTaskAreaChanged();
+
+    //Emitted right away for every edit, for the few listeners that can't wait for flightTaskAreaChanged()
+    void flightTaskAreaEdited();
+
     void geoPolyChanged(const QPolygonF& geoPoly);
     void taskChanged(QSharedPointer<FlightTask> task);
     void taskAboutToAdd();
@@ -50,11 +72,20 @@ public slots:
     void setGeoPoly(const QPolygonF& nPoly);
     void setAreaName(const QString& nName);
 
+private slots:
+    void handleTaskChanged();
+
 private:
+    void _createChangeCoalescer();
+    void _markChanged();
+
     QPolygonF _geoPoly;
     QList<QSharedPointer<FlightTask> > _tasks;
 
     QString _areaName;
+
+    quint64 _version;
+    ChangeCoalescer * _changes;
     
 };
 
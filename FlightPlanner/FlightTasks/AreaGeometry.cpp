@@ -0,0 +1,59 @@
+#include "AreaGeometry.h"
+
+AreaGeometry::AreaGeometry(const QPolygonF &geoPoly, const AreaGeometry *previous) :
+    _geoPoly(geoPoly)
+{
+    if (previous != 0 && previous->_geoPoly == geoPoly)
+    {
+        _polygonIndex = previous->_polygonIndex;
+        _bins = previous->_bins;
+    }
+    else
+        _polygonIndex.build(geoPoly);
+}
+
+const QPolygonF &AreaGeometry::geoPoly() const
+{
+    return _geoPoly;
+}
+
+const PolygonIndex &AreaGeometry::polygonIndex() const
+{
+    return _polygonIndex;
+}
+
+CoverageBins AreaGeometry::prepareCoverageBins(qreal granularity)
+{
+    _prepared.insert(granularity);
+    QMap<qreal, CoverageBins>::iterator found = _bins.find(granularity);
+    if (found != _bins.end())
+        return found.value();
+
+    CoverageBins toRet;
+    toRet.build(_geoPoly, granularity);
+    _bins.insert(granularity, toRet);
+    return toRet;
+}
+
+void AreaGeometry::finishPreparing()
+{
+    QMap<qreal, CoverageBins>::iterator iter = _bins.begin();
+    while (iter != _bins.end())
+    {
+        if (_prepared.contains(iter.key()))
+            iter++;
+        else
+            iter = _bins.erase(iter);
+    }
+}
+
+CoverageBins AreaGeometry::coverageBins(qreal granularity) const
+{
+    QMap<qreal, CoverageBins>::const_iterator found = _bins.constFind(granularity);
+    if (found != _bins.constEnd())
+        return found.value();
+
+    CoverageBins toRet;
+    toRet.build(_geoPoly, granularity);
+    return toRet;
+}
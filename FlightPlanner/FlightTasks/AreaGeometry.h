@@ -0,0 +1,64 @@
+#ifndef AREAGEOMETRY_H
+#define AREAGEOMETRY_H
+
+#include <QtGlobal>
+#include <QMap>
+#include <QPolygonF>
+#include <QSet>
+
+#include "CoverageBins.h"
+#include "PolygonIndex.h"
+
+/**
+ * @brief The AreaGeometry class is what the tasks of one area share for scoring: the area's PolygonIndex and its
+ * CoverageBins, one grid per granularity that a task asked for. Several coverage tasks over the same area (at
+ * the same granularity) share one grid instead of each building their own.
+ *
+ * PlanningProblem::prepareScoring() builds a new one for every area each time and hands it to the area's tasks
+ * (see FlightTask::prepareAreaScoring()). Grids are taken over from the area's previous AreaGeometry when the area
+ * hasn't moved, so only new areas and granularities are built. Once prepared it's never modified, so any number of
+ * threads can score with it at once.
+ */
+class AreaGeometry
+{
+public:
+    /**
+     * @brief AreaGeometry
+     * @param geoPoly
+     * @param previous the area's last AreaGeometry, whose grids are reused if it's of the same polygon. May be 0.
+     */
+    AreaGeometry(const QPolygonF& geoPoly, const AreaGeometry * previous = 0);
+
+    const QPolygonF& geoPoly() const;
+    const PolygonIndex& polygonIndex() const;
+
+    /**
+     * @brief prepareCoverageBins returns the grid at the given granularity, building it (or taking it over from the
+     * previous AreaGeometry) the first time it's asked for. For tasks to call while they're being prepared.
+     * @param granularity
+     * @return
+     */
+    CoverageBins prepareCoverageBins(qreal granularity);
+
+    /**
+     * @brief finishPreparing drops the grids taken over from the previous AreaGeometry that no task asked for
+     */
+    void finishPreparing();
+
+    /**
+     * @brief coverageBins returns the prepared grid at the given granularity. Ones that weren't prepared are
+     * built on the spot (and not kept), which is correct but slow.
+     * @param granularity
+     * @return
+     */
+    CoverageBins coverageBins(qreal granularity) const;
+
+private:
+    QPolygonF _geoPoly;
+    PolygonIndex _polygonIndex;
+
+    QMap<qreal, CoverageBins> _bins;
+    QSet<qreal> _prepared;
+};
+
+#endif // AREAGEOMETRY_H
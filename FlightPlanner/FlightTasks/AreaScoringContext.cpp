@@ -0,0 +1,75 @@
+#include "AreaScoringContext.h"
+
+#include "AreaGeometry.h"
+#include "guts/Conversions.h"
+
+AreaScoringContext::AreaScoringContext(const AreaGeometry &geometry,
+                                       const QList<Position> &positions,
+                                       const UAVParameters &uavParams) :
+    _geometry(geometry), _positions(positions), _uavParams(uavParams),
+    _insideKnown(false), _insideCount(0), _xyzKnown(false)
+{
+}
+
+const AreaGeometry &AreaScoringContext::geometry() const
+{
+    return _geometry;
+}
+
+const QPolygonF &AreaScoringContext::geoPoly() const
+{
+    return _geometry.geoPoly();
+}
+
+const QList<Position> &AreaScoringContext::positions() const
+{
+    return _positions;
+}
+
+const UAVParameters &AreaScoringContext::uavParams() const
+{
+    return _uavParams;
+}
+
+const QVector<bool> &AreaScoringContext::inside() const
+{
+    if (_insideKnown)
+        return _inside;
+
+    QVector<qreal> lons(_positions.size());
+    QVector<qreal> lats(_positions.size());
+    for (int i = 0; i < _positions.size(); i++)
+    {
+        lons[i] = _positions.at(i).longitude();
+        lats[i] = _positions.at(i).latitude();
+    }
+    _inside.resize(_positions.size());
+    _geometry.polygonIndex().contains(lons.constData(), lats.constData(), _positions.size(), _inside.data());
+
+    _insideCount = 0;
+    foreach(bool isInside, _inside)
+    {
+        if (isInside)
+            _insideCount++;
+    }
+    _insideKnown = true;
+    return _inside;
+}
+
+int AreaScoringContext::insideCount() const
+{
+    this->inside();
+    return _insideCount;
+}
+
+const QVector<QVector3D> &AreaScoringContext::xyz() const
+{
+    if (_xyzKnown)
+        return _xyz;
+
+    _xyz.resize(_positions.size());
+    for (int i = 0; i < _positions.size(); i++)
+        _xyz[i] = Conversions::lla2xyz(_positions.at(i));
+    _xyzKnown = true;
+    return _xyz;
+}
@@ -0,0 +1,67 @@
+#ifndef AREASCORINGCONTEXT_H
+#define AREASCORINGCONTEXT_H
+
+#include <QtGlobal>
+#include <QList>
+#include <QPolygonF>
+#include <QVector>
+#include <QVector3D>
+
+#include "Position.h"
+#include "UAVParameters.h"
+
+class AreaGeometry;
+
+/**
+ * @brief The AreaScoringContext class is one flight being scored over one area, shared by all of the area's tasks
+ * (see FlightTask::calculateAreaPerformance()). What the tasks want to know about the flight is worked out the
+ * first time one of them asks and kept for the others: which positions are inside the area, and the positions
+ * in ECEF coordinates.
+ *
+ * A context belongs to the thread scoring the flight. The geometry, positions and parameters are referenced, not
+ * copied, so they must outlive it.
+ */
+class AreaScoringContext
+{
+public:
+    AreaScoringContext(const AreaGeometry& geometry,
+                       const QList<Position>& positions,
+                       const UAVParameters& uavParams);
+
+    const AreaGeometry& geometry() const;
+    const QPolygonF& geoPoly() const;
+    const QList<Position>& positions() const;
+    const UAVParameters& uavParams() const;
+
+    /**
+     * @brief inside returns whether each position is inside the area by the odd-even rule
+     * @return
+     */
+    const QVector<bool>& inside() const;
+
+    /**
+     * @brief insideCount returns how many positions are inside the area
+     * @return
+     */
+    int insideCount() const;
+
+    /**
+     * @brief xyz returns Conversions::lla2xyz() of each position
+     * @return
+     */
+    const QVector<QVector3D>& xyz() const;
+
+private:
+    const AreaGeometry& _geometry;
+    const QList<Position>& _positions;
+    const UAVParameters& _uavParams;
+
+    mutable bool _insideKnown;
+    mutable QVector<bool> _inside;
+    mutable int _insideCount;
+
+    mutable bool _xyzKnown;
+    mutable QVector<QVector3D> _xyz;
+};
+
+#endif // AREASCORINGCONTEXT_H
@@ -0,0 +1,323 @@
+#include "CoverageBins.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "guts/Conversions.h"
+
+const qreal DEG2RAD = 3.1415926535897932384626433 / 180.0;
+
+//Rows checked against a position at once by the distance kernel
+const int ROW_BLOCK = 64;
+
+CoverageBins::CoverageBins()
+{
+    this->clear();
+}
+
+void CoverageBins::build(const QPolygonF &geoPoly, qreal granularity)
+{
+    this->clear();
+    _geoPoly = geoPoly;
+    _granularity = granularity;
+
+    const QRectF boundingRect = geoPoly.boundingRect().normalized();
+
+    const QVector3D topLeftXYZ(Conversions::lla2xyz(boundingRect.topRight()));
+    const QVector3D bottomLeftXYZ(Conversions::lla2xyz(boundingRect.bottomRight()));
+    const QVector3D topRightXYZ(Conversions::lla2xyz(boundingRect.topLeft()));
+
+    const qreal widthMeters = (topLeftXYZ - topRightXYZ).length();
+    const qreal heightMeters = (topLeftXYZ - bottomLeftXYZ).length();
+
+    _left = boundingRect.topLeft().x();
+    _bottom = boundingRect.topLeft().y();
+    _lonPerMeter = Conversions::degreesLonPerMeter(boundingRect.center().y());
+    _latPerMeter = Conversions::degreesLatPerMeter(boundingRect.center().y());
+    _offset = _granularity / 2;
+    _columns = qMax<int>(0, (int) ceil(widthMeters / _granularity));
+    _rows = qMax<int>(0, (int) ceil(heightMeters / _granularity));
+    if (_columns == 0 || _rows == 0 || geoPoly.isEmpty())
+        return;
+
+    //Trigonometry for every column and row, so no cell needs its own
+    _columnCos.resize(_columns);
+    _columnSin.resize(_columns);
+    for (int column = 0; column < _columns; column++)
+    {
+        const qreal radians = _lon(column) * DEG2RAD;
+        _columnCos[column] = cos(radians);
+        _columnSin[column] = sin(radians);
+    }
+
+    QVector<qreal> lats(_rows);
+    for (int row = 0; row < _rows; row++)
+        lats[row] = _lat(row);
+    const QVector<qreal> zeros(_rows, 0.0);
+    QVector<qreal> ys(_rows);
+    _rowRadii.resize(_rows);
+    _rowZ.resize(_rows);
+    Conversions::lla2xyz(lats.constData(), zeros.constData(), zeros.constData(),
+                         _rows,
+                         _rowRadii.data(), ys.data(), _rowZ.data());
+
+    //Scan every row across the area. A cell is a bin if an odd number of boundary crossings are west of it.
+    _mask.resize(_columns * _rows);
+    QVector<qreal> crossings;
+    for (int row = 0; row < _rows; row++)
+    {
+        const qreal lat = lats.at(row);
+
+        crossings.clear();
+        for (int i = 0; i < geoPoly.size(); i++)
+        {
+            QPointF low = geoPoly.at(i);
+            QPointF high = (i + 1 < geoPoly.size()) ? geoPoly.at(i + 1) : geoPoly.first();
+            if (i + 1 == geoPoly.size() && low == high)
+                break;
+            if (qFuzzyCompare(low.y(), high.y()))
+                continue;
+            else if (low.y() > high.y())
+                qSwap(low, high);
+            if (lat < low.y() || lat >= high.y())
+                continue;
+
+            //Computed exactly the way QPolygonF does so that we agree on bins right at an edge
+            crossings.append(low.x() + ((high.x() - low.x()) / (high.y() - low.y())) * (lat - low.y()));
+        }
+        std::sort(crossings.begin(), crossings.end());
+
+        int west = 0;
+        for (int column = 0; column < _columns; column++)
+        {
+            const qreal lon = _lon(column);
+            while (west < crossings.size() && crossings.at(west) <= lon)
+                west++;
+            if (west % 2 == 0)
+                continue;
+            _mask.setBit(column * _rows + row);
+            _count++;
+        }
+    }
+}
+
+void CoverageBins::clear()
+{
+    _geoPoly.clear();
+    _granularity = 1.0;
+    _left = _bottom = 0.0;
+    _lonPerMeter = _latPerMeter = 0.0;
+    _offset = 0;
+    _columns = _rows = 0;
+    _mask.clear();
+    _count = 0;
+    _columnCos.clear();
+    _columnSin.clear();
+    _rowRadii.clear();
+    _rowZ.clear();
+}
+
+const QPolygonF &CoverageBins::geoPoly() const
+{
+    return _geoPoly;
+}
+
+qreal CoverageBins::granularity() const
+{
+    return _granularity;
+}
+
+bool CoverageBins::isEmpty() const
+{
+    return _count == 0;
+}
+
+int CoverageBins::count() const
+{
+    return _count;
+}
+
+int CoverageBins::cellCount() const
+{
+    return _mask.size();
+}
+
+bool CoverageBins::isBin(int cell) const
+{
+    return _mask.testBit(cell);
+}
+
+int CoverageBins::columns() const
+{
+    return _columns;
+}
+
+int CoverageBins::rows() const
+{
+    return _rows;
+}
+
+void CoverageBins::gridCoordinates(const Position &lla, qreal *column, qreal *row) const
+{
+    *column = (lla.longitude() - _lon(0)) / (_granularity * _lonPerMeter);
+    *row = (lla.latitude() - _lat(0)) / (_granularity * _latPerMeter);
+}
+
+int CoverageBins::nextBin(int cell) const
+{
+    while (cell < _mask.size() && !_mask.testBit(cell))
+        cell++;
+    return cell;
+}
+
+Position CoverageBins::lla(int cell) const
+{
+    return Position(_lon(cell / _rows), _lat(cell % _rows));
+}
+
+QVector3D CoverageBins::xyz(int cell) const
+{
+    const int column = cell / _rows;
+    const int row = cell % _rows;
+    return QVector3D(_rowRadii.at(row) * _columnCos.at(column),
+                     _rowRadii.at(row) * _columnSin.at(column),
+                     _rowZ.at(row));
+}
+
+void CoverageBins::binsWithin(const Position &lla, const QVector3D &xyz, qreal radius, QVector<int> *output) const
+{
+    int minColumn, maxColumn, minRow, maxRow;
+    if (output == 0 || !_blockAround(lla, radius, &minColumn, &maxColumn, &minRow, &maxRow))
+        return;
+
+    uchar hits[ROW_BLOCK];
+    for (int column = minColumn; column <= maxColumn; column++)
+    {
+        for (int firstRow = minRow; firstRow <= maxRow; firstRow += ROW_BLOCK)
+        {
+            const int count = qMin<int>(ROW_BLOCK, maxRow - firstRow + 1);
+            _rowsWithin(column, firstRow, count, xyz, radius * radius, hits);
+            for (int i = 0; i < count; i++)
+            {
+                const int cell = column * _rows + firstRow + i;
+                if (hits[i] && _mask.testBit(cell))
+                    output->append(cell);
+            }
+        }
+    }
+}
+
+int CoverageBins::satisfyWithin(const Position &lla, const QVector3D &xyz, qreal radius, QBitArray *satisfied,
+                                QVector<int> *newlySatisfied) const
+{
+    int minColumn, maxColumn, minRow, maxRow;
+    if (satisfied == 0 || !_blockAround(lla, radius, &minColumn, &maxColumn, &minRow, &maxRow))
+        return 0;
+
+    int toRet = 0;
+    uchar hits[ROW_BLOCK];
+    for (int column = minColumn; column <= maxColumn; column++)
+    {
+        for (int firstRow = minRow; firstRow <= maxRow; firstRow += ROW_BLOCK)
+        {
+            const int count = qMin<int>(ROW_BLOCK, maxRow - firstRow + 1);
+            _rowsWithin(column, firstRow, count, xyz, radius * radius, hits);
+            for (int i = 0; i < count; i++)
+            {
+                const int cell = column * _rows + firstRow + i;
+                if (!hits[i] || !_mask.testBit(cell) || satisfied->testBit(cell))
+                    continue;
+                satisfied->setBit(cell);
+                if (newlySatisfied)
+                    newlySatisfied->append(cell);
+                toRet++;
+            }
+        }
+    }
+    return toRet;
+}
+
+void CoverageBins::binsInside(const QRectF &geoRect, QVector<int> *output) const
+{
+    if (output == 0 || _count == 0)
+        return;
+
+    //The columns and rows whose centers fall inside the rectangle
+    const QRectF rect = geoRect.normalized();
+    const qreal columnWidth = _granularity * _lonPerMeter;
+    const qreal rowHeight = _granularity * _latPerMeter;
+    const int minColumn = qMax<int>(0, (int) ceil((rect.left() - _lon(0)) / columnWidth));
+    const int maxColumn = qMin<int>(_columns - 1, (int) floor((rect.right() - _lon(0)) / columnWidth));
+    const int minRow = qMax<int>(0, (int) ceil((rect.top() - _lat(0)) / rowHeight));
+    const int maxRow = qMin<int>(_rows - 1, (int) floor((rect.bottom() - _lat(0)) / rowHeight));
+
+    for (int column = minColumn; column <= maxColumn; column++)
+    {
+        for (int row = minRow; row <= maxRow; row++)
+        {
+            const int cell = column * _rows + row;
+            if (_mask.testBit(cell))
+                output->append(cell);
+        }
+    }
+}
+
+//private
+bool CoverageBins::_blockAround(const Position &lla, qreal radius,
+                                int *minColumn, int *maxColumn, int *minRow, int *maxRow) const
+{
+    if (_count == 0)
+        return false;
+
+    //Only look at the block of cells around the position, with a cell to spare for the earth's curvature
+    const qreal reach = radius / _granularity + 1.0;
+    qreal column;
+    qreal row;
+    this->gridCoordinates(lla, &column, &row);
+    if (column + reach < 0.0 || column - reach > _columns || row + reach < 0.0 || row - reach > _rows)
+        return false;
+    *minColumn = qMax<int>(0, (int) floor(column - reach));
+    *maxColumn = qMin<int>(_columns - 1, (int) ceil(column + reach));
+    *minRow = qMax<int>(0, (int) floor(row - reach));
+    *maxRow = qMin<int>(_rows - 1, (int) ceil(row + reach));
+    return true;
+}
+
+//private
+void CoverageBins::_rowsWithin(int column, int firstRow, int count,
+                               const QVector3D &xyz, qreal radiusSquared,
+                               uchar *hits) const
+{
+    const qreal cosLon = _columnCos.at(column);
+    const qreal sinLon = _columnSin.at(column);
+    const qreal * radii = _rowRadii.constData() + firstRow;
+    const qreal * zs = _rowZ.constData() + firstRow;
+    const qreal x = xyz.x();
+    const qreal y = xyz.y();
+    const qreal z = xyz.z();
+
+    //Squared distances over the row arrays with no branches or sqrt, so that the compiler can vectorize it
+    for (int i = 0; i < count; i++)
+    {
+        const qreal dx = radii[i] * cosLon - x;
+        const qreal dy = radii[i] * sinLon - y;
+        const qreal dz = zs[i] - z;
+        hits[i] = (dx * dx + dy * dy + dz * dz) < radiusSquared;
+    }
+}
+
+//private
+qreal CoverageBins::_lon(int column) const
+{
+    qreal toRet = _left + column * _granularity * _lonPerMeter;
+    toRet += _offset * _lonPerMeter;
+    return toRet;
+}
+
+//private
+qreal CoverageBins::_lat(int row) const
+{
+    qreal toRet = _bottom + row * _granularity * _latPerMeter;
+    toRet += _offset * _latPerMeter;
+    return toRet;
+}
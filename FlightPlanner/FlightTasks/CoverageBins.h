@@ -0,0 +1,162 @@
+#ifndef COVERAGEBINS_H
+#define COVERAGEBINS_H
+
+#include <QtGlobal>
+#include <QBitArray>
+#include <QPolygonF>
+#include <QRectF>
+#include <QVector>
+#include <QVector3D>
+
+#include "Position.h"
+
+/**
+ * @brief The CoverageBins class is the set of points (bins) that a CoverageTask wants flown near: the centers
+ * of a regular grid over the area's bounding box that fall inside the area.
+ *
+ * The grid is implicit. We keep one bit per grid cell saying whether it's a bin, plus per-row and per-column
+ * trigonometry, and work out a bin's coordinates when they're asked for. Memory grows with the number of cells
+ * divided by eight rather than with the number of bins times two coordinates, so fine grids over large areas
+ * stay affordable. The mask is filled row by row with the same crossing rule as
+ * QPolygonF::containsPoint(Qt::OddEvenFill).
+ *
+ * Bins are identified by their cell index. Cells are numbered column by column (west to east), and within a
+ * column from south to north; that is also the order CoverageTask entices the UAV through the bins in.
+ * CoverageBins is a value type and cheap to copy.
+ */
+class CoverageBins
+{
+public:
+    CoverageBins();
+
+    /**
+     * @brief build replaces the bins with those of the given area.
+     * @param geoPoly
+     * @param granularity distance between neighbouring bins in meters
+     */
+    void build(const QPolygonF& geoPoly, qreal granularity);
+
+    void clear();
+
+    /**
+     * @brief geoPoly returns the area given to build()
+     * @return
+     */
+    const QPolygonF& geoPoly() const;
+
+    /**
+     * @brief granularity returns the distance between neighbouring bins given to build()
+     * @return
+     */
+    qreal granularity() const;
+
+    /**
+     * @brief isEmpty returns true if there are no bins at all
+     * @return
+     */
+    bool isEmpty() const;
+
+    /**
+     * @brief count returns the number of bins
+     * @return
+     */
+    int count() const;
+
+    /**
+     * @brief cellCount returns the number of grid cells, bins or not. Cell indices are less than this.
+     * @return
+     */
+    int cellCount() const;
+
+    bool isBin(int cell) const;
+
+    /**
+     * @brief columns returns the number of columns of the grid. Cell column * rows() + row is in that column.
+     * @return
+     */
+    int columns() const;
+    int rows() const;
+
+    /**
+     * @brief gridCoordinates returns where a position is on the grid, in cells. Whole numbers are cell centers,
+     * so cell (column, row) covers column - 0.5 to column + 0.5. Positions off the grid are off its range.
+     * @param lla
+     * @param column
+     * @param row
+     */
+    void gridCoordinates(const Position& lla, qreal * column, qreal * row) const;
+
+    /**
+     * @brief nextBin returns the first cell at or after the given one that is a bin, or cellCount() if none is.
+     * @param cell
+     * @return
+     */
+    int nextBin(int cell) const;
+
+    Position lla(int cell) const;
+    QVector3D xyz(int cell) const;
+
+    /**
+     * @brief binsWithin appends the cell index of every bin strictly closer than radius to the given position.
+     * @param lla the position
+     * @param xyz the same position, already converted with Conversions::lla2xyz()
+     * @param radius in meters
+     * @param output
+     */
+    void binsWithin(const Position& lla, const QVector3D& xyz, qreal radius, QVector<int> * output) const;
+
+    /**
+     * @brief satisfyWithin sets the bit of every bin strictly closer than radius to the given position.
+     * @param lla the position
+     * @param xyz the same position, already converted with Conversions::lla2xyz()
+     * @param radius in meters
+     * @param satisfied has cellCount() bits
+     * @param newlySatisfied if not null, the cell index of every bin whose bit wasn't already set is appended
+     * @return the number of bits that weren't already set
+     */
+    int satisfyWithin(const Position& lla, const QVector3D& xyz, qreal radius, QBitArray * satisfied,
+                      QVector<int> * newlySatisfied = 0) const;
+
+    /**
+     * @brief binsInside appends the cell index of every bin whose center is inside a (lon,lat) rectangle.
+     * Only the cells in the rectangle are looked at.
+     * @param geoRect
+     * @param output
+     */
+    void binsInside(const QRectF& geoRect, QVector<int> * output) const;
+
+private:
+    bool _blockAround(const Position& lla, qreal radius,
+                      int * minColumn, int * maxColumn, int * minRow, int * maxRow) const;
+    void _rowsWithin(int column, int firstRow, int count,
+                     const QVector3D& xyz, qreal radiusSquared,
+                     uchar * hits) const;
+
+    qreal _lon(int column) const;
+    qreal _lat(int row) const;
+
+    QPolygonF _geoPoly;
+    qreal _granularity;
+
+    //The grid: cell (column, row) is at _lon(column), _lat(row)
+    qreal _left;
+    qreal _bottom;
+    qreal _lonPerMeter;
+    qreal _latPerMeter;
+    int _offset;
+    int _columns;
+    int _rows;
+
+    //Bit column * _rows + row is set if that cell is a bin
+    QBitArray _mask;
+    int _count;
+
+    //Conversions::lla2xyz() of a cell is (_rowRadii[row] * _columnCos[column],
+    //_rowRadii[row] * _columnSin[column], _rowZ[row])
+    QVector<qreal> _columnCos;
+    QVector<qreal> _columnSin;
+    QVector<qreal> _rowRadii;
+    QVector<qreal> _rowZ;
+};
+
+#endif // COVERAGEBINS_H
@@ -0,0 +1,144 @@
+#include "CoverageDistanceField.h"
+
+#include <cmath>
+
+//Chamfer distances between neighbouring blocks, across and diagonally. 3 units per block.
+const int CHAMFER_ACROSS = 3;
+const int CHAMFER_DIAGONAL = 4;
+
+//Distances saturate here
+const int FAR_AWAY = 255;
+
+//A block's bins are counted in a byte
+const int MAX_BLOCK_SIZE = 15;
+
+//non-member
+//Lowers the distance at to if going through from, one step away, is shorter
+static inline void relax(quint8 * distances, int to, int from, int step)
+{
+    const int viaFrom = qMin<int>(FAR_AWAY, distances[from] + step);
+    if (viaFrom < distances[to])
+        distances[to] = viaFrom;
+}
+
+CoverageDistanceField::CoverageDistanceField() :
+    _blockSize(1), _blockColumns(0), _blockRows(0), _blockMeters(1.0), _remaining(0)
+{
+}
+
+CoverageDistanceField::CoverageDistanceField(const CoverageBins &bins, qreal blockMeters) :
+    _bins(bins), _remaining(0)
+{
+    _blockSize = qBound<int>(1, qRound(blockMeters / bins.granularity()), MAX_BLOCK_SIZE);
+    _blockColumns = (bins.columns() + _blockSize - 1) / _blockSize;
+    _blockRows = (bins.rows() + _blockSize - 1) / _blockSize;
+    _blockMeters = _blockSize * bins.granularity();
+
+    _unsatisfied.fill(0, _blockColumns * _blockRows);
+    for (int cell = bins.nextBin(0); cell < bins.cellCount(); cell = bins.nextBin(cell + 1))
+    {
+        const int block = (cell / bins.rows() / _blockSize) * _blockRows + (cell % bins.rows()) / _blockSize;
+        _unsatisfied[block]++;
+        _remaining++;
+    }
+    _transform();
+}
+
+void CoverageDistanceField::satisfy(int cell)
+{
+    const int block = (cell / _bins.rows() / _blockSize) * _blockRows + (cell % _bins.rows()) / _blockSize;
+    if (_unsatisfied.at(block) == 0)
+        return;
+
+    _remaining--;
+    if (--_unsatisfied[block] == 0)
+        _transform();
+}
+
+int CoverageDistanceField::remaining() const
+{
+    return _remaining;
+}
+
+qreal CoverageDistanceField::distance(const Position &lla) const
+{
+    if (_remaining == 0)
+        return -1.0;
+
+    //Where we are in blocks, with whole numbers at block centers
+    qreal column;
+    qreal row;
+    _bins.gridCoordinates(lla, &column, &row);
+    const qreal blockColumn = (column + 0.5) / _blockSize - 0.5;
+    const qreal blockRow = (row + 0.5) / _blockSize - 0.5;
+
+    //Off the grid, the way to its edge comes first
+    const qreal clampedColumn = qBound<qreal>(0.0, blockColumn, _blockColumns - 1);
+    const qreal clampedRow = qBound<qreal>(0.0, blockRow, _blockRows - 1);
+    const qreal offColumns = blockColumn - clampedColumn;
+    const qreal offRows = blockRow - clampedRow;
+    const qreal offGrid = sqrt(offColumns * offColumns + offRows * offRows);
+
+    //Then interpolate between the four block centers around us
+    const int c0 = (int) clampedColumn;
+    const int r0 = (int) clampedRow;
+    const int c1 = qMin<int>(c0 + 1, _blockColumns - 1);
+    const int r1 = qMin<int>(r0 + 1, _blockRows - 1);
+    const qreal fc = clampedColumn - c0;
+    const qreal fr = clampedRow - r0;
+    const quint8 * distances = _distances.constData();
+    const qreal west = distances[c0 * _blockRows + r0] * (1.0 - fr) + distances[c0 * _blockRows + r1] * fr;
+    const qreal east = distances[c1 * _blockRows + r0] * (1.0 - fr) + distances[c1 * _blockRows + r1] * fr;
+    const qreal units = west * (1.0 - fc) + east * fc;
+
+    return (units / CHAMFER_ACROSS + offGrid) * _blockMeters;
+}
+
+//private
+void CoverageDistanceField::_transform()
+{
+    const int columns = _blockColumns;
+    const int rows = _blockRows;
+    _distances.resize(columns * rows);
+    quint8 * d = _distances.data();
+    for (int block = 0; block < columns * rows; block++)
+        d[block] = (_unsatisfied.at(block) > 0) ? 0 : FAR_AWAY;
+
+    //Forward pass, from the blocks already visited: the one south of us and the three to the west
+    for (int c = 0; c < columns; c++)
+    {
+        for (int r = 0; r < rows; r++)
+        {
+            const int block = c * rows + r;
+            if (r > 0)
+                relax(d, block, block - 1, CHAMFER_ACROSS);
+            if (c > 0)
+            {
+                relax(d, block, block - rows, CHAMFER_ACROSS);
+                if (r > 0)
+                    relax(d, block, block - rows - 1, CHAMFER_DIAGONAL);
+                if (r + 1 < rows)
+                    relax(d, block, block - rows + 1, CHAMFER_DIAGONAL);
+            }
+        }
+    }
+
+    //Backward pass, mirrored
+    for (int c = columns - 1; c >= 0; c--)
+    {
+        for (int r = rows - 1; r >= 0; r--)
+        {
+            const int block = c * rows + r;
+            if (r + 1 < rows)
+                relax(d, block, block + 1, CHAMFER_ACROSS);
+            if (c + 1 < columns)
+            {
+                relax(d, block, block + rows, CHAMFER_ACROSS);
+                if (r + 1 < rows)
+                    relax(d, block, block + rows + 1, CHAMFER_DIAGONAL);
+                if (r > 0)
+                    relax(d, block, block + rows - 1, CHAMFER_DIAGONAL);
+            }
+        }
+    }
+}
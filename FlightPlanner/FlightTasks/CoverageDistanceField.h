@@ -0,0 +1,72 @@
+#ifndef COVERAGEDISTANCEFIELD_H
+#define COVERAGEDISTANCEFIELD_H
+
+#include <QtGlobal>
+#include <QVector>
+
+#include "CoverageBins.h"
+#include "Position.h"
+
+/**
+ * @brief The CoverageDistanceField class knows how far any position is from the nearest bin of a CoverageBins
+ * that hasn't been satisfied yet, so searches can head for what's left to cover without looking through the bins.
+ *
+ * The bins' grid is split into square blocks of cells. We count each block's unsatisfied bins and keep a chamfer
+ * distance transform (3 per block across, 4 diagonally) from every block to the nearest block that has any. A
+ * position's distance is interpolated between the four block centers around it, so it's a few lookups and has a
+ * gradient everywhere. It's as fine as the blocks: anywhere in a block with bins left is close enough.
+ *
+ * Satisfying a bin only changes its block's count. The transform is only redone, in two passes over the blocks,
+ * when a block runs out of bins. Distances are kept in a byte per block, so copying a field is cheap and fields
+ * far bigger than the searches' reach saturate at 85 blocks. CoverageDistanceField is a value type.
+ */
+class CoverageDistanceField
+{
+public:
+    CoverageDistanceField();
+
+    /**
+     * @brief CoverageDistanceField makes the field of bins with none of them satisfied
+     * @param bins
+     * @param blockMeters roughly how wide a block should be. Blocks are a whole number of bins wide, at most 15.
+     */
+    CoverageDistanceField(const CoverageBins& bins, qreal blockMeters);
+
+    /**
+     * @brief satisfy takes a bin off the ones left. Each bin must only be satisfied once.
+     * @param cell the bin's cell index
+     */
+    void satisfy(int cell);
+
+    /**
+     * @brief remaining returns how many bins haven't been satisfied
+     * @return
+     */
+    int remaining() const;
+
+    /**
+     * @brief distance returns about how far (in meters) a position is from the nearest block with bins left,
+     * or -1 if every bin is satisfied
+     * @param lla
+     * @return
+     */
+    qreal distance(const Position& lla) const;
+
+private:
+    void _transform();
+
+    //The bins' grid, for turning positions into block coordinates
+    CoverageBins _bins;
+
+    int _blockSize;
+    int _blockColumns;
+    int _blockRows;
+    qreal _blockMeters;
+
+    //Per block, column by column like the cells: bins left, and distance in chamfer units to a block with some
+    QVector<quint8> _unsatisfied;
+    QVector<quint8> _distances;
+    int _remaining;
+};
+
+#endif // COVERAGEDISTANCEFIELD_H
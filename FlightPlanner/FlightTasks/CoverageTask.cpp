@@ -1,17 +1,121 @@
 #include "CoverageTask.h"
 
-#include <QSet>
+#include <QBitArray>
 
+#include "AreaGeometry.h"
+#include "AreaScoringContext.h"
+#include "CoverageDistanceField.h"
 #include "guts/Conversions.h"
 
+/*
+ * Remembers which bins have been satisfied so far. Each appended position only has to be checked against
+ * the nearby bins, not re-run through the whole path. The distance field of the bins left, with blocks about
+ * as wide as a position reaches, guides searches.
+*/
+class CoverageScoringState : public FlightTaskScoringState
+{
+public:
+    CoverageScoringState(const CoverageTask * task, const CoverageBins& bins, qreal maxDistance) :
+        FlightTaskScoringState(task), _bins(bins), _maxDistance(maxDistance),
+        _satisfied(bins.cellCount()), _satisfiedCount(0), _firstUnsatisfied(bins.nextBin(0)),
+        _unsatisfiedField(bins, maxDistance)
+    {
+    }
+
+    //pure-virtual from FlightTaskScoringState
+    virtual QSharedPointer<FlightTaskScoringState> clone() const
+    {
+        return QSharedPointer<FlightTaskScoringState>(new CoverageScoringState(*this));
+    }
+
+    //pure-virtual from FlightTaskScoringState
+    virtual qreal performance() const
+    {
+        if (this->positionCount() == 0)
+            return 0.0;
+
+        const qreal reward = _satisfiedCount;
+
+        //Only the first unsatisfied bin in the list entices us (see CoverageTask::calculateFlightPerformance)
+        qreal enticement = 0.0;
+        if (_firstUnsatisfied < _bins.cellCount())
+        {
+            const qreal distance = (_lastXYZ - _bins.xyz(_firstUnsatisfied)).length();
+            enticement = FlightTask::normal(distance, 200.0, 10.0);
+        }
+
+        return reward + enticement;
+    }
+
+    //virtual from FlightTaskScoringState
+    virtual qreal guidanceDistance() const
+    {
+        if (this->positionCount() == 0)
+            return -1.0;
+        return _unsatisfiedField.distance(_lastPos);
+    }
+
+protected:
+    //pure-virtual from FlightTaskScoringState
+    virtual void doAppend(const Position &pos)
+    {
+        _lastPos = pos;
+        _lastXYZ = Conversions::lla2xyz(pos);
+
+        _newlySatisfied.clear();
+        _satisfiedCount += _bins.satisfyWithin(pos, _lastXYZ, _maxDistance, &_satisfied, &_newlySatisfied);
+        foreach(int cell, _newlySatisfied)
+            _unsatisfiedField.satisfy(cell);
+
+        //Bins never become unsatisfied again, so this only ever moves forward
+        while (_firstUnsatisfied < _bins.cellCount() && _satisfied.testBit(_firstUnsatisfied))
+            _firstUnsatisfied = _bins.nextBin(_firstUnsatisfied + 1);
+    }
+
+    //pure-virtual from FlightTaskScoringState
+    virtual void doCopyFrom(const FlightTaskScoringState &other)
+    {
+        const CoverageScoringState& src = static_cast<const CoverageScoringState&>(other);
+        _bins = src._bins;
+        _maxDistance = src._maxDistance;
+
+        //Overwrite our own bits rather than sharing src's so the next append() doesn't have to detach
+        _satisfied.fill(false, src._satisfied.size());
+        _satisfied |= src._satisfied;
+        _satisfiedCount = src._satisfiedCount;
+        _firstUnsatisfied = src._firstUnsatisfied;
+        _lastPos = src._lastPos;
+        _lastXYZ = src._lastXYZ;
+
+        //Shared until one of us satisfies a bin
+        _unsatisfiedField = src._unsatisfiedField;
+    }
+
+private:
+    CoverageBins _bins;
+    qreal _maxDistance;
+
+    //Indexed by cell, like the bins themselves
+    QBitArray _satisfied;
+    int _satisfiedCount;
+    int _firstUnsatisfied;
+    Position _lastPos;
+    QVector3D _lastXYZ;
+
+    CoverageDistanceField _unsatisfiedField;
+
+    //Scratch space for doAppend()
+    QVector<int> _newlySatisfied;
+};
+
 CoverageTask::CoverageTask(qreal coverageGranularity, qreal maxSatisfyingDistance) :
-    _granularity(coverageGranularity), _maxDistance(maxSatisfyingDistance)
+    _granularity(coverageGranularity), _maxDistance(maxSatisfyingDistance), _coverageMode(SearchedCoverage)
 {
 }
 
 //for de-serializing
 CoverageTask::CoverageTask(QDataStream &stream) :
-    FlightTask(stream)
+    FlightTask(stream), _coverageMode(SearchedCoverage)
 {
     stream >> _granularity;
     stream >> _maxDistance;
@@ -38,60 +142,50 @@ QString CoverageTask::taskType() const
 
 qreal CoverageTask::calculateFlightPerformance(const QList<Position> &positions,
                                                const QPolygonF &geoPoly,
-                                               const UAVParameters &)
+                                               const UAVParameters &) const
 {
     if (positions.isEmpty())
         return 0.0;
+    return _score(positions, 0, _binsFor(geoPoly));
+}
 
-    if (geoPoly != _lastGeoPoly || _bins.isEmpty())
-        _calculateBins(geoPoly);
-
-    const qreal maxDistance = _maxDistance;
-
-    QSet<int> satisfiedBins;
-
-    foreach(const Position& pos, positions)
-    {
-        const QVector3D xyz = Conversions::lla2xyz(pos);
-        for (int i = 0; i < _bins.size(); i++)
-        {
-            if (satisfiedBins.contains(i))
-                continue;
-            const qreal distance = (xyz - _xyzBins.value(i)).length();
-            if (distance < maxDistance)
-                satisfiedBins.insert(i);
-        }
-    }
-
-    const qreal reward = satisfiedBins.size();
+//virtual from FlightTask
+qreal CoverageTask::calculateAreaPerformance(const AreaScoringContext &context) const
+{
+    if (context.positions().isEmpty())
+        return 0.0;
 
-    qreal enticement = 0.0;
-    const QVector3D lastPosXYZ = Conversions::lla2xyz(positions.last());
-    for (int i = 0; i < _bins.size(); i++)
-    {
-        if (satisfiedBins.contains(i))
-            continue;
+    //Bins prepared for another area (or not at all) come from the area's geometry instead
+    const CoverageBins bins = (context.geoPoly() == _prepared.geoPoly() && !_prepared.isEmpty())
+            ? _prepared : context.geometry().coverageBins(_granularity);
+    return _score(context.positions(), context.xyz().constData(), bins);
+}
 
-        const qreal distance = (lastPosXYZ - _xyzBins.value(i)).length();
-        const qreal currentEnticement = FlightTask::normal(distance, 200.0, 10.0);
-        if (currentEnticement > enticement)
-            enticement = currentEnticement;
+//virtual from FlightTask
+QSharedPointer<FlightTaskScoringState> CoverageTask::createScoringState(const QPolygonF &geoPoly,
+                                                                        const UAVParameters &) const
+{
+    return QSharedPointer<FlightTaskScoringState>(new CoverageScoringState(this, _binsFor(geoPoly), _maxDistance));
+}
 
-        /*
-         *Comment out this break if you want to use the nearest enticement point rather than
-         *the one that is next in the list.
-        */
-        break;
-    }
+//virtual from FlightTask
+void CoverageTask::prepareScoring(const QPolygonF &geoPoly, const UAVParameters &)
+{
+    if (geoPoly != _prepared.geoPoly() || _prepared.isEmpty())
+        _prepared.build(geoPoly, _granularity);
+}
 
-    return reward + enticement;
+//virtual from FlightTask
+void CoverageTask::prepareAreaScoring(AreaGeometry *geometry, const UAVParameters &)
+{
+    _prepared = geometry->prepareCoverageBins(_granularity);
 }
 
 qreal CoverageTask::maxTaskPerformance() const
 {
-    if (_bins.size() == 0)
+    if (_prepared.isEmpty())
         return FlightTask::maxTaskPerformance();
-    return (qreal) _bins.size();
+    return (qreal) _prepared.count();
 }
 
 qreal CoverageTask::granularity() const
@@ -103,8 +197,8 @@ void CoverageTask::setGranularity(qreal nGran)
 {
     _granularity = qBound<qreal>(1.0, nGran, 1000.0);
 
-    //Reset bins so that they are forced to recalculate next time
-    _bins.clear();
+    //The bins depend on this, so they have to be prepared again
+    _prepared.clear();
     this->flightTaskChanged();
 }
 
@@ -117,47 +211,67 @@ void CoverageTask::setMaxDistance(qreal maxDist)
 {
     _maxDistance = qBound<qreal>(1.0, maxDist, 1000.0);
 
-    //Reset bins so that they are forced to recalculate next time
-    _bins.clear();
+    //The bins depend on this, so they have to be prepared again
+    _prepared.clear();
+    this->flightTaskChanged();
+}
+
+CoverageTask::CoverageMode CoverageTask::coverageMode() const
+{
+    return _coverageMode;
+}
+
+void CoverageTask::setCoverageMode(CoverageTask::CoverageMode mode)
+{
+    _coverageMode = mode;
     this->flightTaskChanged();
 }
 
 //private
-void CoverageTask::_calculateBins(const QPolygonF &geoPoly)
+CoverageBins CoverageTask::_binsFor(const QPolygonF &geoPoly) const
 {
-    _bins.clear();
-    _xyzBins.clear();
-    _lastGeoPoly = geoPoly;
+    if (geoPoly == _prepared.geoPoly() && !_prepared.isEmpty())
+        return _prepared;
 
-    const QRectF boundingRect = geoPoly.boundingRect().normalized();
+    //Not prepared for this area. Still correct, but we build the bins every call and don't keep them.
+    CoverageBins toRet;
+    toRet.build(geoPoly, _granularity);
+    return toRet;
+}
 
-    const QVector3D topLeftXYZ(Conversions::lla2xyz(boundingRect.topRight()));
-    const QVector3D bottomLeftXYZ(Conversions::lla2xyz(boundingRect.bottomRight()));
-    const QVector3D topRightXYZ(Conversions::lla2xyz(boundingRect.topLeft()));
+//private
+qreal CoverageTask::_score(const QList<Position> &positions, const QVector3D *xyz, const CoverageBins &bins) const
+{
+    QBitArray satisfiedBins(bins.cellCount());
+    int satisfiedCount = 0;
 
-    const qreal widthMeters = (topLeftXYZ - topRightXYZ).length();
-    const qreal heightMeters = (topLeftXYZ - bottomLeftXYZ).length();
-    const qreal lonPerMeter = Conversions::degreesLonPerMeter(boundingRect.center().y());
-    const qreal latPerMeter = Conversions::degreesLatPerMeter(boundingRect.center().y());
+    for (int i = 0; i < positions.size(); i++)
+    {
+        const Position& pos = positions.at(i);
+        const QVector3D posXYZ = xyz ? xyz[i] : Conversions::lla2xyz(pos);
+        satisfiedCount += bins.satisfyWithin(pos, posXYZ, _maxDistance, &satisfiedBins);
+    }
 
-    const int offset = _granularity / 2;
+    const qreal reward = satisfiedCount;
 
-    for (int x = 0; x < widthMeters / _granularity; x++)
+    qreal enticement = 0.0;
+    const QVector3D lastPosXYZ = xyz ? xyz[positions.size() - 1] : Conversions::lla2xyz(positions.last());
+    for (int cell = bins.nextBin(0); cell < bins.cellCount(); cell = bins.nextBin(cell + 1))
     {
-        for (int y = 0; y < heightMeters / _granularity; y++)
-        {
-            qreal lon = boundingRect.topLeft().x() + x * _granularity * lonPerMeter;
-            lon += offset * lonPerMeter;
-
-            qreal lat = boundingRect.topLeft().y() + y * _granularity * latPerMeter;
-            lat += offset * latPerMeter;
-
-            Position lla(lon, lat);
-            if (geoPoly.containsPoint(lla.lonLat(), Qt::OddEvenFill))
-            {
-                _bins.append(lla);
-                _xyzBins.append(Conversions::lla2xyz(lla));
-            }
-        }
+        if (satisfiedBins.testBit(cell))
+            continue;
+
+        const qreal distance = (lastPosXYZ - bins.xyz(cell)).length();
+        const qreal currentEnticement = FlightTask::normal(distance, 200.0, 10.0);
+        if (currentEnticement > enticement)
+            enticement = currentEnticement;
+
+        /*
+         *Comment out this break if you want to use the nearest enticement point rather than
+         *the one that is next in the list.
+        */
+        break;
     }
+
+    return reward + enticement;
 }
@@ -2,15 +2,25 @@
 #define COVERAGETASK_H
 
 #include <QObject>
-#include <QVector>
-#include <QVector3D>
 
 #include "FlightTask.h"
+#include "CoverageBins.h"
 
 class CoverageTask : public FlightTask
 {
     Q_OBJECT
 public:
+    /**
+     * @brief The CoverageMode enum chooses how the hierarchical planner flies the task's sub-flight.
+     * SearchedCoverage searches for the path waypoint by waypoint. SweptCoverage flies back and forth across
+     * the area in evenly spaced lines (see SweepPattern) and only searches for whatever the lines miss.
+     */
+    enum CoverageMode
+    {
+        SearchedCoverage,
+        SweptCoverage
+    };
+
     CoverageTask(qreal coverageGranularity = 100.0, qreal maxSatisfyingDistance = 50.0);
 
     //for de-serializing
@@ -26,8 +36,29 @@ public:
 
     virtual qreal calculateFlightPerformance(const QList<Position>& positions,
                                              const QPolygonF& geoPoly,
-                                             const UAVParameters& uavParams);
+                                             const UAVParameters& uavParams) const;
+
+    //virtual from FlightTask
+    virtual QSharedPointer<FlightTaskScoringState> createScoringState(const QPolygonF& geoPoly,
+                                                                      const UAVParameters& uavParams) const;
+
+    //virtual from FlightTask
+    virtual qreal calculateAreaPerformance(const AreaScoringContext& context) const;
+
+    //virtual from FlightTask
+    virtual void prepareScoring(const QPolygonF& geoPoly, const UAVParameters& uavParams);
 
+    /**
+     * @brief prepareAreaScoring takes the bins from the area's geometry, so coverage tasks over the same area at
+     * the same granularity share them
+     */
+    virtual void prepareAreaScoring(AreaGeometry * geometry, const UAVParameters& uavParams);
+
+    /**
+     * @brief maxTaskPerformance returns the number of bins in the area given to prepareScoring().
+     * Before that it has no bins to count and returns FlightTask's default.
+     * @return
+     */
     virtual qreal maxTaskPerformance() const;
 
     qreal granularity() const;
@@ -35,16 +66,26 @@ public:
 
     qreal maxDistance() const;
     void setMaxDistance(qreal maxDist);
+
+    /**
+     * @brief coverageMode defaults to SearchedCoverage. It isn't saved with the task.
+     * @return
+     */
+    CoverageMode coverageMode() const;
+    void setCoverageMode(CoverageMode mode);
     
 //private:
-    void _calculateBins(const QPolygonF& geoPoly);
+    CoverageBins _binsFor(const QPolygonF& geoPoly) const;
+
+    //xyz is Conversions::lla2xyz() of each position, or 0 to convert them as we go
+    qreal _score(const QList<Position>& positions, const QVector3D * xyz, const CoverageBins& bins) const;
 
-    QPolygonF _lastGeoPoly;
-    QVector<Position> _bins;
-    QVector<QVector3D> _xyzBins;
+    //Built by prepareScoring(). Never modified afterwards, so scoring threads can share copies of it.
+    CoverageBins _prepared;
 
     qreal _granularity;
     qreal _maxDistance;
+    CoverageMode _coverageMode;
     
 };
 
@@ -1,23 +1,73 @@
 #include "FlightTask.h"
 
+#include "AreaGeometry.h"
+#include "AreaScoringContext.h"
+
 #include <cmath>
 #include <QtDebug>
 #include <QMutableListIterator>
 #include <QMutableSetIterator>
+#include <QDateTime>
 
 const qreal PI = 3.1415926535897932384626433;
 const qreal SQRT2PI = sqrt(2.0*PI);
 
+/*
+ * Fallback scorer for tasks that don't implement their own. It's no faster than scoring the whole path,
+ * but it lets planners use the incremental interface for every task.
+*/
+class FullPathScoringState : public FlightTaskScoringState
+{
+public:
+    FullPathScoringState(const FlightTask * task, const QPolygonF& geoPoly, const UAVParameters& uavParams) :
+        FlightTaskScoringState(task), _geoPoly(geoPoly), _uavParams(uavParams)
+    {
+    }
+
+    //pure-virtual from FlightTaskScoringState
+    virtual QSharedPointer<FlightTaskScoringState> clone() const
+    {
+        return QSharedPointer<FlightTaskScoringState>(new FullPathScoringState(*this));
+    }
+
+    //pure-virtual from FlightTaskScoringState
+    virtual qreal performance() const
+    {
+        return this->task()->calculateFlightPerformance(_positions, _geoPoly, _uavParams);
+    }
+
+protected:
+    //pure-virtual from FlightTaskScoringState
+    virtual void doAppend(const Position &pos)
+    {
+        _positions.append(pos);
+    }
+
+    //pure-virtual from FlightTaskScoringState
+    virtual void doCopyFrom(const FlightTaskScoringState &other)
+    {
+        *this = static_cast<const FullPathScoringState&>(other);
+    }
+
+private:
+    QPolygonF _geoPoly;
+    UAVParameters _uavParams;
+    QList<Position> _positions;
+};
+
 //static public
 QHash<quint64, QWeakPointer<FlightTask> > FlightTask::_uuidToWeakTask = QHash<quint64, QWeakPointer<FlightTask> >();
 
+//static private
+PlanningRandom FlightTask::_uuidRandom = PlanningRandom(QDateTime::currentMSecsSinceEpoch());
+
 FlightTask::FlightTask()
 {
     _taskName = "Untitled";
     this->addTimingConstraint(TimingConstraint(0, 3600));
 
-    const quint32 r1 = qrand();
-    const quint32 r2 = qrand();
+    const quint32 r1 = _uuidRandom.next();
+    const quint32 r2 = _uuidRandom.next();
     quint64 uuid = r1;
     uuid = uuid << 32;
     uuid = uuid | r2;
@@ -73,6 +123,34 @@ bool FlightTask::shortnessRewardApplies() const
     return true;
 }
 
+//virtual
+bool FlightTask::scoresOnlyInsideArea() const
+{
+    return false;
+}
+
+//virtual
+QSharedPointer<FlightTaskScoringState> FlightTask::createScoringState(const QPolygonF &geoPoly,
+                                                                      const UAVParameters &uavParams) const
+{
+    return QSharedPointer<FlightTaskScoringState>(new FullPathScoringState(this, geoPoly, uavParams));
+}
+
+//virtual
+void FlightTask::prepareScoring(const QPolygonF &, const UAVParameters &)
+{
+}
+
+void FlightTask::prepareAreaScoring(AreaGeometry *geometry, const UAVParameters &uavParams)
+{
+    this->prepareScoring(geometry->geoPoly(), uavParams);
+}
+
+qreal FlightTask::calculateAreaPerformance(const AreaScoringContext &context) const
+{
+    return this->calculateFlightPerformance(context.positions(), context.geoPoly(), context.uavParams());
+}
+
 qreal FlightTask::priority() const
 {
     return 1.0;
@@ -158,7 +236,13 @@ quint64 FlightTask::uuid() const
     return _uuid;
 }
 
-void FlightTask::resolveDependencies()
+//static
+void FlightTask::seedUUIDs(quint64 seed)
+{
+    _uuidRandom.seed(seed);
+}
+
+void FlightTask::resolveDependencies(bool warnIfUnresolved)
 {
     QMutableSetIterator<quint64> iter(_unresolvedDependencies);
 
@@ -170,7 +254,7 @@ void FlightTask::resolveDependencies()
             this->addDependencyContraint(FlightTask::_uuidToWeakTask.value(depUUID));
             iter.remove();
         }
-        else
+        else if (warnIfUnresolved)
             qWarning() << "Unresolved task dependency" << depUUID;
     }
 }
@@ -196,7 +280,7 @@ void FlightTask::handleDependencyDeleted()
     this->flightTaskChanged();
 }
 
-//protected static
+//static
 qreal FlightTask::normal(qreal x, qreal stdDev, qreal scaleFactor)
 {
     qreal expPart = exp(-0.5 * pow(x / stdDev, 2.0) / scaleFactor);
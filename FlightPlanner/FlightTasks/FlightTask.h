@@ -12,6 +12,11 @@
 #include "TimingConstraint.h"
 #include "UAVParameters.h"
 #include "Serializable.h"
+#include "FlightTaskScoringState.h"
+#include "PlanningRandom.h"
+
+class AreaGeometry;
+class AreaScoringContext;
 
 class FlightTask : public QObject, public Serializable
 {
@@ -28,11 +33,68 @@ public:
 
     virtual bool shortnessRewardApplies() const;
 
+    /**
+     * @brief scoresOnlyInsideArea returns true if positions outside the area's bounding rectangle never change
+     * the task's score, so that calculateFlightPerformance() given only the positions inside it (in order, maybe
+     * none) scores the same as given the whole flight. PlanningProblem uses it to skip far-away positions.
+     * False by default.
+     * @return
+     */
+    virtual bool scoresOnlyInsideArea() const;
+
     virtual QString taskType() const=0;
 
+    /**
+     * @brief calculateFlightPerformance scores the whole flight over the given area. It must not modify the
+     * task, so any number of threads can score flights at once.
+     * @param positions
+     * @param geoPoly
+     * @param uavParams
+     * @return
+     */
     virtual qreal calculateFlightPerformance(const QList<Position>& positions,
                                              const QPolygonF& geoPoly,
-                                             const UAVParameters& uavParams)=0;
+                                             const UAVParameters& uavParams) const=0;
+
+    /**
+     * @brief prepareScoring precomputes whatever the task needs to score flights over the given area quickly,
+     * like CoverageTask's bins. Call it when the problem stops changing and before any thread scores.
+     * Scoring an area the task wasn't prepared for still works, just more slowly. Does nothing by default.
+     * @param geoPoly
+     * @param uavParams
+     */
+    virtual void prepareScoring(const QPolygonF& geoPoly, const UAVParameters& uavParams);
+
+    /**
+     * @brief prepareAreaScoring is prepareScoring() for a task whose area's other tasks share geometry with it,
+     * so that what they have in common (like CoverageTask's bins) is only built once. The geometry must stay
+     * unmodified once prepared. The default calls prepareScoring() with the geometry's polygon.
+     * @param geometry
+     * @param uavParams
+     */
+    virtual void prepareAreaScoring(AreaGeometry * geometry, const UAVParameters& uavParams);
+
+    /**
+     * @brief calculateAreaPerformance is calculateFlightPerformance() for a flight that the area's other tasks
+     * are scored on too. Overriding it lets a task use what the others already worked out about the flight
+     * (which positions are inside the area, their ECEF coordinates) instead of working it out again. It must
+     * score the same as calculateFlightPerformance(). The default calls that with the context's positions.
+     * @param context
+     * @return
+     */
+    virtual qreal calculateAreaPerformance(const AreaScoringContext& context) const;
+
+    /**
+     * @brief createScoringState returns an empty incremental scorer for this task over the given area.
+     * The default implementation just remembers the positions and calls calculateFlightPerformance(), so
+     * subclasses should override it with something that doesn't rescan the whole path.
+     * The returned state must not outlive this task.
+     * @param geoPoly
+     * @param uavParams
+     * @return
+     */
+    virtual QSharedPointer<FlightTaskScoringState> createScoringState(const QPolygonF& geoPoly,
+                                                                      const UAVParameters& uavParams) const;
 
     virtual qreal priority() const;
 
@@ -53,19 +115,27 @@ public:
     void addDependencyContraint(const QSharedPointer<FlightTask>& other);
 
     quint64 uuid() const;
-    void resolveDependencies();
+    void resolveDependencies(bool warnIfUnresolved = true);
 
     static QHash<quint64, QWeakPointer<FlightTask> > _uuidToWeakTask;
 
+    /**
+     * @brief seedUUIDs restarts the sequence new tasks draw their UUIDs from, so that a generated problem gets
+     * the same UUIDs every time. By default the sequence is seeded from the clock at startup. Like
+     * _uuidToWeakTask it's shared by every task and should only be used from one thread.
+     * @param seed
+     */
+    static void seedUUIDs(quint64 seed);
+
+    //Public so that the tasks' scoring states can share it
+    static qreal normal(qreal x, qreal stdDev, qreal scaleFactor=1000.0);
+
 private slots:
     void handleDependencyDeleted();
 
 signals:
     void flightTaskChanged();
 
-protected:
-    static qreal normal(qreal x, qreal stdDev, qreal scaleFactor=1000.0);
-
 private:
     QList<TimingConstraint> _timingConstraints;
     QString _taskName;
@@ -73,6 +143,8 @@ private:
     quint64 _uuid;
 
     QSet<quint64> _unresolvedDependencies;
+
+    static PlanningRandom _uuidRandom;
 };
 
 #endif // FLIGHTTASK_H
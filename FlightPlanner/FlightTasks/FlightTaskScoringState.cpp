@@ -0,0 +1,38 @@
+#include "FlightTaskScoringState.h"
+
+FlightTaskScoringState::FlightTaskScoringState(const FlightTask *task) :
+    _task(task), _positionCount(0)
+{
+}
+
+FlightTaskScoringState::~FlightTaskScoringState()
+{
+}
+
+void FlightTaskScoringState::append(const Position &pos)
+{
+    this->doAppend(pos);
+    _positionCount++;
+}
+
+void FlightTaskScoringState::copyFrom(const FlightTaskScoringState &other)
+{
+    Q_ASSERT(other.task() == this->task());
+    this->doCopyFrom(other);
+    _positionCount = other._positionCount;
+}
+
+qreal FlightTaskScoringState::guidanceDistance() const
+{
+    return -1.0;
+}
+
+int FlightTaskScoringState::positionCount() const
+{
+    return _positionCount;
+}
+
+const FlightTask *FlightTaskScoringState::task() const
+{
+    return _task;
+}
@@ -0,0 +1,72 @@
+#ifndef FLIGHTTASKSCORINGSTATE_H
+#define FLIGHTTASKSCORINGSTATE_H
+
+#include <QtGlobal>
+#include <QSharedPointer>
+
+#include "Position.h"
+
+class FlightTask;
+
+/**
+ * @brief The FlightTaskScoringState class scores a flight path incrementally for one FlightTask.
+ * Planners that grow paths one waypoint at a time can clone their parent's state and append() the new
+ * position instead of re-scoring the whole path with FlightTask::calculateFlightPerformance().
+ *
+ * performance() is always equal to what calculateFlightPerformance() would return for the same positions.
+ * Get one from FlightTask::createScoringState(). States only read their task, so different states (clones
+ * included) can be appended to and scored on different threads at once.
+ */
+class FlightTaskScoringState
+{
+public:
+    FlightTaskScoringState(const FlightTask * task);
+    virtual ~FlightTaskScoringState();
+
+    /**
+     * @brief clone returns an independent copy of this state. Appending to the copy does not affect us.
+     * @return
+     */
+    virtual QSharedPointer<FlightTaskScoringState> clone() const=0;
+
+    /**
+     * @brief copyFrom makes this state equal to other, which must have been created by the same task.
+     * Unlike clone() it reuses this object, so planners that pool their states can overwrite them in place.
+     * @param other
+     */
+    void copyFrom(const FlightTaskScoringState& other);
+
+    /**
+     * @brief append extends the scored path by one position.
+     * @param pos
+     */
+    void append(const Position& pos);
+
+    /**
+     * @brief performance returns the task's performance for every position appended so far.
+     * @return
+     */
+    virtual qreal performance() const=0;
+
+    /**
+     * @brief guidanceDistance returns about how far (in meters) the last position appended is from the nearest
+     * place the task still wants flown, for searches to head for. It doesn't affect performance(). Negative if
+     * there's nowhere left or the task can't tell, which is the default.
+     * @return
+     */
+    virtual qreal guidanceDistance() const;
+
+    int positionCount() const;
+
+    const FlightTask * task() const;
+
+protected:
+    virtual void doAppend(const Position& pos)=0;
+    virtual void doCopyFrom(const FlightTaskScoringState& other)=0;
+
+private:
+    const FlightTask * _task;
+    int _positionCount;
+};
+
+#endif // FLIGHTTASKSCORINGSTATE_H
@@ -1,9 +1,72 @@
 #include "FlyThroughTask.h"
 
-#include "guts/Conversions.h"
+#include "AreaScoringContext.h"
+#include "PolygonIndex.h"
 
 #include <QtDebug>
 
+/*
+ * Once any position is inside the area we're done. Until then only the first and last positions matter.
+*/
+class FlyThroughScoringState : public FlightTaskScoringState
+{
+public:
+    FlyThroughScoringState(const FlyThroughTask * task, const QPolygonF& geoPoly) :
+        FlightTaskScoringState(task), _area(geoPoly), _goalLonLat(geoPoly.boundingRect().center()),
+        _flownThrough(false), _firstAltitude(0.0)
+    {
+    }
+
+    //pure-virtual from FlightTaskScoringState
+    virtual QSharedPointer<FlightTaskScoringState> clone() const
+    {
+        return QSharedPointer<FlightTaskScoringState>(new FlyThroughScoringState(*this));
+    }
+
+    //pure-virtual from FlightTaskScoringState
+    virtual qreal performance() const
+    {
+        if (this->positionCount() == 0)
+            return 0.0;
+        else if (_flownThrough)
+            return this->task()->maxTaskPerformance();
+
+        //Same as FlyThroughTask::calculateFlightPerformance
+        Position goalPos(_goalLonLat, _firstAltitude);
+        const qreal dist = _last.distanceTo(goalPos, Position::LocalENU);
+
+        const qreal stdDev = 90.0;
+        qreal toRet = 100*FlightTask::normal(dist,stdDev,2000);
+
+        return qMin<qreal>(toRet,this->task()->maxTaskPerformance());
+    }
+
+protected:
+    //pure-virtual from FlightTaskScoringState
+    virtual void doAppend(const Position &pos)
+    {
+        if (this->positionCount() == 0)
+            _firstAltitude = pos.altitude();
+        _last = pos;
+
+        if (!_flownThrough && _area.contains(pos.lonLat()))
+            _flownThrough = true;
+    }
+
+    //pure-virtual from FlightTaskScoringState
+    virtual void doCopyFrom(const FlightTaskScoringState &other)
+    {
+        *this = static_cast<const FlyThroughScoringState&>(other);
+    }
+
+private:
+    PolygonIndex _area;
+    QPointF _goalLonLat;
+    bool _flownThrough;
+    qreal _firstAltitude;
+    Position _last;
+};
+
 FlyThroughTask::FlyThroughTask()
 {
 }
@@ -31,24 +94,45 @@ QString FlyThroughTask::taskType() const
     return "Fly Through";
 }
 
+//virtual from FlightTask
+QSharedPointer<FlightTaskScoringState> FlyThroughTask::createScoringState(const QPolygonF &geoPoly,
+                                                                          const UAVParameters &) const
+{
+    return QSharedPointer<FlightTaskScoringState>(new FlyThroughScoringState(this, geoPoly));
+}
+
 qreal FlyThroughTask::calculateFlightPerformance(const QList<Position> &positions,
                                                  const QPolygonF &geoPoly,
-                                                 const UAVParameters &)
+                                                 const UAVParameters &) const
 {
     //First, see if one of the points is within the polygon
+    const PolygonIndex area(geoPoly);
     foreach(const Position& pos, positions)
     {
-        if (geoPoly.containsPoint(pos.lonLat(), Qt::OddEvenFill))
+        if (area.contains(pos.lonLat()))
             return this->maxTaskPerformance();
     }
 
-    //if that fails, take the distance to the last point
+    return _approachPerformance(positions, geoPoly);
+}
+
+//virtual from FlightTask
+qreal FlyThroughTask::calculateAreaPerformance(const AreaScoringContext &context) const
+{
+    if (context.insideCount() > 0)
+        return this->maxTaskPerformance();
+    return _approachPerformance(context.positions(), context.geoPoly());
+}
+
+//private
+qreal FlyThroughTask::_approachPerformance(const QList<Position> &positions, const QPolygonF &geoPoly) const
+{
+    //Nothing inside, so take the distance from the last point
     Position goalPos(geoPoly.boundingRect().center(),
                      positions.first().altitude());
 
     const Position& last = positions.last();
-    QVector3D enuPos = Conversions::lla2enu(last, goalPos);
-    qreal dist = enuPos.length();
+    const qreal dist = last.distanceTo(goalPos, Position::LocalENU);
 
     const qreal stdDev = 90.0;
     qreal toRet = 100*FlightTask::normal(dist,stdDev,2000);
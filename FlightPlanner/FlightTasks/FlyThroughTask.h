@@ -22,11 +22,21 @@ public:
 
     virtual qreal calculateFlightPerformance(const QList<Position>& positions,
                                              const QPolygonF& geoPoly,
-                                             const UAVParameters& uavParams);
+                                             const UAVParameters& uavParams) const;
+
+    //virtual from FlightTask
+    virtual qreal calculateAreaPerformance(const AreaScoringContext& context) const;
+
+    //virtual from FlightTask
+    virtual QSharedPointer<FlightTaskScoringState> createScoringState(const QPolygonF& geoPoly,
+                                                                      const UAVParameters& uavParams) const;
     
 signals:
     
 public slots:
+
+private:
+    qreal _approachPerformance(const QList<Position>& positions, const QPolygonF& geoPoly) const;
     
 };
 
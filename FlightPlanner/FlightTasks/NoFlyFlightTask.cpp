@@ -1,5 +1,52 @@
 #include "NoFlyFlightTask.h"
 
+#include "AreaScoringContext.h"
+#include "PolygonIndex.h"
+
+/*
+ * A single position inside the area ruins the whole flight, so all we remember is whether that happened.
+*/
+class NoFlyScoringState : public FlightTaskScoringState
+{
+public:
+    NoFlyScoringState(const NoFlyFlightTask * task, const QPolygonF& geoPoly) :
+        FlightTaskScoringState(task), _area(geoPoly), _violated(false)
+    {
+    }
+
+    //pure-virtual from FlightTaskScoringState
+    virtual QSharedPointer<FlightTaskScoringState> clone() const
+    {
+        return QSharedPointer<FlightTaskScoringState>(new NoFlyScoringState(*this));
+    }
+
+    //pure-virtual from FlightTaskScoringState
+    virtual qreal performance() const
+    {
+        if (_violated)
+            return 0.0;
+        return this->task()->maxTaskPerformance();
+    }
+
+protected:
+    //pure-virtual from FlightTaskScoringState
+    virtual void doAppend(const Position &pos)
+    {
+        if (!_violated && _area.contains(pos.lonLat()))
+            _violated = true;
+    }
+
+    //pure-virtual from FlightTaskScoringState
+    virtual void doCopyFrom(const FlightTaskScoringState &other)
+    {
+        *this = static_cast<const NoFlyScoringState&>(other);
+    }
+
+private:
+    PolygonIndex _area;
+    bool _violated;
+};
+
 NoFlyFlightTask::NoFlyFlightTask()
 {
 }
@@ -28,22 +75,37 @@ bool NoFlyFlightTask::shortnessRewardApplies() const
     return false;
 }
 
+//virtual from FlightTask
+bool NoFlyFlightTask::scoresOnlyInsideArea() const
+{
+    //Only entering the area costs anything
+    return true;
+}
+
 //pure-virtual from FlightTask
 QString NoFlyFlightTask::taskType() const
 {
     return "No-Fly Zone";
 }
 
+//virtual from FlightTask
+QSharedPointer<FlightTaskScoringState> NoFlyFlightTask::createScoringState(const QPolygonF &geoPoly,
+                                                                           const UAVParameters &) const
+{
+    return QSharedPointer<FlightTaskScoringState>(new NoFlyScoringState(this, geoPoly));
+}
+
 //pure-virtual from FlightTask
 qreal NoFlyFlightTask::calculateFlightPerformance(const QList<Position> &positions,
                                                   const QPolygonF &geoPoly,
-                                                  const UAVParameters &)
+                                                  const UAVParameters &) const
 {
     qreal fitness = this->maxTaskPerformance();
 
+    const PolygonIndex area(geoPoly);
     foreach(const Position& pos, positions)
     {
-        if (geoPoly.containsPoint(pos.lonLat(), Qt::OddEvenFill))
+        if (area.contains(pos.lonLat()))
         {
             fitness = 0.0;
             break;
@@ -52,3 +114,11 @@ qreal NoFlyFlightTask::calculateFlightPerformance(const QList<Position> &positio
 
     return fitness;
 }
+
+//virtual from FlightTask
+qreal NoFlyFlightTask::calculateAreaPerformance(const AreaScoringContext &context) const
+{
+    if (context.insideCount() > 0)
+        return 0.0;
+    return this->maxTaskPerformance();
+}
@@ -21,13 +21,23 @@ public:
     //virtual from FlightTask
     virtual bool shortnessRewardApplies() const;
 
+    //virtual from FlightTask
+    virtual bool scoresOnlyInsideArea() const;
+
     //pure-virtual from FlightTask
     virtual QString taskType() const;
 
     //pure-virtual from FlightTask
     virtual qreal calculateFlightPerformance(const QList<Position>& positions,
                                              const QPolygonF& geoPoly,
-                                             const UAVParameters& uavParams);
+                                             const UAVParameters& uavParams) const;
+
+    //virtual from FlightTask
+    virtual qreal calculateAreaPerformance(const AreaScoringContext& context) const;
+
+    //virtual from FlightTask
+    virtual QSharedPointer<FlightTaskScoringState> createScoringState(const QPolygonF& geoPoly,
+                                                                      const UAVParameters& uavParams) const;
 };
 
 #endif // NOFLYFLIGHTTASK_H
@@ -0,0 +1,167 @@
+#include "PolygonIndex.h"
+
+#include <cmath>
+
+//Bands are about one edge tall. Past this many, extra bands stop paying for the memory.
+const int MAX_BANDS = 256;
+
+PolygonIndex::PolygonIndex() :
+    _minX(0.0), _maxX(0.0), _minY(0.0), _maxY(0.0), _bandHeight(1.0)
+{
+}
+
+PolygonIndex::PolygonIndex(const QPolygonF &polygon) :
+    _minX(0.0), _maxX(0.0), _minY(0.0), _maxY(0.0), _bandHeight(1.0)
+{
+    this->build(polygon);
+}
+
+void PolygonIndex::build(const QPolygonF &polygon)
+{
+    this->clear();
+    if (polygon.isEmpty())
+        return;
+
+    //The same edges QPolygonF::containsPoint() looks at, low end first
+    QVector<QPointF> lows;
+    QVector<QPointF> highs;
+    for (int i = 0; i < polygon.size(); i++)
+    {
+        const QPointF& p1 = polygon.at(i);
+        const QPointF& p2 = (i + 1 < polygon.size()) ? polygon.at(i + 1) : polygon.first();
+        if (i + 1 == polygon.size() && p1 == p2)
+            break;
+
+        //Horizontal edges never count (scan conversion rule)
+        if (qFuzzyCompare(p1.y(), p2.y()))
+            continue;
+        else if (p1.y() < p2.y())
+        {
+            lows.append(p1);
+            highs.append(p2);
+        }
+        else
+        {
+            lows.append(p2);
+            highs.append(p1);
+        }
+    }
+
+    const QRectF bounds = polygon.boundingRect();
+    _minX = bounds.left();
+    _maxX = bounds.right();
+    _minY = bounds.top();
+    _maxY = bounds.bottom();
+
+    const int bandCount = qBound<int>(1, lows.size(), MAX_BANDS);
+    _bandHeight = (_maxY - _minY) / bandCount;
+    if (_bandHeight <= 0.0)
+        _bandHeight = 1.0;
+
+    //Count each band's edges first so that every band's edges end up next to each other
+    QVector<int> counts(bandCount, 0);
+    for (int i = 0; i < lows.size(); i++)
+    {
+        const int last = _bandFor(highs.at(i).y());
+        for (int band = _bandFor(lows.at(i).y()); band <= last; band++)
+            counts[band]++;
+    }
+
+    _bandStarts.resize(bandCount + 1);
+    _bandStarts[0] = 0;
+    for (int band = 0; band < bandCount; band++)
+        _bandStarts[band + 1] = _bandStarts.at(band) + counts.at(band);
+
+    const int total = _bandStarts.last();
+    _edgeX1.resize(total);
+    _edgeY1.resize(total);
+    _edgeY2.resize(total);
+    _edgeSlopes.resize(total);
+
+    QVector<int> next = _bandStarts;
+    for (int i = 0; i < lows.size(); i++)
+    {
+        const QPointF& low = lows.at(i);
+        const QPointF& high = highs.at(i);
+
+        //Computed exactly the way QPolygonF does so that we agree on points right at an edge
+        const qreal slope = (high.x() - low.x()) / (high.y() - low.y());
+
+        const int last = _bandFor(high.y());
+        for (int band = _bandFor(low.y()); band <= last; band++)
+        {
+            const int slot = next[band]++;
+            _edgeX1[slot] = low.x();
+            _edgeY1[slot] = low.y();
+            _edgeY2[slot] = high.y();
+            _edgeSlopes[slot] = slope;
+        }
+    }
+}
+
+void PolygonIndex::clear()
+{
+    _minX = _maxX = _minY = _maxY = 0.0;
+    _bandHeight = 1.0;
+    _bandStarts.clear();
+    _edgeX1.clear();
+    _edgeY1.clear();
+    _edgeY2.clear();
+    _edgeSlopes.clear();
+}
+
+bool PolygonIndex::isEmpty() const
+{
+    return _bandStarts.isEmpty();
+}
+
+bool PolygonIndex::contains(const QPointF &point) const
+{
+    const qreal x = point.x();
+    const qreal y = point.y();
+    if (this->isEmpty() || x < _minX || x > _maxX || y < _minY || y >= _maxY)
+        return false;
+    return (_crossings(_bandFor(y), x, y) % 2) != 0;
+}
+
+void PolygonIndex::contains(const qreal *xs, const qreal *ys, int count, bool *inside) const
+{
+    for (int i = 0; i < count; i++)
+    {
+        const qreal x = xs[i];
+        const qreal y = ys[i];
+        if (this->isEmpty() || x < _minX || x > _maxX || y < _minY || y >= _maxY)
+            inside[i] = false;
+        else
+            inside[i] = (_crossings(_bandFor(y), x, y) % 2) != 0;
+    }
+}
+
+//private
+int PolygonIndex::_bandFor(qreal y) const
+{
+    const int bandCount = _bandStarts.size() - 1;
+    const int band = (int) std::floor((y - _minY) / _bandHeight);
+    return qBound<int>(0, band, bandCount - 1);
+}
+
+//private
+int PolygonIndex::_crossings(int band, qreal x, qreal y) const
+{
+    const int first = _bandStarts.at(band);
+    const int last = _bandStarts.at(band + 1);
+    const qreal * x1 = _edgeX1.constData();
+    const qreal * y1 = _edgeY1.constData();
+    const qreal * y2 = _edgeY2.constData();
+    const qreal * slopes = _edgeSlopes.constData();
+
+    //Bands keep any edge that touches them, so the span test is still needed. No branches, so it vectorizes.
+    int toRet = 0;
+    for (int i = first; i < last; i++)
+    {
+        const bool spans = (y >= y1[i]) & (y < y2[i]);
+        const bool left = (x1[i] + slopes[i] * (y - y1[i])) <= x;
+        toRet += spans & left;
+    }
+    return toRet;
+}
@@ -0,0 +1,67 @@
+#ifndef POLYGONINDEX_H
+#define POLYGONINDEX_H
+
+#include <QtGlobal>
+#include <QPointF>
+#include <QPolygonF>
+#include <QVector>
+
+/**
+ * @brief The PolygonIndex class answers point-in-polygon queries against one polygon faster than
+ * QPolygonF::containsPoint(), which walks every edge for every point.
+ *
+ * The polygon's bounding box is cut into horizontal bands, and each band keeps the edges that reach into it.
+ * A query rejects points outside the bounding box and then only counts crossings against its band's edges.
+ * Crossings use the same rules as QPolygonF::containsPoint() with Qt::OddEvenFill (half-open edges,
+ * (nearly) horizontal edges ignored, implicit closing edge), so the answers are the same.
+ *
+ * Build one per polygon and reuse it. PolygonIndex is a value type and cheap to copy.
+ */
+class PolygonIndex
+{
+public:
+    PolygonIndex();
+    explicit PolygonIndex(const QPolygonF& polygon);
+
+    /**
+     * @brief build replaces the contents of the index with the given polygon.
+     * @param polygon
+     */
+    void build(const QPolygonF& polygon);
+
+    void clear();
+
+    bool isEmpty() const;
+
+    /**
+     * @brief contains returns true if point is inside the polygon by the odd-even rule.
+     * @param point
+     * @return
+     */
+    bool contains(const QPointF& point) const;
+
+    /**
+     * @brief contains is the batch version of the above. It checks the count points given by xs and ys and
+     * sets the matching entry of inside.
+     */
+    void contains(const qreal * xs, const qreal * ys, int count, bool * inside) const;
+
+private:
+    int _bandFor(qreal y) const;
+    int _crossings(int band, qreal x, qreal y) const;
+
+    qreal _minX;
+    qreal _maxX;
+    qreal _minY;
+    qreal _maxY;
+    qreal _bandHeight;
+
+    //The edges of band b are [_bandStarts[b], _bandStarts[b+1]) in the arrays below, oriented so y1 < y2
+    QVector<int> _bandStarts;
+    QVector<qreal> _edgeX1;
+    QVector<qreal> _edgeY1;
+    QVector<qreal> _edgeY2;
+    QVector<qreal> _edgeSlopes;
+};
+
+#endif // POLYGONINDEX_H
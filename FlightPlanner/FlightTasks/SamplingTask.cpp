@@ -1,5 +1,52 @@
 #include "SamplingTask.h"
 
+#include "AreaScoringContext.h"
+#include "PolygonIndex.h"
+
+/*
+ * Sampling performance is just a sum over the positions, so we only need to keep the running total.
+*/
+class SamplingScoringState : public FlightTaskScoringState
+{
+public:
+    SamplingScoringState(const SamplingTask * task, const QPolygonF& geoPoly, const UAVParameters& uavParams) :
+        FlightTaskScoringState(task), _area(geoPoly),
+        _secondsPerWaypoint(uavParams.waypointInterval() / uavParams.airspeed()), _time(0.0)
+    {
+    }
+
+    //pure-virtual from FlightTaskScoringState
+    virtual QSharedPointer<FlightTaskScoringState> clone() const
+    {
+        return QSharedPointer<FlightTaskScoringState>(new SamplingScoringState(*this));
+    }
+
+    //pure-virtual from FlightTaskScoringState
+    virtual qreal performance() const
+    {
+        return _time;
+    }
+
+protected:
+    //pure-virtual from FlightTaskScoringState
+    virtual void doAppend(const Position &pos)
+    {
+        if (_area.contains(pos.lonLat()))
+            _time += _secondsPerWaypoint;
+    }
+
+    //pure-virtual from FlightTaskScoringState
+    virtual void doCopyFrom(const FlightTaskScoringState &other)
+    {
+        *this = static_cast<const SamplingScoringState&>(other);
+    }
+
+private:
+    PolygonIndex _area;
+    qreal _secondsPerWaypoint;
+    qreal _time;
+};
+
 SamplingTask::SamplingTask(const qreal timeRequired) : _timeRequired(timeRequired)
 {
 }
@@ -30,6 +77,13 @@ bool SamplingTask::shortnessRewardApplies() const
     return true;
 }
 
+//virtual from FlightTask
+bool SamplingTask::scoresOnlyInsideArea() const
+{
+    //Only time spent inside the area counts
+    return true;
+}
+
 //virtual from FlightTask
 QString SamplingTask::taskType() const
 {
@@ -39,13 +93,23 @@ QString SamplingTask::taskType() const
 //virtual from FlightTask
 qreal SamplingTask::calculateFlightPerformance(const QList<Position> &positions,
                                                const QPolygonF &geoPoly,
-                                               const UAVParameters &uavParams)
+                                               const UAVParameters &uavParams) const
 {
     qreal toRet = 0.0;
 
-    foreach(const Position& pos, positions)
+    QVector<qreal> lons(positions.size());
+    QVector<qreal> lats(positions.size());
+    for (int i = 0; i < positions.size(); i++)
     {
-        if (!geoPoly.containsPoint(pos.lonLat(), Qt::OddEvenFill))
+        lons[i] = positions.at(i).longitude();
+        lats[i] = positions.at(i).latitude();
+    }
+    QVector<bool> inside(positions.size());
+    PolygonIndex(geoPoly).contains(lons.constData(), lats.constData(), positions.size(), inside.data());
+
+    foreach(bool isInside, inside)
+    {
+        if (!isInside)
             continue;
 
         //Estimate the amount of time flown within the area, presumably sampling while doing so
@@ -55,6 +119,24 @@ qreal SamplingTask::calculateFlightPerformance(const QList<Position> &positions,
     return toRet;
 }
 
+//virtual from FlightTask
+qreal SamplingTask::calculateAreaPerformance(const AreaScoringContext &context) const
+{
+    //Summed like calculateFlightPerformance() does, so the two agree to the last bit
+    const UAVParameters& uavParams = context.uavParams();
+    qreal toRet = 0.0;
+    for (int i = 0; i < context.insideCount(); i++)
+        toRet += uavParams.waypointInterval() / uavParams.airspeed();
+    return toRet;
+}
+
+//virtual from FlightTask
+QSharedPointer<FlightTaskScoringState> SamplingTask::createScoringState(const QPolygonF &geoPoly,
+                                                                        const UAVParameters &uavParams) const
+{
+    return QSharedPointer<FlightTaskScoringState>(new SamplingScoringState(this, geoPoly, uavParams));
+}
+
 //virtual from FlightTask
 qreal SamplingTask::maxTaskPerformance() const
 {
@@ -20,11 +20,21 @@ public:
 
     virtual bool shortnessRewardApplies() const;
 
+    //virtual from FlightTask
+    virtual bool scoresOnlyInsideArea() const;
+
     virtual QString taskType() const;
 
     virtual qreal calculateFlightPerformance(const QList<Position>& positions,
                                              const QPolygonF& geoPoly,
-                                             const UAVParameters& uavParams);
+                                             const UAVParameters& uavParams) const;
+
+    //virtual from FlightTask
+    virtual qreal calculateAreaPerformance(const AreaScoringContext& context) const;
+
+    //virtual from FlightTask
+    virtual QSharedPointer<FlightTaskScoringState> createScoringState(const QPolygonF& geoPoly,
+                                                                      const UAVParameters& uavParams) const;
 
     virtual qreal maxTaskPerformance() const;
 
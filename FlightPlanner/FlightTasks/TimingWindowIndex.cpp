@@ -0,0 +1,116 @@
+#include "TimingWindowIndex.h"
+
+#include <algorithm>
+#include <limits>
+
+//non-member
+static bool startsBefore(const TimingConstraint& a, const TimingConstraint& b)
+{
+    if (a.start() != b.start())
+        return a.start() < b.start();
+    return a.end() < b.end();
+}
+
+TimingWindowIndex::TimingWindowIndex()
+{
+}
+
+TimingWindowIndex::TimingWindowIndex(const QVector<TimingConstraint> &windows)
+{
+    this->build(windows);
+}
+
+void TimingWindowIndex::build(const QVector<TimingConstraint> &windows)
+{
+    this->clear();
+
+    QVector<TimingConstraint> sorted = windows;
+    std::sort(sorted.begin(), sorted.end(), startsBefore);
+    foreach(const TimingConstraint& window, sorted)
+    {
+        //Windows that end before they start allow nothing
+        if (window.end() < window.start())
+            continue;
+
+        if (!_ends.isEmpty() && window.start() <= _ends.last())
+            _ends.last() = qMax<qreal>(_ends.last(), window.end());
+        else
+        {
+            _starts.append(window.start());
+            _ends.append(window.end());
+        }
+    }
+
+    _longestFrom.resize(_starts.size());
+    qreal longest = 0.0;
+    for (int i = _starts.size() - 1; i >= 0; i--)
+    {
+        longest = qMax<qreal>(longest, _ends.at(i) - _starts.at(i));
+        _longestFrom[i] = longest;
+    }
+}
+
+void TimingWindowIndex::clear()
+{
+    _starts.clear();
+    _ends.clear();
+    _longestFrom.clear();
+}
+
+bool TimingWindowIndex::isEmpty() const
+{
+    return _starts.isEmpty();
+}
+
+bool TimingWindowIndex::contains(qreal startTime, qreal endTime) const
+{
+    if (this->isEmpty())
+        return true;
+
+    const int window = _windowAt(startTime);
+    return window >= 0 && endTime <= _ends.at(window);
+}
+
+qreal TimingWindowIndex::nextFit(qreal time, qreal duration) const
+{
+    if (this->isEmpty())
+        return time;
+
+    //Maybe right away, in the window we're in
+    const int current = _windowAt(time);
+    if (current >= 0 && time + duration <= _ends.at(current))
+        return time;
+
+    //Otherwise at the start of the first later window that's long enough
+    int window = std::upper_bound(_starts.constBegin(), _starts.constEnd(), time) - _starts.constBegin();
+    for (; window < _starts.size() && _longestFrom.at(window) >= duration; window++)
+    {
+        if (_ends.at(window) - _starts.at(window) >= duration)
+            return _starts.at(window);
+    }
+    return std::numeric_limits<qreal>::max();
+}
+
+qreal TimingWindowIndex::earliestStart() const
+{
+    if (this->isEmpty())
+        return 0.0;
+    return _starts.first();
+}
+
+qreal TimingWindowIndex::latestEnd() const
+{
+    if (this->isEmpty())
+        return std::numeric_limits<qreal>::max();
+    return _ends.last();
+}
+
+//private
+int TimingWindowIndex::_windowAt(qreal time) const
+{
+    //The last window starting no later than time, if time isn't past its end
+    const int window = std::upper_bound(_starts.constBegin(), _starts.constEnd(), time) - _starts.constBegin() - 1;
+    if (window < 0 || time > _ends.at(window))
+        return -1;
+    return window;
+}
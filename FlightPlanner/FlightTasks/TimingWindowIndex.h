@@ -0,0 +1,79 @@
+#ifndef TIMINGWINDOWINDEX_H
+#define TIMINGWINDOWINDEX_H
+
+#include <QtGlobal>
+#include <QVector>
+
+#include "TimingConstraint.h"
+
+/**
+ * @brief The TimingWindowIndex class answers questions about when a task may be flown, given its timing
+ * constraints, without checking every window.
+ *
+ * A task may be flown during any of its windows (recurring observation slots, say). Overlapping and touching
+ * windows are merged and the rest sorted, so a query binary-searches for the window it falls in and only looks
+ * further while some later window is long enough. A task with no windows may be flown at any time.
+ *
+ * Build one per task and reuse it. TimingWindowIndex is a value type and cheap to copy.
+ */
+class TimingWindowIndex
+{
+public:
+    TimingWindowIndex();
+    explicit TimingWindowIndex(const QVector<TimingConstraint>& windows);
+
+    /**
+     * @brief build replaces the contents of the index with the given windows.
+     * @param windows
+     */
+    void build(const QVector<TimingConstraint>& windows);
+
+    void clear();
+
+    /**
+     * @brief isEmpty returns true if there are no windows, and so no constraint
+     * @return
+     */
+    bool isEmpty() const;
+
+    /**
+     * @brief contains returns true if [startTime, endTime] lies inside a single window
+     * @param startTime
+     * @param endTime
+     * @return
+     */
+    bool contains(qreal startTime, qreal endTime) const;
+
+    /**
+     * @brief nextFit returns the earliest start no sooner than time for which [start, start + duration] lies
+     * inside a window, or std::numeric_limits<qreal>::max() if there isn't one.
+     * @param time
+     * @param duration
+     * @return
+     */
+    qreal nextFit(qreal time, qreal duration) const;
+
+    /**
+     * @brief earliestStart returns the start of the first window, or 0 if there are none
+     * @return
+     */
+    qreal earliestStart() const;
+
+    /**
+     * @brief latestEnd returns the end of the last window, or std::numeric_limits<qreal>::max() if there are none
+     * @return
+     */
+    qreal latestEnd() const;
+
+private:
+    int _windowAt(qreal time) const;
+
+    //Disjoint and sorted
+    QVector<qreal> _starts;
+    QVector<qreal> _ends;
+
+    //The length of the longest of window i and those after it, so nextFit() knows when to stop looking
+    QVector<qreal> _longestFrom;
+};
+
+#endif // TIMINGWINDOWINDEX_H
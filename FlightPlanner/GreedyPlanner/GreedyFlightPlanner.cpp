@@ -1,88 +1,322 @@
 #include "GreedyFlightPlanner.h"
 
 #include <QtDebug>
-#include <QMutableMapIterator>
+#include <QRunnable>
+#include <QThread>
 #include <cmath>
 
 #include "guts/Conversions.h"
+#include "CompiledProblem.h"
+#include "JobSystem.h"
 
-const int GREED_DEPTH = 7;
+//Each doIteration() builds and scores at most this many nodes of the tree, so one step never takes long
+const int GREED_STEP_NODES = 512;
+
+typedef QList<QSharedPointer<FlightTaskScoringState> > ScoringStates;
+
+//non-member
+//Extends the key of a flight to the key of the same flight plus pos
+static quint64 pathKey(quint64 parentKey, const Position& pos)
+{
+    const quint64 toRet = TranspositionTable<Fitness>::mixExact(parentKey, pos.longitude());
+    return TranspositionTable<Fitness>::mixExact(toRet, pos.latitude());
+}
+
+/*
+ * Builds and scores one contiguous slice of a level of the lookahead tree. Every slot in the slice belongs
+ * to this job alone and each node extends its own copy of its parent's scoring states, so slices of the
+ * same level can run concurrently.
+*/
+class GreedyLevelJob : public QRunnable
+{
+public:
+    GreedyLevelJob(const CompiledProblem * problem,
+                   const MotionPrimitiveTable * primitives,
+                   GreedyPlanningNode * nodes,
+                   ScoringStates * states,
+                   quint64 * keys,
+                   TranspositionTable<Fitness> * fitnesses,
+                   int begin,
+                   int end) :
+        _problem(problem), _primitives(primitives), _nodes(nodes), _states(states), _keys(keys), _fitnesses(fitnesses),
+        _begin(begin), _end(end), _bestIndex(-1)
+    {
+        this->setAutoDelete(false);
+    }
+
+    //virtual from QRunnable
+    virtual void run()
+    {
+        const int branches = GreedyPlanningNode::branchFactor();
+        for (int index = _begin; index < _end; index++)
+        {
+            const int parentIndex = (index - 1) / branches;
+            _nodes[index] = _nodes[parentIndex].successor(*_primitives, (index - 1) % branches, parentIndex);
+            _keys[index] = pathKey(_keys[parentIndex], _nodes[index].position());
+
+            //Extend our parent's scores by our own position instead of re-scoring the whole flight
+            ScoringStates& states = _states[index];
+            copyScoringStates(_states[parentIndex], &states);
+            foreach(const QSharedPointer<FlightTaskScoringState>& state, states)
+                state->append(_nodes[index].position());
+
+            //Our children still need the states, but the score may be known from the last tree
+            Fitness score;
+            if (!_fitnesses->lookup(_keys[index], &score))
+            {
+                score = _problem->calculateFlightPerformance(states);
+                _fitnesses->insert(_keys[index], score);
+            }
+
+            //Same tie-breaking as scoring the nodes one after another: later nodes win
+            if (_bestIndex < 0 || score >= _bestScore)
+            {
+                _bestScore = score;
+                _bestIndex = index;
+            }
+        }
+    }
+
+    /**
+     * @brief bestIndex returns the slot of the best node in our slice, or -1 if the slice was empty.
+     * @return
+     */
+    int bestIndex() const
+    {
+        return _bestIndex;
+    }
+
+    const Fitness& bestScore() const
+    {
+        return _bestScore;
+    }
+
+    static void copyScoringStates(const ScoringStates& from, ScoringStates * to)
+    {
+        if (to->size() != from.size())
+        {
+            to->clear();
+            foreach(const QSharedPointer<FlightTaskScoringState>& state, from)
+                to->append(state->clone());
+            return;
+        }
+
+        for (int i = 0; i < from.size(); i++)
+            to->at(i)->copyFrom(*from.at(i));
+    }
+
+private:
+    const CompiledProblem * _problem;
+    const MotionPrimitiveTable * _primitives;
+    GreedyPlanningNode * _nodes;
+    ScoringStates * _states;
+    quint64 * _keys;
+    TranspositionTable<Fitness> * _fitnesses;
+    const int _begin;
+    const int _end;
+
+    int _bestIndex;
+    Fitness _bestScore;
+};
 
 GreedyFlightPlanner::GreedyFlightPlanner(QSharedPointer<PlanningProblem> prob, QObject *parent) :
-    FlightPlanner(prob, parent)
+    FlightPlanner(prob, parent), _lastHeadingBin(0), _nextSlot(1), _bestIndexThisIteration(0), _workerCount(1)
+{
+}
+
+GreedyFlightPlanner::~GreedyFlightPlanner()
+{
+    this->finishPlanningThread();
+}
+
+int GreedyFlightPlanner::workerCount() const
 {
+    return _workerCount;
+}
+
+void GreedyFlightPlanner::setWorkerCount(int count)
+{
+    _workerCount = qMax<int>(0, count);
 }
 
 //protected
 //pure-virtual from FlightPlanner
 void GreedyFlightPlanner::doStart()
 {
-    _frontier.clear();
-
-    QSharedPointer<GreedyPlanningNode> topNode(new GreedyPlanningNode(this->problem()->startingPosition(),
-                                                                      this->problem()->startingOrientation(),
-                                                                      0,
-                                                                      GREED_DEPTH));
-    //_frontier.insert(0, topNode);
-    _frontier.enqueue(topNode);
+    //The tuning says how many waypoints ahead we look
+    const int greedDepth = this->runTuning().greedDepth();
+    int treeSize = 0;
+    for (int depth = 0, levelSize = 1; depth <= greedDepth; depth++, levelSize *= GreedyPlanningNode::branchFactor())
+        treeSize += levelSize;
+
+    _nodes.resize(treeSize);
+    _nodeStates.clear();
+    _nodeStates.resize(treeSize);
+    _nodeKeys.resize(treeSize);
+
+    //Room for this tree and the one before it
+    _fitnesses.setCapacity(2 * treeSize);
+    _fitnesses.resetCounters();
+
+    _compiled = this->problem()->compile();
+
+    //Every tree is on the same lattice, so a flight comes out the same, to the bit, in whichever tree it turns up
+    _primitives = GreedyPlanningNode::primitives(_compiled->startingPosition(), _compiled->startingOrientation());
+    _nodes[0] = GreedyPlanningNode(_compiled->startingPosition(),
+                                   _compiled->startingOrientation());
+    _lastHeadingBin = 0;
+    _rootPath.clear();
+    _rootPath.append(_nodes.at(0).position());
+    _nodeStates[0] = _buildScoringStates(_rootPath);
+    _nodeKeys[0] = pathKey(0, _rootPath.first());
+
+    _bestStates = _buildScoringStates(this->bestFlightSoFar());
+    _nextSlot = 1;
 }
 
 //protected
 //pure-virtual from FlightPlanner
 void GreedyFlightPlanner::doIteration()
 {
-    if (_frontier.isEmpty())
-    {
-        UAVOrientation lastOrientation;
-        Position lastPos = _bestPathThisIteration.last();
-        if (this->bestFlightSoFar().size() >= 2)
-            lastOrientation.setRadians(_lastOrientation);
-        QSharedPointer<GreedyPlanningNode> iterTopNode(new GreedyPlanningNode(lastPos,
-                                                                              lastOrientation,
-                                                                              0,
-                                                                              GREED_DEPTH));
-        iterTopNode->setFlighPath(this->bestFlightSoFar());
-        _frontier.enqueue(iterTopNode);
-    }
+    const int workers = (_workerCount == 0) ? QThread::idealThreadCount() : _workerCount;
+    const CompiledProblem * problem = _compiled.data();
+    PlanningStatistics * statistics = this->workingStatistics();
 
-    _bestFitnessThisIteration = Fitness(0, 0);
-    _bestPathThisIteration.clear();
+    //Take the raw arrays once here so the jobs never make the containers detach
+    GreedyPlanningNode * nodes = _nodes.data();
+    ScoringStates * states = _nodeStates.data();
+    quint64 * keys = _nodeKeys.data();
+    const quint64 hitsBefore = _fitnesses.hits();
 
-    while (!_frontier.isEmpty())
+    //The root's states were set up by doStart() or the last tree
+    if (_nextSlot == 1)
     {
-        QSharedPointer<GreedyPlanningNode> top = _frontier.dequeue();
-
-        //Check out the performance of the top's flight
-        const QList<Position>& flightPath = top->flightPath();
+        _bestFitnessThisIteration = problem->calculateFlightPerformance(states[0]);
+        _bestIndexThisIteration = 0;
+        statistics->addToCounter("StatesExpanded");
+        statistics->addToCounter("FitnessEvaluations");
+        this->planningContext()->chargeNodes(1);
+    }
 
-        Fitness score = this->problem()->calculateFlightPerformance(flightPath);
+    /*
+     * Build the next few slots of the tree. They're all on one level, since each level needs the one above it
+     * finished. Split them into one slice per worker, in slot order so folding them keeps the tie-breaking.
+    */
+    int levelEnd = 1;
+    for (int levelSize = GreedyPlanningNode::branchFactor(); levelEnd <= _nextSlot;
+         levelSize *= GreedyPlanningNode::branchFactor())
+        levelEnd += levelSize;
+    const int stepBegin = _nextSlot;
+    const int stepEnd = qMin<int>(levelEnd, stepBegin + GREED_STEP_NODES);
+    const int stepSize = stepEnd - stepBegin;
+    const int jobCount = qBound<int>(1, workers, stepSize);
+    QList<GreedyLevelJob *> jobs;
+    for (int j = 0; j < jobCount; j++)
+        jobs.append(new GreedyLevelJob(problem,
+                                       &_primitives,
+                                       nodes,
+                                       states,
+                                       keys,
+                                       &_fitnesses,
+                                       stepBegin + (qint64) stepSize * j / jobCount,
+                                       stepBegin + (qint64) stepSize * (j + 1) / jobCount));
 
+    if (jobCount <= 1)
+        jobs.first()->run();
+    else
+    {
+        JobGroup group;
+        foreach(GreedyLevelJob * job, jobs)
+            group.run(job, "GreedyLevel");
+        group.wait();
+    }
 
-        if (score >= this->bestFitnessSoFar())
+    foreach(GreedyLevelJob * job, jobs)
+    {
+        if (job->bestIndex() >= 0 && job->bestScore() >= _bestFitnessThisIteration)
         {
-            this->setBestFitnessSoFar(score);
-            this->setBestFlightSoFar(flightPath);
-            _lastOrientation = top->orientation().radians();
+            _bestFitnessThisIteration = job->bestScore();
+            _bestIndexThisIteration = job->bestIndex();
         }
+    }
+    qDeleteAll(jobs);
+    _nextSlot = stepEnd;
 
-        if (score >= _bestFitnessThisIteration)
-        {
-            _bestFitnessThisIteration = score;
-            _bestPathThisIteration = flightPath;
-        }
+    //Every node we visit is scored once, unless the last tree already did
+    const quint64 reused = _fitnesses.hits() - hitsBefore;
+    statistics->addToCounter("StatesExpanded", stepSize);
+    statistics->addToCounter("FitnessEvaluations", stepSize - reused);
+    statistics->setCounter("OpenListSize", _nodes.size() - _nextSlot);
+    statistics->setCounter("TranspositionHits", _fitnesses.hits());
+    statistics->setCounter("TranspositionMisses", _fitnesses.misses());
 
-        QVector<QSharedPointer<GreedyPlanningNode> > children = top->visit();
-        foreach(QSharedPointer<GreedyPlanningNode> child, children)
-        {
-            child->setParent(top);
-            _frontier.enqueue(child);
-        }
+    //A step is short, so it's charged as a whole and the node budget stops us between steps
+    this->planningContext()->chargeNodes(stepSize);
+
+    if (_nextSlot < _nodes.size())
+        return;
+
+    /*
+     * The tree is finished. Every node that scored at least as well as everything before it used to become the
+     * best flight in turn, so the last of them is the one that sticks. That's exactly this tree's best node.
+    */
+    const int bestIndex = _bestIndexThisIteration;
+    if (_bestFitnessThisIteration >= this->bestFitnessSoFar()
+            && this->setBestFlightSoFar(_flightPathTo(bestIndex)))
+    {
+        this->setBestFitnessSoFar(_bestFitnessThisIteration);
+        GreedyLevelJob::copyScoringStates(_nodeStates.at(bestIndex), &_bestStates);
+        _lastHeadingBin = _nodes.at(bestIndex).latticePose().headingBin;
     }
+
+    //The next tree grows from the end of this tree's best flight, continuing the best flight overall
+    LatticePose root = _nodes.at(bestIndex).latticePose();
+    _rootPath = this->bestFlightSoFar();
+    root.headingBin = (_rootPath.size() >= 2) ? _lastHeadingBin : 0;
+    _nodes[0] = GreedyPlanningNode(_primitives.position(root), _primitives.orientation(root), 0, -1, root);
+    GreedyLevelJob::copyScoringStates(_bestStates, &_nodeStates[0]);
+
+    //The root's key has to describe the flight _bestStates scored, which is _rootPath
+    _nodeKeys[0] = 0;
+    foreach(const Position& pos, _rootPath)
+        _nodeKeys[0] = pathKey(_nodeKeys[0], pos);
+    _nextSlot = 1;
 }
 
 //protected
 //pure-virtual from FlightPlanner
 void GreedyFlightPlanner::doReset()
 {
-    _frontier.clear();
+    _nodes.clear();
+    _nodeStates.clear();
+    _nodeKeys.clear();
+    _fitnesses.clear();
+    _rootPath.clear();
+    _bestStates.clear();
+    _compiled.clear();
+    _nextSlot = 1;
+}
+
+//private
+QList<QSharedPointer<FlightTaskScoringState> > GreedyFlightPlanner::_buildScoringStates(const QList<Position> &path) const
+{
+    QList<QSharedPointer<FlightTaskScoringState> > toRet = _compiled->createScoringStates();
+    foreach(const QSharedPointer<FlightTaskScoringState>& state, toRet)
+    {
+        foreach(const Position& pos, path)
+            state->append(pos);
+    }
+    return toRet;
+}
+
+//private
+QList<Position> GreedyFlightPlanner::_flightPathTo(int index) const
+{
+    QList<Position> toRet = _rootPath;
+
+    //Walking up from the node gives positions in reverse, so keep inserting right after the root's flight
+    const int rootPathSize = toRet.size();
+    for (int i = index; i > 0; i = _nodes.at(i).parentIndex())
+        toRet.insert(rootPathSize, _nodes.at(i).position());
+    return toRet;
 }
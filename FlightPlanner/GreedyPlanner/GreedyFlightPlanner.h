@@ -3,10 +3,12 @@
 
 #include "FlightPlanner.h"
 #include "GreedyPlanningNode.h"
+#include "TranspositionTable.h"
 
-#include <QMap>
 #include <QSharedPointer>
-#include <QQueue>
+#include <QVector>
+
+class CompiledProblem;
 
 class GreedyFlightPlanner : public FlightPlanner
 {
@@ -14,7 +16,18 @@ class GreedyFlightPlanner : public FlightPlanner
 public:
     explicit GreedyFlightPlanner(QSharedPointer<PlanningProblem> prob = QSharedPointer<PlanningProblem>(),
                                  QObject *parent = 0);
-    
+    virtual ~GreedyFlightPlanner();
+
+    /**
+     * @brief workerCount returns the number of slices each level of the lookahead tree is split into to be built
+     * and scored in parallel, on JobSystem::shared(). 1 (the default) scores serially. 0 means "use
+     * QThread::idealThreadCount()".
+     * The flight found is the same either way.
+     * @return
+     */
+    int workerCount() const;
+    void setWorkerCount(int count);
+
 signals:
     
 public slots:
@@ -30,13 +43,52 @@ protected:
     virtual void doReset();
 
 private:
-    //QMap<qreal, QSharedPointer<GreedyPlanningNode> > _frontier;
-    QQueue<QSharedPointer<GreedyPlanningNode> > _frontier;
+    QList<QSharedPointer<FlightTaskScoringState> > _buildScoringStates(const QList<Position>& path) const;
+    QList<Position> _flightPathTo(int index) const;
+
+    //The problem as of doStart()
+    QSharedPointer<const CompiledProblem> _compiled;
+
+    /*
+     * Every node of an iteration's search tree in breadth-first order. The tree is complete, so the children
+     * of node i are always at branchFactor()*i + 1 onwards. Sized once in doStart() and overwritten by each
+     * iteration. _nodes[0] is the root, which the next iteration's tree grows from.
+    */
+    QVector<GreedyPlanningNode> _nodes;
 
-    qreal _lastOrientation;
+    //_nodeStates[i] scores the flight to _nodes[i]. Cloned the first time a slot is used, overwritten after that.
+    QVector<QList<QSharedPointer<FlightTaskScoringState> > > _nodeStates;
 
+    //The flight to the root, shared by every node in the tree
+    QList<Position> _rootPath;
+
+    /*
+     * _nodeKeys[i] is a rolling hash of the whole flight to _nodes[i], so the same flight gets the same key in
+     * whichever tree it turns up. The next tree grows from a node of this one, so its upper levels are flights
+     * we've scored already and _fitnesses remembers their scores.
+    */
+    QVector<quint64> _nodeKeys;
+    TranspositionTable<Fitness> _fitnesses;
+
+    //Scores bestFlightSoFar(). Becomes the next root's scoring states.
+    QList<QSharedPointer<FlightTaskScoringState> > _bestStates;
+
+    //The heading bin bestFlightSoFar() ends in
+    qint32 _lastHeadingBin;
+
+    //Every tree's successors, from the start of the flight
+    MotionPrimitiveTable _primitives;
+
+    /*
+     * A tree is built over several doIteration() steps, a bounded number of slots at a time, so the planner hands
+     * control back often even when it isn't on its own thread. The next slot to build (1 when a tree is about to
+     * start) and the best node of the tree so far.
+    */
+    int _nextSlot;
     Fitness _bestFitnessThisIteration;
-    QList<Position> _bestPathThisIteration;
+    int _bestIndexThisIteration;
+
+    int _workerCount;
 };
 
 #endif // GREEDYFLIGHTPLANNER_H
@@ -1,6 +1,5 @@
 #include "GreedyPlanningNode.h"
 
-#include <QScopedPointer>
 #include <cmath>
 
 #include "guts/Conversions.h"
@@ -8,20 +7,19 @@
 const qreal minTurningRadius = 100.0;
 const qreal speedMetersPerSecond = 15.0;
 const qreal secondsPerStep = 5;
-const qreal branchFactor = 3;
+const int branchCount = 3;
+
+//How far each step flies
+const qreal stepMeters = 45.0;
 
 const qreal PI = 3.1415926535897932384626433;
 
 GreedyPlanningNode::GreedyPlanningNode(const Position &pos,
                                        const UAVOrientation &orientation,
                                        int depth,
-                                       int maxDepth,
-                                       QSharedPointer<GreedyPlanningNode> parent) :
-    _pos(pos), _orientation(orientation), _depth(depth), _maxDepth(maxDepth), _parent(parent), _visited(false)
-{
-}
-
-GreedyPlanningNode::~GreedyPlanningNode()
+                                       int parentIndex,
+                                       const LatticePose &latticePose) :
+    _pos(pos), _orientation(orientation), _depth(depth), _parentIndex(parentIndex), _latticePose(latticePose)
 {
 }
 
@@ -40,24 +38,32 @@ int GreedyPlanningNode::depth() const
     return _depth;
 }
 
-int GreedyPlanningNode::maxDepth() const
+int GreedyPlanningNode::parentIndex() const
 {
-    return _maxDepth;
+    return _parentIndex;
 }
 
-bool GreedyPlanningNode::isVisited() const
+const LatticePose &GreedyPlanningNode::latticePose() const
 {
-    return _visited;
+    return _latticePose;
 }
 
-QVector<QSharedPointer<GreedyPlanningNode> > GreedyPlanningNode::visit()
+//static
+int GreedyPlanningNode::branchFactor()
 {
-    _visited = true;
+    return branchCount;
+}
 
-    QVector<QSharedPointer<GreedyPlanningNode> > toRet;
+//static
+MotionPrimitiveTable GreedyPlanningNode::primitives(const Position &origin, const UAVOrientation &originPose)
+{
+    return MotionPrimitiveTable(stepMeters, PI / 4.0, (branchCount - 1) / 2, origin, originPose);
+}
 
-    if (this->depth() >= this->maxDepth())
-        return toRet;
+GreedyPlanningNode GreedyPlanningNode::successor(const MotionPrimitiveTable &primitives, int branch,
+                                                 int ourIndex) const
+{
+    Q_ASSERT(branch >= 0 && branch < branchCount);
 
     /*
     QVector<qreal> radii;
@@ -115,44 +121,11 @@ QVector<QSharedPointer<GreedyPlanningNode> > GreedyPlanningNode::visit()
     }
     */
 
-    for (int i = -1; i <= 1; i++)
-    {
-        qreal successorRadians = this->orientation().radians() + i*(PI / 4.0);
-        QVector3D successorENU(cos(successorRadians), sin(successorRadians), 0);
-        successorENU *= 45.0;
-        Position successorPos = Position::fromENU(this->position(), successorENU);
-        UAVOrientation successorPose(successorRadians);
-        toRet.append(QSharedPointer<GreedyPlanningNode>(new GreedyPlanningNode(successorPos,
-                                                                               successorPose,
-                                                                               this->depth() + 1,
-                                                                               this->maxDepth())));
-    }
-
-    return toRet;
-}
-
-const QSharedPointer<GreedyPlanningNode> &GreedyPlanningNode::parent() const
-{
-    return _parent;
-}
-
-void GreedyPlanningNode::setParent(const QSharedPointer<GreedyPlanningNode> &nParent)
-{
-    _parent = nParent;
-}
-
-const QList<Position> &GreedyPlanningNode::flightPath()
-{
-    if (_flightPath.isEmpty())
-    {
-        if (!this->parent().isNull())
-            _flightPath = this->parent()->flightPath();
-        _flightPath.append(this->position());
-    }
-    return _flightPath;
-}
-
-void GreedyPlanningNode::setFlighPath(const QList<Position> &flightPath)
-{
-    _flightPath = flightPath;
+    //Branches are 45 degrees right, straight ahead, and 45 degrees left, looked up rather than worked out
+    const LatticePose successorLattice = primitives.successor(_latticePose, branch);
+    return GreedyPlanningNode(primitives.position(successorLattice),
+                              primitives.orientation(successorLattice),
+                              this->depth() + 1,
+                              ourIndex,
+                              successorLattice);
 }
@@ -1,47 +1,67 @@
 #ifndef GREEDYPLANNINGNODE_H
 #define GREEDYPLANNINGNODE_H
 
-#include <QSharedPointer>
-#include <QVector>
-#include <QList>
-
 #include "Position.h"
 #include "UAVOrientation.h"
+#include "MotionPrimitiveTable.h"
 
+/**
+ * @brief The GreedyPlanningNode class is one waypoint in GreedyFlightPlanner's search tree.
+ * Nodes are plain values stored in the planner's node arena and refer to their parent by index, so the
+ * flight path to a node is the path to its parent plus position(). Nothing is copied per node.
+ */
 class GreedyPlanningNode
 {
 public:
     GreedyPlanningNode(const Position& pos = Position(),
                        const UAVOrientation& orientation = UAVOrientation(),
                        int depth=0,
-                       int maxDepth = 100,
-                       QSharedPointer<GreedyPlanningNode> parent = QSharedPointer<GreedyPlanningNode>());
-    ~GreedyPlanningNode();
+                       int parentIndex = -1,
+                       const LatticePose& latticePose = LatticePose());
 
     const Position& position() const;
     const UAVOrientation& orientation() const;
 
     int depth() const;
-    int maxDepth() const;
 
-    bool isVisited() const;
-    QVector<QSharedPointer<GreedyPlanningNode> > visit();
+    /**
+     * @brief parentIndex returns where our parent is in the planner's node arena, or -1 for the root.
+     * @return
+     */
+    int parentIndex() const;
+
+    /**
+     * @brief latticePose returns where we are on the planner's MotionPrimitiveTable lattice
+     * @return
+     */
+    const LatticePose& latticePose() const;
+
+    static int branchFactor();
 
-    const QSharedPointer<GreedyPlanningNode>& parent() const;
-    void setParent(const QSharedPointer<GreedyPlanningNode>& nParent);
+    /**
+     * @brief primitives returns the table successor() needs: 45 degrees left, straight ahead or 45 degrees
+     * right, then 45 meters on
+     * @param origin
+     * @param originPose
+     * @return
+     */
+    static MotionPrimitiveTable primitives(const Position& origin, const UAVOrientation& originPose);
+
+    /**
+     * @brief successor returns our child along the given branch, which must be in [0, branchFactor()).
+     * @param primitives made by primitives(), with the origin of the lattice we're on
+     * @param branch
+     * @param ourIndex where we are in the node arena. Becomes the child's parentIndex().
+     * @return
+     */
+    GreedyPlanningNode successor(const MotionPrimitiveTable& primitives, int branch, int ourIndex) const;
 
-    const QList<Position>& flightPath();
-    void setFlighPath(const QList<Position>& flightPath);
 private:
     Position _pos;
     UAVOrientation _orientation;
     int _depth;
-    int _maxDepth;
-
-    QSharedPointer<GreedyPlanningNode> _parent;
-    bool _visited;
-
-    QList<Position> _flightPath;
+    int _parentIndex;
+    LatticePose _latticePose;
 };
 
 #endif // GREEDYPLANNINGNODE_H
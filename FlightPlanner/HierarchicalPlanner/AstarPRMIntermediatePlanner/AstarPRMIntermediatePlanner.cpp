@@ -1,14 +1,13 @@
 #include "AstarPRMIntermediatePlanner.h"
 
-const qreal GRANULARITY = 300.0;
-
-#include <QMultiMap>
-#include <QSet>
 #include <cmath>
 
 #include "QVectorND.h"
+#include "HierarchicalPlanner/BestFirstSearch.h"
 #include "guts/Conversions.h"
 #include "HierarchicalPlanner/DubinsIntermediate/DubinsIntermediatePlanner.h"
+#include "HierarchicalPlanner/ProbabilisticRoadmap.h"
+#include "PlanningLog.h"
 
 AstarPRMIntermediatePlanner::AstarPRMIntermediatePlanner(const UAVParameters& uavParams,
                                                          const Position &startPos,
@@ -16,7 +15,8 @@ AstarPRMIntermediatePlanner::AstarPRMIntermediatePlanner(const UAVParameters& ua
                                                          const Position &endPos,
                                                          const UAVOrientation &endPose,
                                                          const QList<QPolygonF> &obstacles) :
-    IntermediatePlanner(uavParams, startPos, startPose, endPos, endPose, obstacles)
+    IntermediatePlanner(uavParams, startPos, startPose, endPos, endPose, obstacles), _roadmap(0),
+    _granularity(300.0)
 {
 }
 
@@ -24,123 +24,164 @@ bool AstarPRMIntermediatePlanner::plan()
 {
     _results.clear();
 
-    const qreal lonPerMeter = Conversions::degreesLonPerMeter(this->startPos().latitude());
-    const qreal latPerMeter = Conversions::degreesLatPerMeter(this->startPos().latitude());
+    //The roadmap only fails if start or end can't see it, or its graph is split. The lattice may still get through.
+    QList<Position> metaPlan;
+    if (_roadmap != 0 && _roadmap->findPath(this->startPos(), this->endPos(), &metaPlan))
+    {
+        _toRealPath(metaPlan);
+        return true;
+    }
+    else if (_planLattice(&metaPlan))
+    {
+        _toRealPath(metaPlan);
+        return true;
+    }
+    return false;
+}
+
+QList<Position> AstarPRMIntermediatePlanner::results() const
+{
+    return _results;
+}
+
+void AstarPRMIntermediatePlanner::takeResults(QList<Position> *destination)
+{
+    destination->clear();
+    destination->swap(_results);
+}
+
+const ProbabilisticRoadmap *AstarPRMIntermediatePlanner::roadmap() const
+{
+    return _roadmap;
+}
+
+void AstarPRMIntermediatePlanner::setRoadmap(const ProbabilisticRoadmap *roadmap)
+{
+    _roadmap = roadmap;
+}
+
+qreal AstarPRMIntermediatePlanner::granularity() const
+{
+    return _granularity;
+}
 
-    QMultiMap<qreal, Position> workList;
-    QHash<Position, Position> parents;
-    QSet<Position> closedSet;
-    QHash<Position, qreal> costSoFar;
+void AstarPRMIntermediatePlanner::setGranularity(qreal meters)
+{
+    _granularity = qMax<qreal>(1.0, meters);
+}
 
-    workList.insert(0, this->startPos());
-    costSoFar.insert(this->startPos(), 0);
+struct AstarPRMIntermediatePlanner::LatticeSpace
+{
+    typedef qint64 State;
 
-    while (!workList.empty())
+    LatticeSpace(const AstarPRMIntermediatePlanner * planner) :
+        planner(planner),
+        lonPerMeter(Conversions::degreesLonPerMeter(planner->startPos().latitude())),
+        latPerMeter(Conversions::degreesLatPerMeter(planner->startPos().latitude()))
     {
-        const qreal bestScore = workList.keys().first();
-        const Position current = workList.value(bestScore);
-        workList.remove(bestScore, current);
-        closedSet.insert(current);
+    }
 
-        qDebug() << "A* intermed:" << current << bestScore;
+    Position position(qint64 cell) const
+    {
+        return planner->_cellPosition(_cellI(cell), _cellJ(cell), lonPerMeter, latPerMeter);
+    }
 
-        //When we get close enough trace back
-        if (current.flatDistanceEstimate(this->endPos()) < GRANULARITY)
-        {
-            QList<Position> metaPlan;
-            metaPlan.append(this->endPos());
+    qreal heuristic(qint64 cell) const
+    {
+        return this->position(cell).flatDistanceEstimate(planner->endPos());
+    }
 
-            //Trace back
-            Position trace = current;
-            while (true)
-            {
-                metaPlan.prepend(trace);
-                if (!parents.contains(trace))
-                    break;
-                trace = parents.value(trace);
-            }
-            _toRealPath(metaPlan);
-            return true;
-        }
+    //When we get close enough we can fly straight to the end
+    bool isGoal(qint64 cell) const
+    {
+        return this->heuristic(cell) < planner->_granularity;
+    }
+
+    bool keepSearching()
+    {
+        return planner->chargeNodes();
+    }
+
+    template <typename Search>
+    void successors(qint64 cell, const Search& search, QVector<qint64> * cells, QVector<qreal> * stepCosts) const
+    {
+        planningTrace(intermediateLog) << "A* intermed:" << this->position(cell);
 
-        //Otherwise generate more neighbors!
+        const int ci = _cellI(cell);
+        const int cj = _cellJ(cell);
         for (int xd = -1; xd <= 1; xd++)
         {
             for (int xy = -1; xy <= 1; xy++)
             {
                 if (xd == 0 && xy == 0)
                     continue;
-                const Position neighbor(current.longitude() + xd * GRANULARITY * lonPerMeter,
-                                        current.latitude() + xy * GRANULARITY * latPerMeter);
+                const qint64 neighbor = _cellKey(ci + xd, cj + xy);
 
-                //Check closed set
-                if (closedSet.contains(neighbor))
+                //Closed cells are finished, so skip the obstacle check for them
+                if (search.isClosed(neighbor))
+                    continue;
+                if (planner->collidesWithObstacle(this->position(neighbor)))
                     continue;
 
-                //Check obstacles
-                bool obstacleViolation = false;
-                foreach(const QPolygonF& obstacle, this->obstacles())
-                {
-                    if (obstacle.containsPoint(neighbor.lonLat(), Qt::OddEvenFill))
-                    {
-                        obstacleViolation = true;
-                        break;
-                    }
-                }
-                if (obstacleViolation)
-                    break;
-
-                const qreal tentativeCost = costSoFar.value(current) + GRANULARITY;
-                if (!costSoFar.contains(neighbor) || tentativeCost < costSoFar.value(neighbor))
-                {
-                    parents.insert(neighbor, current);
-                    costSoFar.insert(neighbor, tentativeCost);
-                    workList.insert(tentativeCost + neighbor.flatDistanceEstimate(this->endPos()),
-                                    neighbor);
-                }
+                cells->append(neighbor);
+                stepCosts->append(planner->_granularity);
             }
         }
     }
 
-    return false;
-}
+    const AstarPRMIntermediatePlanner * planner;
+    qreal lonPerMeter;
+    qreal latPerMeter;
+};
 
-QList<Position> AstarPRMIntermediatePlanner::results() const
+//private
+bool AstarPRMIntermediatePlanner::_planLattice(QList<Position> *metaPlan)
 {
-    return _results;
+    metaPlan->clear();
+
+    LatticeSpace space(this);
+    BestFirstSearch<LatticeSpace> search(&space);
+    search.addStart(_cellKey(0, 0));
+    if (search.search() != BestFirstSearch<LatticeSpace>::GoalFound)
+        return false;
+
+    foreach(qint64 cell, search.path(search.goal()))
+        metaPlan->append(space.position(cell));
+    metaPlan->append(this->endPos());
+    return true;
 }
 
 //private
 void AstarPRMIntermediatePlanner::_toRealPath(const QList<Position>& metaPlan)
 {
-    QList<UAVOrientation> orientations;
-    orientations.append(this->startPose());
-    for (int i = 1; i < metaPlan.size() - 1; i++)
-    {
-        const Position& prev = metaPlan.at(i-1);
-        const Position& current = metaPlan.at(i);
-        const Position& next = metaPlan.at(i+1);
+    DubinsIntermediatePlanner::flyWaypoints(this->uavParams(), metaPlan,
+                                            this->startPose(), this->endPose(),
+                                            this->obstacles(), this->obstacleMap(),
+                                            &_results);
+}
 
-        const UAVOrientation prevAngle(prev.angleTo(current));
-        const UAVOrientation nextAngle(current.angleTo(next));
-        const UAVOrientation avg = UAVOrientation::average(prevAngle, nextAngle);
+//private static
+qint64 AstarPRMIntermediatePlanner::_cellKey(int i, int j)
+{
+    return ((qint64)i << 32) | (quint32)j;
+}
 
-        orientations.append(UAVOrientation(avg));
-    }
-    orientations.append(this->endPose());
+//private static
+int AstarPRMIntermediatePlanner::_cellI(qint64 key)
+{
+    return (int)(key >> 32);
+}
 
-    for (int i = 0; i < metaPlan.size() - 1; i++)
-    {
-        const Position& startPos = metaPlan.at(i);
-        const UAVOrientation& startPose = orientations.at(i);
-        const Position& endPos = metaPlan.at(i + 1);
-        const UAVOrientation& endPose = orientations.at(i + 1);
-        IntermediatePlanner * intermed = new DubinsIntermediatePlanner(this->uavParams(),
-                                                                       startPos, startPose,
-                                                                       endPos, endPose,
-                                                                       this->obstacles());
-        intermed->plan();
-        _results.append(intermed->results());
-        delete intermed;
-    }
+//private static
+int AstarPRMIntermediatePlanner::_cellJ(qint64 key)
+{
+    return (int)(qint32)(key & Q_INT64_C(0xffffffff));
+}
+
+//private
+Position AstarPRMIntermediatePlanner::_cellPosition(int i, int j, qreal lonPerMeter, qreal latPerMeter) const
+{
+    //Computed directly from the indices so the same cell always gets exactly the same position
+    return Position(this->startPos().longitude() + i * _granularity * lonPerMeter,
+                    this->startPos().latitude() + j * _granularity * latPerMeter);
 }
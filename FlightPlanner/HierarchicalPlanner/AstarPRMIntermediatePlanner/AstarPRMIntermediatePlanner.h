@@ -4,6 +4,13 @@
 #include "HierarchicalPlanner/IntermediatePlanner.h"
 #include "UAVParameters.h"
 
+class ProbabilisticRoadmap;
+
+/**
+ * @brief The AstarPRMIntermediatePlanner class finds a rough path around the obstacles and then flies it with
+ * Dubins curves. The rough path comes from a shared ProbabilisticRoadmap if one has been set, or else from an
+ * A* search over an 8-connected lattice planned just for this transition.
+ */
 class AstarPRMIntermediatePlanner : public IntermediatePlanner
 {
 public:
@@ -16,10 +23,38 @@ public:
 
     virtual bool plan();
     virtual QList<Position> results() const;
+    virtual void takeResults(QList<Position> * destination);
+
+    /**
+     * @brief roadmap returns the roadmap searched for the rough path, or 0 if there isn't one. The roadmap is
+     * not owned by us and must outlive the planner.
+     * @return
+     */
+    const ProbabilisticRoadmap * roadmap() const;
+    void setRoadmap(const ProbabilisticRoadmap * roadmap);
+
+    /**
+     * @brief granularity returns how many meters apart the lattice's cells are, and how close to the end the
+     * search has to get before it flies straight there. Defaults to 300.
+     * @return
+     */
+    qreal granularity() const;
+    void setGranularity(qreal meters);
 
 private:
+    //The lattice as a BestFirstSearch space. Its states are cells (i, j) relative to the start, see _cellKey()
+    struct LatticeSpace;
+
+    static qint64 _cellKey(int i, int j);
+    static int _cellI(qint64 key);
+    static int _cellJ(qint64 key);
+    Position _cellPosition(int i, int j, qreal lonPerMeter, qreal latPerMeter) const;
+
+    bool _planLattice(QList<Position> * metaPlan);
     void _toRealPath(const QList<Position> &metaPlan);
 
+    const ProbabilisticRoadmap * _roadmap;
+    qreal _granularity;
     QList<Position> _results;
 
 };
@@ -0,0 +1,470 @@
+#ifndef BESTFIRSTSEARCH_H
+#define BESTFIRSTSEARCH_H
+
+#include <QtGlobal>
+#include <QHash>
+#include <QList>
+#include <QVector>
+#include <limits>
+
+#include "PriorityQueue.h"
+
+/**
+ * @brief The HashStateIndex class finds a BestFirstSearch's nodes by state with a QHash. It's the default, and
+ * works for any state with a qHash() and an operator==.
+ */
+template <typename State>
+class HashStateIndex
+{
+public:
+    int find(const State& state) const
+    {
+        return _nodes.value(state, -1);
+    }
+
+    void insert(const State& state, int node)
+    {
+        _nodes.insert(state, node);
+    }
+
+    void clear()
+    {
+        _nodes.clear();
+    }
+
+private:
+    QHash<State, int> _nodes;
+};
+
+/**
+ * @brief The DenseStateIndex class finds a BestFirstSearch's nodes by state in an array, for states that are
+ * small non-negative integers like the nodes of a graph. resize() it to the number of states before searching.
+ */
+class DenseStateIndex
+{
+public:
+    void resize(int stateCount)
+    {
+        _nodes.fill(-1, stateCount);
+    }
+
+    int find(int state) const
+    {
+        return _nodes.at(state);
+    }
+
+    void insert(int state, int node)
+    {
+        _nodes[state] = node;
+    }
+
+    void clear()
+    {
+        _nodes.fill(-1);
+    }
+
+private:
+    QVector<int> _nodes;
+};
+
+/**
+ * @brief The NoStateIndex class is for searching trees, where every successor is a state that hasn't been seen
+ * before. It never finds anything, which saves hashing states that can't repeat.
+ */
+template <typename State>
+class NoStateIndex
+{
+public:
+    int find(const State&) const
+    {
+        return -1;
+    }
+
+    void insert(const State&, int)
+    {
+    }
+
+    void clear()
+    {
+    }
+};
+
+/**
+ * @brief The BestFirstSearch class is the best-first search loop our planners share. A*, weighted A*, greedy
+ * best-first, uniform-cost (Dijkstra), beam and anytime searches are all settings of it.
+ *
+ * Space is what gets searched. It has to provide:
+ *  - a State typedef. States are copied into the search's nodes, so keep them small (e.g. an index).
+ *  - qreal heuristic(const State& state): the estimated cost left from state to a goal. A* is only optimal if
+ *    this never overestimates. 0 everywhere gives a uniform-cost search.
+ *  - bool isGoal(const State& state)
+ *  - bool keepSearching(): false stops the search before its next expansion, e.g. once a budget is spent
+ *  - template <typename Search> void successors(const State& state, const Search& search,
+ *    QVector<State> * states, QVector<qreal> * stepCosts): appends the states state leads to and the cost of
+ *    getting to each. search can be asked isClosed() to skip expensive checks on states that are finished.
+ *
+ * Index finds the node a state already has (see HashStateIndex, DenseStateIndex and NoStateIndex). OpenList
+ * orders the open nodes and has PriorityQueue<int>'s interface.
+ *
+ * Nodes are pooled in one array and refer to their parents by position, so tracing a path back costs no
+ * lookups. There's no decrease-key: a node reached more cheaply is queued again and its stale entries are
+ * skipped when they come out. Closed nodes that are reached more cheaply are opened again, so heuristics that
+ * aren't consistent still give the best path they can.
+ */
+template <typename Space, typename Index = HashStateIndex<typename Space::State>, typename OpenList = PriorityQueue<int> >
+class BestFirstSearch
+{
+public:
+    typedef typename Space::State State;
+
+    struct Node
+    {
+        State state;
+        qreal cost;
+        qreal heuristic;
+        int parent;
+        bool closed;
+    };
+
+    enum Outcome
+    {
+        GoalFound,
+        Exhausted,
+        Stopped
+    };
+
+    explicit BestFirstSearch(Space * space) :
+        _space(space), _weight(1.0), _greedy(false), _beamWidth(0),
+        _costBound(std::numeric_limits<qreal>::max()), _bestCost(std::numeric_limits<qreal>::max()),
+        _goal(-1), _closest(-1), _expanded(0)
+    {
+    }
+
+    /**
+     * @brief weight returns how heavily the heuristic counts when ordering open nodes (by cost + weight *
+     * heuristic). 1 (the default) is A*. Bigger weights find a path sooner that may cost up to weight times the best.
+     * @return
+     */
+    qreal weight() const
+    {
+        return _weight;
+    }
+
+    void setWeight(qreal weight)
+    {
+        _weight = weight;
+    }
+
+    /**
+     * @brief greedy returns true if open nodes are ordered by their heuristic alone, ignoring their cost so far.
+     * Defaults to false.
+     * @return
+     */
+    bool greedy() const
+    {
+        return _greedy;
+    }
+
+    void setGreedy(bool greedy)
+    {
+        _greedy = greedy;
+    }
+
+    /**
+     * @brief beamWidth returns how many open nodes are kept after each expansion. The rest are dropped for good.
+     * 0 (the default) keeps them all.
+     * @return
+     */
+    int beamWidth() const
+    {
+        return _beamWidth;
+    }
+
+    void setBeamWidth(int width)
+    {
+        _beamWidth = qMax<int>(0, width);
+    }
+
+    /**
+     * @brief costBound returns the cost + heuristic that a node has to be below to be opened. Defaults to no bound.
+     * @return
+     */
+    qreal costBound() const
+    {
+        return _costBound;
+    }
+
+    void setCostBound(qreal bound)
+    {
+        _costBound = bound;
+    }
+
+    Space * space() const
+    {
+        return _space;
+    }
+
+    Index& index()
+    {
+        return _index;
+    }
+
+    OpenList& openList()
+    {
+        return _openList;
+    }
+
+    void reserve(int nodes)
+    {
+        _nodes.reserve(nodes);
+        _openList.reserve(nodes);
+    }
+
+    /**
+     * @brief clear forgets the starts, every node and the best path found. The settings are kept.
+     */
+    void clear()
+    {
+        _restart();
+        _starts.clear();
+        _startCosts.clear();
+        _bestCost = std::numeric_limits<qreal>::max();
+        _bestPath.clear();
+        _expanded = 0;
+    }
+
+    /**
+     * @brief addStart opens state at cost. Add several to search outwards from all of them at once.
+     * @param state
+     * @param cost
+     */
+    void addStart(const State& state, qreal cost = 0.0)
+    {
+        _starts.append(state);
+        _startCosts.append(cost);
+        _reach(state, -1, cost);
+    }
+
+    /**
+     * @brief search expands open nodes until a goal comes out of the open list (GoalFound, see goal()), there are
+     * none left (Exhausted) or the space says to stop (Stopped). Calling it again after a goal carries on.
+     * @return
+     */
+    Outcome search()
+    {
+        while (!_openList.isEmpty())
+        {
+            const int current = _openList.takeMin();
+
+            //Nodes get queued again when they're reached more cheaply. Skip the stale entries.
+            if (_nodes.at(current).closed)
+                continue;
+            _nodes[current].closed = true;
+
+            //Copy what we need - opening successors below may reallocate the nodes
+            const State state = _nodes.at(current).state;
+            const qreal cost = _nodes.at(current).cost;
+
+            if (_space->isGoal(state))
+            {
+                _goal = current;
+                if (cost < _bestCost)
+                {
+                    _bestCost = cost;
+                    _bestPath = this->path(current);
+                }
+                return GoalFound;
+            }
+
+            if (!_space->keepSearching())
+                return Stopped;
+
+            _successorStates.clear();
+            _stepCosts.clear();
+            _space->successors(state, *this, &_successorStates, &_stepCosts);
+            _expanded++;
+            for (int i = 0; i < _successorStates.size(); i++)
+                _reach(_successorStates.at(i), current, cost + _stepCosts.at(i));
+
+            if (_beamWidth > 0)
+                _openList.truncate(_beamWidth);
+        }
+        return Exhausted;
+    }
+
+    /**
+     * @brief improve is one pass of an anytime search. It searches again from the starts with weight, only
+     * opening nodes that could beat the best path found so far, and returns true if it found a better one (see
+     * bestPath()). Passes with weights falling to 1 find some path quickly and then better ones. A pass with
+     * weight 1 that returns false without having been stopped proves the best path is the cheapest there is.
+     * @param weight
+     * @return
+     */
+    bool improve(qreal weight)
+    {
+        const qreal previousBest = _bestCost;
+        _restart();
+        _weight = weight;
+        _costBound = previousBest;
+        for (int i = 0; i < _starts.size(); i++)
+            _reach(_starts.at(i), -1, _startCosts.at(i));
+        return this->search() == GoalFound && _bestCost < previousBest;
+    }
+
+    int nodeCount() const
+    {
+        return _nodes.size();
+    }
+
+    const Node& node(int index) const
+    {
+        return _nodes.at(index);
+    }
+
+    /**
+     * @brief find returns the node of state, or -1 if it hasn't been reached
+     * @param state
+     * @return
+     */
+    int find(const State& state) const
+    {
+        return _index.find(state);
+    }
+
+    bool isClosed(const State& state) const
+    {
+        const int index = _index.find(state);
+        return index >= 0 && _nodes.at(index).closed;
+    }
+
+    /**
+     * @brief goal returns the node of the goal the last search() found, or -1 if it found none
+     * @return
+     */
+    int goal() const
+    {
+        return _goal;
+    }
+
+    /**
+     * @brief closestNode returns the node with the lowest heuristic reached so far (the first of them on ties), or
+     * -1 if there are none. Searches that run out of time or states can settle for its path.
+     * @return
+     */
+    int closestNode() const
+    {
+        return _closest;
+    }
+
+    /**
+     * @brief path returns the states from a start to the state of node index
+     * @param index
+     * @return
+     */
+    QList<State> path(int index) const
+    {
+        QList<State> toRet;
+        while (index >= 0)
+        {
+            toRet.prepend(_nodes.at(index).state);
+            index = _nodes.at(index).parent;
+        }
+        return toRet;
+    }
+
+    /**
+     * @brief bestCost returns the cost of the cheapest goal found since clear(), or the largest qreal if none has been
+     * @return
+     */
+    qreal bestCost() const
+    {
+        return _bestCost;
+    }
+
+    const QList<State>& bestPath() const
+    {
+        return _bestPath;
+    }
+
+    /**
+     * @brief expandedCount returns how many nodes have been expanded since clear()
+     * @return
+     */
+    int expandedCount() const
+    {
+        return _expanded;
+    }
+
+private:
+    void _restart()
+    {
+        _nodes.clear();
+        _index.clear();
+        _openList.clear();
+        _goal = -1;
+        _closest = -1;
+    }
+
+    //Opens state at cost from parent, unless it's been reached at least as cheaply already or can't beat the bound
+    void _reach(const State& state, int parent, qreal cost)
+    {
+        int index = _index.find(state);
+        qreal heuristic;
+        if (index >= 0)
+        {
+            if (_nodes.at(index).cost <= cost)
+                return;
+            heuristic = _nodes.at(index).heuristic;
+        }
+        else
+            heuristic = _space->heuristic(state);
+
+        if (cost + heuristic >= _costBound)
+            return;
+
+        if (index < 0)
+        {
+            Node node;
+            node.state = state;
+            node.heuristic = heuristic;
+            index = _nodes.size();
+            _nodes.append(node);
+            _index.insert(state, index);
+            if (_closest < 0 || heuristic < _nodes.at(_closest).heuristic)
+                _closest = index;
+        }
+
+        Node& node = _nodes[index];
+        node.cost = cost;
+        node.parent = parent;
+        node.closed = false;
+        _openList.insert(_greedy ? heuristic : cost + _weight * heuristic, index);
+    }
+
+    Space * _space;
+
+    qreal _weight;
+    bool _greedy;
+    int _beamWidth;
+    qreal _costBound;
+
+    QVector<Node> _nodes;
+    Index _index;
+    OpenList _openList;
+
+    QVector<State> _starts;
+    QVector<qreal> _startCosts;
+
+    qreal _bestCost;
+    QList<State> _bestPath;
+
+    int _goal;
+    int _closest;
+    int _expanded;
+
+    //Reused by every expansion
+    QVector<State> _successorStates;
+    QVector<qreal> _stepCosts;
+};
+
+#endif // BESTFIRSTSEARCH_H
@@ -0,0 +1,108 @@
+#include "ConvexHull.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+//non-member
+static bool lexicographicLess(const QPointF& a, const QPointF& b)
+{
+    return a.x() < b.x() || (a.x() == b.x() && a.y() < b.y());
+}
+
+//static
+QVector<QPointF> ConvexHull::build(QVector<QPointF> points)
+{
+    std::sort(points.begin(), points.end(), lexicographicLess);
+    points.erase(std::unique(points.begin(), points.end()), points.end());
+    if (points.size() < 3)
+        return points;
+
+    QVector<QPointF> toRet(2 * points.size());
+    int count = 0;
+    for (int i = 0; i < points.size(); i++)
+    {
+        while (count >= 2 && cross(toRet.at(count - 2), toRet.at(count - 1), points.at(i)) <= 0.0)
+            count--;
+        toRet[count++] = points.at(i);
+    }
+    for (int i = points.size() - 2, lower = count + 1; i >= 0; i--)
+    {
+        while (count >= lower && cross(toRet.at(count - 2), toRet.at(count - 1), points.at(i)) <= 0.0)
+            count--;
+        toRet[count++] = points.at(i);
+    }
+
+    //The last point is the first one again
+    toRet.resize(count - 1);
+    return toRet;
+}
+
+//static
+qreal ConvexHull::cross(const QPointF &a, const QPointF &b, const QPointF &c)
+{
+    return (b.x() - a.x()) * (c.y() - a.y()) - (b.y() - a.y()) * (c.x() - a.x());
+}
+
+//static
+void ConvexHull::diameter(const QVector<QPointF> &hull, int *first, int *second)
+{
+    *first = 0;
+    *second = 0;
+
+    qreal bestDistance = -1.0;
+    const int n = hull.size();
+    for (int i = 0, j = 1 % qMax<int>(1, n); i < n; i++)
+    {
+        //Advance the opposite caliper while it gets farther from edge i
+        const QPointF& a = hull.at(i);
+        const QPointF& b = hull.at((i + 1) % n);
+        while (n > 2 && qAbs(cross(a, b, hull.at((j + 1) % n))) > qAbs(cross(a, b, hull.at(j))))
+            j = (j + 1) % n;
+
+        const int candidates[2] = {i, (i + 1) % n};
+        for (int k = 0; k < 2; k++)
+        {
+            const QPointF diff = hull.at(candidates[k]) - hull.at(j);
+            const qreal distance = diff.x() * diff.x() + diff.y() * diff.y();
+            if (distance > bestDistance)
+            {
+                bestDistance = distance;
+                *first = candidates[k];
+                *second = j;
+            }
+        }
+    }
+}
+
+//static
+int ConvexHull::narrowestEdge(const QVector<QPointF> &hull, qreal *width)
+{
+    const int n = hull.size();
+    if (n < 3)
+        return -1;
+
+    int toRet = -1;
+    qreal bestWidth = std::numeric_limits<qreal>::max();
+    for (int i = 0, j = 1; i < n; i++)
+    {
+        //The vertex farthest from edge i only ever moves forward as the edge does
+        const QPointF& a = hull.at(i);
+        const QPointF& b = hull.at((i + 1) % n);
+        while (qAbs(cross(a, b, hull.at((j + 1) % n))) > qAbs(cross(a, b, hull.at(j))))
+            j = (j + 1) % n;
+
+        const QPointF edge = b - a;
+        const qreal length = sqrt(edge.x() * edge.x() + edge.y() * edge.y());
+        const qreal edgeWidth = qAbs(cross(a, b, hull.at(j))) / length;
+        if (edgeWidth < bestWidth)
+        {
+            bestWidth = edgeWidth;
+            toRet = i;
+        }
+    }
+
+    if (width)
+        *width = bestWidth;
+    return toRet;
+}
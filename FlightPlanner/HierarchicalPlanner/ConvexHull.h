@@ -0,0 +1,47 @@
+#ifndef CONVEXHULL_H
+#define CONVEXHULL_H
+
+#include <QtGlobal>
+#include <QPointF>
+#include <QVector>
+
+/**
+ * @brief The ConvexHull class holds the planar hull computations the planners use to size up task areas.
+ * Points should be in a locally flat frame (e.g., meters east/north of the area), not raw lon/lat.
+ */
+class ConvexHull
+{
+public:
+    /**
+     * @brief build returns the convex hull of points in counter-clockwise order, without collinear points
+     * (Andrew's monotone chain). Fewer than three distinct points are returned as they are.
+     * @param points
+     * @return
+     */
+    static QVector<QPointF> build(QVector<QPointF> points);
+
+    /**
+     * @brief cross returns the z component of (b - a) x (c - a), which is positive when a, b, c turn
+     * counter-clockwise.
+     */
+    static qreal cross(const QPointF& a, const QPointF& b, const QPointF& c);
+
+    /**
+     * @brief diameter finds the two hull vertices that are farthest apart, by rotating calipers.
+     * @param hull as returned by build()
+     * @param first set to the index of one of them
+     * @param second set to the index of the other
+     */
+    static void diameter(const QVector<QPointF>& hull, int * first, int * second);
+
+    /**
+     * @brief narrowestEdge finds the hull edge whose parallel supporting lines are closest together, which
+     * is the direction the hull is thinnest across, by rotating calipers.
+     * @param hull as returned by build()
+     * @param width set to the distance between the supporting lines, if not null
+     * @return the index i of the edge from hull[i] to hull[i+1], or -1 if the hull has fewer than three points
+     */
+    static int narrowestEdge(const QVector<QPointF>& hull, qreal * width = 0);
+};
+
+#endif // CONVEXHULL_H
@@ -0,0 +1,31 @@
+#include "DubinsDistanceMetric.h"
+
+#include "DubinsTable.h"
+#include "guts/Conversions.h"
+
+DubinsDistanceMetric::DubinsDistanceMetric(qreal latitude, qreal minTurnRadius, bool lowerBound) :
+    _lonPerMeter(Conversions::degreesLonPerMeter(latitude)),
+    _latPerMeter(Conversions::degreesLatPerMeter(latitude)),
+    _minTurnRadius(minTurnRadius),
+    _lowerBound(lowerBound),
+    _table(DubinsTable::shared())
+{
+}
+
+//virtual from QKDTreeDistanceMetric
+qreal DubinsDistanceMetric::distance(const QVectorND &a, const QVectorND &b)
+{
+    return this->distance(a.values().constData(), b.values().constData(), a.dimension());
+}
+
+//virtual from QKDTreeDistanceMetric
+qreal DubinsDistanceMetric::distance(const qreal *a, const qreal *b, int)
+{
+    //Meters relative to a
+    const QPointF start(0.0, 0.0);
+    const QPointF end((b[0] - a[0]) / _lonPerMeter, (b[1] - a[1]) / _latPerMeter);
+
+    if (_lowerBound)
+        return _table.lowerBound(start, a[2], end, b[2], _minTurnRadius);
+    return _table.length(start, a[2], end, b[2], _minTurnRadius);
+}
@@ -0,0 +1,41 @@
+#ifndef DUBINSDISTANCEMETRIC_H
+#define DUBINSDISTANCEMETRIC_H
+
+#include "QKDTreeDistanceMetric.h"
+
+class DubinsTable;
+
+/**
+ * @brief The DubinsDistanceMetric class measures between (longitude, latitude, heading in radians) poses by the
+ * length in meters of the shortest Dubins path from the first to the second, looked up in DubinsTable::shared().
+ *
+ * The distance is not symmetric: it's how far a plane at a has to fly to get to b. Note that a KD-tree's
+ * pruning assumes that the distance to a splitting plane is no more than the distance to anything beyond it,
+ * which a Dubins length doesn't promise, so nearest-neighbor searches with this metric are approximate.
+ */
+class DubinsDistanceMetric : public QKDTreeDistanceMetric
+{
+public:
+    /**
+     * @param latitude where poses are converted to meters
+     * @param minTurnRadius in meters
+     * @param lowerBound use DubinsTable::lowerBound() instead of DubinsTable::length(), for admissible
+     * A* heuristics
+     */
+    DubinsDistanceMetric(qreal latitude, qreal minTurnRadius, bool lowerBound = false);
+
+    //virtual from QKDTreeDistanceMetric
+    virtual qreal distance(const QVectorND& a, const QVectorND& b);
+
+    //virtual from QKDTreeDistanceMetric
+    virtual qreal distance(const qreal * a, const qreal * b, int dimension);
+
+private:
+    const qreal _lonPerMeter;
+    const qreal _latPerMeter;
+    const qreal _minTurnRadius;
+    const bool _lowerBound;
+    const DubinsTable& _table;
+};
+
+#endif // DUBINSDISTANCEMETRIC_H
@@ -2,6 +2,7 @@
 
 #include "guts/Conversions.h"
 #include "Dubins.h"
+#include "DubinsSampler.h"
 #include <QtCore>
 
 DubinsIntermediatePlanner::DubinsIntermediatePlanner(const UAVParameters &uavParams,
@@ -29,29 +30,29 @@ bool DubinsIntermediatePlanner::plan()
     const qreal endAngle = this->endPose().radians();
     const qreal minTurnRadius = this->uavParams().minTurningRadius();
 
-    Dubins dubins(startPos, startAngle, endPos, endAngle, minTurnRadius);
-
     //Build the path
+    const Dubins dubins(startPos, startAngle, endPos, endAngle, minTurnRadius);
     if (!dubins.isValid())
         return false;
 
-    const qreal lengthMeters = dubins.length();
-    const int numSamples = qRound(lengthMeters / this->uavParams().waypointInterval());
+    DubinsSampler sampler(dubins, this->uavParams().waypointInterval());
+    const int numSamples = qMin<int>(qRound(dubins.length() / this->uavParams().waypointInterval()),
+                                     sampler.count());
 
-    //Convert back to lat/lon
-    for (int i = 0; i < numSamples; i++)
+    //Convert back to lat/lon as we go
+    _results.reserve(numSamples);
+    QPointF sample;
+    for (int i = 0; i < numSamples && sampler.next(&sample); i++)
     {
-        const qreal t = i * this->uavParams().waypointInterval();
-        QPointF samplePos;
-        qreal sampleAngle;
-        if (!dubins.sample(t, samplePos, sampleAngle))
-            return false;
-
-        Position pos(this->startPos().longitude() + samplePos.x() * lonPerMeter,
-                this->startPos().latitude() + samplePos.y() * latPerMeter);
+        Position pos(this->startPos().longitude() + sample.x() * lonPerMeter,
+                this->startPos().latitude() + sample.y() * latPerMeter);
         _results.append(pos);
     }
 
+    //We keep the path either way, but let callers know if it flies through a no-fly zone
+    if (this->pathCollidesWithObstacle(_results))
+        return false;
+
     return true;
 }
 
@@ -60,3 +61,62 @@ QList<Position> DubinsIntermediatePlanner::results() const
 {
     return _results;
 }
+
+//virtual from IntermediatePlanner
+void DubinsIntermediatePlanner::takeResults(QList<Position> *destination)
+{
+    destination->clear();
+    destination->swap(_results);
+}
+
+//static
+bool DubinsIntermediatePlanner::flyWaypoints(const UAVParameters &uavParams,
+                                             const QList<Position> &waypoints,
+                                             const UAVOrientation &startPose,
+                                             const UAVOrientation &endPose,
+                                             const QList<QPolygonF> &obstacles,
+                                             const ObstacleMap *obstacleMap,
+                                             QList<Position> *results)
+{
+    results->clear();
+
+    QList<UAVOrientation> orientations;
+    orientations.append(startPose);
+    for (int i = 1; i < waypoints.size() - 1; i++)
+    {
+        const Position& prev = waypoints.at(i-1);
+        const Position& current = waypoints.at(i);
+        const Position& next = waypoints.at(i+1);
+
+        const UAVOrientation prevAngle(prev.angleTo(current));
+        const UAVOrientation nextAngle(current.angleTo(next));
+        const UAVOrientation avg = UAVOrientation::average(prevAngle, nextAngle);
+
+        orientations.append(UAVOrientation(avg));
+    }
+    orientations.append(endPose);
+
+    bool clear = true;
+    for (int i = 0; i < waypoints.size() - 1; i++)
+    {
+        const Position& startPos = waypoints.at(i);
+        const UAVOrientation& segmentStartPose = orientations.at(i);
+        const Position& endPos = waypoints.at(i + 1);
+        const UAVOrientation& segmentEndPose = orientations.at(i + 1);
+        DubinsIntermediatePlanner intermed(uavParams,
+                                           startPos, segmentStartPose,
+                                           endPos, segmentEndPose,
+                                           obstacles);
+        intermed.setObstacleMap(obstacleMap);
+        if (!intermed.plan())
+            clear = false;
+
+        QList<Position> segment;
+        intermed.takeResults(&segment);
+        if (results->isEmpty())
+            results->swap(segment);
+        else
+            results->append(segment);
+    }
+    return clear;
+}
@@ -15,6 +15,25 @@ public:
 
     virtual bool plan();
     virtual QList<Position> results() const;
+    virtual void takeResults(QList<Position> * destination);
+
+    /**
+     * @brief flyWaypoints flies through a rough path with one Dubins segment between each pair of consecutive
+     * waypoints. The heading at each interior waypoint is the average of the directions to and from it.
+     * @param waypoints the rough path, from the start to the end position
+     * @param startPose heading at the first waypoint
+     * @param endPose heading at the last waypoint
+     * @param obstacleMap used for the segments' collision checks, if not null
+     * @param results the flight, replacing its contents
+     * @return false if any segment couldn't be planned or flies through an obstacle
+     */
+    static bool flyWaypoints(const UAVParameters& uavParams,
+                             const QList<Position>& waypoints,
+                             const UAVOrientation& startPose,
+                             const UAVOrientation& endPose,
+                             const QList<QPolygonF>& obstacles,
+                             const ObstacleMap * obstacleMap,
+                             QList<Position> * results);
 
 private:
     QList<Position> _results;
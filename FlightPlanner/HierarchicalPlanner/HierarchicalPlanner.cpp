@@ -5,434 +5,3112 @@
 #include "QVectorND.h"
 #include "SubFlightPlanner/SubFlightPlanner.h"
 #include "SubFlightPlanner/SubFlightNode.h"
-#include "AstarPRMIntermediatePlanner/AstarPRMIntermediatePlanner.h"
-#include "DubinsIntermediate/DubinsIntermediatePlanner.h"
+#include "SubFlightPlanner/SubFlightPlanningJob.h"
+#include "PriorityQueue.h"
+#include "ScheduleState.h"
+#include "ScheduleLattice.h"
+#include "FlightPath.h"
+#include "TransitionPlanningJob.h"
+#include "IntermediatePlanner.h"
+#include "PlanningStageTimer.h"
+#include "PlanningLog.h"
+#include "ConvexHull.h"
+#include "FlightTasks/CoverageTask.h"
 
 #include <QMap>
+#include <QPair>
+#include <QBuffer>
+#include <QThread>
+#include <QRectF>
+#include <algorithm>
 #include <cmath>
 #include <limits>
 
-const qreal TIMESLICE = 15.0; //seconds
+//The schedule search updates its statistics every this many expanded states
+const int SCHEDULE_PROGRESS_INTERVAL = 256;
+
+//Heuristic weights of the schedule search's passes. The last must be 1 for the result to be optimal.
+const qreal SCHEDULE_WEIGHTS[] = {3.0, 1.5, 1.0};
+
+//Multi-resolution scheduling starts with time slices this much coarser than the tuning's per level...
+const int SCHEDULE_REFINEMENT_FACTOR = 4;
+
+//...adding levels until the longest task takes no more than this many of the coarsest slices
+const int SCHEDULE_COARSE_STEPS = 8;
+
+//Once the schedule search is over its memory budget, it keeps this many open states
+const int SCHEDULE_BEAM_WIDTH = 64;
+
+//Schedule improvement flies at most this many of each round's candidates, best lower bound first...
+const int IMPROVEMENT_BATCH = 16;
+
+//...tries this many destroy-and-repair candidates when no move improves the schedule...
+const int IMPROVEMENT_REPAIRS = 8;
+
+//...and gives up after this many such rounds in a row find nothing
+const int IMPROVEMENT_MAX_STALLS = 3;
+
+//Improvements smaller than this many seconds aren't worth publishing
+const qreal IMPROVEMENT_EPSILON = 1e-3;
+
+//The kinds of entry an area can have: either end of its longest chord and either side of the chord's bisector
+const int AREA_ENTRY_KINDS = 4;
+
+//Each roadmap waypoint is joined to up to this many of its nearest neighbors
+const int ROADMAP_NEIGHBORS = 10;
+
+//The roadmap reaches this far (in meters) beyond the mission's areas, so transitions can skirt around the edges
+const qreal ROADMAP_MARGIN = 1000.0;
+
+//How far (in meters) the visibility graph's corners are pushed out from the no-fly zones
+const qreal VISIBILITY_CLEARANCE = 100.0;
+
+//Version of what saveResults() writes
+const quint16 RESULTS_VERSION = 5;
+
+//Pinned so that saved results and content hashes don't depend on the Qt version
+const int RESULTS_STREAM_VERSION = QDataStream::Qt_4_8;
+
+//A move the schedule search has queued without planning its transition flight (see lazyTransitions())
+struct LazyScheduleMove
+{
+    //The node moved from, and its cost when the move was queued
+    int parent;
+    qreal parentCost;
+
+    int task;
+};
+
+//non-member
+//Whether state is within width (in every task) of one of the straight lines between consecutive corners
+static bool inScheduleCorridor(const QVectorND& state, const QList<QVectorND>& corners, qreal width)
+{
+    for (int i = 1; i < corners.size(); i++)
+    {
+        const QVectorND& a = corners.at(i - 1);
+        const QVectorND& b = corners.at(i);
+        bool inside = true;
+        for (int j = 0; j < state.dimension() && inside; j++)
+        {
+            const qreal low = qMin<qreal>(a.val(j), b.val(j));
+            const qreal high = qMax<qreal>(a.val(j), b.val(j));
+            inside = state.val(j) >= low - width && state.val(j) <= high + width;
+        }
+        if (inside)
+            return true;
+    }
+    return false;
+}
+
+//non-member
+//Whether one of the states in front covers state and was reached no later than cost
+static bool isScheduleStateDominated(const ScheduleState& state, qreal cost, const QList<int>& front,
+                                     const ScheduleNodeTable& nodes)
+{
+    foreach(int index, front)
+    {
+        const ScheduleNodeTable::Node& other = nodes.at(index);
+        if (other.state != state && other.state.covers(state) && other.cost <= cost)
+            return true;
+    }
+    return false;
+}
+
+//non-member
+//Opens newState, reached from parent at cost, unless a state in its front dominates it. With pruning, the states
+//it dominates are marked and leave the front.
+static void openScheduleState(const ScheduleState& newState, int parent, qreal cost, qreal priority,
+                              bool pruneDominated, ScheduleNodeTable * nodes,
+                              QHash<quint64, QList<int> > * fronts, PriorityQueue<int> * worklist,
+                              qint64 * dominatedCount)
+{
+    const quint64 frontKey = newState.positionKey();
+    if (pruneDominated && isScheduleStateDominated(newState, cost, fronts->value(frontKey), *nodes))
+    {
+        (*dominatedCount)++;
+        return;
+    }
+
+    const int newIndex = nodes->insert(newState);
+    ScheduleNodeTable::Node& newNode = nodes->node(newIndex);
+
+    /*
+     * The transition bounds in the heuristic don't obey the triangle inequality, so it isn't consistent
+     * and a state can turn out to be cheaper to reach after it has been expanded. Reopen it if so.
+    */
+    newNode.closed = false;
+    newNode.parent = parent;
+    newNode.cost = cost;
+
+    if (pruneDominated)
+    {
+        //Whatever newState dominates never needs expanding
+        QList<int>& front = (*fronts)[frontKey];
+        for (int j = front.size() - 1; j >= 0; j--)
+        {
+            ScheduleNodeTable::Node& other = nodes->node(front.at(j));
+            if (front.at(j) != newIndex && newState.covers(other.state) && cost <= other.cost)
+            {
+                other.dominated = true;
+                (*dominatedCount)++;
+                front.removeAt(j);
+            }
+        }
+        if (!front.contains(newIndex))
+            front.append(newIndex);
+    }
+
+    worklist->insert(priority, newIndex);
+}
+
+//non-member
+//Union-find over tasks, for grouping them into schedule clusters
+static int clusterRoot(QVector<int> * parents, int task)
+{
+    while (parents->at(task) != task)
+    {
+        (*parents)[task] = parents->at(parents->at(task));
+        task = parents->at(task);
+    }
+    return task;
+}
+
+//non-member
+//The two points of localPoly that are farthest apart, by rotating calipers over its convex hull
+static void polygonDiameter(const QPolygonF& localPoly, QPointF * first, QPointF * second)
+{
+    const QVector<QPointF> hull = ConvexHull::build(localPoly);
+    if (hull.isEmpty())
+        return;
+
+    int bestI;
+    int bestJ;
+    ConvexHull::diameter(hull, &bestI, &bestJ);
+    *first = hull.at(bestI);
+    *second = hull.at(bestJ);
+}
 
 HierarchicalPlanner::HierarchicalPlanner(QSharedPointer<PlanningProblem> prob,
                                          QObject *parent) :
-    FlightPlanner(prob, parent)
+    FlightPlanner(prob, parent), _maskWords(0), _workerCount(0), _precomputeTransitions(false),
+    _subFlightBeamWidth(0), _obstacleMapResolution(50.0), _roadmapSamples(1000),
+    _visibilityGraphTransitions(true),
+    _scheduleTimeBudget(0), _multiResolutionScheduling(true),
+    _scheduleDominancePruning(true),
+    _parallelScheduleExpansion(true), _lazyTransitions(true), _scheduleImprovementTimeBudget(1000),
+    _scheduleMemoryBudget(Q_INT64_C(1) << 30), _scheduleClusterSize(0),
+    _areaEntryCount(AREA_ENTRY_KINDS), _minTerrainClearance(50.0),
+    _obstacleMapVersion(0), _obstacleMapBuiltResolution(0.0), _roadmapBuiltSamples(0), _roadmapBuiltSeed(0),
+    _commitHorizon(30.0), _replanLatencyBudget(2000), _replanning(false), _replanStartTime(0.0),
+    _stage(StartAndEndPositionsStage), _scheduled(false), _runCompleted(false)
+{
+    this->doReset();
+}
+
+HierarchicalPlanner::~HierarchicalPlanner()
+{
+    this->finishPlanningThread();
+}
+
+const TransitionFlightCache &HierarchicalPlanner::transitionCache() const
+{
+    return _transitionCache;
+}
+
+int HierarchicalPlanner::workerCount() const
+{
+    return _workerCount;
+}
+
+void HierarchicalPlanner::setWorkerCount(int count)
+{
+    _workerCount = qMax<int>(0, count);
+}
+
+bool HierarchicalPlanner::precomputeTransitions() const
+{
+    return _precomputeTransitions;
+}
+
+void HierarchicalPlanner::setPrecomputeTransitions(bool precompute)
+{
+    _precomputeTransitions = precompute;
+}
+
+int HierarchicalPlanner::subFlightBeamWidth() const
+{
+    return _subFlightBeamWidth;
+}
+
+void HierarchicalPlanner::setSubFlightBeamWidth(int width)
+{
+    _subFlightBeamWidth = qMax<int>(0, width);
+}
+
+qreal HierarchicalPlanner::obstacleMapResolution() const
+{
+    return _obstacleMapResolution;
+}
+
+void HierarchicalPlanner::setObstacleMapResolution(qreal resolution)
+{
+    _obstacleMapResolution = qMax<qreal>(0.0, resolution);
+}
+
+int HierarchicalPlanner::roadmapSamples() const
+{
+    return _roadmapSamples;
+}
+
+void HierarchicalPlanner::setRoadmapSamples(int samples)
+{
+    _roadmapSamples = qMax<int>(0, samples);
+}
+
+bool HierarchicalPlanner::visibilityGraphTransitions() const
+{
+    return _visibilityGraphTransitions;
+}
+
+void HierarchicalPlanner::setVisibilityGraphTransitions(bool enabled)
+{
+    _visibilityGraphTransitions = enabled;
+}
+
+const TransitionStrategy &HierarchicalPlanner::transitionStrategy() const
+{
+    return _transitionStrategy;
+}
+
+void HierarchicalPlanner::setTransitionStrategy(const TransitionStrategy &strategy)
+{
+    _transitionStrategy = strategy;
+}
+
+qint64 HierarchicalPlanner::scheduleTimeBudget() const
+{
+    return _scheduleTimeBudget;
+}
+
+void HierarchicalPlanner::setScheduleTimeBudget(qint64 msecs)
+{
+    _scheduleTimeBudget = qMax<qint64>(0, msecs);
+}
+
+bool HierarchicalPlanner::multiResolutionScheduling() const
+{
+    return _multiResolutionScheduling;
+}
+
+void HierarchicalPlanner::setMultiResolutionScheduling(bool enabled)
+{
+    _multiResolutionScheduling = enabled;
+}
+
+bool HierarchicalPlanner::scheduleDominancePruning() const
+{
+    return _scheduleDominancePruning;
+}
+
+void HierarchicalPlanner::setScheduleDominancePruning(bool enabled)
+{
+    _scheduleDominancePruning = enabled;
+}
+
+bool HierarchicalPlanner::parallelScheduleExpansion() const
+{
+    return _parallelScheduleExpansion;
+}
+
+void HierarchicalPlanner::setParallelScheduleExpansion(bool enabled)
+{
+    _parallelScheduleExpansion = enabled;
+}
+
+bool HierarchicalPlanner::lazyTransitions() const
+{
+    return _lazyTransitions;
+}
+
+void HierarchicalPlanner::setLazyTransitions(bool enabled)
+{
+    _lazyTransitions = enabled;
+}
+
+qint64 HierarchicalPlanner::scheduleImprovementTimeBudget() const
+{
+    return _scheduleImprovementTimeBudget;
+}
+
+void HierarchicalPlanner::setScheduleImprovementTimeBudget(qint64 msecs)
+{
+    _scheduleImprovementTimeBudget = qMax<qint64>(0, msecs);
+}
+
+qint64 HierarchicalPlanner::scheduleMemoryBudget() const
+{
+    return _scheduleMemoryBudget;
+}
+
+void HierarchicalPlanner::setScheduleMemoryBudget(qint64 bytes)
+{
+    _scheduleMemoryBudget = qMax<qint64>(0, bytes);
+}
+
+int HierarchicalPlanner::scheduleClusterSize() const
+{
+    return _scheduleClusterSize;
+}
+
+void HierarchicalPlanner::setScheduleClusterSize(int tasks)
+{
+    _scheduleClusterSize = qMax<int>(0, tasks);
+}
+
+int HierarchicalPlanner::areaEntryCount() const
+{
+    return _areaEntryCount;
+}
+
+void HierarchicalPlanner::setAreaEntryCount(int entries)
+{
+    _areaEntryCount = qBound<int>(1, entries, AREA_ENTRY_KINDS);
+}
+
+QSharedPointer<const TerrainModel> HierarchicalPlanner::terrainModel() const
+{
+    return _terrainModel;
+}
+
+void HierarchicalPlanner::setTerrainModel(QSharedPointer<const TerrainModel> terrain)
+{
+    _terrainModel = terrain;
+}
+
+qreal HierarchicalPlanner::minTerrainClearance() const
+{
+    return _minTerrainClearance;
+}
+
+void HierarchicalPlanner::setMinTerrainClearance(qreal meters)
+{
+    _minTerrainClearance = qMax<qreal>(0.0, meters);
+}
+
+QByteArray HierarchicalPlanner::saveResults() const
+{
+    QByteArray toRet;
+    QDataStream stream(&toRet, QIODevice::WriteOnly);
+    stream.setVersion(RESULTS_STREAM_VERSION);
+
+    stream << RESULTS_VERSION << _uavParametersHash();
+    _resultCache.serialize(stream);
+    _transitionCache.serialize(stream);
+    return toRet;
+}
+
+bool HierarchicalPlanner::restoreResults(const QByteArray &results)
+{
+    QDataStream stream(results);
+    stream.setVersion(RESULTS_STREAM_VERSION);
+
+    quint16 version;
+    quint64 uavHash;
+    stream >> version >> uavHash;
+    if (stream.status() != QDataStream::Ok || version != RESULTS_VERSION)
+        return false;
+
+    //Start poses and sub-flights are keyed on everything they depend on, so they can always be restored
+    if (!_resultCache.deserialize(stream))
+        return false;
+
+    //Transition flights aren't keyed on the UAV, so they're only good for the parameters they were planned with
+    if (uavHash != _uavParametersHash())
+        return true;
+    return _transitionCache.deserialize(stream);
+}
+
+bool HierarchicalPlanner::lastRunCompleted() const
+{
+    return _runCompleted;
+}
+
+void HierarchicalPlanner::shareObstacleStructures(const HierarchicalPlanner &other)
+{
+    //They're immutable once built, so any number of planners can search them at once
+    _obstacleMap = other._obstacleMap;
+    _obstacleMapVersion = other._obstacleMapVersion;
+    _obstacleMapBuiltResolution = other._obstacleMapBuiltResolution;
+    _roadmap = other._roadmap;
+    _roadmapBuiltBounds = other._roadmapBuiltBounds;
+    _roadmapBuiltSamples = other._roadmapBuiltSamples;
+    _roadmapBuiltSeed = other._roadmapBuiltSeed;
+    _visibilityGraph = other._visibilityGraph;
+}
+
+qreal HierarchicalPlanner::commitHorizon() const
+{
+    return _commitHorizon;
+}
+
+void HierarchicalPlanner::setCommitHorizon(qreal seconds)
+{
+    _commitHorizon = qMax<qreal>(0.0, seconds);
+}
+
+qint64 HierarchicalPlanner::replanLatencyBudget() const
+{
+    return _replanLatencyBudget;
+}
+
+void HierarchicalPlanner::setReplanLatencyBudget(qint64 msecs)
+{
+    _replanLatencyBudget = qMax<qint64>(0, msecs);
+}
+
+bool HierarchicalPlanner::replanFrom(const QList<Position> &flight, int aircraftWaypoint, QString *errorString)
+{
+    if (this->problem().isNull() || aircraftWaypoint < 0 || aircraftWaypoint >= flight.size())
+    {
+        if (errorString)
+            *errorString = "The aircraft isn't on the flight to replan";
+        return false;
+    }
+
+    //At least two waypoints, so the committed flight ends with a heading
+    const UAVParameters& params = this->problem()->uavParameters();
+    const int commitWaypoints = ceil(_commitHorizon * params.airspeed() / params.waypointInterval());
+    const int committedCount = qBound<int>(qMin<int>(2, flight.size()),
+                                           aircraftWaypoint + 1 + commitWaypoints,
+                                           flight.size());
+    _replanCommitted = flight.mid(0, committedCount);
+    _replanFallback = flight;
+    _replanStartTime = committedCount * params.waypointInterval() / params.airspeed();
+    if (!_interpolatePath(_replanCommitted,
+                          this->problem()->startingOrientation(),
+                          (committedCount - 1) * params.waypointInterval() / params.airspeed(),
+                          &_replanStartPosition,
+                          &_replanStartOrientation))
+    {
+        _replanStartPosition = _replanCommitted.last();
+        _replanStartOrientation = this->problem()->startingOrientation();
+    }
+    _replanStartPosition.setAltitude(_replanCommitted.last().altitude());
+
+    /*
+     * If the committed flight is (the start of) the last one we published, we know how far it takes each task:
+     * as far as the last schedule state it gets all the way through. Otherwise every task starts over.
+    */
+    _replanProgress.clear();
+    if (_publishedFlight.mid(0, committedCount) == _replanCommitted)
+    {
+        int reached = -1;
+        for (int k = 0; k < _publishedEnds.size() && _publishedEnds.at(k) <= committedCount; k++)
+            reached = k;
+        for (int j = 0; reached >= 0 && j < _publishedTasks.size(); j++)
+            _replanProgress.append(qMakePair(_publishedTasks.at(j), _publishedStates.at(reached).val(j)));
+    }
+    else
+        planningDebug(plannerLog) << "Replanning a flight we didn't publish, so every task starts over";
+    _replanning = true;
+
+    //Start transitions and the published flight go from the committed flight's end from now on
+    this->resetPlanning();
+    this->setCommittedPrefix(_replanCommitted);
+
+    //The latency budget only applies to this run
+    const qint64 timeBudget = this->timeBudget();
+    if (_replanLatencyBudget > 0 && (timeBudget == 0 || _replanLatencyBudget < timeBudget))
+        this->setTimeBudget(_replanLatencyBudget);
+    this->startPlanning();
+    this->setTimeBudget(timeBudget);
+
+    if (this->status() != FlightPlanner::Running)
+    {
+        if (errorString)
+            *errorString = "The planner refused to start";
+        return false;
+    }
+    return true;
+}
+
+void HierarchicalPlanner::clearReplan()
+{
+    _replanning = false;
+    _replanCommitted.clear();
+    _replanProgress.clear();
+    _replanFallback.clear();
+    _replanStartTime = 0.0;
+    this->setCommittedPrefix(QList<Position>());
+    this->resetPlanning();
+}
+
+//protected
+//pure-virtual from FlightPlanner
+void HierarchicalPlanner::doStart()
+{
+    //Every run starts over from the first stage. What earlier runs planned is cached, so that's cheap.
+    _stage = StartAndEndPositionsStage;
+    _runCompleted = false;
+
+    //The tuning may have changed since the last reset, and transitions flown with another one don't count
+    _transitionCache.setObstacleVersion(_obstaclesVersion(_obstacles) ^ _terrainVersion() ^ _transitionTuningVersion());
+}
+
+//protected
+//pure-virtual from FlightPlanner
+void HierarchicalPlanner::doIteration()
+{
+    /*
+     * Each call runs one stage of the run and returns, so that in TimerExecution mode the event loop gets
+     * control back between stages and progress and statistics go out as the run goes. An interrupted stage's
+     * results are incomplete, so we stay put and the next run starts over.
+    */
+    PlanningStatistics * statistics = this->workingStatistics();
+    switch (_stage)
+    {
+    case StartAndEndPositionsStage:
+    {
+        //Statistics describe the last run only
+        statistics->clear();
+
+        //A replan's first run answers with the flight the aircraft already has right away, and improves on it
+        if (_replanning && !_replanFallback.isEmpty())
+        {
+            const QList<Position> remainder = _replanFallback.mid(_replanCommitted.size());
+            if (!_obstacleMap.isNull() && _obstacleMap->pathCollides(remainder))
+                this->setBestFlightSoFar(_replanCommitted);
+            else
+                this->setBestFlightSoFar(_replanFallback);
+            _replanFallback.clear();
+        }
+
+        /*
+         * Decide on arbitrary start and end points for each task (except no-fly).
+         * They should be on edges of the polygon.
+        */
+        PlanningStageTimer timer(statistics, "StartAndEndPositions");
+        _buildStartAndEndPositions();
+        _stage = StartTransitionsStage;
+        break;
+    }
+
+    case StartTransitionsStage:
+    {
+        /*
+         * Calculate sub-flights from the global start point to each of the tasks' start points.
+        */
+        PlanningStageTimer timer(statistics, "StartTransitions");
+        _buildStartTransitions();
+        if (!this->planningInterrupted())
+            _stage = SubFlightsStage;
+        break;
+    }
+
+    case SubFlightsStage:
+    {
+        /*
+         * Calculate ideal sub-flights for each task (except no-fly).
+         * These sub-flights start and end at the arbitrary start/end points of the tasks.
+        */
+        {
+            PlanningStageTimer timer(statistics, "SubFlights");
+            _buildSubFlights();
+        }
+        if (this->planningInterrupted())
+            break;
+
+        //Forget results for areas and tasks that have changed or gone
+        _resultCache.retainOnly(_usedResultKeys);
+        _stage = _precomputeTransitions ? TransitionMatrixStage : ScheduleStage;
+        break;
+    }
+
+    case TransitionMatrixStage:
+    {
+        /*
+         * Optionally calculate sub-flights from each task's end point to every other tasks' start point.
+         * These go into the transition cache where the scheduler will find them.
+        */
+        PlanningStageTimer timer(statistics, "TransitionMatrix");
+        _buildTransitionMatrix();
+        if (!this->planningInterrupted())
+            _stage = ScheduleStage;
+        break;
+    }
+
+    case ScheduleStage:
+    {
+        /*
+         * Build and solve scheduling problem.
+        */
+        {
+            PlanningStageTimer timer(statistics, "Schedule");
+            _scheduled = _buildSchedule(&_schedule);
+        }
+        if (!_scheduled && !this->planningInterrupted())
+            qWarning() << "Scheduling failed";
+        if (_scheduled && !this->planningInterrupted())
+            _stage = AreaEntriesStage;
+        else
+            _stage = TerrainValidationStage;
+        break;
+    }
+
+    case AreaEntriesStage:
+    {
+        /*
+         * Enter each area wherever is quickest from where the schedule arrives, and schedule again if that
+         * moves any.
+        */
+        if (_areaEntryCount > 1)
+        {
+            PlanningStageTimer timer(statistics, "AreaEntries");
+            _chooseAreaEntries(&_schedule);
+        }
+        _stage = this->planningInterrupted() ? TerrainValidationStage : ScheduleImprovementStage;
+        break;
+    }
+
+    case ScheduleImprovementStage:
+    {
+        /*
+         * Reorder the finished schedule's task segments and move its switch points while that shortens it.
+        */
+        if (_scheduleImprovementTimeBudget > 0)
+        {
+            PlanningStageTimer timer(statistics, "ScheduleImprovement");
+            _improveSchedule(&_schedule);
+        }
+        _stage = TerrainValidationStage;
+        break;
+    }
+
+    case TerrainValidationStage:
+        _finishRun();
+        break;
+    }
+
+    //Once a schedule's been flown an interrupted run still checks it, rather than waiting for a next step
+    if (_stage == TerrainValidationStage && this->planningInterrupted())
+        _finishRun();
+}
+
+//protected
+//pure-virtual from FlightPlanner
+void HierarchicalPlanner::doReset()
+{
+    _stage = StartAndEndPositionsStage;
+    _schedule = ScheduleSolution();
+    _scheduled = false;
+    _runCompleted = false;
+    const QSharedPointer<const CompiledProblem> previousCompiled = _compiled;
+    _compiled.clear();
+    _tasks.clear();
+    _taskIds.clear();
+    _taskAreas.clear();
+    _taskDependencies.clear();
+    _taskSubFlights.clear();
+    _taskEntrySubFlights.clear();
+    _areaStartPositions.clear();
+    _areaStartOrientations.clear();
+    _areaShapeKeys.clear();
+    _areaEntryPositions.clear();
+    _areaEntryOrientations.clear();
+    _areaEntryKinds.clear();
+    _areaEntries.clear();
+    _startTransitionSubFlights.clear();
+    _startTransitionsPlanned.clear();
+    _obstacles.clear();
+    _transitionCache.resetCounters();
+    _usedResultKeys.clear();
+
+    if (this->problem().isNull())
+    {
+        _obstacleMap.clear();
+        _roadmap.clear();
+        _visibilityGraph.clear();
+        return;
+    }
+
+    _compiled = this->problem()->compile();
+    if (!previousCompiled.isNull())
+    {
+        const CompiledProblem::Changes changes = _compiled->changesSince(*previousCompiled);
+        planningDebug(plannerLog) << "Replanning after" << changes.addedAreas.size() << "added,"
+                                  << changes.changedAreas.size() << "changed and"
+                                  << changes.removedAreas.size() << "removed areas";
+    }
+
+    //We treat obstacles separately in the hierarchical planner. Not as tasks.
+    _obstacles = _compiled->obstacles();
+    QVector<int> scheduleIndices(_compiled->taskCount(), -1);
+    for (int id = 0; id < _compiled->taskCount(); id++)
+    {
+        const CompiledProblem::Task& task = _compiled->task(id);
+        if (task.kind == CompiledProblem::NoFlyTaskKind)
+            continue;
+        scheduleIndices[id] = _tasks.size();
+        _tasks.append(_compiled->sharedTask(id));
+        _taskIds.append(id);
+        _taskAreas.append(task.area);
+    }
+
+    //Dependencies in terms of schedule indices. Ones on no-fly zones can't hold anything up.
+    foreach(int id, _taskIds)
+    {
+        QVector<int> dependencies;
+        foreach(int dependencyId, _compiled->task(id).dependencies)
+        {
+            if (scheduleIndices.at(dependencyId) >= 0)
+                dependencies.append(scheduleIndices.at(dependencyId));
+        }
+        _taskDependencies.append(dependencies);
+    }
+
+    _taskSubFlights.resize(_tasks.size());
+    _taskEntrySubFlights.resize(_tasks.size());
+    _areaStartPositions.resize(_compiled->areaCount());
+    _areaStartOrientations.resize(_compiled->areaCount());
+    _areaShapeKeys.resize(_compiled->areaCount());
+    _areaEntryPositions.resize(_compiled->areaCount());
+    _areaEntryOrientations.resize(_compiled->areaCount());
+    _areaEntryKinds.resize(_compiled->areaCount());
+    _areaEntries.fill(-1, _compiled->areaCount());
+    _startTransitionSubFlights.resize(_compiled->areaCount());
+    _startTransitionsPlanned.resize(_compiled->areaCount());
+
+    /*
+     * Rasterize the obstacles once so every transition planner this run can share the map. Edits that don't
+     * touch a no-fly zone keep the map from the last run.
+    */
+    const quint64 obstaclesVersion = _obstaclesVersion(_obstacles);
+    const QSharedPointer<const ObstacleMap> previousObstacleMap = _obstacleMap;
+    if (_obstacles.isEmpty())
+        _obstacleMap.clear();
+    else if (_obstacleMap.isNull()
+             || obstaclesVersion != _obstacleMapVersion
+             || _obstacleMapResolution != _obstacleMapBuiltResolution)
+    {
+        _obstacleMap = QSharedPointer<const ObstacleMap>(new ObstacleMap(_obstacles, _obstacleMapResolution));
+        _obstacleMapVersion = obstaclesVersion;
+        _obstacleMapBuiltResolution = _obstacleMapResolution;
+    }
+    const bool obstacleMapKept = !_obstacleMap.isNull() && _obstacleMap == previousObstacleMap;
+
+    //Likewise one roadmap around the obstacles serves every transition this run. It's seeded, so the same
+    //inputs would only sample the same roadmap again.
+    const QRectF roadmapBounds = _obstacleMap.isNull() ? QRectF() : _roadmapBounds();
+    if (_obstacleMap.isNull() || _roadmapSamples == 0)
+        _roadmap.clear();
+    else if (!obstacleMapKept
+             || _roadmap.isNull()
+             || roadmapBounds != _roadmapBuiltBounds
+             || _roadmapSamples != _roadmapBuiltSamples
+             || this->randomSeed() != _roadmapBuiltSeed)
+    {
+        _roadmap = QSharedPointer<const ProbabilisticRoadmap>(new ProbabilisticRoadmap(_obstacleMap,
+                                                                                       roadmapBounds,
+                                                                                       _roadmapSamples,
+                                                                                       ROADMAP_NEIGHBORS,
+                                                                                       this->randomSeed()));
+        _roadmapBuiltBounds = roadmapBounds;
+        _roadmapBuiltSamples = _roadmapSamples;
+        _roadmapBuiltSeed = this->randomSeed();
+    }
+
+    if (_obstacleMap.isNull() || !_visibilityGraphTransitions)
+        _visibilityGraph.clear();
+    else if (!obstacleMapKept || _visibilityGraph.isNull())
+        _visibilityGraph = QSharedPointer<const VisibilityGraph>(new VisibilityGraph(_obstacleMap,
+                                                                                     VISIBILITY_CLEARANCE));
+
+    //Cached transition flights survive a reset unless the obstacles (or terrain) they avoid, or the tuning of the
+    //planners that flew them, have changed
+    _transitionCache.setObstacleVersion(obstaclesVersion ^ _terrainVersion() ^ _transitionTuningVersion());
+}
+
+//private
+void HierarchicalPlanner::_finishRun()
+{
+    /*
+     * Check every waypoint of the published flight, sub-flights and all, against the terrain.
+    */
+    if (_terrainModel && !_publishedFlight.isEmpty())
+    {
+        PlanningStageTimer timer(this->workingStatistics(), "TerrainValidation");
+        _validateTerrainClearance(_publishedFlight);
+    }
+
+    _updateTransitionCacheCounters();
+    planningDebug(plannerLog) << "Transition cache:" << _transitionCache.hits() << "hits" << _transitionCache.misses() << "misses";
+    _schedule = ScheduleSolution();
+    _stage = StartAndEndPositionsStage;
+    _runCompleted = !this->planningInterrupted();
+    this->pausePlanning();
+}
+
+//private
+void HierarchicalPlanner::_buildStartAndEndPositions()
+{
+    //Everything here is in meters in the mission's local frame
+    const LocalFrame& frame = _compiled->frame();
+
+    //First calculate the average of all of the task area's midpoints
+    //(Or at least an approximation based on their bounding rectangles...)
+    //(Areas with several tasks count once per task)
+    QPointF avgLocal(0.0,0.0);
+    foreach(int areaId, _taskAreas)
+        avgLocal += _compiled->area(areaId).localBoundingRect.center();
+    avgLocal += _compiled->localStartingPosition();
+    if (_taskAreas.size() > 0)
+        avgLocal /= (_taskAreas.size() + 1);
+
+    //Then loop through all of the areas and find good points that could be start or end: the two ends of
+    //the area's longest chord, pushed just outside it. Make the start the one closest to the average above.
+    const qreal divisions = 100;
+    const QHash<quint64, int> previousChoices = _areaEntryChoices;
+    _areaEntryChoices.clear();
+    QBitArray areaDone(_compiled->areaCount());
+    foreach(int areaId, _taskAreas)
+    {
+        if (areaDone.testBit(areaId))
+            continue;
+        areaDone.setBit(areaId);
+
+        const CompiledProblem::Area& area = _compiled->area(areaId);
+
+        //The search for the two points only depends on the area's shape, so editing other areas doesn't
+        //repeat it. Which of them is the start is cheap and decided below every time.
+        QByteArray keyBytes;
+        {
+            QDataStream keyStream(&keyBytes, QIODevice::WriteOnly);
+            keyStream.setVersion(RESULTS_STREAM_VERSION);
+            keyStream << area.geoPoly;
+        }
+        const quint64 key = PlanningResultCache::hash(keyBytes);
+        _usedResultKeys.insert(key);
+
+        QPointF bestPoint1;
+        QPointF bestPoint2;
+        Position cachedPoint1;
+        Position cachedPoint2;
+        if (_resultCache.lookupEndpoints(key, &cachedPoint1, &cachedPoint2))
+        {
+            bestPoint1 = frame.toLocal(cachedPoint1.lonLat());
+            bestPoint2 = frame.toLocal(cachedPoint2.lonLat());
+            this->workingStatistics()->addToCounter("EndpointCacheHits");
+        }
+        else
+        {
+            this->workingStatistics()->addToCounter("EndpointCacheMisses");
+            polygonDiameter(area.localPoly, &bestPoint1, &bestPoint2);
+
+            //The whole area lies between the diameter's ends, so stepping outward along it leaves the area
+            const QPointF step = (bestPoint1 - bestPoint2) / divisions;
+            bestPoint1 += step;
+            bestPoint2 -= step;
+            _resultCache.insertEndpoints(key, frame.toGeo(bestPoint1), frame.toGeo(bestPoint2));
+        }
+
+        /*
+         * The other places to enter from are either side of the chord's perpendicular bisector, just outside the
+         * area. Each kind of entry heads across the area for the one opposite: kinds 0 and 1 are the chord's ends,
+         * kinds 2 and 3 its sides.
+        */
+        const QPointF middle = (bestPoint1 + bestPoint2) / 2.0;
+        const QPointF chord = bestPoint2 - bestPoint1;
+        const qreal chordLength = sqrt(chord.x() * chord.x() + chord.y() * chord.y());
+        qreal minSide = 0.0;
+        qreal maxSide = 0.0;
+        QPointF normal(0.0, 0.0);
+        if (chordLength > 0.0)
+        {
+            normal = QPointF(-chord.y(), chord.x()) / chordLength;
+            foreach(const QPointF& vertex, area.localPoly)
+            {
+                const qreal side = QPointF::dotProduct(vertex - middle, normal);
+                minSide = qMin<qreal>(minSide, side);
+                maxSide = qMax<qreal>(maxSide, side);
+            }
+        }
+        const qreal margin = (maxSide - minSide) / divisions;
+        const QPointF entryPoints[AREA_ENTRY_KINDS] = {bestPoint1, bestPoint2,
+                                                       middle + normal * (minSide - margin),
+                                                       middle + normal * (maxSide + margin)};
+
+        //The end closest to all the other areas is the best guess, then the other end, then the sides likewise
+        QList<int> kinds;
+        for (int kind = 0; kind < AREA_ENTRY_KINDS; kind += 2)
+        {
+            if (kind > 0 && maxSide - minSide <= 0.0)
+                break;
+            if ((entryPoints[kind] - avgLocal).manhattanLength()
+                    < (entryPoints[kind + 1] - avgLocal).manhattanLength())
+                kinds << kind << kind + 1;
+            else
+                kinds << kind + 1 << kind;
+        }
+        while (kinds.size() > _areaEntryCount)
+            kinds.removeLast();
+
+        QList<Position> positions;
+        QList<UAVOrientation> orientations;
+        foreach(int kind, kinds)
+        {
+            const QPointF& start = entryPoints[kind];
+            const QPointF& end = entryPoints[kind ^ 1];
+            positions.append(frame.toGeo(start));
+            orientations.append(UAVOrientation(atan2(end.y() - start.y(), end.x() - start.x())));
+        }
+        _areaShapeKeys[areaId] = key;
+        _areaEntryPositions[areaId] = positions;
+        _areaEntryOrientations[areaId] = orientations;
+        _areaEntryKinds[areaId] = kinds;
+
+        //Keep entering the area where we did last time, which a replan relies on if the area's been started
+        const int entry = kinds.indexOf(previousChoices.value(key, -1));
+        _useAreaEntry(areaId, qMax<int>(0, entry));
+    }
+}
+
+//private
+void HierarchicalPlanner::_useAreaEntry(int areaId, int entry)
+{
+    //The start transition goes to the old entry
+    if (_areaEntries.at(areaId) != entry)
+        _startTransitionsPlanned.clearBit(areaId);
+
+    _areaEntries[areaId] = entry;
+    _areaStartPositions[areaId] = _areaEntryPositions.at(areaId).at(entry);
+    _areaStartOrientations[areaId] = _areaEntryOrientations.at(areaId).at(entry);
+    _areaEntryChoices.insert(_areaShapeKeys.at(areaId), _areaEntryKinds.at(areaId).at(entry));
+
+    //The sub-flights are only there once _buildSubFlights() has run
+    for (int i = 0; i < _tasks.size(); i++)
+    {
+        if (_taskAreas.at(i) == areaId && entry < _taskEntrySubFlights.at(i).size())
+            _taskSubFlights[i] = _taskEntrySubFlights.at(i).at(entry);
+    }
+}
+
+//private
+void HierarchicalPlanner::_buildStartTransitions()
+{
+    const Position globalStartPos = _startPosition();
+    const UAVOrientation globalStartPose = _startOrientation();
+
+    //Every area's start transition is independent of the others, so plan the ones we don't have at once
+    QHash<QRunnable *, int> jobAreas;
+    QBitArray pendingAreas(_compiled->areaCount());
+    QList<QRunnable *> jobs;
+    foreach(int area, _taskAreas)
+    {
+        if (_startTransitionsPlanned.testBit(area) || pendingAreas.testBit(area))
+            continue;
+        const Position& taskStartPos = _areaStartPositions.at(area);
+        const UAVOrientation& taskStartPose = _areaStartOrientations.at(area);
+
+        QList<Position> subFlight;
+        if (_transitionCache.lookup(globalStartPos, globalStartPose,
+                                    taskStartPos, taskStartPose,
+                                    &subFlight))
+        {
+            _startTransitionSubFlights[area] = subFlight;
+            _startTransitionsPlanned.setBit(area);
+            continue;
+        }
+
+        TransitionPlanningJob * job = new TransitionPlanningJob(this->problem()->uavParameters(),
+                                                                globalStartPos, globalStartPose,
+                                                                taskStartPos, taskStartPose,
+                                                                _obstacles,
+                                                                _obstacleMap,
+                                                                _roadmap,
+                                                                _visibilityGraph);
+        job->setRandomSeed(this->randomSeed());
+        job->setStrategy(_transitionStrategy);
+        job->setPlanningContext(this->planningContext());
+        job->setTerrain(_terrainModel, this->_maxTerrainElevation());
+        job->setTuning(this->runTuning());
+        jobs.append(job);
+        jobAreas.insert(job, area);
+        pendingAreas.setBit(area);
+    }
+
+    _runJobs(jobs, "Transition");
+
+    //An interrupted job's flight is unfinished, so leave its area to be planned again next time
+    const bool interrupted = this->planningInterrupted();
+    foreach(QRunnable * runnable, jobs)
+    {
+        TransitionPlanningJob * job = static_cast<TransitionPlanningJob *>(runnable);
+        if (interrupted)
+        {
+            delete job;
+            continue;
+        }
+        _transitionCache.insert(job->startPos(), job->startPose(),
+                                job->endPos(), job->endPose(),
+                                job->results());
+        const int area = jobAreas.value(job);
+        _startTransitionSubFlights[area] = job->results();
+        _startTransitionsPlanned.setBit(area);
+        delete job;
+    }
+    this->workingStatistics()->addToCounter("TransitionsPlanned", jobs.size());
+}
+
+//private
+void HierarchicalPlanner::_buildSubFlights()
+{
+    //Each task's sub-flight from each of its area's entries only depends on those, so we can plan them all at once
+    const int workers = (_workerCount == 0) ? QThread::idealThreadCount() : _workerCount;
+
+    QList<QRunnable *> jobs;
+    QHash<QRunnable *, quint64> jobKeys;
+    QHash<QRunnable *, QPair<int, int> > jobEntries;
+    for (int i = 0; i < _tasks.size(); i++)
+    {
+        const QSharedPointer<FlightTask>& task = _tasks.at(i);
+        const int areaId = _taskAreas.at(i);
+        _taskEntrySubFlights[i].clear();
+        for (int e = 0; e < _areaEntryPositions.at(areaId).size(); e++)
+        {
+            const Position& start = _areaEntryPositions.at(areaId).at(e);
+            const UAVOrientation& startPose = _areaEntryOrientations.at(areaId).at(e);
+
+            const quint64 key = _subFlightKey(task, _compiled->area(areaId).geoPoly, start, startPose);
+            _usedResultKeys.insert(key);
+
+            QList<Position> subFlight;
+            if (_resultCache.lookupSubFlight(key, &subFlight))
+            {
+                _taskEntrySubFlights[i].append(subFlight);
+                this->workingStatistics()->addToCounter("SubFlightCacheHits");
+                continue;
+            }
+            _taskEntrySubFlights[i].append(QList<Position>());
+
+            const QSharedPointer<FlightTaskArea>& area = _compiled->sharedArea(areaId);
+            planningDebug(subFlightLog) << "Build sub-flight for" << task.data() << area.data() << start << startPose;
+
+            SubFlightPlanningJob * job = new SubFlightPlanningJob(this->problem()->uavParameters(),
+                                                                  task, area, start, startPose);
+
+            //The beam slices go to the same job system as the tasks, so workers that aren't busy with another
+            //task pick them up without there being more threads than workers
+            job->setBeamWidth(_subFlightBeamWidth);
+            job->setBranchesPerSide(this->runTuning().subFlightBranchesPerSide());
+            job->setWorkerCount(workers);
+            job->setRandomSeed(this->randomSeed());
+            job->setPlanningContext(this->planningContext());
+            jobs.append(job);
+            jobKeys.insert(job, key);
+            jobEntries.insert(job, qMakePair(i, e));
+        }
+    }
+
+    _runJobs(jobs, "SubFlight");
+
+    PlanningStatistics * statistics = this->workingStatistics();
+    statistics->addToCounter("SubFlightCacheMisses", jobs.size());
+    foreach(QRunnable * runnable, jobs)
+    {
+        SubFlightPlanningJob * job = static_cast<SubFlightPlanningJob *>(runnable);
+        const QPair<int, int> entry = jobEntries.value(job);
+        _taskEntrySubFlights[entry.first][entry.second] = job->results();
+        statistics->addToCounter("SubFlightNodesExpanded", job->expandedNodes());
+        statistics->addToCounter("FitnessEvaluations", job->scoredNodes());
+        statistics->addToCounter("SubFlightTranspositionHits", job->transpositionHits());
+        statistics->addToCounter("SubFlightTranspositionMisses", job->transpositionMisses());
+
+        //An interrupted job's flight is unfinished, so don't remember it
+        if (!this->planningInterrupted())
+            _resultCache.insertSubFlight(jobKeys.value(job), job->results());
+        delete job;
+    }
+
+    for (int i = 0; i < _tasks.size(); i++)
+        _taskSubFlights[i] = _taskEntrySubFlights.at(i).value(_areaEntries.at(_taskAreas.at(i)));
+}
+
+//private
+void HierarchicalPlanner::_buildTransitionMatrix(const QVector<int> &taskClusters)
+{
+    const UAVParameters& params = this->problem()->uavParameters();
+
+    QList<QRunnable *> jobs;
+    for (int prevTask = 0; prevTask < _tasks.size(); prevTask++)
+    {
+        const QList<Position>& prevSubFlight = _taskSubFlights.at(prevTask);
+
+        //Where we are when we've completely finished the previous task
+        Position startPos;
+        UAVOrientation startPose;
+        if (!_interpolatePath(prevSubFlight,
+                              _areaStartOrientations.at(_taskAreas.at(prevTask)),
+                              _subFlightTime(prevSubFlight),
+                              &startPos,
+                              &startPose))
+            continue;
+
+        for (int task = 0; task < _tasks.size(); task++)
+        {
+            if (task == prevTask)
+                continue;
+
+            //Only between tasks of the same cluster, if we were given clusters
+            if (!taskClusters.isEmpty()
+                    && (taskClusters.at(task) < 0 || taskClusters.at(task) != taskClusters.at(prevTask)))
+                continue;
+
+            //Where we are when we haven't started the next task at all
+            Position endPos;
+            UAVOrientation endPose;
+            if (!_interpolatePath(_taskSubFlights.at(task),
+                                  _areaStartOrientations.at(_taskAreas.at(task)),
+                                  0.0,
+                                  &endPos,
+                                  &endPose))
+                continue;
+
+            if (_transitionCache.contains(startPos, startPose, endPos, endPose))
+                continue;
+
+            TransitionPlanningJob * job = new TransitionPlanningJob(params,
+                                                                    startPos, startPose,
+                                                                    endPos, endPose,
+                                                                    _obstacles,
+                                                                    _obstacleMap,
+                                                                    _roadmap,
+                                                                    _visibilityGraph);
+            job->setRandomSeed(this->randomSeed());
+            job->setStrategy(_transitionStrategy);
+            job->setPlanningContext(this->planningContext());
+            job->setTerrain(_terrainModel, this->_maxTerrainElevation());
+            job->setTuning(this->runTuning());
+            jobs.append(job);
+        }
+    }
+
+    planningDebug(plannerLog) << "Precomputing" << jobs.size() << "transition flights";
+    _runJobs(jobs, "Transition");
+
+    const bool interrupted = this->planningInterrupted();
+    foreach(QRunnable * runnable, jobs)
+    {
+        TransitionPlanningJob * job = static_cast<TransitionPlanningJob *>(runnable);
+        if (!interrupted)
+            _transitionCache.insert(job->startPos(), job->startPose(),
+                                    job->endPos(), job->endPose(),
+                                    job->results());
+        delete job;
+    }
+    this->workingStatistics()->addToCounter("TransitionsPlanned", jobs.size());
+}
+
+//private
+bool HierarchicalPlanner::_buildSchedule(ScheduleSolution *solution)
+{
+    //First we need to know how long each of our sub-flights takes
+    QList<qreal> taskTimes;
+    foreach(const QList<Position>& subFlight, _taskSubFlights)
+    {
+        taskTimes.append(_subFlightTime(subFlight));
+    }
+
+    //start and end states
+    const QVectorND startState = _scheduleStartState(taskTimes);
+    const QVectorND endState(taskTimes);
+
+    planningDebug(scheduleLog) << "Schedule from" << startState << "to" << endState;
+
+    QElapsedTimer budgetClock;
+    budgetClock.start();
+
+    //Dependencies as bit masks and timing constraints as windows, so the search checks them in a few operations
+    if (!_buildConstraints(taskTimes))
+    {
+        planningDebug(scheduleLog) << "The tasks' timing constraints and dependencies can't all be met";
+        return false;
+    }
+
+    _buildTransitionBounds();
+
+    /*
+     * Fly something right away: the cheaper of the previous schedule's task order on the current sub-flights
+     * and a short tour of the tasks, each flown to completion. Either finishes whatever it leaves undone in task
+     * order. If one of them is feasible it's our first schedule and its cost bounds every search below, so
+     * states that can't beat it are never opened.
+    */
+    ScheduleSolution best;
+    best.cost = std::numeric_limits<qreal>::max();
+    bool solutionFound = false;
+    QList<int> previousOrder;
+    foreach(const QSharedPointer<FlightTask>& task, _previousSchedule)
+    {
+        const int index = _tasks.indexOf(task);
+        if (index >= 0)
+            previousOrder.append(index);
+    }
+    if (!previousOrder.isEmpty()
+            && _replaySchedule(taskTimes, startState, endState, previousOrder, previousOrder.size(), &best))
+    {
+        planningDebug(scheduleLog) << "Replayed schedule has cost" << best.cost;
+        solutionFound = true;
+    }
+
+    ScheduleSolution tour;
+    if (_replaySchedule(taskTimes, startState, endState, _tourOrder(taskTimes, startState), 0, &tour))
+    {
+        planningDebug(scheduleLog) << "Tour schedule has cost" << tour.cost;
+        if (tour.cost < best.cost)
+            best = tour;
+        solutionFound = true;
+    }
+
+    if (solutionFound)
+    {
+        this->workingStatistics()->setCounter("ScheduleWarmStartCost", best.cost);
+        _flySchedule(best, startState);
+    }
+
+    /*
+     * Big missions are scheduled a cluster of tasks at a time (see scheduleClusterSize()), which is what keeps
+     * them tractable. The whole mission is only searched at once if that fails.
+    */
+    int unfinished = 0;
+    for (int i = 0; i < taskTimes.size(); i++)
+    {
+        if (startState.val(i) < taskTimes.at(i))
+            unfinished++;
+    }
+    if (_scheduleClusterSize > 0 && unfinished > _scheduleClusterSize)
+    {
+        ScheduleSolution decomposed;
+        if (_buildDecomposedSchedule(taskTimes, startState, &decomposed))
+        {
+            planningDebug(scheduleLog) << "Decomposed schedule has cost" << decomposed.cost;
+            if (decomposed.cost < best.cost)
+            {
+                best = decomposed;
+                _flySchedule(best, startState);
+            }
+            *solution = best;
+            return true;
+        }
+
+        if (this->planningInterrupted())
+        {
+            if (solutionFound)
+                *solution = best;
+            return solutionFound;
+        }
+        planningDebug(scheduleLog) << "Couldn't schedule the clusters in turn, searching the whole mission";
+    }
+
+    solutionFound = _refineSchedule(taskTimes, startState, -1, _replanStartTime, endState, budgetClock, true, &best);
+    if (solutionFound)
+        *solution = best;
+    return solutionFound;
+}
+
+//private
+bool HierarchicalPlanner::_refineSchedule(const QList<qreal> &taskTimes,
+                                          const QVectorND &startState,
+                                          int startLastTask,
+                                          qreal startCost,
+                                          const QVectorND &endState,
+                                          const QElapsedTimer &budgetClock,
+                                          bool flyImprovements,
+                                          HierarchicalPlanner::ScheduleSolution *best)
+{
+    bool solutionFound = (best->cost < std::numeric_limits<qreal>::max());
+
+    /*
+     * Pick the time slices to search with. With multi-resolution scheduling, long tasks first get a search on a
+     * coarse lattice, which is cheap because it has few states. Each finer level only searches the corridor
+     * within one coarser slice of the best schedule so far, so its task switches can move by up to a slice.
+    */
+    qreal maxTaskTime = 0.0;
+    for (int i = 0; i < endState.dimension(); i++)
+    {
+        if (endState.val(i) > startState.val(i))
+            maxTaskTime = qMax<qreal>(maxTaskTime, taskTimes.at(i));
+    }
+
+    QList<qreal> timeslices;
+    timeslices.append(this->runTuning().scheduleTimeslice());
+    while (_multiResolutionScheduling && maxTaskTime > SCHEDULE_COARSE_STEPS * timeslices.first())
+        timeslices.prepend(timeslices.first() * SCHEDULE_REFINEMENT_FACTOR);
+    this->workingStatistics()->setCounter("ScheduleResolutionLevels", timeslices.size());
+
+    /*
+     * Search each level for better schedules with weighted A*, tightening the weight each pass. The early passes
+     * find a decent schedule quickly and the last one is plain A*, which proves the best it finds is optimal (on
+     * that level's lattice and in its corridor). Every pass only looks for schedules cheaper than the best so
+     * far, and each one it finds is flown immediately if flyImprovements is set.
+    */
+    const int passes = sizeof(SCHEDULE_WEIGHTS) / sizeof(SCHEDULE_WEIGHTS[0]);
+    bool stopped = false;
+    for (int level = 0; level < timeslices.size() && !stopped; level++)
+    {
+        const qreal timeslice = timeslices.at(level);
+
+        //The coarsest level searches everywhere. The others stay near the best schedule, if we have one.
+        QList<QVectorND> corridor;
+        qreal corridorWidth = 0.0;
+        if (level > 0 && solutionFound)
+        {
+            corridor = _scheduleCorners(*best);
+            corridorWidth = timeslices.at(level - 1);
+        }
+
+        for (int pass = 0; pass < passes; pass++)
+        {
+            ScheduleSolution improved;
+            bool memoryExhausted = false;
+            if (_searchSchedule(taskTimes, startState, startLastTask, startCost, endState, timeslice, corridor,
+                                corridorWidth, SCHEDULE_WEIGHTS[pass], best->cost, budgetClock, &improved,
+                                &memoryExhausted))
+            {
+                planningDebug(scheduleLog) << "Slice" << timeslice << "weight" << SCHEDULE_WEIGHTS[pass]
+                                           << "found a schedule with cost" << improved.cost;
+                *best = improved;
+                solutionFound = true;
+                if (flyImprovements)
+                    _flySchedule(*best, startState);
+            }
+
+            //A pass that was cut short proves nothing, and neither would the passes after it. The later passes
+            //search more states, so one that ran out of memory means they would too.
+            if (memoryExhausted || this->planningInterrupted() || _scheduleBudgetExhausted(budgetClock))
+            {
+                stopped = true;
+                break;
+            }
+        }
+    }
+    return solutionFound;
+}
+
+//private
+bool HierarchicalPlanner::_buildDecomposedSchedule(const QList<qreal> &taskTimes,
+                                                   const QVectorND &startState,
+                                                   HierarchicalPlanner::ScheduleSolution *solution)
+{
+    const QList<QList<int> > clusters = _scheduleClusters(startState, taskTimes);
+    this->workingStatistics()->setCounter("ScheduleClusters", clusters.size());
+    planningDebug(scheduleLog) << "Scheduling" << clusters.size() << "clusters in turn";
+
+    //Each cluster's search switches between its own tasks, so plan all of those transitions at once up front
+    if (!_precomputeTransitions)
+    {
+        QVector<int> taskClusters(_tasks.size(), -1);
+        for (int c = 0; c < clusters.size(); c++)
+        {
+            foreach(int i, clusters.at(c))
+                taskClusters[i] = c;
+        }
+        _buildTransitionMatrix(taskClusters);
+        if (this->planningInterrupted())
+            return false;
+    }
+
+    /*
+     * Each cluster is searched from where the one before it ended, so they go one after the other. The
+     * transitions between clusters are planned by the searches themselves, as the first move of each.
+    */
+    ScheduleSolution toRet;
+    toRet.cost = _replanStartTime;
+    toRet.states.append(startState);
+    QVectorND state = startState;
+    int lastTask = -1;
+    foreach(const QList<int>& cluster, clusters)
+    {
+        QVectorND clusterEnd = state;
+        foreach(int i, cluster)
+            clusterEnd[i] = taskTimes.at(i);
+
+        //The time budget is per cluster, so that the last ones get a schedule too
+        QElapsedTimer budgetClock;
+        budgetClock.start();
+
+        ScheduleSolution clusterSolution;
+        clusterSolution.cost = std::numeric_limits<qreal>::max();
+        if (!_refineSchedule(taskTimes, state, lastTask, toRet.cost, clusterEnd, budgetClock, false,
+                             &clusterSolution))
+            return false;
+
+        //Its first state is where the cluster before it ended
+        for (int k = 1; k < clusterSolution.states.size(); k++)
+            toRet.states.append(clusterSolution.states.at(k));
+        toRet.lastTasks.unite(clusterSolution.lastTasks);
+        toRet.transitionFlights.unite(clusterSolution.transitionFlights);
+        toRet.cost = clusterSolution.cost;
+
+        state = clusterEnd;
+        lastTask = clusterSolution.lastTasks.value(clusterEnd, lastTask);
+    }
+
+    *solution = toRet;
+    return true;
+}
+
+//private
+QList<QList<int> > HierarchicalPlanner::_scheduleClusters(const QVectorND &startState,
+                                                           const QList<qreal> &taskTimes) const
+{
+    //Tasks in one area start in the same place, and tasks that depend on each other have to go together
+    QVector<int> parents(_tasks.size(), -1);
+    QHash<int, int> areaTasks;
+    for (int i = 0; i < _tasks.size(); i++)
+    {
+        if (startState.val(i) >= taskTimes.at(i))
+            continue;
+        parents[i] = i;
+        if (areaTasks.contains(_taskAreas.at(i)))
+            parents[i] = clusterRoot(&parents, areaTasks.value(_taskAreas.at(i)));
+        else
+            areaTasks.insert(_taskAreas.at(i), i);
+    }
+    for (int i = 0; i < _tasks.size(); i++)
+    {
+        if (parents.at(i) < 0)
+            continue;
+        foreach(int index, _taskDependencies.at(i))
+        {
+            if (parents.at(index) >= 0)
+                parents[clusterRoot(&parents, index)] = clusterRoot(&parents, i);
+        }
+    }
+
+    QList<QList<int> > clusters;
+    QList<QPointF> centers;
+    QHash<int, int> rootClusters;
+    for (int i = 0; i < _tasks.size(); i++)
+    {
+        if (parents.at(i) < 0)
+            continue;
+        const int root = clusterRoot(&parents, i);
+        if (!rootClusters.contains(root))
+        {
+            rootClusters.insert(root, clusters.size());
+            clusters.append(QList<int>());
+            centers.append(QPointF());
+        }
+        const int c = rootClusters.value(root);
+        clusters[c].append(i);
+        centers[c] += _areaStartPositions.at(_taskAreas.at(i)).lonLat();
+    }
+    for (int c = 0; c < clusters.size(); c++)
+        centers[c] /= clusters.at(c).size();
+
+    //Then keep merging the two nearest clusters that still fit in one
+    while (true)
+    {
+        int bestA = -1;
+        int bestB = -1;
+        qreal bestDistance = std::numeric_limits<qreal>::max();
+        for (int a = 0; a < clusters.size(); a++)
+        {
+            for (int b = a + 1; b < clusters.size(); b++)
+            {
+                if (clusters.at(a).size() + clusters.at(b).size() > _scheduleClusterSize)
+                    continue;
+                const qreal distance = Position(centers.at(a)).flatDistanceEstimate(Position(centers.at(b)));
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    bestA = a;
+                    bestB = b;
+                }
+            }
+        }
+        if (bestA < 0)
+            break;
+
+        const qreal sizeA = clusters.at(bestA).size();
+        const qreal sizeB = clusters.at(bestB).size();
+        centers[bestA] = (centers.at(bestA) * sizeA + centers.at(bestB) * sizeB) / (sizeA + sizeB);
+        clusters[bestA] += clusters.at(bestB);
+        std::sort(clusters[bestA].begin(), clusters[bestA].end());
+        clusters.removeAt(bestB);
+        centers.removeAt(bestB);
+    }
+
+    QList<int> order;
+    const int k = clusters.size();
+    if (_hasTimingConstraints())
+    {
+        //Clusters are never interleaved, so with deadlines they have to go in deadline order
+        QList<QPair<qreal, int> > deadlines;
+        for (int c = 0; c < k; c++)
+        {
+            qreal deadline = std::numeric_limits<qreal>::max();
+            foreach(int i, clusters.at(c))
+                deadline = qMin<qreal>(deadline, _latestFinishes.at(i));
+            deadlines.append(QPair<qreal, int>(deadline, c));
+        }
+        std::sort(deadlines.begin(), deadlines.end());
+        for (int c = 0; c < k; c++)
+            order.append(deadlines.at(c).second);
+    }
+    else
+    {
+        //Otherwise a short path through them from the start: nearest first, then untangled by 2-opt
+        QVector<Position> points;
+        foreach(const QPointF& center, centers)
+            points.append(Position(center));
+        points.append(_startPosition());
+
+        QVector<qreal> distances((k + 1) * (k + 1), 0.0);
+        for (int a = 0; a <= k; a++)
+            Position::distances(points.at(a), points.constData(), k + 1, distances.data() + a * (k + 1));
+
+        QVector<bool> visited(k, false);
+        int current = k;
+        for (int step = 0; step < k; step++)
+        {
+            int next = -1;
+            for (int c = 0; c < k; c++)
+            {
+                if (!visited.at(c) && (next < 0 || distances.at(current * (k + 1) + c)
+                                       < distances.at(current * (k + 1) + next)))
+                    next = c;
+            }
+            visited[next] = true;
+            order.append(next);
+            current = next;
+        }
+
+        //Reversing order[i..j] replaces the edge into i and the edge out of j. The path is open, so j may be last.
+        bool improved = true;
+        while (improved)
+        {
+            improved = false;
+            for (int i = 0; i < k; i++)
+            {
+                for (int j = i + 1; j < k; j++)
+                {
+                    const int before = (i == 0) ? k : order.at(i - 1);
+                    qreal oldLength = distances.at(before * (k + 1) + order.at(i));
+                    qreal newLength = distances.at(before * (k + 1) + order.at(j));
+                    if (j + 1 < k)
+                    {
+                        oldLength += distances.at(order.at(j) * (k + 1) + order.at(j + 1));
+                        newLength += distances.at(order.at(i) * (k + 1) + order.at(j + 1));
+                    }
+                    if (newLength < oldLength - 1e-6)
+                    {
+                        std::reverse(order.begin() + i, order.begin() + j + 1);
+                        improved = true;
+                    }
+                }
+            }
+        }
+    }
+
+    QList<QList<int> > toRet;
+    foreach(int c, order)
+        toRet.append(clusters.at(c));
+    return toRet;
+}
+
+//private
+bool HierarchicalPlanner::_replaySchedule(const QList<qreal> &taskTimes,
+                                          const QVectorND &startState,
+                                          const QVectorND &endState,
+                                          const QList<int> &taskOrder,
+                                          int slicedEntries,
+                                          HierarchicalPlanner::ScheduleSolution *solution)
+{
+    const qreal infinity = std::numeric_limits<qreal>::max();
+
+    //Whatever taskOrder leaves undone is finished in task order
+    QList<int> order = taskOrder;
+    for (int i = 0; i < _tasks.size(); i++)
+        order.append(i);
+
+    ScheduleSolution toRet;
+    QVectorND state = startState;
+    qreal cost = _replanStartTime;
+    int lastTask = -1;
+    toRet.states.append(startState);
+    for (int k = 0; k < order.size(); k++)
+    {
+        const int i = order.at(k);
+        while (state[i] < taskTimes[i])
+        {
+            QVectorND newState = state;
+            newState[i] = qMin<qreal>(taskTimes[i], newState[i] + this->runTuning().scheduleTimeslice());
+
+            qreal newCost;
+            QList<Position> transitionFlight;
+            if (!_scheduleMove(state, lastTask, cost, i, newState, taskTimes, infinity,
+                               &newCost, &transitionFlight))
+                return false;
+
+            toRet.states.append(newState);
+            toRet.lastTasks.insert(newState, i);
+            toRet.transitionFlights.insert(newState, transitionFlight);
+            state = newState;
+            cost = newCost;
+            lastTask = i;
+
+            //The first slicedEntries (e.g. a previous schedule's) are one time slice each
+            if (k < slicedEntries)
+                break;
+        }
+    }
+
+    if (state != endState)
+        return false;
+
+    toRet.cost = cost;
+    *solution = toRet;
+    return true;
+}
+
+//private
+void HierarchicalPlanner::_chooseAreaEntries(HierarchicalPlanner::ScheduleSolution *solution)
+{
+    const UAVParameters& params = this->problem()->uavParameters();
+
+    QList<qreal> taskTimes;
+    foreach(const QList<Position>& subFlight, _taskSubFlights)
+        taskTimes.append(_subFlightTime(subFlight));
+    const QVectorND startState = _scheduleStartState(taskTimes);
+
+    //An area a replanned flight has started has to be finished from the entry it was started from
+    QBitArray started(_compiled->areaCount());
+    for (int i = 0; i < _tasks.size(); i++)
+    {
+        if (startState.val(i) > 0.0)
+            started.setBit(_taskAreas.at(i));
+    }
+
+    /*
+     * Follow the schedule to where it first arrives at each area, and enter the area from wherever is quickest to
+     * get to from there (by Dubins estimate) and to fly all of its tasks from.
+    */
+    const QVector<int> previousEntries = _areaEntries;
+    QBitArray seen(_compiled->areaCount());
+    int changed = 0;
+    for (int s = 1; s < solution->states.size(); s++)
+    {
+        const QVectorND& prevInterval = solution->states.at(s - 1);
+        const int area = _taskAreas.at(solution->lastTasks.value(solution->states.at(s)));
+        if (seen.testBit(area))
+            continue;
+        seen.setBit(area);
+        if (started.testBit(area) || _areaEntryPositions.at(area).size() < 2)
+            continue;
+
+        Position arrivalPos = _startPosition();
+        UAVOrientation arrivalPose = _startOrientation();
+        if (prevInterval != startState)
+        {
+            const int prevTask = solution->lastTasks.value(prevInterval);
+            _interpolatePath(_taskSubFlights.at(prevTask), _areaStartOrientations.at(_taskAreas.at(prevTask)),
+                             prevInterval.val(prevTask), &arrivalPos, &arrivalPose);
+        }
+
+        int bestEntry = -1;
+        qreal bestCost = std::numeric_limits<qreal>::max();
+        qreal currentCost = std::numeric_limits<qreal>::max();
+        for (int e = 0; e < _areaEntryPositions.at(area).size(); e++)
+        {
+            qreal cost = IntermediatePlanner::dubinsCostEstimate(params, arrivalPos, arrivalPose,
+                                                                 _areaEntryPositions.at(area).at(e),
+                                                                 _areaEntryOrientations.at(area).at(e));
+            bool planned = true;
+            for (int i = 0; i < _tasks.size(); i++)
+            {
+                if (_taskAreas.at(i) != area)
+                    continue;
+                const QList<Position>& subFlight = _taskEntrySubFlights.at(i).value(e);
+                planned = planned && !subFlight.isEmpty();
+                cost += _subFlightTime(subFlight);
+            }
+            if (!planned)
+                continue;
+            if (e == _areaEntries.at(area))
+                currentCost = cost;
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestEntry = e;
+            }
+        }
+
+        if (bestEntry >= 0 && bestCost < currentCost - IMPROVEMENT_EPSILON)
+        {
+            _useAreaEntry(area, bestEntry);
+            changed++;
+        }
+    }
+    this->workingStatistics()->setCounter("AreaEntriesChanged", changed);
+    if (changed == 0)
+        return;
+
+    //Schedule again on the new entries. Their start transitions (and transitions, if we precompute them) first.
+    ScheduleSolution rescheduled;
+    bool scheduled = false;
+    _buildStartTransitions();
+    if (_precomputeTransitions && !this->planningInterrupted())
+        _buildTransitionMatrix();
+    if (!this->planningInterrupted())
+        scheduled = _buildSchedule(&rescheduled);
+    if (scheduled && rescheduled.cost < solution->cost - IMPROVEMENT_EPSILON)
+    {
+        planningDebug(scheduleLog) << "New area entries cut the schedule's cost from" << solution->cost
+                                   << "to" << rescheduled.cost;
+        *solution = rescheduled;
+        return;
+    }
+
+    //No better, so go back to the old entries and fly the old schedule again in case the search published another
+    for (int area = 0; area < previousEntries.size(); area++)
+    {
+        if (_areaEntries.at(area) != previousEntries.at(area))
+            _useAreaEntry(area, previousEntries.at(area));
+    }
+    _buildStartTransitions();
+    _buildConstraints(taskTimes);
+    _buildTransitionBounds();
+    _flySchedule(*solution, startState);
+}
+
+//private
+QList<int> HierarchicalPlanner::_tourOrder(const QList<qreal> &taskTimes, const QVectorND &startState)
+{
+    const UAVParameters& params = this->problem()->uavParameters();
+
+    QList<int> tasks;
+    for (int i = 0; i < _tasks.size(); i++)
+    {
+        if (startState.val(i) < taskTimes.at(i))
+            tasks.append(i);
+    }
+    const int n = tasks.size();
+    if (n < 2)
+        return tasks;
+
+    /*
+     * How long it takes to get from finishing one task to starting another: the transition flight's length if
+     * we've planned it, otherwise its Dubins estimate. From the start we only have the transition bounds. The
+     * start is node n.
+    */
+    const int boundsCount = _tasks.size() + 1;
+    QVector<qreal> times((n + 1) * (n + 1), 0.0);
+    for (int b = 0; b < n; b++)
+    {
+        if (_transitionBounds.size() == boundsCount * boundsCount)
+            times[n * (n + 1) + b] = _transitionBounds.at(_tasks.size() * boundsCount + tasks.at(b));
+    }
+    for (int a = 0; a < n; a++)
+    {
+        QVectorND finished = startState;
+        finished[tasks.at(a)] = taskTimes.at(tasks.at(a));
+        for (int b = 0; b < n; b++)
+        {
+            if (a == b)
+                continue;
+            Position startPos;
+            UAVOrientation startPose;
+            Position endPos;
+            UAVOrientation endPose;
+            _transitionEndpoints(finished, tasks.at(a), tasks.at(b), &startPos, &startPose, &endPos, &endPose);
+
+            QList<Position> cached;
+            if (_transitionCache.contains(startPos, startPose, endPos, endPose)
+                    && _transitionCache.lookup(startPos, startPose, endPos, endPose, &cached))
+                times[a * (n + 1) + b] = cached.length() * params.waypointInterval() / params.airspeed();
+            else
+                times[a * (n + 1) + b] = IntermediatePlanner::dubinsCostEstimate(params, startPos, startPose,
+                                                                                 endPos, endPose);
+        }
+    }
+
+    //A tour can only visit a task once everything it depends on has been visited (or was already finished)
+    QVector<int> positions(_tasks.size(), -1);
+    QVector<bool> visited(n, false);
+    QList<int> order;
+    int current = n;
+    for (int step = 0; step < n; step++)
+    {
+        int next = -1;
+        for (int c = 0; c < n; c++)
+        {
+            if (visited.at(c))
+                continue;
+            bool ready = true;
+            foreach(int index, _taskDependencies.at(tasks.at(c)))
+                ready = ready && (positions.at(index) >= 0 || startState.val(index) >= taskTimes.at(index));
+            if (ready && (next < 0 || times.at(current * (n + 1) + c) < times.at(current * (n + 1) + next)))
+                next = c;
+        }
+
+        //The dependencies go round in a circle. _buildConstraints() will have said so, but don't hang on it.
+        if (next < 0)
+            return tasks;
+        visited[next] = true;
+        positions[tasks.at(next)] = order.size();
+        order.append(next);
+        current = next;
+    }
+
+    /*
+     * Then untangle it with 2-opt. Transitions aren't symmetric (headings matter), so each reversal is judged on
+     * the whole path it gives, and kept only if it still visits every task after its dependencies.
+    */
+    qreal length = 0.0;
+    for (int k = 0; k < n; k++)
+        length += times.at(((k == 0) ? n : order.at(k - 1)) * (n + 1) + order.at(k));
+
+    bool improved = true;
+    while (improved && !this->planningInterrupted())
+    {
+        improved = false;
+        for (int i = 0; i < n - 1; i++)
+        {
+            for (int j = i + 1; j < n; j++)
+            {
+                QList<int> candidate = order;
+                std::reverse(candidate.begin() + i, candidate.begin() + j + 1);
+
+                qreal candidateLength = 0.0;
+                for (int k = 0; k < n; k++)
+                {
+                    candidateLength += times.at(((k == 0) ? n : candidate.at(k - 1)) * (n + 1) + candidate.at(k));
+                    positions[tasks.at(candidate.at(k))] = k;
+                }
+                if (candidateLength >= length - 1e-6)
+                    continue;
+
+                bool feasible = true;
+                for (int k = i; k <= j && feasible; k++)
+                {
+                    foreach(int index, _taskDependencies.at(tasks.at(candidate.at(k))))
+                        feasible = feasible && positions.at(index) < k;
+                }
+                if (!feasible)
+                    continue;
+
+                order = candidate;
+                length = candidateLength;
+                improved = true;
+            }
+        }
+    }
+
+    QList<int> toRet;
+    foreach(int c, order)
+        toRet.append(tasks.at(c));
+    return toRet;
+}
+
+//private
+bool HierarchicalPlanner::_searchSchedule(const QList<qreal> &taskTimes,
+                                          const QVectorND &startState,
+                                          int startLastTask,
+                                          qreal startCost,
+                                          const QVectorND &endState,
+                                          qreal timeslice,
+                                          const QList<QVectorND> &corridor,
+                                          qreal corridorWidth,
+                                          qreal weight,
+                                          qreal costToBeat,
+                                          const QElapsedTimer &budgetClock,
+                                          HierarchicalPlanner::ScheduleSolution *solution,
+                                          bool *memoryExhausted)
 {
-    this->doReset();
+    const qreal infinity = std::numeric_limits<qreal>::max();
+    const UAVParameters& params = this->problem()->uavParameters();
+
+    //Every state reached: its cost, parent, transition flight and whether it's closed or dominated
+    ScheduleNodeTable nodes;
+
+    //Of node indices, and of lazy moves as -1 - their index in lazyMoves
+    PriorityQueue<int> worklist;
+    QVector<LazyScheduleMove> lazyMoves;
+    qint64 deferredCount = 0;
+    qint64 expanded = 0;
+
+    /*
+     * For dominance pruning: the states that nothing else reached so far covers (see ScheduleState::covers())
+     * at a lower cost, grouped by position. Dominated states are marked in their nodes.
+    */
+    const bool pruneDominated = _scheduleDominancePruning && !_hasTimingConstraints();
+    QHash<quint64, QList<int> > fronts;
+    qint64 dominatedCount = 0;
+
+    //States and moves that the constraints rule out before any transition is planned
+    qint64 infeasibleCount = 0;
+
+    PlanningStatistics * statistics = this->workingStatistics();
+    statistics->addToCounter("SchedulePasses");
+    const qint64 expandedBefore = statistics->counter("ScheduleStatesExpanded");
+    const qint64 dominatedBefore = statistics->counter("ScheduleStatesDominated");
+
+    //Past the memory budget, only the best few open states are kept (see scheduleMemoryBudget())
+    *memoryExhausted = false;
+    const qint64 openEntryBytes = sizeof(qreal) + sizeof(quint64) + sizeof(int);
+
+    //States are slice counts on this pass's lattice
+    const ScheduleLattice lattice(startState, taskTimes, timeslice);
+
+    const int startIndex = nodes.insert(lattice.origin(startLastTask));
+    nodes.node(startIndex).cost = startCost;
+    worklist.insert(weight * _scheduleHeuristic(startState, startLastTask, endState), startIndex);
+
+    bool solutionFound = false;
+    while (!worklist.isEmpty())
+    {
+        //Give up if somebody paused or reset us while we were searching, or if we're out of time
+        if (this->planningInterrupted() || _scheduleBudgetExhausted(budgetClock))
+            break;
+
+        const qreal costKey = worklist.minPriority();
+        const int entry = worklist.takeMin();
+
+        //A lazy move is the most promising thing we have, so now it's worth planning its transition
+        if (entry < 0)
+        {
+            const LazyScheduleMove move = lazyMoves.at(-1 - entry);
+
+            //If the state it's from has been reached more cheaply since, that expansion queued its own moves
+            if (nodes.at(move.parent).cost != move.parentCost)
+                continue;
+
+            const ScheduleState parent = nodes.at(move.parent).state;
+            const ScheduleState newState = lattice.advance(parent, move.task);
+            const QVectorND newProgress = lattice.progress(newState);
+            const qreal knownCost = nodes.cost(newState);
+
+            qreal cost;
+            QList<Position> transitionFlight;
+            if (!_scheduleMove(lattice.progress(parent), parent.lastTask(), move.parentCost, move.task, newProgress,
+                               taskTimes, knownCost, &cost, &transitionFlight))
+                continue;
+
+            const qreal heuristic = _scheduleHeuristic(newProgress, move.task, endState);
+            if (cost + heuristic >= costToBeat || knownCost <= cost)
+                continue;
+
+            //Back on the open list at its real cost, which is usually more than we guessed
+            openScheduleState(newState, move.parent, cost, cost + weight * heuristic, pruneDominated,
+                              &nodes, &fronts, &worklist, &dominatedCount);
+            continue;
+        }
+
+        const int index = entry;
+
+        //States get re-inserted when we find a cheaper way to them. Skip the stale entries, and the dominated ones.
+        if (nodes.at(index).closed || nodes.at(index).dominated)
+            continue;
+        nodes.node(index).closed = true;
+        expanded++;
+
+        //Copied, since adding nodes below may move the table's storage
+        const ScheduleState state = nodes.at(index).state;
+        const qreal stateCost = nodes.at(index).cost;
+        const QVectorND progress = lattice.progress(state);
+
+        //Let anyone watching see how the search is going
+        if (expanded % SCHEDULE_PROGRESS_INTERVAL == 0)
+        {
+            statistics->setCounter("ScheduleStatesExpanded", expandedBefore + expanded);
+            statistics->setCounter("ScheduleStatesDominated", dominatedBefore + dominatedCount);
+            statistics->setCounter("ScheduleOpenListSize", worklist.size());
+            statistics->setCounter("ScheduleMemoryBytes",
+                                   nodes.memoryBytes() + worklist.size() * openEntryBytes
+                                   + lazyMoves.size() * (qint64) sizeof(LazyScheduleMove));
+            _updateTransitionCacheCounters();
+            this->publishStatistics();
+        }
+
+        planningTrace(scheduleLog) << "At:" << progress << "after task" << state.lastTask() << "with cost" << costKey;
+
+        if (progress == endState)
+        {
+            planningDebug(scheduleLog) << "Done scheduling - traceback.";
+            solutionFound = true;
+            solution->cost = stateCost;
+            solution->states.clear();
+            solution->lastTasks.clear();
+            solution->transitionFlights.clear();
+            for (int current = index; current >= 0; current = nodes.at(current).parent)
+            {
+                const ScheduleNodeTable::Node& node = nodes.at(current);
+                const QVectorND nodeProgress = lattice.progress(node.state);
+                planningTrace(scheduleLog) << nodeProgress << node.cost;
+                solution->states.prepend(nodeProgress);
+                if (node.parent < 0)
+                    break;
+                solution->lastTasks.insert(nodeProgress, node.state.lastTask());
+                const ScheduleState& parent = nodes.at(node.parent).state;
+                solution->transitionFlights.insert(nodeProgress,
+                                                   _transitionFlightFor(lattice.progress(parent), parent.lastTask(),
+                                                                        node.state.lastTask()));
+            }
+            break;
+        }
+
+        //Find the possible transitions that the cheap checks don't rule out
+        QList<int> successors;
+
+        //A state that leaves some task no time to finish before its deadline leads nowhere
+        bool deadlineMissed = false;
+        for (int i = 0; i < progress.dimension() && !deadlineMissed; i++)
+        {
+            const qreal remaining = taskTimes[i] - progress[i];
+            deadlineMissed = remaining > 0.0 && stateCost + remaining > _latestFinishes.at(i);
+        }
+        if (deadlineMissed)
+        {
+            infeasibleCount++;
+            continue;
+        }
+
+        QVector<quint64> finished;
+        _finishedMask(progress, taskTimes, &finished);
+        for (int i = 0; i < progress.dimension(); i++)
+        {
+            //Only the tasks endState has further along. The rest are done or left to a later search.
+            if (progress[i] >= endState.val(i))
+                continue;
+            const ScheduleState newState = lattice.advance(state, i);
+            QVectorND newProgress = progress;
+            newProgress[i] = lattice.progress(newState, i);
+
+            //Constraints first: they're cheaper than anything below and need no transition flight
+            if (!_dependenciesMet(i, finished))
+            {
+                infeasibleCount++;
+                continue;
+            }
+
+            /*
+             * The slice can't start before its task's next window that's long enough. Carrying on with the same
+             * task means starting right now, and anything else means flying a transition first, so there's no
+             * use for a window that's already passed.
+            */
+            const qreal sliceTime = newProgress[i] - progress[i];
+            const qreal earliestStart = _taskWindows.at(i).nextFit(stateCost, sliceTime);
+            if (earliestStart == infinity || (state.lastTask() == i && earliestStart > stateCost))
+            {
+                infeasibleCount++;
+                continue;
+            }
+
+            //The slice takes at least its own length to fly, which may already be no better than what we have
+            const qreal lowerBound = earliestStart + sliceTime;
+            if (nodes.cost(newState) <= lowerBound)
+                continue;
+            if (!corridor.isEmpty() && !inScheduleCorridor(newProgress, corridor, corridorWidth))
+                continue;
+
+            //Likewise, don't plan a transition to a state that's dominated even at that lower bound
+            if (pruneDominated
+                    && isScheduleStateDominated(newState, lowerBound, fronts.value(newState.positionKey()), nodes))
+            {
+                dominatedCount++;
+                continue;
+            }
+            successors.append(i);
+        }
+
+        //Plan the transitions those need all at once, so _scheduleMove() finds them in the cache
+        if (_parallelScheduleExpansion && !_lazyTransitions)
+            _prefetchTransitions(state, stateCost, successors, nodes, lattice);
+
+        //Generate them
+        foreach(int i, successors)
+        {
+            const ScheduleState newState = lattice.advance(state, i);
+            QVectorND newProgress = progress;
+            newProgress[i] = lattice.progress(newState, i);
+
+            const qreal heuristic = _scheduleHeuristic(newProgress, i, endState);
+            const qreal knownCost = nodes.cost(newState);
+
+            //Queue a move whose transition we'd have to plan at an optimistic cost instead, and plan it later
+            if (_lazyTransitions && state.lastTask() >= 0 && state.lastTask() != i)
+            {
+                Position startPos;
+                UAVOrientation startPose;
+                Position endPos;
+                UAVOrientation endPose;
+                _transitionEndpoints(progress, state.lastTask(), i, &startPos, &startPose, &endPos, &endPose);
+                if (!_transitionCache.contains(startPos, startPose, endPos, endPose))
+                {
+                    const qreal optimisticCost = stateCost
+                            + IntermediatePlanner::dubinsCostEstimate(params, startPos, startPose, endPos, endPose)
+                            + newProgress[i] - progress[i];
+                    if (knownCost <= optimisticCost || optimisticCost + heuristic >= costToBeat)
+                        continue;
+
+                    LazyScheduleMove move;
+                    move.parent = index;
+                    move.parentCost = stateCost;
+                    move.task = i;
+                    lazyMoves.append(move);
+                    worklist.insert(optimisticCost + weight * heuristic, -lazyMoves.size());
+                    deferredCount++;
+                    continue;
+                }
+            }
+
+            qreal tentativeCostToMove;
+            QList<Position> transitionFlight;
+            if (!_scheduleMove(progress, state.lastTask(), stateCost, i, newProgress, taskTimes,
+                               knownCost, &tentativeCostToMove, &transitionFlight))
+                continue;
+
+            //Nothing through here can beat the best schedule we already have. The heuristic is admissible, so
+            //this holds whatever the weight.
+            if (tentativeCostToMove + heuristic >= costToBeat)
+                continue;
+
+            //If we have found a better way to reach a state then we'll replace the current information
+            if (knownCost <= tentativeCostToMove)
+                continue;
+
+            //newState's parent is state
+            openScheduleState(newState, index, tentativeCostToMove, tentativeCostToMove + weight * heuristic,
+                              pruneDominated, &nodes, &fronts, &worklist, &dominatedCount);
+        } // Done generating transitions
+
+        //Stay within the memory budget by turning into a beam search
+        if (!*memoryExhausted && _scheduleMemoryBudget > 0
+                && nodes.memoryBytes() + worklist.size() * openEntryBytes
+                + lazyMoves.size() * (qint64) sizeof(LazyScheduleMove) > _scheduleMemoryBudget)
+        {
+            planningDebug(scheduleLog) << "Schedule search reached its memory budget with" << nodes.size()
+                                       << "states, continuing as a beam search";
+            statistics->addToCounter("ScheduleMemoryBudgetHits");
+            *memoryExhausted = true;
+        }
+        if (*memoryExhausted)
+            worklist.truncate(SCHEDULE_BEAM_WIDTH);
+    } // Done building schedule
+    statistics->setCounter("ScheduleStatesExpanded", expandedBefore + expanded);
+    statistics->setCounter("ScheduleStatesDominated", dominatedBefore + dominatedCount);
+    statistics->setCounter("ScheduleOpenListSize", worklist.size());
+    statistics->addToCounter("ScheduleMovesInfeasible", infeasibleCount);
+    statistics->addToCounter("ScheduleMovesDeferred", deferredCount);
+
+    return solutionFound;
 }
 
-//protected
-//pure-virtual from FlightPlanner
-void HierarchicalPlanner::doStart()
+//private
+void HierarchicalPlanner::_flySchedule(const HierarchicalPlanner::ScheduleSolution &solution,
+                                       const QVectorND &startState)
 {
+    //Remember the order for the next warm start
+    _previousSchedule.clear();
+    for (int i = 1; i < solution.states.size(); i++)
+    {
+        //A coarse schedule's moves span several time slices
+        const int taskIndex = solution.lastTasks.value(solution.states.at(i));
+        const qreal moveTime = solution.states.at(i).val(taskIndex) - solution.states.at(i - 1).val(taskIndex);
+        const int slices = qMax<int>(1, ceil(moveTime / this->runTuning().scheduleTimeslice() - 1e-6));
+        for (int j = 0; j < slices; j++)
+            _previousSchedule.append(_tasks.value(taskIndex));
+    }
+
+    //Assembled contiguously and converted once, rather than appending list pieces waypoint by waypoint
+    FlightPath path;
+    QVector<int> ends;
+    if (_replanning)
+        path.append(_replanCommitted);
+    ends.append(path.size());
+    for (int i = 1; i < solution.states.size(); i++)
+    {
+        const QVectorND& prevInterval = solution.states.at(i - 1);
+        const QVectorND& interval = solution.states.at(i);
+        const int taskIndex = solution.lastTasks.value(interval);
+        if (prevInterval == startState)
+            path.append(_startTransitionFor(prevInterval, taskIndex));
+        else if (solution.lastTasks.value(prevInterval) != taskIndex)
+            path.append(solution.transitionFlights.value(interval));
+
+        //Add the portion of the sub-flight that we care about, straight from the sub-flight
+        const QList<Position>& subFlight = _taskSubFlights.at(taskIndex);
+        int first;
+        int end;
+        _getPathPortion(subFlight, prevInterval.val(taskIndex), interval.val(taskIndex), &first, &end);
+        path.append(subFlight, first, end - first);
+        ends.append(path.size());
+    }
+
+    //Remembered so that a replan can tell how far along each task the aircraft is
+    _publishedFlight = path.toList();
+    _publishedTasks = _tasks;
+    _publishedStates = solution.states;
+    _publishedEnds = ends;
+
+    if (this->setBestFlightSoFar(_publishedFlight))
+        this->workingStatistics()->addToCounter("SchedulesPublished");
+    else
+        this->workingStatistics()->addToCounter("SchedulesOffCommittedPrefix");
 }
 
-//protected
-//pure-virtual from FlightPlanner
-void HierarchicalPlanner::doIteration()
+//private
+void HierarchicalPlanner::_improveSchedule(HierarchicalPlanner::ScheduleSolution *solution)
 {
-    /*
-     * Decide on arbitrary start and end points for each task (except no-fly).
-     * They should be on edges of the polygon.
-    */
-    _buildStartAndEndPositions();
+    QList<qreal> taskTimes;
+    foreach(const QList<Position>& subFlight, _taskSubFlights)
+        taskTimes.append(_subFlightTime(subFlight));
+    const QVectorND startState = _scheduleStartState(taskTimes);
 
-    /*
-     * Calculate sub-flights from the global start point to each of the tasks' start points.
-     * Also calculate sub-flights from each task's end point to every other tasks' start point.
-    */
-    _buildStartTransitions();
+    QElapsedTimer budgetClock;
+    budgetClock.start();
 
-    /*
-     * Calculate ideal sub-flights for each task (except no-fly).
-     * These sub-flights start and end at the arbitrary start/end points of the tasks.
-    */
-    _buildSubFlights();
+    //Seeded from the problem's size so that reruns with the same seed try the same repairs
+    PlanningRandom random(this->randomSeed(), _tasks.size());
+    PlanningStatistics * statistics = this->workingStatistics();
+
+    QList<ScheduleSegment> segments = _scheduleSegments(*solution);
+    int stalls = 0;
+    while (stalls < IMPROVEMENT_MAX_STALLS && segments.size() > 1 && !this->planningInterrupted()
+           && budgetClock.elapsed() < _scheduleImprovementTimeBudget)
+    {
+        statistics->addToCounter("ScheduleImprovementRounds");
+
+        //Local search first: every Or-opt, 2-opt and switch-shift move of the current schedule
+        QList<QList<ScheduleSegment> > candidates;
+        _orOptMoves(segments, &candidates);
+        _twoOptMoves(segments, &candidates);
+        _switchShiftMoves(segments, this->runTuning().scheduleTimeslice(), &candidates);
+        if (_improveWith(candidates, taskTimes, startState, budgetClock, solution, &segments))
+        {
+            stalls = 0;
+            continue;
+        }
 
+        //At a local optimum. Tear bits out and put them back elsewhere to get out of it.
+        candidates.clear();
+        for (int i = 0; i < IMPROVEMENT_REPAIRS; i++)
+            candidates.append(_destroyAndRepair(segments, taskTimes, startState, &random));
+        if (_improveWith(candidates, taskTimes, startState, budgetClock, solution, &segments))
+            stalls = 0;
+        else
+            stalls++;
+    }
 
-    /*
-     * Build and solve scheduling problem.
-    */
-    if (!_buildSchedule())
-        qDebug() << "Scheduling failed";
-    this->pausePlanning();
+    _updateTransitionCacheCounters();
+    planningDebug(scheduleLog) << "Improved schedule has cost" << solution->cost;
 }
 
-//protected
-//pure-virtual from FlightPlanner
-void HierarchicalPlanner::doReset()
+//private
+bool HierarchicalPlanner::_improveWith(const QList<QList<ScheduleSegment> > &candidates,
+                                       const QList<qreal> &taskTimes,
+                                       const QVectorND &startState,
+                                       const QElapsedTimer &budgetClock,
+                                       HierarchicalPlanner::ScheduleSolution *solution,
+                                       QList<ScheduleSegment> *segments)
 {
-    _tasks.clear();
-    _tasks2areas.clear();
-    _areaStartPositions.clear();
-    _areaStartOrientations.clear();
-    _taskSubFlights.clear();
-    _startTransitionSubFlights.clear();
-    _obstacles.clear();
+    //Rank the candidates by how short they could possibly be, dropping the ones that can't beat what we have
+    QList<QPair<qreal, int> > ranked;
+    for (int i = 0; i < candidates.size(); i++)
+    {
+        const qreal bound = _segmentsLowerBound(candidates.at(i), taskTimes, startState);
+        if (bound < solution->cost - IMPROVEMENT_EPSILON)
+            ranked.append(qMakePair(bound, i));
+    }
+    std::sort(ranked.begin(), ranked.end());
+    while (ranked.size() > IMPROVEMENT_BATCH)
+        ranked.removeLast();
+    this->workingStatistics()->addToCounter("ScheduleImprovementCandidates", ranked.size());
+    if (ranked.isEmpty())
+        return false;
 
-    if (this->problem().isNull())
-        return;
+    //Plan the transitions the batch needs all at once, so flying the candidates only hits the cache
+    QList<QList<ScheduleSegment> > batch;
+    for (int i = 0; i < ranked.size(); i++)
+        batch.append(candidates.at(ranked.at(i).second));
+    _prefetchSegmentTransitions(batch, taskTimes, startState);
+
+    int bestCandidate = -1;
+    ScheduleSolution best;
+    best.cost = solution->cost - IMPROVEMENT_EPSILON;
+    for (int i = 0; i < batch.size(); i++)
+    {
+        if (this->planningInterrupted() || budgetClock.elapsed() >= _scheduleImprovementTimeBudget)
+            break;
 
-    //Fill in list of tasks and mapping of tasks to areas
-    foreach(const QSharedPointer<FlightTaskArea>& area, this->problem()->areas())
+        //The rest are ranked no better, so they can't beat this one by much
+        if (ranked.at(i).first >= best.cost)
+            break;
+
+        ScheduleSolution flown;
+        if (_flySegments(batch.at(i), taskTimes, startState, best.cost, &flown))
+        {
+            best = flown;
+            bestCandidate = i;
+        }
+    }
+    if (bestCandidate < 0)
+        return false;
+
+    planningDebug(scheduleLog) << "Schedule improvement cut cost from" << solution->cost << "to" << best.cost;
+    *solution = best;
+    *segments = batch.at(bestCandidate);
+    this->workingStatistics()->addToCounter("ScheduleImprovements");
+    _flySchedule(*solution, startState);
+    return true;
+}
+
+//private
+QList<HierarchicalPlanner::ScheduleSegment> HierarchicalPlanner::_scheduleSegments(const HierarchicalPlanner::ScheduleSolution &solution) const
+{
+    QList<ScheduleSegment> toRet;
+    for (int i = 1; i < solution.states.size(); i++)
     {
-        foreach(const QSharedPointer<FlightTask>& task, area->tasks())
+        const int task = solution.lastTasks.value(solution.states.at(i));
+        const qreal duration = solution.states.at(i).val(task) - solution.states.at(i - 1).val(task);
+        if (!toRet.isEmpty() && toRet.last().task == task)
+            toRet.last().duration += duration;
+        else
         {
-            //We treat obstacles separately in the hierarchical planner. Not as tasks.
-            if (task->taskType() == "No-Fly Zone")
-                _obstacles.append(area->geoPoly());
-            else
-            {
-                _tasks.append(task);
-                _tasks2areas.insert(task, area);
-            }
+            ScheduleSegment segment;
+            segment.task = task;
+            segment.duration = duration;
+            toRet.append(segment);
         }
     }
+    return toRet;
 }
 
 //private
-void HierarchicalPlanner::_buildStartAndEndPositions()
+QList<QVectorND> HierarchicalPlanner::_segmentStates(const QList<ScheduleSegment> &segments,
+                                                     const QList<qreal> &taskTimes,
+                                                     const QVectorND &startState) const
 {
-    //First calculate the average of all of the task area's midpoints
-    //(Or at least an approximation based on their bounding rectangles...)
-    QPointF avgLonLat(0.0,0.0);
-    foreach(const QSharedPointer<FlightTaskArea>& area, _tasks2areas.values())
-        avgLonLat += area->geoPoly().boundingRect().center();
-    avgLonLat += this->problem()->startingPosition().lonLat();
-    if (_tasks2areas.values().size() > 0)
-        avgLonLat /= (_tasks2areas.values().size() + 1);
-
-    //Then loop through all of the areas and find good points that could be start or end
-    //Make the start point the one that is closest to the average computed above
-    const qreal divisions = 100;
-    foreach(const QSharedPointer<FlightTaskArea>& area, _tasks2areas.values())
+    //Moving segments around adds their durations up in a different order, so snap finished tasks to their end
+    QList<QVectorND> toRet;
+    QVectorND state = startState;
+    toRet.append(state);
+    foreach(const ScheduleSegment& segment, segments)
     {
-        const QRectF boundingRect = area->geoPoly().boundingRect();
-        const QPointF centerLonLat = boundingRect.center();
-        avgLonLat += centerLonLat;
+        const int i = segment.task;
+        state[i] = qMin<qreal>(taskTimes.at(i), state[i] + segment.duration);
+        if (taskTimes.at(i) - state[i] < 1e-6)
+            state[i] = taskTimes.at(i);
+        toRet.append(state);
+    }
+    return toRet;
+}
 
-        qreal mostDistance = std::numeric_limits<qreal>::min();
-        QPointF bestPoint1;
-        QPointF bestPoint2;
-        for (int angleDeg = 0; angleDeg < 179; angleDeg++)
+//private
+qreal HierarchicalPlanner::_segmentsLowerBound(const QList<ScheduleSegment> &segments,
+                                               const QList<qreal> &taskTimes,
+                                               const QVectorND &startState) const
+{
+    if (segments.isEmpty())
+        return 0.0;
+
+    const UAVParameters& params = this->problem()->uavParameters();
+    const QList<QVectorND> states = _segmentStates(segments, taskTimes, startState);
+
+    /*
+     * The start transition is known exactly, unless the first task was started before a replan (then it's
+     * planned when the schedule is flown). Every other transition takes at least its Dubins path.
+    */
+    const int firstTask = segments.first().task;
+    qreal toRet = _replanStartTime;
+    if (startState.val(firstTask) > 0.0)
+    {
+        Position endPos;
+        UAVOrientation endPose;
+        _interpolatePath(_taskSubFlights.at(firstTask), _areaStartOrientations.at(_taskAreas.at(firstTask)),
+                         startState.val(firstTask), &endPos, &endPose);
+        toRet += qMax<qreal>(0.0, IntermediatePlanner::dubinsCostEstimate(params, _startPosition(),
+                                                                          _startOrientation(), endPos, endPose));
+    }
+    else
+        toRet += _subFlightTime(_startTransitionSubFlights.at(_taskAreas.at(firstTask)));
+    for (int k = 0; k < segments.size(); k++)
+    {
+        const int i = segments.at(k).task;
+        toRet += states.at(k + 1).val(i) - states.at(k).val(i);
+        if (k == 0 || segments.at(k - 1).task == i)
+            continue;
+
+        Position startPos;
+        UAVOrientation startPose;
+        Position endPos;
+        UAVOrientation endPose;
+        _transitionEndpoints(states.at(k), segments.at(k - 1).task, i, &startPos, &startPose, &endPos, &endPose);
+        toRet += qMax<qreal>(0.0, IntermediatePlanner::dubinsCostEstimate(params, startPos, startPose,
+                                                                          endPos, endPose));
+    }
+    return toRet;
+}
+
+//private
+bool HierarchicalPlanner::_flySegments(const QList<ScheduleSegment> &segments,
+                                       const QList<qreal> &taskTimes,
+                                       const QVectorND &startState,
+                                       qreal costToBeat,
+                                       HierarchicalPlanner::ScheduleSolution *solution)
+{
+    const QList<QVectorND> states = _segmentStates(segments, taskTimes, startState);
+    if (states.last() != QVectorND(taskTimes))
+        return false;
+
+    ScheduleSolution toRet;
+    toRet.states.append(startState);
+    qreal cost = _replanStartTime;
+    int lastTask = -1;
+    for (int k = 0; k < segments.size(); k++)
+    {
+        const int i = segments.at(k).task;
+        const QVectorND& state = states.at(k);
+        const QVectorND& newState = states.at(k + 1);
+        if (newState == state)
+            continue;
+
+        //Costs only grow along the schedule, so a prefix that can't beat costToBeat is the end of it
+        qreal newCost;
+        QList<Position> transitionFlight;
+        if (!_scheduleMove(state, lastTask, cost, i, newState, taskTimes, costToBeat, &newCost, &transitionFlight)
+                || newCost >= costToBeat)
+            return false;
+
+        toRet.states.append(newState);
+        toRet.lastTasks.insert(newState, i);
+        toRet.transitionFlights.insert(newState, transitionFlight);
+        cost = newCost;
+        lastTask = i;
+    }
+
+    toRet.cost = cost;
+    *solution = toRet;
+    return true;
+}
+
+//private
+void HierarchicalPlanner::_prefetchSegmentTransitions(const QList<QList<ScheduleSegment> > &candidates,
+                                                      const QList<qreal> &taskTimes,
+                                                      const QVectorND &startState)
+{
+    const UAVParameters& params = this->problem()->uavParameters();
+
+    //Candidates are mostly the same schedule, so most of their transitions are shared or already cached
+    QList<QRunnable *> jobs;
+    QSet<QVectorND> queued;
+    foreach(const QList<ScheduleSegment>& segments, candidates)
+    {
+        const QList<QVectorND> states = _segmentStates(segments, taskTimes, startState);
+        for (int k = 1; k < segments.size(); k++)
         {
-            bool gotPos = false;
-            bool gotNeg = false;
+            const int lastTask = segments.at(k - 1).task;
+            const int i = segments.at(k).task;
+            if (lastTask == i)
+                continue;
 
-            const qreal stepSize = qMax<qreal>(boundingRect.width() / divisions,
-                                               boundingRect.height() / divisions);
-            const QVector2D dirVec(cos(angleDeg * 180.0 / 3.14159265),
-                                   sin(angleDeg * 180.0 / 3.14159265));
+            //The state and the two tasks fix the endpoints
+            QList<qreal> keyValues = states.at(k).values().toList();
+            keyValues << lastTask << i;
+            const QVectorND key(keyValues);
+            if (queued.contains(key))
+                continue;
 
-            int count = 0;
-            QPointF pos;
-            QPointF neg;
-            while (!gotPos || !gotNeg)
-            {
-                const QPointF trialPointPos(centerLonLat.x() + dirVec.x() * stepSize * count,
-                                            centerLonLat.y() + dirVec.y() * stepSize * count);
-                const QPointF trialPointNeg(centerLonLat.x() - dirVec.x() * stepSize * count,
-                                            centerLonLat.y() - dirVec.y() * stepSize * count);
+            Position startPos;
+            UAVOrientation startPose;
+            Position endPos;
+            UAVOrientation endPose;
+            _transitionEndpoints(states.at(k), lastTask, i, &startPos, &startPose, &endPos, &endPose);
+            if (_transitionCache.contains(startPos, startPose, endPos, endPose))
+                continue;
+            queued.insert(key);
+
+            TransitionPlanningJob * job = new TransitionPlanningJob(params,
+                                                                    startPos, startPose,
+                                                                    endPos, endPose,
+                                                                    _obstacles,
+                                                                    _obstacleMap,
+                                                                    _roadmap,
+                                                                    _visibilityGraph);
+            job->setRandomSeed(this->randomSeed());
+            job->setStrategy(_transitionStrategy);
+            job->setPlanningContext(this->planningContext());
+            job->setTerrain(_terrainModel, this->_maxTerrainElevation());
+            job->setTuning(this->runTuning());
+            jobs.append(job);
+        }
+    }
 
-                if (!area->geoPoly().containsPoint(trialPointPos, Qt::OddEvenFill)
-                        && !gotPos)
-                {
-                    pos = trialPointPos;
-                    gotPos = true;
-                }
+    if (jobs.isEmpty())
+        return;
+    _runJobs(jobs, "TransitionPrefetch", JobSystem::LowPriority);
 
-                if (!area->geoPoly().containsPoint(trialPointNeg, Qt::OddEvenFill)
-                        && !gotNeg)
-                {
-                    neg = trialPointNeg;
-                    gotNeg = true;
-                }
-                count++;
+    //Backwards, like _prefetchTransitions(), so that the first of two near-identical transitions is the one kept
+    const bool interrupted = this->planningInterrupted();
+    for (int j = jobs.size() - 1; j >= 0; j--)
+    {
+        TransitionPlanningJob * job = static_cast<TransitionPlanningJob *>(jobs.at(j));
+        if (!interrupted)
+            _transitionCache.insert(job->startPos(), job->startPose(),
+                                    job->endPos(), job->endPose(),
+                                    job->results());
+        delete job;
+    }
+    this->workingStatistics()->addToCounter("TransitionsPlanned", jobs.size());
+    this->workingStatistics()->addToCounter("TransitionsPlannedInParallel", jobs.size());
+}
+
+//private
+QList<HierarchicalPlanner::ScheduleSegment> HierarchicalPlanner::_destroyAndRepair(const QList<ScheduleSegment> &segments,
+                                                                                   const QList<qreal> &taskTimes,
+                                                                                   const QVectorND &startState,
+                                                                                   PlanningRandom *random) const
+{
+    //Destroy: take out a few segments, either a contiguous stretch of the schedule or scattered ones
+    QList<ScheduleSegment> toRet = segments;
+    QList<ScheduleSegment> removed;
+    const int count = qMin<int>(toRet.size() - 1, 2 + (int) random->bounded(3));
+    if (random->bounded(2) == 0)
+    {
+        const int first = random->bounded(toRet.size() - count + 1);
+        for (int i = 0; i < count; i++)
+            removed.append(toRet.takeAt(first));
+    }
+    else
+    {
+        for (int i = 0; i < count; i++)
+            removed.append(toRet.takeAt(random->bounded(toRet.size())));
+    }
+
+    //Repair: put them back one at a time, in random order, wherever they look cheapest
+    while (!removed.isEmpty())
+    {
+        const ScheduleSegment segment = removed.takeAt(random->bounded(removed.size()));
+        int bestPosition = 0;
+        qreal bestBound = std::numeric_limits<qreal>::max();
+        for (int position = 0; position <= toRet.size(); position++)
+        {
+            QList<ScheduleSegment> trial = toRet;
+            trial.insert(position, segment);
+            const qreal bound = _segmentsLowerBound(trial, taskTimes, startState);
+            if (bound < bestBound)
+            {
+                bestBound = bound;
+                bestPosition = position;
             }
+        }
+        toRet.insert(bestPosition, segment);
+    }
+
+    _normalizeSegments(&toRet);
+    return toRet;
+}
+
+//private static
+void HierarchicalPlanner::_normalizeSegments(QList<ScheduleSegment> *segments)
+{
+    //Drop emptied segments and merge neighbors of the same task, which are really one segment
+    for (int i = segments->size() - 1; i >= 0; i--)
+    {
+        if (segments->at(i).duration <= 1e-9)
+            segments->removeAt(i);
+        else if (i + 1 < segments->size() && segments->at(i + 1).task == segments->at(i).task)
+        {
+            (*segments)[i].duration += segments->at(i + 1).duration;
+            segments->removeAt(i + 1);
+        }
+    }
+}
+
+//private static
+void HierarchicalPlanner::_orOptMoves(const QList<ScheduleSegment> &segments,
+                                      QList<QList<ScheduleSegment> > *output)
+{
+    //Move every run of up to three segments to every other place in the schedule
+    for (int length = 1; length <= 3 && length < segments.size(); length++)
+    {
+        for (int first = 0; first + length <= segments.size(); first++)
+        {
+            QList<ScheduleSegment> rest = segments;
+            QList<ScheduleSegment> block;
+            for (int i = 0; i < length; i++)
+                block.append(rest.takeAt(first));
 
-            const QVector3D xyz1 = Conversions::lla2xyz(Position(pos));
-            const QVector3D xyz2 = Conversions::lla2xyz(Position(neg));
-            const qreal distance = (xyz1 - xyz2).lengthSquared();
-            if (distance > mostDistance)
+            for (int position = 0; position <= rest.size(); position++)
             {
-                mostDistance = distance;
-                bestPoint1 = pos;
-                bestPoint2 = neg;
+                if (position == first)
+                    continue;
+                QList<ScheduleSegment> moved = rest;
+                for (int i = 0; i < length; i++)
+                    moved.insert(position + i, block.at(i));
+                _normalizeSegments(&moved);
+                output->append(moved);
             }
         }
+    }
+}
 
-        Position start;
-        Position end;
-
-        //The point closest to all the other areas will be the start
-        start = bestPoint2;
-        end = bestPoint1;
-        if ((bestPoint1 - avgLonLat).manhattanLength() < (bestPoint2 - avgLonLat).manhattanLength())
+//private static
+void HierarchicalPlanner::_twoOptMoves(const QList<ScheduleSegment> &segments,
+                                       QList<QList<ScheduleSegment> > *output)
+{
+    //Fly every stretch of three or more segments in reverse. (Reversing two is an Or-opt move.)
+    for (int first = 0; first < segments.size(); first++)
+    {
+        for (int last = first + 2; last < segments.size(); last++)
         {
-            start = bestPoint1;
-            end = bestPoint2;
+            QList<ScheduleSegment> reversed = segments;
+            for (int i = first, j = last; i < j; i++, j--)
+                reversed.swap(i, j);
+            _normalizeSegments(&reversed);
+            output->append(reversed);
         }
-
-        _areaStartPositions.insert(area, start);
-
-        qreal angleRads = atan2(end.latitude() - start.latitude(),
-                                end.longitude() - start.longitude());
-        UAVOrientation orientation(angleRads);
-        _areaStartOrientations.insert(area, orientation);
     }
 }
 
-//private
-void HierarchicalPlanner::_buildStartTransitions()
+//private static
+void HierarchicalPlanner::_switchShiftMoves(const QList<ScheduleSegment> &segments,
+                                            qreal timeslice,
+                                            QList<QList<ScheduleSegment> > *output)
 {
-    const Position& globalStartPos = this->problem()->startingPosition();
-    const UAVOrientation& globalStartPose = this->problem()->startingOrientation();
-
-    foreach(const QSharedPointer<FlightTask>& task, _tasks)
+    //Move one time slice of a task between each of its segments and the next, in both directions
+    for (int a = 0; a < segments.size(); a++)
     {
-        const QSharedPointer<FlightTaskArea>& area = _tasks2areas.value(task);
-        if (_startTransitionSubFlights.contains(area))
+        int b = a + 1;
+        while (b < segments.size() && segments.at(b).task != segments.at(a).task)
+            b++;
+        if (b == segments.size())
             continue;
-        const Position& taskStartPos = _areaStartPositions.value(area);
-        const UAVOrientation& taskStartPose = _areaStartOrientations.value(area);
 
-        QList<Position> subFlight = _generateTransitionFlight(globalStartPos,
-                                                              globalStartPose,
-                                                              taskStartPos,
-                                                              taskStartPose);
-
-        _startTransitionSubFlights.insert(area, subFlight);
+        for (int direction = 0; direction < 2; direction++)
+        {
+            const int from = direction == 0 ? a : b;
+            const int to = direction == 0 ? b : a;
+            QList<ScheduleSegment> shifted = segments;
+            const qreal delta = qMin<qreal>(timeslice, shifted.at(from).duration);
+            shifted[from].duration -= delta;
+            shifted[to].duration += delta;
+            _normalizeSegments(&shifted);
+            output->append(shifted);
+        }
     }
 }
 
 //private
-void HierarchicalPlanner::_buildSubFlights()
+void HierarchicalPlanner::_buildTransitionBounds()
 {
-    foreach(const QSharedPointer<FlightTask>& task, _tasks)
-    {
-        const QSharedPointer<FlightTaskArea>& area = _tasks2areas.value(task);
-        const Position& start = _areaStartPositions.value(area);
-        const UAVOrientation& startPose = _areaStartOrientations.value(area);
-
-        qDebug() << "Build sub-flight for" << task.data() << area.data() << start << startPose;
+    const UAVParameters& params = this->problem()->uavParameters();
+    const Position startPos = _startPosition();
 
-        SubFlightPlanner planner(this->problem()->uavParameters(), task, area, start, startPose);
-        planner.plan();
+    //Where each task's sub-flight goes, as a box in meters around the starting position. The starting position is last.
+    QList<QRectF> boxes;
+    foreach(const QList<Position>& subFlight, _taskSubFlights)
+    {
+        //QRectF::united() ignores empty rectangles, which single points are, so grow the box by hand
+        qreal left = 0.0, right = 0.0, top = 0.0, bottom = 0.0;
+        bool first = true;
+        foreach(const Position& pos, subFlight)
+        {
+            const QVector3D enu = Conversions::lla2enu(pos, startPos);
+            left = first ? enu.x() : qMin<qreal>(left, enu.x());
+            right = first ? enu.x() : qMax<qreal>(right, enu.x());
+            top = first ? enu.y() : qMin<qreal>(top, enu.y());
+            bottom = first ? enu.y() : qMax<qreal>(bottom, enu.y());
+            first = false;
+        }
+        boxes.append(QRectF(QPointF(left, top), QPointF(right, bottom)));
+    }
+    boxes.append(QRectF(0.0, 0.0, 0.0, 0.0));
 
-        _taskSubFlights.insert(task, planner.results());
+    /*
+     * Flying from anywhere in one box to anywhere in another takes at least the gap between them. Transition
+     * flights are timed by their waypoint count, and the first waypoint is already one interval along, so we
+     * take an interval off to stay on the safe side.
+    */
+    const int count = boxes.size();
+    _transitionBounds.fill(0.0, count * count);
+    for (int a = 0; a < count; a++)
+    {
+        for (int b = a + 1; b < count; b++)
+        {
+            const QRectF& boxA = boxes.at(a);
+            const QRectF& boxB = boxes.at(b);
+            const qreal dx = qMax<qreal>(0.0, qMax<qreal>(boxA.left() - boxB.right(), boxB.left() - boxA.right()));
+            const qreal dy = qMax<qreal>(0.0, qMax<qreal>(boxA.top() - boxB.bottom(), boxB.top() - boxA.bottom()));
+            const qreal gap = qMax<qreal>(0.0, sqrt(dx * dx + dy * dy) - params.waypointInterval());
+            _transitionBounds[a * count + b] = gap / params.airspeed();
+            _transitionBounds[b * count + a] = gap / params.airspeed();
+        }
     }
 }
 
 //private
-bool HierarchicalPlanner::_buildSchedule()
+qreal HierarchicalPlanner::_scheduleHeuristic(const QVectorND &progress, int lastTask, const QVectorND &endState) const
 {
-    const UAVParameters& params = this->problem()->uavParameters();
+    //All of the remaining task time has to be flown...
+    const qreal remainingTime = endState.manhattanDistanceTo(progress);
 
-    //First we need to know how long each of our sub-flights takes
-    QList<qreal> taskTimes;
-    foreach(const QSharedPointer<FlightTask>& task, _tasks)
+    /*
+     * ...and so does a transition into every unfinished task we're not already on. Whatever order they come in,
+     * those transitions connect where we are to all of those tasks, so they take at least as long as a minimum
+     * spanning tree over them (Prim's, on the bounds from _buildTransitionBounds()).
+    */
+    const int count = _tasks.size() + 1;
+    QList<int> nodes;
+    nodes.append(lastTask < 0 ? _tasks.size() : lastTask);
+    for (int i = 0; i < progress.dimension(); i++)
     {
-        const QList<Position>& subFlight = _taskSubFlights.value(task);
-
-        //Time required is estimated to be the length of the path in meters divided by airspeed
-        qreal timeRequired = subFlight.length() * params.waypointInterval() / params.airspeed();
-        taskTimes.append(timeRequired);
+        if (i != lastTask && progress.val(i) < endState.val(i))
+            nodes.append(i);
     }
+    if (nodes.size() < 2 || _transitionBounds.size() != count * count)
+        return remainingTime;
+
+    const qreal infinity = std::numeric_limits<qreal>::max();
+    QVector<qreal> distances(nodes.size(), infinity);
+    QVector<bool> inTree(nodes.size(), false);
+    distances[0] = 0.0;
+    qreal treeTime = 0.0;
+    for (int added = 0; added < nodes.size(); added++)
+    {
+        int next = -1;
+        for (int j = 0; j < nodes.size(); j++)
+        {
+            if (!inTree.at(j) && (next < 0 || distances.at(j) < distances.at(next)))
+                next = j;
+        }
+        inTree[next] = true;
+        treeTime += distances.at(next);
 
-    //start and end states
-    const QVectorND startState(_tasks.size());
-    const QVectorND endState(taskTimes);
-
-    qDebug() << "Schedule from" << startState << "to" << endState;
+        const qreal * row = _transitionBounds.constData() + nodes.at(next) * count;
+        for (int j = 0; j < nodes.size(); j++)
+        {
+            if (!inTree.at(j))
+                distances[j] = qMin<qreal>(distances.at(j), row[nodes.at(j)]);
+        }
+    }
 
-    //This hash stores child:parent relationships
-    QHash<QVectorND, QVectorND> parents;
+    return remainingTime + treeTime;
+}
 
-    //This hash stores node:(index of last task) relationships
-    QHash<QVectorND, int> lastTasks;
+//private
+QList<QVectorND> HierarchicalPlanner::_scheduleCorners(const HierarchicalPlanner::ScheduleSolution &solution) const
+{
+    //Between two task switches only one task progresses, so the schedule is straight lines between these
+    QList<QVectorND> toRet;
+    for (int i = 0; i < solution.states.size(); i++)
+    {
+        const QVectorND& state = solution.states.at(i);
+        if (i == 0 || i == solution.states.size() - 1
+                || solution.lastTasks.value(state) != solution.lastTasks.value(solution.states.at(i + 1)))
+            toRet.append(state);
+    }
+    return toRet;
+}
 
-    //This hash stores node:(transition flight to reach node) relationships
-    QHash<QVectorND, QList<Position> > transitionFlights;
+//private
+bool HierarchicalPlanner::_hasTimingConstraints() const
+{
+    foreach(int id, _taskIds)
+    {
+        if (!_compiled->task(id).timingWindows.isEmpty())
+            return true;
+    }
+    return false;
+}
 
-    QHash<QVectorND, qreal> actualCosts;
+//private
+bool HierarchicalPlanner::_buildConstraints(const QList<qreal> &taskTimes)
+{
+    const int count = _taskIds.size();
 
-    QMultiMap<qreal, QVectorND> worklist;
-    QSet<QVectorND> closedSet;
-    worklist.insert((startState - endState).manhattanDistance(), startState);
-    actualCosts.insert(startState, 0);
+    //One bit per task that has to be finished first
+    _maskWords = (count + 63) / 64;
+    _predecessorMasks.fill(0, count * _maskWords);
+    for (int i = 0; i < count; i++)
+    {
+        foreach(int index, _taskDependencies.at(i))
+            _predecessorMasks[i * _maskWords + index / 64] |= (Q_UINT64_C(1) << (index % 64));
+    }
 
-    QList<QVectorND> schedule;
+    //Every slice of a task has to lie inside one of its windows, so the task fits between the first and the last
+    bool feasible = true;
+    _taskWindows.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        _taskWindows[i].build(_compiled->task(_taskIds.at(i)).timingWindows);
+        if (_taskWindows.at(i).earliestStart() + taskTimes.at(i) > _taskWindows.at(i).latestEnd())
+            feasible = false;
+    }
 
-    bool solutionFound = false;
-    while (!worklist.isEmpty())
+    /*
+     * A task can't start until everything it depends on is finished, and has to finish early enough for the tasks
+     * that depend on it to fit before their deadlines. Relax both until nothing changes; a dependency cycle
+     * never settles, and can't be scheduled anyway.
+    */
+    QVector<qreal> earliestFinishes(count);
+    _latestFinishes.resize(count);
+    for (int i = 0; i < count; i++)
     {
-        const qreal costKey = worklist.keys().first();
-        const QVectorND state = worklist.value(costKey);
-        worklist.remove(costKey, state);
-        closedSet.insert(state);
+        earliestFinishes[i] = _taskWindows.at(i).earliestStart() + taskTimes.at(i);
+        _latestFinishes[i] = _taskWindows.at(i).latestEnd();
+    }
 
-        //qDebug() << "At:" << state << "with cost" << costKey;
+    bool changed = true;
+    for (int pass = 0; changed && feasible; pass++)
+    {
+        if (pass > count)
+        {
+            feasible = false;
+            break;
+        }
 
-        if (state == endState)
+        changed = false;
+        for (int i = 0; i < count; i++)
         {
-            qDebug() << "Done scheduling - traceback.";
-            solutionFound = true;
-            QVectorND current = state;
-            while (true)
+            foreach(int index, _taskDependencies.at(i))
             {
-                qDebug() << current << actualCosts.value(current);
-                schedule.prepend(current);
-                if (!parents.contains(current))
-                    break;
-                current = parents.value(current);
+                const qreal earliest = earliestFinishes.at(index) + taskTimes.at(i);
+                if (earliest > earliestFinishes.at(i))
+                {
+                    earliestFinishes[i] = earliest;
+                    changed = true;
+                }
+
+                const qreal latest = _latestFinishes.at(i) - taskTimes.at(i);
+                if (latest < _latestFinishes.at(index))
+                {
+                    _latestFinishes[index] = latest;
+                    changed = true;
+                }
             }
-            break;
         }
 
-        //Generate possible transitions
-        for (int i = 0; i < state.dimension(); i++)
+        for (int i = 0; i < count; i++)
         {
-            QVectorND newState = state;
-            newState[i] = qMin<qreal>(taskTimes[i], newState[i] + TIMESLICE);
-            if (newState[i] == state[i])
-                continue;
-            if (closedSet.contains(newState))
-                continue;
+            if (earliestFinishes.at(i) > _latestFinishes.at(i))
+                feasible = false;
+        }
+    }
 
-            const QSharedPointer<FlightTask>& task = _tasks.value(i);
-            const QSharedPointer<FlightTaskArea>& area = _tasks2areas.value(task);
+    return feasible;
+}
 
-            //The time at which the subflight flying begins and ends.
-            qreal startTime;
-            qreal endTime;
+//private
+void HierarchicalPlanner::_finishedMask(const QVectorND &state,
+                                        const QList<qreal> &taskTimes,
+                                        QVector<quint64> *mask) const
+{
+    mask->fill(0, _maskWords);
+    for (int i = 0; i < taskTimes.size(); i++)
+    {
+        if (state.val(i) >= taskTimes.at(i))
+            (*mask)[i / 64] |= (Q_UINT64_C(1) << (i % 64));
+    }
+}
 
-            QList<Position> transitionFlight;
+//private
+bool HierarchicalPlanner::_dependenciesMet(int i, const QVector<quint64> &finished) const
+{
+    const quint64 * predecessors = _predecessorMasks.constData() + i * _maskWords;
+    for (int word = 0; word < _maskWords; word++)
+    {
+        if (predecessors[word] & ~finished.at(word))
+            return false;
+    }
+    return true;
+}
 
-            /*
-             * The heuristic is the amount of time to fly all remaining tasks assuming no-cost
-             * transitions and no obstacles.
-             */
-            qreal heuristic = (endState - newState).manhattanDistance();
-            if (!lastTasks.contains(state))
-                transitionFlight = _startTransitionSubFlights.value(area);
-            else if (lastTasks.value(state) == i)
-            {
-                //Nothing to do here?
-            }
-            else
-            {
-                //The task we're coming from and the task we're going to
-                const QSharedPointer<FlightTask>& prevTask = _tasks.value(lastTasks.value(state));
-                const QSharedPointer<FlightTaskArea>& prevArea = _tasks2areas.value(prevTask);
+//private
+bool HierarchicalPlanner::_scheduleBudgetExhausted(const QElapsedTimer &budgetClock) const
+{
+    return _scheduleTimeBudget > 0 && budgetClock.elapsed() >= _scheduleTimeBudget;
+}
 
-                //Get current position and pose
-                Position startPos;
-                UAVOrientation startPose;
-                _interpolatePath(_taskSubFlights.value(prevTask),
-                                 _areaStartOrientations.value(prevArea),
-                                 state[_tasks.indexOf(prevTask)],
-                        &startPos,
-                        &startPose);
+//private
+void HierarchicalPlanner::_transitionEndpoints(const QVectorND &state,
+                                               int lastTask,
+                                               int i,
+                                               Position *startPos,
+                                               UAVOrientation *startPose,
+                                               Position *endPos,
+                                               UAVOrientation *endPose) const
+{
+    //Get current position and pose
+    _interpolatePath(_taskSubFlights.at(lastTask),
+                     _areaStartOrientations.at(_taskAreas.at(lastTask)),
+                     state[lastTask],
+                     startPos,
+                     startPose);
+
+    //Get position/pose of context switch destination
+    _interpolatePath(_taskSubFlights.at(i),
+                     _areaStartOrientations.at(_taskAreas.at(i)),
+                     state[i],
+                     endPos,
+                     endPose);
+}
 
-                //Get position/pose of context switch destination
-                Position endPos;
-                UAVOrientation endPose;
-                _interpolatePath(_taskSubFlights.value(task),
-                                 _areaStartOrientations.value(area),
-                                 state[i],
-                                 &endPos,
-                                 &endPose);
-
-                //Plan intermediate flight
-                transitionFlight = _generateTransitionFlight(startPos, startPose,
-                                                             endPos, endPose);
-            }
+//private
+void HierarchicalPlanner::_prefetchTransitions(const ScheduleState &state,
+                                               qreal stateCost,
+                                               const QList<int> &successors,
+                                               const ScheduleNodeTable &nodes,
+                                               const ScheduleLattice &lattice)
+{
+    const UAVParameters& params = this->problem()->uavParameters();
 
-            //The time (if any) needed to fly the transition flight to this task
-            const qreal transitionTime = transitionFlight.length() * params.waypointInterval() / params.airspeed();
-            startTime = actualCosts.value(state) + transitionTime;
-            endTime = startTime + newState[i] - state[i];
-            const qreal tentativeCostToMove = actualCosts.value(state) + endTime - actualCosts.value(state);
+    //The same checks _scheduleMove() makes before it plans a transition, so we don't plan any it wouldn't
+    QList<QRunnable *> jobs;
+    foreach(int i, successors)
+    {
+        if (state.lastTask() < 0 || state.lastTask() == i)
+            continue;
 
-            //Check dependency constraints
-            bool dependencyViolation = false;
-            foreach(const QWeakPointer<FlightTask> wConstraint, task->dependencyConstraints())
-            {
-                QSharedPointer<FlightTask> constraint = wConstraint.toStrongRef();
-                if (constraint.isNull())
-                    continue;
-                int index = _tasks.indexOf(constraint);
-                if (index == -1)
-                    continue;
-                if (state.val(index) < taskTimes.at(index))
-                {
-                    dependencyViolation = true;
-                    break;
-                }
-            }
-            if (dependencyViolation)
-                continue;
+        const ScheduleState newState = lattice.advance(state, i);
 
-            //If the newstate violates timing constraints then we won't generate it
-            bool timingViolation = false;
-            foreach(const TimingConstraint& constraint, task->timingConstraints())
-            {
-                if (startTime < constraint.start() || startTime > constraint.end())
-                    timingViolation = true;
-                else if (endTime < constraint.start() || endTime > constraint.end())
-                    timingViolation = true;
-                if (timingViolation)
-                    break;
-            }
-            if (timingViolation)
-                continue;
+        Position startPos;
+        UAVOrientation startPose;
+        Position endPos;
+        UAVOrientation endPose;
+        _transitionEndpoints(lattice.progress(state), state.lastTask(), i, &startPos, &startPose, &endPos, &endPose);
 
-            //If we have found a better way to reach a state then we'll replace the current information
-            if (!actualCosts.contains(newState) || actualCosts.value(newState) > tentativeCostToMove)
-            {
-                //newState's parent is state
-                parents.insert(newState, state);
+        const qreal optimisticCost = stateCost
+                + IntermediatePlanner::dubinsCostEstimate(params, startPos, startPose, endPos, endPose)
+                + lattice.progress(newState, i) - lattice.progress(state, i);
+        if (nodes.cost(newState) <= optimisticCost)
+            continue;
+        if (_transitionCache.contains(startPos, startPose, endPos, endPose))
+            continue;
 
-                actualCosts.insert(newState, tentativeCostToMove);
-                lastTasks.insert(newState, i);
+        TransitionPlanningJob * job = new TransitionPlanningJob(params,
+                                                                startPos, startPose,
+                                                                endPos, endPose,
+                                                                _obstacles,
+                                                                _obstacleMap,
+                                                                _roadmap,
+                                                                _visibilityGraph);
+        job->setRandomSeed(this->randomSeed());
+        job->setStrategy(_transitionStrategy);
+        job->setPlanningContext(this->planningContext());
+        job->setTerrain(_terrainModel, this->_maxTerrainElevation());
+        job->setTuning(this->runTuning());
+        jobs.append(job);
+    }
 
-                transitionFlights.insert(newState, transitionFlight);
+    //One transition gets planned just as quickly by _scheduleMove() itself
+    if (jobs.size() < 2)
+    {
+        qDeleteAll(jobs);
+        return;
+    }
 
-                worklist.insert(tentativeCostToMove + heuristic, newState);
-            }
-        } // Done generating transitions
-    } // Done building schedule
+    _runJobs(jobs, "TransitionPrefetch", JobSystem::LowPriority);
 
-    if (!solutionFound)
-        return false;
+    /*
+     * Two successors close enough to share a cache entry would have had the first one's flight if we'd planned
+     * them one at a time. Inserting backwards leaves the first one's in the cache, so the schedule doesn't change.
+    */
+    const bool interrupted = this->planningInterrupted();
+    for (int j = jobs.size() - 1; j >= 0; j--)
+    {
+        TransitionPlanningJob * job = static_cast<TransitionPlanningJob *>(jobs.at(j));
+        if (!interrupted)
+            _transitionCache.insert(job->startPos(), job->startPose(),
+                                    job->endPos(), job->endPose(),
+                                    job->results());
+        delete job;
+    }
+    this->workingStatistics()->addToCounter("TransitionsPlanned", jobs.size());
+    this->workingStatistics()->addToCounter("TransitionsPlannedInParallel", jobs.size());
+}
 
-    QVectorND prevInterval = schedule[0];
-    schedule.removeFirst();
+//private
+QList<Position> HierarchicalPlanner::_transitionFlightFor(const QVectorND &state, int lastTask, int i)
+{
+    if (lastTask < 0)
+        return _startTransitionFor(state, i);
+    else if (lastTask == i)
+        return QList<Position>();
+
+    //Planned when the move was considered, so this comes from the cache
+    Position startPos;
+    UAVOrientation startPose;
+    Position endPos;
+    UAVOrientation endPose;
+    _transitionEndpoints(state, lastTask, i, &startPos, &startPose, &endPos, &endPose);
+    return _generateTransitionFlight(startPos, startPose, endPos, endPose);
+}
 
-    QList<Position> path;
-    foreach(const QVectorND& interval, schedule)
-    {
-        const int taskIndex = lastTasks.value(interval);
-        const QSharedPointer<FlightTask> task = _tasks.value(taskIndex);
-        const QSharedPointer<FlightTaskArea> area = _tasks2areas.value(task);
+//private
+bool HierarchicalPlanner::_scheduleMove(const QVectorND &state,
+                                        int lastTask,
+                                        qreal stateCost,
+                                        int i,
+                                        const QVectorND &newState,
+                                        const QList<qreal> &taskTimes,
+                                        qreal costToBeat,
+                                        qreal *newCost,
+                                        QList<Position> *transitionFlight)
+{
+    const UAVParameters& params = this->problem()->uavParameters();
 
-        if (prevInterval == startState)
-            path.append(_startTransitionSubFlights.value(area));
-        else if (prevInterval == startState
-                 || lastTasks.value(prevInterval) != taskIndex)
-            path.append(transitionFlights.value(interval));
+    transitionFlight->clear();
+    if (lastTask < 0)
+        *transitionFlight = _startTransitionFor(state, i);
+    else if (lastTask == i)
+    {
+        //Nothing to do here?
+    }
+    else
+    {
+        Position startPos;
+        UAVOrientation startPose;
+        Position endPos;
+        UAVOrientation endPose;
+        _transitionEndpoints(state, lastTask, i, &startPos, &startPose, &endPos, &endPose);
+
+        //Don't plan a transition that can't beat the best way we already know to reach newState
+        const qreal optimisticCost = stateCost
+                + IntermediatePlanner::dubinsCostEstimate(params, startPos, startPose, endPos, endPose)
+                + newState[i] - state[i];
+        if (costToBeat <= optimisticCost)
+            return false;
+
+        //Plan intermediate flight
+        *transitionFlight = _generateTransitionFlight(startPos, startPose,
+                                                      endPos, endPose);
+    }
 
-        //Add the portion of the sub-flight that we care about
-        const QList<Position>& subFlight = _taskSubFlights.value(task);
-        const qreal startTime = prevInterval.val(taskIndex);
-        const qreal endTime = interval.val(taskIndex);
-        path.append(_getPathPortion(subFlight, startTime, endTime));
+    //Transition flights that cut through a no-fly zone (or over high ground) can't be scheduled
+    if (_obstacleMap && _obstacleMap->pathCollides(*transitionFlight))
+        return false;
+    if (_terrainModel
+            && _terrainModel->checkPath(*transitionFlight, this->_maxTerrainElevation(), true).violations > 0)
+        return false;
 
+    //The time (if any) needed to fly the transition flight to this task
+    const qreal transitionTime = transitionFlight->length() * params.waypointInterval() / params.airspeed();
+    const qreal startTime = stateCost + transitionTime;
+    const qreal endTime = startTime + newState[i] - state[i];
 
-        prevInterval = interval;
+    //Check dependency constraints
+    foreach(int index, _taskDependencies.at(i))
+    {
+        if (state.val(index) < taskTimes.at(index))
+            return false;
     }
 
-    this->setBestFlightSoFar(path);
+    //If the newstate violates timing constraints then we won't generate it
+    if (!_taskWindows.at(i).contains(startTime, endTime))
+        return false;
+
+    *newCost = endTime;
     return true;
 }
 
@@ -445,17 +3123,17 @@ bool HierarchicalPlanner::_interpolatePath(const QList<Position> &path,
 {
     if (outPosition == 0 || outOrientation == 0)
     {
-        qDebug() << "Can't interpolate: bad output position/orientation pointer(s).";
+        planningDebug(plannerLog) << "Can't interpolate: bad output position/orientation pointer(s).";
         return false;
     }
     else if (goalTime < 0.0)
     {
-        qDebug() << "Can't interpolate: bad time.";
+        planningDebug(plannerLog) << "Can't interpolate: bad time.";
         return false;
     }
     else if (path.isEmpty())
     {
-        qDebug() << "Can't interpolate: empty path.";
+        planningDebug(plannerLog) << "Can't interpolate: empty path.";
         return false;
     }
     else if (path.size() == 1)
@@ -467,39 +3145,29 @@ bool HierarchicalPlanner::_interpolatePath(const QList<Position> &path,
 
     const UAVParameters& params = this->problem()->uavParameters();
 
-    //qDebug() << "Interpolate path of size" << path.size() << "to time" << goalTime;
-
-    qreal distanceSoFar = 0.0;
-    qreal timeSoFar = 0.0;
-
-    for (int i = 1; i < path.size(); i++)
-    {
-        const Position& pos = path[i];
-        const Position& lastPos = path[i-1];
-        //const qreal distance = (Conversions::lla2xyz(pos) - Conversions::lla2xyz(lastPos)).length();
-        const qreal intervalDistance = params.waypointInterval();
-        distanceSoFar += intervalDistance;
-        timeSoFar = distanceSoFar / params.airspeed();
-
-
-        if (timeSoFar >= goalTime || i == path.size() - 1)
-        {
-            const qreal lonPerMeter = Conversions::degreesLonPerMeter(pos.latitude());
-            const qreal latPerMeter = Conversions::degreesLatPerMeter(pos.latitude());
-            const qreal lastTime = timeSoFar - intervalDistance / params.airspeed();
-            const qreal ratio = (goalTime - lastTime) / (timeSoFar - lastTime);
-            QVector2D dirVecMeters((pos.longitude() - lastPos.longitude()) / lonPerMeter,
-                                   (pos.latitude() - lastPos.latitude()) / latPerMeter);
-            const qreal distToGo = params.waypointInterval() * ratio;
-            dirVecMeters.normalize();
-            const qreal longitude = lastPos.longitude() + distToGo * dirVecMeters.x() * lonPerMeter;
-            const qreal latitude = lastPos.latitude() + distToGo * dirVecMeters.y() * latPerMeter;
-            *outPosition = Position(longitude, latitude);
-            *outOrientation = UAVOrientation(atan2(dirVecMeters.y(),
-                                                   dirVecMeters.x()));
-            break;
-        }
-    }
+    /*
+     * Waypoints are one waypointInterval apart, so waypoint i is reached at i * interval / airspeed. The first
+     * one reached at or after goalTime is the end of the segment we're on, and there's no need to walk the path.
+    */
+    const qreal intervalTime = params.waypointInterval() / params.airspeed();
+    const int i = qBound<int>(1, ceil(goalTime / intervalTime - 1e-9), path.size() - 1);
+    const qreal timeSoFar = i * intervalTime;
+
+    const Position& pos = path[i];
+    const Position& lastPos = path[i-1];
+    const qreal lonPerMeter = Conversions::degreesLonPerMeter(pos.latitude());
+    const qreal latPerMeter = Conversions::degreesLatPerMeter(pos.latitude());
+    const qreal lastTime = timeSoFar - intervalTime;
+    const qreal ratio = (goalTime - lastTime) / (timeSoFar - lastTime);
+    QVector2D dirVecMeters((pos.longitude() - lastPos.longitude()) / lonPerMeter,
+                           (pos.latitude() - lastPos.latitude()) / latPerMeter);
+    const qreal distToGo = params.waypointInterval() * ratio;
+    dirVecMeters.normalize();
+    const qreal longitude = lastPos.longitude() + distToGo * dirVecMeters.x() * lonPerMeter;
+    const qreal latitude = lastPos.latitude() + distToGo * dirVecMeters.y() * latPerMeter;
+    *outPosition = Position(longitude, latitude);
+    *outOrientation = UAVOrientation(atan2(dirVecMeters.y(),
+                                           dirVecMeters.x()));
 
     if (timeSoFar < goalTime)
     {
@@ -516,38 +3184,261 @@ QList<Position> HierarchicalPlanner::_generateTransitionFlight(const Position &s
                                                                const UAVOrientation &endPose)
 {
     //qDebug() << "Intermediate from" << startPos << startPose.radians() << "to" << endPos << endPose.radians();
-    //Adjust the positions backwards a little bit along their angles?
-
-    //    DubinsIntermediatePlanner * intermed = new DubinsIntermediatePlanner(this->problem()->uavParameters(),
-    //                                                                         startPos, startPose,
-    //                                                                         endPos, endPose,
-    //                                                                         _obstacles);
-    AstarPRMIntermediatePlanner * intermed = new AstarPRMIntermediatePlanner(this->problem()->uavParameters(),
-                                                                             startPos, startPose,
-                                                                             endPos, endPose,
-                                                                             _obstacles);
-    intermed->plan();
-    QList<Position> toRet = intermed->results();
-    delete intermed;
+
+    //We may have flown this context switch (or one very close to it) already
+    QList<Position> toRet;
+    if (_transitionCache.lookup(startPos, startPose, endPos, endPose, &toRet))
+        return toRet;
+
+    TransitionPlanningJob job(this->problem()->uavParameters(),
+                              startPos, startPose,
+                              endPos, endPose,
+                              _obstacles,
+                              _obstacleMap,
+                              _roadmap,
+                              _visibilityGraph);
+    job.setRandomSeed(this->randomSeed());
+    job.setStrategy(_transitionStrategy);
+    job.setPlanningContext(this->planningContext());
+    job.setTerrain(_terrainModel, this->_maxTerrainElevation());
+    job.setTuning(this->runTuning());
+    job.run();
+    toRet = job.results();
+    this->workingStatistics()->addToCounter("TransitionsPlanned");
+
+    if (!this->planningInterrupted())
+        _transitionCache.insert(startPos, startPose, endPos, endPose, toRet);
 
     return toRet;
 }
 
 //private
-QList<Position> HierarchicalPlanner::_getPathPortion(const QList<Position> &path,
-                                                     qreal portionStartTime,
-                                                     qreal portionEndTime) const
+void HierarchicalPlanner::_updateTransitionCacheCounters()
 {
-    QList<Position> toRet;
+    this->workingStatistics()->setCounter("TransitionCacheHits", _transitionCache.hits());
+    this->workingStatistics()->setCounter("TransitionCacheMisses", _transitionCache.misses());
+
+    //Transitions to a destination the graphs have already searched back from
+    quint64 goalFieldHits = 0;
+    quint64 goalFieldMisses = 0;
+    if (_visibilityGraph)
+    {
+        goalFieldHits += _visibilityGraph->goalFieldHits();
+        goalFieldMisses += _visibilityGraph->goalFieldMisses();
+    }
+    if (_roadmap)
+    {
+        goalFieldHits += _roadmap->goalFieldHits();
+        goalFieldMisses += _roadmap->goalFieldMisses();
+    }
+    this->workingStatistics()->setCounter("GoalFieldHits", goalFieldHits);
+    this->workingStatistics()->setCounter("GoalFieldMisses", goalFieldMisses);
+}
+
+//private
+void HierarchicalPlanner::_runJobs(const QList<QRunnable *> &jobs, const char *name,
+                                   JobSystem::Priority priority) const
+{
+    if (_workerCount == 1 || jobs.size() <= 1)
+    {
+        foreach(QRunnable * job, jobs)
+            job->run();
+        return;
+    }
+
+    //The jobs may fork jobs of their own (beam slices, transition races), which share the same workers
+    JobGroup group;
+    foreach(QRunnable * job, jobs)
+        group.run(job, name, priority);
+    group.wait();
+}
 
+//private
+qreal HierarchicalPlanner::_subFlightTime(const QList<Position> &subFlight) const
+{
     const UAVParameters& params = this->problem()->uavParameters();
-    const int startingIndex = portionStartTime * params.airspeed() / params.waypointInterval();
-    const int endingIndex = portionEndTime * params.airspeed() / params.waypointInterval();
-    //const int count = endingIndex - startingIndex;
 
-    for (int i = startingIndex; i < endingIndex; i++)
-        toRet.append(path[i]);
+    //Time required is estimated to be the length of the path in meters divided by airspeed
+    return subFlight.length() * params.waypointInterval() / params.airspeed();
+}
+
+//private
+QRectF HierarchicalPlanner::_roadmapBounds() const
+{
+    //Every area (no-fly zones included) and the starting position, with a margin around them
+    QRectF localBounds(_compiled->localStartingPosition(), QSizeF(0.0, 0.0));
+    for (int id = 0; id < _compiled->areaCount(); id++)
+        localBounds = localBounds.united(_compiled->area(id).localBoundingRect);
+    localBounds.adjust(-ROADMAP_MARGIN, -ROADMAP_MARGIN, ROADMAP_MARGIN, ROADMAP_MARGIN);
+
+    //The roadmap itself is sampled in lon/lat
+    return _compiled->frame().toGeo(QPolygonF(localBounds)).boundingRect();
+}
+
+//private
+Position HierarchicalPlanner::_startPosition() const
+{
+    if (_replanning)
+        return _replanStartPosition;
+    return this->problem()->startingPosition();
+}
+
+//private
+UAVOrientation HierarchicalPlanner::_startOrientation() const
+{
+    if (_replanning)
+        return _replanStartOrientation;
+    return this->problem()->startingOrientation();
+}
+
+//private
+QVectorND HierarchicalPlanner::_scheduleStartState(const QList<qreal> &taskTimes) const
+{
+    //Nothing's flown yet, unless we're replanning a flight that had started some of the tasks
+    QVectorND toRet(_tasks.size());
+    for (int p = 0; p < _replanProgress.size(); p++)
+    {
+        const int i = _tasks.indexOf(_replanProgress.at(p).first);
+        if (i >= 0)
+            toRet[i] = qBound<qreal>(0.0, _replanProgress.at(p).second, taskTimes.at(i));
+    }
+    return toRet;
+}
+
+//private
+QList<Position> HierarchicalPlanner::_startTransitionFor(const QVectorND &state, int i)
+{
+    if (state.val(i) <= 0.0)
+        return _startTransitionSubFlights.at(_taskAreas.at(i));
+
+    //Picking up a task a replanned flight had started, where it left off
+    Position endPos;
+    UAVOrientation endPose;
+    _interpolatePath(_taskSubFlights.at(i), _areaStartOrientations.at(_taskAreas.at(i)), state.val(i),
+                     &endPos, &endPose);
+    return _generateTransitionFlight(_startPosition(), _startOrientation(), endPos, endPose);
+}
+
+//private
+qreal HierarchicalPlanner::_maxTerrainElevation() const
+{
+    //Replans keep to the altitude the mission started at
+    return this->problem()->startingPosition().altitude() - _minTerrainClearance;
+}
+
+//private
+void HierarchicalPlanner::_validateTerrainClearance(const QList<Position> &flight)
+{
+    const TerrainModel::PathCheck check = _terrainModel->checkPath(flight, this->_maxTerrainElevation());
 
+    PlanningStatistics * statistics = this->workingStatistics();
+    statistics->setCounter("TerrainWaypointsChecked", check.points);
+    statistics->setCounter("TerrainWaypointsUnknown", check.unknown);
+    statistics->setCounter("TerrainClearanceViolations", check.violations);
+    statistics->setCounter("TerrainTilesMapped", _terrainModel->tilesMapped());
+
+    if (check.violations > 0)
+        qWarning() << "Flight passes within" << _minTerrainClearance << "meters of the ground at"
+                   << check.violations << "waypoints, first at" << flight.at(check.firstViolation);
+}
 
+//private static
+quint64 HierarchicalPlanner::_obstaclesVersion(const QList<QPolygonF> &obstacles)
+{
+    //FNV-1a over each obstacle's vertices. The hashes are summed so that the version doesn't depend on the
+    //order the areas come out of the problem's set, which changes from run to run.
+    quint64 toRet = 0;
+    foreach(const QPolygonF& obstacle, obstacles)
+    {
+        quint64 obstacleHash = Q_UINT64_C(14695981039346656037);
+        foreach(const QPointF& point, obstacle)
+        {
+            const qreal coords[2] = {point.x(), point.y()};
+            const uchar * bytes = reinterpret_cast<const uchar *>(coords);
+            for (uint i = 0; i < sizeof(coords); i++)
+            {
+                obstacleHash ^= bytes[i];
+                obstacleHash *= Q_UINT64_C(1099511628211);
+            }
+        }
+        toRet += obstacleHash;
+    }
     return toRet;
 }
+
+//private
+quint64 HierarchicalPlanner::_terrainVersion() const
+{
+    if (!_terrainModel)
+        return 0;
+    const qreal maxElevation = this->_maxTerrainElevation();
+    return PlanningRandom::hashReals(qHash(_terrainModel->directory()), &maxElevation, 1);
+}
+
+//private
+quint64 HierarchicalPlanner::_transitionTuningVersion() const
+{
+    //The default tuning leaves the version as it was before there was tuning, so saved caches stay valid
+    const PlannerTuning& tuning = this->runTuning();
+    const PlannerTuning defaults;
+    if (tuning.rrtBranchesPerSide() == defaults.rrtBranchesPerSide()
+            && tuning.rrtMaxSamples() == defaults.rrtMaxSamples()
+            && tuning.rrtStarMaxIterations() == defaults.rrtStarMaxIterations()
+            && tuning.latticeGranularity() == defaults.latticeGranularity())
+        return 0;
+
+    const qreal values[] = {(qreal) tuning.rrtBranchesPerSide(), (qreal) tuning.rrtMaxSamples(),
+                            (qreal) tuning.rrtStarMaxIterations(), tuning.latticeGranularity()};
+    return PlanningRandom::hashReals(0, values, 4);
+}
+
+//private
+quint64 HierarchicalPlanner::_uavParametersHash() const
+{
+    QByteArray bytes;
+    QDataStream stream(&bytes, QIODevice::WriteOnly);
+    stream.setVersion(RESULTS_STREAM_VERSION);
+    stream << this->problem()->uavParameters();
+    return PlanningResultCache::hash(bytes);
+}
+
+//private
+quint64 HierarchicalPlanner::_subFlightKey(const QSharedPointer<FlightTask> &task,
+                                           const QPolygonF &geoPoly,
+                                           const Position &start,
+                                           const UAVOrientation &startPose) const
+{
+    //Everything the sub-flight planner looks at: the task's own settings, its area, where it starts and the UAV
+    QByteArray bytes;
+    QDataStream stream(&bytes, QIODevice::WriteOnly);
+    stream.setVersion(RESULTS_STREAM_VERSION);
+    stream << task->serializationType();
+    task->serialize(stream);
+
+    //Not part of the task's serialized form, but it changes the sub-flight completely
+    const CoverageTask * coverage = qobject_cast<const CoverageTask *>(task.data());
+    if (coverage)
+        stream << (qint32) coverage->coverageMode();
+
+    stream << geoPoly << start;
+    startPose.serialize(stream);
+    stream << this->problem()->uavParameters() << _subFlightBeamWidth << this->randomSeed();
+
+    //Only when it's been changed, so results cached before it could be changed are still found
+    if (this->runTuning().subFlightBranchesPerSide() != PlannerTuning().subFlightBranchesPerSide())
+        stream << (qint32) this->runTuning().subFlightBranchesPerSide();
+    return PlanningResultCache::hash(bytes);
+}
+
+//private
+void HierarchicalPlanner::_getPathPortion(const QList<Position> &path,
+                                          qreal portionStartTime,
+                                          qreal portionEndTime,
+                                          int *first,
+                                          int *end) const
+{
+    //Waypoints are evenly spaced in time, so the portion's indices follow directly from its times
+    const UAVParameters& params = this->problem()->uavParameters();
+    *first = qBound<int>(0, portionStartTime * params.airspeed() / params.waypointInterval(), path.size());
+    *end = qBound<int>(*first, portionEndTime * params.airspeed() / params.waypointInterval(), path.size());
+}
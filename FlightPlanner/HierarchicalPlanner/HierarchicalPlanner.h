@@ -4,10 +4,31 @@
 #include <QObject>
 #include <QList>
 #include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QBitArray>
+#include <QRunnable>
+#include <QElapsedTimer>
+#include <QPair>
 
 #include "FlightPlanner.h"
+#include "JobSystem.h"
 #include "PlanningProblem.h"
+#include "CompiledProblem.h"
 #include "Position.h"
+#include "TransitionFlightCache.h"
+#include "PlanningResultCache.h"
+#include "ObstacleMap.h"
+#include "ProbabilisticRoadmap.h"
+#include "VisibilityGraph.h"
+#include "TerrainModel.h"
+#include "TransitionStrategy.h"
+#include "QVectorND.h"
+#include "ScheduleState.h"
+#include "ScheduleLattice.h"
+#include "ScheduleNodeTable.h"
+#include "PlanningRandom.h"
+#include "FlightTasks/TimingWindowIndex.h"
 
 class HierarchicalPlanner : public FlightPlanner
 {
@@ -15,6 +36,273 @@ class HierarchicalPlanner : public FlightPlanner
 public:
     explicit HierarchicalPlanner(QSharedPointer<PlanningProblem> prob = QSharedPointer<PlanningProblem>(),
                                  QObject *parent = 0);
+    virtual ~HierarchicalPlanner();
+
+    /**
+     * @brief transitionCache returns the cache of transition flights shared by this planner's run.
+     * Useful for checking hit/miss counts.
+     * @return
+     */
+    const TransitionFlightCache& transitionCache() const;
+
+    /**
+     * @brief workerCount returns how many ways sub-flights and transition flights are planned in parallel.
+     * 0 means "use QThread::idealThreadCount()". 1 plans everything serially on the calling thread. Otherwise
+     * the work goes to JobSystem::shared(), whose worker count bounds the threads used by all planners at once.
+     * @return
+     */
+    int workerCount() const;
+    void setWorkerCount(int count);
+
+    /**
+     * @brief precomputeTransitions returns true if the planner plans the transition from the end of every
+     * task to the start of every other task (concurrently) before scheduling. The scheduler then finds those
+     * flights in the transition cache instead of planning them one at a time. Defaults to false.
+     * @return
+     */
+    bool precomputeTransitions() const;
+    void setPrecomputeTransitions(bool precompute);
+
+    /**
+     * @brief subFlightBeamWidth returns the beam width used to plan each task's sub-flight.
+     * 0 (the default) plans sub-flights with an unbounded greedy best-first search instead.
+     * @return
+     */
+    int subFlightBeamWidth() const;
+    void setSubFlightBeamWidth(int width);
+
+    /**
+     * @brief obstacleMapResolution returns the cell size (in meters) of the obstacle raster that transition
+     * planners and the scheduler use for collision checks. The raster is rebuilt from the no-fly zones on every
+     * reset. 0 disables the raster and tests the obstacle polygons exactly instead. Defaults to 50 meters.
+     * @return
+     */
+    qreal obstacleMapResolution() const;
+    void setObstacleMapResolution(qreal resolution);
+
+    /**
+     * @brief roadmapSamples returns how many waypoints the probabilistic roadmap that transition planners search
+     * around the no-fly zones has. The roadmap covers the whole mission and is rebuilt on every reset, so each
+     * transition only has to join its endpoints to it. 0 disables the roadmap and plans each transition from
+     * scratch. Defaults to 1000.
+     * @return
+     */
+    int roadmapSamples() const;
+    void setRoadmapSamples(int samples);
+
+    /**
+     * @brief visibilityGraphTransitions returns whether transitions are first planned along the shortest route
+     * around the no-fly zones, found in a graph of their corners that is built on every reset. Without the
+     * graph the strategy's "VisibilityGraph" planner is skipped. Defaults to true.
+     * @return
+     */
+    bool visibilityGraphTransitions() const;
+    void setVisibilityGraphTransitions(bool enabled);
+
+    /**
+     * @brief transitionStrategy returns which IntermediatePlanners transitions are planned with and whether
+     * they're tried in order or raced against each other. Defaults to TransitionStrategy().
+     * @return
+     */
+    const TransitionStrategy& transitionStrategy() const;
+    void setTransitionStrategy(const TransitionStrategy& strategy);
+
+    /**
+     * @brief scheduleTimeBudget returns how many milliseconds the scheduler may spend looking for better
+     * schedules once it has one. The best schedule found when the time runs out is kept. 0 (the default)
+     * searches until the schedule is known to be optimal.
+     * @return
+     */
+    qint64 scheduleTimeBudget() const;
+    void setScheduleTimeBudget(qint64 msecs);
+
+    /**
+     * @brief multiResolutionScheduling returns whether schedules for long tasks are searched on coarse time
+     * slices first and then refined near the coarse schedule's task switches. This makes long tasks tractable
+     * but the finished schedule is only optimal near the coarse one. Defaults to true.
+     * @return
+     */
+    bool multiResolutionScheduling() const;
+    void setMultiResolutionScheduling(bool enabled);
+
+    /**
+     * @brief scheduleDominancePruning returns whether the schedule search drops states that another state
+     * dominates: one at the same point of the same task that has flown at least as much of every task and got
+     * there no later. Such a state can do anything the dominated one can, except that it may have to join a task
+     * further along its sub-flight. Pruning is skipped for problems with timing constraints, where arriving
+     * earlier isn't always better. Defaults to true.
+     * @return
+     */
+    bool scheduleDominancePruning() const;
+    void setScheduleDominancePruning(bool enabled);
+
+    /**
+     * @brief parallelScheduleExpansion returns whether the schedule search plans the uncached transition flights
+     * of each expanded state's successors at once, on workerCount() threads, before evaluating the successors.
+     * The schedule found is the same either way. Defaults to true.
+     * @return
+     */
+    bool parallelScheduleExpansion() const;
+    void setParallelScheduleExpansion(bool enabled);
+
+    /**
+     * @brief lazyTransitions returns whether the schedule search puts off planning transition flights (lazy
+     * weighted A*). A move whose transition isn't in the cache is queued at the optimistic Dubins estimate of
+     * flying it, and its transition is only planned once that move is the most promising thing left to expand.
+     * The move is then queued again at its real cost. Most of the transitions an expansion considers are never
+     * planned, and the schedule found is just as good. Moves are planned one at a time, so there's nothing left
+     * for parallelScheduleExpansion() to prefetch. Defaults to true.
+     * @return
+     */
+    bool lazyTransitions() const;
+    void setLazyTransitions(bool enabled);
+
+    /**
+     * @brief scheduleImprovementTimeBudget returns how many milliseconds the planner may spend improving the
+     * finished schedule. The schedule is cut into segments (runs of one task) which are reordered, moved and
+     * reversed (Or-opt and 2-opt), have their switch points shifted, and are destroyed and greedily reinserted
+     * (large neighborhood search). Candidates are ranked by a cheap lower bound and the best few have their
+     * missing transitions planned on workerCount() threads before they're flown. Each improvement is published
+     * right away. The stage also ends once it stops finding improvements. 0 disables it. Defaults to 1000.
+     * @return
+     */
+    qint64 scheduleImprovementTimeBudget() const;
+    void setScheduleImprovementTimeBudget(qint64 msecs);
+
+    /**
+     * @brief scheduleMemoryBudget returns roughly how many bytes the schedule search may use for the states it
+     * has reached and its open list. Once a search reaches it, the search only keeps its few most promising open
+     * states from then on (a beam search), so it still finishes a schedule without using much more, and the
+     * finer passes that would need more memory are skipped. 0 means no limit. Defaults to 1 GiB.
+     * @return
+     */
+    qint64 scheduleMemoryBudget() const;
+    void setScheduleMemoryBudget(qint64 bytes);
+
+    /**
+     * @brief scheduleClusterSize returns how many tasks one schedule search takes on. A mission with more
+     * unfinished tasks than this is decomposed into clusters of tasks whose areas are near each other. Tasks of one
+     * area, and tasks that depend on each other, always share a cluster, so clusters can end up bigger. The
+     * clusters are put in order (by deadline if there are timing constraints, otherwise along a short tour of
+     * them), the transitions within each are planned in parallel, and then each cluster's schedule is searched
+     * from where the one before it ends, with scheduleTimeBudget() each. A search's states multiply with its
+     * cluster's tasks rather than the mission's, so scheduling time grows about linearly with the mission. Tasks
+     * of different clusters are never interleaved though, so the schedule isn't optimal. If the clusters can't
+     * meet the timing constraints in that order, the whole mission is searched as usual. 0 (the default) never
+     * decomposes.
+     * @return
+     */
+    int scheduleClusterSize() const;
+    void setScheduleClusterSize(int tasks);
+
+    /**
+     * @brief areaEntryCount returns how many places each area can be entered from: the end of its longest chord
+     * nearest the other areas, the chord's other end, and either side of the chord's perpendicular bisector, each
+     * just outside the area and heading across it. Every task's sub-flight is planned from each of its area's
+     * entries at once, and cached like any other sub-flight. Once a schedule is found, each area it hasn't
+     * started is entered wherever is quickest to reach from where the schedule arrives from and to fly the area's
+     * tasks from ("AreaEntriesChanged"), and if that changes any the schedule is searched again on the new
+     * entries, to be kept if it's shorter. An area keeps its entry across resets, so replans pick up a started
+     * task where the aircraft is. 1 enters each area from the first of them only. Defaults to 4.
+     * @return
+     */
+    int areaEntryCount() const;
+    void setAreaEntryCount(int entries);
+
+    /**
+     * @brief terrainModel returns the terrain flights are kept clear of, or null (the default) to ignore terrain.
+     * Flights are planned level at the altitude of the problem's starting position, so transition planners treat
+     * ground higher than that less minTerrainClearance() as an obstacle. Sub-flights cover their areas however
+     * high the ground is, so every published flight is also checked waypoint by waypoint: the
+     * "TerrainValidation" stage counts the waypoints checked ("TerrainWaypointsChecked"), those with no terrain
+     * data ("TerrainWaypointsUnknown") and those too close to the ground ("TerrainClearanceViolations").
+     * Takes effect on the next reset.
+     * @return
+     */
+    QSharedPointer<const TerrainModel> terrainModel() const;
+    void setTerrainModel(QSharedPointer<const TerrainModel> terrain);
+
+    /**
+     * @brief minTerrainClearance returns how far (in meters) above the ground flights must stay when there's a
+     * terrainModel(). Defaults to 50 meters.
+     * @return
+     */
+    qreal minTerrainClearance() const;
+    void setMinTerrainClearance(qreal meters);
+
+    /**
+     * @brief saveResults returns the area endpoints, task sub-flights and transition flights planned so
+     * far, for saving with the problem. Only call it while planning isn't running.
+     * @return
+     */
+    QByteArray saveResults() const;
+
+    /**
+     * @brief restoreResults adds results returned by saveResults() to the caches, so that planning the
+     * same (or a mostly unchanged) problem again skips the work it has already done. Results for areas,
+     * tasks or UAV parameters that have changed since are simply never used. Only call it while planning
+     * isn't running. Returns false if results is damaged.
+     * @param results
+     * @return
+     */
+    bool restoreResults(const QByteArray& results);
+
+    /**
+     * @brief lastRunCompleted returns true if the last run went through every stage without being interrupted
+     * (by pausing or a budget), so its flight is the one the problem and settings give. False while running.
+     * @return
+     */
+    bool lastRunCompleted() const;
+
+    /**
+     * @brief shareObstacleStructures has the planner use other's obstacle map, probabilistic roadmap and
+     * visibility graph. A reset keeps each of them for as long as it would come out the same anyway (same
+     * no-fly zones, resolution, mission bounds, roadmap samples and seed), so planners of one mission that only
+     * differ in UAV parameters build them once between them. Call it while neither planner is running, and
+     * before giving this planner its problem.
+     * @param other
+     */
+    void shareObstacleStructures(const HierarchicalPlanner& other);
+
+    /**
+     * @brief commitHorizon returns how many seconds of the flight ahead of the aircraft replanFrom() keeps as they
+     * are, so the aircraft has something to fly while the rest is replanned. Defaults to 30.
+     * @return
+     */
+    qreal commitHorizon() const;
+    void setCommitHorizon(qreal seconds);
+
+    /**
+     * @brief replanLatencyBudget returns how many milliseconds a run started by replanFrom() may take before the
+     * planner pauses itself with whatever flight it has by then. 0 leaves it to timeBudget(). Defaults to 2000.
+     * @return
+     */
+    qint64 replanLatencyBudget() const;
+    void setReplanLatencyBudget(qint64 msecs);
+
+    /**
+     * @brief replanFrom replans in flight (receding horizon) for an aircraft that has reached waypoint
+     * aircraftWaypoint of flight, e.g. after the problem gained a no-fly zone or a task. The flight up to
+     * commitHorizon() seconds past the aircraft is committed (see FlightPlanner::committedPrefix()) and the rest
+     * of the mission is planned from where that ends. Tasks that the last schedule this planner published had
+     * started by then carry on from where it left them, and cached sub-flights and transitions are reused.
+     *
+     * The old flight is published first, unless the part after the committed flight cuts through a no-fly zone
+     * (then just the committed flight is), and the run pauses itself after replanLatencyBudget(), so there's
+     * always a flight to fly within the budget. Runs started later plan from the same point, across resets,
+     * until clearReplan(). Returns false without starting if aircraftWaypoint isn't on flight.
+     * @param flight the flight the aircraft is flying, usually bestFlightSoFar() before the problem changed
+     * @param aircraftWaypoint
+     * @param errorString
+     * @return
+     */
+    bool replanFrom(const QList<Position>& flight, int aircraftWaypoint, QString * errorString = 0);
+
+    /**
+     * @brief clearReplan goes back to planning the whole mission from the problem's starting position and
+     * clears the committed prefix. Only call it while planning isn't running.
+     */
+    void clearReplan();
 
 protected:
     //pure-virtual from FlightPlanner
@@ -23,10 +311,144 @@ protected:
     virtual void doReset();
 
 private:
+    //The stages of a planning run, in order. doIteration() runs one per call.
+    enum RunStage
+    {
+        StartAndEndPositionsStage,
+        StartTransitionsStage,
+        SubFlightsStage,
+        TransitionMatrixStage,
+        ScheduleStage,
+        AreaEntriesStage,
+        ScheduleImprovementStage,
+        TerrainValidationStage
+    };
+
+    //A complete schedule: the states it passes through, and the task and transition flight into each
+    struct ScheduleSolution
+    {
+        qreal cost;
+        QList<QVectorND> states;
+        QHash<QVectorND, int> lastTasks;
+        QHash<QVectorND, QList<Position> > transitionFlights;
+    };
+
+    //A run of one task in a schedule: the task and how many seconds of its sub-flight are flown
+    struct ScheduleSegment
+    {
+        int task;
+        qreal duration;
+    };
+
+    void _finishRun();
     void _buildStartAndEndPositions();
+    void _useAreaEntry(int areaId, int entry);
     void _buildStartTransitions();
     void _buildSubFlights();
-    bool _buildSchedule();
+    void _buildTransitionMatrix(const QVector<int>& taskClusters = QVector<int>());
+    bool _buildSchedule(ScheduleSolution * solution);
+    void _chooseAreaEntries(ScheduleSolution * solution);
+    bool _refineSchedule(const QList<qreal>& taskTimes,
+                         const QVectorND& startState,
+                         int startLastTask,
+                         qreal startCost,
+                         const QVectorND& endState,
+                         const QElapsedTimer& budgetClock,
+                         bool flyImprovements,
+                         ScheduleSolution * best);
+    bool _buildDecomposedSchedule(const QList<qreal>& taskTimes,
+                                  const QVectorND& startState,
+                                  ScheduleSolution * solution);
+    QList<QList<int> > _scheduleClusters(const QVectorND& startState, const QList<qreal>& taskTimes) const;
+    void _improveSchedule(ScheduleSolution * solution);
+    bool _improveWith(const QList<QList<ScheduleSegment> >& candidates,
+                      const QList<qreal>& taskTimes,
+                      const QVectorND& startState,
+                      const QElapsedTimer& budgetClock,
+                      ScheduleSolution * solution,
+                      QList<ScheduleSegment> * segments);
+    QList<ScheduleSegment> _scheduleSegments(const ScheduleSolution& solution) const;
+    QList<QVectorND> _segmentStates(const QList<ScheduleSegment>& segments,
+                                    const QList<qreal>& taskTimes,
+                                    const QVectorND& startState) const;
+    qreal _segmentsLowerBound(const QList<ScheduleSegment>& segments,
+                              const QList<qreal>& taskTimes,
+                              const QVectorND& startState) const;
+    bool _flySegments(const QList<ScheduleSegment>& segments,
+                      const QList<qreal>& taskTimes,
+                      const QVectorND& startState,
+                      qreal costToBeat,
+                      ScheduleSolution * solution);
+    void _prefetchSegmentTransitions(const QList<QList<ScheduleSegment> >& candidates,
+                                     const QList<qreal>& taskTimes,
+                                     const QVectorND& startState);
+    QList<ScheduleSegment> _destroyAndRepair(const QList<ScheduleSegment>& segments,
+                                             const QList<qreal>& taskTimes,
+                                             const QVectorND& startState,
+                                             PlanningRandom * random) const;
+    static void _normalizeSegments(QList<ScheduleSegment> * segments);
+    static void _orOptMoves(const QList<ScheduleSegment>& segments, QList<QList<ScheduleSegment> > * output);
+    static void _twoOptMoves(const QList<ScheduleSegment>& segments, QList<QList<ScheduleSegment> > * output);
+    static void _switchShiftMoves(const QList<ScheduleSegment>& segments,
+                                  qreal timeslice,
+                                  QList<QList<ScheduleSegment> > * output);
+    bool _replaySchedule(const QList<qreal>& taskTimes,
+                         const QVectorND& startState,
+                         const QVectorND& endState,
+                         const QList<int>& order,
+                         int slicedEntries,
+                         ScheduleSolution * solution);
+    QList<int> _tourOrder(const QList<qreal>& taskTimes, const QVectorND& startState);
+    bool _searchSchedule(const QList<qreal>& taskTimes,
+                         const QVectorND& startState,
+                         int startLastTask,
+                         qreal startCost,
+                         const QVectorND& endState,
+                         qreal timeslice,
+                         const QList<QVectorND>& corridor,
+                         qreal corridorWidth,
+                         qreal weight,
+                         qreal costToBeat,
+                         const QElapsedTimer& budgetClock,
+                         ScheduleSolution * solution,
+                         bool * memoryExhausted);
+    QList<Position> _transitionFlightFor(const QVectorND& state, int lastTask, int i);
+    void _flySchedule(const ScheduleSolution& solution, const QVectorND& startState);
+    void _buildTransitionBounds();
+    bool _buildConstraints(const QList<qreal>& taskTimes);
+    void _finishedMask(const QVectorND& state, const QList<qreal>& taskTimes, QVector<quint64> * mask) const;
+    bool _dependenciesMet(int i, const QVector<quint64>& finished) const;
+    qreal _scheduleHeuristic(const QVectorND& progress, int lastTask, const QVectorND& endState) const;
+    QList<QVectorND> _scheduleCorners(const ScheduleSolution& solution) const;
+    bool _hasTimingConstraints() const;
+    bool _scheduleBudgetExhausted(const QElapsedTimer& budgetClock) const;
+    void _transitionEndpoints(const QVectorND& state,
+                              int lastTask,
+                              int i,
+                              Position * startPos,
+                              UAVOrientation * startPose,
+                              Position * endPos,
+                              UAVOrientation * endPose) const;
+    void _prefetchTransitions(const ScheduleState& state,
+                              qreal stateCost,
+                              const QList<int>& successors,
+                              const ScheduleNodeTable& nodes,
+                              const ScheduleLattice& lattice);
+    bool _scheduleMove(const QVectorND& state,
+                       int lastTask,
+                       qreal stateCost,
+                       int i,
+                       const QVectorND& newState,
+                       const QList<qreal>& taskTimes,
+                       qreal costToBeat,
+                       qreal * newCost,
+                       QList<Position> * transitionFlight);
+
+    void _runJobs(const QList<QRunnable *>& jobs, const char * name,
+                  JobSystem::Priority priority = JobSystem::NormalPriority) const;
+    void _updateTransitionCacheCounters();
+
+    qreal _subFlightTime(const QList<Position>& subFlight) const;
 
     bool _interpolatePath(const QList<Position>& path,
                               const UAVOrientation& startingOrientation,
@@ -39,18 +461,145 @@ private:
                                               const Position& endPos,
                                               const UAVOrientation& endPose);
 
-    QList<Position> _getPathPortion(const QList<Position>& path,
-                                    qreal portionStartTime,
-                                    qreal portionEndTime) const;
+    QRectF _roadmapBounds() const;
+
+    Position _startPosition() const;
+    UAVOrientation _startOrientation() const;
+    QVectorND _scheduleStartState(const QList<qreal>& taskTimes) const;
+    QList<Position> _startTransitionFor(const QVectorND& state, int i);
+
+    qreal _maxTerrainElevation() const;
+    void _validateTerrainClearance(const QList<Position>& flight);
+
+    static quint64 _obstaclesVersion(const QList<QPolygonF>& obstacles);
+    quint64 _terrainVersion() const;
+    quint64 _transitionTuningVersion() const;
+    quint64 _uavParametersHash() const;
+    quint64 _subFlightKey(const QSharedPointer<FlightTask>& task,
+                          const QPolygonF& geoPoly,
+                          const Position& start,
+                          const UAVOrientation& startPose) const;
 
+    void _getPathPortion(const QList<Position>& path,
+                         qreal portionStartTime,
+                         qreal portionEndTime,
+                         int * first,
+                         int * end) const;
+
+    //The problem as of the last reset
+    QSharedPointer<const CompiledProblem> _compiled;
+
+    //The tasks we schedule, in schedule state order. No-fly zones aren't tasks to us, just obstacles.
     QList<QSharedPointer<FlightTask> > _tasks;
-    QHash<QSharedPointer<FlightTask>, QSharedPointer<FlightTaskArea> > _tasks2areas;
-    QHash<QSharedPointer<FlightTaskArea>, Position> _areaStartPositions;
-    QHash<QSharedPointer<FlightTaskArea>, UAVOrientation> _areaStartOrientations;
-    QHash<QSharedPointer<FlightTask>, QList<Position> > _taskSubFlights;
-    QHash<QSharedPointer<FlightTaskArea>, QList<Position> > _startTransitionSubFlights;
+
+    //For each scheduled task: its id and its area's id in _compiled, and the scheduled tasks it depends on
+    QVector<int> _taskIds;
+    QVector<int> _taskAreas;
+    QVector<QVector<int> > _taskDependencies;
+    QVector<QList<Position> > _taskSubFlights;
+
+    //For each scheduled task: its sub-flight from each of its area's entries
+    QVector<QList<QList<Position> > > _taskEntrySubFlights;
+
+    //By area id in _compiled
+    QVector<Position> _areaStartPositions;
+    QVector<UAVOrientation> _areaStartOrientations;
+
+    //Also by area id: the content hash of its shape, where it can be entered from (best guess first), what kind
+    //of entry each of those is (see _buildStartAndEndPositions()) and which of them the start above is
+    QVector<quint64> _areaShapeKeys;
+    QVector<QList<Position> > _areaEntryPositions;
+    QVector<QList<UAVOrientation> > _areaEntryOrientations;
+    QVector<QList<int> > _areaEntryKinds;
+    QVector<int> _areaEntries;
+
+    //The kind of entry each area was last entered from, by the content hash of its shape. Survives resets.
+    QHash<quint64, int> _areaEntryChoices;
+
+    QVector<QList<Position> > _startTransitionSubFlights;
+    QBitArray _startTransitionsPlanned;
+
     QList<QPolygonF> _obstacles;
-    
+    QSharedPointer<const ObstacleMap> _obstacleMap;
+    QSharedPointer<const ProbabilisticRoadmap> _roadmap;
+    QSharedPointer<const VisibilityGraph> _visibilityGraph;
+
+    TransitionFlightCache _transitionCache;
+
+    //Area endpoints and sub-flights by content hash, and the hashes this run has used
+    PlanningResultCache _resultCache;
+    QSet<quint64> _usedResultKeys;
+
+    //The task flown in each time slice of the last schedule, to warm-start the next one. Survives resets.
+    QList<QSharedPointer<FlightTask> > _previousSchedule;
+
+    /*
+     * Built by _buildConstraints() for each schedule: the tasks each task waits for, as _maskWords words of bits
+     * per task; when each task may be flown (any of its timing windows); and the latest each can
+     * finish and still leave time for the tasks that wait on it to meet their windows.
+    */
+    QVector<quint64> _predecessorMasks;
+    int _maskWords;
+    QVector<TimingWindowIndex> _taskWindows;
+    QVector<qreal> _latestFinishes;
+
+    //Lower bounds on the time to fly between any two tasks' sub-flights (and the starting position, last), row-major
+    QVector<qreal> _transitionBounds;
+
+    int _workerCount;
+    bool _precomputeTransitions;
+    int _subFlightBeamWidth;
+    qreal _obstacleMapResolution;
+    int _roadmapSamples;
+    bool _visibilityGraphTransitions;
+    TransitionStrategy _transitionStrategy;
+    qint64 _scheduleTimeBudget;
+    bool _multiResolutionScheduling;
+    bool _scheduleDominancePruning;
+    bool _parallelScheduleExpansion;
+    bool _lazyTransitions;
+    qint64 _scheduleImprovementTimeBudget;
+    qint64 _scheduleMemoryBudget;
+    int _scheduleClusterSize;
+    int _areaEntryCount;
+    QSharedPointer<const TerrainModel> _terrainModel;
+    qreal _minTerrainClearance;
+
+    //What _obstacleMap was rasterized from, so a reset can tell whether it's still good
+    quint64 _obstacleMapVersion;
+    qreal _obstacleMapBuiltResolution;
+
+    //What _roadmap was sampled over, likewise
+    QRectF _roadmapBuiltBounds;
+    int _roadmapBuiltSamples;
+    quint64 _roadmapBuiltSeed;
+
+    qreal _commitHorizon;
+    qint64 _replanLatencyBudget;
+
+    /*
+     * Set by replanFrom() and kept across resets: the committed flight, where it leaves the aircraft and when
+     * (seconds into the mission), how far along it each task is, and the flight to fall back on
+    */
+    bool _replanning;
+    QList<Position> _replanCommitted;
+    Position _replanStartPosition;
+    UAVOrientation _replanStartOrientation;
+    qreal _replanStartTime;
+    QList<QPair<QSharedPointer<FlightTask>, qreal> > _replanProgress;
+    QList<Position> _replanFallback;
+
+    //The last schedule _flySchedule() published: its flight, its tasks, its states and the waypoint each ends at
+    QList<Position> _publishedFlight;
+    QList<QSharedPointer<FlightTask> > _publishedTasks;
+    QList<QVectorND> _publishedStates;
+    QVector<int> _publishedEnds;
+
+    //Where the current run is, and the schedule its stages are working on
+    RunStage _stage;
+    ScheduleSolution _schedule;
+    bool _scheduled;
+    bool _runCompleted;
 };
 
 #endif // HIERARCHICALPLANNER_H
@@ -1,19 +1,61 @@
 #include "IntermediatePlanner.h"
 
+#include "ObstacleMap.h"
+#include "TerrainModel.h"
+#include "guts/Conversions.h"
+#include "Dubins.h"
+
 IntermediatePlanner::IntermediatePlanner(const UAVParameters &uavParams,
                                          const Position &startPos,
                                          const UAVOrientation &startPose,
                                          const Position &endPos,
                                          const UAVOrientation &endPose,
                                          const QList<QPolygonF> &obstacles) :
-    _uavParams(uavParams), _startPos(startPos), _startPose(startPose), _endPos(endPos), _endPose(endPose), _obstacles(obstacles)
+    _uavParams(uavParams), _startPos(startPos), _startPose(startPose), _endPos(endPos), _endPose(endPose), _obstacles(obstacles),
+    _obstacleMap(0), _terrain(0), _maxTerrainElevation(0.0), _cancelFlag(0), _planningContext(0)
 {
+    this->setRandomSeed(0);
 }
 
 IntermediatePlanner::~IntermediatePlanner()
 {
 }
 
+void IntermediatePlanner::takeResults(QList<Position> *destination)
+{
+    *destination = this->results();
+}
+
+qreal IntermediatePlanner::estimateCost() const
+{
+    return IntermediatePlanner::dubinsCostEstimate(_uavParams, _startPos, _startPose, _endPos, _endPose);
+}
+
+//static
+qreal IntermediatePlanner::dubinsCostEstimate(const UAVParameters &uavParams,
+                                              const Position &startPos,
+                                              const UAVOrientation &startPose,
+                                              const Position &endPos,
+                                              const UAVOrientation &endPose)
+{
+    //Same local frame (meters, relative to the start) that DubinsIntermediatePlanner flies in
+    const qreal lonPerMeter = Conversions::degreesLonPerMeter(startPos.latitude());
+    const qreal latPerMeter = Conversions::degreesLatPerMeter(startPos.latitude());
+    const QPointF start(0.0, 0.0);
+    const QPointF end((endPos.longitude() - startPos.longitude()) / lonPerMeter,
+                      (endPos.latitude() - startPos.latitude()) / latPerMeter);
+
+    qreal lengthMeters = 0.0;
+    if (!Dubins::shortestLength(start, startPose.radians(),
+                                end, endPose.radians(),
+                                uavParams.minTurningRadius(),
+                                &lengthMeters))
+        return 0.0;
+
+    lengthMeters = qMax<qreal>(0.0, lengthMeters - uavParams.waypointInterval());
+    return lengthMeters / uavParams.airspeed();
+}
+
 const UAVParameters &IntermediatePlanner::uavParams() const
 {
     return _uavParams;
@@ -43,3 +85,118 @@ const QList<QPolygonF> &IntermediatePlanner::obstacles() const
 {
     return _obstacles;
 }
+
+const ObstacleMap *IntermediatePlanner::obstacleMap() const
+{
+    return _obstacleMap;
+}
+
+void IntermediatePlanner::setObstacleMap(const ObstacleMap *obstacleMap)
+{
+    _obstacleMap = obstacleMap;
+}
+
+const TerrainModel *IntermediatePlanner::terrain() const
+{
+    return _terrain;
+}
+
+qreal IntermediatePlanner::maxTerrainElevation() const
+{
+    return _maxTerrainElevation;
+}
+
+void IntermediatePlanner::setTerrain(const TerrainModel *terrain, qreal maxElevation)
+{
+    _terrain = terrain;
+    _maxTerrainElevation = maxElevation;
+}
+
+bool IntermediatePlanner::collidesWithObstacle(const Position &pos) const
+{
+    const ObstacleMap * map = this->_checkingMap();
+    if (map != 0 && map->contains(pos))
+        return true;
+
+    qreal elevation;
+    return _terrain != 0 && _terrain->elevationAt(pos, &elevation) && elevation > _maxTerrainElevation;
+}
+
+bool IntermediatePlanner::pathCollidesWithObstacle(const QList<Position> &path) const
+{
+    const ObstacleMap * map = this->_checkingMap();
+    if (map != 0 && map->pathCollides(path))
+        return true;
+    return this->pathCollidesWithTerrain(path);
+}
+
+bool IntermediatePlanner::pathCollidesWithTerrain(const QList<Position> &path) const
+{
+    if (_terrain == 0)
+        return false;
+    return _terrain->checkPath(path, _maxTerrainElevation, true).violations > 0;
+}
+
+quint64 IntermediatePlanner::randomSeed() const
+{
+    return _randomSeed;
+}
+
+void IntermediatePlanner::setRandomSeed(quint64 seed)
+{
+    _randomSeed = seed;
+
+    const qreal inputs[6] = {_startPos.longitude(), _startPos.latitude(), _startPose.radians(),
+                             _endPos.longitude(), _endPos.latitude(), _endPose.radians()};
+    _random.seed(PlanningRandom::hashReals(PlanningRandom::mix(seed), inputs, 6));
+}
+
+void IntermediatePlanner::setCancelFlag(const QAtomicInt *flag)
+{
+    _cancelFlag = flag;
+}
+
+void IntermediatePlanner::setPlanningContext(const PlanningContext *context)
+{
+    _planningContext = context;
+}
+
+const PlanningContext *IntermediatePlanner::planningContext() const
+{
+    return _planningContext;
+}
+
+bool IntermediatePlanner::cancelRequested() const
+{
+    if (_cancelFlag != 0 && *_cancelFlag != 0)
+        return true;
+    return _planningContext != 0 && _planningContext->shouldStop();
+}
+
+//protected
+bool IntermediatePlanner::chargeNodes(int count) const
+{
+    if (_cancelFlag != 0 && *_cancelFlag != 0)
+        return false;
+    return _planningContext == 0 || _planningContext->chargeNodes(count);
+}
+
+//protected
+PlanningRandom &IntermediatePlanner::random()
+{
+    return _random;
+}
+
+//private
+const ObstacleMap *IntermediatePlanner::_checkingMap() const
+{
+    if (_obstacleMap)
+        return _obstacleMap;
+    if (_obstacles.isEmpty())
+        return 0;
+
+    //Index the obstacles once for the whole plan() rather than once per check
+    if (_ownObstacleMap.isNull())
+        _ownObstacleMap = QSharedPointer<const ObstacleMap>(new ObstacleMap(_obstacles, 0.0));
+    return _ownObstacleMap.data();
+}
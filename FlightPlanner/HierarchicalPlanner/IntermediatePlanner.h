@@ -4,9 +4,16 @@
 #include "Position.h"
 #include "UAVOrientation.h"
 #include "UAVParameters.h"
+#include "PlanningRandom.h"
+#include "PlanningContext.h"
 
 #include <QList>
 #include <QPolygonF>
+#include <QAtomicInt>
+#include <QSharedPointer>
+
+class ObstacleMap;
+class TerrainModel;
 
 class IntermediatePlanner
 {
@@ -22,6 +29,33 @@ public:
     virtual bool plan()=0;
     virtual QList<Position> results() const=0;
 
+    /**
+     * @brief takeResults replaces destination's contents with the planned flight and leaves the planner without
+     * it. A list from results() stays shared with the planner, so the first change to it copies every waypoint;
+     * one from takeResults() doesn't. The default copies results().
+     * @param destination
+     */
+    virtual void takeResults(QList<Position> * destination);
+
+    /**
+     * @brief estimateCost returns a cheap, optimistic estimate of how long (in seconds) the transition will take
+     * to fly, without planning it. Useful for ranking or pruning candidate transitions before committing to
+     * plan() any of them. The default is dubinsCostEstimate(), which ignores obstacles.
+     * @return
+     */
+    virtual qreal estimateCost() const;
+
+    /**
+     * @brief dubinsCostEstimate returns the time (in seconds) to fly the shortest Dubins path between two poses,
+     * less one waypoint interval to allow for the waypoints that results() are rounded to. The path itself is
+     * never built or sampled.
+     */
+    static qreal dubinsCostEstimate(const UAVParameters& uavParams,
+                                    const Position& startPos,
+                                    const UAVOrientation& startPose,
+                                    const Position& endPos,
+                                    const UAVOrientation& endPose);
+
     const UAVParameters& uavParams() const;
 
     const Position& startPos() const;
@@ -32,13 +66,115 @@ public:
 
     const QList<QPolygonF>& obstacles() const;
 
+    /**
+     * @brief obstacleMap returns the raster used to speed up obstacle checks, or 0 if there isn't one.
+     * The map is not owned by us and must outlive the planner.
+     * @return
+     */
+    const ObstacleMap * obstacleMap() const;
+    void setObstacleMap(const ObstacleMap * obstacleMap);
+
+    /**
+     * @brief terrain returns the terrain that transitions must stay clear of, or 0 if there isn't any.
+     * Transitions are flown level, so the ground counts as an obstacle wherever it rises above
+     * maxTerrainElevation(): the altitude flown less the clearance required. The model is not owned by us and
+     * must outlive the planner.
+     * @return
+     */
+    const TerrainModel * terrain() const;
+    qreal maxTerrainElevation() const;
+    void setTerrain(const TerrainModel * terrain, qreal maxElevation);
+
+    /**
+     * @brief collidesWithObstacle returns true if pos is inside one of the obstacles or over terrain that's too
+     * high. Uses the obstacle map if one has been set. Otherwise the planner indexes its obstacles on the first
+     * check and tests only the polygons near pos.
+     * @param pos
+     * @return
+     */
+    bool collidesWithObstacle(const Position& pos) const;
+
+    /**
+     * @brief pathCollidesWithObstacle returns true if any segment between consecutive positions of path
+     * crosses or touches an obstacle, or any of its positions is over terrain that's too high.
+     * @param path
+     * @return
+     */
+    bool pathCollidesWithObstacle(const QList<Position>& path) const;
+
+    /**
+     * @brief pathCollidesWithTerrain returns true if the ground under any of the positions of path is above
+     * maxTerrainElevation(). Always false without terrain.
+     * @param path
+     * @return
+     */
+    bool pathCollidesWithTerrain(const QList<Position>& path) const;
+
+    /**
+     * @brief randomSeed is mixed with the start and end poses to seed random(), so a planner given the same
+     * inputs and seed always plans the same flight. Defaults to 0.
+     * @return
+     */
+    quint64 randomSeed() const;
+    void setRandomSeed(quint64 seed);
+
+    /**
+     * @brief setCancelFlag gives the planner a flag that another thread sets (to anything but 0) to ask it to
+     * give up. Planners that search for a long time check it between iterations and return false from plan().
+     * The flag is not owned by us and must outlive the planner. 0 (the default) means plan() always finishes.
+     * @param flag
+     */
+    void setCancelFlag(const QAtomicInt * flag);
+
+    /**
+     * @brief setPlanningContext gives the planner the context of the planning run it's part of. Planners that
+     * search for a long time charge their samples or expansions to it and give up (returning false from plan())
+     * once it's cancelled or its budgets are spent. The context is not owned by us and must outlive the planner.
+     * 0 (the default) means no context.
+     * @param context
+     */
+    void setPlanningContext(const PlanningContext * context);
+    const PlanningContext * planningContext() const;
+
+    /**
+     * @brief cancelRequested returns true if the cancel flag has been set or the planning context says to stop
+     * @return
+     */
+    bool cancelRequested() const;
+
+protected:
+    /**
+     * @brief chargeNodes charges count units of search work to the planning context, if there is one
+     * @param count
+     * @return false if the search should give up, i.e. cancelRequested()
+     */
+    bool chargeNodes(int count = 1) const;
+
+    /**
+     * @brief random returns the generator that stochastic planners should draw from
+     * @return
+     */
+    PlanningRandom& random();
+
 private:
+    const ObstacleMap * _checkingMap() const;
+
     const UAVParameters& _uavParams;
     const Position& _startPos;
     const UAVOrientation& _startPose;
     const Position& _endPos;
     const UAVOrientation& _endPose;
     const QList<QPolygonF>& _obstacles;
+    const ObstacleMap * _obstacleMap;
+    //Built from _obstacles (with no raster) the first time it's needed when no obstacle map was set
+    mutable QSharedPointer<const ObstacleMap> _ownObstacleMap;
+    const TerrainModel * _terrain;
+    qreal _maxTerrainElevation;
+    const QAtomicInt * _cancelFlag;
+    const PlanningContext * _planningContext;
+
+    quint64 _randomSeed;
+    PlanningRandom _random;
 };
 
 #endif // INTERMEDIATEPLANNER_H
@@ -0,0 +1,200 @@
+#include "IntermediatePlannerRegistry.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include "DubinsIntermediate/DubinsIntermediatePlanner.h"
+#include "VisibilityGraphIntermediatePlanner/VisibilityGraphIntermediatePlanner.h"
+#include "AstarPRMIntermediatePlanner/AstarPRMIntermediatePlanner.h"
+#include "RRTIntermediatePlanner/RRTIntermediatePlanner.h"
+#include "RRTStarIntermediatePlanner/RRTStarIntermediatePlanner.h"
+#include "PhonyIntermediatePlanner/PhonyIntermediatePlanner.h"
+#include "PlannerTuning.h"
+
+//non-member
+static IntermediatePlanner * createDubins(const UAVParameters& uavParams,
+                                          const Position& startPos, const UAVOrientation& startPose,
+                                          const Position& endPos, const UAVOrientation& endPose,
+                                          const QList<QPolygonF>& obstacles,
+                                          const IntermediatePlannerRegistry::Context&)
+{
+    return new DubinsIntermediatePlanner(uavParams, startPos, startPose, endPos, endPose, obstacles);
+}
+
+//non-member
+//Building a visibility graph for every transition would cost more than it saves, so it needs a shared one
+static IntermediatePlanner * createVisibilityGraph(const UAVParameters& uavParams,
+                                                   const Position& startPos, const UAVOrientation& startPose,
+                                                   const Position& endPos, const UAVOrientation& endPose,
+                                                   const QList<QPolygonF>& obstacles,
+                                                   const IntermediatePlannerRegistry::Context& context)
+{
+    if (context.visibilityGraph == 0)
+        return 0;
+    VisibilityGraphIntermediatePlanner * toRet = new VisibilityGraphIntermediatePlanner(uavParams,
+                                                                                        startPos, startPose,
+                                                                                        endPos, endPose,
+                                                                                        obstacles);
+    toRet->setVisibilityGraph(context.visibilityGraph);
+    return toRet;
+}
+
+//non-member
+static IntermediatePlanner * createAstarPRM(const UAVParameters& uavParams,
+                                            const Position& startPos, const UAVOrientation& startPose,
+                                            const Position& endPos, const UAVOrientation& endPose,
+                                            const QList<QPolygonF>& obstacles,
+                                            const IntermediatePlannerRegistry::Context& context)
+{
+    AstarPRMIntermediatePlanner * toRet = new AstarPRMIntermediatePlanner(uavParams,
+                                                                          startPos, startPose,
+                                                                          endPos, endPose,
+                                                                          obstacles);
+    toRet->setRoadmap(context.roadmap);
+    if (context.tuning != 0)
+        toRet->setGranularity(context.tuning->latticeGranularity());
+    return toRet;
+}
+
+//non-member
+static IntermediatePlanner * createRRT(const UAVParameters& uavParams,
+                                       const Position& startPos, const UAVOrientation& startPose,
+                                       const Position& endPos, const UAVOrientation& endPose,
+                                       const QList<QPolygonF>& obstacles,
+                                       const IntermediatePlannerRegistry::Context& context)
+{
+    RRTIntermediatePlanner * toRet = new RRTIntermediatePlanner(uavParams,
+                                                                startPos, startPose,
+                                                                endPos, endPose,
+                                                                obstacles);
+    if (context.tuning != 0)
+    {
+        toRet->setBranchesPerSide(context.tuning->rrtBranchesPerSide());
+        toRet->setMaxSamples(context.tuning->rrtMaxSamples());
+    }
+    return toRet;
+}
+
+//non-member
+static IntermediatePlanner * createRRTConnect(const UAVParameters& uavParams,
+                                              const Position& startPos, const UAVOrientation& startPose,
+                                              const Position& endPos, const UAVOrientation& endPose,
+                                              const QList<QPolygonF>& obstacles,
+                                              const IntermediatePlannerRegistry::Context& context)
+{
+    RRTIntermediatePlanner * toRet = static_cast<RRTIntermediatePlanner *>(createRRT(uavParams,
+                                                                                     startPos, startPose,
+                                                                                     endPos, endPose,
+                                                                                     obstacles, context));
+    toRet->setBidirectional(true);
+    return toRet;
+}
+
+//non-member
+static IntermediatePlanner * createRRTStar(const UAVParameters& uavParams,
+                                           const Position& startPos, const UAVOrientation& startPose,
+                                           const Position& endPos, const UAVOrientation& endPose,
+                                           const QList<QPolygonF>& obstacles,
+                                           const IntermediatePlannerRegistry::Context& context)
+{
+    RRTStarIntermediatePlanner * toRet = new RRTStarIntermediatePlanner(uavParams,
+                                                                        startPos, startPose,
+                                                                        endPos, endPose,
+                                                                        obstacles);
+    if (context.tuning != 0)
+        toRet->setMaxIterations(context.tuning->rrtStarMaxIterations());
+    return toRet;
+}
+
+//non-member
+static IntermediatePlanner * createPhony(const UAVParameters& uavParams,
+                                         const Position& startPos, const UAVOrientation& startPose,
+                                         const Position& endPos, const UAVOrientation& endPose,
+                                         const QList<QPolygonF>& obstacles,
+                                         const IntermediatePlannerRegistry::Context&)
+{
+    return new PhonyIntermediatePlanner(uavParams, startPos, startPose, endPos, endPose, obstacles);
+}
+
+//non-member
+//The factories by name, with the built-in ones registered up front
+class RegistryData
+{
+public:
+    RegistryData()
+    {
+        factories.insert("Dubins", createDubins);
+        factories.insert("VisibilityGraph", createVisibilityGraph);
+        factories.insert("AstarPRM", createAstarPRM);
+        factories.insert("RRT", createRRT);
+        factories.insert("RRTConnect", createRRTConnect);
+        factories.insert("RRTStar", createRRTStar);
+        factories.insert("Phony", createPhony);
+    }
+
+    QMutex lock;
+    QHash<QString, IntermediatePlannerRegistry::Factory> factories;
+};
+Q_GLOBAL_STATIC(RegistryData, registryData)
+
+IntermediatePlannerRegistry::Context::Context() :
+    obstacleMap(0), roadmap(0), visibilityGraph(0), planningContext(0), terrain(0), maxTerrainElevation(0.0),
+    tuning(0)
+{
+}
+
+//static
+void IntermediatePlannerRegistry::registerPlanner(const QString &name, IntermediatePlannerRegistry::Factory factory)
+{
+    RegistryData * data = registryData();
+    QMutexLocker locker(&data->lock);
+    data->factories.insert(name, factory);
+}
+
+//static
+bool IntermediatePlannerRegistry::contains(const QString &name)
+{
+    RegistryData * data = registryData();
+    QMutexLocker locker(&data->lock);
+    return data->factories.contains(name);
+}
+
+//static
+QStringList IntermediatePlannerRegistry::names()
+{
+    RegistryData * data = registryData();
+    QMutexLocker locker(&data->lock);
+    QStringList toRet = data->factories.keys();
+    toRet.sort();
+    return toRet;
+}
+
+//static
+IntermediatePlanner *IntermediatePlannerRegistry::create(const QString &name,
+                                                         const UAVParameters &uavParams,
+                                                         const Position &startPos,
+                                                         const UAVOrientation &startPose,
+                                                         const Position &endPos,
+                                                         const UAVOrientation &endPose,
+                                                         const QList<QPolygonF> &obstacles,
+                                                         const IntermediatePlannerRegistry::Context &context)
+{
+    Factory factory = 0;
+    {
+        RegistryData * data = registryData();
+        QMutexLocker locker(&data->lock);
+        factory = data->factories.value(name, 0);
+    }
+    if (factory == 0)
+        return 0;
+
+    IntermediatePlanner * toRet = factory(uavParams, startPos, startPose, endPos, endPose, obstacles, context);
+    if (toRet != 0)
+    {
+        toRet->setObstacleMap(context.obstacleMap);
+        toRet->setTerrain(context.terrain, context.maxTerrainElevation);
+        toRet->setPlanningContext(context.planningContext);
+    }
+    return toRet;
+}
@@ -0,0 +1,83 @@
+#ifndef INTERMEDIATEPLANNERREGISTRY_H
+#define INTERMEDIATEPLANNERREGISTRY_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QPolygonF>
+
+#include "IntermediatePlanner.h"
+
+class ProbabilisticRoadmap;
+class VisibilityGraph;
+class PlanningContext;
+class TerrainModel;
+class PlannerTuning;
+
+/**
+ * @brief The IntermediatePlannerRegistry class creates IntermediatePlanners by name, so that which planners a
+ * transition is planned with (and in what order) is a setting rather than code. The built-in planners are
+ * registered as "Dubins", "VisibilityGraph", "AstarPRM", "RRT", "RRTConnect", "RRTStar" and "Phony". Others
+ * can be added with registerPlanner().
+ *
+ * The registry is safe to use from many threads at once.
+ */
+class IntermediatePlannerRegistry
+{
+public:
+    //What a planning run shares between its transitions. Any of it may be missing (0).
+    struct Context
+    {
+        Context();
+
+        const ObstacleMap * obstacleMap;
+        const ProbabilisticRoadmap * roadmap;
+        const VisibilityGraph * visibilityGraph;
+        const PlanningContext * planningContext;
+
+        //Terrain that transitions must not fly over where it's higher than maxTerrainElevation
+        const TerrainModel * terrain;
+        qreal maxTerrainElevation;
+
+        //The built-in planners take their search parameters from here, or use their defaults if it's missing
+        const PlannerTuning * tuning;
+    };
+
+    /**
+     * @brief Factory creates a planner for one transition, or returns 0 if it can't plan with what's in the
+     * context (e.g., a planner that needs a shared graph when there isn't one).
+     */
+    typedef IntermediatePlanner * (*Factory)(const UAVParameters& uavParams,
+                                             const Position& startPos,
+                                             const UAVOrientation& startPose,
+                                             const Position& endPos,
+                                             const UAVOrientation& endPose,
+                                             const QList<QPolygonF>& obstacles,
+                                             const Context& context);
+
+    /**
+     * @brief registerPlanner adds a planner under name, replacing whatever was registered under it before
+     * @param name
+     * @param factory
+     */
+    static void registerPlanner(const QString& name, Factory factory);
+
+    static bool contains(const QString& name);
+    static QStringList names();
+
+    /**
+     * @brief create returns a new planner (owned by the caller) of the kind registered under name, with the
+     * context's obstacle map, terrain and planning context set. Returns 0 if nothing is registered under name or if the planner can't be
+     * used with context. The poses and obstacles are referenced, not copied, so they must outlive the planner.
+     */
+    static IntermediatePlanner * create(const QString& name,
+                                        const UAVParameters& uavParams,
+                                        const Position& startPos,
+                                        const UAVOrientation& startPose,
+                                        const Position& endPos,
+                                        const UAVOrientation& endPose,
+                                        const QList<QPolygonF>& obstacles,
+                                        const Context& context);
+};
+
+#endif // INTERMEDIATEPLANNERREGISTRY_H
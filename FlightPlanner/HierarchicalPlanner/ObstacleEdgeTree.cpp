@@ -0,0 +1,206 @@
+#include "ObstacleEdgeTree.h"
+
+#include <algorithm>
+
+const int LEAF_SIZE = 4;
+
+/*
+ * Orders edges by their midpoint along one axis. Used to split edge ranges at the median.
+*/
+struct EdgeMidpointLess
+{
+    EdgeMidpointLess(bool xAxis) : _xAxis(xAxis) {}
+
+    bool operator()(const QLineF& a, const QLineF& b) const
+    {
+        if (_xAxis)
+            return (a.x1() + a.x2()) < (b.x1() + b.x2());
+        return (a.y1() + a.y2()) < (b.y1() + b.y2());
+    }
+
+    bool _xAxis;
+};
+
+//non-member
+static qreal orientation(const QPointF& a, const QPointF& b, const QPointF& c)
+{
+    return (b.x() - a.x()) * (c.y() - a.y()) - (b.y() - a.y()) * (c.x() - a.x());
+}
+
+//non-member
+//True if c (known to be collinear with ab) lies within ab's bounding box
+static bool onSegment(const QPointF& a, const QPointF& b, const QPointF& c)
+{
+    return c.x() >= qMin<qreal>(a.x(), b.x()) && c.x() <= qMax<qreal>(a.x(), b.x())
+            && c.y() >= qMin<qreal>(a.y(), b.y()) && c.y() <= qMax<qreal>(a.y(), b.y());
+}
+
+ObstacleEdgeTree::ObstacleEdgeTree()
+{
+}
+
+ObstacleEdgeTree::ObstacleEdgeTree(const QList<QPolygonF> &obstacles)
+{
+    this->build(obstacles);
+}
+
+void ObstacleEdgeTree::build(const QList<QPolygonF> &obstacles)
+{
+    _edges.clear();
+    _nodes.clear();
+
+    foreach(const QPolygonF& obstacle, obstacles)
+    {
+        if (obstacle.size() < 3)
+            continue;
+        //Obstacles are treated as closed whether or not the last point repeats the first one
+        for (int i = 0; i < obstacle.size(); i++)
+        {
+            const QPointF& a = obstacle.at(i);
+            const QPointF& b = obstacle.at((i + 1) % obstacle.size());
+            if (a != b)
+                _edges.append(QLineF(a, b));
+        }
+    }
+
+    if (_edges.isEmpty())
+        return;
+
+    //A binary tree with LEAF_SIZE edges per leaf has fewer than this many nodes
+    _nodes.reserve(2 * (_edges.size() / LEAF_SIZE + 1));
+    _build(0, _edges.size());
+}
+
+bool ObstacleEdgeTree::isEmpty() const
+{
+    return _nodes.isEmpty();
+}
+
+int ObstacleEdgeTree::edgeCount() const
+{
+    return _edges.size();
+}
+
+QRectF ObstacleEdgeTree::bounds() const
+{
+    if (_nodes.isEmpty())
+        return QRectF();
+    const Node& root = _nodes.at(0);
+    return QRectF(QPointF(root.minX, root.minY), QPointF(root.maxX, root.maxY));
+}
+
+bool ObstacleEdgeTree::intersects(const QPointF &a, const QPointF &b) const
+{
+    if (_nodes.isEmpty())
+        return false;
+
+    const qreal minX = qMin<qreal>(a.x(), b.x());
+    const qreal maxX = qMax<qreal>(a.x(), b.x());
+    const qreal minY = qMin<qreal>(a.y(), b.y());
+    const qreal maxY = qMax<qreal>(a.y(), b.y());
+
+    //The tree is balanced so the stack never gets deeper than a few dozen nodes
+    int stack[64];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0)
+    {
+        const Node& node = _nodes.at(stack[--stackSize]);
+        if (node.maxX < minX || node.minX > maxX || node.maxY < minY || node.minY > maxY)
+            continue;
+
+        if (node.left < 0)
+        {
+            for (int i = node.first; i < node.first + node.count; i++)
+            {
+                const QLineF& edge = _edges.at(i);
+                if (ObstacleEdgeTree::segmentsIntersect(a, b, edge.p1(), edge.p2()))
+                    return true;
+            }
+            continue;
+        }
+
+        stack[stackSize++] = node.left;
+        stack[stackSize++] = node.right;
+    }
+    return false;
+}
+
+//static
+bool ObstacleEdgeTree::segmentsIntersect(const QPointF &a, const QPointF &b,
+                                         const QPointF &c, const QPointF &d)
+{
+    const qreal o1 = orientation(a, b, c);
+    const qreal o2 = orientation(a, b, d);
+    const qreal o3 = orientation(c, d, a);
+    const qreal o4 = orientation(c, d, b);
+
+    //Proper crossing
+    if (((o1 > 0 && o2 < 0) || (o1 < 0 && o2 > 0))
+            && ((o3 > 0 && o4 < 0) || (o3 < 0 && o4 > 0)))
+        return true;
+
+    //Touching or collinear overlap
+    if (o1 == 0 && onSegment(a, b, c))
+        return true;
+    if (o2 == 0 && onSegment(a, b, d))
+        return true;
+    if (o3 == 0 && onSegment(c, d, a))
+        return true;
+    if (o4 == 0 && onSegment(c, d, b))
+        return true;
+    return false;
+}
+
+//private
+int ObstacleEdgeTree::_build(int first, int count)
+{
+    const int index = _nodes.size();
+    _nodes.append(Node());
+
+    Node node;
+    node.minX = node.minY = 0.0;
+    node.maxX = node.maxY = 0.0;
+    for (int i = first; i < first + count; i++)
+    {
+        const QLineF& edge = _edges.at(i);
+        const qreal eMinX = qMin<qreal>(edge.x1(), edge.x2());
+        const qreal eMaxX = qMax<qreal>(edge.x1(), edge.x2());
+        const qreal eMinY = qMin<qreal>(edge.y1(), edge.y2());
+        const qreal eMaxY = qMax<qreal>(edge.y1(), edge.y2());
+        if (i == first)
+        {
+            node.minX = eMinX;
+            node.maxX = eMaxX;
+            node.minY = eMinY;
+            node.maxY = eMaxY;
+            continue;
+        }
+        node.minX = qMin<qreal>(node.minX, eMinX);
+        node.maxX = qMax<qreal>(node.maxX, eMaxX);
+        node.minY = qMin<qreal>(node.minY, eMinY);
+        node.maxY = qMax<qreal>(node.maxY, eMaxY);
+    }
+
+    if (count <= LEAF_SIZE)
+    {
+        node.left = node.right = -1;
+        node.first = first;
+        node.count = count;
+        _nodes[index] = node;
+        return index;
+    }
+
+    //Split at the median edge along the longer side of the box
+    const int half = count / 2;
+    const EdgeMidpointLess less((node.maxX - node.minX) >= (node.maxY - node.minY));
+    std::nth_element(_edges.begin() + first, _edges.begin() + first + half, _edges.begin() + first + count, less);
+
+    node.first = first;
+    node.count = count;
+    node.left = _build(first, half);
+    node.right = _build(first + half, count - half);
+    _nodes[index] = node;
+    return index;
+}
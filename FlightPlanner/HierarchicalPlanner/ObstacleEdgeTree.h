@@ -0,0 +1,73 @@
+#ifndef OBSTACLEEDGETREE_H
+#define OBSTACLEEDGETREE_H
+
+#include <QtGlobal>
+#include <QList>
+#include <QVector>
+#include <QPolygonF>
+#include <QLineF>
+#include <QRectF>
+
+/**
+ * @brief The ObstacleEdgeTree class is a bounding volume hierarchy over the edges of a set of obstacle
+ * polygons. It answers "does this line segment cross an obstacle boundary" by descending only into the
+ * boxes that the segment's bounding box overlaps.
+ *
+ * The tree is stored in flat arrays and is immutable once built, so it's cheap to query from many threads.
+ */
+class ObstacleEdgeTree
+{
+public:
+    ObstacleEdgeTree();
+    ObstacleEdgeTree(const QList<QPolygonF>& obstacles);
+
+    void build(const QList<QPolygonF>& obstacles);
+
+    bool isEmpty() const;
+
+    int edgeCount() const;
+
+    /**
+     * @brief bounds returns the bounding box of every edge in the tree.
+     * @return
+     */
+    QRectF bounds() const;
+
+    /**
+     * @brief intersects returns true if the segment from a to b touches or crosses any obstacle edge.
+     * @param a
+     * @param b
+     * @return
+     */
+    bool intersects(const QPointF& a, const QPointF& b) const;
+
+    /**
+     * @brief segmentsIntersect returns true if segment ab and segment cd share at least one point.
+     */
+    static bool segmentsIntersect(const QPointF& a, const QPointF& b,
+                                  const QPointF& c, const QPointF& d);
+
+public:
+    struct Node
+    {
+        //Not a QRectF, since horizontal and vertical edges have empty boxes that QRectF won't intersect
+        qreal minX;
+        qreal minY;
+        qreal maxX;
+        qreal maxY;
+        //Children for interior nodes, -1 for leaves
+        int left;
+        int right;
+        //Range of _edges for leaves
+        int first;
+        int count;
+    };
+
+private:
+    int _build(int first, int count);
+
+    QVector<QLineF> _edges;
+    QVector<Node> _nodes;
+};
+
+#endif // OBSTACLEEDGETREE_H
@@ -0,0 +1,254 @@
+#include "ObstacleMap.h"
+
+#include "guts/Conversions.h"
+
+#include <QVector>
+#include <cmath>
+#include <algorithm>
+
+ObstacleMap::ObstacleMap(const QList<QPolygonF> &obstacles, qreal resolution, int maxCells) :
+    _obstacles(obstacles), _cellWidth(1.0), _cellHeight(1.0), _columns(0), _rows(0), _edgeTree(obstacles)
+{
+    QVector<QRectF> obstacleBounds;
+    for (int i = 0; i < _obstacles.size(); i++)
+    {
+        const QPolygonF& obstacle = _obstacles.at(i);
+        if (obstacle.size() < 3)
+            continue;
+        const QRectF box = obstacle.boundingRect();
+        obstacleBounds.append(box);
+        _indexedObstacles.append(i);
+        _bounds = _bounds.isNull() ? box : _bounds.united(box);
+    }
+    _obstacleIndex.build(obstacleBounds);
+
+    if (_bounds.isNull() || resolution <= 0.0)
+        return;
+
+    //Cells are square in meters, which means they're not square in degrees
+    const qreal lat = _bounds.center().y();
+    _cellWidth = resolution * Conversions::degreesLonPerMeter(lat);
+    _cellHeight = resolution * Conversions::degreesLatPerMeter(lat);
+
+    qreal columns = qMax<qreal>(1.0, ceil(_bounds.width() / _cellWidth));
+    qreal rows = qMax<qreal>(1.0, ceil(_bounds.height() / _cellHeight));
+    maxCells = qMax<int>(1, maxCells);
+    if (columns * rows > maxCells)
+    {
+        const qreal scale = sqrt(columns * rows / maxCells);
+        _cellWidth *= scale;
+        _cellHeight *= scale;
+        columns = qMax<qreal>(1.0, ceil(_bounds.width() / _cellWidth));
+        rows = qMax<qreal>(1.0, ceil(_bounds.height() / _cellHeight));
+    }
+    _columns = (int)columns;
+    _rows = (int)rows;
+
+    _occupied.resize(_columns * _rows);
+    _edge.resize(_columns * _rows);
+
+    //First find every cell that a polygon edge passes through. Those are the ones we can't answer with one bit.
+    foreach(const QPolygonF& obstacle, _obstacles)
+    {
+        if (obstacle.size() < 3)
+            continue;
+        for (int i = 0; i < obstacle.size(); i++)
+            _markEdgeCells(obstacle.at(i), obstacle.at((i + 1) % obstacle.size()));
+    }
+
+    /*
+     * Then scan each row of cell centers with the even-odd rule, one polygon at a time so that overlapping
+     * obstacles union instead of cancelling out. Edge cells get filled in too but they're never read.
+    */
+    QVector<qreal> crossings;
+    foreach(const QPolygonF& obstacle, _obstacles)
+    {
+        if (obstacle.size() < 3)
+            continue;
+        const QRectF box = obstacle.boundingRect();
+        const int firstRow = qMax<int>(0, (int)floor((box.top() - _bounds.top()) / _cellHeight));
+        const int lastRow = qMin<int>(_rows - 1, (int)floor((box.bottom() - _bounds.top()) / _cellHeight));
+
+        for (int row = firstRow; row <= lastRow; row++)
+        {
+            const qreal y = _bounds.top() + (row + 0.5) * _cellHeight;
+
+            crossings.clear();
+            for (int i = 0; i < obstacle.size(); i++)
+            {
+                const QPointF& a = obstacle.at(i);
+                const QPointF& b = obstacle.at((i + 1) % obstacle.size());
+                if ((a.y() <= y) == (b.y() <= y))
+                    continue;
+                crossings.append(a.x() + (y - a.y()) * (b.x() - a.x()) / (b.y() - a.y()));
+            }
+            std::sort(crossings.begin(), crossings.end());
+
+            for (int i = 0; i + 1 < crossings.size(); i += 2)
+            {
+                const int firstCol = qMax<int>(0, (int)ceil((crossings[i] - _bounds.left()) / _cellWidth - 0.5));
+                const int lastCol = qMin<int>(_columns - 1,
+                                              (int)floor((crossings[i + 1] - _bounds.left()) / _cellWidth - 0.5));
+                for (int col = firstCol; col <= lastCol; col++)
+                    _occupied.setBit(_cellIndex(col, row));
+            }
+        }
+    }
+}
+
+const QList<QPolygonF> &ObstacleMap::obstacles() const
+{
+    return _obstacles;
+}
+
+bool ObstacleMap::hasRaster() const
+{
+    return (_columns > 0 && _rows > 0);
+}
+
+bool ObstacleMap::contains(const QPointF &lonLat) const
+{
+    //Nothing outside the obstacles' bounding box can be inside an obstacle
+    if (_bounds.isNull())
+        return false;
+    if (lonLat.x() < _bounds.left() || lonLat.x() > _bounds.right()
+            || lonLat.y() < _bounds.top() || lonLat.y() > _bounds.bottom())
+        return false;
+
+    if (!this->hasRaster())
+        return _containsExact(lonLat);
+
+    const int col = qMin<int>(_columns - 1, (int)((lonLat.x() - _bounds.left()) / _cellWidth));
+    const int row = qMin<int>(_rows - 1, (int)((lonLat.y() - _bounds.top()) / _cellHeight));
+    const int index = _cellIndex(col, row);
+
+    if (_edge.testBit(index))
+        return _containsExact(lonLat);
+    return _occupied.testBit(index);
+}
+
+bool ObstacleMap::contains(const Position &pos) const
+{
+    return this->contains(pos.lonLat());
+}
+
+bool ObstacleMap::segmentCollides(const QPointF &a, const QPointF &b) const
+{
+    //If the start is outside then the segment can only get inside by crossing an edge
+    if (this->contains(a))
+        return true;
+    return _edgeTree.intersects(a, b);
+}
+
+bool ObstacleMap::pathCollides(const QList<Position> &path, int *firstSegmentOut) const
+{
+    if (path.isEmpty() || _bounds.isNull())
+        return false;
+
+    if (path.size() == 1)
+    {
+        if (!this->contains(path.first()))
+            return false;
+        if (firstSegmentOut)
+            *firstSegmentOut = 0;
+        return true;
+    }
+
+    //Most transition flights never come near an obstacle. Throw those out with one box test.
+    QPointF pathMin = path.first().lonLat();
+    QPointF pathMax = pathMin;
+    foreach(const Position& pos, path)
+    {
+        pathMin.setX(qMin<qreal>(pathMin.x(), pos.longitude()));
+        pathMin.setY(qMin<qreal>(pathMin.y(), pos.latitude()));
+        pathMax.setX(qMax<qreal>(pathMax.x(), pos.longitude()));
+        pathMax.setY(qMax<qreal>(pathMax.y(), pos.latitude()));
+    }
+    if (pathMax.x() < _bounds.left() || pathMin.x() > _bounds.right()
+            || pathMax.y() < _bounds.top() || pathMin.y() > _bounds.bottom())
+        return false;
+
+    for (int i = 0; i < path.size() - 1; i++)
+    {
+        if (!this->segmentCollides(path.at(i).lonLat(), path.at(i + 1).lonLat()))
+            continue;
+        if (firstSegmentOut)
+            *firstSegmentOut = i;
+        return true;
+    }
+    return false;
+}
+
+void ObstacleMap::obstaclesNear(const QRectF &rect, QVector<int> *output) const
+{
+    if (output == 0)
+        return;
+
+    const int first = output->size();
+    _obstacleIndex.intersecting(rect, output);
+    for (int i = first; i < output->size(); i++)
+        (*output)[i] = _indexedObstacles.at(output->at(i));
+}
+
+const ObstacleEdgeTree &ObstacleMap::edgeTree() const
+{
+    return _edgeTree;
+}
+
+int ObstacleMap::columns() const
+{
+    return _columns;
+}
+
+int ObstacleMap::rows() const
+{
+    return _rows;
+}
+
+int ObstacleMap::edgeCellCount() const
+{
+    return _edge.count(true);
+}
+
+//private
+void ObstacleMap::_markEdgeCells(const QPointF &a, const QPointF &b)
+{
+    /*
+     * Sample the edge at no more than half a cell apart in either direction. Every cell the edge touches is
+     * then within one cell of a sample, so marking each sample's 3x3 neighborhood is conservative.
+    */
+    const qreal spanCells = qMax<qreal>(fabs(b.x() - a.x()) / _cellWidth, fabs(b.y() - a.y()) / _cellHeight);
+    const int steps = (int)ceil(2.0 * spanCells) + 1;
+
+    for (int i = 0; i <= steps; i++)
+    {
+        const qreal t = (qreal)i / steps;
+        const qreal x = a.x() + t * (b.x() - a.x());
+        const qreal y = a.y() + t * (b.y() - a.y());
+        const int col = (int)floor((x - _bounds.left()) / _cellWidth);
+        const int row = (int)floor((y - _bounds.top()) / _cellHeight);
+
+        for (int r = qMax<int>(0, row - 1); r <= qMin<int>(_rows - 1, row + 1); r++)
+            for (int c = qMax<int>(0, col - 1); c <= qMin<int>(_columns - 1, col + 1); c++)
+                _edge.setBit(_cellIndex(c, r));
+    }
+}
+
+//private
+bool ObstacleMap::_containsExact(const QPointF &lonLat) const
+{
+    QVector<int> nearby;
+    this->obstaclesNear(QRectF(lonLat, QSizeF(0.0, 0.0)), &nearby);
+    foreach(int i, nearby)
+    {
+        if (_obstacles.at(i).containsPoint(lonLat, Qt::OddEvenFill))
+            return true;
+    }
+    return false;
+}
+
+//private
+int ObstacleMap::_cellIndex(int col, int row) const
+{
+    return row * _columns + col;
+}
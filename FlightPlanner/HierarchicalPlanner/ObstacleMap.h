@@ -0,0 +1,115 @@
+#ifndef OBSTACLEMAP_H
+#define OBSTACLEMAP_H
+
+#include <QtGlobal>
+#include <QList>
+#include <QPolygonF>
+#include <QRectF>
+#include <QBitArray>
+#include <QVector>
+
+#include "Position.h"
+#include "ObstacleEdgeTree.h"
+#include "RectIndex.h"
+
+/**
+ * @brief The ObstacleMap class answers "is this point inside a no-fly zone" with a raster lookup instead of
+ * testing every obstacle polygon.
+ *
+ * The bounding box of the obstacles is cut into square cells. Cells that no polygon edge passes through are
+ * entirely inside or entirely outside of the obstacles, so their answer is stored as one bit. Cells that an
+ * edge does pass through fall back to an exact containsPoint() test against the polygons, so results always
+ * match a brute-force test with Qt::OddEvenFill. The exact test only visits the polygons whose bounding boxes
+ * hold the point, found with an R-tree over the boxes.
+ *
+ * Segments and sampled paths are checked with an ObstacleEdgeTree over the polygon edges: a segment is in
+ * collision if its start is inside an obstacle or if it touches an obstacle edge anywhere along its length.
+ *
+ * An ObstacleMap is immutable once built and safe to query from many threads at once.
+ */
+class ObstacleMap
+{
+public:
+    /**
+     * @brief ObstacleMap
+     * @param obstacles no-fly polygons in lon/lat
+     * @param resolution edge length (in meters) of the raster cells. The resolution is coarsened if the raster
+     * would otherwise have more than maxCells cells. 0 builds no raster, so every point gets the exact test.
+     * @param maxCells
+     */
+    ObstacleMap(const QList<QPolygonF>& obstacles,
+                qreal resolution = 50.0,
+                int maxCells = 4 * 1024 * 1024);
+
+    const QList<QPolygonF>& obstacles() const;
+
+    /**
+     * @brief hasRaster returns false if no raster cells were built (no obstacles, or a resolution of 0).
+     * @return
+     */
+    bool hasRaster() const;
+
+    bool contains(const QPointF& lonLat) const;
+    bool contains(const Position& pos) const;
+
+    /**
+     * @brief segmentCollides returns true if any part of the straight (in lon/lat) segment from a to b is
+     * inside or on the boundary of an obstacle.
+     * @param a
+     * @param b
+     * @return
+     */
+    bool segmentCollides(const QPointF& a, const QPointF& b) const;
+
+    /**
+     * @brief pathCollides checks every segment of a sampled path at once. A single-position path is checked
+     * as a point.
+     * @param path
+     * @param firstSegmentOut if not null, set to the index of the first colliding segment (or point)
+     * @return true if any segment collides
+     */
+    bool pathCollides(const QList<Position>& path, int * firstSegmentOut = 0) const;
+
+    /**
+     * @brief obstaclesNear appends the index (into obstacles()) of every obstacle whose bounding box overlaps
+     * rect. Obstacles with fewer than three points are never listed.
+     * @param rect in lon/lat
+     * @param output
+     */
+    void obstaclesNear(const QRectF& rect, QVector<int> * output) const;
+
+    const ObstacleEdgeTree& edgeTree() const;
+
+    int columns() const;
+    int rows() const;
+
+    /**
+     * @brief edgeCellCount returns the number of cells that need an exact polygon test.
+     * @return
+     */
+    int edgeCellCount() const;
+
+private:
+    void _markEdgeCells(const QPointF& a, const QPointF& b);
+    bool _containsExact(const QPointF& lonLat) const;
+    int _cellIndex(int col, int row) const;
+
+    QList<QPolygonF> _obstacles;
+    QRectF _bounds;
+    qreal _cellWidth;
+    qreal _cellHeight;
+    int _columns;
+    int _rows;
+
+    QBitArray _occupied;
+    QBitArray _edge;
+
+    ObstacleEdgeTree _edgeTree;
+
+    //Bounding boxes of the obstacles with at least three points. _indexedObstacles maps the index's ids back
+    //to positions in _obstacles.
+    RectIndex _obstacleIndex;
+    QVector<int> _indexedObstacles;
+};
+
+#endif // OBSTACLEMAP_H
@@ -43,3 +43,9 @@ QList<Position> PhonyIntermediatePlanner::results() const
 {
     return _results;
 }
+
+void PhonyIntermediatePlanner::takeResults(QList<Position> *destination)
+{
+    destination->clear();
+    destination->swap(_results);
+}
@@ -16,6 +16,7 @@ public:
 
     virtual bool plan();
     virtual QList<Position> results() const;
+    virtual void takeResults(QList<Position> * destination);
 
 private:
     QList<Position> _results;
@@ -0,0 +1,113 @@
+#include "PlanningResultCache.h"
+
+PlanningResultCache::PlanningResultCache()
+{
+}
+
+//static
+quint64 PlanningResultCache::hash(const QByteArray &bytes, quint64 hash)
+{
+    const uchar * data = reinterpret_cast<const uchar *>(bytes.constData());
+    for (int i = 0; i < bytes.size(); i++)
+    {
+        hash ^= data[i];
+        hash *= Q_UINT64_C(1099511628211);
+    }
+    return hash;
+}
+
+bool PlanningResultCache::lookupEndpoints(quint64 key, Position *first, Position *second) const
+{
+    QHash<quint64, Endpoints>::const_iterator iter = _endpoints.constFind(key);
+    if (iter == _endpoints.constEnd())
+        return false;
+
+    *first = iter.value().first;
+    *second = iter.value().second;
+    return true;
+}
+
+void PlanningResultCache::insertEndpoints(quint64 key, const Position &first, const Position &second)
+{
+    Endpoints toInsert;
+    toInsert.first = first;
+    toInsert.second = second;
+    _endpoints.insert(key, toInsert);
+}
+
+bool PlanningResultCache::lookupSubFlight(quint64 key, QList<Position> *subFlight) const
+{
+    QHash<quint64, QList<Position> >::const_iterator iter = _subFlights.constFind(key);
+    if (iter == _subFlights.constEnd())
+        return false;
+
+    *subFlight = iter.value();
+    return true;
+}
+
+void PlanningResultCache::insertSubFlight(quint64 key, const QList<Position> &subFlight)
+{
+    _subFlights.insert(key, subFlight);
+}
+
+void PlanningResultCache::retainOnly(const QSet<quint64> &keys)
+{
+    QMutableHashIterator<quint64, Endpoints> endpointIter(_endpoints);
+    while (endpointIter.hasNext())
+    {
+        if (!keys.contains(endpointIter.next().key()))
+            endpointIter.remove();
+    }
+
+    QMutableHashIterator<quint64, QList<Position> > flightIter(_subFlights);
+    while (flightIter.hasNext())
+    {
+        if (!keys.contains(flightIter.next().key()))
+            flightIter.remove();
+    }
+}
+
+void PlanningResultCache::clear()
+{
+    _endpoints.clear();
+    _subFlights.clear();
+}
+
+int PlanningResultCache::size() const
+{
+    return _endpoints.size() + _subFlights.size();
+}
+
+void PlanningResultCache::serialize(QDataStream &stream) const
+{
+    stream << (quint32)_endpoints.size();
+    QHash<quint64, Endpoints>::const_iterator endpointIter;
+    for (endpointIter = _endpoints.constBegin(); endpointIter != _endpoints.constEnd(); endpointIter++)
+        stream << endpointIter.key() << endpointIter.value().first << endpointIter.value().second;
+
+    stream << _subFlights;
+}
+
+bool PlanningResultCache::deserialize(QDataStream &stream)
+{
+    quint32 numEndpoints;
+    stream >> numEndpoints;
+    for (quint32 i = 0; i < numEndpoints && stream.status() == QDataStream::Ok; i++)
+    {
+        quint64 key;
+        Position first;
+        Position second;
+        stream >> key >> first >> second;
+        this->insertEndpoints(key, first, second);
+    }
+
+    QHash<quint64, QList<Position> > subFlights;
+    stream >> subFlights;
+    if (stream.status() != QDataStream::Ok)
+        return false;
+
+    QHash<quint64, QList<Position> >::const_iterator flightIter;
+    for (flightIter = subFlights.constBegin(); flightIter != subFlights.constEnd(); flightIter++)
+        _subFlights.insert(flightIter.key(), flightIter.value());
+    return true;
+}
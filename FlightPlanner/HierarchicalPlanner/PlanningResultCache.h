@@ -0,0 +1,62 @@
+#ifndef PLANNINGRESULTCACHE_H
+#define PLANNINGRESULTCACHE_H
+
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QByteArray>
+#include <QDataStream>
+
+#include "Position.h"
+
+/**
+ * @brief The PlanningResultCache class remembers the intermediate results of HierarchicalPlanner (the two
+ * candidate endpoints found for each area and the sub-flight planned for each task) keyed by a content hash
+ * of everything that went into them. Unchanged areas and tasks are then found here after a reset or after
+ * reopening a saved problem instead of being planned again.
+ */
+class PlanningResultCache
+{
+public:
+    PlanningResultCache();
+
+    /**
+     * @brief hash continues the 64-bit FNV-1a hash over bytes. Start with the default.
+     */
+    static quint64 hash(const QByteArray& bytes, quint64 hash = Q_UINT64_C(14695981039346656037));
+
+    bool lookupEndpoints(quint64 key, Position * first, Position * second) const;
+    void insertEndpoints(quint64 key, const Position& first, const Position& second);
+
+    bool lookupSubFlight(quint64 key, QList<Position> * subFlight) const;
+    void insertSubFlight(quint64 key, const QList<Position>& subFlight);
+
+    /**
+     * @brief retainOnly forgets every result whose key isn't in keys, so edits don't make the cache grow
+     * without bound
+     */
+    void retainOnly(const QSet<quint64>& keys);
+
+    void clear();
+    int size() const;
+
+    void serialize(QDataStream& stream) const;
+
+    /**
+     * @brief deserialize adds the results written by serialize() to the cache. Returns false if the stream
+     * was damaged.
+     */
+    bool deserialize(QDataStream& stream);
+
+private:
+    struct Endpoints
+    {
+        Position first;
+        Position second;
+    };
+
+    QHash<quint64, Endpoints> _endpoints;
+    QHash<quint64, QList<Position> > _subFlights;
+};
+
+#endif // PLANNINGRESULTCACHE_H
@@ -0,0 +1,140 @@
+#ifndef PRIORITYQUEUE_H
+#define PRIORITYQUEUE_H
+
+#include <QtGlobal>
+#include <QVector>
+#include <algorithm>
+
+#include "PlanningRandom.h"
+
+/**
+ * @brief The PriorityQueue class is a binary min-heap used as the open list of our best-first searches.
+ * Insertion and removal of the minimum are O(log n).
+ *
+ * There is no decrease-key. Searches that find a cheaper way to reach a state just insert it again and
+ * skip the stale entries when they come off of the queue (i.e., check them against a closed set).
+ *
+ * Entries with equal priority come out most-recently-inserted first, which matches the ordering we used
+ * to get out of QMultiMap::value(), unless setTieBreaker() has been given a generator to shuffle them with.
+ */
+template <typename T>
+class PriorityQueue
+{
+public:
+    PriorityQueue() : _insertions(0), _tieBreaker(0)
+    {
+    }
+
+    /**
+     * @brief setTieBreaker makes entries with equal priority come out in an order drawn from random rather than
+     * most-recently-inserted first. random is not owned by us and must outlive the queue. 0 (the default) goes
+     * back to insertion order for new entries.
+     * @param random
+     */
+    void setTieBreaker(PlanningRandom * random)
+    {
+        _tieBreaker = random;
+    }
+
+    bool isEmpty() const
+    {
+        return _heap.isEmpty();
+    }
+
+    int size() const
+    {
+        return _heap.size();
+    }
+
+    void clear()
+    {
+        _heap.clear();
+        _insertions = 0;
+    }
+
+    void reserve(int size)
+    {
+        _heap.reserve(size);
+    }
+
+    void insert(qreal priority, const T& value)
+    {
+        Entry entry;
+        entry.priority = priority;
+        entry.sequence = _tieBreaker ? _tieBreaker->next() : _insertions++;
+        entry.value = value;
+        _heap.append(entry);
+        std::push_heap(_heap.begin(), _heap.end(), EntryCompare());
+    }
+
+    /**
+     * @brief minPriority returns the priority of the entry that takeMin() will return next.
+     * Don't call this on an empty queue.
+     * @return
+     */
+    qreal minPriority() const
+    {
+        return _heap.first().priority;
+    }
+
+    /**
+     * @brief minValue returns the entry that takeMin() will return next without removing it.
+     * Don't call this on an empty queue.
+     * @return
+     */
+    const T& minValue() const
+    {
+        return _heap.first().value;
+    }
+
+    /**
+     * @brief takeMin removes and returns the value with the lowest priority.
+     * Don't call this on an empty queue.
+     * @return
+     */
+    T takeMin()
+    {
+        std::pop_heap(_heap.begin(), _heap.end(), EntryCompare());
+        const T toRet = _heap.last().value;
+        _heap.removeLast();
+        return toRet;
+    }
+
+    /**
+     * @brief truncate drops all but the count entries that would come out first
+     * @param count
+     */
+    void truncate(int count)
+    {
+        if (count >= _heap.size())
+            return;
+        std::sort_heap(_heap.begin(), _heap.end(), EntryCompare());
+        _heap.remove(0, _heap.size() - count);
+        std::make_heap(_heap.begin(), _heap.end(), EntryCompare());
+    }
+
+private:
+    struct Entry
+    {
+        qreal priority;
+        quint64 sequence;
+        T value;
+    };
+
+    //std heap functions build a max-heap, so "less" here means "comes out later"
+    struct EntryCompare
+    {
+        bool operator()(const Entry& a, const Entry& b) const
+        {
+            if (a.priority != b.priority)
+                return a.priority > b.priority;
+            return a.sequence < b.sequence;
+        }
+    };
+
+    QVector<Entry> _heap;
+    quint64 _insertions;
+    PlanningRandom * _tieBreaker;
+};
+
+#endif // PRIORITYQUEUE_H
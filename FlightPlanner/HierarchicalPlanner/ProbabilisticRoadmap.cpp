@@ -0,0 +1,80 @@
+#include "ProbabilisticRoadmap.h"
+
+#include <QSet>
+
+#include "PlanningRandom.h"
+#include "PlanningLog.h"
+
+//Give up on filling the roadmap after this many samples per node have landed in obstacles
+const int MAX_ATTEMPTS_PER_SAMPLE = 20;
+
+ProbabilisticRoadmap::ProbabilisticRoadmap(QSharedPointer<const ObstacleMap> obstacleMap,
+                                           const QRectF &lonLatBounds,
+                                           int samples,
+                                           int neighbors,
+                                           quint64 seed) :
+    WaypointGraph(obstacleMap, lonLatBounds.normalized().center()),
+    _bounds(lonLatBounds.normalized()), _neighbors(qMax<int>(1, neighbors)), _kdtree(QKDTreeSquaredEuclidean<2>(), true),
+    _kdtreeMemory("KDTrees")
+{
+    //Scatter the nodes over the free part of the region
+    PlanningRandom random(seed);
+    const int maxAttempts = qMax<int>(0, samples) * MAX_ATTEMPTS_PER_SAMPLE;
+    for (int attempt = 0; attempt < maxAttempts && this->nodeCount() < samples; attempt++)
+    {
+        const QPointF lonLat(_bounds.left() + random.uniform() * _bounds.width(),
+                             _bounds.top() + random.uniform() * _bounds.height());
+        if (this->obstacleMap() && this->obstacleMap()->contains(lonLat))
+            continue;
+        const int index = this->addNode(lonLat);
+        const QPointF meters = this->nodeMeters(index);
+        const qreal position[2] = {meters.x(), meters.y()};
+        _kdtree.add(position, index);
+    }
+    _kdtree.rebalance();
+    _kdtreeMemory.setBytes(_kdtree.memoryBytes());
+
+    //Join each node to its nearest neighbors. Every pair is checked once, whichever of them finds the other.
+    QSet<qint64> checkedPairs;
+    QVector<int> nearest;
+    for (int i = 0; i < this->nodeCount(); i++)
+    {
+        //The nearest node is always this one
+        const QPointF meters = this->nodeMeters(i);
+        const qreal position[2] = {meters.x(), meters.y()};
+        _kdtree.kNearest(position, _neighbors + 1, &nearest);
+        foreach(int neighbor, nearest)
+        {
+            const int j = _kdtree.payload(neighbor);
+            if (j == i)
+                continue;
+            const qint64 pair = ((qint64)qMin<int>(i, j) << 32) | (quint32)qMax<int>(i, j);
+            if (checkedPairs.contains(pair))
+                continue;
+            checkedPairs.insert(pair);
+            this->tryAddEdge(i, j);
+        }
+    }
+    this->finishEdges();
+
+    planningDebug(intermediateLog) << "Roadmap has" << this->nodeCount() << "nodes and" << this->edgeCount() << "edges";
+}
+
+const QRectF &ProbabilisticRoadmap::bounds() const
+{
+    return _bounds;
+}
+
+//protected
+//pure-virtual from WaypointGraph
+void ProbabilisticRoadmap::candidateNodes(const QPointF &lonLat, QVector<int> *nodesOut) const
+{
+    nodesOut->clear();
+
+    const QPointF meters = this->toMeters(lonLat);
+    const qreal position[2] = {meters.x(), meters.y()};
+    QVector<int> nearest;
+    _kdtree.kNearest(position, _neighbors, &nearest);
+    foreach(int neighbor, nearest)
+        nodesOut->append(_kdtree.payload(neighbor));
+}
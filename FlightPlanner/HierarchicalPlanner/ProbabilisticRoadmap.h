@@ -0,0 +1,48 @@
+#ifndef PROBABILISTICROADMAP_H
+#define PROBABILISTICROADMAP_H
+
+#include <QRectF>
+
+#include "WaypointGraph.h"
+#include "QKDTreeT.h"
+#include "AllocationTracker.h"
+
+/**
+ * @brief The ProbabilisticRoadmap class is a WaypointGraph sampled over a region that is built once and then
+ * searched for many transitions. Nodes are sampled uniformly over the region outside of the obstacles and each
+ * one is joined to its k nearest nodes (found with a QKDTreeT) wherever the straight segment between them is
+ * clear. A query's start and end are joined to their own k nearest nodes the same way.
+ */
+class ProbabilisticRoadmap : public WaypointGraph
+{
+public:
+    /**
+     * @brief ProbabilisticRoadmap
+     * @param obstacleMap the no-fly zones the roadmap avoids. May be null, in which case nothing is in the way.
+     * @param lonLatBounds the region to sample
+     * @param samples how many nodes to place
+     * @param neighbors how many of each node's nearest nodes to try to join it to
+     * @param seed seeds the sampling, so the same inputs always give the same roadmap
+     */
+    ProbabilisticRoadmap(QSharedPointer<const ObstacleMap> obstacleMap,
+                         const QRectF& lonLatBounds,
+                         int samples = 1000,
+                         int neighbors = 10,
+                         quint64 seed = 0);
+
+    const QRectF& bounds() const;
+
+protected:
+    //pure-virtual from WaypointGraph
+    virtual void candidateNodes(const QPointF& lonLat, QVector<int> * nodesOut) const;
+
+private:
+    QRectF _bounds;
+    int _neighbors;
+
+    //Nodes by position in meters. Each node's payload is its index.
+    QKDTreeT<2, QKDTreeSquaredEuclidean<2>, int> _kdtree;
+    AllocationScope _kdtreeMemory;
+};
+
+#endif // PROBABILISTICROADMAP_H
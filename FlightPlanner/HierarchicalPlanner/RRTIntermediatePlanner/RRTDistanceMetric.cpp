@@ -14,14 +14,20 @@ RRTDistanceMetric::RRTDistanceMetric(qreal latitude, qreal minTurnRadius) :
 //virtual from QKDTreeDistanceMetric
 qreal RRTDistanceMetric::distance(const QVectorND &a, const QVectorND &b)
 {
-    const qreal lonMeters = (a.val(0) - b.val(0)) / _lonPerMeter;
-    const qreal latMeters = (a.val(1) - b.val(1)) / _latPerMeter;
+    return this->distance(a.values().constData(), b.values().constData(), a.dimension());
+}
+
+//virtual from QKDTreeDistanceMetric
+qreal RRTDistanceMetric::distance(const qreal *a, const qreal *b, int)
+{
+    const qreal lonMeters = (a[0] - b[0]) / _lonPerMeter;
+    const qreal latMeters = (a[1] - b[1]) / _latPerMeter;
 
     const qreal distanceInMeters = sqrt(lonMeters*lonMeters + latMeters*latMeters);
 
-    const qreal smallAngle1 = qMin<qreal>(a.val(2), b.val(2));
+    const qreal smallAngle1 = qMin<qreal>(a[2], b[2]);
     const qreal smallAngle2 = smallAngle1 + (2.0 * 3.14159265);
-    const qreal bigAngle = qMax<qreal>(a.val(2), b.val(2));
+    const qreal bigAngle = qMax<qreal>(a[2], b[2]);
 
     const qreal radianDiff = qMin<qreal>(qAbs<qreal>(smallAngle1 - bigAngle),
                                          qAbs<qreal>(smallAngle2 - bigAngle));
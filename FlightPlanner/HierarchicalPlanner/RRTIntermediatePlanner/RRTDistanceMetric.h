@@ -11,6 +11,9 @@ public:
     //virtual from QKDTreeDistanceMetric
     virtual qreal distance(const QVectorND& a, const QVectorND& b);
 
+    //virtual from QKDTreeDistanceMetric
+    virtual qreal distance(const qreal * a, const qreal * b, int dimension);
+
 private:
     const qreal _lonPerMeter;
     const qreal _latPerMeter;
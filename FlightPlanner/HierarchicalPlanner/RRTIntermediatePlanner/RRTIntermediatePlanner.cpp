@@ -2,11 +2,43 @@
 
 #include <limits>
 #include <cmath>
-#include <QVector2D>
+#include <QSet>
 
 #include "guts/Conversions.h"
-#include "QKDTree.h"
+#include "QFlatKDTree.h"
 #include "RRTDistanceMetric.h"
+#include "PlanningLog.h"
+#include "AllocationTracker.h"
+
+//Nodes this many waypoint intervals apart (in RRTDistanceMetric terms) count as joined up
+const qreal REACH_INTERVALS = 1.8;
+
+//The most steps a single greedy connect may take towards the other tree's new node
+const int MAX_CONNECT_STEPS = 200;
+
+//Extending towards a random sample only needs a node close to it, not the closest, so those lookups settle
+//for one within 1 + NEAREST_EPSILON of the nearest distance and measure to at most NEAREST_MAX_VISITS nodes
+const qreal NEAREST_EPSILON = 0.5;
+const int NEAREST_MAX_VISITS = 128;
+
+struct RRTIntermediatePlanner::LatticeTree
+{
+    LatticeTree(QFlatKDTree * kdtree, const MotionPrimitiveTable& primitives) :
+        kdtree(kdtree), primitives(primitives)
+    {
+    }
+
+    //Nodes' coordinates, for nearest neighbours
+    QFlatKDTree * kdtree;
+    const MotionPrimitiveTable primitives;
+
+    //parents[i] is the index of node i's parent, or -1 for the root. poses[i] is where node i is on the lattice.
+    QVector<int> parents;
+    QVector<LatticePose> poses;
+
+    //Every pose in the tree, so steps never lead anywhere it's been
+    QSet<LatticePose> reached;
+};
 
 RRTIntermediatePlanner::RRTIntermediatePlanner(const UAVParameters& uavParams,
                                                const Position &startPos,
@@ -14,128 +46,316 @@ RRTIntermediatePlanner::RRTIntermediatePlanner(const UAVParameters& uavParams,
                                                const Position &endPos,
                                                const UAVOrientation &endPose,
                                                const QList<QPolygonF> &obstacles) :
-    IntermediatePlanner(uavParams, startPos, startPose, endPos, endPose, obstacles)
+    IntermediatePlanner(uavParams, startPos, startPose, endPos, endPose, obstacles),
+    _bidirectional(false), _branchesPerSide(3), _maxSamples(50000), _nodeCount(0),
+    _lonPerMeter(0.0), _latPerMeter(0.0)
 {
 }
 
 bool RRTIntermediatePlanner::plan()
 {
     _results.clear();
+    _nodeCount = 0;
+
+    const quint32 squareSize = qMax<quint32>(1, 3.0 * this->startPos().distanceTo(this->endPos(), Position::LocalENU));
+    _lonPerMeter = Conversions::degreesLonPerMeter(this->startPos().latitude());
+    _latPerMeter = Conversions::degreesLatPerMeter(this->startPos().latitude());
+
+    const bool success = _bidirectional ? _planBidirectional(squareSize) : _planForward(squareSize);
+    planningDebug(intermediateLog) << (_bidirectional ? "RRT-Connect" : "RRT")
+                                   << (success ? "succeeded" : "failed") << "with" << _nodeCount << "nodes";
+    return success;
+}
+
+QList<Position> RRTIntermediatePlanner::results() const
+{
+    return _results;
+}
+
+void RRTIntermediatePlanner::takeResults(QList<Position> *destination)
+{
+    destination->clear();
+    destination->swap(_results);
+}
+
+bool RRTIntermediatePlanner::bidirectional() const
+{
+    return _bidirectional;
+}
+
+void RRTIntermediatePlanner::setBidirectional(bool bidirectional)
+{
+    _bidirectional = bidirectional;
+}
+
+int RRTIntermediatePlanner::branchesPerSide() const
+{
+    return _branchesPerSide;
+}
 
-    const QVectorND goal = _toVec(this->endPos(), this->endPose());
+void RRTIntermediatePlanner::setBranchesPerSide(int branches)
+{
+    _branchesPerSide = qMax<int>(1, branches);
+}
 
-    QKDTree kdtree(3, false,
-                   new RRTDistanceMetric(this->endPos().latitude(),
-                                         this->uavParams().minTurningRadius()));
+int RRTIntermediatePlanner::maxSamples() const
+{
+    return _maxSamples;
+}
 
-    QHash<QVectorND, QVectorND> parents;
-    kdtree.add(_toVec(this->startPos(), this->startPose()), 1);
+void RRTIntermediatePlanner::setMaxSamples(int samples)
+{
+    _maxSamples = qMax<int>(0, samples);
+}
 
-    const quint32 squareSize = 3.0 * (Conversions::lla2xyz(this->startPos()) - Conversions::lla2xyz(this->endPos())).length();
-    const qreal lonPerMeter = Conversions::degreesLonPerMeter(this->startPos().latitude());
-    const qreal latPerMeter = Conversions::degreesLatPerMeter(this->startPos().latitude());
+int RRTIntermediatePlanner::nodeCount() const
+{
+    return _nodeCount;
+}
+
+//private
+bool RRTIntermediatePlanner::_planForward(quint32 squareSize)
+{
+    const QVectorND3 goal = _toVec(this->endPos(), this->endPose());
+
+    //Flat tree rebalances itself as it grows, so growth from a single start point doesn't degenerate
+    QFlatKDTree kdtree(3, false,
+                       new RRTDistanceMetric(this->endPos().latitude(),
+                                             this->uavParams().minTurningRadius()));
+    kdtree.reserve(4096);
+    AllocationScope treeMemory("KDTrees", kdtree.memoryBytes());
+
+    LatticeTree tree(&kdtree, MotionPrimitiveTable(this->uavParams(), _branchesPerSide,
+                                                   this->startPos(), this->startPose()));
+    tree.parents.reserve(4096);
+    tree.poses.reserve(4096);
+    _addNode(&tree, LatticePose(), -1);
 
     int count = 0;
     qreal bestDistToGoal = std::numeric_limits<qreal>::max();
-    while (count++ < 50000)
+    while (count++ < _maxSamples && this->chargeNodes())
     {
-        //Generate random place in state space
-        const int lonDiff = (qrand() % squareSize) + 1 - squareSize / 2;
-        const int latDiff = (qrand() % squareSize) + 1 - squareSize / 2;
-        const QVector3D random(this->startPos().longitude() + lonDiff * lonPerMeter,
-                               this->startPos().latitude() + latDiff * latPerMeter,
-                               (qreal)qrand()/((qreal)RAND_MAX/(2.0*3.14159265)));
-
-        //Find nearest existing node
-        QVectorND nearestExisting;
-        kdtree.nearestKey(random, &nearestExisting);
-        if (nearestExisting == random)
-            continue;
+        qreal random[3];
+        _sample(random, squareSize);
 
-        //Generate step towards random from nearestExisting
-        const Position existingPos = _toPosition(nearestExisting);
-        const UAVOrientation existingPose = _toOrientation(nearestExisting);
+        //Find a nearby existing node
+        qreal nearestDist;
+        const int nearestIndex = kdtree.nearest(random, &nearestDist, NEAREST_EPSILON, NEAREST_MAX_VISITS);
+        if (nearestIndex < 0 || nearestDist == 0.0)
+            continue;
 
-        QVectorND bestNew(kdtree.dimension());
-        qreal bestNewDist = std::numeric_limits<qreal>::max();
+        const int newIndex = _extend(&tree, nearestIndex, random, false);
+        if (newIndex < 0)
+            continue;
+        treeMemory.setBytes(kdtree.memoryBytes());
 
-        const int branches = 3;
-        for (int i = -branches; i <= branches; i++)
+        const qreal distToGoal = kdtree.distance(goal.constData(), kdtree.coordinates(newIndex));
+        if (distToGoal < bestDistToGoal)
         {
-            const qreal angleMod = this->uavParams().maxTurnAngle() * ((qreal)i / (qreal)branches);
-            const qreal successorRadians = existingPose.radians() + angleMod;
-            QVector2D translateVec(cos(successorRadians), sin(successorRadians));
-            translateVec.normalize();
-            translateVec *= this->uavParams().waypointInterval();
-            const Position successorPos(existingPos.longitude() + lonPerMeter * translateVec.x(),
-                                        existingPos.latitude() + latPerMeter * translateVec.y());
-            const UAVOrientation successorPose(successorRadians);
-            const QVectorND vec = _toVec(successorPos, successorPose);
-
-            //No flying through obstacles!
-            if (_collidesWithObstacle(successorPos))
-                continue;
-
-            const qreal dist = kdtree.distanceMetric()->distance(random, vec);
-            if (dist < bestNewDist)
+            bestDistToGoal = distToGoal;
+            planningTrace(intermediateLog) << "RRT closest to goal:" << distToGoal;
+        }
+        if (distToGoal < REACH_INTERVALS * this->uavParams().waypointInterval())
+        {
+            planningDebug(intermediateLog) << "RRT solution found - trace back";
+            int current = newIndex;
+            while (current >= 0)
             {
-                bestNewDist = dist;
-                bestNew = vec;
+                _results.prepend(_toPosition(QVectorND3(kdtree.coordinates(current))));
+                current = tree.parents.at(current);
             }
+            break;
         }
+    }
 
-        if (bestNew.isNull())
-            continue;
-        kdtree.add(bestNew,2);
-        parents.insert(bestNew, nearestExisting);
+    _nodeCount = kdtree.size();
+    return !_results.isEmpty();
+}
 
-        const qreal distToGoal = kdtree.distanceMetric()->distance(goal, bestNew);
-        if (distToGoal < bestDistToGoal)
-        {
-            bestDistToGoal = distToGoal;
-            qDebug() << distToGoal;
-        }
-        if (distToGoal < 1.8 * this->uavParams().waypointInterval())
+//private
+bool RRTIntermediatePlanner::_planBidirectional(quint32 squareSize)
+{
+    const qreal reachDistance = REACH_INTERVALS * this->uavParams().waypointInterval();
+
+    //trees[0] grows forward from the start, trees[1] grows backward from the goal
+    QFlatKDTree startTree(3, false,
+                          new RRTDistanceMetric(this->endPos().latitude(),
+                                                this->uavParams().minTurningRadius()));
+    QFlatKDTree goalTree(3, false,
+                         new RRTDistanceMetric(this->endPos().latitude(),
+                                               this->uavParams().minTurningRadius()));
+    startTree.reserve(1024);
+    goalTree.reserve(1024);
+    AllocationScope treeMemory("KDTrees", startTree.memoryBytes() + goalTree.memoryBytes());
+
+    LatticeTree startLattice(&startTree, MotionPrimitiveTable(this->uavParams(), _branchesPerSide,
+                                                              this->startPos(), this->startPose()));
+    LatticeTree goalLattice(&goalTree, MotionPrimitiveTable(this->uavParams(), _branchesPerSide,
+                                                            this->endPos(), this->endPose()));
+    LatticeTree * trees[2] = {&startLattice, &goalLattice};
+    _addNode(&startLattice, LatticePose(), -1);
+    _addNode(&goalLattice, LatticePose(), -1);
+
+    int startMeet = -1;
+    int goalMeet = -1;
+    int side = 0;
+    int count = 0;
+    while (count++ < _maxSamples && startMeet < 0 && this->chargeNodes())
+    {
+        LatticeTree * growing = trees[side];
+        LatticeTree * other = trees[1 - side];
+
+        qreal random[3];
+        _sample(random, squareSize);
+
+        qreal nearestDist;
+        const int nearestIndex = growing->kdtree->nearest(random, &nearestDist, NEAREST_EPSILON, NEAREST_MAX_VISITS);
+        const int grownIndex = (nearestIndex < 0 || nearestDist == 0.0)
+                ? -1 : _extend(growing, nearestIndex, random, side == 1);
+
+        //Greedily pull the other tree towards the new node until it arrives, gets stuck or stops closing in
+        if (grownIndex >= 0)
         {
-            qDebug() << "Solution found - trace back";
-            QVectorND current = bestNew;
-            while (true)
+            const QVectorND3 target(growing->kdtree->coordinates(grownIndex));
+            qreal lastDist = std::numeric_limits<qreal>::max();
+            for (int step = 0; step < MAX_CONNECT_STEPS; step++)
             {
-                _results.prepend(_toPosition(current));
-                if (parents.contains(current))
-                    current = parents.value(current);
-                else
+                qreal dist;
+                const int closest = other->kdtree->nearest(target.constData(), &dist);
+                if (closest < 0)
+                    break;
+                else if (dist < reachDistance)
+                {
+                    startMeet = (side == 0) ? grownIndex : closest;
+                    goalMeet = (side == 0) ? closest : grownIndex;
+                    break;
+                }
+                else if (dist >= lastDist)
+                    break;
+                lastDist = dist;
+
+                if (_extend(other, closest, target.constData(), side == 0) < 0)
                     break;
             }
-            break;
         }
+
+        treeMemory.setBytes(startTree.memoryBytes() + goalTree.memoryBytes());
+        side = 1 - side;
     }
 
-    if (_results.isEmpty())
+    _nodeCount = startTree.size() + goalTree.size();
+    if (startMeet < 0)
         return false;
+
+    planningDebug(intermediateLog) << "RRT-Connect trees met - trace back";
+    for (int current = startMeet; current >= 0; current = startLattice.parents.at(current))
+        _results.prepend(_toPosition(QVectorND3(startTree.coordinates(current))));
+
+    //Like the forward search, stop short of the goal itself
+    for (int current = goalMeet; goalLattice.parents.at(current) >= 0; current = goalLattice.parents.at(current))
+        _results.append(_toPosition(QVectorND3(goalTree.coordinates(current))));
     return true;
 }
 
-QList<Position> RRTIntermediatePlanner::results() const
+//private
+void RRTIntermediatePlanner::_sample(qreal *sampleOut, quint32 squareSize)
 {
-    return _results;
+    //Generate random place in state space
+    const int lonDiff = this->random().bounded(squareSize) + 1 - squareSize / 2;
+    const int latDiff = this->random().bounded(squareSize) + 1 - squareSize / 2;
+    sampleOut[0] = this->startPos().longitude() + lonDiff * _lonPerMeter;
+    sampleOut[1] = this->startPos().latitude() + latDiff * _latPerMeter;
+    sampleOut[2] = this->random().uniform(0.0, 2.0*3.14159265);
+}
+
+//private
+int RRTIntermediatePlanner::_extend(LatticeTree *tree, int fromIndex, const qreal *target, bool backwards)
+{
+    const LatticePose existing = tree->poses.at(fromIndex);
+    const MotionPrimitiveTable& primitives = tree->primitives;
+
+    LatticePose bestNew;
+    qreal bestNewDist = std::numeric_limits<qreal>::max();
+
+    /*
+     * Forwards, a successor turns by up to maxTurnAngle and then flies one interval on its new heading.
+     * Backwards, a predecessor is one interval behind along the existing heading, and turned by up to
+     * maxTurnAngle from it, so that flying forward from the predecessor is a legal step.
+    */
+    for (int branch = 0; branch < primitives.branchCount(); branch++)
+    {
+        const LatticePose candidate = backwards ? primitives.predecessor(existing, branch)
+                                                : primitives.successor(existing, branch);
+        if (tree->reached.contains(candidate))
+            continue;
+
+        //No flying through obstacles! Backwards, the step is flown from the candidate back to where we are.
+        const bool collides = backwards
+                ? _stepCollides(*tree, candidate, primitives.branchCount() - 1 - branch, existing)
+                : _stepCollides(*tree, existing, branch, candidate);
+        if (collides)
+            continue;
+
+        const QVectorND3 vec = _toVec(primitives.position(candidate), primitives.orientation(candidate));
+        const qreal dist = tree->kdtree->distance(target, vec.constData());
+        if (dist < bestNewDist)
+        {
+            bestNewDist = dist;
+            bestNew = candidate;
+        }
+    }
+
+    if (bestNewDist == std::numeric_limits<qreal>::max())
+        return -1;
+    return _addNode(tree, bestNew, fromIndex);
+}
+
+//private
+int RRTIntermediatePlanner::_addNode(LatticeTree *tree, const LatticePose &pose, int parentIndex)
+{
+    const QVectorND3 vec = _toVec(tree->primitives.position(pose), tree->primitives.orientation(pose));
+    const int toRet = tree->kdtree->add(vec.constData());
+    if (toRet < 0)
+        return -1;
+    tree->parents.append(parentIndex);
+    tree->poses.append(pose);
+    tree->reached.insert(pose);
+    return toRet;
+}
+
+//private
+bool RRTIntermediatePlanner::_stepCollides(const LatticeTree &tree, const LatticePose &from, int branch,
+                                           const LatticePose &to) const
+{
+    if (this->collidesWithObstacle(tree.primitives.position(to)))
+        return true;
+    for (int sample = 0; sample < MotionPrimitiveTable::STEP_SAMPLES; sample++)
+    {
+        if (this->collidesWithObstacle(tree.primitives.stepSample(from, branch, sample)))
+            return true;
+    }
+    return false;
 }
 
 //private static
-QVectorND RRTIntermediatePlanner::_toVec(const Position &pos,
-                                         const UAVOrientation &pose)
+QVectorND3 RRTIntermediatePlanner::_toVec(const Position &pos,
+                                          const UAVOrientation &pose)
 {
-    return QVectorND(QVector3D(pos.longitude(), pos.latitude(), pose.radians()));
+    QVectorND3 toRet;
+    toRet[0] = pos.longitude();
+    toRet[1] = pos.latitude();
+    toRet[2] = pose.radians();
+    return toRet;
 }
 
 //private static
-UAVOrientation RRTIntermediatePlanner::_toOrientation(const QVectorND &vec)
+UAVOrientation RRTIntermediatePlanner::_toOrientation(const QVectorND3 &vec)
 {
     return UAVOrientation(vec.val(2));
 }
 
 //private static
-Position RRTIntermediatePlanner::_toPosition(const QVectorND &vec)
+Position RRTIntermediatePlanner::_toPosition(const QVectorND3 &vec)
 {
     Position toRet;
     toRet.setLongitude(vec.val(0));
@@ -143,18 +363,8 @@ Position RRTIntermediatePlanner::_toPosition(const QVectorND &vec)
     return toRet;
 }
 
-//private
-bool RRTIntermediatePlanner::_collidesWithObstacle(const Position &pos) const
-{
-    foreach(const QPolygonF& obs, this->obstacles())
-    {
-        if (obs.containsPoint(pos.lonLat(), Qt::OddEvenFill))
-            return true;
-    }
-    return false;
-}
-
 uint qHash(const QVector3D& vec)
 {
-    return vec.x() + vec.y() + vec.z();
+    const qreal values[3] = {vec.x(), vec.y(), vec.z()};
+    return qHashReals(values, 3);
 }
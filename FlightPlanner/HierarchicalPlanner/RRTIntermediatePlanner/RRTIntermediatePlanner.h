@@ -1,9 +1,14 @@
 #ifndef RRTINTERMEDIATEPLANNER_H
 #define RRTINTERMEDIATEPLANNER_H
 
+#include <QVector>
+
 #include "HierarchicalPlanner/IntermediatePlanner.h"
 #include "UAVParameters.h"
-#include "QVectorND.h"
+#include "QVectorNDFixed.h"
+#include "MotionPrimitiveTable.h"
+
+class QFlatKDTree;
 
 class RRTIntermediatePlanner : public IntermediatePlanner
 {
@@ -17,13 +22,62 @@ public:
 
     virtual bool plan();
     virtual QList<Position> results() const;
+    virtual void takeResults(QList<Position> * destination);
+
+    /**
+     * @brief bidirectional returns true if plan() uses RRT-Connect: one tree grows forward from the start,
+     * another grows backward from the goal, and each new node greedily pulls the other tree towards it.
+     * Defaults to false, which grows a single tree from the start until it gets near the goal.
+     * @return
+     */
+    bool bidirectional() const;
+    void setBidirectional(bool bidirectional);
+
+    /**
+     * @brief branchesPerSide returns how many equal steps each way the UAV's maximum turn is split into when
+     * the trees grow. Defaults to 3.
+     * @return
+     */
+    int branchesPerSide() const;
+    void setBranchesPerSide(int branches);
+
+    /**
+     * @brief maxSamples returns how many random samples plan() draws before giving up, if the planning context
+     * doesn't stop it sooner. Defaults to 50000.
+     * @return
+     */
+    int maxSamples() const;
+    void setMaxSamples(int samples);
+
+    /**
+     * @brief nodeCount returns how many nodes (in both trees) the last plan() built
+     * @return
+     */
+    int nodeCount() const;
 
 private:
-    static QVectorND _toVec(const Position& pos, const UAVOrientation& pose);
-    static UAVOrientation _toOrientation(const QVectorND &vec);
-    static Position _toPosition(const QVectorND& vec);
+    //A tree of the search, on a lattice of its own rooted at the tree's root
+    struct LatticeTree;
+
+    bool _planForward(quint32 squareSize);
+    bool _planBidirectional(quint32 squareSize);
+
+    void _sample(qreal * sampleOut, quint32 squareSize);
+    int _extend(LatticeTree * tree, int fromIndex, const qreal * target, bool backwards);
+    int _addNode(LatticeTree * tree, const LatticePose& pose, int parentIndex);
+    bool _stepCollides(const LatticeTree& tree, const LatticePose& from, int branch, const LatticePose& to) const;
+
+    static QVectorND3 _toVec(const Position& pos, const UAVOrientation& pose);
+    static UAVOrientation _toOrientation(const QVectorND3 &vec);
+    static Position _toPosition(const QVectorND3& vec);
+
+    bool _bidirectional;
+    int _branchesPerSide;
+    int _maxSamples;
+    int _nodeCount;
 
-    bool _collidesWithObstacle(const Position& pos) const;
+    qreal _lonPerMeter;
+    qreal _latPerMeter;
 
     QList<Position> _results;
 };
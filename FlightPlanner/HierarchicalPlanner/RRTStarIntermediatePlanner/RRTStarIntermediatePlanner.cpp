@@ -0,0 +1,377 @@
+#include "RRTStarIntermediatePlanner.h"
+
+#include <QElapsedTimer>
+#include <QScopedPointer>
+#include <QPair>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "guts/Conversions.h"
+#include "HierarchicalPlanner/ObstacleMap.h"
+#include "QFlatKDTree.h"
+#include "Dubins.h"
+#include "DubinsSampler.h"
+#include "AllocationTracker.h"
+
+const qreal PI = 3.14159265358979;
+
+//New nodes are at most this many turning radii from the node they grow from
+const qreal STEER_TURN_RADII = 2.0;
+
+//Nodes this many steps away are considered as parents, rewired and linked to the goal
+const qreal NEIGHBOR_STEPS = 3.0;
+
+//Until the goal has been reached, this fraction of the samples are the goal itself
+const qreal GOAL_BIAS = 0.05;
+
+//Stop once the best path is this close (relatively) to the obstacle-free Dubins path
+const qreal DONE_TOLERANCE = 0.001;
+
+RRTStarIntermediatePlanner::RRTStarIntermediatePlanner(const UAVParameters &uavParams,
+                                                       const Position &startPos,
+                                                       const UAVOrientation &startPose,
+                                                       const Position &endPos,
+                                                       const UAVOrientation &endPose,
+                                                       const QList<QPolygonF> &obstacles) :
+    IntermediatePlanner(uavParams, startPos, startPose, endPos, endPose, obstacles),
+    _timeBudget(100), _maxIterations(50000), _lonPerMeter(0.0), _latPerMeter(0.0), _collisionMap(0)
+{
+}
+
+//pure-virtual from IntermediatePlanner
+bool RRTStarIntermediatePlanner::plan()
+{
+    _results.clear();
+    _bestLengths.clear();
+    _positions.clear();
+    _headings.clear();
+    _parents.clear();
+    _costs.clear();
+    _children.clear();
+
+    const UAVParameters& params = this->uavParams();
+    _lonPerMeter = Conversions::degreesLonPerMeter(this->startPos().latitude());
+    _latPerMeter = Conversions::degreesLatPerMeter(this->startPos().latitude());
+
+    //Every edge gets checked, so don't rebuild the exact obstacle test for each one if there's no raster
+    QScopedPointer<ObstacleMap> exactMap;
+    _collisionMap = this->obstacleMap();
+    if (_collisionMap == 0 && !this->obstacles().isEmpty())
+    {
+        exactMap.reset(new ObstacleMap(this->obstacles(), 0.0));
+        _collisionMap = exactMap.data();
+    }
+
+    const QPointF start(0.0, 0.0);
+    const qreal startHeading = this->startPose().radians();
+    const QPointF goal((this->endPos().longitude() - this->startPos().longitude()) / _lonPerMeter,
+                       (this->endPos().latitude() - this->startPos().latitude()) / _latPerMeter);
+    const qreal goalHeading = this->endPose().radians();
+
+    //No path can beat the obstacle-free Dubins path. If it's clear there's nothing to search for.
+    qreal lowerBound = 0.0;
+    _dubinsLength(start, startHeading, goal, goalHeading, &lowerBound);
+    if (lowerBound > 0.0 && _edgeIsFree(start, startHeading, goal, goalHeading))
+    {
+        _bestLengths.append(lowerBound);
+        _sampleEdge(start, startHeading, goal, goalHeading, &_results);
+        _collisionMap = 0;
+        return true;
+    }
+
+    QFlatKDTree kdtree(2, true);
+    kdtree.reserve(4096);
+    AllocationScope treeMemory("KDTrees", kdtree.memoryBytes());
+    const qreal startCoords[2] = {start.x(), start.y()};
+    kdtree.add(startCoords);
+    _positions.append(start);
+    _headings.append(startHeading);
+    _parents.append(-1);
+    _costs.append(0.0);
+    _children.append(QVector<int>());
+
+    const qreal directDistance = sqrt(goal.x() * goal.x() + goal.y() * goal.y());
+    const qreal step = qMax<qreal>(STEER_TURN_RADII * params.minTurningRadius(), 2.0 * params.waypointInterval());
+    const qreal squareSize = qMax<qreal>(3.0 * directDistance, 4.0 * step);
+    const qreal infinity = std::numeric_limits<qreal>::max();
+
+    //Tree nodes with a clear path to the goal, and the length of that path
+    QVector<int> goalNodes;
+    QVector<qreal> goalEdges;
+    int goalParent = -1;
+    qreal bestCost = infinity;
+
+    QVector<int> neighbors;
+    QVector<QPair<qreal, int> > candidates;
+    QElapsedTimer clock;
+    clock.start();
+    for (int iteration = 0; iteration < _maxIterations; iteration++)
+    {
+        if (_timeBudget > 0 && clock.elapsed() >= _timeBudget)
+            break;
+        else if (!this->chargeNodes())
+            break;
+        else if (goalParent >= 0 && bestCost <= lowerBound * (1.0 + DONE_TOLERANCE))
+            break;
+
+        //Pick a point and grow the nearest node one step towards it
+        QPointF target;
+        if (goalParent < 0 && this->random().uniform(0.0, 1.0) < GOAL_BIAS)
+            target = goal;
+        else
+            target = _sample(bestCost, directDistance, goal, squareSize);
+
+        const qreal targetCoords[2] = {target.x(), target.y()};
+        const int nearest = kdtree.nearest(targetCoords);
+        if (nearest < 0)
+            continue;
+
+        QPointF offset = target - _positions.at(nearest);
+        const qreal offsetLength = sqrt(offset.x() * offset.x() + offset.y() * offset.y());
+        if (offsetLength < 1e-6)
+            continue;
+        else if (offsetLength > step)
+            offset *= step / offsetLength;
+        const QPointF newPos = _positions.at(nearest) + offset;
+        const qreal newHeading = atan2(offset.y(), offset.x());
+        if (this->collidesWithObstacle(_toPosition(newPos)))
+            continue;
+
+        //The neighborhood shrinks as the tree fills in, as RRT* needs for its paths to converge
+        const int n = _positions.size();
+        const qreal radius = qMin<qreal>(NEIGHBOR_STEPS * step, squareSize * sqrt(log(n + 1.0) / (n + 1.0)));
+        const qreal newCoords[2] = {newPos.x(), newPos.y()};
+        kdtree.withinDistance(newCoords, radius * radius, &neighbors);
+        if (!neighbors.contains(nearest))
+            neighbors.append(nearest);
+
+        //Connect through whichever neighbor gets here cheapest without hitting anything
+        candidates.clear();
+        foreach(int neighbor, neighbors)
+        {
+            qreal length;
+            if (_dubinsLength(_positions.at(neighbor), _headings.at(neighbor), newPos, newHeading, &length))
+                candidates.append(qMakePair(_costs.at(neighbor) + length, neighbor));
+        }
+        std::sort(candidates.begin(), candidates.end());
+
+        int parent = -1;
+        qreal newCost = infinity;
+        for (int i = 0; i < candidates.size(); i++)
+        {
+            //Nothing through here can beat the best path we have
+            if (candidates.at(i).first >= bestCost)
+                break;
+            const int candidate = candidates.at(i).second;
+            if (!_edgeIsFree(_positions.at(candidate), _headings.at(candidate), newPos, newHeading))
+                continue;
+            parent = candidate;
+            newCost = candidates.at(i).first;
+            break;
+        }
+        if (parent < 0)
+            continue;
+
+        const int newIndex = kdtree.add(newCoords);
+        if (newIndex < 0)
+            continue;
+        treeMemory.setBytes(kdtree.memoryBytes());
+        _positions.append(newPos);
+        _headings.append(newHeading);
+        _parents.append(parent);
+        _costs.append(newCost);
+        _children.append(QVector<int>());
+        _children[parent].append(newIndex);
+
+        //Rewire the neighbors that are cheaper to reach through the new node
+        foreach(int neighbor, neighbors)
+        {
+            if (neighbor == parent)
+                continue;
+            qreal length;
+            if (!_dubinsLength(newPos, newHeading, _positions.at(neighbor), _headings.at(neighbor), &length))
+                continue;
+            const qreal rewiredCost = newCost + length;
+            if (rewiredCost >= _costs.at(neighbor)
+                    || !_edgeIsFree(newPos, newHeading, _positions.at(neighbor), _headings.at(neighbor)))
+                continue;
+
+            QVector<int>& siblings = _children[_parents.at(neighbor)];
+            siblings.remove(siblings.indexOf(neighbor));
+            _children[newIndex].append(neighbor);
+            _parents[neighbor] = newIndex;
+            _propagateCost(neighbor, rewiredCost - _costs.at(neighbor));
+        }
+
+        //Link to the goal if it's close
+        const QPointF toGoal = goal - newPos;
+        if (sqrt(toGoal.x() * toGoal.x() + toGoal.y() * toGoal.y()) <= NEIGHBOR_STEPS * step)
+        {
+            qreal length;
+            if (_dubinsLength(newPos, newHeading, goal, goalHeading, &length)
+                    && newCost + length < bestCost
+                    && _edgeIsFree(newPos, newHeading, goal, goalHeading))
+            {
+                goalNodes.append(newIndex);
+                goalEdges.append(length);
+            }
+        }
+
+        //Rewiring can make any of the goal's links cheaper, not just the new one
+        for (int i = 0; i < goalNodes.size(); i++)
+        {
+            const qreal cost = _costs.at(goalNodes.at(i)) + goalEdges.at(i);
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                goalParent = goalNodes.at(i);
+            }
+        }
+        if (goalParent >= 0 && (_bestLengths.isEmpty() || bestCost < _bestLengths.last()))
+            _bestLengths.append(bestCost);
+    }
+
+    if (goalParent >= 0)
+        _buildResults(goalParent, goal);
+    _collisionMap = 0;
+    return goalParent >= 0;
+}
+
+//pure-virtual from IntermediatePlanner
+QList<Position> RRTStarIntermediatePlanner::results() const
+{
+    return _results;
+}
+
+//virtual from IntermediatePlanner
+void RRTStarIntermediatePlanner::takeResults(QList<Position> *destination)
+{
+    destination->clear();
+    destination->swap(_results);
+}
+
+qint64 RRTStarIntermediatePlanner::timeBudget() const
+{
+    return _timeBudget;
+}
+
+void RRTStarIntermediatePlanner::setTimeBudget(qint64 msecs)
+{
+    _timeBudget = qMax<qint64>(0, msecs);
+}
+
+int RRTStarIntermediatePlanner::maxIterations() const
+{
+    return _maxIterations;
+}
+
+void RRTStarIntermediatePlanner::setMaxIterations(int iterations)
+{
+    _maxIterations = qMax<int>(0, iterations);
+}
+
+const QVector<qreal> &RRTStarIntermediatePlanner::bestLengths() const
+{
+    return _bestLengths;
+}
+
+//private
+QPointF RRTStarIntermediatePlanner::_sample(qreal bestCost, qreal directDistance, const QPointF &goal,
+                                            qreal squareSize)
+{
+    const QPointF center = goal * 0.5;
+    if (bestCost == std::numeric_limits<qreal>::max() || bestCost <= directDistance)
+        return center + QPointF(this->random().uniform(-0.5, 0.5) * squareSize,
+                                this->random().uniform(-0.5, 0.5) * squareSize);
+
+    /*
+     * A path through a point is at least as long as the straight lines to it from the start and the goal, so
+     * only points inside the ellipse with those foci and a major axis of bestCost can be on a shorter path.
+    */
+    const qreal major = bestCost / 2.0;
+    const qreal minor = sqrt(bestCost * bestCost - directDistance * directDistance) / 2.0;
+    const qreal radius = sqrt(this->random().uniform(0.0, 1.0));
+    const qreal angle = this->random().uniform(0.0, 2.0 * PI);
+    const qreal x = major * radius * cos(angle);
+    const qreal y = minor * radius * sin(angle);
+
+    const qreal rotation = atan2(goal.y(), goal.x());
+    return center + QPointF(x * cos(rotation) - y * sin(rotation),
+                            x * sin(rotation) + y * cos(rotation));
+}
+
+//private
+bool RRTStarIntermediatePlanner::_dubinsLength(const QPointF &from, qreal fromHeading,
+                                               const QPointF &to, qreal toHeading,
+                                               qreal *lengthOut) const
+{
+    return Dubins::shortestLength(from, fromHeading, to, toHeading,
+                                  this->uavParams().minTurningRadius(), lengthOut);
+}
+
+//private
+bool RRTStarIntermediatePlanner::_edgeIsFree(const QPointF &from, qreal fromHeading,
+                                             const QPointF &to, qreal toHeading) const
+{
+    if (_collisionMap == 0 && this->terrain() == 0)
+        return true;
+
+    QList<Position> path;
+    _sampleEdge(from, fromHeading, to, toHeading, &path);
+    path.append(_toPosition(to));
+    if (_collisionMap != 0 && _collisionMap->pathCollides(path))
+        return false;
+    return !this->pathCollidesWithTerrain(path);
+}
+
+//private
+void RRTStarIntermediatePlanner::_sampleEdge(const QPointF &from, qreal fromHeading,
+                                             const QPointF &to, qreal toHeading,
+                                             QList<Position> *path) const
+{
+    Dubins dubins(from, fromHeading, to, toHeading, this->uavParams().minTurningRadius());
+    if (!dubins.isValid())
+        return;
+
+    //Up to but not including the end, like DubinsIntermediatePlanner, so the next edge picks up from there
+    DubinsSampler sampler(dubins, this->uavParams().waypointInterval());
+    QPointF pos;
+    while (sampler.next(&pos))
+        path->append(_toPosition(pos));
+}
+
+//private
+void RRTStarIntermediatePlanner::_propagateCost(int node, qreal delta)
+{
+    QVector<int> stack;
+    stack.append(node);
+    while (!stack.isEmpty())
+    {
+        const int current = stack.last();
+        stack.pop_back();
+        _costs[current] += delta;
+        stack += _children.at(current);
+    }
+}
+
+//private
+void RRTStarIntermediatePlanner::_buildResults(int goalParent, const QPointF &goal)
+{
+    QVector<int> chain;
+    for (int current = goalParent; current >= 0; current = _parents.at(current))
+        chain.prepend(current);
+
+    for (int i = 1; i < chain.size(); i++)
+        _sampleEdge(_positions.at(chain.at(i - 1)), _headings.at(chain.at(i - 1)),
+                    _positions.at(chain.at(i)), _headings.at(chain.at(i)),
+                    &_results);
+    _sampleEdge(_positions.at(goalParent), _headings.at(goalParent), goal, this->endPose().radians(), &_results);
+}
+
+//private
+Position RRTStarIntermediatePlanner::_toPosition(const QPointF &meters) const
+{
+    return Position(this->startPos().longitude() + meters.x() * _lonPerMeter,
+                    this->startPos().latitude() + meters.y() * _latPerMeter);
+}
@@ -0,0 +1,87 @@
+#ifndef RRTSTARINTERMEDIATEPLANNER_H
+#define RRTSTARINTERMEDIATEPLANNER_H
+
+#include <QVector>
+#include <QPointF>
+
+#include "HierarchicalPlanner/IntermediatePlanner.h"
+#include "UAVParameters.h"
+
+/**
+ * @brief The RRTStarIntermediatePlanner class plans transitions with RRT*: the tree's edges are Dubins paths,
+ * each new node is connected to whichever nearby node reaches it most cheaply, and the nearby nodes are then
+ * rewired through the new one if that's cheaper for them. Once the goal has been reached, samples are drawn
+ * from the ellipse of points that could still lie on a shorter path (informed RRT*).
+ *
+ * Unlike RRTIntermediatePlanner it doesn't stop at the first path. It keeps shortening the best path until
+ * timeBudget() or maxIterations() runs out, or until the path is as short as the obstacle-free Dubins path.
+ */
+class RRTStarIntermediatePlanner : public IntermediatePlanner
+{
+public:
+    RRTStarIntermediatePlanner(const UAVParameters& uavParams,
+                               const Position& startPos,
+                               const UAVOrientation& startPose,
+                               const Position& endPos,
+                               const UAVOrientation& endPose,
+                               const QList<QPolygonF>& obstacles);
+
+    //pure-virtual from IntermediatePlanner
+    virtual bool plan();
+    virtual QList<Position> results() const;
+
+    //virtual from IntermediatePlanner
+    virtual void takeResults(QList<Position> * destination);
+
+    /**
+     * @brief timeBudget returns how many milliseconds plan() may spend shortening the path. 0 means only
+     * maxIterations() limits it. Defaults to 100.
+     * @return
+     */
+    qint64 timeBudget() const;
+    void setTimeBudget(qint64 msecs);
+
+    /**
+     * @brief maxIterations returns how many samples plan() draws at most. Defaults to 50000.
+     * @return
+     */
+    int maxIterations() const;
+    void setMaxIterations(int iterations);
+
+    /**
+     * @brief bestLengths returns the length (in meters) of each successively shorter path plan() found
+     * @return
+     */
+    const QVector<qreal>& bestLengths() const;
+
+private:
+    QPointF _sample(qreal bestCost, qreal directDistance, const QPointF& goal, qreal squareSize);
+    bool _dubinsLength(const QPointF& from, qreal fromHeading, const QPointF& to, qreal toHeading,
+                       qreal * lengthOut) const;
+    bool _edgeIsFree(const QPointF& from, qreal fromHeading, const QPointF& to, qreal toHeading) const;
+    void _sampleEdge(const QPointF& from, qreal fromHeading, const QPointF& to, qreal toHeading,
+                     QList<Position> * path) const;
+    void _propagateCost(int node, qreal delta);
+    void _buildResults(int goalParent, const QPointF& goal);
+
+    Position _toPosition(const QPointF& meters) const;
+
+    qint64 _timeBudget;
+    int _maxIterations;
+
+    //The tree, in meters east and north of the start
+    QVector<QPointF> _positions;
+    QVector<qreal> _headings;
+    QVector<int> _parents;
+    QVector<qreal> _costs;
+    QVector<QVector<int> > _children;
+
+    qreal _lonPerMeter;
+    qreal _latPerMeter;
+    const ObstacleMap * _collisionMap;
+
+    QList<Position> _results;
+    QVector<qreal> _bestLengths;
+};
+
+#endif // RRTSTARINTERMEDIATEPLANNER_H
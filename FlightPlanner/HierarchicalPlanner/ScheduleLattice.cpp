@@ -0,0 +1,56 @@
+#include "ScheduleLattice.h"
+
+#include <cmath>
+
+ScheduleLattice::ScheduleLattice(const QVectorND &origin, const QList<qreal> &taskTimes, qreal timeslice) :
+    _origin(origin), _taskTimes(taskTimes), _timeslice(timeslice), _maxSlices(origin.dimension(), 0)
+{
+    quint32 mostSlices = 0;
+    for (int i = 0; i < _origin.dimension(); i++)
+    {
+        //Allowing for rounding, so a task that's a whole number of slices long doesn't get a sliver of another
+        const qreal remaining = _taskTimes.at(i) - _origin.val(i);
+        if (remaining > 0.0)
+            _maxSlices[i] = qMax<quint32>(1, ceil(remaining / _timeslice - 1e-6));
+        mostSlices = qMax<quint32>(mostSlices, _maxSlices.at(i));
+    }
+
+    if (mostSlices <= 0xff)
+        _fieldBits = 8;
+    else if (mostSlices <= 0xffff)
+        _fieldBits = 16;
+    else
+        _fieldBits = 32;
+}
+
+ScheduleState ScheduleLattice::origin(int lastTask) const
+{
+    ScheduleState toRet(_origin.dimension(), _fieldBits);
+    toRet.setLastTask(lastTask);
+    return toRet;
+}
+
+ScheduleState ScheduleLattice::advance(const ScheduleState &state, int task) const
+{
+    ScheduleState toRet = state;
+    toRet.setSlices(task, qMin<quint32>(_maxSlices.at(task), state.slices(task) + 1));
+    toRet.setLastTask(task);
+    return toRet;
+}
+
+qreal ScheduleLattice::progress(const ScheduleState &state, int task) const
+{
+    //The last slice ends exactly at the task's time, so finished tasks compare equal to it
+    const quint32 slices = state.slices(task);
+    if (slices >= _maxSlices.at(task))
+        return (_maxSlices.at(task) == 0) ? _origin.val(task) : _taskTimes.at(task);
+    return _origin.val(task) + slices * _timeslice;
+}
+
+QVectorND ScheduleLattice::progress(const ScheduleState &state) const
+{
+    QVectorND toRet(_origin.dimension());
+    for (int i = 0; i < _origin.dimension(); i++)
+        toRet[i] = this->progress(state, i);
+    return toRet;
+}
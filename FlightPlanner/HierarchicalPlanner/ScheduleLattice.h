@@ -0,0 +1,70 @@
+#ifndef SCHEDULELATTICE_H
+#define SCHEDULELATTICE_H
+
+#include <QList>
+#include <QVector>
+
+#include "QVectorND.h"
+#include "ScheduleState.h"
+
+/**
+ * @brief The ScheduleLattice class is the grid of progress that one pass of the schedule search moves on. Every
+ * task starts at its progress in the search's start state and moves a time slice at a time, the last slice
+ * stopping short at the task's time. So a task's progress is fixed by the number of slices flown, which is what
+ * ScheduleState stores, and the lattice turns those counts back into task times.
+ *
+ * Fields are as narrow as the task with the most slices to go allows, so with up to 255 slices a task, eight
+ * tasks' progress fits in a word.
+ */
+class ScheduleLattice
+{
+public:
+    /**
+     * @brief ScheduleLattice
+     * @param origin the progress of every task that zero slices stand for
+     * @param taskTimes how long each task takes. No task moves past its time.
+     * @param timeslice
+     */
+    ScheduleLattice(const QVectorND& origin, const QList<qreal>& taskTimes, qreal timeslice);
+
+    /**
+     * @brief origin returns the state with no slices flown since the origin
+     * @param lastTask
+     * @return
+     */
+    ScheduleState origin(int lastTask) const;
+
+    /**
+     * @brief advance returns state with one more slice of task flown, and task flown last
+     * @param state
+     * @param task
+     * @return
+     */
+    ScheduleState advance(const ScheduleState& state, int task) const;
+
+    /**
+     * @brief progress returns how much of task state has flown, in seconds
+     * @param state
+     * @param task
+     * @return
+     */
+    qreal progress(const ScheduleState& state, int task) const;
+
+    /**
+     * @brief progress returns how much of every task state has flown, in seconds
+     * @param state
+     * @return
+     */
+    QVectorND progress(const ScheduleState& state) const;
+
+private:
+    QVectorND _origin;
+    QList<qreal> _taskTimes;
+    qreal _timeslice;
+
+    //Slices from the origin to each task's time
+    QVector<quint32> _maxSlices;
+    int _fieldBits;
+};
+
+#endif // SCHEDULELATTICE_H
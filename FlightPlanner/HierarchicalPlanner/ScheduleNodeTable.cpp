@@ -0,0 +1,127 @@
+#include "ScheduleNodeTable.h"
+
+#include <limits>
+
+//Slots in a new table. Always a power of two.
+const int INITIAL_SLOTS = 1024;
+
+ScheduleNodeTable::ScheduleNodeTable() :
+    _accounting("ScheduleNodes")
+{
+    this->clear();
+}
+
+int ScheduleNodeTable::find(const ScheduleState &state) const
+{
+    return _slots.at(_slotFor(state));
+}
+
+int ScheduleNodeTable::insert(const ScheduleState &state, bool *added)
+{
+    int slot = _slotFor(state);
+    if (_slots.at(slot) >= 0)
+    {
+        if (added)
+            *added = false;
+        return _slots.at(slot);
+    }
+
+    //Keep at least a third of the slots empty so probes stay short
+    if (3 * (_nodes.size() + 1) > 2 * _slots.size())
+    {
+        _grow();
+        slot = _slotFor(state);
+    }
+
+    Node node;
+    node.state = state;
+    node.cost = std::numeric_limits<qreal>::max();
+    node.parent = -1;
+    node.closed = false;
+    node.dominated = false;
+    const int capacity = _nodes.capacity();
+    _nodes.append(node);
+    _slots[slot] = _nodes.size() - 1;
+    if (_nodes.capacity() != capacity)
+        _updateAccounting();
+
+    if (added)
+        *added = true;
+    return _nodes.size() - 1;
+}
+
+ScheduleNodeTable::Node &ScheduleNodeTable::node(int index)
+{
+    return _nodes[index];
+}
+
+const ScheduleNodeTable::Node &ScheduleNodeTable::at(int index) const
+{
+    return _nodes.at(index);
+}
+
+qreal ScheduleNodeTable::cost(const ScheduleState &state) const
+{
+    const int index = this->find(state);
+    if (index < 0)
+        return std::numeric_limits<qreal>::max();
+    return _nodes.at(index).cost;
+}
+
+int ScheduleNodeTable::size() const
+{
+    return _nodes.size();
+}
+
+qint64 ScheduleNodeTable::memoryBytes() const
+{
+    qint64 toRet = (qint64)_slots.size() * sizeof(int);
+    toRet += (qint64)_nodes.size() * sizeof(Node);
+    if (!_nodes.isEmpty())
+        toRet += (qint64)_nodes.size() * _nodes.first().state.heapBytes();
+    return toRet;
+}
+
+void ScheduleNodeTable::clear()
+{
+    _nodes.clear();
+    _slots.fill(-1, INITIAL_SLOTS);
+    _updateAccounting();
+}
+
+//private
+int ScheduleNodeTable::_slotFor(const ScheduleState &state) const
+{
+    //The slot holding state's record, or the empty one where it would go
+    const int mask = _slots.size() - 1;
+    int slot = qHash(state) & mask;
+    while (_slots.at(slot) >= 0 && _nodes.at(_slots.at(slot)).state != state)
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+//private
+void ScheduleNodeTable::_grow()
+{
+    _slots.fill(-1, 2 * _slots.size());
+    const int mask = _slots.size() - 1;
+    for (int index = 0; index < _nodes.size(); index++)
+    {
+        int slot = qHash(_nodes.at(index).state) & mask;
+        while (_slots.at(slot) >= 0)
+            slot = (slot + 1) & mask;
+        _slots[slot] = index;
+    }
+    _updateAccounting();
+}
+
+//private
+void ScheduleNodeTable::_updateAccounting()
+{
+    //Like memoryBytes(), but for what's allocated rather than what's used
+    qint64 bytes = (qint64)_slots.capacity() * sizeof(int);
+    bytes += (qint64)_nodes.capacity() * sizeof(Node);
+    if (!_nodes.isEmpty())
+        bytes += (qint64)_nodes.capacity() * _nodes.first().state.heapBytes();
+    _accounting.setBytes(bytes);
+}
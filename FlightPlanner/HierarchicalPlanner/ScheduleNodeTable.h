@@ -0,0 +1,92 @@
+#ifndef SCHEDULENODETABLE_H
+#define SCHEDULENODETABLE_H
+
+#include <QtGlobal>
+#include <QVector>
+
+#include "ScheduleState.h"
+#include "AllocationTracker.h"
+
+/**
+ * @brief The ScheduleNodeTable class holds everything the schedule search knows about the states it has reached:
+ * one record per state, found by index.
+ *
+ * States are only hashed when a move reaches them, into an open-addressing table of record indices with
+ * linear probing. ScheduleState's hash is mixed in every bit, so the table uses its low bits as they are. The
+ * search (and its open list) refers to states by index, so a state's slice counts are stored once and aren't
+ * hashed again when it's expanded or traced back. Records are never removed.
+ *
+ * Transition flights aren't stored: the one into a state follows from its parent and its last task, and the
+ * planner's transition cache still has it when the schedule is traced back.
+ *
+ * The table's memory is tracked as "ScheduleNodes" (see AllocationTracker).
+ */
+class ScheduleNodeTable
+{
+public:
+    struct Node
+    {
+        ScheduleState state;
+
+        //Cost of the cheapest way found to reach the state
+        qreal cost;
+
+        //The record this one was reached from, or -1 for the start
+        int parent;
+
+        bool closed;
+        bool dominated;
+    };
+
+    ScheduleNodeTable();
+
+    /**
+     * @brief find returns the index of state's record, or -1 if it has none
+     * @param state
+     * @return
+     */
+    int find(const ScheduleState& state) const;
+
+    /**
+     * @brief insert returns the index of state's record, adding one (with infinite cost and no parent) if it has
+     * none.
+     * @param state
+     * @param added set to whether a record was added. May be null.
+     * @return
+     */
+    int insert(const ScheduleState& state, bool * added = 0);
+
+    Node& node(int index);
+    const Node& at(int index) const;
+
+    /**
+     * @brief cost returns the cost of state's record, or std::numeric_limits<qreal>::max() if it has none
+     * @param state
+     * @return
+     */
+    qreal cost(const ScheduleState& state) const;
+
+    int size() const;
+
+    /**
+     * @brief memoryBytes estimates the memory the table takes
+     * @return
+     */
+    qint64 memoryBytes() const;
+
+    void clear();
+
+private:
+    int _slotFor(const ScheduleState& state) const;
+    void _grow();
+    void _updateAccounting();
+
+    QVector<Node> _nodes;
+
+    //Record indices, -1 for an empty slot. The size is a power of two.
+    QVector<int> _slots;
+
+    AllocationScope _accounting;
+};
+
+#endif // SCHEDULENODETABLE_H
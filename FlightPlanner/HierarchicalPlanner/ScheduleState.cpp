@@ -0,0 +1,148 @@
+#include "ScheduleState.h"
+
+ScheduleState::ScheduleState() :
+    _lastTask(-1), _taskCount(0), _fieldBits(8)
+{
+    _words[0] = 0;
+    _words[1] = 0;
+}
+
+ScheduleState::ScheduleState(int taskCount, int fieldBits) :
+    _lastTask(-1), _taskCount(taskCount), _fieldBits(fieldBits)
+{
+    _words[0] = 0;
+    _words[1] = 0;
+
+    const int fieldsPerWord = 64 / _fieldBits;
+    const int wordCount = (taskCount + fieldsPerWord - 1) / fieldsPerWord;
+    if (wordCount > INLINE_WORDS)
+        _moreWords.fill(0, wordCount - INLINE_WORDS);
+}
+
+int ScheduleState::taskCount() const
+{
+    return _taskCount;
+}
+
+int ScheduleState::fieldBits() const
+{
+    return _fieldBits;
+}
+
+quint32 ScheduleState::slices(int task) const
+{
+    const int fieldsPerWord = 64 / _fieldBits;
+    const int shift = (task % fieldsPerWord) * _fieldBits;
+    const quint64 mask = (Q_UINT64_C(1) << _fieldBits) - 1;
+    return (quint32) ((_word(task / fieldsPerWord) >> shift) & mask);
+}
+
+void ScheduleState::setSlices(int task, quint32 slices)
+{
+    const int fieldsPerWord = 64 / _fieldBits;
+    const int shift = (task % fieldsPerWord) * _fieldBits;
+    const quint64 mask = (Q_UINT64_C(1) << _fieldBits) - 1;
+    quint64& word = _word(task / fieldsPerWord);
+    word = (word & ~(mask << shift)) | (((quint64) slices & mask) << shift);
+}
+
+int ScheduleState::lastTask() const
+{
+    return _lastTask;
+}
+
+void ScheduleState::setLastTask(int task)
+{
+    _lastTask = task;
+}
+
+bool ScheduleState::sharesPositionWith(const ScheduleState &other) const
+{
+    if (_lastTask != other._lastTask)
+        return false;
+    else if (_lastTask < 0)
+        return true;
+    return this->slices(_lastTask) == other.slices(_lastTask);
+}
+
+quint64 ScheduleState::positionKey() const
+{
+    if (_lastTask < 0)
+        return 0;
+    return ((quint64) (_lastTask + 1) << 32) | this->slices(_lastTask);
+}
+
+bool ScheduleState::covers(const ScheduleState &other) const
+{
+    if (!this->sharesPositionWith(other) || _taskCount != other._taskCount || _fieldBits != other._fieldBits)
+        return false;
+
+    for (int i = 0; i < _taskCount; i++)
+    {
+        if (this->slices(i) < other.slices(i))
+            return false;
+    }
+    return true;
+}
+
+int ScheduleState::heapBytes() const
+{
+    if (_moreWords.isEmpty())
+        return 0;
+    return _moreWords.size() * sizeof(quint64);
+}
+
+uint ScheduleState::hash() const
+{
+    //Multiply-xor each word in. The high bits of the product are the best mixed, so fold them down.
+    const quint64 multiplier = Q_UINT64_C(0x9e3779b97f4a7c15);
+    quint64 toRet = (quint64) (_lastTask + 1) * multiplier;
+    toRet = (toRet ^ _words[0]) * multiplier;
+    toRet = (toRet ^ _words[1]) * multiplier;
+    foreach(quint64 word, _moreWords)
+        toRet = (toRet ^ word) * multiplier;
+    return (uint) (toRet ^ (toRet >> 32));
+}
+
+bool ScheduleState::operator ==(const ScheduleState &other) const
+{
+    return _words[0] == other._words[0] && _words[1] == other._words[1] && _lastTask == other._lastTask
+            && _moreWords == other._moreWords;
+}
+
+bool ScheduleState::operator !=(const ScheduleState &other) const
+{
+    return !(*this == other);
+}
+
+//private
+quint64 ScheduleState::_word(int index) const
+{
+    if (index < INLINE_WORDS)
+        return _words[index];
+    return _moreWords.at(index - INLINE_WORDS);
+}
+
+//private
+quint64 &ScheduleState::_word(int index)
+{
+    if (index < INLINE_WORDS)
+        return _words[index];
+    return _moreWords[index - INLINE_WORDS];
+}
+
+//non-member
+uint qHash(const ScheduleState &state)
+{
+    return state.hash();
+}
+
+//non-member
+QDebug operator<<(QDebug dbg, const ScheduleState &state)
+{
+    dbg.nospace() << "(";
+    for (int i = 0; i < state.taskCount(); i++)
+        dbg.nospace() << (i > 0 ? ", " : "") << state.slices(i);
+    dbg.nospace() << ") slices after task " << state.lastTask();
+    return dbg.space();
+}
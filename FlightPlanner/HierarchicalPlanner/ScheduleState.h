@@ -0,0 +1,92 @@
+#ifndef SCHEDULESTATE_H
+#define SCHEDULESTATE_H
+
+#include <QtGlobal>
+#include <QDebug>
+#include <QVector>
+
+/**
+ * @brief The ScheduleState class is a node of the hierarchical planner's schedule search: how far each task has
+ * been flown and which task was flown last. Together these fix where the UAV is, so two schedules that reach
+ * the same progress by ending on different tasks are different states.
+ *
+ * Progress is kept as the number of time slices flown of each task, packed into fields of fieldBits() bits. The
+ * first two 64-bit words are stored inline, so small missions' states don't allocate and compare and hash in a
+ * couple of operations. A ScheduleLattice turns slice counts into task times and back. States are only
+ * comparable with states from the same lattice.
+ */
+class ScheduleState
+{
+public:
+    ScheduleState();
+
+    /**
+     * @brief ScheduleState makes a state with no slices of any task flown and no task flown last
+     * @param taskCount
+     * @param fieldBits bits per task. 8, 16 or 32.
+     */
+    ScheduleState(int taskCount, int fieldBits);
+
+    int taskCount() const;
+    int fieldBits() const;
+
+    /**
+     * @brief slices returns how many slices of task have been flown
+     */
+    quint32 slices(int task) const;
+    void setSlices(int task, quint32 slices);
+
+    /**
+     * @brief lastTask returns the index of the task flown last, or -1 if nothing has been flown yet
+     */
+    int lastTask() const;
+    void setLastTask(int task);
+
+    /**
+     * @brief sharesPositionWith returns true if both states are at the same point of the same task's sub-flight
+     */
+    bool sharesPositionWith(const ScheduleState& other) const;
+
+    /**
+     * @brief positionKey returns a key that's the same for exactly the states that share a position
+     */
+    quint64 positionKey() const;
+
+    /**
+     * @brief covers returns true if this state shares other's position and has flown at least as much of every
+     * task. Reached no later, such a state can do nearly anything other can: it only differs in where it joins
+     * the tasks it's further along.
+     */
+    bool covers(const ScheduleState& other) const;
+
+    /**
+     * @brief heapBytes returns the memory the state has allocated for tasks that don't fit in its inline words
+     */
+    int heapBytes() const;
+
+    /**
+     * @brief hash returns a hash of the whole state, well mixed in every bit
+     */
+    uint hash() const;
+
+    bool operator ==(const ScheduleState& other) const;
+    bool operator !=(const ScheduleState& other) const;
+
+private:
+    static const int INLINE_WORDS = 2;
+
+    quint64 _word(int index) const;
+    quint64& _word(int index);
+
+    quint64 _words[INLINE_WORDS];
+    QVector<quint64> _moreWords;
+
+    qint16 _lastTask;
+    quint16 _taskCount;
+    quint8 _fieldBits;
+};
+
+uint qHash(const ScheduleState& state);
+QDebug operator<<(QDebug dbg, const ScheduleState& state);
+
+#endif // SCHEDULESTATE_H
@@ -2,10 +2,10 @@
 
 SubFlightNode::SubFlightNode(const Position &pos,
                              const UAVOrientation &pose,
-                             const QSharedPointer<SubFlightNode> &parent) :
-    _position(pos), _orientation(pose)
+                             int parentIndex,
+                             int depth) :
+    _position(pos), _orientation(pose), _parentIndex(parentIndex), _depth(depth)
 {
-    this->setParent(parent);
 }
 
 const Position &SubFlightNode::position() const
@@ -18,31 +18,39 @@ const UAVOrientation &SubFlightNode::orientation() const
     return _orientation;
 }
 
-QSharedPointer<SubFlightNode> SubFlightNode::parent() const
+int SubFlightNode::parentIndex() const
 {
-    return _parent;
+    return _parentIndex;
 }
 
-void SubFlightNode::setParent(const QSharedPointer<SubFlightNode> &parent)
+int SubFlightNode::depth() const
 {
-    _parent = parent;
+    return _depth;
+}
 
-    _path.clear();
+const QVector3D &SubFlightNode::xyz()
+{
+    if (_xyz.isNull())
+        _xyz = Conversions::lla2xyz(_position);
+    return _xyz;
+}
 
-    if (!_parent.isNull())
-        _path = _parent->path();
+const LatticePose &SubFlightNode::latticePose() const
+{
+    return _latticePose;
+}
 
-    _path.append(this->position());
+void SubFlightNode::setLatticePose(const LatticePose &pose)
+{
+    _latticePose = pose;
 }
 
-const QList<Position> &SubFlightNode::path() const
+const QSharedPointer<FlightTaskScoringState> &SubFlightNode::scoringState() const
 {
-    return _path;
+    return _scoringState;
 }
 
-const QVector3D &SubFlightNode::xyz()
+void SubFlightNode::setScoringState(const QSharedPointer<FlightTaskScoringState> &state)
 {
-    if (_xyz.isNull())
-        _xyz = Conversions::lla2xyz(_position);
-    return _xyz;
+    _scoringState = state;
 }
@@ -2,38 +2,70 @@
 #define SUBFLIGHTNODE_H
 
 #include <QSharedPointer>
-#include <QList>
 
 #include "Position.h"
 #include "UAVOrientation.h"
+#include "MotionPrimitiveTable.h"
 #include "guts/Conversions.h"
+#include "FlightTasks/FlightTaskScoringState.h"
 
+/**
+ * @brief The SubFlightNode class is one waypoint in SubFlightPlanner's search tree.
+ * Nodes live in a SubFlightNodeArena and refer to their parent by index, so a node doesn't carry its
+ * whole path around. Use SubFlightNodeArena::path() to walk back up to the root.
+ */
 class SubFlightNode
 {
 public:
-    SubFlightNode(const Position& pos,
-                  const UAVOrientation& pose,
-                  const QSharedPointer<SubFlightNode>& parent = QSharedPointer<SubFlightNode>());
+    SubFlightNode(const Position& pos = Position(),
+                  const UAVOrientation& pose = UAVOrientation(),
+                  int parentIndex = -1,
+                  int depth = 0);
 
     const Position& position() const;
 
     const UAVOrientation& orientation() const;
 
-    QSharedPointer<SubFlightNode> parent() const;
-    void setParent(const QSharedPointer<SubFlightNode>& parent);
+    /**
+     * @brief parentIndex returns the arena index of our parent, or -1 if we are the root.
+     * @return
+     */
+    int parentIndex() const;
 
-    const QList<Position>& path() const;
+    /**
+     * @brief depth returns the number of waypoints between us and the root. The root has depth 0.
+     * @return
+     */
+    int depth() const;
 
     const QVector3D& xyz();
 
+    /**
+     * @brief latticePose returns where we are on the search's MotionPrimitiveTable lattice. The root is at its
+     * origin.
+     * @return
+     */
+    const LatticePose& latticePose() const;
+    void setLatticePose(const LatticePose& pose);
+
+    /**
+     * @brief scoringState is the task's incremental score for the path ending at this node. May be null
+     * once the node has been expanded.
+     * @return
+     */
+    const QSharedPointer<FlightTaskScoringState>& scoringState() const;
+    void setScoringState(const QSharedPointer<FlightTaskScoringState>& state);
+
 private:
     Position _position;
     UAVOrientation _orientation;
-    QSharedPointer<SubFlightNode> _parent;
-
-    QList<Position> _path;
+    int _parentIndex;
+    int _depth;
+    LatticePose _latticePose;
 
     QVector3D _xyz;
+
+    QSharedPointer<FlightTaskScoringState> _scoringState;
 };
 
 #endif // SUBFLIGHTNODE_H
@@ -0,0 +1,70 @@
+#include "SubFlightNodeArena.h"
+
+SubFlightNodeArena::SubFlightNodeArena() :
+    _accounting("SubFlightNodes")
+{
+}
+
+int SubFlightNodeArena::add(const SubFlightNode &node)
+{
+    const int capacity = _nodes.capacity();
+    _nodes.append(node);
+    if (_nodes.capacity() != capacity)
+        _updateAccounting();
+    return _nodes.size() - 1;
+}
+
+const SubFlightNode &SubFlightNodeArena::at(int index) const
+{
+    return _nodes.at(index);
+}
+
+SubFlightNode &SubFlightNodeArena::operator [](int index)
+{
+    return _nodes[index];
+}
+
+int SubFlightNodeArena::size() const
+{
+    return _nodes.size();
+}
+
+void SubFlightNodeArena::reserve(int size)
+{
+    _nodes.reserve(size);
+    _updateAccounting();
+}
+
+void SubFlightNodeArena::clear()
+{
+    _nodes.clear();
+    _updateAccounting();
+}
+
+QList<Position> SubFlightNodeArena::path(int index) const
+{
+    QList<Position> toRet;
+    if (index < 0 || index >= _nodes.size())
+        return toRet;
+
+    //Walk up to the root, then flip it around
+    QVector<Position> reversed;
+    reversed.reserve(_nodes.at(index).depth() + 1);
+    while (index >= 0)
+    {
+        const SubFlightNode& node = _nodes.at(index);
+        reversed.append(node.position());
+        index = node.parentIndex();
+    }
+
+    toRet.reserve(reversed.size());
+    for (int i = reversed.size() - 1; i >= 0; i--)
+        toRet.append(reversed.at(i));
+    return toRet;
+}
+
+//private
+void SubFlightNodeArena::_updateAccounting()
+{
+    _accounting.setBytes((qint64)_nodes.capacity() * sizeof(SubFlightNode));
+}
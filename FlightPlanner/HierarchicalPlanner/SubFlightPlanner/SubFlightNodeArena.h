@@ -0,0 +1,49 @@
+#ifndef SUBFLIGHTNODEARENA_H
+#define SUBFLIGHTNODEARENA_H
+
+#include <QVector>
+#include <QList>
+
+#include "SubFlightNode.h"
+#include "AllocationTracker.h"
+
+/**
+ * @brief The SubFlightNodeArena class owns every node of a SubFlightPlanner search in one contiguous
+ * vector. Nodes are addressed by index and are never removed until clear(), so indices stay valid for the
+ * whole search. Memory grows linearly with the number of nodes generated. It's tracked as "SubFlightNodes" (see
+ * AllocationTracker).
+ */
+class SubFlightNodeArena
+{
+public:
+    SubFlightNodeArena();
+
+    /**
+     * @brief add copies the node into the arena.
+     * @param node
+     * @return the index of the new node
+     */
+    int add(const SubFlightNode& node);
+
+    const SubFlightNode& at(int index) const;
+    SubFlightNode& operator[](int index);
+
+    int size() const;
+    void reserve(int size);
+    void clear();
+
+    /**
+     * @brief path returns the positions from the root down to (and including) the node at index.
+     * @param index
+     * @return
+     */
+    QList<Position> path(int index) const;
+
+private:
+    void _updateAccounting();
+
+    QVector<SubFlightNode> _nodes;
+    AllocationScope _accounting;
+};
+
+#endif // SUBFLIGHTNODEARENA_H
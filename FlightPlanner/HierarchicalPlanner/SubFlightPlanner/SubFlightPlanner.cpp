@@ -1,32 +1,290 @@
 #include "SubFlightPlanner.h"
 
-#include <QMap>
-#include <QMutableMapIterator>
+#include <QRunnable>
+#include <QThread>
+#include <QVector2D>
 #include <QtDebug>
+#include <algorithm>
 #include <cmath>
+#include <limits>
 
 #include "SubFlightNode.h"
+#include "SubFlightNodeArena.h"
+#include "SweepPattern.h"
+#include "JobSystem.h"
+#include "HierarchicalPlanner/BestFirstSearch.h"
 #include "FlightTasks/FlightTask.h"
+#include "FlightTasks/CoverageBins.h"
 #include "FlightTasks/CoverageTask.h"
+#include "FlightTasks/SamplingTask.h"
+#include "FlightTasks/PolygonIndex.h"
+#include "HierarchicalPlanner/DubinsIntermediate/DubinsIntermediatePlanner.h"
 
-#include "guts/Conversions.h"
+#include "PlanningLog.h"
 
-const qreal PI = 3.1415926535;
+//Nodes don't carry their paths anymore, so this is only a safety net for tasks we can never finish
+const int DEFAULT_MAX_PATH_LENGTH = 20000;
+
+const int DEFAULT_BEAM_WIDTH = 32;
+
+const qreal DEFAULT_MAX_CELL_AREA = 1000.0 * 1000.0;
+
+//Cells are built from sweep lines this fraction of a cell's width apart, which is how finely they follow the area
+const qreal CELL_LINE_FRACTION = 0.125;
+
+const int DEFAULT_TRANSPOSITION_CAPACITY = 65536;
+
+//Search states are the same if they're in the same cell this fraction of a waypoint interval across and the
+//same heading bin of the search's lattice
+const qreal STATE_CELL_INTERVALS = 0.25;
+
+//Unless told otherwise, searches turn by up to the UAV's maximum turn in this many equal steps each way at every
+//waypoint
+const int DEFAULT_BRANCHES_PER_SIDE = 4;
+
+//Sweep lines are spaced this fraction of the widest gap that still covers everything between them
+const qreal SWEEP_SPACING_MARGIN = 0.9;
+
+//Searches rank flights by their performance plus up to this much for being near what the task has left...
+const qreal GUIDANCE_WEIGHT = 0.5;
+
+//...half of it this many meters away
+const qreal GUIDANCE_SCALE = 100.0;
+
+//non-member
+//What the searches rank a flight by. The guidance is worth less than a bin, so it only decides between flights
+//that are as good.
+static qreal guidedScore(const FlightTaskScoringState& state)
+{
+    const qreal distance = state.guidanceDistance();
+    if (distance < 0.0)
+        return state.performance();
+    return state.performance() + GUIDANCE_WEIGHT * GUIDANCE_SCALE / (GUIDANCE_SCALE + distance);
+}
+
+//non-member
+//Rounds towards negative infinity, so cells either side of the origin are the same size
+static inline qint32 floorDivide(qint32 value, qint32 divisor)
+{
+    return (value >= 0) ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+//Builds the successors of node (at nodeIndex in the arena), each with its own extended scoring state.
+static void buildSuccessors(const MotionPrimitiveTable& primitives,
+                            const SubFlightNode& node,
+                            int nodeIndex,
+                            QVector<SubFlightNode> * output)
+{
+    for (int branch = 0; branch < primitives.branchCount(); branch++)
+    {
+        const LatticePose successorLattice = primitives.successor(node.latticePose(), branch);
+        const Position successorPos = primitives.position(successorLattice);
+        SubFlightNode successor(successorPos, primitives.orientation(successorLattice), nodeIndex, node.depth() + 1);
+        successor.setLatticePose(successorLattice);
+
+        QSharedPointer<FlightTaskScoringState> successorState = node.scoringState()->clone();
+        successorState->append(successorPos);
+        successor.setScoringState(successorState);
+
+        output->append(successor);
+    }
+}
+
+//Flies through every waypoint with the matching heading, joining each pair with a Dubins curve
+static QList<Position> flyPoses(const UAVParameters& uavParams,
+                                const QList<Position>& waypoints,
+                                const QList<UAVOrientation>& poses)
+{
+    QList<Position> toRet;
+    for (int i = 0; i + 1 < waypoints.size(); i++)
+    {
+        DubinsIntermediatePlanner segment(uavParams,
+                                          waypoints.at(i), poses.at(i),
+                                          waypoints.at(i + 1), poses.at(i + 1),
+                                          QList<QPolygonF>());
+        segment.plan();
+
+        QList<Position> samples;
+        segment.takeResults(&samples);
+        toRet.append(samples);
+    }
+    return toRet;
+}
+
+struct BeamCandidate
+{
+    SubFlightNode node;
+    qreal score;
+    qreal rank;
+};
+
+struct BeamCandidateGreater
+{
+    bool operator()(const BeamCandidate& a, const BeamCandidate& b) const
+    {
+        return a.rank > b.rank;
+    }
+};
+
+/*
+ * Expands and scores one slice of the beam. Each job only touches its own parents' scoring states
+ * (which it clones), so slices can be expanded concurrently.
+*/
+class BeamExpansionJob : public QRunnable
+{
+public:
+    BeamExpansionJob(const MotionPrimitiveTable * primitives) : _primitives(primitives)
+    {
+        this->setAutoDelete(false);
+    }
+
+    void addParent(const SubFlightNode& node, int nodeIndex)
+    {
+        _parents.append(node);
+        _parentIndices.append(nodeIndex);
+    }
+
+    //virtual from QRunnable
+    virtual void run()
+    {
+        QVector<SubFlightNode> successors;
+        for (int i = 0; i < _parents.size(); i++)
+        {
+            successors.clear();
+            buildSuccessors(*_primitives, _parents.at(i), _parentIndices.at(i), &successors);
+            foreach(const SubFlightNode& successor, successors)
+            {
+                BeamCandidate candidate;
+                candidate.node = successor;
+                candidate.score = successor.scoringState()->performance();
+                candidate.rank = guidedScore(*successor.scoringState());
+                _results.append(candidate);
+            }
+        }
+    }
+
+    const QVector<BeamCandidate>& results() const
+    {
+        return _results;
+    }
+
+private:
+    const MotionPrimitiveTable * _primitives;
+    QVector<SubFlightNode> _parents;
+    QVector<int> _parentIndices;
+    QVector<BeamCandidate> _results;
+};
+
+/*
+ * Searches one cell of a decomposed area with a planner of its own, set up like the one that decomposed it.
+ * Cells only share the task, which scoring only reads, so they can be searched concurrently.
+*/
+class SubFlightPlanner::CellJob : public QRunnable
+{
+public:
+    CellJob(const SubFlightPlanner * parent,
+            const QPolygonF& geoPoly,
+            qreal goal,
+            const Position& entry,
+            const UAVOrientation& entryPose) :
+        _parent(parent), _geoPoly(geoPoly), _goal(goal), _entry(entry), _entryPose(entryPose),
+        _expandedNodes(0), _scoredNodes(0)
+    {
+        this->setAutoDelete(false);
+    }
+
+    //virtual from QRunnable
+    virtual void run()
+    {
+        SubFlightPlanner planner(_parent->_uavParams, _parent->_task, _parent->_area, _entry, _entryPose);
+        planner.setMaxPathLength(_parent->_maxPathLength);
+        planner.setSearchMode(_parent->_searchMode);
+        planner.setBeamWidth(_parent->_beamWidth);
+        planner.setBranchesPerSide(_parent->_branchesPerSide);
+        planner.setWorkerCount(_parent->_workerCount);
+        planner.setRandomSeed(_parent->_randomSeed);
+        planner.setTranspositionCapacity(_parent->transpositionCapacity());
+        planner.setPlanningContext(_parent->_planningContext);
+
+        planner._geoPoly = _geoPoly;
+        planner._goal = _goal;
+        planner._resetSearch();
+        planner._searchPlan();
+
+        _results = planner._results;
+        _expandedNodes = planner._expandedNodes;
+        _scoredNodes = planner._scoredNodes;
+    }
+
+    const Position& entry() const
+    {
+        return _entry;
+    }
+
+    const UAVOrientation& entryPose() const
+    {
+        return _entryPose;
+    }
+
+    const QList<Position>& results() const
+    {
+        return _results;
+    }
+
+    int expandedNodes() const
+    {
+        return _expandedNodes;
+    }
+
+    int scoredNodes() const
+    {
+        return _scoredNodes;
+    }
+
+private:
+    const SubFlightPlanner * _parent;
+    const QPolygonF _geoPoly;
+    const qreal _goal;
+    const Position _entry;
+    const UAVOrientation _entryPose;
+
+    QList<Position> _results;
+    int _expandedNodes;
+    int _scoredNodes;
+};
 
 SubFlightPlanner::SubFlightPlanner(const UAVParameters &uavParams,
                                    const QSharedPointer<FlightTask> &task,
                                    const QSharedPointer<FlightTaskArea> &area,
                                    const Position &startPos,
                                    const UAVOrientation &startPose) :
-    _uavParams(uavParams), _task(task), _area(area), _startPos(startPos), _startPose(startPose)
+    _uavParams(uavParams), _task(task), _area(area), _startPos(startPos), _startPose(startPose), _goal(0.0),
+    _maxPathLength(DEFAULT_MAX_PATH_LENGTH), _maxCellArea(DEFAULT_MAX_CELL_AREA), _searchMode(GreedySearch),
+    _beamWidth(DEFAULT_BEAM_WIDTH), _branchesPerSide(DEFAULT_BRANCHES_PER_SIDE),
+    _workerCount(1), _expandedNodes(0), _scoredNodes(0), _planningContext(0),
+    _reachedStates(DEFAULT_TRANSPOSITION_CAPACITY), _stateCellUnits(1)
 {
+    this->setRandomSeed(0);
 }
 
 void SubFlightPlanner::plan()
 {
-    _results.clear();
+    _geoPoly = _area->geoPoly();
+    _goal = _task->maxTaskPerformance();
+    _resetSearch();
 
-    _greedyPlan();
+    const CoverageTask * coverage = qobject_cast<const CoverageTask *>(_task.data());
+    if (coverage && coverage->coverageMode() == CoverageTask::SweptCoverage && _sweepPlan(coverage))
+        return;
+
+    const SamplingTask * sampling = qobject_cast<const SamplingTask *>(_task.data());
+    if (sampling && _loiterPlan(sampling))
+        return;
+
+    if (coverage && _maxCellArea > 0.0 && _cellPlan(coverage))
+        return;
+
+    _searchPlan();
 }
 
 const QList<Position>& SubFlightPlanner::results() const
@@ -34,63 +292,623 @@ const QList<Position>& SubFlightPlanner::results() const
     return _results;
 }
 
+int SubFlightPlanner::maxPathLength() const
+{
+    return _maxPathLength;
+}
+
+void SubFlightPlanner::setMaxPathLength(int length)
+{
+    _maxPathLength = qMax<int>(1, length);
+}
+
+qreal SubFlightPlanner::maxCellArea() const
+{
+    return _maxCellArea;
+}
+
+void SubFlightPlanner::setMaxCellArea(qreal squareMeters)
+{
+    _maxCellArea = qMax<qreal>(0.0, squareMeters);
+}
+
+SubFlightPlanner::SearchMode SubFlightPlanner::searchMode() const
+{
+    return _searchMode;
+}
+
+void SubFlightPlanner::setSearchMode(SubFlightPlanner::SearchMode mode)
+{
+    _searchMode = mode;
+}
+
+int SubFlightPlanner::beamWidth() const
+{
+    return _beamWidth;
+}
+
+void SubFlightPlanner::setBeamWidth(int width)
+{
+    _beamWidth = qMax<int>(1, width);
+}
+
+int SubFlightPlanner::branchesPerSide() const
+{
+    return _branchesPerSide;
+}
+
+void SubFlightPlanner::setBranchesPerSide(int branches)
+{
+    _branchesPerSide = qMax<int>(1, branches);
+}
+
+int SubFlightPlanner::workerCount() const
+{
+    return _workerCount;
+}
+
+void SubFlightPlanner::setWorkerCount(int count)
+{
+    _workerCount = qMax<int>(0, count);
+}
+
+quint64 SubFlightPlanner::randomSeed() const
+{
+    return _randomSeed;
+}
+
+void SubFlightPlanner::setRandomSeed(quint64 seed)
+{
+    _randomSeed = seed;
+
+    const qreal inputs[3] = {_startPos.longitude(), _startPos.latitude(), _startPose.radians()};
+    _random.seed(PlanningRandom::hashReals(PlanningRandom::mix(seed), inputs, 3));
+}
+
+int SubFlightPlanner::transpositionCapacity() const
+{
+    return _reachedStates.capacity();
+}
+
+void SubFlightPlanner::setTranspositionCapacity(int capacity)
+{
+    _reachedStates.setCapacity(capacity);
+}
+
+quint64 SubFlightPlanner::transpositionHits() const
+{
+    return _reachedStates.hits();
+}
+
+quint64 SubFlightPlanner::transpositionMisses() const
+{
+    return _reachedStates.misses();
+}
+
+int SubFlightPlanner::expandedNodes() const
+{
+    return _expandedNodes;
+}
+
+int SubFlightPlanner::scoredNodes() const
+{
+    return _scoredNodes;
+}
+
+void SubFlightPlanner::setPlanningContext(const PlanningContext *context)
+{
+    _planningContext = context;
+}
+
+const PlanningContext *SubFlightPlanner::planningContext() const
+{
+    return _planningContext;
+}
+
+//private
+void SubFlightPlanner::_resetSearch()
+{
+    _results.clear();
+    _expandedNodes = 0;
+    _scoredNodes = 0;
+
+    _reachedStates.clear();
+    _reachedStates.resetCounters();
+    _stateCellUnits = qMax<qint32>(1, MotionPrimitiveTable::millimeters(STATE_CELL_INTERVALS
+                                                                         * _uavParams.waypointInterval()));
+}
+
+//private
+void SubFlightPlanner::_searchPlan()
+{
+    if (_searchMode == BeamSearch)
+        _beamPlan();
+    else
+        _greedyPlan();
+}
+
 //private
 void SubFlightPlanner::_greedyPlan()
 {
-    QMultiMap<qreal, QSharedPointer<SubFlightNode> > frontier;
+    QSharedPointer<FlightTaskScoringState> rootState = _task->createScoringState(_geoPoly, _uavParams);
+    rootState->append(_startPos);
+    _greedyPlanFrom(_startPos, _startPose, rootState);
+}
+
+struct SubFlightPlanner::GreedySpace
+{
+    typedef int State;
+
+    GreedySpace(SubFlightPlanner * planner) :
+        planner(planner)
+    {
+    }
+
+    //Open nodes are ordered by their score alone, best first, heading for what's left between equal ones
+    qreal heuristic(int nodeIndex) const
+    {
+        return -guidedScore(*arena.at(nodeIndex).scoringState());
+    }
+
+    //We're done once we've accomplished our task, or given up when it gets too long
+    bool isGoal(int nodeIndex) const
+    {
+        const SubFlightNode& node = arena.at(nodeIndex);
+        return node.scoringState()->performance() >= planner->_goal
+                || node.depth() + 1 >= planner->_maxPathLength;
+    }
+
+    bool keepSearching() const
+    {
+        return planner->_keepSearching(1);
+    }
+
+    template <typename Search>
+    void successors(int nodeIndex, const Search&, QVector<int> * nodeIndices, QVector<qreal> * stepCosts)
+    {
+        //Copy what we need - adding successors below may reallocate the arena
+        const SubFlightNode node = arena.at(nodeIndex);
+
+        //The successors get their own copies of the score, so the arena doesn't need ours anymore
+        arena[nodeIndex].setScoringState(QSharedPointer<FlightTaskScoringState>());
+
+        QVector<SubFlightNode> successors;
+        buildSuccessors(planner->_primitives, node, nodeIndex, &successors);
+        planner->_expandedNodes++;
+        planner->_scoredNodes += successors.size();
+        foreach(const SubFlightNode& successor, successors)
+        {
+            if (!planner->_isNewState(successor, successor.scoringState()->performance()))
+                continue;
+            nodeIndices->append(arena.add(successor));
+            stepCosts->append(0.0);
+        }
+    }
+
+    SubFlightPlanner * planner;
+
+    //Every node we generate lives in here. The search just holds indices.
+    SubFlightNodeArena arena;
+};
+
+//private
+void SubFlightPlanner::_greedyPlanFrom(const Position &pos,
+                                       const UAVOrientation &pose,
+                                       const QSharedPointer<FlightTaskScoringState> &state)
+{
+    _startLattice(pos, pose);
+    GreedySpace space(this);
+    BestFirstSearch<GreedySpace, NoStateIndex<int> > search(&space);
+    search.setGreedy(true);
 
-    QSharedPointer<SubFlightNode> rootNode(new SubFlightNode(_startPos, _startPose));
-    frontier.insert(0.0, rootNode);
+    //If there are several nodes with the same fitness, choose one randomly
+    search.openList().setTieBreaker(&_random);
 
-    while (!frontier.isEmpty())
+    //Successors extend their parent's score by one position rather than re-scoring their whole path
+    SubFlightNode rootNode(pos, pose);
+    rootNode.setScoringState(state);
+    _isNewState(rootNode, state->performance());
+    search.addStart(space.arena.add(rootNode));
+
+    //Nodes give up their scores when they're expanded, so read the search's copy of them
+    switch (search.search())
+    {
+    case BestFirstSearch<GreedySpace, NoStateIndex<int> >::GoalFound:
     {
-        //Find the node in the frontier with the best fitness. Grab it and remove it
-        const QList<qreal> scores = frontier.uniqueKeys();
-        const qreal score = scores.last();
-        QList<QSharedPointer<SubFlightNode> > nodes = frontier.values(score);
+        const int goal = search.goal();
+        const qreal score = -search.node(goal).heuristic;
+        _results = space.arena.path(search.node(goal).state);
+        if (score >= _goal)
+            planningDebug(subFlightLog) << "Done. Performance of" << score << "on sub flight";
+        else
+            planningDebug(subFlightLog) << "Failed with performance" << score << "at" << _results.last();
+        break;
+    }
+
+    //Out of time or cancelled, so settle for the best we've got
+    case BestFirstSearch<GreedySpace, NoStateIndex<int> >::Stopped:
+        _results = space.arena.path(search.node(search.closestNode()).state);
+        planningDebug(subFlightLog) << "Interrupted with performance" << -search.node(search.closestNode()).heuristic;
+        break;
+
+    //In case every way forward turns out to be somewhere we've been
+    case BestFirstSearch<GreedySpace, NoStateIndex<int> >::Exhausted:
+        _results = space.arena.path(search.node(search.closestNode()).state);
+        planningDebug(subFlightLog) << "Ran out of new states with performance" << -search.node(search.closestNode()).heuristic;
+        break;
+    }
+}
+
+//private
+void SubFlightPlanner::_beamPlan()
+{
+    SubFlightNodeArena arena;
+
+    _startLattice(_startPos, _startPose);
+    SubFlightNode rootNode(_startPos, _startPose);
+    QSharedPointer<FlightTaskScoringState> rootState = _task->createScoringState(_geoPoly, _uavParams);
+    rootState->append(_startPos);
+    rootNode.setScoringState(rootState);
+
+    QVector<int> beam;
+    beam.append(arena.add(rootNode));
+    _isNewState(rootNode, rootState->performance());
+
+    qreal bestScore = rootState->performance();
+    int bestIndex = beam.first();
 
-        //If there are several nodes with the same fitness, choose one randomly
-        QSharedPointer<SubFlightNode> node = nodes[qrand() % nodes.size()];
-        frontier.remove(score, node);
+    const int workers = (_workerCount == 0) ? QThread::idealThreadCount() : _workerCount;
 
-        //If we've accomplished our task we can quit
-        if (score >= _task->maxTaskPerformance())
+    while (!beam.isEmpty())
+    {
+        if (bestScore >= _goal)
         {
-            qDebug() << "Done. Performance of" << score << "on sub flight";
-            _results = node->path();
+            planningDebug(subFlightLog) << "Done. Performance of" << bestScore << "on sub flight";
             break;
         }
         //If our task gets to long we give up
-        else if (node->path().size() >= 1000)
+        else if (arena.at(beam.first()).depth() + 1 >= _maxPathLength)
+        {
+            planningDebug(subFlightLog) << "Failed with performance" << bestScore;
+            break;
+        }
+
+        if (!_keepSearching(beam.size()))
         {
-            qDebug() << "Failed";
-            qDebug() << score;
-            _results = node->path();
-            qDebug() << _results.last();
+            planningDebug(subFlightLog) << "Interrupted with performance" << bestScore;
             break;
         }
 
-        const qreal lonPerMeter = Conversions::degreesLonPerMeter(node->position().latitude());
-        const qreal latPerMeter = Conversions::degreesLatPerMeter(node->position().latitude());
+        //Split the beam into one slice per worker and expand/score the slices
+        const int jobCount = qBound<int>(1, workers, beam.size());
+        QList<BeamExpansionJob *> jobs;
+        for (int j = 0; j < jobCount; j++)
+            jobs.append(new BeamExpansionJob(&_primitives));
+        for (int b = 0; b < beam.size(); b++)
+            jobs[b % jobCount]->addParent(arena.at(beam[b]), beam[b]);
+
+        if (jobCount <= 1)
+            jobs.first()->run();
+        else
+        {
+            //We're usually a job ourselves, and our slices come before the other planning waiting for workers
+            JobGroup group;
+            foreach(BeamExpansionJob * job, jobs)
+                group.run(job, "BeamExpansion", JobSystem::HighPriority);
+            group.wait();
+        }
+
+        QVector<BeamCandidate> candidates;
+        foreach(BeamExpansionJob * job, jobs)
+            candidates += job->results();
+        qDeleteAll(jobs);
+        _expandedNodes += beam.size();
+        _scoredNodes += candidates.size();
 
-        //Build successors to the current node. Add them to frontier.
-        const int branches = 4;
-        for (int i = -branches; i <= branches; i++)
+        //The expanded nodes' scores have been cloned into their successors
+        foreach(int index, beam)
+            arena[index].setScoringState(QSharedPointer<FlightTaskScoringState>());
+
+        //Keep only the best beamWidth() candidates for the next depth, skipping states we've reached before
+        std::stable_sort(candidates.begin(), candidates.end(), BeamCandidateGreater());
+
+        beam.clear();
+        for (int k = 0; k < candidates.size() && beam.size() < _beamWidth; k++)
         {
-            qreal successorRadians = node->orientation().radians() + _uavParams.maxTurnAngle() * ((qreal)i / (qreal) branches);
-            QVector3D successorVec(cos(successorRadians), sin(successorRadians), 0);
-            successorVec.normalize();
-            successorVec *= _uavParams.waypointInterval();
-            Position successorPos(node->position().longitude() + lonPerMeter * successorVec.x(),
-                                  node->position().latitude() + latPerMeter * successorVec.y());
-
-            UAVOrientation successorPose(successorRadians);
-            QSharedPointer<SubFlightNode> successor(new SubFlightNode(successorPos, successorPose, node));
-
-            const qreal successorScore = _task->calculateFlightPerformance(successor->path(), _area->geoPoly(), _uavParams);
-            frontier.insert(successorScore, successor);
+            if (!_isNewState(candidates[k].node, candidates[k].score))
+                continue;
+
+            const int index = arena.add(candidates[k].node);
+            beam.append(index);
+            if (candidates[k].score > bestScore)
+            {
+                bestScore = candidates[k].score;
+                bestIndex = index;
+            }
         }
     }
+
+    _results = arena.path(bestIndex);
 }
 
+//private
+bool SubFlightPlanner::_sweepPlan(const CoverageTask *task)
+{
+    /*
+     * A bin halfway between two lines and halfway between two waypoints must still be within maxDistance()
+     * of one of them, so the lines can be at most 2 * sqrt(maxDistance^2 - (interval / 2)^2) apart.
+    */
+    const qreal halfInterval = _uavParams.waypointInterval() / 2.0;
+    const qreal maxDistance = task->maxDistance();
+    qreal halfSpacing = maxDistance;
+    if (maxDistance > halfInterval)
+        halfSpacing = sqrt(maxDistance * maxDistance - halfInterval * halfInterval);
+    const SweepPattern pattern(_geoPoly, 2.0 * SWEEP_SPACING_MARGIN * halfSpacing);
+    if (pattern.isEmpty())
+        return false;
+
+    //Fly each line straight along its heading. The Dubins curves between them are the turn-arounds.
+    QList<Position> waypoints;
+    QList<UAVOrientation> poses;
+    waypoints.append(_startPos);
+    poses.append(_startPose);
+    foreach(const QLineF& line, pattern.lines(_startPos.lonLat()))
+    {
+        const Position from(line.p1());
+        const Position to(line.p2());
+
+        //Lines that just graze a corner have no direction to fly
+        if (from.flatOffsetMeters(to).length() < 1.0)
+            continue;
 
+        const UAVOrientation heading(from.angleTo(to));
+        waypoints << from << to;
+        poses << heading << heading;
+    }
+
+    QList<Position> flight = flyPoses(_uavParams, waypoints, poses);
+    if (flight.isEmpty())
+        return false;
+
+    QSharedPointer<FlightTaskScoringState> state = _task->createScoringState(_geoPoly, _uavParams);
+    foreach(const Position& pos, flight)
+        state->append(pos);
+    _scoredNodes++;
+
+    planningDebug(subFlightLog) << "Swept" << pattern.cellCount() << "cells with performance"
+                                << state->performance() << "of" << _goal;
+    if (state->performance() >= _goal)
+    {
+        _results = flight;
+        return true;
+    }
+
+    //Search for whatever the lines missed, starting where they end
+    const Position last = flight.takeLast();
+    UAVOrientation lastPose = poses.last();
+    if (!flight.isEmpty())
+        lastPose = UAVOrientation(flight.last().angleTo(last));
+    _greedyPlanFrom(last, lastPose, state);
+    _results = flight + _results;
+    return true;
+}
+
+//private
+bool SubFlightPlanner::_loiterPlan(const SamplingTask *task)
+{
+    //The longest line across the area that leaves a full turn's width beside it is the outbound leg
+    const qreal turnDiameter = 2.0 * _uavParams.minTurningRadius();
+    const SweepPattern pattern(_geoPoly, turnDiameter);
+    QLineF longest;
+    qreal longestLength = -1.0;
+    foreach(const QLineF& line, pattern.lines(_startPos.lonLat()))
+    {
+        const qreal length = Position(line.p1()).flatOffsetMeters(Position(line.p2())).length();
+        if (length > longestLength)
+        {
+            longest = line;
+            longestLength = length;
+        }
+    }
+    if (longestLength < 1.0)
+        return false;
+
+    //The return leg is a turn's width to whichever side of the outbound leg is in the area
+    const Position out1(longest.p1());
+    const Position out2(longest.p2());
+    const QVector2D along = out1.flatOffsetMeters(out2).normalized();
+    QPointF side(-along.y() * turnDiameter, along.x() * turnDiameter);
+    const PolygonIndex area(_geoPoly);
+    const Position middle((out1.lonLat() + out2.lonLat()) / 2.0);
+    if (!area.contains(middle.flatOffsetToPosition(side).lonLat())
+            && area.contains(middle.flatOffsetToPosition(-side).lonLat()))
+        side = -side;
+    const Position back1 = out2.flatOffsetToPosition(side);
+    const Position back2 = out1.flatOffsetToPosition(side);
+
+    const UAVOrientation outPose(out1.angleTo(out2));
+    const UAVOrientation backPose(back1.angleTo(back2));
+
+    QList<Position> waypoints;
+    QList<UAVOrientation> poses;
+    waypoints << _startPos << out1;
+    poses << _startPose << outPose;
+    QList<Position> flight = flyPoses(_uavParams, waypoints, poses);
+
+    //One lap: out, turn, back, turn. Every lap is the same, so we only fly it once.
+    waypoints.clear();
+    poses.clear();
+    waypoints << out1 << out2 << back1 << back2 << out1;
+    poses << outPose << outPose << backPose << backPose << outPose;
+    const QList<Position> lap = flyPoses(_uavParams, waypoints, poses);
+
+    QSharedPointer<FlightTaskScoringState> state = _task->createScoringState(_geoPoly, _uavParams);
+    foreach(const Position& pos, flight)
+        state->append(pos);
+
+    //Go around until we've spent long enough in the area
+    const qreal goal = task->maxTaskPerformance();
+    while (state->performance() < goal && flight.size() < _maxPathLength)
+    {
+        const qreal before = state->performance();
+        for (int i = 0; i < lap.size() && state->performance() < goal; i++)
+        {
+            state->append(lap.at(i));
+            flight.append(lap.at(i));
+        }
+
+        //A lap that doesn't get us any time in the area never will
+        if (state->performance() <= before)
+            return false;
+    }
+    _scoredNodes++;
+
+    planningDebug(subFlightLog) << "Loitered for" << state->performance() << "of" << goal << "seconds in"
+                                << flight.size() << "waypoints";
+    _results = flight;
+    return true;
+}
+
+//private
+bool SubFlightPlanner::_cellPlan(const CoverageTask *task)
+{
+    //Lines fine enough to follow the area's edges, but few enough that they cost nothing next to the search
+    const SweepPattern pattern(_geoPoly, CELL_LINE_FRACTION * sqrt(_maxCellArea));
+    const QList<QPolygonF> cellPolys = pattern.cellPolygons(_maxCellArea);
+    if (cellPolys.size() < 2)
+        return false;
+
+    //Each cell's goal is the bins in it. Cells too small to hold any have nothing to search for.
+    QList<QPolygonF> remaining;
+    QList<qreal> goals;
+    QList<Position> centers;
+    foreach(const QPolygonF& cellPoly, cellPolys)
+    {
+        CoverageBins bins;
+        bins.build(cellPoly, task->granularity());
+        if (bins.isEmpty())
+            continue;
+        remaining.append(cellPoly);
+        goals.append(bins.count());
+        centers.append(Position(cellPoly.boundingRect().center()));
+    }
+
+    //Visit the cells nearest first, entering each at its corner nearest to the one before, facing into it
+    QList<CellJob *> jobs;
+    Position here = _startPos;
+    while (!remaining.isEmpty())
+    {
+        int nearest = 0;
+        qreal nearestDistance = std::numeric_limits<qreal>::max();
+        for (int i = 0; i < centers.size(); i++)
+        {
+            const qreal distance = here.flatOffsetMeters(centers.at(i)).length();
+            if (distance < nearestDistance)
+            {
+                nearest = i;
+                nearestDistance = distance;
+            }
+        }
+
+        const QPolygonF cellPoly = remaining.takeAt(nearest);
+        const qreal goal = goals.takeAt(nearest);
+        const Position center = centers.takeAt(nearest);
+
+        Position entry(cellPoly.first());
+        foreach(const QPointF& corner, cellPoly)
+        {
+            if (here.flatOffsetMeters(Position(corner)).length() < here.flatOffsetMeters(entry).length())
+                entry = Position(corner);
+        }
+
+        jobs.append(new CellJob(this, cellPoly, goal, entry, UAVOrientation(entry.angleTo(center))));
+        here = center;
+    }
+
+    //Every cell starts from a known corner, so they can all be searched at once
+    JobGroup group;
+    foreach(CellJob * job, jobs)
+        group.run(job, "SubFlightCell");
+    group.wait();
+
+    //Stitch the cells together in order with a Dubins curve from the end of one to the entry of the next
+    QList<Position> flight;
+    Position last = _startPos;
+    UAVOrientation lastPose = _startPose;
+    foreach(CellJob * job, jobs)
+    {
+        _expandedNodes += job->expandedNodes();
+        _scoredNodes += job->scoredNodes();
+
+        const QList<Position>& cellFlight = job->results();
+        if (cellFlight.isEmpty())
+            continue;
+
+        QList<Position> waypoints;
+        QList<UAVOrientation> poses;
+        waypoints << last << job->entry();
+        poses << lastPose << job->entryPose();
+        flight += flyPoses(_uavParams, waypoints, poses);
+        flight += cellFlight;
+
+        last = cellFlight.last();
+        lastPose = job->entryPose();
+        if (cellFlight.size() > 1)
+            lastPose = UAVOrientation(cellFlight.at(cellFlight.size() - 2).angleTo(last));
+    }
+    const int cellCount = jobs.size();
+    qDeleteAll(jobs);
+    if (flight.isEmpty())
+        return false;
+
+    QSharedPointer<FlightTaskScoringState> state = _task->createScoringState(_geoPoly, _uavParams);
+    foreach(const Position& pos, flight)
+        state->append(pos);
+    _scoredNodes++;
+
+    planningDebug(subFlightLog) << "Searched" << cellCount << "cells with performance"
+                                << state->performance() << "of" << _goal;
+    if (state->performance() >= _goal)
+    {
+        _results = flight;
+        return true;
+    }
+
+    //Search for whatever the cells missed, starting where they end
+    flight.takeLast();
+    _greedyPlanFrom(last, lastPose, state);
+    _results = flight + _results;
+    return true;
+}
+
+//private
+void SubFlightPlanner::_startLattice(const Position &pos, const UAVOrientation &pose)
+{
+    _primitives = MotionPrimitiveTable(_uavParams, _branchesPerSide, pos, pose);
+
+    //States of another lattice are somewhere else entirely
+    _reachedStates.clear();
+}
+
+//private
+bool SubFlightPlanner::_isNewState(const SubFlightNode &node, qreal score)
+{
+    //Lattice poses are whole numbers, so the same state always lands in the same cell and heading bin
+    const LatticePose& lattice = node.latticePose();
+    quint64 key = TranspositionTable<qreal>::mix(0, floorDivide(lattice.east, _stateCellUnits));
+    key = TranspositionTable<qreal>::mix(key, floorDivide(lattice.north, _stateCellUnits));
+    key = TranspositionTable<qreal>::mix(key, lattice.headingBin);
+
+    //Getting here again is only worth searching if we've made more progress than last time
+    qreal reachedScore;
+    if (_reachedStates.lookup(key, &reachedScore) && reachedScore >= score)
+        return false;
+    _reachedStates.insert(key, score);
+    return true;
+}
+
+//private
+bool SubFlightPlanner::_keepSearching(int expansions) const
+{
+    return _planningContext == 0 || _planningContext->chargeNodes(expansions);
+}
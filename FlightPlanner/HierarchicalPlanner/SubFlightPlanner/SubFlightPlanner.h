@@ -9,28 +9,190 @@
 #include "Position.h"
 #include "UAVOrientation.h"
 #include "UAVParameters.h"
+#include "PlanningRandom.h"
+#include "PlanningContext.h"
+#include "TranspositionTable.h"
+#include "MotionPrimitiveTable.h"
+
+class CoverageTask;
+class SubFlightNode;
+class SamplingTask;
 
 class SubFlightPlanner
 {
 public:
+    /**
+     * @brief The SearchMode enum chooses how plan() searches.
+     * GreedySearch always expands the single best partial flight generated so far and keeps every
+     * successor around. BeamSearch advances one waypoint at a time and keeps only the beamWidth() best
+     * partial flights at each depth, so memory and time per step are bounded.
+     */
+    enum SearchMode
+    {
+        GreedySearch,
+        BeamSearch
+    };
+
     SubFlightPlanner(const UAVParameters& uavParams,
                      const QSharedPointer<FlightTask>& task,
                      const QSharedPointer<FlightTaskArea>& area,
                      const Position& startPos,
                      const UAVOrientation& startPose);
 
+    /**
+     * @brief plan finds the sub-flight. Coverage tasks in CoverageTask::SweptCoverage mode are swept instead
+     * of searched, whatever the search mode, and the search only takes over for what the sweep missed.
+     * Sampling tasks loiter around a racetrack inside their area, and are only searched if there's no room
+     * for one. Searched coverage of an area bigger than maxCellArea() is planned a cell at a time.
+     */
     void plan();
     const QList<Position> &results() const;
 
+    /**
+     * @brief maxPathLength returns the number of waypoints after which the search gives up on reaching
+     * the task's max performance and returns the best path it has.
+     * @return
+     */
+    int maxPathLength() const;
+    void setMaxPathLength(int length);
+
+    /**
+     * @brief maxCellArea returns the size in square meters above which searched coverage areas are split into
+     * cells (see SweepPattern::cellPolygons()). Every cell is searched on its own, concurrently on
+     * JobSystem::shared() and with its own maxPathLength(), then the cells are flown nearest first and whatever
+     * they missed is searched for from where the last one ends. 0 searches every area whole. Defaults to 1 km².
+     * @return
+     */
+    qreal maxCellArea() const;
+    void setMaxCellArea(qreal squareMeters);
+
+    SearchMode searchMode() const;
+    void setSearchMode(SearchMode mode);
+
+    /**
+     * @brief beamWidth returns the number of partial flights kept at each depth in BeamSearch mode.
+     * @return
+     */
+    int beamWidth() const;
+    void setBeamWidth(int width);
+
+    /**
+     * @brief branchesPerSide returns how many equal steps each way the UAV's maximum turn is split into at every
+     * waypoint of the search. More branches find tighter flights but multiply the nodes expanded. Defaults to 4.
+     * @return
+     */
+    int branchesPerSide() const;
+    void setBranchesPerSide(int branches);
+
+    /**
+     * @brief workerCount returns the number of slices the beam is split into to be expanded and scored in parallel
+     * (on JobSystem::shared()) in BeamSearch mode. 1 (the default) expands serially. 0 means "use
+     * QThread::idealThreadCount()".
+     * @return
+     */
+    int workerCount() const;
+    void setWorkerCount(int count);
+
+    /**
+     * @brief randomSeed is mixed with the start pose to seed the random choices GreedySearch makes, so the
+     * same inputs and seed always give the same sub-flight. Defaults to 0.
+     * @return
+     */
+    quint64 randomSeed() const;
+    void setRandomSeed(quint64 seed);
+
+    /**
+     * @brief transpositionCapacity returns how many search states the searches remember. A partial flight
+     * that reaches a remembered state (nearly the same position and heading) without beating the score it was
+     * reached with before is dropped instead of searched again. 0 disables this.
+     * @return
+     */
+    int transpositionCapacity() const;
+    void setTranspositionCapacity(int capacity);
+
+    /**
+     * @brief transpositionHits and transpositionMisses return how often the last plan() found and didn't find
+     * a partial flight's state already remembered
+     * @return
+     */
+    quint64 transpositionHits() const;
+    quint64 transpositionMisses() const;
+
+    /**
+     * @brief expandedNodes returns how many partial flights the last plan() expanded
+     * @return
+     */
+    int expandedNodes() const;
+
+    /**
+     * @brief scoredNodes returns how many partial flights the last plan() scored, i.e. its fitness evaluations
+     * @return
+     */
+    int scoredNodes() const;
+
+    /**
+     * @brief setPlanningContext gives the searches a context to charge their expansions to. Once it's cancelled
+     * or its budgets are spent they stop and plan() keeps the best partial flight found so far. The context is not
+     * owned by us and must outlive the planner. 0 (the default) means the searches always run to the end.
+     * @param context
+     */
+    void setPlanningContext(const PlanningContext * context);
+    const PlanningContext * planningContext() const;
+
 private:
+    //GreedySearch's tree as a BestFirstSearch space. Its states are nodes in an arena.
+    struct GreedySpace;
+
+    //Searches one cell of a decomposed area
+    class CellJob;
+
+    void _resetSearch();
+    void _searchPlan();
+
     void _greedyPlan();
+    void _greedyPlanFrom(const Position& pos,
+                         const UAVOrientation& pose,
+                         const QSharedPointer<FlightTaskScoringState>& state);
+    void _beamPlan();
+    bool _sweepPlan(const CoverageTask * task);
+    bool _loiterPlan(const SamplingTask * task);
+    bool _cellPlan(const CoverageTask * task);
+    void _startLattice(const Position& pos, const UAVOrientation& pose);
+    bool _isNewState(const SubFlightNode& node, qreal score);
+    bool _keepSearching(int expansions) const;
     const UAVParameters& _uavParams;
     const QSharedPointer<FlightTask>& _task;
     const QSharedPointer<FlightTaskArea>& _area;
     const Position& _startPos;
     const UAVOrientation& _startPose;
 
+    //What's searched: the task's area and max performance, or one cell of it and the bins in there
+    QPolygonF _geoPoly;
+    qreal _goal;
+
     QList<Position> _results;
+
+    int _maxPathLength;
+    qreal _maxCellArea;
+    SearchMode _searchMode;
+    int _beamWidth;
+    int _branchesPerSide;
+    int _workerCount;
+
+    quint64 _randomSeed;
+    PlanningRandom _random;
+
+    int _expandedNodes;
+    int _scoredNodes;
+
+    const PlanningContext * _planningContext;
+
+    //The current search's successors, from the pose it started at
+    MotionPrimitiveTable _primitives;
+
+    //Best score each quantized state of the current search was reached with. Cells are in lattice units.
+    TranspositionTable<qreal> _reachedStates;
+    qint32 _stateCellUnits;
 };
 
 #endif // SUBFLIGHTPLANNER_H
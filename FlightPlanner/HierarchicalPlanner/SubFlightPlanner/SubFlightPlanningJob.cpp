@@ -0,0 +1,93 @@
+#include "SubFlightPlanningJob.h"
+
+#include "SubFlightPlanner.h"
+
+SubFlightPlanningJob::SubFlightPlanningJob(const UAVParameters &uavParams,
+                                           const QSharedPointer<FlightTask> &task,
+                                           const QSharedPointer<FlightTaskArea> &area,
+                                           const Position &startPos,
+                                           const UAVOrientation &startPose) :
+    _uavParams(uavParams), _task(task), _area(area), _startPos(startPos), _startPose(startPose),
+    _beamWidth(0), _branchesPerSide(0), _workerCount(1), _randomSeed(0), _planningContext(0), _expandedNodes(0),
+    _scoredNodes(0), _transpositionHits(0), _transpositionMisses(0)
+{
+    //We collect results after the pool is done with us, so the pool must not delete us
+    this->setAutoDelete(false);
+}
+
+//virtual from QRunnable
+void SubFlightPlanningJob::run()
+{
+    SubFlightPlanner planner(_uavParams, _task, _area, _startPos, _startPose);
+    planner.setRandomSeed(_randomSeed);
+    planner.setPlanningContext(_planningContext);
+    if (_branchesPerSide > 0)
+        planner.setBranchesPerSide(_branchesPerSide);
+    if (_beamWidth > 0)
+    {
+        planner.setSearchMode(SubFlightPlanner::BeamSearch);
+        planner.setBeamWidth(_beamWidth);
+        planner.setWorkerCount(_workerCount);
+    }
+    planner.plan();
+    _results = planner.results();
+    _expandedNodes = planner.expandedNodes();
+    _scoredNodes = planner.scoredNodes();
+    _transpositionHits = planner.transpositionHits();
+    _transpositionMisses = planner.transpositionMisses();
+}
+
+const QSharedPointer<FlightTask> &SubFlightPlanningJob::task() const
+{
+    return _task;
+}
+
+const QList<Position> &SubFlightPlanningJob::results() const
+{
+    return _results;
+}
+
+void SubFlightPlanningJob::setBeamWidth(int width)
+{
+    _beamWidth = qMax<int>(0, width);
+}
+
+void SubFlightPlanningJob::setBranchesPerSide(int branches)
+{
+    _branchesPerSide = qMax<int>(0, branches);
+}
+
+void SubFlightPlanningJob::setWorkerCount(int count)
+{
+    _workerCount = qMax<int>(1, count);
+}
+
+void SubFlightPlanningJob::setRandomSeed(quint64 seed)
+{
+    _randomSeed = seed;
+}
+
+void SubFlightPlanningJob::setPlanningContext(const PlanningContext *context)
+{
+    _planningContext = context;
+}
+
+int SubFlightPlanningJob::expandedNodes() const
+{
+    return _expandedNodes;
+}
+
+int SubFlightPlanningJob::scoredNodes() const
+{
+    return _scoredNodes;
+}
+
+quint64 SubFlightPlanningJob::transpositionHits() const
+{
+    return _transpositionHits;
+}
+
+quint64 SubFlightPlanningJob::transpositionMisses() const
+{
+    return _transpositionMisses;
+}
@@ -0,0 +1,97 @@
+#ifndef SUBFLIGHTPLANNINGJOB_H
+#define SUBFLIGHTPLANNINGJOB_H
+
+#include <QRunnable>
+#include <QSharedPointer>
+#include <QList>
+
+#include "FlightTaskArea.h"
+#include "FlightTasks/FlightTask.h"
+#include "Position.h"
+#include "UAVOrientation.h"
+#include "UAVParameters.h"
+#include "PlanningContext.h"
+
+/**
+ * @brief The SubFlightPlanningJob class runs a SubFlightPlanner for a single task so that sub-flights for
+ * several tasks can be planned at once on a QThreadPool.
+ *
+ * The job keeps its own copies of everything SubFlightPlanner references. It only touches its own
+ * FlightTask, so jobs for different tasks can safely run concurrently.
+ */
+class SubFlightPlanningJob : public QRunnable
+{
+public:
+    SubFlightPlanningJob(const UAVParameters& uavParams,
+                         const QSharedPointer<FlightTask>& task,
+                         const QSharedPointer<FlightTaskArea>& area,
+                         const Position& startPos,
+                         const UAVOrientation& startPose);
+
+    //virtual from QRunnable
+    virtual void run();
+
+    const QSharedPointer<FlightTask>& task() const;
+    const QList<Position>& results() const;
+
+    /**
+     * @brief setBeamWidth makes the job plan with SubFlightPlanner::BeamSearch using the given width.
+     * 0 (the default) uses SubFlightPlanner::GreedySearch.
+     * @param width
+     */
+    void setBeamWidth(int width);
+
+    /**
+     * @brief setBranchesPerSide sets the turn steps the job's SubFlightPlanner searches with (see
+     * SubFlightPlanner::branchesPerSide()). 0 (the default) leaves the planner's own default.
+     * @param branches
+     */
+    void setBranchesPerSide(int branches);
+
+    /**
+     * @brief setWorkerCount sets the number of threads the job's beam search may use.
+     * @param count
+     */
+    void setWorkerCount(int count);
+
+    /**
+     * @brief setRandomSeed sets the seed handed to the job's SubFlightPlanner
+     * @param seed
+     */
+    void setRandomSeed(quint64 seed);
+
+    /**
+     * @brief setPlanningContext sets the context handed to the job's SubFlightPlanner. Not owned by the job and
+     * must outlive it.
+     * @param context
+     */
+    void setPlanningContext(const PlanningContext * context);
+
+    //How much work the job's SubFlightPlanner did. See SubFlightPlanner::expandedNodes() and scoredNodes().
+    int expandedNodes() const;
+    int scoredNodes() const;
+    quint64 transpositionHits() const;
+    quint64 transpositionMisses() const;
+
+private:
+    const UAVParameters _uavParams;
+    const QSharedPointer<FlightTask> _task;
+    const QSharedPointer<FlightTaskArea> _area;
+    const Position _startPos;
+    const UAVOrientation _startPose;
+
+    QList<Position> _results;
+
+    int _beamWidth;
+    int _branchesPerSide;
+    int _workerCount;
+    quint64 _randomSeed;
+    const PlanningContext * _planningContext;
+
+    int _expandedNodes;
+    int _scoredNodes;
+    quint64 _transpositionHits;
+    quint64 _transpositionMisses;
+};
+
+#endif // SUBFLIGHTPLANNINGJOB_H
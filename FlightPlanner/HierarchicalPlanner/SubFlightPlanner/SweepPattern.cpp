@@ -0,0 +1,259 @@
+#include "SweepPattern.h"
+
+#include <QBitArray>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "HierarchicalPlanner/ConvexHull.h"
+#include "guts/Conversions.h"
+
+SweepPattern::SweepPattern() : _lonScale(1.0), _latPerMeter(1.0), _lineSpacing(0.0)
+{
+}
+
+SweepPattern::SweepPattern(const QPolygonF &geoPoly, qreal lineSpacing) :
+    _lonScale(1.0), _latPerMeter(1.0), _lineSpacing(0.0)
+{
+    this->build(geoPoly, lineSpacing);
+}
+
+void SweepPattern::build(const QPolygonF &geoPoly, qreal lineSpacing)
+{
+    _cells.clear();
+    _lonScale = 1.0;
+    _latPerMeter = 1.0;
+    _across = QPointF();
+    _lineSpacing = 0.0;
+    if (geoPoly.size() < 3 || lineSpacing <= 0.0)
+        return;
+
+    //Work in meters around the middle of the area
+    const QPointF center = geoPoly.boundingRect().center();
+    const qreal lonPerMeter = Conversions::degreesLonPerMeter(center.y());
+    const qreal latPerMeter = Conversions::degreesLatPerMeter(center.y());
+    _lonScale = latPerMeter / lonPerMeter;
+
+    QVector<QPointF> local;
+    local.reserve(geoPoly.size());
+    foreach(const QPointF& lonLat, geoPoly)
+        local.append(QPointF((lonLat.x() - center.x()) / lonPerMeter, (lonLat.y() - center.y()) / latPerMeter));
+
+    //Lines parallel to the edge the area is narrowest across means the fewest turn-arounds
+    const QVector<QPointF> hull = ConvexHull::build(local);
+    const int narrowest = ConvexHull::narrowestEdge(hull);
+    qreal angle = 0.0;
+    if (narrowest >= 0)
+    {
+        const QPointF edge = hull.at((narrowest + 1) % hull.size()) - hull.at(narrowest);
+        angle = atan2(edge.y(), edge.x());
+    }
+    const qreal c = cos(angle);
+    const qreal s = sin(angle);
+    _latPerMeter = latPerMeter;
+    _across = QPointF(-s * lineSpacing * lonPerMeter, c * lineSpacing * latPerMeter);
+    _lineSpacing = lineSpacing;
+
+    //Rotate so that the lines are horizontal: u along them, v across them
+    QVector<QPointF> rotated;
+    rotated.reserve(local.size());
+    qreal minV = std::numeric_limits<qreal>::max();
+    qreal maxV = -std::numeric_limits<qreal>::max();
+    foreach(const QPointF& p, local)
+    {
+        const QPointF uv(p.x() * c + p.y() * s, -p.x() * s + p.y() * c);
+        minV = qMin<qreal>(minV, uv.y());
+        maxV = qMax<qreal>(maxV, uv.y());
+        rotated.append(uv);
+    }
+
+    //Center the lines across the area so both outside lines are the same distance from its edge
+    const int lineCount = qMax<int>(1, (int) ceil((maxV - minV) / lineSpacing));
+    const qreal firstV = minV + ((maxV - minV) - (lineCount - 1) * lineSpacing) / 2.0;
+
+    QVector<QPointF> prevPieces;
+    QVector<int> prevCells;
+    for (int line = 0; line < lineCount; line++)
+    {
+        const qreal v = firstV + line * lineSpacing;
+
+        //Where the line crosses the area's boundary, with the same half-open rule as the odd-even fill
+        QVector<qreal> crossings;
+        for (int i = 0; i < rotated.size(); i++)
+        {
+            QPointF low = rotated.at(i);
+            QPointF high = rotated.at((i + 1) % rotated.size());
+            if (low.y() == high.y())
+                continue;
+            else if (low.y() > high.y())
+                qSwap(low, high);
+            if (v < low.y() || v >= high.y())
+                continue;
+            crossings.append(low.x() + (high.x() - low.x()) * (v - low.y()) / (high.y() - low.y()));
+        }
+        std::sort(crossings.begin(), crossings.end());
+
+        //Each pair of crossings is a piece of the line inside the area. Pieces are (start u, end u).
+        QVector<QPointF> pieces;
+        for (int i = 0; i + 1 < crossings.size(); i += 2)
+            pieces.append(QPointF(crossings.at(i), crossings.at(i + 1)));
+
+        //A piece continues the cell of the one piece it overlaps on the previous line, unless that piece also
+        //overlaps others (the area splits) or this one overlaps several (it merges). Otherwise it starts a cell.
+        QVector<int> prevOverlaps(prevPieces.size(), 0);
+        QVector<int> overlapCounts(pieces.size(), 0);
+        QVector<int> overlapped(pieces.size(), -1);
+        for (int i = 0; i < pieces.size(); i++)
+        {
+            for (int j = 0; j < prevPieces.size(); j++)
+            {
+                if (pieces.at(i).x() > prevPieces.at(j).y() || prevPieces.at(j).x() > pieces.at(i).y())
+                    continue;
+                overlapCounts[i]++;
+                overlapped[i] = j;
+                prevOverlaps[j]++;
+            }
+        }
+
+        QVector<int> cells(pieces.size());
+        for (int i = 0; i < pieces.size(); i++)
+        {
+            const int prev = overlapped.at(i);
+            if (overlapCounts.at(i) == 1 && prevOverlaps.at(prev) == 1)
+                cells[i] = prevCells.at(prev);
+            else
+            {
+                cells[i] = _cells.size();
+                _cells.append(Cell());
+            }
+
+            //Back to lon/lat
+            QPointF ends[2];
+            for (int e = 0; e < 2; e++)
+            {
+                const qreal u = (e == 0) ? pieces.at(i).x() : pieces.at(i).y();
+                const qreal x = u * c - v * s;
+                const qreal y = u * s + v * c;
+                ends[e] = QPointF(center.x() + x * lonPerMeter, center.y() + y * latPerMeter);
+            }
+            _cells[cells.at(i)].append(QLineF(ends[0], ends[1]));
+        }
+
+        prevPieces = pieces;
+        prevCells = cells;
+    }
+}
+
+bool SweepPattern::isEmpty() const
+{
+    return _cells.isEmpty();
+}
+
+int SweepPattern::cellCount() const
+{
+    return _cells.size();
+}
+
+QList<QLineF> SweepPattern::lines(const QPointF &startLonLat) const
+{
+    QList<QLineF> toRet;
+    QBitArray swept(_cells.size());
+    QPointF here = startLonLat;
+    for (int visited = 0; visited < _cells.size(); visited++)
+    {
+        //Enter the unswept cell with the nearest corner. A corner is either end of its first or last line.
+        int bestCell = -1;
+        bool bestFromLast = false;
+        bool bestReversed = false;
+        qreal bestDistance = std::numeric_limits<qreal>::max();
+        for (int i = 0; i < _cells.size(); i++)
+        {
+            if (swept.testBit(i))
+                continue;
+            for (int fromLast = 0; fromLast < 2; fromLast++)
+            {
+                const QLineF& line = fromLast ? _cells.at(i).last() : _cells.at(i).first();
+                for (int reversed = 0; reversed < 2; reversed++)
+                {
+                    const qreal distance = _distance(here, reversed ? line.p2() : line.p1());
+                    if (distance < bestDistance)
+                    {
+                        bestDistance = distance;
+                        bestCell = i;
+                        bestFromLast = fromLast;
+                        bestReversed = reversed;
+                    }
+                }
+            }
+        }
+
+        //Back and forth across the cell
+        const Cell& cell = _cells.at(bestCell);
+        for (int k = 0; k < cell.size(); k++)
+        {
+            const QLineF& line = cell.at(bestFromLast ? cell.size() - 1 - k : k);
+            const bool reversed = bestReversed != (k % 2 == 1);
+            toRet.append(reversed ? QLineF(line.p2(), line.p1()) : line);
+        }
+        swept.setBit(bestCell);
+        here = toRet.last().p2();
+    }
+    return toRet;
+}
+
+QList<QPolygonF> SweepPattern::cellPolygons(qreal maxArea) const
+{
+    QList<QPolygonF> toRet;
+    foreach(const Cell& cell, _cells)
+    {
+        int first = 0;
+        while (first < cell.size())
+        {
+            //Each line sweeps a strip a line spacing wide. Take lines until the next one would be too much.
+            int last = first;
+            qreal area = _lengthMeters(cell.at(first)) * _lineSpacing;
+            while (last + 1 < cell.size())
+            {
+                const qreal more = _lengthMeters(cell.at(last + 1)) * _lineSpacing;
+                if (area + more > maxArea)
+                    break;
+                area += more;
+                last++;
+            }
+            toRet.append(_piecePolygon(cell, first, last));
+            first = last + 1;
+        }
+    }
+    return toRet;
+}
+
+//private
+qreal SweepPattern::_distance(const QPointF &a, const QPointF &b) const
+{
+    const qreal dx = (a.x() - b.x()) * _lonScale;
+    const qreal dy = a.y() - b.y();
+    return sqrt(dx * dx + dy * dy);
+}
+
+//private
+qreal SweepPattern::_lengthMeters(const QLineF &line) const
+{
+    return _distance(line.p1(), line.p2()) / _latPerMeter;
+}
+
+//private
+QPolygonF SweepPattern::_piecePolygon(const Cell &cell, int first, int last) const
+{
+    //Up the starts of the lines and back down their ends, half a line past the outside ones
+    const QPointF half = _across / 2.0;
+    QPolygonF toRet;
+    toRet.append(cell.at(first).p1() - half);
+    for (int i = first; i <= last; i++)
+        toRet.append(cell.at(i).p1());
+    toRet.append(cell.at(last).p1() + half);
+    toRet.append(cell.at(last).p2() + half);
+    for (int i = last; i >= first; i--)
+        toRet.append(cell.at(i).p2());
+    toRet.append(cell.at(first).p2() - half);
+    return toRet;
+}
@@ -0,0 +1,77 @@
+#ifndef SWEEPPATTERN_H
+#define SWEEPPATTERN_H
+
+#include <QtGlobal>
+#include <QList>
+#include <QLineF>
+#include <QPointF>
+#include <QPolygonF>
+#include <QVector>
+
+/**
+ * @brief The SweepPattern class lays parallel, evenly spaced lines (a "lawnmower" or boustrophedon pattern)
+ * across an area so that flying all of them covers it.
+ *
+ * The lines run parallel to the hull edge that the area is narrowest across, so there are as few of them (and
+ * as few turn-arounds) as possible.
+ * Non-convex areas are split into cells that each sweep back and forth without leaving the area: a new cell
+ * starts wherever the lines' pieces split or merge. lines() then chains the cells together.
+ *
+ * Everything is worked out when the pattern is built. SweepPattern is a value type.
+ */
+class SweepPattern
+{
+public:
+    SweepPattern();
+    SweepPattern(const QPolygonF& geoPoly, qreal lineSpacing);
+
+    /**
+     * @brief build lays out the lines for an area.
+     * @param geoPoly the area, in lon/lat
+     * @param lineSpacing distance between neighbouring lines in meters
+     */
+    void build(const QPolygonF& geoPoly, qreal lineSpacing);
+
+    bool isEmpty() const;
+
+    int cellCount() const;
+
+    /**
+     * @brief lines returns every line of the pattern in the order and direction to fly them, in lon/lat.
+     * Each cell is swept back and forth, entering at the corner nearest to where the UAV is. The cell after
+     * it is the one with the nearest corner to where the sweep ended.
+     * @param startLonLat where the UAV is before the sweep
+     * @return
+     */
+    QList<QLineF> lines(const QPointF& startLonLat) const;
+
+    /**
+     * @brief cellPolygons returns the area split into the pattern's cells (a boustrophedon decomposition), with
+     * any cell bigger than maxArea cut across its lines into trapezoidal pieces of at most maxArea, but always at
+     * least one line. Each piece reaches half a line spacing past its outside lines, so between them they cover
+     * the area up to how finely the lines follow its edges.
+     * @param maxArea in square meters
+     * @return the pieces in lon/lat, cell by cell and across each cell in order
+     */
+    QList<QPolygonF> cellPolygons(qreal maxArea) const;
+
+private:
+    //A cell's lines in lon/lat, in order across the area. Every line points the same way.
+    typedef QVector<QLineF> Cell;
+
+    qreal _distance(const QPointF& a, const QPointF& b) const;
+    qreal _lengthMeters(const QLineF& line) const;
+    QPolygonF _piecePolygon(const Cell& cell, int first, int last) const;
+
+    QVector<Cell> _cells;
+
+    //Length of a degree of longitude over a degree of latitude at the area, for comparing distances in lon/lat
+    qreal _lonScale;
+    qreal _latPerMeter;
+
+    //Lon/lat offset from one line to the next across the area, and the distance between them in meters
+    QPointF _across;
+    qreal _lineSpacing;
+};
+
+#endif // SWEEPPATTERN_H
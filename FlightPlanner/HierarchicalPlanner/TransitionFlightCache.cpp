@@ -0,0 +1,178 @@
+#include "TransitionFlightCache.h"
+
+#include <cmath>
+
+#include "guts/Conversions.h"
+
+TransitionFlightCache::TransitionFlightCache(qreal positionQuantum, qreal headingQuantum) :
+    _positionQuantum(positionQuantum), _headingQuantum(headingQuantum), _obstacleVersion(0),
+    _hits(0), _misses(0)
+{
+}
+
+bool TransitionFlightCache::lookup(const Position &startPos,
+                                   const UAVOrientation &startPose,
+                                   const Position &endPos,
+                                   const UAVOrientation &endPose,
+                                   QList<Position> *output)
+{
+    if (output == 0)
+        return false;
+
+    const Key key = _makeKey(startPos, startPose, endPos, endPose);
+    QHash<Key, QList<Position> >::const_iterator iter = _flights.constFind(key);
+    if (iter == _flights.constEnd())
+    {
+        _misses++;
+        return false;
+    }
+
+    _hits++;
+    *output = iter.value();
+    return true;
+}
+
+bool TransitionFlightCache::contains(const Position &startPos,
+                                     const UAVOrientation &startPose,
+                                     const Position &endPos,
+                                     const UAVOrientation &endPose) const
+{
+    return _flights.contains(_makeKey(startPos, startPose, endPos, endPose));
+}
+
+void TransitionFlightCache::insert(const Position &startPos,
+                                   const UAVOrientation &startPose,
+                                   const Position &endPos,
+                                   const UAVOrientation &endPose,
+                                   const QList<Position> &flight)
+{
+    _flights.insert(_makeKey(startPos, startPose, endPos, endPose), flight);
+}
+
+void TransitionFlightCache::clear()
+{
+    _flights.clear();
+}
+
+int TransitionFlightCache::size() const
+{
+    return _flights.size();
+}
+
+quint64 TransitionFlightCache::obstacleVersion() const
+{
+    return _obstacleVersion;
+}
+
+void TransitionFlightCache::setObstacleVersion(quint64 version)
+{
+    if (version == _obstacleVersion)
+        return;
+
+    //Flights planned around the old obstacles are useless to us now
+    _obstacleVersion = version;
+    _flights.clear();
+}
+
+quint64 TransitionFlightCache::hits() const
+{
+    return _hits;
+}
+
+quint64 TransitionFlightCache::misses() const
+{
+    return _misses;
+}
+
+void TransitionFlightCache::resetCounters()
+{
+    _hits = 0;
+    _misses = 0;
+}
+
+void TransitionFlightCache::serialize(QDataStream &stream) const
+{
+    stream << _positionQuantum << _headingQuantum << _obstacleVersion;
+
+    stream << (quint32)_flights.size();
+    QHash<Key, QList<Position> >::const_iterator iter;
+    for (iter = _flights.constBegin(); iter != _flights.constEnd(); iter++)
+    {
+        for (int i = 0; i < 6; i++)
+            stream << iter.key().values[i];
+        stream << iter.value();
+    }
+}
+
+bool TransitionFlightCache::deserialize(QDataStream &stream)
+{
+    qreal positionQuantum;
+    qreal headingQuantum;
+    quint64 obstacleVersion;
+    stream >> positionQuantum >> headingQuantum >> obstacleVersion;
+
+    //Keys made with other quanta or around other obstacles would never be looked up, so don't keep them
+    const bool compatible = positionQuantum == _positionQuantum && headingQuantum == _headingQuantum
+            && obstacleVersion == _obstacleVersion;
+
+    quint32 numFlights;
+    stream >> numFlights;
+    for (quint32 i = 0; i < numFlights && stream.status() == QDataStream::Ok; i++)
+    {
+        Key key;
+        for (int j = 0; j < 6; j++)
+            stream >> key.values[j];
+        key.obstacleVersion = obstacleVersion;
+
+        QList<Position> flight;
+        stream >> flight;
+        if (compatible && !_flights.contains(key))
+            _flights.insert(key, flight);
+    }
+
+    return stream.status() == QDataStream::Ok;
+}
+
+bool TransitionFlightCache::Key::operator ==(const Key &other) const
+{
+    if (obstacleVersion != other.obstacleVersion)
+        return false;
+
+    for (int i = 0; i < 6; i++)
+    {
+        if (values[i] != other.values[i])
+            return false;
+    }
+    return true;
+}
+
+//private
+TransitionFlightCache::Key TransitionFlightCache::_makeKey(const Position &startPos,
+                                                           const UAVOrientation &startPose,
+                                                           const Position &endPos,
+                                                           const UAVOrientation &endPose) const
+{
+    const qreal startLonQuantum = _positionQuantum * Conversions::degreesLonPerMeter(startPos.latitude());
+    const qreal startLatQuantum = _positionQuantum * Conversions::degreesLatPerMeter(startPos.latitude());
+    const qreal endLonQuantum = _positionQuantum * Conversions::degreesLonPerMeter(endPos.latitude());
+    const qreal endLatQuantum = _positionQuantum * Conversions::degreesLatPerMeter(endPos.latitude());
+
+    Key toRet;
+    toRet.values[0] = (qint64)floor(startPos.longitude() / startLonQuantum);
+    toRet.values[1] = (qint64)floor(startPos.latitude() / startLatQuantum);
+    toRet.values[2] = (qint64)floor(startPose.radians() / _headingQuantum);
+    toRet.values[3] = (qint64)floor(endPos.longitude() / endLonQuantum);
+    toRet.values[4] = (qint64)floor(endPos.latitude() / endLatQuantum);
+    toRet.values[5] = (qint64)floor(endPose.radians() / _headingQuantum);
+    toRet.obstacleVersion = _obstacleVersion;
+    return toRet;
+}
+
+//non-member
+uint qHash(const TransitionFlightCache::Key& key)
+{
+    quint64 toRet = key.obstacleVersion;
+    for (int i = 0; i < 6; i++)
+        toRet ^= (quint64)key.values[i] + Q_UINT64_C(0x9e3779b97f4a7c15) + (toRet << 6) + (toRet >> 2);
+    return (uint)(toRet ^ (toRet >> 32));
+}
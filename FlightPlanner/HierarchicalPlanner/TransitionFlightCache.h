@@ -0,0 +1,98 @@
+#ifndef TRANSITIONFLIGHTCACHE_H
+#define TRANSITIONFLIGHTCACHE_H
+
+#include <QHash>
+#include <QList>
+#include <QDataStream>
+
+#include "Position.h"
+#include "UAVOrientation.h"
+
+/**
+ * @brief The TransitionFlightCache class remembers transition flights that have already been planned
+ * so that the scheduler doesn't have to re-run an intermediate planner every time it considers
+ * the same context switch.
+ *
+ * Start/end positions and headings are quantized before lookup, so poses that are "close enough"
+ * share an entry. Entries are also keyed on an obstacle version so that flights planned around an
+ * old set of no-fly zones are never returned.
+ */
+class TransitionFlightCache
+{
+public:
+    /**
+     * @brief TransitionFlightCache
+     * @param positionQuantum size (in meters) of the grid that start/end positions are snapped to
+     * @param headingQuantum size (in radians) of the bins that start/end headings are snapped to
+     */
+    TransitionFlightCache(qreal positionQuantum = 5.0, qreal headingQuantum = 0.05);
+
+    bool lookup(const Position& startPos,
+                const UAVOrientation& startPose,
+                const Position& endPos,
+                const UAVOrientation& endPose,
+                QList<Position> * output);
+
+    /**
+     * @brief contains returns true if a flight is cached for the given poses. Unlike lookup(), this
+     * doesn't count as a hit or miss.
+     */
+    bool contains(const Position& startPos,
+                  const UAVOrientation& startPose,
+                  const Position& endPos,
+                  const UAVOrientation& endPose) const;
+
+    void insert(const Position& startPos,
+                const UAVOrientation& startPose,
+                const Position& endPos,
+                const UAVOrientation& endPose,
+                const QList<Position>& flight);
+
+    void clear();
+
+    int size() const;
+
+    quint64 obstacleVersion() const;
+    void setObstacleVersion(quint64 version);
+
+    quint64 hits() const;
+    quint64 misses() const;
+    void resetCounters();
+
+    void serialize(QDataStream& stream) const;
+
+    /**
+     * @brief deserialize adds the flights written by serialize() to the cache, as long as they were planned
+     * with the same quanta and around the same obstacles as this cache's. Returns false if the stream was
+     * damaged.
+     */
+    bool deserialize(QDataStream& stream);
+
+public:
+    struct Key
+    {
+        qint64 values[6];
+        quint64 obstacleVersion;
+
+        bool operator ==(const Key& other) const;
+    };
+
+private:
+    Key _makeKey(const Position& startPos,
+                 const UAVOrientation& startPose,
+                 const Position& endPos,
+                 const UAVOrientation& endPose) const;
+
+    qreal _positionQuantum;
+    qreal _headingQuantum;
+    quint64 _obstacleVersion;
+
+    QHash<Key, QList<Position> > _flights;
+
+    quint64 _hits;
+    quint64 _misses;
+};
+
+uint qHash(const TransitionFlightCache::Key& key);
+
+#endif // TRANSITIONFLIGHTCACHE_H
@@ -0,0 +1,188 @@
+#include "TransitionPlanningJob.h"
+
+#include <QScopedPointer>
+
+#include "JobSystem.h"
+#include "PlanningLog.h"
+
+TransitionPlanningJob::TransitionPlanningJob(const UAVParameters &uavParams,
+                                             const Position &startPos,
+                                             const UAVOrientation &startPose,
+                                             const Position &endPos,
+                                             const UAVOrientation &endPose,
+                                             const QList<QPolygonF> &obstacles,
+                                             QSharedPointer<const ObstacleMap> obstacleMap,
+                                             QSharedPointer<const ProbabilisticRoadmap> roadmap,
+                                             QSharedPointer<const VisibilityGraph> visibilityGraph) :
+    _uavParams(uavParams), _startPos(startPos), _startPose(startPose),
+    _endPos(endPos), _endPose(endPose), _obstacles(obstacles), _obstacleMap(obstacleMap), _roadmap(roadmap),
+    _visibilityGraph(visibilityGraph), _maxTerrainElevation(0.0), _succeeded(false), _randomSeed(0), _planningContext(0),
+    _raceFlag(0), _raceIndex(0)
+{
+    //We collect results after the pool is done with us, so the pool must not delete us
+    this->setAutoDelete(false);
+}
+
+//virtual from QRunnable
+void TransitionPlanningJob::run()
+{
+    _results.clear();
+    _succeeded = false;
+
+    if (_strategy.mode() == TransitionStrategy::Race && _strategy.planners().size() > 1)
+        this->_race();
+    else
+        this->_planInOrder();
+}
+
+const Position &TransitionPlanningJob::startPos() const
+{
+    return _startPos;
+}
+
+const UAVOrientation &TransitionPlanningJob::startPose() const
+{
+    return _startPose;
+}
+
+const Position &TransitionPlanningJob::endPos() const
+{
+    return _endPos;
+}
+
+const UAVOrientation &TransitionPlanningJob::endPose() const
+{
+    return _endPose;
+}
+
+const QList<Position> &TransitionPlanningJob::results() const
+{
+    return _results;
+}
+
+bool TransitionPlanningJob::succeeded() const
+{
+    return _succeeded;
+}
+
+void TransitionPlanningJob::setRandomSeed(quint64 seed)
+{
+    _randomSeed = seed;
+}
+
+void TransitionPlanningJob::setPlanningContext(const PlanningContext *context)
+{
+    _planningContext = context;
+}
+
+void TransitionPlanningJob::setTerrain(QSharedPointer<const TerrainModel> terrain, qreal maxElevation)
+{
+    _terrain = terrain;
+    _maxTerrainElevation = maxElevation;
+}
+
+void TransitionPlanningJob::setTuning(const PlannerTuning &tuning)
+{
+    _tuning = tuning;
+}
+
+const TransitionStrategy &TransitionPlanningJob::strategy() const
+{
+    return _strategy;
+}
+
+void TransitionPlanningJob::setStrategy(const TransitionStrategy &strategy)
+{
+    _strategy = strategy;
+}
+
+//private
+void TransitionPlanningJob::_planInOrder()
+{
+    const IntermediatePlannerRegistry::Context context = this->_context();
+    foreach(const QString& name, _strategy.planners())
+    {
+        QScopedPointer<IntermediatePlanner> planner(IntermediatePlannerRegistry::create(name, _uavParams,
+                                                                                        _startPos, _startPose,
+                                                                                        _endPos, _endPose,
+                                                                                        _obstacles, context));
+        if (planner.isNull())
+            continue;
+        planner->setRandomSeed(_randomSeed);
+        planner->setCancelFlag(_raceFlag);
+        _succeeded = planner->plan();
+
+        //Keep the flight even if it failed, in case nothing after it does any better
+        QList<Position> flight;
+        planner->takeResults(&flight);
+
+        //Not every planner can route around high ground, so check every waypoint of what they came up with
+        if (_succeeded && planner->pathCollidesWithTerrain(flight))
+        {
+            planningDebug(intermediateLog) << name << "transition from" << _startPos << "to" << _endPos
+                                           << "passes over terrain above" << _maxTerrainElevation;
+            _succeeded = false;
+        }
+        if (_succeeded || !flight.isEmpty())
+            _results.swap(flight);
+        if (_succeeded || planner->cancelRequested())
+            break;
+    }
+
+    //First to finish wins the race, and the others see the flag and give up
+    if (_succeeded && _raceFlag != 0)
+        _raceFlag->testAndSetOrdered(0, _raceIndex + 1);
+}
+
+//private
+void TransitionPlanningJob::_race()
+{
+    QAtomicInt winner(0);
+    QList<TransitionPlanningJob *> racers;
+    foreach(const QString& name, _strategy.planners())
+    {
+        TransitionPlanningJob * racer = new TransitionPlanningJob(_uavParams,
+                                                                  _startPos, _startPose,
+                                                                  _endPos, _endPose,
+                                                                  _obstacles,
+                                                                  _obstacleMap,
+                                                                  _roadmap,
+                                                                  _visibilityGraph);
+        racer->setRandomSeed(_randomSeed);
+        racer->setPlanningContext(_planningContext);
+        racer->setTerrain(_terrain, _maxTerrainElevation);
+        racer->setTuning(_tuning);
+        racer->setStrategy(TransitionStrategy(QStringList(name)));
+        racer->_raceFlag = &winner;
+        racer->_raceIndex = racers.size();
+        racers.append(racer);
+    }
+
+    //Free workers pick up the other racers while we run the first. If there are none, they run after it and
+    //give up as soon as they see that it won.
+    JobGroup group;
+    for (int i = 1; i < racers.size(); i++)
+        group.run(racers.at(i), "TransitionRace", JobSystem::HighPriority);
+    racers.first()->run();
+    group.wait();
+
+    const int winnerIndex = winner - 1;
+    TransitionPlanningJob * chosen = (winnerIndex >= 0) ? racers.at(winnerIndex) : racers.last();
+    _results.swap(chosen->_results);
+    _succeeded = (winnerIndex >= 0);
+    qDeleteAll(racers);
+}
+
+//private
+IntermediatePlannerRegistry::Context TransitionPlanningJob::_context() const
+{
+    IntermediatePlannerRegistry::Context toRet;
+    toRet.obstacleMap = _obstacleMap.data();
+    toRet.roadmap = _roadmap.data();
+    toRet.visibilityGraph = _visibilityGraph.data();
+    toRet.planningContext = _planningContext;
+    toRet.terrain = _terrain.data();
+    toRet.maxTerrainElevation = _maxTerrainElevation;
+    toRet.tuning = &_tuning;
+    return toRet;
+}
@@ -0,0 +1,122 @@
+#ifndef TRANSITIONPLANNINGJOB_H
+#define TRANSITIONPLANNINGJOB_H
+
+#include <QRunnable>
+#include <QList>
+#include <QPolygonF>
+#include <QSharedPointer>
+#include <QAtomicInt>
+
+#include "Position.h"
+#include "UAVOrientation.h"
+#include "UAVParameters.h"
+#include "ObstacleMap.h"
+#include "ProbabilisticRoadmap.h"
+#include "VisibilityGraph.h"
+#include "TerrainModel.h"
+#include "TransitionStrategy.h"
+#include "IntermediatePlannerRegistry.h"
+#include "PlannerTuning.h"
+
+/**
+ * @brief The TransitionPlanningJob class plans a single transition flight between two poses with the
+ * IntermediatePlanners its TransitionStrategy names. It can be run directly or handed to a QThreadPool so that
+ * many transitions can be planned at once.
+ *
+ * The job keeps its own copies of everything the IntermediatePlanner references. The optional ObstacleMap,
+ * ProbabilisticRoadmap, VisibilityGraph and TerrainModel are shared (read-only) between all of the jobs of a
+ * planning run.
+ */
+class TransitionPlanningJob : public QRunnable
+{
+public:
+    TransitionPlanningJob(const UAVParameters& uavParams,
+                          const Position& startPos,
+                          const UAVOrientation& startPose,
+                          const Position& endPos,
+                          const UAVOrientation& endPose,
+                          const QList<QPolygonF>& obstacles,
+                          QSharedPointer<const ObstacleMap> obstacleMap = QSharedPointer<const ObstacleMap>(),
+                          QSharedPointer<const ProbabilisticRoadmap> roadmap = QSharedPointer<const ProbabilisticRoadmap>(),
+                          QSharedPointer<const VisibilityGraph> visibilityGraph = QSharedPointer<const VisibilityGraph>());
+
+    //virtual from QRunnable
+    virtual void run();
+
+    const Position& startPos() const;
+    const UAVOrientation& startPose() const;
+    const Position& endPos() const;
+    const UAVOrientation& endPose() const;
+
+    const QList<Position>& results() const;
+
+    /**
+     * @brief succeeded returns true if one of the strategy's planners succeeded. If none did, results() is
+     * the last planner's flight, which may hit an obstacle.
+     * @return
+     */
+    bool succeeded() const;
+
+    const TransitionStrategy& strategy() const;
+    void setStrategy(const TransitionStrategy& strategy);
+
+    /**
+     * @brief setRandomSeed sets the seed handed to the job's IntermediatePlanner
+     * @param seed
+     */
+    void setRandomSeed(quint64 seed);
+
+    /**
+     * @brief setPlanningContext sets the context handed to the job's IntermediatePlanners, so that cancelling the
+     * planning run (or running out of budget) stops them. Not owned by the job and must outlive it. 0 (the default)
+     * means the planners always finish.
+     * @param context
+     */
+    void setPlanningContext(const PlanningContext * context);
+
+    /**
+     * @brief setTerrain has the job's IntermediatePlanners keep out of terrain higher than maxElevation (see
+     * IntermediatePlanner::setTerrain()). A planner whose flight still passes over such terrain counts as having
+     * failed, so the strategy's next planner gets a turn. Null (the default) ignores terrain.
+     * @param terrain
+     * @param maxElevation
+     */
+    void setTerrain(QSharedPointer<const TerrainModel> terrain, qreal maxElevation);
+
+    /**
+     * @brief setTuning sets the search parameters handed to the job's IntermediatePlanners. Defaults to the
+     * default tuning.
+     * @param tuning
+     */
+    void setTuning(const PlannerTuning& tuning);
+
+private:
+    void _planInOrder();
+    void _race();
+    IntermediatePlannerRegistry::Context _context() const;
+
+    const UAVParameters _uavParams;
+    const Position _startPos;
+    const UAVOrientation _startPose;
+    const Position _endPos;
+    const UAVOrientation _endPose;
+    const QList<QPolygonF> _obstacles;
+    const QSharedPointer<const ObstacleMap> _obstacleMap;
+    const QSharedPointer<const ProbabilisticRoadmap> _roadmap;
+    const QSharedPointer<const VisibilityGraph> _visibilityGraph;
+    QSharedPointer<const TerrainModel> _terrain;
+    qreal _maxTerrainElevation;
+    PlannerTuning _tuning;
+
+    QList<Position> _results;
+    bool _succeeded;
+    quint64 _randomSeed;
+    TransitionStrategy _strategy;
+    const PlanningContext * _planningContext;
+
+    //Set for the jobs a race runs: the flag that the winner sets to its index + 1, and this job's index
+    QAtomicInt * _raceFlag;
+    int _raceIndex;
+};
+
+#endif // TRANSITIONPLANNINGJOB_H
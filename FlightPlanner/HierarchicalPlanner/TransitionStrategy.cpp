@@ -0,0 +1,34 @@
+#include "TransitionStrategy.h"
+
+TransitionStrategy::TransitionStrategy(const QStringList &planners, TransitionStrategy::Mode mode) :
+    _planners(planners), _mode(mode)
+{
+}
+
+const QStringList &TransitionStrategy::planners() const
+{
+    return _planners;
+}
+
+TransitionStrategy::Mode TransitionStrategy::mode() const
+{
+    return _mode;
+}
+
+//static
+QStringList TransitionStrategy::defaultPlanners()
+{
+    QStringList toRet;
+    toRet << "Dubins" << "VisibilityGraph" << "AstarPRM";
+    return toRet;
+}
+
+bool TransitionStrategy::operator==(const TransitionStrategy &other) const
+{
+    return _mode == other._mode && _planners == other._planners;
+}
+
+bool TransitionStrategy::operator!=(const TransitionStrategy &other) const
+{
+    return !(*this == other);
+}
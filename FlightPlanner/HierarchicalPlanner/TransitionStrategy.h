@@ -0,0 +1,50 @@
+#ifndef TRANSITIONSTRATEGY_H
+#define TRANSITIONSTRATEGY_H
+
+#include <QStringList>
+
+/**
+ * @brief The TransitionStrategy class says which IntermediatePlanners (by their IntermediatePlannerRegistry
+ * names) a transition is planned with, and how.
+ *
+ * In FirstSuccess mode the planners are tried one after another and the first one whose plan() succeeds is kept.
+ * Ordering them cheapest first means a transition only pays for a search when it needs one: the default flies a
+ * plain Dubins path when that misses the obstacles, then the visibility graph's shortest route, then the A*
+ * roadmap/lattice search.
+ *
+ * In Race mode the planners run at once on the shared JobSystem's free workers, and the first to succeed
+ * wins. The others are cancelled.
+ *
+ * In both modes, if no planner succeeds the last planner's flight is used anyway. Planners the registry can't
+ * create for a transition (e.g., VisibilityGraph without a shared graph) are skipped.
+ */
+class TransitionStrategy
+{
+public:
+    enum Mode
+    {
+        FirstSuccess,
+        Race
+    };
+
+    TransitionStrategy(const QStringList& planners = TransitionStrategy::defaultPlanners(),
+                       Mode mode = FirstSuccess);
+
+    const QStringList& planners() const;
+    Mode mode() const;
+
+    /**
+     * @brief defaultPlanners returns Dubins, VisibilityGraph and AstarPRM, in that order
+     * @return
+     */
+    static QStringList defaultPlanners();
+
+    bool operator==(const TransitionStrategy& other) const;
+    bool operator!=(const TransitionStrategy& other) const;
+
+private:
+    QStringList _planners;
+    Mode _mode;
+};
+
+#endif // TRANSITIONSTRATEGY_H
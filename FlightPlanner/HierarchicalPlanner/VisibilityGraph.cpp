@@ -0,0 +1,128 @@
+#include "VisibilityGraph.h"
+
+#include <cmath>
+
+#include "PlanningLog.h"
+
+//Sharp corners are pushed out along their bisector by at most this many clearances
+const qreal MAX_MITER = 3.0;
+
+VisibilityGraph::VisibilityGraph(QSharedPointer<const ObstacleMap> obstacleMap, qreal clearance) :
+    WaypointGraph(obstacleMap, _origin(obstacleMap)), _clearance(qMax<qreal>(0.0, clearance))
+{
+    if (!obstacleMap)
+    {
+        this->finishEdges();
+        return;
+    }
+
+    foreach(const QPolygonF& obstacle, obstacleMap->obstacles())
+        _addCorners(obstacle);
+
+    for (int i = 0; i < this->nodeCount(); i++)
+        for (int j = i + 1; j < this->nodeCount(); j++)
+            this->tryAddEdge(i, j);
+    this->finishEdges();
+
+    planningDebug(intermediateLog) << "Visibility graph has" << this->nodeCount() << "nodes and" << this->edgeCount() << "edges";
+}
+
+qreal VisibilityGraph::clearance() const
+{
+    return _clearance;
+}
+
+//protected
+//pure-virtual from WaypointGraph
+void VisibilityGraph::candidateNodes(const QPointF &, QVector<int> *nodesOut) const
+{
+    nodesOut->resize(this->nodeCount());
+    for (int i = 0; i < this->nodeCount(); i++)
+        (*nodesOut)[i] = i;
+}
+
+//private
+void VisibilityGraph::_addCorners(const QPolygonF &obstacle)
+{
+    //Work in meters, without the closing point if there is one
+    QVector<QPointF> corners;
+    for (int i = 0; i < obstacle.size(); i++)
+    {
+        if (i == obstacle.size() - 1 && obstacle.size() > 1 && obstacle.last() == obstacle.first())
+            break;
+        corners.append(this->toMeters(obstacle.at(i)));
+    }
+    if (corners.size() < 3)
+        return;
+
+    //Twice the signed area. Positive means counter-clockwise (with y pointing north).
+    qreal area = 0.0;
+    for (int i = 0; i < corners.size(); i++)
+    {
+        const QPointF& a = corners.at(i);
+        const QPointF& b = corners.at((i + 1) % corners.size());
+        area += a.x() * b.y() - b.x() * a.y();
+    }
+    if (area == 0.0)
+        return;
+    const qreal winding = (area > 0.0) ? 1.0 : -1.0;
+
+    for (int i = 0; i < corners.size(); i++)
+    {
+        const QPointF& prev = corners.at((i + corners.size() - 1) % corners.size());
+        const QPointF& corner = corners.at(i);
+        const QPointF& next = corners.at((i + 1) % corners.size());
+
+        QPointF inDir = corner - prev;
+        QPointF outDir = next - corner;
+        const qreal inLength = sqrt(inDir.x() * inDir.x() + inDir.y() * inDir.y());
+        const qreal outLength = sqrt(outDir.x() * outDir.x() + outDir.y() * outDir.y());
+        if (inLength == 0.0 || outLength == 0.0)
+            continue;
+        inDir /= inLength;
+        outDir /= outLength;
+
+        //Routes never bend at reflex (or straight) corners
+        const qreal turn = inDir.x() * outDir.y() - inDir.y() * outDir.x();
+        if (turn * winding <= 0.0)
+            continue;
+
+        //Push the corner out along the bisector of the two edges' outward normals
+        const QPointF inNormal(winding * inDir.y(), -winding * inDir.x());
+        const QPointF outNormal(winding * outDir.y(), -winding * outDir.x());
+        QPointF bisector = inNormal + outNormal;
+        const qreal bisectorLength = sqrt(bisector.x() * bisector.x() + bisector.y() * bisector.y());
+        if (bisectorLength == 0.0)
+            continue;
+        bisector /= bisectorLength;
+        const qreal miter = _clearance / qMax<qreal>(bisectorLength / 2.0, 1.0 / MAX_MITER);
+
+        const QPointF lonLat = this->toLonLat(corner + bisector * miter);
+        if (this->obstacleMap()->contains(lonLat))
+            continue;
+        this->addNode(lonLat);
+    }
+}
+
+//private static
+QPointF VisibilityGraph::_origin(QSharedPointer<const ObstacleMap> obstacleMap)
+{
+    if (!obstacleMap)
+        return QPointF(0.0, 0.0);
+
+    //Middle of the obstacles' bounds
+    bool first = true;
+    qreal left = 0.0, right = 0.0, bottom = 0.0, top = 0.0;
+    foreach(const QPolygonF& obstacle, obstacleMap->obstacles())
+    {
+        foreach(const QPointF& point, obstacle)
+        {
+            left = first ? point.x() : qMin<qreal>(left, point.x());
+            right = first ? point.x() : qMax<qreal>(right, point.x());
+            bottom = first ? point.y() : qMin<qreal>(bottom, point.y());
+            top = first ? point.y() : qMax<qreal>(top, point.y());
+            first = false;
+        }
+    }
+    return QPointF((left + right) / 2.0, (bottom + top) / 2.0);
+}
@@ -0,0 +1,39 @@
+#ifndef VISIBILITYGRAPH_H
+#define VISIBILITYGRAPH_H
+
+#include "WaypointGraph.h"
+
+/**
+ * @brief The VisibilityGraph class is a WaypointGraph over the corners of the no-fly zones. The shortest route
+ * around polygonal obstacles only ever bends at their convex corners, so searching the graph of corners that can
+ * see each other gives the exact shortest geometric route. A query's start and end are joined to every corner
+ * they can see.
+ *
+ * Each corner is pushed out from its obstacle by a clearance so that routes don't graze the obstacle edges.
+ * Corners that end up inside another obstacle are dropped.
+ */
+class VisibilityGraph : public WaypointGraph
+{
+public:
+    /**
+     * @brief VisibilityGraph
+     * @param obstacleMap the no-fly zones. May be null, in which case the graph is empty and every route is
+     * straight.
+     * @param clearance how far (in meters) to keep the graph's nodes from the obstacles
+     */
+    VisibilityGraph(QSharedPointer<const ObstacleMap> obstacleMap, qreal clearance = 50.0);
+
+    qreal clearance() const;
+
+protected:
+    //pure-virtual from WaypointGraph
+    virtual void candidateNodes(const QPointF& lonLat, QVector<int> * nodesOut) const;
+
+private:
+    void _addCorners(const QPolygonF& obstacle);
+    static QPointF _origin(QSharedPointer<const ObstacleMap> obstacleMap);
+
+    qreal _clearance;
+};
+
+#endif // VISIBILITYGRAPH_H
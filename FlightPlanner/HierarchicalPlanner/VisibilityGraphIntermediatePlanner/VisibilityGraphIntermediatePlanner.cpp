@@ -0,0 +1,67 @@
+#include "VisibilityGraphIntermediatePlanner.h"
+
+#include <QScopedPointer>
+
+#include "HierarchicalPlanner/VisibilityGraph.h"
+#include "HierarchicalPlanner/DubinsIntermediate/DubinsIntermediatePlanner.h"
+#include "PlanningLog.h"
+
+VisibilityGraphIntermediatePlanner::VisibilityGraphIntermediatePlanner(const UAVParameters &uavParams,
+                                                                       const Position &startPos,
+                                                                       const UAVOrientation &startPose,
+                                                                       const Position &endPos,
+                                                                       const UAVOrientation &endPose,
+                                                                       const QList<QPolygonF> &obstacles) :
+    IntermediatePlanner(uavParams, startPos, startPose, endPos, endPose, obstacles), _visibilityGraph(0)
+{
+}
+
+bool VisibilityGraphIntermediatePlanner::plan()
+{
+    _results.clear();
+
+    //Without a shared graph, build one over exact obstacle tests for just this transition
+    QScopedPointer<VisibilityGraph> ownGraph;
+    const VisibilityGraph * graph = _visibilityGraph;
+    if (graph == 0)
+    {
+        QSharedPointer<const ObstacleMap> exactMap;
+        if (!this->obstacles().isEmpty())
+            exactMap = QSharedPointer<const ObstacleMap>(new ObstacleMap(this->obstacles(), 0.0));
+        ownGraph.reset(new VisibilityGraph(exactMap));
+        graph = ownGraph.data();
+    }
+
+    QList<Position> route;
+    if (!graph->findPath(this->startPos(), this->endPos(), &route))
+    {
+        planningDebug(intermediateLog) << "Visibility graph doesn't join" << this->startPos() << "and" << this->endPos();
+        return false;
+    }
+
+    return DubinsIntermediatePlanner::flyWaypoints(this->uavParams(), route,
+                                                   this->startPose(), this->endPose(),
+                                                   this->obstacles(), this->obstacleMap(),
+                                                   &_results);
+}
+
+QList<Position> VisibilityGraphIntermediatePlanner::results() const
+{
+    return _results;
+}
+
+void VisibilityGraphIntermediatePlanner::takeResults(QList<Position> *destination)
+{
+    destination->clear();
+    destination->swap(_results);
+}
+
+const VisibilityGraph *VisibilityGraphIntermediatePlanner::visibilityGraph() const
+{
+    return _visibilityGraph;
+}
+
+void VisibilityGraphIntermediatePlanner::setVisibilityGraph(const VisibilityGraph *graph)
+{
+    _visibilityGraph = graph;
+}
@@ -0,0 +1,49 @@
+#ifndef VISIBILITYGRAPHINTERMEDIATEPLANNER_H
+#define VISIBILITYGRAPHINTERMEDIATEPLANNER_H
+
+#include "HierarchicalPlanner/IntermediatePlanner.h"
+#include "UAVParameters.h"
+
+class VisibilityGraph;
+
+/**
+ * @brief The VisibilityGraphIntermediatePlanner class finds the shortest geometric route around the no-fly zones
+ * through a VisibilityGraph of their corners and flies it with Dubins segments. Searching the corners takes far
+ * fewer expansions than a lattice over the whole transition.
+ *
+ * The graph is normally built once per planning run and shared through setVisibilityGraph(). Without one a
+ * graph is built for just this transition.
+ */
+class VisibilityGraphIntermediatePlanner : public IntermediatePlanner
+{
+public:
+    VisibilityGraphIntermediatePlanner(const UAVParameters& uavParams,
+                                       const Position& startPos,
+                                       const UAVOrientation& startPose,
+                                       const Position& endPos,
+                                       const UAVOrientation& endPose,
+                                       const QList<QPolygonF>& obstacles);
+
+    /**
+     * @brief plan returns false if the graph doesn't join the start and end, or if the Dubins segments flown
+     * around its corners clip an obstacle. The flight is kept either way.
+     * @return
+     */
+    virtual bool plan();
+    virtual QList<Position> results() const;
+    virtual void takeResults(QList<Position> * destination);
+
+    /**
+     * @brief visibilityGraph returns the graph searched for the route, or 0 if there isn't one. The graph is
+     * not owned by us and must outlive the planner.
+     * @return
+     */
+    const VisibilityGraph * visibilityGraph() const;
+    void setVisibilityGraph(const VisibilityGraph * graph);
+
+private:
+    const VisibilityGraph * _visibilityGraph;
+    QList<Position> _results;
+};
+
+#endif // VISIBILITYGRAPHINTERMEDIATEPLANNER_H
@@ -0,0 +1,315 @@
+#include "WaypointGraph.h"
+
+#include <cmath>
+#include <limits>
+
+#include "guts/Conversions.h"
+#include "BestFirstSearch.h"
+
+WaypointGraph::~WaypointGraph()
+{
+}
+
+int WaypointGraph::nodeCount() const
+{
+    return _lonLats.size();
+}
+
+Position WaypointGraph::node(int index) const
+{
+    return Position(_lonLats.at(index));
+}
+
+int WaypointGraph::edgeCount() const
+{
+    return _edgeTargets.size() / 2;
+}
+
+bool WaypointGraph::findPath(const Position &start, const Position &end, QList<Position> *waypointsOut) const
+{
+    waypointsOut->clear();
+
+    const QPointF startLonLat = start.lonLat();
+    const QPointF endLonLat = end.lonLat();
+    if (this->segmentIsFree(startLonLat, endLonLat))
+    {
+        waypointsOut->append(start);
+        waypointsOut->append(end);
+        return true;
+    }
+
+    QVector<int> startNodes;
+    QVector<qreal> startLengths;
+    _connect(startLonLat, &startNodes, &startLengths);
+    if (startNodes.isEmpty())
+        return false;
+
+    //Join the graph wherever the rest of the way to the end is shortest
+    const QSharedPointer<const GoalField> field = _goalField(endLonLat);
+    const qreal infinity = std::numeric_limits<qreal>::max();
+    int firstNode = -1;
+    qreal bestCost = infinity;
+    for (int i = 0; i < startNodes.size(); i++)
+    {
+        const qreal rest = field->costs.at(startNodes.at(i));
+        if (rest == infinity)
+            continue;
+        const qreal cost = startLengths.at(i) + rest;
+        if (cost < bestCost)
+        {
+            bestCost = cost;
+            firstNode = startNodes.at(i);
+        }
+    }
+    if (firstNode < 0)
+        return false;
+
+    waypointsOut->append(start);
+    for (int current = firstNode; current >= 0; current = field->next.at(current))
+        waypointsOut->append(Position(_lonLats.at(current)));
+    waypointsOut->append(end);
+    return true;
+}
+
+int WaypointGraph::maxGoalFields() const
+{
+    return _maxGoalFields;
+}
+
+void WaypointGraph::setMaxGoalFields(int count)
+{
+    QMutexLocker lock(&_goalFieldsLock);
+    _maxGoalFields = qMax<int>(0, count);
+    while (_goalFieldOrder.size() > _maxGoalFields)
+        _goalFields.remove(_goalFieldOrder.takeFirst());
+}
+
+quint64 WaypointGraph::goalFieldHits() const
+{
+    QMutexLocker lock(&_goalFieldsLock);
+    return _goalFieldHits;
+}
+
+quint64 WaypointGraph::goalFieldMisses() const
+{
+    QMutexLocker lock(&_goalFieldsLock);
+    return _goalFieldMisses;
+}
+
+//protected
+WaypointGraph::WaypointGraph(QSharedPointer<const ObstacleMap> obstacleMap, const QPointF &origin) :
+    _obstacleMap(obstacleMap), _origin(origin), _maxGoalFields(128), _goalFieldHits(0), _goalFieldMisses(0)
+{
+    _lonPerMeter = Conversions::degreesLonPerMeter(_origin.y());
+    _latPerMeter = Conversions::degreesLatPerMeter(_origin.y());
+}
+
+//protected
+int WaypointGraph::addNode(const QPointF &lonLat)
+{
+    _lonLats.append(lonLat);
+    _meters.append(this->toMeters(lonLat));
+    _adjacency.append(QVector<QPair<int, qreal> >());
+    return _lonLats.size() - 1;
+}
+
+//protected
+bool WaypointGraph::tryAddEdge(int a, int b)
+{
+    if (a == b || !this->segmentIsFree(_lonLats.at(a), _lonLats.at(b)))
+        return false;
+    const qreal length = _length(_meters.at(a), _meters.at(b));
+    _adjacency[a].append(qMakePair(b, length));
+    _adjacency[b].append(qMakePair(a, length));
+    return true;
+}
+
+//protected
+void WaypointGraph::finishEdges()
+{
+    _edgeStarts.clear();
+    _edgeTargets.clear();
+    _edgeLengths.clear();
+
+    _edgeStarts.reserve(_adjacency.size() + 1);
+    for (int i = 0; i < _adjacency.size(); i++)
+    {
+        _edgeStarts.append(_edgeTargets.size());
+        for (int k = 0; k < _adjacency.at(i).size(); k++)
+        {
+            _edgeTargets.append(_adjacency.at(i).at(k).first);
+            _edgeLengths.append(_adjacency.at(i).at(k).second);
+        }
+    }
+    _edgeStarts.append(_edgeTargets.size());
+    _adjacency.clear();
+}
+
+//protected
+const QPointF &WaypointGraph::nodeLonLat(int index) const
+{
+    return _lonLats.at(index);
+}
+
+//protected
+const QPointF &WaypointGraph::nodeMeters(int index) const
+{
+    return _meters.at(index);
+}
+
+//protected
+QPointF WaypointGraph::toMeters(const QPointF &lonLat) const
+{
+    return QPointF((lonLat.x() - _origin.x()) / _lonPerMeter,
+                   (lonLat.y() - _origin.y()) / _latPerMeter);
+}
+
+//protected
+QPointF WaypointGraph::toLonLat(const QPointF &meters) const
+{
+    return QPointF(_origin.x() + meters.x() * _lonPerMeter,
+                   _origin.y() + meters.y() * _latPerMeter);
+}
+
+//protected
+bool WaypointGraph::segmentIsFree(const QPointF &a, const QPointF &b) const
+{
+    if (!_obstacleMap)
+        return true;
+    return !_obstacleMap->segmentCollides(a, b);
+}
+
+//protected
+const QSharedPointer<const ObstacleMap> &WaypointGraph::obstacleMap() const
+{
+    return _obstacleMap;
+}
+
+//private
+QSharedPointer<const WaypointGraph::GoalField> WaypointGraph::_goalField(const QPointF &goalLonLat) const
+{
+    const QVectorND key(goalLonLat);
+    {
+        QMutexLocker lock(&_goalFieldsLock);
+        QHash<QVectorND, QSharedPointer<const GoalField> >::const_iterator iter = _goalFields.constFind(key);
+        if (iter != _goalFields.constEnd())
+        {
+            _goalFieldHits++;
+            _goalFieldOrder.removeOne(key);
+            _goalFieldOrder.append(key);
+            return iter.value();
+        }
+        _goalFieldMisses++;
+    }
+
+    //Built without the lock so other destinations aren't held up. Two threads may both build the same field.
+    const QSharedPointer<const GoalField> toRet = _buildGoalField(goalLonLat);
+
+    QMutexLocker lock(&_goalFieldsLock);
+    if (_maxGoalFields > 0 && !_goalFields.contains(key))
+    {
+        _goalFields.insert(key, toRet);
+        _goalFieldOrder.append(key);
+        while (_goalFieldOrder.size() > _maxGoalFields)
+            _goalFields.remove(_goalFieldOrder.takeFirst());
+    }
+    return toRet;
+}
+
+struct WaypointGraph::GoalFieldSpace
+{
+    typedef int State;
+
+    GoalFieldSpace(const WaypointGraph * graph) :
+        graph(graph)
+    {
+    }
+
+    //Every node's distance is wanted, so there's no goal to head for
+    qreal heuristic(int) const
+    {
+        return 0.0;
+    }
+
+    bool isGoal(int) const
+    {
+        return false;
+    }
+
+    bool keepSearching() const
+    {
+        return true;
+    }
+
+    template <typename Search>
+    void successors(int node, const Search& search, QVector<int> * nodes, QVector<qreal> * stepCosts) const
+    {
+        for (int e = graph->_edgeStarts.at(node); e < graph->_edgeStarts.at(node + 1); e++)
+        {
+            const int neighbor = graph->_edgeTargets.at(e);
+            if (search.isClosed(neighbor))
+                continue;
+            nodes->append(neighbor);
+            stepCosts->append(graph->_edgeLengths.at(e));
+        }
+    }
+
+    const WaypointGraph * graph;
+};
+
+//private
+QSharedPointer<const WaypointGraph::GoalField> WaypointGraph::_buildGoalField(const QPointF &goalLonLat) const
+{
+    const qreal infinity = std::numeric_limits<qreal>::max();
+    QSharedPointer<GoalField> toRet(new GoalField());
+    toRet->costs.fill(infinity, _lonLats.size());
+    toRet->next.fill(-1, _lonLats.size());
+
+    //Edges are undirected, so searching outwards from the goal gives every node's distance to it
+    GoalFieldSpace space(this);
+    BestFirstSearch<GoalFieldSpace, DenseStateIndex> search(&space);
+    search.index().resize(_lonLats.size());
+    search.reserve(_lonLats.size());
+
+    QVector<int> goalNodes;
+    QVector<qreal> goalLengths;
+    _connect(goalLonLat, &goalNodes, &goalLengths);
+    for (int i = 0; i < goalNodes.size(); i++)
+        search.addStart(goalNodes.at(i), goalLengths.at(i));
+    search.search();
+
+    for (int i = 0; i < search.nodeCount(); i++)
+    {
+        const BestFirstSearch<GoalFieldSpace, DenseStateIndex>::Node& node = search.node(i);
+        toRet->costs[node.state] = node.cost;
+        if (node.parent >= 0)
+            toRet->next[node.state] = search.node(node.parent).state;
+    }
+    return toRet;
+}
+
+//private
+void WaypointGraph::_connect(const QPointF &lonLat, QVector<int> *nodesOut, QVector<qreal> *lengthsOut) const
+{
+    nodesOut->clear();
+    lengthsOut->clear();
+
+    QVector<int> candidates;
+    this->candidateNodes(lonLat, &candidates);
+
+    const QPointF meters = this->toMeters(lonLat);
+    foreach(int node, candidates)
+    {
+        if (!this->segmentIsFree(lonLat, _lonLats.at(node)))
+            continue;
+        nodesOut->append(node);
+        lengthsOut->append(_length(meters, _meters.at(node)));
+    }
+}
+
+//private static
+qreal WaypointGraph::_length(const QPointF &a, const QPointF &b)
+{
+    const QPointF offset = b - a;
+    return sqrt(offset.x() * offset.x() + offset.y() * offset.y());
+}
@@ -0,0 +1,139 @@
+#ifndef WAYPOINTGRAPH_H
+#define WAYPOINTGRAPH_H
+
+#include <QtGlobal>
+#include <QList>
+#include <QVector>
+#include <QPair>
+#include <QPointF>
+#include <QSharedPointer>
+#include <QHash>
+#include <QMutex>
+
+#include "Position.h"
+#include "ObstacleMap.h"
+#include "QVectorND.h"
+
+/**
+ * @brief The WaypointGraph class is the base of the graphs that transition planners search for a rough path
+ * around the no-fly zones. Subclasses place the waypoints and join the pairs that can see each other. A query
+ * joins its start and end to whichever of candidateNodes() they can see, without changing the graph.
+ *
+ * Many queries share a destination (the scheduler flies to the same task entry point from everywhere), so the
+ * graph is searched backwards from each destination once, with Dijkstra, and the distance from every node to
+ * it is kept. Later queries to that destination only have to join their start to the graph and look the rest
+ * up. The most recently used maxGoalFields() destinations are kept.
+ *
+ * A WaypointGraph doesn't change once its subclass's constructor has finished, apart from the distance fields,
+ * which are guarded by a lock. It is safe to query from many threads at once.
+ */
+class WaypointGraph
+{
+public:
+    virtual ~WaypointGraph();
+
+    int nodeCount() const;
+    Position node(int index) const;
+
+    /**
+     * @brief edgeCount returns the number of (undirected) edges between nodes
+     * @return
+     */
+    int edgeCount() const;
+
+    /**
+     * @brief findPath finds the shortest path from start to end through the graph. If the straight segment
+     * from start to end is clear that is the path.
+     * @param start
+     * @param end
+     * @param waypointsOut set to the path, from start to end inclusive
+     * @return false if start or end can't see any candidate node, or if the graph doesn't join them
+     */
+    bool findPath(const Position& start, const Position& end, QList<Position> * waypointsOut) const;
+
+    /**
+     * @brief maxGoalFields returns how many destinations' distance fields are kept. Defaults to 128.
+     * @return
+     */
+    int maxGoalFields() const;
+    void setMaxGoalFields(int count);
+
+    /**
+     * @brief goalFieldHits returns how many findPath() calls found their destination's distance field already
+     * computed, and goalFieldMisses() how many had to compute it
+     * @return
+     */
+    quint64 goalFieldHits() const;
+    quint64 goalFieldMisses() const;
+
+protected:
+    /**
+     * @brief WaypointGraph
+     * @param obstacleMap the no-fly zones that edges must avoid. May be null, in which case nothing is in the way.
+     * @param origin lon/lat around which distances are measured in meters
+     */
+    WaypointGraph(QSharedPointer<const ObstacleMap> obstacleMap, const QPointF& origin);
+
+    /**
+     * @brief candidateNodes lists the nodes that findPath() should try to join lonLat to
+     * @param lonLat
+     * @param nodesOut
+     */
+    virtual void candidateNodes(const QPointF& lonLat, QVector<int> * nodesOut) const=0;
+
+    //For subclasses building the graph. finishEdges() must be called once all edges have been added.
+    int addNode(const QPointF& lonLat);
+    bool tryAddEdge(int a, int b);
+    void finishEdges();
+
+    const QPointF& nodeLonLat(int index) const;
+    const QPointF& nodeMeters(int index) const;
+    QPointF toMeters(const QPointF& lonLat) const;
+    QPointF toLonLat(const QPointF& meters) const;
+    bool segmentIsFree(const QPointF& a, const QPointF& b) const;
+
+    const QSharedPointer<const ObstacleMap>& obstacleMap() const;
+
+private:
+    //The length of the shortest path from every node to one destination, and the next node along it
+    struct GoalField
+    {
+        QVector<qreal> costs;
+        QVector<int> next;
+    };
+
+    //The graph as a BestFirstSearch space, searched outwards from a destination
+    struct GoalFieldSpace;
+
+    QSharedPointer<const GoalField> _goalField(const QPointF& goalLonLat) const;
+    QSharedPointer<const GoalField> _buildGoalField(const QPointF& goalLonLat) const;
+    void _connect(const QPointF& lonLat, QVector<int> * nodesOut, QVector<qreal> * lengthsOut) const;
+    static qreal _length(const QPointF& a, const QPointF& b);
+
+    QSharedPointer<const ObstacleMap> _obstacleMap;
+    QPointF _origin;
+    qreal _lonPerMeter;
+    qreal _latPerMeter;
+
+    //Each node in lon/lat (for collision checks) and in meters from the origin (for distances)
+    QVector<QPointF> _lonLats;
+    QVector<QPointF> _meters;
+
+    //Edges added so far, until finishEdges() packs them
+    QVector<QVector<QPair<int, qreal> > > _adjacency;
+
+    //The edges of node i are [_edgeStarts[i], _edgeStarts[i + 1]) in _edgeTargets and _edgeLengths
+    QVector<int> _edgeStarts;
+    QVector<int> _edgeTargets;
+    QVector<qreal> _edgeLengths;
+
+    //Distance fields by destination lon/lat, and the destinations from least to most recently used
+    mutable QMutex _goalFieldsLock;
+    mutable QHash<QVectorND, QSharedPointer<const GoalField> > _goalFields;
+    mutable QList<QVectorND> _goalFieldOrder;
+    int _maxGoalFields;
+    mutable quint64 _goalFieldHits;
+    mutable quint64 _goalFieldMisses;
+};
+
+#endif // WAYPOINTGRAPH_H
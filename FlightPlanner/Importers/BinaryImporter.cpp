@@ -0,0 +1,83 @@
+#include "BinaryImporter.h"
+
+#include <QFile>
+#include <QtDebug>
+
+#include "Exporters/BinaryFlightPathFormat.h"
+
+BinaryImporter::BinaryImporter(const QString &filename) : _filename(filename)
+{
+}
+
+//pure-virtual from Importer
+bool BinaryImporter::doImport()
+{
+    QFile file(_filename);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        _errorString = "Failed to open " + _filename + ": " + file.errorString();
+        qDebug() << "Failed to import solution from binary file. Message:" << _errorString;
+        return false;
+    }
+
+    //Fall back to reading the file if it can't be mapped
+    QByteArray bytes;
+    qint64 size = file.size();
+    const uchar * data = (size > 0) ? file.map(0, size) : 0;
+    if (data == 0)
+    {
+        bytes = file.readAll();
+        data = (const uchar *) bytes.constData();
+        size = bytes.size();
+    }
+
+    if (!this->decode(data, size))
+    {
+        qDebug() << "Failed to import solution from binary file. Message:" << _errorString;
+        return false;
+    }
+    qDebug() << "Imported" << this->results().size() << "binary flight path points.";
+    return true;
+}
+
+const UAVParameters &BinaryImporter::uavParameters() const
+{
+    return _params;
+}
+
+QString BinaryImporter::errorString() const
+{
+    return _errorString;
+}
+
+//private
+bool BinaryImporter::decode(const uchar *data, qint64 size)
+{
+    quint32 pointCount;
+    quint32 checksum;
+    UAVParameters params;
+    if (!BinaryFlightPathFormat::decodeHeader(data, size, &pointCount, &params, &checksum, &_errorString))
+        return false;
+
+    const uchar * records = data + BinaryFlightPathFormat::HEADER_SIZE;
+    const qint64 recordBytes = (qint64) pointCount * BinaryFlightPathFormat::RECORD_SIZE;
+    if (BinaryFlightPathFormat::crc32(records, recordBytes) != checksum)
+    {
+        _errorString = "Binary flight path file is corrupt (checksum mismatch)";
+        return false;
+    }
+
+    QList<Position> toResult;
+    toResult.reserve(pointCount);
+    BinaryFlightPathFormat::FixedPoint current = {0, 0, 0};
+    for (quint32 i = 0; i < pointCount; i++)
+    {
+        BinaryFlightPathFormat::decodeRecord(records + (qint64) i * BinaryFlightPathFormat::RECORD_SIZE,
+                                             &current);
+        toResult.append(BinaryFlightPathFormat::fromFixed(current));
+    }
+
+    _params = params;
+    this->setResults(toResult);
+    return true;
+}
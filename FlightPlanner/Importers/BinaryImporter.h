@@ -0,0 +1,36 @@
+#ifndef BINARYIMPORTER_H
+#define BINARYIMPORTER_H
+
+#include "Importer.h"
+#include "UAVParameters.h"
+
+#include <QString>
+
+/**
+ * @brief The BinaryImporter class reads a .fpath file written by BinaryExporter. The file is memory-mapped
+ * and decoded in place, so it's never copied into a buffer first.
+ */
+class BinaryImporter : public Importer
+{
+public:
+    BinaryImporter(const QString& filename);
+
+    //pure-virtual from Importer
+    virtual bool doImport();
+
+    /**
+     * @brief uavParameters returns the UAV parameters stored with the path by the last successful import
+     */
+    const UAVParameters& uavParameters() const;
+
+    QString errorString() const;
+
+private:
+    bool decode(const uchar * data, qint64 size);
+
+    QString _filename;
+    UAVParameters _params;
+    QString _errorString;
+};
+
+#endif // BINARYIMPORTER_H
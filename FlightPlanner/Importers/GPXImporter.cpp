@@ -14,7 +14,9 @@ bool GPXImporter::doImport()
 {
     GPX gpx;
     QString errorMsg;
-    if (!GPX::parseGPXFile(_filename, &gpx, &errorMsg))
+    const bool parsed = _tracks.isEmpty() ? GPX::parseGPXFile(_filename, &gpx, &errorMsg)
+                                          : GPX::parseGPXFile(_filename, _tracks, &gpx, &errorMsg);
+    if (!parsed)
     {
         qDebug() << "Failed to import soltion from gpx file. Message:" << errorMsg;
         return false;
@@ -28,3 +30,13 @@ bool GPXImporter::doImport()
     this->setResults(toResult);
     return true;
 }
+
+const QList<int> &GPXImporter::tracks() const
+{
+    return _tracks;
+}
+
+void GPXImporter::setTracks(const QList<int> &tracks)
+{
+    _tracks = tracks;
+}
@@ -3,6 +3,8 @@
 
 #include "Importer.h"
 
+#include <QList>
+
 class GPXImporter : public Importer
 {
 public:
@@ -11,8 +13,15 @@ public:
     //pure-virtual from Importer
     virtual bool doImport();
 
+    /**
+     * @brief tracks are the indices of the trk elements to import, in order. Empty imports every track.
+     */
+    const QList<int>& tracks() const;
+    void setTracks(const QList<int>& tracks);
+
 private:
     QString _filename;
+    QList<int> _tracks;
 };
 
 #endif // GPXIMPORTER_H
@@ -0,0 +1,404 @@
+#include "NoFlyZoneImporter.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDataStream>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QPainterPath>
+#include <QVector>
+#include <QPair>
+#include <QtDebug>
+#include <cmath>
+
+#include "FlightTasks/NoFlyFlightTask.h"
+
+//Meters per degree of latitude, near enough for judging simplification tolerances
+const qreal METERS_PER_DEGREE = 111320.0;
+
+const qreal PI = 3.14159265358979323846;
+
+//Shapefile constants. See the ESRI Shapefile Technical Description
+const qint32 SHAPEFILE_CODE = 9994;
+const int SHAPEFILE_HEADER_BYTES = 100;
+const qint32 SHAPE_NULL = 0;
+const qint32 SHAPE_POLYGON = 5;
+const qint32 SHAPE_POLYGON_Z = 15;
+const qint32 SHAPE_POLYGON_M = 25;
+
+//non-member
+//Twice the signed area of ring, positive when it's counter-clockwise with x east and y north
+static qreal signedArea(const QPolygonF& ring)
+{
+    qreal toRet = 0.0;
+    for (int i = 0; i < ring.size(); i++)
+    {
+        const QPointF& a = ring.at(i);
+        const QPointF& b = ring.at((i + 1) % ring.size());
+        toRet += a.x() * b.y() - b.x() * a.y();
+    }
+    return toRet;
+}
+
+//non-member
+//Distance from p to the segment from a to b
+static qreal segmentDistance(const QPointF& p, const QPointF& a, const QPointF& b)
+{
+    const QPointF ab = b - a;
+    const qreal lengthSquared = ab.x() * ab.x() + ab.y() * ab.y();
+    qreal t = 0.0;
+    if (lengthSquared > 0.0)
+        t = qBound<qreal>(0.0, ((p.x() - a.x()) * ab.x() + (p.y() - a.y()) * ab.y()) / lengthSquared, 1.0);
+    const QPointF closest = a + t * ab;
+    const QPointF d = p - closest;
+    return sqrt(d.x() * d.x() + d.y() * d.y());
+}
+
+//non-member
+//Douglas-Peucker on ring, closed back to its first vertex, with tolerance in meters
+static QPolygonF simplifyRing(const QPolygonF& ring, qreal tolerance)
+{
+    //Work in meters on a flat frame at the ring's first vertex
+    const QPointF origin = ring.first();
+    const qreal lonScale = METERS_PER_DEGREE * cos(origin.y() * PI / 180.0);
+    QPolygonF meters(ring.size() + 1);
+    for (int i = 0; i <= ring.size(); i++)
+    {
+        const QPointF& ll = ring.at(i % ring.size());
+        meters[i] = QPointF((ll.x() - origin.x()) * lonScale, (ll.y() - origin.y()) * METERS_PER_DEGREE);
+    }
+
+    QVector<bool> keep(meters.size(), false);
+    keep[0] = true;
+    keep[meters.size() - 1] = true;
+
+    //A stack rather than recursion, since rings can have many thousands of vertices
+    QVector<QPair<int, int> > ranges;
+    ranges.append(qMakePair(0, meters.size() - 1));
+    while (!ranges.isEmpty())
+    {
+        const QPair<int, int> range = ranges.last();
+        ranges.removeLast();
+
+        int farthest = -1;
+        qreal farthestDistance = tolerance;
+        for (int i = range.first + 1; i < range.second; i++)
+        {
+            //The ring starts and ends at the same point, so its first range measures from that point
+            const qreal distance = segmentDistance(meters.at(i), meters.at(range.first), meters.at(range.second));
+            if (distance > farthestDistance)
+            {
+                farthest = i;
+                farthestDistance = distance;
+            }
+        }
+        if (farthest < 0)
+            continue;
+
+        keep[farthest] = true;
+        ranges.append(qMakePair(range.first, farthest));
+        ranges.append(qMakePair(farthest, range.second));
+    }
+
+    QPolygonF toRet;
+    for (int i = 0; i < ring.size(); i++)
+    {
+        if (keep.at(i))
+            toRet.append(ring.at(i));
+    }
+    return toRet;
+}
+
+//non-member
+//Drops the repeated closing vertex GeoJSON and shapefile rings end with
+static QPolygonF openRing(QPolygonF ring)
+{
+    if (ring.size() > 1 && ring.first() == ring.last())
+        ring.removeLast();
+    return ring;
+}
+
+NoFlyZoneImporter::NoFlyZoneImporter(const QString &filename) :
+    _filename(filename), _simplifyTolerance(5.0), _skipped(0)
+{
+}
+
+bool NoFlyZoneImporter::doImport()
+{
+    _results.clear();
+    _skipped = 0;
+    _errorString.clear();
+
+    QFile file(_filename);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        _errorString = "Failed to open " + _filename + ": " + file.errorString();
+        qDebug() << "Failed to import no-fly zones. Message:" << _errorString;
+        return false;
+    }
+
+    const QString suffix = QFileInfo(_filename).suffix().toLower();
+    bool imported;
+    if (suffix == "shp")
+        imported = this->importShapefile(&file);
+    else if (suffix == "geojson" || suffix == "json")
+        imported = this->importGeoJSON(&file);
+    else
+    {
+        _errorString = "Can't import no-fly zones from " + suffix + " file";
+        imported = false;
+    }
+
+    if (!imported)
+    {
+        _results.clear();
+        qDebug() << "Failed to import no-fly zones. Message:" << _errorString;
+        return false;
+    }
+    qDebug() << "Imported" << _results.size() << "no-fly zones, skipped" << _skipped;
+    return true;
+}
+
+const QList<QSharedPointer<FlightTaskArea> > &NoFlyZoneImporter::results() const
+{
+    return _results;
+}
+
+qreal NoFlyZoneImporter::simplifyTolerance() const
+{
+    return _simplifyTolerance;
+}
+
+void NoFlyZoneImporter::setSimplifyTolerance(qreal meters)
+{
+    _simplifyTolerance = qMax<qreal>(0.0, meters);
+}
+
+const QPolygonF &NoFlyZoneImporter::region() const
+{
+    return _region;
+}
+
+void NoFlyZoneImporter::setRegion(const QPolygonF &region)
+{
+    _region = region;
+}
+
+int NoFlyZoneImporter::skippedCount() const
+{
+    return _skipped;
+}
+
+QString NoFlyZoneImporter::errorString() const
+{
+    return _errorString;
+}
+
+//private
+bool NoFlyZoneImporter::importGeoJSON(QIODevice *device)
+{
+    QJsonParseError error;
+    const QJsonDocument document = QJsonDocument::fromJson(device->readAll(), &error);
+    if (error.error != QJsonParseError::NoError)
+    {
+        _errorString = "Invalid GeoJSON at offset " + QString::number(error.offset) + ": " + error.errorString();
+        return false;
+    }
+    if (!document.isObject())
+    {
+        _errorString = "GeoJSON file doesn't hold an object";
+        return false;
+    }
+
+    this->addGeoJSONObject(document.object());
+    return true;
+}
+
+//private
+bool NoFlyZoneImporter::importShapefile(QIODevice *device)
+{
+    QDataStream stream(device);
+    stream.setFloatingPointPrecision(QDataStream::DoublePrecision);
+
+    //The file code and length are big-endian, the rest of the header little-endian
+    stream.setByteOrder(QDataStream::BigEndian);
+    qint32 fileCode;
+    stream >> fileCode;
+    if (stream.status() != QDataStream::Ok || fileCode != SHAPEFILE_CODE)
+    {
+        _errorString = _filename + " is not a shapefile";
+        return false;
+    }
+    if (!device->seek(SHAPEFILE_HEADER_BYTES))
+    {
+        _errorString = _filename + " is truncated";
+        return false;
+    }
+
+    while (!stream.atEnd())
+    {
+        //Record headers are big-endian. The length is in 16-bit words
+        stream.setByteOrder(QDataStream::BigEndian);
+        qint32 recordNumber, contentWords;
+        stream >> recordNumber >> contentWords;
+        if (stream.status() != QDataStream::Ok || contentWords < 2)
+        {
+            _errorString = "Bad record header in " + _filename;
+            return false;
+        }
+        const qint64 contentStart = device->pos();
+        const qint64 contentEnd = contentStart + 2 * (qint64)contentWords;
+
+        stream.setByteOrder(QDataStream::LittleEndian);
+        qint32 shapeType;
+        stream >> shapeType;
+        if (shapeType == SHAPE_POLYGON || shapeType == SHAPE_POLYGON_Z || shapeType == SHAPE_POLYGON_M)
+        {
+            double box[4];
+            qint32 partCount, pointCount;
+            stream >> box[0] >> box[1] >> box[2] >> box[3] >> partCount >> pointCount;
+
+            //Each part takes 4 bytes and each point 16, so the record's length bounds the counts
+            const qint64 available = contentEnd - device->pos();
+            if (stream.status() != QDataStream::Ok || partCount < 0 || pointCount < 0
+                    || 4 * (qint64)partCount + 16 * (qint64)pointCount > available)
+            {
+                _errorString = "Bad polygon in record " + QString::number(recordNumber) + " of " + _filename;
+                return false;
+            }
+
+            QVector<qint32> partStarts(partCount);
+            for (int i = 0; i < partCount; i++)
+                stream >> partStarts[i];
+            QPolygonF points(pointCount);
+            for (int i = 0; i < pointCount; i++)
+            {
+                double x, y;
+                stream >> x >> y;
+                points[i] = QPointF(x, y);
+            }
+
+            //Outer rings are clockwise and holes counter-clockwise. Holes are filled in
+            QList<QPolygonF> rings;
+            QList<QPolygonF> outerRings;
+            for (int i = 0; i < partCount; i++)
+            {
+                const int start = qBound(0, partStarts.at(i), pointCount);
+                const int end = (i + 1 < partCount) ? qBound(start, partStarts.at(i + 1), pointCount) : pointCount;
+                const QPolygonF ring = openRing(points.mid(start, end - start));
+                rings.append(ring);
+                if (signedArea(ring) < 0.0)
+                    outerRings.append(ring);
+            }
+
+            //Some writers get the winding wrong. Then every ring is taken as an outer one
+            if (outerRings.isEmpty())
+                outerRings = rings;
+            foreach(const QPolygonF& ring, outerRings)
+                this->addRing(ring);
+        }
+        else if (shapeType != SHAPE_NULL)
+            qDebug() << "Skipping shapefile record" << recordNumber << "of type" << shapeType;
+
+        //Skip whatever's left of the record (Z and M values, other shape types)
+        if (stream.status() != QDataStream::Ok || !device->seek(contentEnd))
+        {
+            _errorString = "Truncated record " + QString::number(recordNumber) + " in " + _filename;
+            return false;
+        }
+    }
+    return true;
+}
+
+//private
+void NoFlyZoneImporter::addGeoJSONObject(const QJsonObject &object)
+{
+    const QString type = object.value("type").toString();
+    if (type == "FeatureCollection")
+    {
+        foreach(const QJsonValue& feature, object.value("features").toArray())
+            this->addGeoJSONObject(feature.toObject());
+    }
+    else if (type == "Feature")
+        this->addGeoJSONObject(object.value("geometry").toObject());
+    else if (type == "GeometryCollection")
+    {
+        foreach(const QJsonValue& geometry, object.value("geometries").toArray())
+            this->addGeoJSONObject(geometry.toObject());
+    }
+    else if (type == "Polygon" || type == "MultiPolygon")
+    {
+        //A Polygon is a list of rings, the first being the outer one. A MultiPolygon is a list of Polygons
+        QJsonArray polygons = object.value("coordinates").toArray();
+        if (type == "Polygon")
+        {
+            polygons = QJsonArray();
+            polygons.append(object.value("coordinates"));
+        }
+
+        foreach(const QJsonValue& polygon, polygons)
+        {
+            const QJsonArray rings = polygon.toArray();
+            if (rings.isEmpty())
+                continue;
+
+            QPolygonF ring;
+            foreach(const QJsonValue& position, rings.first().toArray())
+            {
+                const QJsonArray coordinates = position.toArray();
+                if (coordinates.size() >= 2)
+                    ring.append(QPointF(coordinates.at(0).toDouble(), coordinates.at(1).toDouble()));
+            }
+            this->addRing(openRing(ring));
+        }
+    }
+}
+
+//private
+void NoFlyZoneImporter::addRing(QPolygonF ring)
+{
+    if (ring.size() < 3)
+    {
+        _skipped++;
+        return;
+    }
+
+    //Zones smaller than the tolerance would simplify away to nothing, so those keep their shape
+    if (_simplifyTolerance > 0.0)
+    {
+        const QPolygonF simplified = simplifyRing(ring, _simplifyTolerance);
+        if (simplified.size() >= 3)
+            ring = simplified;
+    }
+
+    QList<QPolygonF> pieces;
+    if (_region.isEmpty())
+        pieces.append(ring);
+    else if (_region.boundingRect().intersects(ring.boundingRect()))
+    {
+        QPainterPath zonePath;
+        zonePath.addPolygon(ring);
+        zonePath.closeSubpath();
+        QPainterPath regionPath;
+        regionPath.addPolygon(_region);
+        regionPath.closeSubpath();
+
+        foreach(const QPolygonF& piece, zonePath.intersected(regionPath).toSubpathPolygons())
+            pieces.append(openRing(piece));
+    }
+
+    bool added = false;
+    foreach(const QPolygonF& piece, pieces)
+    {
+        if (piece.size() < 3)
+            continue;
+
+        QSharedPointer<FlightTaskArea> area(new FlightTaskArea(piece));
+        area->addTask(QSharedPointer<FlightTask>(new NoFlyFlightTask()));
+        _results.append(area);
+        added = true;
+    }
+    if (!added)
+        _skipped++;
+}
@@ -0,0 +1,73 @@
+#ifndef NOFLYZONEIMPORTER_H
+#define NOFLYZONEIMPORTER_H
+
+#include <QList>
+#include <QPolygonF>
+#include <QSharedPointer>
+#include <QString>
+
+#include "FlightTaskArea.h"
+
+class QIODevice;
+class QJsonObject;
+
+/**
+ * @brief The NoFlyZoneImporter class turns a file of airspace restriction polygons into no-fly areas: a
+ * FlightTaskArea with a NoFlyFlightTask for each polygon. Add them all at once with
+ * PlanningProblem::addTaskAreas().
+ *
+ * GeoJSON (.geojson, .json) Polygon and MultiPolygon geometries are read, alone or in Features,
+ * FeatureCollections and GeometryCollections. Shapefiles (.shp) are read one record at a time, so the whole
+ * file is never in memory; Polygon, PolygonZ and PolygonM records are supported. Coordinates must be
+ * longitude/latitude (WGS84).
+ *
+ * Only outer rings are imported. Holes are filled in, which makes a zone bigger but never lets a flight into
+ * restricted airspace. Each ring is simplified with Douglas-Peucker to simplifyTolerance() and clipped to
+ * region(), if there is one. Rings entirely outside the region are skipped.
+ */
+class NoFlyZoneImporter
+{
+public:
+    NoFlyZoneImporter(const QString& filename);
+
+    bool doImport();
+
+    const QList<QSharedPointer<FlightTaskArea> >& results() const;
+
+    /**
+     * @brief simplifyTolerance is how far in meters a simplified outline may stray from the original. Zero
+     * keeps every vertex. Defaults to 5.
+     */
+    qreal simplifyTolerance() const;
+    void setSimplifyTolerance(qreal meters);
+
+    /**
+     * @brief region is the (longitude, latitude) polygon the zones are clipped to. Empty (the default)
+     * imports them whole.
+     */
+    const QPolygonF& region() const;
+    void setRegion(const QPolygonF& region);
+
+    /**
+     * @brief skippedCount returns how many rings the last import left out for being outside the region or
+     * degenerate
+     */
+    int skippedCount() const;
+
+    QString errorString() const;
+
+private:
+    bool importGeoJSON(QIODevice * device);
+    bool importShapefile(QIODevice * device);
+    void addGeoJSONObject(const QJsonObject& object);
+    void addRing(QPolygonF ring);
+
+    QString _filename;
+    qreal _simplifyTolerance;
+    QPolygonF _region;
+    QList<QSharedPointer<FlightTaskArea> > _results;
+    int _skipped;
+    QString _errorString;
+};
+
+#endif // NOFLYZONEIMPORTER_H
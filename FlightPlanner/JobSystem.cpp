@@ -0,0 +1,355 @@
+#include "JobSystem.h"
+
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QThread>
+#include <QThreadStorage>
+
+#include "PlanningStatistics.h"
+
+//How long a waiting thread sleeps before looking for queued jobs again, in milliseconds. Jobs its group's jobs
+//fork elsewhere don't wake it, so this bounds how long they can sit there.
+const unsigned long HELP_POLL_MS = 1;
+
+//The job system and worker the current thread belongs to, if it's a worker
+struct CurrentWorker
+{
+    CurrentWorker() : system(0), worker(-1) {}
+
+    const JobSystem * system;
+    int worker;
+};
+
+//non-member
+static QThreadStorage<CurrentWorker>& currentWorker()
+{
+    static QThreadStorage<CurrentWorker> storage;
+    return storage;
+}
+
+class JobSystem::WorkerThread : public QThread
+{
+public:
+    WorkerThread(JobSystem * system, int worker) : _system(system), _worker(worker)
+    {
+    }
+
+protected:
+    //virtual from QThread
+    virtual void run()
+    {
+        CurrentWorker current;
+        current.system = _system;
+        current.worker = _worker;
+        currentWorker().setLocalData(current);
+        _system->_work(_worker);
+    }
+
+private:
+    JobSystem * _system;
+    int _worker;
+};
+
+JobSystem::JobStatistics::JobStatistics() :
+    jobs(0), stolenJobs(0), totalNanoseconds(0), maxNanoseconds(0)
+{
+}
+
+JobSystem::JobSystem(int workerCount) :
+    _workerCount(1), _queued(0), _stopping(false)
+{
+    _outside.thread = 0;
+    _start(workerCount);
+}
+
+JobSystem::~JobSystem()
+{
+    _stop();
+}
+
+//static
+JobSystem *JobSystem::shared()
+{
+    static JobSystem system;
+    return &system;
+}
+
+int JobSystem::workerCount() const
+{
+    return _workerCount;
+}
+
+void JobSystem::setWorkerCount(int count)
+{
+    _stop();
+    _start(count);
+}
+
+QMap<QString, JobSystem::JobStatistics> JobSystem::statistics() const
+{
+    QMap<QString, JobStatistics> toRet;
+    QList<const Worker *> workers;
+    foreach(const Worker * worker, _workers)
+        workers.append(worker);
+    workers.append(&_outside);
+
+    foreach(const Worker * worker, workers)
+    {
+        QMutexLocker lock(&worker->lock);
+        QHash<QByteArray, JobStatistics>::const_iterator iter;
+        for (iter = worker->statistics.constBegin(); iter != worker->statistics.constEnd(); iter++)
+        {
+            JobStatistics& total = toRet[QString::fromLatin1(iter.key())];
+            total.jobs += iter.value().jobs;
+            total.stolenJobs += iter.value().stolenJobs;
+            total.totalNanoseconds += iter.value().totalNanoseconds;
+            total.maxNanoseconds = qMax<qint64>(total.maxNanoseconds, iter.value().maxNanoseconds);
+        }
+    }
+    return toRet;
+}
+
+void JobSystem::resetStatistics()
+{
+    foreach(Worker * worker, _workers)
+    {
+        QMutexLocker lock(&worker->lock);
+        worker->statistics.clear();
+    }
+    QMutexLocker lock(&_outside.lock);
+    _outside.statistics.clear();
+}
+
+void JobSystem::addToStatistics(PlanningStatistics *statistics) const
+{
+    const QMap<QString, JobStatistics> current = this->statistics();
+    QMap<QString, JobStatistics>::const_iterator iter;
+    for (iter = current.constBegin(); iter != current.constEnd(); iter++)
+    {
+        statistics->setCounter(iter.key() + "Jobs", iter.value().jobs);
+        statistics->setCounter(iter.key() + "JobsStolen", iter.value().stolenJobs);
+        statistics->setCounter(iter.key() + "JobMicroseconds", iter.value().totalNanoseconds / 1000);
+        statistics->setCounter(iter.key() + "JobMaxMicroseconds", iter.value().maxNanoseconds / 1000);
+    }
+}
+
+//private
+void JobSystem::_start(int workerCount)
+{
+    _workerCount = (workerCount == 0) ? QThread::idealThreadCount() : workerCount;
+    _workerCount = qMax<int>(1, _workerCount);
+    _stopping = false;
+
+    //Whoever waits on a group does the work of the last worker
+    for (int i = 0; i < _workerCount - 1; i++)
+    {
+        Worker * worker = new Worker();
+        worker->thread = new WorkerThread(this, i);
+        _workers.append(worker);
+    }
+    foreach(Worker * worker, _workers)
+        worker->thread->start();
+}
+
+//private
+void JobSystem::_stop()
+{
+    QMutexLocker lock(&_sleepLock);
+    _stopping = true;
+    _wakeUp.wakeAll();
+    lock.unlock();
+
+    foreach(Worker * worker, _workers)
+    {
+        worker->thread->wait();
+        delete worker->thread;
+
+        //Jobs nobody got to (there shouldn't be any) go to whoever waits on them next
+        for (int p = 0; p < PriorityCount; p++)
+            _outside.queues[p] += worker->queues[p];
+        QHash<QByteArray, JobStatistics>::const_iterator iter;
+        for (iter = worker->statistics.constBegin(); iter != worker->statistics.constEnd(); iter++)
+        {
+            JobStatistics& total = _outside.statistics[iter.key()];
+            total.jobs += iter.value().jobs;
+            total.stolenJobs += iter.value().stolenJobs;
+            total.totalNanoseconds += iter.value().totalNanoseconds;
+            total.maxNanoseconds = qMax<qint64>(total.maxNanoseconds, iter.value().maxNanoseconds);
+        }
+        delete worker;
+    }
+    _workers.clear();
+}
+
+//private
+int JobSystem::_currentWorker() const
+{
+    if (!currentWorker().hasLocalData())
+        return -1;
+    const CurrentWorker& current = currentWorker().localData();
+    return (current.system == this) ? current.worker : -1;
+}
+
+//private
+void JobSystem::_push(const Entry &entry, Priority priority)
+{
+    const int self = _currentWorker();
+    Worker * worker = (self >= 0) ? _workers.at(self) : &_outside;
+    _queued.ref();
+    QMutexLocker lock(&worker->lock);
+    worker->queues[priority].append(entry);
+    lock.unlock();
+
+    QMutexLocker sleepLock(&_sleepLock);
+    _wakeUp.wakeOne();
+}
+
+//private
+bool JobSystem::_take(int worker, JobSystem::Entry *entry, bool *stolen)
+{
+    if (_queued.load() == 0)
+        return false;
+
+    for (int p = 0; p < PriorityCount; p++)
+    {
+        //Our own newest job first, since what it needs is most likely still in cache
+        if (worker >= 0)
+        {
+            Worker * own = _workers.at(worker);
+            QMutexLocker lock(&own->lock);
+            if (!own->queues[p].isEmpty())
+            {
+                *entry = own->queues[p].takeLast();
+                *stolen = false;
+                _queued.deref();
+                return true;
+            }
+        }
+
+        //Then the oldest job anyone else has, which is usually the biggest
+        const int victims = _workers.size() + 1;
+        for (int k = 0; k < victims; k++)
+        {
+            const int victim = (worker + 1 + k) % victims;
+            if (victim == worker)
+                continue;
+            Worker * other = (victim < _workers.size()) ? _workers.at(victim) : &_outside;
+            QMutexLocker lock(&other->lock);
+            if (!other->queues[p].isEmpty())
+            {
+                *entry = other->queues[p].takeFirst();
+                *stolen = (other != &_outside);
+                _queued.deref();
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+//private
+bool JobSystem::_runOne()
+{
+    const int self = _currentWorker();
+    Entry entry;
+    bool stolen = false;
+    if (!_take(self, &entry, &stolen))
+        return false;
+    _execute(self, entry, stolen);
+    return true;
+}
+
+//private
+void JobSystem::_execute(int worker, const Entry &entry, bool stolen)
+{
+    QElapsedTimer timer;
+    timer.start();
+    entry.job->run();
+    const qint64 elapsed = timer.nsecsElapsed();
+    if (entry.job->autoDelete())
+        delete entry.job;
+
+    Worker * statisticsWorker = (worker >= 0) ? _workers.at(worker) : &_outside;
+    QMutexLocker lock(&statisticsWorker->lock);
+    JobStatistics& statistics = statisticsWorker->statistics[QByteArray(entry.name)];
+    statistics.jobs++;
+    if (stolen)
+        statistics.stolenJobs++;
+    statistics.totalNanoseconds += elapsed;
+    statistics.maxNanoseconds = qMax<qint64>(statistics.maxNanoseconds, elapsed);
+    lock.unlock();
+
+    entry.group->_jobFinished();
+}
+
+//private
+void JobSystem::_work(int worker)
+{
+    while (true)
+    {
+        Entry entry;
+        bool stolen = false;
+        if (_take(worker, &entry, &stolen))
+        {
+            _execute(worker, entry, stolen);
+            continue;
+        }
+
+        QMutexLocker lock(&_sleepLock);
+        if (_stopping)
+            return;
+        if (_queued.load() == 0)
+            _wakeUp.wait(&_sleepLock);
+    }
+}
+
+JobGroup::JobGroup(JobSystem *system) :
+    _system(system), _pending(0)
+{
+}
+
+JobGroup::~JobGroup()
+{
+    this->wait();
+}
+
+void JobGroup::run(QRunnable *job, const char *name, JobSystem::Priority priority)
+{
+    QMutexLocker lock(&_lock);
+    _pending++;
+    lock.unlock();
+
+    JobSystem::Entry entry;
+    entry.job = job;
+    entry.group = this;
+    entry.name = name;
+    _system->_push(entry, priority);
+}
+
+void JobGroup::wait()
+{
+    while (true)
+    {
+        QMutexLocker lock(&_lock);
+        if (_pending == 0)
+            return;
+        lock.unlock();
+
+        //Rather than sit idle, run queued jobs (ours or anyone's) until ours are done
+        if (_system->_runOne())
+            continue;
+
+        lock.relock();
+        if (_pending == 0)
+            return;
+        _done.wait(&_lock, HELP_POLL_MS);
+    }
+}
+
+//private
+void JobGroup::_jobFinished()
+{
+    QMutexLocker lock(&_lock);
+    if (--_pending == 0)
+        _done.wakeAll();
+}
@@ -0,0 +1,164 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <QtGlobal>
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QRunnable>
+#include <QString>
+#include <QWaitCondition>
+
+class JobGroup;
+class PlanningStatistics;
+
+/**
+ * @brief The JobSystem class runs the planners' parallel work (sub-flights per task, transitions per pair of
+ * tasks, beam expansions, fitness evaluations...) on one set of worker threads. Those stages nest inside each
+ * other, and giving each level its own QThreadPool would start far more threads than there are cores.
+ *
+ * Jobs are QRunnables forked into a JobGroup and joined by JobGroup::wait(). Each worker keeps its own queues and
+ * runs the jobs it forked itself newest first. Idle workers steal the oldest jobs from the others. A thread that
+ * waits on a group runs queued jobs until the group is done instead of blocking, so a job that forks and joins
+ * its own jobs never ties up a worker and workerCount() threads are busy at most (plus any outside threads that
+ * are waiting).
+ *
+ * Higher priority jobs are always taken before lower priority ones. Each job is timed under the name it was
+ * forked with, see statistics().
+ */
+class JobSystem
+{
+public:
+    enum Priority
+    {
+        HighPriority,
+        NormalPriority,
+        LowPriority,
+
+        PriorityCount
+    };
+
+    /**
+     * @brief The JobStatistics struct is what the jobs run under one name added up to
+     */
+    struct JobStatistics
+    {
+        JobStatistics();
+
+        qint64 jobs;
+        qint64 stolenJobs;
+        qint64 totalNanoseconds;
+        qint64 maxNanoseconds;
+    };
+
+    /**
+     * @brief JobSystem starts workerCount - 1 worker threads. The thread waiting on a group is the last worker.
+     * @param workerCount 0 means "use QThread::idealThreadCount()"
+     */
+    explicit JobSystem(int workerCount = 0);
+    ~JobSystem();
+
+    /**
+     * @brief shared returns the job system that all the planners use, created the first time it's needed
+     * @return
+     */
+    static JobSystem * shared();
+
+    int workerCount() const;
+
+    /**
+     * @brief setWorkerCount replaces the worker threads. Don't call it while jobs are queued or running.
+     * @param count 0 means "use QThread::idealThreadCount()"
+     */
+    void setWorkerCount(int count);
+
+    /**
+     * @brief statistics returns what the jobs run so far took, by the names they were forked with
+     * @return
+     */
+    QMap<QString, JobStatistics> statistics() const;
+    void resetStatistics();
+
+    /**
+     * @brief addToStatistics sets <name>Jobs, <name>JobsStolen, <name>JobMicroseconds and
+     * <name>JobMaxMicroseconds counters in statistics for every name jobs have been run under
+     * @param statistics
+     */
+    void addToStatistics(PlanningStatistics * statistics) const;
+
+private:
+    class WorkerThread;
+    friend class JobGroup;
+
+    struct Entry
+    {
+        QRunnable * job;
+        JobGroup * group;
+        const char * name;
+    };
+
+    //One worker's queues, newest jobs last. The outside threads share one too.
+    struct Worker
+    {
+        mutable QMutex lock;
+        QList<Entry> queues[PriorityCount];
+        QHash<QByteArray, JobStatistics> statistics;
+        WorkerThread * thread;
+    };
+
+    void _start(int workerCount);
+    void _stop();
+    int _currentWorker() const;
+    void _push(const Entry& entry, Priority priority);
+    bool _take(int worker, Entry * entry, bool * stolen);
+    bool _runOne();
+    void _execute(int worker, const Entry& entry, bool stolen);
+    void _work(int worker);
+
+    int _workerCount;
+    QList<Worker *> _workers;
+    Worker _outside;
+
+    QMutex _sleepLock;
+    QWaitCondition _wakeUp;
+    QAtomicInt _queued;
+    bool _stopping;
+};
+
+/**
+ * @brief The JobGroup class forks jobs onto a JobSystem and joins them. It waits for its jobs when it's destroyed.
+ */
+class JobGroup
+{
+public:
+    explicit JobGroup(JobSystem * system = JobSystem::shared());
+    ~JobGroup();
+
+    /**
+     * @brief run queues job to be run by some worker. It's deleted afterwards if its autoDelete() is set.
+     * @param job
+     * @param name what the job is timed as, e.g. "SubFlight". Counter names are built from it, so keep it CamelCase.
+     * @param priority
+     */
+    void run(QRunnable * job, const char * name, JobSystem::Priority priority = JobSystem::NormalPriority);
+
+    /**
+     * @brief wait returns once every job run() so far has finished, running queued jobs in the meantime
+     */
+    void wait();
+
+private:
+    void _jobFinished();
+
+    JobSystem * _system;
+    QMutex _lock;
+    QWaitCondition _done;
+    int _pending;
+
+    friend class JobSystem;
+};
+
+#endif // JOBSYSTEM_H
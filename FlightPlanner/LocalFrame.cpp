@@ -0,0 +1,82 @@
+#include "LocalFrame.h"
+
+#include <QRectF>
+#include <QVector>
+
+LocalFrame::LocalFrame(const Position &reference) :
+    _converter(Position(reference.lonLat(), 0.0))
+{
+}
+
+//static
+LocalFrame LocalFrame::around(const QRectF &lonLatBounds)
+{
+    return LocalFrame(Position(lonLatBounds.center()));
+}
+
+const Position &LocalFrame::reference() const
+{
+    return _converter.reference();
+}
+
+QPointF LocalFrame::toLocal(const QPointF &lonLat) const
+{
+    const QVector3D enu = _converter.lla2enu(lonLat.y(), lonLat.x(), 0.0);
+    return QPointF(enu.x(), enu.y());
+}
+
+QPolygonF LocalFrame::toLocal(const QPolygonF &lonLatPoly) const
+{
+    const int count = lonLatPoly.size();
+    QVector<qreal> lats(count);
+    QVector<qreal> lons(count);
+    const QVector<qreal> alts(count, 0.0);
+    for (int i = 0; i < count; i++)
+    {
+        lons[i] = lonLatPoly.at(i).x();
+        lats[i] = lonLatPoly.at(i).y();
+    }
+
+    QVector<qreal> easts(count);
+    QVector<qreal> norths(count);
+    QVector<qreal> ups(count);
+    _converter.lla2enu(lats.constData(), lons.constData(), alts.constData(),
+                       count,
+                       easts.data(), norths.data(), ups.data());
+
+    QPolygonF toRet(count);
+    for (int i = 0; i < count; i++)
+        toRet[i] = QPointF(easts.at(i), norths.at(i));
+    return toRet;
+}
+
+Position LocalFrame::toGeo(const QPointF &local) const
+{
+    const Position lla = _converter.enu2lla(local.x(), local.y(), 0.0);
+    return Position(lla.lonLat());
+}
+
+QPolygonF LocalFrame::toGeo(const QPolygonF &localPoly) const
+{
+    const int count = localPoly.size();
+    QVector<qreal> easts(count);
+    QVector<qreal> norths(count);
+    const QVector<qreal> ups(count, 0.0);
+    for (int i = 0; i < count; i++)
+    {
+        easts[i] = localPoly.at(i).x();
+        norths[i] = localPoly.at(i).y();
+    }
+
+    QVector<qreal> lats(count);
+    QVector<qreal> lons(count);
+    QVector<qreal> alts(count);
+    _converter.enu2lla(easts.constData(), norths.constData(), ups.constData(),
+                       count,
+                       lats.data(), lons.data(), alts.data());
+
+    QPolygonF toRet(count);
+    for (int i = 0; i < count; i++)
+        toRet[i] = QPointF(lons.at(i), lats.at(i));
+    return toRet;
+}
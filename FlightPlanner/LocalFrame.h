@@ -0,0 +1,56 @@
+#ifndef LOCALFRAME_H
+#define LOCALFRAME_H
+
+#include <QtGlobal>
+#include <QPointF>
+#include <QPolygonF>
+#include <QRectF>
+
+#include "Position.h"
+#include "guts/ENUConverter.h"
+
+/**
+ * @brief The LocalFrame class is a flat east/north frame in meters, tangent to the earth at one reference
+ * point, for doing planning geometry without degrees.
+ *
+ * Distances, angles and areas in the frame are plain Euclidean ones: no degreesLonPerMeter() scale factors and
+ * no lla2xyz(). Converting in or out costs a few trigonometric calls, so convert once (e.g., when compiling a
+ * problem) and stay in the frame. Altitude is ignored.
+ *
+ * A LocalFrame is a value type and immutable once constructed.
+ */
+class LocalFrame
+{
+public:
+    LocalFrame(const Position& reference = Position());
+
+    /**
+     * @brief around returns a frame whose reference is the middle of the given lon/lat rectangle
+     * @param lonLatBounds
+     * @return
+     */
+    static LocalFrame around(const QRectF& lonLatBounds);
+
+    const Position& reference() const;
+
+    /**
+     * @brief toLocal converts a lon/lat point to meters east and north of the reference
+     * @param lonLat
+     * @return
+     */
+    QPointF toLocal(const QPointF& lonLat) const;
+    QPolygonF toLocal(const QPolygonF& lonLatPoly) const;
+
+    /**
+     * @brief toGeo converts meters east and north of the reference back to lon/lat
+     * @param local
+     * @return
+     */
+    Position toGeo(const QPointF& local) const;
+    QPolygonF toGeo(const QPolygonF& localPoly) const;
+
+private:
+    ENUConverter _converter;
+};
+
+#endif // LOCALFRAME_H
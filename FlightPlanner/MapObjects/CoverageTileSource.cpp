@@ -0,0 +1,417 @@
+#include "CoverageTileSource.h"
+
+#include <QMetaObject>
+#include <QMutexLocker>
+#include <QPainter>
+#include <QtConcurrentRun>
+#include <QtDebug>
+#include <cmath>
+
+#include "FlightTasks/CoverageTask.h"
+#include "guts/Conversions.h"
+
+const qreal PI = 3.14159265358979323846;
+const qreal deg2rad = PI / 180.0;
+const qreal rad2deg = 180.0 / PI;
+
+const quint16 TILE_SIZE = 256;
+
+//How many bytes of drawn tiles to keep. A 256x256 tile is 256 KB
+const int TILE_CACHE_BYTES = 32 * 1024 * 1024;
+
+//Bins smaller than this many pixels are shaded per pixel instead of drawn one by one
+const qreal MIN_BIN_PIXELS = 2.0;
+
+//Half transparent so that the map shows through
+const QRgb SATISFIED_COLOR = qRgba(0, 200, 0, 128);
+const QRgb UNSATISFIED_COLOR = qRgba(220, 0, 0, 128);
+
+typedef CoverageTileSource::Layer Layer;
+
+//non-member
+static QPointF mercator(const QPointF& ll, quint8 zoomLevel)
+{
+    const qreal edge = pow(2.0, zoomLevel) * TILE_SIZE;
+    const qreal x = (ll.x() + 180.0) * edge / 360.0;
+    const qreal y = (1.0 - (log(tan(PI / 4.0 + (ll.y() * deg2rad) / 2.0)) / PI)) / 2.0 * edge;
+    return QPointF(x, y);
+}
+
+//non-member
+static QRgb shade(qreal satisfiedFraction)
+{
+    const qreal f = satisfiedFraction;
+    return qRgba(qRound(qRed(UNSATISFIED_COLOR) + f * (qRed(SATISFIED_COLOR) - qRed(UNSATISFIED_COLOR))),
+                 qRound(qGreen(UNSATISFIED_COLOR) + f * (qGreen(SATISFIED_COLOR) - qGreen(UNSATISFIED_COLOR))),
+                 qRound(qBlue(UNSATISFIED_COLOR) + f * (qBlue(SATISFIED_COLOR) - qBlue(UNSATISFIED_COLOR))),
+                 qAlpha(SATISFIED_COLOR));
+}
+
+//non-member
+static bool sameLayer(const Layer& a, const Layer& b)
+{
+    return a.geoPoly == b.geoPoly && a.granularity == b.granularity && a.maxDistance == b.maxDistance
+            && a.satisfied == b.satisfied;
+}
+
+//non-member
+static bool containsLayer(const QList<Layer>& layers, const Layer& layer)
+{
+    foreach(const Layer& other, layers)
+    {
+        if (sameLayer(other, layer))
+            return true;
+    }
+    return false;
+}
+
+//non-member
+static QSharedPointer<const QList<Layer> > computeCoverage(QList<Layer> layers,
+                                                           QList<Position> flight,
+                                                           QSharedPointer<const QList<Layer> > previous)
+{
+    for (int i = 0; i < layers.size(); i++)
+    {
+        Layer& layer = layers[i];
+        layer.geoBounds = layer.geoPoly.boundingRect().normalized();
+
+        //Building the bins is the expensive part, and they only change with the area
+        bool reused = false;
+        foreach(const Layer& old, *previous)
+        {
+            if (old.geoPoly != layer.geoPoly || old.granularity != layer.granularity)
+                continue;
+            layer.bins = old.bins;
+            reused = true;
+            break;
+        }
+        if (!reused)
+            layer.bins.build(layer.geoPoly, layer.granularity);
+        layer.satisfied = QBitArray(layer.bins.cellCount());
+    }
+
+    foreach(const Position& pos, flight)
+    {
+        const QVector3D xyz = Conversions::lla2xyz(pos);
+        for (int i = 0; i < layers.size(); i++)
+            layers[i].bins.satisfyWithin(pos, xyz, layers.at(i).maxDistance, &layers[i].satisfied);
+    }
+    return QSharedPointer<const QList<Layer> >(new QList<Layer>(layers));
+}
+
+//non-member
+static QImage drawCoverageTile(QSharedPointer<const QList<Layer> > coverage,
+                               quint32 x, quint32 y, quint8 z,
+                               QRectF geoRect)
+{
+    QImage toRet(TILE_SIZE, TILE_SIZE, QImage::Format_ARGB32_Premultiplied);
+    toRet.fill(Qt::transparent);
+    const QPointF origin((qreal) x * TILE_SIZE, (qreal) y * TILE_SIZE);
+
+    QPainter painter(&toRet);
+    painter.setPen(Qt::NoPen);
+    QVector<int> cells;
+    foreach(const Layer& layer, *coverage)
+    {
+        if (!layer.geoBounds.intersects(geoRect))
+            continue;
+
+        //How big a bin is here, in degrees and in pixels
+        const qreal lat = qBound<qreal>(geoRect.top(), layer.geoBounds.center().y(), geoRect.bottom());
+        const qreal binLon = layer.granularity * Conversions::degreesLonPerMeter(lat);
+        const qreal binLat = layer.granularity * Conversions::degreesLatPerMeter(lat);
+        const QPointF center(layer.geoBounds.center().x(), lat);
+        const qreal binPixels = mercator(center + QPointF(binLon, 0.0), z).x() - mercator(center, z).x();
+
+        //Bins straddling the tile's edges are drawn too
+        cells.clear();
+        layer.bins.binsInside(geoRect.adjusted(-binLon, -binLat, binLon, binLat), &cells);
+        if (cells.isEmpty())
+            continue;
+
+        if (binPixels >= MIN_BIN_PIXELS)
+        {
+            foreach(int cell, cells)
+            {
+                const QPointF pixel = mercator(layer.bins.lla(cell).lonLat(), z) - origin;
+                const QColor color = QColor::fromRgba(layer.satisfied.testBit(cell) ? SATISFIED_COLOR
+                                                                                      : UNSATISFIED_COLOR);
+                painter.fillRect(QRectF(pixel.x() - binPixels / 2.0, pixel.y() - binPixels / 2.0,
+                                        binPixels, binPixels),
+                                 color);
+            }
+            continue;
+        }
+
+        //Too small to draw one by one, so each pixel is shaded by the fraction of its bins that are satisfied
+        QVector<quint32> satisfied(TILE_SIZE * TILE_SIZE, 0);
+        QVector<quint32> total(TILE_SIZE * TILE_SIZE, 0);
+        foreach(int cell, cells)
+        {
+            const QPointF pixel = mercator(layer.bins.lla(cell).lonLat(), z) - origin;
+            const int px = (int) floor(pixel.x());
+            const int py = (int) floor(pixel.y());
+            if (px < 0 || py < 0 || px >= TILE_SIZE || py >= TILE_SIZE)
+                continue;
+            total[py * TILE_SIZE + px]++;
+            if (layer.satisfied.testBit(cell))
+                satisfied[py * TILE_SIZE + px]++;
+        }
+
+        QImage shading(TILE_SIZE, TILE_SIZE, QImage::Format_ARGB32);
+        shading.fill(Qt::transparent);
+        for (int py = 0; py < TILE_SIZE; py++)
+        {
+            QRgb * line = reinterpret_cast<QRgb *>(shading.scanLine(py));
+            for (int px = 0; px < TILE_SIZE; px++)
+            {
+                const quint32 count = total.at(py * TILE_SIZE + px);
+                if (count == 0)
+                    continue;
+                line[px] = shade((qreal) satisfied.at(py * TILE_SIZE + px) / count);
+            }
+        }
+        painter.drawImage(0, 0, shading);
+    }
+    painter.end();
+    return toRet;
+}
+
+CoverageTileSource::CoverageTileSource() :
+    MapTileSource(), _requestWaiting(false), _coverage(new QList<Layer>()), _generation(0), _coverageWatcher(0)
+{
+    //We keep our own tiles, since they're thrown out by area rather than by age
+    this->setCacheMode(MapTileSource::NoCaching);
+    _tiles.setMaxCost(TILE_CACHE_BYTES);
+}
+
+CoverageTileSource::~CoverageTileSource()
+{
+    //Drawing threads hold their own references to the coverage, so there's nothing to wait for
+}
+
+//pure-virtual from MapTileSource
+QPointF CoverageTileSource::ll2qgs(const QPointF &ll, quint8 zoomLevel) const
+{
+    //Rounded like OSMTileSource's so that we line up with the map under us
+    const QPointF toRet = mercator(ll, zoomLevel);
+    return QPoint(int(toRet.x()), int(toRet.y()));
+}
+
+//pure-virtual from MapTileSource
+QPointF CoverageTileSource::qgs2ll(const QPointF &qgs, quint8 zoomLevel) const
+{
+    const qreal edge = pow(2.0, zoomLevel) * TILE_SIZE;
+    const qreal longitude = qgs.x() * (360.0 / edge) - 180.0;
+    const qreal latitude = rad2deg * atan(sinh((1.0 - qgs.y() * (2.0 / edge)) * PI));
+    return QPointF(longitude, latitude);
+}
+
+//pure-virtual from MapTileSource
+quint64 CoverageTileSource::tilesOnZoomLevel(quint8 zoomLevel) const
+{
+    return pow(4.0, zoomLevel);
+}
+
+//pure-virtual from MapTileSource
+quint16 CoverageTileSource::tileSize() const
+{
+    return TILE_SIZE;
+}
+
+//pure-virtual from MapTileSource
+quint8 CoverageTileSource::minZoomLevel(QPointF ll)
+{
+    Q_UNUSED(ll)
+    return 0;
+}
+
+//pure-virtual from MapTileSource
+quint8 CoverageTileSource::maxZoomLevel(QPointF ll)
+{
+    Q_UNUSED(ll)
+    return 50;
+}
+
+//pure-virtual from MapTileSource
+QString CoverageTileSource::name() const
+{
+    return "Coverage";
+}
+
+//pure-virtual from MapTileSource
+QString CoverageTileSource::tileFileExtension() const
+{
+    return ".png";
+}
+
+void CoverageTileSource::setCoverage(const QList<QSharedPointer<FlightTaskArea> > &areas,
+                                     const QList<Position> &flight)
+{
+    QList<Layer> layers;
+    foreach(const QSharedPointer<FlightTaskArea>& area, areas)
+    {
+        foreach(const QSharedPointer<FlightTask>& task, area->tasks())
+        {
+            const CoverageTask * coverageTask = qobject_cast<const CoverageTask *>(task.data());
+            if (coverageTask == 0)
+                continue;
+
+            Layer layer;
+            layer.geoPoly = area->geoPoly();
+            layer.granularity = coverageTask->granularity();
+            layer.maxDistance = coverageTask->maxDistance();
+            layers.append(layer);
+        }
+    }
+
+    //The update is worked out from our own thread, which picks up whatever was asked for last
+    QMutexLocker lock(&_requestLock);
+    _requestedLayers = layers;
+    _requestedFlight = flight;
+    if (_requestWaiting)
+        return;
+    _requestWaiting = true;
+    QMetaObject::invokeMethod(this, "updateCoverage", Qt::QueuedConnection);
+}
+
+//protected
+//pure-virtual from MapTileSource
+void CoverageTileSource::fetchTile(quint32 x, quint32 y, quint8 z)
+{
+    const MapTileKey key(x,y,z);
+    const QImage * cached = _tiles.object(key);
+    if (cached != 0)
+    {
+        this->prepareNewlyReceivedTile(x, y, z, new QImage(*cached));
+        return;
+    }
+
+    //Most of the map has no coverage tasks on it
+    const QRectF geoRect = this->tileGeoRect(x, y, z);
+    bool covered = false;
+    foreach(const Layer& layer, *_coverage)
+    {
+        if (layer.geoBounds.intersects(geoRect))
+        {
+            covered = true;
+            break;
+        }
+    }
+    if (!covered)
+    {
+        QImage * blank = new QImage(TILE_SIZE, TILE_SIZE, QImage::Format_ARGB32_Premultiplied);
+        blank->fill(Qt::transparent);
+        this->prepareNewlyReceivedTile(x, y, z, blank);
+        return;
+    }
+
+    PendingTile pending;
+    pending.key = key;
+    pending.generation = _generation;
+
+    QFutureWatcher<QImage> * watcher = new QFutureWatcher<QImage>(this);
+    connect(watcher,
+            SIGNAL(finished()),
+            this,
+            SLOT(handleTileDrawn()));
+    _pendingTiles.insert(watcher, pending);
+    watcher->setFuture(QtConcurrent::run(drawCoverageTile, _coverage, x, y, z, geoRect));
+}
+
+//private slot
+void CoverageTileSource::updateCoverage()
+{
+    //One update at a time. The one that's running starts the next when it's done.
+    if (_coverageWatcher != 0 && _coverageWatcher->isRunning())
+        return;
+
+    QMutexLocker lock(&_requestLock);
+    if (!_requestWaiting)
+        return;
+    _requestWaiting = false;
+    const QList<Layer> layers = _requestedLayers;
+    const QList<Position> flight = _requestedFlight;
+    lock.unlock();
+
+    if (_coverageWatcher == 0)
+    {
+        _coverageWatcher = new QFutureWatcher<QSharedPointer<const QList<Layer> > >(this);
+        connect(_coverageWatcher,
+                SIGNAL(finished()),
+                this,
+                SLOT(handleCoverageUpdated()));
+    }
+    _coverageWatcher->setFuture(QtConcurrent::run(computeCoverage, layers, flight, _coverage));
+}
+
+//private slot
+void CoverageTileSource::handleCoverageUpdated()
+{
+    const QSharedPointer<const QList<Layer> > updated = _coverageWatcher->result();
+
+    //The areas whose coverage is new or gone
+    QList<QRectF> changed;
+    foreach(const Layer& layer, *updated)
+    {
+        if (!containsLayer(*_coverage, layer))
+            changed.append(layer.geoBounds);
+    }
+    foreach(const Layer& layer, *_coverage)
+    {
+        if (!containsLayer(*updated, layer))
+            changed.append(layer.geoBounds);
+    }
+    _coverage = updated;
+
+    if (!changed.isEmpty())
+    {
+        //Tiles being drawn from the old coverage are drawn again when they're done
+        _generation++;
+
+        foreach(const MapTileKey& key, _tiles.keys())
+        {
+            const QRectF geoRect = this->tileGeoRect(key.x(), key.y(), key.z());
+            foreach(const QRectF& area, changed)
+            {
+                if (!geoRect.intersects(area))
+                    continue;
+                _tiles.remove(key);
+                break;
+            }
+        }
+
+        foreach(const QRectF& area, changed)
+            this->tilesInvalidated(area);
+    }
+
+    //Anything asked for while we were busy
+    this->updateCoverage();
+}
+
+//private slot
+void CoverageTileSource::handleTileDrawn()
+{
+    QFutureWatcher<QImage> * watcher = static_cast<QFutureWatcher<QImage> *>(QObject::sender());
+    if (!_pendingTiles.contains(watcher))
+    {
+        qWarning() << "Unknown coverage tile";
+        return;
+    }
+    watcher->deleteLater();
+
+    const PendingTile pending = _pendingTiles.take(watcher);
+    const quint32 x = pending.key.x();
+    const quint32 y = pending.key.y();
+    const quint8 z = pending.key.z();
+
+    if (pending.generation != _generation)
+    {
+        this->fetchTile(x, y, z);
+        return;
+    }
+
+    const QImage tile = watcher->result();
+    _tiles.insert(pending.key, new QImage(tile), tile.byteCount());
+    this->prepareNewlyReceivedTile(x, y, z, new QImage(tile));
+}
@@ -0,0 +1,115 @@
+#ifndef COVERAGETILESOURCE_H
+#define COVERAGETILESOURCE_H
+
+#include <QBitArray>
+#include <QCache>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QSharedPointer>
+
+#include "MapTileSource.h"
+#include "FlightTaskArea.h"
+#include "FlightTasks/CoverageBins.h"
+
+/**
+ * @brief The CoverageTileSource class is a tile layer showing how well a flight covers the areas' coverage
+ * tasks, meant to be laid over the map by a CompositeTileSource. Bins the flight satisfies are green and the
+ * rest are red. Where bins are smaller than a couple of pixels each pixel is shaded by the fraction of its bins
+ * that are satisfied instead.
+ *
+ * Tiles are only drawn when they're requested, in the global QThreadPool, from the bins inside them. Drawn
+ * tiles are kept until the coverage of an area they show changes. setCoverage() also works out which bins
+ * are satisfied in the thread pool, and then invalidates (see tilesInvalidated()) just the areas whose coverage
+ * changed, so a new best flight doesn't redraw the whole map.
+ */
+class CoverageTileSource : public MapTileSource
+{
+    Q_OBJECT
+public:
+    explicit CoverageTileSource();
+    virtual ~CoverageTileSource();
+
+    //pure-virtual from MapTileSource
+    virtual QPointF ll2qgs(const QPointF& ll, quint8 zoomLevel) const;
+
+    //pure-virtual from MapTileSource
+    virtual QPointF qgs2ll(const QPointF& qgs, quint8 zoomLevel) const;
+
+    //pure-virtual from MapTileSource
+    virtual quint64 tilesOnZoomLevel(quint8 zoomLevel) const;
+
+    //pure-virtual from MapTileSource
+    virtual quint16 tileSize() const;
+
+    //pure-virtual from MapTileSource
+    virtual quint8 minZoomLevel(QPointF ll);
+
+    //pure-virtual from MapTileSource
+    virtual quint8 maxZoomLevel(QPointF ll);
+
+    //pure-virtual from MapTileSource
+    virtual QString name() const;
+
+    //pure-virtual from MapTileSource
+    virtual QString tileFileExtension() const;
+
+    /**
+     * @brief setCoverage shows how flight covers the coverage tasks of areas. The areas are only read here, so
+     * call it from the thread they live in whenever they or the flight change. An update that's still being
+     * worked out when the next one comes is superseded by it.
+     * @param areas
+     * @param flight
+     */
+    void setCoverage(const QList<QSharedPointer<FlightTaskArea> >& areas, const QList<Position>& flight);
+
+    /**
+     * @brief The Layer struct is one coverage task's bins and which of them the flight satisfies
+     */
+    struct Layer
+    {
+        QPolygonF geoPoly;
+        qreal granularity;
+        qreal maxDistance;
+
+        QRectF geoBounds;
+        CoverageBins bins;
+        QBitArray satisfied;
+    };
+
+protected:
+    //pure-virtual from MapTileSource
+    virtual void fetchTile(quint32 x,
+                           quint32 y,
+                           quint8 z);
+
+private slots:
+    void updateCoverage();
+    void handleCoverageUpdated();
+    void handleTileDrawn();
+
+private:
+    //A tile being drawn and the coverage it's drawn from
+    struct PendingTile
+    {
+        MapTileKey key;
+        quint32 generation;
+    };
+
+    //What setCoverage() was last asked for. Protected by _requestLock
+    QMutex _requestLock;
+    QList<Layer> _requestedLayers;
+    QList<Position> _requestedFlight;
+    bool _requestWaiting;
+
+    //The coverage tiles are drawn from. Replaced, never modified, so drawing threads can share it
+    QSharedPointer<const QList<Layer> > _coverage;
+    quint32 _generation;
+    QFutureWatcher<QSharedPointer<const QList<Layer> > > * _coverageWatcher;
+
+    QCache<MapTileKey, QImage> _tiles;
+    QHash<QFutureWatcher<QImage> *, PendingTile> _pendingTiles;
+};
+
+#endif // COVERAGETILESOURCE_H
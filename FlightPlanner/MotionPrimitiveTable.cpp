@@ -0,0 +1,169 @@
+#include "MotionPrimitiveTable.h"
+
+#include <cmath>
+
+#include "guts/Conversions.h"
+
+const qreal PI = 3.1415926535897932384626433;
+
+//Lattice units per meter
+const qreal UNITS_PER_METER = 1000.0;
+
+//Headings are split at least this finely...
+const int MIN_HEADING_BINS = 64;
+
+//...and at most this finely, however small the turns
+const int MAX_HEADING_BINS = 4096;
+
+LatticePose::LatticePose() :
+    east(0), north(0), headingBin(0)
+{
+}
+
+LatticePose::LatticePose(qint32 east, qint32 north, int headingBin) :
+    east(east), north(north), headingBin(headingBin)
+{
+}
+
+bool LatticePose::operator ==(const LatticePose &other) const
+{
+    return east == other.east && north == other.north && headingBin == other.headingBin;
+}
+
+bool LatticePose::operator !=(const LatticePose &other) const
+{
+    return !(*this == other);
+}
+
+//non-member
+uint qHash(const LatticePose &pose)
+{
+    const quint64 multiplier = Q_UINT64_C(0x9e3779b97f4a7c15);
+    quint64 toRet = (quint64) (quint32) pose.east * multiplier;
+    toRet = (toRet ^ (quint32) pose.north) * multiplier;
+    toRet = (toRet ^ (quint32) pose.headingBin) * multiplier;
+    return (uint) (toRet ^ (toRet >> 32));
+}
+
+MotionPrimitiveTable::MotionPrimitiveTable() :
+    _headingBins(0), _branchCount(0), _lonPerUnit(0.0), _latPerUnit(0.0)
+{
+}
+
+MotionPrimitiveTable::MotionPrimitiveTable(const UAVParameters &params, int branchesPerSide,
+                                           const Position &origin, const UAVOrientation &originPose)
+{
+    _build(params.waypointInterval(), params.maxTurnAngle() / qMax<int>(1, branchesPerSide), branchesPerSide,
+           origin, originPose);
+}
+
+MotionPrimitiveTable::MotionPrimitiveTable(qreal stepMeters, qreal turnStep, int branchesPerSide,
+                                           const Position &origin, const UAVOrientation &originPose)
+{
+    _build(stepMeters, turnStep, branchesPerSide, origin, originPose);
+}
+
+int MotionPrimitiveTable::headingBins() const
+{
+    return _headingBins;
+}
+
+int MotionPrimitiveTable::branchCount() const
+{
+    return _branchCount;
+}
+
+LatticePose MotionPrimitiveTable::successor(const LatticePose &pose, int branch) const
+{
+    const Primitive& primitive = _primitives.at(pose.headingBin * _branchCount + branch);
+    return LatticePose(pose.east + primitive.east, pose.north + primitive.north, primitive.headingBin);
+}
+
+LatticePose MotionPrimitiveTable::predecessor(const LatticePose &pose, int branch) const
+{
+    const Primitive& primitive = _primitives.at(pose.headingBin * _branchCount + branch);
+    return LatticePose(pose.east - _straightEast.at(pose.headingBin), pose.north - _straightNorth.at(pose.headingBin),
+                       primitive.headingBin);
+}
+
+Position MotionPrimitiveTable::stepSample(const LatticePose &pose, int branch, int sample) const
+{
+    const int offset = ((pose.headingBin * _branchCount + branch) * STEP_SAMPLES + sample) * 2;
+    return this->position(LatticePose(pose.east + _sampleOffsets.at(offset),
+                                      pose.north + _sampleOffsets.at(offset + 1),
+                                      pose.headingBin));
+}
+
+Position MotionPrimitiveTable::position(const LatticePose &pose) const
+{
+    return Position(_origin.longitude() + pose.east * _lonPerUnit,
+                    _origin.latitude() + pose.north * _latPerUnit);
+}
+
+UAVOrientation MotionPrimitiveTable::orientation(const LatticePose &pose) const
+{
+    return UAVOrientation(_radians.at(pose.headingBin));
+}
+
+qreal MotionPrimitiveTable::radians(int headingBin) const
+{
+    return _radians.at(headingBin);
+}
+
+//static
+qint32 MotionPrimitiveTable::millimeters(qreal meters)
+{
+    return (qint32) qRound64(meters * UNITS_PER_METER);
+}
+
+//private
+void MotionPrimitiveTable::_build(qreal stepMeters, qreal turnStep, int branchesPerSide, const Position &origin,
+                                  const UAVOrientation &originPose)
+{
+    //A whole number of turn steps per turn, rounding the steps down, and a whole number of bins per step
+    const qreal turn = 2.0 * PI;
+    int stepsPerTurn = MAX_HEADING_BINS;
+    if (turnStep > turn / MAX_HEADING_BINS)
+        stepsPerTurn = qMax<int>(2, (int) ceil(turn / turnStep - 1e-9));
+    const int binsPerStep = qMax<int>(1, (MIN_HEADING_BINS + stepsPerTurn - 1) / stepsPerTurn);
+    _headingBins = stepsPerTurn * binsPerStep;
+    branchesPerSide = qMax<int>(0, branchesPerSide);
+    _branchCount = 2 * branchesPerSide + 1;
+
+    _radians.resize(_headingBins);
+    _straightEast.resize(_headingBins);
+    _straightNorth.resize(_headingBins);
+    for (int bin = 0; bin < _headingBins; bin++)
+    {
+        _radians[bin] = UAVOrientation(originPose.radians() + turn * bin / _headingBins).radians();
+        _straightEast[bin] = millimeters(stepMeters * cos(_radians.at(bin)));
+        _straightNorth[bin] = millimeters(stepMeters * sin(_radians.at(bin)));
+    }
+
+    _primitives.resize(_headingBins * _branchCount);
+    _sampleOffsets.resize(_headingBins * _branchCount * STEP_SAMPLES * 2);
+    for (int bin = 0; bin < _headingBins; bin++)
+    {
+        for (int branch = 0; branch < _branchCount; branch++)
+        {
+            const int index = bin * _branchCount + branch;
+            const int turned = bin + (branch - branchesPerSide) * binsPerStep;
+            Primitive& primitive = _primitives[index];
+            primitive.headingBin = ((turned % _headingBins) + _headingBins) % _headingBins;
+            primitive.east = _straightEast.at(primitive.headingBin);
+            primitive.north = _straightNorth.at(primitive.headingBin);
+
+            //Straight along the new heading from the waypoint, like the step itself
+            for (int sample = 0; sample < STEP_SAMPLES; sample++)
+            {
+                const qreal fraction = (qreal) (sample + 1) / (STEP_SAMPLES + 1);
+                _sampleOffsets[(index * STEP_SAMPLES + sample) * 2] = qRound(primitive.east * fraction);
+                _sampleOffsets[(index * STEP_SAMPLES + sample) * 2 + 1] = qRound(primitive.north * fraction);
+            }
+        }
+    }
+
+    _origin = origin;
+    _lonPerUnit = Conversions::degreesLonPerMeter(origin.latitude()) / UNITS_PER_METER;
+    _latPerUnit = Conversions::degreesLatPerMeter(origin.latitude()) / UNITS_PER_METER;
+}
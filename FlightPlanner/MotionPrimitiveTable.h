@@ -0,0 +1,132 @@
+#ifndef MOTIONPRIMITIVETABLE_H
+#define MOTIONPRIMITIVETABLE_H
+
+#include <QtGlobal>
+#include <QVector>
+
+#include "Position.h"
+#include "UAVOrientation.h"
+#include "UAVParameters.h"
+
+/**
+ * @brief The LatticePose struct is a state of a MotionPrimitiveTable's lattice: where the UAV is, in whole
+ * millimeters east and north of the lattice's origin, and which of the lattice's heading bins it's flying in.
+ * Whatever path reaches a pose, it compares equal to the same pose reached any other way.
+ */
+struct LatticePose
+{
+    LatticePose();
+    LatticePose(qint32 east, qint32 north, int headingBin);
+
+    bool operator ==(const LatticePose& other) const;
+    bool operator !=(const LatticePose& other) const;
+
+    qint32 east;
+    qint32 north;
+    qint32 headingBin;
+};
+
+uint qHash(const LatticePose& pose);
+
+/**
+ * @brief The MotionPrimitiveTable class is the successor generation of the searches that fly one waypoint
+ * interval per step and turn by a fixed fraction of the UAV's maximum turn at each waypoint.
+ *
+ * Headings are split into bins, starting at the origin's heading, so that every turn is a whole number of bins.
+ * That can make the turns a little gentler than asked for, never sharper. For every heading bin and branch the
+ * table holds the step's offset in millimeters, the heading bin it ends up in and samples along the way, all
+ * worked out once from the UAV's parameters. A successor is then two additions and a lookup, with no
+ * trigonometry or geodesy. Positions are only made from poses when they're needed, as flat offsets from the
+ * origin at its latitude, which is plenty for the few kilometers a search covers.
+ */
+class MotionPrimitiveTable
+{
+public:
+    //How many points between a step's ends stepSample() has
+    static const int STEP_SAMPLES = 3;
+
+    MotionPrimitiveTable();
+
+    /**
+     * @brief MotionPrimitiveTable makes the table of steps one waypoint interval long that turn by up to the
+     * UAV's maxTurnAngle(), in branchesPerSide equal steps each way
+     * @param params
+     * @param branchesPerSide
+     * @param origin the position the lattice's poses are offsets from
+     * @param originPose the heading of heading bin 0
+     */
+    MotionPrimitiveTable(const UAVParameters& params, int branchesPerSide, const Position& origin,
+                         const UAVOrientation& originPose);
+
+    /**
+     * @brief MotionPrimitiveTable makes the table of steps stepMeters long that turn by turnStep radians
+     * per branch, branchesPerSide branches each way
+     */
+    MotionPrimitiveTable(qreal stepMeters, qreal turnStep, int branchesPerSide, const Position& origin,
+                         const UAVOrientation& originPose);
+
+    int headingBins() const;
+
+    /**
+     * @brief branchCount returns how many successors every pose has. Branch 0 turns the furthest clockwise,
+     * branchCount() / 2 goes straight on and the last turns the furthest counter-clockwise.
+     * @return
+     */
+    int branchCount() const;
+
+    /**
+     * @brief successor returns the pose a step along branch takes pose to: turning, then flying one step
+     * on the new heading
+     */
+    LatticePose successor(const LatticePose& pose, int branch) const;
+
+    /**
+     * @brief predecessor returns the pose one step behind pose along its heading, turned by branch, so that
+     * flying forward from it with the opposite branch comes back to pose exactly
+     */
+    LatticePose predecessor(const LatticePose& pose, int branch) const;
+
+    /**
+     * @brief stepSample returns the sample-th of the STEP_SAMPLES points, evenly spread, between pose and its
+     * successor along branch
+     */
+    Position stepSample(const LatticePose& pose, int branch, int sample) const;
+
+    Position position(const LatticePose& pose) const;
+    UAVOrientation orientation(const LatticePose& pose) const;
+    qreal radians(int headingBin) const;
+
+    /**
+     * @brief millimeters returns meters in the lattice's units, rounded
+     */
+    static qint32 millimeters(qreal meters);
+
+private:
+    void _build(qreal stepMeters, qreal turnStep, int branchesPerSide, const Position& origin,
+                const UAVOrientation& originPose);
+
+    struct Primitive
+    {
+        qint32 east;
+        qint32 north;
+        qint32 headingBin;
+    };
+
+    int _headingBins;
+    int _branchCount;
+
+    //By heading bin, then branch
+    QVector<Primitive> _primitives;
+    QVector<qint32> _sampleOffsets;
+
+    //By heading bin: a straight step's offset, and the heading itself
+    QVector<qint32> _straightEast;
+    QVector<qint32> _straightNorth;
+    QVector<qreal> _radians;
+
+    Position _origin;
+    qreal _lonPerUnit;
+    qreal _latPerUnit;
+};
+
+#endif // MOTIONPRIMITIVETABLE_H
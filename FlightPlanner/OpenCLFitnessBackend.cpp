@@ -0,0 +1,543 @@
+#include "OpenCLFitnessBackend.h"
+
+#include <QByteArray>
+#include <QVarLengthArray>
+
+#include "CompiledProblem.h"
+#include "FlightTasks/CoverageBins.h"
+#include "FlightTasks/CoverageTask.h"
+#include "guts/Conversions.h"
+
+//The kernel keeps each task's running score in local memory, so problems with more tasks stay on the CPU
+const int MAX_TASKS = 64;
+
+//Work-items per flight, if the device allows that many
+const size_t PREFERRED_LOCAL_SIZE = 64;
+
+//Task kinds as the kernel knows them
+const int GPU_COVERAGE_KIND = 0;
+const int GPU_SAMPLING_KIND = 1;
+const int GPU_NO_FLY_KIND = 2;
+
+const char * KERNEL_SOURCE =
+        "#define MAX_TASKS 64\n"
+        "#define COVERAGE_KIND 0\n"
+        "#define SAMPLING_KIND 1\n"
+        "#define NO_FLY_KIND 2\n"
+        "\n"
+        "//FlightTask::normal(distance, 200.0, 10.0), as CoverageTask entices with it\n"
+        "float enticement(float distance)\n"
+        "{\n"
+        "    const float x = distance / 200.0f;\n"
+        "    return exp(-0.05f * x * x) / (200.0f * 2.50662827463f);\n"
+        "}\n"
+        "\n"
+        "__kernel void scoreFlights(const int taskCount, const int binCount, const int slotCount,\n"
+        "                           __global const int * taskKinds,\n"
+        "                           __global const int * taskSlots,\n"
+        "                           __global const int * taskBinStarts,\n"
+        "                           __global const float * taskValues,\n"
+        "                           __global const float * taskMaxPerformances,\n"
+        "                           __global const int * taskShortness,\n"
+        "                           __global const float4 * binXYZ,\n"
+        "                           __global const int * binTasks,\n"
+        "                           __global const float4 * positions,\n"
+        "                           __global const int * flightStarts,\n"
+        "                           __global const uchar * inside,\n"
+        "                           __global uchar * satisfied,\n"
+        "                           __global float * taskScoresOut,\n"
+        "                           __global float * efficiencyScoresOut,\n"
+        "                           __global int * lengthsOut)\n"
+        "{\n"
+        "    const int flight = get_group_id(0);\n"
+        "    const int id = get_local_id(0);\n"
+        "    const int workers = get_local_size(0);\n"
+        "    __global uchar * flightSatisfied = satisfied + (size_t) flight * binCount;\n"
+        "\n"
+        "    __local int newlySatisfied[MAX_TASKS];\n"
+        "    __local int satisfiedCounts[MAX_TASKS];\n"
+        "    __local int firstUnsatisfied[MAX_TASKS];\n"
+        "    __local float totals[MAX_TASKS];\n"
+        "\n"
+        "    for (int b = id; b < binCount; b += workers)\n"
+        "        flightSatisfied[b] = 0;\n"
+        "    for (int t = id; t < taskCount; t += workers)\n"
+        "    {\n"
+        "        newlySatisfied[t] = 0;\n"
+        "        satisfiedCounts[t] = 0;\n"
+        "        firstUnsatisfied[t] = taskBinStarts[t];\n"
+        "        totals[t] = 0.0f;\n"
+        "    }\n"
+        "    barrier(CLK_LOCAL_MEM_FENCE | CLK_GLOBAL_MEM_FENCE);\n"
+        "\n"
+        "    const int first = flightStarts[flight];\n"
+        "    const int end = flightStarts[flight + 1];\n"
+        "    float bestTaskScore = 0.0f;\n"
+        "    float bestEfficiencyScore = 0.0f;\n"
+        "    int bestLength = 0;\n"
+        "    for (int p = first; p < end; p++)\n"
+        "    {\n"
+        "        const float4 pos = positions[p];\n"
+        "\n"
+        "        //Every work-item marks the bins of its share that this waypoint satisfies\n"
+        "        for (int b = id; b < binCount; b += workers)\n"
+        "        {\n"
+        "            if (flightSatisfied[b])\n"
+        "                continue;\n"
+        "            const float4 d = binXYZ[b] - pos;\n"
+        "            const int task = binTasks[b];\n"
+        "            if (dot(d, d) < taskValues[task])\n"
+        "            {\n"
+        "                flightSatisfied[b] = 1;\n"
+        "                atomic_inc(&newlySatisfied[task]);\n"
+        "            }\n"
+        "        }\n"
+        "        barrier(CLK_LOCAL_MEM_FENCE | CLK_GLOBAL_MEM_FENCE);\n"
+        "\n"
+        "        //Then the first one scores the prefix ending here\n"
+        "        if (id == 0)\n"
+        "        {\n"
+        "            const int positionCount = p - first + 1;\n"
+        "            float taskScore = 0.0f;\n"
+        "            float efficiencyScore = 0.0f;\n"
+        "            for (int t = 0; t < taskCount; t++)\n"
+        "            {\n"
+        "                float subScore;\n"
+        "                if (taskKinds[t] == COVERAGE_KIND)\n"
+        "                {\n"
+        "                    satisfiedCounts[t] += newlySatisfied[t];\n"
+        "                    newlySatisfied[t] = 0;\n"
+        "                    const int binsEnd = taskBinStarts[t + 1];\n"
+        "                    int next = firstUnsatisfied[t];\n"
+        "                    while (next < binsEnd && flightSatisfied[next])\n"
+        "                        next++;\n"
+        "                    firstUnsatisfied[t] = next;\n"
+        "                    subScore = satisfiedCounts[t];\n"
+        "                    if (next < binsEnd)\n"
+        "                        subScore += enticement(length(binXYZ[next].xyz - pos.xyz));\n"
+        "                }\n"
+        "                else if (taskKinds[t] == SAMPLING_KIND)\n"
+        "                {\n"
+        "                    if (inside[(size_t) p * slotCount + taskSlots[t]])\n"
+        "                        totals[t] += taskValues[t];\n"
+        "                    subScore = totals[t];\n"
+        "                }\n"
+        "                else\n"
+        "                {\n"
+        "                    if (inside[(size_t) p * slotCount + taskSlots[t]])\n"
+        "                        totals[t] = 1.0f;\n"
+        "                    subScore = (totals[t] > 0.0f) ? 0.0f : taskValues[t];\n"
+        "                }\n"
+        "\n"
+        "                if (taskShortness[t] && subScore >= taskMaxPerformances[t])\n"
+        "                    efficiencyScore += subScore / positionCount;\n"
+        "                taskScore += subScore;\n"
+        "            }\n"
+        "\n"
+        "            if (p == first || taskScore > bestTaskScore\n"
+        "                    || (taskScore == bestTaskScore && efficiencyScore > bestEfficiencyScore))\n"
+        "            {\n"
+        "                bestTaskScore = taskScore;\n"
+        "                bestEfficiencyScore = efficiencyScore;\n"
+        "                bestLength = p - first;\n"
+        "            }\n"
+        "        }\n"
+        "        barrier(CLK_LOCAL_MEM_FENCE | CLK_GLOBAL_MEM_FENCE);\n"
+        "    }\n"
+        "\n"
+        "    if (id == 0)\n"
+        "    {\n"
+        "        taskScoresOut[flight] = bestTaskScore;\n"
+        "        efficiencyScoresOut[flight] = bestEfficiencyScore;\n"
+        "        lengthsOut[flight] = bestLength;\n"
+        "    }\n"
+        "}\n";
+
+/*
+ * Releases a buffer when it goes out of scope, so the error paths don't leak them.
+*/
+class ScopedBuffer
+{
+public:
+    ScopedBuffer() : buffer(0)
+    {
+    }
+
+    ~ScopedBuffer()
+    {
+        if (buffer)
+            clReleaseMemObject(buffer);
+    }
+
+    cl_mem buffer;
+};
+
+//non-member
+static QString clError(const char * what, cl_int error)
+{
+    return QString("%1 failed with OpenCL error %2").arg(what).arg(error);
+}
+
+//non-member
+//A read-only buffer holding a copy of count values. Empty arrays get one value, as OpenCL has no empty buffers.
+template <typename T>
+static cl_mem uploadBuffer(cl_context context, const T * values, int count, cl_int * error)
+{
+    const T placeholder = T();
+    if (count == 0)
+    {
+        values = &placeholder;
+        count = 1;
+    }
+    return clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(T) * count,
+                          (void *) values, error);
+}
+
+//static
+OpenCLFitnessBackend *OpenCLFitnessBackend::create(const CompiledProblem *problem, QString *errorString)
+{
+    if (problem->taskCount() > MAX_TASKS)
+    {
+        *errorString = QString("the GPU backend scores at most %1 tasks").arg(MAX_TASKS);
+        return 0;
+    }
+
+    for (int t = 0; t < problem->taskCount(); t++)
+    {
+        const CompiledProblem::TaskKind kind = problem->task(t).kind;
+        if (kind != CompiledProblem::CoverageTaskKind && kind != CompiledProblem::SamplingTaskKind
+                && kind != CompiledProblem::NoFlyTaskKind)
+        {
+            *errorString = "the GPU backend only scores coverage, sampling and no-fly tasks";
+            return 0;
+        }
+    }
+
+    OpenCLFitnessBackend * toRet = new OpenCLFitnessBackend(problem);
+    if (!toRet->_initialize(errorString) || !toRet->_uploadProblem(errorString))
+    {
+        delete toRet;
+        return 0;
+    }
+    return toRet;
+}
+
+OpenCLFitnessBackend::~OpenCLFitnessBackend()
+{
+    cl_mem buffers[] = {_taskKinds, _taskSlots, _taskBinStarts, _taskValues, _taskMaxPerformances,
+                        _taskShortness, _binXYZ, _binTasks};
+    for (int i = 0; i < (int) (sizeof(buffers) / sizeof(buffers[0])); i++)
+    {
+        if (buffers[i])
+            clReleaseMemObject(buffers[i]);
+    }
+
+    if (_kernel)
+        clReleaseKernel(_kernel);
+    if (_program)
+        clReleaseProgram(_program);
+    if (_queue)
+        clReleaseCommandQueue(_queue);
+    if (_context)
+        clReleaseContext(_context);
+}
+
+const QString &OpenCLFitnessBackend::deviceName() const
+{
+    return _deviceName;
+}
+
+bool OpenCLFitnessBackend::evaluate(const QList<QList<Position> > &flights,
+                                    QVector<Fitness> *fitnessesOut,
+                                    QVector<int> *lengthsOut,
+                                    QString *errorString)
+{
+    //Each flight needs a flag per bin on the device, so big batches go in chunks the device can allocate
+    const int chunkSize = (int) qBound<cl_ulong>(1, _maxAllocation / qMax(1, _binCount), flights.size());
+    for (int first = 0; first < flights.size(); first += chunkSize)
+    {
+        const int end = qMin(flights.size(), first + chunkSize);
+        if (!_evaluateChunk(flights, first, end, fitnessesOut, lengthsOut, errorString))
+            return false;
+    }
+    return true;
+}
+
+//private
+OpenCLFitnessBackend::OpenCLFitnessBackend(const CompiledProblem *problem) :
+    _problem(problem), _device(0), _context(0), _queue(0), _program(0), _kernel(0), _localSize(1),
+    _maxAllocation(0), _binCount(0), _taskKinds(0), _taskSlots(0), _taskBinStarts(0), _taskValues(0),
+    _taskMaxPerformances(0), _taskShortness(0), _binXYZ(0), _binTasks(0)
+{
+}
+
+//private
+bool OpenCLFitnessBackend::_initialize(QString *errorString)
+{
+    cl_uint platformCount = 0;
+    if (clGetPlatformIDs(0, 0, &platformCount) != CL_SUCCESS || platformCount == 0)
+    {
+        *errorString = "no OpenCL platforms";
+        return false;
+    }
+
+    QVarLengthArray<cl_platform_id, 8> platforms(platformCount);
+    clGetPlatformIDs(platformCount, platforms.data(), 0);
+    for (int i = 0; i < (int) platformCount && _device == 0; i++)
+    {
+        if (clGetDeviceIDs(platforms[i], CL_DEVICE_TYPE_GPU, 1, &_device, 0) != CL_SUCCESS)
+            _device = 0;
+    }
+    if (_device == 0)
+    {
+        *errorString = "no OpenCL GPU";
+        return false;
+    }
+
+    char name[256] = {0};
+    clGetDeviceInfo(_device, CL_DEVICE_NAME, sizeof(name) - 1, name, 0);
+    _deviceName = QString::fromLatin1(name).trimmed();
+    clGetDeviceInfo(_device, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(_maxAllocation), &_maxAllocation, 0);
+
+    cl_int error = CL_SUCCESS;
+    _context = clCreateContext(0, 1, &_device, 0, 0, &error);
+    if (error != CL_SUCCESS)
+    {
+        *errorString = clError("clCreateContext", error);
+        return false;
+    }
+
+    _queue = clCreateCommandQueue(_context, _device, 0, &error);
+    if (error != CL_SUCCESS)
+    {
+        *errorString = clError("clCreateCommandQueue", error);
+        return false;
+    }
+
+    _program = clCreateProgramWithSource(_context, 1, &KERNEL_SOURCE, 0, &error);
+    if (error != CL_SUCCESS)
+    {
+        *errorString = clError("clCreateProgramWithSource", error);
+        return false;
+    }
+
+    error = clBuildProgram(_program, 1, &_device, 0, 0, 0);
+    if (error != CL_SUCCESS)
+    {
+        size_t logSize = 0;
+        clGetProgramBuildInfo(_program, _device, CL_PROGRAM_BUILD_LOG, 0, 0, &logSize);
+        QByteArray log(qMax<int>(1, (int) logSize), '\0');
+        clGetProgramBuildInfo(_program, _device, CL_PROGRAM_BUILD_LOG, log.size(), log.data(), 0);
+        *errorString = clError("clBuildProgram", error) + ": " + QString::fromLatin1(log.constData());
+        return false;
+    }
+
+    _kernel = clCreateKernel(_program, "scoreFlights", &error);
+    if (error != CL_SUCCESS)
+    {
+        *errorString = clError("clCreateKernel", error);
+        return false;
+    }
+
+    size_t maxLocalSize = 1;
+    clGetKernelWorkGroupInfo(_kernel, _device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(maxLocalSize), &maxLocalSize, 0);
+    _localSize = qBound<size_t>(1, maxLocalSize, PREFERRED_LOCAL_SIZE);
+    return true;
+}
+
+//private
+bool OpenCLFitnessBackend::_uploadProblem(QString *errorString)
+{
+    _reference = Conversions::lla2xyz(_problem->startingPosition());
+
+    const int taskCount = _problem->taskCount();
+    QVector<cl_int> kinds(taskCount);
+    QVector<cl_int> slots(taskCount, 0);
+    QVector<cl_int> binStarts(taskCount + 1, 0);
+    QVector<cl_float> values(taskCount);
+    QVector<cl_float> maxPerformances(taskCount);
+    QVector<cl_int> shortness(taskCount);
+    QVector<cl_float> binXYZ;
+    QVector<cl_int> binTasks;
+
+    for (int t = 0; t < taskCount; t++)
+    {
+        const CompiledProblem::Task& task = _problem->task(t);
+        const CompiledProblem::Area& area = _problem->area(task.area);
+        binStarts[t] = binTasks.size();
+        maxPerformances[t] = task.maxPerformance;
+        shortness[t] = task.shortnessRewardApplies ? 1 : 0;
+
+        if (task.kind == CompiledProblem::CoverageTaskKind)
+        {
+            const CoverageTask * coverage = static_cast<const CoverageTask *>(task.task);
+            kinds[t] = GPU_COVERAGE_KIND;
+            values[t] = coverage->maxDistance() * coverage->maxDistance();
+
+            //Built the way CoverageTask builds its own, and listed in the order it entices the UAV through them
+            CoverageBins bins;
+            bins.build(area.geoPoly, coverage->granularity());
+            for (int cell = bins.nextBin(0); cell < bins.cellCount(); cell = bins.nextBin(cell + 1))
+            {
+                const QVector3D offset = bins.xyz(cell) - _reference;
+                binXYZ << offset.x() << offset.y() << offset.z() << 0.0f;
+                binTasks.append(t);
+            }
+            continue;
+        }
+
+        //Sampling and no-fly tasks only need to know which waypoints are inside their area
+        slots[t] = _slotAreas.indexOf(task.area);
+        if (slots[t] < 0)
+        {
+            slots[t] = _slotAreas.size();
+            _slotAreas.append(task.area);
+        }
+
+        if (task.kind == CompiledProblem::SamplingTaskKind)
+        {
+            const UAVParameters& uavParams = _problem->uavParameters();
+            kinds[t] = GPU_SAMPLING_KIND;
+            values[t] = uavParams.waypointInterval() / uavParams.airspeed();
+        }
+        else
+        {
+            kinds[t] = GPU_NO_FLY_KIND;
+            values[t] = task.maxPerformance;
+        }
+    }
+    binStarts[taskCount] = binTasks.size();
+    _binCount = binTasks.size();
+
+    cl_int error = CL_SUCCESS;
+    cl_int errors[8];
+    _taskKinds = uploadBuffer(_context, kinds.constData(), kinds.size(), &errors[0]);
+    _taskSlots = uploadBuffer(_context, slots.constData(), slots.size(), &errors[1]);
+    _taskBinStarts = uploadBuffer(_context, binStarts.constData(), binStarts.size(), &errors[2]);
+    _taskValues = uploadBuffer(_context, values.constData(), values.size(), &errors[3]);
+    _taskMaxPerformances = uploadBuffer(_context, maxPerformances.constData(), maxPerformances.size(), &errors[4]);
+    _taskShortness = uploadBuffer(_context, shortness.constData(), shortness.size(), &errors[5]);
+    _binXYZ = uploadBuffer(_context, binXYZ.constData(), binXYZ.size(), &errors[6]);
+    _binTasks = uploadBuffer(_context, binTasks.constData(), binTasks.size(), &errors[7]);
+    for (int i = 0; i < 8 && error == CL_SUCCESS; i++)
+        error = errors[i];
+    if (error != CL_SUCCESS)
+    {
+        *errorString = clError("Uploading the problem", error);
+        return false;
+    }
+    return true;
+}
+
+//private
+bool OpenCLFitnessBackend::_evaluateChunk(const QList<QList<Position> > &flights, int first, int end,
+                                          QVector<Fitness> *fitnessesOut, QVector<int> *lengthsOut,
+                                          QString *errorString)
+{
+    const int flightCount = end - first;
+    const int slotCount = _slotAreas.size();
+
+    //Waypoints as ECEF offsets, and as lon/lat for the inside tests
+    QVector<cl_int> flightStarts(flightCount + 1, 0);
+    QVector<cl_float> positions;
+    QVector<qreal> lons;
+    QVector<qreal> lats;
+    for (int i = first; i < end; i++)
+    {
+        foreach(const Position& pos, flights.at(i))
+        {
+            const QVector3D offset = Conversions::lla2xyz(pos) - _reference;
+            positions << offset.x() << offset.y() << offset.z() << 0.0f;
+            lons.append(pos.longitude());
+            lats.append(pos.latitude());
+        }
+        flightStarts[i - first + 1] = lons.size();
+    }
+
+    const int positionCount = lons.size();
+    QVector<uchar> inside(positionCount * slotCount, 0);
+    QVector<bool> areaInside(positionCount);
+    for (int s = 0; s < slotCount; s++)
+    {
+        _problem->area(_slotAreas.at(s)).polygonIndex.contains(lons.constData(), lats.constData(), positionCount,
+                                                                areaInside.data());
+        for (int p = 0; p < positionCount; p++)
+            inside[p * slotCount + s] = areaInside.at(p) ? 1 : 0;
+    }
+
+    cl_int errors[7];
+    ScopedBuffer positionBuffer;
+    ScopedBuffer flightStartBuffer;
+    ScopedBuffer insideBuffer;
+    ScopedBuffer satisfiedBuffer;
+    ScopedBuffer taskScoreBuffer;
+    ScopedBuffer efficiencyScoreBuffer;
+    ScopedBuffer lengthBuffer;
+    positionBuffer.buffer = uploadBuffer(_context, positions.constData(), positions.size(), &errors[0]);
+    flightStartBuffer.buffer = uploadBuffer(_context, flightStarts.constData(), flightStarts.size(), &errors[1]);
+    insideBuffer.buffer = uploadBuffer(_context, inside.constData(), inside.size(), &errors[2]);
+    satisfiedBuffer.buffer = clCreateBuffer(_context, CL_MEM_READ_WRITE,
+                                            (size_t) flightCount * qMax(1, _binCount), 0, &errors[3]);
+    taskScoreBuffer.buffer = clCreateBuffer(_context, CL_MEM_WRITE_ONLY, sizeof(cl_float) * flightCount, 0,
+                                            &errors[4]);
+    efficiencyScoreBuffer.buffer = clCreateBuffer(_context, CL_MEM_WRITE_ONLY, sizeof(cl_float) * flightCount, 0,
+                                                  &errors[5]);
+    lengthBuffer.buffer = clCreateBuffer(_context, CL_MEM_WRITE_ONLY, sizeof(cl_int) * flightCount, 0, &errors[6]);
+    for (int i = 0; i < 7; i++)
+    {
+        if (errors[i] != CL_SUCCESS)
+        {
+            *errorString = clError("Uploading the flights", errors[i]);
+            return false;
+        }
+    }
+
+    const cl_int taskCount = _problem->taskCount();
+    const cl_int binCount = _binCount;
+    const cl_int slots = slotCount;
+    const cl_mem args[] = {_taskKinds, _taskSlots, _taskBinStarts, _taskValues, _taskMaxPerformances,
+                           _taskShortness, _binXYZ, _binTasks, positionBuffer.buffer, flightStartBuffer.buffer,
+                           insideBuffer.buffer, satisfiedBuffer.buffer, taskScoreBuffer.buffer,
+                           efficiencyScoreBuffer.buffer, lengthBuffer.buffer};
+    cl_int error = clSetKernelArg(_kernel, 0, sizeof(cl_int), &taskCount);
+    error |= clSetKernelArg(_kernel, 1, sizeof(cl_int), &binCount);
+    error |= clSetKernelArg(_kernel, 2, sizeof(cl_int), &slots);
+    for (int i = 0; i < (int) (sizeof(args) / sizeof(args[0])); i++)
+        error |= clSetKernelArg(_kernel, 3 + i, sizeof(cl_mem), &args[i]);
+    if (error != CL_SUCCESS)
+    {
+        *errorString = clError("clSetKernelArg", error);
+        return false;
+    }
+
+    //One work-group per flight
+    const size_t globalSize = _localSize * flightCount;
+    error = clEnqueueNDRangeKernel(_queue, _kernel, 1, 0, &globalSize, &_localSize, 0, 0, 0);
+    if (error != CL_SUCCESS)
+    {
+        *errorString = clError("clEnqueueNDRangeKernel", error);
+        return false;
+    }
+
+    QVector<cl_float> taskScores(flightCount);
+    QVector<cl_float> efficiencyScores(flightCount);
+    QVector<cl_int> lengths(flightCount);
+    error = clEnqueueReadBuffer(_queue, taskScoreBuffer.buffer, CL_FALSE, 0, sizeof(cl_float) * flightCount,
+                                taskScores.data(), 0, 0, 0);
+    error |= clEnqueueReadBuffer(_queue, efficiencyScoreBuffer.buffer, CL_FALSE, 0, sizeof(cl_float) * flightCount,
+                                 efficiencyScores.data(), 0, 0, 0);
+    error |= clEnqueueReadBuffer(_queue, lengthBuffer.buffer, CL_TRUE, 0, sizeof(cl_int) * flightCount,
+                                 lengths.data(), 0, 0, 0);
+    if (error != CL_SUCCESS)
+    {
+        *errorString = clError("Reading the scores back", error);
+        return false;
+    }
+
+    for (int i = 0; i < flightCount; i++)
+    {
+        (*fitnessesOut)[first + i] = Fitness(taskScores.at(i), efficiencyScores.at(i));
+        (*lengthsOut)[first + i] = lengths.at(i);
+    }
+    return true;
+}
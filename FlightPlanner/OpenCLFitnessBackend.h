@@ -0,0 +1,98 @@
+#ifndef OPENCLFITNESSBACKEND_H
+#define OPENCLFITNESSBACKEND_H
+
+#include <QtGlobal>
+#include <QList>
+#include <QString>
+#include <QVector>
+#include <QVector3D>
+
+#define CL_TARGET_OPENCL_VERSION 120
+#ifdef Q_OS_MAC
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "Position.h"
+#include "Fitness.h"
+
+class CompiledProblem;
+
+/**
+ * @brief The OpenCLFitnessBackend class is BatchFitnessEvaluator's GPU backend. Only built with
+ * CONFIG += planning_opencl.
+ *
+ * The problem is uploaded once: the coverage bins of every coverage task (as ECEF offsets from the starting
+ * position, in the order CoverageTask entices the UAV through them) and a table of the tasks. Each batch uploads
+ * the flights' waypoints the same way, along with whether each waypoint is inside each sampling and no-fly area,
+ * which the CPU works out quickly with the areas' PolygonIndex. One work-group scores each flight. Its
+ * work-items split the bins between them and mark the ones each waypoint satisfies, and then the first work-item
+ * updates the tasks' scores and keeps the best prefix, just like the scoring states do.
+ */
+class OpenCLFitnessBackend
+{
+public:
+    /**
+     * @brief create sets up the first GPU found for problem
+     * @param problem must outlive the backend
+     * @param errorString set to why if there's no GPU, or problem has tasks the GPU can't score
+     * @return the backend, or 0
+     */
+    static OpenCLFitnessBackend * create(const CompiledProblem * problem, QString * errorString);
+    ~OpenCLFitnessBackend();
+
+    const QString& deviceName() const;
+
+    /**
+     * @brief evaluate is BatchFitnessEvaluator::evaluate() on the GPU
+     * @param flights
+     * @param fitnessesOut must already have flights.size() entries
+     * @param lengthsOut must already have flights.size() entries
+     * @param errorString set to what went wrong if it fails
+     * @return false if the GPU failed, in which case the outputs are undefined
+     */
+    bool evaluate(const QList<QList<Position> >& flights, QVector<Fitness> * fitnessesOut, QVector<int> * lengthsOut,
+                  QString * errorString);
+
+private:
+    OpenCLFitnessBackend(const CompiledProblem * problem);
+
+    bool _initialize(QString * errorString);
+    bool _uploadProblem(QString * errorString);
+    bool _evaluateChunk(const QList<QList<Position> >& flights, int first, int end,
+                        QVector<Fitness> * fitnessesOut, QVector<int> * lengthsOut, QString * errorString);
+
+    const CompiledProblem * _problem;
+    QString _deviceName;
+
+    cl_device_id _device;
+    cl_context _context;
+    cl_command_queue _queue;
+    cl_program _program;
+    cl_kernel _kernel;
+    size_t _localSize;
+    cl_ulong _maxAllocation;
+
+    //Waypoints and bins are uploaded relative to this, which keeps single precision exact enough
+    QVector3D _reference;
+
+    //The areas of the sampling and no-fly tasks, one inside-flag per waypoint each
+    QVector<int> _slotAreas;
+
+    int _binCount;
+
+    //Task table and bins, see the kernel
+    cl_mem _taskKinds;
+    cl_mem _taskSlots;
+    cl_mem _taskBinStarts;
+    cl_mem _taskValues;
+    cl_mem _taskMaxPerformances;
+    cl_mem _taskShortness;
+    cl_mem _binXYZ;
+    cl_mem _binTasks;
+
+    Q_DISABLE_COPY(OpenCLFitnessBackend)
+};
+
+#endif // OPENCLFITNESSBACKEND_H
@@ -0,0 +1,293 @@
+#include "ParameterSweep.h"
+
+#include <QElapsedTimer>
+#include <QThread>
+#include <QtDebug>
+
+#include "HierarchicalPlanner/HierarchicalPlanner.h"
+
+ParameterSweep::ParameterSweep(QSharedPointer<PlanningProblem> problem, QObject *parent) :
+    QObject(parent), _problem(problem), _timeBudget(0), _workerCount(0), _randomSeed(0),
+    _scheduleTimeBudget(0), _scheduleImprovementTimeBudget(1000), _elapsed(0), _runningPlanners(0)
+{
+    _budgetTimer.setSingleShot(true);
+    connect(&_budgetTimer,
+            SIGNAL(timeout()),
+            this,
+            SLOT(handleBudgetTimeout()));
+}
+
+ParameterSweep::~ParameterSweep()
+{
+    _clearPlanners();
+}
+
+QSharedPointer<PlanningProblem> ParameterSweep::problem() const
+{
+    return _problem;
+}
+
+void ParameterSweep::setProblem(QSharedPointer<PlanningProblem> problem)
+{
+    _problem = problem;
+}
+
+const QList<qreal> &ParameterSweep::airspeeds() const
+{
+    return _airspeeds;
+}
+
+void ParameterSweep::setAirspeeds(const QList<qreal> &airspeeds)
+{
+    _airspeeds = airspeeds;
+}
+
+const QList<qreal> &ParameterSweep::turningRadii() const
+{
+    return _turningRadii;
+}
+
+void ParameterSweep::setTurningRadii(const QList<qreal> &radii)
+{
+    _turningRadii = radii;
+}
+
+QList<UAVParameters> ParameterSweep::combinations() const
+{
+    QList<UAVParameters> toRet;
+    if (_problem.isNull())
+        return toRet;
+
+    const UAVParameters& base = _problem->uavParameters();
+    const QList<qreal> airspeeds = _airspeeds.isEmpty() ? QList<qreal>() << base.airspeed() : _airspeeds;
+    const QList<qreal> radii = _turningRadii.isEmpty() ? QList<qreal>() << base.minTurningRadius() : _turningRadii;
+    foreach(qreal airspeed, airspeeds)
+    {
+        foreach(qreal radius, radii)
+            toRet.append(UAVParameters(airspeed, radius, base.waypointInterval()));
+    }
+    return toRet;
+}
+
+qint64 ParameterSweep::timeBudget() const
+{
+    return _timeBudget;
+}
+
+void ParameterSweep::setTimeBudget(qint64 msecs)
+{
+    _timeBudget = qMax<qint64>(0, msecs);
+}
+
+int ParameterSweep::workerCount() const
+{
+    return _workerCount;
+}
+
+void ParameterSweep::setWorkerCount(int count)
+{
+    _workerCount = qMax<int>(0, count);
+}
+
+quint64 ParameterSweep::randomSeed() const
+{
+    return _randomSeed;
+}
+
+void ParameterSweep::setRandomSeed(quint64 seed)
+{
+    _randomSeed = seed;
+}
+
+const PlannerTuning &ParameterSweep::tuning() const
+{
+    return _tuning;
+}
+
+void ParameterSweep::setTuning(const PlannerTuning &tuning)
+{
+    _tuning = tuning;
+}
+
+qint64 ParameterSweep::scheduleTimeBudget() const
+{
+    return _scheduleTimeBudget;
+}
+
+void ParameterSweep::setScheduleTimeBudget(qint64 msecs)
+{
+    _scheduleTimeBudget = qMax<qint64>(0, msecs);
+}
+
+qint64 ParameterSweep::scheduleImprovementTimeBudget() const
+{
+    return _scheduleImprovementTimeBudget;
+}
+
+void ParameterSweep::setScheduleImprovementTimeBudget(qint64 msecs)
+{
+    _scheduleImprovementTimeBudget = qMax<qint64>(0, msecs);
+}
+
+bool ParameterSweep::plan(QString *errorString)
+{
+    QElapsedTimer clock;
+    clock.start();
+
+    _combinations = this->combinations();
+    const int count = _combinations.size();
+    _flights.clear();
+    _flights.resize(count);
+    _fitnesses.clear();
+    _fitnesses.resize(count);
+    _statistics.clear();
+    _statistics.resize(count);
+    _elapsed = 0;
+
+    if (_problem.isNull() || !_problem->startingPositionDefined())
+    {
+        if (errorString)
+            *errorString = "A parameter sweep needs a problem with a starting position";
+        return false;
+    }
+
+    /*
+     * The tasks are shared by every combination's problem. Preparing them here, before any planner is running,
+     * means the planners' own preparation finds nothing left to do instead of rebuilding data that the
+     * others are already scoring with.
+    */
+    _problem->prepareScoring();
+
+    const int workers = (_workerCount == 0) ? QThread::idealThreadCount() : _workerCount;
+    const int workersPerPlanner = qMax<int>(1, workers / qMax<int>(1, count));
+
+    const QList<QSharedPointer<FlightTaskArea> > areas = _problem->areas().toList();
+    for (int c = 0; c < count; c++)
+    {
+        QSharedPointer<PlanningProblem> combinationProblem(new PlanningProblem());
+        combinationProblem->setStartingPosition(_problem->startingPosition());
+        if (_problem->startingOrientationDefined())
+            combinationProblem->setStartingOrientation(_problem->startingOrientation());
+        combinationProblem->setUAVParameters(_combinations.at(c));
+        combinationProblem->addTaskAreas(areas);
+
+        //The first planner builds the obstacle structures as it takes its problem. The rest borrow them.
+        HierarchicalPlanner * planner = new HierarchicalPlanner();
+        planner->setRandomSeed(_randomSeed);
+        planner->setTuning(_tuning);
+        planner->setWorkerCount(workersPerPlanner);
+        planner->setScheduleTimeBudget(_scheduleTimeBudget);
+        planner->setScheduleImprovementTimeBudget(_scheduleImprovementTimeBudget);
+        planner->setExecutionMode(FlightPlanner::ThreadExecution);
+        if (!_planners.isEmpty())
+            planner->shareObstacleStructures(*_planners.first());
+        planner->setProblem(combinationProblem);
+
+        connect(planner,
+                SIGNAL(plannerStatusChanged(FlightPlanner::PlanningStatus)),
+                this,
+                SLOT(handlePlannerStatusChanged(FlightPlanner::PlanningStatus)));
+        _planners.append(planner);
+    }
+
+    //All of the combinations plan at once
+    _runningPlanners = 0;
+    bool started = true;
+    foreach(HierarchicalPlanner * planner, _planners)
+    {
+        planner->startPlanning();
+        if (planner->status() == FlightPlanner::Running)
+            _runningPlanners++;
+        else
+            started = false;
+    }
+
+    if (_runningPlanners > 0)
+    {
+        if (_timeBudget > 0)
+            _budgetTimer.start(_timeBudget);
+        _loop.exec();
+        _budgetTimer.stop();
+    }
+
+    for (int c = 0; c < _planners.size(); c++)
+    {
+        const HierarchicalPlanner * planner = _planners.at(c);
+        _flights[c] = planner->bestFlightSoFar();
+        _fitnesses[c] = planner->bestFitnessSoFar();
+        _statistics[c] = planner->statistics();
+    }
+    _clearPlanners();
+    _elapsed = clock.elapsed();
+
+    if (!started)
+    {
+        if (errorString)
+            *errorString = "A combination's planner refused to start";
+        return false;
+    }
+    return true;
+}
+
+QList<Position> ParameterSweep::flight(int combination) const
+{
+    return _flights.value(combination);
+}
+
+Fitness ParameterSweep::fitness(int combination) const
+{
+    return _fitnesses.value(combination);
+}
+
+PlanningStatistics ParameterSweep::statistics(int combination) const
+{
+    return _statistics.value(combination);
+}
+
+qreal ParameterSweep::flightTime(int combination) const
+{
+    if (combination < 0 || combination >= _combinations.size())
+        return 0.0;
+
+    //Waypoints are a waypoint interval apart, flown at the airspeed
+    const UAVParameters& params = _combinations.at(combination);
+    return _flights.at(combination).size() * params.waypointInterval() / params.airspeed();
+}
+
+qint64 ParameterSweep::elapsed() const
+{
+    return _elapsed;
+}
+
+//private slot
+void ParameterSweep::handlePlannerStatusChanged(FlightPlanner::PlanningStatus status)
+{
+    //HierarchicalPlanner pauses itself when it's done
+    if (status == FlightPlanner::Running)
+        return;
+
+    _runningPlanners--;
+    if (_runningPlanners <= 0)
+        _loop.quit();
+}
+
+//private slot
+void ParameterSweep::handleBudgetTimeout()
+{
+    qDebug() << "Time budget of" << _timeBudget << "ms exhausted, stopping the sweep's planners";
+
+    //The loop quits once the last of them announces that it's paused
+    foreach(HierarchicalPlanner * planner, _planners)
+    {
+        if (planner->status() == FlightPlanner::Running)
+            planner->pausePlanning();
+    }
+}
+
+//private
+void ParameterSweep::_clearPlanners()
+{
+    qDeleteAll(_planners);
+    _planners.clear();
+    _runningPlanners = 0;
+}
@@ -0,0 +1,152 @@
+#ifndef PARAMETERSWEEP_H
+#define PARAMETERSWEEP_H
+
+#include <QObject>
+#include <QEventLoop>
+#include <QList>
+#include <QSharedPointer>
+#include <QString>
+#include <QTimer>
+#include <QVector>
+
+#include "FlightPlanner.h"
+#include "PlanningProblem.h"
+#include "UAVParameters.h"
+
+class HierarchicalPlanner;
+
+/**
+ * @brief The ParameterSweep class plans one problem for every combination of a grid of airspeeds and minimum
+ * turning radii, to show how the flight changes with the aircraft.
+ *
+ * Each combination gets its own PlanningProblem and HierarchicalPlanner, and all of them run at once on their
+ * worker threads. What doesn't depend on the UAV parameters is only worked out once: the problem's tasks are
+ * shared, so their scoring data (coverage bins and the like) is prepared before any planner starts, and the
+ * planners share one obstacle map, roadmap and visibility graph (see
+ * HierarchicalPlanner::shareObstacleStructures()).
+ *
+ * An empty list of airspeeds or turning radii means the problem's own. The waypoint interval is always the
+ * problem's.
+ */
+class ParameterSweep : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ParameterSweep(QSharedPointer<PlanningProblem> problem = QSharedPointer<PlanningProblem>(),
+                            QObject *parent = 0);
+    virtual ~ParameterSweep();
+
+    QSharedPointer<PlanningProblem> problem() const;
+    void setProblem(QSharedPointer<PlanningProblem> problem);
+
+    const QList<qreal>& airspeeds() const;
+    void setAirspeeds(const QList<qreal>& airspeeds);
+
+    const QList<qreal>& turningRadii() const;
+    void setTurningRadii(const QList<qreal>& radii);
+
+    /**
+     * @brief combinations returns the UAV parameters plan() tries, airspeed-major. plan()'s results are indexed
+     * the same way.
+     * @return
+     */
+    QList<UAVParameters> combinations() const;
+
+    /**
+     * @brief timeBudget is how long in milliseconds plan() lets the planners work before pausing them and
+     * taking what they have. Zero (the default) means no limit.
+     * @return
+     */
+    qint64 timeBudget() const;
+    void setTimeBudget(qint64 msecs);
+
+    /**
+     * @brief workerCount returns the number of threads shared out between the combinations' planners.
+     * 0 (the default) means "use QThread::idealThreadCount()". Every planner gets at least one.
+     * @return
+     */
+    int workerCount() const;
+    void setWorkerCount(int count);
+
+    quint64 randomSeed() const;
+    void setRandomSeed(quint64 seed);
+
+    /**
+     * @brief tuning is handed to every planner (see FlightPlanner::tuning())
+     * @return
+     */
+    const PlannerTuning& tuning() const;
+    void setTuning(const PlannerTuning& tuning);
+
+    /**
+     * @brief scheduleTimeBudget and scheduleImprovementTimeBudget are handed to every planner. See
+     * HierarchicalPlanner's.
+     * @return
+     */
+    qint64 scheduleTimeBudget() const;
+    void setScheduleTimeBudget(qint64 msecs);
+    qint64 scheduleImprovementTimeBudget() const;
+    void setScheduleImprovementTimeBudget(qint64 msecs);
+
+    /**
+     * @brief plan plans every combination. Returns false with an explanation in errorString if there's no
+     * problem or starting position, or a planner wouldn't start.
+     * @param errorString
+     * @return
+     */
+    bool plan(QString * errorString = 0);
+
+    /**
+     * @brief flight returns a combination's flight from the last plan()
+     * @param combination
+     * @return
+     */
+    QList<Position> flight(int combination) const;
+    Fitness fitness(int combination) const;
+    PlanningStatistics statistics(int combination) const;
+
+    /**
+     * @brief flightTime returns how many seconds a combination's flight from the last plan() takes to fly
+     * @param combination
+     * @return
+     */
+    qreal flightTime(int combination) const;
+
+    /**
+     * @brief elapsed returns how many milliseconds the last plan() took
+     * @return
+     */
+    qint64 elapsed() const;
+
+private slots:
+    void handlePlannerStatusChanged(FlightPlanner::PlanningStatus status);
+    void handleBudgetTimeout();
+
+private:
+    void _clearPlanners();
+
+    QSharedPointer<PlanningProblem> _problem;
+    QList<qreal> _airspeeds;
+    QList<qreal> _turningRadii;
+    qint64 _timeBudget;
+    int _workerCount;
+    quint64 _randomSeed;
+    PlannerTuning _tuning;
+    qint64 _scheduleTimeBudget;
+    qint64 _scheduleImprovementTimeBudget;
+
+    //Results of the last plan(), by combination
+    QList<UAVParameters> _combinations;
+    QVector<QList<Position> > _flights;
+    QVector<Fitness> _fitnesses;
+    QVector<PlanningStatistics> _statistics;
+    qint64 _elapsed;
+
+    //Only while plan() runs
+    QList<HierarchicalPlanner *> _planners;
+    int _runningPlanners;
+    QEventLoop _loop;
+    QTimer _budgetTimer;
+};
+
+#endif // PARAMETERSWEEP_H
@@ -0,0 +1,184 @@
+#include "PlanCache.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtDebug>
+
+//"FPPC"
+const quint32 PLAN_CACHE_MAGIC = 0x46505043;
+const quint16 PLAN_CACHE_VERSION = 1;
+
+const char * const PLAN_CACHE_SUFFIX = ".plan";
+
+//Must match PlanningJob's, so that problems hash the same whichever of us serialized them
+const int PLAN_CACHE_STREAM_VERSION = QDataStream::Qt_4_8;
+
+PlanCache::Entry::Entry() :
+    fitness(0.0)
+{
+}
+
+PlanCache::PlanCache()
+{
+}
+
+PlanCache::PlanCache(const QString &directory)
+{
+    this->setDirectory(directory);
+}
+
+QString PlanCache::directory() const
+{
+    return _directory;
+}
+
+void PlanCache::setDirectory(const QString &directory)
+{
+    _directory = directory;
+    if (!_directory.isEmpty() && !QDir().mkpath(_directory))
+        qWarning() << "Failed to make plan cache directory" << _directory;
+}
+
+bool PlanCache::isEnabled() const
+{
+    return !_directory.isEmpty();
+}
+
+//static
+QByteArray PlanCache::configuration(const QString &planner, quint64 seed, qint64 timeBudget,
+                                    qint64 scheduleBudget, qint64 improvementBudget, bool sweepCoverage,
+                                    const PlannerTuning &tuning)
+{
+    QByteArray toRet;
+    QDataStream stream(&toRet, QIODevice::WriteOnly);
+    stream.setVersion(PLAN_CACHE_STREAM_VERSION);
+    stream << planner << seed << timeBudget << scheduleBudget << improvementBudget << sweepCoverage;
+    if (!tuning.isDefault())
+        stream << tuning;
+    return toRet;
+}
+
+//static
+QByteArray PlanCache::key(const QByteArray &problemBytes, const QByteArray &configuration)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(problemBytes);
+    hash.addData(configuration);
+    return hash.result().toHex();
+}
+
+//static
+QByteArray PlanCache::key(const PlanningProblem &problem, const QByteArray &configuration)
+{
+    return PlanCache::key(PlanCache::problemBytes(problem), configuration);
+}
+
+//static
+QByteArray PlanCache::problemBytes(const PlanningProblem &problem)
+{
+    QByteArray toRet;
+    QDataStream stream(&toRet, QIODevice::WriteOnly);
+    stream.setVersion(PLAN_CACHE_STREAM_VERSION);
+    problem.serialize(stream);
+    return toRet;
+}
+
+bool PlanCache::lookup(const QByteArray &key, Entry *entry) const
+{
+    if (!this->isEnabled())
+        return false;
+    return _read(_filePath(key), entry);
+}
+
+bool PlanCache::store(const QByteArray &key, const Entry &entry, QString *errorString)
+{
+    if (!this->isEnabled())
+    {
+        if (errorString)
+            *errorString = "The plan cache has no directory";
+        return false;
+    }
+
+    QByteArray bytes;
+    QDataStream stream(&bytes, QIODevice::WriteOnly);
+    stream.setVersion(PLAN_CACHE_STREAM_VERSION);
+    stream << PLAN_CACHE_MAGIC << PLAN_CACHE_VERSION;
+    stream << entry.flight << entry.fitness << entry.plannerResults;
+
+    //Renamed into place once it's all there, so other processes sharing the directory never see part of it
+    const QString filePath = _filePath(key);
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        if (errorString)
+            *errorString = "Failed to open " + filePath + " for writing: " + file.errorString();
+        return false;
+    }
+    file.write(bytes);
+    if (!file.commit())
+    {
+        if (errorString)
+            *errorString = "Failed to write " + filePath + ": " + file.errorString();
+        return false;
+    }
+    return true;
+}
+
+QList<QByteArray> PlanCache::recentPlannerResults(int limit) const
+{
+    QList<QByteArray> toRet;
+    if (!this->isEnabled() || limit <= 0)
+        return toRet;
+
+    const QStringList filters(QString("*") + PLAN_CACHE_SUFFIX);
+    const QFileInfoList files = QDir(_directory).entryInfoList(filters, QDir::Files, QDir::Time);
+    foreach(const QFileInfo& info, files)
+    {
+        Entry entry;
+        if (!_read(info.filePath(), &entry) || entry.plannerResults.isEmpty())
+            continue;
+        toRet.append(entry.plannerResults);
+        if (toRet.size() >= limit)
+            break;
+    }
+    return toRet;
+}
+
+//private
+QString PlanCache::_filePath(const QByteArray &key) const
+{
+    return QDir(_directory).filePath(QString::fromLatin1(key) + PLAN_CACHE_SUFFIX);
+}
+
+//private static
+bool PlanCache::_read(const QString &filePath, Entry *entry)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream(&file);
+    stream.setVersion(PLAN_CACHE_STREAM_VERSION);
+    quint32 magic;
+    quint16 version;
+    stream >> magic >> version;
+    if (stream.status() != QDataStream::Ok || magic != PLAN_CACHE_MAGIC || version != PLAN_CACHE_VERSION)
+    {
+        qWarning() << "Ignoring plan cache entry" << filePath << "in an unknown format";
+        return false;
+    }
+
+    Entry toRead;
+    stream >> toRead.flight >> toRead.fitness >> toRead.plannerResults;
+    if (stream.status() != QDataStream::Ok)
+    {
+        qWarning() << "Ignoring damaged plan cache entry" << filePath;
+        return false;
+    }
+    *entry = toRead;
+    return true;
+}
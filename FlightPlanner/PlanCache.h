@@ -0,0 +1,115 @@
+#ifndef PLANCACHE_H
+#define PLANCACHE_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+#include "PlannerTuning.h"
+#include "PlanningProblem.h"
+#include "Position.h"
+
+/**
+ * @brief The PlanCache class keeps finished plans in a directory, one file per plan, named after a hash of the
+ * serialized problem and the planner configuration that planned it. Asking for the same plan again, from the
+ * command line, the planning service or the GUI, returns the flight without planning anything. The directory may
+ * be shared between machines: entries are written to a temporary file and renamed into place, so readers never
+ * see half an entry.
+ *
+ * Each entry also keeps the planner's intermediate results (see HierarchicalPlanner::saveResults()). Those are
+ * keyed by the areas and obstacles they were planned for rather than by the whole problem, so when a request
+ * misses because only some of its inputs changed, recentPlannerResults() still spares the planner whatever the
+ * changes didn't touch.
+ */
+class PlanCache
+{
+public:
+    struct Entry
+    {
+        Entry();
+
+        QList<Position> flight;
+        qreal fitness;
+
+        //HierarchicalPlanner::saveResults() after planning, empty for other planners
+        QByteArray plannerResults;
+    };
+
+    /**
+     * @brief PlanCache makes a cache that keeps nothing until it's given a directory
+     */
+    PlanCache();
+    explicit PlanCache(const QString& directory);
+
+    QString directory() const;
+    void setDirectory(const QString& directory);
+
+    bool isEnabled() const;
+
+    /**
+     * @brief configuration encodes the planner settings that change what gets planned. The thread count isn't
+     * one of them: seeded planners give the same flight however many threads they have.
+     * @param planner the planner's name, as the command line takes it
+     * @param seed
+     * @param timeBudget milliseconds, 0 for no limit
+     * @param scheduleBudget milliseconds, 0 for no limit
+     * @param improvementBudget milliseconds
+     * @param sweepCoverage
+     * @param tuning only encoded when it isn't the default, so plans cached before tuning existed keep their keys
+     * @return
+     */
+    static QByteArray configuration(const QString& planner, quint64 seed, qint64 timeBudget,
+                                    qint64 scheduleBudget, qint64 improvementBudget, bool sweepCoverage,
+                                    const PlannerTuning& tuning = PlannerTuning());
+
+    /**
+     * @brief key returns the hex SHA-1 of the serialized problem and the configuration
+     * @param problemBytes the problem as PlanningJob::serializeProblem() or problemBytes() serialized it
+     * @param configuration
+     * @return
+     */
+    static QByteArray key(const QByteArray& problemBytes, const QByteArray& configuration);
+    static QByteArray key(const PlanningProblem& problem, const QByteArray& configuration);
+
+    /**
+     * @brief problemBytes serializes problem the way the planning service's jobs carry it, so the GUI and the
+     * command line hash the same problem to the same key
+     * @param problem
+     * @return
+     */
+    static QByteArray problemBytes(const PlanningProblem& problem);
+
+    /**
+     * @brief lookup returns true and fills entry if a plan is stored under key
+     * @param key
+     * @param entry
+     * @return
+     */
+    bool lookup(const QByteArray& key, Entry * entry) const;
+
+    /**
+     * @brief store keeps entry under key, replacing whatever was there. Returns false on failure with an
+     * explanation in errorString.
+     * @param key
+     * @param entry
+     * @param errorString
+     * @return
+     */
+    bool store(const QByteArray& key, const Entry& entry, QString * errorString = 0);
+
+    /**
+     * @brief recentPlannerResults returns the planner results of up to limit of the most recently stored plans,
+     * newest first
+     * @param limit
+     * @return
+     */
+    QList<QByteArray> recentPlannerResults(int limit) const;
+
+private:
+    QString _filePath(const QByteArray& key) const;
+    static bool _read(const QString& filePath, Entry * entry);
+
+    QString _directory;
+};
+
+#endif // PLANCACHE_H
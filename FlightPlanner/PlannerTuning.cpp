@@ -0,0 +1,257 @@
+#include "PlannerTuning.h"
+
+const qreal DEFAULT_SCHEDULE_TIMESLICE = 15.0;
+const int DEFAULT_GREED_DEPTH = 7;
+const int DEFAULT_SUBFLIGHT_BRANCHES_PER_SIDE = 4;
+const int DEFAULT_RRT_BRANCHES_PER_SIDE = 3;
+const int DEFAULT_RRT_MAX_SAMPLES = 50000;
+const int DEFAULT_RRTSTAR_MAX_ITERATIONS = 50000;
+const qreal DEFAULT_LATTICE_GRANULARITY = 300.0;
+
+//Below a second the schedule search has more states than it could ever expand
+const qreal MIN_SCHEDULE_TIMESLICE = 1.0;
+
+//The greedy planner's tree has 3^depth leaves, so much deeper than this and it never finishes one
+const int MAX_GREED_DEPTH = 10;
+
+//Finer than this and the turns are smaller than the lattices' heading bins
+const int MAX_BRANCHES_PER_SIDE = 16;
+
+//Finer than this and the A* lattice cells are smaller than the obstacle raster's
+const qreal MIN_LATTICE_GRANULARITY = 10.0;
+
+PlannerTuning::PlannerTuning() :
+    _scheduleTimeslice(DEFAULT_SCHEDULE_TIMESLICE), _greedDepth(DEFAULT_GREED_DEPTH),
+    _subFlightBranchesPerSide(DEFAULT_SUBFLIGHT_BRANCHES_PER_SIDE), _rrtBranchesPerSide(DEFAULT_RRT_BRANCHES_PER_SIDE),
+    _rrtMaxSamples(DEFAULT_RRT_MAX_SAMPLES), _rrtStarMaxIterations(DEFAULT_RRTSTAR_MAX_ITERATIONS),
+    _latticeGranularity(DEFAULT_LATTICE_GRANULARITY)
+{
+}
+
+qreal PlannerTuning::scheduleTimeslice() const
+{
+    return _scheduleTimeslice;
+}
+
+void PlannerTuning::setScheduleTimeslice(qreal seconds)
+{
+    _scheduleTimeslice = qMax<qreal>(MIN_SCHEDULE_TIMESLICE, seconds);
+}
+
+int PlannerTuning::greedDepth() const
+{
+    return _greedDepth;
+}
+
+void PlannerTuning::setGreedDepth(int depth)
+{
+    _greedDepth = qBound<int>(1, depth, MAX_GREED_DEPTH);
+}
+
+int PlannerTuning::subFlightBranchesPerSide() const
+{
+    return _subFlightBranchesPerSide;
+}
+
+void PlannerTuning::setSubFlightBranchesPerSide(int branches)
+{
+    _subFlightBranchesPerSide = qBound<int>(1, branches, MAX_BRANCHES_PER_SIDE);
+}
+
+int PlannerTuning::rrtBranchesPerSide() const
+{
+    return _rrtBranchesPerSide;
+}
+
+void PlannerTuning::setRRTBranchesPerSide(int branches)
+{
+    _rrtBranchesPerSide = qBound<int>(1, branches, MAX_BRANCHES_PER_SIDE);
+}
+
+int PlannerTuning::rrtMaxSamples() const
+{
+    return _rrtMaxSamples;
+}
+
+void PlannerTuning::setRRTMaxSamples(int samples)
+{
+    _rrtMaxSamples = qMax<int>(1, samples);
+}
+
+int PlannerTuning::rrtStarMaxIterations() const
+{
+    return _rrtStarMaxIterations;
+}
+
+void PlannerTuning::setRRTStarMaxIterations(int iterations)
+{
+    _rrtStarMaxIterations = qMax<int>(1, iterations);
+}
+
+qreal PlannerTuning::latticeGranularity() const
+{
+    return _latticeGranularity;
+}
+
+void PlannerTuning::setLatticeGranularity(qreal meters)
+{
+    _latticeGranularity = qMax<qreal>(MIN_LATTICE_GRANULARITY, meters);
+}
+
+bool PlannerTuning::isDefault() const
+{
+    return *this == PlannerTuning();
+}
+
+QString PlannerTuning::toString() const
+{
+    QStringList pairs;
+    pairs << QString("timeslice=%1").arg(_scheduleTimeslice);
+    pairs << QString("greed-depth=%1").arg(_greedDepth);
+    pairs << QString("subflight-branches=%1").arg(_subFlightBranchesPerSide);
+    pairs << QString("rrt-branches=%1").arg(_rrtBranchesPerSide);
+    pairs << QString("rrt-samples=%1").arg(_rrtMaxSamples);
+    pairs << QString("rrtstar-iterations=%1").arg(_rrtStarMaxIterations);
+    pairs << QString("lattice-granularity=%1").arg(_latticeGranularity);
+    return pairs.join(",");
+}
+
+//static
+bool PlannerTuning::parse(const QString &text, PlannerTuning *tuning, QString *errorString)
+{
+    PlannerTuning parsed = *tuning;
+    foreach(const QString& pair, text.split(',', QString::SkipEmptyParts))
+    {
+        const int equals = pair.indexOf('=');
+        if (equals < 0)
+        {
+            if (errorString)
+                *errorString = QString("Expected name=value in tuning, not %1").arg(pair.trimmed());
+            return false;
+        }
+        const QString name = pair.left(equals).trimmed();
+        const QString value = pair.mid(equals + 1).trimmed();
+
+        //Out-of-range values are errors here rather than being clamped, so typos don't go unnoticed
+        bool ok = false;
+        if (name == "timeslice")
+        {
+            const qreal seconds = value.toDouble(&ok);
+            ok = ok && seconds >= MIN_SCHEDULE_TIMESLICE;
+            parsed.setScheduleTimeslice(seconds);
+        }
+        else if (name == "greed-depth")
+        {
+            const int depth = value.toInt(&ok);
+            ok = ok && depth >= 1 && depth <= MAX_GREED_DEPTH;
+            parsed.setGreedDepth(depth);
+        }
+        else if (name == "subflight-branches" || name == "rrt-branches")
+        {
+            const int branches = value.toInt(&ok);
+            ok = ok && branches >= 1 && branches <= MAX_BRANCHES_PER_SIDE;
+            if (name == "subflight-branches")
+                parsed.setSubFlightBranchesPerSide(branches);
+            else
+                parsed.setRRTBranchesPerSide(branches);
+        }
+        else if (name == "rrt-samples" || name == "rrtstar-iterations")
+        {
+            const int samples = value.toInt(&ok);
+            ok = ok && samples >= 1;
+            if (name == "rrt-samples")
+                parsed.setRRTMaxSamples(samples);
+            else
+                parsed.setRRTStarMaxIterations(samples);
+        }
+        else if (name == "lattice-granularity")
+        {
+            const qreal meters = value.toDouble(&ok);
+            ok = ok && meters >= MIN_LATTICE_GRANULARITY;
+            parsed.setLatticeGranularity(meters);
+        }
+        else
+        {
+            if (errorString)
+                *errorString = QString("Unknown tuning parameter %1 (expected one of %2)")
+                        .arg(name, PlannerTuning::parameterNames().join(", "));
+            return false;
+        }
+
+        if (!ok)
+        {
+            if (errorString)
+                *errorString = QString("Invalid tuning %1").arg(pair.trimmed());
+            return false;
+        }
+    }
+
+    *tuning = parsed;
+    return true;
+}
+
+//static
+QStringList PlannerTuning::parameterNames()
+{
+    QStringList toRet;
+    toRet << "timeslice" << "greed-depth" << "subflight-branches" << "rrt-branches" << "rrt-samples"
+          << "rrtstar-iterations" << "lattice-granularity";
+    return toRet;
+}
+
+bool PlannerTuning::operator==(const PlannerTuning &other) const
+{
+    return _scheduleTimeslice == other._scheduleTimeslice
+            && _greedDepth == other._greedDepth
+            && _subFlightBranchesPerSide == other._subFlightBranchesPerSide
+            && _rrtBranchesPerSide == other._rrtBranchesPerSide
+            && _rrtMaxSamples == other._rrtMaxSamples
+            && _rrtStarMaxIterations == other._rrtStarMaxIterations
+            && _latticeGranularity == other._latticeGranularity;
+}
+
+bool PlannerTuning::operator!=(const PlannerTuning &other) const
+{
+    return !(*this == other);
+}
+
+//non-member
+QDataStream& operator<<(QDataStream& stream, const PlannerTuning& tuning)
+{
+    stream << tuning.scheduleTimeslice();
+    stream << (qint32) tuning.greedDepth();
+    stream << (qint32) tuning.subFlightBranchesPerSide();
+    stream << (qint32) tuning.rrtBranchesPerSide();
+    stream << (qint32) tuning.rrtMaxSamples();
+    stream << (qint32) tuning.rrtStarMaxIterations();
+    stream << tuning.latticeGranularity();
+
+    return stream;
+}
+
+//non-member
+QDataStream& operator>>(QDataStream& stream, PlannerTuning& tuning)
+{
+    qreal scheduleTimeslice, latticeGranularity;
+    qint32 greedDepth, subFlightBranchesPerSide, rrtBranchesPerSide, rrtMaxSamples, rrtStarMaxIterations;
+
+    stream >> scheduleTimeslice;
+    stream >> greedDepth;
+    stream >> subFlightBranchesPerSide;
+    stream >> rrtBranchesPerSide;
+    stream >> rrtMaxSamples;
+    stream >> rrtStarMaxIterations;
+    stream >> latticeGranularity;
+
+    PlannerTuning a;
+    a.setScheduleTimeslice(scheduleTimeslice);
+    a.setGreedDepth(greedDepth);
+    a.setSubFlightBranchesPerSide(subFlightBranchesPerSide);
+    a.setRRTBranchesPerSide(rrtBranchesPerSide);
+    a.setRRTMaxSamples(rrtMaxSamples);
+    a.setRRTStarMaxIterations(rrtStarMaxIterations);
+    a.setLatticeGranularity(latticeGranularity);
+    tuning = a;
+
+    return stream;
+}
@@ -0,0 +1,125 @@
+#ifndef PLANNERTUNING_H
+#define PLANNERTUNING_H
+
+#include <QDataStream>
+#include <QString>
+#include <QStringList>
+
+/**
+ * @brief The PlannerTuning class holds the search parameters that trade planning time against flight quality.
+ * They used to be compiled in, and the defaults are the values they were compiled in with. A FlightPlanner
+ * hands its tuning() to the searches it runs: HierarchicalPlanner to its schedule search, sub-flight searches
+ * and transition planners, GreedyFlightPlanner to its lookahead.
+ *
+ * Tunings can be written as text, "name=value,name=value". Parameters left out keep their defaults. That's how
+ * the command line takes them, and how a PlannerTuningProfile stores the tunings that auto-tuning picked.
+ */
+class PlannerTuning
+{
+public:
+    PlannerTuning();
+
+    /**
+     * @brief scheduleTimeslice returns how many seconds of a task each step of HierarchicalPlanner's schedule
+     * search flies ("timeslice"). Shorter slices interleave tasks more finely but multiply the states searched.
+     * Defaults to 15.
+     * @return
+     */
+    qreal scheduleTimeslice() const;
+    void setScheduleTimeslice(qreal seconds);
+
+    /**
+     * @brief greedDepth returns how many waypoints GreedyFlightPlanner looks ahead ("greed-depth"). Each one
+     * more triples the tree it scores. Defaults to 7.
+     * @return
+     */
+    int greedDepth() const;
+    void setGreedDepth(int depth);
+
+    /**
+     * @brief subFlightBranchesPerSide returns how many equal steps sub-flight searches split the UAV's maximum
+     * turn into each way at every waypoint ("subflight-branches"). Defaults to 4.
+     * @return
+     */
+    int subFlightBranchesPerSide() const;
+    void setSubFlightBranchesPerSide(int branches);
+
+    /**
+     * @brief rrtBranchesPerSide is the same for the RRT and RRT-Connect transition planners ("rrt-branches").
+     * Defaults to 3.
+     * @return
+     */
+    int rrtBranchesPerSide() const;
+    void setRRTBranchesPerSide(int branches);
+
+    /**
+     * @brief rrtMaxSamples returns how many random samples the RRT and RRT-Connect transition planners draw
+     * before giving up ("rrt-samples"). Defaults to 50000.
+     * @return
+     */
+    int rrtMaxSamples() const;
+    void setRRTMaxSamples(int samples);
+
+    /**
+     * @brief rrtStarMaxIterations returns how many samples the RRT* transition planner draws at most
+     * ("rrtstar-iterations"). Defaults to 50000.
+     * @return
+     */
+    int rrtStarMaxIterations() const;
+    void setRRTStarMaxIterations(int iterations);
+
+    /**
+     * @brief latticeGranularity returns how many meters apart the cells of the A* transition planner's lattice
+     * are ("lattice-granularity"). Finer lattices squeeze between closer obstacles but have more cells to search.
+     * Defaults to 300.
+     * @return
+     */
+    qreal latticeGranularity() const;
+    void setLatticeGranularity(qreal meters);
+
+    /**
+     * @brief isDefault returns true if every parameter has its default value
+     * @return
+     */
+    bool isDefault() const;
+
+    /**
+     * @brief toString returns every parameter as "name=value", separated by commas
+     * @return
+     */
+    QString toString() const;
+
+    /**
+     * @brief parse sets the parameters named in text, leaving the others alone. Returns false, with an
+     * explanation in errorString and tuning unchanged, if text names a parameter we don't have or gives one a
+     * value it can't take.
+     * @param text "name=value" pairs separated by commas
+     * @param tuning
+     * @param errorString
+     * @return
+     */
+    static bool parse(const QString& text, PlannerTuning * tuning, QString * errorString = 0);
+
+    /**
+     * @brief parameterNames returns the names toString() and parse() use, in the order toString() writes them
+     * @return
+     */
+    static QStringList parameterNames();
+
+    bool operator==(const PlannerTuning& other) const;
+    bool operator!=(const PlannerTuning& other) const;
+
+private:
+    qreal _scheduleTimeslice;
+    int _greedDepth;
+    int _subFlightBranchesPerSide;
+    int _rrtBranchesPerSide;
+    int _rrtMaxSamples;
+    int _rrtStarMaxIterations;
+    qreal _latticeGranularity;
+};
+
+QDataStream& operator<<(QDataStream& stream, const PlannerTuning& tuning);
+QDataStream& operator>>(QDataStream& stream, PlannerTuning& tuning);
+
+#endif // PLANNERTUNING_H
@@ -0,0 +1,170 @@
+#include "PlannerTuningProfile.h"
+
+#include <QFile>
+#include <QRegExp>
+#include <QTextStream>
+
+#include "FlightTaskArea.h"
+#include "FlightTasks/NoFlyFlightTask.h"
+
+//The most task areas a "small" and a "medium" mission have
+const int MAX_SMALL_TASK_AREAS = 6;
+const int MAX_MEDIUM_TASK_AREAS = 15;
+
+//Fewer no-fly zones than this and the transitions are straight enough that they don't count as obstructed
+const int MIN_OBSTRUCTING_NO_FLY_ZONES = 3;
+
+PlannerTuningProfile::PlannerTuningProfile()
+{
+}
+
+//static
+QString PlannerTuningProfile::missionClass(const PlanningProblem &problem)
+{
+    int taskAreas = 0;
+    int noFlyZones = 0;
+    foreach(const QSharedPointer<FlightTaskArea>& area, problem.areas())
+    {
+        bool noFly = false;
+        foreach(const QSharedPointer<FlightTask>& task, area->tasks())
+        {
+            if (qobject_cast<const NoFlyFlightTask *>(task.data()))
+            {
+                noFly = true;
+                break;
+            }
+        }
+
+        if (noFly)
+            noFlyZones++;
+        else
+            taskAreas++;
+    }
+
+    QString toRet;
+    if (taskAreas <= MAX_SMALL_TASK_AREAS)
+        toRet = "small";
+    else if (taskAreas <= MAX_MEDIUM_TASK_AREAS)
+        toRet = "medium";
+    else
+        toRet = "large";
+
+    if (noFlyZones >= qMax<int>(MIN_OBSTRUCTING_NO_FLY_ZONES, taskAreas / 2))
+        toRet += "-obstructed";
+    else
+        toRet += "-open";
+    return toRet;
+}
+
+//static
+QStringList PlannerTuningProfile::missionClasses()
+{
+    QStringList toRet;
+    foreach(const QString& size, QStringList() << "small" << "medium" << "large")
+        toRet << size + "-open" << size + "-obstructed";
+    return toRet;
+}
+
+bool PlannerTuningProfile::contains(const QString &missionClass) const
+{
+    return _tunings.contains(missionClass);
+}
+
+PlannerTuning PlannerTuningProfile::tuning(const QString &missionClass) const
+{
+    return _tunings.value(missionClass);
+}
+
+void PlannerTuningProfile::setTuning(const QString &missionClass, const PlannerTuning &tuning)
+{
+    _tunings.insert(missionClass, tuning);
+}
+
+PlannerTuning PlannerTuningProfile::tuningFor(const PlanningProblem &problem) const
+{
+    return this->tuning(PlannerTuningProfile::missionClass(problem));
+}
+
+QString PlannerTuningProfile::comment() const
+{
+    return _comment;
+}
+
+void PlannerTuningProfile::setComment(const QString &comment)
+{
+    _comment = comment;
+}
+
+bool PlannerTuningProfile::load(const QString &filePath, QString *errorString)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        if (errorString)
+            *errorString = QString("Failed to open tuning profile %1: %2").arg(filePath, file.errorString());
+        return false;
+    }
+
+    QMap<QString, PlannerTuning> tunings;
+    QStringList comment;
+    QTextStream in(&file);
+    int lineNumber = 0;
+    while (!in.atEnd())
+    {
+        const QString line = in.readLine().trimmed();
+        lineNumber++;
+        if (line.isEmpty())
+            continue;
+        if (line.startsWith('#'))
+        {
+            comment << line.mid(1).trimmed();
+            continue;
+        }
+
+        const QStringList fields = line.split(QRegExp("\\s+"));
+        PlannerTuning tuning;
+        QString error;
+        if (fields.size() != 2 || !PlannerTuning::parse(fields.at(1), &tuning, &error))
+        {
+            if (errorString)
+                *errorString = QString("Bad line %1 in tuning profile %2: %3").arg(lineNumber).arg(filePath)
+                        .arg(error.isEmpty() ? "expected a mission class and a tuning" : error);
+            return false;
+        }
+        tunings.insert(fields.at(0), tuning);
+    }
+
+    _tunings = tunings;
+    _comment = comment.join("\n");
+    return true;
+}
+
+bool PlannerTuningProfile::save(const QString &filePath, QString *errorString) const
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+    {
+        if (errorString)
+            *errorString = QString("Failed to open tuning profile %1: %2").arg(filePath, file.errorString());
+        return false;
+    }
+
+    QTextStream out(&file);
+    if (!_comment.isEmpty())
+    {
+        foreach(const QString& line, _comment.split('\n'))
+            out << "# " << line << "\n";
+        out << "\n";
+    }
+    foreach(const QString& missionClass, _tunings.keys())
+        out << missionClass << " " << _tunings.value(missionClass).toString() << "\n";
+
+    out.flush();
+    if (out.status() != QTextStream::Ok)
+    {
+        if (errorString)
+            *errorString = QString("Failed to write tuning profile %1: %2").arg(filePath, file.errorString());
+        return false;
+    }
+    return true;
+}
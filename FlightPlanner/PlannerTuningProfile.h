@@ -0,0 +1,85 @@
+#ifndef PLANNERTUNINGPROFILE_H
+#define PLANNERTUNINGPROFILE_H
+
+#include <QMap>
+#include <QString>
+#include <QStringList>
+
+#include "PlannerTuning.h"
+#include "PlanningProblem.h"
+
+/**
+ * @brief The PlannerTuningProfile class maps classes of mission to the PlannerTuning to plan them with. The
+ * benchmarks' auto-tuning writes one by planning the mission corpus with a range of tunings and keeping the best
+ * that fits a latency budget for each class, and the command line and the GUI read it to tune their planners
+ * for whatever problem they're given.
+ *
+ * Missions are classed by how many task areas they have and how many no-fly zones they have to get around,
+ * which between them decide most of how long the schedule and transitions take (see missionClass()). Classes the
+ * profile says nothing about are planned with the default tuning.
+ *
+ * Profiles are text files with one "class tuning" line per class (see PlannerTuning::toString()). Blank lines
+ * and lines starting with # are ignored.
+ */
+class PlannerTuningProfile
+{
+public:
+    PlannerTuningProfile();
+
+    /**
+     * @brief missionClass returns the class of problem: "small", "medium" or "large" for up to 6, up to 15 and
+     * more task areas, then "-open" or "-obstructed" for whether it has fewer no-fly zones than half its task
+     * areas (and at least three)
+     * @param problem
+     * @return
+     */
+    static QString missionClass(const PlanningProblem& problem);
+
+    /**
+     * @brief missionClasses returns every class missionClass() can return
+     * @return
+     */
+    static QStringList missionClasses();
+
+    bool contains(const QString& missionClass) const;
+    PlannerTuning tuning(const QString& missionClass) const;
+    void setTuning(const QString& missionClass, const PlannerTuning& tuning);
+
+    /**
+     * @brief tuningFor returns the tuning for problem's class, or the default if the profile doesn't have one
+     * @param problem
+     * @return
+     */
+    PlannerTuning tuningFor(const PlanningProblem& problem) const;
+
+    /**
+     * @brief comment is written at the top of the file, a line per line. Auto-tuning records its latency
+     * budget and what each class's tuning scored there.
+     * @return
+     */
+    QString comment() const;
+    void setComment(const QString& comment);
+
+    /**
+     * @brief load replaces the profile with the one in filePath. Returns false, with an explanation in
+     * errorString and the profile unchanged, on failure.
+     * @param filePath
+     * @param errorString
+     * @return
+     */
+    bool load(const QString& filePath, QString * errorString = 0);
+
+    /**
+     * @brief save writes the profile to filePath. Returns false, with an explanation in errorString, on failure.
+     * @param filePath
+     * @param errorString
+     * @return
+     */
+    bool save(const QString& filePath, QString * errorString = 0) const;
+
+private:
+    QMap<QString, PlannerTuning> _tunings;
+    QString _comment;
+};
+
+#endif // PLANNERTUNINGPROFILE_H
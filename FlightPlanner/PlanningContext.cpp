@@ -0,0 +1,75 @@
+#include "PlanningContext.h"
+
+PlanningContext::PlanningContext() :
+    _cancelled(0), _nodesCharged(0), _timeBudget(0), _nodeBudget(0)
+{
+    _clock.invalidate();
+}
+
+void PlanningContext::start()
+{
+    _cancelled = 0;
+    _nodesCharged = 0;
+    _clock.start();
+}
+
+void PlanningContext::cancel()
+{
+    _cancelled = 1;
+}
+
+bool PlanningContext::cancelled() const
+{
+    return (_cancelled != 0);
+}
+
+qint64 PlanningContext::timeBudget() const
+{
+    return _timeBudget;
+}
+
+void PlanningContext::setTimeBudget(qint64 msecs)
+{
+    _timeBudget = qMax<qint64>(0, msecs);
+}
+
+qint64 PlanningContext::elapsed() const
+{
+    if (!_clock.isValid())
+        return 0;
+    return _clock.elapsed();
+}
+
+int PlanningContext::nodeBudget() const
+{
+    return _nodeBudget;
+}
+
+void PlanningContext::setNodeBudget(int nodes)
+{
+    _nodeBudget = qMax<int>(0, nodes);
+}
+
+int PlanningContext::nodesCharged() const
+{
+    return _nodesCharged;
+}
+
+bool PlanningContext::chargeNodes(int count) const
+{
+    //Nobody reads the count unless there's a budget, so don't make every thread fight over it for nothing
+    if (_nodeBudget > 0)
+        _nodesCharged.fetchAndAddRelaxed(count);
+    return !this->shouldStop();
+}
+
+bool PlanningContext::shouldStop() const
+{
+    if (_cancelled != 0)
+        return true;
+    else if (_nodeBudget > 0 && _nodesCharged >= _nodeBudget)
+        return true;
+    else if (_timeBudget > 0 && _clock.isValid() && _clock.elapsed() >= _timeBudget)
+        return true;
+    return false;
+}
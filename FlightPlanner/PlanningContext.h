@@ -0,0 +1,85 @@
+#ifndef PLANNINGCONTEXT_H
+#define PLANNINGCONTEXT_H
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+
+/**
+ * @brief The PlanningContext class tells long-running searches when to give up: when someone cancels the run,
+ * when the run's time budget is spent, or when the searches have charged the run's node budget (samples drawn,
+ * states expanded...) against it.
+ *
+ * One context is shared by every search of a planning run, on any number of threads. cancel(), chargeNodes() and
+ * shouldStop() are safe to call from any thread. The budgets and start() must only be touched while no search is
+ * using the context.
+ */
+class PlanningContext
+{
+public:
+    PlanningContext();
+
+    /**
+     * @brief start begins a run: clears the cancel flag and the nodes charged, and starts the time budget's clock
+     */
+    void start();
+
+    /**
+     * @brief cancel asks every search using the context to give up as soon as it next checks
+     */
+    void cancel();
+    bool cancelled() const;
+
+    /**
+     * @brief timeBudget returns how many milliseconds after start() the context expires. 0 (the default) means never.
+     * @return
+     */
+    qint64 timeBudget() const;
+    void setTimeBudget(qint64 msecs);
+
+    /**
+     * @brief elapsed returns the milliseconds since start(), or 0 if the context was never started
+     * @return
+     */
+    qint64 elapsed() const;
+
+    /**
+     * @brief nodeBudget returns how many nodes may be charged before the context expires. 0 (the default) means
+     * any number.
+     * @return
+     */
+    int nodeBudget() const;
+    void setNodeBudget(int nodes);
+
+    /**
+     * @brief nodesCharged returns the nodes charged since start(). Only counted while there's a node budget.
+     * @return
+     */
+    int nodesCharged() const;
+
+    /**
+     * @brief chargeNodes records count units of search work against the node budget. It's const so that searches
+     * handed a const context can still account for their work.
+     * @param count
+     * @return false if the search should give up, i.e. shouldStop()
+     */
+    bool chargeNodes(int count = 1) const;
+
+    /**
+     * @brief shouldStop returns true if the context was cancelled or one of its budgets is spent. Cheap enough to
+     * check every iteration of a search.
+     * @return
+     */
+    bool shouldStop() const;
+
+private:
+    Q_DISABLE_COPY(PlanningContext)
+
+    QAtomicInt _cancelled;
+    mutable QAtomicInt _nodesCharged;
+
+    qint64 _timeBudget;
+    int _nodeBudget;
+    QElapsedTimer _clock;
+};
+
+#endif // PLANNINGCONTEXT_H
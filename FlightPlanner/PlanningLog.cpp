@@ -0,0 +1,75 @@
+#include "PlanningLog.h"
+
+#if QT_VERSION >= 0x050400
+
+Q_LOGGING_CATEGORY(plannerLog, "flightplanner.planner", QtInfoMsg)
+Q_LOGGING_CATEGORY(subFlightLog, "flightplanner.subflight", QtInfoMsg)
+Q_LOGGING_CATEGORY(scheduleLog, "flightplanner.schedule", QtInfoMsg)
+Q_LOGGING_CATEGORY(intermediateLog, "flightplanner.intermediate", QtInfoMsg)
+
+//static
+void PlanningLog::setDiagnosticsEnabled(bool enabled)
+{
+    QLoggingCategory::setFilterRules(enabled ? "flightplanner.*.debug=true" : "flightplanner.*.debug=false");
+}
+
+#else
+
+PlanningLogCategory::PlanningLogCategory(const char *name) :
+    _name(name), _debugEnabled(false)
+{
+}
+
+const char *PlanningLogCategory::categoryName() const
+{
+    return _name;
+}
+
+bool PlanningLogCategory::isDebugEnabled() const
+{
+    return _debugEnabled;
+}
+
+void PlanningLogCategory::setDebugEnabled(bool enabled)
+{
+    _debugEnabled = enabled;
+}
+
+//non-member
+PlanningLogCategory& plannerLog()
+{
+    static PlanningLogCategory category("flightplanner.planner");
+    return category;
+}
+
+//non-member
+PlanningLogCategory& subFlightLog()
+{
+    static PlanningLogCategory category("flightplanner.subflight");
+    return category;
+}
+
+//non-member
+PlanningLogCategory& scheduleLog()
+{
+    static PlanningLogCategory category("flightplanner.schedule");
+    return category;
+}
+
+//non-member
+PlanningLogCategory& intermediateLog()
+{
+    static PlanningLogCategory category("flightplanner.intermediate");
+    return category;
+}
+
+//static
+void PlanningLog::setDiagnosticsEnabled(bool enabled)
+{
+    plannerLog().setDebugEnabled(enabled);
+    subFlightLog().setDebugEnabled(enabled);
+    scheduleLog().setDebugEnabled(enabled);
+    intermediateLog().setDebugEnabled(enabled);
+}
+
+#endif
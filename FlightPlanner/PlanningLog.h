@@ -0,0 +1,73 @@
+#ifndef PLANNINGLOG_H
+#define PLANNINGLOG_H
+
+#include <QtGlobal>
+#include <QtDebug>
+
+/*
+ * Logging categories for the planners. Their debug output is off by default.
+ *
+ * planningDebug(category) is for diagnostics a few times per stage or per task. Turn it on at runtime with
+ * PlanningLog::setDiagnosticsEnabled() or, on Qt 5, with QT_LOGGING_RULES="flightplanner.*.debug=true".
+ *
+ * planningTrace(category) is for messages inside the search loops, once per node or per state. It's compiled
+ * out entirely unless the planning core is built with CONFIG += planning_trace, and even then it's only
+ * printed while the category's debug output is on.
+*/
+
+#if QT_VERSION >= 0x050400
+#include <QLoggingCategory>
+
+Q_DECLARE_LOGGING_CATEGORY(plannerLog)
+Q_DECLARE_LOGGING_CATEGORY(subFlightLog)
+Q_DECLARE_LOGGING_CATEGORY(scheduleLog)
+Q_DECLARE_LOGGING_CATEGORY(intermediateLog)
+
+#define planningDebug(category) qCDebug(category)
+
+#else
+/*
+ * Qt 4 has no QLoggingCategory. PlanningLogCategory stands in for it with just what planningDebug() needs.
+*/
+class PlanningLogCategory
+{
+public:
+    explicit PlanningLogCategory(const char * name);
+
+    const char * categoryName() const;
+    bool isDebugEnabled() const;
+    void setDebugEnabled(bool enabled);
+
+private:
+    const char * _name;
+    bool _debugEnabled;
+};
+
+PlanningLogCategory& plannerLog();
+PlanningLogCategory& subFlightLog();
+PlanningLogCategory& scheduleLog();
+PlanningLogCategory& intermediateLog();
+
+#define planningDebug(category) \
+    for (bool planningLogEnabled = category().isDebugEnabled(); planningLogEnabled; planningLogEnabled = false) \
+        qDebug() << category().categoryName() << ":"
+
+#endif
+
+#ifdef PLANNING_TRACE
+#define planningTrace(category) planningDebug(category)
+#else
+#define planningTrace(category) while (false) planningDebug(category)
+#endif
+
+class PlanningLog
+{
+public:
+    /**
+     * @brief setDiagnosticsEnabled turns the debug output of every planning category on or off
+     * @param enabled
+     */
+    static void setDiagnosticsEnabled(bool enabled);
+};
+
+#endif // PLANNINGLOG_H
@@ -2,13 +2,21 @@
 
 #include <QtDebug>
 
+#include "CompiledProblem.h"
+#include "FlightTasks/AreaScoringContext.h"
+
+//Flights are matched against the area index this many positions at a time
+const int POSITION_CHUNK = 32;
+
 PlanningProblem::PlanningProblem() :
-    _startingOrientationDefined(false), _startingPositionDefined(false)
+    _startingOrientationDefined(false), _startingPositionDefined(false), _version(0)
 {
+    this->_createChangeCoalescer();
 }
 
 //for de-serializing
-PlanningProblem::PlanningProblem(QDataStream &stream)
+PlanningProblem::PlanningProblem(QDataStream &stream) :
+    _version(0)
 {
     stream >> _startingOrientationDefined;
     if (_startingOrientationDefined)
@@ -25,6 +33,9 @@ PlanningProblem::PlanningProblem(QDataStream &stream)
     {
         QSharedPointer<FlightTaskArea> area(new FlightTaskArea(stream));
         _areas.insert(area);
+
+        //Same as addTaskArea(), so that edits to loaded areas drop the area index too
+        this->_connectArea(area.data());
     }
 
     //Resolve dependencies between flight tasks. This requires a "second pass" here.
@@ -36,6 +47,8 @@ PlanningProblem::PlanningProblem(QDataStream &stream)
     FlightTask::_uuidToWeakTask.clear();
 
     stream >> _uavParameters;
+
+    this->_createChangeCoalescer();
 }
 
 //pure-virtual from Serializable
@@ -81,7 +94,7 @@ void PlanningProblem::setStartingOrientation(const UAVOrientation &orientation)
     _startingOrientationDefined = true;
 
     this->startingOrientationChanged(_startingOrientation);
-    this->planningProblemChanged();
+    this->_markChanged();
 }
 
 bool PlanningProblem::startingPositionDefined() const
@@ -100,23 +113,12 @@ void PlanningProblem::setStartingPosition(const Position &pos)
     _startingPositionDefined = true;
 
     this->startingPositionChanged(_startingPosition);
-    this->planningProblemChanged();
+    this->_markChanged();
 }
 
 void PlanningProblem::addTaskArea(QSharedPointer<FlightTaskArea> area)
 {
-    if (area.isNull())
-        return;
-
-    _areas.insert(area);
-
-    connect(area.data(),
-            SIGNAL(flightTaskAreaChanged()),
-            this,
-            SIGNAL(planningProblemChanged()));
-
-    this->flighTaskAreaAdded(area);
-    this->planningProblemChanged();
+    this->addTaskAreas(QList<QSharedPointer<FlightTaskArea> >() << area);
 }
 
 void PlanningProblem::addTaskArea(const QPointF &centerPos)
@@ -134,25 +136,153 @@ void PlanningProblem::addTaskArea(const QPointF &centerPos)
     this->addTaskArea(area);
 }
 
+void PlanningProblem::addTaskAreas(const QList<QSharedPointer<FlightTaskArea> > &areas)
+{
+    QList<QSharedPointer<FlightTaskArea> > added;
+    foreach(const QSharedPointer<FlightTaskArea>& area, areas)
+    {
+        if (area.isNull() || _areas.contains(area))
+            continue;
+
+        _areas.insert(area);
+        this->_connectArea(area.data());
+        added.append(area);
+    }
+    if (added.isEmpty())
+        return;
+
+    foreach(const QSharedPointer<FlightTaskArea>& area, added)
+        this->flighTaskAreaAdded(area);
+    this->flightTaskAreasAdded(added);
+    this->_markChanged();
+}
+
 void PlanningProblem::removeTaskArea(QSharedPointer<FlightTaskArea> area)
 {
-    _areas.remove(area);
+    if (!_areas.remove(area))
+        return;
+    disconnect(area.data(), 0, this, 0);
 
     this->flightTaskAreaRemoved(area);
-    this->planningProblemChanged();
+    this->_markChanged();
+}
+
+void PlanningProblem::prepareScoring()
+{
+    //New geometry every time, so none that a scoring thread may still hold is modified. What an area's last one
+    //built is taken over if the area hasn't moved.
+    QHash<const FlightTaskArea *, QSharedPointer<AreaGeometry> > geometries;
+    _indexedAreas.clear();
+    _indexedBounds.clear();
+    _indexedGeometries.clear();
+    foreach(const QSharedPointer<FlightTaskArea>& area, _areas)
+    {
+        const QSharedPointer<AreaGeometry> previous = _areaGeometries.value(area.data());
+        QSharedPointer<AreaGeometry> geometry(new AreaGeometry(area->geoPoly(), previous.data()));
+        foreach(const QSharedPointer<FlightTask>& task, area->tasks())
+            task->prepareAreaScoring(geometry.data(), _uavParameters);
+        geometry->finishPreparing();
+        geometries.insert(area.data(), geometry);
+
+        _indexedAreas.append(area);
+        _indexedBounds.append(area->geoPoly().boundingRect());
+        _indexedGeometries.append(geometry);
+    }
+    _areaGeometries = geometries;
+    _areaIndex.build(_indexedBounds);
+}
+
+QSharedPointer<const CompiledProblem> PlanningProblem::compile()
+{
+    this->prepareScoring();
+    if (!_lastCompiled.isNull() && _lastCompiled->version() == _version)
+        return _lastCompiled;
+
+    _lastCompiled = QSharedPointer<const CompiledProblem>(new CompiledProblem(*this, _lastCompiled.data()));
+    return _lastCompiled;
+}
+
+quint64 PlanningProblem::version() const
+{
+    return _version;
+}
+
+void PlanningProblem::beginUpdate()
+{
+    _changes->beginUpdate();
+}
+
+void PlanningProblem::endUpdate()
+{
+    _changes->endUpdate();
 }
 
 Fitness PlanningProblem::calculateFlightPerformance(const QList<Position> &positions) const
 {
+    if (_areaIndex.isEmpty() || positions.isEmpty())
+        return _calculateFlightPerformanceUnindexed(positions);
+
+    //Find the areas near each chunk of the flight. Every area gets its chunks in flight order.
+    QVector<QVector<int> > areaChunks(_indexedAreas.size());
+    QVector<int> nearbyAreas;
+    for (int start = 0; start < positions.size(); start += POSITION_CHUNK)
+    {
+        const int end = qMin<int>(start + POSITION_CHUNK, positions.size());
+        QPointF minLonLat = positions.at(start).lonLat();
+        QPointF maxLonLat = minLonLat;
+        for (int i = start + 1; i < end; i++)
+        {
+            const QPointF lonLat = positions.at(i).lonLat();
+            minLonLat.setX(qMin<qreal>(minLonLat.x(), lonLat.x()));
+            minLonLat.setY(qMin<qreal>(minLonLat.y(), lonLat.y()));
+            maxLonLat.setX(qMax<qreal>(maxLonLat.x(), lonLat.x()));
+            maxLonLat.setY(qMax<qreal>(maxLonLat.y(), lonLat.y()));
+        }
+
+        nearbyAreas.clear();
+        _areaIndex.intersecting(QRectF(minLonLat, maxLonLat), &nearbyAreas);
+        foreach(int areaId, nearbyAreas)
+            areaChunks[areaId].append(start);
+    }
+
     qreal taskScore = 0.0;
     qreal efficiencyScore = 0.0;
 
-    foreach(const QSharedPointer<FlightTaskArea>& area, _areas)
+    for (int areaId = 0; areaId < _indexedAreas.size(); areaId++)
     {
-        const QPolygonF& geoPoly = area->geoPoly();
+        const QSharedPointer<FlightTaskArea>& area = _indexedAreas.at(areaId);
+        const AreaGeometry& geometry = *_indexedGeometries.at(areaId);
+
+        //The positions within the area's bounds, only gathered if one of its tasks wants them
+        QList<Position> nearby;
+        bool nearbyGathered = false;
+
+        //The area's tasks share what's worked out about the flight (or the nearby part of it)
+        const AreaScoringContext flightContext(geometry, positions, _uavParameters);
+        const AreaScoringContext nearbyContext(geometry, nearby, _uavParameters);
+
         foreach(const QSharedPointer<FlightTask>& task, area->tasks())
         {
-            const qreal subScore = task->calculateFlightPerformance(positions, geoPoly, _uavParameters);
+            if (task->scoresOnlyInsideArea() && !nearbyGathered)
+            {
+                const QRectF& bounds = _indexedBounds.at(areaId);
+                foreach(int start, areaChunks.at(areaId))
+                {
+                    const int end = qMin<int>(start + POSITION_CHUNK, positions.size());
+                    for (int i = start; i < end; i++)
+                    {
+                        const Position& pos = positions.at(i);
+                        if (pos.longitude() < bounds.left() || pos.longitude() > bounds.right()
+                                || pos.latitude() < bounds.top() || pos.latitude() > bounds.bottom())
+                            continue;
+                        nearby.append(pos);
+                    }
+                }
+                nearbyGathered = true;
+            }
+
+            const AreaScoringContext& context = task->scoresOnlyInsideArea() ? nearbyContext : flightContext;
+            const qreal subScore = task->calculateAreaPerformance(context);
             if (task->shortnessRewardApplies() && subScore >= task->maxTaskPerformance())
                 efficiencyScore += subScore / positions.size();
             taskScore += subScore;
@@ -162,6 +292,37 @@ Fitness PlanningProblem::calculateFlightPerformance(const QList<Position> &posit
     return Fitness(taskScore, efficiencyScore);
 }
 
+QList<QSharedPointer<FlightTaskScoringState> > PlanningProblem::createScoringStates() const
+{
+    QList<QSharedPointer<FlightTaskScoringState> > toRet;
+
+    foreach(const QSharedPointer<FlightTaskArea>& area, _areas)
+    {
+        const QPolygonF& geoPoly = area->geoPoly();
+        foreach(const QSharedPointer<FlightTask>& task, area->tasks())
+            toRet.append(task->createScoringState(geoPoly, _uavParameters));
+    }
+
+    return toRet;
+}
+
+Fitness PlanningProblem::calculateFlightPerformance(const QList<QSharedPointer<FlightTaskScoringState> > &states) const
+{
+    qreal taskScore = 0.0;
+    qreal efficiencyScore = 0.0;
+
+    foreach(const QSharedPointer<FlightTaskScoringState>& state, states)
+    {
+        const FlightTask * task = state->task();
+        const qreal subScore = state->performance();
+        if (task->shortnessRewardApplies() && subScore >= task->maxTaskPerformance())
+            efficiencyScore += subScore / state->positionCount();
+        taskScore += subScore;
+    }
+
+    return Fitness(taskScore, efficiencyScore);
+}
+
 const QSet<QSharedPointer<FlightTaskArea> > &PlanningProblem::areas() const
 {
     return _areas;
@@ -176,5 +337,68 @@ void PlanningProblem::setUAVParameters(const UAVParameters &nParams)
 {
     _uavParameters = nParams;
 
-    this->planningProblemChanged();
+    this->_markChanged();
+}
+
+//private slot
+void PlanningProblem::handleFlightTaskAreaEdited()
+{
+    this->_markChanged();
+}
+
+//private
+void PlanningProblem::_createChangeCoalescer()
+{
+    _changes = new ChangeCoalescer(this);
+    connect(_changes,
+            SIGNAL(changed()),
+            this,
+            SIGNAL(planningProblemChanged()));
+}
+
+//private
+void PlanningProblem::_connectArea(FlightTaskArea *area)
+{
+    //Right away rather than coalesced, since the area index and our version have to follow every edit
+    connect(area,
+            SIGNAL(flightTaskAreaEdited()),
+            this,
+            SLOT(handleFlightTaskAreaEdited()));
+}
+
+//private
+void PlanningProblem::_markChanged()
+{
+    _version++;
+
+    //Areas may have moved, come or gone
+    _areaIndex.clear();
+    _indexedAreas.clear();
+    _indexedBounds.clear();
+    _indexedGeometries.clear();
+
+    _changes->markChanged();
+}
+
+//private
+Fitness PlanningProblem::_calculateFlightPerformanceUnindexed(const QList<Position> &positions) const
+{
+    qreal taskScore = 0.0;
+    qreal efficiencyScore = 0.0;
+
+    foreach(const QSharedPointer<FlightTaskArea>& area, _areas)
+    {
+        //Not prepared, but the area's tasks can still share what they work out about the flight
+        const AreaGeometry geometry(area->geoPoly());
+        const AreaScoringContext context(geometry, positions, _uavParameters);
+        foreach(const QSharedPointer<FlightTask>& task, area->tasks())
+        {
+            const qreal subScore = task->calculateAreaPerformance(context);
+            if (task->shortnessRewardApplies() && subScore >= task->maxTaskPerformance())
+                efficiencyScore += subScore / positions.size();
+            taskScore += subScore;
+        }
+    }
+
+    return Fitness(taskScore, efficiencyScore);
 }
@@ -2,8 +2,10 @@
 #define PLANNINGPROBLEM_H
 
 #include <QObject>
+#include <QHash>
 #include <QSet>
 #include <QSharedPointer>
+#include <QVector>
 
 #include "UAVOrientation.h"
 #include "Position.h"
@@ -11,6 +13,11 @@
 #include "Fitness.h"
 #include "UAVParameters.h"
 #include "Serializable.h"
+#include "RectIndex.h"
+#include "ChangeCoalescer.h"
+#include "FlightTasks/AreaGeometry.h"
+
+class CompiledProblem;
 
 class PlanningProblem : public QObject, public Serializable
 {
@@ -37,16 +44,77 @@ public:
 
     void addTaskArea(QSharedPointer<FlightTaskArea> area);
     void addTaskArea(const QPointF& centerPos);
+
+    /**
+     * @brief addTaskAreas adds many areas with a single planningProblemChanged() and flightTaskAreasAdded(),
+     * e.g. for imported no-fly zones
+     * @param areas
+     */
+    void addTaskAreas(const QList<QSharedPointer<FlightTaskArea> >& areas);
     void removeTaskArea(QSharedPointer<FlightTaskArea> area);
 
+    /**
+     * @brief prepareScoring has every task precompute what it needs to score flights over its area (see
+     * FlightTask::prepareAreaScoring()), sharing each area's geometry between its tasks, and indexes the areas
+     * by their bounds. Planners call it when they start. Until the problem changes again the
+     * const scoring functions below only read the problem, so any number of threads can call them at once.
+     */
+    void prepareScoring();
+
+    /**
+     * @brief compile prepares the tasks for scoring and returns a snapshot of the problem as it is now, for
+     * planners to read while planning. See CompiledProblem.
+     *
+     * Snapshots are cheap to take while the user edits: if nothing has changed since the last one it's returned
+     * again, and otherwise the new one shares everything it can with the last one, so only the areas that were
+     * edited are built again.
+     * @return
+     */
+    QSharedPointer<const CompiledProblem> compile();
+
+    /**
+     * @brief version counts the changes to the problem. Snapshots are tagged with it.
+     * @return
+     */
+    quint64 version() const;
+
+    /**
+     * @brief beginUpdate holds planningProblemChanged() back until the matching endUpdate(), so that many edits
+     * (to the problem or to its areas) give one signal. Updates nest. See also UpdateScope.
+     */
+    void beginUpdate();
+    void endUpdate();
+
+    /**
+     * @brief calculateFlightPerformance scores a whole flight. Once prepareScoring() has been called, tasks
+     * that score only inside their area (see FlightTask::scoresOnlyInsideArea()) are given just the positions
+     * near it, found through the area index, instead of the whole flight. Each area's tasks are scored through
+     * one AreaScoringContext, so which positions are inside the area is only worked out once per area.
+     * @param positions
+     * @return
+     */
     Fitness calculateFlightPerformance(const QList<Position>& positions) const;
 
+    /**
+     * @brief createScoringStates returns an empty incremental scorer for every task in the problem.
+     * Append positions to all of them and pass them to calculateFlightPerformance() to get the same
+     * Fitness as scoring the whole path.
+     * @return
+     */
+    QList<QSharedPointer<FlightTaskScoringState> > createScoringStates() const;
+    Fitness calculateFlightPerformance(const QList<QSharedPointer<FlightTaskScoringState> >& states) const;
+
     const QSet<QSharedPointer<FlightTaskArea> >& areas() const;
 
     const UAVParameters& uavParameters() const;
     void setUAVParameters(const UAVParameters& nParams);
     
 signals:
+    /**
+     * @brief planningProblemChanged is emitted once per event-loop turn in which the problem or its areas were
+     * edited (and only once no update is open), however many edits that turn made. The problem's version() and
+     * snapshots (see compile()) follow every edit right away.
+     */
     void planningProblemChanged();
 
     void startingOrientationChanged(const UAVOrientation& orientation);
@@ -54,11 +122,22 @@ signals:
     void startingPositionChanged(const Position& pos);
 
     void flighTaskAreaAdded(const QSharedPointer<FlightTaskArea>& area);
+
+    //Emitted once per addTaskArea() or addTaskAreas(), after flighTaskAreaAdded() for each of the areas
+    void flightTaskAreasAdded(const QList<QSharedPointer<FlightTaskArea> >& areas);
     void flightTaskAreaRemoved(const QSharedPointer<FlightTaskArea>& area);
     
 public slots:
 
+private slots:
+    void handleFlightTaskAreaEdited();
+
 private:
+    void _createChangeCoalescer();
+    void _connectArea(FlightTaskArea * area);
+    void _markChanged();
+    Fitness _calculateFlightPerformanceUnindexed(const QList<Position>& positions) const;
+
     bool _startingOrientationDefined;
     UAVOrientation _startingOrientation;
 
@@ -68,6 +147,21 @@ private:
     QSet<QSharedPointer<FlightTaskArea> > _areas;
 
     UAVParameters _uavParameters;
+
+    //Built by prepareScoring() and dropped whenever the problem changes. Ids in _areaIndex index the others.
+    RectIndex _areaIndex;
+    QVector<QSharedPointer<FlightTaskArea> > _indexedAreas;
+    QVector<QRectF> _indexedBounds;
+    QVector<QSharedPointer<AreaGeometry> > _indexedGeometries;
+
+    //Every area's geometry from the last prepareScoring(), to take over what it can on the next one
+    QHash<const FlightTaskArea *, QSharedPointer<AreaGeometry> > _areaGeometries;
+
+    quint64 _version;
+    ChangeCoalescer * _changes;
+
+    //The last snapshot compile() took, to share with the next one
+    QSharedPointer<const CompiledProblem> _lastCompiled;
     
 };
 
@@ -0,0 +1,74 @@
+#include "PlanningRandom.h"
+
+#include <cstring>
+
+PlanningRandom::PlanningRandom(quint64 seed, quint64 stream)
+{
+    this->seed(seed, stream);
+}
+
+void PlanningRandom::seed(quint64 seed, quint64 stream)
+{
+    //The initialization from the PCG paper: the increment must be odd
+    _state = 0;
+    _increment = (stream << 1) | 1;
+    this->next();
+    _state += seed;
+    this->next();
+}
+
+quint32 PlanningRandom::next()
+{
+    const quint64 old = _state;
+    _state = old * Q_UINT64_C(6364136223846793005) + _increment;
+
+    //XSH-RR output function
+    const quint32 xorShifted = (quint32) (((old >> 18) ^ old) >> 27);
+    const quint32 rotation = (quint32) (old >> 59);
+    return (xorShifted >> rotation) | (xorShifted << ((32 - rotation) & 31));
+}
+
+quint32 PlanningRandom::bounded(quint32 bound)
+{
+    //Reject the few values at the bottom that would make some results more likely than others
+    const quint32 threshold = (0u - bound) % bound;
+    while (true)
+    {
+        const quint32 value = this->next();
+        if (value >= threshold)
+            return value % bound;
+    }
+}
+
+qreal PlanningRandom::uniform()
+{
+    return this->next() * (1.0 / 4294967296.0);
+}
+
+qreal PlanningRandom::uniform(qreal min, qreal max)
+{
+    return min + (max - min) * this->uniform();
+}
+
+//static
+quint64 PlanningRandom::mix(quint64 value)
+{
+    value += Q_UINT64_C(0x9E3779B97F4A7C15);
+    value = (value ^ (value >> 30)) * Q_UINT64_C(0xBF58476D1CE4E5B9);
+    value = (value ^ (value >> 27)) * Q_UINT64_C(0x94D049BB133111EB);
+    return value ^ (value >> 31);
+}
+
+//static
+quint64 PlanningRandom::hashReals(quint64 seed, const qreal *values, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        //+0.0 so that -0.0 hashes the same
+        const double value = values[i] + 0.0;
+        quint64 bits;
+        memcpy(&bits, &value, sizeof(bits));
+        seed = PlanningRandom::mix(seed ^ bits);
+    }
+    return seed;
+}
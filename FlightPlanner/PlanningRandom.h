@@ -0,0 +1,51 @@
+#ifndef PLANNINGRANDOM_H
+#define PLANNINGRANDOM_H
+
+#include <QtGlobal>
+
+/**
+ * @brief The PlanningRandom class is a small, fast pseudo-random generator (PCG32) for the stochastic parts
+ * of planning. Every planner component owns one and seeds it from its own inputs, so results only depend on
+ * the problem and the planner's seed, never on what else ran first or on which thread. Unlike qrand() there
+ * is no global or per-thread state involved.
+ */
+class PlanningRandom
+{
+public:
+    explicit PlanningRandom(quint64 seed = 0, quint64 stream = 0);
+
+    /**
+     * @brief seed restarts the sequence. Generators with the same seed but different streams produce
+     * unrelated sequences.
+     */
+    void seed(quint64 seed, quint64 stream = 0);
+
+    //Uniform over all 32-bit values
+    quint32 next();
+
+    //Uniform over [0, bound), without modulo bias. bound must be positive.
+    quint32 bounded(quint32 bound);
+
+    //Uniform over [0, 1)
+    qreal uniform();
+
+    //Uniform over [min, max)
+    qreal uniform(qreal min, qreal max);
+
+    /**
+     * @brief mix scrambles value (SplitMix64's finalizer) so that similar seeds give unrelated sequences
+     */
+    static quint64 mix(quint64 value);
+
+    /**
+     * @brief hashReals folds the bit patterns of count reals into seed, for deriving seeds from a component's
+     * inputs.
+     */
+    static quint64 hashReals(quint64 seed, const qreal * values, int count);
+
+private:
+    quint64 _state;
+    quint64 _increment;
+};
+
+#endif // PLANNINGRANDOM_H
@@ -0,0 +1,12 @@
+#include "PlanningStageTimer.h"
+
+PlanningStageTimer::PlanningStageTimer(PlanningStatistics *statistics, const QString &name) :
+    _statistics(statistics)
+{
+    _statistics->beginSpan(name);
+}
+
+PlanningStageTimer::~PlanningStageTimer()
+{
+    _statistics->endSpan();
+}
@@ -0,0 +1,25 @@
+#ifndef PLANNINGSTAGETIMER_H
+#define PLANNINGSTAGETIMER_H
+
+#include <QString>
+
+#include "PlanningStatistics.h"
+
+/**
+ * @brief The PlanningStageTimer class times the scope it lives in as a span of a PlanningStatistics. The span
+ * is open (see PlanningStatistics::openSpans()) while the scope runs and is finished when the timer goes out
+ * of scope, however the scope is left.
+ */
+class PlanningStageTimer
+{
+public:
+    PlanningStageTimer(PlanningStatistics * statistics, const QString& name);
+    ~PlanningStageTimer();
+
+private:
+    Q_DISABLE_COPY(PlanningStageTimer)
+
+    PlanningStatistics * _statistics;
+};
+
+#endif // PLANNINGSTAGETIMER_H
@@ -0,0 +1,179 @@
+#include "PlanningStatistics.h"
+
+#include <QIODevice>
+#include <QTextStream>
+
+//Planners that record a span per iteration would otherwise grow without bound
+const int MAX_SPANS = 100000;
+
+//Quotes and escapes value for a JSON document
+static QString jsonString(const QString& value)
+{
+    QString toRet = value;
+    toRet.replace('\\', "\\\\");
+    toRet.replace('"', "\\\"");
+    return '"' + toRet + '"';
+}
+
+//Flushes out and reports whether everything written to it made it to device
+static bool finishWriting(QTextStream& out, QIODevice * device, QString * errorString)
+{
+    out.flush();
+    if (out.status() == QTextStream::Ok)
+        return true;
+
+    if (errorString)
+        *errorString = "Failed to write planning statistics: " + device->errorString();
+    return false;
+}
+
+PlanningStatistics::PlanningStatistics()
+{
+    this->clear();
+}
+
+void PlanningStatistics::clear()
+{
+    _spans.clear();
+    _openSpans.clear();
+    _counters.clear();
+    _clock.start();
+}
+
+qint64 PlanningStatistics::elapsed() const
+{
+    return _clock.nsecsElapsed();
+}
+
+void PlanningStatistics::addSpan(const QString &name, qint64 startNsecs, qint64 durationNsecs)
+{
+    if (_spans.size() >= MAX_SPANS)
+    {
+        this->addToCounter("DroppedSpans");
+        return;
+    }
+
+    Span span;
+    span.name = name;
+    span.startNsecs = startNsecs;
+    span.durationNsecs = durationNsecs;
+    _spans.append(span);
+}
+
+const QList<PlanningStatistics::Span> &PlanningStatistics::spans() const
+{
+    return _spans;
+}
+
+void PlanningStatistics::beginSpan(const QString &name)
+{
+    Span span;
+    span.name = name;
+    span.startNsecs = this->elapsed();
+    span.durationNsecs = 0;
+    _openSpans.append(span);
+}
+
+void PlanningStatistics::endSpan()
+{
+    if (_openSpans.isEmpty())
+        return;
+    const Span span = _openSpans.takeLast();
+    this->addSpan(span.name, span.startNsecs, this->elapsed() - span.startNsecs);
+}
+
+QList<PlanningStatistics::Span> PlanningStatistics::openSpans() const
+{
+    QList<Span> toRet = _openSpans;
+    const qint64 now = this->elapsed();
+    for (int i = 0; i < toRet.size(); i++)
+        toRet[i].durationNsecs = now - toRet[i].startNsecs;
+    return toRet;
+}
+
+void PlanningStatistics::addToCounter(const QString &name, qint64 amount)
+{
+    _counters[name] += amount;
+}
+
+void PlanningStatistics::setCounter(const QString &name, qint64 value)
+{
+    _counters.insert(name, value);
+}
+
+qint64 PlanningStatistics::counter(const QString &name) const
+{
+    return _counters.value(name, 0);
+}
+
+const QMap<QString, qint64> &PlanningStatistics::counters() const
+{
+    return _counters;
+}
+
+bool PlanningStatistics::writeJSON(QIODevice *device, QString *errorString) const
+{
+    QTextStream out(device);
+    out << "{\n  \"spans\": [";
+    for (int i = 0; i < _spans.size(); i++)
+    {
+        const Span& span = _spans.at(i);
+        out << (i == 0 ? "\n" : ",\n");
+        out << "    {\"name\": " << jsonString(span.name)
+            << ", \"start_ns\": " << span.startNsecs
+            << ", \"duration_ns\": " << span.durationNsecs << "}";
+    }
+    out << "\n  ],\n  \"counters\": {";
+
+    QMapIterator<QString, qint64> iter(_counters);
+    bool first = true;
+    while (iter.hasNext())
+    {
+        iter.next();
+        out << (first ? "\n" : ",\n") << "    " << jsonString(iter.key()) << ": " << iter.value();
+        first = false;
+    }
+    out << "\n  }\n}\n";
+
+    return finishWriting(out, device, errorString);
+}
+
+bool PlanningStatistics::writeChromeTrace(QIODevice *device, QString *errorString) const
+{
+    //Trace timestamps are in microseconds
+    QTextStream out(device);
+    out.setRealNumberNotation(QTextStream::FixedNotation);
+    out.setRealNumberPrecision(3);
+
+    qint64 endNsecs = 0;
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    for (int i = 0; i < _spans.size(); i++)
+    {
+        const Span& span = _spans.at(i);
+        endNsecs = qMax<qint64>(endNsecs, span.startNsecs + span.durationNsecs);
+        out << (i == 0 ? "\n" : ",\n");
+        out << "  {\"name\": " << jsonString(span.name)
+            << ", \"cat\": \"planning\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1"
+            << ", \"ts\": " << span.startNsecs / 1000.0
+            << ", \"dur\": " << span.durationNsecs / 1000.0 << "}";
+    }
+
+    if (!_counters.isEmpty())
+    {
+        out << (_spans.isEmpty() ? "\n" : ",\n");
+        out << "  {\"name\": \"Counters\", \"cat\": \"planning\", \"ph\": \"C\", \"pid\": 1, \"tid\": 1"
+            << ", \"ts\": " << endNsecs / 1000.0 << ", \"args\": {";
+        QMapIterator<QString, qint64> iter(_counters);
+        bool first = true;
+        while (iter.hasNext())
+        {
+            iter.next();
+            out << (first ? "" : ", ") << jsonString(iter.key()) << ": " << iter.value();
+            first = false;
+        }
+        out << "}}";
+    }
+    out << "\n]}\n";
+
+    return finishWriting(out, device, errorString);
+}
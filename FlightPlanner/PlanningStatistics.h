@@ -0,0 +1,85 @@
+#ifndef PLANNINGSTATISTICS_H
+#define PLANNINGSTATISTICS_H
+
+#include <QString>
+#include <QList>
+#include <QMap>
+#include <QElapsedTimer>
+#include <QMetaType>
+
+class QIODevice;
+
+/**
+ * @brief The PlanningStatistics class records where a planner spends its time: named spans (usually one per
+ * stage, see PlanningStageTimer) measured from the last clear(), and named counters like how many states were
+ * expanded or how often a cache hit.
+ *
+ * It can be written out as plain JSON or in the Chrome trace event format, which chrome://tracing and
+ * Perfetto display as a timeline. A PlanningStatistics is a value type and is not thread-safe. Planners fill
+ * in their own on the planning thread and publish copies through FlightPlanner.
+ */
+class PlanningStatistics
+{
+public:
+    struct Span
+    {
+        QString name;
+        qint64 startNsecs;
+        qint64 durationNsecs;
+    };
+
+    PlanningStatistics();
+
+    /**
+     * @brief clear forgets every span and counter and restarts the clock that spans are measured against
+     */
+    void clear();
+
+    /**
+     * @brief elapsed returns the nanoseconds since the last clear()
+     */
+    qint64 elapsed() const;
+
+    void addSpan(const QString& name, qint64 startNsecs, qint64 durationNsecs);
+    const QList<Span>& spans() const;
+
+    /**
+     * @brief beginSpan starts a span that endSpan() finishes. Spans may nest; endSpan() finishes the innermost.
+     */
+    void beginSpan(const QString& name);
+    void endSpan();
+
+    /**
+     * @brief openSpans returns the spans that have begun but not ended yet, outermost first, with their
+     * durations so far
+     */
+    QList<Span> openSpans() const;
+
+    void addToCounter(const QString& name, qint64 amount = 1);
+    void setCounter(const QString& name, qint64 value);
+    qint64 counter(const QString& name) const;
+    const QMap<QString, qint64>& counters() const;
+
+    /**
+     * @brief writeJSON writes the spans and counters as a JSON object. Returns true on success, false on
+     * failure with an explanation in errorString.
+     */
+    bool writeJSON(QIODevice * device, QString * errorString = 0) const;
+
+    /**
+     * @brief writeChromeTrace writes the spans as complete ("X") events and the counters as one counter ("C")
+     * event at the end of the trace. Returns true on success, false on failure with an explanation in
+     * errorString.
+     */
+    bool writeChromeTrace(QIODevice * device, QString * errorString = 0) const;
+
+private:
+    QElapsedTimer _clock;
+    QList<Span> _spans;
+    QList<Span> _openSpans;
+    QMap<QString, qint64> _counters;
+};
+
+Q_DECLARE_METATYPE(PlanningStatistics)
+
+#endif // PLANNINGSTATISTICS_H
@@ -0,0 +1,416 @@
+#include "ProblemFile.h"
+
+#include <QDataStream>
+#include <QIODevice>
+#include <QtEndian>
+#include <QtDebug>
+
+//"FPPB"
+const quint32 PROBLEM_FILE_MAGIC = 0x46505042;
+
+//The version this code writes, and the oldest reader that can still read what it writes
+const quint16 FORMAT_VERSION = 1;
+const quint16 MIN_READER_VERSION = 1;
+
+const quint16 PROBLEM_SECTION_VERSION = 1;
+const quint16 AREA_SECTION_VERSION = 1;
+const quint16 PLANNER_RESULTS_SECTION_VERSION = 1;
+
+const char * const PROBLEM_SECTION = "Problem";
+const char * const AREA_SECTION = "Area";
+const char * const PLANNER_RESULTS_SECTION = "PlannerResults";
+
+//Pinned so that files don't depend on the Qt version that wrote them
+const int STREAM_VERSION = QDataStream::Qt_4_8;
+
+ProblemFile::ProblemFile() :
+    _formatVersion(0), _dataStart(0), _startingPositionDefined(false), _problemSection(-1),
+    _plannerResultsSection(-1)
+{
+}
+
+ProblemFile::~ProblemFile()
+{
+    this->close();
+}
+
+//static
+bool ProblemFile::write(const PlanningProblem &problem, QIODevice *device, QString *errorString,
+                        const QByteArray &plannerResults)
+{
+    QList<QByteArray> sectionBytes;
+    QList<Section> sections;
+
+    //The problem's own settings
+    {
+        QByteArray bytes;
+        QDataStream stream(&bytes, QIODevice::WriteOnly);
+        stream.setVersion(STREAM_VERSION);
+
+        stream << problem.startingOrientationDefined();
+        if (problem.startingOrientationDefined())
+            problem.startingOrientation().serialize(stream);
+        stream << problem.startingPositionDefined();
+        if (problem.startingPositionDefined())
+            stream << problem.startingPosition();
+        stream << problem.uavParameters();
+
+        Section section;
+        section.kind = PROBLEM_SECTION;
+        section.version = PROBLEM_SECTION_VERSION;
+        sections.append(section);
+        sectionBytes.append(bytes);
+    }
+
+    QStringList areaNames;
+    QList<int> taskCounts;
+    foreach(const QSharedPointer<FlightTaskArea>& area, problem.areas())
+    {
+        QByteArray bytes;
+        QDataStream stream(&bytes, QIODevice::WriteOnly);
+        stream.setVersion(STREAM_VERSION);
+        area->serialize(stream);
+
+        Section section;
+        section.kind = AREA_SECTION;
+        section.version = AREA_SECTION_VERSION;
+        sections.append(section);
+        sectionBytes.append(bytes);
+
+        areaNames.append(area->areaName());
+        taskCounts.append(area->numTasks());
+    }
+
+    //Last, since it's only wanted once the problem itself is loaded
+    if (!plannerResults.isEmpty())
+    {
+        Section section;
+        section.kind = PLANNER_RESULTS_SECTION;
+        section.version = PLANNER_RESULTS_SECTION_VERSION;
+        sections.append(section);
+        sectionBytes.append(plannerResults);
+    }
+
+    qint64 offset = 0;
+    for (int i = 0; i < sections.size(); i++)
+    {
+        sections[i].offset = offset;
+        sections[i].length = sectionBytes.at(i).size();
+        offset += sections[i].length;
+    }
+
+    QByteArray preview;
+    {
+        QDataStream stream(&preview, QIODevice::WriteOnly);
+        stream.setVersion(STREAM_VERSION);
+        stream << areaNames << taskCounts;
+        stream << problem.startingPositionDefined() << problem.startingPosition();
+    }
+
+    QDataStream stream(device);
+    stream.setVersion(STREAM_VERSION);
+    stream << PROBLEM_FILE_MAGIC << FORMAT_VERSION << MIN_READER_VERSION;
+    stream << preview;
+
+    stream << (quint32)sections.size();
+    foreach(const Section& section, sections)
+        stream << section.kind << section.version << section.offset << section.length;
+
+    foreach(const QByteArray& bytes, sectionBytes)
+        stream.writeRawData(bytes.constData(), bytes.size());
+
+    if (stream.status() != QDataStream::Ok)
+    {
+        if (errorString)
+            *errorString = "Failed to write planning problem: " + device->errorString();
+        return false;
+    }
+    return true;
+}
+
+//static
+bool ProblemFile::isProblemFile(QIODevice *device)
+{
+    const QByteArray magic = device->peek(4);
+    return magic.size() == 4
+            && qFromBigEndian<quint32>((const uchar *) magic.constData()) == PROBLEM_FILE_MAGIC;
+}
+
+//static
+QSharedPointer<PlanningProblem> ProblemFile::load(const QString &filePath, QByteArray *plannerResults,
+                                                  QString *errorString)
+{
+    QFile fp(filePath);
+    if (!fp.open(QFile::ReadOnly))
+    {
+        if (errorString)
+            *errorString = "Failed to open " + filePath + ": " + fp.errorString();
+        return QSharedPointer<PlanningProblem>();
+    }
+
+    //Files saved before the container format are one bare QDataStream
+    if (!ProblemFile::isProblemFile(&fp))
+    {
+        QDataStream stream(&fp);
+        return QSharedPointer<PlanningProblem>(new PlanningProblem(stream));
+    }
+    fp.close();
+
+    ProblemFile file;
+    if (!file.open(filePath, errorString))
+        return QSharedPointer<PlanningProblem>();
+
+    QSharedPointer<PlanningProblem> problem = file.loadProblem(errorString);
+    for (int i = 0; !problem.isNull() && i < file.areaCount(); i++)
+    {
+        QSharedPointer<FlightTaskArea> area = file.loadArea(i, errorString);
+        if (area.isNull())
+            return QSharedPointer<PlanningProblem>();
+        problem->addTaskArea(area);
+    }
+
+    if (!problem.isNull() && plannerResults)
+        *plannerResults = file.loadPlannerResults();
+    return problem;
+}
+
+bool ProblemFile::open(const QString &filePath, QString *errorString)
+{
+    this->close();
+
+    _file.setFileName(filePath);
+    if (!_file.open(QIODevice::ReadOnly))
+    {
+        if (errorString)
+            *errorString = "Failed to open " + filePath + ": " + _file.errorString();
+        return false;
+    }
+
+    QDataStream stream(&_file);
+    stream.setVersion(STREAM_VERSION);
+
+    quint32 magic;
+    quint16 minReaderVersion;
+    stream >> magic >> _formatVersion >> minReaderVersion;
+    if (stream.status() != QDataStream::Ok || magic != PROBLEM_FILE_MAGIC)
+    {
+        if (errorString)
+            *errorString = filePath + " is not a planning problem file";
+        this->close();
+        return false;
+    }
+    if (minReaderVersion > FORMAT_VERSION)
+    {
+        if (errorString)
+            *errorString = QString("%1 needs a newer version of the planner (format %2)").arg(filePath)
+                    .arg(_formatVersion);
+        this->close();
+        return false;
+    }
+
+    QByteArray preview;
+    stream >> preview;
+    {
+        QDataStream previewStream(preview);
+        previewStream.setVersion(STREAM_VERSION);
+        previewStream >> _areaNames >> _taskCounts;
+        previewStream >> _startingPositionDefined >> _startingPosition;
+    }
+
+    quint32 numSections;
+    stream >> numSections;
+    for (quint32 i = 0; i < numSections && stream.status() == QDataStream::Ok; i++)
+    {
+        Section section;
+        stream >> section.kind >> section.version >> section.offset >> section.length;
+
+        //Sections of kinds we don't know are from newer writers, and are skipped
+        if (section.kind == PROBLEM_SECTION && _problemSection < 0)
+            _problemSection = _sections.size();
+        else if (section.kind == AREA_SECTION)
+            _areaSections.append(_sections.size());
+        else if (section.kind == PLANNER_RESULTS_SECTION && _plannerResultsSection < 0)
+            _plannerResultsSection = _sections.size();
+        _sections.append(section);
+    }
+
+    _dataStart = _file.pos();
+    if (stream.status() != QDataStream::Ok)
+    {
+        if (errorString)
+            *errorString = filePath + " has a damaged table of contents";
+        this->close();
+        return false;
+    }
+
+    return true;
+}
+
+void ProblemFile::close()
+{
+    if (!_loadedTasks.isEmpty())
+        FlightTask::_uuidToWeakTask.clear();
+
+    _file.close();
+    _formatVersion = 0;
+    _dataStart = 0;
+    _areaNames.clear();
+    _taskCounts.clear();
+    _startingPositionDefined = false;
+    _startingPosition = Position();
+    _sections.clear();
+    _areaSections.clear();
+    _problemSection = -1;
+    _plannerResultsSection = -1;
+    _loadedTasks.clear();
+}
+
+bool ProblemFile::isOpen() const
+{
+    return _file.isOpen();
+}
+
+quint16 ProblemFile::formatVersion() const
+{
+    return _formatVersion;
+}
+
+int ProblemFile::areaCount() const
+{
+    return _areaSections.size();
+}
+
+QString ProblemFile::areaName(int area) const
+{
+    return _areaNames.value(area);
+}
+
+int ProblemFile::taskCount(int area) const
+{
+    return _taskCounts.value(area);
+}
+
+bool ProblemFile::startingPositionDefined() const
+{
+    return _startingPositionDefined;
+}
+
+const Position &ProblemFile::startingPosition() const
+{
+    return _startingPosition;
+}
+
+QString ProblemFile::summary() const
+{
+    int tasks = 0;
+    foreach(int count, _taskCounts)
+        tasks += count;
+    return QString("%1 areas, %2 tasks").arg(this->areaCount()).arg(tasks);
+}
+
+QSharedPointer<PlanningProblem> ProblemFile::loadProblem(QString *errorString)
+{
+    QSharedPointer<PlanningProblem> toRet(new PlanningProblem());
+    if (_problemSection < 0)
+        return toRet;
+
+    QByteArray bytes;
+    if (!this->readSection(_sections.at(_problemSection), &bytes, errorString))
+        return QSharedPointer<PlanningProblem>();
+
+    QDataStream stream(bytes);
+    stream.setVersion(STREAM_VERSION);
+
+    bool orientationDefined;
+    stream >> orientationDefined;
+    if (orientationDefined)
+        toRet->setStartingOrientation(UAVOrientation(stream));
+
+    bool positionDefined;
+    stream >> positionDefined;
+    if (positionDefined)
+    {
+        Position pos;
+        stream >> pos;
+        toRet->setStartingPosition(pos);
+    }
+
+    UAVParameters params;
+    stream >> params;
+    toRet->setUAVParameters(params);
+
+    if (stream.status() != QDataStream::Ok)
+    {
+        if (errorString)
+            *errorString = "The planning problem's settings are damaged";
+        return QSharedPointer<PlanningProblem>();
+    }
+    return toRet;
+}
+
+QSharedPointer<FlightTaskArea> ProblemFile::loadArea(int area, QString *errorString)
+{
+    if (area < 0 || area >= _areaSections.size())
+    {
+        if (errorString)
+            *errorString = QString("No area %1 in the planning problem").arg(area);
+        return QSharedPointer<FlightTaskArea>();
+    }
+
+    QByteArray bytes;
+    if (!this->readSection(_sections.at(_areaSections.at(area)), &bytes, errorString))
+        return QSharedPointer<FlightTaskArea>();
+
+    QDataStream stream(bytes);
+    stream.setVersion(STREAM_VERSION);
+    QSharedPointer<FlightTaskArea> toRet(new FlightTaskArea(stream));
+    if (stream.status() != QDataStream::Ok)
+    {
+        if (errorString)
+            *errorString = QString("Area %1 of the planning problem is damaged").arg(area);
+        return QSharedPointer<FlightTaskArea>();
+    }
+
+    //The area's tasks registered themselves for dependency lookup, so try everything loaded so far again
+    foreach(const QSharedPointer<FlightTask>& task, toRet->tasks())
+        _loadedTasks.append(task.toWeakRef());
+    foreach(const QWeakPointer<FlightTask>& weak, _loadedTasks)
+    {
+        QSharedPointer<FlightTask> task = weak.toStrongRef();
+        if (!task.isNull())
+            task->resolveDependencies(false);
+    }
+
+    return toRet;
+}
+
+QByteArray ProblemFile::loadPlannerResults(QString *errorString)
+{
+    QByteArray toRet;
+    if (_plannerResultsSection < 0
+            || !this->readSection(_sections.at(_plannerResultsSection), &toRet, errorString))
+        return QByteArray();
+    return toRet;
+}
+
+//private
+bool ProblemFile::readSection(const Section &section, QByteArray *bytes, QString *errorString)
+{
+    if (section.offset < 0 || section.length < 0
+            || _dataStart + section.offset + section.length > _file.size()
+            || !_file.seek(_dataStart + section.offset))
+    {
+        if (errorString)
+            *errorString = "The planning problem file is truncated";
+        return false;
+    }
+
+    *bytes = _file.read(section.length);
+    if (bytes->size() != section.length)
+    {
+        if (errorString)
+            *errorString = "Failed to read the planning problem file: " + _file.errorString();
+        return false;
+    }
+    return true;
+}
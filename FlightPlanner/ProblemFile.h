@@ -0,0 +1,123 @@
+#ifndef PROBLEMFILE_H
+#define PROBLEMFILE_H
+
+#include <QFile>
+#include <QList>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+
+#include "PlanningProblem.h"
+#include "FlightTaskArea.h"
+#include "Position.h"
+
+class QIODevice;
+
+/**
+ * @brief The ProblemFile class reads and writes planning problems in a versioned container format. A file
+ * has a small header, a preview (area names, task counts, starting position), a table of contents and then
+ * one section per part of the problem: the problem's own settings and each FlightTaskArea with its tasks.
+ *
+ * open() reads only the header, preview and table of contents, so it's cheap enough for previews. The
+ * sections are only read when asked for with loadProblem() and loadArea().
+ *
+ * Every section records its own version. Readers skip sections of kinds they don't know and ignore any
+ * bytes at the end of a section that a newer writer appended, so new fields and section kinds can be added
+ * without breaking older readers. A file whose minimum reader version is newer than ours is refused.
+ */
+class ProblemFile
+{
+public:
+    ProblemFile();
+    ~ProblemFile();
+
+    /**
+     * @brief write writes problem to device, which must be open for writing, along with the planner's
+     * saved results if there are any. Returns true on success, false on failure with an explanation in
+     * errorString.
+     */
+    static bool write(const PlanningProblem& problem, QIODevice * device, QString * errorString = 0,
+                      const QByteArray& plannerResults = QByteArray());
+
+    /**
+     * @brief isProblemFile returns true if device, open for reading, is positioned at the start of a
+     * problem file. It only peeks, so nothing is consumed.
+     */
+    static bool isProblemFile(QIODevice * device);
+
+    /**
+     * @brief load reads the whole problem from filePath, which may also be in the bare QDataStream format
+     * used before ProblemFile, and the planner results saved with it if plannerResults is given. Returns
+     * null on failure with an explanation in errorString.
+     */
+    static QSharedPointer<PlanningProblem> load(const QString& filePath, QByteArray * plannerResults = 0,
+                                                QString * errorString = 0);
+
+    /**
+     * @brief open reads the header, preview and table of contents of filePath and keeps the file open for
+     * loadProblem() and loadArea(). Returns true on success, false on failure with an explanation in
+     * errorString.
+     */
+    bool open(const QString& filePath, QString * errorString = 0);
+    void close();
+    bool isOpen() const;
+
+    quint16 formatVersion() const;
+
+    //Preview, available once the file is open
+    int areaCount() const;
+    QString areaName(int area) const;
+    int taskCount(int area) const;
+    bool startingPositionDefined() const;
+    const Position& startingPosition() const;
+    QString summary() const;
+
+    /**
+     * @brief loadProblem returns the problem with its settings but none of its areas. Returns null on
+     * failure with an explanation in errorString.
+     */
+    QSharedPointer<PlanningProblem> loadProblem(QString * errorString = 0);
+
+    /**
+     * @brief loadArea reads one area and its tasks. Dependencies on tasks in areas loaded earlier are
+     * resolved right away, and those of earlier areas on this one's tasks are resolved now. Returns null on
+     * failure with an explanation in errorString.
+     */
+    QSharedPointer<FlightTaskArea> loadArea(int area, QString * errorString = 0);
+
+    /**
+     * @brief loadPlannerResults returns the planner results saved with the problem (see
+     * HierarchicalPlanner::saveResults()), or an empty array if there are none or they can't be read.
+     */
+    QByteArray loadPlannerResults(QString * errorString = 0);
+
+private:
+    struct Section
+    {
+        QString kind;
+        quint16 version;
+        qint64 offset;
+        qint64 length;
+    };
+
+    bool readSection(const Section& section, QByteArray * bytes, QString * errorString);
+
+    QFile _file;
+    quint16 _formatVersion;
+    qint64 _dataStart;
+
+    QStringList _areaNames;
+    QList<int> _taskCounts;
+    bool _startingPositionDefined;
+    Position _startingPosition;
+
+    QList<Section> _sections;
+    QList<int> _areaSections;
+    int _problemSection;
+    int _plannerResultsSection;
+
+    //The tasks of every area loaded so far, whose dependencies may still be waiting on later areas
+    QList<QWeakPointer<FlightTask> > _loadedTasks;
+};
+
+#endif // PROBLEMFILE_H
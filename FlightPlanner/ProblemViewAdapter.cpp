@@ -8,6 +8,12 @@ ProblemViewAdapter::ProblemViewAdapter(QSharedPointer<PlanningProblem> model,
                                        QObject *parent) :
     QObject(parent), _view(view)
 {
+    _areaChanges = new ChangeCoalescer(this);
+    connect(_areaChanges,
+            SIGNAL(changed()),
+            this,
+            SLOT(applyAreaChanges()));
+
     this->setModel(model);
 }
 
@@ -29,6 +35,10 @@ void ProblemViewAdapter::setModel(QSharedPointer<PlanningProblem> model)
             _startPosObject.clear();
 
         _areaObjects.clear();
+        _addedAreas.clear();
+        _removedAreas.clear();
+
+        disconnect(_model.data(), 0, this, 0);
     }
 
     _model = model;
@@ -48,9 +58,9 @@ void ProblemViewAdapter::setModel(QSharedPointer<PlanningProblem> model)
             SLOT(handleStartingOrientationChanged(UAVOrientation)));
 
     connect(conv,
-            SIGNAL(flighTaskAreaAdded(QSharedPointer<FlightTaskArea>)),
+            SIGNAL(flightTaskAreasAdded(QList<QSharedPointer<FlightTaskArea> >)),
             this,
-            SLOT(handleFlightTaskAreaAdded(QSharedPointer<FlightTaskArea>)));
+            SLOT(handleFlightTaskAreasAdded(QList<QSharedPointer<FlightTaskArea> >)));
     connect(conv,
             SIGNAL(flightTaskAreaRemoved(QSharedPointer<FlightTaskArea>)),
             this,
@@ -59,8 +69,8 @@ void ProblemViewAdapter::setModel(QSharedPointer<PlanningProblem> model)
     //Fire some fake events to force generation of the map graphics objects
     this->handleStartingPositionChanged(_model->startingPosition());
     this->handleStartingOrientationChanged(_model->startingOrientation());
-    foreach(const QSharedPointer<FlightTaskArea>& area, _model->areas())
-        this->handleFlightTaskAreaAdded(area);
+    this->handleFlightTaskAreasAdded(_model->areas().toList());
+    _areaChanges->flush();
 }
 
 //private slot
@@ -81,13 +91,10 @@ void ProblemViewAdapter::handleStartingOrientationChanged(const UAVOrientation &
 }
 
 //private slot
-void ProblemViewAdapter::handleFlightTaskAreaAdded(const QSharedPointer<FlightTaskArea> &area)
+void ProblemViewAdapter::handleFlightTaskAreasAdded(const QList<QSharedPointer<FlightTaskArea> > &areas)
 {
-    //This object needs the model so that it can delete the area in the model when needed
-    QSharedPointer<FlightTaskAreaMapObject> obj(new FlightTaskAreaMapObject(_model.toWeakRef(),
-                                                                            area));
-    _areaObjects.insert(obj);
-    _view->addObject(obj.data());
+    _addedAreas.append(areas);
+    _areaChanges->markChanged();
 }
 
 //private slot
@@ -96,13 +103,38 @@ void ProblemViewAdapter::handleFlightTaskAreaRemoved(const QSharedPointer<Flight
     if (area.isNull())
         return;
 
-    QWeakPointer<FlightTaskArea> weak = area.toWeakRef();
+    //An area that comes and goes within one turn never needs a map object
+    if (_addedAreas.removeAll(area) == 0)
+        _removedAreas.insert(area);
+    _areaChanges->markChanged();
+}
+
+//private slot
+void ProblemViewAdapter::applyAreaChanges()
+{
+    if (!_removedAreas.isEmpty())
+    {
+        QMutableSetIterator<QSharedPointer<FlightTaskAreaMapObject> > iter(_areaObjects);
+        while (iter.hasNext())
+        {
+            QSharedPointer<FlightTaskAreaMapObject> item = iter.next();
+            if (_removedAreas.contains(item->flightTaskArea().toStrongRef()))
+                iter.remove();
+        }
+        _removedAreas.clear();
+    }
 
-    QMutableSetIterator<QSharedPointer<FlightTaskAreaMapObject> > iter(_areaObjects);
-    while (iter.hasNext())
+    //Added to the scene in one batch, which matters when thousands of zones are imported at once
+    QList<MapGraphicsObject *> objects;
+    foreach(const QSharedPointer<FlightTaskArea>& area, _addedAreas)
     {
-        QSharedPointer<FlightTaskAreaMapObject> item = iter.next();
-        if (item->flightTaskArea() == weak)
-            iter.remove();
+        //This object needs the model so that it can delete the area in the model when needed
+        QSharedPointer<FlightTaskAreaMapObject> obj(new FlightTaskAreaMapObject(_model.toWeakRef(),
+                                                                                area));
+        _areaObjects.insert(obj);
+        objects.append(obj.data());
     }
+    _addedAreas.clear();
+    if (!objects.isEmpty())
+        _view->addObjects(objects);
 }
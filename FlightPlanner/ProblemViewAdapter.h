@@ -6,10 +6,16 @@
 #include <QSet>
 
 #include "PlanningProblem.h"
+#include "ChangeCoalescer.h"
 #include "MapGraphicsScene.h"
 #include "MapObjects/StartPosMapObject.h"
 #include "MapObjects/FlightTaskAreaMapObject.h"
 
+/**
+ * @brief The ProblemViewAdapter class keeps a map object on the scene for the problem's starting position and for
+ * each of its areas. Areas that come and go are collected and the scene is updated once per event-loop turn, so
+ * adding or removing many areas (one at a time or not) costs one pass over the map objects.
+ */
 class ProblemViewAdapter : public QObject
 {
     Q_OBJECT
@@ -27,8 +33,9 @@ private slots:
     void handleStartingPositionChanged(const Position& pos);
     void handleStartingOrientationChanged(const UAVOrientation& orientation);
 
-    void handleFlightTaskAreaAdded(const QSharedPointer<FlightTaskArea>& area);
+    void handleFlightTaskAreasAdded(const QList<QSharedPointer<FlightTaskArea> >& areas);
     void handleFlightTaskAreaRemoved(const QSharedPointer<FlightTaskArea>& area);
+    void applyAreaChanges();
 
 private:
     QSharedPointer<PlanningProblem> _model;
@@ -37,6 +44,11 @@ private:
     QSharedPointer<StartPosMapObject> _startPosObject;
 
     QSet<QSharedPointer<FlightTaskAreaMapObject> > _areaObjects;
+
+    //Areas added and removed since applyAreaChanges() last ran
+    QList<QSharedPointer<FlightTaskArea> > _addedAreas;
+    QSet<QSharedPointer<FlightTaskArea> > _removedAreas;
+    ChangeCoalescer * _areaChanges;
     
 };
 
@@ -0,0 +1,220 @@
+#include "PlanningProcessProtocol.h"
+
+#include <QDataStream>
+#include <QSharedMemory>
+#include <QtDebug>
+#include <QtEndian>
+
+#include <cstring>
+
+const char * const PlanningProcessProtocol::WORKER_ARGUMENT = "--planning-worker";
+
+//Pinned, like the planning service's, so that the payloads don't depend on which Qt built us
+const int PROTOCOL_STREAM_VERSION = QDataStream::Qt_4_8;
+
+//Our messages are a few hundred bytes; anything this long means the stream has come apart
+const quint32 MAX_MESSAGE_LENGTH = 16 * 1024 * 1024;
+
+//"FPFS"
+const quint32 FLIGHT_SEGMENT_MAGIC = 0x46504653;
+
+struct FlightSegmentHeader
+{
+    quint32 magic;
+    quint32 count;
+    quint32 capacity;
+
+    //Keeps the coordinate arrays that follow 8-byte aligned
+    quint32 reserved;
+};
+
+//non-member
+int flightSegmentBytes(int capacity)
+{
+    return sizeof(FlightSegmentHeader) + 3 * capacity * sizeof(double);
+}
+
+//static
+QByteArray PlanningProcessProtocol::frame(MessageType type, const QByteArray &payload)
+{
+    QByteArray toRet(HEADER_BYTES, 0);
+    qToBigEndian<quint32>(sizeof(quint16) + payload.size(), (uchar *) toRet.data());
+    qToBigEndian<quint16>(type, (uchar *) toRet.data() + sizeof(quint32));
+    toRet.append(payload);
+    return toRet;
+}
+
+//static
+qint64 PlanningProcessProtocol::frameSize(const QByteArray &header)
+{
+    if (header.size() < HEADER_BYTES)
+        return -1;
+
+    const quint32 length = qFromBigEndian<quint32>((const uchar *) header.constData());
+    if (length < sizeof(quint16) || length > MAX_MESSAGE_LENGTH)
+        return -1;
+    return sizeof(quint32) + length;
+}
+
+//static
+bool PlanningProcessProtocol::takeMessage(QByteArray *buffer, MessageType *type, QByteArray *payload)
+{
+    if (buffer->size() < HEADER_BYTES)
+        return false;
+
+    const qint64 size = PlanningProcessProtocol::frameSize(*buffer);
+    if (size < 0)
+    {
+        qWarning() << "Discarding" << buffer->size() << "bytes that aren't a planning process message";
+        buffer->clear();
+        return false;
+    }
+    if (buffer->size() < size)
+        return false;
+
+    *type = (MessageType) qFromBigEndian<quint16>((const uchar *) buffer->constData() + sizeof(quint32));
+    *payload = buffer->mid(HEADER_BYTES, size - HEADER_BYTES);
+    buffer->remove(0, size);
+    return true;
+}
+
+//static
+int PlanningProcessProtocol::streamVersion()
+{
+    return PROTOCOL_STREAM_VERSION;
+}
+
+//static
+bool PlanningProcessProtocol::writeProblem(QSharedMemory *segment, const QByteArray &problemBytes,
+                                           QString *errorString)
+{
+    //The first bytes say how many follow, since segments may be rounded up to whole pages
+    if (!segment->create(sizeof(quint32) + problemBytes.size()))
+    {
+        if (errorString)
+            *errorString = "Failed to create " + segment->key() + ": " + segment->errorString();
+        return false;
+    }
+
+    segment->lock();
+    uchar * data = (uchar *) segment->data();
+    qToBigEndian<quint32>(problemBytes.size(), data);
+    memcpy(data + sizeof(quint32), problemBytes.constData(), problemBytes.size());
+    segment->unlock();
+    return true;
+}
+
+//static
+QSharedPointer<PlanningProblem> PlanningProcessProtocol::readProblem(const QString &key, QString *errorString)
+{
+    QSharedPointer<PlanningProblem> toRet;
+
+    QSharedMemory segment(key);
+    if (!segment.attach(QSharedMemory::ReadOnly))
+    {
+        if (errorString)
+            *errorString = "Failed to attach to " + key + ": " + segment.errorString();
+        return toRet;
+    }
+
+    segment.lock();
+    const uchar * data = (const uchar *) segment.constData();
+    const quint32 length = qFromBigEndian<quint32>(data);
+    if (sizeof(quint32) + length <= (quint32) segment.size())
+    {
+        //Borrows the segment's bytes rather than copying them; the stream is done with them before we unlock
+        const QByteArray bytes = QByteArray::fromRawData((const char *) data + sizeof(quint32), length);
+        QDataStream stream(bytes);
+        stream.setVersion(PROTOCOL_STREAM_VERSION);
+        QSharedPointer<PlanningProblem> problem(new PlanningProblem(stream));
+        if (stream.status() == QDataStream::Ok)
+            toRet = problem;
+    }
+    segment.unlock();
+
+    if (toRet.isNull() && errorString)
+        *errorString = key + " doesn't hold a planning problem";
+    return toRet;
+}
+
+//static
+int PlanningProcessProtocol::flightCapacity(const QSharedMemory *segment)
+{
+    if (!segment->isAttached() || segment->size() < (int) sizeof(FlightSegmentHeader))
+        return 0;
+
+    //Set once when the segment is made, so there's no need to lock it
+    const FlightSegmentHeader * header = (const FlightSegmentHeader *) segment->constData();
+    if (header->magic != FLIGHT_SEGMENT_MAGIC)
+        return 0;
+    return header->capacity;
+}
+
+//static
+bool PlanningProcessProtocol::createFlightSegment(QSharedMemory *segment, int capacity, QString *errorString)
+{
+    if (!segment->create(flightSegmentBytes(capacity)))
+    {
+        if (errorString)
+            *errorString = "Failed to create " + segment->key() + ": " + segment->errorString();
+        return false;
+    }
+
+    segment->lock();
+    FlightSegmentHeader * header = (FlightSegmentHeader *) segment->data();
+    header->magic = FLIGHT_SEGMENT_MAGIC;
+    header->count = 0;
+    header->capacity = capacity;
+    header->reserved = 0;
+    segment->unlock();
+    return true;
+}
+
+//static
+bool PlanningProcessProtocol::writeFlight(QSharedMemory *segment, const QList<Position> &flight)
+{
+    if (flight.size() > flightCapacity(segment))
+        return false;
+
+    segment->lock();
+    FlightSegmentHeader * header = (FlightSegmentHeader *) segment->data();
+    double * longitudes = (double *) (header + 1);
+    double * latitudes = longitudes + header->capacity;
+    double * altitudes = latitudes + header->capacity;
+    for (int i = 0; i < flight.size(); i++)
+    {
+        const Position& pos = flight.at(i);
+        longitudes[i] = pos.longitude();
+        latitudes[i] = pos.latitude();
+        altitudes[i] = pos.altitude();
+    }
+    header->count = flight.size();
+    segment->unlock();
+    return true;
+}
+
+//static
+bool PlanningProcessProtocol::readFlight(QSharedMemory *segment, QList<Position> *flight)
+{
+    if (segment->size() < (int) sizeof(FlightSegmentHeader))
+        return false;
+
+    bool toRet = false;
+    segment->lock();
+    const FlightSegmentHeader * header = (const FlightSegmentHeader *) segment->constData();
+    if (header->magic == FLIGHT_SEGMENT_MAGIC && header->count <= header->capacity
+            && flightSegmentBytes(header->capacity) <= segment->size())
+    {
+        const double * longitudes = (const double *) (header + 1);
+        const double * latitudes = longitudes + header->capacity;
+        const double * altitudes = latitudes + header->capacity;
+
+        flight->clear();
+        flight->reserve(header->count);
+        for (quint32 i = 0; i < header->count; i++)
+            flight->append(Position(longitudes[i], latitudes[i], altitudes[i]));
+        toRet = true;
+    }
+    segment->unlock();
+    return toRet;
+}
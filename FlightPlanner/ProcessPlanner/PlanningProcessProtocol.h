@@ -0,0 +1,137 @@
+#ifndef PLANNINGPROCESSPROTOCOL_H
+#define PLANNINGPROCESSPROTOCOL_H
+
+#include <QByteArray>
+#include <QList>
+#include <QSharedPointer>
+#include <QString>
+#include <QtGlobal>
+
+#include "PlanningProblem.h"
+#include "Position.h"
+
+class QSharedMemory;
+
+/**
+ * @brief The PlanningProcessProtocol class is how a WorkerProcessPlanner and the PlanningProcessWorker it launches
+ * talk to each other.
+ *
+ * Small messages go over the worker's stdin and stdout: a 32-bit big-endian length, then a 16-bit big-endian
+ * message type and a payload. The planner sends Start and Pause. The worker answers with Statistics, BestFlight
+ * and Paused, each tagged with the run (one per Start) it's about.
+ *
+ * Bulky data goes through shared memory instead, and the messages only carry segment keys.
+ * - Problem snapshots: the planner writes each one to a segment, serialized the way the planning service and
+ *   the plan cache serialize problems.
+ * - Best flights: the worker keeps them in a segment as a small header followed by contiguous arrays of
+ *   longitudes, latitudes and altitudes, like FlightPath. A flight is written there once and read once, and
+ *   its waypoints are never streamed.
+ */
+class PlanningProcessProtocol
+{
+public:
+    enum MessageType
+    {
+        //Planner to worker
+        Start,
+        Pause,
+
+        //Worker to planner
+        Statistics,
+        BestFlight,
+        Paused
+    };
+
+    //FlightPlanner runs as a planning worker when started with this argument, followed by the key prefix
+    static const char * const WORKER_ARGUMENT;
+
+    //The length and type in front of every payload
+    static const int HEADER_BYTES = 6;
+
+    /**
+     * @brief frame returns one message, ready to be written to the other side
+     * @param type
+     * @param payload
+     * @return
+     */
+    static QByteArray frame(MessageType type, const QByteArray& payload = QByteArray());
+
+    /**
+     * @brief frameSize returns the size of the whole message that starts with header, or -1 if header can't be
+     * the start of one of ours
+     * @param header the message's first HEADER_BYTES
+     * @return
+     */
+    static qint64 frameSize(const QByteArray& header);
+
+    /**
+     * @brief takeMessage removes the first message from buffer if all of it has arrived, and returns false
+     * otherwise. A buffer that doesn't start with a plausible message is emptied.
+     * @param buffer bytes read from the other side so far
+     * @param type
+     * @param payload
+     * @return
+     */
+    static bool takeMessage(QByteArray * buffer, MessageType * type, QByteArray * payload);
+
+    /**
+     * @brief streamVersion is the QDataStream version of the (small) payloads
+     * @return
+     */
+    static int streamVersion();
+
+    /**
+     * @brief writeProblem creates segment, whose key must be set, and copies problemBytes into it. Returns false
+     * with an explanation in errorString on failure.
+     * @param segment
+     * @param problemBytes from PlanCache::problemBytes()
+     * @param errorString
+     * @return
+     */
+    static bool writeProblem(QSharedMemory * segment, const QByteArray& problemBytes, QString * errorString = 0);
+
+    /**
+     * @brief readProblem reads the problem in the segment called key. It's parsed straight from the shared
+     * memory, without copying the bytes first. Returns null with an explanation in errorString on failure.
+     * @param key
+     * @param errorString
+     * @return
+     */
+    static QSharedPointer<PlanningProblem> readProblem(const QString& key, QString * errorString = 0);
+
+    /**
+     * @brief flightCapacity returns how many waypoints a flight segment can hold
+     * @param segment
+     * @return
+     */
+    static int flightCapacity(const QSharedMemory * segment);
+
+    /**
+     * @brief createFlightSegment creates segment, whose key must be set, big enough for capacity waypoints.
+     * Returns false with an explanation in errorString on failure.
+     * @param segment
+     * @param capacity
+     * @param errorString
+     * @return
+     */
+    static bool createFlightSegment(QSharedMemory * segment, int capacity, QString * errorString = 0);
+
+    /**
+     * @brief writeFlight replaces the flight in segment, which must have room for it
+     * @param segment
+     * @param flight
+     * @return
+     */
+    static bool writeFlight(QSharedMemory * segment, const QList<Position>& flight);
+
+    /**
+     * @brief readFlight reads the flight in segment, which must be attached. Returns false if it isn't a
+     * flight segment.
+     * @param segment
+     * @param flight
+     * @return
+     */
+    static bool readFlight(QSharedMemory * segment, QList<Position> * flight);
+};
+
+#endif // PLANNINGPROCESSPROTOCOL_H
@@ -0,0 +1,305 @@
+#include "PlanningProcessWorker.h"
+
+#include <QDataStream>
+#include <QMetaObject>
+#include <QThread>
+#include <QtDebug>
+
+#include "HierarchicalPlanner/HierarchicalPlanner.h"
+
+//How often best flights and statistics are sent while planning, in milliseconds
+const int PUBLISH_INTERVAL = 200;
+
+//The waypoints the first flight segment has room for
+const int MIN_FLIGHT_CAPACITY = 1024;
+
+/*
+ * PlanningProcessInputThread reads stdin for the worker, which can't wait on it without a thread of its own on
+ * every platform. It reads one whole message at a time and hands it to the worker's thread.
+*/
+class PlanningProcessInputThread : public QThread
+{
+public:
+    explicit PlanningProcessInputThread(PlanningProcessWorker * worker) : QThread(worker), _worker(worker)
+    {
+    }
+
+    bool open()
+    {
+        return _input.open(0, QIODevice::ReadOnly | QIODevice::Unbuffered);
+    }
+
+protected:
+    //virtual from QThread
+    virtual void run()
+    {
+        forever
+        {
+            const QByteArray header = _read(PlanningProcessProtocol::HEADER_BYTES);
+            const qint64 size = PlanningProcessProtocol::frameSize(header);
+            if (size < 0)
+            {
+                if (!header.isEmpty())
+                    qWarning() << "Planning worker got something that isn't a message on stdin";
+                break;
+            }
+            const QByteArray rest = _read(size - header.size());
+            if (rest.size() < size - header.size())
+                break;
+
+            QMetaObject::invokeMethod(_worker, "handleInput", Qt::QueuedConnection,
+                                      Q_ARG(QByteArray, header + rest));
+        }
+        QMetaObject::invokeMethod(_worker, "handleInputClosed", Qt::QueuedConnection);
+    }
+
+private:
+    //Returns fewer than count bytes only at the end of the input
+    QByteArray _read(qint64 count)
+    {
+        QByteArray toRet(count, 0);
+        qint64 done = 0;
+        while (done < count)
+        {
+            const qint64 got = _input.read(toRet.data() + done, count - done);
+            if (got <= 0)
+                break;
+            done += got;
+        }
+        toRet.truncate(done);
+        return toRet;
+    }
+
+    PlanningProcessWorker * _worker;
+    QFile _input;
+};
+
+PlanningProcessWorker::PlanningProcessWorker(const QString &keyPrefix, QObject *parent) :
+    QObject(parent), _keyPrefix(keyPrefix), _run(0), _flightSegment(0), _flightSegments(0),
+    _flightChanged(false), _statisticsChanged(false)
+{
+    //On its own thread, so that we keep reading messages while it plans
+    _planner = new HierarchicalPlanner(QSharedPointer<PlanningProblem>(), this);
+    _planner->setExecutionMode(FlightPlanner::ThreadExecution);
+    connect(_planner,
+            SIGNAL(bestFlightSoFarChanged(QList<Position>)),
+            this,
+            SLOT(handleBestFlightChanged()));
+    connect(_planner,
+            SIGNAL(plannerStatisticsChanged(PlanningStatistics)),
+            this,
+            SLOT(handleStatisticsChanged()));
+    connect(_planner,
+            SIGNAL(plannerStatusChanged(FlightPlanner::PlanningStatus)),
+            this,
+            SLOT(handleStatusChanged(FlightPlanner::PlanningStatus)));
+
+    _publishTimer = new QTimer(this);
+    _publishTimer->setInterval(PUBLISH_INTERVAL);
+    connect(_publishTimer,
+            SIGNAL(timeout()),
+            this,
+            SLOT(handlePublishTimeout()));
+
+    _inputThread = new PlanningProcessInputThread(this);
+}
+
+PlanningProcessWorker::~PlanningProcessWorker()
+{
+    _planner->pausePlanning();
+    delete _planner;
+    _planner = 0;
+
+    //We only finish once stdin has closed, so the input thread is done or about to be
+    _inputThread->wait();
+
+    delete _flightSegment;
+    _flightSegment = 0;
+}
+
+bool PlanningProcessWorker::start()
+{
+    if (!_inputThread->open() || !_output.open(1, QIODevice::WriteOnly | QIODevice::Unbuffered))
+    {
+        qWarning() << "Planning worker failed to open stdin and stdout";
+        return false;
+    }
+    _inputThread->start();
+    return true;
+}
+
+//private slot
+void PlanningProcessWorker::handleInput(const QByteArray &message)
+{
+    QByteArray buffer = message;
+    PlanningProcessProtocol::MessageType type;
+    QByteArray payload;
+    if (!PlanningProcessProtocol::takeMessage(&buffer, &type, &payload))
+        return;
+
+    if (type == PlanningProcessProtocol::Start)
+        _start(payload);
+    else if (type == PlanningProcessProtocol::Pause)
+        _planner->pausePlanning();
+    else
+        qWarning() << "Planning worker ignoring unexpected message" << type;
+}
+
+//private slot
+void PlanningProcessWorker::handleInputClosed()
+{
+    _planner->pausePlanning();
+    this->finished();
+}
+
+//private slot
+void PlanningProcessWorker::handleBestFlightChanged()
+{
+    _flightChanged = true;
+}
+
+//private slot
+void PlanningProcessWorker::handleStatisticsChanged()
+{
+    _statisticsChanged = true;
+}
+
+//private slot
+void PlanningProcessWorker::handleStatusChanged(FlightPlanner::PlanningStatus status)
+{
+    if (status == FlightPlanner::Running)
+        _publishTimer->start();
+    else
+    {
+        //Whatever the planner found since we last published, then the news that that's all
+        _publishTimer->stop();
+        _publish();
+        if (status == FlightPlanner::Paused)
+            _sendPaused();
+    }
+}
+
+//private slot
+void PlanningProcessWorker::handlePublishTimeout()
+{
+    _publish();
+}
+
+//private
+void PlanningProcessWorker::_start(const QByteArray &payload)
+{
+    QDataStream stream(payload);
+    stream.setVersion(PlanningProcessProtocol::streamVersion());
+    quint32 run;
+    QString problemKey;
+    quint64 seed;
+    qint64 timeBudget;
+    qint32 nodeBudget;
+    PlannerTuning tuning;
+    stream >> run >> problemKey >> seed >> timeBudget >> nodeBudget >> tuning;
+    if (stream.status() != QDataStream::Ok)
+    {
+        qWarning() << "Planning worker got a damaged Start";
+        return;
+    }
+
+    //Anything still running belongs to a run the planner has given up on
+    _planner->pausePlanning();
+    _run = run;
+
+    //No problem means carrying on with the one we have
+    if (!problemKey.isEmpty())
+    {
+        QString error;
+        QSharedPointer<PlanningProblem> problem = PlanningProcessProtocol::readProblem(problemKey, &error);
+        if (problem.isNull())
+        {
+            qWarning() << "Planning worker failed to read its problem:" << error;
+            _sendPaused();
+            return;
+        }
+        _planner->setProblem(problem);
+    }
+
+    _planner->setRandomSeed(seed);
+    _planner->setTimeBudget(timeBudget);
+    _planner->setNodeBudget(nodeBudget);
+    _planner->setTuning(tuning);
+    _flightChanged = false;
+    _statisticsChanged = false;
+    _planner->startPlanning();
+
+    //It refuses problems it can't plan for
+    if (_planner->status() != FlightPlanner::Running)
+        _sendPaused();
+}
+
+//private
+void PlanningProcessWorker::_publish()
+{
+    if (_flightChanged)
+    {
+        _flightChanged = false;
+        _publishFlight();
+    }
+
+    if (_statisticsChanged)
+    {
+        _statisticsChanged = false;
+        QByteArray payload;
+        QDataStream stream(&payload, QIODevice::WriteOnly);
+        stream.setVersion(PlanningProcessProtocol::streamVersion());
+        stream << _run << _planner->statistics().counters();
+        _send(PlanningProcessProtocol::Statistics, payload);
+    }
+}
+
+//private
+void PlanningProcessWorker::_publishFlight()
+{
+    const QList<Position> flight = _planner->bestFlightSoFar();
+    const Fitness fitness = _planner->bestFitnessSoFar();
+
+    const int capacity = _flightSegment == 0 ? 0 : PlanningProcessProtocol::flightCapacity(_flightSegment);
+    if (_flightSegment == 0 || flight.size() > capacity)
+    {
+        int newCapacity = qMax<int>(MIN_FLIGHT_CAPACITY, 2 * capacity);
+        while (newCapacity < flight.size())
+            newCapacity *= 2;
+
+        //The GUI stays attached to the old one until it hears about this one, so it's safe to let go of it
+        QString error;
+        QSharedMemory * segment = new QSharedMemory(QString("%1-flight-%2").arg(_keyPrefix).arg(_flightSegments++));
+        if (!PlanningProcessProtocol::createFlightSegment(segment, newCapacity, &error))
+        {
+            qWarning() << "Planning worker failed to share its flight:" << error;
+            delete segment;
+            return;
+        }
+        delete _flightSegment;
+        _flightSegment = segment;
+    }
+    PlanningProcessProtocol::writeFlight(_flightSegment, flight);
+
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setVersion(PlanningProcessProtocol::streamVersion());
+    stream << _run << _flightSegment->key() << fitness.taskScore() << fitness.efficiencyScore();
+    _send(PlanningProcessProtocol::BestFlight, payload);
+}
+
+//private
+void PlanningProcessWorker::_sendPaused()
+{
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setVersion(PlanningProcessProtocol::streamVersion());
+    stream << _run;
+    _send(PlanningProcessProtocol::Paused, payload);
+}
+
+//private
+void PlanningProcessWorker::_send(PlanningProcessProtocol::MessageType type, const QByteArray &payload)
+{
+    _output.write(PlanningProcessProtocol::frame(type, payload));
+}
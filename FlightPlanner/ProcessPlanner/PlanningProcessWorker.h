@@ -0,0 +1,76 @@
+#ifndef PLANNINGPROCESSWORKER_H
+#define PLANNINGPROCESSWORKER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QObject>
+#include <QSharedMemory>
+#include <QString>
+#include <QTimer>
+
+#include "FlightPlanner.h"
+#include "PlanningProcessProtocol.h"
+
+class PlanningProcessInputThread;
+
+/**
+ * @brief The PlanningProcessWorker class is the worker end of a WorkerProcessPlanner: it runs in the process
+ * the planner started, plans with a HierarchicalPlanner as the messages on stdin say, and answers on stdout.
+ *
+ * Best flights and statistics are sent at most every PUBLISH_INTERVAL, however often the planner improves,
+ * and once more when it pauses. Flights are written to a shared memory segment that's replaced by one twice the
+ * size whenever a flight outgrows it. The worker finishes when stdin closes, which is also what happens when
+ * the GUI goes away without saying goodbye.
+ */
+class PlanningProcessWorker : public QObject
+{
+    Q_OBJECT
+public:
+    /**
+     * @brief PlanningProcessWorker makes a worker whose shared memory keys start with keyPrefix
+     * @param keyPrefix
+     * @param parent
+     */
+    explicit PlanningProcessWorker(const QString& keyPrefix, QObject *parent = 0);
+    virtual ~PlanningProcessWorker();
+
+    /**
+     * @brief start starts reading stdin. Returns false if stdin or stdout can't be opened.
+     * @return
+     */
+    bool start();
+
+signals:
+    void finished();
+
+private slots:
+    void handleInput(const QByteArray& message);
+    void handleInputClosed();
+    void handleBestFlightChanged();
+    void handleStatisticsChanged();
+    void handleStatusChanged(FlightPlanner::PlanningStatus status);
+    void handlePublishTimeout();
+
+private:
+    void _start(const QByteArray& payload);
+    void _publish();
+    void _publishFlight();
+    void _sendPaused();
+    void _send(PlanningProcessProtocol::MessageType type, const QByteArray& payload);
+
+    QString _keyPrefix;
+    FlightPlanner * _planner;
+    PlanningProcessInputThread * _inputThread;
+    QFile _output;
+    QTimer * _publishTimer;
+
+    //The run (from the last Start) that everything we send is about
+    quint32 _run;
+
+    QSharedMemory * _flightSegment;
+    int _flightSegments;
+    bool _flightChanged;
+    bool _statisticsChanged;
+};
+
+#endif // PLANNINGPROCESSWORKER_H
@@ -0,0 +1,318 @@
+#include "WorkerProcessPlanner.h"
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QMutexLocker>
+#include <QStringList>
+#include <QtDebug>
+
+#include "PlanCache.h"
+
+//How long doIteration() waits for news from the worker, in milliseconds
+const unsigned long NEWS_WAIT = 100;
+
+//How long a worker gets to quit by itself once its stdin is closed, in milliseconds
+const int WORKER_EXIT_TIMEOUT = 3000;
+
+WorkerProcessPlanner::WorkerProcessPlanner(QSharedPointer<PlanningProblem> prob, QObject *parent) :
+    FlightPlanner(prob, parent),
+    _worker(0), _workerLaunches(0), _problemSegment(0), _problemSnapshots(0), _workerHasProblem(false), _run(0),
+    _newsRun(0), _flightChanged(false), _countersChanged(false), _workerPaused(false), _workerGone(false)
+{
+    //Our shared memory keys have to differ from every other planner's, in this process and any other
+    static int instances = 0;
+    _keyPrefix = QString("FlightPlanner-%1-%2").arg(QCoreApplication::applicationPid()).arg(instances++);
+
+    //The planning thread only waits on the worker, but waiting on our own thread would stall the GUI
+    this->setExecutionMode(ThreadExecution);
+
+    connect(this,
+            SIGNAL(plannerStatusChanged(FlightPlanner::PlanningStatus)),
+            this,
+            SLOT(handleStatusChanged(FlightPlanner::PlanningStatus)));
+}
+
+WorkerProcessPlanner::~WorkerProcessPlanner()
+{
+    this->finishPlanningThread();
+    _stopWorker();
+    delete _problemSegment;
+    _problemSegment = 0;
+}
+
+//protected
+//virtual from FlightPlanner
+void WorkerProcessPlanner::doStart()
+{
+    //Whatever the worker still has to say about earlier runs is ignored from here on
+    QMutexLocker lock(&_newsLock);
+    _newsRun = ++_run;
+    _flightChanged = false;
+    _countersChanged = false;
+    _workerPaused = false;
+    _workerGone = false;
+    lock.unlock();
+
+    if (!_startWorker() || !_writeProblemSnapshot())
+    {
+        //doIteration() pauses us
+        lock.relock();
+        _workerGone = true;
+        return;
+    }
+
+    //Resuming a run the worker already has the problem for
+    QString problemKey;
+    if (!_workerHasProblem)
+        problemKey = _problemSegment->key();
+
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setVersion(PlanningProcessProtocol::streamVersion());
+    stream << _run << problemKey << this->randomSeed() << this->timeBudget() << (qint32) this->nodeBudget();
+    stream << this->runTuning();
+    _send(PlanningProcessProtocol::Start, payload);
+    _workerHasProblem = true;
+}
+
+//protected
+//virtual from FlightPlanner
+void WorkerProcessPlanner::doIteration()
+{
+    QMutexLocker lock(&_newsLock);
+    if (!_flightChanged && !_countersChanged && !_workerPaused && !_workerGone)
+        _news.wait(&_newsLock, NEWS_WAIT);
+
+    const bool flightChanged = _flightChanged;
+    const QString flightKey = _flightKey;
+    const Fitness flightFitness = _flightFitness;
+    const bool countersChanged = _countersChanged;
+    const QMap<QString, qint64> counters = _counters;
+    const bool finished = _workerPaused || _workerGone;
+    _flightChanged = false;
+    _countersChanged = false;
+    lock.unlock();
+
+    if (flightChanged)
+        _readBestFlight(flightKey, flightFitness);
+
+    if (countersChanged)
+    {
+        QMap<QString, qint64>::const_iterator iter;
+        for (iter = counters.constBegin(); iter != counters.constEnd(); iter++)
+            this->workingStatistics()->setCounter(iter.key(), iter.value());
+    }
+
+    if (finished)
+        this->pausePlanning();
+}
+
+//protected
+//virtual from FlightPlanner
+void WorkerProcessPlanner::doReset()
+{
+    //The worker starts over with a fresh copy of the problem next time, and stays around until then
+    if (_worker != 0 && _worker->state() == QProcess::Running)
+        _send(PlanningProcessProtocol::Pause);
+    _workerHasProblem = false;
+
+    QMutexLocker lock(&_newsLock);
+    _newsRun = 0;
+    _flightKey.clear();
+    _flightChanged = false;
+    _counters.clear();
+    _countersChanged = false;
+    lock.unlock();
+
+    //The planning thread has finished, so the segment is ours
+    _flightSegment.detach();
+}
+
+//private slot
+void WorkerProcessPlanner::handleWorkerOutput()
+{
+    _received.append(_worker->readAllStandardOutput());
+
+    PlanningProcessProtocol::MessageType type;
+    QByteArray payload;
+    while (PlanningProcessProtocol::takeMessage(&_received, &type, &payload))
+        _handleMessage(type, payload);
+}
+
+//private slot
+void WorkerProcessPlanner::handleWorkerFinished()
+{
+    qWarning() << "Planning worker exited unexpectedly with code" << _worker->exitCode();
+
+    QMutexLocker lock(&_newsLock);
+    _workerGone = true;
+    _news.wakeAll();
+}
+
+//private slot
+void WorkerProcessPlanner::handleStatusChanged(FlightPlanner::PlanningStatus status)
+{
+    if (status == Paused && _worker != 0 && _worker->state() == QProcess::Running)
+        _send(PlanningProcessProtocol::Pause);
+}
+
+//private
+bool WorkerProcessPlanner::_startWorker()
+{
+    if (_worker != 0 && _worker->state() == QProcess::Running)
+        return true;
+    _stopWorker();
+
+    _worker = new QProcess(this);
+    //Its stdout is our channel, but what it logs should go where ours does
+    _worker->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    connect(_worker,
+            SIGNAL(readyReadStandardOutput()),
+            this,
+            SLOT(handleWorkerOutput()));
+    connect(_worker,
+            SIGNAL(finished(int,QProcess::ExitStatus)),
+            this,
+            SLOT(handleWorkerFinished()));
+
+    //A dead worker may have left segments behind, so every worker gets keys of its own
+    const QString workerPrefix = QString("%1-%2").arg(_keyPrefix).arg(_workerLaunches++);
+    _worker->start(QCoreApplication::applicationFilePath(),
+                   QStringList() << PlanningProcessProtocol::WORKER_ARGUMENT << workerPrefix);
+    if (!_worker->waitForStarted())
+    {
+        qWarning() << "Failed to start planning worker:" << _worker->errorString();
+        _stopWorker();
+        return false;
+    }
+
+    _received.clear();
+    _workerHasProblem = false;
+    return true;
+}
+
+//private
+void WorkerProcessPlanner::_stopWorker()
+{
+    if (_worker == 0)
+        return;
+
+    //It's going on purpose, so handleWorkerFinished() shouldn't hear about it
+    _worker->disconnect(this);
+    if (_worker->state() != QProcess::NotRunning)
+    {
+        //Closing its stdin asks it to quit
+        _worker->closeWriteChannel();
+        if (!_worker->waitForFinished(WORKER_EXIT_TIMEOUT))
+        {
+            _worker->kill();
+            _worker->waitForFinished();
+        }
+    }
+    delete _worker;
+    _worker = 0;
+}
+
+//private
+bool WorkerProcessPlanner::_writeProblemSnapshot()
+{
+    const QByteArray bytes = PlanCache::problemBytes(*this->problem());
+    const QByteArray hash = QCryptographicHash::hash(bytes, QCryptographicHash::Sha1);
+    if (_problemSegment != 0 && hash == _problemHash)
+        return true;
+
+    QString error;
+    QSharedMemory * segment = new QSharedMemory(QString("%1-problem-%2").arg(_keyPrefix).arg(_problemSnapshots++));
+    if (!PlanningProcessProtocol::writeProblem(segment, bytes, &error))
+    {
+        qWarning() << "Failed to share the problem with the planning worker:" << error;
+        delete segment;
+        return false;
+    }
+
+    /*
+     * If the worker hasn't read the old snapshot yet, it was for a run we've moved on from. Failing to read it
+     * only makes the worker report that run paused, and we ignore that.
+    */
+    delete _problemSegment;
+    _problemSegment = segment;
+    _problemHash = hash;
+    _workerHasProblem = false;
+    return true;
+}
+
+//private
+void WorkerProcessPlanner::_send(PlanningProcessProtocol::MessageType type, const QByteArray &payload)
+{
+    _worker->write(PlanningProcessProtocol::frame(type, payload));
+}
+
+//private
+void WorkerProcessPlanner::_handleMessage(PlanningProcessProtocol::MessageType type, const QByteArray &payload)
+{
+    QDataStream stream(payload);
+    stream.setVersion(PlanningProcessProtocol::streamVersion());
+    quint32 run;
+    stream >> run;
+
+    QMutexLocker lock(&_newsLock);
+    if (stream.status() != QDataStream::Ok || run != _newsRun)
+        return;
+
+    if (type == PlanningProcessProtocol::BestFlight)
+    {
+        QString key;
+        qreal taskScore;
+        qreal efficiencyScore;
+        stream >> key >> taskScore >> efficiencyScore;
+        if (stream.status() != QDataStream::Ok)
+            return;
+        _flightKey = key;
+        _flightFitness = Fitness(taskScore, efficiencyScore);
+        _flightChanged = true;
+    }
+    else if (type == PlanningProcessProtocol::Statistics)
+    {
+        QMap<QString, qint64> counters;
+        stream >> counters;
+        if (stream.status() != QDataStream::Ok)
+            return;
+        _counters = counters;
+        _countersChanged = true;
+    }
+    else if (type == PlanningProcessProtocol::Paused)
+        _workerPaused = true;
+    else
+    {
+        qWarning() << "Ignoring unexpected message" << type << "from the planning worker";
+        return;
+    }
+    _news.wakeAll();
+}
+
+//private
+//Runs on the planning thread
+void WorkerProcessPlanner::_readBestFlight(const QString &key, const Fitness &fitness)
+{
+    //The worker moves the flight to a bigger segment when it outgrows the one it's in
+    if (_flightSegment.key() != key || !_flightSegment.isAttached())
+    {
+        _flightSegment.setKey(key);
+        if (!_flightSegment.attach(QSharedMemory::ReadOnly))
+        {
+            qWarning() << "Failed to attach to the planning worker's flight" << key << ":"
+                       << _flightSegment.errorString();
+            return;
+        }
+    }
+
+    QList<Position> flight;
+    if (!PlanningProcessProtocol::readFlight(&_flightSegment, &flight))
+    {
+        qWarning() << key << "doesn't hold a flight";
+        return;
+    }
+    if (this->setBestFlightSoFar(flight))
+        this->setBestFitnessSoFar(fitness);
+}
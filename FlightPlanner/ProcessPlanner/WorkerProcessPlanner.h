@@ -0,0 +1,86 @@
+#ifndef WORKERPROCESSPLANNER_H
+#define WORKERPROCESSPLANNER_H
+
+#include <QByteArray>
+#include <QMap>
+#include <QMutex>
+#include <QProcess>
+#include <QSharedMemory>
+#include <QWaitCondition>
+
+#include "FlightPlanner.h"
+#include "PlanningProcessProtocol.h"
+
+/**
+ * @brief The WorkerProcessPlanner class plans in another process: a copy of FlightPlanner started with
+ * PlanningProcessProtocol::WORKER_ARGUMENT, which runs a HierarchicalPlanner for us (see PlanningProcessWorker).
+ * A planner that crashes or runs out of memory then takes the worker down instead of the GUI, and the map
+ * stays responsive however hard the worker's threads are working.
+ *
+ * The worker is started the first time planning starts and kept for later runs. Each run hands it a snapshot of
+ * the problem in shared memory, rewritten only when the problem has changed. The worker's best flights come
+ * back through shared memory too, and show up here as if we'd found them ourselves. If the worker dies, we keep
+ * the best flight it had sent, pause, and start a new worker the next time planning starts.
+ */
+class WorkerProcessPlanner : public FlightPlanner
+{
+    Q_OBJECT
+public:
+    explicit WorkerProcessPlanner(QSharedPointer<PlanningProblem> prob = QSharedPointer<PlanningProblem>(),
+                                  QObject *parent = 0);
+    virtual ~WorkerProcessPlanner();
+
+protected:
+    //virtual from FlightPlanner
+    virtual void doStart();
+
+    //virtual from FlightPlanner
+    virtual void doIteration();
+
+    //virtual from FlightPlanner
+    virtual void doReset();
+
+private slots:
+    void handleWorkerOutput();
+    void handleWorkerFinished();
+    void handleStatusChanged(FlightPlanner::PlanningStatus status);
+
+private:
+    bool _startWorker();
+    void _stopWorker();
+    bool _writeProblemSnapshot();
+    void _send(PlanningProcessProtocol::MessageType type, const QByteArray& payload = QByteArray());
+    void _handleMessage(PlanningProcessProtocol::MessageType type, const QByteArray& payload);
+    void _readBestFlight(const QString& key, const Fitness& fitness);
+
+    //Only our own thread touches these
+    QProcess * _worker;
+    QString _keyPrefix;
+    int _workerLaunches;
+    QByteArray _received;
+    QSharedMemory * _problemSegment;
+    QByteArray _problemHash;
+    int _problemSnapshots;
+    bool _workerHasProblem;
+    quint32 _run;
+
+    /*
+     * What the worker has told us about the current run, waiting for doIteration() on the planning thread.
+     * _newsLock guards them, and _news is woken whenever they change.
+    */
+    QMutex _newsLock;
+    QWaitCondition _news;
+    quint32 _newsRun;
+    QString _flightKey;
+    Fitness _flightFitness;
+    bool _flightChanged;
+    QMap<QString, qint64> _counters;
+    bool _countersChanged;
+    bool _workerPaused;
+    bool _workerGone;
+
+    //Only the planning thread touches this one
+    QSharedMemory _flightSegment;
+};
+
+#endif // WORKERPROCESSPLANNER_H
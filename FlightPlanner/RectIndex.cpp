@@ -0,0 +1,128 @@
+#include "RectIndex.h"
+
+#include <QPair>
+#include <algorithm>
+#include <cmath>
+
+//Children per node
+const int FANOUT = 8;
+
+RectIndex::RectIndex()
+{
+}
+
+void RectIndex::build(const QVector<QRectF> &rects)
+{
+    this->clear();
+    if (rects.isEmpty())
+        return;
+
+    QVector<Node> leaves(rects.size());
+    for (int i = 0; i < rects.size(); i++)
+    {
+        const QRectF rect = rects.at(i).normalized();
+        Node& leaf = leaves[i];
+        leaf.minX = rect.left();
+        leaf.minY = rect.top();
+        leaf.maxX = rect.right();
+        leaf.maxY = rect.bottom();
+        leaf.first = i;
+        leaf.count = 0;
+    }
+    _levels.append(leaves);
+
+    //Sort-tile-recursive: cut the level into vertical slices by x, sort each slice by y, and give every run of
+    //FANOUT nodes a parent. The level is reordered in place so that each parent's children are contiguous.
+    while (_levels.last().size() > 1)
+    {
+        QVector<Node>& level = _levels.last();
+        const int parentCount = (level.size() + FANOUT - 1) / FANOUT;
+        const int sliceCount = (int) ceil(sqrt((qreal) parentCount));
+        const int sliceSize = sliceCount * FANOUT;
+
+        std::sort(level.begin(), level.end(), _centerXLess);
+        for (int start = 0; start < level.size(); start += sliceSize)
+        {
+            const int end = qMin<int>(start + sliceSize, level.size());
+            std::sort(level.begin() + start, level.begin() + end, _centerYLess);
+        }
+
+        QVector<Node> parents;
+        parents.reserve(parentCount);
+        for (int start = 0; start < level.size(); start += FANOUT)
+            parents.append(_bounds(level, start, qMin<int>(FANOUT, level.size() - start)));
+        _levels.append(parents);
+    }
+}
+
+void RectIndex::clear()
+{
+    _levels.clear();
+}
+
+bool RectIndex::isEmpty() const
+{
+    return _levels.isEmpty();
+}
+
+void RectIndex::intersecting(const QRectF &rect, QVector<int> *output) const
+{
+    if (output == 0 || _levels.isEmpty())
+        return;
+
+    const QRectF query = rect.normalized();
+    const qreal minX = query.left();
+    const qreal minY = query.top();
+    const qreal maxX = query.right();
+    const qreal maxY = query.bottom();
+
+    //Depth-first. Each entry is (level, node).
+    QVector<QPair<int, int> > stack;
+    stack.append(qMakePair(_levels.size() - 1, 0));
+    while (!stack.isEmpty())
+    {
+        const QPair<int, int> entry = stack.last();
+        stack.pop_back();
+
+        const Node& node = _levels.at(entry.first).at(entry.second);
+        if (node.maxX < minX || node.minX > maxX || node.maxY < minY || node.minY > maxY)
+            continue;
+
+        if (entry.first == 0)
+            output->append(node.first);
+        else
+        {
+            for (int i = 0; i < node.count; i++)
+                stack.append(qMakePair(entry.first - 1, node.first + i));
+        }
+    }
+}
+
+//private static
+RectIndex::Node RectIndex::_bounds(const QVector<Node> &nodes, int first, int count)
+{
+    Node toRet = nodes.at(first);
+    for (int i = first + 1; i < first + count; i++)
+    {
+        const Node& node = nodes.at(i);
+        toRet.minX = qMin<qreal>(toRet.minX, node.minX);
+        toRet.minY = qMin<qreal>(toRet.minY, node.minY);
+        toRet.maxX = qMax<qreal>(toRet.maxX, node.maxX);
+        toRet.maxY = qMax<qreal>(toRet.maxY, node.maxY);
+    }
+    toRet.first = first;
+    toRet.count = count;
+    return toRet;
+}
+
+//private static
+bool RectIndex::_centerXLess(const Node &a, const Node &b)
+{
+    return a.minX + a.maxX < b.minX + b.maxX;
+}
+
+//private static
+bool RectIndex::_centerYLess(const Node &a, const Node &b)
+{
+    return a.minY + a.maxY < b.minY + b.maxY;
+}
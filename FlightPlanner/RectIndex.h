@@ -0,0 +1,61 @@
+#ifndef RECTINDEX_H
+#define RECTINDEX_H
+
+#include <QtGlobal>
+#include <QRectF>
+#include <QVector>
+
+/**
+ * @brief The RectIndex class is a static R-tree over a set of rectangles: it finds the ones that overlap a query
+ * rectangle without checking all of them.
+ *
+ * The tree is bulk-loaded with sort-tile-recursive packing, so every node is full and siblings barely overlap.
+ * It can't be edited, only rebuilt. Rectangles are closed, so ones that only touch (or have no area, like the
+ * bounds of a single point) still count as overlapping.
+ *
+ * RectIndex is a value type and cheap to copy.
+ */
+class RectIndex
+{
+public:
+    RectIndex();
+
+    /**
+     * @brief build replaces the contents of the index. Rectangles are identified by their index in rects.
+     * @param rects
+     */
+    void build(const QVector<QRectF>& rects);
+
+    void clear();
+
+    bool isEmpty() const;
+
+    /**
+     * @brief intersecting appends the id of every rectangle that overlaps rect.
+     * @param rect
+     * @param output
+     */
+    void intersecting(const QRectF& rect, QVector<int> * output) const;
+
+private:
+    struct Node
+    {
+        qreal minX;
+        qreal minY;
+        qreal maxX;
+        qreal maxY;
+
+        //Leaves: the rectangle's id. Otherwise: the first child in the level below.
+        int first;
+        int count;
+    };
+
+    static Node _bounds(const QVector<Node>& nodes, int first, int count);
+    static bool _centerXLess(const Node& a, const Node& b);
+    static bool _centerYLess(const Node& a, const Node& b);
+
+    //_levels.first() are the leaves, _levels.last() has just the root
+    QVector<QVector<Node> > _levels;
+};
+
+#endif // RECTINDEX_H
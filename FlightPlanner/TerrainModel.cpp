@@ -0,0 +1,315 @@
+#include "TerrainModel.h"
+
+#include <QDir>
+#include <QFile>
+#include <QMutexLocker>
+#include <QScopedPointer>
+#include <QtDebug>
+#include <QtEndian>
+#include <QtNumeric>
+#include <cmath>
+#include <limits>
+
+//Samples with no data (voids) in SRTM tiles
+const qint16 HGT_VOID = -32768;
+
+//Tile sizes (samples on a side) we accept: 3 arc-second and 1 arc-second SRTM
+const int HGT_SIZES[] = {1201, 3601};
+
+/**
+ * One mapped HGT tile. Unmapped when the last holder lets go of it.
+ */
+class TerrainModel::Tile
+{
+public:
+    Tile(QFile * file, uchar * data, int size, int longitude, int latitude) :
+        file(file), data(data), size(size), longitude(longitude), latitude(latitude)
+    {
+    }
+
+    ~Tile()
+    {
+        file->unmap(data);
+    }
+
+    inline int sample(int row, int column) const
+    {
+        return qFromBigEndian<qint16>(data + 2 * (row * size + column));
+    }
+
+    QScopedPointer<QFile> file;
+    uchar * data;
+
+    //Samples on a side. Row 0 is the north edge and column 0 the west edge.
+    int size;
+
+    //South-west corner, in whole degrees
+    int longitude;
+    int latitude;
+};
+
+TerrainModel::PathCheck::PathCheck() :
+    points(0), unknown(0), violations(0), firstViolation(-1),
+    highestElevation(-std::numeric_limits<qreal>::infinity())
+{
+}
+
+TerrainModel::TerrainModel(const QString &directory, int maxMappedTiles) :
+    _directory(directory), _maxMappedTiles(qMax(1, maxMappedTiles)), _tilesMapped(0), _tilesEvicted(0)
+{
+}
+
+TerrainModel::~TerrainModel()
+{
+}
+
+const QString &TerrainModel::directory() const
+{
+    return _directory;
+}
+
+int TerrainModel::maxMappedTiles() const
+{
+    return _maxMappedTiles;
+}
+
+bool TerrainModel::elevationAt(const Position &pos, qreal *elevationOut) const
+{
+    const int key = _tileKey(pos.longitude(), pos.latitude());
+    if (key < 0)
+        return false;
+
+    const QSharedPointer<const Tile> tile = this->_tile(key);
+    return !tile.isNull() && _interpolate(*tile, pos.longitude(), pos.latitude(), elevationOut);
+}
+
+void TerrainModel::elevationAt(const QList<Position> &points, QVector<qreal> *elevationsOut) const
+{
+    elevationsOut->resize(points.size());
+    qreal * elevations = elevationsOut->data();
+
+    //Consecutive points are nearly always on the same tile, so only look it up again when they leave it
+    int currentKey = -1;
+    QSharedPointer<const Tile> tile;
+    for (int i = 0; i < points.size(); i++)
+    {
+        const Position& pos = points.at(i);
+        const int key = _tileKey(pos.longitude(), pos.latitude());
+        if (key != currentKey)
+        {
+            currentKey = key;
+            tile = (key < 0) ? QSharedPointer<const Tile>() : this->_tile(key);
+        }
+        if (tile.isNull() || !_interpolate(*tile, pos.longitude(), pos.latitude(), elevations + i))
+            elevations[i] = qQNaN();
+    }
+}
+
+void TerrainModel::elevationAt(const qreal *longitudes, const qreal *latitudes, int count, qreal *elevationsOut) const
+{
+    int currentKey = -1;
+    QSharedPointer<const Tile> tile;
+    for (int i = 0; i < count; i++)
+    {
+        const int key = _tileKey(longitudes[i], latitudes[i]);
+        if (key != currentKey)
+        {
+            currentKey = key;
+            tile = (key < 0) ? QSharedPointer<const Tile>() : this->_tile(key);
+        }
+        if (tile.isNull() || !_interpolate(*tile, longitudes[i], latitudes[i], elevationsOut + i))
+            elevationsOut[i] = qQNaN();
+    }
+}
+
+TerrainModel::PathCheck TerrainModel::checkPath(const QList<Position> &path,
+                                                qreal maxElevation,
+                                                bool stopAtFirstViolation) const
+{
+    PathCheck toRet;
+    int currentKey = -1;
+    QSharedPointer<const Tile> tile;
+    for (int i = 0; i < path.size(); i++)
+    {
+        const Position& pos = path.at(i);
+        const int key = _tileKey(pos.longitude(), pos.latitude());
+        if (key != currentKey)
+        {
+            currentKey = key;
+            tile = (key < 0) ? QSharedPointer<const Tile>() : this->_tile(key);
+        }
+
+        toRet.points++;
+        qreal elevation;
+        if (tile.isNull() || !_interpolate(*tile, pos.longitude(), pos.latitude(), &elevation))
+        {
+            toRet.unknown++;
+            continue;
+        }
+
+        toRet.highestElevation = qMax(toRet.highestElevation, elevation);
+        if (elevation <= maxElevation)
+            continue;
+
+        if (toRet.firstViolation < 0)
+            toRet.firstViolation = i;
+        toRet.violations++;
+        if (stopAtFirstViolation)
+            break;
+    }
+    return toRet;
+}
+
+//static
+QString TerrainModel::tileName(int longitude, int latitude)
+{
+    return QString("%1%2%3%4.hgt")
+            .arg(latitude < 0 ? 'S' : 'N')
+            .arg(qAbs(latitude), 2, 10, QChar('0'))
+            .arg(longitude < 0 ? 'W' : 'E')
+            .arg(qAbs(longitude), 3, 10, QChar('0'));
+}
+
+quint64 TerrainModel::tilesMapped() const
+{
+    QMutexLocker locker(&_lock);
+    return _tilesMapped;
+}
+
+quint64 TerrainModel::tilesEvicted() const
+{
+    QMutexLocker locker(&_lock);
+    return _tilesEvicted;
+}
+
+quint64 TerrainModel::tilesMissing() const
+{
+    QMutexLocker locker(&_lock);
+    return _missing.size();
+}
+
+//private static
+int TerrainModel::_tileKey(qreal longitude, qreal latitude)
+{
+    if (!(longitude >= -180.0 && longitude <= 180.0 && latitude >= -90.0 && latitude <= 90.0))
+        return -1;
+
+    //The north and east edges of the globe belong to the tiles below and left of them
+    const int lonIndex = qMin(179, (int) floor(longitude));
+    const int latIndex = qMin(89, (int) floor(latitude));
+    return (latIndex + 90) * 360 + (lonIndex + 180);
+}
+
+//private static
+bool TerrainModel::_interpolate(const TerrainModel::Tile &tile, qreal longitude, qreal latitude, qreal *elevationOut)
+{
+    const int last = tile.size - 1;
+    const qreal column = (longitude - tile.longitude) * last;
+    const qreal row = (tile.latitude + 1 - latitude) * last;
+    const int c = qBound(0, (int) floor(column), last - 1);
+    const int r = qBound(0, (int) floor(row), last - 1);
+    const qreal fx = qBound<qreal>(0.0, column - c, 1.0);
+    const qreal fy = qBound<qreal>(0.0, row - r, 1.0);
+
+    const int samples[4] = {tile.sample(r, c), tile.sample(r, c + 1), tile.sample(r + 1, c), tile.sample(r + 1, c + 1)};
+    const qreal weights[4] = {(1.0 - fx) * (1.0 - fy), fx * (1.0 - fy), (1.0 - fx) * fy, fx * fy};
+
+    qreal elevation = 0.0;
+    qreal highest = -std::numeric_limits<qreal>::infinity();
+    int valid = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        if (samples[i] == HGT_VOID)
+            continue;
+        elevation += weights[i] * samples[i];
+        highest = qMax<qreal>(highest, samples[i]);
+        valid++;
+    }
+
+    if (valid == 0)
+        return false;
+
+    //Next to a void we can't interpolate, so err on the high side
+    *elevationOut = (valid == 4) ? elevation : highest;
+    return true;
+}
+
+//private
+QSharedPointer<const TerrainModel::Tile> TerrainModel::_tile(int key) const
+{
+    {
+        QMutexLocker locker(&_lock);
+        QHash<int, QSharedPointer<const Tile> >::const_iterator found = _tiles.constFind(key);
+        if (found != _tiles.constEnd())
+        {
+            if (_recentlyUsed.last() != key)
+            {
+                _recentlyUsed.removeOne(key);
+                _recentlyUsed.append(key);
+            }
+            return found.value();
+        }
+        if (_missing.contains(key))
+            return QSharedPointer<const Tile>();
+    }
+
+    //Opening and mapping the file doesn't need the lock, so other threads' lookups aren't held up by it
+    const QSharedPointer<const Tile> mapped = this->_mapTile(key);
+
+    QMutexLocker locker(&_lock);
+    if (mapped.isNull())
+    {
+        _missing.insert(key);
+        return mapped;
+    }
+
+    //Another thread may have mapped it meanwhile. Ours is unmapped as it goes out of scope.
+    if (_tiles.contains(key))
+        return _tiles.value(key);
+
+    _tiles.insert(key, mapped);
+    _recentlyUsed.append(key);
+    _tilesMapped++;
+    while (_tiles.size() > _maxMappedTiles)
+    {
+        _tiles.remove(_recentlyUsed.takeFirst());
+        _tilesEvicted++;
+    }
+    return mapped;
+}
+
+//private
+QSharedPointer<const TerrainModel::Tile> TerrainModel::_mapTile(int key) const
+{
+    const int longitude = key % 360 - 180;
+    const int latitude = key / 360 - 90;
+    const QString name = TerrainModel::tileName(longitude, latitude);
+    const QDir dir(_directory);
+
+    QScopedPointer<QFile> file(new QFile(dir.filePath(name)));
+    if (!file->exists())
+        file->setFileName(dir.filePath(name.toLower()));
+    if (!file->open(QFile::ReadOnly))
+        return QSharedPointer<const Tile>();
+
+    int size = 0;
+    for (int i = 0; i < (int) (sizeof(HGT_SIZES) / sizeof(HGT_SIZES[0])); i++)
+    {
+        if (file->size() == (qint64) HGT_SIZES[i] * HGT_SIZES[i] * 2)
+            size = HGT_SIZES[i];
+    }
+    if (size == 0)
+    {
+        qWarning() << "Terrain tile" << file->fileName() << "is" << file->size() << "bytes, not an SRTM tile";
+        return QSharedPointer<const Tile>();
+    }
+
+    uchar * data = file->map(0, file->size());
+    if (data == 0)
+    {
+        qWarning() << "Failed to map terrain tile" << file->fileName() << ":" << file->errorString();
+        return QSharedPointer<const Tile>();
+    }
+
+    return QSharedPointer<const Tile>(new Tile(file.take(), data, size, longitude, latitude));
+}
@@ -0,0 +1,128 @@
+#ifndef TERRAINMODEL_H
+#define TERRAINMODEL_H
+
+#include <QtGlobal>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QSet>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+
+#include "Position.h"
+
+/**
+ * @brief The TerrainModel class answers "how high is the ground here" from a directory of SRTM HGT elevation
+ * tiles (e.g. N40W112.hgt): one-degree squares of big-endian 16-bit samples in meters above sea level, 1201 or
+ * 3601 samples on a side. Elevations between samples are interpolated bilinearly.
+ *
+ * Tiles are memory-mapped rather than read, so only the pages a query touches are ever loaded, and at most
+ * maxMappedTiles() of them are mapped at once. The least recently used one is unmapped to make room for another.
+ * Tiles that aren't in the directory (SRTM has none over the sea) have no elevation.
+ *
+ * A TerrainModel is safe to query from many threads at once. The batch queries look up each run of points on
+ * the same tile once, so checking a flight waypoint by waypoint costs little more than the interpolation.
+ */
+class TerrainModel
+{
+public:
+    //What checkPath() found
+    struct PathCheck
+    {
+        PathCheck();
+
+        //Waypoints checked, those with no elevation data and those where the ground is above the limit
+        int points;
+        int unknown;
+        int violations;
+
+        //Index of the first violation, or -1
+        int firstViolation;
+
+        //Highest ground under the path, of the points with data. -infinity if none had any.
+        qreal highestElevation;
+    };
+
+    /**
+     * @brief TerrainModel
+     * @param directory where the .hgt tiles are. Tile names are matched in upper or lower case.
+     * @param maxMappedTiles how many tiles may be mapped at once (at least 1). A 3601-sample tile takes 25 MB of
+     * address space, though only the pages that are read take memory.
+     */
+    TerrainModel(const QString& directory, int maxMappedTiles = 16);
+    ~TerrainModel();
+
+    const QString& directory() const;
+    int maxMappedTiles() const;
+
+    /**
+     * @brief elevationAt returns the ground elevation (in meters above sea level) under pos
+     * @param pos
+     * @param elevationOut set to the elevation if there is data for pos
+     * @return false if there is no tile for pos, or no valid samples around it
+     */
+    bool elevationAt(const Position& pos, qreal * elevationOut) const;
+
+    /**
+     * @brief elevationAt looks up many points at once. Points with no data get NaN (see qIsNaN()).
+     * @param points
+     * @param elevationsOut resized to points.size()
+     */
+    void elevationAt(const QList<Position>& points, QVector<qreal> * elevationsOut) const;
+    void elevationAt(const qreal * longitudes, const qreal * latitudes, int count, qreal * elevationsOut) const;
+
+    /**
+     * @brief checkPath checks that the ground under every waypoint of path is no higher than maxElevation, which
+     * is usually the altitude flown less the clearance required. Waypoints with no data don't count as
+     * violations.
+     * @param path
+     * @param maxElevation
+     * @param stopAtFirstViolation returns as soon as one violation is found, leaving the rest of path unchecked
+     * @return
+     */
+    TerrainModel::PathCheck checkPath(const QList<Position>& path,
+                                      qreal maxElevation,
+                                      bool stopAtFirstViolation = false) const;
+
+    /**
+     * @brief tileName returns the name of the tile whose south-west corner is at the given whole degrees,
+     * e.g. "N40W112.hgt"
+     */
+    static QString tileName(int longitude, int latitude);
+
+    //How many tiles have been mapped, unmapped to make room, and looked for but not found
+    quint64 tilesMapped() const;
+    quint64 tilesEvicted() const;
+    quint64 tilesMissing() const;
+
+private:
+    class Tile;
+
+    //Index of the tile holding the point, or -1 if it's off the globe
+    static int _tileKey(qreal longitude, qreal latitude);
+    static bool _interpolate(const Tile& tile, qreal longitude, qreal latitude, qreal * elevationOut);
+
+    /**
+     * @brief _tile returns the tile with the given key, mapping it if need be, or null if there's no such tile.
+     * The tile stays mapped for as long as the caller holds it, even if it's evicted meanwhile.
+     */
+    QSharedPointer<const Tile> _tile(int key) const;
+    QSharedPointer<const Tile> _mapTile(int key) const;
+
+    const QString _directory;
+    const int _maxMappedTiles;
+
+    //The mapped tiles, and their keys from least to most recently used
+    mutable QMutex _lock;
+    mutable QHash<int, QSharedPointer<const Tile> > _tiles;
+    mutable QList<int> _recentlyUsed;
+    mutable QSet<int> _missing;
+
+    mutable quint64 _tilesMapped;
+    mutable quint64 _tilesEvicted;
+
+    Q_DISABLE_COPY(TerrainModel)
+};
+
+#endif // TERRAINMODEL_H
@@ -0,0 +1,233 @@
+#ifndef TRANSPOSITIONTABLE_H
+#define TRANSPOSITIONTABLE_H
+
+#include <QtGlobal>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QVector>
+#include <cstring>
+
+/**
+ * @brief The TranspositionTable class remembers a value (e.g., a score) for search states that have been
+ * reached before, so that a planner that reaches the same state through a different branch can reuse it.
+ *
+ * States are identified by a 64-bit key that the planner builds with mix(), usually as a rolling hash over the
+ * path or over a quantized summary of the state. The table holds at most capacity() entries and evicts the
+ * least recently used one when it's full.
+ *
+ * Lookups and inserts lock, so jobs on a thread pool can share one table.
+ */
+template <typename T>
+class TranspositionTable
+{
+public:
+    explicit TranspositionTable(int capacity = 65536) : _capacity(qMax<int>(0, capacity)), _hits(0), _misses(0)
+    {
+        this->clear();
+    }
+
+    int capacity() const
+    {
+        return _capacity;
+    }
+
+    /**
+     * @brief setCapacity changes the maximum number of entries and empties the table. 0 disables it: nothing is
+     * stored and every lookup misses.
+     * @param capacity
+     */
+    void setCapacity(int capacity)
+    {
+        QMutexLocker locker(&_mutex);
+        _capacity = qMax<int>(0, capacity);
+        _clear();
+    }
+
+    /**
+     * @brief lookup copies the value stored for key into value and returns true, or returns false if there
+     * isn't one. Counts as a hit or miss.
+     * @param key
+     * @param value
+     * @return
+     */
+    bool lookup(quint64 key, T * value)
+    {
+        QMutexLocker locker(&_mutex);
+        const int slot = _slots.value(key, -1);
+        if (slot < 0)
+        {
+            _misses++;
+            return false;
+        }
+
+        _hits++;
+        _touch(slot);
+        if (value)
+            *value = _entries.at(slot).value;
+        return true;
+    }
+
+    /**
+     * @brief insert stores value for key, replacing what was there. Evicts the least recently used entry if the
+     * table is full.
+     * @param key
+     * @param value
+     */
+    void insert(quint64 key, const T& value)
+    {
+        QMutexLocker locker(&_mutex);
+        if (_capacity == 0)
+            return;
+
+        int slot = _slots.value(key, -1);
+        if (slot < 0)
+        {
+            if (_entries.size() < _capacity)
+            {
+                slot = _entries.size();
+                _entries.append(Entry());
+            }
+            else
+            {
+                slot = _tail;
+                _unlink(slot);
+                _slots.remove(_entries.at(slot).key);
+            }
+            _entries[slot].key = key;
+            _slots.insert(key, slot);
+            _pushFront(slot);
+        }
+        else
+            _touch(slot);
+        _entries[slot].value = value;
+    }
+
+    void clear()
+    {
+        QMutexLocker locker(&_mutex);
+        _clear();
+    }
+
+    int size() const
+    {
+        QMutexLocker locker(&_mutex);
+        return _entries.size();
+    }
+
+    quint64 hits() const
+    {
+        QMutexLocker locker(&_mutex);
+        return _hits;
+    }
+
+    quint64 misses() const
+    {
+        QMutexLocker locker(&_mutex);
+        return _misses;
+    }
+
+    void resetCounters()
+    {
+        QMutexLocker locker(&_mutex);
+        _hits = 0;
+        _misses = 0;
+    }
+
+    /**
+     * @brief mix folds one more value into a rolling key. Start from 0.
+     * @param key
+     * @param value
+     * @return
+     */
+    static quint64 mix(quint64 key, qint64 value)
+    {
+        quint64 toRet = key ^ ((quint64) value + Q_UINT64_C(0x9e3779b97f4a7c15) + (key << 6) + (key >> 2));
+        toRet ^= toRet >> 33;
+        toRet *= Q_UINT64_C(0xff51afd7ed558ccd);
+        toRet ^= toRet >> 33;
+        return toRet;
+    }
+
+    /**
+     * @brief mixExact folds a qreal into a rolling key bit for bit, so only identical values give the same key
+     * @param key
+     * @param value
+     * @return
+     */
+    static quint64 mixExact(quint64 key, qreal value)
+    {
+        //+0.0 and -0.0 are the same position
+        if (value == 0.0)
+            value = 0.0;
+        qint64 bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return mix(key, bits);
+    }
+
+private:
+    struct Entry
+    {
+        quint64 key;
+        T value;
+
+        //Neighbours in the recency list, most recent first. -1 at either end.
+        int previous;
+        int next;
+    };
+
+    void _clear()
+    {
+        _slots.clear();
+        _entries.clear();
+        _head = -1;
+        _tail = -1;
+    }
+
+    void _touch(int slot)
+    {
+        if (slot == _head)
+            return;
+        _unlink(slot);
+        _pushFront(slot);
+    }
+
+    void _unlink(int slot)
+    {
+        Entry& entry = _entries[slot];
+        if (entry.previous >= 0)
+            _entries[entry.previous].next = entry.next;
+        else
+            _head = entry.next;
+        if (entry.next >= 0)
+            _entries[entry.next].previous = entry.previous;
+        else
+            _tail = entry.previous;
+    }
+
+    void _pushFront(int slot)
+    {
+        Entry& entry = _entries[slot];
+        entry.previous = -1;
+        entry.next = _head;
+        if (_head >= 0)
+            _entries[_head].previous = slot;
+        _head = slot;
+        if (_tail < 0)
+            _tail = slot;
+    }
+
+    int _capacity;
+
+    QHash<quint64, int> _slots;
+    QVector<Entry> _entries;
+    int _head;
+    int _tail;
+
+    quint64 _hits;
+    quint64 _misses;
+
+    mutable QMutex _mutex;
+};
+
+#endif // TRANSPOSITIONTABLE_H
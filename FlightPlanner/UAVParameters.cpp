@@ -43,6 +43,18 @@ qreal UAVParameters::maxTurnAngle() const
     return _waypointInterval / _minTurningRadius;
 }
 
+bool UAVParameters::operator ==(const UAVParameters &other) const
+{
+    return (other._airspeed == _airspeed
+            && other._minTurningRadius == _minTurningRadius
+            && other._waypointInterval == _waypointInterval);
+}
+
+bool UAVParameters::operator !=(const UAVParameters &other) const
+{
+    return !(other == *this);
+}
+
 //non-member
 QDataStream& operator<<(QDataStream& stream, const UAVParameters& params)
 {
@@ -24,6 +24,9 @@ public:
      */
     qreal maxTurnAngle() const;
 
+    bool operator ==(const UAVParameters& other) const;
+    bool operator !=(const UAVParameters& other) const;
+
 private:
     qreal _airspeed;
     qreal _minTurningRadius;
@@ -0,0 +1,104 @@
+#include "LogPlaybackWidget.h"
+
+#include <QSlider>
+#include <QLabel>
+#include <QHBoxLayout>
+
+LogPlaybackWidget::LogPlaybackWidget(QWidget *parent) :
+    QWidget(parent), _drawnCount(0)
+{
+    this->setWindowTitle("Flight Log");
+
+    //The slider is in seconds from the start of the log
+    _slider = new QSlider(Qt::Horizontal, this);
+    _slider->setRange(0, 0);
+    _timeLabel = new QLabel(this);
+
+    QHBoxLayout * layout = new QHBoxLayout(this);
+    layout->addWidget(_slider, 1);
+    layout->addWidget(_timeLabel);
+
+    connect(_slider,
+            SIGNAL(valueChanged(int)),
+            this,
+            SLOT(handleSliderMoved(int)));
+}
+
+bool LogPlaybackWidget::load(const QString &filePath, QString *errorString)
+{
+    if (!_index.load(filePath, errorString))
+        return false;
+
+    if (_index.isEmpty())
+    {
+        if (errorString)
+            *errorString = "The log has no timestamped track points";
+        return false;
+    }
+
+    _time = QDateTime();
+    _drawnCount = -1;
+    _slider->blockSignals(true);
+    _slider->setRange(0, (int)(_index.startTime().msecsTo(_index.endTime()) / 1000));
+    _slider->setValue(0);
+    _slider->blockSignals(false);
+    this->setTime(_index.startTime());
+    return true;
+}
+
+QList<Position> LogPlaybackWidget::track() const
+{
+    QList<Position> toRet;
+    const double * longitudes = _index.longitudes();
+    const double * latitudes = _index.latitudes();
+    const double * heights = _index.heights();
+    for (int i = 0; i < _index.size(); i++)
+        toRet.append(Position(longitudes[i], latitudes[i], heights[i]));
+    return toRet;
+}
+
+QDateTime LogPlaybackWidget::time() const
+{
+    return _time;
+}
+
+int LogPlaybackWidget::drawnCount() const
+{
+    return _drawnCount;
+}
+
+//public slot
+void LogPlaybackWidget::setTime(const QDateTime &time)
+{
+    if (_index.isEmpty() || time == _time)
+        return;
+    _time = time;
+    this->updateTimeLabel();
+
+    const int count = _index.countUntil(time);
+    if (count != _drawnCount)
+    {
+        _drawnCount = count;
+        this->drawnCountChanged(count);
+    }
+
+    GPXPoint position;
+    if (_index.positionAt(time, &position))
+        this->aircraftMoved(Position(position.longitude, position.latitude, position.height));
+}
+
+//private slot
+void LogPlaybackWidget::handleSliderMoved(int seconds)
+{
+    this->setTime(_index.startTime().addMSecs(1000 * (qint64)seconds));
+}
+
+//private
+void LogPlaybackWidget::updateTimeLabel()
+{
+    const qint64 elapsed = _index.startTime().secsTo(_time);
+    _timeLabel->setText(QString("%1 (+%2:%3:%4)").arg(_time.toString("yyyy-MM-dd hh:mm:ss"))
+                        .arg(elapsed / 3600)
+                        .arg((elapsed / 60) % 60, 2, 10, QChar('0'))
+                        .arg(elapsed % 60, 2, 10, QChar('0')));
+}
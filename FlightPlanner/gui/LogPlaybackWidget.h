@@ -0,0 +1,65 @@
+#ifndef LOGPLAYBACKWIDGET_H
+#define LOGPLAYBACKWIDGET_H
+
+#include <QWidget>
+#include <QList>
+#include <QDateTime>
+
+#include "GPXTimeIndex.h"
+#include "Position.h"
+
+class QSlider;
+class QLabel;
+
+/**
+ * @brief The LogPlaybackWidget class scrubs through a recorded flight log. Dragging its slider moves the time
+ * being reviewed, and drawnCountChanged() tells a PathObject showing track() how much of it was flown by then.
+ *
+ * Each move is a binary search in the log's GPXTimeIndex, so scrubbing through logs hours long stays smooth.
+ */
+class LogPlaybackWidget : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit LogPlaybackWidget(QWidget *parent = 0);
+
+    /**
+     * @brief load replaces the log being reviewed and goes to its start. Returns true on success, false on
+     * failure with an explanation in errorString.
+     */
+    bool load(const QString& filePath, QString * errorString = 0);
+
+    /**
+     * @brief track returns every position in the log, in time order
+     */
+    QList<Position> track() const;
+
+    QDateTime time() const;
+
+    /**
+     * @brief drawnCount returns how many of track()'s positions were flown by time()
+     */
+    int drawnCount() const;
+
+signals:
+    void drawnCountChanged(int count);
+    void aircraftMoved(const Position& position);
+
+public slots:
+    void setTime(const QDateTime& time);
+
+private slots:
+    void handleSliderMoved(int seconds);
+
+private:
+    void updateTimeLabel();
+
+    GPXTimeIndex _index;
+    QDateTime _time;
+    int _drawnCount;
+
+    QSlider * _slider;
+    QLabel * _timeLabel;
+};
+
+#endif // LOGPLAYBACKWIDGET_H
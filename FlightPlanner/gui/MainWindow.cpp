@@ -4,40 +4,132 @@
 #include <QtDebug>
 #include <QMessageBox>
 #include <QFileDialog>
-#include <QDateTime>
+#include <QInputDialog>
+#include <QTimer>
+#include <QGraphicsView>
+#include <QSettings>
+#include <QCloseEvent>
+#include <QDir>
 
 #include "MapGraphicsView.h"
 #include "MapGraphicsScene.h"
 #include "tileSources/OSMTileSource.h"
 
 #include "HierarchicalPlanner/HierarchicalPlanner.h"
+#include "ProcessPlanner/WorkerProcessPlanner.h"
 
 #include "UAVParametersWidget.h"
 
 #include "Exporters/GPXExporter.h"
 #include "Importers/GPXImporter.h"
+#include "Exporters/BinaryExporter.h"
+#include "Exporters/PathCompressor.h"
+#include "Exporters/SegmentExporter.h"
+#include "Importers/BinaryImporter.h"
+#include "Importers/NoFlyZoneImporter.h"
+#include "GPX.h"
+#include "ProblemFile.h"
+#include "StartupTimer.h"
+
+//How far in meters an exported flight may stray from the planned one to save waypoints
+const qreal EXPORT_TOLERANCE = 1.0;
+
+//How often the tile caches' memory is charged to the allocation tracker, in milliseconds
+const int TILE_CACHE_ACCOUNTING_INTERVAL = 1000;
+
+//Where the map view is remembered between sessions
+const char * SETTINGS_ORGANIZATION = "FlightPlanner";
+const char * SETTINGS_APPLICATION = "FlightPlanner";
+const char * MAP_VIEW_STATE_KEY = "map/viewState";
+
+//Where finished plans are kept. Point it at a shared directory to share them with the planning service.
+const char * PLAN_CACHE_DIRECTORY_KEY = "planning/planCacheDirectory";
+
+//Set to plan in a separate worker process, which a planner crash or memory blowup can't take the GUI down with
+const char * OUT_OF_PROCESS_PLANNING_KEY = "planning/outOfProcess";
+
+//A profile written by the benchmarks' --auto-tune, to tune the planner for each problem's mission class
+const char * TUNING_PROFILE_KEY = "planning/tuningProfile";
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow),
     _view(0), _scene(0),
-    _planner(0), _viewAdapter(0)
+    _planner(0), _viewAdapter(0),
+    _displayedPath(0), _displayedFlightVersion(0), _telemetryTrack(0), _logPath(0),
+    _firstFrameWidget(0), _startupFinished(false),
+    _tileCacheMemory("MapTileCache")
 {
     ui->setupUi(this);
+    StartupTimer::mark("Main window widgets built");
+
+    QSettings settings(SETTINGS_ORGANIZATION, SETTINGS_APPLICATION);
+    _planCache.setDirectory(settings.value(PLAN_CACHE_DIRECTORY_KEY,
+                                           QDir::homePath() + "/.FlightPlanner/plans").toString());
+    const QString tuningProfilePath = settings.value(TUNING_PROFILE_KEY).toString();
+    QString tuningProfileError;
+    if (!tuningProfilePath.isEmpty() && !_tuningProfile.load(tuningProfilePath, &tuningProfileError))
+        qWarning() << "Planning with the default tuning:" << tuningProfileError;
 
     this->initMap();
+    StartupTimer::mark("Map view and tile sources set up");
     this->initPlanningProblem();
     this->initPaletteConnections();
     this->initPlanningControlConnections();
 
-    qsrand(QDateTime::currentMSecsSinceEpoch());
+    //The planner isn't needed to draw the map, so it waits until the first frame is up (see finishStartup()).
+    //The map is drawn by the view's internal QGraphicsView, so that's what gets the paint events.
+    QGraphicsView * mapViewport = _view->findChild<QGraphicsView *>();
+    _firstFrameWidget = (mapViewport != 0) ? mapViewport->viewport() : (QWidget *) _view;
+    _firstFrameWidget->installEventFilter(this);
 }
 
 MainWindow::~MainWindow()
 {
+    if (AllocationTracker::isEnabled())
+        AllocationTracker::dump();
     delete ui;
 }
 
+//protected
+//virtual from QObject
+bool MainWindow::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == _firstFrameWidget && event->type() == QEvent::Paint && !_startupFinished)
+    {
+        StartupTimer::mark("First map frame");
+        _startupFinished = true;
+        _firstFrameWidget->removeEventFilter(this);
+
+        //Let the frame reach the screen first
+        QTimer::singleShot(0, this, SLOT(finishStartup()));
+    }
+    return QMainWindow::eventFilter(watched, event);
+}
+
+//protected
+//virtual from QWidget
+void MainWindow::closeEvent(QCloseEvent *event)
+{
+    //Start up next time where we left off, with the tiles that were on screen warmed up
+    QSettings settings(SETTINGS_ORGANIZATION, SETTINGS_APPLICATION);
+    settings.setValue(MAP_VIEW_STATE_KEY, _view->saveViewState());
+    QMainWindow::closeEvent(event);
+}
+
+//public slot
+void MainWindow::addTelemetryFix(const Position &fix)
+{
+    //One object for the whole track, which keeps the newest fixes and repaints at its own pace
+    if (_telemetryTrack == 0)
+    {
+        _telemetryTrack = new TelemetryTrackObject();
+        _telemetryTrack->setZValue(110.0);
+        _scene->addObject(_telemetryTrack);
+    }
+    _telemetryTrack->addFix(fix);
+}
+
 //private slot
 void MainWindow::on_actionOpen_triggered()
 {
@@ -46,24 +138,28 @@ void MainWindow::on_actionOpen_triggered()
     if (filePath.isEmpty())
         return;
 
-    QFile fp(filePath);
-    if (!fp.exists())
+    if (!QFile::exists(filePath))
         return;
-    else if (!fp.open(QFile::ReadOnly))
+
+    QByteArray plannerResults;
+    QString errorString;
+    QSharedPointer<PlanningProblem> problem = ProblemFile::load(filePath, &plannerResults, &errorString);
+    if (problem.isNull())
     {
-        QMessageBox::warning(this, "Error", "Failed to open file for reading");
+        QMessageBox::warning(this, "Error", "Failed to load planning problem: " + errorString);
         return;
     }
 
-    QDataStream stream(&fp);
-    _problem = QSharedPointer<PlanningProblem>(new PlanningProblem(stream));
-    _planner->setProblem(_problem);
+    _problem = problem;
+    this->planner()->setProblem(_problem);
     _viewAdapter->setModel(_problem);
 
-    connect(_problem.data(),
-            SIGNAL(planningProblemChanged()),
-            _planner,
-            SLOT(resetPlanning()));
+    //Whatever was planned before the problem was saved doesn't have to be planned again
+    HierarchicalPlanner * hierarchical = qobject_cast<HierarchicalPlanner *>(this->planner());
+    if (hierarchical != 0 && !plannerResults.isEmpty() && !hierarchical->restoreResults(plannerResults))
+        qWarning() << "Ignoring damaged planner results in" << filePath;
+
+    this->connectProblemToPlanner();
 }
 
 //private slot
@@ -86,8 +182,15 @@ void MainWindow::on_actionSave_Planning_Problem_triggered()
         return;
     }
 
-    QDataStream stream(&fp);
-    _problem->serialize(stream);
+    //Save what the planner has worked out too, unless it's busy changing it
+    QByteArray plannerResults;
+    HierarchicalPlanner * hierarchical = qobject_cast<HierarchicalPlanner *>(this->planner());
+    if (hierarchical != 0 && hierarchical->status() != FlightPlanner::Running)
+        plannerResults = hierarchical->saveResults();
+
+    QString errorString;
+    if (!ProblemFile::write(*_problem, &fp, &errorString, plannerResults))
+        QMessageBox::warning(this, "Error", errorString);
 }
 
 //private slot
@@ -100,26 +203,20 @@ void MainWindow::on_actionSave_As_triggered()
 void MainWindow::on_actionNew_triggered()
 {
     _problem = QSharedPointer<PlanningProblem>(new PlanningProblem());
-    _planner->setProblem(_problem);
+    this->planner()->setProblem(_problem);
     _viewAdapter->setModel(_problem);
 
-    connect(_problem.data(),
-            SIGNAL(planningProblemChanged()),
-            _planner,
-            SLOT(resetPlanning()));
+    this->connectProblemToPlanner();
 }
 
 //private slot
 void MainWindow::on_actionClose_triggered()
 {
     _problem = QSharedPointer<PlanningProblem>(new PlanningProblem());
-    _planner->setProblem(_problem);
+    this->planner()->setProblem(_problem);
     _viewAdapter->setModel(_problem);
 
-    connect(_problem.data(),
-            SIGNAL(planningProblemChanged()),
-            _planner,
-            SLOT(resetPlanning()));
+    this->connectProblemToPlanner();
 }
 
 //private slot
@@ -128,41 +225,42 @@ void MainWindow::on_actionExport_Solution_triggered()
     const QString fileToWrite = QFileDialog::getSaveFileName(this,
                                                              "Select destination",
                                                              QString(),
-                                                             "GPX (*.gpx);;");
+                                                             "GPX (*.gpx);;Binary flight path (*.fpath);;Segment commands (*.segments);;");
     if (fileToWrite.isEmpty())
         return;
 
     const QFileInfo info(fileToWrite);
     const QString suffix = info.suffix().toLower();
-    const QList<Position>& solution = _planner->bestFlightSoFar();
+    const QList<Position>& solution = this->planner()->bestFlightSoFar();
+    const UAVParameters& params = _problem->uavParameters();
 
-    Exporter * exporter = 0;
+    //Most of the planned waypoints are in line with their neighbors, and autopilots don't need those
+    const PathCompressor compressor(params, EXPORT_TOLERANCE);
+
+    QScopedPointer<Exporter> exporter;
     if (suffix == "gpx")
-        exporter = new GPXExporter(solution);
+        exporter.reset(new GPXExporter(compressor.simplify(solution)));
+    else if (suffix == "fpath")
+        exporter.reset(new BinaryExporter(compressor.simplify(solution), params));
+    else if (suffix == "segments")
+        exporter.reset(new SegmentExporter(solution, params, EXPORT_TOLERANCE));
     else
     {
         QMessageBox::warning(this, "Invalid File Type", "Can't export to " + suffix + " file");
         return;
     }
 
-    QByteArray outBytes;
-    if (!exporter->doExport(&outBytes))
-    {
-        QMessageBox::warning(this, "Export Failed", "Unable to export due to unknown error.");
-        return;
-    }
-
-
     QFile fp(fileToWrite);
     if (!fp.open(QFile::WriteOnly))
     {
         QMessageBox::warning(this,"Export Failed", "Failed to open export file for writing.");
         return;
     }
-    const qint64 written = fp.write(outBytes);
-    if (written != outBytes.size())
+
+    QString errorString;
+    if (!exporter->doExport(&fp, &errorString))
     {
-        QMessageBox::warning(this, "Export Failed", "Failed to write all bytes.");
+        QMessageBox::warning(this, "Export Failed", errorString);
         return;
     }
 }
@@ -203,11 +301,38 @@ void MainWindow::on_actionImport_Solution_triggered()
     const QString fileToLoad = QFileDialog::getOpenFileName(this,
                                                             "Select import file",
                                                             QString(),
-                                                            "GPX (*.gpx);;");
+                                                            "GPX (*.gpx);;Binary flight path (*.fpath);;");
     if (fileToLoad.isEmpty())
         return;
 
-    QScopedPointer<GPXImporter> importer(new GPXImporter(fileToLoad));
+    QScopedPointer<Importer> importer;
+    if (QFileInfo(fileToLoad).suffix().toLower() == "fpath")
+        importer.reset(new BinaryImporter(fileToLoad));
+    else
+    {
+        GPXImporter * gpxImporter = new GPXImporter(fileToLoad);
+        importer.reset(gpxImporter);
+
+        //Logs with several tracks (e.g. one per sortie) only load the one that's asked for
+        QStringList trackNames;
+        if (GPX::readTrackNames(fileToLoad, &trackNames) && trackNames.size() > 1)
+        {
+            QStringList choices("All tracks");
+            for (int i = 0; i < trackNames.size(); i++)
+                choices.append(QString("%1: %2").arg(i + 1).arg(trackNames.at(i)));
+
+            bool ok = false;
+            const QString choice = QInputDialog::getItem(this, "Select track", "Track to import:",
+                                                         choices, 0, false, &ok);
+            if (!ok)
+                return;
+
+            const int track = choices.indexOf(choice) - 1;
+            if (track >= 0)
+                gpxImporter->setTracks(QList<int>() << track);
+        }
+    }
+
     if (!importer->doImport())
     {
         QMessageBox::warning(this,
@@ -217,10 +342,120 @@ void MainWindow::on_actionImport_Solution_triggered()
     }
 
     const QList<Position>& results = importer->results();
-    _planner->setBestFlightSoFar(results);
+    this->planner()->setBestFlightSoFar(results);
     this->updateDisplayedFlight();
 }
 
+//private slot
+void MainWindow::on_actionReview_Flight_Log_triggered()
+{
+    const QString fileToLoad = QFileDialog::getOpenFileName(this,
+                                                            "Select flight log",
+                                                            QString(),
+                                                            "GPX (*.gpx);;");
+    if (fileToLoad.isEmpty())
+        return;
+
+    LogPlaybackWidget * playback = new LogPlaybackWidget();
+    QString errorString;
+    if (!playback->load(fileToLoad, &errorString))
+    {
+        delete playback;
+        QMessageBox::warning(this, "Error", "Failed to load flight log: " + errorString);
+        return;
+    }
+
+    if (!_logPlayback.isNull())
+        _logPlayback->close();
+    _logPlayback = playback;
+
+    //Under the planned flight and telemetry, in a color that won't be mistaken for either
+    if (_logPath == 0)
+    {
+        _logPath = new PathObject(QList<Position>(), QColor(0, 200, 255));
+        _logPath->setMarkerRadius(0.0);
+
+        //Logs can wander far from where they start, so keep them at the same precision everywhere
+        _logPath->setPathEncoding(CompactPath::QuantizedInt32);
+        _logPath->setZValue(90.0);
+        _scene->addObject(_logPath);
+    }
+    _logPath->setPath(playback->track());
+    _logPath->setDrawnCount(playback->drawnCount());
+
+    connect(playback,
+            SIGNAL(drawnCountChanged(int)),
+            _logPath,
+            SLOT(setDrawnCount(int)));
+    connect(this,
+            SIGNAL(destroyed()),
+            playback,
+            SLOT(deleteLater()));
+    playback->setAttribute(Qt::WA_DeleteOnClose);
+    playback->show();
+}
+
+//private slot
+void MainWindow::on_actionRender_Profiler_triggered(bool checked)
+{
+    _view->setRenderProfiling(checked);
+    _view->setRenderProfileOverlay(checked);
+    this->ui->actionExport_Render_Profile->setEnabled(checked);
+}
+
+//private slot
+void MainWindow::on_actionExport_Render_Profile_triggered()
+{
+    MapRenderProfiler * profiler = _view->renderProfiler();
+    if (profiler == 0)
+        return;
+
+    //Grab it now, before the file dialog adds frames of its own
+    const QByteArray profile = profiler->toJson();
+
+    const QString fileToWrite = QFileDialog::getSaveFileName(this,
+                                                             "Select destination",
+                                                             QString(),
+                                                             "JSON (*.json);;");
+    if (fileToWrite.isEmpty())
+        return;
+
+    QFile fp(fileToWrite);
+    if (!fp.open(QFile::WriteOnly) || fp.write(profile) != profile.size())
+        QMessageBox::warning(this, "Error", "Failed to export render profile: " + fp.errorString());
+}
+
+//private slot
+void MainWindow::on_actionImport_No_Fly_Zones_triggered()
+{
+    const QString fileToLoad = QFileDialog::getOpenFileName(this,
+                                                            "Select no-fly zone file",
+                                                            QString(),
+                                                            "GeoJSON (*.geojson *.json);;Shapefile (*.shp);;");
+    if (fileToLoad.isEmpty())
+        return;
+
+    bool ok = false;
+    const qreal tolerance = QInputDialog::getDouble(this, "Simplify zones",
+                                                    "Simplify outlines to within (meters):",
+                                                    5.0, 0.0, 1000.0, 1, &ok);
+    if (!ok)
+        return;
+
+    NoFlyZoneImporter importer(fileToLoad);
+    importer.setSimplifyTolerance(tolerance);
+    if (!importer.doImport())
+    {
+        QMessageBox::warning(this,
+                             "Error",
+                             "Import failed: " + importer.errorString());
+        return;
+    }
+
+    //All at once, so the planner and the map only hear about one change
+    _problem->addTaskAreas(importer.results());
+}
+
 //private slot
 void MainWindow::on_actionSensor_Parameters_triggered()
 {
@@ -250,20 +485,40 @@ void MainWindow::handlePlanningStartRequested()
                                  "Planning cannot begin until a start point is defined");
         return;
     }
-    _planner->startPlanning();
+
+    //The problem may have changed class since the last run. Without a profile this is the default tuning.
+    this->planner()->setTuning(_tuningProfile.tuningFor(*_problem));
+
+    //A problem that's been planned before with these settings doesn't have to be planned again
+    HierarchicalPlanner * hierarchical = qobject_cast<HierarchicalPlanner *>(this->planner());
+    if (hierarchical != 0 && hierarchical->bestFlightSoFar().isEmpty())
+    {
+        const QByteArray key = this->planCacheKey();
+        PlanCache::Entry cached;
+        if (_planCache.lookup(key, &cached))
+        {
+            if (!cached.plannerResults.isEmpty() && !hierarchical->restoreResults(cached.plannerResults))
+                qWarning() << "Ignoring damaged planner results in the plan cache";
+            hierarchical->setBestFlightSoFar(cached.flight);
+            this->updateDisplayedFlight();
+            return;
+        }
+        _pendingPlanKey = key;
+    }
+    this->planner()->startPlanning();
 }
 
 //private slot
 void MainWindow::handlePlanningPauseRequested()
 {
-    _planner->pausePlanning();
+    this->planner()->pausePlanning();
 }
 
 //private slot
 void MainWindow::handlePlanningClearRequested()
 {
-    _planner->pausePlanning();
-    _planner->resetPlanning();
+    this->planner()->pausePlanning();
+    this->planner()->resetPlanning();
 }
 
 //private slot
@@ -278,7 +533,50 @@ void MainWindow::handlePlannerStatusChanged(FlightPlanner::PlanningStatus status
     this->ui->planningControlWidget->setPlanningState(status);
 
     if (status == FlightPlanner::Paused || status == FlightPlanner::Stopped)
+    {
         this->updateDisplayedFlight();
+        this->cacheFinishedPlan();
+    }
+}
+
+//private slot
+void MainWindow::handleBestFlightSoFarChanged()
+{
+    //Planners that improve their flight as they go (e.g. the hierarchical planner's scheduler) show each one
+    this->updateDisplayedFlight();
+}
+
+//private slot
+void MainWindow::finishStartup()
+{
+    this->planner();
+
+    //The tile sources live in MapGraphics, which doesn't know about the tracker, so we poll them
+    if (AllocationTracker::isEnabled())
+    {
+        QTimer * accountingTimer = new QTimer(this);
+        connect(accountingTimer,
+                SIGNAL(timeout()),
+                this,
+                SLOT(updateTileCacheAccounting()));
+        accountingTimer->start(TILE_CACHE_ACCOUNTING_INTERVAL);
+    }
+    StartupTimer::mark("Deferred initialization done");
+}
+
+//private slot
+void MainWindow::updateTileCacheAccounting()
+{
+    const QSharedPointer<MapTileSource> tileSource = _view->tileSource();
+    if (tileSource.isNull())
+    {
+        _tileCacheMemory.setBytes(0);
+        return;
+    }
+
+    //A composite source's statistics include its children's
+    const MapTileSource::CacheStatistics statistics = tileSource->cacheStatistics();
+    _tileCacheMemory.setBytes(statistics.memoryBytes + statistics.pendingBytes);
 }
 
 //private
@@ -293,12 +591,17 @@ void MainWindow::initMap()
     QSharedPointer<CompositeTileSource> composite(new CompositeTileSource());
     QSharedPointer<MapTileSource> osm(new OSMTileSource());
     composite->addSourceBottom(osm);
+    _coverageTiles = QSharedPointer<CoverageTileSource>(new CoverageTileSource());
+    composite->addSourceTop(_coverageTiles, 0.6);
     _view->setTileSource(composite);
 
     //Provide our "map layers" dock widget with the composite tile source to be configured
     this->ui->mapLayersWidget->setComposite(composite);
 
-    //Zoom into BYU campus by default
+    //Pick up where the last session left off. Otherwise zoom into BYU campus
+    QSettings settings(SETTINGS_ORGANIZATION, SETTINGS_APPLICATION);
+    if (_view->restoreViewState(settings.value(MAP_VIEW_STATE_KEY).toByteArray()))
+        return;
     QPointF place(-111.649253,40.249707);
     _view->setZoomLevel(15);
     _view->centerOn(place);
@@ -308,8 +611,24 @@ void MainWindow::initMap()
 void MainWindow::initPlanningProblem()
 {
     _problem = QSharedPointer<PlanningProblem>(new PlanningProblem());
+    _viewAdapter = new ProblemViewAdapter(_problem,
+                                          _scene,
+                                          this);
+}
+
+//private
+FlightPlanner *MainWindow::planner()
+{
+    if (_planner != 0)
+        return _planner;
+
     //_planner = new GreedyFlightPlanner(_problem, this);
-    _planner = new HierarchicalPlanner(_problem, this);
+    QSettings settings(SETTINGS_ORGANIZATION, SETTINGS_APPLICATION);
+    if (settings.value(OUT_OF_PROCESS_PLANNING_KEY, false).toBool())
+        _planner = new WorkerProcessPlanner(_problem, this);
+    else
+        _planner = new HierarchicalPlanner(_problem, this);
+    _planner->setExecutionMode(FlightPlanner::ThreadExecution);
     connect(_planner,
             SIGNAL(plannerStatusChanged(FlightPlanner::PlanningStatus)),
             this,
@@ -318,14 +637,64 @@ void MainWindow::initPlanningProblem()
             SIGNAL(plannerProgressChanged(qreal,quint32)),
             this,
             SLOT(handlePlannerProgressChanged(qreal,quint32)));
+    connect(_planner,
+            SIGNAL(bestFlightSoFarChanged(QList<Position>)),
+            this,
+            SLOT(handleBestFlightSoFarChanged()));
+    connect(_planner,
+            SIGNAL(plannerStatisticsChanged(PlanningStatistics)),
+            this->ui->planningControlWidget,
+            SLOT(setPlanningStatistics(PlanningStatistics)));
+    this->connectProblemToPlanner();
+    return _planner;
+}
+
+//private
+QByteArray MainWindow::planCacheKey()
+{
+    HierarchicalPlanner * hierarchical = qobject_cast<HierarchicalPlanner *>(this->planner());
+    if (hierarchical == 0)
+        return QByteArray();
+
+    //The command line's settings for the same planner, so both find each other's plans
+    return PlanCache::key(*_problem,
+                          PlanCache::configuration("hierarchical", hierarchical->randomSeed(),
+                                                   hierarchical->timeBudget(), hierarchical->scheduleTimeBudget(),
+                                                   hierarchical->scheduleImprovementTimeBudget(), false,
+                                                   hierarchical->tuning()));
+}
+
+//private
+void MainWindow::cacheFinishedPlan()
+{
+    if (_pendingPlanKey.isEmpty())
+        return;
+
+    //Only whole runs of the problem they started with. A paused run keeps its key until it's done.
+    HierarchicalPlanner * hierarchical = qobject_cast<HierarchicalPlanner *>(this->planner());
+    if (hierarchical == 0 || !hierarchical->lastRunCompleted() || this->planCacheKey() != _pendingPlanKey)
+        return;
+
+    PlanCache::Entry entry;
+    entry.flight = hierarchical->bestFlightSoFar();
+    entry.fitness = hierarchical->bestFitnessSoFar().combined();
+    entry.plannerResults = hierarchical->saveResults();
+
+    QString errorString;
+    if (!entry.flight.isEmpty() && !_planCache.store(_pendingPlanKey, entry, &errorString))
+        qWarning() << "Failed to cache the plan:" << errorString;
+    _pendingPlanKey.clear();
+}
+
+//private
+void MainWindow::connectProblemToPlanner()
+{
+    //The planner may have been created for this problem already, and the connection must only be made once
     connect(_problem.data(),
             SIGNAL(planningProblemChanged()),
-            _planner,
-            SLOT(resetPlanning()));
-
-    _viewAdapter = new ProblemViewAdapter(_problem,
-                                          _scene,
-                                          this);
+            this->planner(),
+            SLOT(resetPlanning()),
+            Qt::UniqueConnection);
 }
 
 //private
@@ -375,17 +744,22 @@ void MainWindow::initPlanningControlConnections()
 
 void MainWindow::updateDisplayedFlight()
 {
-    foreach(MapGraphicsObject * obj, _displayedPathObjects)
-        obj->deleteLater();
-    _displayedPathObjects.clear();
+    quint32 version;
+    const QList<Position> path = this->planner()->bestFlightSoFar(&version);
 
-    const QList<Position>& path = _planner->bestFlightSoFar();
-    foreach(const Position& pos, path)
+    //Queued bestFlightSoFarChanged() signals pile up while we're busy, and only the first has anything new
+    if (_displayedPath != 0 && version == _displayedFlightVersion)
+        return;
+    _displayedFlightVersion = version;
+    _coverageTiles->setCoverage(_problem->areas().toList(), path);
+
+    //The whole flight is one object that we update in place rather than one object per waypoint
+    if (_displayedPath == 0)
     {
-        CircleObject * obj = new CircleObject(5.0, true, QColor(255,255,0));
-        obj->setPos(pos.lonLat());
-        obj->setZValue(100.0);
-        _scene->addObject(obj);
-        _displayedPathObjects.append(obj);
+        _displayedPath = new PathObject(path, QColor(255,255,0));
+        _displayedPath->setZValue(100.0);
+        _scene->addObject(_displayedPath);
+        return;
     }
+    _displayedPath->setPath(path);
 }
@@ -4,12 +4,20 @@
 #include <QMainWindow>
 #include <QSharedPointer>
 #include <QList>
+#include <QPointer>
 
 #include "MapGraphicsView.h"
 #include "MapGraphicsScene.h"
 #include "PlanningProblem.h"
 #include "FlightPlanner.h"
 #include "ProblemViewAdapter.h"
+#include "PathObject.h"
+#include "TelemetryTrackObject.h"
+#include "AllocationTracker.h"
+#include "PlanCache.h"
+#include "PlannerTuningProfile.h"
+#include "LogPlaybackWidget.h"
+#include "MapObjects/CoverageTileSource.h"
 
 namespace Ui {
 class MainWindow;
@@ -22,6 +30,21 @@ class MainWindow : public QMainWindow
 public:
     explicit MainWindow(QWidget *parent = 0);
     ~MainWindow();
+
+public slots:
+    /**
+     * @brief addTelemetryFix shows the aircraft's latest position over the planned flight. Connect a telemetry
+     * feed straight to it, at whatever rate the fixes come.
+     * @param fix
+     */
+    void addTelemetryFix(const Position& fix);
+
+protected:
+    //virtual from QObject
+    virtual bool eventFilter(QObject * watched, QEvent * event);
+
+    //virtual from QWidget
+    virtual void closeEvent(QCloseEvent * event);
     
 private slots:
     //MainWindow actions
@@ -37,6 +60,10 @@ private slots:
     void on_actionUAV_Parameters_triggered();
     void on_actionSensor_Parameters_triggered();
     void on_actionImport_Solution_triggered();
+    void on_actionImport_No_Fly_Zones_triggered();
+    void on_actionReview_Flight_Log_triggered();
+    void on_actionRender_Profiler_triggered(bool checked);
+    void on_actionExport_Render_Profile_triggered();
 
     //Palette Widget actions
     void handleAddStartPointRequested();
@@ -50,6 +77,13 @@ private slots:
     //Planner events
     void handlePlannerProgressChanged(qreal fitness, quint32 iterations);
     void handlePlannerStatusChanged(FlightPlanner::PlanningStatus status);
+    void handleBestFlightSoFarChanged();
+
+    //Everything that can wait until the map has been drawn once
+    void finishStartup();
+
+    //Charges the tile caches' memory to the allocation tracker. Only runs while tracking is on.
+    void updateTileCacheAccounting();
 
 private:
     inline void initMap();
@@ -58,16 +92,58 @@ private:
     inline void initPlanningControlConnections();
     void updateDisplayedFlight();
 
+    /**
+     * @brief planner returns the planner, creating it (for the current problem) the first time it's needed
+     * @return
+     */
+    FlightPlanner * planner();
+    void connectProblemToPlanner();
+
+    /**
+     * @brief planCacheKey returns the PlanCache key of planning the current problem with the planner's settings,
+     * or an empty key if the planner's results can't be cached
+     * @return
+     */
+    QByteArray planCacheKey();
+
+    //Stores the planner's flight under _pendingPlanKey if the run that was started for it has finished
+    void cacheFinishedPlan();
+
     Ui::MainWindow *ui;
 
     MapGraphicsView * _view;
     MapGraphicsScene * _scene;
 
     QSharedPointer<PlanningProblem> _problem;
+    //Created by planner(). Use that instead.
     FlightPlanner * _planner;
     ProblemViewAdapter * _viewAdapter;
 
-    QList<MapGraphicsObject *> _displayedPathObjects;
+    PathObject * _displayedPath;
+    quint32 _displayedFlightVersion;
+
+    //Map layer showing how well the displayed flight covers the coverage tasks
+    QSharedPointer<CoverageTileSource> _coverageTiles;
+
+    //Created with the first telemetry fix
+    TelemetryTrackObject * _telemetryTrack;
+
+    //The flight log being reviewed, if any, and the track it draws. One log at a time.
+    QPointer<LogPlaybackWidget> _logPlayback;
+    PathObject * _logPath;
+
+    //Watched for the first map frame. Whether it's been drawn and finishStartup() scheduled.
+    QWidget * _firstFrameWidget;
+    bool _startupFinished;
+
+    AllocationScope _tileCacheMemory;
+
+    //Finished plans, and the key of the plan being planned if it's to be stored there when it's done
+    PlanCache _planCache;
+    QByteArray _pendingPlanKey;
+
+    //The planner's tuning for each class of problem, from TUNING_PROFILE_KEY
+    PlannerTuningProfile _tuningProfile;
 };
 
 #endif // MAINWINDOW_H
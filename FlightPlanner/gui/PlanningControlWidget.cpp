@@ -2,12 +2,43 @@
 #include "ui_PlanningControlWidget.h"
 
 #include <QtDebug>
+#include <QTreeWidgetItem>
+#include <QMapIterator>
+
+//How often the telemetry panel redraws, in milliseconds
+const int TELEMETRY_INTERVAL = 500;
+
+//non-member
+QString formatNsecs(qint64 nsecs)
+{
+    return QString::number(nsecs / 1.0e6, 'f', 1) + " ms";
+}
+
+//non-member
+QString formatCounter(const QString& name, qint64 value)
+{
+    if (!name.endsWith("Bytes"))
+        return QString::number(value);
+    if (value >= 1024 * 1024)
+        return QString::number(value / (1024.0 * 1024.0), 'f', 1) + " MiB";
+    return QString::number(value / 1024.0, 'f', 1) + " KiB";
+}
 
 PlanningControlWidget::PlanningControlWidget(QWidget *parent) :
     QWidget(parent),
-    ui(new Ui::PlanningControlWidget)
+    ui(new Ui::PlanningControlWidget),
+    _statisticsTime(0), _rateStates(0), _rateTime(0), _statesPerSecond(0.0)
 {
     ui->setupUi(this);
+
+    _telemetryTimer = new QTimer(this);
+    _telemetryTimer->setSingleShot(true);
+    _telemetryTimer->setInterval(TELEMETRY_INTERVAL);
+    connect(_telemetryTimer,
+            SIGNAL(timeout()),
+            this,
+            SLOT(updateTelemetry()));
+
     this->setPlanningState(FlightPlanner::Stopped);
 }
 
@@ -28,6 +59,7 @@ void PlanningControlWidget::setPlanningState(FlightPlanner::PlanningStatus statu
         this->ui->currentFitnessDisplay->setValue(0.0);
         this->ui->currentIterationSpinbox->setValue(0);
         this->ui->planProgressBar->setValue(0);
+        this->clearTelemetry();
     }
 }
 
@@ -75,6 +107,17 @@ void PlanningControlWidget::setIsRunning()
     this->setPlanningState(FlightPlanner::Running);
 }
 
+//public slot
+void PlanningControlWidget::setPlanningStatistics(const PlanningStatistics &statistics)
+{
+    //The statistics' clock keeps running, so remember how far along they were when they arrived
+    _statistics = statistics;
+    _statisticsTime = statistics.elapsed();
+
+    if (!_telemetryTimer->isActive())
+        _telemetryTimer->start();
+}
+
 //private slot
 void PlanningControlWidget::on_resetButton_clicked()
 {
@@ -92,3 +135,82 @@ void PlanningControlWidget::on_pauseButton_clicked()
 {
     this->planningPauseRequested();
 }
+
+//private slot
+void PlanningControlWidget::updateTelemetry()
+{
+    //Counters named "...Expanded" count search states, whatever the planner
+    qint64 states = 0;
+    QMapIterator<QString, qint64> iter(_statistics.counters());
+    while (iter.hasNext())
+    {
+        iter.next();
+        if (iter.key().endsWith("Expanded"))
+            states += iter.value();
+    }
+
+    //A new iteration or a reset restarts the statistics, and with them the rate
+    if (_statisticsTime < _rateTime || states < _rateStates)
+    {
+        _rateStates = 0;
+        _rateTime = 0;
+    }
+    if (_statisticsTime > _rateTime)
+    {
+        _statesPerSecond = (states - _rateStates) * 1.0e9 / (_statisticsTime - _rateTime);
+        _rateStates = states;
+        _rateTime = _statisticsTime;
+    }
+
+    QTreeWidget * tree = this->ui->telemetryTree;
+    tree->clear();
+
+    QTreeWidgetItem * progress = new QTreeWidgetItem(tree, QStringList("Progress"));
+    new QTreeWidgetItem(progress, QStringList() << "Elapsed" << formatNsecs(_statisticsTime));
+    new QTreeWidgetItem(progress, QStringList() << "States/sec" << QString::number(_statesPerSecond, 'f', 0));
+
+    //Hit rate of every cache that has both a hits and a misses counter
+    iter.toFront();
+    while (iter.hasNext())
+    {
+        iter.next();
+        if (!iter.key().endsWith("CacheHits"))
+            continue;
+        const QString cache = iter.key().left(iter.key().size() - 4);
+        const qint64 lookups = iter.value() + _statistics.counter(cache + "Misses");
+        if (lookups == 0)
+            continue;
+        new QTreeWidgetItem(progress, QStringList() << cache + " hit rate"
+                            << QString::number(100.0 * iter.value() / lookups, 'f', 1) + "%");
+    }
+
+    QTreeWidgetItem * stages = new QTreeWidgetItem(tree, QStringList("Stages"));
+    foreach(const PlanningStatistics::Span& span, _statistics.spans())
+        new QTreeWidgetItem(stages, QStringList() << span.name << formatNsecs(span.durationNsecs));
+    foreach(const PlanningStatistics::Span& span, _statistics.openSpans())
+        new QTreeWidgetItem(stages, QStringList() << span.name
+                            << formatNsecs(_statisticsTime - span.startNsecs) + " (running)");
+
+    QTreeWidgetItem * counters = new QTreeWidgetItem(tree, QStringList("Counters"));
+    iter.toFront();
+    while (iter.hasNext())
+    {
+        iter.next();
+        new QTreeWidgetItem(counters, QStringList() << iter.key() << formatCounter(iter.key(), iter.value()));
+    }
+
+    tree->expandAll();
+    tree->resizeColumnToContents(0);
+}
+
+//private
+void PlanningControlWidget::clearTelemetry()
+{
+    _telemetryTimer->stop();
+    _statistics.clear();
+    _statisticsTime = 0;
+    _rateStates = 0;
+    _rateTime = 0;
+    _statesPerSecond = 0.0;
+    this->ui->telemetryTree->clear();
+}
@@ -2,8 +2,10 @@
 #define PLANNINGCONTROLWIDGET_H
 
 #include <QWidget>
+#include <QTimer>
 
 #include "FlightPlanner.h"
+#include "PlanningStatistics.h"
 
 namespace Ui {
 class PlanningControlWidget;
@@ -24,6 +26,12 @@ public slots:
     void setIsStopped();
     void setIsRunning();
 
+    /**
+     * @brief setPlanningStatistics feeds the telemetry panel. It may be called as often as the planner likes;
+     * the panel only redraws a couple of times per second.
+     */
+    void setPlanningStatistics(const PlanningStatistics& statistics);
+
 signals:
     void planningStartRequested();
     void planningPauseRequested();
@@ -36,8 +44,21 @@ private slots:
 
     void on_pauseButton_clicked();
 
+    void updateTelemetry();
+
 private:
+    void clearTelemetry();
+
     Ui::PlanningControlWidget *ui;
+
+    QTimer * _telemetryTimer;
+    PlanningStatistics _statistics;
+    qint64 _statisticsTime;
+
+    //What the states/sec rate was last computed from
+    qint64 _rateStates;
+    qint64 _rateTime;
+    qreal _statesPerSecond;
 };
 
 #endif // PLANNINGCONTROLWIDGET_H
@@ -0,0 +1,51 @@
+#include "StartupTimer.h"
+
+#include <QElapsedTimer>
+#include <QtDebug>
+
+//non-member
+static QElapsedTimer& startupClock()
+{
+    static QElapsedTimer clock;
+    return clock;
+}
+
+//non-member
+static qint64& lastMark()
+{
+    static qint64 last = 0;
+    return last;
+}
+
+//non-member
+static bool startupTimingEnabled()
+{
+    static const bool enabled = !qgetenv("FLIGHTPLANNER_STARTUP_TIMING").isEmpty();
+    return enabled;
+}
+
+//static
+void StartupTimer::start()
+{
+    startupClock().start();
+    lastMark() = 0;
+}
+
+//static
+void StartupTimer::mark(const char *step)
+{
+    if (!startupTimingEnabled() || !startupClock().isValid())
+        return;
+
+    const qint64 now = startupClock().elapsed();
+    qDebug() << "Startup:" << step << "at" << now << "ms (+" << (now - lastMark()) << "ms)";
+    lastMark() = now;
+}
+
+//static
+qint64 StartupTimer::elapsed()
+{
+    if (!startupClock().isValid())
+        return 0;
+    return startupClock().elapsed();
+}
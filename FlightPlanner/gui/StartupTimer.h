@@ -0,0 +1,34 @@
+#ifndef STARTUPTIMER_H
+#define STARTUPTIMER_H
+
+#include <QtGlobal>
+
+/**
+ * @brief The StartupTimer class times the steps of application startup from the beginning of main(). Each
+ * mark() is logged with the time since start() and since the previous mark when FLIGHTPLANNER_STARTUP_TIMING
+ * is set in the environment, and is free otherwise.
+ *
+ * GUI thread only.
+ */
+class StartupTimer
+{
+public:
+    /**
+     * @brief start starts the clock. Call it first thing in main().
+     */
+    static void start();
+
+    /**
+     * @brief mark notes that startup has reached step
+     * @param step
+     */
+    static void mark(const char * step);
+
+    /**
+     * @brief elapsed returns the milliseconds since start(), or 0 if it hasn't been called
+     * @return
+     */
+    static qint64 elapsed();
+};
+
+#endif // STARTUPTIMER_H
@@ -1,12 +1,188 @@
 #include <QApplication>
+#include <QCoreApplication>
+#include <QStringList>
+#include <QTextStream>
+#include <QVector>
+
 #include "gui/MainWindow.h"
+#include "ProblemFile.h"
+#include "PlanningProblem.h"
+#include "FlightTaskArea.h"
+#include "HierarchicalPlanner/ConvexHull.h"
+#include "tileSources/OSMTileSource.h"
+#include "guts/MapTileSeeder.h"
+#include "gui/StartupTimer.h"
+#include "ProcessPlanner/PlanningProcessWorker.h"
+
+const char * SEED_USAGE =
+        "Usage: FlightPlanner --seed-tiles <problem file> [options]\n"
+        "\n"
+        "Downloads the map tiles covering a planning problem's areas and starting position into the tile\n"
+        "cache, so the map can be used without a network connection. Progress is saved next to the problem\n"
+        "file, and running it again picks up where it stopped.\n"
+        "\n"
+        "Options:\n"
+        "  --zoom <min>-<max>               The zoom levels to download (default 10-18)\n"
+        "  --concurrency <n>                Tiles to download at once (default 4)\n"
+        "  --rate <n>                       Tiles to start per second, 0 for no limit (default 10)\n"
+        "  --cache-quota <MB>               Disk space the tile cache may take up, 0 for no limit (default 2048)\n";
+
+//non-member
+int seedTiles(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    QString problemPath;
+    int minZoom = 10;
+    int maxZoom = 18;
+    int concurrency = 4;
+    qreal rate = 10.0;
+    qint64 quotaMB = 2048;
+
+    const QStringList args = a.arguments();
+    for (int i = 1; i < args.size(); i++)
+    {
+        const QString& arg = args.at(i);
+        const bool hasValue = i + 1 < args.size();
+        bool ok = true;
+        if (arg == "--seed-tiles" && hasValue)
+            problemPath = args.at(++i);
+        else if (arg == "--zoom" && hasValue)
+        {
+            const QStringList range = args.at(++i).split('-');
+            bool minOk = false, maxOk = false;
+            if (range.size() == 2)
+            {
+                minZoom = range.at(0).toInt(&minOk);
+                maxZoom = range.at(1).toInt(&maxOk);
+            }
+            ok = minOk && maxOk && minZoom >= 0 && minZoom <= maxZoom && maxZoom <= 255;
+        }
+        else if (arg == "--concurrency" && hasValue)
+        {
+            concurrency = args.at(++i).toInt(&ok);
+            ok = ok && concurrency > 0;
+        }
+        else if (arg == "--rate" && hasValue)
+        {
+            rate = args.at(++i).toDouble(&ok);
+            ok = ok && rate >= 0.0;
+        }
+        else if (arg == "--cache-quota" && hasValue)
+        {
+            quotaMB = args.at(++i).toLongLong(&ok);
+            ok = ok && quotaMB >= 0;
+        }
+        else
+            ok = false;
+
+        if (!ok)
+        {
+            err << "Invalid argument " << arg << "\n" << SEED_USAGE;
+            return 2;
+        }
+    }
+    if (problemPath.isEmpty())
+    {
+        err << SEED_USAGE;
+        return 2;
+    }
+
+    QString error;
+    QSharedPointer<PlanningProblem> problem = ProblemFile::load(problemPath, 0, &error);
+    if (problem.isNull())
+    {
+        err << "Failed to load " << problemPath << ": " << error << "\n";
+        return 1;
+    }
+
+    //The hull of everything the mission may fly over
+    QVector<QPointF> points;
+    foreach(const QSharedPointer<FlightTaskArea>& area, problem->areas())
+        points += area->geoPoly();
+    if (problem->startingPositionDefined())
+        points.append(problem->startingPosition().lonLat());
+    const QVector<QPointF> hull = ConvexHull::build(points);
+    if (hull.size() < 3)
+    {
+        err << problemPath << " has no areas to download tiles for\n";
+        return 1;
+    }
+
+    MapTileSeeder seeder;
+    //Seeding more than fits would just evict the first tiles to make room for the last
+    QSharedPointer<MapTileSource> source(new OSMTileSource());
+    source->setDiskCacheQuota(quotaMB * 1024 * 1024);
+    seeder.setTileSource(source);
+    seeder.setRegion(QPolygonF(hull));
+    seeder.setZoomRange(minZoom, maxZoom);
+    seeder.setMaxConcurrentRequests(concurrency);
+    seeder.setMaxRequestsPerSecond(rate);
+    seeder.setResumeFile(problemPath + ".seed");
+    QObject::connect(&seeder,
+                     SIGNAL(finished()),
+                     &a,
+                     SLOT(quit()));
+
+    seeder.start();
+    if (seeder.isRunning())
+    {
+        out << "Downloading " << seeder.tileCount() << " tiles" << endl;
+        a.exec();
+    }
+
+    out << seeder.completedCount() << " of " << seeder.tileCount() << " tiles done, "
+        << seeder.failedCount() << " failed" << endl;
+    return seeder.failedCount() == 0 ? 0 : 1;
+}
+
+//non-member
+//The other end of a WorkerProcessPlanner, which starts us with the prefix for our shared memory keys
+int planningWorker(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    const QStringList args = a.arguments();
+    const int index = args.indexOf(PlanningProcessProtocol::WORKER_ARGUMENT);
+    if (index < 0 || index + 1 >= args.size())
+    {
+        QTextStream(stderr) << "Usage: FlightPlanner " << PlanningProcessProtocol::WORKER_ARGUMENT
+                            << " <key prefix>\n";
+        return 2;
+    }
+
+    PlanningProcessWorker worker(args.at(index + 1));
+    QObject::connect(&worker,
+                     SIGNAL(finished()),
+                     &a,
+                     SLOT(quit()));
+    if (!worker.start())
+        return 1;
+    return a.exec();
+}
 
 int main(int argc, char *argv[])
 {
+    for (int i = 1; i < argc; i++)
+    {
+        if (QString(argv[i]) == "--seed-tiles")
+            return seedTiles(argc, argv);
+        if (QString(argv[i]) == PlanningProcessProtocol::WORKER_ARGUMENT)
+            return planningWorker(argc, argv);
+    }
+
+    //Set FLIGHTPLANNER_STARTUP_TIMING to see where startup spends its time
+    StartupTimer::start();
+
     QApplication a(argc, argv);
+    StartupTimer::mark("QApplication created");
     MainWindow * w = new MainWindow();
+    StartupTimer::mark("Main window created");
     w->show();
     w->setAttribute(Qt::WA_DeleteOnClose);
-    
+    StartupTimer::mark("Main window shown");
+
     return a.exec();
 }
@@ -0,0 +1,32 @@
+#-------------------------------------------------
+#
+# Headless flight planner for batch runs
+#
+#-------------------------------------------------
+
+#The planning core uses QtGui's geometry types (QPolygonF, QVector3D and friends) but no widgets. The planning
+#service talks TCP.
+QT       += core gui network
+
+TARGET = FlightPlannerCLI
+TEMPLATE = app
+CONFIG   += console
+CONFIG   -= app_bundle
+
+include(../PlanningCore/PlanningCore.pri)
+
+SOURCES += main.cpp \
+    PlanningJob.cpp \
+    PlanningService.cpp \
+    PlanningServiceProtocol.cpp \
+    PlanningWorker.cpp
+
+HEADERS += \
+    PlanningJob.h \
+    PlanningService.h \
+    PlanningServiceProtocol.h \
+    PlanningWorker.h
+
+#MapGraphics' geographic types, built in directly so we don't link its widgets
+DEFINES += MAPGRAPHICS_LIBRARY
+include(../MapGraphics/Geographic.pri)
@@ -0,0 +1,200 @@
+#include "PlanningJob.h"
+
+#include <QBuffer>
+#include <QScopedPointer>
+#include <QtDebug>
+
+#include "BatchPlanningRun.h"
+#include "FlightTaskArea.h"
+#include "FlightTasks/CoverageTask.h"
+#include "EvolutionaryPlanner/EvolutionaryFlightPlanner.h"
+#include "Exporters/FlightPrefixStreamer.h"
+#include "GreedyPlanner/GreedyFlightPlanner.h"
+#include "HierarchicalPlanner/HierarchicalPlanner.h"
+#include "PlanCache.h"
+
+//Pinned so that the service and its workers agree whatever Qt they were built with. PlanCache pins the same.
+const int JOB_STREAM_VERSION = QDataStream::Qt_4_8;
+
+PlanningJobRequest::PlanningJobRequest() :
+    planner("hierarchical"), timeBudget(0), scheduleBudget(0), improvementBudget(1000), seed(0), workers(-1),
+    sweepCoverage(false)
+{
+}
+
+PlanningJobResult::PlanningJobResult() :
+    planned(false), fitness(0.0), elapsed(0), iterations(0), budgetExhausted(false)
+{
+}
+
+QDataStream& operator<<(QDataStream& stream, const PlanningJobRequest& request)
+{
+    stream << request.problem << request.planner << request.timeBudget << request.scheduleBudget;
+    stream << request.improvementBudget;
+    stream << request.seed << (qint32)request.workers << request.sweepCoverage << request.plannerResults;
+    stream << request.tuning;
+    return stream;
+}
+
+QDataStream& operator>>(QDataStream& stream, PlanningJobRequest& request)
+{
+    qint32 workers;
+    stream >> request.problem >> request.planner >> request.timeBudget >> request.scheduleBudget;
+    stream >> request.improvementBudget;
+    stream >> request.seed >> workers >> request.sweepCoverage >> request.plannerResults;
+    stream >> request.tuning;
+    request.workers = workers;
+    return stream;
+}
+
+QDataStream& operator<<(QDataStream& stream, const PlanningJobResult& result)
+{
+    stream << result.planned << result.errorString << result.flight << result.fitness;
+    stream << result.elapsed << result.iterations << result.budgetExhausted;
+    stream << result.statistics << result.trace << result.plannerResults;
+    return stream;
+}
+
+QDataStream& operator>>(QDataStream& stream, PlanningJobResult& result)
+{
+    stream >> result.planned >> result.errorString >> result.flight >> result.fitness;
+    stream >> result.elapsed >> result.iterations >> result.budgetExhausted;
+    stream >> result.statistics >> result.trace >> result.plannerResults;
+    return stream;
+}
+
+//static
+bool PlanningJob::isKnownPlanner(const QString &name)
+{
+    return name == "hierarchical" || name == "greedy" || name == "evolutionary";
+}
+
+//static
+void PlanningJob::useSweptCoverage(PlanningProblem *problem)
+{
+    foreach(const QSharedPointer<FlightTaskArea>& area, problem->areas())
+    {
+        foreach(const QSharedPointer<FlightTask>& task, area->tasks())
+        {
+            QSharedPointer<CoverageTask> coverage = task.objectCast<CoverageTask>();
+            if (!coverage.isNull())
+                coverage->setCoverageMode(CoverageTask::SweptCoverage);
+        }
+    }
+}
+
+//static
+PlanningJobResult PlanningJob::run(QSharedPointer<PlanningProblem> problem, const PlanningJobRequest &request,
+                                   QIODevice *stream)
+{
+    PlanningJobResult toRet;
+
+    if (request.sweepCoverage)
+        PlanningJob::useSweptCoverage(problem.data());
+
+    QScopedPointer<FlightPlanner> planner;
+    HierarchicalPlanner * hierarchical = 0;
+    if (request.planner == "hierarchical")
+    {
+        hierarchical = new HierarchicalPlanner(problem);
+        planner.reset(hierarchical);
+        hierarchical->setScheduleTimeBudget(request.scheduleBudget);
+        hierarchical->setScheduleImprovementTimeBudget(request.improvementBudget);
+        if (request.workers >= 0)
+            hierarchical->setWorkerCount(request.workers);
+
+        //Whatever was planned before doesn't have to be planned again
+        foreach(const QByteArray& results, request.plannerResults)
+        {
+            if (!results.isEmpty() && !hierarchical->restoreResults(results))
+                qWarning() << "Ignoring damaged planner results";
+        }
+    }
+    else if (request.planner == "greedy")
+    {
+        GreedyFlightPlanner * greedy = new GreedyFlightPlanner(problem);
+        planner.reset(greedy);
+        if (request.workers >= 0)
+            greedy->setWorkerCount(request.workers);
+    }
+    else if (request.planner == "evolutionary")
+    {
+        EvolutionaryFlightPlanner * evolutionary = new EvolutionaryFlightPlanner(problem);
+        planner.reset(evolutionary);
+        if (request.workers >= 0)
+            evolutionary->setWorkerCount(request.workers);
+    }
+    else
+    {
+        toRet.errorString = "Unknown planner " + request.planner;
+        return toRet;
+    }
+
+    planner->setRandomSeed(request.seed);
+    planner->setTuning(request.tuning);
+
+    QScopedPointer<FlightPrefixStreamer> streamer;
+    if (stream)
+    {
+        streamer.reset(new FlightPrefixStreamer(planner.data(), stream));
+        if (!streamer->start(&toRet.errorString))
+            return toRet;
+    }
+
+    BatchPlanningRun run(planner.data());
+    run.setTimeBudget(request.timeBudget);
+    toRet.planned = run.run(&toRet.errorString);
+
+    if (streamer && !streamer->finish(toRet.planned ? &toRet.errorString : 0))
+        toRet.planned = false;
+
+    toRet.flight = planner->bestFlightSoFar();
+    toRet.fitness = planner->bestFitnessSoFar().combined();
+    toRet.elapsed = run.elapsed();
+    toRet.iterations = run.iterations();
+    toRet.budgetExhausted = run.budgetExhausted();
+
+    //Worth having even when planning failed, to see where it got to
+    const PlanningStatistics statistics = planner->statistics();
+    QBuffer statisticsBuffer(&toRet.statistics);
+    statisticsBuffer.open(QIODevice::WriteOnly);
+    statistics.writeJSON(&statisticsBuffer);
+    QBuffer traceBuffer(&toRet.trace);
+    traceBuffer.open(QIODevice::WriteOnly);
+    statistics.writeChromeTrace(&traceBuffer);
+
+    if (hierarchical)
+        toRet.plannerResults = hierarchical->saveResults();
+
+    return toRet;
+}
+
+//static
+QByteArray PlanningJob::cacheKey(const PlanningJobRequest &request)
+{
+    return PlanCache::key(request.problem,
+                          PlanCache::configuration(request.planner, request.seed, request.timeBudget,
+                                                   request.scheduleBudget, request.improvementBudget,
+                                                   request.sweepCoverage, request.tuning));
+}
+
+//static
+QByteArray PlanningJob::serializeProblem(const PlanningProblem &problem)
+{
+    QByteArray toRet;
+    QDataStream stream(&toRet, QIODevice::WriteOnly);
+    stream.setVersion(JOB_STREAM_VERSION);
+    problem.serialize(stream);
+    return toRet;
+}
+
+//static
+QSharedPointer<PlanningProblem> PlanningJob::deserializeProblem(const QByteArray &bytes)
+{
+    QDataStream stream(bytes);
+    stream.setVersion(JOB_STREAM_VERSION);
+    QSharedPointer<PlanningProblem> toRet(new PlanningProblem(stream));
+    if (stream.status() != QDataStream::Ok)
+        return QSharedPointer<PlanningProblem>();
+    return toRet;
+}
@@ -0,0 +1,129 @@
+#ifndef PLANNINGJOB_H
+#define PLANNINGJOB_H
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QList>
+#include <QSharedPointer>
+#include <QString>
+
+class QIODevice;
+
+#include "PlannerTuning.h"
+#include "PlanningProblem.h"
+#include "Position.h"
+
+/**
+ * @brief The PlanningJobRequest struct is everything needed to plan one problem: the problem itself, serialized
+ * with PlanningJob::serializeProblem(), and the planner settings from the command line.
+ */
+struct PlanningJobRequest
+{
+    PlanningJobRequest();
+
+    QByteArray problem;
+    QString planner;
+
+    //Milliseconds, 0 for no limit
+    qint64 timeBudget;
+    qint64 scheduleBudget;
+
+    //Milliseconds, 0 to skip schedule improvement
+    qint64 improvementBudget;
+
+    quint64 seed;
+
+    //-1 for the planner's default
+    int workers;
+    bool sweepCoverage;
+
+    //From --tuning, or the --tuning-profile entry for the problem's mission class
+    PlannerTuning tuning;
+
+    //HierarchicalPlanner::saveResults() blobs to start from, most useful first
+    QList<QByteArray> plannerResults;
+};
+
+/**
+ * @brief The PlanningJobResult struct is what planning a PlanningJobRequest gave
+ */
+struct PlanningJobResult
+{
+    PlanningJobResult();
+
+    bool planned;
+    QString errorString;
+
+    QList<Position> flight;
+    qreal fitness;
+
+    qint64 elapsed;
+    quint32 iterations;
+    bool budgetExhausted;
+
+    //The planner's statistics, as PlanningStatistics::writeJSON() and writeChromeTrace() wrote them
+    QByteArray statistics;
+    QByteArray trace;
+
+    //HierarchicalPlanner::saveResults() after planning, empty for other planners
+    QByteArray plannerResults;
+};
+
+QDataStream& operator<<(QDataStream& stream, const PlanningJobRequest& request);
+QDataStream& operator>>(QDataStream& stream, PlanningJobRequest& request);
+QDataStream& operator<<(QDataStream& stream, const PlanningJobResult& result);
+QDataStream& operator>>(QDataStream& stream, PlanningJobResult& result);
+
+/**
+ * @brief The PlanningJob class plans a PlanningJobRequest to completion on this machine. The command line's
+ * local mode and the planning service's workers both go through it, so a job planned remotely gives the same
+ * flight as one planned locally.
+ */
+class PlanningJob
+{
+public:
+    /**
+     * @brief isKnownPlanner returns true if name is a planner run() can make
+     * @param name
+     * @return
+     */
+    static bool isKnownPlanner(const QString& name);
+
+    /**
+     * @brief run plans problem (which should be the one serialized in request) with the request's settings.
+     * Blocks, spinning an event loop, until the planner stops or the time budget runs out.
+     * @param problem
+     * @param request
+     * @param stream if given, the flight's settled start is written to it as GPX while planning goes on (see
+     * FlightPrefixStreamer) and the rest once planning is done
+     * @return
+     */
+    static PlanningJobResult run(QSharedPointer<PlanningProblem> problem, const PlanningJobRequest& request,
+                                 QIODevice * stream = 0);
+
+    /**
+     * @brief useSweptCoverage has problem's coverage tasks fly back-and-forth lines instead of searching
+     * @param problem
+     */
+    static void useSweptCoverage(PlanningProblem * problem);
+
+    /**
+     * @brief cacheKey returns the PlanCache key of request, whose problem must be filled in. Requests that only
+     * differ in their worker count or the planner results they carry have the same key.
+     * @param request
+     * @return
+     */
+    static QByteArray cacheKey(const PlanningJobRequest& request);
+
+    static QByteArray serializeProblem(const PlanningProblem& problem);
+
+    /**
+     * @brief deserializeProblem returns the problem serialized by serializeProblem(), or null if bytes are
+     * damaged
+     * @param bytes
+     * @return
+     */
+    static QSharedPointer<PlanningProblem> deserializeProblem(const QByteArray& bytes);
+};
+
+#endif // PLANNINGJOB_H
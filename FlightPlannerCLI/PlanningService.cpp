@@ -0,0 +1,314 @@
+#include "PlanningService.h"
+
+#include <QDataStream>
+#include <QTcpSocket>
+#include <QtDebug>
+
+//Must match PlanningServiceProtocol's
+const int SERVICE_STREAM_VERSION = QDataStream::Qt_4_8;
+
+PlanningService::PlanningService(QObject *parent) :
+    QObject(parent), _sharedResultsLimit(8), _nextJobId(1)
+{
+    connect(&_server,
+            SIGNAL(newConnection()),
+            this,
+            SLOT(handleNewConnection()));
+}
+
+PlanningService::~PlanningService()
+{
+}
+
+bool PlanningService::listen(quint16 port, QString *errorString)
+{
+    if (!_server.listen(QHostAddress::Any, port))
+    {
+        if (errorString)
+            *errorString = QString("Failed to listen on port %1: %2").arg(port).arg(_server.errorString());
+        return false;
+    }
+    return true;
+}
+
+int PlanningService::sharedResultsLimit() const
+{
+    return _sharedResultsLimit;
+}
+
+void PlanningService::setSharedResultsLimit(int limit)
+{
+    _sharedResultsLimit = qMax<int>(0, limit);
+    while (_sharedResults.size() > _sharedResultsLimit)
+        _sharedResults.removeLast();
+}
+
+void PlanningService::setPlanCacheDirectory(const QString &directory)
+{
+    _planCache.setDirectory(directory);
+
+    //What was planned before the service started is as good as what its own jobs plan
+    foreach(const QByteArray& results, _planCache.recentPlannerResults(_sharedResultsLimit))
+    {
+        if (!_sharedResults.contains(results))
+            _sharedResults.append(results);
+    }
+    while (_sharedResults.size() > _sharedResultsLimit)
+        _sharedResults.removeLast();
+}
+
+int PlanningService::workerCount() const
+{
+    return _idleWorkers.size() + _running.size();
+}
+
+int PlanningService::queuedJobCount() const
+{
+    return _queue.size();
+}
+
+//private slot
+void PlanningService::handleNewConnection()
+{
+    while (_server.hasPendingConnections())
+    {
+        QTcpSocket * socket = _server.nextPendingConnection();
+        connect(socket,
+                SIGNAL(readyRead()),
+                this,
+                SLOT(handleReadyRead()));
+        connect(socket,
+                SIGNAL(disconnected()),
+                this,
+                SLOT(handleDisconnected()));
+    }
+}
+
+//private slot
+void PlanningService::handleReadyRead()
+{
+    QTcpSocket * socket = qobject_cast<QTcpSocket *>(this->sender());
+    if (socket == 0)
+        return;
+
+    PlanningServiceProtocol::MessageType type;
+    QByteArray payload;
+    while (socket->state() == QAbstractSocket::ConnectedState
+           && PlanningServiceProtocol::receive(socket, &type, &payload))
+        _handleMessage(socket, type, payload);
+}
+
+//private slot
+void PlanningService::handleDisconnected()
+{
+    QTcpSocket * socket = qobject_cast<QTcpSocket *>(this->sender());
+    if (socket == 0)
+        return;
+
+    const PlanningServiceProtocol::Role role = _roles.value(socket, PlanningServiceProtocol::ClientRole);
+    _roles.remove(socket);
+    if (role == PlanningServiceProtocol::WorkerRole)
+    {
+        _idleWorkers.removeAll(socket);
+        if (_running.contains(socket))
+        {
+            const Job job = _running.take(socket);
+            qWarning() << "Worker" << socket->peerAddress().toString() << "went away, requeueing job" << job.id;
+            _queue.prepend(job);
+        }
+        qDebug() << "Worker" << socket->peerAddress().toString() << "left," << this->workerCount() << "remain";
+    }
+    else
+    {
+        //Nobody is waiting for this client's jobs any more. Queued ones are dropped, running ones finish
+        //(they still add to the shared results) but their results go nowhere.
+        for (int i = _queue.size() - 1; i >= 0; i--)
+        {
+            if (_queue.at(i).client == socket)
+                _queue.removeAt(i);
+        }
+        QHash<QTcpSocket *, Job>::iterator iter;
+        for (iter = _running.begin(); iter != _running.end(); iter++)
+        {
+            if (iter.value().client == socket)
+                iter.value().client = 0;
+        }
+    }
+
+    socket->deleteLater();
+    _dispatch();
+}
+
+//private
+void PlanningService::_handleMessage(QTcpSocket *socket, PlanningServiceProtocol::MessageType type,
+                                     const QByteArray &payload)
+{
+    if (type == PlanningServiceProtocol::Hello)
+    {
+        QString errorString;
+        PlanningServiceProtocol::Role role;
+        if (_roles.contains(socket) || !PlanningServiceProtocol::parseHello(payload, &role, &errorString))
+        {
+            qWarning() << "Refusing" << socket->peerAddress().toString() << errorString;
+            socket->abort();
+            return;
+        }
+
+        _roles.insert(socket, role);
+        if (role == PlanningServiceProtocol::WorkerRole)
+        {
+            _idleWorkers.append(socket);
+            qDebug() << "Worker" << socket->peerAddress().toString() << "joined," << this->workerCount()
+                     << "available";
+            _dispatch();
+        }
+        return;
+    }
+
+    if (!_roles.contains(socket))
+    {
+        qWarning() << "Refusing" << socket->peerAddress().toString() << "which didn't say hello";
+        socket->abort();
+        return;
+    }
+
+    const PlanningServiceProtocol::Role role = _roles.value(socket);
+    if (type == PlanningServiceProtocol::Submit && role == PlanningServiceProtocol::ClientRole)
+        _handleSubmit(socket, payload);
+    else if (type == PlanningServiceProtocol::Done && role == PlanningServiceProtocol::WorkerRole)
+        _handleDone(socket, payload);
+    else
+        qWarning() << "Ignoring unexpected message" << type << "from" << socket->peerAddress().toString();
+}
+
+//private
+void PlanningService::_handleSubmit(QTcpSocket *client, const QByteArray &payload)
+{
+    QDataStream stream(payload);
+    stream.setVersion(SERVICE_STREAM_VERSION);
+
+    Job job;
+    job.id = _nextJobId++;
+    job.client = client;
+    stream >> job.request;
+    if (stream.status() != QDataStream::Ok)
+    {
+        qWarning() << "Refusing damaged job from" << client->peerAddress().toString();
+        client->abort();
+        return;
+    }
+
+    if (_planCache.isEnabled())
+    {
+        job.cacheKey = PlanningJob::cacheKey(job.request);
+        PlanCache::Entry cached;
+        if (_planCache.lookup(job.cacheKey, &cached))
+        {
+            qDebug() << "Job" << job.id << "from" << client->peerAddress().toString() << "was in the plan cache";
+            PlanningJobResult result;
+            result.planned = true;
+            result.flight = cached.flight;
+            result.fitness = cached.fitness;
+            _sendResult(client, job.id, result);
+            return;
+        }
+    }
+
+    qDebug() << "Queued job" << job.id << "from" << client->peerAddress().toString();
+    _queue.append(job);
+    _dispatch();
+}
+
+//private
+void PlanningService::_handleDone(QTcpSocket *worker, const QByteArray &payload)
+{
+    if (!_running.contains(worker))
+    {
+        qWarning() << "Ignoring result from idle worker" << worker->peerAddress().toString();
+        return;
+    }
+    const Job job = _running.take(worker);
+
+    QDataStream stream(payload);
+    stream.setVersion(SERVICE_STREAM_VERSION);
+    quint64 jobId;
+    PlanningJobResult result;
+    stream >> jobId >> result;
+    if (stream.status() != QDataStream::Ok || jobId != job.id)
+    {
+        //Don't trust the worker with anything else, and give the job to someone who can do it
+        qWarning() << "Worker" << worker->peerAddress().toString() << "sent a damaged result for job" << job.id;
+        _queue.prepend(job);
+        worker->abort();
+        return;
+    }
+
+    qDebug() << "Job" << job.id << "done in" << result.elapsed << "ms, fitness" << result.fitness;
+    _shareResults(result.plannerResults);
+
+    if (!job.cacheKey.isEmpty() && result.planned)
+    {
+        PlanCache::Entry entry;
+        entry.flight = result.flight;
+        entry.fitness = result.fitness;
+        entry.plannerResults = result.plannerResults;
+        QString errorString;
+        if (!_planCache.store(job.cacheKey, entry, &errorString))
+            qWarning() << "Failed to cache job" << job.id << errorString;
+    }
+
+    if (job.client)
+    {
+        //The client has no use for the planner results, they're just for the other workers
+        result.plannerResults.clear();
+        _sendResult(job.client, job.id, result);
+    }
+
+    _idleWorkers.append(worker);
+    _dispatch();
+}
+
+//private
+void PlanningService::_sendResult(QTcpSocket *client, quint64 jobId, const PlanningJobResult &result)
+{
+    QByteArray resultBytes;
+    QDataStream resultStream(&resultBytes, QIODevice::WriteOnly);
+    resultStream.setVersion(SERVICE_STREAM_VERSION);
+    resultStream << jobId << result;
+    PlanningServiceProtocol::send(client, PlanningServiceProtocol::Result, resultBytes);
+}
+
+//private
+void PlanningService::_dispatch()
+{
+    while (!_queue.isEmpty() && !_idleWorkers.isEmpty())
+    {
+        Job job = _queue.takeFirst();
+        QTcpSocket * worker = _idleWorkers.takeFirst();
+
+        //The client's own results (saved with its problem) go first, then whatever other jobs worked out
+        PlanningJobRequest request = job.request;
+        request.plannerResults.append(_sharedResults);
+
+        QByteArray jobBytes;
+        QDataStream stream(&jobBytes, QIODevice::WriteOnly);
+        stream.setVersion(SERVICE_STREAM_VERSION);
+        stream << job.id << request;
+        PlanningServiceProtocol::send(worker, PlanningServiceProtocol::Assign, jobBytes);
+
+        _running.insert(worker, job);
+        qDebug() << "Job" << job.id << "went to" << worker->peerAddress().toString();
+    }
+}
+
+//private
+void PlanningService::_shareResults(const QByteArray &results)
+{
+    if (results.isEmpty() || _sharedResultsLimit == 0)
+        return;
+
+    //A job's results include whatever it was given that still applied, so newer ones are the more complete
+    _sharedResults.prepend(results);
+    while (_sharedResults.size() > _sharedResultsLimit)
+        _sharedResults.removeLast();
+}
@@ -0,0 +1,105 @@
+#ifndef PLANNINGSERVICE_H
+#define PLANNINGSERVICE_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QTcpServer>
+
+#include "PlanCache.h"
+#include "PlanningJob.h"
+#include "PlanningServiceProtocol.h"
+
+class QTcpSocket;
+
+/**
+ * @brief The PlanningService class hands planning jobs from clients out to worker nodes. Clients and workers
+ * both connect to it (see PlanningServiceProtocol), so workers can come and go while the service runs. Each
+ * worker plans one job at a time. Jobs wait in order of arrival for a free worker, and a job whose worker
+ * disconnects goes back to the front of the queue.
+ *
+ * Every job carries the planner results (area endpoints, sub-flights and transition flights, see
+ * HierarchicalPlanner::saveResults()) of the most recently finished jobs, so a worker skips whatever another
+ * worker has already planned for the same areas and obstacles. That's what makes what-if campaigns cheap:
+ * variations of one problem mostly plan the same sub-flights and transitions.
+ *
+ * With a plan cache (see PlanCache), a job that has been planned before is answered from the cache without going
+ * to a worker, and the cache's newest planner results are shared from the start.
+ */
+class PlanningService : public QObject
+{
+    Q_OBJECT
+public:
+    explicit PlanningService(QObject *parent = 0);
+    virtual ~PlanningService();
+
+    /**
+     * @brief listen starts accepting clients and workers on port. Returns false with an explanation in
+     * errorString if the port can't be had.
+     * @param port
+     * @param errorString
+     * @return
+     */
+    bool listen(quint16 port, QString * errorString = 0);
+
+    /**
+     * @brief sharedResultsLimit returns how many finished jobs' planner results are kept and sent with every
+     * new job. 0 turns sharing off. Defaults to 8.
+     * @return
+     */
+    int sharedResultsLimit() const;
+    void setSharedResultsLimit(int limit);
+
+    /**
+     * @brief setPlanCacheDirectory keeps finished plans in directory, which may be shared with other services and
+     * command lines. Empty (the default) turns the cache off.
+     * @param directory
+     */
+    void setPlanCacheDirectory(const QString& directory);
+
+    int workerCount() const;
+    int queuedJobCount() const;
+
+private slots:
+    void handleNewConnection();
+    void handleReadyRead();
+    void handleDisconnected();
+
+private:
+    struct Job
+    {
+        quint64 id;
+        QTcpSocket * client;
+        PlanningJobRequest request;
+
+        //Empty without a plan cache
+        QByteArray cacheKey;
+    };
+
+    void _handleMessage(QTcpSocket * socket, PlanningServiceProtocol::MessageType type, const QByteArray& payload);
+    void _handleSubmit(QTcpSocket * client, const QByteArray& payload);
+    void _handleDone(QTcpSocket * worker, const QByteArray& payload);
+    void _sendResult(QTcpSocket * client, quint64 jobId, const PlanningJobResult& result);
+    void _dispatch();
+    void _shareResults(const QByteArray& results);
+
+    QTcpServer _server;
+    int _sharedResultsLimit;
+
+    //Peers that have said Hello, by role
+    QHash<QTcpSocket *, PlanningServiceProtocol::Role> _roles;
+
+    QList<QTcpSocket *> _idleWorkers;
+    QList<Job> _queue;
+    QHash<QTcpSocket *, Job> _running;
+    quint64 _nextJobId;
+
+    //Planner results of the most recently finished jobs, newest first
+    QList<QByteArray> _sharedResults;
+
+    PlanCache _planCache;
+};
+
+#endif // PLANNINGSERVICE_H
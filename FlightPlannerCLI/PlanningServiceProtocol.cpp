@@ -0,0 +1,171 @@
+#include "PlanningServiceProtocol.h"
+
+#include <QDataStream>
+#include <QTcpSocket>
+#include <QtEndian>
+
+const quint16 PlanningServiceProtocol::VERSION = 3;
+const quint16 PlanningServiceProtocol::DEFAULT_PORT = 7421;
+
+//Identifies our Hello among whatever else might connect to the port
+const quint32 PROTOCOL_MAGIC = 0x46505331;
+
+//Pinned so that every node reads every other's messages, whatever Qt they were built with
+const int PROTOCOL_STREAM_VERSION = QDataStream::Qt_4_8;
+
+//Bigger than any problem or result we'd send, small enough that a garbage length can't exhaust memory
+const quint32 MAX_MESSAGE_LENGTH = 512 * 1024 * 1024;
+
+//static
+void PlanningServiceProtocol::send(QTcpSocket *socket, MessageType type, const QByteArray &payload)
+{
+    QByteArray message;
+    QDataStream stream(&message, QIODevice::WriteOnly);
+    stream.setVersion(PROTOCOL_STREAM_VERSION);
+    stream << (quint32) 0 << (quint16) type << payload;
+
+    qToBigEndian<quint32>(message.size() - sizeof(quint32), (uchar *) message.data());
+    socket->write(message);
+}
+
+//static
+bool PlanningServiceProtocol::receive(QTcpSocket *socket, MessageType *type, QByteArray *payload)
+{
+    if (socket->bytesAvailable() < (qint64) sizeof(quint32))
+        return false;
+
+    QByteArray header = socket->peek(sizeof(quint32));
+    const quint32 length = qFromBigEndian<quint32>((const uchar *) header.constData());
+    if (length > MAX_MESSAGE_LENGTH)
+    {
+        socket->abort();
+        return false;
+    }
+    if (socket->bytesAvailable() < (qint64)(sizeof(quint32) + length))
+        return false;
+
+    socket->read(sizeof(quint32));
+    QDataStream stream(socket->read(length));
+    stream.setVersion(PROTOCOL_STREAM_VERSION);
+
+    quint16 messageType;
+    stream >> messageType >> *payload;
+    if (stream.status() != QDataStream::Ok)
+    {
+        socket->abort();
+        return false;
+    }
+    *type = (MessageType) messageType;
+    return true;
+}
+
+//static
+QByteArray PlanningServiceProtocol::helloPayload(Role role)
+{
+    QByteArray toRet;
+    QDataStream stream(&toRet, QIODevice::WriteOnly);
+    stream.setVersion(PROTOCOL_STREAM_VERSION);
+    stream << PROTOCOL_MAGIC << VERSION << (quint16) role;
+    return toRet;
+}
+
+//static
+bool PlanningServiceProtocol::parseHello(const QByteArray &payload, Role *role, QString *errorString)
+{
+    QDataStream stream(payload);
+    stream.setVersion(PROTOCOL_STREAM_VERSION);
+
+    quint32 magic;
+    quint16 version;
+    quint16 roleValue;
+    stream >> magic >> version >> roleValue;
+    if (stream.status() != QDataStream::Ok || magic != PROTOCOL_MAGIC || roleValue > WorkerRole)
+    {
+        if (errorString)
+            *errorString = "Not a planning service peer";
+        return false;
+    }
+    if (version != VERSION)
+    {
+        if (errorString)
+            *errorString = QString("Protocol version %1 isn't ours (%2)").arg(version).arg(VERSION);
+        return false;
+    }
+    *role = (Role) roleValue;
+    return true;
+}
+
+//static
+bool PlanningServiceProtocol::parseAddress(const QString &address, QString *host, quint16 *port)
+{
+    const int colon = address.lastIndexOf(':');
+    if (colon < 0)
+    {
+        *host = address;
+        *port = DEFAULT_PORT;
+        return !address.isEmpty();
+    }
+
+    bool ok;
+    *host = address.left(colon);
+    *port = address.mid(colon + 1).toUShort(&ok);
+    return ok && !host->isEmpty();
+}
+
+//static
+bool PlanningServiceProtocol::submit(const QString &address, const PlanningJobRequest &request,
+                                     PlanningJobResult *result, QString *errorString)
+{
+    QString host;
+    quint16 port;
+    if (!parseAddress(address, &host, &port))
+    {
+        *errorString = "Invalid service address " + address;
+        return false;
+    }
+
+    QTcpSocket socket;
+    socket.connectToHost(host, port);
+    if (!socket.waitForConnected())
+    {
+        *errorString = "Failed to connect to " + address + ": " + socket.errorString();
+        return false;
+    }
+
+    QByteArray requestBytes;
+    QDataStream requestStream(&requestBytes, QIODevice::WriteOnly);
+    requestStream.setVersion(PROTOCOL_STREAM_VERSION);
+    requestStream << request;
+
+    send(&socket, Hello, helloPayload(ClientRole));
+    send(&socket, Submit, requestBytes);
+
+    //The job may wait behind others for a free worker, so there's no telling how long this takes
+    MessageType type;
+    QByteArray payload;
+    forever
+    {
+        if (receive(&socket, &type, &payload))
+        {
+            if (type == Result)
+                break;
+            continue;
+        }
+        if (socket.state() != QAbstractSocket::ConnectedState || !socket.waitForReadyRead(-1))
+        {
+            *errorString = "Lost the connection to " + address + ": " + socket.errorString();
+            return false;
+        }
+    }
+
+    QDataStream stream(payload);
+    stream.setVersion(PROTOCOL_STREAM_VERSION);
+    quint64 jobId;
+    stream >> jobId >> *result;
+    if (stream.status() != QDataStream::Ok)
+    {
+        *errorString = "The service sent a damaged result";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,87 @@
+#ifndef PLANNINGSERVICEPROTOCOL_H
+#define PLANNINGSERVICEPROTOCOL_H
+
+#include <QByteArray>
+#include <QString>
+#include <QtGlobal>
+
+#include "PlanningJob.h"
+
+class QTcpSocket;
+
+/**
+ * @brief The PlanningServiceProtocol class frames the messages that the planning service, its workers and its
+ * clients send each other over TCP.
+ *
+ * Every message is a 32-bit big-endian length followed by that many bytes: a 16-bit message type and a
+ * QDataStream-serialized payload. A connection starts with a Hello naming its role and the protocol version.
+ *
+ * Clients send Submit (a PlanningJobRequest) and get Result (job id and PlanningJobResult) back. Workers get
+ * Assign (job id and PlanningJobRequest) and answer with Done (job id and PlanningJobResult).
+ */
+class PlanningServiceProtocol
+{
+public:
+    enum MessageType
+    {
+        Hello,
+        Submit,
+        Assign,
+        Done,
+        Result
+    };
+
+    enum Role
+    {
+        ClientRole,
+        WorkerRole
+    };
+
+    static const quint16 VERSION;
+    static const quint16 DEFAULT_PORT;
+
+    /**
+     * @brief send writes one message to socket
+     * @param socket
+     * @param type
+     * @param payload
+     */
+    static void send(QTcpSocket * socket, MessageType type, const QByteArray& payload = QByteArray());
+
+    /**
+     * @brief receive reads one message from socket if all of it has arrived, and returns false otherwise.
+     * A connection that announces an absurdly large message is aborted.
+     * @param socket
+     * @param type
+     * @param payload
+     * @return
+     */
+    static bool receive(QTcpSocket * socket, MessageType * type, QByteArray * payload);
+
+    static QByteArray helloPayload(Role role);
+    static bool parseHello(const QByteArray& payload, Role * role, QString * errorString);
+
+    /**
+     * @brief parseAddress splits "host:port" (or just "host", for DEFAULT_PORT). Returns false if the port
+     * isn't a number.
+     * @param address
+     * @param host
+     * @param port
+     * @return
+     */
+    static bool parseAddress(const QString& address, QString * host, quint16 * port);
+
+    /**
+     * @brief submit sends request to the service at address and blocks until its result comes back.
+     * Returns false with an explanation in errorString if the service can't be reached or goes away.
+     * @param address
+     * @param request
+     * @param result
+     * @param errorString
+     * @return
+     */
+    static bool submit(const QString& address, const PlanningJobRequest& request, PlanningJobResult * result,
+                       QString * errorString);
+};
+
+#endif // PLANNINGSERVICEPROTOCOL_H
@@ -0,0 +1,139 @@
+#include "PlanningWorker.h"
+
+#include <QDataStream>
+#include <QtDebug>
+
+#include "PlanningJob.h"
+#include "PlanningServiceProtocol.h"
+
+//Must match PlanningServiceProtocol's
+const int WORKER_STREAM_VERSION = QDataStream::Qt_4_8;
+
+PlanningWorker::PlanningWorker(QObject *parent) :
+    QObject(parent), _workerCount(-1), _jobsDone(0), _busy(false)
+{
+    connect(&_socket,
+            SIGNAL(readyRead()),
+            this,
+            SLOT(handleReadyRead()));
+    connect(&_socket,
+            SIGNAL(disconnected()),
+            this,
+            SLOT(handleDisconnected()));
+}
+
+PlanningWorker::~PlanningWorker()
+{
+}
+
+bool PlanningWorker::connectToService(const QString &address, QString *errorString)
+{
+    QString host;
+    quint16 port;
+    if (!PlanningServiceProtocol::parseAddress(address, &host, &port))
+    {
+        if (errorString)
+            *errorString = "Invalid service address " + address;
+        return false;
+    }
+
+    _socket.connectToHost(host, port);
+    if (!_socket.waitForConnected())
+    {
+        if (errorString)
+            *errorString = "Failed to connect to " + address + ": " + _socket.errorString();
+        return false;
+    }
+
+    PlanningServiceProtocol::send(&_socket, PlanningServiceProtocol::Hello,
+                                  PlanningServiceProtocol::helloPayload(PlanningServiceProtocol::WorkerRole));
+    return true;
+}
+
+int PlanningWorker::workerCount() const
+{
+    return _workerCount;
+}
+
+void PlanningWorker::setWorkerCount(int count)
+{
+    _workerCount = qMax<int>(-1, count);
+}
+
+int PlanningWorker::jobsDone() const
+{
+    return _jobsDone;
+}
+
+//private slot
+void PlanningWorker::handleReadyRead()
+{
+    //Planning spins an event loop, which may deliver more data. The service only sends one job at a time, but
+    //whatever arrives meanwhile waits until this job is done.
+    if (_busy)
+        return;
+
+    PlanningServiceProtocol::MessageType type;
+    QByteArray payload;
+    while (_socket.state() == QAbstractSocket::ConnectedState
+           && PlanningServiceProtocol::receive(&_socket, &type, &payload))
+    {
+        if (type == PlanningServiceProtocol::Assign)
+            _plan(payload);
+        else
+            qWarning() << "Ignoring unexpected message" << type << "from the service";
+    }
+}
+
+//private slot
+void PlanningWorker::handleDisconnected()
+{
+    //A job still planning finds out when it tries to send its result
+    if (!_busy)
+        this->finished();
+}
+
+//private
+void PlanningWorker::_plan(const QByteArray &payload)
+{
+    QDataStream stream(payload);
+    stream.setVersion(WORKER_STREAM_VERSION);
+    quint64 jobId;
+    PlanningJobRequest request;
+    stream >> jobId >> request;
+    if (stream.status() != QDataStream::Ok)
+    {
+        qWarning() << "The service sent a damaged job";
+        _socket.abort();
+        return;
+    }
+
+    PlanningJobResult result;
+    QSharedPointer<PlanningProblem> problem = PlanningJob::deserializeProblem(request.problem);
+    if (problem.isNull())
+        result.errorString = "The planning problem is damaged";
+    else
+    {
+        if (_workerCount >= 0)
+            request.workers = _workerCount;
+
+        qDebug() << "Planning job" << jobId << "with" << problem->areas().size() << "areas";
+        _busy = true;
+        result = PlanningJob::run(problem, request);
+        _busy = false;
+    }
+    _jobsDone++;
+
+    if (_socket.state() != QAbstractSocket::ConnectedState)
+    {
+        qWarning() << "Lost the service while planning job" << jobId;
+        this->finished();
+        return;
+    }
+
+    QByteArray resultBytes;
+    QDataStream resultStream(&resultBytes, QIODevice::WriteOnly);
+    resultStream.setVersion(WORKER_STREAM_VERSION);
+    resultStream << jobId << result;
+    PlanningServiceProtocol::send(&_socket, PlanningServiceProtocol::Done, resultBytes);
+}
@@ -0,0 +1,55 @@
+#ifndef PLANNINGWORKER_H
+#define PLANNINGWORKER_H
+
+#include <QObject>
+#include <QString>
+#include <QTcpSocket>
+
+/**
+ * @brief The PlanningWorker class is a worker node of a PlanningService: it connects to the service, plans the
+ * jobs it's given one at a time with PlanningJob, and sends back their results. finished() is emitted when the
+ * connection to the service is lost.
+ */
+class PlanningWorker : public QObject
+{
+    Q_OBJECT
+public:
+    explicit PlanningWorker(QObject *parent = 0);
+    virtual ~PlanningWorker();
+
+    /**
+     * @brief connectToService connects to the service at address ("host:port") and announces this worker.
+     * Returns false with an explanation in errorString if the service can't be reached.
+     * @param address
+     * @param errorString
+     * @return
+     */
+    bool connectToService(const QString& address, QString * errorString = 0);
+
+    /**
+     * @brief workerCount returns the number of threads each job's planner may use. -1 (the default) lets the
+     * job decide.
+     * @return
+     */
+    int workerCount() const;
+    void setWorkerCount(int count);
+
+    int jobsDone() const;
+
+signals:
+    void finished();
+
+private slots:
+    void handleReadyRead();
+    void handleDisconnected();
+
+private:
+    void _plan(const QByteArray& payload);
+
+    QTcpSocket _socket;
+    int _workerCount;
+    int _jobsDone;
+    bool _busy;
+};
+
+#endif // PLANNINGWORKER_H
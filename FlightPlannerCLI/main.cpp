@@ -0,0 +1,538 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QScopedPointer>
+#include <QStringList>
+#include <QTextStream>
+#include <QtDebug>
+
+#include "ProblemFile.h"
+#include "PlanningLog.h"
+#include "AllocationTracker.h"
+#include "PlanCache.h"
+#include "PlanningJob.h"
+#include "PlannerTuningProfile.h"
+#include "PlanningService.h"
+#include "PlanningServiceProtocol.h"
+#include "PlanningWorker.h"
+#include "ParameterSweep/ParameterSweep.h"
+#include "Exporters/GPXExporter.h"
+#include "Exporters/BinaryExporter.h"
+#include "Exporters/PathCompressor.h"
+#include "Exporters/SegmentExporter.h"
+
+const char * USAGE =
+        "Usage: FlightPlannerCLI [options] <problem file>\n"
+        "       FlightPlannerCLI --serve <port> [--cache <directory>]\n"
+        "       FlightPlannerCLI --worker <host:port> [--workers <n>]\n"
+        "\n"
+        "Plans a flight for a saved planning problem without the GUI.\n"
+        "\n"
+        "--serve runs a planning service that hands the problems submitted with --remote out to the workers\n"
+        "started with --worker, which may be on other machines. Workers share what they've planned, so\n"
+        "variations of one problem don't plan the same sub-flights and transitions over again.\n"
+        "\n"
+        "Options:\n"
+        "  --planner <name>                 The planner to run: hierarchical (the default), greedy or\n"
+        "                                   evolutionary. The last two never stop by themselves, so give them\n"
+        "                                   a time budget.\n"
+        "  --time-budget <seconds>          Stop the planner after this long (default: when it stops)\n"
+        "  --schedule-budget <seconds>      Let the hierarchical planner's scheduler look for better schedules\n"
+        "                                   for this long once it has one (default: until optimal)\n"
+        "  --improve-budget <seconds>       Let the hierarchical planner reorder the finished schedule's task\n"
+        "                                   segments for up to this long, 0 to skip it (default 1)\n"
+        "  --seed <n>                       Seed for the planner's random choices (default 0)\n"
+        "  --workers <n>                    Threads the planner may use, 0 for one per core (default: the\n"
+        "                                   hierarchical and evolutionary planners use one per core, the\n"
+        "                                   greedy planner one)\n"
+        "  --tuning <name=value,...>        Search parameters for the planner: timeslice, greed-depth,\n"
+        "                                   subflight-branches, rrt-branches, rrt-samples, rrtstar-iterations\n"
+        "                                   and lattice-granularity. The ones left out keep their defaults, or\n"
+        "                                   --tuning-profile's values.\n"
+        "  --tuning-profile <file>          Tune the planner for the problem's mission class from a profile\n"
+        "                                   written by the benchmarks' --auto-tune\n"
+        "  --sweep-coverage                 Fly coverage tasks in back-and-forth lines instead of searching\n"
+        "  --sweep-airspeed <m/s,...>       Plan the problem with the hierarchical planner for each of these\n"
+        "                                   airspeeds at once and print one line per combination\n"
+        "  --sweep-turn-radius <m,...>      Likewise for minimum turning radii. Both together sweep every\n"
+        "                                   combination of the two.\n"
+        "  --output <file>                  Write the flight to a .gpx, .fpath or .segments (straight and arc\n"
+        "                                   commands) file. May be repeated.\n"
+        "  --compress <meters>              Drop the waypoints that straight legs between the others pass\n"
+        "                                   within this distance of before writing --output files, and fit\n"
+        "                                   .segments files this closely (default 0: keep every waypoint)\n"
+        "  --stream <file>                  Write the flight's start to a .gpx file as soon as it stops\n"
+        "                                   changing, while the rest is still being planned, and keep the\n"
+        "                                   planner to that start from then on. Not with --remote.\n"
+        "  --statistics <file>              Write the planner's stage timings and counters as JSON\n"
+        "  --trace <file>                   Write the stage timings in Chrome trace format\n"
+        "  --allocations                    Track the big allocators' memory by subsystem and print each one's\n"
+        "                                   peak (also counted in --statistics)\n"
+        "  --cache <directory>              Keep finished plans in this directory, which may be shared, and\n"
+        "                                   answer the same problem and settings from it without planning.\n"
+        "                                   Plans of changed problems start from what the newest ones worked\n"
+        "                                   out. With --serve, the service's cache.\n"
+        "  --remote <host:port>             Plan on a planning service's workers instead of here\n"
+        "  --verbose                        Print the planners' diagnostics on standard error\n"
+        "  --help                           Show this message\n"
+        "\n"
+        "Timing statistics are printed on standard output.\n";
+
+//How many of the newest cached plans' planner results a plan that misses the cache starts from
+const int CACHED_RESULTS_LIMIT = 8;
+
+//non-member
+bool exportFlight(const QList<Position>& flight, const UAVParameters& params, qreal tolerance,
+                  const QString& filePath, QString * errorString)
+{
+    const QString suffix = QFileInfo(filePath).suffix().toLower();
+    const PathCompressor compressor(params, tolerance);
+    QScopedPointer<Exporter> exporter;
+    if (suffix == "gpx")
+        exporter.reset(new GPXExporter(tolerance > 0.0 ? compressor.simplify(flight) : flight));
+    else if (suffix == "fpath")
+        exporter.reset(new BinaryExporter(tolerance > 0.0 ? compressor.simplify(flight) : flight, params));
+    else if (suffix == "segments")
+        exporter.reset(new SegmentExporter(flight, params, tolerance));
+    else
+    {
+        *errorString = "Can't export to " + suffix + " file";
+        return false;
+    }
+
+    QFile fp(filePath);
+    if (!fp.open(QFile::WriteOnly))
+    {
+        *errorString = "Failed to open " + filePath + " for writing: " + fp.errorString();
+        return false;
+    }
+    return exporter->doExport(&fp, errorString);
+}
+
+//non-member
+bool parseValues(const QString& text, QList<qreal> * values)
+{
+    foreach(const QString& part, text.split(',', QString::SkipEmptyParts))
+    {
+        bool ok;
+        const qreal value = part.trimmed().toDouble(&ok);
+        if (!ok || value <= 0.0)
+            return false;
+        values->append(value);
+    }
+    return !values->isEmpty();
+}
+
+//non-member
+bool writeBytes(const QByteArray& bytes, const QString& filePath, QString * errorString)
+{
+    QFile fp(filePath);
+    if (!fp.open(QFile::WriteOnly | QFile::Truncate))
+    {
+        *errorString = "Failed to open " + filePath + " for writing: " + fp.errorString();
+        return false;
+    }
+    if (fp.write(bytes) != bytes.size())
+    {
+        *errorString = "Failed to write " + filePath + ": " + fp.errorString();
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    QString plannerName = "hierarchical";
+    qreal timeBudget = 0.0;
+    qreal scheduleBudget = 0.0;
+    qreal improveBudget = 1.0;
+    quint64 seed = 0;
+    int workers = -1;
+    bool sweepCoverage = false;
+    QString tuningText;
+    QString tuningProfilePath;
+    qreal compressTolerance = 0.0;
+    QList<qreal> sweepAirspeeds;
+    QList<qreal> sweepTurningRadii;
+    QStringList outputs;
+    QString streamPath;
+    QString statisticsPath;
+    QString tracePath;
+    QString remoteAddress;
+    QString workerAddress;
+    QString cacheDirectory;
+    int servePort = -1;
+    QString problemPath;
+
+    const QStringList args = a.arguments();
+    for (int i = 1; i < args.size(); i++)
+    {
+        const QString& arg = args.at(i);
+        const bool hasValue = i + 1 < args.size();
+        if (arg == "--help" || arg == "-h")
+        {
+            out << USAGE;
+            return 0;
+        }
+        else if (arg == "--verbose")
+            PlanningLog::setDiagnosticsEnabled(true);
+        else if (arg == "--allocations")
+            AllocationTracker::setEnabled(true);
+        else if (arg == "--planner" && hasValue)
+            plannerName = args.at(++i).toLower();
+        else if (arg == "--time-budget" && hasValue)
+        {
+            bool ok;
+            timeBudget = args.at(++i).toDouble(&ok);
+            if (!ok || timeBudget < 0.0)
+            {
+                err << "Invalid time budget " << args.at(i) << "\n";
+                return 2;
+            }
+        }
+        else if (arg == "--schedule-budget" && hasValue)
+        {
+            bool ok;
+            scheduleBudget = args.at(++i).toDouble(&ok);
+            if (!ok || scheduleBudget < 0.0)
+            {
+                err << "Invalid schedule budget " << args.at(i) << "\n";
+                return 2;
+            }
+        }
+        else if (arg == "--improve-budget" && hasValue)
+        {
+            bool ok;
+            improveBudget = args.at(++i).toDouble(&ok);
+            if (!ok || improveBudget < 0.0)
+            {
+                err << "Invalid improvement budget " << args.at(i) << "\n";
+                return 2;
+            }
+        }
+        else if (arg == "--seed" && hasValue)
+        {
+            bool ok;
+            seed = args.at(++i).toULongLong(&ok);
+            if (!ok)
+            {
+                err << "Invalid seed " << args.at(i) << "\n";
+                return 2;
+            }
+        }
+        else if (arg == "--workers" && hasValue)
+        {
+            bool ok;
+            workers = args.at(++i).toInt(&ok);
+            if (!ok || workers < 0)
+            {
+                err << "Invalid worker count " << args.at(i) << "\n";
+                return 2;
+            }
+        }
+        else if (arg == "--tuning" && hasValue)
+        {
+            tuningText = args.at(++i);
+            PlannerTuning tuning;
+            QString tuningError;
+            if (!PlannerTuning::parse(tuningText, &tuning, &tuningError))
+            {
+                err << tuningError << "\n";
+                return 2;
+            }
+        }
+        else if (arg == "--tuning-profile" && hasValue)
+            tuningProfilePath = args.at(++i);
+        else if (arg == "--sweep-coverage")
+            sweepCoverage = true;
+        else if (arg == "--sweep-airspeed" && hasValue)
+        {
+            if (!parseValues(args.at(++i), &sweepAirspeeds))
+            {
+                err << "Invalid airspeeds " << args.at(i) << "\n";
+                return 2;
+            }
+        }
+        else if (arg == "--sweep-turn-radius" && hasValue)
+        {
+            if (!parseValues(args.at(++i), &sweepTurningRadii))
+            {
+                err << "Invalid turning radii " << args.at(i) << "\n";
+                return 2;
+            }
+        }
+        else if (arg == "--compress" && hasValue)
+        {
+            bool ok;
+            compressTolerance = args.at(++i).toDouble(&ok);
+            if (!ok || compressTolerance < 0.0)
+            {
+                err << "Invalid compression tolerance " << args.at(i) << "\n";
+                return 2;
+            }
+        }
+        else if (arg == "--output" && hasValue)
+            outputs.append(args.at(++i));
+        else if (arg == "--stream" && hasValue)
+            streamPath = args.at(++i);
+        else if (arg == "--statistics" && hasValue)
+            statisticsPath = args.at(++i);
+        else if (arg == "--trace" && hasValue)
+            tracePath = args.at(++i);
+        else if (arg == "--remote" && hasValue)
+            remoteAddress = args.at(++i);
+        else if (arg == "--cache" && hasValue)
+            cacheDirectory = args.at(++i);
+        else if (arg == "--worker" && hasValue)
+            workerAddress = args.at(++i);
+        else if (arg == "--serve" && hasValue)
+        {
+            bool ok;
+            servePort = args.at(++i).toUShort(&ok);
+            if (!ok)
+            {
+                err << "Invalid port " << args.at(i) << "\n";
+                return 2;
+            }
+        }
+        else if (arg.startsWith("-") || !problemPath.isEmpty())
+        {
+            err << "Unexpected argument " << arg << "\n\n" << USAGE;
+            return 2;
+        }
+        else
+            problemPath = arg;
+    }
+
+    QString errorString;
+
+    //Service and worker nodes run until they're killed (or, for workers, until the service goes away)
+    if (servePort >= 0)
+    {
+        PlanningService service;
+        service.setPlanCacheDirectory(cacheDirectory);
+        if (!service.listen(servePort, &errorString))
+        {
+            err << errorString << "\n";
+            return 1;
+        }
+        err << "Planning service listening on port " << servePort << "\n";
+        err.flush();
+        return a.exec();
+    }
+    if (!workerAddress.isEmpty())
+    {
+        PlanningWorker worker;
+        worker.setWorkerCount(workers);
+        if (!worker.connectToService(workerAddress, &errorString))
+        {
+            err << errorString << "\n";
+            return 1;
+        }
+        QObject::connect(&worker, SIGNAL(finished()), &a, SLOT(quit()));
+        a.exec();
+        err << "Lost the planning service after " << worker.jobsDone() << " jobs\n";
+        return 0;
+    }
+
+    if (problemPath.isEmpty())
+    {
+        err << USAGE;
+        return 2;
+    }
+    if (!PlanningJob::isKnownPlanner(plannerName))
+    {
+        err << "Unknown planner " << plannerName << "\n";
+        return 2;
+    }
+
+    QElapsedTimer loadClock;
+    loadClock.start();
+    QByteArray plannerResults;
+    QSharedPointer<PlanningProblem> problem = ProblemFile::load(problemPath, &plannerResults, &errorString);
+    if (problem.isNull())
+    {
+        err << "Failed to load planning problem: " << errorString << "\n";
+        return 1;
+    }
+    const qint64 loadTime = loadClock.elapsed();
+
+    //--tuning's parameters win over the profile's
+    PlannerTuning tuning;
+    if (!tuningProfilePath.isEmpty())
+    {
+        PlannerTuningProfile profile;
+        if (!profile.load(tuningProfilePath, &errorString))
+        {
+            err << errorString << "\n";
+            return 1;
+        }
+        tuning = profile.tuningFor(*problem);
+    }
+    PlannerTuning::parse(tuningText, &tuning);
+
+    //A sweep plans locally with the hierarchical planner and only reports how each combination did
+    if (!sweepAirspeeds.isEmpty() || !sweepTurningRadii.isEmpty())
+    {
+        if (sweepCoverage)
+            PlanningJob::useSweptCoverage(problem.data());
+
+        ParameterSweep sweep(problem);
+        sweep.setAirspeeds(sweepAirspeeds);
+        sweep.setTurningRadii(sweepTurningRadii);
+        sweep.setTimeBudget(timeBudget * 1000.0);
+        sweep.setScheduleTimeBudget(scheduleBudget * 1000.0);
+        sweep.setScheduleImprovementTimeBudget(improveBudget * 1000.0);
+        sweep.setRandomSeed(seed);
+        sweep.setTuning(tuning);
+        if (workers >= 0)
+            sweep.setWorkerCount(workers);
+        const bool swept = sweep.plan(&errorString);
+
+        out << "seed: " << seed << "\n";
+        out << "areas: " << problem->areas().size() << "\n";
+        out << "load_ms: " << loadTime << "\n";
+        out << "plan_ms: " << sweep.elapsed() << "\n";
+        const QList<UAVParameters> combinations = sweep.combinations();
+        for (int c = 0; c < combinations.size(); c++)
+        {
+            out << "airspeed: " << combinations.at(c).airspeed();
+            out << " turn_radius: " << combinations.at(c).minTurningRadius();
+            out << " flight_s: " << sweep.flightTime(c);
+            out << " fitness: " << sweep.fitness(c).combined();
+            out << " waypoints: " << sweep.flight(c).size() << "\n";
+        }
+        out.flush();
+
+        if (!swept)
+        {
+            err << errorString << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    PlanningJobRequest request;
+    request.planner = plannerName;
+    request.timeBudget = timeBudget * 1000.0;
+    request.scheduleBudget = scheduleBudget * 1000.0;
+    request.improvementBudget = improveBudget * 1000.0;
+    request.seed = seed;
+    request.workers = workers;
+    request.sweepCoverage = sweepCoverage;
+    request.tuning = tuning;
+
+    //Whatever was planned before the problem was saved doesn't have to be planned again
+    if (!plannerResults.isEmpty())
+        request.plannerResults.append(plannerResults);
+
+    if (!remoteAddress.isEmpty() && !streamPath.isEmpty())
+    {
+        err << "--stream can't be used with --remote\n";
+        return 2;
+    }
+
+    //The same problem planned the same way before is answered from the cache
+    PlanCache cache(cacheDirectory);
+    if (cache.isEnabled() || !remoteAddress.isEmpty())
+        request.problem = PlanningJob::serializeProblem(*problem);
+    const QByteArray cacheKey = cache.isEnabled() ? PlanningJob::cacheKey(request) : QByteArray();
+    PlanCache::Entry cached;
+    const bool cacheHit = cache.lookup(cacheKey, &cached);
+
+    PlanningJobResult result;
+    if (cacheHit)
+    {
+        result.planned = true;
+        result.flight = cached.flight;
+        result.fitness = cached.fitness;
+        result.elapsed = loadClock.elapsed() - loadTime;
+        if (!streamPath.isEmpty() && !exportFlight(result.flight, problem->uavParameters(), 0.0, streamPath,
+                                                   &errorString))
+        {
+            err << "Failed to write " << streamPath << ": " << errorString << "\n";
+            return 1;
+        }
+    }
+    else if (remoteAddress.isEmpty())
+    {
+        QFile stream(streamPath);
+        if (!streamPath.isEmpty() && !stream.open(QFile::WriteOnly | QFile::Truncate))
+        {
+            err << "Failed to open " << streamPath << " for writing\n";
+            return 1;
+        }
+
+        //Other plans cached here have probably worked out much of this one
+        request.plannerResults.append(cache.recentPlannerResults(CACHED_RESULTS_LIMIT));
+        result = PlanningJob::run(problem, request, streamPath.isEmpty() ? 0 : &stream);
+    }
+    else if (!PlanningServiceProtocol::submit(remoteAddress, request, &result, &errorString))
+    {
+        err << errorString << "\n";
+        return 1;
+    }
+
+    if (cache.isEnabled() && !cacheHit && result.planned)
+    {
+        PlanCache::Entry entry;
+        entry.flight = result.flight;
+        entry.fitness = result.fitness;
+        entry.plannerResults = result.plannerResults;
+        if (!cache.store(cacheKey, entry, &errorString))
+            err << "Failed to cache the plan: " << errorString << "\n";
+    }
+
+    out << "planner: " << plannerName << "\n";
+    out << "seed: " << seed << "\n";
+    out << "areas: " << problem->areas().size() << "\n";
+    out << "load_ms: " << loadTime << "\n";
+    out << "plan_ms: " << result.elapsed << "\n";
+    out << "iterations: " << result.iterations << "\n";
+    if (cache.isEnabled())
+        out << "cache_hit: " << (cacheHit ? "yes" : "no") << "\n";
+    out << "budget_exhausted: " << (result.budgetExhausted ? "yes" : "no") << "\n";
+    out << "fitness: " << result.fitness << "\n";
+    out << "waypoints: " << result.flight.size() << "\n";
+    if (AllocationTracker::isEnabled())
+    {
+        const QMap<QString, AllocationTracker::Usage> usage = AllocationTracker::usage();
+        foreach(const QString& subsystem, usage.keys())
+            out << "peak_bytes_" << subsystem << ": " << usage.value(subsystem).peakBytes << "\n";
+    }
+    out.flush();
+
+    //Worth having even when planning failed, to see where it got to
+    if (!statisticsPath.isEmpty() && !writeBytes(result.statistics, statisticsPath, &errorString))
+    {
+        err << errorString << "\n";
+        return 1;
+    }
+    if (!tracePath.isEmpty() && !writeBytes(result.trace, tracePath, &errorString))
+    {
+        err << errorString << "\n";
+        return 1;
+    }
+
+    if (!result.planned)
+    {
+        err << result.errorString << "\n";
+        return 1;
+    }
+
+    foreach(const QString& output, outputs)
+    {
+        if (!exportFlight(result.flight, problem->uavParameters(), compressTolerance, output, &errorString))
+        {
+            err << "Failed to export " << output << ": " << errorString << "\n";
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -1,12 +1,38 @@
 #include "GPX.h"
-#include "GPXXMLHandler.h"
+#include "GPXStreamParser.h"
+#include "GPXFileIndex.h"
+#include "GPXStreamWriter.h"
 
 #include <QFile>
-#include <QSharedPointer>
-#include <QTextStream>
-#include <QDomDocument>
+#include <QFileInfo>
+#include <QBuffer>
+#include <QtConcurrentMap>
 #include <QtDebug>
 
+//Files at least this big are indexed and their segments parsed in parallel
+const qint64 PARALLEL_MIN_BYTES = 8 * 1024 * 1024;
+
+//One trkseg for parseSegment() to read
+struct SegmentJob
+{
+    const char * data;
+    qint64 length;
+    bool ok;
+    QString error;
+    QVector<GPXPoint> points;
+};
+
+//non-member
+void parseSegment(SegmentJob& job)
+{
+    QByteArray bytes = QByteArray::fromRawData(job.data, job.length);
+    QBuffer buffer(&bytes);
+    buffer.open(QIODevice::ReadOnly);
+
+    GPXStreamParser parser;
+    job.ok = parser.parse(&buffer, &job.error);
+    job.points = parser.points();
+}
 
 GPX::GPX()
 {
@@ -17,12 +43,12 @@ GPX::~GPX()
 
 }
 
-void GPX::setPoints(QList<GPXPoint> nPoints)
+void GPX::setPoints(const QVector<GPXPoint>& nPoints)
 {
     _points = nPoints;
 }
 
-const QList<GPXPoint> &GPX::points() const
+const QVector<GPXPoint> &GPX::points() const
 {
     return _points;
 }
@@ -32,71 +58,212 @@ void GPX::appendPoint(GPXPoint point)
     _points.append(point);
 }
 
-bool GPX::toXML(QByteArray *dest, QString *)
+void GPX::setTracks(const QList<GPXTrack> &nTracks)
 {
-    QTextStream stream(dest);
-    QDomDocument doc;
+    _tracks = nTracks;
+}
 
-    QDomElement root = doc.createElement("gpx");
-    root.setAttribute("version",1.1);
-    root.setAttribute("creator","CommStation");
-    root.setAttribute("xmlns:xsi","http://www.w3.org/2001/XMLSchema-instance");
-    root.setAttribute("xmlns","http://www.topografix.com/GPX/1/1");
-    root.setAttribute("xsi:schemaLocation","http://www.topografix.com/GPX/1/1 http://www.topografix.com/GPX/1/1/gpx.xsd");
-    doc.appendChild(root);
+const QList<GPXTrack> &GPX::tracks() const
+{
+    return _tracks;
+}
 
-    QDomElement track = doc.createElement("trk");
-    root.appendChild(track);
-    QDomElement segment = doc.createElement("trkseg");
-    track.appendChild(segment);
+QVector<GPXPoint> GPX::trackPoints(int track) const
+{
+    if (_tracks.isEmpty() && track == 0)
+        return _points;
+    if (track < 0 || track >= _tracks.size())
+        return QVector<GPXPoint>();
 
+    const GPXTrack& info = _tracks.at(track);
+    return _points.mid(info.firstPoint, info.pointCount);
+}
 
-    foreach(GPXPoint point, _points)
-    {
-        QDomElement trackPoint = doc.createElement("trkpt");
-        trackPoint.setAttribute("lat",point.latitude);
-        trackPoint.setAttribute("lon",point.longitude);
+bool GPX::toXML(QByteArray *dest, QString * errorMessage)
+{
+    QBuffer buffer(dest);
+    buffer.open(QIODevice::WriteOnly);
 
-        QDomElement timeNode = doc.createElement("time");
-        QDomText timeNodeText = doc.createTextNode(point.time.toString(Qt::ISODate));
-        timeNode.appendChild(timeNodeText);
-        trackPoint.appendChild(timeNode);
+    GPXStreamWriter writer(&buffer);
+    if (!writer.begin(errorMessage))
+        return false;
 
-        QDomElement heightNode = doc.createElement("ele");
-        QDomText heightNodeText = doc.createTextNode(QString::number(point.height));
-        heightNode.appendChild(heightNodeText);
-        trackPoint.appendChild(heightNode);
+    //Without tracks, write everything as one track and segment
+    QList<GPXTrack> tracks = _tracks;
+    if (tracks.isEmpty())
+    {
+        GPXTrack all;
+        all.pointCount = _points.size();
+        all.segmentStarts.append(0);
+        tracks.append(all);
+    }
 
-        segment.appendChild(trackPoint);
+    foreach(const GPXTrack& info, tracks)
+    {
+        writer.beginTrack(info.name);
+        for (int seg = 0; seg < info.segmentCount(); seg++)
+        {
+            writer.beginSegment();
 
+            const int first = info.segmentStarts.at(seg);
+            for (int i = first; i < first + info.segmentPointCount(seg); i++)
+                writer.writePoint(_points.at(i));
+        }
     }
 
-    doc.save(stream,0);
-    return true;
+    return writer.end(errorMessage);
 }
 
 //static
 bool GPX::parseGPXFile(QString filePath, GPX *output, QString *messages)
 {
-    QSharedPointer<QFile> fp(new QFile(filePath));
-    if (!fp->exists())
+    if (QFileInfo(filePath).size() >= PARALLEL_MIN_BYTES)
+        return GPX::parseIndexed(filePath, 0, output, messages);
+
+    GPXStreamParser parser;
+    if (!parser.parseFile(filePath, messages))
+        return false;
+
+    output->setPoints(parser.points());
+    output->setTracks(parser.tracks());
+    return true;
+}
+
+//static
+bool GPX::parseGPXFile(QString filePath, const QList<int> &tracks, GPX *output, QString *messages)
+{
+    return GPX::parseIndexed(filePath, &tracks, output, messages);
+}
+
+//static
+bool GPX::readTrackNames(QString filePath, QStringList *names, QString *messages)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        if (messages)
+            *messages = "Failed to open " + filePath + ": " + file.errorString();
+        return false;
+    }
+
+    QByteArray bytes;
+    qint64 size = file.size();
+    const char * data = (size > 0) ? (const char *) file.map(0, size) : 0;
+    if (data == 0)
+    {
+        bytes = file.readAll();
+        data = bytes.constData();
+        size = bytes.size();
+    }
+
+    GPXFileIndex index;
+    if (!index.build(data, size, messages))
+        return false;
+
+    names->clear();
+    for (int i = 0; i < index.trackCount(); i++)
+        names->append(index.trackName(i));
+    return true;
+}
+
+//private static
+bool GPX::parseIndexed(QString filePath, const QList<int> *tracks, GPX *output, QString *messages)
+{
+    QFile file(filePath);
+    if (!file.exists())
     {
         if (messages)
             *messages = "No such file:" + filePath;
         return false;
     }
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        if (messages)
+            *messages = "Failed to open " + filePath + ": " + file.errorString();
+        return false;
+    }
 
-    QSharedPointer<GPXXMLHandler> handler(new GPXXMLHandler());
-    QXmlSimpleReader reader;
-    QXmlInputSource source(fp.data());
-    reader.setContentHandler(handler.data());
-    if (!reader.parse(source))
+    //Map the file so that the segments can be parsed straight out of it. It's unmapped when file closes.
+    QByteArray bytes;
+    qint64 size = file.size();
+    const char * data = (size > 0) ? (const char *) file.map(0, size) : 0;
+    if (data == 0)
     {
-        *messages = handler->errorString();
+        bytes = file.readAll();
+        data = bytes.constData();
+        size = bytes.size();
+    }
+
+    GPXFileIndex index;
+    if (!index.build(data, size, messages))
         return false;
+
+    QList<int> wanted;
+    if (tracks)
+        wanted = *tracks;
+    else
+        for (int i = 0; i < index.trackCount(); i++)
+            wanted.append(i);
+
+    QVector<SegmentJob> jobs;
+    qint64 jobBytes = 0;
+    foreach(int track, wanted)
+    {
+        if (track < 0 || track >= index.trackCount())
+        {
+            if (messages)
+                *messages = QString("%1 has no track %2").arg(filePath).arg(track);
+            return false;
+        }
+
+        for (int i = 0; i < index.segmentCount(track); i++)
+        {
+            SegmentJob job;
+            job.data = data + index.segmentOffset(track, i);
+            job.length = index.segmentLength(track, i);
+            job.ok = false;
+            jobs.append(job);
+            jobBytes += job.length;
+        }
+    }
+
+    if (jobs.size() > 1 && jobBytes >= PARALLEL_MIN_BYTES)
+        QtConcurrent::blockingMap(jobs, parseSegment);
+    else
+        for (int i = 0; i < jobs.size(); i++)
+            parseSegment(jobs[i]);
+
+    //Stitch the segments back together, in the order the tracks were asked for
+    int pointCount = 0;
+    foreach(const SegmentJob& job, jobs)
+        pointCount += job.points.size();
+
+    QVector<GPXPoint> points;
+    points.reserve(pointCount);
+    QList<GPXTrack> parsedTracks;
+    int jobIndex = 0;
+    foreach(int track, wanted)
+    {
+        GPXTrack info;
+        info.name = index.trackName(track);
+        info.firstPoint = points.size();
+        for (int i = 0; i < index.segmentCount(track); i++, jobIndex++)
+        {
+            const SegmentJob& job = jobs.at(jobIndex);
+            if (!job.ok)
+            {
+                if (messages)
+                    *messages = QString("Track %1, segment %2: %3").arg(track).arg(i).arg(job.error);
+                return false;
+            }
+            info.segmentStarts.append(points.size());
+            points += job.points;
+        }
+        info.pointCount = points.size() - info.firstPoint;
+        parsedTracks.append(info);
     }
 
-    fp->close();
-    (*output).setPoints(handler->getPoints());
+    output->setPoints(points);
+    output->setTracks(parsedTracks);
     return true;
 }
@@ -3,10 +3,16 @@
 
 #include "GPX_global.h"
 #include "GPXPoint.h"
+#include "GPXTrack.h"
+
+#include <QVector>
+#include <QList>
+#include <QStringList>
 
 /**
- * @brief Represents a simple GPX file. Parses all GPX files as if they
- * only had a single track and segment.
+ * @brief Represents a simple GPX file: the points of its tracks, in order,
+ * and the tracks and segments they belong to. A GPX without tracks() is
+ * treated as a single track with a single segment.
  *
  */
 class GPXSHARED_EXPORT GPX
@@ -18,15 +24,15 @@ public:
     /**
      * @brief Sets the points that comprise a GPX log
      *
-     * @param QList<GPXPoint>
+     * @param QVector<GPXPoint>
      */
-    void setPoints(QList<GPXPoint>);
+    void setPoints(const QVector<GPXPoint>&);
 
     /**
      * @brief points returns the list of points within this GPX object.
      * @return
      */
-    const QList<GPXPoint>& points() const;
+    const QVector<GPXPoint>& points() const;
 
     /**
      * @brief Append a single point to the GPX track
@@ -35,10 +41,31 @@ public:
      */
     void appendPoint(GPXPoint);
 
+    /**
+     * @brief Sets the tracks that divide points() into trk and trkseg
+     *
+     * @param QList<GPXTrack>
+     */
+    void setTracks(const QList<GPXTrack>&);
+
+    /**
+     * @brief tracks returns the tracks of this GPX object. Empty means
+     * points() form a single track.
+     */
+    const QList<GPXTrack>& tracks() const;
+
+    /**
+     * @brief trackPoints returns the points of a single track
+     *
+     * @param track index into tracks()
+     */
+    QVector<GPXPoint> trackPoints(int track) const;
+
     /**
      * @brief Serializes the GPX object to XML. Outputs to the given
      * QByteArray pointer. Returns true on success. On failure, an error
-     * will be written to the errorMessage pointer, if provided.
+     * will be written to the errorMessage pointer, if provided. Use
+     * GPXStreamWriter to write large logs straight to a file instead.
      *
      * @param dest
      * @param errorMessage
@@ -51,7 +78,7 @@ public:
      * Returns true on success, false on failure. The parsed GPX object will be
      * assigned to the pointer you provide in the output argument.
      * If the optional messages argument is supplied and non-null, error messages
-     * will be placed there.
+     * will be placed there. Use GPXStreamParser directly to import large files in chunks.
      *
      * @param filePath path to the the .gpx file you want parsed
      * @param output where the parsed GPX object will be placed, if successful
@@ -59,8 +86,36 @@ public:
      */
     static bool parseGPXFile(QString filePath, GPX * output, QString * messages =0);
 
+    /**
+     * @brief Like parseGPXFile(), but only parses the trk elements whose
+     * (zero-based) indices are in tracks, in the order given. The rest of
+     * the file is only scanned, not parsed.
+     *
+     * @param filePath path to the the .gpx file you want parsed
+     * @param tracks indices of the tracks to load
+     * @param output where the parsed GPX object will be placed, if successful
+     * @param messages where erros messages will be written if something bad happens
+     */
+    static bool parseGPXFile(QString filePath, const QList<int>& tracks,
+                             GPX * output, QString * messages =0);
+
+    /**
+     * @brief Lists the names of the tracks in a .gpx file without parsing
+     * their points. Unnamed tracks get an empty string. Returns true on
+     * success, false on failure with an explanation in messages.
+     *
+     * @param filePath path to the the .gpx file
+     * @param names where the track names will be placed, if successful
+     * @param messages where erros messages will be written if something bad happens
+     */
+    static bool readTrackNames(QString filePath, QStringList * names, QString * messages =0);
+
 private:
-    QList<GPXPoint> _points;
+    static bool parseIndexed(QString filePath, const QList<int> * tracks,
+                             GPX * output, QString * messages);
+
+    QVector<GPXPoint> _points;
+    QList<GPXTrack> _tracks;
 };
 
 #endif // GPX_H
@@ -4,23 +4,31 @@
 #
 #-------------------------------------------------
 
-QT       += xml
-
 QT       -= gui
 
+greaterThan(QT_MAJOR_VERSION, 4): QT += concurrent
+
 TARGET = GPX
 TEMPLATE = lib
 
 DEFINES += GPX_LIBRARY
 
 SOURCES += GPX.cpp \
-    GPXXMLHandler.cpp \
-    GPXPoint.cpp
+    GPXStreamParser.cpp \
+    GPXTrack.cpp \
+    GPXFileIndex.cpp \
+    GPXStreamWriter.cpp \
+    GPXPoint.cpp \
+    GPXTimeIndex.cpp
 
 HEADERS += GPX.h\
         GPX_global.h \
-    GPXXMLHandler.h \
-    GPXPoint.h
+    GPXStreamParser.h \
+    GPXTrack.h \
+    GPXFileIndex.h \
+    GPXStreamWriter.h \
+    GPXPoint.h \
+    GPXTimeIndex.h
 
 unix:!symbian {
     maemo5 {
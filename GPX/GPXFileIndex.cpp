@@ -0,0 +1,216 @@
+#include "GPXFileIndex.h"
+
+#include <QByteArray>
+#include <QXmlStreamReader>
+#include <cstring>
+
+//non-member
+const char * findBytes(const char * from, const char * end, const char * needle)
+{
+    const size_t needleLength = strlen(needle);
+    while (end - from >= (qint64)needleLength)
+    {
+        const char * candidate = (const char *) memchr(from, needle[0], end - from - needleLength + 1);
+        if (candidate == 0)
+            return 0;
+        if (memcmp(candidate, needle, needleLength) == 0)
+            return candidate;
+        from = candidate + 1;
+    }
+    return 0;
+}
+
+//non-member
+//Whether the tag name at p is exactly name, i.e. name followed by whitespace, '>' or '/'
+bool tagNameAt(const char * p, const char * end, const char * name)
+{
+    const size_t length = strlen(name);
+    if (end - p <= (qint64)length || memcmp(p, name, length) != 0)
+        return false;
+
+    const char next = p[length];
+    return next == '>' || next == '/' || next == ' ' || next == '\t' || next == '\r' || next == '\n';
+}
+
+//non-member
+//Returns the '>' ending the tag that p is inside of, or 0 if there isn't one
+const char * tagEnd(const char * p, const char * end)
+{
+    return (const char *) memchr(p, '>', end - p);
+}
+
+GPXFileIndex::GPXFileIndex()
+{
+}
+
+GPXFileIndex::~GPXFileIndex()
+{
+}
+
+bool GPXFileIndex::build(const char *data, qint64 size, QString *errorString)
+{
+    this->clear();
+
+    const char * const end = data + size;
+    const char * p = data;
+    bool inTrack = false;
+    bool inSegment = false;
+    Track track;
+    Segment segment;
+
+    while (p < end)
+    {
+        p = (const char *) memchr(p, '<', end - p);
+        if (p == 0)
+            break;
+        const char * const tagStart = p;
+        p++;
+
+        const char * skipTo = 0;
+        if (end - p >= 3 && memcmp(p, "!--", 3) == 0)
+            skipTo = findBytes(p + 3, end, "-->");
+        else if (end - p >= 8 && memcmp(p, "![CDATA[", 8) == 0)
+            skipTo = findBytes(p + 8, end, "]]>");
+        else if (end - p >= 1 && *p == '?')
+            skipTo = findBytes(p + 1, end, "?>");
+        else if (tagNameAt(p, end, "trkseg"))
+        {
+            if (inSegment)
+                break;
+            if (!inTrack)
+                continue;
+
+            const char * const close = tagEnd(p, end);
+            if (close == 0)
+                break;
+            segment.offset = tagStart - data;
+            if (close[-1] == '/')
+            {
+                segment.length = close + 1 - tagStart;
+                track.segments.append(segment);
+            }
+            else
+                inSegment = true;
+            p = close + 1;
+            continue;
+        }
+        else if (tagNameAt(p, end, "/trkseg"))
+        {
+            const char * const close = tagEnd(p, end);
+            if (close == 0)
+                break;
+            if (inSegment)
+            {
+                segment.length = close + 1 - tagStart;
+                track.segments.append(segment);
+                inSegment = false;
+            }
+            p = close + 1;
+            continue;
+        }
+        else if (inSegment)
+            continue;
+        else if (tagNameAt(p, end, "trk"))
+        {
+            const char * const close = tagEnd(p, end);
+            if (close == 0)
+                break;
+            track = Track();
+            if (close[-1] == '/')
+                _tracks.append(track);
+            else
+                inTrack = true;
+            p = close + 1;
+            continue;
+        }
+        else if (tagNameAt(p, end, "/trk"))
+        {
+            if (inTrack)
+                _tracks.append(track);
+            inTrack = false;
+            continue;
+        }
+        else if (inTrack && track.name.isEmpty() && track.segments.isEmpty() && tagNameAt(p, end, "name"))
+        {
+            //The name is short, so let a real XML reader deal with entities and character references
+            const char * const nameEnd = findBytes(p, end, "</name>");
+            if (nameEnd == 0)
+                break;
+            QXmlStreamReader reader(QByteArray::fromRawData(tagStart, nameEnd + 7 - tagStart));
+            if (reader.readNextStartElement())
+                track.name = reader.readElementText();
+            p = nameEnd + 7;
+            continue;
+        }
+        else
+            continue;
+
+        //A comment, CDATA section or processing instruction
+        if (skipTo == 0)
+            break;
+        p = skipTo + 1;
+    }
+
+    if (p != 0 && p < end)
+    {
+        if (errorString)
+            *errorString = QString("Malformed GPX near byte %1").arg(p - data);
+        this->clear();
+        return false;
+    }
+
+    if (inTrack || inSegment)
+    {
+        if (errorString)
+            *errorString = inSegment ? "Unterminated <trkseg>" : "Unterminated <trk>";
+        this->clear();
+        return false;
+    }
+
+    return true;
+}
+
+void GPXFileIndex::clear()
+{
+    _tracks.clear();
+}
+
+int GPXFileIndex::trackCount() const
+{
+    return _tracks.size();
+}
+
+QString GPXFileIndex::trackName(int track) const
+{
+    if (track < 0 || track >= _tracks.size())
+        return QString();
+    return _tracks.at(track).name;
+}
+
+int GPXFileIndex::segmentCount(int track) const
+{
+    if (track < 0 || track >= _tracks.size())
+        return 0;
+    return _tracks.at(track).segments.size();
+}
+
+qint64 GPXFileIndex::segmentOffset(int track, int segment) const
+{
+    if (!this->validSegment(track, segment))
+        return -1;
+    return _tracks.at(track).segments.at(segment).offset;
+}
+
+qint64 GPXFileIndex::segmentLength(int track, int segment) const
+{
+    if (!this->validSegment(track, segment))
+        return 0;
+    return _tracks.at(track).segments.at(segment).length;
+}
+
+//private
+bool GPXFileIndex::validSegment(int track, int segment) const
+{
+    return track >= 0 && track < _tracks.size()
+            && segment >= 0 && segment < _tracks.at(track).segments.size();
+}
@@ -0,0 +1,70 @@
+#ifndef GPXFILEINDEX_H
+#define GPXFILEINDEX_H
+
+#include "GPX_global.h"
+
+#include <QString>
+#include <QList>
+
+/**
+ * @brief The GPXFileIndex class finds where each trk and trkseg of a GPX document is without parsing the
+ * points. It scans the raw bytes for the tags (skipping comments, CDATA and processing instructions), so
+ * building it is far cheaper than a full parse.
+ *
+ * Each segment's byte range is a well-formed XML fragment that can be handed to a GPXStreamParser on its
+ * own, which is what lets GPX parse segments in parallel and load only some tracks. Tags are expected
+ * without a namespace prefix and the document in UTF-8 (or ASCII), as GPX files practically always are.
+ */
+class GPXSHARED_EXPORT GPXFileIndex
+{
+public:
+    GPXFileIndex();
+    ~GPXFileIndex();
+
+    /**
+     * @brief build indexes the size bytes at data, replacing any previous index. Returns true on success,
+     * false on failure (e.g. an unterminated trk) with an explanation in errorString.
+     */
+    bool build(const char * data, qint64 size, QString * errorString = 0);
+
+    void clear();
+
+    int trackCount() const;
+
+    /**
+     * @brief trackName returns the name element of track, or an empty string if it has none
+     */
+    QString trackName(int track) const;
+
+    int segmentCount(int track) const;
+
+    /**
+     * @brief segmentOffset returns where in the document the segment's opening tag starts
+     */
+    qint64 segmentOffset(int track, int segment) const;
+
+    /**
+     * @brief segmentLength returns the number of bytes from the segment's opening tag to the end of its
+     * closing tag
+     */
+    qint64 segmentLength(int track, int segment) const;
+
+private:
+    struct Segment
+    {
+        qint64 offset;
+        qint64 length;
+    };
+
+    struct Track
+    {
+        QString name;
+        QList<Segment> segments;
+    };
+
+    bool validSegment(int track, int segment) const;
+
+    QList<Track> _tracks;
+};
+
+#endif // GPXFILEINDEX_H
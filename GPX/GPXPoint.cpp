@@ -1,6 +1,7 @@
 #include "GPXPoint.h"
 
-GPXPoint::GPXPoint()
+GPXPoint::GPXPoint() :
+    longitude(0.0), latitude(0.0), height(0.0)
 {
 }
 
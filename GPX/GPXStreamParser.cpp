@@ -0,0 +1,216 @@
+#include "GPXStreamParser.h"
+
+#include <QFile>
+#include <QXmlStreamReader>
+#include <QtDebug>
+
+//A track point with an elevation and a time takes roughly this many bytes of GPX
+const qint64 ESTIMATED_BYTES_PER_POINT = 100;
+
+//Don't trust the estimate further than this when reserving up front
+const qint64 MAX_RESERVED_POINTS = 16 * 1024 * 1024;
+
+//non-member
+bool namesMatch(const QStringRef& name, const char * expected)
+{
+    return name.compare(QLatin1String(expected), Qt::CaseInsensitive) == 0;
+}
+
+//non-member
+double toDouble(const QStringRef& text, bool * ok)
+{
+#if QT_VERSION >= 0x050100
+    return text.toDouble(ok);
+#else
+    return text.toString().toDouble(ok);
+#endif
+}
+
+GPXStreamParser::GPXStreamParser() :
+    _chunkSize(0), _pointCount(0)
+{
+}
+
+GPXStreamParser::~GPXStreamParser()
+{
+}
+
+int GPXStreamParser::chunkSize() const
+{
+    return _chunkSize;
+}
+
+void GPXStreamParser::setChunkSize(int chunkSize)
+{
+    _chunkSize = qMax<int>(0, chunkSize);
+}
+
+bool GPXStreamParser::parse(QIODevice *device, QString *errorString)
+{
+    _points.clear();
+    _pointCount = 0;
+    _tracks.clear();
+
+    if (device == 0 || !device->isReadable())
+    {
+        if (errorString)
+            *errorString = "GPX input is not open for reading";
+        return false;
+    }
+
+    //Reserve either one chunk or, when keeping everything, enough for the whole input
+    qint64 reserve = _chunkSize;
+    if (_chunkSize == 0 && !device->isSequential())
+        reserve = qMin<qint64>(device->size() / ESTIMATED_BYTES_PER_POINT, MAX_RESERVED_POINTS);
+    _points.reserve(reserve);
+
+    QXmlStreamReader reader(device);
+    GPXPoint current;
+    bool inPoint = false;
+    GPXTrack track;
+    bool inTrack = false;
+    bool inSegment = false;
+
+    while (!reader.atEnd())
+    {
+        const QXmlStreamReader::TokenType token = reader.readNext();
+
+        if (token == QXmlStreamReader::StartElement)
+        {
+            const QStringRef name = reader.name();
+            if (namesMatch(name, "trkpt"))
+            {
+                current = GPXPoint();
+                inPoint = true;
+
+                bool ok = true;
+                const QXmlStreamAttributes attributes = reader.attributes();
+                for (int i = 0; i < attributes.size() && ok; i++)
+                {
+                    const QXmlStreamAttribute& attribute = attributes.at(i);
+                    if (namesMatch(attribute.name(), "lat"))
+                        current.latitude = toDouble(attribute.value(), &ok);
+                    else if (namesMatch(attribute.name(), "lon"))
+                        current.longitude = toDouble(attribute.value(), &ok);
+                    if (!ok)
+                        reader.raiseError("Failed to parse " + attribute.value().toString() + " as double");
+                }
+            }
+            else if (inPoint && namesMatch(name, "ele"))
+            {
+                const QString text = reader.readElementText();
+                bool ok;
+                current.height = text.toDouble(&ok);
+                if (!ok)
+                    reader.raiseError("Failed to parse " + text + " as double");
+            }
+            else if (inPoint && namesMatch(name, "time"))
+            {
+                const QString text = reader.readElementText();
+                current.time = QDateTime::fromString(text, Qt::ISODate);
+                if (!current.time.isValid())
+                    reader.raiseError("Failed to parse " + text + " as a time");
+            }
+            else if (!inPoint && namesMatch(name, "trkseg"))
+            {
+                inSegment = true;
+                if (inTrack)
+                    track.segmentStarts.append(_pointCount);
+            }
+            else if (!inSegment && namesMatch(name, "trk"))
+            {
+                track = GPXTrack();
+                track.firstPoint = _pointCount;
+                inTrack = true;
+            }
+            else if (inTrack && !inSegment && namesMatch(name, "name"))
+                track.name = reader.readElementText();
+        }
+        else if (token == QXmlStreamReader::EndElement)
+        {
+            const QStringRef name = reader.name();
+            if (inPoint && namesMatch(name, "trkpt"))
+            {
+                inPoint = false;
+                _points.append(current);
+                _pointCount++;
+
+                if (_chunkSize > 0 && _points.size() >= _chunkSize && !this->flushChunk())
+                    reader.raiseError("GPX import was cancelled");
+            }
+            else if (inSegment && namesMatch(name, "trkseg"))
+                inSegment = false;
+            else if (inTrack && !inSegment && namesMatch(name, "trk"))
+            {
+                inTrack = false;
+                track.pointCount = _pointCount - track.firstPoint;
+                _tracks.append(track);
+            }
+        }
+    }
+
+    if (!reader.hasError() && !this->flushChunk())
+        reader.raiseError("GPX import was cancelled");
+
+    if (reader.hasError())
+    {
+        if (errorString)
+            *errorString = QString("%1 at line %2, column %3").arg(reader.errorString())
+                    .arg(reader.lineNumber()).arg(reader.columnNumber());
+        return false;
+    }
+    return true;
+}
+
+bool GPXStreamParser::parseFile(const QString &filePath, QString *errorString)
+{
+    QFile file(filePath);
+    if (!file.exists())
+    {
+        if (errorString)
+            *errorString = "No such file:" + filePath;
+        return false;
+    }
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        if (errorString)
+            *errorString = "Failed to open " + filePath + ": " + file.errorString();
+        return false;
+    }
+    return this->parse(&file, errorString);
+}
+
+const QVector<GPXPoint> &GPXStreamParser::points() const
+{
+    return _points;
+}
+
+qint64 GPXStreamParser::pointCount() const
+{
+    return _pointCount;
+}
+
+const QList<GPXTrack> &GPXStreamParser::tracks() const
+{
+    return _tracks;
+}
+
+//protected
+bool GPXStreamParser::processChunk(const QVector<GPXPoint> &chunk)
+{
+    Q_UNUSED(chunk)
+    return true;
+}
+
+//private
+bool GPXStreamParser::flushChunk()
+{
+    if (_chunkSize == 0 || _points.isEmpty())
+        return true;
+
+    const bool keepGoing = this->processChunk(_points);
+
+    //resize() rather than clear() so that the buffer's capacity is reused for the next chunk
+    _points.resize(0);
+    return keepGoing;
+}
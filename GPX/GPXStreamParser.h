@@ -0,0 +1,82 @@
+#ifndef GPXSTREAMPARSER_H
+#define GPXSTREAMPARSER_H
+
+#include "GPX_global.h"
+#include "GPXPoint.h"
+#include "GPXTrack.h"
+
+#include <QVector>
+#include <QList>
+#include <QString>
+
+class QIODevice;
+
+/**
+ * @brief The GPXStreamParser class reads the track points of a GPX file with a QXmlStreamReader, in one
+ * pass and without building a document. The points of every track and segment are read in document order
+ * and tracks() records where each one starts.
+ *
+ * With the default chunkSize() of zero every point is kept in points(), which is reserved up front from the
+ * size of the input. To import very large logs in constant memory, subclass it, set a chunk size and
+ * reimplement processChunk(): the points are then handed over that many at a time and never all held.
+ */
+class GPXSHARED_EXPORT GPXStreamParser
+{
+public:
+    GPXStreamParser();
+    virtual ~GPXStreamParser();
+
+    /**
+     * @brief chunkSize is how many points are collected before they're passed to processChunk(). Zero keeps
+     * every point in points() instead.
+     */
+    int chunkSize() const;
+    void setChunkSize(int chunkSize);
+
+    /**
+     * @brief parse reads GPX from device, which must be open for reading. Returns true on success, false on
+     * failure with an explanation in errorString.
+     */
+    bool parse(QIODevice * device, QString * errorString = 0);
+
+    /**
+     * @brief parseFile opens filePath and parses it. Returns true on success, false on failure with an
+     * explanation in errorString.
+     */
+    bool parseFile(const QString& filePath, QString * errorString = 0);
+
+    /**
+     * @brief points returns the points parsed so far that haven't been passed to processChunk()
+     */
+    const QVector<GPXPoint>& points() const;
+
+    /**
+     * @brief pointCount returns the number of points the last parse read, including those already passed
+     * to processChunk()
+     */
+    qint64 pointCount() const;
+
+    /**
+     * @brief tracks returns the trk elements the last parse read. Their point indices count every point
+     * read, so with a non-zero chunkSize() they refer to the stream rather than to points().
+     */
+    const QList<GPXTrack>& tracks() const;
+
+protected:
+    /**
+     * @brief processChunk is called with every chunkSize() points, and once more with what's left at the
+     * end, when chunkSize() is non-zero. Return false to stop parsing with an error. The default
+     * implementation discards the points.
+     */
+    virtual bool processChunk(const QVector<GPXPoint>& chunk);
+
+private:
+    bool flushChunk();
+
+    int _chunkSize;
+    QVector<GPXPoint> _points;
+    qint64 _pointCount;
+    QList<GPXTrack> _tracks;
+};
+
+#endif // GPXSTREAMPARSER_H
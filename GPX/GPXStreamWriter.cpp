@@ -0,0 +1,118 @@
+#include "GPXStreamWriter.h"
+
+#include <QIODevice>
+
+//Significant digits written for coordinates and heights. Ten keeps latitude and longitude to about a centimeter
+const int COORDINATE_PRECISION = 10;
+
+GPXStreamWriter::GPXStreamWriter(QIODevice *device) :
+    _device(device), _writer(device), _inTrack(false), _inSegment(false)
+{
+    _writer.setAutoFormatting(true);
+    _writer.setAutoFormattingIndent(1);
+}
+
+GPXStreamWriter::~GPXStreamWriter()
+{
+}
+
+bool GPXStreamWriter::begin(QString *errorString)
+{
+    if (_device == 0 || !_device->isWritable())
+    {
+        if (errorString)
+            *errorString = "GPX output is not open for writing";
+        return false;
+    }
+
+    _writer.writeStartDocument();
+    _writer.writeStartElement("gpx");
+    _writer.writeAttribute("version", "1.1");
+    _writer.writeAttribute("creator", "CommStation");
+    _writer.writeAttribute("xmlns:xsi", "http://www.w3.org/2001/XMLSchema-instance");
+    _writer.writeAttribute("xmlns", "http://www.topografix.com/GPX/1/1");
+    _writer.writeAttribute("xsi:schemaLocation",
+                           "http://www.topografix.com/GPX/1/1 http://www.topografix.com/GPX/1/1/gpx.xsd");
+    return this->checkDevice(errorString);
+}
+
+void GPXStreamWriter::beginTrack(const QString &name)
+{
+    this->endTrack();
+
+    _writer.writeStartElement("trk");
+    if (!name.isEmpty())
+        _writer.writeTextElement("name", name);
+    _inTrack = true;
+}
+
+void GPXStreamWriter::endTrack()
+{
+    if (!_inTrack)
+        return;
+
+    this->endSegment();
+    _writer.writeEndElement();
+    _inTrack = false;
+}
+
+void GPXStreamWriter::beginSegment()
+{
+    if (!_inTrack)
+        this->beginTrack();
+    this->endSegment();
+
+    _writer.writeStartElement("trkseg");
+    _inSegment = true;
+}
+
+void GPXStreamWriter::endSegment()
+{
+    if (!_inSegment)
+        return;
+
+    _writer.writeEndElement();
+    _inSegment = false;
+}
+
+void GPXStreamWriter::writePoint(double longitude, double latitude, double height, const QDateTime &time)
+{
+    if (!_inSegment)
+        this->beginSegment();
+
+    _writer.writeStartElement("trkpt");
+    _writer.writeAttribute("lat", QString::number(latitude, 'g', COORDINATE_PRECISION));
+    _writer.writeAttribute("lon", QString::number(longitude, 'g', COORDINATE_PRECISION));
+    _writer.writeTextElement("ele", QString::number(height, 'g', COORDINATE_PRECISION));
+    if (time.isValid())
+        _writer.writeTextElement("time", time.toString(Qt::ISODate));
+    _writer.writeEndElement();
+}
+
+void GPXStreamWriter::writePoint(const GPXPoint &point)
+{
+    this->writePoint(point.longitude, point.latitude, point.height, point.time);
+}
+
+bool GPXStreamWriter::end(QString *errorString)
+{
+    this->endTrack();
+    _writer.writeEndDocument();
+    return this->checkDevice(errorString);
+}
+
+//private
+bool GPXStreamWriter::checkDevice(QString *errorString) const
+{
+#if QT_VERSION >= 0x040800
+    if (_writer.hasError())
+    {
+        if (errorString)
+            *errorString = "Failed to write GPX: " + _device->errorString();
+        return false;
+    }
+#else
+    Q_UNUSED(errorString)
+#endif
+    return true;
+}
@@ -0,0 +1,59 @@
+#ifndef GPXSTREAMWRITER_H
+#define GPXSTREAMWRITER_H
+
+#include "GPX_global.h"
+#include "GPXPoint.h"
+
+#include <QXmlStreamWriter>
+#include <QString>
+#include <QDateTime>
+
+class QIODevice;
+
+/**
+ * @brief The GPXStreamWriter class writes a GPX document to a QIODevice one point at a time with a
+ * QXmlStreamWriter, so nothing but the point being written is ever held in memory.
+ *
+ * Call begin(), then beginTrack()/beginSegment() and writePoint() as needed, then end(). writePoint() opens
+ * a track and segment if none is open, and end() closes whatever is still open.
+ */
+class GPXSHARED_EXPORT GPXStreamWriter
+{
+public:
+    explicit GPXStreamWriter(QIODevice * device);
+    ~GPXStreamWriter();
+
+    /**
+     * @brief begin writes the XML declaration and the opening gpx element. Returns true on success, false
+     * on failure with an explanation in errorString.
+     */
+    bool begin(QString * errorString = 0);
+
+    void beginTrack(const QString& name = QString());
+    void endTrack();
+
+    void beginSegment();
+    void endSegment();
+
+    /**
+     * @brief writePoint writes a trkpt. The time is left out if it isn't valid.
+     */
+    void writePoint(double longitude, double latitude, double height, const QDateTime& time = QDateTime());
+    void writePoint(const GPXPoint& point);
+
+    /**
+     * @brief end closes every open element and the document. Returns true if everything was written, false
+     * with an explanation in errorString otherwise.
+     */
+    bool end(QString * errorString = 0);
+
+private:
+    bool checkDevice(QString * errorString) const;
+
+    QIODevice * _device;
+    QXmlStreamWriter _writer;
+    bool _inTrack;
+    bool _inSegment;
+};
+
+#endif // GPXSTREAMWRITER_H
@@ -0,0 +1,241 @@
+#include "GPXTimeIndex.h"
+#include "GPXStreamParser.h"
+
+#include <QFile>
+#include <algorithm>
+
+//Points handed over by the parser at a time while loading
+const int LOAD_CHUNK_POINTS = 64 * 1024;
+
+//A track point with an elevation and a time takes roughly this many bytes of GPX
+const qint64 ESTIMATED_BYTES_PER_POINT = 100;
+
+//Don't trust the estimate further than this when reserving up front
+const qint64 MAX_RESERVED_POINTS = 16 * 1024 * 1024;
+
+/**
+ * @brief The GPXTimeIndexParser class adds each chunk of parsed points straight to an index
+ */
+class GPXTimeIndexParser : public GPXStreamParser
+{
+public:
+    explicit GPXTimeIndexParser(GPXTimeIndex * index) : _index(index)
+    {
+        this->setChunkSize(LOAD_CHUNK_POINTS);
+    }
+
+protected:
+    //virtual from GPXStreamParser
+    virtual bool processChunk(const QVector<GPXPoint>& chunk)
+    {
+        _index->append(chunk);
+        return true;
+    }
+
+private:
+    GPXTimeIndex * _index;
+};
+
+//Orders point indices by time, and by index among equal times
+class TimeOrder
+{
+public:
+    explicit TimeOrder(const QVector<qint64>& times) : _times(times)
+    {
+    }
+
+    bool operator()(int a, int b) const
+    {
+        if (_times.at(a) != _times.at(b))
+            return _times.at(a) < _times.at(b);
+        return a < b;
+    }
+
+private:
+    const QVector<qint64>& _times;
+};
+
+GPXTimeIndex::GPXTimeIndex()
+{
+}
+
+GPXTimeIndex::~GPXTimeIndex()
+{
+}
+
+bool GPXTimeIndex::load(const QString &filePath, QString *errorString)
+{
+    this->clear();
+
+    QFile file(filePath);
+    if (!file.open(QFile::ReadOnly))
+    {
+        if (errorString)
+            *errorString = "Failed to open " + filePath + ": " + file.errorString();
+        return false;
+    }
+
+    const qint64 reserve = qMin<qint64>(file.size() / ESTIMATED_BYTES_PER_POINT, MAX_RESERVED_POINTS);
+    _times.reserve(reserve);
+    _longitudes.reserve(reserve);
+    _latitudes.reserve(reserve);
+    _heights.reserve(reserve);
+
+    GPXTimeIndexParser parser(this);
+    if (!parser.parse(&file, errorString))
+    {
+        this->clear();
+        return false;
+    }
+
+    //The estimate is usually generous
+    _times.squeeze();
+    _longitudes.squeeze();
+    _latitudes.squeeze();
+    _heights.squeeze();
+
+    this->sortByTime();
+    return true;
+}
+
+void GPXTimeIndex::setPoints(const QVector<GPXPoint> &points)
+{
+    this->clear();
+    this->append(points);
+    this->sortByTime();
+}
+
+void GPXTimeIndex::clear()
+{
+    _times.clear();
+    _longitudes.clear();
+    _latitudes.clear();
+    _heights.clear();
+}
+
+int GPXTimeIndex::size() const
+{
+    return _times.size();
+}
+
+bool GPXTimeIndex::isEmpty() const
+{
+    return _times.isEmpty();
+}
+
+QDateTime GPXTimeIndex::startTime() const
+{
+    if (_times.isEmpty())
+        return QDateTime();
+    return this->time(0);
+}
+
+QDateTime GPXTimeIndex::endTime() const
+{
+    if (_times.isEmpty())
+        return QDateTime();
+    return this->time(_times.size() - 1);
+}
+
+QDateTime GPXTimeIndex::time(int index) const
+{
+    return QDateTime::fromMSecsSinceEpoch(_times.at(index)).toUTC();
+}
+
+GPXPoint GPXTimeIndex::point(int index) const
+{
+    GPXPoint toRet;
+    toRet.longitude = _longitudes.at(index);
+    toRet.latitude = _latitudes.at(index);
+    toRet.height = _heights.at(index);
+    toRet.time = this->time(index);
+    return toRet;
+}
+
+const double *GPXTimeIndex::longitudes() const
+{
+    return _longitudes.constData();
+}
+
+const double *GPXTimeIndex::latitudes() const
+{
+    return _latitudes.constData();
+}
+
+const double *GPXTimeIndex::heights() const
+{
+    return _heights.constData();
+}
+
+int GPXTimeIndex::countUntil(const QDateTime &time) const
+{
+    if (!time.isValid())
+        return 0;
+    const qint64 msecs = time.toMSecsSinceEpoch();
+    return std::upper_bound(_times.constBegin(), _times.constEnd(), msecs) - _times.constBegin();
+}
+
+bool GPXTimeIndex::positionAt(const QDateTime &time, GPXPoint *position) const
+{
+    const int count = this->countUntil(time);
+    if (position == 0 || count == 0 || (count == _times.size() && time > this->endTime()))
+        return false;
+
+    //Between the last point at or before time and the one after it
+    const int before = count - 1;
+    const int after = qMin<int>(count, _times.size() - 1);
+    const qint64 span = _times.at(after) - _times.at(before);
+    const double ratio = (span > 0) ? double(time.toMSecsSinceEpoch() - _times.at(before)) / span : 0.0;
+
+    position->longitude = _longitudes.at(before) + ratio * (_longitudes.at(after) - _longitudes.at(before));
+    position->latitude = _latitudes.at(before) + ratio * (_latitudes.at(after) - _latitudes.at(before));
+    position->height = _heights.at(before) + ratio * (_heights.at(after) - _heights.at(before));
+    position->time = time;
+    return true;
+}
+
+//private
+void GPXTimeIndex::append(const QVector<GPXPoint> &points)
+{
+    foreach(const GPXPoint& point, points)
+    {
+        if (!point.time.isValid())
+            continue;
+        _times.append(point.time.toMSecsSinceEpoch());
+        _longitudes.append(point.longitude);
+        _latitudes.append(point.latitude);
+        _heights.append(point.height);
+    }
+}
+
+//private
+void GPXTimeIndex::sortByTime()
+{
+    //Logs are almost always in order already, which takes one pass to see
+    bool sorted = true;
+    for (int i = 1; i < _times.size() && sorted; i++)
+        sorted = _times.at(i - 1) <= _times.at(i);
+    if (sorted)
+        return;
+
+    QVector<int> order(_times.size());
+    for (int i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), TimeOrder(_times));
+
+    QVector<qint64> times(order.size());
+    QVector<double> longitudes(order.size());
+    QVector<double> latitudes(order.size());
+    QVector<double> heights(order.size());
+    for (int i = 0; i < order.size(); i++)
+    {
+        times[i] = _times.at(order.at(i));
+        longitudes[i] = _longitudes.at(order.at(i));
+        latitudes[i] = _latitudes.at(order.at(i));
+        heights[i] = _heights.at(order.at(i));
+    }
+    _times = times;
+    _longitudes = longitudes;
+    _latitudes = latitudes;
+    _heights = heights;
+}
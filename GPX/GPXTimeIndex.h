@@ -0,0 +1,82 @@
+#ifndef GPXTIMEINDEX_H
+#define GPXTIMEINDEX_H
+
+#include "GPX_global.h"
+#include "GPXPoint.h"
+
+#include <QDateTime>
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief The GPXTimeIndex class holds a log's track points sorted by time, for scrubbing through logs hours
+ * long. Finding how many points there are up to any time, or where the aircraft was then, is a binary search
+ * over the timestamps, so showing the track up to a time never filters the whole log.
+ *
+ * The points are kept as flat arrays of times, longitudes, latitudes and heights (32 bytes a point). load()
+ * parses the file in chunks with a GPXStreamParser, so the GPXPoints with their QDateTimes are never all held
+ * at once. Points without a time are left out. A log whose times go backwards somewhere is sorted (keeping
+ * the file's order among equal times) when it's loaded.
+ */
+class GPXSHARED_EXPORT GPXTimeIndex
+{
+public:
+    GPXTimeIndex();
+    ~GPXTimeIndex();
+
+    /**
+     * @brief load replaces the index with the points of every track in filePath. Returns true on success, false
+     * on failure with an explanation in errorString.
+     */
+    bool load(const QString& filePath, QString * errorString = 0);
+
+    /**
+     * @brief setPoints replaces the index with points, e.g. from an already parsed GPX
+     */
+    void setPoints(const QVector<GPXPoint>& points);
+
+    void clear();
+
+    int size() const;
+    bool isEmpty() const;
+
+    /**
+     * @brief startTime and endTime return the times of the first and last points, or an invalid QDateTime if
+     * there are none
+     */
+    QDateTime startTime() const;
+    QDateTime endTime() const;
+
+    QDateTime time(int index) const;
+    GPXPoint point(int index) const;
+
+    //The points' coordinates, in time order, size() of each
+    const double * longitudes() const;
+    const double * latitudes() const;
+    const double * heights() const;
+
+    /**
+     * @brief countUntil returns how many points have a time at or before time. The first that many points are the
+     * track flown by then.
+     */
+    int countUntil(const QDateTime& time) const;
+
+    /**
+     * @brief positionAt sets position to where the aircraft was at time, interpolated between the points around
+     * it. Returns false if time is outside the log.
+     */
+    bool positionAt(const QDateTime& time, GPXPoint * position) const;
+
+private:
+    void append(const QVector<GPXPoint>& points);
+    void sortByTime();
+
+    QVector<qint64> _times;
+    QVector<double> _longitudes;
+    QVector<double> _latitudes;
+    QVector<double> _heights;
+
+    friend class GPXTimeIndexParser;
+};
+
+#endif // GPXTIMEINDEX_H
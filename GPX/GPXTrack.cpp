@@ -0,0 +1,25 @@
+#include "GPXTrack.h"
+
+GPXTrack::GPXTrack() :
+    firstPoint(0), pointCount(0)
+{
+}
+
+GPXTrack::~GPXTrack()
+{
+}
+
+int GPXTrack::segmentCount() const
+{
+    return segmentStarts.size();
+}
+
+int GPXTrack::segmentPointCount(int segment) const
+{
+    if (segment < 0 || segment >= segmentStarts.size())
+        return 0;
+
+    const int end = (segment + 1 < segmentStarts.size()) ? segmentStarts.at(segment + 1)
+                                                         : firstPoint + pointCount;
+    return end - segmentStarts.at(segment);
+}
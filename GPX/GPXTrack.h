@@ -0,0 +1,40 @@
+#ifndef GPXTRACK_H
+#define GPXTRACK_H
+
+#include "GPX_global.h"
+
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief The GPXTrack class describes one trk of a GPX file as a range of GPX::points(). Like GPXPoint it's
+ * a glorified struct.
+ */
+class GPXSHARED_EXPORT GPXTrack
+{
+public:
+    GPXTrack();
+    ~GPXTrack();
+
+    /**
+     * @brief segmentCount returns the number of trkseg in the track
+     */
+    int segmentCount() const;
+
+    /**
+     * @brief segmentPointCount returns the number of points in segment, which runs from
+     * segmentStarts[segment] to the start of the next segment or the end of the track
+     */
+    int segmentPointCount(int segment) const;
+
+    QString name;
+
+    //Index in GPX::points() of the track's first point, and how many points it has
+    int firstPoint;
+    int pointCount;
+
+    //Index in GPX::points() of the first point of each segment
+    QVector<int> segmentStarts;
+};
+
+#endif // GPXTRACK_H
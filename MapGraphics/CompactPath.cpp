@@ -0,0 +1,145 @@
+#include "CompactPath.h"
+
+#include <QtGlobal>
+#include <cmath>
+
+//How many QuantizedInt32 steps a degree of longitude or latitude and a meter of altitude are
+const qreal STEPS_PER_DEGREE = 1e7;
+const qreal STEPS_PER_METER = 100.0;
+
+//non-member
+static qint32 quantizeClamped(qreal value)
+{
+    const qreal limit = 2147483647.0;
+    return (qint32) floor(qBound<qreal>(-limit, value, limit) + 0.5);
+}
+
+CompactPath::CompactPath() :
+    _encoding(Float32Offsets), _size(0)
+{
+}
+
+CompactPath::CompactPath(const QList<Position> &path, CompactPath::Encoding encoding) :
+    _encoding(encoding), _size(0)
+{
+    if (!path.isEmpty())
+        _origin = path.first();
+    _encode(path);
+}
+
+CompactPath::CompactPath(const QList<Position> &path, const Position &origin, CompactPath::Encoding encoding) :
+    _origin(origin), _encoding(encoding), _size(0)
+{
+    _encode(path);
+}
+
+int CompactPath::size() const
+{
+    return _size;
+}
+
+bool CompactPath::isEmpty() const
+{
+    return _size == 0;
+}
+
+CompactPath::Encoding CompactPath::encoding() const
+{
+    return _encoding;
+}
+
+const Position &CompactPath::origin() const
+{
+    return _origin;
+}
+
+Position CompactPath::at(int index) const
+{
+    if (_encoding == QuantizedInt32)
+    {
+        const qint32 * values = _quantized.constData() + 3 * index;
+        return Position(_origin.longitude() + values[0] / STEPS_PER_DEGREE,
+                        _origin.latitude() + values[1] / STEPS_PER_DEGREE,
+                        _origin.altitude() + values[2] / STEPS_PER_METER);
+    }
+
+    const float * values = _floats.constData() + 3 * index;
+    return Position(_origin.longitude() + values[0],
+                    _origin.latitude() + values[1],
+                    _origin.altitude() + values[2]);
+}
+
+QList<Position> CompactPath::toList() const
+{
+    QList<Position> toRet;
+    toRet.reserve(_size);
+    for (int i = 0; i < _size; i++)
+        toRet.append(this->at(i));
+    return toRet;
+}
+
+bool CompactPath::matches(int index, const Position &position) const
+{
+    if (_encoding == QuantizedInt32)
+    {
+        qint32 encoded[3];
+        _quantize(position, encoded);
+        const qint32 * values = _quantized.constData() + 3 * index;
+        return encoded[0] == values[0] && encoded[1] == values[1] && encoded[2] == values[2];
+    }
+
+    float encoded[3];
+    _offsets(position, encoded);
+    const float * values = _floats.constData() + 3 * index;
+    return encoded[0] == values[0] && encoded[1] == values[1] && encoded[2] == values[2];
+}
+
+qint64 CompactPath::memoryBytes() const
+{
+    return _floats.size() * (qint64) sizeof(float) + _quantized.size() * (qint64) sizeof(qint32);
+}
+
+bool CompactPath::operator ==(const CompactPath &other) const
+{
+    return _origin == other._origin && _encoding == other._encoding
+            && _floats == other._floats && _quantized == other._quantized;
+}
+
+bool CompactPath::operator !=(const CompactPath &other) const
+{
+    return !(*this == other);
+}
+
+//private
+void CompactPath::_encode(const QList<Position> &path)
+{
+    _size = path.size();
+    if (_encoding == QuantizedInt32)
+    {
+        _quantized.resize(3 * _size);
+        for (int i = 0; i < _size; i++)
+            _quantize(path.at(i), _quantized.data() + 3 * i);
+    }
+    else
+    {
+        _floats.resize(3 * _size);
+        for (int i = 0; i < _size; i++)
+            _offsets(path.at(i), _floats.data() + 3 * i);
+    }
+}
+
+//private
+void CompactPath::_offsets(const Position &position, float *output) const
+{
+    output[0] = (float) (position.longitude() - _origin.longitude());
+    output[1] = (float) (position.latitude() - _origin.latitude());
+    output[2] = (float) (position.altitude() - _origin.altitude());
+}
+
+//private
+void CompactPath::_quantize(const Position &position, qint32 *output) const
+{
+    output[0] = quantizeClamped((position.longitude() - _origin.longitude()) * STEPS_PER_DEGREE);
+    output[1] = quantizeClamped((position.latitude() - _origin.latitude()) * STEPS_PER_DEGREE);
+    output[2] = quantizeClamped((position.altitude() - _origin.altitude()) * STEPS_PER_METER);
+}
@@ -0,0 +1,84 @@
+#ifndef COMPACTPATH_H
+#define COMPACTPATH_H
+
+#include <QList>
+#include <QVector>
+
+#include "MapGraphics_global.h"
+#include "Position.h"
+
+/**
+ * @brief The CompactPath class stores a path for display as small offsets from one origin per path. A
+ * QList<Position> spends three qreals and a heap allocation on every waypoint, which adds up for long surveys
+ * and flight logs that only ever get drawn.
+ *
+ * Float32Offsets keeps each waypoint as three floats (degrees of longitude and latitude, meters of altitude
+ * from the origin), a quarter of what QList<Position> takes. That's good to about a centimeter within a degree
+ * of the origin and gets coarser further away. QuantizedInt32 keeps it as three int32s in steps of 1e-7 degrees
+ * (about a centimeter) and of a centimeter of altitude, with the same precision everywhere up to about 200
+ * degrees from the origin.
+ *
+ * Like the Qt containers it is implicitly shared, so passing and returning it by value is cheap.
+ */
+class MAPGRAPHICSSHARED_EXPORT CompactPath
+{
+public:
+    enum Encoding
+    {
+        Float32Offsets,
+        QuantizedInt32
+    };
+
+    CompactPath();
+
+    /**
+     * @brief CompactPath encodes path around its first waypoint
+     */
+    explicit CompactPath(const QList<Position>& path, Encoding encoding = Float32Offsets);
+
+    /**
+     * @brief CompactPath encodes path around origin. Pick one near the path, e.g. its center.
+     */
+    CompactPath(const QList<Position>& path, const Position& origin, Encoding encoding = Float32Offsets);
+
+    int size() const;
+    bool isEmpty() const;
+    Encoding encoding() const;
+    const Position& origin() const;
+
+    /**
+     * @brief at returns waypoint index, decoded. It's within the encoding's precision of what was stored.
+     */
+    Position at(int index) const;
+
+    QList<Position> toList() const;
+
+    /**
+     * @brief matches returns true if position encodes to exactly what waypoint index holds, i.e. if they're
+     * the same as far as this path can tell.
+     */
+    bool matches(int index, const Position& position) const;
+
+    /**
+     * @brief memoryBytes returns roughly how much memory the waypoints take
+     */
+    qint64 memoryBytes() const;
+
+    bool operator ==(const CompactPath& other) const;
+    bool operator !=(const CompactPath& other) const;
+
+private:
+    void _encode(const QList<Position>& path);
+    void _offsets(const Position& position, float * output) const;
+    void _quantize(const Position& position, qint32 * output) const;
+
+    Position _origin;
+    Encoding _encoding;
+    int _size;
+
+    //Three values per waypoint (longitude, latitude, altitude), in whichever of these the encoding uses
+    QVector<float> _floats;
+    QVector<qint32> _quantized;
+};
+
+#endif // COMPACTPATH_H
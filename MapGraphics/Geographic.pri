@@ -0,0 +1,16 @@
+#MapGraphics' geographic types: Position, CompactPath and the coordinate conversions. They only need QtCore
+#and QtGui's vector types, so code that wants them without the widgets (like the planning core's users) can build these
+#in directly. Define MAPGRAPHICS_LIBRARY when doing so outside of MapGraphics.
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+SOURCES += $$PWD/Position.cpp \
+    $$PWD/CompactPath.cpp \
+    $$PWD/guts/Conversions.cpp \
+    $$PWD/guts/ENUConverter.cpp
+
+HEADERS += $$PWD/Position.h \
+    $$PWD/CompactPath.h \
+    $$PWD/guts/Conversions.h \
+    $$PWD/guts/ENUConverter.h
@@ -5,7 +5,7 @@
 #-------------------------------------------------
 
 QT       += network sql
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets concurrent
 
 TARGET = MapGraphics
 TEMPLATE = lib
@@ -14,17 +14,21 @@ DEFINES += MAPGRAPHICS_LIBRARY
 
 INCLUDEPATH += .
 
+#Position and Conversions, which the planning core uses without the rest of MapGraphics
+include(Geographic.pri)
+
 SOURCES += MapGraphicsScene.cpp \
     MapGraphicsObject.cpp \
     MapGraphicsView.cpp \
     guts/PrivateQGraphicsScene.cpp \
+    guts/MapRenderProfiler.cpp \
     guts/PrivateQGraphicsObject.cpp \
-    guts/Conversions.cpp \
     MapTileSource.cpp \
     tileSources/GridTileSource.cpp \
     guts/MapTileGraphicsObject.cpp \
     guts/PrivateQGraphicsView.cpp \
     tileSources/OSMTileSource.cpp \
+    tileSources/WMTSTileSource.cpp \
     guts/MapGraphicsNetwork.cpp \
     tileSources/CompositeTileSource.cpp \
     guts/MapTileLayerListModel.cpp \
@@ -33,21 +37,35 @@ SOURCES += MapGraphicsScene.cpp \
     CircleObject.cpp \
     guts/PrivateQGraphicsInfoSource.cpp \
     PolygonObject.cpp \
-    Position.cpp \
-    LineObject.cpp
+    LineObject.cpp \
+    PathObject.cpp \
+    TelemetryTrackObject.cpp \
+    guts/MultiResolutionPath.cpp \
+    guts/MapTilePrefetcher.cpp \
+    MapTileKey.cpp \
+    guts/MapTilePackCache.cpp \
+    guts/MapTileExpirationStore.cpp \
+    guts/MapTileDiskCacheWriter.cpp \
+    guts/MapTileCacheDirectory.cpp \
+    guts/MapTileSeeder.cpp \
+    guts/MapTilePlaceholders.cpp \
+    guts/MapObjectIndex.cpp \
+    guts/MapTileSourceExecutor.cpp \
+    guts/WebMercator.cpp
 
 HEADERS += MapGraphicsScene.h\
         MapGraphics_global.h \
     MapGraphicsObject.h \
     MapGraphicsView.h \
     guts/PrivateQGraphicsScene.h \
+    guts/MapRenderProfiler.h \
     guts/PrivateQGraphicsObject.h \
-    guts/Conversions.h \
     MapTileSource.h \
     tileSources/GridTileSource.h \
     guts/MapTileGraphicsObject.h \
     guts/PrivateQGraphicsView.h \
     tileSources/OSMTileSource.h \
+    tileSources/WMTSTileSource.h \
     guts/MapGraphicsNetwork.h \
     tileSources/CompositeTileSource.h \
     guts/MapTileLayerListModel.h \
@@ -56,8 +74,21 @@ HEADERS += MapGraphicsScene.h\
     CircleObject.h \
     guts/PrivateQGraphicsInfoSource.h \
     PolygonObject.h \
-    Position.h \
-    LineObject.h
+    LineObject.h \
+    PathObject.h \
+    TelemetryTrackObject.h \
+    guts/MultiResolutionPath.h \
+    guts/MapTilePrefetcher.h \
+    MapTileKey.h \
+    guts/MapTilePackCache.h \
+    guts/MapTileExpirationStore.h \
+    guts/MapTileDiskCacheWriter.h \
+    guts/MapTileCacheDirectory.h \
+    guts/MapTileSeeder.h \
+    guts/MapTilePlaceholders.h \
+    guts/MapObjectIndex.h \
+    guts/MapTileSourceExecutor.h \
+    guts/WebMercator.h
 
 symbian {
     MMP_RULES += EXPORTUNFROZEN
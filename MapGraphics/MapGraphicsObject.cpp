@@ -285,6 +285,12 @@ void MapGraphicsObject::wheelEvent(QGraphicsSceneWheelEvent *event)
     event->ignore();
 }
 
+//protected
+void MapGraphicsObject::zoomLevelChangedEvent(quint8 zoomLevel)
+{
+    Q_UNUSED(zoomLevel)
+}
+
 
 //private slot
 void MapGraphicsObject::setConstructed()
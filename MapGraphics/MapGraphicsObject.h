@@ -112,6 +112,14 @@ protected:
     virtual void mouseReleaseEvent(QGraphicsSceneMouseEvent * event);
     virtual void wheelEvent(QGraphicsSceneWheelEvent * event);
 
+    /**
+     * @brief Called by the view when the object is first shown and whenever the zoom level changes.
+     * Objects that keep several levels of detail can reimplement this to pick one. Does nothing by default.
+     *
+     * @param zoomLevel the view's new zoom level
+     */
+    virtual void zoomLevelChangedEvent(quint8 zoomLevel);
+
     
 signals:
     void enabledChanged();
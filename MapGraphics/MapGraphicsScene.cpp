@@ -1,7 +1,10 @@
 #include "MapGraphicsScene.h"
 
 #include <QtDebug>
+#include <cmath>
 
+//Meters per degree of latitude, near enough for sizing up index bounds
+const qreal METERS_PER_DEGREE = 111320.0;
 
 MapGraphicsScene::MapGraphicsScene(QObject * parent)
     : QObject(parent)
@@ -10,39 +13,100 @@ MapGraphicsScene::MapGraphicsScene(QObject * parent)
 
 MapGraphicsScene::~MapGraphicsScene()
 {
-    foreach(MapGraphicsObject * obj, _objects)
-        this->removeObject(obj);
+    this->removeObjects(_objects.toList());
 }
 
 void MapGraphicsScene::addObject(MapGraphicsObject *object)
 {
-    if (object == 0)
-        return;
+    this->addObjects(QList<MapGraphicsObject *>() << object);
+}
+
+void MapGraphicsScene::addObjects(const QList<MapGraphicsObject *> &objects)
+{
+    QList<MapGraphicsObject *> added;
+    foreach(MapGraphicsObject * object, objects)
+    {
+        if (object == 0 || _objects.contains(object))
+            continue;
 
-    connect(object,
-            SIGNAL(newObjectGenerated(MapGraphicsObject*)),
-            this,
-            SLOT(handleNewObjectGenerated(MapGraphicsObject*)));
-    connect(object,
-            SIGNAL(destroyed(QObject*)),
-            this,
-            SLOT(handleObjectDestroyed(QObject*)));
-
-    _objects.insert(object);
-    this->objectAdded(object);
+        connect(object,
+                SIGNAL(newObjectGenerated(MapGraphicsObject*)),
+                this,
+                SLOT(handleNewObjectGenerated(MapGraphicsObject*)));
+        connect(object,
+                SIGNAL(destroyed(QObject*)),
+                this,
+                SLOT(handleObjectDestroyed(QObject*)));
+        //Objects ask for a redraw when their shape changes, which may change their bounds
+        connect(object,
+                SIGNAL(posChanged()),
+                this,
+                SLOT(handleObjectGeometryChanged()));
+        connect(object,
+                SIGNAL(redrawRequested()),
+                this,
+                SLOT(handleObjectGeometryChanged()));
+
+        _objects.insert(object);
+        _index.insert(object, geoBounds(object));
+        added.append(object);
+    }
+
+    foreach(MapGraphicsObject * object, added)
+        this->objectAdded(object);
+    if (!added.isEmpty())
+        this->objectsAdded(added);
 }
 
 QList<MapGraphicsObject *> MapGraphicsScene::objects() const
+{
+    return _objects.toList();
+}
+
+void MapGraphicsScene::removeObject(MapGraphicsObject *object)
+{
+    this->removeObjects(QList<MapGraphicsObject *>() << object);
+}
+
+void MapGraphicsScene::removeObjects(const QList<MapGraphicsObject *> &objects)
+{
+    QList<MapGraphicsObject *> removed;
+    foreach(MapGraphicsObject * object, objects)
+    {
+        if (!_objects.remove(object))
+            continue;
+        _index.remove(object);
+        removed.append(object);
+    }
+
+    foreach(MapGraphicsObject * object, removed)
+        this->objectRemoved(object);
+    if (!removed.isEmpty())
+        this->objectsRemoved(removed);
+}
+
+QList<MapGraphicsObject *> MapGraphicsScene::objectsAt(const QPointF &geoPos, qreal toleranceDegrees) const
 {
     QList<MapGraphicsObject *> toRet;
 
+    const QRectF area(geoPos.x() - toleranceDegrees, geoPos.y() - toleranceDegrees,
+                      2.0 * toleranceDegrees, 2.0 * toleranceDegrees);
+    foreach(MapGraphicsObject * object, _index.query(area))
+    {
+        if (object->sizeIsZoomInvariant())
+        {
+            if (area.contains(object->pos()))
+                toRet.append(object);
+        }
+        else if (object->contains(geoPos))
+            toRet.append(object);
+    }
     return toRet;
 }
 
-void MapGraphicsScene::removeObject(MapGraphicsObject *object)
+QList<MapGraphicsObject *> MapGraphicsScene::objectsIn(const QRectF &geoRect) const
 {
-    _objects.remove(object);
-    this->objectRemoved(object);
+    return _index.query(geoRect);
 }
 
 //private slot
@@ -62,3 +126,30 @@ void MapGraphicsScene::handleObjectDestroyed(QObject *object)
 
     this->removeObject(mgObj);
 }
+
+//private slot
+void MapGraphicsScene::handleObjectGeometryChanged()
+{
+    MapGraphicsObject * object = qobject_cast<MapGraphicsObject *>(this->sender());
+    if (object == 0 || !_objects.contains(object))
+        return;
+    _index.insert(object, geoBounds(object));
+}
+
+//private static
+QRectF MapGraphicsScene::geoBounds(MapGraphicsObject *object)
+{
+    const QPointF pos = object->pos();
+    if (object->sizeIsZoomInvariant())
+        return QRectF(pos, QSizeF(0.0, 0.0));
+
+    //The bounds are in meters around pos. Whichever way up they are, they reach this far each way
+    const QRectF meters = object->boundingRect();
+    const qreal halfWidth = qMax(qAbs(meters.left()), qAbs(meters.right()));
+    const qreal halfHeight = qMax(qAbs(meters.top()), qAbs(meters.bottom()));
+
+    const qreal halfLat = halfHeight / METERS_PER_DEGREE;
+    const qreal cosLat = qMax<qreal>(0.01, cos(pos.y() * M_PI / 180.0));
+    const qreal halfLon = halfWidth / (METERS_PER_DEGREE * cosLat);
+    return QRectF(pos.x() - halfLon, pos.y() - halfLat, 2.0 * halfLon, 2.0 * halfLat);
+}
@@ -7,6 +7,9 @@
 #include <QObject>
 #include <QList>
 #include <QSet>
+#include <QRectF>
+
+#include "guts/MapObjectIndex.h"
 
 class MAPGRAPHICSSHARED_EXPORT MapGraphicsScene : public QObject
 {
@@ -22,6 +25,14 @@ public:
      */
     void addObject(MapGraphicsObject * object);
 
+    /**
+     * @brief Adds many objects at once. Views set up their items for the whole batch in one go, which is
+     * much faster than adding the objects one at a time when loading thousands of them.
+     *
+     * @param objects
+     */
+    void addObjects(const QList<MapGraphicsObject *>& objects);
+
     /**
      * @brief Returns a list of pointers to all MapGraphicsObject objects in the scene
      *
@@ -31,6 +42,27 @@ public:
 
     void removeObject(MapGraphicsObject * object);
 
+    void removeObjects(const QList<MapGraphicsObject *>& objects);
+
+    /**
+     * @brief Returns the objects that contain the given (longitude, latitude) point, by their contains().
+     * Objects whose size is zoom invariant (in pixels) are found within toleranceDegrees of their position.
+     *
+     * @param geoPos
+     * @param toleranceDegrees
+     * @return QList<MapGraphicsObject *>
+     */
+    QList<MapGraphicsObject *> objectsAt(const QPointF& geoPos, qreal toleranceDegrees = 0.0) const;
+
+    /**
+     * @brief Returns the objects whose bounds may intersect the given (longitude, latitude) rectangle. Every
+     * object that does is included, along with some nearby ones that don't.
+     *
+     * @param geoRect
+     * @return QList<MapGraphicsObject *>
+     */
+    QList<MapGraphicsObject *> objectsIn(const QRectF& geoRect) const;
+
 signals:
     /**
      * @brief Fired when a MapGraphicsObject is added to the scene
@@ -46,12 +78,33 @@ signals:
      */
     void objectRemoved(MapGraphicsObject *);
 
+    /**
+     * @brief Fired once for each addObjects() or addObject() call, after objectAdded has been fired for each
+     * of the objects
+     *
+     * @param the objects that were added
+     */
+    void objectsAdded(const QList<MapGraphicsObject *>&);
+
+    /**
+     * @brief Fired once for each removeObjects() or removeObject() call, after objectRemoved has been fired
+     * for each of the objects
+     *
+     * @param the objects that were removed
+     */
+    void objectsRemoved(const QList<MapGraphicsObject *>&);
+
 private slots:
     void handleNewObjectGenerated(MapGraphicsObject * newObject);
     void handleObjectDestroyed(QObject * object);
+    void handleObjectGeometryChanged();
 
 private:
+    //Where object is for the index: its bounds converted to degrees, or just its position if they're in pixels
+    static QRectF geoBounds(MapGraphicsObject * object);
+
     QSet<MapGraphicsObject *> _objects;
+    MapObjectIndex _index;
 
 
 };
@@ -7,36 +7,61 @@
 #include <QQueue>
 #include <QSet>
 #include <QWheelEvent>
-#include <QCoreApplication>
-#include <QThread>
 #include <QMenu>
+#include <QScrollBar>
+#include <QResizeEvent>
+#include <QDataStream>
+#include <QPair>
+#include <algorithm>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 4, 0)
+#include <QOpenGLWidget>
+#endif
 
 #include "guts/PrivateQGraphicsScene.h"
 #include "guts/PrivateQGraphicsView.h"
 #include "guts/Conversions.h"
+#include "guts/MapTileSourceExecutor.h"
+
+//Marks the start of saveViewState()'s output and its version
+const quint32 VIEW_STATE_MAGIC = 0x4d475653;
+const quint32 VIEW_STATE_VERSION = 1;
+
+//How many of the tiles on screen saveViewState() remembers
+const int MAX_SAVED_TILES = 48;
+
+//non-member
+static quint64 tileKey(quint32 x, quint32 y)
+{
+    return (((quint64)x) << 32) | y;
+}
 
 MapGraphicsView::MapGraphicsView(MapGraphicsScene *scene, QWidget *parent) :
-    QWidget(parent)
+    QWidget(parent), _openGLViewport(false), _renderProfiler(0), _renderProfileOverlay(false)
 {
+    _prefetcher = new MapTilePrefetcher(this);
+
+    //Tiles are laid out when the viewport changes rather than on a polling timer
+    _tileLayoutTimer = new QTimer(this);
+    _tileLayoutTimer->setSingleShot(true);
+    _tileLayoutTimer->setInterval(0);
+    connect(_tileLayoutTimer,
+            SIGNAL(timeout()),
+            this,
+            SLOT(renderTiles()));
+
     //Setup the given scene and set the default zoomLevel to 3
     this->setScene(scene);
     _zoomLevel = 2;
 
     //The default drag mode allows us to drag the map around to move the view
     this->setDragMode(MapGraphicsView::ScrollHandDrag);
-
-    //Start the timer that will cause the tiles to periodically move to follow the view
-    QTimer * renderTimer = new QTimer(this);
-    connect(renderTimer,
-            SIGNAL(timeout()),
-            this,
-            SLOT(renderTiles()));
-    renderTimer->start(200);
 }
 
 MapGraphicsView::~MapGraphicsView()
 {
     qDebug() << this << "Destructing";
+    this->setRenderProfiling(false);
+
     //When we die, take all of our tile objects with us...
     foreach(MapTileGraphicsObject * tileObject, _tileObjects)
     {
@@ -45,29 +70,17 @@ MapGraphicsView::~MapGraphicsView()
         delete tileObject;
     }
     _tileObjects.clear();
+    _tileIndex.clear();
 
     if (!_tileSource.isNull())
     {
-        //Find the tileSource's thread
-        QPointer<QThread> tileSourceThread = _tileSource->thread();
-
         /*
          Clear the QSharedPointer to the tilesource. Unless there's a serious problem, we should be the
-         last thing holding that reference and we expect it to be deleted
+         last thing holding that reference and we expect it to be deleted. MapTileSourceExecutor shuts
+         its thread down if nothing else is using it.
         */
         _tileSource.clear();
-
-        //After the tilesource is deleted, we wait for the thread it was running in to shut down
-        int count = 0;
-        const int maxCount = 100;
-        while (!tileSourceThread.isNull() && !tileSourceThread->wait(100))
-        {
-            //We have to process events while it's shutting down in case it uses signals/slots to shut down
-            //Hint: it does
-            QCoreApplication::processEvents(QEventLoop::ExcludeSocketNotifiers | QEventLoop::ExcludeUserInputEvents);
-            if (++count == maxCount)
-                break;
-        }
+        _prefetcher->setTileSource(QSharedPointer<MapTileSource>());
     }
 }
 
@@ -193,6 +206,19 @@ void MapGraphicsView::setScene(MapGraphicsScene * scene)
     // set resize anchor of child QGraphicsView to center so the center
     // position doesn't change when the view gets resized
     childView->setResizeAnchor(QGraphicsView::AnchorViewCenter);    
+    this->applyViewport(childView);
+    childView->setRenderProfiler(_renderProfiler);
+    childView->setProfileOverlay(_renderProfileOverlay && _renderProfiler != 0);
+
+    //Centering, dragging and zooming all move the view through its scroll bars
+    connect(childView->horizontalScrollBar(),
+            SIGNAL(valueChanged(int)),
+            this,
+            SLOT(scheduleTileLayout()));
+    connect(childView->verticalScrollBar(),
+            SIGNAL(valueChanged(int)),
+            this,
+            SLOT(scheduleTileLayout()));
 
 
     //Delete old stuff if applicable
@@ -211,6 +237,7 @@ void MapGraphicsView::setScene(MapGraphicsScene * scene)
 
     //Reset the drag mode for the new child view
     this->setDragMode(this->dragMode());
+    this->scheduleTileLayout();
 }
 
 QSharedPointer<MapTileSource> MapGraphicsView::tileSource() const
@@ -221,28 +248,19 @@ QSharedPointer<MapTileSource> MapGraphicsView::tileSource() const
 void MapGraphicsView::setTileSource(QSharedPointer<MapTileSource> tSource)
 {
     _tileSource = tSource;
+    _placeholders.clear();
 
     if (!_tileSource.isNull())
     {
-        //Create a thread just for the tile source
-        QThread * tileSourceThread = new QThread();
-        tileSourceThread->start();
-        _tileSource->moveToThread(tileSourceThread);
-
-        //Set it up so that the thread is destroyed when the tile source is!
-        connect(_tileSource.data(),
-                SIGNAL(destroyed()),
-                tileSourceThread,
-                SLOT(quit()));
-        connect(tileSourceThread,
-                SIGNAL(finished()),
-                tileSourceThread,
-                SLOT(deleteLater()));
+        //Run the tile source in one of the shared tile source threads
+        MapTileSourceExecutor::getInstance()->adopt(_tileSource.data());
     }
 
     //Update our tile displays (if any) about the new tile source
     foreach(MapTileGraphicsObject * tileObject, _tileObjects)
         tileObject->setTileSource(tSource);
+    _prefetcher->setTileSource(tSource);
+    this->scheduleTileLayout();
 }
 
 quint8 MapGraphicsView::zoomLevel() const
@@ -272,9 +290,16 @@ void MapGraphicsView::setZoomLevel(quint8 nZoom, ZoomMode zMode)
 
     _zoomLevel = nZoom;
 
-    //Disable all tile display temporarily. They'll redisplay properly when the timer ticks
+    /*
+      Disable all tile display temporarily. They'll redisplay at the next layout, showing placeholders scaled
+      from the tiles we just had until their own tiles arrive
+    */
     foreach(MapTileGraphicsObject * tileObject, _tileObjects)
+    {
         tileObject->setVisible(false);
+        tileObject->cancelPendingRequest();
+    }
+    _tileIndex.clear();
 
     //Make sure the QGraphicsScene is the right size
     this->resetQGSSceneSize();
@@ -292,6 +317,7 @@ void MapGraphicsView::setZoomLevel(quint8 nZoom, ZoomMode zMode)
 
     //Make MapGraphicsObjects update
     this->zoomLevelChanged(nZoom);
+    this->scheduleTileLayout();
 }
 
 void MapGraphicsView::zoomIn(ZoomMode zMode)
@@ -315,6 +341,169 @@ void MapGraphicsView::zoomOut(ZoomMode zMode)
 void MapGraphicsView::rotate(qreal rotation)
 {
     _childView->rotate(rotation);
+    this->scheduleTileLayout();
+}
+
+int MapGraphicsView::prefetchRingSize() const
+{
+    return _prefetcher->ringSize();
+}
+
+void MapGraphicsView::setPrefetchRingSize(int ringSize)
+{
+    _prefetcher->setRingSize(ringSize);
+    this->scheduleTileLayout();
+}
+
+bool MapGraphicsView::prefetchZoomLevels() const
+{
+    return _prefetcher->prefetchZoomLevels();
+}
+
+void MapGraphicsView::setPrefetchZoomLevels(bool prefetch)
+{
+    _prefetcher->setPrefetchZoomLevels(prefetch);
+    this->scheduleTileLayout();
+}
+
+bool MapGraphicsView::openGLViewport() const
+{
+    return _openGLViewport;
+}
+
+void MapGraphicsView::setOpenGLViewport(bool useOpenGL)
+{
+    if (_openGLViewport == useOpenGL)
+        return;
+    _openGLViewport = useOpenGL;
+
+    if (!_childView.isNull())
+        this->applyViewport(_childView);
+}
+
+bool MapGraphicsView::renderProfiling() const
+{
+    return _renderProfiler != 0;
+}
+
+void MapGraphicsView::setRenderProfiling(bool profile)
+{
+    if (profile == this->renderProfiling())
+        return;
+
+    //Nothing may be left pointing at the old profiler when it's deleted
+    MapRenderProfiler * old = _renderProfiler;
+    _renderProfiler = profile ? new MapRenderProfiler() : 0;
+    this->applyRenderProfiler();
+    delete old;
+}
+
+bool MapGraphicsView::renderProfileOverlay() const
+{
+    return _renderProfileOverlay;
+}
+
+void MapGraphicsView::setRenderProfileOverlay(bool overlay)
+{
+    if (overlay == _renderProfileOverlay)
+        return;
+    _renderProfileOverlay = overlay;
+    this->applyRenderProfiler();
+}
+
+MapRenderProfiler *MapGraphicsView::renderProfiler() const
+{
+    return _renderProfiler;
+}
+
+QByteArray MapGraphicsView::saveViewState() const
+{
+    //The tiles on screen, nearest to the center first, since that's what the first frame shows
+    QList<QPair<qreal, quint64> > tiles;
+    if (!_tileSource.isNull() && !_childView.isNull())
+    {
+        const QPointF centerQGS = _childView->mapToScene(_childView->width() / 2.0, _childView->height() / 2.0);
+        const qreal tileSize = _tileSource->tileSize();
+        QHash<quint64, MapTileGraphicsObject *>::const_iterator iter;
+        for (iter = _tileIndex.constBegin(); iter != _tileIndex.constEnd(); iter++)
+        {
+            if (!iter.value()->isVisible())
+                continue;
+            const QPointF offset = (iter.value()->pos() - centerQGS) / tileSize;
+            tiles.append(QPair<qreal, quint64>(offset.x() * offset.x() + offset.y() * offset.y(), iter.key()));
+        }
+    }
+    std::sort(tiles.begin(), tiles.end());
+
+    QByteArray toRet;
+    QDataStream stream(&toRet, QIODevice::WriteOnly);
+    stream << VIEW_STATE_MAGIC << VIEW_STATE_VERSION;
+    stream << this->center() << this->zoomLevel();
+    const int count = qMin<int>(tiles.size(), MAX_SAVED_TILES);
+    stream << (qint32) count;
+    for (int i = 0; i < count; i++)
+    {
+        const quint64 key = tiles.at(i).second;
+        stream << MapTileKey(key >> 32, key & 0xffffffff, this->zoomLevel()).toUInt64();
+    }
+    return toRet;
+}
+
+bool MapGraphicsView::restoreViewState(const QByteArray &state)
+{
+    QDataStream stream(state);
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic >> version;
+    if (magic != VIEW_STATE_MAGIC || version != VIEW_STATE_VERSION)
+        return false;
+
+    QPointF center;
+    quint8 zoom = 0;
+    qint32 count = 0;
+    stream >> center >> zoom >> count;
+    if (stream.status() != QDataStream::Ok || count < 0 || count > MAX_SAVED_TILES)
+        return false;
+
+    QList<MapTileKey> tiles;
+    for (int i = 0; i < count; i++)
+    {
+        quint64 packed = 0;
+        stream >> packed;
+        tiles.append(MapTileKey::fromUInt64(packed));
+    }
+    if (stream.status() != QDataStream::Ok)
+        return false;
+
+    //The warming is queued in the source's thread ahead of the requests the first layout makes
+    if (!_tileSource.isNull())
+        _tileSource->warmMemoryCache(tiles);
+    this->setZoomLevel(zoom);
+    this->centerOn(center);
+    return true;
+}
+
+int MapGraphicsView::pendingVisibleTiles() const
+{
+    int toRet = 0;
+    if (_childView.isNull())
+        return toRet;
+
+    const QRectF visibleRect = this->visibleSceneRect();
+    foreach(const MapTileGraphicsObject * tileObject, _tileIndex)
+    {
+        if (tileObject->isWaitingForTile() && this->isOnScreen(tileObject, visibleRect))
+            toRet++;
+    }
+    return toRet;
+}
+
+//protected
+//virtual from QWidget
+void MapGraphicsView::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    this->scheduleTileLayout();
 }
 
 //protected slot
@@ -379,6 +568,32 @@ void MapGraphicsView::renderTiles()
     this->doTileLayout();
 }
 
+//private slot
+void MapGraphicsView::scheduleTileLayout()
+{
+    if (!_tileLayoutTimer->isActive())
+        _tileLayoutTimer->start();
+}
+
+//private slot
+void MapGraphicsView::handleTileDelivered(quint32 x, quint32 y, quint8 z, bool displayed, bool finished)
+{
+    if (z != this->zoomLevel())
+        return;
+
+    if (displayed)
+        this->tileDisplayed(x, y, z, finished);
+
+    //Only a tile on screen finishing can be the one that completes the viewport. If a layout is coming, the tiles
+    //on screen aren't all laid out yet and the layout will tell
+    MapTileGraphicsObject * tileObject = qobject_cast<MapTileGraphicsObject *>(QObject::sender());
+    if (!finished || tileObject == 0 || _tileLayoutTimer->isActive()
+            || !this->isOnScreen(tileObject, this->visibleSceneRect()))
+        return;
+    if (this->pendingVisibleTiles() == 0)
+        this->visibleTilesLoaded();
+}
+
 //protected
 void MapGraphicsView::doTileLayout()
 {
@@ -399,16 +614,24 @@ void MapGraphicsView::doTileLayout()
     //We'll mark tiles that aren't being displayed as free so we can use them
     QQueue<MapTileGraphicsObject *> freeTiles;
 
-    QSet<QPointF> placesWhereTilesAre;
-    foreach(MapTileGraphicsObject * tileObject, _tileObjects)
+    //Drop tiles that have scrolled well out of view from the index. Everything not in the index is free
+    QMutableHashIterator<quint64, MapTileGraphicsObject *> iter(_tileIndex);
+    while (iter.hasNext())
     {
+        iter.next();
+        MapTileGraphicsObject * tileObject = iter.value();
         if (!tileObject->isVisible() || !exaggeratedBoundingRect.contains(tileObject->pos()))
         {
-            freeTiles.enqueue(tileObject);
+            //Don't leave a download for a tile we've scrolled away from ahead of the ones on screen
             tileObject->setVisible(false);
+            tileObject->cancelPendingRequest();
+            iter.remove();
         }
-        else
-            placesWhereTilesAre.insert(tileObject->pos());
+    }
+    foreach(MapTileGraphicsObject * tileObject, _tileObjects)
+    {
+        if (!tileObject->isVisible())
+            freeTiles.enqueue(tileObject);
     }
 
     const quint16 tileSize = _tileSource->tileSize();
@@ -430,22 +653,24 @@ void MapGraphicsView::doTileLayout()
     {
         for (qint32 y = yc; y < yMax; y++)
         {
+            const quint64 key = tileKey(x, y);
+            if (_tileIndex.contains(key))
+                continue;
+
             const QPointF scenePos(x*tileSize + tileSize/2,
                                    y*tileSize + tileSize/2);
 
-
-            bool tileIsThere = false;
-            if (placesWhereTilesAre.contains(scenePos))
-                tileIsThere = true;
-
-            if (tileIsThere)
-                continue;
-
             //Just in case we're running low on free tiles, add one
             if (freeTiles.isEmpty())
             {
                 MapTileGraphicsObject * tileObject = new MapTileGraphicsObject(tileSize);
+                tileObject->setPlaceholders(&_placeholders);
+                tileObject->setRenderProfiler(_renderProfiler);
                 tileObject->setTileSource(_tileSource);
+                connect(tileObject,
+                        SIGNAL(tileDelivered(quint32,quint32,quint8,bool,bool)),
+                        this,
+                        SLOT(handleTileDelivered(quint32,quint32,quint8,bool,bool)));
                 _tileObjects.insert(tileObject);
                 _childScene->addItem(tileObject);
                 freeTiles.enqueue(tileObject);
@@ -457,11 +682,23 @@ void MapGraphicsView::doTileLayout()
             if (tileObject->isVisible() != true)
                 tileObject->setVisible(true);
             tileObject->setTile(x,y,this->zoomLevel());
+            _tileIndex.insert(key, tileObject);
         }
     }
 
-    //If we've got a lot of free tiles left over, delete some of them
-    while (freeTiles.size() > 2)
+    //Replan prefetching around what we just laid out. This also drops stale prefetches for where we were
+    if (xc < xMax && yc < yMax)
+        _prefetcher->setViewport(xc, yc, xMax, yMax, this->zoomLevel());
+    else
+        _prefetcher->cancel();
+
+    /*
+      Keep enough tile objects around to cover the area we keep tiles for (twice the viewport each way),
+      so panning recycles them instead of creating and deleting them. Only a shrinking viewport or zooming
+      out leaves more than that, and then the extras are deleted.
+    */
+    const int poolCapacity = 4 * perSide * perSide;
+    while (!freeTiles.isEmpty() && _tileObjects.size() > poolCapacity)
     {
         MapTileGraphicsObject * tileObject = freeTiles.dequeue();
         _tileObjects.remove(tileObject);
@@ -469,6 +706,9 @@ void MapGraphicsView::doTileLayout()
         delete tileObject;
     }
 
+    //Tiles straight from the memory cache may all have arrived already, or nothing new may have been needed
+    if (this->pendingVisibleTiles() == 0)
+        this->visibleTilesLoaded();
 }
 
 //protected
@@ -482,3 +722,62 @@ void MapGraphicsView::resetQGSSceneSize()
     if (_childScene->sceneRect().width() != dimension)
         _childScene->setSceneRect(0,0,dimension,dimension);
 }
+
+//private
+void MapGraphicsView::applyViewport(QGraphicsView *childView)
+{
+    const bool isOpenGL = (childView->viewport() != 0
+                           && childView->viewport()->inherits("QOpenGLWidget"));
+    if (isOpenGL == _openGLViewport)
+        return;
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 4, 0)
+    //The view takes ownership of the new viewport and deletes the old one
+    if (_openGLViewport)
+    {
+        childView->setViewport(new QOpenGLWidget());
+
+        //Redrawing a GL viewport in pieces costs more than redrawing all of it
+        childView->setViewportUpdateMode(QGraphicsView::FullViewportUpdate);
+    }
+    else
+    {
+        childView->setViewport(new QWidget());
+        childView->setViewportUpdateMode(QGraphicsView::MinimalViewportUpdate);
+    }
+#else
+    qWarning() << "OpenGL viewports need Qt 5.4 or later, using the raster viewport";
+#endif
+}
+
+//private
+QRectF MapGraphicsView::visibleSceneRect() const
+{
+    QPolygon viewportPolygonQGV;
+    viewportPolygonQGV << QPoint(0,0) << QPoint(0,_childView->height()) << QPoint(_childView->width(),_childView->height()) << QPoint(_childView->width(),0);
+    return _childView->mapToScene(viewportPolygonQGV).boundingRect();
+}
+
+//private
+bool MapGraphicsView::isOnScreen(const MapTileGraphicsObject *tileObject, const QRectF &visibleRect) const
+{
+    if (!tileObject->isVisible())
+        return false;
+    const qreal tileSize = tileObject->tileSize();
+    const QRectF tileRect(tileObject->pos() - QPointF(tileSize / 2.0, tileSize / 2.0), QSizeF(tileSize, tileSize));
+    return tileRect.intersects(visibleRect);
+}
+
+//private
+void MapGraphicsView::applyRenderProfiler()
+{
+    PrivateQGraphicsView * childView = qobject_cast<PrivateQGraphicsView *>(_childView.data());
+    if (childView != 0)
+    {
+        childView->setRenderProfiler(_renderProfiler);
+        childView->setProfileOverlay(_renderProfileOverlay && _renderProfiler != 0);
+    }
+
+    foreach(MapTileGraphicsObject * tileObject, _tileObjects)
+        tileObject->setRenderProfiler(_renderProfiler);
+}
@@ -11,6 +11,7 @@
 #include <QVector3D>
 #include <QStringBuilder>
 #include <QHash>
+#include <QTimer>
 
 #include "MapGraphicsScene.h"
 #include "MapGraphicsObject.h"
@@ -18,7 +19,10 @@
 #include "MapGraphics_global.h"
 
 #include "guts/MapTileGraphicsObject.h"
+#include "guts/MapTilePlaceholders.h"
 #include "guts/PrivateQGraphicsInfoSource.h"
+#include "guts/MapTilePrefetcher.h"
+#include "guts/MapRenderProfiler.h"
 
 class MAPGRAPHICSSHARED_EXPORT MapGraphicsView : public QWidget, public PrivateQGraphicsInfoSource
 {
@@ -61,6 +65,9 @@ public:
      * @brief Sets the tile source that this view will pull from.
      * MapGraphicsView does NOT take ownership of the tile source.
      *
+     * Several views (e.g. an overview map and the main map) can share one tile source, or composites sharing
+     * children. They then share its memory cache, and a tile that's on screen in both is fetched once for both.
+     *
      * @param tSource
      */
     void setTileSource(QSharedPointer<MapTileSource> tSource);
@@ -73,9 +80,86 @@ public:
     void zoomOut(ZoomMode zMode = CenterZoom);
 
     void rotate(qreal rotation);
+
+    /**
+     * @brief How many rings of tiles beyond the viewport are fetched ahead of time. Zero disables the ring.
+     */
+    int prefetchRingSize() const;
+    void setPrefetchRingSize(int ringSize);
+
+    /**
+     * @brief Whether the viewport is also fetched ahead of time on the neighboring zoom levels
+     */
+    bool prefetchZoomLevels() const;
+    void setPrefetchZoomLevels(bool prefetch);
+
+    /**
+     * @brief Whether the map is drawn through an OpenGL viewport instead of the raster engine. Tiles are then
+     * kept on the GPU as textures and overlays are rasterized by the GPU, which keeps panning smooth over
+     * dense overlays. Needs Qt 5.4 or later; setting it on older versions only prints a warning.
+     */
+    bool openGLViewport() const;
+    void setOpenGLViewport(bool useOpenGL);
+
+    /**
+     * @brief Whether frame times and the time each class of object spends painting and working out bounding
+     * rects are being collected, see renderProfiler(). Off by default. Turning it off throws away what was
+     * collected.
+     */
+    bool renderProfiling() const;
+    void setRenderProfiling(bool profile);
+
+    /**
+     * @brief Whether a summary of the render profile is drawn over the top left of the map while profiling
+     */
+    bool renderProfileOverlay() const;
+    void setRenderProfileOverlay(bool overlay);
+
+    /**
+     * @brief Returns what render profiling has collected so far (e.g. to export with MapRenderProfiler::toJson()),
+     * or null if it's off
+     */
+    //pure-virtual from PrivateQGraphicsInfoSource
+    MapRenderProfiler * renderProfiler() const;
+
+    /**
+     * @brief Returns the center, zoom level and the tiles on screen (the nearest to the center first, up to a
+     * few dozen), for restoreViewState() to bring back, e.g. the next time the application starts.
+     */
+    QByteArray saveViewState() const;
+
+    /**
+     * @brief Centers and zooms the view as it was when state was saved. The saved tiles are warmed into the tile
+     * source's memory cache first (see MapTileSource::warmMemoryCache()), so the first layout finds them there
+     * instead of decoding them off the disk one by one. Set the tile source before calling this.
+     * Returns false, leaving the view alone, if state isn't something saveViewState() returned.
+     */
+    bool restoreViewState(const QByteArray& state);
+
+    /**
+     * @brief Returns how many of the tiles on screen are still waiting for their finished tile (they may show a
+     * placeholder or a partial tile meanwhile). Zero means the viewport is fully loaded.
+     */
+    int pendingVisibleTiles() const;
+
+protected:
+    //virtual from QWidget
+    virtual void resizeEvent(QResizeEvent * event);
     
 signals:
     void zoomLevelChanged(quint8 nZoom);
+
+    /**
+     * @brief Emitted when a tile on the current zoom level is drawn: a partial tile (finished=false), or the
+     * finished one
+     */
+    void tileDisplayed(quint32 x, quint32 y, quint8 z, bool finished);
+
+    /**
+     * @brief Emitted when the tiles on screen are all loaded, i.e. pendingVisibleTiles() has dropped to zero:
+     * when the last one arrives, or after a layout that didn't need any new ones
+     */
+    void visibleTilesLoaded();
     
 public slots:
 
@@ -90,10 +174,29 @@ protected slots:
 private slots:
     void renderTiles();
 
+    /**
+     * @brief Lays out the tiles on the next pass through the event loop. Calling this many times before then
+     * (e.g., once per scroll step while dragging) still only lays them out once.
+     */
+    void scheduleTileLayout();
+
+    void handleTileDelivered(quint32 x, quint32 y, quint8 z, bool displayed, bool finished);
+
 protected:
     void doTileLayout();
     void resetQGSSceneSize();
 
+private:
+    //Gives the child view the viewport widget that _openGLViewport asks for
+    void applyViewport(QGraphicsView * childView);
+
+    //Hands _renderProfiler to the child view and the tile objects
+    void applyRenderProfiler();
+
+    //The part of the scene on screen, and whether a tile object overlaps it
+    QRectF visibleSceneRect() const;
+    bool isOnScreen(const MapTileGraphicsObject * tileObject, const QRectF& visibleRect) const;
+
 private:
     QPointer<MapGraphicsScene> _scene;
     QPointer<QGraphicsView> _childView;
@@ -102,9 +205,27 @@ private:
 
     QSet<MapTileGraphicsObject *> _tileObjects;
 
+    //The visible tile objects, keyed by their tile's (x, y) on the current zoom level
+    QHash<quint64, MapTileGraphicsObject *> _tileIndex;
+
+    //Recently shown tiles, which stand in for tiles on other zoom levels while those load
+    MapTilePlaceholders _placeholders;
+
+    //Requests tiles around the viewport at a lower rate than the visible ones
+    MapTilePrefetcher * _prefetcher;
+
+    //Single-shot timer that coalesces layout requests from scrolling, resizing and zooming
+    QTimer * _tileLayoutTimer;
+
     quint8 _zoomLevel;
 
     DragMode _dragMode;
+
+    bool _openGLViewport;
+
+    //Null unless render profiling is on
+    MapRenderProfiler * _renderProfiler;
+    bool _renderProfileOverlay;
 };
 
 inline uint qHash(const QPointF& key)
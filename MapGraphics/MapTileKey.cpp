@@ -0,0 +1,74 @@
+#include "MapTileKey.h"
+
+const int COORDINATE_BITS = 28;
+const quint64 COORDINATE_MASK = (Q_UINT64_C(1) << COORDINATE_BITS) - 1;
+
+MapTileKey::MapTileKey() :
+    _packed(0)
+{
+}
+
+MapTileKey::MapTileKey(quint32 x, quint32 y, quint8 z)
+{
+    _packed = (((quint64)z) << (2 * COORDINATE_BITS))
+            | ((((quint64)x) & COORDINATE_MASK) << COORDINATE_BITS)
+            | (((quint64)y) & COORDINATE_MASK);
+}
+
+bool MapTileKey::operator ==(const MapTileKey &other) const
+{
+    return _packed == other._packed;
+}
+
+bool MapTileKey::operator !=(const MapTileKey &other) const
+{
+    return !(*this == other);
+}
+
+bool MapTileKey::operator <(const MapTileKey &other) const
+{
+    return _packed < other._packed;
+}
+
+quint32 MapTileKey::x() const
+{
+    return (quint32)((_packed >> COORDINATE_BITS) & COORDINATE_MASK);
+}
+
+quint32 MapTileKey::y() const
+{
+    return (quint32)(_packed & COORDINATE_MASK);
+}
+
+quint8 MapTileKey::z() const
+{
+    return (quint8)(_packed >> (2 * COORDINATE_BITS));
+}
+
+quint64 MapTileKey::toUInt64() const
+{
+    return _packed;
+}
+
+//static
+MapTileKey MapTileKey::fromUInt64(quint64 packed)
+{
+    MapTileKey toRet;
+    toRet._packed = packed;
+    return toRet;
+}
+
+//non-member
+QDebug operator<<(QDebug dbg, const MapTileKey &key)
+{
+    dbg.nospace() << "MapTileKey(" << key.x() << "," << key.y() << "," << (int)key.z() << ")";
+    return dbg.space();
+}
+
+//non-member
+uint qHash(const MapTileKey &key)
+{
+    //The low half holds y and the bottom of x. Fold the rest of x and z onto it
+    const quint64 packed = key.toUInt64();
+    return (uint)(packed ^ (packed >> 32));
+}
@@ -0,0 +1,46 @@
+#ifndef MAPTILEKEY_H
+#define MAPTILEKEY_H
+
+#include <QtGlobal>
+#include <QtDebug>
+
+#include "MapGraphics_global.h"
+
+/**
+ * @brief The MapTileKey class identifies a tile by its x, y and zoom level, packed into a single 64-bit
+ * integer. MapTileSource uses it to key its caches and request bookkeeping so that looking a tile up
+ * doesn't have to format or parse a string.
+ *
+ * x and y each get 28 bits, which covers every tile up to zoom level 28.
+ */
+class MAPGRAPHICSSHARED_EXPORT MapTileKey
+{
+public:
+    MapTileKey();
+    MapTileKey(quint32 x, quint32 y, quint8 z);
+
+    bool operator ==(const MapTileKey& other) const;
+    bool operator !=(const MapTileKey& other) const;
+    bool operator <(const MapTileKey& other) const;
+
+    quint32 x() const;
+    quint32 y() const;
+    quint8 z() const;
+
+    /**
+     * @brief toUInt64 returns the packed key. Keys order by zoom level, then x, then y.
+     */
+    quint64 toUInt64() const;
+    static MapTileKey fromUInt64(quint64 packed);
+
+private:
+    quint64 _packed;
+};
+
+//Non-member method for streaming to qDebug
+MAPGRAPHICSSHARED_EXPORT QDebug operator<<(QDebug dbg, const MapTileKey& key);
+
+//Non-member method for hashing
+MAPGRAPHICSSHARED_EXPORT uint qHash(const MapTileKey& key);
+
+#endif // MAPTILEKEY_H
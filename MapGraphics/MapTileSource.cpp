@@ -1,25 +1,105 @@
 #include "MapTileSource.h"
 
+#include "guts/MapTilePackCache.h"
+#include "guts/MapTileExpirationStore.h"
+#include "guts/MapTileDiskCacheWriter.h"
+
 #include <QStringBuilder>
 #include <QMutexLocker>
 #include <QtDebug>
-#include <QStringList>
-#include <QDataStream>
+#include <QBuffer>
+#include <QTimer>
+#include <QtConcurrentRun>
 
 const QString MAPGRAPHICS_CACHE_FOLDER_NAME = ".MapGraphicsCache";
 const quint32 DEFAULT_CACHE_DAYS = 7;
-const quint64 MAX_DISK_CACHE_READ_ATTEMPTS = 100000;
+const int DEFAULT_MEMORY_CACHE_BYTES = 32 * 1024 * 1024;
+const qint64 DEFAULT_DISK_CACHE_QUOTA_BYTES = Q_INT64_C(2) * 1024 * 1024 * 1024;
+
+//Decoded tiles waiting for pickup are big, but dropping them means a client never gets its tile
+const int DEFAULT_TEMP_CACHE_BYTES = 64 * 1024 * 1024;
+const int DEFAULT_MAX_CONCURRENT_REQUESTS = 4;
+
+//Expired tiles kept around so their fetches can be revalidated instead of downloaded again
+const int DEFAULT_STALE_CACHE_BYTES = 8 * 1024 * 1024;
+
+//Revalidations under way at once, so that they leave most of the fetches to tiles somebody is waiting on
+const int MAX_CONCURRENT_REVALIDATIONS = 2;
+
+//How long to hold off revalidating after a revalidation fails, which usually means we're offline
+const int REVALIDATION_RETRY_SECS = 300;
+
+//How often changed cache expirations are appended to disk. A crash loses at most this much
+const int CACHE_EXPIRATION_SAVE_INTERVAL_MS = 5000;
+
+//non-member
+//Tiles in the format QPixmap uses on the screen, so that turning them into pixmaps on the GUI thread is just a
+//copy. Decoded PNGs and JPEGs are often paletted or 24-bit, which would need converting there.
+static QImage toDisplayFormat(const QImage& image)
+{
+    if (image.isNull() || image.format() == QImage::Format_ARGB32_Premultiplied
+            || image.format() == QImage::Format_RGB32)
+        return image;
+    return image.convertToFormat(image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied
+                                                         : QImage::Format_RGB32);
+}
+
+//non-member
+static QImage * decodeTile(const QByteArray& encodedTile)
+{
+    QImage * image = new QImage();
+    if (!image->loadFromData(encodedTile))
+    {
+        delete image;
+        return 0;
+    }
+    *image = toDisplayFormat(*image);
+    return image;
+}
+
+//non-member
+static QImage decodeTileImage(const QByteArray& encodedTile)
+{
+    //Run in the thread pool, so it returns by value: nobody may be left to delete a pointer
+    QImage image;
+    image.loadFromData(encodedTile);
+    return toDisplayFormat(image);
+}
 
 MapTileSource::MapTileSource() :
-    QObject(), _cacheExpirationsLoaded(false)
+    QObject(), _cacheExpirationsLoaded(false), _cacheExpirations(0),
+    _expiredTilePolicy(StaleWhileRevalidate), _packCache(0), _packCacheFailed(false), _diskCacheWriter(0),
+    _diskCacheQuota(DEFAULT_DISK_CACHE_QUOTA_BYTES), _nextToken(1), _maxConcurrentRequests(DEFAULT_MAX_CONCURRENT_REQUESTS)
 {
     this->setCacheMode(DiskAndMemCaching);
+    _memoryCache.setMaxCost(DEFAULT_MEMORY_CACHE_BYTES);
+
+    //Parented to us so that it follows us into our thread
+    _cacheExpirationsTimer = new QTimer(this);
+    _cacheExpirationsTimer->setInterval(CACHE_EXPIRATION_SAVE_INTERVAL_MS);
+    connect(_cacheExpirationsTimer,
+            SIGNAL(timeout()),
+            this,
+            SLOT(saveCacheExpirationsToDisk()));
+    _cacheExpirationsTimer->start();
+    _tempCache.setMaxCost(DEFAULT_TEMP_CACHE_BYTES);
+    _staleTiles.setMaxCost(DEFAULT_STALE_CACHE_BYTES);
 
     //We connect this signal/slot pair to communicate across threads.
     connect(this,
-            SIGNAL(tileRequested(quint32,quint32,quint8)),
+            SIGNAL(requestQueueChanged()),
+            this,
+            SLOT(processRequestQueue()),
+            Qt::QueuedConnection);
+    connect(this,
+            SIGNAL(memoryCacheWarmingRequested()),
+            this,
+            SLOT(warmRequestedTiles()),
+            Qt::QueuedConnection);
+    connect(this,
+            SIGNAL(diskCacheQuotaChanged()),
             this,
-            SLOT(startTileRequest(quint32,quint32,quint8)),
+            SLOT(applyDiskCacheQuota()),
             Qt::QueuedConnection);
 
     /*
@@ -30,32 +110,215 @@ MapTileSource::MapTileSource() :
             SIGNAL(allTilesInvalidated()),
             this,
             SLOT(clearTempCache()));
+
+    //Whatever was being fetched when the tiles were invalidated has to be fetched again
+    connect(this,
+            SIGNAL(allTilesInvalidated()),
+            this,
+            SLOT(restartInFlightRequests()));
 }
 
 MapTileSource::~MapTileSource()
 {
-    this->saveCacheExpirationsToDisk();
+    //The store saves whatever is left as it's deleted
+    if (_cacheExpirations != 0)
+        delete _cacheExpirations;
+    _cacheExpirations = 0;
+
+    //Finish writing before the pack the writer may be writing to goes away
+    if (_diskCacheWriter != 0)
+    {
+        _diskCacheWriter->stop();
+        delete _diskCacheWriter;
+    }
+    _diskCacheWriter = 0;
+
+    if (_packCache != 0)
+        delete _packCache;
+    _packCache = 0;
+}
+
+quint64 MapTileSource::requestTile(quint32 x, quint32 y, quint8 z, RequestPriority priority)
+{
+    return this->requestTile(x, y, z, priority, 0, 0);
 }
 
-void MapTileSource::requestTile(quint32 x, quint32 y, quint8 z)
+quint64 MapTileSource::requestTile(quint32 x, quint32 y, quint8 z, RequestPriority priority,
+                                   QObject *receiver, const char *member)
 {
+    const MapTileKey key(x,y,z);
+
+    QMutexLocker lock(&_requestLock);
+    const quint64 token = _nextToken++;
+    _tokenKeys.insert(token, key);
+
+    if (receiver != 0 && member != 0)
+    {
+        TileDelivery delivery;
+        delivery.receiver = receiver;
+        delivery.member = member;
+        _deliveries.insert(token, delivery);
+    }
+
+    bool queueChanged = false;
+    if (_inFlightRequests.contains(key))
+    {
+        //It's already being fetched, so there's one more client waiting for it
+        TileRequest& request = _inFlightRequests[key];
+        request.tokens.insert(token);
+        request.priority = qMax(request.priority, priority);
+    }
+    else if (_queuedRequests.contains(key))
+    {
+        //Move it up the queue if it's wanted more urgently now
+        TileRequest& request = _queuedRequests[key];
+        request.tokens.insert(token);
+        if (priority > request.priority)
+        {
+            request.priority = priority;
+            _queues[priority].enqueue(key);
+            queueChanged = true;
+        }
+    }
+    else
+    {
+        TileRequest request;
+        request.key = key;
+        request.priority = priority;
+        request.tokens.insert(token);
+        _queuedRequests.insert(key, request);
+        _queues[priority].enqueue(key);
+        queueChanged = true;
+    }
+    lock.unlock();
+
+    this->tileRequested(x,y,z);
+
     /*We emit a signal to communicate across threads. MapTileSource (usually) runs in its own
       thread, but this method will be called from a different thread (probably the GUI thread).
       It's easy to communicate across threads with queued signals/slots.
     */
-    this->tileRequested(x,y,z);
+    if (queueChanged)
+        this->requestQueueChanged();
+    return token;
+}
+
+void MapTileSource::cancelTileRequest(quint64 token)
+{
+    QMutexLocker lock(&_requestLock);
+    if (!_tokenKeys.contains(token))
+        return;
+    const MapTileKey key = _tokenKeys.take(token);
+
+    //Once this returns the receiver won't hear about the tile, so it's free to go away
+    _deliveries.remove(token);
+
+    if (_queuedRequests.contains(key))
+    {
+        TileRequest& request = _queuedRequests[key];
+        request.tokens.remove(token);
+        if (!request.tokens.isEmpty())
+            return;
+
+        //Nobody wants it anymore. Its entry in _queues gets skipped when it comes up
+        _queuedRequests.remove(key);
+        this->compactQueues();
+        return;
+    }
+
+    if (!_inFlightRequests.contains(key))
+        return;
+
+    TileRequest& request = _inFlightRequests[key];
+    request.tokens.remove(token);
+    if (!request.tokens.isEmpty())
+        return;
+
+    //Stop counting it against the limit now, and let the fetch itself be cancelled in our own thread
+    _cancelledFetches.append(_inFlightRequests.take(key));
+    lock.unlock();
+
+    this->requestQueueChanged();
+}
+
+int MapTileSource::maxConcurrentRequests() const
+{
+    QMutexLocker lock(&_requestLock);
+    return _maxConcurrentRequests;
+}
+
+void MapTileSource::setMaxConcurrentRequests(int maxRequests)
+{
+    QMutexLocker lock(&_requestLock);
+    _maxConcurrentRequests = qMax<int>(0, maxRequests);
+    lock.unlock();
+
+    this->requestQueueChanged();
+}
+
+int MapTileSource::memoryCacheBudget() const
+{
+    QMutexLocker lock(&_memoryCacheLock);
+    return _memoryCache.maxCost();
+}
+
+void MapTileSource::setMemoryCacheBudget(int bytes)
+{
+    QMutexLocker lock(&_memoryCacheLock);
+    const int before = _memoryCache.count();
+    _memoryCache.setMaxCost(qMax<int>(0, bytes));
+    _statistics.evictions += before - _memoryCache.count();
+}
+
+MapTileSource::CacheStatistics MapTileSource::cacheStatistics() const
+{
+    QMutexLocker lock(&_memoryCacheLock);
+    MapTileSource::CacheStatistics toRet = _statistics;
+    toRet.memoryBytes = _memoryCache.totalCost();
+    toRet.memoryTiles = _memoryCache.count();
+    toRet.memoryBudget = _memoryCache.maxCost();
+    lock.unlock();
+
+    QMutexLocker tempLock(&_tempCacheLock);
+    toRet.pendingBytes = _tempCache.totalCost();
+    return toRet;
+}
+
+void MapTileSource::resetCacheStatistics()
+{
+    QMutexLocker lock(&_memoryCacheLock);
+    _statistics = MapTileSource::CacheStatistics();
+}
+
+void MapTileSource::warmMemoryCache(const QList<MapTileKey> &keys)
+{
+    if (keys.isEmpty())
+        return;
+
+    QMutexLocker lock(&_memoryCacheLock);
+    _tilesToWarm += keys;
+    lock.unlock();
+
+    //warmRequestedTiles() picks them up in our thread
+    this->memoryCacheWarmingRequested();
 }
 
 QImage *MapTileSource::getFinishedTile(quint32 x, quint32 y, quint8 z)
 {
-    const QString cacheID = MapTileSource::createCacheID(x,y,z);
+    const MapTileKey key(x,y,z);
     QMutexLocker lock(&_tempCacheLock);
-    if (!_tempCache.contains(cacheID))
+    if (!_tempCache.contains(key))
     {
+        _tempCachePickups.remove(key);
         qWarning() << "getFinishedTile() called, but the tile is not present";
         return 0;
     }
-    return _tempCache.take(cacheID);
+
+    //Everyone but the last to pick it up gets a copy, which shares the pixels until somebody paints on it
+    if (--_tempCachePickups[key] > 0)
+        return new QImage(*_tempCache.object(key));
+    _tempCachePickups.remove(key);
+    return _tempCache.take(key);
 }
 
 MapTileSource::CacheMode MapTileSource::cacheMode() const
@@ -68,20 +331,143 @@ void MapTileSource::setCacheMode(MapTileSource::CacheMode nMode)
     _cacheMode = nMode;
 }
 
+MapTileSource::ExpiredTilePolicy MapTileSource::expiredTilePolicy() const
+{
+    QMutexLocker lock(&_memoryCacheLock);
+    return _expiredTilePolicy;
+}
+
+void MapTileSource::setExpiredTilePolicy(MapTileSource::ExpiredTilePolicy policy)
+{
+    QMutexLocker lock(&_memoryCacheLock);
+    _expiredTilePolicy = policy;
+}
+
+void MapTileSource::ll2qgsBatch(const QPointF *ll, QPointF *qgs, int count, quint8 zoomLevel) const
+{
+    for (int i = 0; i < count; i++)
+        qgs[i] = this->ll2qgs(ll[i], zoomLevel);
+}
+
+void MapTileSource::qgs2llBatch(const QPointF *qgs, QPointF *ll, int count, quint8 zoomLevel) const
+{
+    for (int i = 0; i < count; i++)
+        ll[i] = this->qgs2ll(qgs[i], zoomLevel);
+}
+
+QRectF MapTileSource::tileGeoRect(quint32 x, quint32 y, quint8 z) const
+{
+    const quint16 size = this->tileSize();
+    const QPointF northWest = this->qgs2ll(QPointF((qreal) x * size, (qreal) y * size), z);
+    const QPointF southEast = this->qgs2ll(QPointF((qreal) (x + 1) * size, (qreal) (y + 1) * size), z);
+    return QRectF(northWest, southEast).normalized();
+}
+
 //private slot
+void MapTileSource::processRequestQueue()
+{
+    QMutexLocker lock(&_requestLock);
+    const QList<TileRequest> cancelled = _cancelledFetches;
+    _cancelledFetches.clear();
+    lock.unlock();
+
+    foreach(const TileRequest& request, cancelled)
+        this->cancelFetch(request.key.x(), request.key.y(), request.key.z());
+
+    //Start as many requests as we're allowed to. Fetches can finish synchronously, so never hold the lock here
+    while (true)
+    {
+        TileRequest request;
+        lock.relock();
+        if (_maxConcurrentRequests > 0 && _inFlightRequests.size() >= _maxConcurrentRequests)
+            return;
+        if (!this->takeNextRequest(&request))
+        {
+            //Revalidations only get the room that's left over
+            MapTileKey key;
+            if (!this->takeNextRevalidation(&key))
+                return;
+            lock.unlock();
+
+            //Straight to fetchTile(), since the caches would only hand back the expired tile
+            this->fetchTile(key.x(), key.y(), key.z());
+            continue;
+        }
+        lock.unlock();
+
+        this->startTileRequest(request.key.x(), request.key.y(), request.key.z());
+    }
+}
+
+//private slot
+void MapTileSource::restartInFlightRequests()
+{
+    QMutexLocker lock(&_requestLock);
+    QHash<MapTileKey, TileRequest> revalidations;
+    foreach(const TileRequest& request, _inFlightRequests)
+    {
+        //Nobody is waiting on a revalidation, and whatever it comes back with replaces the cached tile anyway
+        if (_revalidating.contains(request.key) && request.tokens.isEmpty())
+        {
+            revalidations.insert(request.key, request);
+            continue;
+        }
+
+        if (_queuedRequests.contains(request.key))
+        {
+            TileRequest& queued = _queuedRequests[request.key];
+            queued.tokens.unite(request.tokens);
+            if (request.priority > queued.priority)
+            {
+                queued.priority = request.priority;
+                _queues[request.priority].enqueue(request.key);
+            }
+            continue;
+        }
+        _queuedRequests.insert(request.key, request);
+        _queues[request.priority].enqueue(request.key);
+    }
+    _inFlightRequests = revalidations;
+    lock.unlock();
+
+    this->requestQueueChanged();
+}
+
+//private
 void MapTileSource::startTileRequest(quint32 x, quint32 y, quint8 z)
 {
     //Check caches for the tile first
-    if (this->cacheMode() == DiskAndMemCaching)
+    if (this->cacheMode() != NoCaching)
     {
-        const QString cacheID = MapTileSource::createCacheID(x,y,z);
-        QImage * cached = this->fromMemCache(cacheID);
+        const MapTileKey key(x,y,z);
+        bool expired = false;
+        QImage * cached = this->fromMemCache(key, &expired);
+        bool fromMemory = (cached != 0);
         if (!cached)
-            cached = this->fromDiskCache(cacheID);
+            cached = this->fromDiskCache(key, &expired);
+
+        QMutexLocker lock(&_memoryCacheLock);
+        if (fromMemory)
+            _statistics.memoryHits++;
+        else if (cached)
+            _statistics.diskHits++;
+        else
+            _statistics.misses++;
+        if (cached && expired)
+            _statistics.staleHits++;
+        lock.unlock();
 
         //If we got an image from one of the caches, prepare it for the client and return
         if (cached)
         {
+            //Keeps it from being evicted from the disk cache for a while
+            MapTileDiskCacheWriter * writer = this->diskCacheWriter();
+            if (writer != 0)
+                writer->noteAccess(key);
+
+            //Queued first, so that the expired copy kept for the revalidation outlives this request
+            if (expired)
+                this->queueRevalidation(key);
             this->prepareRetrievedTile(x,y,z,cached);
             return;
         }
@@ -94,169 +480,369 @@ void MapTileSource::startTileRequest(quint32 x, quint32 y, quint8 z)
 //private slot
 void MapTileSource::clearTempCache()
 {
+    QMutexLocker lock(&_tempCacheLock);
     _tempCache.clear();
+    _tempCachePickups.clear();
 }
 
-//protected static
-QString MapTileSource::createCacheID(quint32 x, quint32 y, quint8 z)
+//private
+bool MapTileSource::takeNextRequest(TileRequest *request)
 {
-    //We use % because it's more efficient to concatenate with QStringBuilder
-    QString toRet = QString::number(x) % "," % QString::number(y) % "," % QString::number(z);
-    return toRet;
+    for (int priority = VisiblePriority; priority >= PrefetchPriority; priority--)
+    {
+        QQueue<MapTileKey>& queue = _queues[priority];
+        while (!queue.isEmpty())
+        {
+            const MapTileKey key = queue.dequeue();
+
+            //Skip requests that were cancelled or have since been queued at a higher priority
+            if (!_queuedRequests.contains(key) || _queuedRequests.value(key).priority != priority)
+                continue;
+
+            *request = _queuedRequests.take(key);
+            _inFlightRequests.insert(key, *request);
+            return true;
+        }
+    }
+    return false;
 }
 
-//protected static
-bool MapTileSource::cacheID2xyz(const QString & string, quint32 *x, quint32 *y, quint32 *z)
+//private
+void MapTileSource::compactQueues()
 {
-    QStringList list = string.split(',');
-    if (list.size() != 3)
+    //Only bother once stale entries clearly outnumber live ones
+    int queued = 0;
+    for (int priority = PrefetchPriority; priority <= VisiblePriority; priority++)
+        queued += _queues[priority].size();
+    if (queued <= 2 * _queuedRequests.size() + 64)
+        return;
+
+    for (int priority = PrefetchPriority; priority <= VisiblePriority; priority++)
     {
-        qWarning() << "Bad cacheID" << string << "cannot convert";
-        return false;
+        QQueue<MapTileKey> compacted;
+        foreach(const MapTileKey& key, _queues[priority])
+        {
+            if (_queuedRequests.contains(key) && _queuedRequests.value(key).priority == priority)
+                compacted.enqueue(key);
+        }
+        _queues[priority] = compacted;
     }
+}
 
-    bool ok = true;
-    *x = list.at(0).toUInt(&ok);
-    if (!ok)
-        return false;
-    *y = list.at(1).toUInt(&ok);
-    if (!ok)
-        return false;
-    *z = list.at(2).toUInt(&ok);
-    return ok;
+//private
+void MapTileSource::queueRevalidation(const MapTileKey &key)
+{
+    QMutexLocker lock(&_requestLock);
+    if (_revalidations.contains(key))
+        return;
+
+    //Until the retry time the expired tile is just handed out as it is
+    if (!_revalidationRetryTime.isNull() && QDateTime::currentDateTimeUtc() < _revalidationRetryTime)
+        return;
+
+    _revalidations.insert(key);
+    _revalidationQueue.enqueue(key);
 }
 
-QImage *MapTileSource::fromMemCache(const QString &cacheID)
+//private
+bool MapTileSource::takeNextRevalidation(MapTileKey *key)
 {
-    QImage * toRet = 0;
+    if (_revalidating.size() >= MAX_CONCURRENT_REVALIDATIONS)
+        return false;
+    if (!_revalidationRetryTime.isNull() && QDateTime::currentDateTimeUtc() < _revalidationRetryTime)
+        return false;
 
-    if (_memoryCache.contains(cacheID))
+    while (!_revalidationQueue.isEmpty())
     {
-        //Figure out when the tile we're loading from cache was supposed to expire
-        QDateTime expireTime = this->getTileExpirationTime(cacheID);
+        *key = _revalidationQueue.dequeue();
 
-        //If the cached tile is older than we would like, throw it out
-        if (QDateTime::currentDateTimeUtc().secsTo(expireTime) <= 0)
+        //Already being fetched for somebody, which is as good as revalidating it
+        if (_inFlightRequests.contains(*key))
         {
-            _memoryCache.remove(cacheID);
+            _revalidations.remove(*key);
+            continue;
         }
-        //Otherwise, make a copy of the cached tile and return it to the caller
-        else
+
+        //A request without tokens, so that anyone who asks for the tile meanwhile just joins it
+        TileRequest request;
+        request.key = *key;
+        request.priority = PrefetchPriority;
+        _inFlightRequests.insert(*key, request);
+        _revalidating.insert(*key);
+        return true;
+    }
+    return false;
+}
+
+//private
+bool MapTileSource::finishRevalidation(const MapTileKey &key, const QByteArray &encodedTile,
+                                       const QDateTime &expireTime)
+{
+    QMutexLocker lock(&_requestLock);
+    if (!_revalidating.remove(key))
+        return false;
+    _revalidations.remove(key);
+    lock.unlock();
+
+    QMutexLocker cacheLock(&_memoryCacheLock);
+    const StaleTile * stale = _staleTiles.object(key);
+    const bool changed = (stale == 0 || stale->encodedTile != encodedTile);
+    _staleTiles.remove(key);
+
+    //The caches only add tiles they don't have yet, so a changed tile has to replace the expired one by hand
+    if (changed)
+        _memoryCache.remove(key);
+    else
+        this->setTileExpirationTime(key, expireTime);
+    cacheLock.unlock();
+
+    //Files share the expiration store, but packs keep their own, so even an unchanged tile is written again
+    if (this->cacheMode() == PackAndMemCaching)
+    {
+        MapTilePackCache * pack = this->packCache();
+        if (pack != 0)
         {
-            toRet = new QImage(*_memoryCache.object(cacheID));
+            QMutexLocker packLock(&_packCacheLock);
+            pack->remove(key);
         }
     }
+    else if (changed)
+    {
+        const QString path = this->getDiskCacheFile(key.x(),key.y(),key.z());
+        if (QFile::exists(path) && !QFile::remove(path))
+            qWarning() << "Failed to remove old cache file" << path;
+    }
+    this->cacheEncodedTile(key, encodedTile, expireTime);
+    if (!changed)
+        return true;
 
-    return toRet;
+    //Whoever is showing the expired tile can fetch the new one from the memory cache now
+    this->tilesInvalidated(this->tileGeoRect(key.x(), key.y(), key.z()));
+    return true;
 }
 
-void MapTileSource::toMemCache(const QString &cacheID, QImage *toCache, const QDateTime &expireTime)
+//private
+void MapTileSource::failRevalidation(const MapTileKey &key)
 {
-    if (toCache == 0)
+    QMutexLocker lock(&_requestLock);
+    if (!_revalidating.remove(key))
         return;
 
-    if (_memoryCache.contains(cacheID))
-        return;
+    //The queued ones would most likely fail too. They're queued again when their tiles are next asked for
+    _revalidations.clear();
+    _revalidationQueue.clear();
+    foreach(const MapTileKey& other, _revalidating)
+        _revalidations.insert(other);
+    _revalidationRetryTime = QDateTime::currentDateTimeUtc().addSecs(REVALIDATION_RETRY_SECS);
+    lock.unlock();
 
-    //Note when the tile will expire
-    this->setTileExpirationTime(cacheID, expireTime);
+    QMutexLocker staleLock(&_memoryCacheLock);
+    _staleTiles.remove(key);
+}
+
+//private
+int MapTileSource::finishTileRequest(const MapTileKey &key, const QImage &tile)
+{
+    QMutexLocker lock(&_requestLock);
+    if (!_inFlightRequests.contains(key))
+        return 1;
+
+    /*
+      Requests made with a receiver get the tile straight away. The receivers are called while we still
+      hold the lock so that one can't be destroyed between cancelTileRequest() and our call reaching it:
+      queued calls to a receiver that's since been destroyed are discarded by Qt.
+    */
+    int pickups = 0;
+    const TileRequest request = _inFlightRequests.take(key);
+    foreach(quint64 token, request.tokens)
+    {
+        _tokenKeys.remove(token);
+        if (!_deliveries.contains(token))
+        {
+            pickups++;
+            continue;
+        }
+
+        const TileDelivery delivery = _deliveries.take(token);
+        QMetaObject::invokeMethod(delivery.receiver,
+                                  delivery.member.constData(),
+                                  Qt::QueuedConnection,
+                                  Q_ARG(quint64, token),
+                                  Q_ARG(QImage, tile),
+                                  Q_ARG(bool, true));
+    }
+    const bool haveQueued = !_queuedRequests.isEmpty() || !_revalidationQueue.isEmpty();
+    const bool revalidating = _revalidations.contains(key);
+    lock.unlock();
+
+    //Whatever the fetch did, the expired copy has served its purpose, unless it's still to be revalidated
+    if (!revalidating)
+    {
+        QMutexLocker staleLock(&_memoryCacheLock);
+        _staleTiles.remove(key);
+    }
 
-    //Make a copy of the QImage
-    QImage * copy = new QImage(*toCache);
-    _memoryCache.insert(cacheID,copy);
+    if (haveQueued)
+        this->requestQueueChanged();
+    return pickups;
 }
 
-QImage *MapTileSource::fromDiskCache(const QString &cacheID)
+QImage *MapTileSource::fromMemCache(const MapTileKey &key, bool *expired)
 {
-    //Figure out x,y,z based on the cacheID
-    quint32 x,y,z;
-    if (!MapTileSource::cacheID2xyz(cacheID,&x,&y,&z))
-        return 0;
+    if (expired != 0)
+        *expired = false;
 
-    //See if we've got it in the cache
-    const QString path = this->getDiskCacheFile(x,y,z);
-    QFile fp(path);
-    if (!fp.exists())
+    QMutexLocker lock(&_memoryCacheLock);
+    if (!_memoryCache.contains(key))
         return 0;
 
+    //Sharing the bytes lets us decode without the lock
+    const QByteArray encodedTile = *_memoryCache.object(key);
+
     //Figure out when the tile we're loading from cache was supposed to expire
-    QDateTime expireTime = this->getTileExpirationTime(cacheID);
+    QDateTime expireTime = this->getTileExpirationTime(key);
 
-    //If the cached tile is older than we would like, throw it out
+    //If the cached tile is older than we would like, keep it for revalidation and drop it unless it's wanted anyway
     if (QDateTime::currentDateTimeUtc().secsTo(expireTime) <= 0)
     {
-        if (!QFile::remove(path))
-            qWarning() << "Failed to remove old cache file" << path;
-        return 0;
+        this->toStaleCache(key, encodedTile, QDateTime());
+        if (expired == 0 || _expiredTilePolicy != StaleWhileRevalidate)
+        {
+            _memoryCache.remove(key);
+            return 0;
+        }
+        *expired = true;
     }
 
-    if (!fp.open(QFile::ReadOnly))
+    //Decode the cached tile for the caller
+    lock.unlock();
+    return decodeTile(encodedTile);
+}
+
+void MapTileSource::toMemCache(const MapTileKey &key, const QByteArray &encodedTile, const QDateTime &expireTime)
+{
+    if (encodedTile.isEmpty())
+        return;
+
+    QMutexLocker lock(&_memoryCacheLock);
+    if (_memoryCache.contains(key))
+        return;
+
+    //Note when the tile will expire
+    this->setTileExpirationTime(key, expireTime);
+
+    //Shares the bytes rather than copying them. Whatever doesn't fit any more (possibly this tile) is evicted
+    const int before = _memoryCache.count();
+    _memoryCache.insert(key, new QByteArray(encodedTile), encodedTile.size());
+    _statistics.evictions += before + 1 - _memoryCache.count();
+}
+
+QImage *MapTileSource::fromDiskCache(const MapTileKey &key, bool *expired)
+{
+    if (expired != 0)
+        *expired = false;
+
+    //A tile that's still waiting to be written is as good as on disk
+    if (_diskCacheWriter != 0)
     {
-        qWarning() << "Failed to open" << QFileInfo(fp.fileName()).baseName() << "from cache";
-        return 0;
+        const QByteArray pending = _diskCacheWriter->pending(key);
+        if (!pending.isNull())
+            return decodeTile(pending);
     }
 
-    QByteArray data;
-    quint64 counter = 0;
-    while (data.length() < fp.size())
+    if (this->cacheMode() == PackAndMemCaching)
+        return this->fromPackCache(key, expired);
+
+    //See if we've got it in the cache. Failing to open is how we find out it isn't, without asking first
+    const QString path = this->getDiskCacheFile(key.x(),key.y(),key.z());
+    QFile fp(path);
+    if (!fp.open(QFile::ReadOnly))
+        return 0;
+
+    //Figure out when the tile we're loading from cache was supposed to expire
+    QDateTime expireTime = this->getTileExpirationTime(key);
+
+    //If the cached tile is older than we would like, keep it for revalidation and drop it unless it's wanted anyway
+    const QByteArray encodedTile = fp.readAll();
+    if (QDateTime::currentDateTimeUtc().secsTo(expireTime) <= 0)
     {
-        data += fp.read(20480);
-        if (++counter >= MAX_DISK_CACHE_READ_ATTEMPTS)
+        QMutexLocker lock(&_memoryCacheLock);
+        this->toStaleCache(key, encodedTile, QFileInfo(fp).lastModified().toUTC());
+        const bool keep = (expired != 0 && _expiredTilePolicy == StaleWhileRevalidate);
+        lock.unlock();
+        fp.close();
+
+        if (keep)
         {
-            qWarning() << "Reading cache file" << fp.fileName() << "took too long. Aborting.";
-            return 0;
+            *expired = true;
+            return decodeTile(encodedTile);
         }
-    }
-
-    QImage * image = new QImage();
-    if (!image->loadFromData(data))
-    {
-        delete image;
+        if (!QFile::remove(path))
+            qWarning() << "Failed to remove old cache file" << path;
         return 0;
     }
 
-    return image;
+    return decodeTile(encodedTile);
 }
 
-void MapTileSource::toDiskCache(const QString &cacheID, QImage *toCache, const QDateTime &expireTime)
+void MapTileSource::toDiskCache(const MapTileKey &key, const QByteArray &encodedTile, const QDateTime &expireTime)
 {
-    //Figure out x,y,z based on the cacheID
-    quint32 x,y,z;
-    if (!MapTileSource::cacheID2xyz(cacheID,&x,&y,&z))
+    if (encodedTile.isEmpty())
         return;
 
-    //Find out where we'll be caching
-    const QString filePath = this->getDiskCacheFile(x,y,z);
-
-    //If we've already cached something, do not cache it again
-    QFile fp(filePath);
-    if (fp.exists())
+    MapTileDiskCacheWriter * writer = this->diskCacheWriter();
+    if (writer == 0)
         return;
 
-    //Note when the tile will expire
-    this->setTileExpirationTime(cacheID, expireTime);
-
-    //Auto-detect file format
-    const char * format = 0;
-
-    //No compression for lossy file types!
-    const int quality = 100;
+    //The pack stores each tile's expiration itself
+    if (this->cacheMode() == PackAndMemCaching)
+    {
+        QDateTime cacheUntil = expireTime;
+        if (cacheUntil.isNull())
+            cacheUntil = QDateTime::currentDateTimeUtc().addDays(DEFAULT_CACHE_DAYS);
+        writer->enqueue(key, QString(), encodedTile, cacheUntil);
+        return;
+    }
 
-    //Try to write the data
-    if (!toCache->save(filePath,format,quality))
-        qWarning() << "Failed to put" << this->name() << x << y << z << "into disk cache";
+    //Note when the tile will expire. The writer skips tiles that are already on disk
+    this->setTileExpirationTime(key, expireTime);
+    writer->enqueue(key, this->getDiskCacheFile(key.x(),key.y(),key.z()), encodedTile, expireTime);
 }
 
 void MapTileSource::prepareRetrievedTile(quint32 x, quint32 y, quint8 z, QImage *image)
 {
     //Do tile sanity check here optionally
     if (image == 0)
+    {
+        this->prepareFailedTile(x,y,z);
+        return;
+    }
+
+    //Generated tiles are converted here, in our thread, if they weren't made in the display format already
+    *image = toDisplayFormat(*image);
+
+    //Everyone who asked for direct delivery shares the one image
+    const MapTileKey key(x,y,z);
+    const int pickups = this->finishTileRequest(key, *image);
+    if (pickups == 0)
+    {
+        delete image;
+        this->tileRetrieved(x,y,z);
         return;
+    }
 
-    //Put it into the "temporary retrieval cache" so the user can grab it
+    /*
+      Put it into the "temporary retrieval cache" so the user can grab it, once for each request that will.
+      Requests from several clients (e.g. the composites of two views sharing this source) were fetched once
+      and each get the tile. Clients that haven't picked up an earlier copy yet get this one instead.
+    */
     QMutexLocker lock(&_tempCacheLock);
-    _tempCache.insert(MapTileSource::createCacheID(x,y,z),
-                      image);
+    if (!_tempCache.contains(key))
+        _tempCachePickups.remove(key);
+    _tempCachePickups[key] += pickups;
+    _tempCache.insert(key,
+                      image,
+                      image->byteCount());
     /*
       We must explicitly unlock the mutex before emitting tileRetrieved in case
       we're running in the GUI thread (since the signal can trigger
@@ -270,39 +856,244 @@ void MapTileSource::prepareRetrievedTile(quint32 x, quint32 y, quint8 z, QImage
 
 void MapTileSource::prepareNewlyReceivedTile(quint32 x, quint32 y, quint8 z, QImage *image, QDateTime expireTime)
 {
-    //Insert into caches when applicable
-    const QString cacheID = MapTileSource::createCacheID(x,y,z);
-    if (this->cacheMode() == DiskAndMemCaching)
+    if (this->cacheMode() == NoCaching || image == 0)
     {
-        this->toMemCache(cacheID, image, expireTime);
-        this->toDiskCache(cacheID, image, expireTime);
+        this->prepareRetrievedTile(x, y, z, image);
+        return;
     }
 
-    //Put the tile in a client-accessible place and notify them
+    //The client may take (and delete) the tile as soon as it's announced, so encode from a shallow copy
+    const QImage toEncode = *image;
+
+    //Put the tile in a client-accessible place and notify them before spending any time on caching
     this->prepareRetrievedTile(x, y, z, image);
+
+    //Generated tiles have to be encoded once so they can be cached like downloaded ones
+    QString format = this->tileFileExtension();
+    if (format.startsWith('.'))
+        format.remove(0, 1);
+
+    //No compression for lossy file types!
+    QByteArray encodedTile;
+    QBuffer buffer(&encodedTile);
+    buffer.open(QIODevice::WriteOnly);
+    if (!toEncode.save(&buffer, format.toLatin1().constData(), 100))
+    {
+        qWarning() << "Failed to encode" << this->name() << x << y << z << "for caching";
+        this->failRevalidation(MapTileKey(x,y,z));
+        return;
+    }
+
+    if (!this->finishRevalidation(MapTileKey(x,y,z), encodedTile, expireTime))
+        this->cacheEncodedTile(MapTileKey(x,y,z), encodedTile, expireTime);
+}
+
+void MapTileSource::prepareNewlyReceivedTile(quint32 x, quint32 y, quint8 z, const QByteArray &encodedTile,
+                                             QDateTime expireTime)
+{
+    PendingDecode pending;
+    pending.key = MapTileKey(x,y,z);
+    pending.encodedTile = encodedTile;
+    pending.expireTime = expireTime;
+
+    //handleTileDecoded() picks up from here in our thread
+    QFutureWatcher<QImage> * watcher = new QFutureWatcher<QImage>(this);
+    _pendingDecodes.insert(watcher, pending);
+    connect(watcher,
+            SIGNAL(finished()),
+            this,
+            SLOT(handleTileDecoded()));
+    watcher->setFuture(QtConcurrent::run(decodeTileImage, encodedTile));
+}
+
+//private slot
+void MapTileSource::handleTileDecoded()
+{
+    QFutureWatcher<QImage> * watcher = static_cast<QFutureWatcher<QImage> *>(QObject::sender());
+    if (!_pendingDecodes.contains(watcher))
+    {
+        qWarning() << "Unknown tile decode";
+        return;
+    }
+    watcher->deleteLater();
+
+    const PendingDecode pending = _pendingDecodes.take(watcher);
+    const quint32 x = pending.key.x();
+    const quint32 y = pending.key.y();
+    const quint8 z = pending.key.z();
+
+    const QImage decoded = watcher->result();
+    if (decoded.isNull())
+    {
+        qWarning() << "Failed to decode" << this->name() << x << y << z;
+        this->prepareFailedTile(x,y,z);
+        return;
+    }
+
+    //Put the tile in a client-accessible place and notify them before spending any time on caching
+    this->prepareRetrievedTile(x, y, z, new QImage(decoded));
+
+    if (this->cacheMode() != NoCaching
+            && !this->finishRevalidation(pending.key, pending.encodedTile, pending.expireTime))
+        this->cacheEncodedTile(pending.key, pending.encodedTile, pending.expireTime);
+}
+
+//private slot
+void MapTileSource::warmRequestedTiles()
+{
+    QMutexLocker lock(&_memoryCacheLock);
+    const QList<MapTileKey> keys = _tilesToWarm;
+    _tilesToWarm.clear();
+    lock.unlock();
+
+    if (this->cacheMode() == NoCaching)
+        return;
+
+    //Only the encoded bytes are read. Decoding waits until the tile is actually requested
+    foreach(const MapTileKey& key, keys)
+    {
+        lock.relock();
+        const bool cached = _memoryCache.contains(key);
+        lock.unlock();
+        if (cached)
+            continue;
+
+        QDateTime expireTime;
+        const QByteArray encodedTile = this->diskCacheBytes(key, &expireTime);
+        if (!encodedTile.isNull())
+            this->toMemCache(key, encodedTile, expireTime);
+    }
+}
+
+//private slot
+void MapTileSource::applyDiskCacheQuota()
+{
+    //A writer made later picks the quota up when it's made
+    if (_diskCacheWriter != 0)
+        _diskCacheWriter->setQuota(this->diskCacheQuota());
+}
+
+//private
+void MapTileSource::cacheEncodedTile(const MapTileKey &key, const QByteArray &encodedTile, const QDateTime &expireTime)
+{
+    this->toMemCache(key, encodedTile, expireTime);
+    this->toDiskCache(key, encodedTile, expireTime);
+}
+
+MapTileSource::CacheStatistics::CacheStatistics() :
+    memoryHits(0), diskHits(0), misses(0), staleHits(0), evictions(0),
+    memoryBytes(0), memoryTiles(0), memoryBudget(0), pendingBytes(0)
+{
+}
+
+qreal MapTileSource::CacheStatistics::hitRate() const
+{
+    const quint64 requests = memoryHits + diskHits + misses;
+    if (requests == 0)
+        return 0.0;
+    return (qreal)(memoryHits + diskHits) / (qreal)requests;
+}
+
+MapTileSource::CacheStatistics &MapTileSource::CacheStatistics::operator +=(const CacheStatistics &other)
+{
+    memoryHits += other.memoryHits;
+    diskHits += other.diskHits;
+    misses += other.misses;
+    staleHits += other.staleHits;
+    evictions += other.evictions;
+    memoryBytes += other.memoryBytes;
+    memoryTiles += other.memoryTiles;
+    memoryBudget += other.memoryBudget;
+    pendingBytes += other.pendingBytes;
+    return *this;
+}
+
+//protected
+void MapTileSource::prepareFailedTile(quint32 x, quint32 y, quint8 z)
+{
+    this->failRevalidation(MapTileKey(x,y,z));
+    this->finishTileRequest(MapTileKey(x,y,z), QImage());
+    this->tileRequestFailed(x,y,z);
+}
+
+//protected
+void MapTileSource::preparePartialTile(quint32 x, quint32 y, quint8 z, const QImage &tile)
+{
+    if (tile.isNull())
+        return;
+    const QImage displayTile = toDisplayFormat(tile);
+
+    //Under the lock for the same reason as in finishTileRequest()
+    QMutexLocker lock(&_requestLock);
+    const MapTileKey key(x,y,z);
+    if (!_inFlightRequests.contains(key))
+        return;
+
+    foreach(quint64 token, _inFlightRequests.value(key).tokens)
+    {
+        if (!_deliveries.contains(token))
+            continue;
+
+        const TileDelivery& delivery = _deliveries[token];
+        QMetaObject::invokeMethod(delivery.receiver,
+                                  delivery.member.constData(),
+                                  Qt::QueuedConnection,
+                                  Q_ARG(quint64, token),
+                                  Q_ARG(QImage, displayTile),
+                                  Q_ARG(bool, false));
+    }
 }
 
 //protected
-QDateTime MapTileSource::getTileExpirationTime(const QString &cacheID)
+void MapTileSource::cancelFetch(quint32 x, quint32 y, quint8 z)
+{
+    Q_UNUSED(x)
+    Q_UNUSED(y)
+    Q_UNUSED(z)
+}
+
+//protected
+MapTileSource::RequestPriority MapTileSource::fetchPriority(quint32 x, quint32 y, quint8 z)
+{
+    QMutexLocker lock(&_requestLock);
+    const MapTileKey key(x,y,z);
+    if (!_inFlightRequests.contains(key))
+        return VisiblePriority;
+    return _inFlightRequests.value(key).priority;
+}
+
+//protected
+QByteArray MapTileSource::staleTile(quint32 x, quint32 y, quint8 z, QDateTime *fetchedTime) const
+{
+    QMutexLocker lock(&_memoryCacheLock);
+    const StaleTile * stale = _staleTiles.object(MapTileKey(x,y,z));
+    if (stale == 0)
+        return QByteArray();
+
+    if (fetchedTime != 0)
+        *fetchedTime = stale->fetchedTime;
+    return stale->encodedTile;
+}
+
+//protected
+QDateTime MapTileSource::getTileExpirationTime(const MapTileKey &key)
 {
     //Make sure we've got our expiration database loaded
     this->loadCacheExpirationsFromDisk();
 
-    QDateTime expireTime;
-    if (_cacheExpirations.contains(cacheID))
-        expireTime = _cacheExpirations.value(cacheID);
-    else
+    QDateTime expireTime = _cacheExpirations->value(key);
+    if (expireTime.isNull())
     {
-        qWarning() << "Tile" << cacheID << "has unknown expire time. Resetting to default of" << DEFAULT_CACHE_DAYS << "days.";
+        qWarning() << "Tile" << key << "has unknown expire time. Resetting to default of" << DEFAULT_CACHE_DAYS << "days.";
         expireTime = QDateTime::currentDateTimeUtc().addDays(DEFAULT_CACHE_DAYS);
-        _cacheExpirations.insert(cacheID,expireTime);
+        _cacheExpirations->insert(key,expireTime);
     }
 
     return expireTime;
 }
 
 //protected
-void MapTileSource::setTileExpirationTime(const QString &cacheID, QDateTime expireTime)
+void MapTileSource::setTileExpirationTime(const MapTileKey &key, QDateTime expireTime)
 {
     //Make sure we've got our expiration database loaded
     this->loadCacheExpirationsFromDisk();
@@ -313,28 +1104,187 @@ void MapTileSource::setTileExpirationTime(const QString &cacheID, QDateTime expi
         expireTime = QDateTime::currentDateTimeUtc().addDays(DEFAULT_CACHE_DAYS);
     }
 
-    _cacheExpirations.insert(cacheID, expireTime);
+    _cacheExpirations->insert(key, expireTime);
+}
+
+QString MapTileSource::diskCachePath() const
+{
+    return QDir::homePath() % "/" % MAPGRAPHICS_CACHE_FOLDER_NAME % "/" % this->name();
+}
+
+qint64 MapTileSource::diskCacheQuota() const
+{
+    QMutexLocker lock(&_memoryCacheLock);
+    return _diskCacheQuota;
+}
+
+void MapTileSource::setDiskCacheQuota(qint64 bytes)
+{
+    QMutexLocker lock(&_memoryCacheLock);
+    _diskCacheQuota = qMax<qint64>(0, bytes);
+    lock.unlock();
+
+    //The writer is only reached from our own thread
+    this->diskCacheQuotaChanged();
 }
 
 //private
 QDir MapTileSource::getDiskCacheDirectory(quint32 x, quint32 y, quint8 z) const
 {
     Q_UNUSED(y)
-    QString pathString = QDir::homePath() % "/" % MAPGRAPHICS_CACHE_FOLDER_NAME % "/" % this->name() % "/" % QString::number(z) % "/" % QString::number(x);
-    QDir toRet = QDir(pathString);
-    if (!toRet.exists())
+    MapTileCacheDirectory * directory = this->cacheDirectory();
+    directory->ensureColumn(x, z);
+    return QDir(directory->columnPath(x, z));
+}
+
+//private
+QString MapTileSource::getDiskCacheFile(quint32 x, quint32 y, quint8 z) const
+{
+    //Just the path. The disk cache writer creates the directory when it writes the first tile into it
+    return this->cacheDirectory()->tilePath(x, y, z);
+}
+
+//private
+MapTileCacheDirectory *MapTileSource::cacheDirectory() const
+{
+    //name() is pure-virtual, so this can't happen in our constructor
+    if (_cacheDirectory.isNull())
+        _cacheDirectory.setRoot(this->diskCachePath(), this->tileFileExtension());
+    return &_cacheDirectory;
+}
+
+//private
+MapTilePackCache *MapTileSource::packCache()
+{
+    if (_packCache != 0 || _packCacheFailed)
+        return _packCache;
+
+    QString error;
+    _packCache = new MapTilePackCache();
+    if (!_packCache->open(this->cacheDirectory()->root(), &error))
     {
-        if (!toRet.mkpath(toRet.absolutePath()))
-            qWarning() << "Failed to create cache directory" << toRet.absolutePath();
+        qWarning() << "Failed to open tile pack for" << this->name() << ":" << error;
+        delete _packCache;
+        _packCache = 0;
+
+        //Don't keep trying on every tile
+        _packCacheFailed = true;
     }
-    return toRet;
+    return _packCache;
 }
 
 //private
-QString MapTileSource::getDiskCacheFile(quint32 x, quint32 y, quint8 z) const
+QImage *MapTileSource::fromPackCache(const MapTileKey &key, bool *expired)
 {
-    QString toRet = this->getDiskCacheDirectory(x,y,z).absolutePath() % "/" % QString::number(y) % "." % this->tileFileExtension();
-    return toRet;
+    MapTilePackCache * pack = this->packCache();
+    if (pack == 0)
+        return 0;
+
+    //The writer appends to the pack from its own thread, and the bytes we get point into the pack's mapping
+    QMutexLocker lock(&_packCacheLock);
+
+    //The pack stores each tile's expiration itself, so there's no need for the expiration store here
+    QDateTime expireTime;
+    const QByteArray bytes = pack->value(key, &expireTime);
+    if (bytes.isNull())
+        return 0;
+
+    if (!expireTime.isNull() && QDateTime::currentDateTimeUtc().secsTo(expireTime) <= 0)
+    {
+        //The bytes point into the pack, so the stale copy needs a real one. The pack doesn't know when it was fetched
+        QMutexLocker staleLock(&_memoryCacheLock);
+        this->toStaleCache(key, QByteArray(bytes.constData(), bytes.size()), QDateTime());
+        const bool keep = (expired != 0 && _expiredTilePolicy == StaleWhileRevalidate);
+        staleLock.unlock();
+
+        if (!keep)
+        {
+            pack->remove(key);
+            return 0;
+        }
+        *expired = true;
+    }
+
+    QImage * image = decodeTile(bytes);
+    if (image == 0)
+        pack->remove(key);
+    return image;
+}
+
+//private
+QByteArray MapTileSource::diskCacheBytes(const MapTileKey &key, QDateTime *expireTime)
+{
+    if (_diskCacheWriter != 0)
+    {
+        const QByteArray pending = _diskCacheWriter->pending(key);
+        if (!pending.isNull())
+        {
+            *expireTime = this->getTileExpirationTime(key);
+            return pending;
+        }
+    }
+
+    if (this->cacheMode() == PackAndMemCaching)
+    {
+        MapTilePackCache * pack = this->packCache();
+        if (pack == 0)
+            return QByteArray();
+
+        QMutexLocker lock(&_packCacheLock);
+        const QByteArray bytes = pack->value(key, expireTime);
+        if (bytes.isNull() || (!expireTime->isNull() && QDateTime::currentDateTimeUtc().secsTo(*expireTime) <= 0))
+            return QByteArray();
+
+        //The bytes point into the pack's mapping, which may move once we let go of the lock
+        return QByteArray(bytes.constData(), bytes.size());
+    }
+
+    QFile fp(this->getDiskCacheFile(key.x(),key.y(),key.z()));
+    if (!fp.open(QFile::ReadOnly))
+        return QByteArray();
+
+    *expireTime = this->getTileExpirationTime(key);
+    if (QDateTime::currentDateTimeUtc().secsTo(*expireTime) <= 0)
+        return QByteArray();
+    return fp.readAll();
+}
+
+//private
+void MapTileSource::toStaleCache(const MapTileKey &key, const QByteArray &encodedTile, const QDateTime &fetchedTime)
+{
+    //Nothing to revalidate
+    if (encodedTile.isEmpty())
+        return;
+
+    StaleTile * stale = new StaleTile();
+    stale->encodedTile = encodedTile;
+    stale->fetchedTime = fetchedTime;
+    _staleTiles.insert(key, stale, encodedTile.size());
+}
+
+//private
+MapTileDiskCacheWriter *MapTileSource::diskCacheWriter()
+{
+    if (_diskCacheWriter != 0)
+        return _diskCacheWriter;
+
+    //Whether it writes files or a pack is decided now, by the cache mode at the time of the first write
+    MapTilePackCache * pack = 0;
+    if (this->cacheMode() == PackAndMemCaching)
+    {
+        pack = this->packCache();
+        if (pack == 0)
+            return 0;
+    }
+
+    _diskCacheWriter = new MapTileDiskCacheWriter();
+    if (pack != 0)
+        _diskCacheWriter->setPackCache(pack, &_packCacheLock);
+    else
+        _diskCacheWriter->setCacheDirectory(this->cacheDirectory());
+    _diskCacheWriter->setQuota(this->diskCacheQuota());
+    _diskCacheWriter->start();
+    return _diskCacheWriter;
 }
 
 //private
@@ -345,39 +1295,39 @@ void MapTileSource::loadCacheExpirationsFromDisk()
 
     //If we try to do this and succeed or even fail, don't try again
     _cacheExpirationsLoaded = true;
+    _cacheExpirations = new MapTileExpirationStore();
 
     QDir dir = this->getDiskCacheDirectory(0,0,0);
-    QString path = dir.absolutePath() % "/" % "cacheExpirations.db";
-    _cacheExpirationsFile = path;
+    const QString path = dir.absolutePath() % "/" % "cacheExpirations.log";
+    const QString legacyPath = dir.absolutePath() % "/" % "cacheExpirations.db";
 
-    QFile fp(path);
-    if (!fp.exists())
-        return;
-
-    if (!fp.open(QIODevice::ReadOnly))
+    QString error;
+    if (!_cacheExpirations->open(path, &error))
     {
-        qWarning() << "Failed to open cache expiration file for reading:" << fp.errorString();
+        //We'll still remember expirations for as long as we're running
+        qWarning() << "Failed to open cache expiration log:" << error;
         return;
     }
 
-    QDataStream stream(&fp);
-    stream >> _cacheExpirations;
+    //Bring over what older versions saved, then retire their file
+    if (QFile::exists(legacyPath))
+    {
+        if (_cacheExpirations->importLegacy(legacyPath) && _cacheExpirations->flush(&error))
+            QFile::remove(legacyPath);
+        else
+            qWarning() << "Failed to import cache expirations from" << legacyPath;
+    }
 }
 
+//private slot
 void MapTileSource::saveCacheExpirationsToDisk()
 {
-    if (!_cacheExpirationsLoaded || _cacheExpirationsFile.isEmpty())
+    if (_cacheExpirations == 0
+            || !_cacheExpirations->isOpen()
+            || !_cacheExpirations->hasUnflushedChanges())
         return;
 
-    QFile fp(_cacheExpirationsFile);
-
-    if (!fp.open(QIODevice::Truncate | QIODevice::WriteOnly))
-    {
-        qWarning() << "Failed to open cache expiration file for writing:" << fp.errorString();
-        return;
-    }
-
-    QDataStream stream(&fp);
-    stream << _cacheExpirations;
-    qDebug() << "Cache expirations saved to" << _cacheExpirationsFile;
+    QString error;
+    if (!_cacheExpirations->flush(&error))
+        qWarning() << "Failed to save cache expirations:" << error;
 }
@@ -4,6 +4,7 @@
 #include <QObject>
 #include <QPoint>
 #include <QPointF>
+#include <QRectF>
 #include <QImage>
 #include <QCache>
 #include <QMutex>
@@ -11,8 +12,18 @@
 #include <QDir>
 #include <QFile>
 #include <QHash>
+#include <QQueue>
+#include <QSet>
+#include <QFutureWatcher>
 
 #include "MapGraphics_global.h"
+#include "MapTileKey.h"
+#include "guts/MapTileCacheDirectory.h"
+
+class MapTilePackCache;
+class MapTileDiskCacheWriter;
+class MapTileExpirationStore;
+class QTimer;
 
 class MAPGRAPHICSSHARED_EXPORT MapTileSource : public QObject
 {
@@ -20,13 +31,71 @@ class MAPGRAPHICSSHARED_EXPORT MapTileSource : public QObject
 public:
     /**
      * @brief Enum used to describe how a MapTileSource should cache tiles, if at all. NoCaching does not
-     * cache tiles at all. DiskAndMemCaching caches tiles on disk and in RAM
+     * cache tiles at all. DiskAndMemCaching caches tiles on disk (one file per tile) and in RAM.
+     * PackAndMemCaching caches tiles in RAM and in a single pack file on disk (see MapTilePackCache), which
+     * suits caches of millions of tiles better.
      *
      */
     enum CacheMode
     {
         NoCaching,
-        DiskAndMemCaching
+        DiskAndMemCaching,
+        PackAndMemCaching
+    };
+
+    /**
+     * @brief Priority of a tile request. Queued requests are started highest priority first, and in the order
+     * they were made within a priority.
+     */
+    enum RequestPriority
+    {
+        PrefetchPriority = 0,
+        VisiblePriority = 1
+    };
+
+    /**
+     * @brief What to do with a cached tile that has expired. RefetchExpiredTiles throws it out and fetches the
+     * tile again, leaving a blank until it arrives (or for good, offline). StaleWhileRevalidate hands out the
+     * expired tile straight away and revalidates it in the background once there's nothing more urgent to fetch:
+     * if the tile turns out to have changed it's replaced in the caches and tilesInvalidated() is emitted for
+     * it, otherwise only its expiration is pushed back. A tile whose revalidation fails stays cached as it is.
+     */
+    enum ExpiredTilePolicy
+    {
+        RefetchExpiredTiles,
+        StaleWhileRevalidate
+    };
+
+    /**
+     * @brief Counters and sizes describing how well a MapTileSource's caches are doing. Hits and misses are
+     * only counted for sources that cache.
+     */
+    struct MAPGRAPHICSSHARED_EXPORT CacheStatistics
+    {
+        CacheStatistics();
+
+        //Fraction of tile requests answered from the memory or disk cache, or 0.0 if there were none
+        qreal hitRate() const;
+
+        //Adds all of other's counters and sizes to ours
+        CacheStatistics& operator +=(const CacheStatistics& other);
+
+        quint64 memoryHits;
+        quint64 diskHits;
+        quint64 misses;
+
+        //Hits on expired tiles that were handed out while they're revalidated. Also counted as hits above
+        quint64 staleHits;
+
+        //Tiles pushed out of the memory cache to stay within the budget
+        quint64 evictions;
+
+        qint64 memoryBytes;
+        int memoryTiles;
+        qint64 memoryBudget;
+
+        //Decoded tiles waiting for clients to call getFinishedTile()
+        qint64 pendingBytes;
     };
 
 public:
@@ -38,16 +107,87 @@ public:
      * A tileRetrieved signal will be emitted when the tile is available, at which point it can be
      * retrieved using getFinishedTile()
      *
+     * Requests wait in a queue until fewer than maxConcurrentRequests() are being fetched. Requests for a tile
+     * that is already queued or being fetched share that request, which takes the highest priority asked for.
+     *
+     * @param x
+     * @param y
+     * @param z
+     * @param priority
+     * @return quint64 a token that can be passed to cancelTileRequest()
+     */
+    quint64 requestTile(quint32 x, quint32 y, quint8 z, RequestPriority priority = VisiblePriority);
+
+    /**
+     * @brief Same as above, but the tile is handed straight to receiver instead of waiting in
+     * getFinishedTile(). member is the name of a slot of receiver taking (quint64 token, QImage tile,
+     * bool finished), which is called in receiver's thread with the request's token and the tile, or a null
+     * QImage if the tile couldn't be retrieved. Sources that build tiles in stages (e.g. a progressive
+     * CompositeTileSource) may call it with finished=false first, once per stage. tileRetrieved is still
+     * emitted for anyone else listening.
+     *
+     * Tiles are delivered as Format_ARGB32_Premultiplied, or Format_RGB32 if they're opaque, so that the
+     * receiver can turn them into QPixmaps without converting them.
+     *
+     * The receiver must cancelTileRequest() any request it's still waiting on before it's destroyed.
+     *
      * @param x
      * @param y
      * @param z
+     * @param priority
+     * @param receiver
+     * @param member e.g. "handleTileDelivered"
+     * @return quint64 a token that can be passed to cancelTileRequest()
+     */
+    quint64 requestTile(quint32 x, quint32 y, quint8 z, RequestPriority priority,
+                        QObject * receiver, const char * member);
+
+    /**
+     * @brief Withdraws a request made with requestTile(). Once every request for a tile has been withdrawn
+     * the tile is dropped from the queue, or its fetch is cancelled if it had already started. Tokens of
+     * requests that have already finished are ignored.
+     *
+     * @param token
+     */
+    void cancelTileRequest(quint64 token);
+
+    /**
+     * @brief Returns how many tiles may be fetched at once. Zero means there is no limit.
+     */
+    int maxConcurrentRequests() const;
+    void setMaxConcurrentRequests(int maxRequests);
+
+    /**
+     * @brief Returns how many bytes of encoded tiles the memory cache may hold. A CompositeTileSource shares
+     * its budget among its children.
+     */
+    int memoryCacheBudget() const;
+    virtual void setMemoryCacheBudget(int bytes);
+
+    /**
+     * @brief Returns current cache statistics. A CompositeTileSource includes its children's.
      */
-    void requestTile(quint32 x, quint32 y, quint8 z);
+    virtual MapTileSource::CacheStatistics cacheStatistics() const;
+    virtual void resetCacheStatistics();
+
+    /**
+     * @brief Loads the tiles from the disk cache into the memory cache, in the tile source's own thread, so
+     * that requesting them later skips the disk. Tiles that aren't on disk (or have expired) are skipped; nothing
+     * is fetched. Requests made after this call find the tiles warmed, since they're processed in the same
+     * thread afterwards. A CompositeTileSource warms its children. Safe to call from any thread.
+     *
+     * @param keys e.g. the tiles that were on screen when the application last quit
+     */
+    virtual void warmMemoryCache(const QList<MapTileKey>& keys);
 
     /**
      * @brief Retrieves a pointer to a retrieved image tile. You must call requestTile and wait for the
      * tileRetrieved signal before calling this method. Returns a QImage pointer on success, null on failure.
      * The caller takes ownership of the QImage pointer - i.e., the caller is responsible for deleting it.
+     * Each request made without a receiver may pick the tile up once, so several clients sharing the source
+     * each get it from the one fetch. Don't pick up tiles you didn't request (or have cancelled): that takes
+     * another client's copy.
+     * Like delivered tiles, it's in the format QPixmaps use on the screen.
      *
      * @param x
      * @param y
@@ -60,6 +200,38 @@ public:
 
     void setCacheMode(MapTileSource::CacheMode);
 
+    /**
+     * @brief Returns what happens to cached tiles that have expired. Defaults to StaleWhileRevalidate.
+     */
+    MapTileSource::ExpiredTilePolicy expiredTilePolicy() const;
+    void setExpiredTilePolicy(MapTileSource::ExpiredTilePolicy policy);
+
+    /**
+     * @brief Returns the directory that the source caches tiles in on disk (files or pack, depending on the
+     * cache mode). It's named after name(), so sources with the same name share it.
+     */
+    QString diskCachePath() const;
+
+    /**
+     * @brief Returns how many bytes the disk cache may take up, or 0 if it may grow without bound. Once it grows
+     * past the quota, the tiles that were used longest ago are deleted in the background until it's back under
+     * 90% of it (see MapTileDiskCacheWriter). Sources with the same name share a disk cache, so they should
+     * share a quota too. Defaults to 2 GB.
+     */
+    qint64 diskCacheQuota() const;
+    void setDiskCacheQuota(qint64 bytes);
+
+    /**
+     * @brief Returns the (lon,lat) rectangle that the tile (x,y) at zoom level z covers, worked out with
+     * qgs2ll(). Its top is its southern edge.
+     *
+     * @param x
+     * @param y
+     * @param z
+     * @return QRectF
+     */
+    QRectF tileGeoRect(quint32 x, quint32 y, quint8 z) const;
+
     /**
      * @brief Converst from geo (lat,lon) coordinates into QGraphicsScene coordinates. A MapTileSource
      * implementation has to implement this method.
@@ -80,6 +252,25 @@ public:
      */
     virtual QPointF qgs2ll(const QPointF& qgs, quint8 zoomLevel) const=0;
 
+    /**
+     * @brief Converts count points from geo (lon,lat) coordinates into QGraphicsScene coordinates, the same as
+     * ll2qgs() does one at a time. Use it when positioning many things at once. The default calls ll2qgs() for
+     * each point; sources whose projection has a closed form (see WebMercator) do the whole span in tight loops
+     * with the zoom level's constants worked out once.
+     *
+     * @param ll the points to convert
+     * @param qgs where to put the converted points. May be ll.
+     * @param count
+     * @param zoomLevel
+     */
+    virtual void ll2qgsBatch(const QPointF * ll, QPointF * qgs, int count, quint8 zoomLevel) const;
+
+    /**
+     * @brief The reverse of ll2qgsBatch(), i.e. qgs2ll() for count points at once. qgs and ll may be the same
+     * array.
+     */
+    virtual void qgs2llBatch(const QPointF * qgs, QPointF * ll, int count, quint8 zoomLevel) const;
+
     /**
      * @brief Pure-virtual method that returns the number of tiles on a given zoom level.
      *
@@ -150,83 +341,104 @@ signals:
      */
     void tileRequested(quint32 x, quint32 y, quint8 z);
 
+    /**
+     * @brief Signal emitted when a tile that was requested could not be retrieved
+     *
+     * @param x
+     * @param y
+     * @param z
+     */
+    void tileRequestFailed(quint32 x, quint32 y, quint8 z);
+
+    /*!
+     \brief Used internally to get the request queue processed in the tile source's own thread.
+    */
+    void requestQueueChanged();
+
+    /*!
+     \brief Used internally to get tiles warmed (see warmMemoryCache()) in the tile source's own thread.
+    */
+    void memoryCacheWarmingRequested();
+
+    /*!
+     \brief Used internally to hand a new disk cache quota to the writer in the tile source's own thread.
+    */
+    void diskCacheQuotaChanged();
+
     /*!
      \brief Emitted when vital parameters of the tile source have changed and anyone displaying the tiles should
       refresh.
 
     */
     void allTilesInvalidated();
+
+    /**
+     * @brief Emitted when only the tiles covering part of the map have changed, so that anyone displaying
+     * them can refresh just those. A source that caches tiles has to drop the ones in the rectangle itself
+     * before emitting this.
+     *
+     * @param geoRect the (lon,lat) rectangle that changed, as from tileGeoRect()
+     */
+    void tilesInvalidated(const QRectF& geoRect);
     
 public slots:
 
 private slots:
-    void startTileRequest(quint32 x, quint32 y, quint8 z);
+    void processRequestQueue();
     void clearTempCache();
+    void restartInFlightRequests();
+    void saveCacheExpirationsToDisk();
+    void handleTileDecoded();
+    void warmRequestedTiles();
+    void applyDiskCacheQuota();
 
 protected:
     /**
-     * @brief This static method takes the x,y,z of a tile and creates a unique string that is used
-     * as a key in the caches to keep track of the tile.
-     *
-     * @param x x-coordinate of the tile
-     * @param y y-coordinate of the tile
-     * @param z zoom-level of the tile
-     * @return QString unique cacheID
-     */
-    static QString createCacheID(quint32 x, quint32 y, quint8 z);
-
-    /**
-     * @brief This static convenience method takes a cacheID and places the numberical x,y,z values that
-     * generated the cacheID into the variables pointed to by x,y,z. Returns true on success, false on failure.
-     *
-     * @param string the cacheID you are converting
-     * @param x where you want the x value
-     * @param y where you want the y value
-     * @param z where you want the z value
-     * @return bool
-     */
-    static bool cacheID2xyz(const QString & string, quint32 * x, quint32 * y, quint32 * z);
-
-    /**
-     * @brief Given a cacheID, retrieve the tile with that cacheID from memcache. Returns a pointer
+     * @brief Given a tile's key, retrieve the tile from memcache. Returns a pointer
      * to a QImage on success, null on failure. Caller takes responsibility for deleting the returned
-     * QImage
+     * QImage. The memory cache holds encoded tiles, so this is where the tile gets decoded.
+     *
+     * If the tile has expired it's dropped and null is returned, unless expired is given and the policy is
+     * StaleWhileRevalidate, in which case the tile is kept and returned with expired set to true.
      *
-     * @param cacheID cacheID of the tile you want to get from cache
+     * @param key key of the tile you want to get from cache
+     * @param expired set to whether the returned tile has expired
      * @return QImage
      */
-    QImage * fromMemCache(const QString& cacheID);
+    QImage * fromMemCache(const MapTileKey& key, bool * expired = 0);
 
     /**
-     * @brief Given a cacheID and a pointer to a QImage, inserts the QImage pointed to by the pointer into
-     * the memory cache using cacheID as the key
+     * @brief Given a tile's key and its encoded (png, jpg, etc.) bytes, inserts the bytes into the memory
+     * cache. The bytes are implicitly shared, not copied.
      *
-     * @param cacheID
-     * @param toCache
+     * @param key
+     * @param encodedTile
      */
-    void toMemCache(const QString& cacheID, QImage * toCache, const QDateTime &expireTime = QDateTime());
+    void toMemCache(const MapTileKey& key, const QByteArray& encodedTile, const QDateTime &expireTime = QDateTime());
 
     /**
-     * @brief Given a cacheID, retrieve the tile with that cacheID from the disk cache. Returns a
+     * @brief Given a tile's key, retrieve the tile from the disk cache. Returns a
      * pointer to a QImage on success, null on failure. Caller takes responsibility for deleting the
-     * returned QImage
+     * returned QImage. Expired tiles are treated as by fromMemCache().
      *
-     * @param cacheID cacheID of the tile you want to get from cache
+     * @param key key of the tile you want to get from cache
+     * @param expired set to whether the returned tile has expired
      * @return QImage
      */
-    QImage * fromDiskCache(const QString& cacheID);
+    QImage * fromDiskCache(const MapTileKey& key, bool * expired = 0);
 
     /**
-     * @brief Given a cacheID and a pointer to a QImage, inserts the QImage pointed to by the pointer into
-     * the disk cache using cacheID as the key.
-     * Optionally, takes a QDateTime object that specifies the time that the QImage should be kept cached 
+     * @brief Given a tile's key and its encoded (png, jpg, etc.) bytes, queues the bytes to be written to
+     * the disk cache as they are. The write happens in a background thread; until then fromDiskCache()
+     * finds the tile in the queue.
+     * Optionally, takes a QDateTime object that specifies the time that the tile should be kept cached
      * until. Defaults to 7 days.
      *
-     * @param cacheID
-     * @param toCache
+     * @param key
+     * @param encodedTile
      * @param cacheUntil
      */
-    void toDiskCache(const QString& cacheID, QImage * toCache, const QDateTime &expireTime = QDateTime());
+    void toDiskCache(const MapTileKey& key, const QByteArray& encodedTile, const QDateTime &expireTime = QDateTime());
 
     /**
      * @brief Fetches (from MapQuest or OSM or whatever) or generates the tile if it isn't cached.
@@ -245,28 +457,139 @@ protected:
     //Call only for tiles which were newly-generated or newly-acquired from the network (i.e., not cached)
     void prepareNewlyReceivedTile(quint32 x, quint32 y, quint8 z, QImage * image, QDateTime expireTime = QDateTime());
 
+    /*
+      Same as above for tiles that arrive encoded (e.g., a png from the network). The bytes are cached as they
+      are and only decoded once, for the client. Decoding happens in the global QThreadPool so that a screenful
+      of tiles arriving at once is decoded in parallel; the tile is delivered from our thread when it's done.
+      Fails the tile if the bytes can't be decoded.
+    */
+    void prepareNewlyReceivedTile(quint32 x, quint32 y, quint8 z, const QByteArray& encodedTile,
+                                  QDateTime expireTime = QDateTime());
+
+    //Call when fetchTile() gives up on a tile so that its request stops counting against the concurrency limit
+    void prepareFailedTile(quint32 x, quint32 y, quint8 z);
+
+    /*
+      Hands an incomplete version of a tile that's still being fetched to the requests that have a receiver,
+      without finishing the request. Requests that pick their tiles up with getFinishedTile() only get the
+      finished tile.
+    */
+    void preparePartialTile(quint32 x, quint32 y, quint8 z, const QImage& tile);
+
+    /**
+     * @brief Called (in the tile source's thread) when every request for a tile whose fetch has already
+     * started has been cancelled. Implementations can abort the fetch here. The default does nothing, and a
+     * fetch that goes on to finish is still delivered and cached as usual.
+     */
+    virtual void cancelFetch(quint32 x, quint32 y, quint8 z);
+
+    /**
+     * @brief Returns the priority of the request for a tile that is being fetched, so that implementations
+     * which request tiles from other sources can pass it along.
+     */
+    MapTileSource::RequestPriority fetchPriority(quint32 x, quint32 y, quint8 z);
+
+    /**
+     * @brief Returns the encoded bytes of an expired cached copy of the tile, or a null QByteArray if we
+     * don't have one. fetchTile() can use it to revalidate the tile with its server (e.g. If-Modified-Since)
+     * and pass it to prepareNewlyReceivedTile() if it's still good, instead of downloading it again.
+     * fetchedTime is set to when the copy was cached, or to a null QDateTime if that isn't known.
+     * The copy is forgotten once the tile's request finishes.
+     */
+    QByteArray staleTile(quint32 x, quint32 y, quint8 z, QDateTime * fetchedTime = 0) const;
+
     /**
      * @brief Returns the time when the tile is supposed to expire from any caches.
      * This should only be called on tiles which are actually cached!
-     * @param cacheID The cacheID of the tile
+     * @param key The key of the tile
      * @return QDateTime of the tile's expiration (time after which it should be re-requested or regenerated)
      */
-    QDateTime getTileExpirationTime(const QString& cacheID);
+    QDateTime getTileExpirationTime(const MapTileKey& key);
 
     /**
      * @brief Sets the time when the tile is supposed to expire from any caches
-     * @param cacheID of the tile
+     * @param key of the tile
      * @param QDateTime of the tile's expiration (time after which it should be re-requested or regenerated)
      */
-    void setTileExpirationTime(const QString& cacheID, QDateTime expireTime);
+    void setTileExpirationTime(const MapTileKey& key, QDateTime expireTime);
 
 private:
+    /*
+     * Everything we know about a tile that's been asked for: where it is, the highest priority it was
+     * requested at and the tokens of the requests that still want it
+    */
+    struct TileRequest
+    {
+        MapTileKey key;
+        MapTileSource::RequestPriority priority;
+        QSet<quint64> tokens;
+    };
+
+    //Where to hand the tile of a request made with a receiver
+    struct TileDelivery
+    {
+        QObject * receiver;
+        QByteArray member;
+    };
+
+    void startTileRequest(quint32 x, quint32 y, quint8 z);
+
+    //Queues a background revalidation of an expired tile that was just handed out, unless one is already due
+    void queueRevalidation(const MapTileKey& key);
+
+    //Moves the next queued revalidation to _inFlightRequests if there's room for it. Call with _requestLock held
+    bool takeNextRevalidation(MapTileKey * key);
+
+    /*
+      Called with the tile a fetch came back with. If the fetch was a revalidation, replaces the cached tile if
+      it has changed (and announces that it has) or just refreshes its expiration, and returns true. Returns
+      false for ordinary fetches, whose tiles the caller caches as usual.
+    */
+    bool finishRevalidation(const MapTileKey& key, const QByteArray& encodedTile, const QDateTime& expireTime);
+
+    //Called when a fetch fails. A failed revalidation leaves the expired tile cached and holds off the others
+    void failRevalidation(const MapTileKey& key);
+
+    //Moves the highest-priority queued request to _inFlightRequests. Call with _requestLock held
+    bool takeNextRequest(TileRequest * request);
+
+    //Drops queue entries that no longer refer to a queued request. Call with _requestLock held
+    void compactQueues();
+
+    /*
+      Forgets the request for a fetch that has finished (or failed, with a null tile) and lets the next one
+      start. Hands the tile to the requests that have a receiver. Returns how many of the others still need
+      to pick it up with getFinishedTile()
+    */
+    int finishTileRequest(const MapTileKey& key, const QImage& tile);
+
     /**
      * @brief prepareRetrievedTile prepares a generated/retrieve tile for retrieval by the client
      * and notifies the client that the tile is ready.
      */
     void prepareRetrievedTile(quint32 x, quint32 y, quint8 z, QImage * image);
 
+    //An expired tile kept for revalidation and when it was cached
+    struct StaleTile
+    {
+        QByteArray encodedTile;
+        QDateTime fetchedTime;
+    };
+
+    //Keeps an expired tile around until its fetch finishes. Call with _memoryCacheLock held
+    void toStaleCache(const MapTileKey& key, const QByteArray& encodedTile, const QDateTime& fetchedTime);
+
+    //What to do with a tile once the thread pool has decoded it
+    struct PendingDecode
+    {
+        MapTileKey key;
+        QByteArray encodedTile;
+        QDateTime expireTime;
+    };
+
+    //Puts an encoded tile in the memory and disk caches
+    void cacheEncodedTile(const MapTileKey& key, const QByteArray& encodedTile, const QDateTime& expireTime);
+
     /**
      * @brief Given the x,y, and z of a tile, returns the directory where it should be cached on disk
      *
@@ -288,32 +611,108 @@ private:
      */
     QString getDiskCacheFile(quint32 x, quint32 y, quint8 z) const;
 
+    /**
+     * @brief Returns the layout of our file disk cache, setting it up the first time
+     */
+    MapTileCacheDirectory * cacheDirectory() const;
+
+    /**
+     * @brief Returns our pack file cache, opening it the first time. Returns null if it can't be opened.
+     */
+    MapTilePackCache * packCache();
+
+    QImage * fromPackCache(const MapTileKey& key, bool * expired);
+
+    /**
+     * @brief Returns the encoded bytes of the tile in the disk cache and when it expires, or a null QByteArray if
+     * it isn't there or has expired. Unlike fromDiskCache() it neither decodes the tile nor cleans up expired ones.
+     */
+    QByteArray diskCacheBytes(const MapTileKey& key, QDateTime * expireTime);
+
+    /**
+     * @brief Returns the writer that does our disk cache writes, creating and starting it the first time.
+     * Returns null if there's nowhere to write to.
+     */
+    MapTileDiskCacheWriter * diskCacheWriter();
+
     /*!
      \brief Loads cache expiration times from disk if necessary
     */
     void loadCacheExpirationsFromDisk();
 
-    void saveCacheExpirationsToDisk();
-
     bool _cacheExpirationsLoaded;
 
     /*
-      loadCacheExpirationsFromDisk() stores the place where it loaded from here.
-      When we're destructing and need to serialize out we can use this instead of
-      foolishly trying to call a pure-virtual method (name()) from the destructor
+      The store remembers where it was loaded from, so when we're destructing we can save to it
+      instead of foolishly trying to call a pure-virtual method (name()) from the destructor.
+      Changes are saved periodically by _cacheExpirationsTimer rather than only on destruction.
     */
-    QString _cacheExpirationsFile;
+    MapTileExpirationStore * _cacheExpirations;
+    QTimer * _cacheExpirationsTimer;
 
     MapTileSource::CacheMode _cacheMode;
+    MapTileSource::ExpiredTilePolicy _expiredTilePolicy;
+
+    //Opened lazily since it's named after name(), which we can't call from our constructor
+    MapTilePackCache * _packCache;
+    bool _packCacheFailed;
+
+    //Likewise set up lazily. It remembers which directories exist so we don't ask the disk for every tile
+    mutable MapTileCacheDirectory _cacheDirectory;
 
-    //Temporary cache for QImage tiles waiting for the client to take them
-    QCache<QString, QImage> _tempCache;
-    QMutex _tempCacheLock;
+    //Held by whoever is using _packCache, since _diskCacheWriter writes to it from another thread
+    QMutex _packCacheLock;
+    MapTileDiskCacheWriter * _diskCacheWriter;
 
-    //The "real" cache, where tiles are saved in memory so we don't download them again
-    QCache<QString, QImage> _memoryCache;
+    //Temporary cache for QImage tiles waiting for the client to take them, and how many pickups each is waiting for
+    QCache<MapTileKey, QImage> _tempCache;
+    QHash<MapTileKey, int> _tempCachePickups;
+    mutable QMutex _tempCacheLock;
 
-    QHash<QString, QDateTime> _cacheExpirations;
+    //The "real" cache, where encoded tiles are saved in memory so we don't download them again. Cost is in bytes
+    QCache<MapTileKey, QByteArray> _memoryCache;
+
+    //Decodes running in the thread pool. The watchers are our children, so they go away with us
+    QHash<QFutureWatcher<QImage> *, PendingDecode> _pendingDecodes;
+
+    //Expired tiles whose fetches are under way. Cost is in bytes
+    QCache<MapTileKey, StaleTile> _staleTiles;
+
+    //Tiles warmMemoryCache() was asked for that haven't been warmed yet
+    QList<MapTileKey> _tilesToWarm;
+
+    //Protects _memoryCache, _staleTiles, _tilesToWarm, _expiredTilePolicy and _diskCacheQuota, which
+    //cacheStatistics(), setMemoryCacheBudget(), warmMemoryCache() and the setters reach from other threads
+    mutable QMutex _memoryCacheLock;
+    qint64 _diskCacheQuota;
+
+    //Only the counters in here are kept up to date. cacheStatistics() fills in the sizes
+    MapTileSource::CacheStatistics _statistics;
+
+    /*
+      Tile requests. requestTile() and cancelTileRequest() are called from other threads, so everything below
+      is protected by _requestLock. _queues holds the keys of the tiles waiting at each priority; entries whose request
+      was cancelled or moved to another priority are skipped when they come up.
+    */
+    mutable QMutex _requestLock;
+    QHash<MapTileKey, TileRequest> _queuedRequests;
+    QHash<MapTileKey, TileRequest> _inFlightRequests;
+    QQueue<MapTileKey> _queues[VisiblePriority + 1];
+    QHash<quint64, MapTileKey> _tokenKeys;
+    QHash<quint64, TileDelivery> _deliveries;
+    QList<TileRequest> _cancelledFetches;
+    quint64 _nextToken;
+    int _maxConcurrentRequests;
+
+    /*
+      Revalidations of expired tiles that were handed out. _revalidations holds the keys of the ones that are
+      queued or under way, _revalidating those under way. They're fetched like requests nobody is waiting on, and
+      nothing is revalidated until _revalidationRetryTime after one fails. Also protected by _requestLock.
+    */
+    QQueue<MapTileKey> _revalidationQueue;
+    QSet<MapTileKey> _revalidations;
+    QSet<MapTileKey> _revalidating;
+    QDateTime _revalidationRetryTime;
     
 };
 
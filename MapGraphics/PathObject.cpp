@@ -0,0 +1,383 @@
+#include "PathObject.h"
+
+#include "guts/ENUConverter.h"
+
+#include <QtGlobal>
+#include <QPen>
+#include <algorithm>
+#include <cmath>
+
+//Zoom levels above this one share its simplification
+const int MAX_SIMPLIFIED_ZOOM = 22;
+
+//Ground resolution at the equator of 256-pixel Web Mercator tiles on zoom level 0
+const qreal METERS_PER_PIXEL_ZOOM_0 = 156543.03392;
+
+const qreal PI = 3.14159265358979323846;
+
+//How far in meters new waypoints may lie outside the path's extents before the ENU frame is re-centered
+const qreal RECENTER_MARGIN = 1000.0;
+
+PathObject::PathObject(const QList<Position> &path,
+                       QColor color,
+                       MapGraphicsObject *parent) :
+    MapGraphicsObject(false, parent),
+    _pathEncoding(CompactPath::Float32Offsets), _color(color), _lineWidth(2.0), _markerRadius(4.0), _markerSpacing(12.0),
+    _simplifyTolerance(0.5), _drawnCount(-1), _halfWidth(5.0), _halfHeight(5.0), _zoomLevel(MAX_SIMPLIFIED_ZOOM)
+{
+    this->setPath(path);
+}
+
+PathObject::~PathObject()
+{
+}
+
+//pure-virtual from MapGraphicsObject
+QRectF PathObject::boundingRect() const
+{
+    //PrivateQGraphicsObject expects the rect to be centered on pos()
+    return QRectF(-1.0 * _halfWidth,
+                  -1.0 * _halfHeight,
+                  2.0 * _halfWidth,
+                  2.0 * _halfHeight);
+}
+
+//pure-virtual from MapGraphicsObject
+void PathObject::paint(QPainter *painter,
+                       const QStyleOptionGraphicsItem *option,
+                       QWidget *widget)
+{
+    Q_UNUSED(option);
+    Q_UNUSED(widget);
+
+    const QPolygonF& enuPoints = _enuPath.points();
+    const int drawn = (_drawnCount < 0) ? enuPoints.size() : qMin<int>(_drawnCount, enuPoints.size());
+    if (drawn == 0)
+        return;
+
+    if (!_levelBuilt.at(_zoomLevel))
+        this->buildLevel(_zoomLevel);
+
+    painter->setRenderHint(QPainter::Antialiasing, true);
+
+    //Cosmetic pens keep their width in pixels even though we paint in meters
+    QPen pen(_color);
+    pen.setCosmetic(true);
+    pen.setWidthF(_lineWidth);
+    painter->setPen(pen);
+    painter->setBrush(Qt::NoBrush);
+    if (drawn == enuPoints.size())
+        painter->drawPath(_levelPaths.at(_zoomLevel));
+    else
+    {
+        //The simplified vertices up to the last drawn waypoint, then on to that waypoint if it wasn't kept
+        const QPolygonF& points = _levelPoints.at(_zoomLevel);
+        const QVector<int>& indices = _levelIndices.at(_zoomLevel);
+        const int kept = std::upper_bound(indices.constBegin(), indices.constEnd(), drawn - 1) - indices.constBegin();
+        painter->drawPolyline(points.constData(), kept);
+        if (kept > 0 && indices.at(kept - 1) != drawn - 1)
+            painter->drawLine(points.at(kept - 1), enuPoints.at(drawn - 1));
+    }
+
+    if (_markerRadius <= 0.0)
+        return;
+
+    //Work out how many meters a pixel is at the current zoom so we can decimate the markers
+    const qreal pixelsPerMeter = qAbs<qreal>(painter->worldTransform().m11());
+    if (pixelsPerMeter <= 0.0)
+        return;
+    const qreal spacingMeters = _markerSpacing / pixelsPerMeter;
+    const qreal radiusMeters = _markerRadius / pixelsPerMeter;
+
+    QPen markerPen(Qt::black);
+    markerPen.setCosmetic(true);
+    painter->setPen(markerPen);
+    painter->setBrush(_color);
+
+    //Markers go on the real waypoints, not just the ones that survived simplification
+    QPointF lastMarker = enuPoints.first();
+    painter->drawEllipse(lastMarker, radiusMeters, radiusMeters);
+    for (int i = 1; i < drawn; i++)
+    {
+        const QPointF& point = enuPoints.at(i);
+        const QPointF diff = point - lastMarker;
+        if (diff.x() * diff.x() + diff.y() * diff.y() < spacingMeters * spacingMeters)
+            continue;
+        painter->drawEllipse(point, radiusMeters, radiusMeters);
+        lastMarker = point;
+    }
+}
+
+QList<Position> PathObject::path() const
+{
+    return _path.toList();
+}
+
+CompactPath::Encoding PathObject::pathEncoding() const
+{
+    return _pathEncoding;
+}
+
+void PathObject::setPathEncoding(CompactPath::Encoding encoding)
+{
+    _pathEncoding = encoding;
+}
+
+qint64 PathObject::pathMemoryBytes() const
+{
+    return _path.memoryBytes();
+}
+
+QColor PathObject::color() const
+{
+    return _color;
+}
+
+void PathObject::setColor(const QColor &color)
+{
+    if (_color == color)
+        return;
+    _color = color;
+    this->redrawRequested();
+}
+
+qreal PathObject::lineWidth() const
+{
+    return _lineWidth;
+}
+
+void PathObject::setLineWidth(qreal width)
+{
+    _lineWidth = qMax<qreal>(0.0, width);
+    this->redrawRequested();
+}
+
+qreal PathObject::markerRadius() const
+{
+    return _markerRadius;
+}
+
+void PathObject::setMarkerRadius(qreal radius)
+{
+    _markerRadius = qMax<qreal>(0.0, radius);
+    this->redrawRequested();
+}
+
+qreal PathObject::markerSpacing() const
+{
+    return _markerSpacing;
+}
+
+void PathObject::setMarkerSpacing(qreal spacing)
+{
+    _markerSpacing = qMax<qreal>(0.0, spacing);
+    this->redrawRequested();
+}
+
+qreal PathObject::simplifyTolerance() const
+{
+    return _simplifyTolerance;
+}
+
+void PathObject::setSimplifyTolerance(qreal tolerance)
+{
+    _simplifyTolerance = qMax<qreal>(0.0, tolerance);
+    this->clearLevels();
+    this->redrawRequested();
+}
+
+int PathObject::displayedVertexCount() const
+{
+    if (!_levelBuilt.value(_zoomLevel, false))
+        return 0;
+    return _levelPoints.at(_zoomLevel).size();
+}
+
+int PathObject::drawnCount() const
+{
+    return _drawnCount;
+}
+
+//public slot
+void PathObject::setDrawnCount(int count)
+{
+    if (count == _drawnCount)
+        return;
+    _drawnCount = count;
+    this->redrawRequested();
+}
+
+//public slot
+void PathObject::setPath(const QList<Position> &path)
+{
+    //Only the waypoints between the common start and the common end need converting again
+    const int oldSize = _path.size();
+    const bool sameEncoding = (_path.encoding() == _pathEncoding);
+    const int shorter = sameEncoding ? qMin<int>(oldSize, path.size()) : 0;
+    int prefix = 0;
+    while (prefix < shorter && _path.matches(prefix, path.at(prefix)))
+        prefix++;
+    int suffix = 0;
+    while (suffix < shorter - prefix && _path.matches(oldSize - 1 - suffix, path.at(path.size() - 1 - suffix)))
+        suffix++;
+
+    if (oldSize > 0 && sameEncoding && prefix == oldSize && prefix == path.size())
+        return;
+    else if (oldSize == 0 || path.isEmpty())
+        this->rebuild(path);
+    else
+        this->replaceRange(path, prefix, oldSize - prefix - suffix, path.size() - prefix - suffix);
+}
+
+//protected
+//virtual from MapGraphicsObject
+void PathObject::zoomLevelChangedEvent(quint8 zoomLevel)
+{
+    //The view repaints us after this, so just remember which level to draw
+    _zoomLevel = qMin<int>(zoomLevel, MAX_SIMPLIFIED_ZOOM);
+}
+
+//private
+void PathObject::rebuild(const QList<Position> &path)
+{
+    const int count = path.size();
+
+    QPolygonF geoPoints(count);
+    for (int i = 0; i < count; i++)
+        geoPoints[i] = path.at(i).lonLat();
+    const QPointF center = geoPoints.boundingRect().center();
+    _path = CompactPath(path, Position(center, 0.0), _pathEncoding);
+
+    //Convert every point in one batch around our new position
+    QVector<qreal> lats(count);
+    QVector<qreal> lons(count);
+    QVector<qreal> alts(count, 0.0);
+    for (int i = 0; i < count; i++)
+    {
+        lons[i] = geoPoints.at(i).x();
+        lats[i] = geoPoints.at(i).y();
+    }
+
+    QVector<qreal> easts(count);
+    QVector<qreal> norths(count);
+    QVector<qreal> ups(count);
+    const ENUConverter converter(Position(center, 0.0));
+    converter.lla2enu(lats.constData(), lons.constData(), alts.constData(),
+                      count,
+                      easts.data(), norths.data(), ups.data());
+
+    QPolygonF enuPoints(count);
+    _halfWidth = 5.0;
+    _halfHeight = 5.0;
+    for (int i = 0; i < count; i++)
+    {
+        enuPoints[i] = QPointF(easts[i], norths[i]);
+        _halfWidth = qMax<qreal>(_halfWidth, qAbs<qreal>(easts[i]));
+        _halfHeight = qMax<qreal>(_halfHeight, qAbs<qreal>(norths[i]));
+    }
+    _enuPath.setPoints(enuPoints);
+    this->clearLevels();
+
+    //Both of these make PrivateQGraphicsObject recompute its bounding rect
+    this->setPos(center);
+    this->redrawRequested();
+}
+
+//private
+void PathObject::replaceRange(const QList<Position> &path, int first, int removed, int added)
+{
+    //Convert the new waypoints in one batch around the same position as the rest
+    QVector<qreal> lats(added);
+    QVector<qreal> lons(added);
+    QVector<qreal> alts(added, 0.0);
+    for (int i = 0; i < added; i++)
+    {
+        const QPointF lonLat = path.at(first + i).lonLat();
+        lons[i] = lonLat.x();
+        lats[i] = lonLat.y();
+    }
+
+    QVector<qreal> easts(added);
+    QVector<qreal> norths(added);
+    QVector<qreal> ups(added);
+    const ENUConverter converter(Position(this->pos(), 0.0));
+    converter.lla2enu(lats.constData(), lons.constData(), alts.constData(),
+                      added,
+                      easts.data(), norths.data(), ups.data());
+
+    QPolygonF enuPoints(added);
+    for (int i = 0; i < added; i++)
+    {
+        //ENU is only flat near its origin, so a path that wanders off is converted again around its new center
+        if (qAbs<qreal>(easts[i]) > _halfWidth + RECENTER_MARGIN
+                || qAbs<qreal>(norths[i]) > _halfHeight + RECENTER_MARGIN)
+        {
+            this->rebuild(path);
+            return;
+        }
+        enuPoints[i] = QPointF(easts[i], norths[i]);
+    }
+    _enuPath.replace(first, removed, enuPoints);
+
+    //Encoding is only arithmetic, so the whole path is simply encoded again around the same origin
+    _path = CompactPath(path, _path.origin(), _pathEncoding);
+
+    //The extents may have shrunk as well as grown
+    const QPolygonF& points = _enuPath.points();
+    _halfWidth = 5.0;
+    _halfHeight = 5.0;
+    for (int i = 0; i < points.size(); i++)
+    {
+        _halfWidth = qMax<qreal>(_halfWidth, qAbs<qreal>(points.at(i).x()));
+        _halfHeight = qMax<qreal>(_halfHeight, qAbs<qreal>(points.at(i).y()));
+    }
+    this->clearLevels();
+
+    //Makes PrivateQGraphicsObject recompute its bounding rect
+    this->redrawRequested();
+}
+
+//private
+void PathObject::clearLevels()
+{
+    _levelBuilt.fill(false, MAX_SIMPLIFIED_ZOOM + 1);
+    _levelPoints.fill(QPolygonF(), MAX_SIMPLIFIED_ZOOM + 1);
+    _levelIndices.fill(QVector<int>(), MAX_SIMPLIFIED_ZOOM + 1);
+    _levelPaths.fill(QPainterPath(), MAX_SIMPLIFIED_ZOOM + 1);
+}
+
+//private
+void PathObject::buildLevel(int zoomLevel)
+{
+    //How many meters one pixel covers at our latitude on this zoom level
+    const qreal metersPerPixel = METERS_PER_PIXEL_ZOOM_0 * cos(this->latitude() * PI / 180.0)
+            / pow(2.0, zoomLevel);
+
+    const QPolygonF& allPoints = _enuPath.points();
+    QVector<int> indices;
+    if (_simplifyTolerance > 0.0)
+        indices = _enuPath.simplifiedIndices(_simplifyTolerance * metersPerPixel);
+    else
+    {
+        indices.resize(allPoints.size());
+        for (int i = 0; i < indices.size(); i++)
+            indices[i] = i;
+    }
+
+    QPolygonF points(indices.size());
+    for (int i = 0; i < indices.size(); i++)
+        points[i] = allPoints.at(indices.at(i));
+
+    QPainterPath painterPath;
+    if (!points.isEmpty())
+    {
+        painterPath.moveTo(points.first());
+        for (int i = 1; i < points.size(); i++)
+            painterPath.lineTo(points.at(i));
+    }
+
+    _levelPoints[zoomLevel] = points;
+    _levelIndices[zoomLevel] = indices;
+    _levelPaths[zoomLevel] = painterPath;
+    _levelBuilt[zoomLevel] = true;
+}
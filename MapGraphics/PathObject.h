@@ -0,0 +1,153 @@
+#ifndef PATHOBJECT_H
+#define PATHOBJECT_H
+
+#include <QList>
+#include <QVector>
+#include <QPolygonF>
+#include <QPainterPath>
+#include <QColor>
+
+#include "MapGraphics_global.h"
+#include "MapGraphicsObject.h"
+#include "Position.h"
+#include "CompactPath.h"
+#include "guts/MultiResolutionPath.h"
+
+/**
+ * @brief The PathObject class draws a whole geographic path as one polyline, optionally with a marker
+ * at the waypoints. It replaces one graphics object per waypoint with a single object whose ENU points are
+ * converted once per setPath() instead of on every repaint.
+ *
+ * Markers are decimated according to the current zoom: a marker is only drawn once the path has gone at
+ * least markerSpacing() pixels since the last one, so zoomed-out views don't draw thousands of them.
+ *
+ * The line itself is simplified per zoom level with Douglas-Peucker to simplifyTolerance() pixels. The
+ * vertices are ranked once per setPath() and each zoom level's path is built the first time it's shown.
+ *
+ * setPath() compares the new path with the old one and only converts and ranks the waypoints between their
+ * common start and common end, so a planner that keeps refining the end of a long flight doesn't pay for the
+ * whole flight on every update.
+ *
+ * setDrawnCount() draws just the start of the path, e.g. a flight log up to the time being reviewed. Moving
+ * the cut only costs a binary search in the zoom level's simplified vertices.
+ *
+ * The path itself is kept as a CompactPath around pos(), which is all the precision drawing it needs. Waypoints
+ * that moved by less than that precision count as unchanged.
+ */
+class MAPGRAPHICSSHARED_EXPORT PathObject : public MapGraphicsObject
+{
+    Q_OBJECT
+public:
+    explicit PathObject(const QList<Position>& path = QList<Position>(),
+                        QColor color = QColor(255,255,0),
+                        MapGraphicsObject *parent = 0);
+    virtual ~PathObject();
+
+    //pure-virtual from MapGraphicsObject
+    QRectF boundingRect() const;
+
+    //pure-virtual from MapGraphicsObject
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget);
+
+    /**
+     * @brief path returns the displayed path, decoded from pathEncoding()
+     */
+    QList<Position> path() const;
+
+    /**
+     * @brief pathEncoding is how the path is kept (see CompactPath). Defaults to CompactPath::Float32Offsets.
+     * Changing it only affects later calls to setPath().
+     */
+    CompactPath::Encoding pathEncoding() const;
+    void setPathEncoding(CompactPath::Encoding encoding);
+
+    /**
+     * @brief pathMemoryBytes returns roughly how much memory the kept path takes
+     */
+    qint64 pathMemoryBytes() const;
+
+    QColor color() const;
+    void setColor(const QColor& color);
+
+    /**
+     * @brief lineWidth is the width of the polyline in pixels, regardless of zoom
+     */
+    qreal lineWidth() const;
+    void setLineWidth(qreal width);
+
+    /**
+     * @brief markerRadius is the radius of the waypoint markers in pixels. Zero disables markers.
+     */
+    qreal markerRadius() const;
+    void setMarkerRadius(qreal radius);
+
+    /**
+     * @brief markerSpacing is the minimum distance in pixels between two drawn markers
+     */
+    qreal markerSpacing() const;
+    void setMarkerSpacing(qreal spacing);
+
+    /**
+     * @brief simplifyTolerance is how far in pixels the drawn line may stray from the real path. Zero draws
+     * every vertex.
+     */
+    qreal simplifyTolerance() const;
+    void setSimplifyTolerance(qreal tolerance);
+
+    /**
+     * @brief displayedVertexCount returns the number of vertices drawn at the current zoom level
+     */
+    int displayedVertexCount() const;
+
+    /**
+     * @brief drawnCount is how many of the path's waypoints, from the first, are drawn. Negative (the default)
+     * draws them all. setPath() keeps it.
+     */
+    int drawnCount() const;
+
+signals:
+
+public slots:
+    /**
+     * @brief setPath replaces the displayed path in place. The ENU points of the waypoints that changed are
+     * converted and ranked here rather than in paint().
+     */
+    void setPath(const QList<Position>& path);
+
+    void setDrawnCount(int count);
+
+protected:
+    //virtual from MapGraphicsObject
+    virtual void zoomLevelChangedEvent(quint8 zoomLevel);
+
+private:
+    void rebuild(const QList<Position>& path);
+    void replaceRange(const QList<Position>& path, int first, int removed, int added);
+    void clearLevels();
+    void buildLevel(int zoomLevel);
+
+    CompactPath _path;
+    CompactPath::Encoding _pathEncoding;
+    QColor _color;
+    qreal _lineWidth;
+    qreal _markerRadius;
+    qreal _markerSpacing;
+
+    qreal _simplifyTolerance;
+    int _drawnCount;
+
+    //The path in meters (ENU) around pos(), ranked for simplification, and its half-extents
+    MultiResolutionPath _enuPath;
+    qreal _halfWidth;
+    qreal _halfHeight;
+
+    //Simplified vertices and painter path for each zoom level, built on demand
+    int _zoomLevel;
+    QVector<bool> _levelBuilt;
+    QVector<QPolygonF> _levelPoints;
+    QVector<QVector<int> > _levelIndices;
+    QVector<QPainterPath> _levelPaths;
+
+};
+
+#endif // PATHOBJECT_H
@@ -1,30 +1,47 @@
 #include "PolygonObject.h"
 
 #include "guts/Conversions.h"
+#include "guts/ENUConverter.h"
 #include "CircleObject.h"
 
 #include <QtDebug>
 #include <QKeyEvent>
+#include <QTimer>
+#include <QPointer>
+#include <cmath>
+
+//Zoom levels above this one share its simplification
+const int MAX_SIMPLIFIED_ZOOM = 22;
+
+//Ground resolution at the equator of 256-pixel Web Mercator tiles on zoom level 0
+const qreal METERS_PER_PIXEL_ZOOM_0 = 156543.03392;
+
+//How far in pixels the drawn outline may stray from the real one
+const qreal SIMPLIFY_TOLERANCE_PIXELS = 0.5;
+
+const qreal PI = 3.14159265358979323846;
+
+//non-member
+//The polygon that's showing its handles, if any
+static QPointer<PolygonObject> editedPolygon;
 
 PolygonObject::PolygonObject(QPolygonF geoPoly, QColor fillColor, QObject *parent) :
-    MapGraphicsObject(parent), _geoPoly(geoPoly), _fillColor(fillColor)
+    MapGraphicsObject(parent), _geoPoly(geoPoly), _fillColor(fillColor), _zoomLevel(MAX_SIMPLIFIED_ZOOM),
+    _editing(false)
 {
     this->setFlag(MapGraphicsObject::ObjectIsMovable);
     this->setFlag(MapGraphicsObject::ObjectIsSelectable,false);
     this->setFlag(MapGraphicsObject::ObjectIsFocusable);
     this->setGeoPoly(geoPoly);
+
+    //setGeoPoly() does nothing when handed the polygon we already have
+    this->updateENUPoly();
 }
 
 PolygonObject::~PolygonObject()
 {
     qDebug() << this << "destroying";
-    foreach(MapGraphicsObject * circle, _editCircles)
-        this->destroyEditCircle(circle);
-    _editCircles.clear();
-
-    foreach(MapGraphicsObject * circle, _addVertexCircles)
-        this->destroyAddVertexCircle(circle);
-    _addVertexCircles.clear();
+    this->destroyEditCircles();
 }
 
 //pure-virtual from MapGraphicsObject
@@ -36,8 +53,9 @@ QRectF PolygonObject::boundingRect() const
     Position topLeftPos(latLonRect.topLeft(),0.0);
     Position bottomRightPos(latLonRect.bottomRight(),0.0);
 
-    QPointF topLeftENU = Conversions::lla2enu(topLeftPos,latLonCenterPos).toPointF();
-    QPointF bottomRightENU = Conversions::lla2enu(bottomRightPos,latLonCenterPos).toPointF();
+    const ENUConverter converter(latLonCenterPos);
+    QPointF topLeftENU = converter.lla2enu(topLeftPos).toPointF();
+    QPointF bottomRightENU = converter.lla2enu(bottomRightPos).toPointF();
 
     return QRectF(topLeftENU,bottomRightENU);
 }
@@ -55,45 +73,12 @@ void PolygonObject::paint(QPainter *painter, const QStyleOptionGraphicsItem *opt
     Q_UNUSED(option)
     Q_UNUSED(widget)
 
-    painter->setRenderHint(QPainter::Antialiasing,true);
-
-    QPolygonF enuPoly;
-
-    Position latLonCenterPos(_geoPoly.boundingRect().center(),0);
-    foreach(QPointF latLon, _geoPoly)
-    {
-        Position latLonPos(latLon,0.0);
-        QPointF enu = Conversions::lla2enu(latLonPos,latLonCenterPos).toPointF();
-        enuPoly << enu;
-    }
+    if (!_levelBuilt.at(_zoomLevel))
+        this->buildLevel(_zoomLevel);
 
+    painter->setRenderHint(QPainter::Antialiasing,true);
     painter->setBrush(_fillColor);
-    painter->drawPolygon(enuPoly);
-
-
-    //Populate edit and add-vertex handles if necessary.
-    //Is there a better place to do this? Most likely, yes.
-    if (_editCircles.isEmpty())
-    {
-        //Create objects to edit the polygon!
-        for (int i = 0; i < _geoPoly.size(); i++)
-        {
-            //Edit circles - to change the shape
-            CircleObject * circle = this->constructEditCircle();
-            circle->setPos(_geoPoly.at(i));
-            _editCircles.append(circle);
-
-            QPointF current = _geoPoly.at(i);
-            QPointF next = _geoPoly.at((i+1) % _geoPoly.size());
-            QPointF avg((current.x() + next.x())/2.0,
-                        (current.y() + next.y())/2.0);
-
-            //Add vertex circles - to add new vertices
-            CircleObject * betweener = this->constructAddVertexCircle();
-            betweener->setPos(avg);
-            _addVertexCircles.append(betweener);
-        }
-    }
+    painter->drawPath(_levelPaths.at(_zoomLevel));
 }
 
 void PolygonObject::setPos(const QPointF & nPos)
@@ -117,6 +102,9 @@ void PolygonObject::setPos(const QPointF & nPos)
 
     MapGraphicsObject::setPos(nPos);
 
+    //Every path that changes _geoPoly ends up here, so this is where we keep the ENU version current
+    this->updateENUPoly();
+
     //If this isn't here, we get TEARING when we edit our polygons
     this->posChanged();
 }
@@ -132,16 +120,13 @@ void PolygonObject::setGeoPoly(const QPolygonF &newPoly)
         return;
 
     _geoPoly = newPoly;
-
-    foreach(MapGraphicsObject * obj, _editCircles)
-        this->destroyEditCircle(obj);
-    foreach(MapGraphicsObject * obj, _addVertexCircles)
-        this->destroyAddVertexCircle(obj);
-    _editCircles.clear();
-    _addVertexCircles.clear();
+    this->destroyEditCircles();
 
     this->setPos(newPoly.boundingRect().center());
     this->polygonChanged(newPoly);
+
+    if (_editing)
+        QTimer::singleShot(1, this, SLOT(createEditCircles()));
 }
 
 void PolygonObject::setFillColor(const QColor &color)
@@ -153,6 +138,34 @@ void PolygonObject::setFillColor(const QColor &color)
     this->redrawRequested();
 }
 
+bool PolygonObject::isEditing() const
+{
+    return _editing;
+}
+
+void PolygonObject::setEditing(bool editing)
+{
+    if (editing == _editing)
+        return;
+    _editing = editing;
+
+    if (_editing)
+    {
+        if (!editedPolygon.isNull() && editedPolygon.data() != this)
+            editedPolygon->setEditing(false);
+        editedPolygon = this;
+
+        //Our handles go into the scene through newObjectGenerated(), which only works once we're in it
+        QTimer::singleShot(1, this, SLOT(createEditCircles()));
+    }
+    else
+    {
+        if (editedPolygon.data() == this)
+            editedPolygon.clear();
+        this->destroyEditCircles();
+    }
+}
+
 //protected
 //virtual from MapGraphicsObject
 void PolygonObject::mousePressEvent(QGraphicsSceneMouseEvent *event)
@@ -165,9 +178,12 @@ void PolygonObject::mousePressEvent(QGraphicsSceneMouseEvent *event)
     */
     const QPointF geoPos = event->scenePos();
 
-    //If the geo point is within our geo polygon, we might accept it
+    //If the geo point is within our geo polygon, we might accept it. Clicking a polygon starts editing it
     if (_geoPoly.containsPoint(geoPos,Qt::OddEvenFill))
+    {
+        this->setEditing(true);
         MapGraphicsObject::mousePressEvent(event);
+    }
     //Otherwise we ignore it
     else
         event->ignore();
@@ -186,6 +202,14 @@ void PolygonObject::keyReleaseEvent(QKeyEvent *event)
         event->ignore();
 }
 
+//protected
+//virtual from MapGraphicsObject
+void PolygonObject::zoomLevelChangedEvent(quint8 zoomLevel)
+{
+    //The view repaints us after this, so just remember which level to draw
+    _zoomLevel = qMin<int>(zoomLevel, MAX_SIMPLIFIED_ZOOM);
+}
+
 //private slot
 void PolygonObject::handleEditCirclePosChanged()
 {
@@ -237,8 +261,9 @@ void PolygonObject::handleAddVertexCircleSelected()
         return;
     index++;
 
-    //Put the vertex in the polygon
+    //Put the vertex in the polygon. It's on an existing edge, so the bounding box (and our position) can't change
     _geoPoly.insert(index,geoPos);
+    this->updateENUPoly();
 
     //Create a new "Edit Circle" and put it in the right spot
     CircleObject * editCircle = this->constructEditCircle();
@@ -290,9 +315,38 @@ void PolygonObject::handleEditCircleDestroyed()
     this->setPos(_geoPoly.boundingRect().center());
 }
 
+//private slot
+void PolygonObject::createEditCircles()
+{
+    if (!_editing || !_editCircles.isEmpty())
+        return;
+
+    for (int i = 0; i < _geoPoly.size(); i++)
+    {
+        //Edit circles - to change the shape
+        CircleObject * circle = this->constructEditCircle();
+        circle->setPos(_geoPoly.at(i));
+        _editCircles.append(circle);
+
+        QPointF current = _geoPoly.at(i);
+        QPointF next = _geoPoly.at((i+1) % _geoPoly.size());
+        QPointF avg((current.x() + next.x())/2.0,
+                    (current.y() + next.y())/2.0);
+
+        //Add vertex circles - to add new vertices
+        CircleObject * betweener = this->constructAddVertexCircle();
+        betweener->setPos(avg);
+        _addVertexCircles.append(betweener);
+    }
+}
+
 //private
 void PolygonObject::fixAddVertexCirclePos()
 {
+    //Without handles (or before they've caught up with the polygon) there's nothing to move
+    if (_addVertexCircles.size() != _geoPoly.size())
+        return;
+
     for (int i = 0; i < _geoPoly.size(); i++)
     {
         QPointF current = _geoPoly.at(i);
@@ -360,3 +414,71 @@ void PolygonObject::destroyAddVertexCircle(MapGraphicsObject *obj)
                SLOT(handleAddVertexCircleSelected()));
     obj->deleteLater();
 }
+
+//private
+void PolygonObject::updateENUPoly()
+{
+    //Convert every vertex in one batch so the ENU frame is only set up once
+    const int count = _geoPoly.size();
+    QVector<qreal> lats(count);
+    QVector<qreal> lons(count);
+    QVector<qreal> alts(count, 0.0);
+    for (int i = 0; i < count; i++)
+    {
+        lons[i] = _geoPoly.at(i).x();
+        lats[i] = _geoPoly.at(i).y();
+    }
+
+    QVector<qreal> easts(count);
+    QVector<qreal> norths(count);
+    QVector<qreal> ups(count);
+    const ENUConverter converter(Position(_geoPoly.boundingRect().center(),0));
+    converter.lla2enu(lats.constData(), lons.constData(), alts.constData(),
+                      count,
+                      easts.data(), norths.data(), ups.data());
+
+    _enuPoly.resize(count);
+    for (int i = 0; i < count; i++)
+        _enuPoly[i] = QPointF(easts[i], norths[i]);
+
+    QPolygonF ring = _enuPoly;
+    if (!ring.isEmpty())
+        ring.append(ring.first());
+    _enuRanked.setPoints(ring);
+    _levelBuilt.fill(false, MAX_SIMPLIFIED_ZOOM + 1);
+    _levelPaths.fill(QPainterPath(), MAX_SIMPLIFIED_ZOOM + 1);
+    this->redrawRequested();
+}
+
+//private
+void PolygonObject::buildLevel(int zoomLevel)
+{
+    //How many meters one pixel covers at our latitude on this zoom level
+    const qreal metersPerPixel = METERS_PER_PIXEL_ZOOM_0 * cos(this->latitude() * PI / 180.0)
+            / pow(2.0, zoomLevel);
+
+    QPolygonF points = _enuRanked.simplified(SIMPLIFY_TOLERANCE_PIXELS * metersPerPixel);
+
+    //Simplified down to a sliver, it's too small to see the difference, so keep its real shape
+    if (points.size() < 4)
+        points = _enuRanked.points();
+
+    QPainterPath painterPath;
+    painterPath.addPolygon(points);
+    painterPath.closeSubpath();
+
+    _levelPaths[zoomLevel] = painterPath;
+    _levelBuilt[zoomLevel] = true;
+}
+
+//private
+void PolygonObject::destroyEditCircles()
+{
+    foreach(MapGraphicsObject * circle, _editCircles)
+        this->destroyEditCircle(circle);
+    _editCircles.clear();
+
+    foreach(MapGraphicsObject * circle, _addVertexCircles)
+        this->destroyAddVertexCircle(circle);
+    _addVertexCircles.clear();
+}
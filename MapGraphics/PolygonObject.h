@@ -3,11 +3,22 @@
 
 #include <QPolygonF>
 #include <QList>
+#include <QVector>
+#include <QPainterPath>
 
 #include "MapGraphicsObject.h"
 #include "MapGraphics_global.h"
+#include "guts/MultiResolutionPath.h"
 class CircleObject;
 
+/**
+ * @brief The PolygonObject class draws an editable geographic polygon.
+ *
+ * The outline is simplified per zoom level with Douglas-Peucker to half a pixel, like PathObject's, so a
+ * detailed polygon seen from far away is drawn with a handful of vertices. The vertex handles (an edit circle
+ * per vertex and an add-vertex circle per edge) only exist while the polygon is being edited, which it starts
+ * being when it's clicked. Only one polygon is edited at a time.
+ */
 class MAPGRAPHICSSHARED_EXPORT PolygonObject : public MapGraphicsObject
 {
     Q_OBJECT
@@ -32,6 +43,16 @@ public:
     virtual void setGeoPoly(const QPolygonF& newPoly);
 
     void setFillColor(const QColor& color);
+
+    /**
+     * @brief isEditing returns whether the polygon is showing its vertex handles
+     */
+    bool isEditing() const;
+
+    /**
+     * @brief setEditing shows or hides the vertex handles. Editing one polygon stops the editing of any other.
+     */
+    void setEditing(bool editing);
     
 signals:
     void polygonChanged(const QPolygonF& poly);
@@ -42,14 +63,19 @@ protected:
     //virtual from MapGraphicsObject
     virtual void mousePressEvent(QGraphicsSceneMouseEvent * event);
     virtual void keyReleaseEvent(QKeyEvent *event);
+    virtual void zoomLevelChangedEvent(quint8 zoomLevel);
 
 private slots:
     void handleEditCirclePosChanged();
     void handleAddVertexCircleSelected();
     void handleEditCircleDestroyed();
+    void createEditCircles();
 
 private:
     void fixAddVertexCirclePos();
+    void updateENUPoly();
+    void buildLevel(int zoomLevel);
+    void destroyEditCircles();
 
     CircleObject * constructEditCircle();
     void destroyEditCircle(MapGraphicsObject * obj);
@@ -60,6 +86,19 @@ private:
     QPolygonF _geoPoly;
     QColor _fillColor;
 
+    //_geoPoly in meters around the center of its bounding box, rebuilt whenever _geoPoly changes
+    QPolygonF _enuPoly;
+
+    //The outline ranked for simplification (closed, so the first vertex is repeated at the end)
+    MultiResolutionPath _enuRanked;
+
+    //The simplified outline for each zoom level, built the first time it's shown
+    int _zoomLevel;
+    QVector<bool> _levelBuilt;
+    QVector<QPainterPath> _levelPaths;
+
+    bool _editing;
+
     QList<MapGraphicsObject *> _editCircles;
     QList<MapGraphicsObject *> _addVertexCircles;
     
@@ -90,6 +90,26 @@ void Position::setAltitude(const qreal &altitude)
     _altitude = altitude;
 }
 
+qreal Position::distanceTo(const Position &other, DistanceModel model) const
+{
+    switch (model)
+    {
+    case LocalENU:
+        return Conversions::chordDistance(*this, other);
+    case Geodesic:
+        return Conversions::geodesicDistance(*this, other);
+    default:
+    case Equirectangular:
+        return Conversions::equirectangularDistance(*this, other);
+    }
+}
+
+//static
+void Position::distances(const Position &from, const Position *to, int count, qreal *distances, DistanceModel model)
+{
+    Conversions::distances(from, to, count, model, distances);
+}
+
 qreal Position::flatDistanceEstimate(const Position &other) const
 {
     const QVector2D offsetMeters = this->flatOffsetMeters(other);
@@ -184,5 +204,22 @@ QDataStream& operator>>(QDataStream& stream, Position& pos)
 //Non-member method for hashing
 uint qHash(const Position& pos)
 {
-    return pos.lonLat().x() + pos.lonLat().y() + pos.altitude();
+    /*
+     * operator== compares lon/lat fuzzily (QPointF), so hash them at a resolution much coarser than that
+     * tolerance (1e-9 degrees is about 0.1mm) instead of hashing their raw bits.
+    */
+    quint64 toRet = 0;
+    const qint64 parts[3] = {qRound64(pos.longitude() * 1.0e9),
+                             qRound64(pos.latitude() * 1.0e9),
+                             qRound64(pos.altitude() * 1.0e6)};
+    for (int i = 0; i < 3; i++)
+    {
+        //splitmix64 finalizer
+        toRet ^= (quint64)parts[i];
+        toRet += Q_UINT64_C(0x9e3779b97f4a7c15);
+        toRet = (toRet ^ (toRet >> 30)) * Q_UINT64_C(0xbf58476d1ce4e5b9);
+        toRet = (toRet ^ (toRet >> 27)) * Q_UINT64_C(0x94d049bb133111eb);
+        toRet ^= toRet >> 31;
+    }
+    return (uint)(toRet ^ (toRet >> 32));
 }
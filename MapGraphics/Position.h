@@ -11,6 +11,37 @@
 class MAPGRAPHICSSHARED_EXPORT Position
 {
 public:
+    /*
+     * How distanceTo() and distances() measure, cheapest first. None of them converts either end to ECEF, so even
+     * LocalENU costs less than the two Conversions::lla2xyz() it replaces.
+     */
+    enum DistanceModel
+    {
+        /*
+         * Horizontal meters on a plane scaled by the WGS84 ellipsoid's radii of curvature at the two ends' mean
+         * latitude. A sin, a cos and two square roots; altitude is ignored. Off by a few millimeters at 10 km and
+         * about a meter at 100 km at mid latitudes, growing with the square of the distance and towards the poles.
+         * Good for comparing and estimating distances within a mission.
+        */
+        Equirectangular,
+
+        /*
+         * The straight-line meters between the two, altitude included: the length of one's ENU coordinates about the
+         * other, or of their ECEF difference, to rounding. Five trig calls and three square roots (three and two per
+         * point in distances()) where two lla2xyz() take eight and three. It cuts under the curve of the earth, so
+         * it's shorter than the distance along the surface by d^3/24R^2: a millimeter at 10 km, a meter at 100 km.
+        */
+        LocalENU,
+
+        /*
+         * Meters along the surface of the WGS84 ellipsoid by Vincenty's inverse formula, good to half a millimeter
+         * at any range; altitude is ignored. It iterates, usually three to six times with a few trig calls each, so
+         * it costs several times the others. For nearly antipodal points it may not converge, and stops after a
+         * fixed number of iterations with a less accurate answer.
+        */
+        Geodesic
+    };
+
     Position();
     Position(qreal longitude, qreal latitude, qreal altitude = 0.0);
     Position(const QPointF& lonLat, qreal altitude = 0.0);
@@ -30,6 +61,18 @@ public:
     void setLatitude(const qreal& latitude);
     void setAltitude(const qreal& altitude);
 
+    /**
+     * @brief distanceTo returns the meters between this and other, measured by model
+     */
+    qreal distanceTo(const Position& other, DistanceModel model = Equirectangular) const;
+
+    /**
+     * @brief distances measures from from to each of the count positions in to under model, into distances
+     */
+    static void distances(const Position& from, const Position * to, int count, qreal * distances,
+                          DistanceModel model = Equirectangular);
+
+    //Roughly distanceTo() with Equirectangular, in single precision
     qreal flatDistanceEstimate(const Position& other) const;
     QVector2D flatOffsetMeters(const Position& dest) const;
     Position flatOffsetToPosition(const QPointF &offset) const;
@@ -0,0 +1,294 @@
+#include "TelemetryTrackObject.h"
+
+#include <QtGlobal>
+#include <QPen>
+#include <cmath>
+
+//Ground resolution at the equator of 256-pixel Web Mercator tiles on zoom level 0
+const qreal METERS_PER_PIXEL_ZOOM_0 = 156543.03392;
+
+const qreal PI = 3.14159265358979323846;
+
+//Radius in pixels of the marker on the latest fix
+const qreal LATEST_FIX_RADIUS = 5.0;
+
+//Until the view tells us its zoom level, decimate for the closest one, which keeps the most fixes
+const quint8 DEFAULT_ZOOM_LEVEL = 22;
+
+TelemetryTrackObject::TelemetryTrackObject(int capacity,
+                                           QColor color,
+                                           MapGraphicsObject *parent) :
+    MapGraphicsObject(false, parent),
+    _color(color), _lineWidth(2.0), _first(0), _count(0), _halfWidth(5.0), _halfHeight(5.0),
+    _fixesPending(false), _zoomLevel(DEFAULT_ZOOM_LEVEL), _dirty(true)
+{
+    _ring.resize(qMax<int>(1, capacity));
+
+    _redrawTimer.setSingleShot(true);
+    _redrawTimer.setInterval(100);
+    connect(&_redrawTimer,
+            SIGNAL(timeout()),
+            this,
+            SLOT(handleRedrawTimerTimeout()));
+}
+
+TelemetryTrackObject::~TelemetryTrackObject()
+{
+}
+
+//pure-virtual from MapGraphicsObject
+QRectF TelemetryTrackObject::boundingRect() const
+{
+    //PrivateQGraphicsObject expects the rect to be centered on pos()
+    return QRectF(-1.0 * _halfWidth,
+                  -1.0 * _halfHeight,
+                  2.0 * _halfWidth,
+                  2.0 * _halfHeight);
+}
+
+//pure-virtual from MapGraphicsObject
+void TelemetryTrackObject::paint(QPainter *painter,
+                                 const QStyleOptionGraphicsItem *option,
+                                 QWidget *widget)
+{
+    Q_UNUSED(option);
+    Q_UNUSED(widget);
+
+    if (_count == 0)
+        return;
+
+    if (_dirty)
+        this->decimate();
+
+    painter->setRenderHint(QPainter::Antialiasing, true);
+
+    //Cosmetic pens keep their width in pixels even though we paint in meters
+    QPen pen(_color);
+    pen.setCosmetic(true);
+    pen.setWidthF(_lineWidth);
+    painter->setPen(pen);
+    painter->setBrush(Qt::NoBrush);
+    painter->drawPath(_decimatedPath);
+
+    const qreal pixelsPerMeter = qAbs<qreal>(painter->worldTransform().m11());
+    if (pixelsPerMeter <= 0.0)
+        return;
+    const qreal radiusMeters = LATEST_FIX_RADIUS / pixelsPerMeter;
+
+    QPen markerPen(Qt::black);
+    markerPen.setCosmetic(true);
+    painter->setPen(markerPen);
+    painter->setBrush(_color);
+    painter->drawEllipse(this->fixAt(_count - 1), radiusMeters, radiusMeters);
+}
+
+int TelemetryTrackObject::capacity() const
+{
+    return _ring.size();
+}
+
+void TelemetryTrackObject::setCapacity(int capacity)
+{
+    capacity = qMax<int>(1, capacity);
+    if (capacity == _ring.size())
+        return;
+
+    //Unrolled so the oldest fix we keep lands at the front
+    const int kept = qMin<int>(_count, capacity);
+    QVector<QPointF> ring(capacity);
+    for (int i = 0; i < kept; i++)
+        ring[i] = this->fixAt(_count - kept + i);
+    _ring = ring;
+    _first = 0;
+    _count = kept;
+
+    _dirty = true;
+    this->redrawRequested();
+}
+
+int TelemetryTrackObject::size() const
+{
+    return _count;
+}
+
+Position TelemetryTrackObject::latestFix() const
+{
+    return _latestFix;
+}
+
+QColor TelemetryTrackObject::color() const
+{
+    return _color;
+}
+
+void TelemetryTrackObject::setColor(const QColor &color)
+{
+    if (_color == color)
+        return;
+    _color = color;
+    this->redrawRequested();
+}
+
+qreal TelemetryTrackObject::lineWidth() const
+{
+    return _lineWidth;
+}
+
+void TelemetryTrackObject::setLineWidth(qreal width)
+{
+    _lineWidth = qMax<qreal>(0.0, width);
+    this->redrawRequested();
+}
+
+int TelemetryTrackObject::redrawInterval() const
+{
+    return _redrawTimer.interval();
+}
+
+void TelemetryTrackObject::setRedrawInterval(int msecs)
+{
+    _redrawTimer.setInterval(qMax<int>(0, msecs));
+}
+
+int TelemetryTrackObject::displayedVertexCount() const
+{
+    if (_dirty)
+        return 0;
+    return _decimated.size();
+}
+
+//public slot
+void TelemetryTrackObject::addFix(const Position &fix)
+{
+    //Everything is drawn around the first fix. Tracks don't wander far enough for that to distort them.
+    if (_count == 0)
+    {
+        _converter = ENUConverter(Position(fix.lonLat(), 0.0));
+        this->setPos(fix.lonLat());
+    }
+
+    const QVector3D enu = _converter.lla2enu(fix.latitude(), fix.longitude(), 0.0);
+    const int capacity = _ring.size();
+    if (_count == capacity)
+    {
+        _ring[_first] = QPointF(enu.x(), enu.y());
+        _first = (_first + 1) % capacity;
+    }
+    else
+    {
+        _ring[(_first + _count) % capacity] = QPointF(enu.x(), enu.y());
+        _count++;
+    }
+    _latestFix = fix;
+    _dirty = true;
+
+    //The first fix after a quiet spell is drawn right away. The rest wait for the timer.
+    if (_redrawTimer.isActive())
+        _fixesPending = true;
+    else
+        this->redraw();
+}
+
+//public slot
+void TelemetryTrackObject::clear()
+{
+    _first = 0;
+    _count = 0;
+    _latestFix = Position();
+    _halfWidth = 5.0;
+    _halfHeight = 5.0;
+    _dirty = true;
+    _fixesPending = false;
+    _redrawTimer.stop();
+    this->redrawRequested();
+}
+
+//protected
+//virtual from MapGraphicsObject
+void TelemetryTrackObject::zoomLevelChangedEvent(quint8 zoomLevel)
+{
+    //The view repaints us after this. Columns are a different width now, so decimate again then.
+    _zoomLevel = zoomLevel;
+    _dirty = true;
+}
+
+//private slot
+void TelemetryTrackObject::handleRedrawTimerTimeout()
+{
+    //Fixes that came in while we were waiting are drawn now, and the wait starts over
+    if (_fixesPending)
+        this->redraw();
+}
+
+//private
+void TelemetryTrackObject::redraw()
+{
+    _fixesPending = false;
+
+    _halfWidth = 5.0;
+    _halfHeight = 5.0;
+    for (int i = 0; i < _count; i++)
+    {
+        const QPointF point = this->fixAt(i);
+        _halfWidth = qMax<qreal>(_halfWidth, qAbs<qreal>(point.x()));
+        _halfHeight = qMax<qreal>(_halfHeight, qAbs<qreal>(point.y()));
+    }
+
+    //Makes PrivateQGraphicsObject recompute our bounding rect and repaint us
+    this->redrawRequested();
+    _redrawTimer.start();
+}
+
+//private
+QPointF TelemetryTrackObject::fixAt(int index) const
+{
+    return _ring.at((_first + index) % _ring.size());
+}
+
+//private
+void TelemetryTrackObject::decimate()
+{
+    //How many meters one pixel covers at our latitude on this zoom level
+    const qreal metersPerPixel = METERS_PER_PIXEL_ZOOM_0 * cos(this->latitude() * PI / 180.0)
+            / pow(2.0, _zoomLevel);
+
+    _decimated.clear();
+    int i = 0;
+    while (i < _count)
+    {
+        //The run of fixes in this fix's pixel column, and the lowest and highest of them
+        const qreal column = floor(this->fixAt(i).x() / metersPerPixel);
+        int lowest = i;
+        int highest = i;
+        int j = i + 1;
+        while (j < _count)
+        {
+            const QPointF point = this->fixAt(j);
+            if (floor(point.x() / metersPerPixel) != column)
+                break;
+            if (point.y() < this->fixAt(lowest).y())
+                lowest = j;
+            if (point.y() > this->fixAt(highest).y())
+                highest = j;
+            j++;
+        }
+
+        //Kept in the order they were flown
+        int kept[4] = {i, qMin<int>(lowest, highest), qMax<int>(lowest, highest), j - 1};
+        for (int k = 0; k < 4; k++)
+        {
+            if (k == 0 || kept[k] != kept[k - 1])
+                _decimated.append(this->fixAt(kept[k]));
+        }
+        i = j;
+    }
+
+    _decimatedPath = QPainterPath();
+    if (!_decimated.isEmpty())
+    {
+        _decimatedPath.moveTo(_decimated.first());
+        for (int k = 1; k < _decimated.size(); k++)
+            _decimatedPath.lineTo(_decimated.at(k));
+    }
+    _dirty = false;
+}
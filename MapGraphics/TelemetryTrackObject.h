@@ -0,0 +1,122 @@
+#ifndef TELEMETRYTRACKOBJECT_H
+#define TELEMETRYTRACKOBJECT_H
+
+#include <QColor>
+#include <QPainterPath>
+#include <QPointF>
+#include <QPolygonF>
+#include <QTimer>
+#include <QVector>
+
+#include "MapGraphics_global.h"
+#include "MapGraphicsObject.h"
+#include "Position.h"
+#include "guts/ENUConverter.h"
+
+/**
+ * @brief The TelemetryTrackObject class draws an aircraft's live position fixes as one polyline with a marker on
+ * the latest fix, however fast they arrive.
+ *
+ * Fixes go into a ring buffer of capacity() points, converted to meters (ENU) around the first fix as they
+ * come in, so once it's full the oldest fix makes way for each new one and memory stays fixed. addFix() only
+ * stores the fix. The scene is told to repaint at most once every redrawInterval() milliseconds.
+ *
+ * Before drawing, each run of consecutive fixes that falls in one pixel column at the current zoom is cut down
+ * to its first, last, lowest and highest fix (min/max decimation). Those are all the fixes that change the
+ * drawn line, so a long track costs at most about four vertices per column. The decimated line is rebuilt
+ * once per repaint that has new fixes or a new zoom level, not on every paint().
+ */
+class MAPGRAPHICSSHARED_EXPORT TelemetryTrackObject : public MapGraphicsObject
+{
+    Q_OBJECT
+public:
+    explicit TelemetryTrackObject(int capacity = 100000,
+                                  QColor color = QColor(0,255,255),
+                                  MapGraphicsObject *parent = 0);
+    virtual ~TelemetryTrackObject();
+
+    //pure-virtual from MapGraphicsObject
+    QRectF boundingRect() const;
+
+    //pure-virtual from MapGraphicsObject
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget);
+
+    /**
+     * @brief capacity is how many fixes are kept. Shrinking it drops the oldest ones.
+     */
+    int capacity() const;
+    void setCapacity(int capacity);
+
+    /**
+     * @brief size returns how many fixes are kept right now
+     */
+    int size() const;
+
+    /**
+     * @brief latestFix returns the last fix added, or Position() if there's none
+     */
+    Position latestFix() const;
+
+    QColor color() const;
+    void setColor(const QColor& color);
+
+    /**
+     * @brief lineWidth is the width of the polyline in pixels, regardless of zoom
+     */
+    qreal lineWidth() const;
+    void setLineWidth(qreal width);
+
+    /**
+     * @brief redrawInterval is the least time in milliseconds between two repaints caused by new fixes
+     */
+    int redrawInterval() const;
+    void setRedrawInterval(int msecs);
+
+    /**
+     * @brief displayedVertexCount returns the number of vertices drawn after decimation at the current zoom level
+     */
+    int displayedVertexCount() const;
+
+signals:
+
+public slots:
+    void addFix(const Position& fix);
+    void clear();
+
+protected:
+    //virtual from MapGraphicsObject
+    virtual void zoomLevelChangedEvent(quint8 zoomLevel);
+
+private slots:
+    void handleRedrawTimerTimeout();
+
+private:
+    QPointF fixAt(int index) const;
+    void redraw();
+    void decimate();
+
+    QColor _color;
+    qreal _lineWidth;
+
+    //Fixes in meters around _converter's reference, oldest at _first. Only _count of them are in use.
+    ENUConverter _converter;
+    QVector<QPointF> _ring;
+    int _first;
+    int _count;
+    Position _latestFix;
+
+    //Half-extents of what was last drawn, for boundingRect()
+    qreal _halfWidth;
+    qreal _halfHeight;
+
+    QTimer _redrawTimer;
+    bool _fixesPending;
+
+    //The decimated line for _zoomLevel, rebuilt when _dirty
+    quint8 _zoomLevel;
+    bool _dirty;
+    QPolygonF _decimated;
+    QPainterPath _decimatedPath;
+};
+
+#endif // TELEMETRYTRACKOBJECT_H
@@ -5,8 +5,11 @@
 #include "MapTileSourceDelegate.h"
 
 #include "tileSources/OSMTileSource.h"
+#include "tileSources/WMTSTileSource.h"
 
 #include <QtDebug>
+#include <QInputDialog>
+#include <QUrl>
 #include <QMenu>
 
 CompositeTileSourceConfigurationWidget::CompositeTileSourceConfigurationWidget(QWeakPointer<CompositeTileSource> composite,
@@ -79,6 +82,42 @@ void CompositeTileSourceConfigurationWidget::addOSMTileLayer()
     composite->addSourceTop(source);
 }
 
+//private slot
+void CompositeTileSourceConfigurationWidget::addWMTSTileLayer()
+{
+    QSharedPointer<CompositeTileSource> composite = _composite.toStrongRef();
+    if (composite.isNull())
+        return;
+
+    bool ok = false;
+    const QString urlTemplate = QInputDialog::getText(this, "WMTS Tiles",
+                                                      "Tile URL, with {TileMatrix}, {TileRow} and {TileCol}:",
+                                                      QLineEdit::Normal, QString(), &ok);
+    if (!ok || urlTemplate.isEmpty())
+        return;
+
+    const int metatileSize = QInputDialog::getInt(this, "WMTS Tiles", "Tiles per side of a metatile (1 for none):",
+                                                  1, 1, 16, 1, &ok);
+    if (!ok)
+        return;
+
+    QString metatileUrlTemplate;
+    if (metatileSize > 1)
+    {
+        metatileUrlTemplate = QInputDialog::getText(this, "WMTS Tiles",
+                                                    "Metatile URL, also with {MetaSize}, {MetaCols} and {MetaRows}:",
+                                                    QLineEdit::Normal, urlTemplate, &ok);
+        if (!ok)
+            return;
+    }
+
+    const QString extension = urlTemplate.contains("png", Qt::CaseInsensitive) ? "png" : "jpg";
+    QSharedPointer<WMTSTileSource> source(new WMTSTileSource("WMTS " + QUrl(urlTemplate).host(), urlTemplate,
+                                                             extension));
+    source->setMetatiles(metatileSize, metatileUrlTemplate);
+    composite->addSourceTop(source);
+}
+
 //private slot
 void CompositeTileSourceConfigurationWidget::on_removeSourceButton_clicked()
 {
@@ -184,5 +223,6 @@ void CompositeTileSourceConfigurationWidget::init()
     //Build a menu of possible sources for the "add" button
     QMenu * menu = new QMenu(this->ui->addSourceButton);
     menu->addAction("OpenStreetMap Tiles", this, SLOT(addOSMTileLayer()));
+    menu->addAction("WMTS Tiles...", this, SLOT(addWMTSTileLayer()));
     this->ui->addSourceButton->setMenu(menu);
 }
@@ -1,5 +1,7 @@
 #include "Conversions.h"
 
+#include "ENUConverter.h"
+
 #include <cmath>
 #include <QtDebug>
 
@@ -10,6 +12,151 @@ const qreal NAV_E2 = (2.0-flattening)*flattening;
 const qreal deg2rad = pi/180.0;
 const qreal rad2deg = 180.0/pi;
 
+const qreal B_EARTH = A_EARTH*(1.0 - flattening);
+const qreal NAV_EP2 = NAV_E2/(1.0 - NAV_E2);
+
+//How many Bowring steps xyz2lla() takes. See the error bounds in Conversions.h.
+const int BOWRING_ITERATIONS = 2;
+
+//geodesicDistance() gives up on Vincenty's iteration after this many steps (only ever near antipodes)...
+const int VINCENTY_MAX_ITERATIONS = 100;
+
+//...and otherwise stops once longitude on the auxiliary sphere changes by less than this many radians (~0.01 mm)
+const qreal VINCENTY_TOLERANCE = 1e-12;
+
+//non-member
+static inline bool bowringXYZ2LLA(qreal x, qreal y, qreal z, qreal * lat, qreal * lon, qreal * alt)
+{
+    if (x == 0.0 && y == 0.0 && z == 0.0)
+    {
+        *lat = *lon = *alt = 0.0;
+        return false;
+    }
+
+    const qreal p = sqrt(x*x + y*y);
+
+    //Sine and cosine of the reduced latitude, starting from the spherical guess tan(beta) = z / ((1-f)*p)
+    qreal sbeta = z;
+    qreal cbeta = p*(1.0 - flattening);
+    qreal norm = sqrt(sbeta*sbeta + cbeta*cbeta);
+    sbeta /= norm;
+    cbeta /= norm;
+
+    //Numerator and denominator of tan(latitude). Keeping them apart means no trig until the very end.
+    qreal num = 0.0;
+    qreal den = 0.0;
+    for (int i = 0; i < BOWRING_ITERATIONS; i++)
+    {
+        num = z + NAV_EP2*B_EARTH*sbeta*sbeta*sbeta;
+        den = p - NAV_E2*A_EARTH*cbeta*cbeta*cbeta;
+
+        //tan(beta) = (1-f) * tan(latitude)
+        sbeta = (1.0 - flattening)*num;
+        cbeta = den;
+        norm = sqrt(sbeta*sbeta + cbeta*cbeta);
+        sbeta /= norm;
+        cbeta /= norm;
+    }
+
+    norm = sqrt(num*num + den*den);
+    const qreal slat = num/norm;
+    const qreal clat = den/norm;
+
+    *lat = atan2(num, den)*rad2deg;
+    *lon = (x == 0.0 && y == 0.0) ? 0.0 : atan2(y, x)*rad2deg;
+    //Stays well conditioned at the poles, unlike p / cos(latitude) - N
+    *alt = p*clat + z*slat - A_EARTH*sqrt(1.0 - NAV_E2*slat*slat);
+    return true;
+}
+
+//non-member
+//Longitude difference to - from, in radians, the short way round
+static inline qreal longitudeDelta(qreal fromLon, qreal toLon)
+{
+    qreal toRet = toLon - fromLon;
+    if (toRet > 180.0)
+        toRet -= 360.0;
+    else if (toRet < -180.0)
+        toRet += 360.0;
+    return toRet*deg2rad;
+}
+
+//non-member
+//Distance from the earth's axis and height above the equatorial plane, i.e. ECEF without the longitude
+static inline void meridianCoordinates(qreal lat, qreal alt, qreal * rho, qreal * z)
+{
+    const qreal slat = sin(lat*deg2rad);
+    const qreal clat = cos(lat*deg2rad);
+    const qreal r_n = A_EARTH/sqrt(1.0 - NAV_E2*slat*slat);
+    *rho = (r_n + alt)*clat;
+    *z = (r_n*(1.0 - NAV_E2) + alt)*slat;
+}
+
+//non-member
+static inline qreal chordLength(qreal rho1, qreal z1, qreal rho2, qreal z2, qreal lonDelta)
+{
+    //|p1 - p2|^2 with 1 - cos(dLon) written as 2sin^2(dLon/2), which doesn't cancel for nearby points
+    const qreal dRho = rho1 - rho2;
+    const qreal dZ = z1 - z2;
+    const qreal sHalf = sin(lonDelta/2.0);
+    return sqrt(dRho*dRho + dZ*dZ + 4.0*rho1*rho2*sHalf*sHalf);
+}
+
+//non-member
+//Sine and cosine of the reduced latitude, tan(beta) = (1-f) * tan(latitude), without a tangent to blow up at the poles
+static inline void reducedLatitude(qreal lat, qreal * sbeta, qreal * cbeta)
+{
+    const qreal s = (1.0 - flattening)*sin(lat*deg2rad);
+    const qreal c = cos(lat*deg2rad);
+    const qreal norm = sqrt(s*s + c*c);
+    *sbeta = s/norm;
+    *cbeta = c/norm;
+}
+
+//non-member
+//Vincenty's inverse formula, from reduced latitudes and the longitude difference in radians
+static inline qreal vincentyDistance(qreal sU1, qreal cU1, qreal sU2, qreal cU2, qreal lonDelta)
+{
+    qreal lambda = lonDelta;
+    qreal sSigma = 0.0;
+    qreal cSigma = 1.0;
+    qreal sigma = 0.0;
+    qreal cos2Alpha = 1.0;
+    qreal cos2SigmaM = 0.0;
+    for (int i = 0; i < VINCENTY_MAX_ITERATIONS; i++)
+    {
+        const qreal sLambda = sin(lambda);
+        const qreal cLambda = cos(lambda);
+        const qreal a = cU2*sLambda;
+        const qreal b = cU1*sU2 - sU1*cU2*cLambda;
+        sSigma = sqrt(a*a + b*b);
+        if (sSigma == 0.0)
+            return 0.0;
+        cSigma = sU1*sU2 + cU1*cU2*cLambda;
+        sigma = atan2(sSigma, cSigma);
+
+        const qreal sAlpha = cU1*cU2*sLambda/sSigma;
+        cos2Alpha = 1.0 - sAlpha*sAlpha;
+        //Both ends on the equator
+        cos2SigmaM = (cos2Alpha != 0.0) ? cSigma - 2.0*sU1*sU2/cos2Alpha : 0.0;
+
+        const qreal C = flattening/16.0*cos2Alpha*(4.0 + flattening*(4.0 - 3.0*cos2Alpha));
+        const qreal previous = lambda;
+        lambda = lonDelta + (1.0 - C)*flattening*sAlpha
+                *(sigma + C*sSigma*(cos2SigmaM + C*cSigma*(-1.0 + 2.0*cos2SigmaM*cos2SigmaM)));
+        if (qAbs<qreal>(lambda - previous) < VINCENTY_TOLERANCE)
+            break;
+    }
+
+    const qreal u2 = cos2Alpha*NAV_EP2;
+    const qreal A = 1.0 + u2/16384.0*(4096.0 + u2*(-768.0 + u2*(320.0 - 175.0*u2)));
+    const qreal B = u2/1024.0*(256.0 + u2*(-128.0 + u2*(74.0 - 47.0*u2)));
+    const qreal deltaSigma = B*sSigma*(cos2SigmaM + B/4.0*(cSigma*(-1.0 + 2.0*cos2SigmaM*cos2SigmaM)
+                                                            - B/6.0*cos2SigmaM*(-3.0 + 4.0*sSigma*sSigma)
+                                                            *(-3.0 + 4.0*cos2SigmaM*cos2SigmaM)));
+    return B_EARTH*A*(sigma - deltaSigma);
+}
+
 //static
 QVector3D Conversions::lla2xyz(qreal wlat, qreal wlon, qreal walt)
 {
@@ -45,7 +192,25 @@ Position Conversions::xyz2lla(const QVector3D & v)
     return Conversions::xyz2lla(v.x(),v.y(),v.z());
 }
 
+//static
+Position Conversions::xyz2llaIterative(const QVector3D &v)
+{
+    return Conversions::xyz2llaIterative(v.x(), v.y(), v.z());
+}
+
+//static
 Position Conversions::xyz2lla(qreal x, qreal y, qreal z)
+{
+    qreal lat = 0.0;
+    qreal lon = 0.0;
+    qreal alt = 0.0;
+    if (!bowringXYZ2LLA(x, y, z, &lat, &lon, &alt))
+        qDebug() << "Error: XYZ at center of the earth";
+    return Position(lon, lat, alt);
+}
+
+//static
+Position Conversions::xyz2llaIterative(qreal x, qreal y, qreal z)
 {
     Position toRet;
     toRet.setAltitude(0.0);
@@ -68,7 +233,7 @@ Position Conversions::xyz2lla(qreal x, qreal y, qreal z)
     qreal rhoerror = 1000.0;
     qreal zerror = 1000.0;
 
-    while (abs(rhoerror) > 0.000001 || abs(zerror) > 0.000001)
+    while (qAbs(rhoerror) > 0.000001 || qAbs(zerror) > 0.000001)
     {
         qreal slat = sin(templat);
         qreal clat = cos(templat);
@@ -251,6 +416,160 @@ QVector3D Conversions::lla2enu(const Position & lla, const Position & refLLA)
                                 refLLA.altitude());
 }
 
+//Number of points the batch conversions stage through their stack buffers at a time
+const int BATCH_CHUNK = 64;
+
+//static
+void Conversions::lla2xyz(const qreal *lats, const qreal *lons, const qreal *alts,
+                          int count,
+                          qreal *xs, qreal *ys, qreal *zs)
+{
+    qreal slat[BATCH_CHUNK];
+    qreal clat[BATCH_CHUNK];
+    qreal slon[BATCH_CHUNK];
+    qreal clon[BATCH_CHUNK];
+
+    for (int first = 0; first < count; first += BATCH_CHUNK)
+    {
+        const int n = qMin<int>(BATCH_CHUNK, count - first);
+        const qreal * lat = lats + first;
+        const qreal * lon = lons + first;
+
+        //All of the trig first, in plain loops that the compiler can vectorize
+        for (int i = 0; i < n; i++)
+        {
+            slat[i] = sin(lat[i]*deg2rad);
+            clat[i] = cos(lat[i]*deg2rad);
+        }
+        for (int i = 0; i < n; i++)
+        {
+            slon[i] = sin(lon[i]*deg2rad);
+            clon[i] = cos(lon[i]*deg2rad);
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            const int j = first + i;
+            if (lat[i] < -90.0 || lat[i] > 90.0 || lon[i] < -180.0 || lon[i] > 180.0)
+            {
+                qDebug() << "Lat/Lon out of range" << lat[i] << lon[i];
+                xs[j] = ys[j] = zs[j] = 0.0;
+                continue;
+            }
+
+            const qreal r_n = A_EARTH/sqrt(1.0 - NAV_E2*slat[i]*slat[i]);
+            xs[j] = (r_n + alts[j])*clat[i]*clon[i];
+            ys[j] = (r_n + alts[j])*clat[i]*slon[i];
+            zs[j] = (r_n*(1.0 - NAV_E2) + alts[j])*slat[i];
+        }
+    }
+}
+
+//static
+void Conversions::xyz2lla(const qreal *xs, const qreal *ys, const qreal *zs,
+                          int count,
+                          qreal *lats, qreal *lons, qreal *alts)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (!bowringXYZ2LLA(xs[i], ys[i], zs[i], lats + i, lons + i, alts + i))
+            qDebug() << "Error: XYZ at center of the earth";
+    }
+}
+
+//static
+void Conversions::lla2enu(const qreal *lats, const qreal *lons, const qreal *alts,
+                          int count,
+                          const Position &refLLA,
+                          qreal *easts, qreal *norths, qreal *ups)
+{
+    ENUConverter(refLLA).lla2enu(lats, lons, alts, count, easts, norths, ups);
+}
+
+//static
+void Conversions::enu2lla(const qreal *easts, const qreal *norths, const qreal *ups,
+                          int count,
+                          const Position &refLLA,
+                          qreal *lats, qreal *lons, qreal *alts)
+{
+    ENUConverter(refLLA).enu2lla(easts, norths, ups, count, lats, lons, alts);
+}
+
+//static
+qreal Conversions::equirectangularDistance(const Position &a, const Position &b)
+{
+    //The ellipsoid's radii of curvature at the mean latitude, north-south (meridional) and east-west (prime vertical)
+    const qreal meanLat = (a.latitude() + b.latitude())/2.0*deg2rad;
+    const qreal slat = sin(meanLat);
+    const qreal w = 1.0 - NAV_E2*slat*slat;
+    const qreal r_n = A_EARTH/sqrt(w);
+    const qreal r_m = r_n*(1.0 - NAV_E2)/w;
+
+    const qreal north = (b.latitude() - a.latitude())*deg2rad*r_m;
+    const qreal east = longitudeDelta(a.longitude(), b.longitude())*r_n*cos(meanLat);
+    return sqrt(north*north + east*east);
+}
+
+//static
+qreal Conversions::chordDistance(const Position &a, const Position &b)
+{
+    qreal rho1, z1, rho2, z2;
+    meridianCoordinates(a.latitude(), a.altitude(), &rho1, &z1);
+    meridianCoordinates(b.latitude(), b.altitude(), &rho2, &z2);
+    return chordLength(rho1, z1, rho2, z2, longitudeDelta(a.longitude(), b.longitude()));
+}
+
+//static
+qreal Conversions::geodesicDistance(const Position &a, const Position &b)
+{
+    qreal sU1, cU1, sU2, cU2;
+    reducedLatitude(a.latitude(), &sU1, &cU1);
+    reducedLatitude(b.latitude(), &sU2, &cU2);
+    return vincentyDistance(sU1, cU1, sU2, cU2, longitudeDelta(a.longitude(), b.longitude()));
+}
+
+//static
+void Conversions::distances(const Position &from, const Position *to, int count,
+                            Position::DistanceModel model,
+                            qreal *distances)
+{
+    switch (model)
+    {
+    case Position::LocalENU:
+    {
+        qreal rho1, z1;
+        meridianCoordinates(from.latitude(), from.altitude(), &rho1, &z1);
+        for (int i = 0; i < count; i++)
+        {
+            qreal rho2, z2;
+            meridianCoordinates(to[i].latitude(), to[i].altitude(), &rho2, &z2);
+            distances[i] = chordLength(rho1, z1, rho2, z2, longitudeDelta(from.longitude(), to[i].longitude()));
+        }
+        break;
+    }
+
+    case Position::Geodesic:
+    {
+        qreal sU1, cU1;
+        reducedLatitude(from.latitude(), &sU1, &cU1);
+        for (int i = 0; i < count; i++)
+        {
+            qreal sU2, cU2;
+            reducedLatitude(to[i].latitude(), &sU2, &cU2);
+            distances[i] = vincentyDistance(sU1, cU1, sU2, cU2, longitudeDelta(from.longitude(), to[i].longitude()));
+        }
+        break;
+    }
+
+    default:
+    case Position::Equirectangular:
+        //Each pair has its own mean latitude, so there's nothing about from alone worth keeping
+        for (int i = 0; i < count; i++)
+            distances[i] = Conversions::equirectangularDistance(from, to[i]);
+        break;
+    }
+}
+
 qreal Conversions::degreesLatPerMeter(const qreal latitude)
 {
     const qreal latRad = latitude * (pi / 180.0);
@@ -304,6 +623,14 @@ void Conversions::test()
     else
         qDebug() << "Passed LLA -> XYZ -> LLA";
 
+    Position byu4 = Conversions::xyz2llaIterative(xyz);
+    if (qAbs(byu4.longitude() - byu2.longitude()) > 1e-9 ||
+            qAbs(byu4.latitude() - byu2.latitude()) > 1e-9 ||
+            qAbs(byu4.altitude() - byu2.altitude()) > 1e-4)
+        qDebug() << "Failed Bowring vs. iterative XYZ -> LLA";
+    else
+        qDebug() << "Passed Bowring vs. iterative XYZ -> LLA";
+
     QVector3D enu1(5,5,0);
     Position byu3 = Conversions::enu2lla(enu1,byu1);
     QVector3D enu3 = Conversions::lla2enu(byu3,byu1);
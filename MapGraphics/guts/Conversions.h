@@ -13,9 +13,23 @@ class MAPGRAPHICSSHARED_EXPORT Conversions
 public:
     static QVector3D lla2xyz(qreal wlat, qreal wlon, qreal walt);
     static QVector3D lla2xyz(const Position &lla);
+
+    /**
+     * @brief xyz2lla converts ECEF to WGS84 latitude/longitude/altitude with two steps of Bowring's method, a
+     * fixed amount of work with no loop to converge. From 5 km below the ellipsoid to 40,000 km above it the
+     * latitude is within 1e-13 degrees and the altitude within 0.1 micrometers of the exact answer, i.e. as good
+     * as doubles get. Returns lat/lon/alt 0 for the center of the earth.
+     */
     static Position xyz2lla(const QVector3D &);
     static Position xyz2lla(qreal x, qreal y, qreal z);
 
+    /**
+     * @brief xyz2llaIterative is the Newton iteration xyz2lla() used to be, run until the ECEF error is under a
+     * micrometer. It's slower and kept to check and benchmark xyz2lla() against.
+     */
+    static Position xyz2llaIterative(const QVector3D &);
+    static Position xyz2llaIterative(qreal x, qreal y, qreal z);
+
     static QVector3D xyz2enu(const QVector3D & xyz, qreal reflat, qreal reflon, qreal refalt);
     static QVector3D xyz2enu(const QVector3D & xyz, const Position & refLLA);
     static QVector3D xyz2enu(qreal x, qreal y, qreal z, qreal reflat, qreal reflon, qreal refalt);
@@ -34,6 +48,37 @@ public:
     static QVector3D lla2enu(const Position & lla, qreal reflat, qreal reflon, qreal refalt);
     static QVector3D lla2enu(const Position & lla, const Position & refLLA);
 
+    /*
+     * Batch versions of the above. Each takes separate input and output arrays of count values. The
+     * ENU ones compute the reference frame once for the whole batch (see ENUConverter).
+     */
+    static void lla2xyz(const qreal * lats, const qreal * lons, const qreal * alts,
+                        int count,
+                        qreal * xs, qreal * ys, qreal * zs);
+    static void xyz2lla(const qreal * xs, const qreal * ys, const qreal * zs,
+                        int count,
+                        qreal * lats, qreal * lons, qreal * alts);
+    static void lla2enu(const qreal * lats, const qreal * lons, const qreal * alts,
+                        int count,
+                        const Position & refLLA,
+                        qreal * easts, qreal * norths, qreal * ups);
+    static void enu2lla(const qreal * easts, const qreal * norths, const qreal * ups,
+                        int count,
+                        const Position & refLLA,
+                        qreal * lats, qreal * lons, qreal * alts);
+
+    /*
+     * Distances under each of Position::DistanceModel, with no conversion of either end to ECEF or ENU. See there
+     * for what each costs and how far off it is. The batch version measures from one position to count others and
+     * works out everything that only depends on from once.
+     */
+    static qreal equirectangularDistance(const Position & a, const Position & b);
+    static qreal chordDistance(const Position & a, const Position & b);
+    static qreal geodesicDistance(const Position & a, const Position & b);
+    static void distances(const Position & from, const Position * to, int count,
+                          Position::DistanceModel model,
+                          qreal * distances);
+
     static qreal degreesLatPerMeter(const qreal latitude);
     static qreal degreesLonPerMeter(const qreal latitude);
 
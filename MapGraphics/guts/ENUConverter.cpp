@@ -0,0 +1,128 @@
+#include "ENUConverter.h"
+
+#include "Conversions.h"
+
+#include <QTransform>
+#include <QtDebug>
+
+//Number of points the batch conversions stage through their stack buffers at a time
+const int CHUNK_SIZE = 64;
+
+ENUConverter::ENUConverter(const Position &refLLA) :
+    _refLLA(refLLA)
+{
+    const qreal lat = refLLA.latitude();
+    const qreal lon = refLLA.longitude();
+    const qreal alt = refLLA.altitude();
+    Conversions::lla2xyz(&lat, &lon, &alt, 1, _refXYZ, _refXYZ + 1, _refXYZ + 2);
+
+    //Built exactly the way Conversions::xyz2enu() and Conversions::enu2xyz() build theirs
+    const QTransform R1 = Conversions::rot(90.0 + lon, 3);
+    const QTransform R2 = Conversions::rot(90.0 - lat, 1);
+    const QTransform R = R2*R1;
+    const QTransform invR = R.inverted();
+
+    const qreal rot[9] = {R.m11(), R.m12(), R.m13(),
+                          R.m21(), R.m22(), R.m23(),
+                          R.m31(), R.m32(), R.m33()};
+    const qreal invRot[9] = {invR.m11(), invR.m12(), invR.m13(),
+                             invR.m21(), invR.m22(), invR.m23(),
+                             invR.m31(), invR.m32(), invR.m33()};
+    for (int i = 0; i < 9; i++)
+    {
+        _rot[i] = rot[i];
+        _invRot[i] = invRot[i];
+    }
+
+    _invertible = !invR.isIdentity();
+    if (!_invertible)
+        qDebug() << "Failed to invert rotation matrix --- did you enter a bad lat,lon,or alt?";
+}
+
+const Position &ENUConverter::reference() const
+{
+    return _refLLA;
+}
+
+QVector3D ENUConverter::lla2enu(const Position &lla) const
+{
+    return this->lla2enu(lla.latitude(), lla.longitude(), lla.altitude());
+}
+
+QVector3D ENUConverter::lla2enu(qreal lat, qreal lon, qreal alt) const
+{
+    qreal east, north, up;
+    this->lla2enu(&lat, &lon, &alt, 1, &east, &north, &up);
+    return QVector3D(east, north, up);
+}
+
+Position ENUConverter::enu2lla(const QVector3D &enu) const
+{
+    return this->enu2lla(enu.x(), enu.y(), enu.z());
+}
+
+Position ENUConverter::enu2lla(qreal east, qreal north, qreal up) const
+{
+    qreal lat, lon, alt;
+    this->enu2lla(&east, &north, &up, 1, &lat, &lon, &alt);
+    return Position(lon, lat, alt);
+}
+
+void ENUConverter::lla2enu(const qreal *lats, const qreal *lons, const qreal *alts,
+                           int count,
+                           qreal *easts, qreal *norths, qreal *ups) const
+{
+    qreal xs[CHUNK_SIZE];
+    qreal ys[CHUNK_SIZE];
+    qreal zs[CHUNK_SIZE];
+
+    for (int first = 0; first < count; first += CHUNK_SIZE)
+    {
+        const int n = qMin<int>(CHUNK_SIZE, count - first);
+        Conversions::lla2xyz(lats + first, lons + first, alts + first, n, xs, ys, zs);
+
+        for (int i = 0; i < n; i++)
+        {
+            const qreal dx = xs[i] - _refXYZ[0];
+            const qreal dy = ys[i] - _refXYZ[1];
+            const qreal dz = zs[i] - _refXYZ[2];
+            easts[first + i] = _rot[0]*dx + _rot[1]*dy + _rot[2]*dz;
+            norths[first + i] = _rot[3]*dx + _rot[4]*dy + _rot[5]*dz;
+            ups[first + i] = _rot[6]*dx + _rot[7]*dy + _rot[8]*dz;
+        }
+    }
+}
+
+void ENUConverter::enu2lla(const qreal *easts, const qreal *norths, const qreal *ups,
+                           int count,
+                           qreal *lats, qreal *lons, qreal *alts) const
+{
+    qreal xs[CHUNK_SIZE];
+    qreal ys[CHUNK_SIZE];
+    qreal zs[CHUNK_SIZE];
+
+    for (int first = 0; first < count; first += CHUNK_SIZE)
+    {
+        const int n = qMin<int>(CHUNK_SIZE, count - first);
+        for (int i = 0; i < n; i++)
+        {
+            const int j = first + i;
+
+            //Conversions::enu2xyz() hands the ENU vector back unchanged if it can't invert the rotation
+            if (_invertible)
+            {
+                xs[i] = _invRot[0]*easts[j] + _invRot[1]*norths[j] + _invRot[2]*ups[j] + _refXYZ[0];
+                ys[i] = _invRot[3]*easts[j] + _invRot[4]*norths[j] + _invRot[5]*ups[j] + _refXYZ[1];
+                zs[i] = _invRot[6]*easts[j] + _invRot[7]*norths[j] + _invRot[8]*ups[j] + _refXYZ[2];
+            }
+            else
+            {
+                xs[i] = easts[j];
+                ys[i] = norths[j];
+                zs[i] = ups[j];
+            }
+        }
+
+        Conversions::xyz2lla(xs, ys, zs, n, lats + first, lons + first, alts + first);
+    }
+}
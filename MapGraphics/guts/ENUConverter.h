@@ -0,0 +1,54 @@
+#ifndef ENUCONVERTER_H
+#define ENUCONVERTER_H
+
+#include <QVector3D>
+
+#include "MapGraphics_global.h"
+#include "Position.h"
+
+/**
+ * @brief The ENUConverter class converts between lat/lon/alt and east/north/up around one fixed reference
+ * point. The reference point's XYZ position and the ENU rotation are computed once in the constructor
+ * instead of on every conversion like Conversions::lla2enu() and Conversions::enu2lla() do.
+ *
+ * Everything is computed in qreal, so results agree with the Conversions functions to within the
+ * precision of the QVector3D (float) intermediates those use.
+ */
+class MAPGRAPHICSSHARED_EXPORT ENUConverter
+{
+public:
+    ENUConverter(const Position& refLLA = Position());
+
+    const Position& reference() const;
+
+    QVector3D lla2enu(const Position& lla) const;
+    QVector3D lla2enu(qreal lat, qreal lon, qreal alt) const;
+
+    Position enu2lla(const QVector3D& enu) const;
+    Position enu2lla(qreal east, qreal north, qreal up) const;
+
+    /**
+     * @brief lla2enu converts count points at once. Inputs and outputs are separate arrays of count values.
+     */
+    void lla2enu(const qreal * lats, const qreal * lons, const qreal * alts,
+                 int count,
+                 qreal * easts, qreal * norths, qreal * ups) const;
+
+    /**
+     * @brief enu2lla converts count points at once. Inputs and outputs are separate arrays of count values.
+     */
+    void enu2lla(const qreal * easts, const qreal * norths, const qreal * ups,
+                 int count,
+                 qreal * lats, qreal * lons, qreal * alts) const;
+
+private:
+    Position _refLLA;
+    qreal _refXYZ[3];
+
+    //Row-major 3x3 rotations from XYZ offsets to ENU and back
+    qreal _rot[9];
+    qreal _invRot[9];
+    bool _invertible;
+};
+
+#endif // ENUCONVERTER_H
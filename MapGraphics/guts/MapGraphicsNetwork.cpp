@@ -31,6 +31,11 @@ QNetworkReply *MapGraphicsNetwork::get(QNetworkRequest &request)
 {
     request.setRawHeader("User-Agent",
                          _userAgent);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, _http2Allowed);
+#elif QT_VERSION >= QT_VERSION_CHECK(5, 8, 0)
+    request.setAttribute(QNetworkRequest::HTTP2AllowedAttribute, _http2Allowed);
+#endif
     QNetworkReply * toRet = _manager->get(request);
     return toRet;
 }
@@ -45,8 +50,19 @@ QByteArray MapGraphicsNetwork::userAgent() const
     return _userAgent;
 }
 
+void MapGraphicsNetwork::setHttp2Allowed(bool allowed)
+{
+    _http2Allowed = allowed;
+}
+
+bool MapGraphicsNetwork::http2Allowed() const
+{
+    return _http2Allowed;
+}
+
 //protected
-MapGraphicsNetwork::MapGraphicsNetwork()
+MapGraphicsNetwork::MapGraphicsNetwork() :
+    _http2Allowed(true)
 {
     _manager = new QNetworkAccessManager();
     this->setUserAgent(DEFAULT_USER_AGENT);
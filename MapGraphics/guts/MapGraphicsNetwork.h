@@ -17,6 +17,13 @@ public:
     void setUserAgent(const QByteArray& agent);
     QByteArray userAgent() const;
 
+    /**
+     * @brief http2Allowed is whether requests may use HTTP/2 when the server supports it, so that all the
+     * tiles from one host share one connection. Needs Qt 5.8 or later and is ignored otherwise.
+     */
+    void setHttp2Allowed(bool allowed);
+    bool http2Allowed() const;
+
 protected:
     MapGraphicsNetwork();
 
@@ -26,6 +33,7 @@ private:
     QNetworkAccessManager * _manager;
 
     QByteArray _userAgent;
+    bool _http2Allowed;
 };
 
 #endif // MAPGRAPHICSNETWORK_H
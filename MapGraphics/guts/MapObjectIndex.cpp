@@ -0,0 +1,148 @@
+#include "MapObjectIndex.h"
+
+#include <cmath>
+
+//About a kilometer on a side, which is the size of most of what goes on the map
+const qreal CELL_DEGREES = 0.01;
+
+//Objects that would be listed in more cells than this are checked by every lookup instead
+const int MAX_OBJECT_CELLS = 64;
+
+MapObjectIndex::MapObjectIndex()
+{
+}
+
+void MapObjectIndex::insert(MapGraphicsObject *object, const QRectF &geoBounds)
+{
+    const QRect cells = this->_cellsFor(geoBounds);
+    const bool large = (qint64)cells.width() * cells.height() > MAX_OBJECT_CELLS;
+
+    //Moving within the same cells (the common case while dragging) doesn't change anything
+    if (_objectCells.contains(object))
+    {
+        const QRect old = _objectCells.value(object);
+        if ((large && old.isNull()) || (!large && old == cells))
+            return;
+        this->remove(object);
+    }
+
+    if (large)
+    {
+        _objectCells.insert(object, QRect());
+        _large.insert(object);
+        return;
+    }
+
+    _objectCells.insert(object, cells);
+    for (int x = cells.left(); x <= cells.right(); x++)
+        for (int y = cells.top(); y <= cells.bottom(); y++)
+            _cells[_cellKey(x, y)].append(object);
+}
+
+void MapObjectIndex::remove(MapGraphicsObject *object)
+{
+    if (!_objectCells.contains(object))
+        return;
+
+    const QRect cells = _objectCells.take(object);
+    if (cells.isNull())
+    {
+        _large.remove(object);
+        return;
+    }
+
+    for (int x = cells.left(); x <= cells.right(); x++)
+    {
+        for (int y = cells.top(); y <= cells.bottom(); y++)
+        {
+            const quint64 key = _cellKey(x, y);
+            QList<MapGraphicsObject *>& cell = _cells[key];
+            cell.removeOne(object);
+            if (cell.isEmpty())
+                _cells.remove(key);
+        }
+    }
+}
+
+bool MapObjectIndex::contains(MapGraphicsObject *object) const
+{
+    return _objectCells.contains(object);
+}
+
+QList<MapGraphicsObject *> MapObjectIndex::query(const QRectF &geoRect) const
+{
+    QList<MapGraphicsObject *> toRet = _large.toList();
+
+    const QRect cells = this->_cellsFor(geoRect);
+
+    //Objects spanning several cells would be found more than once
+    QSet<MapGraphicsObject *> found;
+
+    //A zoomed-out view covers far more cells than have anything in them, so go through the ones that do
+    if ((qint64)cells.width() * cells.height() > _cells.size())
+    {
+        QHash<quint64, QList<MapGraphicsObject *> >::const_iterator cell;
+        for (cell = _cells.constBegin(); cell != _cells.constEnd(); cell++)
+        {
+            const int x = (int)(quint32)(cell.key() >> 32);
+            const int y = (int)(quint32)cell.key();
+            if (!cells.contains(x, y))
+                continue;
+            foreach(MapGraphicsObject * object, cell.value())
+            {
+                if (found.contains(object))
+                    continue;
+                found.insert(object);
+                toRet.append(object);
+            }
+        }
+        return toRet;
+    }
+
+    for (int x = cells.left(); x <= cells.right(); x++)
+    {
+        for (int y = cells.top(); y <= cells.bottom(); y++)
+        {
+            QHash<quint64, QList<MapGraphicsObject *> >::const_iterator cell = _cells.constFind(_cellKey(x, y));
+            if (cell == _cells.constEnd())
+                continue;
+            foreach(MapGraphicsObject * object, cell.value())
+            {
+                if (found.contains(object))
+                    continue;
+                found.insert(object);
+                toRet.append(object);
+            }
+        }
+    }
+    return toRet;
+}
+
+int MapObjectIndex::size() const
+{
+    return _objectCells.size();
+}
+
+void MapObjectIndex::clear()
+{
+    _cells.clear();
+    _objectCells.clear();
+    _large.clear();
+}
+
+//private
+QRect MapObjectIndex::_cellsFor(const QRectF &geoBounds) const
+{
+    const QRectF normalized = geoBounds.normalized();
+    const int left = (int)floor(normalized.left() / CELL_DEGREES);
+    const int right = (int)floor(normalized.right() / CELL_DEGREES);
+    const int top = (int)floor(normalized.top() / CELL_DEGREES);
+    const int bottom = (int)floor(normalized.bottom() / CELL_DEGREES);
+    return QRect(QPoint(left, top), QPoint(right, bottom));
+}
+
+//private static
+quint64 MapObjectIndex::_cellKey(int x, int y)
+{
+    return ((quint64)(quint32)x << 32) | (quint32)y;
+}
@@ -0,0 +1,57 @@
+#ifndef MAPOBJECTINDEX_H
+#define MAPOBJECTINDEX_H
+
+#include <QHash>
+#include <QList>
+#include <QRect>
+#include <QRectF>
+#include <QSet>
+
+class MapGraphicsObject;
+
+/**
+ * @brief The MapObjectIndex class finds a MapGraphicsScene's objects by where they are on the globe.
+ *
+ * It's a uniform grid in longitude/latitude: each object is listed in the cells its geographic bounds
+ * overlap, so a lookup only looks at the objects near the point or rectangle asked about. Unlike a
+ * QGraphicsScene's BSP tree it doesn't depend on the zoom level and moving one object only touches the cells
+ * it left and entered. Objects that would cover too many cells (big areas) are kept in a short list that every
+ * lookup checks.
+ */
+class MapObjectIndex
+{
+public:
+    MapObjectIndex();
+
+    /**
+     * @brief insert lists object under geoBounds, a (longitude, latitude) rectangle, replacing where it was
+     * listed before
+     */
+    void insert(MapGraphicsObject * object, const QRectF& geoBounds);
+
+    void remove(MapGraphicsObject * object);
+
+    bool contains(MapGraphicsObject * object) const;
+
+    /**
+     * @brief query returns the objects whose bounds may intersect geoRect. Every object that does is
+     * included, along with some nearby ones that don't.
+     */
+    QList<MapGraphicsObject *> query(const QRectF& geoRect) const;
+
+    int size() const;
+
+    void clear();
+
+private:
+    QRect _cellsFor(const QRectF& geoBounds) const;
+    static quint64 _cellKey(int x, int y);
+
+    QHash<quint64, QList<MapGraphicsObject *> > _cells;
+
+    //The cells each object is listed in. Big objects have a null rect and are in _large instead
+    QHash<MapGraphicsObject *, QRect> _objectCells;
+    QSet<MapGraphicsObject *> _large;
+};
+
+#endif // MAPOBJECTINDEX_H
@@ -0,0 +1,190 @@
+#include "MapRenderProfiler.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QList>
+#include <QMetaObject>
+#include <QPair>
+#include <QStringList>
+#include <algorithm>
+
+//How many of the most recent frames are kept
+const int FRAME_HISTORY = 240;
+
+const qreal NSECS_PER_MSEC = 1000000.0;
+
+MapRenderProfiler::ClassStatistics::ClassStatistics() :
+    paints(0), paintNsecs(0), maxPaintNsecs(0), boundingRects(0), boundingRectMisses(0), boundingRectNsecs(0)
+{
+}
+
+MapRenderProfiler::FrameStatistics::FrameStatistics() :
+    frames(0), meanMsecs(0.0), medianMsecs(0.0), p95Msecs(0.0), maxMsecs(0.0), framesPerSecond(0.0)
+{
+}
+
+MapRenderProfiler::MapRenderProfiler() :
+    _frameTimes(FRAME_HISTORY, 0), _frameStarts(FRAME_HISTORY, 0), _nextFrame(0), _frameCount(0), _frameStart(0)
+{
+    _clock.start();
+}
+
+void MapRenderProfiler::beginFrame()
+{
+    _frameStart = _clock.nsecsElapsed();
+}
+
+void MapRenderProfiler::endFrame()
+{
+    _frameTimes[_nextFrame] = _clock.nsecsElapsed() - _frameStart;
+    _frameStarts[_nextFrame] = _frameStart;
+    _nextFrame = (_nextFrame + 1) % FRAME_HISTORY;
+    _frameCount = qMin(_frameCount + 1, FRAME_HISTORY);
+}
+
+void MapRenderProfiler::addPaint(const QMetaObject *type, qint64 nsecs)
+{
+    ClassStatistics& statistics = _classes[type];
+    statistics.paints++;
+    statistics.paintNsecs += nsecs;
+    statistics.maxPaintNsecs = qMax(statistics.maxPaintNsecs, nsecs);
+}
+
+void MapRenderProfiler::addBoundingRectHit(const QMetaObject *type)
+{
+    _classes[type].boundingRects++;
+}
+
+void MapRenderProfiler::addBoundingRectMiss(const QMetaObject *type, qint64 nsecs)
+{
+    ClassStatistics& statistics = _classes[type];
+    statistics.boundingRects++;
+    statistics.boundingRectMisses++;
+    statistics.boundingRectNsecs += nsecs;
+}
+
+QVector<qint64> MapRenderProfiler::frameTimes() const
+{
+    QVector<qint64> toRet;
+    toRet.reserve(_frameCount);
+    const int first = (_nextFrame - _frameCount + FRAME_HISTORY) % FRAME_HISTORY;
+    for (int i = 0; i < _frameCount; i++)
+        toRet.append(_frameTimes.at((first + i) % FRAME_HISTORY));
+    return toRet;
+}
+
+MapRenderProfiler::FrameStatistics MapRenderProfiler::frameStatistics() const
+{
+    FrameStatistics toRet;
+    QVector<qint64> times = this->frameTimes();
+    toRet.frames = times.size();
+    if (times.isEmpty())
+        return toRet;
+
+    std::sort(times.begin(), times.end());
+    qint64 total = 0;
+    foreach(qint64 time, times)
+        total += time;
+
+    toRet.meanMsecs = total / NSECS_PER_MSEC / times.size();
+    toRet.medianMsecs = times.at(times.size() / 2) / NSECS_PER_MSEC;
+    toRet.p95Msecs = times.at(qMin(times.size() - 1, (int) (times.size() * 0.95))) / NSECS_PER_MSEC;
+    toRet.maxMsecs = times.last() / NSECS_PER_MSEC;
+
+    const int first = (_nextFrame - _frameCount + FRAME_HISTORY) % FRAME_HISTORY;
+    const int last = (_nextFrame - 1 + FRAME_HISTORY) % FRAME_HISTORY;
+    const qint64 span = _frameStarts.at(last) - _frameStarts.at(first);
+    if (_frameCount > 1 && span > 0)
+        toRet.framesPerSecond = (_frameCount - 1) * 1e9 / span;
+    return toRet;
+}
+
+QMap<QString, MapRenderProfiler::ClassStatistics> MapRenderProfiler::classStatistics() const
+{
+    QMap<QString, ClassStatistics> toRet;
+    QHash<const QMetaObject *, ClassStatistics>::const_iterator iter;
+    for (iter = _classes.constBegin(); iter != _classes.constEnd(); iter++)
+        toRet.insert(iter.key()->className(), iter.value());
+    return toRet;
+}
+
+void MapRenderProfiler::reset()
+{
+    _nextFrame = 0;
+    _frameCount = 0;
+    _classes.clear();
+}
+
+QString MapRenderProfiler::summary(int maxClasses) const
+{
+    const FrameStatistics frames = this->frameStatistics();
+    QStringList lines;
+    lines << QString("Frames: %1 fps, %2 ms mean, %3 ms p95, %4 ms max (last %5)")
+             .arg(frames.framesPerSecond, 0, 'f', 1)
+             .arg(frames.meanMsecs, 0, 'f', 2)
+             .arg(frames.p95Msecs, 0, 'f', 2)
+             .arg(frames.maxMsecs, 0, 'f', 2)
+             .arg(frames.frames);
+
+    //Costliest first
+    QList<QPair<qint64, QString> > order;
+    const QMap<QString, ClassStatistics> classes = this->classStatistics();
+    QMap<QString, ClassStatistics>::const_iterator iter;
+    for (iter = classes.constBegin(); iter != classes.constEnd(); iter++)
+        order.append(QPair<qint64, QString>(-(iter.value().paintNsecs + iter.value().boundingRectNsecs), iter.key()));
+    std::sort(order.begin(), order.end());
+
+    for (int i = 0; i < order.size() && i < maxClasses; i++)
+    {
+        const ClassStatistics& statistics = classes[order.at(i).second];
+        lines << QString("%1: paint %2 ms in %3, max %4 ms; bounds %5 ms in %6 of %7")
+                 .arg(order.at(i).second)
+                 .arg(statistics.paintNsecs / NSECS_PER_MSEC, 0, 'f', 1)
+                 .arg(statistics.paints)
+                 .arg(statistics.maxPaintNsecs / NSECS_PER_MSEC, 0, 'f', 2)
+                 .arg(statistics.boundingRectNsecs / NSECS_PER_MSEC, 0, 'f', 1)
+                 .arg(statistics.boundingRectMisses)
+                 .arg(statistics.boundingRects);
+    }
+    return lines.join("\n");
+}
+
+QByteArray MapRenderProfiler::toJson() const
+{
+    const FrameStatistics frames = this->frameStatistics();
+    QJsonObject frameObject;
+    frameObject.insert("frames", frames.frames);
+    frameObject.insert("mean_ms", frames.meanMsecs);
+    frameObject.insert("median_ms", frames.medianMsecs);
+    frameObject.insert("p95_ms", frames.p95Msecs);
+    frameObject.insert("max_ms", frames.maxMsecs);
+    frameObject.insert("fps", frames.framesPerSecond);
+
+    QJsonArray times;
+    foreach(qint64 time, this->frameTimes())
+        times.append(time / NSECS_PER_MSEC);
+    frameObject.insert("times_ms", times);
+
+    QJsonArray classArray;
+    const QMap<QString, ClassStatistics> classes = this->classStatistics();
+    QMap<QString, ClassStatistics>::const_iterator iter;
+    for (iter = classes.constBegin(); iter != classes.constEnd(); iter++)
+    {
+        const ClassStatistics& statistics = iter.value();
+        QJsonObject classObject;
+        classObject.insert("class", iter.key());
+        classObject.insert("paints", (double) statistics.paints);
+        classObject.insert("paint_ms", statistics.paintNsecs / NSECS_PER_MSEC);
+        classObject.insert("max_paint_ms", statistics.maxPaintNsecs / NSECS_PER_MSEC);
+        classObject.insert("bounding_rects", (double) statistics.boundingRects);
+        classObject.insert("bounding_rect_misses", (double) statistics.boundingRectMisses);
+        classObject.insert("bounding_rect_ms", statistics.boundingRectNsecs / NSECS_PER_MSEC);
+        classArray.append(classObject);
+    }
+
+    QJsonObject toRet;
+    toRet.insert("frames", frameObject);
+    toRet.insert("classes", classArray);
+    return QJsonDocument(toRet).toJson();
+}
@@ -0,0 +1,103 @@
+#ifndef MAPRENDERPROFILER_H
+#define MAPRENDERPROFILER_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMap>
+#include <QString>
+#include <QVector>
+
+#include "MapGraphics_global.h"
+
+struct QMetaObject;
+
+/**
+ * @brief The MapRenderProfiler class collects where a MapGraphicsView's frames go: how long each frame took to
+ * paint, and how much of that (and of working out bounding rects) each class of object on the map accounts
+ * for. Tiles are counted as MapTileGraphicsObject and everything else under its MapGraphicsObject subclass,
+ * e.g. PolygonObject.
+ *
+ * Turn it on with MapGraphicsView::setRenderProfiling(). It's only touched from the GUI thread. Timing a paint
+ * costs a few tens of nanoseconds, and bounding rects are only timed when they have to be recomputed.
+ */
+class MAPGRAPHICSSHARED_EXPORT MapRenderProfiler
+{
+public:
+    struct ClassStatistics
+    {
+        ClassStatistics();
+
+        qint64 paints;
+        qint64 paintNsecs;
+        qint64 maxPaintNsecs;
+
+        //Calls, and how many of them had to recompute the rect instead of returning the cached one
+        qint64 boundingRects;
+        qint64 boundingRectMisses;
+        qint64 boundingRectNsecs;
+    };
+
+    struct FrameStatistics
+    {
+        FrameStatistics();
+
+        //Over the frames still in the history
+        int frames;
+        qreal meanMsecs;
+        qreal medianMsecs;
+        qreal p95Msecs;
+        qreal maxMsecs;
+
+        //How often frames were painted, from the time between them
+        qreal framesPerSecond;
+    };
+
+    MapRenderProfiler();
+
+    //Called by the view around each paint event
+    void beginFrame();
+    void endFrame();
+
+    void addPaint(const QMetaObject * type, qint64 nsecs);
+    void addBoundingRectHit(const QMetaObject * type);
+    void addBoundingRectMiss(const QMetaObject * type, qint64 nsecs);
+
+    /**
+     * @brief frameTimes returns how long the most recent frames took to paint, oldest first, in nanoseconds
+     */
+    QVector<qint64> frameTimes() const;
+    MapRenderProfiler::FrameStatistics frameStatistics() const;
+
+    /**
+     * @brief classStatistics returns what each class of object added up to since the last reset(), by class name
+     */
+    QMap<QString, MapRenderProfiler::ClassStatistics> classStatistics() const;
+
+    void reset();
+
+    /**
+     * @brief summary returns a few lines on the frame times and the costliest classes, for an overlay
+     * @param maxClasses how many classes to list, most paint time first
+     */
+    QString summary(int maxClasses = 6) const;
+
+    /**
+     * @brief toJson returns everything collected as JSON: the frame statistics and times, and the classes
+     */
+    QByteArray toJson() const;
+
+private:
+    //Ring buffers of the last FRAME_HISTORY frames' paint times and start times, in nanoseconds
+    QVector<qint64> _frameTimes;
+    QVector<qint64> _frameStarts;
+    int _nextFrame;
+    int _frameCount;
+
+    QElapsedTimer _clock;
+    qint64 _frameStart;
+
+    QHash<const QMetaObject *, ClassStatistics> _classes;
+};
+
+#endif // MAPRENDERPROFILER_H
@@ -0,0 +1,122 @@
+#include "MapTileCacheDirectory.h"
+
+#include <QDir>
+#include <QMutexLocker>
+#include <QStringBuilder>
+#include <QStringList>
+#include <QtDebug>
+
+MapTileCacheDirectory::MapTileCacheDirectory()
+{
+}
+
+void MapTileCacheDirectory::setRoot(const QString &root, const QString &extension)
+{
+    QMutexLocker lock(&_lock);
+    _prefix = root % "/";
+    _extension = extension;
+    _madeColumns.clear();
+}
+
+bool MapTileCacheDirectory::isNull() const
+{
+    QMutexLocker lock(&_lock);
+    return _prefix.isEmpty();
+}
+
+QString MapTileCacheDirectory::root() const
+{
+    QMutexLocker lock(&_lock);
+    return _prefix.left(_prefix.size() - 1);
+}
+
+QString MapTileCacheDirectory::extension() const
+{
+    QMutexLocker lock(&_lock);
+    return _extension;
+}
+
+QString MapTileCacheDirectory::columnPath(quint32 x, quint8 z) const
+{
+    QMutexLocker lock(&_lock);
+    return _prefix % QString::number(z) % "/" % QString::number(x);
+}
+
+QString MapTileCacheDirectory::tilePath(quint32 x, quint32 y, quint8 z) const
+{
+    QMutexLocker lock(&_lock);
+    return _prefix % QString::number(z) % "/" % QString::number(x) % "/" % QString::number(y) % "." % _extension;
+}
+
+bool MapTileCacheDirectory::tileKey(const QString &path, MapTileKey *key) const
+{
+    QMutexLocker lock(&_lock);
+    const QString suffix = "." % _extension;
+    if (!path.startsWith(_prefix) || !path.endsWith(suffix))
+        return false;
+
+    //What's left is z/x/y
+    const QStringList parts = path.mid(_prefix.size(), path.size() - _prefix.size() - suffix.size()).split('/');
+    if (parts.size() != 3)
+        return false;
+
+    bool ok = true;
+    const uint z = parts.at(0).toUInt(&ok);
+    if (!ok || z > 0xFF)
+        return false;
+    const quint32 x = parts.at(1).toUInt(&ok);
+    if (!ok)
+        return false;
+    const quint32 y = parts.at(2).toUInt(&ok);
+    if (!ok)
+        return false;
+
+    *key = MapTileKey(x, y, (quint8) z);
+    return true;
+}
+
+bool MapTileCacheDirectory::ensureColumn(quint32 x, quint8 z)
+{
+    const quint64 key = _columnKey(x, z);
+    QMutexLocker lock(&_lock);
+    if (_madeColumns.contains(key))
+        return true;
+    lock.unlock();
+
+    //mkpath() is happy with directories that already exist, so there's no need to check first
+    const QString path = this->columnPath(x, z);
+    if (!QDir().mkpath(path))
+    {
+        qWarning() << "Failed to create cache directory" << path;
+        return false;
+    }
+
+    lock.relock();
+    _madeColumns.insert(key);
+    return true;
+}
+
+void MapTileCacheDirectory::ensureColumns(const QList<MapTileKey> &keys)
+{
+    QSet<quint64> done;
+    foreach(const MapTileKey& key, keys)
+    {
+        const quint64 column = _columnKey(key.x(), key.z());
+        if (done.contains(column))
+            continue;
+        done.insert(column);
+        this->ensureColumn(key.x(), key.z());
+    }
+}
+
+void MapTileCacheDirectory::forgetColumn(quint32 x, quint8 z)
+{
+    QMutexLocker lock(&_lock);
+    _madeColumns.remove(_columnKey(x, z));
+}
+
+//private static
+quint64 MapTileCacheDirectory::_columnKey(quint32 x, quint8 z)
+{
+    return ((quint64)z << 32) | x;
+}
@@ -0,0 +1,79 @@
+#ifndef MAPTILECACHEDIRECTORY_H
+#define MAPTILECACHEDIRECTORY_H
+
+#include <QString>
+#include <QSet>
+#include <QList>
+#include <QMutex>
+
+#include "MapTileKey.h"
+
+/**
+ * @brief The MapTileCacheDirectory class lays out a tile source's file disk cache: one directory per zoom level
+ * and column, one file per tile. It builds paths from tile coordinates without touching the disk and remembers
+ * which column directories it has already made, so each is only checked for and created once.
+ *
+ * It's thread-safe: MapTileSource reads through it while its disk cache writer creates directories.
+ */
+class MapTileCacheDirectory
+{
+public:
+    MapTileCacheDirectory();
+
+    /**
+     * @brief setRoot sets the directory the cache lives in and the extension of the tile files, and forgets
+     * which directories were made.
+     * @param root
+     * @param extension
+     */
+    void setRoot(const QString& root, const QString& extension);
+
+    bool isNull() const;
+
+    QString root() const;
+    QString extension() const;
+
+    /**
+     * @brief columnPath returns the directory that holds column x of zoom level z
+     */
+    QString columnPath(quint32 x, quint8 z) const;
+
+    /**
+     * @brief tilePath returns the file tile (x, y, z) is cached in
+     */
+    QString tilePath(quint32 x, quint32 y, quint8 z) const;
+
+    /**
+     * @brief tileKey is the reverse of tilePath(). Returns false if path isn't a tile file of ours.
+     */
+    bool tileKey(const QString& path, MapTileKey * key) const;
+
+    /**
+     * @brief ensureColumn creates column x of zoom level z unless it already made it. Returns false if it
+     * couldn't be created.
+     */
+    bool ensureColumn(quint32 x, quint8 z);
+
+    /**
+     * @brief ensureColumns makes sure the columns of all of keys exist, creating each missing one once
+     */
+    void ensureColumns(const QList<MapTileKey>& keys);
+
+    /**
+     * @brief forgetColumn makes the next ensureColumn() for the column check the disk again, e.g. because
+     * writing into it failed
+     */
+    void forgetColumn(quint32 x, quint8 z);
+
+private:
+    static quint64 _columnKey(quint32 x, quint8 z);
+
+    //Everything up to and including the separator before the zoom level
+    QString _prefix;
+    QString _extension;
+
+    QSet<quint64> _madeColumns;
+    mutable QMutex _lock;
+};
+
+#endif // MAPTILECACHEDIRECTORY_H
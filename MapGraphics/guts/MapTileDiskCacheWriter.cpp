@@ -0,0 +1,464 @@
+#include "MapTileDiskCacheWriter.h"
+
+#include "MapTilePackCache.h"
+#include "MapTileCacheDirectory.h"
+#include "MapTileExpirationStore.h"
+
+#include <QThread>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDirIterator>
+#include <QMutexLocker>
+#include <QStringBuilder>
+#include <QtDebug>
+#include <algorithm>
+
+//How many tiles to write per batch. The pack is flushed and its lock released once per batch
+const int WRITE_BATCH_SIZE = 32;
+
+//Enough for about a thousand typical encoded tiles
+const qint64 DEFAULT_MAX_QUEUED_BYTES = 16 * 1024 * 1024;
+
+const QString ACCESS_LOG_FILE_NAME = "cacheAccesses.log";
+
+//Tile files whose stamp is at most this old aren't stamped again, so browsing the same tiles doesn't keep
+//appending to the access log
+const int ACCESS_STAMP_RESOLUTION_SECS = 300;
+
+//Evicting goes a bit below the quota so that it isn't needed again after every few tiles
+const int QUOTA_LOW_WATER_PERCENT = 90;
+
+//A tile file found while counting the cache
+struct CachedTileFile
+{
+    MapTileKey key;
+    QString path;
+    qint64 size;
+    qint64 usedMSecs;
+};
+
+//non-member
+static bool usedEarlier(const CachedTileFile& a, const CachedTileFile& b)
+{
+    return a.usedMSecs < b.usedMSecs;
+}
+
+MapTileDiskCacheWriter::MapTileDiskCacheWriter(QObject *parent) :
+    QObject(parent), _thread(0), _queuedBytes(0), _maxQueuedBytes(DEFAULT_MAX_QUEUED_BYTES),
+    _processScheduled(false), _quota(0), _pack(0), _packLock(0), _directory(0),
+    _accessLog(0), _accessLogFailed(false), _fileBytes(-1)
+{
+    connect(this,
+            SIGNAL(writesQueued()),
+            this,
+            SLOT(processQueue()),
+            Qt::QueuedConnection);
+}
+
+MapTileDiskCacheWriter::~MapTileDiskCacheWriter()
+{
+    this->stop();
+
+    //The log saves whatever is left as it's deleted
+    if (_accessLog != 0)
+        delete _accessLog;
+    _accessLog = 0;
+}
+
+void MapTileDiskCacheWriter::start()
+{
+    if (_thread != 0)
+        return;
+
+    _thread = new QThread();
+    _thread->start();
+    this->moveToThread(_thread);
+}
+
+void MapTileDiskCacheWriter::stop()
+{
+    if (_thread != 0)
+    {
+        _thread->quit();
+        _thread->wait();
+        delete _thread;
+        _thread = 0;
+    }
+
+    //Nobody else is writing now, so finish the queue ourselves
+    while (this->processBatch(WRITE_BATCH_SIZE))
+        continue;
+
+    QMutexLocker lock(&_writeLock);
+    this->recordAccesses();
+}
+
+void MapTileDiskCacheWriter::setPackCache(MapTilePackCache *pack, QMutex *packLock)
+{
+    QMutexLocker lock(&_writeLock);
+    _pack = pack;
+    _packLock = packLock;
+}
+
+void MapTileDiskCacheWriter::setCacheDirectory(MapTileCacheDirectory *directory)
+{
+    QMutexLocker lock(&_writeLock);
+    _directory = directory;
+}
+
+void MapTileDiskCacheWriter::enqueue(const MapTileKey &key, const QString &filePath, const QByteArray &encodedTile,
+                                     const QDateTime &expireTime)
+{
+    QMutexLocker lock(&_queueLock);
+
+    //It's on its way to disk already
+    if (_pending.contains(key))
+        return;
+
+    //Back-pressure. Without our own thread, whoever would wait here is the one who has to do the writing
+    while (_thread != 0 && _queuedBytes > 0 && _queuedBytes + encodedTile.size() > _maxQueuedBytes)
+        _queueNotFull.wait(&_queueLock);
+
+    WriteJob job;
+    job.key = key;
+    job.filePath = filePath;
+    job.encodedTile = encodedTile;
+    job.expireTime = expireTime;
+    _queue.enqueue(job);
+    _pending.insert(key, encodedTile);
+    _queuedBytes += encodedTile.size();
+    this->scheduleProcessing(&lock);
+}
+
+QByteArray MapTileDiskCacheWriter::pending(const MapTileKey &key) const
+{
+    QMutexLocker lock(&_queueLock);
+    return _pending.value(key);
+}
+
+qint64 MapTileDiskCacheWriter::queuedBytes() const
+{
+    QMutexLocker lock(&_queueLock);
+    return _queuedBytes;
+}
+
+qint64 MapTileDiskCacheWriter::maxQueuedBytes() const
+{
+    QMutexLocker lock(&_queueLock);
+    return _maxQueuedBytes;
+}
+
+void MapTileDiskCacheWriter::setMaxQueuedBytes(qint64 bytes)
+{
+    QMutexLocker lock(&_queueLock);
+    _maxQueuedBytes = qMax<qint64>(0, bytes);
+    _queueNotFull.wakeAll();
+}
+
+void MapTileDiskCacheWriter::noteAccess(const MapTileKey &key)
+{
+    QMutexLocker lock(&_queueLock);
+    _accessed.insert(key);
+    this->scheduleProcessing(&lock);
+}
+
+qint64 MapTileDiskCacheWriter::quota() const
+{
+    QMutexLocker lock(&_queueLock);
+    return _quota;
+}
+
+void MapTileDiskCacheWriter::setQuota(qint64 bytes)
+{
+    //Checked straight away, in case the cache is over it already
+    QMutexLocker lock(&_queueLock);
+    _quota = qMax<qint64>(0, bytes);
+    this->scheduleProcessing(&lock);
+}
+
+//private slot
+void MapTileDiskCacheWriter::processQueue()
+{
+    while (this->processBatch(WRITE_BATCH_SIZE))
+        continue;
+
+    //Once the writes have caught up
+    QMutexLocker lock(&_writeLock);
+    this->recordAccesses();
+    this->enforceQuota();
+}
+
+//private
+bool MapTileDiskCacheWriter::processBatch(int maxJobs)
+{
+    QMutexLocker lock(&_queueLock);
+    QList<WriteJob> jobs;
+    while (!_queue.isEmpty() && jobs.size() < maxJobs)
+        jobs.append(_queue.dequeue());
+
+    //Clearing the flag under the same lock as the empty check means enqueue() can't miss its chance to reschedule
+    if (jobs.isEmpty())
+    {
+        _processScheduled = false;
+        return false;
+    }
+    lock.unlock();
+
+    this->writeJobs(jobs);
+
+    //Only forget the tiles now that they're readable from disk
+    lock.relock();
+    foreach(const WriteJob& job, jobs)
+    {
+        _pending.remove(job.key);
+        _queuedBytes -= job.encodedTile.size();
+    }
+    _queueNotFull.wakeAll();
+    return true;
+}
+
+//private
+void MapTileDiskCacheWriter::writeJobs(const QList<WriteJob> &jobs)
+{
+    QMutexLocker lock(&_writeLock);
+    if (_pack == 0)
+    {
+        //Each directory the batch writes into is made (or found) once for the whole batch
+        if (_directory != 0)
+        {
+            QList<MapTileKey> keys;
+            foreach(const WriteJob& job, jobs)
+                keys.append(job.key);
+            _directory->ensureColumns(keys);
+        }
+
+        QList<MapTileKey> written;
+        foreach(const WriteJob& job, jobs)
+        {
+            this->writeFile(job);
+            written.append(job.key);
+        }
+        this->stampFiles(written);
+        return;
+    }
+
+    QMutexLocker packLock(_packLock);
+    foreach(const WriteJob& job, jobs)
+        this->writePack(job);
+
+    QString error;
+    if (!_pack->flush(&error))
+        qWarning() << "Failed to flush tile pack:" << error;
+}
+
+//private
+void MapTileDiskCacheWriter::writeFile(const WriteJob &job)
+{
+    //If we've already cached something, do not cache it again
+    QFile fp(job.filePath);
+    if (fp.exists())
+        return;
+
+    //Directories are only created the first time a tile lands in them. If one has gone since, make it again
+    if (!fp.open(QFile::WriteOnly))
+    {
+        if (_directory != 0)
+            _directory->forgetColumn(job.key.x(), job.key.z());
+        QDir().mkpath(QFileInfo(job.filePath).absolutePath());
+        if (!fp.open(QFile::WriteOnly))
+        {
+            qWarning() << "Failed to put" << job.key << "into disk cache:" << fp.errorString();
+            return;
+        }
+    }
+
+    if (fp.write(job.encodedTile) != job.encodedTile.size())
+    {
+        qWarning() << "Failed to put" << job.key << "into disk cache:" << fp.errorString();
+        fp.close();
+        fp.remove();
+        return;
+    }
+
+    if (_fileBytes >= 0)
+        _fileBytes += job.encodedTile.size();
+}
+
+//private
+void MapTileDiskCacheWriter::writePack(const WriteJob &job)
+{
+    //If we've already cached something, do not cache it again
+    if (_pack->contains(job.key))
+        return;
+
+    QString error;
+    if (!_pack->insert(job.key, job.encodedTile, job.expireTime, &error))
+        qWarning() << "Failed to put" << job.key << "into tile pack:" << error;
+}
+
+//private
+void MapTileDiskCacheWriter::recordAccesses()
+{
+    QMutexLocker lock(&_queueLock);
+    const QList<MapTileKey> accessed = _accessed.toList();
+    _accessed.clear();
+    lock.unlock();
+
+    if (accessed.isEmpty())
+        return;
+
+    if (_pack == 0)
+    {
+        this->stampFiles(accessed);
+        return;
+    }
+
+    QMutexLocker packLock(_packLock);
+    foreach(const MapTileKey& key, accessed)
+        _pack->touch(key);
+}
+
+//private
+void MapTileDiskCacheWriter::stampFiles(const QList<MapTileKey> &keys)
+{
+    MapTileExpirationStore * log = this->accessLog();
+    if (log == 0)
+        return;
+
+    const QDateTime now = QDateTime::currentDateTimeUtc();
+    foreach(const MapTileKey& key, keys)
+    {
+        const QDateTime stamped = log->value(key);
+        if (stamped.isNull() || stamped.secsTo(now) > ACCESS_STAMP_RESOLUTION_SECS)
+            log->insert(key, now);
+    }
+
+    QString error;
+    if (!log->flush(&error))
+        qWarning() << "Failed to save tile access times:" << error;
+}
+
+//private
+void MapTileDiskCacheWriter::enforceQuota()
+{
+    QMutexLocker lock(&_queueLock);
+    const qint64 quota = _quota;
+    lock.unlock();
+
+    if (quota <= 0)
+        return;
+
+    if (_pack != 0)
+    {
+        QMutexLocker packLock(_packLock);
+        if (_pack->dataSize() <= quota)
+            return;
+
+        int evicted = 0;
+        QString error;
+        if (!_pack->trim(quota * QUOTA_LOW_WATER_PERCENT / 100, &evicted, &error))
+            qWarning() << "Failed to trim tile pack:" << error;
+        else
+            qDebug() << "Evicted" << evicted << "tiles from tile pack to stay within" << quota << "bytes";
+        return;
+    }
+
+    //Until the cache has been counted we can't tell, and after that only once it's grown past the quota
+    if (_directory == 0 || (_fileBytes >= 0 && _fileBytes <= quota))
+        return;
+    this->trimFiles(quota);
+}
+
+//private
+void MapTileDiskCacheWriter::trimFiles(qint64 quota)
+{
+    MapTileExpirationStore * log = this->accessLog();
+    const QString root = _directory->root();
+
+    QList<CachedTileFile> files;
+    _fileBytes = 0;
+    QDirIterator iter(root, QStringList("*." % _directory->extension()), QDir::Files,
+                      QDirIterator::Subdirectories);
+    while (iter.hasNext())
+    {
+        iter.next();
+        const QFileInfo info = iter.fileInfo();
+
+        CachedTileFile file;
+        if (!_directory->tileKey(info.filePath(), &file.key))
+            continue;
+        file.path = info.filePath();
+        file.size = info.size();
+
+        //Tiles cached before we kept stamps count as used when they were written
+        QDateTime used;
+        if (log != 0)
+            used = log->value(file.key);
+        if (used.isNull())
+            used = info.lastModified();
+        file.usedMSecs = used.toMSecsSinceEpoch();
+
+        files.append(file);
+        _fileBytes += file.size;
+    }
+
+    if (_fileBytes <= quota)
+        return;
+
+    //Least recently used first
+    std::sort(files.begin(), files.end(), usedEarlier);
+    const qint64 target = quota * QUOTA_LOW_WATER_PERCENT / 100;
+    int evicted = 0;
+    foreach(const CachedTileFile& file, files)
+    {
+        if (_fileBytes <= target)
+            break;
+        if (!QFile::remove(file.path))
+            continue;
+
+        _fileBytes -= file.size;
+        evicted++;
+        if (log != 0)
+            log->remove(file.key);
+    }
+
+    QString error;
+    if (log != 0 && !log->flush(&error))
+        qWarning() << "Failed to save tile access times:" << error;
+    qDebug() << "Evicted" << evicted << "tiles from" << root << "to stay within" << quota << "bytes";
+}
+
+//private
+MapTileExpirationStore *MapTileDiskCacheWriter::accessLog()
+{
+    if (_accessLog != 0 || _accessLogFailed || _directory == 0)
+        return _accessLog;
+
+    QString error;
+    _accessLog = new MapTileExpirationStore();
+    if (!_accessLog->open(_directory->root() % "/" % ACCESS_LOG_FILE_NAME, &error))
+    {
+        qWarning() << "Failed to open tile access log:" << error;
+        delete _accessLog;
+        _accessLog = 0;
+
+        //Don't keep trying on every batch. Eviction falls back on when the files were written
+        _accessLogFailed = true;
+    }
+    return _accessLog;
+}
+
+//private
+void MapTileDiskCacheWriter::scheduleProcessing(QMutexLocker *lock)
+{
+    if (_processScheduled)
+    {
+        lock->unlock();
+        return;
+    }
+    _processScheduled = true;
+    lock->unlock();
+
+    this->writesQueued();
+}
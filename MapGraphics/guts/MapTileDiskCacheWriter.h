@@ -0,0 +1,154 @@
+#ifndef MAPTILEDISKCACHEWRITER_H
+#define MAPTILEDISKCACHEWRITER_H
+
+#include <QObject>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QHash>
+#include <QSet>
+#include <QByteArray>
+#include <QDateTime>
+#include <QString>
+
+#include "MapTileKey.h"
+
+class QThread;
+class MapTilePackCache;
+class MapTileCacheDirectory;
+class MapTileExpirationStore;
+
+/**
+ * @brief The MapTileDiskCacheWriter class writes encoded tiles to a MapTileSource's disk cache from a
+ * thread of its own, so that a tile can be handed to the client without waiting for the disk.
+ *
+ * Writes are queued by enqueue() and written in batches. The queue holds at most maxQueuedBytes(); once
+ * it's full, enqueue() blocks until the writer catches up, so a slow disk slows down fetching rather than
+ * letting the queue grow without bound. Tiles still in the queue can be read back with pending().
+ *
+ * Tiles go to one file each (the path given to enqueue()) unless setPackCache() was called, in which
+ * case they go to the pack. Everything except the private slot is thread-safe.
+ *
+ * The writer also keeps the cache within its quota. Tiles are stamped with when they were last written or
+ * noteAccess()ed: in the pack's index, or in an access log (cacheAccesses.log) next to the tile files. Once
+ * the cache grows past the quota, the tiles used longest ago are deleted until it's back under 90% of it.
+ * Packs know their size. Files are counted by walking the cache directory, which happens on the first check
+ * and then only once the bytes written since suggest the cache has grown past the quota again.
+ */
+class MapTileDiskCacheWriter : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MapTileDiskCacheWriter(QObject *parent = 0);
+    virtual ~MapTileDiskCacheWriter();
+
+    /**
+     * @brief start moves the writer into a new thread of its own. stop() ends it.
+     */
+    void start();
+
+    /**
+     * @brief stop writes anything still queued and ends the writer's thread. Call it before destroying
+     * the writer.
+     */
+    void stop();
+
+    /**
+     * @brief setPackCache makes the writer put tiles into pack, holding packLock while doing so. Whoever
+     * reads from the pack must hold packLock too.
+     */
+    void setPackCache(MapTilePackCache * pack, QMutex * packLock);
+
+    /**
+     * @brief setCacheDirectory makes the writer create the directories of each batch of tile files through
+     * directory, once per directory, instead of checking for them file by file
+     */
+    void setCacheDirectory(MapTileCacheDirectory * directory);
+
+    /**
+     * @brief enqueue queues a tile to be written. filePath is ignored when writing to a pack. Blocks while
+     * the queue is full.
+     */
+    void enqueue(const MapTileKey& key, const QString& filePath, const QByteArray& encodedTile,
+                 const QDateTime& expireTime);
+
+    /**
+     * @brief pending returns the bytes of a tile that's queued but not written yet, or a null QByteArray
+     */
+    QByteArray pending(const MapTileKey& key) const;
+
+    qint64 queuedBytes() const;
+    qint64 maxQueuedBytes() const;
+    void setMaxQueuedBytes(qint64 bytes);
+
+    /**
+     * @brief noteAccess tells the writer that the tile was just used, so that it's evicted later
+     */
+    void noteAccess(const MapTileKey& key);
+
+    /**
+     * @brief quota returns how many bytes the cache may take up on disk, or 0 if it may grow without bound
+     */
+    qint64 quota() const;
+    void setQuota(qint64 bytes);
+
+signals:
+    //Used internally to get queued writes processed in the writer's thread
+    void writesQueued();
+
+private slots:
+    void processQueue();
+
+private:
+    struct WriteJob
+    {
+        MapTileKey key;
+        QString filePath;
+        QByteArray encodedTile;
+        QDateTime expireTime;
+    };
+
+    //Writes up to maxJobs of the oldest queued tiles. Returns false if there were none
+    bool processBatch(int maxJobs);
+
+    void writeJobs(const QList<WriteJob>& jobs);
+    void writeFile(const WriteJob& job);
+    void writePack(const WriteJob& job);
+
+    //Call these with _writeLock held
+    void recordAccesses();
+    void stampFiles(const QList<MapTileKey>& keys);
+    void enforceQuota();
+    void trimFiles(qint64 quota);
+    MapTileExpirationStore * accessLog();
+
+    //Schedules processQueue() unless it already is. Call with _queueLock held; returns with it released
+    void scheduleProcessing(QMutexLocker * lock);
+
+    QThread * _thread;
+
+    mutable QMutex _queueLock;
+    QWaitCondition _queueNotFull;
+    QQueue<WriteJob> _queue;
+    QHash<MapTileKey, QByteArray> _pending;
+    qint64 _queuedBytes;
+    qint64 _maxQueuedBytes;
+    bool _processScheduled;
+
+    //Tiles used since their stamps were last updated, and the quota. Also protected by _queueLock
+    QSet<MapTileKey> _accessed;
+    qint64 _quota;
+
+    //Held while a batch is being written, so that stop() can't race a batch in progress
+    QMutex _writeLock;
+    MapTilePackCache * _pack;
+    QMutex * _packLock;
+    MapTileCacheDirectory * _directory;
+
+    //For tile files only. The log is opened the first time it's needed, and the size is -1 until it's counted
+    MapTileExpirationStore * _accessLog;
+    bool _accessLogFailed;
+    qint64 _fileBytes;
+};
+
+#endif // MAPTILEDISKCACHEWRITER_H
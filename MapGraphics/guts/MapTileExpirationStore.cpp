@@ -0,0 +1,305 @@
+#include "MapTileExpirationStore.h"
+
+#include <QDataStream>
+#include <QStringList>
+#include <QStringBuilder>
+#include <QtDebug>
+#include <cstring>
+
+//The log starts with a magic number and version, followed by RECORD_SIZE-byte (quint64 key, quint32 epoch) records.
+//An epoch of REMOVED_EPOCH means the tile was forgotten
+const quint32 EXPIRATION_MAGIC = 0x58454748;
+const quint32 EXPIRATION_VERSION = 1;
+const qint64 EXPIRATION_HEADER_SIZE = 8;
+const qint64 RECORD_SIZE = 12;
+const quint32 REMOVED_EPOCH = 0;
+
+//Rewrite the log once it holds this many more records than tiles, and twice as many
+const qint64 COMPACT_MIN_SUPERSEDED = 65536;
+
+//non-member
+static bool legacyCacheID2Key(const QString& cacheID, MapTileKey * key)
+{
+    const QStringList list = cacheID.split(',');
+    if (list.size() != 3)
+        return false;
+
+    bool ok = true;
+    const quint32 x = list.at(0).toUInt(&ok);
+    if (!ok)
+        return false;
+    const quint32 y = list.at(1).toUInt(&ok);
+    if (!ok)
+        return false;
+    const quint32 z = list.at(2).toUInt(&ok);
+    if (!ok || z > 0xFF)
+        return false;
+
+    *key = MapTileKey(x,y,z);
+    return true;
+}
+
+//non-member
+static void appendRecord(QByteArray * buffer, quint64 key, quint32 epoch)
+{
+    char record[RECORD_SIZE];
+    memcpy(record, &key, sizeof(key));
+    memcpy(record + sizeof(key), &epoch, sizeof(epoch));
+    buffer->append(record, RECORD_SIZE);
+}
+
+MapTileExpirationStore::MapTileExpirationStore() :
+    _records(0)
+{
+}
+
+MapTileExpirationStore::~MapTileExpirationStore()
+{
+    QString error;
+    if (this->isOpen() && !this->flush(&error))
+        qWarning() << "Failed to save cache expirations:" << error;
+}
+
+bool MapTileExpirationStore::open(const QString &path, QString *errorString)
+{
+    QString dummy;
+    if (errorString == 0)
+        errorString = &dummy;
+
+    _file.close();
+    _expirations.clear();
+    _unflushed.clear();
+    _records = 0;
+
+    _file.setFileName(path);
+    if (!_file.open(QIODevice::ReadWrite))
+    {
+        *errorString = "Failed to open " % path % ": " % _file.errorString();
+        return false;
+    }
+
+    quint32 header[2] = {0, 0};
+    const qint64 size = _file.size();
+    if (size >= EXPIRATION_HEADER_SIZE)
+        _file.read((char *)header, EXPIRATION_HEADER_SIZE);
+
+    //Start over on anything we don't recognize. It only costs us expiration times
+    if (header[0] != EXPIRATION_MAGIC || header[1] != EXPIRATION_VERSION)
+    {
+        if (size > 0)
+            qWarning() << "Unrecognized cache expiration log" << path << "- starting a new one";
+        header[0] = EXPIRATION_MAGIC;
+        header[1] = EXPIRATION_VERSION;
+        if (!_file.resize(0)
+                || !_file.seek(0)
+                || _file.write((const char *)header, EXPIRATION_HEADER_SIZE) != EXPIRATION_HEADER_SIZE
+                || !_file.flush())
+        {
+            *errorString = "Failed to initialize " % path % ": " % _file.errorString();
+            _file.close();
+            return false;
+        }
+        return true;
+    }
+
+    //A crash can leave half a record at the end. Drop it so that appends stay aligned
+    _records = (size - EXPIRATION_HEADER_SIZE) / RECORD_SIZE;
+    const qint64 validSize = EXPIRATION_HEADER_SIZE + _records * RECORD_SIZE;
+    if (validSize != size && !_file.resize(validSize))
+    {
+        *errorString = "Failed to truncate " % path % ": " % _file.errorString();
+        _file.close();
+        return false;
+    }
+
+    if (_records == 0)
+        return true;
+
+    uchar * mapped = _file.map(0, validSize);
+    if (mapped == 0)
+    {
+        *errorString = "Failed to map " % path % ": " % _file.errorString();
+        _file.close();
+        return false;
+    }
+
+    _expirations.reserve(_records);
+    const uchar * record = mapped + EXPIRATION_HEADER_SIZE;
+    for (qint64 i = 0; i < _records; i++, record += RECORD_SIZE)
+    {
+        quint64 key;
+        quint32 epoch;
+        memcpy(&key, record, sizeof(key));
+        memcpy(&epoch, record + sizeof(key), sizeof(epoch));
+        if (epoch == REMOVED_EPOCH)
+            _expirations.remove(MapTileKey::fromUInt64(key));
+        else
+            _expirations.insert(MapTileKey::fromUInt64(key), epoch);
+    }
+    _file.unmap(mapped);
+
+    return true;
+}
+
+bool MapTileExpirationStore::importLegacy(const QString &legacyPath)
+{
+    QFile fp(legacyPath);
+    if (!fp.open(QIODevice::ReadOnly))
+        return false;
+
+    QHash<QString, QDateTime> stored;
+    QDataStream stream(&fp);
+    stream >> stored;
+    if (stream.status() != QDataStream::Ok)
+        return false;
+
+    QHash<QString, QDateTime>::const_iterator iter;
+    for (iter = stored.constBegin(); iter != stored.constEnd(); iter++)
+    {
+        MapTileKey key;
+        if (!legacyCacheID2Key(iter.key(), &key) || this->contains(key))
+            continue;
+        this->insert(key, iter.value());
+    }
+    return true;
+}
+
+bool MapTileExpirationStore::isOpen() const
+{
+    return _file.isOpen();
+}
+
+int MapTileExpirationStore::count() const
+{
+    return _expirations.size();
+}
+
+bool MapTileExpirationStore::contains(const MapTileKey &key) const
+{
+    return _expirations.contains(key);
+}
+
+QDateTime MapTileExpirationStore::value(const MapTileKey &key) const
+{
+    if (!_expirations.contains(key))
+        return QDateTime();
+
+    return QDateTime::fromMSecsSinceEpoch(1000 * (qint64)_expirations.value(key)).toUTC();
+}
+
+void MapTileExpirationStore::insert(const MapTileKey &key, const QDateTime &expireTime)
+{
+    const quint32 epoch = MapTileExpirationStore::toEpoch(expireTime);
+    if (_expirations.contains(key) && _expirations.value(key) == epoch)
+        return;
+
+    _expirations.insert(key, epoch);
+    appendRecord(&_unflushed, key.toUInt64(), epoch);
+}
+
+void MapTileExpirationStore::remove(const MapTileKey &key)
+{
+    if (_expirations.remove(key) == 0)
+        return;
+    appendRecord(&_unflushed, key.toUInt64(), REMOVED_EPOCH);
+}
+
+bool MapTileExpirationStore::flush(QString *errorString)
+{
+    QString dummy;
+    if (errorString == 0)
+        errorString = &dummy;
+
+    if (!this->isOpen())
+    {
+        *errorString = "Cache expiration log is not open";
+        return false;
+    }
+
+    if (_unflushed.isEmpty())
+        return true;
+
+    const qint64 newRecords = _unflushed.size() / RECORD_SIZE;
+    const qint64 superseded = _records + newRecords - _expirations.size();
+    if (superseded >= COMPACT_MIN_SUPERSEDED && superseded > _expirations.size())
+        return this->compact(errorString);
+
+    const qint64 end = EXPIRATION_HEADER_SIZE + _records * RECORD_SIZE;
+    if (!_file.seek(end)
+            || _file.write(_unflushed) != _unflushed.size()
+            || !_file.flush())
+    {
+        *errorString = "Failed to append to " % _file.fileName() % ": " % _file.errorString();
+
+        //Don't leave a partial append behind for the next one to land after
+        _file.resize(end);
+        return false;
+    }
+
+    _records += newRecords;
+    _unflushed.clear();
+    return true;
+}
+
+bool MapTileExpirationStore::hasUnflushedChanges() const
+{
+    return !_unflushed.isEmpty();
+}
+
+//private
+bool MapTileExpirationStore::compact(QString *errorString)
+{
+    QByteArray contents;
+    contents.reserve(EXPIRATION_HEADER_SIZE + _expirations.size() * RECORD_SIZE);
+    const quint32 header[2] = {EXPIRATION_MAGIC, EXPIRATION_VERSION};
+    contents.append((const char *)header, EXPIRATION_HEADER_SIZE);
+
+    QHash<MapTileKey, quint32>::const_iterator iter;
+    for (iter = _expirations.constBegin(); iter != _expirations.constEnd(); iter++)
+        appendRecord(&contents, iter.key().toUInt64(), iter.value());
+
+    //Write the new log next to the old one and swap them, so a failure leaves the old one intact
+    const QString path = _file.fileName();
+    QFile compacted(path % ".compact");
+    if (!compacted.open(QIODevice::WriteOnly | QIODevice::Truncate)
+            || compacted.write(contents) != contents.size()
+            || !compacted.flush())
+    {
+        *errorString = "Failed to write " % compacted.fileName() % ": " % compacted.errorString();
+        compacted.close();
+        compacted.remove();
+        return false;
+    }
+    compacted.close();
+
+    _file.close();
+    const bool replaced = QFile::remove(path) && QFile::rename(compacted.fileName(), path);
+    if (!replaced)
+    {
+        *errorString = "Failed to replace " % path % " with its compacted copy";
+        compacted.remove();
+    }
+
+    //Either way, reopen whatever is there now. Our changes stay queued if the swap failed
+    _file.setFileName(path);
+    if (!_file.open(QIODevice::ReadWrite))
+    {
+        *errorString = "Failed to reopen " % path % ": " % _file.errorString();
+        return false;
+    }
+    if (!replaced)
+        return false;
+
+    _records = _expirations.size();
+    _unflushed.clear();
+    return true;
+}
+
+//private static
+quint32 MapTileExpirationStore::toEpoch(const QDateTime &time)
+{
+    if (!time.isValid())
+        return 0;
+    const qint64 seconds = time.toMSecsSinceEpoch() / 1000;
+    return (quint32)qBound<qint64>(0, seconds, 0xFFFFFFFFLL);
+}
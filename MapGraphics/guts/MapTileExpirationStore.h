@@ -0,0 +1,79 @@
+#ifndef MAPTILEEXPIRATIONSTORE_H
+#define MAPTILEEXPIRATIONSTORE_H
+
+#include <QString>
+#include <QHash>
+#include <QByteArray>
+#include <QDateTime>
+#include <QFile>
+
+#include "MapTileKey.h"
+
+/**
+ * @brief The MapTileExpirationStore class remembers when each cached tile expires, as a 32-bit UTC epoch
+ * per MapTileKey. The disk cache writer keeps a second one of when each tile file was last used.
+ *
+ * On disk it's an append-only log of fixed-size (key, expiry) records in which the last record for a key
+ * wins. Opening the store scans the memory-mapped log once. Changes are buffered and appended by flush(),
+ * so a crash loses at most the changes since the last flush. Once most of the log is superseded records,
+ * flush() rewrites it with one record per tile.
+ *
+ * Not thread-safe. MapTileSource only uses it from its own thread.
+ */
+class MapTileExpirationStore
+{
+public:
+    MapTileExpirationStore();
+    ~MapTileExpirationStore();
+
+    /**
+     * @brief open loads the log at path, creating it if it doesn't exist. Returns true on success, false
+     * on failure with an explanation in errorString.
+     */
+    bool open(const QString& path, QString * errorString = 0);
+
+    /**
+     * @brief importLegacy merges in the expirations from a cacheExpirations.db written by older versions
+     * (a QDataStream of QHash<QString, QDateTime> keyed by "x,y,z"). Returns false if it can't be read.
+     */
+    bool importLegacy(const QString& legacyPath);
+
+    bool isOpen() const;
+    int count() const;
+
+    bool contains(const MapTileKey& key) const;
+
+    /**
+     * @brief value returns when the tile expires, or a null QDateTime if we don't know
+     */
+    QDateTime value(const MapTileKey& key) const;
+    void insert(const MapTileKey& key, const QDateTime& expireTime);
+
+    /**
+     * @brief remove forgets the tile, e.g. because it's been deleted from the cache
+     */
+    void remove(const MapTileKey& key);
+
+    /**
+     * @brief flush appends the changes made since the last flush to the log. Returns true on success,
+     * false on failure with an explanation in errorString (the changes are kept for the next attempt).
+     */
+    bool flush(QString * errorString = 0);
+
+    bool hasUnflushedChanges() const;
+
+private:
+    bool compact(QString * errorString);
+    static quint32 toEpoch(const QDateTime& time);
+
+    QFile _file;
+    QHash<MapTileKey, quint32> _expirations;
+
+    //Records appended since the last flush, already in their on-disk form
+    QByteArray _unflushed;
+
+    //How many records the log holds, superseded ones included
+    qint64 _records;
+};
+
+#endif // MAPTILEEXPIRATIONSTORE_H
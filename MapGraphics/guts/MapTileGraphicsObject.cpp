@@ -1,17 +1,24 @@
 #include "MapTileGraphicsObject.h"
+#include "MapTilePlaceholders.h"
+#include "MapRenderProfiler.h"
 
+#include <QElapsedTimer>
 #include <QPainter>
 #include <QtDebug>
 
 MapTileGraphicsObject::MapTileGraphicsObject(quint16 tileSize)
 {
     this->setTileSize(tileSize);
-    _tile = 0;
+    _haveTile = false;
+    _havePlaceholder = false;
+    _placeholders = 0;
+    _renderProfiler = 0;
     _tileX = 0;
     _tileY = 0;
     _tileZoom = 0;
     _initialized = false;
     _havePendingRequest = false;
+    _requestToken = 0;
 
     //Default z-value is important --- used in MapGraphicsView
     this->setZValue(-1.0);
@@ -19,11 +26,7 @@ MapTileGraphicsObject::MapTileGraphicsObject(quint16 tileSize)
 
 MapTileGraphicsObject::~MapTileGraphicsObject()
 {
-    if (_tile != 0)
-    {
-        delete _tile;
-        _tile = 0;
-    }
+    this->cancelPendingRequest();
 }
 
 QRectF MapTileGraphicsObject::boundingRect() const
@@ -40,10 +43,14 @@ void MapTileGraphicsObject::paint(QPainter *painter, const QStyleOptionGraphicsI
     Q_UNUSED(option)
     Q_UNUSED(widget)
 
-    //If we've got a tile, draw it. Otherwise, show a loading or "No tile source" message
-    if (_tile != 0)
+    QElapsedTimer clock;
+    if (_renderProfiler != 0)
+        clock.start();
+
+    //If we've got a tile (or something to stand in for it), draw it. Otherwise, show a loading or "No tile source" message
+    if (_haveTile || _havePlaceholder)
         painter->drawPixmap(this->boundingRect().toRect(),
-                            *_tile);
+                            _tile);
     else
     {
         QString string;
@@ -55,6 +62,9 @@ void MapTileGraphicsObject::paint(QPainter *painter, const QStyleOptionGraphicsI
                           string,
                           QTextOption(Qt::AlignCenter));
     }
+
+    if (_renderProfiler != 0)
+        _renderProfiler->addPaint(this->metaObject(), clock.nsecsElapsed());
 }
 
 quint16 MapTileGraphicsObject::tileSize() const
@@ -75,12 +85,15 @@ void MapTileGraphicsObject::setTile(quint32 x, quint32 y, quint8 z, bool force)
     if (_tileX == x && _tileY == y && _tileZoom == z && !force && _initialized)
         return;
 
-    //Get rid of the old tile
-    if (_tile != 0)
-    {
-        delete _tile;
-        _tile = 0;
-    }
+    /*
+      If we're still waiting on a tile, withdraw that request only after making the new one. Re-requesting
+      the same tile (force=true) then shares the fetch that's underway rather than cancelling it.
+    */
+    const bool hadPendingRequest = _havePendingRequest;
+    const quint64 oldToken = _requestToken;
+
+    //Stop showing the old tile, but hang on to its pixmap for the new one
+    _haveTile = false;
 
     //Store information for the tile we're requesting
     _tileX = x;
@@ -88,22 +101,42 @@ void MapTileGraphicsObject::setTile(quint32 x, quint32 y, quint8 z, bool force)
     _tileZoom = z;
     _initialized = true;
 
+    //Until it arrives, show what the zoom levels around it have
+    _havePlaceholder = _placeholders != 0 && _placeholders->placeholder(x, y, z, _tileSize, &_tile);
+
     //If we have a null tile source, there's not much more to do!
     if (_tileSource.isNull())
+    {
+        _havePendingRequest = false;
         return;
-
-    //If our tile source is good, connect to the signal we'll need to get the result after requesting
-    connect(_tileSource.data(),
-            SIGNAL(tileRetrieved(quint32,quint32,quint8)),
-            this,
-            SLOT(handleTileRetrieved(quint32,quint32,quint8)));
+    }
 
     //Make sure we know that we're requesting a tile
     _havePendingRequest = true;
 
-    //Request the tile from tileSource, which will emit tileRetrieved when finished
+    //Request the tile from tileSource, which hands it straight to handleTileDelivered() when finished
     //qDebug() << this << "requests" << x << y << z;
-    _tileSource->requestTile(x,y,z);
+    _requestToken = _tileSource->requestTile(x,y,z,MapTileSource::VisiblePriority,
+                                             this, "handleTileDelivered");
+    if (hadPendingRequest)
+        _tileSource->cancelTileRequest(oldToken);
+}
+
+void MapTileGraphicsObject::cancelPendingRequest()
+{
+    if (!_havePendingRequest)
+        return;
+    _havePendingRequest = false;
+
+    if (_tileSource.isNull())
+        return;
+    _tileSource->cancelTileRequest(_requestToken);
+    _requestToken = 0;
+}
+
+bool MapTileGraphicsObject::isWaitingForTile() const
+{
+    return _havePendingRequest;
 }
 
 QSharedPointer<MapTileSource> MapTileGraphicsObject::tileSource() const
@@ -114,16 +147,17 @@ QSharedPointer<MapTileSource> MapTileGraphicsObject::tileSource() const
 void MapTileGraphicsObject::setTileSource(QSharedPointer<MapTileSource> nSource)
 {
     //Disconnect from the old source, if applicable
+    this->cancelPendingRequest();
     if (!_tileSource.isNull())
     {
-        QObject::disconnect(_tileSource.data(),
-                            SIGNAL(tileRetrieved(quint32,quint32,quint8)),
-                            this,
-                            SLOT(handleTileRetrieved(quint32,quint32,quint8)));
         QObject::disconnect(_tileSource.data(),
                             SIGNAL(allTilesInvalidated()),
                             this,
                             SLOT(handleTileInvalidation()));
+        QObject::disconnect(_tileSource.data(),
+                            SIGNAL(tilesInvalidated(QRectF)),
+                            this,
+                            SLOT(handleTileInvalidation(QRectF)));
     }
 
     //Set the new source
@@ -137,69 +171,59 @@ void MapTileGraphicsObject::setTileSource(QSharedPointer<MapTileSource> nSource)
                 SIGNAL(allTilesInvalidated()),
                 this,
                 SLOT(handleTileInvalidation()));
-        //We connect/disconnect the "tileRetrieved" signal as needed and don't do it here!
+        connect(_tileSource.data(),
+                SIGNAL(tilesInvalidated(QRectF)),
+                this,
+                SLOT(handleTileInvalidation(QRectF)));
     }
 
     //Force a refresh from the new source
     this->handleTileInvalidation();
 }
 
-//private slot
-void MapTileGraphicsObject::handleTileRetrieved(quint32 x, quint32 y, quint8 z)
+void MapTileGraphicsObject::setPlaceholders(MapTilePlaceholders *placeholders)
 {
-    //If we don't care about retrieved tiles (i.e., we haven't requested a tile), return
-    //This shouldn't actually happen as the signal/slot should get disconnected
-    if (!_havePendingRequest)
-        return;
-
-    //If this isn't the tile we're looking for, return
-    else if (_tileX != x || _tileY != y || _tileZoom != z)
-        return;
+    _placeholders = placeholders;
+}
 
-    //Now we know that our tile has been retrieved by the MapTileSource. We just need to get it.
-    _havePendingRequest = false;
+void MapTileGraphicsObject::setRenderProfiler(MapRenderProfiler *profiler)
+{
+    _renderProfiler = profiler;
+}
 
-    //Make sure some mischevious person hasn't set our MapTileSource to null while we weren't looking...
-    if (_tileSource.isNull())
+//private slot
+void MapTileGraphicsObject::handleTileDelivered(quint64 token, QImage tile, bool finished)
+{
+    //If this is for a request we've since withdrawn or replaced, ignore it
+    if (!_havePendingRequest || token != _requestToken)
         return;
 
-    QImage * image = _tileSource->getFinishedTile(x,y,z);
-
-    //Make sure someone didn't snake us to grabbing our tile
-    if (image == 0)
+    //Once the finished tile is here the MapTileSource is done with our request. Partial ones may come first
+    if (finished)
     {
-        qWarning() << "Failed to get tile" << x << y << z << "from MapTileSource";
-        return;
+        _havePendingRequest = false;
+        _requestToken = 0;
     }
 
-    //Convert the QImage to a QPixmap
-    //We have to do this here since we can't use QPixmaps in non-GUI threads (i.e., MapTileSource)
-    QPixmap * tile = new QPixmap();
-    *tile = QPixmap::fromImage(*image);
-
-    //Delete the QImage
-    delete image;
-    image = 0;
-
-    //Make sure that the old tile has been disposed of. If it hasn't, do it
-    //In reality, it should have been, so display a warning
-    if (_tile != 0)
+    //A null tile means the source gave up on it, so keep showing whatever we've got
+    if (tile.isNull())
     {
-        qWarning() << "Tile should be null, but isn't";
-        delete _tile;
-        _tile = 0;
+        this->tileDelivered(_tileX, _tileY, _tileZoom, false, finished);
+        return;
     }
 
-    //Set the new tile and force a redraw
-    _tile = tile;
-    this->update();
+    //Convert the QImage to a QPixmap, replacing whatever tile (or partial tile) the pixmap held before
+    //We have to do this here since we can't use QPixmaps in non-GUI threads (i.e., MapTileSource). The source
+    //already converted the tile to the pixmap's format in its own thread, so all that's left is a copy.
+    _tile.convertFromImage(tile);
+    _haveTile = true;
+    _havePlaceholder = false;
+    if (finished && _placeholders != 0)
+        _placeholders->insert(_tileX, _tileY, _tileZoom, _tile);
 
-    //Disconnect our signal/slot connection with MapTileSource until we need to do another request
-    //It remains to be seen if it's better to continually connect/reconnect or just to filter events
-    QObject::disconnect(_tileSource.data(),
-                        SIGNAL(tileRetrieved(quint32,quint32,quint8)),
-                        this,
-                        SLOT(handleTileRetrieved(quint32,quint32,quint8)));
+    //Force a redraw
+    this->update();
+    this->tileDelivered(_tileX, _tileY, _tileZoom, true, finished);
 }
 
 //private slot
@@ -212,3 +236,15 @@ void MapTileGraphicsObject::handleTileInvalidation()
     //Call setTile with force=true so that it forces a refresh
     this->setTile(_tileX,_tileY,_tileZoom,true);
 }
+
+//private slot
+void MapTileGraphicsObject::handleTileInvalidation(const QRectF &geoRect)
+{
+    if (!_initialized || _tileSource.isNull())
+        return;
+
+    //Only our tile's part of the map matters
+    if (!_tileSource->tileGeoRect(_tileX, _tileY, _tileZoom).intersects(geoRect))
+        return;
+    this->setTile(_tileX,_tileY,_tileZoom,true);
+}
@@ -3,9 +3,13 @@
 
 #include <QGraphicsObject>
 #include <QPointer>
+#include <QPixmap>
 
 #include "MapTileSource.h"
 
+class MapRenderProfiler;
+class MapTilePlaceholders;
+
 class MapTileGraphicsObject : public QGraphicsObject
 {
     Q_OBJECT
@@ -22,22 +26,50 @@ public:
 
     void setTile(quint32 x, quint32 y, quint8 z, bool force = false);
 
+    //Withdraws our request for the tile we're waiting on, if any, e.g. when we're scrolled out of view
+    void cancelPendingRequest();
+
+    //True while we're still waiting on the finished version of our tile
+    bool isWaitingForTile() const;
+
     QSharedPointer<MapTileSource> tileSource() const;
     void setTileSource(QSharedPointer<MapTileSource>);
 
+    /*
+      Where finished tiles are remembered and placeholders for tiles still on their way come from. Not owned,
+      and may be null for no placeholders.
+    */
+    void setPlaceholders(MapTilePlaceholders * placeholders);
+
+    //Where paints are timed, or null not to time them. Not owned.
+    void setRenderProfiler(MapRenderProfiler * profiler);
+
 
 private slots:
-    void handleTileRetrieved(quint32 x, quint32 y, quint8 z);
+    void handleTileDelivered(quint64 token, QImage tile, bool finished);
     void handleTileInvalidation();
+    void handleTileInvalidation(const QRectF& geoRect);
     
 signals:
     void tileRequested(quint32 x, quint32 y, quint8 z);
+
+    /*
+      Emitted when the tile source answers our request for tile (x,y,z): with a partial tile (finished=false),
+      the finished tile, or nothing if the source gave up on it (displayed=false).
+    */
+    void tileDelivered(quint32 x, quint32 y, quint8 z, bool displayed, bool finished);
     
 public slots:
 
 private:
     quint16 _tileSize;
-    QPixmap * _tile;
+    //Kept between tiles so that its storage can be reused. _haveTile says whether it's the current tile
+    QPixmap _tile;
+    bool _haveTile;
+    //Whether _tile holds a placeholder drawn from other zoom levels while we wait
+    bool _havePlaceholder;
+    MapTilePlaceholders * _placeholders;
+    MapRenderProfiler * _renderProfiler;
     quint32 _tileX;
     quint32 _tileY;
     quint8 _tileZoom;
@@ -45,6 +77,7 @@ private:
     bool _initialized;
 
     bool _havePendingRequest;
+    quint64 _requestToken;
 
     QSharedPointer<MapTileSource> _tileSource;
     
@@ -0,0 +1,713 @@
+#include "MapTilePackCache.h"
+
+#include <QDir>
+#include <QMap>
+#include <QVector>
+#include <QStringBuilder>
+#include <QHash>
+#include <QtDebug>
+#include <algorithm>
+#include <cstring>
+
+const QString PACK_DATA_FILE_NAME = "tiles.mgpack";
+const QString PACK_INDEX_FILE_NAME = "tiles.mgindex";
+
+//The data file starts with a magic number and version, followed by records
+const quint32 DATA_MAGIC = 0x4B50474D;
+const quint32 DATA_VERSION = 1;
+const qint64 DATA_HEADER_SIZE = 8;
+
+//Each record in the data file is a RecordHeader followed by the tile's bytes
+const quint32 RECORD_MAGIC = 0x454C4954;
+const qint64 RECORD_HEADER_SIZE = 24;
+
+//The index file is an IndexHeader padded to INDEX_HEADER_SIZE, followed by capacity Slots. Version 2 added
+//access stamps; older indexes are rebuilt
+const quint32 INDEX_MAGIC = 0x58444947;
+const quint32 INDEX_VERSION = 2;
+const qint64 INDEX_HEADER_SIZE = 64;
+const quint32 MIN_INDEX_CAPACITY = 1024;
+
+const quint32 SLOT_EMPTY = 0;
+const quint32 SLOT_LIVE = 1;
+const quint32 SLOT_REMOVED = 2;
+
+//open() compacts the data file once more than half of it (and at least this much) is wasted
+const qint64 AUTO_COMPACT_MIN_WASTE = 16 * 1024 * 1024;
+
+//touch() leaves stamps alone that are at most this old
+const quint32 ACCESS_STAMP_RESOLUTION_SECS = 300;
+
+struct RecordHeader
+{
+    quint32 magic;
+    quint32 length;
+    quint64 key;
+    qint64 expireMSecs;
+};
+
+MapTilePackCache::MapTilePackCache() :
+    _data(0), _dataMappedSize(0), _index(0)
+{
+}
+
+MapTilePackCache::~MapTilePackCache()
+{
+    this->close();
+}
+
+bool MapTilePackCache::open(const QString &directory, QString *errorString)
+{
+    this->close();
+
+    QString dummy;
+    if (errorString == 0)
+        errorString = &dummy;
+
+    if (!QDir().mkpath(directory))
+    {
+        *errorString = "Failed to create tile pack directory " % directory;
+        return false;
+    }
+
+    _directory = directory;
+    _dataFile.setFileName(directory % "/" % PACK_DATA_FILE_NAME);
+    _indexFile.setFileName(directory % "/" % PACK_INDEX_FILE_NAME);
+
+    if (!this->openDataFile(errorString) || !this->mapData(errorString))
+    {
+        this->close();
+        return false;
+    }
+
+    if (!_indexFile.open(QIODevice::ReadWrite))
+    {
+        *errorString = "Failed to open tile pack index: " % _indexFile.errorString();
+        this->close();
+        return false;
+    }
+
+    if (_indexFile.size() >= INDEX_HEADER_SIZE)
+        _index = _indexFile.map(0, _indexFile.size());
+
+    if (!this->validIndex())
+    {
+        qWarning() << "Rebuilding tile pack index" << _indexFile.fileName();
+        if (!this->rebuildIndex(errorString))
+        {
+            this->close();
+            return false;
+        }
+    }
+    //Anything past dataEnd was appended after the index was last updated, so it's not trustworthy
+    else if (_dataFile.size() > this->header()->dataEnd)
+    {
+        _dataFile.unmap(_data);
+        _data = 0;
+        if (!_dataFile.resize(this->header()->dataEnd) || !this->mapData(errorString))
+        {
+            this->close();
+            return false;
+        }
+    }
+
+    if (this->wastedBytes() >= AUTO_COMPACT_MIN_WASTE && 2 * this->wastedBytes() > this->dataSize())
+    {
+        QString compactError;
+        if (!this->compact(&compactError))
+            qWarning() << "Failed to compact tile pack:" << compactError;
+    }
+
+    return this->isOpen();
+}
+
+void MapTilePackCache::close()
+{
+    if (_data != 0)
+        _dataFile.unmap(_data);
+    if (_index != 0)
+        _indexFile.unmap(_index);
+    _data = 0;
+    _dataMappedSize = 0;
+    _index = 0;
+
+    _dataFile.close();
+    _indexFile.close();
+}
+
+bool MapTilePackCache::isOpen() const
+{
+    return (_data != 0 && _index != 0);
+}
+
+bool MapTilePackCache::contains(const MapTileKey &key) const
+{
+    return (this->findSlot(key) != 0);
+}
+
+QByteArray MapTilePackCache::value(const MapTileKey &key, QDateTime *expireTime)
+{
+    Slot * slot = this->findSlot(key);
+    if (slot == 0)
+        return QByteArray();
+
+    //Tiles appended since we last mapped the data file need a fresh mapping
+    const qint64 end = slot->offset + RECORD_HEADER_SIZE + slot->length;
+    if (end > _dataMappedSize)
+    {
+        QString error;
+        if (!this->mapData(&error))
+        {
+            qWarning() << "Failed to map tile pack:" << error;
+            return QByteArray();
+        }
+        if (end > _dataMappedSize)
+            return QByteArray();
+    }
+
+    if (expireTime != 0)
+    {
+        if (slot->expireMSecs == 0)
+            *expireTime = QDateTime();
+        else
+            *expireTime = QDateTime::fromMSecsSinceEpoch(slot->expireMSecs).toUTC();
+    }
+
+    return QByteArray::fromRawData((const char *)(_data + slot->offset + RECORD_HEADER_SIZE),
+                                   slot->length);
+}
+
+bool MapTilePackCache::insert(const MapTileKey &key, const QByteArray &data, const QDateTime &expireTime,
+                              QString *errorString)
+{
+    QString dummy;
+    if (errorString == 0)
+        errorString = &dummy;
+
+    if (!this->isOpen())
+    {
+        *errorString = "Tile pack is not open";
+        return false;
+    }
+
+    if (!this->reserveSlot(errorString))
+        return false;
+
+    Slot slot;
+    slot.key = key.toUInt64();
+    slot.offset = this->header()->dataEnd;
+    slot.expireMSecs = expireTime.isNull() ? 0 : expireTime.toMSecsSinceEpoch();
+    slot.length = data.size();
+    slot.state = SLOT_LIVE;
+    slot.accessed = MapTilePackCache::now();
+    slot.reserved = 0;
+
+    RecordHeader record;
+    record.magic = RECORD_MAGIC;
+    record.length = slot.length;
+    record.key = slot.key;
+    record.expireMSecs = slot.expireMSecs;
+
+    //Append the record first so that a crash before the index is updated just leaves unreferenced bytes
+    if (!_dataFile.seek(slot.offset)
+            || _dataFile.write((const char *)&record, RECORD_HEADER_SIZE) != RECORD_HEADER_SIZE
+            || _dataFile.write(data) != data.size())
+    {
+        *errorString = "Failed to append to tile pack: " % _dataFile.errorString();
+        return false;
+    }
+
+    this->placeSlot(slot);
+    this->header()->dataEnd = slot.offset + RECORD_HEADER_SIZE + slot.length;
+    return true;
+}
+
+bool MapTilePackCache::flush(QString *errorString)
+{
+    QString dummy;
+    if (errorString == 0)
+        errorString = &dummy;
+
+    if (!this->isOpen())
+        return true;
+
+    if (!_dataFile.flush())
+    {
+        *errorString = "Failed to flush tile pack: " % _dataFile.errorString();
+        return false;
+    }
+    return true;
+}
+
+void MapTilePackCache::remove(const MapTileKey &key)
+{
+    Slot * slot = this->findSlot(key);
+    if (slot == 0)
+        return;
+
+    slot->state = SLOT_REMOVED;
+    this->header()->count--;
+    this->header()->wastedBytes += RECORD_HEADER_SIZE + slot->length;
+}
+
+void MapTilePackCache::touch(const MapTileKey &key)
+{
+    Slot * slot = this->findSlot(key);
+    if (slot == 0)
+        return;
+
+    const quint32 stamp = MapTilePackCache::now();
+    if (stamp > slot->accessed + ACCESS_STAMP_RESOLUTION_SECS)
+        slot->accessed = stamp;
+}
+
+bool MapTilePackCache::trim(qint64 maxBytes, int *evicted, QString *errorString)
+{
+    QString dummy;
+    if (errorString == 0)
+        errorString = &dummy;
+    *evicted = 0;
+
+    if (!this->isOpen())
+    {
+        *errorString = "Tile pack is not open";
+        return false;
+    }
+
+    QVector<Slot> live;
+    live.reserve(this->header()->count);
+    const Slot * table = this->slotArray();
+    for (quint32 i = 0; i < this->header()->capacity; i++)
+    {
+        if (table[i].state == SLOT_LIVE)
+            live.append(table[i]);
+    }
+
+    //Least recently used first
+    std::sort(live.begin(), live.end(), MapTilePackCache::usedEarlier);
+    qint64 liveBytes = this->dataSize() - this->wastedBytes();
+    for (int i = 0; i < live.size() && liveBytes > maxBytes; i++)
+    {
+        this->remove(MapTileKey::fromUInt64(live.at(i).key));
+        liveBytes -= RECORD_HEADER_SIZE + live.at(i).length;
+        (*evicted)++;
+    }
+
+    if (this->wastedBytes() == 0)
+        return true;
+    return this->compact(errorString);
+}
+
+int MapTilePackCache::count() const
+{
+    if (_index == 0)
+        return 0;
+    return this->header()->count;
+}
+
+qint64 MapTilePackCache::wastedBytes() const
+{
+    if (_index == 0)
+        return 0;
+    return this->header()->wastedBytes;
+}
+
+qint64 MapTilePackCache::dataSize() const
+{
+    if (_index == 0)
+        return 0;
+    return this->header()->dataEnd;
+}
+
+bool MapTilePackCache::compact(QString *errorString)
+{
+    QString dummy;
+    if (errorString == 0)
+        errorString = &dummy;
+
+    if (!this->isOpen())
+    {
+        *errorString = "Tile pack is not open";
+        return false;
+    }
+
+    if (this->header()->dataEnd > _dataMappedSize && !this->mapData(errorString))
+        return false;
+
+    //Copy the live records in file order so the new file is written sequentially
+    QMap<qint64, Slot> live;
+    const qint64 now = QDateTime::currentDateTimeUtc().toMSecsSinceEpoch();
+    const Slot * table = this->slotArray();
+    for (quint32 i = 0; i < this->header()->capacity; i++)
+    {
+        if (table[i].state != SLOT_LIVE)
+            continue;
+        if (table[i].expireMSecs != 0 && table[i].expireMSecs <= now)
+            continue;
+        live.insert(table[i].offset, table[i]);
+    }
+
+    //Rebuilding the index loses the access stamps, so they're put back afterwards
+    QHash<quint64, quint32> stamps;
+    stamps.reserve(live.size());
+    foreach(const Slot& slot, live)
+        stamps.insert(slot.key, slot.accessed);
+
+    const QString dataPath = _dataFile.fileName();
+    QFile compacted(dataPath % ".compact");
+    if (!compacted.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        *errorString = "Failed to create compacted tile pack: " % compacted.errorString();
+        return false;
+    }
+
+    const quint32 fileHeader[2] = {DATA_MAGIC, DATA_VERSION};
+    bool ok = (compacted.write((const char *)fileHeader, DATA_HEADER_SIZE) == DATA_HEADER_SIZE);
+    foreach(const Slot& slot, live)
+    {
+        if (!ok)
+            break;
+        const qint64 recordSize = RECORD_HEADER_SIZE + slot.length;
+        ok = (compacted.write((const char *)(_data + slot.offset), recordSize) == recordSize);
+    }
+    compacted.close();
+
+    if (!ok)
+    {
+        *errorString = "Failed to write compacted tile pack: " % compacted.errorString();
+        compacted.remove();
+        return false;
+    }
+
+    //Swap the files and index the new one from scratch. The old index is meaningless from here on
+    this->close();
+    const bool replaced = QFile::remove(dataPath) && QFile::rename(compacted.fileName(), dataPath);
+    if (!replaced)
+    {
+        *errorString = "Failed to replace tile pack with compacted copy";
+        compacted.remove();
+    }
+
+    QString reopenError;
+    if (!this->openDataFile(&reopenError)
+            || !this->mapData(&reopenError)
+            || !_indexFile.open(QIODevice::ReadWrite)
+            || !this->rebuildIndex(&reopenError))
+    {
+        *errorString = "Failed to reopen tile pack after compacting: " % reopenError;
+        this->close();
+        return false;
+    }
+
+    QHash<quint64, quint32>::const_iterator iter;
+    for (iter = stamps.constBegin(); iter != stamps.constEnd(); iter++)
+    {
+        Slot * slot = this->findSlot(MapTileKey::fromUInt64(iter.key()));
+        if (slot != 0)
+            slot->accessed = iter.value();
+    }
+
+    return replaced;
+}
+
+//private
+MapTilePackCache::IndexHeader *MapTilePackCache::header() const
+{
+    return reinterpret_cast<IndexHeader *>(_index);
+}
+
+//private
+MapTilePackCache::Slot *MapTilePackCache::slotArray() const
+{
+    return reinterpret_cast<Slot *>(_index + INDEX_HEADER_SIZE);
+}
+
+//private
+MapTilePackCache::Slot *MapTilePackCache::findSlot(const MapTileKey &key) const
+{
+    if (_index == 0)
+        return 0;
+
+    const quint64 packed = key.toUInt64();
+    const quint32 capacity = this->header()->capacity;
+    Slot * table = this->slotArray();
+
+    //Linear probing. The table is never allowed to fill up, so we always hit an empty slot eventually
+    quint32 i = MapTilePackCache::slotIndex(packed, capacity);
+    for (quint32 probes = 0; probes < capacity; probes++)
+    {
+        Slot * slot = table + i;
+        if (slot->state == SLOT_EMPTY)
+            return 0;
+        if (slot->state == SLOT_LIVE && slot->key == packed)
+            return slot;
+        i = (i + 1) & (capacity - 1);
+    }
+    return 0;
+}
+
+//private
+bool MapTilePackCache::reserveSlot(QString *errorString)
+{
+    //Keep used (live + removed) slots under three quarters of the table
+    const IndexHeader * head = this->header();
+    if (4 * ((quint64)head->used + 1) <= 3 * (quint64)head->capacity)
+        return true;
+
+    //Rehashing drops removed slots, so only grow if the live ones need the room
+    quint32 capacity = head->capacity;
+    while (2 * ((quint64)head->count + 1) > capacity)
+        capacity *= 2;
+    return this->growIndex(capacity, errorString);
+}
+
+//private
+void MapTilePackCache::placeSlot(const Slot &slot)
+{
+    IndexHeader * head = this->header();
+    Slot * table = this->slotArray();
+    const quint32 capacity = head->capacity;
+
+    Slot * target = 0;
+    quint32 i = MapTilePackCache::slotIndex(slot.key, capacity);
+    for (quint32 probes = 0; probes < capacity; probes++)
+    {
+        Slot * candidate = table + i;
+        i = (i + 1) & (capacity - 1);
+
+        if (candidate->state == SLOT_REMOVED)
+        {
+            if (target == 0)
+                target = candidate;
+            continue;
+        }
+        else if (candidate->state == SLOT_EMPTY)
+        {
+            if (target == 0)
+            {
+                target = candidate;
+                head->used++;
+            }
+            break;
+        }
+        else if (candidate->key == slot.key)
+        {
+            //Replacing a tile. Its old record stays in the data file until the next compaction
+            head->wastedBytes += RECORD_HEADER_SIZE + candidate->length;
+            head->count--;
+            if (target != 0)
+                candidate->state = SLOT_REMOVED;
+            else
+                target = candidate;
+            break;
+        }
+    }
+
+    *target = slot;
+    target->state = SLOT_LIVE;
+    head->count++;
+}
+
+//private
+bool MapTilePackCache::openDataFile(QString *errorString)
+{
+    if (!_dataFile.open(QIODevice::ReadWrite))
+    {
+        *errorString = "Failed to open tile pack: " % _dataFile.errorString();
+        return false;
+    }
+
+    quint32 fileHeader[2] = {0, 0};
+    if (_dataFile.size() >= DATA_HEADER_SIZE)
+        _dataFile.read((char *)fileHeader, DATA_HEADER_SIZE);
+
+    if (fileHeader[0] == DATA_MAGIC && fileHeader[1] == DATA_VERSION)
+        return true;
+
+    //It's a cache, so anything we can't read is simply started over
+    if (_dataFile.size() > 0)
+        qWarning() << "Unrecognized tile pack" << _dataFile.fileName() << "- starting a new one";
+
+    fileHeader[0] = DATA_MAGIC;
+    fileHeader[1] = DATA_VERSION;
+    if (!_dataFile.resize(0)
+            || !_dataFile.seek(0)
+            || _dataFile.write((const char *)fileHeader, DATA_HEADER_SIZE) != DATA_HEADER_SIZE
+            || !_dataFile.flush())
+    {
+        *errorString = "Failed to initialize tile pack: " % _dataFile.errorString();
+        return false;
+    }
+    return true;
+}
+
+//private
+bool MapTilePackCache::mapData(QString *errorString)
+{
+    if (_data != 0)
+        _dataFile.unmap(_data);
+    _dataMappedSize = 0;
+
+    //Appends may still be sitting in QFile's buffer
+    if (!_dataFile.flush())
+    {
+        *errorString = "Failed to flush tile pack: " % _dataFile.errorString();
+        return false;
+    }
+
+    const qint64 size = _dataFile.size();
+    _data = _dataFile.map(0, size);
+    if (_data == 0)
+    {
+        *errorString = "Failed to map tile pack: " % _dataFile.errorString();
+        return false;
+    }
+    _dataMappedSize = size;
+    return true;
+}
+
+//private
+bool MapTilePackCache::validIndex() const
+{
+    if (_index == 0)
+        return false;
+
+    const IndexHeader * head = this->header();
+    if (head->magic != INDEX_MAGIC || head->version != INDEX_VERSION)
+        return false;
+    if (head->capacity < MIN_INDEX_CAPACITY || (head->capacity & (head->capacity - 1)) != 0)
+        return false;
+    if (_indexFile.size() != INDEX_HEADER_SIZE + (qint64)head->capacity * (qint64)sizeof(Slot))
+        return false;
+    if (head->count > head->used || head->used >= head->capacity)
+        return false;
+    if (head->dataEnd < DATA_HEADER_SIZE || head->dataEnd > _dataFile.size())
+        return false;
+    return true;
+}
+
+//private
+bool MapTilePackCache::mapIndex(quint32 capacity, QString *errorString)
+{
+    if (_index != 0)
+        _indexFile.unmap(_index);
+    _index = 0;
+
+    const qint64 size = INDEX_HEADER_SIZE + (qint64)capacity * (qint64)sizeof(Slot);
+    if (!_indexFile.resize(size))
+    {
+        *errorString = "Failed to resize tile pack index: " % _indexFile.errorString();
+        return false;
+    }
+
+    _index = _indexFile.map(0, size);
+    if (_index == 0)
+    {
+        *errorString = "Failed to map tile pack index: " % _indexFile.errorString();
+        return false;
+    }
+
+    //Start out empty
+    memset(_index, 0, size);
+    IndexHeader * head = this->header();
+    head->magic = INDEX_MAGIC;
+    head->version = INDEX_VERSION;
+    head->capacity = capacity;
+    head->dataEnd = DATA_HEADER_SIZE;
+    return true;
+}
+
+//private
+bool MapTilePackCache::growIndex(quint32 capacity, QString *errorString)
+{
+    QVector<Slot> live;
+    live.reserve(this->header()->count);
+    const Slot * table = this->slotArray();
+    for (quint32 i = 0; i < this->header()->capacity; i++)
+    {
+        if (table[i].state == SLOT_LIVE)
+            live.append(table[i]);
+    }
+    const qint64 dataEnd = this->header()->dataEnd;
+    const qint64 wastedBytes = this->header()->wastedBytes;
+
+    if (!this->mapIndex(capacity, errorString))
+        return false;
+
+    this->header()->dataEnd = dataEnd;
+    this->header()->wastedBytes = wastedBytes;
+    foreach(const Slot& slot, live)
+        this->placeSlot(slot);
+    return true;
+}
+
+//private
+bool MapTilePackCache::rebuildIndex(QString *errorString)
+{
+    if (!this->mapIndex(MIN_INDEX_CAPACITY, errorString))
+        return false;
+
+    //Walk the records until the end of the file or the first one that's been cut short
+    qint64 offset = DATA_HEADER_SIZE;
+    while (offset + RECORD_HEADER_SIZE <= _dataMappedSize)
+    {
+        RecordHeader record;
+        memcpy(&record, _data + offset, RECORD_HEADER_SIZE);
+        if (record.magic != RECORD_MAGIC || offset + RECORD_HEADER_SIZE + record.length > _dataMappedSize)
+            break;
+
+        if (!this->reserveSlot(errorString))
+            return false;
+
+        Slot slot;
+        slot.key = record.key;
+        slot.offset = offset;
+        slot.expireMSecs = record.expireMSecs;
+        slot.length = record.length;
+        slot.state = SLOT_LIVE;
+        slot.accessed = 0;
+        slot.reserved = 0;
+        this->placeSlot(slot);
+
+        offset += RECORD_HEADER_SIZE + record.length;
+        this->header()->dataEnd = offset;
+    }
+
+    //Drop whatever partial record a crash may have left at the end
+    if (offset < _dataFile.size())
+    {
+        _dataFile.unmap(_data);
+        _data = 0;
+        if (!_dataFile.resize(offset))
+        {
+            *errorString = "Failed to truncate tile pack: " % _dataFile.errorString();
+            return false;
+        }
+        return this->mapData(errorString);
+    }
+    return true;
+}
+
+//private static
+quint32 MapTilePackCache::slotIndex(quint64 key, quint32 capacity)
+{
+    //Multiplicative hashing spreads neighbouring tiles out over the table
+    quint64 hash = key * Q_UINT64_C(0x9E3779B97F4A7C15);
+    hash ^= (hash >> 32);
+    return (quint32)hash & (capacity - 1);
+}
+
+//private static
+bool MapTilePackCache::usedEarlier(const Slot &a, const Slot &b)
+{
+    //Tiles used at the same time (e.g. never, since the index was rebuilt) go oldest record first
+    if (a.accessed != b.accessed)
+        return a.accessed < b.accessed;
+    return a.offset < b.offset;
+}
+
+//private static
+quint32 MapTilePackCache::now()
+{
+    return (quint32)(QDateTime::currentDateTimeUtc().toMSecsSinceEpoch() / 1000);
+}
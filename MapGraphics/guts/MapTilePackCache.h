@@ -0,0 +1,155 @@
+#ifndef MAPTILEPACKCACHE_H
+#define MAPTILEPACKCACHE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QDateTime>
+#include <QFile>
+
+#include "MapTileKey.h"
+
+/**
+ * @brief The MapTilePackCache class stores encoded tiles in two files instead of one file per tile: an
+ * append-only data file holding the tile bytes and an index file holding an open-addressing hash table
+ * keyed by MapTileKey. Both files are memory-mapped, so a lookup is a few probes in the index and reading
+ * a tile doesn't copy it.
+ *
+ * Replacing or removing a tile leaves its old bytes in the data file. compact() rewrites the data file
+ * without them, and open() does so automatically once more than half of the file is wasted.
+ *
+ * The index also stamps each tile with when it was last inserted or touch()ed, which trim() uses to keep the
+ * pack within a size by evicting the tiles that were used longest ago.
+ *
+ * The index is only a cache of what's in the data file. If it's missing, damaged or out of date (e.g. after
+ * a crash between appending a tile and updating the index) it is rebuilt by scanning the data file.
+ * Both files are in native byte order, so a pack is meant to be used on the kind of machine that wrote it.
+ *
+ * A MapTilePackCache is not thread-safe. MapTileSource and its MapTileDiskCacheWriter share one under a
+ * lock.
+ */
+class MapTilePackCache
+{
+public:
+    MapTilePackCache();
+    ~MapTilePackCache();
+
+    /**
+     * @brief open opens (creating if necessary) the pack in directory. Returns true on success, false on
+     * failure with an explanation in errorString.
+     */
+    bool open(const QString& directory, QString * errorString = 0);
+    void close();
+    bool isOpen() const;
+
+    bool contains(const MapTileKey& key) const;
+
+    /**
+     * @brief value returns the stored bytes for key, or a null QByteArray if there are none. The returned
+     * array points straight into the mapped data file and is only valid until the next non-const call.
+     * Copy it if you need to keep it.
+     */
+    QByteArray value(const MapTileKey& key, QDateTime * expireTime = 0);
+
+    /**
+     * @brief insert appends data for key to the pack, replacing whatever was stored for it before. The
+     * bytes may stay buffered until flush(). Returns true on success, false on failure with an explanation
+     * in errorString.
+     */
+    bool insert(const MapTileKey& key, const QByteArray& data, const QDateTime& expireTime,
+                QString * errorString = 0);
+
+    /**
+     * @brief flush writes any buffered appends to the data file. Returns true on success, false on
+     * failure with an explanation in errorString.
+     */
+    bool flush(QString * errorString = 0);
+
+    void remove(const MapTileKey& key);
+
+    /**
+     * @brief touch stamps the tile as used now. Stamps are only as fine as a few minutes, so touching the same
+     * tiles over and over doesn't keep dirtying the index.
+     */
+    void touch(const MapTileKey& key);
+
+    /**
+     * @brief trim evicts the tiles that were used longest ago until the live tiles take up at most maxBytes,
+     * and then compacts the pack so that the data file shrinks to match. Returns true on success, false on
+     * failure with an explanation in errorString.
+     * @param maxBytes
+     * @param evicted set to how many tiles were evicted
+     * @param errorString
+     */
+    bool trim(qint64 maxBytes, int * evicted, QString * errorString = 0);
+
+    /**
+     * @brief count returns the number of tiles stored
+     */
+    int count() const;
+
+    /**
+     * @brief wastedBytes returns how many bytes of the data file belong to replaced or removed tiles
+     */
+    qint64 wastedBytes() const;
+    qint64 dataSize() const;
+
+    /**
+     * @brief compact rewrites the data file with only the live tiles that haven't expired, and rebuilds the
+     * index to match. Returns true on success, false on failure with an explanation in errorString.
+     */
+    bool compact(QString * errorString = 0);
+
+private:
+    //One entry in the on-disk hash table
+    struct Slot
+    {
+        quint64 key;
+        qint64 offset;
+        qint64 expireMSecs;
+        quint32 length;
+        quint32 state;
+
+        //When it was last used, in seconds since the epoch. 0 for tiles found by rebuilding the index
+        quint32 accessed;
+        quint32 reserved;
+    };
+
+    //The start of the index file
+    struct IndexHeader
+    {
+        quint32 magic;
+        quint32 version;
+        quint32 capacity;
+        quint32 count;
+        quint32 used;
+        quint32 reserved;
+        qint64 dataEnd;
+        qint64 wastedBytes;
+    };
+
+    IndexHeader * header() const;
+    Slot * slotArray() const;
+    Slot * findSlot(const MapTileKey& key) const;
+    bool reserveSlot(QString * errorString);
+    void placeSlot(const Slot& slot);
+
+    bool openDataFile(QString * errorString);
+    bool mapData(QString * errorString);
+    bool validIndex() const;
+    bool mapIndex(quint32 capacity, QString * errorString);
+    bool growIndex(quint32 capacity, QString * errorString);
+    bool rebuildIndex(QString * errorString);
+    static quint32 slotIndex(quint64 key, quint32 capacity);
+    static bool usedEarlier(const Slot& a, const Slot& b);
+    static quint32 now();
+
+    QString _directory;
+    QFile _dataFile;
+    QFile _indexFile;
+
+    uchar * _data;
+    qint64 _dataMappedSize;
+    uchar * _index;
+};
+
+#endif // MAPTILEPACKCACHE_H
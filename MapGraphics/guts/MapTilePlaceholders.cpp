@@ -0,0 +1,78 @@
+#include "MapTilePlaceholders.h"
+
+#include <QPainter>
+
+//Ancestors further up than this are too blurry to be worth showing
+const int MAX_ANCESTOR_LEVELS = 4;
+
+MapTilePlaceholders::MapTilePlaceholders(int budgetBytes)
+{
+    _tiles.setMaxCost(budgetBytes);
+}
+
+void MapTilePlaceholders::insert(quint32 x, quint32 y, quint8 z, const QPixmap &tile)
+{
+    if (tile.isNull())
+        return;
+    const int cost = tile.width() * tile.height() * qMax(1, tile.depth() / 8);
+    _tiles.insert(MapTileKey(x, y, z), new QPixmap(tile), cost);
+}
+
+bool MapTilePlaceholders::placeholder(quint32 x, quint32 y, quint8 z, quint16 tileSize, QPixmap *toRet) const
+{
+    //The closest ancestor wins. Its piece covering us is a 1/2^levels square of it
+    for (int levels = 1; levels <= MAX_ANCESTOR_LEVELS && levels <= z; levels++)
+    {
+        const QPixmap * ancestor = _tiles.object(MapTileKey(x >> levels, y >> levels, z - levels));
+        if (ancestor == 0)
+            continue;
+
+        const int divisions = 1 << levels;
+        const qreal pieceWidth = (qreal)ancestor->width() / divisions;
+        const qreal pieceHeight = (qreal)ancestor->height() / divisions;
+        const QRectF piece((x % divisions) * pieceWidth, (y % divisions) * pieceHeight,
+                           pieceWidth, pieceHeight);
+
+        QPixmap drawn(tileSize, tileSize);
+        drawn.fill(Qt::transparent);
+        QPainter painter(&drawn);
+        painter.setRenderHint(QPainter::SmoothPixmapTransform);
+        painter.drawPixmap(QRectF(0, 0, tileSize, tileSize), *ancestor, piece);
+        painter.end();
+        *toRet = drawn;
+        return true;
+    }
+
+    //Otherwise whichever of the four children we have, each in its quarter
+    const qreal half = tileSize / 2.0;
+    QPixmap drawn;
+    QPainter painter;
+    for (int i = 0; i < 4; i++)
+    {
+        const quint32 dx = i % 2;
+        const quint32 dy = i / 2;
+        const QPixmap * child = _tiles.object(MapTileKey(2 * x + dx, 2 * y + dy, z + 1));
+        if (child == 0)
+            continue;
+
+        if (drawn.isNull())
+        {
+            drawn = QPixmap(tileSize, tileSize);
+            drawn.fill(Qt::transparent);
+            painter.begin(&drawn);
+            painter.setRenderHint(QPainter::SmoothPixmapTransform);
+        }
+        painter.drawPixmap(QRectF(dx * half, dy * half, half, half), *child, child->rect());
+    }
+    if (drawn.isNull())
+        return false;
+
+    painter.end();
+    *toRet = drawn;
+    return true;
+}
+
+void MapTilePlaceholders::clear()
+{
+    _tiles.clear();
+}
@@ -0,0 +1,40 @@
+#ifndef MAPTILEPLACEHOLDERS_H
+#define MAPTILEPLACEHOLDERS_H
+
+#include <QCache>
+#include <QPixmap>
+
+#include "MapTileKey.h"
+
+/**
+ * @brief The MapTilePlaceholders class remembers the tiles a MapGraphicsView has recently shown, as pixmaps,
+ * so that a tile that hasn't arrived yet can be drawn from its neighbours in the zoom level quad-tree: a scaled
+ * up piece of a cached ancestor, or its four children scaled down. Zooming then shows a blurry map right away
+ * instead of a blank one.
+ *
+ * It lives in the GUI thread with the tile objects that fill it. Cost is in bytes of pixmap.
+ */
+class MapTilePlaceholders
+{
+public:
+    explicit MapTilePlaceholders(int budgetBytes = 48 * 1024 * 1024);
+
+    /**
+     * @brief insert remembers tile as the finished tile (x, y, z)
+     */
+    void insert(quint32 x, quint32 y, quint8 z, const QPixmap& tile);
+
+    /**
+     * @brief placeholder draws a stand-in for tile (x, y, z) into toRet, preferring the closest cached
+     * ancestor and falling back to the children on the next zoom level. Returns false, leaving toRet alone,
+     * if nothing usable is cached.
+     */
+    bool placeholder(quint32 x, quint32 y, quint8 z, quint16 tileSize, QPixmap * toRet) const;
+
+    void clear();
+
+private:
+    QCache<MapTileKey, QPixmap> _tiles;
+};
+
+#endif // MAPTILEPLACEHOLDERS_H
@@ -0,0 +1,182 @@
+#include "MapTilePrefetcher.h"
+
+#include <cmath>
+
+//Once we've remembered this many retrieved tiles, forget them all. Asking again just hits the source's cache
+const int MAX_REMEMBERED_TILES = 4096;
+
+MapTilePrefetcher::MapTilePrefetcher(QObject *parent) :
+    QObject(parent), _ringSize(1), _prefetchZoomLevels(true)
+{
+}
+
+MapTilePrefetcher::~MapTilePrefetcher()
+{
+    this->cancel();
+}
+
+QSharedPointer<MapTileSource> MapTilePrefetcher::tileSource() const
+{
+    return _tileSource;
+}
+
+void MapTilePrefetcher::setTileSource(QSharedPointer<MapTileSource> tileSource)
+{
+    this->cancel();
+    _retrieved.clear();
+
+    if (!_tileSource.isNull())
+        QObject::disconnect(_tileSource.data(), 0, this, 0);
+
+    _tileSource = tileSource;
+    if (_tileSource.isNull())
+        return;
+
+    connect(_tileSource.data(),
+            SIGNAL(tileRetrieved(quint32,quint32,quint8)),
+            this,
+            SLOT(handleTileRetrieved(quint32,quint32,quint8)));
+    connect(_tileSource.data(),
+            SIGNAL(tileRequestFailed(quint32,quint32,quint8)),
+            this,
+            SLOT(handleTileRequestFailed(quint32,quint32,quint8)));
+}
+
+int MapTilePrefetcher::ringSize() const
+{
+    return _ringSize;
+}
+
+void MapTilePrefetcher::setRingSize(int ringSize)
+{
+    _ringSize = qMax<int>(0, ringSize);
+}
+
+bool MapTilePrefetcher::prefetchZoomLevels() const
+{
+    return _prefetchZoomLevels;
+}
+
+void MapTilePrefetcher::setPrefetchZoomLevels(bool prefetch)
+{
+    _prefetchZoomLevels = prefetch;
+}
+
+int MapTilePrefetcher::pendingCount() const
+{
+    return _outstanding.size();
+}
+
+//public slot
+void MapTilePrefetcher::setViewport(quint32 xMin, quint32 yMin, quint32 xMax, quint32 yMax, quint8 z)
+{
+    if (_tileSource.isNull() || xMin >= xMax || yMin >= yMax)
+    {
+        this->cancel();
+        return;
+    }
+
+    //The viewport's own tiles are requested by the tiles on screen, so treat them as already retrieved
+    if (_retrieved.size() >= MAX_REMEMBERED_TILES)
+        _retrieved.clear();
+    for (quint32 x = xMin; x < xMax; x++)
+        for (quint32 y = yMin; y < yMax; y++)
+            _retrieved.insert(MapTileKey(x, y, z));
+
+    QList<MapTileKey> plan;
+    QSet<MapTileKey> planned;
+
+    //The ring, nearest tiles first. Each pass covers the previous ones too but planRange() skips duplicates
+    for (int ring = 1; ring <= _ringSize; ring++)
+        this->planRange((qint64)xMin - ring, (qint64)yMin - ring,
+                        (qint64)xMax + ring, (qint64)yMax + ring,
+                        z, &plan, &planned);
+
+    if (_prefetchZoomLevels)
+    {
+        //Zooming out: the parent tiles covering the viewport and its ring
+        if (z > _tileSource->minZoomLevel())
+            this->planRange(((qint64)xMin - _ringSize) / 2, ((qint64)yMin - _ringSize) / 2,
+                            ((qint64)xMax + _ringSize + 1) / 2, ((qint64)yMax + _ringSize + 1) / 2,
+                            z - 1, &plan, &planned);
+
+        //Zooming in: the children of the viewport only, since there are four times as many of them
+        if (z < _tileSource->maxZoomLevel())
+            this->planRange(2 * (qint64)xMin, 2 * (qint64)yMin,
+                            2 * (qint64)xMax, 2 * (qint64)yMax,
+                            z + 1, &plan, &planned);
+    }
+
+    //Cancel what we no longer want before asking for anything new, so the source never has to queue both
+    QMutableHashIterator<MapTileKey, quint64> iter(_outstanding);
+    while (iter.hasNext())
+    {
+        iter.next();
+        if (planned.contains(iter.key()))
+            continue;
+        _tileSource->cancelTileRequest(iter.value());
+        iter.remove();
+    }
+
+    foreach(const MapTileKey& key, plan)
+    {
+        if (_outstanding.contains(key))
+            continue;
+        _outstanding.insert(key, _tileSource->requestTile(key.x(), key.y(), key.z(),
+                                                          MapTileSource::PrefetchPriority));
+    }
+}
+
+//public slot
+void MapTilePrefetcher::cancel()
+{
+    if (!_tileSource.isNull())
+    {
+        foreach(quint64 token, _outstanding)
+            _tileSource->cancelTileRequest(token);
+    }
+    _outstanding.clear();
+}
+
+//private slot
+void MapTilePrefetcher::handleTileRetrieved(quint32 x, quint32 y, quint8 z)
+{
+    const MapTileKey key(x, y, z);
+    if (_outstanding.remove(key) == 0)
+        return;
+
+    if (_retrieved.size() >= MAX_REMEMBERED_TILES)
+        _retrieved.clear();
+    _retrieved.insert(key);
+}
+
+//private slot
+void MapTilePrefetcher::handleTileRequestFailed(quint32 x, quint32 y, quint8 z)
+{
+    //Leave it out of _retrieved so that the next plan tries again
+    _outstanding.remove(MapTileKey(x, y, z));
+}
+
+//private
+void MapTilePrefetcher::planRange(qint64 xMin, qint64 yMin, qint64 xMax, qint64 yMax, quint8 z,
+                                  QList<MapTileKey> *plan, QSet<MapTileKey> *planned)
+{
+    //Clip to the tiles that exist on this zoom level
+    const qint64 tilesPerSide = sqrt((long double)_tileSource->tilesOnZoomLevel(z));
+    xMin = qMax<qint64>(0, xMin);
+    yMin = qMax<qint64>(0, yMin);
+    xMax = qMin<qint64>(tilesPerSide, xMax);
+    yMax = qMin<qint64>(tilesPerSide, yMax);
+
+    for (qint64 x = xMin; x < xMax; x++)
+    {
+        for (qint64 y = yMin; y < yMax; y++)
+        {
+            const MapTileKey key(x, y, z);
+            if (_retrieved.contains(key) || planned->contains(key))
+                continue;
+            planned->insert(key);
+            plan->append(key);
+        }
+    }
+}
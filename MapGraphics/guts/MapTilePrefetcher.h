@@ -0,0 +1,75 @@
+#ifndef MAPTILEPREFETCHER_H
+#define MAPTILEPREFETCHER_H
+
+#include <QObject>
+#include <QSharedPointer>
+#include <QHash>
+#include <QSet>
+
+#include "MapTileSource.h"
+
+/**
+ * @brief The MapTilePrefetcher class requests tiles that aren't on screen yet but probably will be soon: a ring
+ * of tiles around the viewport and, optionally, the tiles covering the viewport on the zoom levels just above
+ * and below the current one.
+ *
+ * Prefetches are requested at MapTileSource::PrefetchPriority, so the tiles actually on screen always get
+ * fetched first. Each call to setViewport() cancels the outstanding prefetches that aren't part of the new
+ * plan, so moving the view drops prefetching for the area it moved away from.
+ */
+class MapTilePrefetcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MapTilePrefetcher(QObject *parent = 0);
+    virtual ~MapTilePrefetcher();
+
+    QSharedPointer<MapTileSource> tileSource() const;
+    void setTileSource(QSharedPointer<MapTileSource> tileSource);
+
+    /**
+     * @brief ringSize is how many tiles beyond the edge of the viewport to prefetch. Zero disables the ring.
+     */
+    int ringSize() const;
+    void setRingSize(int ringSize);
+
+    /**
+     * @brief prefetchZoomLevels is whether to prefetch the viewport on the parent and child zoom levels
+     */
+    bool prefetchZoomLevels() const;
+    void setPrefetchZoomLevels(bool prefetch);
+
+    int pendingCount() const;
+
+public slots:
+    /**
+     * @brief setViewport replans prefetching around the tiles x in [xMin, xMax) and y in [yMin, yMax) on zoom
+     * level z, cancelling outstanding prefetches that are no longer wanted.
+     */
+    void setViewport(quint32 xMin, quint32 yMin, quint32 xMax, quint32 yMax, quint8 z);
+
+    /**
+     * @brief cancel cancels every outstanding prefetch
+     */
+    void cancel();
+
+private slots:
+    void handleTileRetrieved(quint32 x, quint32 y, quint8 z);
+    void handleTileRequestFailed(quint32 x, quint32 y, quint8 z);
+
+private:
+    void planRange(qint64 xMin, qint64 yMin, qint64 xMax, qint64 yMax, quint8 z,
+                   QList<MapTileKey> * plan, QSet<MapTileKey> * planned);
+
+    QSharedPointer<MapTileSource> _tileSource;
+    int _ringSize;
+    bool _prefetchZoomLevels;
+
+    //Request tokens of the prefetches that haven't arrived yet, by tile key
+    QHash<MapTileKey, quint64> _outstanding;
+
+    //Tiles that have arrived (or are on screen) recently, so small pans don't ask for them again
+    QSet<MapTileKey> _retrieved;
+};
+
+#endif // MAPTILEPREFETCHER_H
@@ -0,0 +1,430 @@
+#include "MapTileSeeder.h"
+#include "MapTileSourceExecutor.h"
+
+#include <QTimer>
+#include <QFile>
+#include <QDataStream>
+#include <QtDebug>
+#include <cmath>
+
+//The rate limit is applied in steps this long
+const int RATE_INTERVAL_MS = 100;
+
+//Progress is saved to the resume file every this many tiles
+const int RESUME_SAVE_INTERVAL = 64;
+
+//Identifies resume files, and their layout
+const quint32 RESUME_MAGIC = 0x4D545352;
+const quint16 RESUME_VERSION = 1;
+
+MapTileSeeder::MapTileSeeder(QObject *parent) :
+    QObject(parent), _minZoomLevel(10), _maxZoomLevel(18), _maxConcurrentRequests(4),
+    _maxRequestsPerSecond(10.0), _tileCount(0), _nextSpan(0), _nextX(0), _nextIndex(0), _completed(0),
+    _failed(0), _firstFailed(-1), _requestAllowance(0.0), _running(false)
+{
+    _rateTimer = new QTimer(this);
+    _rateTimer->setInterval(RATE_INTERVAL_MS);
+    connect(_rateTimer,
+            SIGNAL(timeout()),
+            this,
+            SLOT(startRequests()));
+}
+
+MapTileSeeder::~MapTileSeeder()
+{
+    this->cancel();
+}
+
+QSharedPointer<MapTileSource> MapTileSeeder::tileSource() const
+{
+    return _tileSource;
+}
+
+void MapTileSeeder::setTileSource(QSharedPointer<MapTileSource> tileSource)
+{
+    this->cancel();
+    _tileSource = tileSource;
+
+    //Run the tile source in one of the shared tile source threads, like MapGraphicsView does
+    if (!_tileSource.isNull() && _tileSource->thread() == this->thread())
+        MapTileSourceExecutor::getInstance()->adopt(_tileSource.data());
+}
+
+QPolygonF MapTileSeeder::region() const
+{
+    return _region;
+}
+
+void MapTileSeeder::setRegion(const QPolygonF &region)
+{
+    this->cancel();
+    _region = region;
+}
+
+quint8 MapTileSeeder::minZoomLevel() const
+{
+    return _minZoomLevel;
+}
+
+quint8 MapTileSeeder::maxZoomLevel() const
+{
+    return _maxZoomLevel;
+}
+
+void MapTileSeeder::setZoomRange(quint8 minZoomLevel, quint8 maxZoomLevel)
+{
+    this->cancel();
+    _minZoomLevel = qMin<quint8>(minZoomLevel, maxZoomLevel);
+    _maxZoomLevel = qMax<quint8>(minZoomLevel, maxZoomLevel);
+}
+
+int MapTileSeeder::maxConcurrentRequests() const
+{
+    return _maxConcurrentRequests;
+}
+
+void MapTileSeeder::setMaxConcurrentRequests(int maxRequests)
+{
+    _maxConcurrentRequests = qMax<int>(1, maxRequests);
+}
+
+qreal MapTileSeeder::maxRequestsPerSecond() const
+{
+    return _maxRequestsPerSecond;
+}
+
+void MapTileSeeder::setMaxRequestsPerSecond(qreal rate)
+{
+    _maxRequestsPerSecond = qMax<qreal>(0.0, rate);
+}
+
+QString MapTileSeeder::resumeFile() const
+{
+    return _resumeFile;
+}
+
+void MapTileSeeder::setResumeFile(const QString &filePath)
+{
+    _resumeFile = filePath;
+}
+
+qint64 MapTileSeeder::tileCount() const
+{
+    return _tileCount;
+}
+
+qint64 MapTileSeeder::completedCount() const
+{
+    return _completed;
+}
+
+qint64 MapTileSeeder::failedCount() const
+{
+    return _failed;
+}
+
+bool MapTileSeeder::isRunning() const
+{
+    return _running;
+}
+
+//public slot
+void MapTileSeeder::start()
+{
+    if (_running || _tileSource.isNull())
+        return;
+
+    this->planSpans();
+    _completed = 0;
+    _failed = 0;
+    _firstFailed = -1;
+
+    //Whatever was finished last time doesn't need asking for again
+    const qint64 resumeFrom = this->loadResume();
+    if (resumeFrom > 0)
+    {
+        this->skipTiles(resumeFrom);
+        _completed = resumeFrom;
+        qDebug() << "Resuming seeding of" << _tileSource->name() << "at tile" << resumeFrom << "of" << _tileCount;
+    }
+
+    _running = true;
+    this->progress(_completed, _tileCount);
+
+    //Allow one right away, then as many as the rate limit lets through
+    _requestAllowance = 1.0;
+    if (_maxRequestsPerSecond > 0.0)
+        _rateTimer->start();
+    this->startRequests();
+}
+
+//public slot
+void MapTileSeeder::cancel()
+{
+    if (!_running)
+        return;
+
+    this->saveResume();
+    foreach(quint64 token, _outstanding.values())
+        _tileSource->cancelTileRequest(token);
+    _outstanding.clear();
+    _tokenIndices.clear();
+    _rateTimer->stop();
+    _running = false;
+}
+
+//private slot
+void MapTileSeeder::handleTileDelivered(quint64 token, QImage tile, bool finished)
+{
+    //Partial tiles don't mean the tile is cached yet
+    if (!finished || !_tokenIndices.contains(token))
+        return;
+
+    const qint64 index = _tokenIndices.take(token);
+    _outstanding.remove(index);
+    _completed++;
+    if (tile.isNull())
+    {
+        _failed++;
+        if (_firstFailed < 0 || index < _firstFailed)
+            _firstFailed = index;
+        qWarning() << "Failed to seed tile" << index << "of" << _tileCount;
+    }
+
+    this->progress(_completed, _tileCount);
+    if (_completed % RESUME_SAVE_INTERVAL == 0)
+        this->saveResume();
+
+    this->startRequests();
+}
+
+//private slot
+void MapTileSeeder::startRequests()
+{
+    if (!_running)
+        return;
+
+    //A timer tick adds to the allowance. Unused allowance only builds up to one burst of concurrent requests
+    if (_maxRequestsPerSecond > 0.0 && this->sender() == _rateTimer)
+        _requestAllowance = qMin<qreal>(_maxConcurrentRequests,
+                                        _requestAllowance + _maxRequestsPerSecond * RATE_INTERVAL_MS / 1000.0);
+
+    MapTileKey key;
+    while (_outstanding.size() < _maxConcurrentRequests
+           && (_maxRequestsPerSecond <= 0.0 || _requestAllowance >= 1.0))
+    {
+        const qint64 index = _nextIndex;
+        if (!this->nextTile(&key))
+            break;
+
+        const quint64 token = _tileSource->requestTile(key.x(), key.y(), key.z(),
+                                                       MapTileSource::PrefetchPriority,
+                                                       this, "handleTileDelivered");
+        _outstanding.insert(index, token);
+        _tokenIndices.insert(token, index);
+        if (_maxRequestsPerSecond > 0.0)
+            _requestAllowance -= 1.0;
+    }
+
+    if (_outstanding.isEmpty() && _nextSpan >= _spans.size())
+        this->finish();
+}
+
+//private
+void MapTileSeeder::planSpans()
+{
+    _spans.clear();
+    _tileCount = 0;
+    _nextSpan = 0;
+    _nextX = 0;
+    _nextIndex = 0;
+    if (_region.size() < 3)
+        return;
+
+    for (int z = _minZoomLevel; z <= _maxZoomLevel; z++)
+    {
+        const qreal tileSize = _tileSource->tileSize();
+        const qint64 tilesOnEdge = (qint64)(sqrt((qreal)_tileSource->tilesOnZoomLevel(z)) + 0.5);
+        if (tilesOnEdge <= 0)
+            continue;
+
+        //The region in tile coordinates
+        QPolygonF tiles;
+        foreach(const QPointF& ll, _region)
+            tiles.append(_tileSource->ll2qgs(ll, z) / tileSize);
+        const QRectF bounds = tiles.boundingRect();
+
+        const qint64 yMin = qBound<qint64>(0, (qint64)floor(bounds.top()), tilesOnEdge - 1);
+        const qint64 yMax = qBound<qint64>(0, (qint64)floor(bounds.bottom()), tilesOnEdge - 1);
+        for (qint64 y = yMin; y <= yMax; y++)
+        {
+            //Where the region's edges pass through the row
+            qreal left = 0.0, right = 0.0;
+            bool found = false;
+            for (int i = 0; i < tiles.size(); i++)
+            {
+                const QPointF& a = tiles.at(i);
+                const QPointF& b = tiles.at((i + 1) % tiles.size());
+                const qreal low = qMax<qreal>(y, qMin<qreal>(a.y(), b.y()));
+                const qreal high = qMin<qreal>(y + 1, qMax<qreal>(a.y(), b.y()));
+                if (low > high)
+                    continue;
+
+                qreal xs[2];
+                if (a.y() == b.y())
+                {
+                    xs[0] = a.x();
+                    xs[1] = b.x();
+                }
+                else
+                {
+                    xs[0] = a.x() + (b.x() - a.x()) * (low - a.y()) / (b.y() - a.y());
+                    xs[1] = a.x() + (b.x() - a.x()) * (high - a.y()) / (b.y() - a.y());
+                }
+                for (int j = 0; j < 2; j++)
+                {
+                    left = found ? qMin<qreal>(left, xs[j]) : xs[j];
+                    right = found ? qMax<qreal>(right, xs[j]) : xs[j];
+                    found = true;
+                }
+            }
+            if (!found)
+                continue;
+
+            Span span;
+            span.z = z;
+            span.y = y;
+            span.xMin = qBound<qint64>(0, (qint64)floor(left), tilesOnEdge - 1);
+            span.xMax = qBound<qint64>(0, (qint64)floor(right), tilesOnEdge - 1);
+            _spans.append(span);
+            _tileCount += span.xMax - span.xMin + 1;
+        }
+    }
+
+    if (!_spans.isEmpty())
+        _nextX = _spans.first().xMin;
+}
+
+//private
+bool MapTileSeeder::nextTile(MapTileKey *key)
+{
+    if (_nextSpan >= _spans.size())
+        return false;
+
+    const Span& span = _spans.at(_nextSpan);
+    *key = MapTileKey(_nextX, span.y, span.z);
+    _nextIndex++;
+    if (_nextX < span.xMax)
+        _nextX++;
+    else if (++_nextSpan < _spans.size())
+        _nextX = _spans.at(_nextSpan).xMin;
+    return true;
+}
+
+//private
+void MapTileSeeder::skipTiles(qint64 count)
+{
+    //Whole spans at a time
+    while (count > 0 && _nextSpan < _spans.size())
+    {
+        const Span& span = _spans.at(_nextSpan);
+        const qint64 left = span.xMax - _nextX + 1;
+        if (count < left)
+        {
+            _nextX += count;
+            _nextIndex += count;
+            return;
+        }
+
+        count -= left;
+        _nextIndex += left;
+        if (++_nextSpan < _spans.size())
+            _nextX = _spans.at(_nextSpan).xMin;
+    }
+}
+
+//private
+qint64 MapTileSeeder::watermark() const
+{
+    //Every tile before the first outstanding one is done. Requests finish out of order, so that's all we know.
+    //Failed tiles aren't done: resuming asks for them again.
+    qint64 toRet = _nextIndex;
+    if (!_outstanding.isEmpty())
+        toRet = _outstanding.constBegin().key();
+    if (_firstFailed >= 0)
+        toRet = qMin<qint64>(toRet, _firstFailed);
+    return toRet;
+}
+
+//private
+quint64 MapTileSeeder::planHash() const
+{
+    //FNV-1a over everything that decides the plan
+    QByteArray bytes;
+    QDataStream stream(&bytes, QIODevice::WriteOnly);
+    stream << _tileSource->name() << _region << _minZoomLevel << _maxZoomLevel << _tileCount;
+
+    quint64 hash = Q_UINT64_C(14695981039346656037);
+    for (int i = 0; i < bytes.size(); i++)
+    {
+        hash ^= (uchar) bytes.at(i);
+        hash *= Q_UINT64_C(1099511628211);
+    }
+    return hash;
+}
+
+//private
+qint64 MapTileSeeder::loadResume() const
+{
+    if (_resumeFile.isEmpty())
+        return 0;
+
+    QFile fp(_resumeFile);
+    if (!fp.open(QFile::ReadOnly))
+        return 0;
+
+    QDataStream stream(&fp);
+    quint32 magic;
+    quint16 version;
+    quint64 hash;
+    qint64 done;
+    stream >> magic >> version >> hash >> done;
+
+    //Progress on some other region or zoom levels is no use
+    if (stream.status() != QDataStream::Ok || magic != RESUME_MAGIC || version != RESUME_VERSION
+            || hash != this->planHash())
+        return 0;
+    return qBound<qint64>(0, done, _tileCount);
+}
+
+//private
+void MapTileSeeder::saveResume() const
+{
+    if (_resumeFile.isEmpty())
+        return;
+
+    QFile fp(_resumeFile);
+    if (!fp.open(QFile::WriteOnly | QFile::Truncate))
+    {
+        qWarning() << "Failed to save seeding progress to" << _resumeFile << ":" << fp.errorString();
+        return;
+    }
+
+    QDataStream stream(&fp);
+    stream << RESUME_MAGIC << RESUME_VERSION << this->planHash() << this->watermark();
+}
+
+//private
+void MapTileSeeder::finish()
+{
+    _running = false;
+    _rateTimer->stop();
+
+    //Done, unless some tiles failed and are worth trying again
+    if (_failed == 0 && !_resumeFile.isEmpty())
+        QFile::remove(_resumeFile);
+    else
+        this->saveResume();
+
+    this->finished();
+}
@@ -0,0 +1,155 @@
+#ifndef MAPTILESEEDER_H
+#define MAPTILESEEDER_H
+
+#include <QObject>
+#include <QSharedPointer>
+#include <QPolygonF>
+#include <QString>
+#include <QList>
+#include <QMap>
+#include <QHash>
+#include <QImage>
+
+#include "MapGraphics_global.h"
+#include "MapTileSource.h"
+
+class QTimer;
+
+/**
+ * @brief The MapTileSeeder class fills a tile source's caches with every tile covering a region on a range of
+ * zoom levels, so the region can be viewed later without a network connection.
+ *
+ * The region is a polygon of (longitude, latitude) points. On each zoom level, each row of tiles is covered
+ * from the region's westernmost to its easternmost point in that row, which is exact for convex regions. Tiles
+ * are requested from the source at MapTileSource::PrefetchPriority and go into its caches like any others,
+ * so the source should be caching to disk. Tiles already cached come back without being downloaded again.
+ *
+ * At most maxConcurrentRequests() tiles are outstanding at once, and no more than maxRequestsPerSecond() are
+ * started each second. With a resume file, progress is saved as it goes and a later seeding of the same
+ * region and zoom levels picks up where it was stopped.
+ */
+class MAPGRAPHICSSHARED_EXPORT MapTileSeeder : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MapTileSeeder(QObject *parent = 0);
+    virtual ~MapTileSeeder();
+
+    QSharedPointer<MapTileSource> tileSource() const;
+
+    /**
+     * @brief setTileSource sets the source to seed. A source still in this seeder's thread is moved into one of
+     * the shared tile source threads.
+     */
+    void setTileSource(QSharedPointer<MapTileSource> tileSource);
+
+    QPolygonF region() const;
+    void setRegion(const QPolygonF& region);
+
+    quint8 minZoomLevel() const;
+    quint8 maxZoomLevel() const;
+    void setZoomRange(quint8 minZoomLevel, quint8 maxZoomLevel);
+
+    /**
+     * @brief maxConcurrentRequests returns how many tiles may be outstanding at once. Defaults to 4.
+     */
+    int maxConcurrentRequests() const;
+    void setMaxConcurrentRequests(int maxRequests);
+
+    /**
+     * @brief maxRequestsPerSecond returns how many tile requests may be started per second, or 0 for no
+     * limit. Defaults to 10, to stay within what public tile servers ask of bulk downloaders.
+     */
+    qreal maxRequestsPerSecond() const;
+    void setMaxRequestsPerSecond(qreal rate);
+
+    /**
+     * @brief resumeFile returns the file progress is saved to, or an empty string (the default) for none
+     */
+    QString resumeFile() const;
+    void setResumeFile(const QString& filePath);
+
+    /**
+     * @brief tileCount returns how many tiles cover the region on the zoom levels. Only valid once seeding has
+     * started.
+     */
+    qint64 tileCount() const;
+    qint64 completedCount() const;
+    qint64 failedCount() const;
+
+    bool isRunning() const;
+
+public slots:
+    /**
+     * @brief start plans the tiles and starts requesting them. Emits finished() right away if there's
+     * nothing to do.
+     */
+    void start();
+
+    /**
+     * @brief cancel withdraws the outstanding requests and stops, saving progress to the resume file
+     */
+    void cancel();
+
+signals:
+    void progress(qint64 completed, qint64 total);
+
+    /**
+     * @brief finished is emitted once every tile has been requested and has arrived or failed
+     */
+    void finished();
+
+private slots:
+    void handleTileDelivered(quint64 token, QImage tile, bool finished);
+    void startRequests();
+
+private:
+    //The tiles x in [xMin, xMax] of row y on zoom level z
+    struct Span
+    {
+        quint8 z;
+        quint32 y;
+        quint32 xMin;
+        quint32 xMax;
+    };
+
+    void planSpans();
+    bool nextTile(MapTileKey * key);
+    void skipTiles(qint64 count);
+    qint64 watermark() const;
+    quint64 planHash() const;
+    qint64 loadResume() const;
+    void saveResume() const;
+    void finish();
+
+    QSharedPointer<MapTileSource> _tileSource;
+    QPolygonF _region;
+    quint8 _minZoomLevel;
+    quint8 _maxZoomLevel;
+    int _maxConcurrentRequests;
+    qreal _maxRequestsPerSecond;
+    QString _resumeFile;
+
+    QList<Span> _spans;
+    qint64 _tileCount;
+
+    //Where the next tile to request is: a span and an x within it, and its index among all the tiles
+    int _nextSpan;
+    quint32 _nextX;
+    qint64 _nextIndex;
+
+    //Request tokens of the outstanding tiles by their index, so the lowest unfinished one is first
+    QMap<qint64, quint64> _outstanding;
+    QHash<quint64, qint64> _tokenIndices;
+
+    qint64 _completed;
+    qint64 _failed;
+
+    //Index of the first tile that failed, or -1
+    qint64 _firstFailed;
+    qreal _requestAllowance;
+    bool _running;
+    QTimer * _rateTimer;
+};
+
+#endif // MAPTILESEEDER_H
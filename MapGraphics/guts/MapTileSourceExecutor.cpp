@@ -0,0 +1,115 @@
+#include "MapTileSourceExecutor.h"
+
+#include <QThread>
+#include <QMutexLocker>
+
+//Tile sources are mostly idle, so more threads than this would only add context switches
+const int DEFAULT_MAX_THREADS_CAP = 4;
+
+//static
+MapTileSourceExecutor * MapTileSourceExecutor::_instance = 0;
+QMutex MapTileSourceExecutor::_instanceMutex;
+
+//static
+MapTileSourceExecutor *MapTileSourceExecutor::getInstance()
+{
+    QMutexLocker lock(&_instanceMutex);
+    if (MapTileSourceExecutor::_instance == 0)
+        MapTileSourceExecutor::_instance = new MapTileSourceExecutor();
+    return MapTileSourceExecutor::_instance;
+}
+
+void MapTileSourceExecutor::adopt(QObject *source)
+{
+    if (source == 0)
+        return;
+
+    QMutexLocker lock(&_lock);
+    if (_sources.contains(source))
+        return;
+
+    //Least busy thread first, but an idle new thread beats sharing while we're allowed more
+    QThread * thread = 0;
+    foreach(QThread * candidate, _threads)
+    {
+        if (thread == 0 || _load.value(candidate) < _load.value(thread))
+            thread = candidate;
+    }
+
+    if (thread == 0 || (_load.value(thread) > 0 && _threads.size() < _maxThreads))
+    {
+        thread = new QThread();
+        thread->start();
+        _threads.append(thread);
+        _load.insert(thread, 0);
+    }
+
+    _load[thread]++;
+    _sources.insert(source, thread);
+    lock.unlock();
+
+    source->moveToThread(thread);
+
+    //Direct, so the source is forgotten right as it's destroyed, in whatever thread that happens
+    connect(source,
+            SIGNAL(destroyed(QObject*)),
+            this,
+            SLOT(handleSourceDestroyed(QObject*)),
+            Qt::DirectConnection);
+}
+
+int MapTileSourceExecutor::maxThreads() const
+{
+    QMutexLocker lock(&_lock);
+    return _maxThreads;
+}
+
+void MapTileSourceExecutor::setMaxThreads(int maxThreads)
+{
+    QMutexLocker lock(&_lock);
+    _maxThreads = qMax<int>(1, maxThreads);
+}
+
+int MapTileSourceExecutor::threadCount() const
+{
+    QMutexLocker lock(&_lock);
+    return _threads.size();
+}
+
+//private slot
+void MapTileSourceExecutor::handleSourceDestroyed(QObject *source)
+{
+    QMutexLocker lock(&_lock);
+    if (!_sources.contains(source))
+        return;
+
+    QThread * thread = _sources.take(source);
+    if (--_load[thread] > 0)
+        return;
+
+    //That was the last source in the thread, so shut it down
+    _load.remove(thread);
+    _threads.removeAll(thread);
+    lock.unlock();
+
+    thread->quit();
+
+    //A thread can't wait for itself. This happens when a source is destroyed by another in the same thread
+    if (QThread::currentThread() == thread)
+    {
+        connect(thread,
+                SIGNAL(finished()),
+                thread,
+                SLOT(deleteLater()));
+        return;
+    }
+
+    thread->wait();
+    delete thread;
+}
+
+//private
+MapTileSourceExecutor::MapTileSourceExecutor() :
+    QObject(), _maxThreads(qBound<int>(1, QThread::idealThreadCount(), DEFAULT_MAX_THREADS_CAP))
+{
+}
@@ -0,0 +1,59 @@
+#ifndef MAPTILESOURCEEXECUTOR_H
+#define MAPTILESOURCEEXECUTOR_H
+
+#include <QObject>
+#include <QMutex>
+#include <QHash>
+#include <QList>
+
+class QThread;
+
+/**
+ * @brief The MapTileSourceExecutor class runs tile sources on a small shared set of threads instead of one
+ * thread per source. A tile source spends most of its time waiting for the network or the disk, and its
+ * decoding runs in the global QThreadPool, so a handful of threads can serve many layers. Fewer threads
+ * also means fewer network managers, since MapGraphicsNetwork keeps one per thread.
+ *
+ * adopt() moves a source into the least busy thread, starting a new one while there are fewer than
+ * maxThreads(). A thread is shut down once the last source in it is destroyed.
+ */
+class MapTileSourceExecutor : public QObject
+{
+    Q_OBJECT
+public:
+    static MapTileSourceExecutor * getInstance();
+
+    /**
+     * @brief adopt moves source into one of the executor's threads. Like QObject::moveToThread(), it must be
+     * called from the thread source currently lives in, and source must not have a parent.
+     */
+    void adopt(QObject * source);
+
+    /**
+     * @brief maxThreads is how many threads the executor runs at most. Changing it only affects sources
+     * adopted afterwards.
+     */
+    int maxThreads() const;
+    void setMaxThreads(int maxThreads);
+
+    int threadCount() const;
+
+private slots:
+    void handleSourceDestroyed(QObject * source);
+
+private:
+    MapTileSourceExecutor();
+
+    static MapTileSourceExecutor * _instance;
+    static QMutex _instanceMutex;
+
+    mutable QMutex _lock;
+    int _maxThreads;
+    QList<QThread *> _threads;
+
+    //How many sources live in each thread, and which thread each source lives in
+    QHash<QThread *, int> _load;
+    QHash<QObject *, QThread *> _sources;
+};
+
+#endif // MAPTILESOURCEEXECUTOR_H
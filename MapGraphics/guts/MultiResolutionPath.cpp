@@ -0,0 +1,213 @@
+#include "MultiResolutionPath.h"
+
+#include <QtGlobal>
+#include <cmath>
+#include <limits>
+
+//Most edges a chunk of the path is ranked over at once
+const int CHUNK_EDGES = 1024;
+
+/*
+ * A range of vertices (first, last) still to be split, and the importance of the vertex that split off it
+*/
+struct PendingRange
+{
+    int first;
+    int last;
+    qreal parentImportance;
+};
+
+//non-member
+static qreal distanceToSegment(const QPointF& p, const QPointF& a, const QPointF& b)
+{
+    const qreal dx = b.x() - a.x();
+    const qreal dy = b.y() - a.y();
+    const qreal lengthSq = dx * dx + dy * dy;
+
+    qreal t = 0.0;
+    if (lengthSq > 0.0)
+        t = qBound<qreal>(0.0, ((p.x() - a.x()) * dx + (p.y() - a.y()) * dy) / lengthSq, 1.0);
+
+    const qreal ex = p.x() - (a.x() + t * dx);
+    const qreal ey = p.y() - (a.y() + t * dy);
+    return sqrt(ex * ex + ey * ey);
+}
+
+MultiResolutionPath::MultiResolutionPath(const QPolygonF &points)
+{
+    this->setPoints(points);
+}
+
+const QPolygonF &MultiResolutionPath::points() const
+{
+    return _points;
+}
+
+void MultiResolutionPath::setPoints(const QPolygonF &points)
+{
+    _points = points;
+    _importance.fill(0.0, _points.size());
+    _chunkStarts.clear();
+    this->_rankChunks(0, _points.size() - 1);
+}
+
+void MultiResolutionPath::replace(int first, int count, const QPolygonF &points)
+{
+    first = qBound<int>(0, first, _points.size());
+    count = qBound<int>(0, count, _points.size() - first);
+    const int delta = points.size() - count;
+    const int newSize = _points.size() + delta;
+
+    //Chunks that lie wholly before or after the change keep their ranks. The rest are ranked again.
+    int keptBefore = 0;
+    while (keptBefore < _chunkStarts.size() && this->_chunkEnd(keptBefore) < first)
+        keptBefore++;
+    int keptAfter = _chunkStarts.size();
+    while (keptAfter > keptBefore && _chunkStarts.at(keptAfter - 1) >= first + count)
+        keptAfter--;
+
+    QPolygonF updatedPoints;
+    updatedPoints.reserve(newSize);
+    QVector<qreal> updatedImportance;
+    updatedImportance.reserve(newSize);
+    for (int i = 0; i < first; i++)
+    {
+        updatedPoints.append(_points.at(i));
+        updatedImportance.append(_importance.at(i));
+    }
+    updatedPoints += points;
+    for (int i = 0; i < points.size(); i++)
+        updatedImportance.append(0.0);
+    for (int i = first + count; i < _points.size(); i++)
+    {
+        updatedPoints.append(_points.at(i));
+        updatedImportance.append(_importance.at(i));
+    }
+
+    //The vertices from the end of the last chunk kept before to the start of the first kept after
+    const int rankFirst = (keptBefore > 0) ? this->_chunkEnd(keptBefore - 1) : 0;
+    const int rankLast = (keptAfter < _chunkStarts.size()) ? _chunkStarts.at(keptAfter) + delta : newSize - 1;
+
+    const QVector<int> oldStarts = _chunkStarts;
+    _points = updatedPoints;
+    _importance = updatedImportance;
+    _chunkStarts = oldStarts.mid(0, keptBefore);
+    if (rankLast > rankFirst || (keptBefore == 0 && keptAfter == oldStarts.size()))
+        this->_rankChunks(rankFirst, rankLast);
+    for (int i = keptAfter; i < oldStarts.size(); i++)
+        _chunkStarts.append(oldStarts.at(i) + delta);
+}
+
+int MultiResolutionPath::size() const
+{
+    return _points.size();
+}
+
+qreal MultiResolutionPath::importance(int index) const
+{
+    return _importance.value(index, 0.0);
+}
+
+QPolygonF MultiResolutionPath::simplified(qreal tolerance) const
+{
+    QPolygonF toRet;
+    for (int i = 0; i < _points.size(); i++)
+    {
+        if (_importance.at(i) > tolerance)
+            toRet.append(_points.at(i));
+    }
+    return toRet;
+}
+
+QVector<int> MultiResolutionPath::simplifiedIndices(qreal tolerance) const
+{
+    QVector<int> toRet;
+    for (int i = 0; i < _points.size(); i++)
+    {
+        if (_importance.at(i) > tolerance)
+            toRet.append(i);
+    }
+    return toRet;
+}
+
+//private
+int MultiResolutionPath::_chunkEnd(int chunk) const
+{
+    return (chunk + 1 < _chunkStarts.size()) ? _chunkStarts.at(chunk + 1) : _points.size() - 1;
+}
+
+//private
+void MultiResolutionPath::_rankChunks(int first, int last)
+{
+    if (last < first)
+        return;
+
+    //Even chunks of at most CHUNK_EDGES edges
+    const int edges = last - first;
+    const int chunks = qMax<int>(1, (edges + CHUNK_EDGES - 1) / CHUNK_EDGES);
+    for (int c = 0; c < chunks; c++)
+    {
+        const int chunkFirst = first + (int) ((qint64) edges * c / chunks);
+        const int chunkLast = first + (int) ((qint64) edges * (c + 1) / chunks);
+        _chunkStarts.append(chunkFirst);
+        this->_rankChunk(chunkFirst, chunkLast);
+    }
+}
+
+//private
+void MultiResolutionPath::_rankChunk(int first, int last)
+{
+    const qreal infinity = std::numeric_limits<qreal>::max();
+    _importance[first] = infinity;
+    _importance[last] = infinity;
+    for (int i = first + 1; i < last; i++)
+        _importance[i] = 0.0;
+    if (last - first < 2)
+        return;
+
+    //Same splitting order as recursive Douglas-Peucker, but with an explicit stack so long paths can't overflow
+    QVector<PendingRange> stack;
+    PendingRange whole;
+    whole.first = first;
+    whole.last = last;
+    whole.parentImportance = infinity;
+    stack.append(whole);
+
+    while (!stack.isEmpty())
+    {
+        const PendingRange range = stack.last();
+        stack.pop_back();
+        if (range.last - range.first < 2)
+            continue;
+
+        const QPointF& a = _points.at(range.first);
+        const QPointF& b = _points.at(range.last);
+        int farthest = range.first + 1;
+        qreal farthestDistance = -1.0;
+        for (int i = range.first + 1; i < range.last; i++)
+        {
+            const qreal distance = distanceToSegment(_points.at(i), a, b);
+            if (distance > farthestDistance)
+            {
+                farthest = i;
+                farthestDistance = distance;
+            }
+        }
+
+        //A vertex can only survive while the vertex that split its range does
+        const qreal importance = qMin<qreal>(farthestDistance, range.parentImportance);
+        _importance[farthest] = importance;
+
+        PendingRange left;
+        left.first = range.first;
+        left.last = farthest;
+        left.parentImportance = importance;
+        stack.append(left);
+
+        PendingRange right;
+        right.first = farthest;
+        right.last = range.last;
+        right.parentImportance = importance;
+        stack.append(right);
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef MULTIRESOLUTIONPATH_H
+#define MULTIRESOLUTIONPATH_H
+
+#include <QPolygonF>
+#include <QVector>
+
+#include "MapGraphics_global.h"
+
+/**
+ * @brief The MultiResolutionPath class precomputes a Douglas-Peucker simplification of a polyline for every
+ * tolerance at once.
+ *
+ * Each vertex is ranked by the tolerance below which Douglas-Peucker would keep it (clamped so that a vertex
+ * never outranks the one that split its range). Simplifying to any tolerance is then a single pass that keeps
+ * the vertices ranked above it, and gives exactly what running Douglas-Peucker with that tolerance would.
+ * The endpoints are always kept.
+ *
+ * Long paths are ranked in chunks of about a thousand vertices, each on its own, so that replace() only ranks
+ * again the chunks around the points that changed. The vertices between chunks are always kept too, which
+ * costs about one extra vertex per chunk.
+ */
+class MAPGRAPHICSSHARED_EXPORT MultiResolutionPath
+{
+public:
+    MultiResolutionPath(const QPolygonF& points = QPolygonF());
+
+    const QPolygonF& points() const;
+    void setPoints(const QPolygonF& points);
+
+    /**
+     * @brief replace swaps the count points starting at first for points. Only the chunks holding changed
+     * points are ranked again, so changing the end of a long path costs little more than the change.
+     */
+    void replace(int first, int count, const QPolygonF& points);
+
+    int size() const;
+
+    /**
+     * @brief importance returns the largest tolerance at which the vertex at index survives simplification
+     */
+    qreal importance(int index) const;
+
+    /**
+     * @brief simplified returns the vertices that Douglas-Peucker keeps with the given tolerance, in order.
+     * The tolerance is in the same units as the points.
+     */
+    QPolygonF simplified(qreal tolerance) const;
+
+    /**
+     * @brief simplifiedIndices returns the indices of the vertices simplified() keeps, in order
+     */
+    QVector<int> simplifiedIndices(qreal tolerance) const;
+
+private:
+    int _chunkEnd(int chunk) const;
+
+    //Splits the vertices from first to last into chunks and ranks them
+    void _rankChunks(int first, int last);
+    void _rankChunk(int first, int last);
+
+    QPolygonF _points;
+    QVector<qreal> _importance;
+
+    //Index of the first vertex of each chunk. A chunk ends at the first vertex of the next, or at the last vertex.
+    QVector<int> _chunkStarts;
+};
+
+#endif // MULTIRESOLUTIONPATH_H
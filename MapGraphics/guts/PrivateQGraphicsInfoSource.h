@@ -5,6 +5,8 @@
 
 #include "MapTileSource.h"
 
+class MapRenderProfiler;
+
 /*!
  \brief This abstract class is inherited by MapGraphicsView as an implementation of
  the "dependency inversion" design pattern, or at least as well as I can remember it.
@@ -22,6 +24,9 @@ public:
     virtual quint8 zoomLevel() const=0;
 
     virtual QSharedPointer<MapTileSource> tileSource() const=0;
+
+    //Null unless render profiling is on
+    virtual MapRenderProfiler * renderProfiler() const=0;
 };
 
 #endif // PRIVATEQGRAPHICSINFOSOURCE_H
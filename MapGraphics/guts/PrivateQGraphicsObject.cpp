@@ -2,13 +2,16 @@
 
 #include <QtDebug>
 #include <QKeyEvent>
+#include <QElapsedTimer>
 
 #include "guts/Conversions.h"
+#include "guts/ENUConverter.h"
+#include "guts/MapRenderProfiler.h"
 
 PrivateQGraphicsObject::PrivateQGraphicsObject(MapGraphicsObject *mgObj,
                                                PrivateQGraphicsInfoSource *infoSource,
                                                QGraphicsItem *parent) :
-    QGraphicsObject(parent), _infoSource(infoSource)
+    QGraphicsObject(parent), _infoSource(infoSource), _boundingRectValid(false), _cachedZoomLevel(-1)
 {
     this->setMGObj(mgObj);
     this->setZValue(5.0);
@@ -25,53 +28,39 @@ PrivateQGraphicsObject::~PrivateQGraphicsObject()
 //pure-virtual from QGraphicsItem
 QRectF PrivateQGraphicsObject::boundingRect() const
 {
-    QRectF toRet(-1.0,-1.0,2.0,2.0);
     if (_mgObj.isNull())
     {
         qWarning() << "Warning:" << this << "could not get bounding rect as MapGraphicsObject is null";
-        return toRet;
+        return QRectF(-1.0,-1.0,2.0,2.0);
     }
 
-    //If the object's size is zoom invariant (e.g., labels or markers) then assume the rect's units are pixels
-    if (_mgObj->sizeIsZoomInvariant())
-        return _mgObj->boundingRect();
-
-    //Otherwise, assume they're meters and do some conversions!
-    QRectF enuRect = _mgObj->boundingRect();
-
-    //Convert from ENU to lat/lon
-    QPointF latLonCenter = _mgObj->pos();
-    Position latLonCenterPos(latLonCenter, 0.0);
-    QPointF leftLatLon = Conversions::enu2lla(enuRect.left(),
-                                              0.0,
-                                              0.0,
-                                              latLonCenterPos).lonLat();
-    QPointF upLatLon = Conversions::enu2lla(0.0,
-                                            enuRect.top(),
-                                            0.0,
-                                            latLonCenterPos).lonLat();
-
-    qreal lonWidth = 2.0*(latLonCenter.x() - leftLatLon.x());
-    qreal latHeight = 2.0*(upLatLon.y() - latLonCenter.y());
-
-    //Once we've got the rect in lat/lon, we should convert it to scene pixels
-    QRectF latLonRect(leftLatLon.x(),upLatLon.y(),lonWidth,latHeight);
+    MapRenderProfiler * profiler = _infoSource->renderProfiler();
 
-    //We need our tile source to do the conversion
-    QSharedPointer<MapTileSource> tileSource = _infoSource->tileSource();
-    if (tileSource.isNull())
+    //Normally the slots below invalidate the cache, but double check the cheap parts of the key
+    if (_boundingRectValid
+            && _cachedZoomLevel == (int)_infoSource->zoomLevel()
+            && _cachedPos == _mgObj->pos())
     {
-        qWarning() << this << "can't do bounding box conversion, null tile source.";
-        return toRet;
+        if (profiler != 0)
+            profiler->addBoundingRectHit(_mgObj->metaObject());
+        return _cachedBoundingRect;
     }
 
-    int zoomLevel = _infoSource->zoomLevel();
-    QPointF topLeft = tileSource->ll2qgs(latLonRect.topLeft(),zoomLevel);
-    QPointF bottomRight = tileSource->ll2qgs(latLonRect.bottomRight(),zoomLevel);
+    QElapsedTimer clock;
+    if (profiler != 0)
+        clock.start();
 
-    toRet = QRectF(topLeft,bottomRight);
-    toRet.moveCenter(QPointF(0,0));
-    return toRet;
+    _cachedMGRect = _mgObj->boundingRect();
+    _cachedPos = _mgObj->pos();
+    _cachedZoomLevel = _infoSource->zoomLevel();
+    _cachedBoundingRect = this->_computeBoundingRect();
+
+    //Without a tile source we only have a placeholder rect, so don't hang on to it
+    _boundingRectValid = _mgObj->sizeIsZoomInvariant() || !_infoSource->tileSource().isNull();
+
+    if (profiler != 0)
+        profiler->addBoundingRectMiss(_mgObj->metaObject(), clock.nsecsElapsed());
+    return _cachedBoundingRect;
 }
 
 //virtual from QGraphicsItem
@@ -105,16 +94,31 @@ void PrivateQGraphicsObject::paint(QPainter *painter, const QStyleOptionGraphics
         return;
     }
 
+    //Objects sized in meters that have shrunk below a pixel can't be seen, so don't make them paint
+    if (!_mgObj->sizeIsZoomInvariant() && !this->isSelected())
+    {
+        const QRectF pixelRect = this->boundingRect();
+        if (pixelRect.width() < 1.0 && pixelRect.height() < 1.0)
+            return;
+    }
+
+    //Timed from here so that the bounding rect work above counts as bounding rect time, not paint time
+    MapRenderProfiler * profiler = _infoSource->renderProfiler();
+    QElapsedTimer clock;
+    if (profiler != 0)
+        clock.start();
+
     painter->save();
     painter->scale(1.0,-1.0);
 
     //Transform painter coordinates to the object's bounding box and then have the MapGraphicsObject do its thing
     if (!_mgObj->sizeIsZoomInvariant())
     {
-        QRectF enuRect = _mgObj->boundingRect();
+        //boundingRect() refreshes _cachedMGRect if needed, so call it first
+        QRectF pixelRect = this->boundingRect();
+        const QRectF& enuRect = _cachedMGRect;
         qreal desiredWidthMeters = enuRect.width();
         qreal desiredHeightMeters = enuRect.height();
-        QRectF pixelRect = this->boundingRect();
         qreal widthPixels = pixelRect.width();
         qreal heightPixels = pixelRect.height();
 
@@ -130,6 +134,9 @@ void PrivateQGraphicsObject::paint(QPainter *painter, const QStyleOptionGraphics
 
     if (this->isSelected())
         painter->drawRect(this->boundingRect());
+
+    if (profiler != 0)
+        profiler->addPaint(_mgObj->metaObject(), clock.nsecsElapsed());
 }
 
 //override from QGraphicsItem
@@ -141,6 +148,32 @@ void PrivateQGraphicsObject::setSelected(bool selected)
     _mgObj->setSelected(this->isSelected());
 }
 
+void PrivateQGraphicsObject::prepareForZoomLevel()
+{
+    _mgObj->zoomLevelChangedEvent(_infoSource->zoomLevel());
+}
+
+QPointF PrivateQGraphicsObject::geoPos() const
+{
+    //TODO:If the object has a parent, do stupid stuff here to handle it
+    return _mgObj->pos();
+}
+
+void PrivateQGraphicsObject::setQGSPos(const QPointF &qgsPos)
+{
+    //Our size in pixels depends on both where we are and the zoom level
+    this->_invalidateBoundingRect();
+
+    /*
+      We disable the position change notifications to itemChange() before calling setPos so that
+      itemChange() doesn't cause another change to geoPos. i.e., it isn't treated as if the object
+      has been moved by the mouse. Don't think about it too much.
+    */
+    this->setFlag(QGraphicsObject::ItemSendsScenePositionChanges,false);
+    this->setPos(qgsPos);
+    this->setFlag(QGraphicsObject::ItemSendsScenePositionChanges,true);
+}
+
 //protected
 void PrivateQGraphicsObject::contextMenuEvent(QGraphicsSceneContextMenuEvent *event)
 {
@@ -294,6 +327,8 @@ void PrivateQGraphicsObject::wheelEvent(QGraphicsSceneWheelEvent *event)
 //public slot
 void PrivateQGraphicsObject::handleZoomLevelChanged()
 {
+    //Let the object pick its level of detail before we ask it for its bounding rect again
+    this->prepareForZoomLevel();
     this->handlePosChanged();
 }
 
@@ -318,27 +353,16 @@ void PrivateQGraphicsObject::handleParentChanged()
 //private slot
 void PrivateQGraphicsObject::handlePosChanged()
 {
-    //Get the position of the object in lat,lon,alt
-    QPointF geoPos = _mgObj->pos();
-
-    //TODO:If the object has a parent, do stupid stuff here to handle it
-
     //Convert LLA coordinates to QGraphicsScene coordinates
     QSharedPointer<MapTileSource> tileSource = _infoSource->tileSource();
     if (tileSource.isNull())
+    {
+        //Our size in pixels depends on both where we are and the zoom level
+        this->_invalidateBoundingRect();
         return;
+    }
 
-    int zoomLevel = _infoSource->zoomLevel();
-    QPointF qgsPos = tileSource->ll2qgs(geoPos,zoomLevel);
-
-    /*
-      We disable the position change notifications to itemChange() before calling setPos so that
-      itemChange() doesn't cause another change to geoPos. i.e., it isn't treated as if the object
-      has been moved by the mouse. Don't think about it too much.
-    */
-    this->setFlag(QGraphicsObject::ItemSendsScenePositionChanges,false);
-    this->setPos(qgsPos);
-    this->setFlag(QGraphicsObject::ItemSendsScenePositionChanges,true);
+    this->setQGSPos(tileSource->ll2qgs(this->geoPos(),_infoSource->zoomLevel()));
 }
 
 //private slot
@@ -417,6 +441,8 @@ void PrivateQGraphicsObject::updateAllFromMG()
 //private slot
 void PrivateQGraphicsObject::handleRedrawRequested()
 {
+    //MapGraphicsObjects ask for a redraw when their geometry changes (e.g., CircleObject::setRadius())
+    this->_invalidateBoundingRect();
     this->update();
 }
 
@@ -485,6 +511,7 @@ void PrivateQGraphicsObject::setMGObj(MapGraphicsObject * mgObj)
             SLOT(handleRedrawRequested()));
 
     //Get all of the info about the MGObject
+    _mgObj->zoomLevelChangedEvent(_infoSource->zoomLevel());
     this->updateAllFromMG();
 
     connect(mgObj,
@@ -493,6 +520,59 @@ void PrivateQGraphicsObject::setMGObj(MapGraphicsObject * mgObj)
             SLOT(deleteLater()));
 }
 
+//private
+QRectF PrivateQGraphicsObject::_computeBoundingRect() const
+{
+    QRectF toRet(-1.0,-1.0,2.0,2.0);
+
+    //If the object's size is zoom invariant (e.g., labels or markers) then assume the rect's units are pixels
+    if (_mgObj->sizeIsZoomInvariant())
+        return _cachedMGRect;
+
+    //Otherwise, assume they're meters and do some conversions!
+    const QRectF& enuRect = _cachedMGRect;
+
+    //Convert from ENU to lat/lon
+    QPointF latLonCenter = _mgObj->pos();
+    Position latLonCenterPos(latLonCenter, 0.0);
+    const ENUConverter converter(latLonCenterPos);
+    QPointF leftLatLon = converter.enu2lla(enuRect.left(),
+                                           0.0,
+                                           0.0).lonLat();
+    QPointF upLatLon = converter.enu2lla(0.0,
+                                         enuRect.top(),
+                                         0.0).lonLat();
+
+    qreal lonWidth = 2.0*(latLonCenter.x() - leftLatLon.x());
+    qreal latHeight = 2.0*(upLatLon.y() - latLonCenter.y());
+
+    //Once we've got the rect in lat/lon, we should convert it to scene pixels
+    QRectF latLonRect(leftLatLon.x(),upLatLon.y(),lonWidth,latHeight);
+
+    //We need our tile source to do the conversion
+    QSharedPointer<MapTileSource> tileSource = _infoSource->tileSource();
+    if (tileSource.isNull())
+    {
+        qWarning() << this << "can't do bounding box conversion, null tile source.";
+        return toRet;
+    }
+
+    QPointF corners[2] = {latLonRect.topLeft(), latLonRect.bottomRight()};
+    tileSource->ll2qgsBatch(corners,corners,2,_infoSource->zoomLevel());
+
+    toRet = QRectF(corners[0],corners[1]);
+    toRet.moveCenter(QPointF(0,0));
+    return toRet;
+}
+
+//private
+void PrivateQGraphicsObject::_invalidateBoundingRect()
+{
+    //Tell the scene before our geometry changes so that it can update its index
+    this->prepareGeometryChange();
+    _boundingRectValid = false;
+}
+
 //private
 void PrivateQGraphicsObject::convertSceneMouseEventCoordinates(QGraphicsSceneMouseEvent *event)
 {
@@ -30,6 +30,15 @@ public:
     //override from QGraphicsItem
     void setSelected(bool selected);
 
+    /*
+      The pieces of handleZoomLevelChanged(), for PrivateQGraphicsScene to reposition many objects with one
+      projection call: let the object pick its level of detail, ask where it is, then move it to the scene position
+      that was projected for it.
+    */
+    void prepareForZoomLevel();
+    QPointF geoPos() const;
+    void setQGSPos(const QPointF& qgsPos);
+
 protected:
     //virtual from QGraphicsItem
     virtual void contextMenuEvent(QGraphicsSceneContextMenuEvent *event);
@@ -84,12 +93,26 @@ private slots:
 private:
     void setMGObj(MapGraphicsObject *);
 
+    QRectF _computeBoundingRect() const;
+    void _invalidateBoundingRect();
+
     void convertSceneMouseEventCoordinates(QGraphicsSceneMouseEvent * event);
     void unconvertSceneMouseEventCoorindates(QGraphicsSceneMouseEvent * event);
     QHash<QGraphicsSceneMouseEvent *, QPointF> _unconvertedSceneMouseCoordinates;
 
     QPointer<MapGraphicsObject> _mgObj;
     PrivateQGraphicsInfoSource * _infoSource;
+
+    /*
+     * boundingRect() gets called many times per frame, so we cache its result (and the MapGraphicsObject's rect
+     * that it was derived from) along with the geo position and zoom level it was computed for.
+     * _invalidateBoundingRect() throws the cache out when any of those change.
+    */
+    mutable bool _boundingRectValid;
+    mutable QRectF _cachedBoundingRect;
+    mutable QRectF _cachedMGRect;
+    mutable QPointF _cachedPos;
+    mutable int _cachedZoomLevel;
     
 };
 
@@ -2,9 +2,12 @@
 
 #include <QtDebug>
 #include <QSet>
+#include <QVector>
 
 #include "MapGraphicsScene.h"
 
+const int BIG_BATCH_SIZE = 64;
+
 PrivateQGraphicsScene::PrivateQGraphicsScene(MapGraphicsScene * mgScene,
                                              PrivateQGraphicsInfoSource *infoSource,
                                              QObject *parent) :
@@ -19,7 +22,35 @@ PrivateQGraphicsScene::PrivateQGraphicsScene(MapGraphicsScene * mgScene,
 }
 
 //private slot
-void PrivateQGraphicsScene::handleMGObjectAdded(MapGraphicsObject * added)
+void PrivateQGraphicsScene::handleMGObjectsAdded(const QList<MapGraphicsObject *> &added)
+{
+    const bool bigBatch = isBigBatch(added.size());
+    if (bigBatch)
+        this->setItemIndexMethod(QGraphicsScene::NoIndex);
+
+    foreach(MapGraphicsObject * obj, added)
+        this->addMGObject(obj);
+
+    if (bigBatch)
+        this->setItemIndexMethod(QGraphicsScene::BspTreeIndex);
+}
+
+//private slot
+void PrivateQGraphicsScene::handleMGObjectsRemoved(const QList<MapGraphicsObject *> &removed)
+{
+    const bool bigBatch = isBigBatch(removed.size());
+    if (bigBatch)
+        this->setItemIndexMethod(QGraphicsScene::NoIndex);
+
+    foreach(MapGraphicsObject * obj, removed)
+        this->removeMGObject(obj);
+
+    if (bigBatch)
+        this->setItemIndexMethod(QGraphicsScene::BspTreeIndex);
+}
+
+//private
+void PrivateQGraphicsScene::addMGObject(MapGraphicsObject * added)
 {
     PrivateQGraphicsObject * qgObj = new PrivateQGraphicsObject(added,_infoSource);
     this->addItem(qgObj);
@@ -28,8 +59,8 @@ void PrivateQGraphicsScene::handleMGObjectAdded(MapGraphicsObject * added)
     _mgToqg.insert(added,qgObj);
 }
 
-//private slot
-void PrivateQGraphicsScene::handleMGObjectRemoved(MapGraphicsObject * removed)
+//private
+void PrivateQGraphicsScene::removeMGObject(MapGraphicsObject * removed)
 {
     if (!_mgToqg.contains(removed))
     {
@@ -58,8 +89,31 @@ void PrivateQGraphicsScene::handleMGObjectRemoved(MapGraphicsObject * removed)
 
 void PrivateQGraphicsScene::handleZoomLevelChanged()
 {
-    foreach(PrivateQGraphicsObject * obj, _mgToqg.values())
-        obj->handleZoomLevelChanged();
+    const QList<PrivateQGraphicsObject *> objects = _mgToqg.values();
+    QSharedPointer<MapTileSource> tileSource = _infoSource->tileSource();
+    if (!isBigBatch(objects.size()) || tileSource.isNull())
+    {
+        foreach(PrivateQGraphicsObject * obj, objects)
+            obj->handleZoomLevelChanged();
+        return;
+    }
+
+    //Everything moves, so project all of the positions in one span and rebuild the index once afterwards
+    this->setItemIndexMethod(QGraphicsScene::NoIndex);
+
+    QVector<QPointF> positions(objects.size());
+    for (int i = 0; i < objects.size(); i++)
+    {
+        objects.at(i)->prepareForZoomLevel();
+        positions[i] = objects.at(i)->geoPos();
+    }
+
+    tileSource->ll2qgsBatch(positions.constData(),positions.data(),positions.size(),_infoSource->zoomLevel());
+
+    for (int i = 0; i < objects.size(); i++)
+        objects.at(i)->setQGSPos(positions.at(i));
+
+    this->setItemIndexMethod(QGraphicsScene::BspTreeIndex);
 }
 
 void PrivateQGraphicsScene::handleSelectionChanged()
@@ -97,12 +151,18 @@ void PrivateQGraphicsScene::setMapGraphicsScene(MapGraphicsScene *mgScene)
     }
 
     connect(_mgScene.data(),
-            SIGNAL(objectAdded(MapGraphicsObject*)),
+            SIGNAL(objectsAdded(QList<MapGraphicsObject*>)),
             this,
-            SLOT(handleMGObjectAdded(MapGraphicsObject*)));
+            SLOT(handleMGObjectsAdded(QList<MapGraphicsObject*>)));
     connect(_mgScene.data(),
-            SIGNAL(objectRemoved(MapGraphicsObject*)),
+            SIGNAL(objectsRemoved(QList<MapGraphicsObject*>)),
             this,
-            SLOT(handleMGObjectRemoved(MapGraphicsObject*)));
+            SLOT(handleMGObjectsRemoved(QList<MapGraphicsObject*>)));
 
 }
+
+//private static
+bool PrivateQGraphicsScene::isBigBatch(int count)
+{
+    return count > BIG_BATCH_SIZE;
+}
@@ -24,14 +24,22 @@ signals:
 public slots:
 
 private slots:
-    void handleMGObjectAdded(MapGraphicsObject *);
-    void handleMGObjectRemoved(MapGraphicsObject *);
+    void handleMGObjectsAdded(const QList<MapGraphicsObject *>& added);
+    void handleMGObjectsRemoved(const QList<MapGraphicsObject *>& removed);
     void handleZoomLevelChanged();
 
     void handleSelectionChanged();
 
 private:
     void setMapGraphicsScene(MapGraphicsScene * mgScene);
+    void addMGObject(MapGraphicsObject * added);
+    void removeMGObject(MapGraphicsObject * removed);
+
+    /*
+      Batches bigger than this are added and removed with the BSP index turned off, so it's built once for the
+      lot instead of being updated for every item
+    */
+    static bool isBigBatch(int count);
 
     QPointer<MapGraphicsScene> _mgScene;
     PrivateQGraphicsInfoSource * _infoSource;
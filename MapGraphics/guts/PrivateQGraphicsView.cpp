@@ -2,17 +2,28 @@
 
 #include <QWheelEvent>
 #include <QContextMenuEvent>
+#include <QPainter>
+#include <QTimer>
 #include <QtDebug>
 
+#include "MapRenderProfiler.h"
+
+//How often the profiler overlay is redrawn, in milliseconds
+const int OVERLAY_REFRESH_INTERVAL = 500;
+const int OVERLAY_MARGIN = 6;
+
+//How many classes the overlay lists, under its line on the frames
+const int OVERLAY_CLASSES = 6;
+
 PrivateQGraphicsView::PrivateQGraphicsView(QWidget *parent) :
-    QGraphicsView(parent)
+    QGraphicsView(parent), _renderProfiler(0), _profileOverlay(false), _overlayTimer(0)
 {
     this->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
     this->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
 }
 
 PrivateQGraphicsView::PrivateQGraphicsView(QGraphicsScene *scene, QWidget *parent) :
-    QGraphicsView(scene,parent)
+    QGraphicsView(scene,parent), _renderProfiler(0), _profileOverlay(false), _overlayTimer(0)
 {
     this->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
     this->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
@@ -22,6 +33,68 @@ PrivateQGraphicsView::~PrivateQGraphicsView()
 {
 }
 
+void PrivateQGraphicsView::setRenderProfiler(MapRenderProfiler *profiler)
+{
+    _renderProfiler = profiler;
+    this->refreshProfileOverlay();
+}
+
+void PrivateQGraphicsView::setProfileOverlay(bool overlay)
+{
+    _profileOverlay = overlay;
+    if (_overlayTimer == 0)
+    {
+        _overlayTimer = new QTimer(this);
+        _overlayTimer->setInterval(OVERLAY_REFRESH_INTERVAL);
+        connect(_overlayTimer,
+                SIGNAL(timeout()),
+                this,
+                SLOT(refreshProfileOverlay()));
+    }
+
+    if (overlay)
+        _overlayTimer->start();
+    else
+        _overlayTimer->stop();
+    this->refreshProfileOverlay();
+}
+
+//protected
+//virtual from QGraphicsView
+void PrivateQGraphicsView::paintEvent(QPaintEvent *event)
+{
+    if (_renderProfiler == 0)
+    {
+        QGraphicsView::paintEvent(event);
+        return;
+    }
+
+    _renderProfiler->beginFrame();
+    QGraphicsView::paintEvent(event);
+    _renderProfiler->endFrame();
+}
+
+//protected
+//virtual from QGraphicsView
+void PrivateQGraphicsView::drawForeground(QPainter *painter, const QRectF &rect)
+{
+    QGraphicsView::drawForeground(painter, rect);
+    if (!_profileOverlay || _renderProfiler == 0)
+        return;
+
+    //Drawn in viewport coordinates, whatever the scene is scrolled or rotated to
+    painter->save();
+    painter->resetTransform();
+    const QString summary = _renderProfiler->summary(OVERLAY_CLASSES);
+    const QRect textRect = painter->fontMetrics().boundingRect(QRect(0, 0, this->viewport()->width(), 0),
+                                                               Qt::AlignLeft | Qt::TextDontClip,
+                                                               summary);
+    painter->fillRect(textRect.adjusted(0, 0, 2 * OVERLAY_MARGIN, 2 * OVERLAY_MARGIN), QColor(0, 0, 0, 170));
+    painter->setPen(Qt::white);
+    painter->drawText(textRect.translated(OVERLAY_MARGIN, OVERLAY_MARGIN), Qt::AlignLeft, summary);
+    painter->restore();
+}
+
 //protected
 ////virtual from QGraphicsView
 void PrivateQGraphicsView::mouseDoubleClickEvent(QMouseEvent *event)
@@ -81,3 +154,11 @@ void PrivateQGraphicsView::wheelEvent(QWheelEvent *event)
     if (!event->isAccepted())
         QGraphicsView::wheelEvent(event);
 }
+
+//private slot
+void PrivateQGraphicsView::refreshProfileOverlay()
+{
+    //Only the overlay changes on its own, so don't repaint (and time) the whole map for it
+    const int height = (OVERLAY_CLASSES + 1) * this->fontMetrics().lineSpacing() + 2 * OVERLAY_MARGIN;
+    this->viewport()->update(QRect(0, 0, this->viewport()->width(), height));
+}
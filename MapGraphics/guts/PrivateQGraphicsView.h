@@ -3,6 +3,9 @@
 
 #include <QGraphicsView>
 
+class MapRenderProfiler;
+class QTimer;
+
 class PrivateQGraphicsView : public QGraphicsView
 {
     Q_OBJECT
@@ -11,7 +14,20 @@ public:
     PrivateQGraphicsView(QGraphicsScene* scene, QWidget * parent=0);
     virtual ~PrivateQGraphicsView();
 
+    /*
+      Where frame times go, or null to not time frames. Not owned. With the overlay on, the profiler's summary is
+      drawn over the top left of the view and refreshed a couple of times a second.
+    */
+    void setRenderProfiler(MapRenderProfiler * profiler);
+    void setProfileOverlay(bool overlay);
+
 protected:
+    //virtual from QGraphicsView
+    virtual void paintEvent(QPaintEvent *event);
+
+    //virtual from QGraphicsView
+    virtual void drawForeground(QPainter *painter, const QRectF &rect);
+
     //virtual from QGraphicsView
     virtual void mouseDoubleClickEvent(QMouseEvent *event);
 
@@ -39,7 +55,14 @@ signals:
     void hadWheelEvent(QWheelEvent *);
     
 public slots:
-    
+
+private slots:
+    void refreshProfileOverlay();
+
+private:
+    MapRenderProfiler * _renderProfiler;
+    bool _profileOverlay;
+    QTimer * _overlayTimer;
 };
 
 #endif // PRIVATEQGRAPHICSVIEW_H
@@ -0,0 +1,83 @@
+#include "WebMercator.h"
+
+#include <cmath>
+
+const qreal PI = 3.14159265358979323846;
+const qreal deg2rad = PI / 180.0;
+const qreal rad2deg = 180.0 / PI;
+
+WebMercator::WebMercator(quint16 tileSize) :
+    _tileSize(tileSize)
+{
+    for (int z = 0; z < PRECOMPUTED_ZOOM_LEVELS; z++)
+        _zoomConstants[z] = WebMercator::computeConstants(tileSize, z);
+}
+
+quint16 WebMercator::tileSize() const
+{
+    return _tileSize;
+}
+
+qreal WebMercator::worldSize(quint8 zoomLevel) const
+{
+    return 2.0 * this->constantsFor(zoomLevel).halfWorld;
+}
+
+QPointF WebMercator::ll2qgs(const QPointF &ll, quint8 zoomLevel) const
+{
+    QPointF toRet;
+    this->ll2qgs(&ll, &toRet, 1, zoomLevel);
+    return toRet;
+}
+
+QPointF WebMercator::qgs2ll(const QPointF &qgs, quint8 zoomLevel) const
+{
+    QPointF toRet;
+    this->qgs2ll(&qgs, &toRet, 1, zoomLevel);
+    return toRet;
+}
+
+void WebMercator::ll2qgs(const QPointF *ll, QPointF *qgs, int count, quint8 zoomLevel) const
+{
+    const ZoomConstants c = this->constantsFor(zoomLevel);
+
+    //x and y in separate passes, so the linear one isn't held up by the trigonometry
+    for (int i = 0; i < count; i++)
+        qgs[i].rx() = (int)(c.halfWorld + ll[i].x() * c.pixelsPerDegree);
+
+    for (int i = 0; i < count; i++)
+        qgs[i].ry() = (int)(c.halfWorld - log(tan(PI / 4.0 + ll[i].y() * (deg2rad / 2.0))) * c.pixelsPerRadian);
+}
+
+void WebMercator::qgs2ll(const QPointF *qgs, QPointF *ll, int count, quint8 zoomLevel) const
+{
+    const ZoomConstants c = this->constantsFor(zoomLevel);
+
+    for (int i = 0; i < count; i++)
+        ll[i].rx() = qgs[i].x() * c.degreesPerPixel - 180.0;
+
+    for (int i = 0; i < count; i++)
+        ll[i].ry() = rad2deg * atan(sinh(PI - qgs[i].y() * c.radiansPerPixel));
+}
+
+//private
+WebMercator::ZoomConstants WebMercator::constantsFor(quint8 zoomLevel) const
+{
+    if (zoomLevel < PRECOMPUTED_ZOOM_LEVELS)
+        return _zoomConstants[zoomLevel];
+    return WebMercator::computeConstants(_tileSize, zoomLevel);
+}
+
+//private static
+WebMercator::ZoomConstants WebMercator::computeConstants(quint16 tileSize, quint8 zoomLevel)
+{
+    const qreal world = ldexp((qreal) tileSize, zoomLevel);
+
+    ZoomConstants toRet;
+    toRet.halfWorld = world / 2.0;
+    toRet.pixelsPerDegree = world / 360.0;
+    toRet.degreesPerPixel = 360.0 / world;
+    toRet.pixelsPerRadian = world / (2.0 * PI);
+    toRet.radiansPerPixel = (2.0 * PI) / world;
+    return toRet;
+}
@@ -0,0 +1,63 @@
+#ifndef WEBMERCATOR_H
+#define WEBMERCATOR_H
+
+#include <QPointF>
+
+#include "MapGraphics_global.h"
+
+/**
+ * @brief The WebMercator class projects between (longitude, latitude) and the scene pixels of a map tiled like
+ * OpenStreetMap's: Web Mercator, square tiles, 2^z tiles on an edge at zoom level z and row 0 at the north.
+ *
+ * The scale constants of each zoom level are worked out once, up front, so projecting a point is a few
+ * multiplications plus the trigonometry for its latitude, and no pow() or divisions. The span versions convert
+ * the x and y coordinates of a whole array in separate tight loops, which compilers can vectorize (the linear x
+ * one always, the y one where the math library has vector versions).
+ *
+ * Scene pixels are truncated to whole pixels, as the tile sources always have.
+ */
+class MAPGRAPHICSSHARED_EXPORT WebMercator
+{
+public:
+    explicit WebMercator(quint16 tileSize = 256);
+
+    quint16 tileSize() const;
+
+    /**
+     * @brief worldSize returns how many pixels wide (and high) the whole world is at zoomLevel
+     */
+    qreal worldSize(quint8 zoomLevel) const;
+
+    QPointF ll2qgs(const QPointF& ll, quint8 zoomLevel) const;
+    QPointF qgs2ll(const QPointF& qgs, quint8 zoomLevel) const;
+
+    /**
+     * @brief ll2qgs projects count points at once. ll and qgs may be the same array.
+     */
+    void ll2qgs(const QPointF * ll, QPointF * qgs, int count, quint8 zoomLevel) const;
+    void qgs2ll(const QPointF * qgs, QPointF * ll, int count, quint8 zoomLevel) const;
+
+private:
+    //Everything about a zoom level that doesn't depend on the point
+    struct ZoomConstants
+    {
+        qreal halfWorld;
+        qreal pixelsPerDegree;
+        qreal degreesPerPixel;
+
+        //Mercator y is in radians, i.e. pixels per unit of log(tan(pi/4 + lat/2))
+        qreal pixelsPerRadian;
+        qreal radiansPerPixel;
+    };
+
+    //Precomputed for the zoom levels that are actually used; anything deeper is worked out when it's asked for
+    static const int PRECOMPUTED_ZOOM_LEVELS = 32;
+
+    ZoomConstants constantsFor(quint8 zoomLevel) const;
+    static ZoomConstants computeConstants(quint16 tileSize, quint8 zoomLevel);
+
+    quint16 _tileSize;
+    ZoomConstants _zoomConstants[PRECOMPUTED_ZOOM_LEVELS];
+};
+
+#endif // WEBMERCATOR_H
@@ -3,15 +3,21 @@
 #include <QtDebug>
 #include <QPainter>
 #include <QMutexLocker>
-#include <QThread>
-#include <QPointer>
 #include <QTimer>
 
+#include "guts/MapTileSourceExecutor.h"
+
+//How many bytes of decoded tiles to keep for each layer. A 256x256 tile is 256 KB
+const int DEFAULT_LAYER_CACHE_BYTES = 16 * 1024 * 1024;
+
 CompositeTileSource::CompositeTileSource() :
-    MapTileSource()
+    MapTileSource(), _progressive(false)
 {
     _globalMutex = new QMutex(QMutex::Recursive);
     this->setCacheMode(MapTileSource::NoCaching);
+
+    //Our children each limit their own fetches, so there's no point holding requests back here too
+    this->setMaxConcurrentRequests(0);
 }
 
 CompositeTileSource::~CompositeTileSource()
@@ -22,23 +28,10 @@ CompositeTileSource::~CompositeTileSource()
     //Clean up all data related to pending tiles
     this->clearPendingTiles();
 
-    //Clear the sources
-    //We first find all the sources' threads and put them in a list
-    QList<QPointer<QThread> > tileSourceThreads;
-    foreach(QSharedPointer<MapTileSource> source, _childSources)
-        tileSourceThreads.append(QPointer<QThread>(source->thread()));
-
-    //Then we clear the sources
+    //Clear the sources. MapTileSourceExecutor shuts down any of their threads that nothing else is using
     _childSources.clear();
-
-    int numThreads = tileSourceThreads.size();
-    //Then we wait for all of those threads to shut down
-    for (int i = 0; i < numThreads; i++)
-    {
-        QPointer<QThread> thread = tileSourceThreads[i];
-        if (!thread.isNull() && thread != this->thread())
-            thread->wait(10000);
-    }
+    qDeleteAll(_layerCaches);
+    _layerCaches.clear();
 
     delete this->_globalMutex;
 }
@@ -69,6 +62,35 @@ QPointF CompositeTileSource::qgs2ll(const QPointF &qgs, quint8 zoomLevel) const
     return _childSources.at(0)->qgs2ll(qgs,zoomLevel);
 }
 
+void CompositeTileSource::ll2qgsBatch(const QPointF *ll, QPointF *qgs, int count, quint8 zoomLevel) const
+{
+    QMutexLocker lock(_globalMutex);
+    if (_childSources.isEmpty())
+    {
+        qWarning() << "Composite tile source is empty --- results undefined";
+        for (int i = 0; i < count; i++)
+            qgs[i] = QPointF(0,0);
+        return;
+    }
+
+    //One lock and one virtual call for the whole span
+    _childSources.at(0)->ll2qgsBatch(ll,qgs,count,zoomLevel);
+}
+
+void CompositeTileSource::qgs2llBatch(const QPointF *qgs, QPointF *ll, int count, quint8 zoomLevel) const
+{
+    QMutexLocker lock(_globalMutex);
+    if (_childSources.isEmpty())
+    {
+        qWarning() << "Composite tile source is empty --- results undefined";
+        for (int i = 0; i < count; i++)
+            ll[i] = QPointF(0,0);
+        return;
+    }
+
+    _childSources.at(0)->qgs2llBatch(qgs,ll,count,zoomLevel);
+}
+
 quint64 CompositeTileSource::tilesOnZoomLevel(quint8 zoomLevel) const
 {
     QMutexLocker lock(_globalMutex);
@@ -139,11 +161,10 @@ void CompositeTileSource::addSourceTop(QSharedPointer<MapTileSource> source, qre
     _childSources.insert(0, source);
     _childOpacities.insert(0,opacity);
     _childEnabledFlags.insert(0,true);
+    this->createLayerCache(source.data());
 
-    connect(source.data(),
-            SIGNAL(tileRetrieved(quint32,quint32,quint8)),
-            this,
-            SLOT(handleTileRetrieved(quint32,quint32,quint8)));
+    this->connectChild(source);
+    this->distributeMemoryCacheBudget();
 
     this->sourceAdded(0);
     this->sourcesChanged();
@@ -162,11 +183,10 @@ void CompositeTileSource::addSourceBottom(QSharedPointer<MapTileSource> source,
     _childSources.append(source);
     _childOpacities.append(opacity);
     _childEnabledFlags.append(true);
+    this->createLayerCache(source.data());
 
-    connect(source.data(),
-            SIGNAL(tileRetrieved(quint32,quint32,quint8)),
-            this,
-            SLOT(handleTileRetrieved(quint32,quint32,quint8)));
+    this->connectChild(source);
+    this->distributeMemoryCacheBudget();
 
     this->sourceAdded(_childSources.size()-1);
     this->sourcesChanged();
@@ -199,10 +219,12 @@ void CompositeTileSource::removeSource(int index)
     if (index < 0 || index >= _childSources.size())
         return;
 
+    delete _layerCaches.take(_childSources.at(index).data());
     _childSources.removeAt(index);
     _childOpacities.removeAt(index);
     _childEnabledFlags.removeAt(index);
     this->clearPendingTiles();
+    this->distributeMemoryCacheBudget();
 
     this->sourceRemoved(index);
     this->sourcesChanged();
@@ -273,6 +295,60 @@ void CompositeTileSource::setEnabledFlag(int index, bool isEnabled)
     this->allTilesInvalidated();
 }
 
+bool CompositeTileSource::progressive() const
+{
+    QMutexLocker lock(_globalMutex);
+    return _progressive;
+}
+
+void CompositeTileSource::setProgressive(bool progressive)
+{
+    QMutexLocker lock(_globalMutex);
+    _progressive = progressive;
+}
+
+//virtual from MapTileSource
+void CompositeTileSource::setMemoryCacheBudget(int bytes)
+{
+    MapTileSource::setMemoryCacheBudget(bytes);
+
+    QMutexLocker lock(_globalMutex);
+    this->distributeMemoryCacheBudget();
+}
+
+//virtual from MapTileSource
+MapTileSource::CacheStatistics CompositeTileSource::cacheStatistics() const
+{
+    MapTileSource::CacheStatistics toRet = MapTileSource::cacheStatistics();
+
+    QMutexLocker lock(_globalMutex);
+    foreach(const QSharedPointer<MapTileSource>& child, _childSources)
+        toRet += child->cacheStatistics();
+
+    //The children's budgets are shares of ours, so don't count them twice
+    toRet.memoryBudget = this->memoryCacheBudget();
+    return toRet;
+}
+
+//virtual from MapTileSource
+void CompositeTileSource::resetCacheStatistics()
+{
+    MapTileSource::resetCacheStatistics();
+
+    QMutexLocker lock(_globalMutex);
+    foreach(const QSharedPointer<MapTileSource>& child, _childSources)
+        child->resetCacheStatistics();
+}
+
+//virtual from MapTileSource
+void CompositeTileSource::warmMemoryCache(const QList<MapTileKey> &keys)
+{
+    //We don't cache composites ourselves, so it's the layers that get warmed
+    QMutexLocker lock(_globalMutex);
+    foreach(const QSharedPointer<MapTileSource>& child, _childSources)
+        child->warmMemoryCache(keys);
+}
+
 //protected
 void CompositeTileSource::fetchTile(quint32 x, quint32 y, quint8 z)
 {
@@ -294,26 +370,79 @@ void CompositeTileSource::fetchTile(quint32 x, quint32 y, quint8 z)
         return;
     }
 
-    //Allocate space in memory to store the tiles as they come before we composite them.
-    //If we already have a space allocated from a previous un-finished request, clear it and start over
-    QString cacheID = MapTileSource::createCacheID(x,y,z);
-    if (_pendingTiles.contains(cacheID))
-    {
-        QMap<quint32, QImage *> * tiles = _pendingTiles.value(cacheID);
-        foreach(QImage * tile, *tiles)
-            delete tile;
-        tiles->clear();
-    }
-    //Otherwise, create a new space
-    else
-        _pendingTiles.insert(cacheID,new QMap<quint32,QImage *>());
+    /*
+      Start (or start over) collecting the layers of the tile. Layers we've got cached go in straight away,
+      so only the visible layers we don't have are requested from the children.
+    */
+    const MapTileKey key(x,y,z);
+    PendingTile pending;
+    pending.waiting = 0;
 
-    //Request tiles from all of our beautiful children
+    const MapTileSource::RequestPriority priority = this->fetchPriority(x,y,z);
+    QList<QPair<QWeakPointer<MapTileSource>, quint64> > childRequests;
     for (int i = 0; i < _childSources.size(); i++)
     {
+        if (this->layerOpacity(i) <= 0.0)
+            continue;
+
         QSharedPointer<MapTileSource> child = _childSources.at(i);
-        child->requestTile(x,y,z);
+        const QCache<MapTileKey, QImage> * cache = _layerCaches.value(child.data());
+        const QImage * cached = (cache == 0) ? 0 : cache->object(key);
+        if (cached != 0)
+        {
+            pending.layers.insert(child.data(), *cached);
+            continue;
+        }
+
+        const quint64 token = child->requestTile(x,y,z,priority);
+        childRequests.append(qMakePair(child.toWeakRef(), token));
+        pending.waiting++;
+    }
+
+    /*
+      If we're starting over on a tile, withdraw the old child requests only now that the new ones are in.
+      That way a child that's already fetching the tile keeps going instead of aborting and starting again.
+    */
+    typedef QPair<QWeakPointer<MapTileSource>, quint64> ChildRequest;
+    foreach(const ChildRequest& childRequest, _childRequests.value(key))
+    {
+        QSharedPointer<MapTileSource> child = childRequest.first.toStrongRef();
+        if (!child.isNull())
+            child->cancelTileRequest(childRequest.second);
     }
+
+    //Everything was cached (e.g. only a layer's opacity changed), so we can composite right now
+    if (pending.waiting == 0)
+    {
+        _childRequests.remove(key);
+        _pendingTiles.remove(key);
+        const QList<QPair<QImage, qreal> > layers = this->collectLayers(pending);
+        lock.unlock();
+
+        this->prepareNewlyReceivedTile(x,y,z,this->compositeLayers(layers));
+        return;
+    }
+
+    _childRequests.insert(key, childRequests);
+    _pendingTiles.insert(key, pending);
+
+    //Show the layers we had cached while we wait for the rest
+    if (!_progressive || pending.layers.isEmpty())
+        return;
+    const QList<QPair<QImage, qreal> > layers = this->collectLayers(pending);
+    lock.unlock();
+
+    QImage * partial = this->compositeLayers(layers);
+    this->preparePartialTile(x,y,z,*partial);
+    delete partial;
+}
+
+//protected
+//virtual from MapTileSource
+void CompositeTileSource::cancelFetch(quint32 x, quint32 y, quint8 z)
+{
+    QMutexLocker lock(_globalMutex);
+    this->dropPendingTile(MapTileKey(x,y,z));
 }
 
 //private slot
@@ -331,29 +460,28 @@ void CompositeTileSource::handleTileRetrieved(quint32 x, quint32 y, quint8 z)
     }
 
     //Make sure this is a notification from a MapTileSource that we care about
-    int tileSourceIndex = -1;
-    for (int i = 0; i < _childSources.size(); i++)
-    {
-        if (_childSources[i].data() != tileSource)
-            continue;
-        tileSourceIndex = i;
-        break;
-    }
-
-    if (tileSourceIndex == -1)
+    if (!_layerCaches.contains(tileSource))
     {
         qWarning() << this << "received tile from unknown source...";
         return;
     }
 
-
-    //Make sure that this is a tile we're interested in
-    const QString cacheID = MapTileSource::createCacheID(x,y,z);
-    if (!_pendingTiles.contains(cacheID))
+    /*
+      Only pick up tiles that answer one of our current requests, and only once. The child may be shared with
+      other clients (e.g. the composite of another view), which it also tells about their tiles, and each request
+      gets to pick the tile up once: taking one we didn't ask for, have since withdrawn or already have would
+      leave another client without.
+    */
+    const MapTileKey key(x,y,z);
+    bool requested = false;
+    typedef QPair<QWeakPointer<MapTileSource>, quint64> ChildRequest;
+    foreach(const ChildRequest& childRequest, _childRequests.value(key))
     {
-        qWarning() << this << "received unknown tile" << x << y << z << "from" << tileSource;
-        return;
+        if (childRequest.first.toStrongRef().data() == tileSource)
+            requested = true;
     }
+    if (!requested || !_pendingTiles.contains(key) || _pendingTiles.value(key).layers.contains(tileSource))
+        return;
 
     //Make sure the tile is non-null
     QImage * tile = tileSource->getFinishedTile(x,y,z);
@@ -366,64 +494,184 @@ void CompositeTileSource::handleTileRetrieved(quint32 x, quint32 y, quint8 z)
     //qDebug() << this << "Retrieved tile" << x << y << z << "from" << tileSource;
 
     /*
-      Put the tile into our pendingTiles structure. If it was the last tile we wanted, build
-      our finishied product and notify our client. If we've already received this tile because
-      it was requested twice for some reason (e.g. crazy zooming in/out) then let's just go ahead
-      and delete the new version and go about our day.
+      Keep the layer so that opacity, ordering and enabled changes can be composited without fetching
+      it again.
     */
-    QMap<quint32, QImage *> * tiles = _pendingTiles.value(cacheID);
-    if (tiles->contains(tileSourceIndex))
+    _layerCaches.value(tileSource)->insert(key, new QImage(*tile), tile->byteCount());
+
+    PendingTile& pending = _pendingTiles[key];
+    pending.layers.insert(tileSource, *tile);
+    pending.waiting--;
+    delete tile;
+
+    //Still waiting for a tile or two? Then maybe show what we've got so far
+    if (pending.waiting > 0)
     {
-        delete tile;
+        if (!_progressive)
+            return;
+        const QList<QPair<QImage, qreal> > layers = this->collectLayers(pending);
+        lock.unlock();
+
+        QImage * partial = this->compositeLayers(layers);
+        this->preparePartialTile(x,y,z,*partial);
+        delete partial;
         return;
     }
-    tiles->insert(tileSourceIndex,tile);
 
-    //Still waiting for a tile or two?
-    if (tiles->size() < _childSources.size())
+    //Time to build the finished composite tile. The painting doesn't need the lock
+    const QList<QPair<QImage, qreal> > layers = this->collectLayers(pending);
+    _pendingTiles.remove(key);
+    _childRequests.remove(key);
+    lock.unlock();
+
+    this->prepareNewlyReceivedTile(x,y,z,this->compositeLayers(layers));
+}
+
+//private slot
+void CompositeTileSource::handleTileRequestFailed(quint32 x, quint32 y, quint8 z)
+{
+    QMutexLocker lock(_globalMutex);
+
+    //If one layer can't be had, neither can the composite tile
+    const MapTileKey key(x,y,z);
+    if (!_pendingTiles.contains(key))
         return;
+    this->dropPendingTile(key);
+    this->prepareFailedTile(x,y,z);
+}
 
-    //Time to build the finished composite tile
-    QImage * toRet = new QImage(this->tileSize(),
-                                this->tileSize(),
-                                QImage::Format_ARGB32_Premultiplied);
-    QPainter painter(toRet);
-    painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-    painter.setOpacity(1.0);
-    for (int i = tiles->size()-1; i >= 0; i--)
+//private slot
+void CompositeTileSource::handleChildTilesInvalidated(const QRectF &geoRect)
+{
+    MapTileSource * tileSource = qobject_cast<MapTileSource *>(this->sender());
+    if (tileSource == 0)
+        return;
+
+    //Forget our copies of the child's tiles there, so the next requests fetch the new ones
     {
-        QImage * childTile = tiles->value(i);
-        qreal opacity = _childOpacities[i];
-
-        //If there are no other layers, we need to be opaque no matter what
-        if (this->numSources() == 1)
-            opacity = 1.0;
-
-        if (_childEnabledFlags[i] == false)
-            opacity = 0.0;
-        painter.setOpacity(opacity);
-        painter.drawImage(0,0,*childTile);
-        delete childTile;
+        QMutexLocker lock(_globalMutex);
+        QCache<MapTileKey, QImage> * cache = _layerCaches.value(tileSource);
+        if (cache == 0)
+            return;
+        foreach(const MapTileKey& key, cache->keys())
+        {
+            if (this->tileGeoRect(key.x(), key.y(), key.z()).intersects(geoRect))
+                cache->remove(key);
+        }
     }
-    delete tiles;
-    _pendingTiles.remove(cacheID);
-    painter.end();
 
-    this->prepareNewlyReceivedTile(x,y,z,toRet);
+    this->tilesInvalidated(geoRect);
 }
 
 //private slot
 void CompositeTileSource::clearPendingTiles()
 {
-    QList<QMap<quint32, QImage *> * > pendingTiles = _pendingTiles.values();
-    for (int i = 0; i < pendingTiles.size(); i++)
+    foreach(const MapTileKey& key, _childRequests.keys())
+        this->dropPendingTile(key);
+    foreach(const MapTileKey& key, _pendingTiles.keys())
+        this->dropPendingTile(key);
+}
+
+//private
+void CompositeTileSource::connectChild(QSharedPointer<MapTileSource> source)
+{
+    connect(source.data(),
+            SIGNAL(tileRetrieved(quint32,quint32,quint8)),
+            this,
+            SLOT(handleTileRetrieved(quint32,quint32,quint8)));
+    connect(source.data(),
+            SIGNAL(tileRequestFailed(quint32,quint32,quint8)),
+            this,
+            SLOT(handleTileRequestFailed(quint32,quint32,quint8)));
+    connect(source.data(),
+            SIGNAL(tilesInvalidated(QRectF)),
+            this,
+            SLOT(handleChildTilesInvalidated(QRectF)));
+}
+
+//private
+void CompositeTileSource::distributeMemoryCacheBudget()
+{
+    if (_childSources.isEmpty())
+        return;
+
+    const int share = this->memoryCacheBudget() / _childSources.size();
+    foreach(const QSharedPointer<MapTileSource>& child, _childSources)
+        child->setMemoryCacheBudget(share);
+}
+
+//private
+void CompositeTileSource::dropPendingTile(const MapTileKey &key)
+{
+    typedef QPair<QWeakPointer<MapTileSource>, quint64> ChildRequest;
+    foreach(const ChildRequest& childRequest, _childRequests.take(key))
+    {
+        QSharedPointer<MapTileSource> child = childRequest.first.toStrongRef();
+        if (!child.isNull())
+            child->cancelTileRequest(childRequest.second);
+    }
+
+    _pendingTiles.remove(key);
+}
+
+//private
+void CompositeTileSource::createLayerCache(MapTileSource *source)
+{
+    if (_layerCaches.contains(source))
+        return;
+
+    QCache<MapTileKey, QImage> * cache = new QCache<MapTileKey, QImage>();
+    cache->setMaxCost(DEFAULT_LAYER_CACHE_BYTES);
+    _layerCaches.insert(source, cache);
+}
+
+//private
+qreal CompositeTileSource::layerOpacity(int index) const
+{
+    if (!_childEnabledFlags[index])
+        return 0.0;
+
+    //If there are no other layers, we need to be opaque no matter what
+    if (_childSources.size() == 1)
+        return 1.0;
+    return _childOpacities[index];
+}
+
+//private
+QList<QPair<QImage, qreal> > CompositeTileSource::collectLayers(const PendingTile &pending) const
+{
+    //Bottom layer first
+    QList<QPair<QImage, qreal> > toRet;
+    for (int i = _childSources.size() - 1; i >= 0; i--)
+    {
+        const qreal opacity = this->layerOpacity(i);
+        MapTileSource * child = _childSources.at(i).data();
+        if (opacity <= 0.0 || !pending.layers.contains(child))
+            continue;
+        toRet.append(qMakePair(pending.layers.value(child), opacity));
+    }
+    return toRet;
+}
+
+//private
+QImage *CompositeTileSource::compositeLayers(const QList<QPair<QImage, qreal> > &layers) const
+{
+    const quint16 size = this->tileSize();
+    QImage * toRet = new QImage(size,
+                                size,
+                                QImage::Format_ARGB32_Premultiplied);
+    toRet->fill(Qt::transparent);
+
+    QPainter painter(toRet);
+    painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+    typedef QPair<QImage, qreal> Layer;
+    foreach(const Layer& layer, layers)
     {
-        QMap<quint32, QImage *> * tiles = pendingTiles.at(i);
-        foreach(QImage * tile, tiles->values())
-            delete tile;
-        delete tiles;
+        painter.setOpacity(layer.second);
+        painter.drawImage(0,0,layer.first);
     }
-    _pendingTiles.clear();
+    painter.end();
+    return toRet;
 }
 
 //private
@@ -432,18 +680,6 @@ void CompositeTileSource::doChildThreading(QSharedPointer<MapTileSource> source)
     if (source.isNull())
         return;
 
-    //We create a new thread for each child source in our care.
-    QThread * sourceThread = new QThread();
-    sourceThread->start();
-    source->moveToThread(sourceThread);
-
-    //Set the thread up so that it will shutdown and be destroyed when the tilesource is dead
-    connect(source.data(),
-            SIGNAL(destroyed()),
-            sourceThread,
-            SLOT(quit()));
-    connect(sourceThread,
-            SIGNAL(finished()),
-            sourceThread,
-            SLOT(deleteLater()));
+    //Each child runs in one of the shared tile source threads, possibly alongside us
+    MapTileSourceExecutor::getInstance()->adopt(source.data());
 }
@@ -6,9 +6,12 @@
 
 #include <QList>
 #include <QHash>
-#include <QMap>
+#include <QCache>
+#include <QImage>
 #include <QSharedPointer>
 #include <QMutex>
+#include <QPair>
+#include <QWeakPointer>
 
 class MAPGRAPHICSSHARED_EXPORT CompositeTileSource : public MapTileSource
 {
@@ -23,6 +26,12 @@ public:
     //pure-virtual from MapTileSource
     virtual QPointF qgs2ll(const QPointF& qgs, quint8 zoomLevel) const;
 
+    //virtual from MapTileSource
+    virtual void ll2qgsBatch(const QPointF * ll, QPointF * qgs, int count, quint8 zoomLevel) const;
+
+    //virtual from MapTileSource
+    virtual void qgs2llBatch(const QPointF * qgs, QPointF * ll, int count, quint8 zoomLevel) const;
+
     //pure-virtual from MapTileSource
     virtual quint64 tilesOnZoomLevel(quint8 zoomLevel) const;
 
@@ -53,12 +62,37 @@ public:
     bool getEnabledFlag(int index) const;
     void setEnabledFlag(int index, bool isEnabled);
 
+    /**
+     * @brief progressive is whether to publish a partial composite each time a layer of a tile arrives, so
+     * that the fast layers of a tile show up without waiting for the slowest one. Only clients that request
+     * tiles with a receiver (like MapGraphicsView's tiles) see the partial composites. Off by default.
+     */
+    bool progressive() const;
+    void setProgressive(bool progressive);
+
+    //virtual from MapTileSource
+    virtual void setMemoryCacheBudget(int bytes);
+
+    //virtual from MapTileSource
+    virtual MapTileSource::CacheStatistics cacheStatistics() const;
+
+    //virtual from MapTileSource
+    virtual void resetCacheStatistics();
+
+    //virtual from MapTileSource
+    virtual void warmMemoryCache(const QList<MapTileKey>& keys);
+
 
 
 protected:
     virtual void fetchTile(quint32 x,
                            quint32 y,
                            quint8 z);
+
+    //virtual from MapTileSource
+    virtual void cancelFetch(quint32 x,
+                             quint32 y,
+                             quint8 z);
     
 signals:
     /*!
@@ -77,17 +111,53 @@ public slots:
 
 private slots:
     void handleTileRetrieved(quint32 x, quint32 y, quint8 z);
+    void handleTileRequestFailed(quint32 x, quint32 y, quint8 z);
+    void handleChildTilesInvalidated(const QRectF& geoRect);
     void clearPendingTiles();
 
 private:
+    //The layers collected so far for a composite tile, and how many we're still waiting on
+    struct PendingTile
+    {
+        QHash<MapTileSource *, QImage> layers;
+        int waiting;
+    };
+
     void doChildThreading(QSharedPointer<MapTileSource>);
+    void connectChild(QSharedPointer<MapTileSource>);
+
+    //Splits our memory cache budget evenly between the children, which do the caching
+    void distributeMemoryCacheBudget();
+
+    //Cancels whatever child requests are still out for a composite tile and forgets about the tile
+    void dropPendingTile(const MapTileKey& key);
+
+    void createLayerCache(MapTileSource * source);
+
+    //The opacity a layer is drawn with, zero if it's disabled. Call with _globalMutex held
+    qreal layerOpacity(int index) const;
+
+    //The visible layers of a pending tile and their opacities, bottom first. Call with _globalMutex held
+    QList<QPair<QImage, qreal> > collectLayers(const PendingTile& pending) const;
+
+    //Draws the layers over each other. Doesn't need _globalMutex
+    QImage * compositeLayers(const QList<QPair<QImage, qreal> >& layers) const;
+
     QMutex * _globalMutex;
     QList<QSharedPointer<MapTileSource> > _childSources;
     QList<qreal> _childOpacities;
     QList<bool> _childEnabledFlags;
+    bool _progressive;
+
+    //Composite tiles we're collecting layers for
+    QHash<MapTileKey, PendingTile> _pendingTiles;
+
+    //Recently received tiles of each child, so that changing a layer's opacity, order or enabled flag doesn't
+    //mean fetching every layer again. Cost is in bytes
+    QHash<MapTileSource *, QCache<MapTileKey, QImage> *> _layerCaches;
 
-    //A hash of QString:QMap pointer to quint32:QImage pointer
-    QHash<QString, QMap<quint32, QImage *> * > _pendingTiles;
+    //The requests we made of our children for each pending tile, so they can be cancelled
+    QHash<MapTileKey, QList<QPair<QWeakPointer<MapTileSource>, quint64> > > _childRequests;
     
 };
 
@@ -5,10 +5,6 @@
 #include <QStringBuilder>
 #include <QtDebug>
 
-const qreal PI = 3.14159265358979323846;
-const qreal deg2rad = PI / 180.0;
-const qreal rad2deg = 180.0 / PI;
-
 GridTileSource::GridTileSource() :
     MapTileSource()
 {
@@ -22,22 +18,22 @@ GridTileSource::~GridTileSource()
 
 QPointF GridTileSource::ll2qgs(const QPointF &ll, quint8 zoomLevel) const
 {
-    const qreal tilesOnOneEdge = pow(2.0,zoomLevel);
-    const quint16 tileSize = this->tileSize();
-    qreal x = (ll.x()+180.0) * (tilesOnOneEdge*tileSize)/360.0; // coord to pixel!
-    qreal y = (1-(log(tan(PI/4.0+(ll.y()*deg2rad)/2)) /PI)) /2.0  * (tilesOnOneEdge*tileSize);
-
-    return QPoint(int(x), int(y));
+    return _mercator.ll2qgs(ll, zoomLevel);
 }
 
 QPointF GridTileSource::qgs2ll(const QPointF &qgs, quint8 zoomLevel) const
 {
-    const qreal tilesOnOneEdge = pow(2.0,zoomLevel);
-    const quint16 tileSize = this->tileSize();
-    qreal longitude = (qgs.x()*(360.0/(tilesOnOneEdge*tileSize)))-180.0;
-    qreal latitude = rad2deg*(atan(sinh((1.0-qgs.y()*(2.0/(tilesOnOneEdge*tileSize)))*PI)));
+    return _mercator.qgs2ll(qgs, zoomLevel);
+}
 
-    return QPointF(longitude, latitude);
+void GridTileSource::ll2qgsBatch(const QPointF *ll, QPointF *qgs, int count, quint8 zoomLevel) const
+{
+    _mercator.ll2qgs(ll, qgs, count, zoomLevel);
+}
+
+void GridTileSource::qgs2llBatch(const QPointF *qgs, QPointF *ll, int count, quint8 zoomLevel) const
+{
+    _mercator.qgs2ll(qgs, ll, count, zoomLevel);
 }
 
 quint64 GridTileSource::tilesOnZoomLevel(quint8 zoomLevel) const
@@ -47,7 +43,7 @@ quint64 GridTileSource::tilesOnZoomLevel(quint8 zoomLevel) const
 
 quint16 GridTileSource::tileSize() const
 {
-    return 256;
+    return _mercator.tileSize();
 }
 
 quint8 GridTileSource::minZoomLevel(QPointF ll)
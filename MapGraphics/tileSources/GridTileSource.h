@@ -4,6 +4,7 @@
 #include "MapTileSource.h"
 
 #include "MapGraphics_global.h"
+#include "guts/WebMercator.h"
 
 class MAPGRAPHICSSHARED_EXPORT GridTileSource : public MapTileSource
 {
@@ -16,6 +17,10 @@ public:
 
     virtual QPointF qgs2ll(const QPointF& qgs, quint8 zoomLevel) const;
 
+    virtual void ll2qgsBatch(const QPointF * ll, QPointF * qgs, int count, quint8 zoomLevel) const;
+
+    virtual void qgs2llBatch(const QPointF * qgs, QPointF * ll, int count, quint8 zoomLevel) const;
+
     virtual quint64 tilesOnZoomLevel(quint8 zoomLevel) const;
 
     virtual quint16 tileSize() const;
@@ -32,6 +37,9 @@ protected:
     virtual void fetchTile(quint32 x,
                            quint32 y,
                            quint8 z);
+
+private:
+    const WebMercator _mercator;
     
 signals:
     
@@ -7,15 +7,29 @@
 #include <QStringBuilder>
 #include <QtDebug>
 #include <QNetworkReply>
+#include <QMutexLocker>
+#include <QLocale>
 
-const qreal PI = 3.14159265358979323846;
-const qreal deg2rad = PI / 180.0;
-const qreal rad2deg = 180.0 / PI;
+//ETags are only remembered for this session, so this only has to cover the tiles that expire during it
+const int MAX_REMEMBERED_ETAGS = 4096;
+
+//non-member
+static QByteArray toHttpDate(const QDateTime& time)
+{
+    //A C locale so that day and month names aren't translated
+    return QLocale::c().toString(time.toUTC(), "ddd, dd MMM yyyy hh:mm:ss 'GMT'").toLatin1();
+}
 
 OSMTileSource::OSMTileSource(OSMTileType tileType) :
     MapTileSource(), _tileType(tileType)
 {
     this->setCacheMode(MapTileSource::DiskAndMemCaching);
+    _etags.setMaxCost(MAX_REMEMBERED_ETAGS);
+
+    if (_tileType == OSMTiles)
+        _hosts << "https://a.tile.openstreetmap.org"
+               << "https://b.tile.openstreetmap.org"
+               << "https://c.tile.openstreetmap.org";
 }
 
 OSMTileSource::~OSMTileSource()
@@ -25,22 +39,22 @@ OSMTileSource::~OSMTileSource()
 
 QPointF OSMTileSource::ll2qgs(const QPointF &ll, quint8 zoomLevel) const
 {
-    const qreal tilesOnOneEdge = pow(2.0,zoomLevel);
-    const quint16 tileSize = this->tileSize();
-    qreal x = (ll.x()+180) * (tilesOnOneEdge*tileSize)/360; // coord to pixel!
-    qreal y = (1-(log(tan(PI/4+(ll.y()*deg2rad)/2)) /PI)) /2  * (tilesOnOneEdge*tileSize);
-
-    return QPoint(int(x), int(y));
+    return _mercator.ll2qgs(ll, zoomLevel);
 }
 
 QPointF OSMTileSource::qgs2ll(const QPointF &qgs, quint8 zoomLevel) const
 {
-    const qreal tilesOnOneEdge = pow(2.0,zoomLevel);
-    const quint16 tileSize = this->tileSize();
-    qreal longitude = (qgs.x()*(360/(tilesOnOneEdge*tileSize)))-180;
-    qreal latitude = rad2deg*(atan(sinh((1-qgs.y()*(2/(tilesOnOneEdge*tileSize)))*PI)));
+    return _mercator.qgs2ll(qgs, zoomLevel);
+}
 
-    return QPointF(longitude, latitude);
+void OSMTileSource::ll2qgsBatch(const QPointF *ll, QPointF *qgs, int count, quint8 zoomLevel) const
+{
+    _mercator.ll2qgs(ll, qgs, count, zoomLevel);
+}
+
+void OSMTileSource::qgs2llBatch(const QPointF *qgs, QPointF *ll, int count, quint8 zoomLevel) const
+{
+    _mercator.qgs2ll(qgs, ll, count, zoomLevel);
 }
 
 quint64 OSMTileSource::tilesOnZoomLevel(quint8 zoomLevel) const
@@ -50,7 +64,7 @@ quint64 OSMTileSource::tilesOnZoomLevel(quint8 zoomLevel) const
 
 quint16 OSMTileSource::tileSize() const
 {
-    return 256;
+    return _mercator.tileSize();
 }
 
 quint8 OSMTileSource::minZoomLevel(QPointF ll)
@@ -87,26 +101,47 @@ QString OSMTileSource::tileFileExtension() const
         return "jpg";
 }
 
+QStringList OSMTileSource::hosts() const
+{
+    QMutexLocker lock(&_hostsLock);
+    return _hosts;
+}
+
+void OSMTileSource::setHosts(const QStringList &hosts)
+{
+    QMutexLocker lock(&_hostsLock);
+    _hosts = hosts;
+}
+
 //protected
 void OSMTileSource::fetchTile(quint32 x, quint32 y, quint8 z)
 {
     MapGraphicsNetwork * network = MapGraphicsNetwork::getInstance();
 
-    QString host;
     QString url;
 
     //Figure out which server to request from based on our desired tile type
     if (_tileType == OSMTiles)
-    {
-        host = "https://b.tile.openstreetmap.org";
         url = "/%1/%2/%3.png";
+
+    QMutexLocker lock(&_hostsLock);
+    if (_hosts.isEmpty() || url.isEmpty())
+    {
+        lock.unlock();
+        qWarning() << this->name() << "has nowhere to fetch tiles from";
+        this->prepareFailedTile(x,y,z);
+        return;
     }
 
-    //Use the unique cacheID to see if this tile has already been requested
-    const QString cacheID = this->createCacheID(x,y,z);
-    if (_pendingRequests.contains(cacheID))
+    //Rotate through the hosts by tile, so that a tile's URL (and anyone's HTTP cache of it) doesn't change
+    const QString host = _hosts.at((x + y) % _hosts.size());
+    lock.unlock();
+
+    //Use the tile's key to see if this tile has already been requested
+    const MapTileKey key(x,y,z);
+    if (_pendingRequests.contains(key))
         return;
-    _pendingRequests.insert(cacheID);
+    _pendingRequests.insert(key);
 
     //Build the request
     const QString fetchURL = url.arg(QString::number(z),
@@ -114,9 +149,19 @@ void OSMTileSource::fetchTile(quint32 x, quint32 y, quint8 z)
                                      QString::number(y));
     QNetworkRequest request(QUrl(host + fetchURL));
 
+    //If our cached copy has just expired, ask whether it's still good rather than downloading it again
+    QDateTime fetchedTime;
+    if (!this->staleTile(x,y,z, &fetchedTime).isNull())
+    {
+        if (_etags.contains(key))
+            request.setRawHeader("If-None-Match", *_etags.object(key));
+        if (fetchedTime.isValid())
+            request.setRawHeader("If-Modified-Since", toHttpDate(fetchedTime));
+    }
+
     //Send the request and setupd a signal to ensure we're notified when it finishes
     QNetworkReply * reply = network->get(request);
-    _pendingReplies.insert(reply,cacheID);
+    _pendingReplies.insert(reply,key);
 
     connect(reply,
             SIGNAL(finished()),
@@ -124,6 +169,20 @@ void OSMTileSource::fetchTile(quint32 x, quint32 y, quint8 z)
             SLOT(handleNetworkRequestFinished()));
 }
 
+//protected
+//virtual from MapTileSource
+void OSMTileSource::cancelFetch(quint32 x, quint32 y, quint8 z)
+{
+    const MapTileKey key(x,y,z);
+    if (!_pendingRequests.contains(key))
+        return;
+
+    //Aborting makes the reply finish with an error, which handleNetworkRequestFinished() cleans up
+    QNetworkReply * reply = _pendingReplies.key(key, 0);
+    if (reply != 0)
+        reply->abort();
+}
+
 //private slot
 void OSMTileSource::handleNetworkRequestFinished()
 {
@@ -148,32 +207,19 @@ void OSMTileSource::handleNetworkRequestFinished()
         return;
     }
 
-    //get the cacheID
-    const QString cacheID = _pendingReplies.take(reply);
-    _pendingRequests.remove(cacheID);
+    //get the tile this reply was for
+    const MapTileKey key = _pendingReplies.take(reply);
+    _pendingRequests.remove(key);
+    const quint32 x = key.x();
+    const quint32 y = key.y();
+    const quint8 z = key.z();
 
-    //If there was a network error, ignore the reply
+    //If there was a network error, ignore the reply. Cancelled requests end up here too
     if (reply->error() != QNetworkReply::NoError)
     {
-        qDebug() << "Network Error:" << reply->errorString();
-        return;
-    }
-
-    //Convert the cacheID back into x,y,z tile coordinates
-    quint32 x,y,z;
-    if (!MapTileSource::cacheID2xyz(cacheID,&x,&y,&z))
-    {
-        qWarning() << "Failed to convert cacheID" << cacheID << "back to xyz";
-        return;
-    }
-
-    QByteArray bytes = reply->readAll();
-    QImage * image = new QImage();
-
-    if (!image->loadFromData(bytes))
-    {
-        delete image;
-        qWarning() << "Failed to make QImage from network bytes";
+        if (reply->error() != QNetworkReply::OperationCanceledError)
+            qDebug() << "Network Error:" << reply->errorString();
+        this->prepareFailedTile(x,y,z);
         return;
     }
 
@@ -194,6 +240,16 @@ void OSMTileSource::handleNetworkRequestFinished()
         }
     }
 
-    //Notify client of tile retrieval
-    this->prepareNewlyReceivedTile(x,y,z, image, expireTime);
+    //Not modified: the copy we already have is good until the new expiration
+    QByteArray bytes;
+    if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 304)
+        bytes = this->staleTile(x,y,z);
+    else
+        bytes = reply->readAll();
+
+    if (reply->hasRawHeader("ETag"))
+        _etags.insert(key, new QByteArray(reply->rawHeader("ETag")));
+
+    //Cache the bytes as they came and notify client of tile retrieval. Bad bytes fail the tile
+    this->prepareNewlyReceivedTile(x,y,z, bytes, expireTime);
 }
@@ -3,8 +3,12 @@
 
 #include "MapTileSource.h"
 #include "MapGraphics_global.h"
+#include "guts/WebMercator.h"
 #include <QSet>
 #include <QHash>
+#include <QCache>
+#include <QMutex>
+#include <QStringList>
 
 //Forward declaration so that projects that import us as a library don't necessarily have to use QT += network
 class QNetworkReply;
@@ -26,6 +30,10 @@ public:
 
     virtual QPointF qgs2ll(const QPointF& qgs, quint8 zoomLevel) const;
 
+    virtual void ll2qgsBatch(const QPointF * ll, QPointF * qgs, int count, quint8 zoomLevel) const;
+
+    virtual void qgs2llBatch(const QPointF * qgs, QPointF * ll, int count, quint8 zoomLevel) const;
+
     virtual quint64 tilesOnZoomLevel(quint8 zoomLevel) const;
 
     virtual quint16 tileSize() const;
@@ -38,19 +46,40 @@ public:
 
     virtual QString tileFileExtension() const;
 
+    /**
+     * @brief hosts are the servers (scheme and host, e.g. "https://a.tile.openstreetmap.org") that tiles are
+     * fetched from. Each tile always comes from the same one, and neighbouring tiles are spread across them.
+     */
+    QStringList hosts() const;
+    void setHosts(const QStringList& hosts);
+
 protected:
     virtual void fetchTile(quint32 x,
                            quint32 y,
                            quint8 z);
 
+    //virtual from MapTileSource
+    virtual void cancelFetch(quint32 x,
+                             quint32 y,
+                             quint8 z);
+
 private:
     OSMTileSource::OSMTileType _tileType;
 
-    //Set used to ensure a tile with a certain cacheID isn't requested twice
-    QSet<QString> _pendingRequests;
+    const WebMercator _mercator;
+
+    //Set used to ensure a tile isn't requested twice
+    QSet<MapTileKey> _pendingRequests;
+
+    //Hash used to keep track of what tile goes with what reply
+    QHash<QNetworkReply *, MapTileKey> _pendingReplies;
+
+    //Set from other threads, read by fetchTile()
+    mutable QMutex _hostsLock;
+    QStringList _hosts;
 
-    //Hash used to keep track of what cacheID goes with what reply
-    QHash<QNetworkReply *, QString> _pendingReplies;
+    //ETags of recently downloaded tiles, to revalidate them with once they expire
+    QCache<MapTileKey, QByteArray> _etags;
     
 signals:
     
@@ -0,0 +1,325 @@
+#include "WMTSTileSource.h"
+
+#include "guts/MapGraphicsNetwork.h"
+
+#include <cmath>
+#include <QBuffer>
+#include <QImage>
+#include <QMutexLocker>
+#include <QNetworkReply>
+#include <QRegExp>
+#include <QtDebug>
+
+//Bytes of split tiles kept until they're asked for. A 4x4 metatile of jpgs is around 300 KB.
+const int MAX_SPLIT_TILE_BYTES = 8 * 1024 * 1024;
+
+//Quality split tiles are encoded with when they're jpgs
+const int SPLIT_JPG_QUALITY = 90;
+
+WMTSTileSource::WMTSTileSource(const QString &name, const QString &urlTemplate, const QString &tileFileExtension) :
+    MapTileSource(), _name(name), _tileFileExtension(tileFileExtension.toLower()), _urlTemplate(urlTemplate),
+    _metatileSize(1), _maxZoomLevel(18)
+{
+    this->setCacheMode(MapTileSource::DiskAndMemCaching);
+    _splitTiles.setMaxCost(MAX_SPLIT_TILE_BYTES);
+}
+
+WMTSTileSource::~WMTSTileSource()
+{
+    qDebug() << this << this->name() << "Destructing";
+}
+
+QPointF WMTSTileSource::ll2qgs(const QPointF &ll, quint8 zoomLevel) const
+{
+    return _mercator.ll2qgs(ll, zoomLevel);
+}
+
+QPointF WMTSTileSource::qgs2ll(const QPointF &qgs, quint8 zoomLevel) const
+{
+    return _mercator.qgs2ll(qgs, zoomLevel);
+}
+
+void WMTSTileSource::ll2qgsBatch(const QPointF *ll, QPointF *qgs, int count, quint8 zoomLevel) const
+{
+    _mercator.ll2qgs(ll, qgs, count, zoomLevel);
+}
+
+void WMTSTileSource::qgs2llBatch(const QPointF *qgs, QPointF *ll, int count, quint8 zoomLevel) const
+{
+    _mercator.qgs2ll(qgs, ll, count, zoomLevel);
+}
+
+quint64 WMTSTileSource::tilesOnZoomLevel(quint8 zoomLevel) const
+{
+    return pow(4.0,zoomLevel);
+}
+
+quint16 WMTSTileSource::tileSize() const
+{
+    return _mercator.tileSize();
+}
+
+quint8 WMTSTileSource::minZoomLevel(QPointF ll)
+{
+    Q_UNUSED(ll)
+    return 0;
+}
+
+quint8 WMTSTileSource::maxZoomLevel(QPointF ll)
+{
+    Q_UNUSED(ll)
+    QMutexLocker lock(&_configLock);
+    return _maxZoomLevel;
+}
+
+QString WMTSTileSource::name() const
+{
+    return _name;
+}
+
+QString WMTSTileSource::tileFileExtension() const
+{
+    return _tileFileExtension;
+}
+
+QString WMTSTileSource::urlTemplate() const
+{
+    QMutexLocker lock(&_configLock);
+    return _urlTemplate;
+}
+
+void WMTSTileSource::setUrlTemplate(const QString &urlTemplate)
+{
+    QMutexLocker lock(&_configLock);
+    _urlTemplate = urlTemplate;
+}
+
+int WMTSTileSource::metatileSize() const
+{
+    QMutexLocker lock(&_configLock);
+    return _metatileSize;
+}
+
+QString WMTSTileSource::metatileUrlTemplate() const
+{
+    QMutexLocker lock(&_configLock);
+    return _metatileUrlTemplate;
+}
+
+void WMTSTileSource::setMetatiles(int size, const QString &urlTemplate)
+{
+    QMutexLocker lock(&_configLock);
+    _metatileSize = qMax(1, size);
+    _metatileUrlTemplate = urlTemplate;
+}
+
+void WMTSTileSource::setMaxZoomLevel(quint8 zoomLevel)
+{
+    QMutexLocker lock(&_configLock);
+    _maxZoomLevel = zoomLevel;
+}
+
+//protected
+//pure-virtual from MapTileSource
+void WMTSTileSource::fetchTile(quint32 x, quint32 y, quint8 z)
+{
+    const MapTileKey key(x,y,z);
+
+    //Split from a metatile fetched for one of its neighbours
+    if (_splitTiles.contains(key))
+    {
+        const SplitTile split = *_splitTiles.object(key);
+        _splitTiles.remove(key);
+        this->prepareNewlyReceivedTile(x,y,z, split.encodedTile, split.expireTime);
+        return;
+    }
+
+    QMutexLocker lock(&_configLock);
+    const int size = _metatileUrlTemplate.isEmpty() ? 1 : _metatileSize;
+    const QString urlTemplate = (size == 1) ? _urlTemplate : _metatileUrlTemplate;
+    lock.unlock();
+
+    //Already coming with a metatile fetched for one of its neighbours
+    int columns = 1;
+    int rows = 1;
+    const MapTileKey metaKey = this->metatileOf(x,y,z, size, &columns, &rows);
+    if (_metatiles.contains(metaKey))
+    {
+        _metatiles[metaKey].waiting.insert(key);
+        return;
+    }
+
+    if (urlTemplate.isEmpty())
+    {
+        qWarning() << this->name() << "has nowhere to fetch tiles from";
+        this->prepareFailedTile(x,y,z);
+        return;
+    }
+
+    Metatile metatile;
+    metatile.x = metaKey.x();
+    metatile.y = metaKey.y();
+    metatile.z = z;
+    metatile.columns = columns;
+    metatile.rows = rows;
+    metatile.waiting.insert(key);
+
+    const QString url = fillTemplate(urlTemplate, metatile.x, metatile.y, z, size, columns, rows);
+    metatile.reply = MapGraphicsNetwork::getInstance()->get(QNetworkRequest(QUrl(url)));
+    _metatiles.insert(metaKey, metatile);
+    _pendingReplies.insert(metatile.reply, metaKey);
+
+    connect(metatile.reply,
+            SIGNAL(finished()),
+            this,
+            SLOT(handleNetworkRequestFinished()));
+}
+
+//protected
+//virtual from MapTileSource
+void WMTSTileSource::cancelFetch(quint32 x, quint32 y, quint8 z)
+{
+    //Metatiles are still fetched for the neighbours that want them, so only the last one out aborts
+    const MapTileKey key(x,y,z);
+    QHash<MapTileKey, Metatile>::iterator iter;
+    for (iter = _metatiles.begin(); iter != _metatiles.end(); iter++)
+    {
+        if (!iter.value().waiting.remove(key))
+            continue;
+
+        //Aborting makes the reply finish with an error, which handleNetworkRequestFinished() cleans up
+        if (iter.value().waiting.isEmpty())
+            iter.value().reply->abort();
+        return;
+    }
+}
+
+//private slot
+void WMTSTileSource::handleNetworkRequestFinished()
+{
+    QNetworkReply * reply = qobject_cast<QNetworkReply *>(QObject::sender());
+    if (reply == 0)
+    {
+        qWarning() << "QNetworkReply cast failure";
+        return;
+    }
+    reply->deleteLater();
+
+    if (!_pendingReplies.contains(reply))
+    {
+        qWarning() << "Unknown QNetworkReply";
+        return;
+    }
+    const Metatile metatile = _metatiles.take(_pendingReplies.take(reply));
+
+    //Cancelled requests end up here too, with nobody waiting
+    if (reply->error() != QNetworkReply::NoError)
+    {
+        if (reply->error() != QNetworkReply::OperationCanceledError)
+            qDebug() << "Network Error:" << reply->errorString();
+        foreach(const MapTileKey& key, metatile.waiting)
+            this->prepareFailedTile(key.x(), key.y(), key.z());
+        return;
+    }
+
+    this->splitMetatile(metatile, reply->readAll(), expireTimeOf(reply));
+}
+
+//private
+MapTileKey WMTSTileSource::metatileOf(quint32 x, quint32 y, quint8 z, int size, int *columns, int *rows) const
+{
+    //Clipped to the edges of the zoom level, which can be smaller than a metatile or not a multiple of one
+    const quint64 tilesOnOneEdge = (quint64) 1 << z;
+    const quint32 metaX = x - x % size;
+    const quint32 metaY = y - y % size;
+    *columns = (int) qMin<quint64>(size, tilesOnOneEdge - metaX);
+    *rows = (int) qMin<quint64>(size, tilesOnOneEdge - metaY);
+    return MapTileKey(metaX, metaY, z);
+}
+
+//private static
+QString WMTSTileSource::fillTemplate(QString urlTemplate, quint32 x, quint32 y, quint8 z,
+                                     int size, int columns, int rows)
+{
+    return urlTemplate.replace("{TileMatrix}", QString::number(z))
+            .replace("{TileRow}", QString::number(y))
+            .replace("{TileCol}", QString::number(x))
+            .replace("{MetaSize}", QString::number(size))
+            .replace("{MetaCols}", QString::number(columns))
+            .replace("{MetaRows}", QString::number(rows));
+}
+
+//private static
+QDateTime WMTSTileSource::expireTimeOf(QNetworkReply *reply)
+{
+    //Like OSMTileSource, we only understand the max-age directive
+    QDateTime toRet;
+    if (!reply->hasRawHeader("Cache-Control"))
+        return toRet;
+
+    QRegExp maxAgeFinder("max-age=(\\d+)");
+    if (maxAgeFinder.indexIn(reply->rawHeader("Cache-Control")) == -1)
+        return toRet;
+
+    bool ok = false;
+    const qint64 delta = maxAgeFinder.cap(1).toULongLong(&ok);
+    if (ok)
+        toRet = QDateTime::currentDateTimeUtc().addSecs(delta);
+    return toRet;
+}
+
+//private
+void WMTSTileSource::splitMetatile(const WMTSTileSource::Metatile &metatile, const QByteArray &bytes,
+                                   const QDateTime &expireTime)
+{
+    //A single tile goes out as it came
+    if (metatile.columns == 1 && metatile.rows == 1)
+    {
+        foreach(const MapTileKey& key, metatile.waiting)
+            this->prepareNewlyReceivedTile(key.x(), key.y(), key.z(), bytes, expireTime);
+        return;
+    }
+
+    const int tileSize = this->tileSize();
+    const QImage image = QImage::fromData(bytes);
+    if (image.width() != metatile.columns * tileSize || image.height() != metatile.rows * tileSize)
+    {
+        qWarning() << this->name() << "expected a" << metatile.columns * tileSize << "x" << metatile.rows * tileSize
+                   << "metatile but got" << image.size();
+        foreach(const MapTileKey& key, metatile.waiting)
+            this->prepareFailedTile(key.x(), key.y(), key.z());
+        return;
+    }
+
+    const QByteArray format = (_tileFileExtension == "png") ? "PNG" : "JPG";
+    for (int column = 0; column < metatile.columns; column++)
+    {
+        for (int row = 0; row < metatile.rows; row++)
+        {
+            const MapTileKey key(metatile.x + column, metatile.y + row, metatile.z);
+            QByteArray encodedTile;
+            QBuffer buffer(&encodedTile);
+            buffer.open(QIODevice::WriteOnly);
+            image.copy(column * tileSize, row * tileSize, tileSize, tileSize)
+                    .save(&buffer, format.constData(), (format == "JPG") ? SPLIT_JPG_QUALITY : -1);
+
+            if (metatile.waiting.contains(key))
+            {
+                this->prepareNewlyReceivedTile(key.x(), key.y(), key.z(), encodedTile, expireTime);
+                continue;
+            }
+
+            //The neighbours nobody has asked for yet are cached for when they are, by us if nobody else will
+            if (this->cacheMode() != NoCaching)
+            {
+                this->toMemCache(key, encodedTile, expireTime);
+                this->toDiskCache(key, encodedTile, expireTime);
+                continue;
+            }
+            SplitTile * split = new SplitTile;
+            split->encodedTile = encodedTile;
+            split->expireTime = expireTime;
+            _splitTiles.insert(key, split, encodedTile.size());
+        }
+    }
+}
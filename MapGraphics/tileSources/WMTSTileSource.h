@@ -0,0 +1,148 @@
+#ifndef WMTSTILESOURCE_H
+#define WMTSTILESOURCE_H
+
+#include "MapTileSource.h"
+#include "MapGraphics_global.h"
+#include "guts/WebMercator.h"
+#include <QCache>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+
+//Forward declaration so that projects that import us as a library don't necessarily have to use QT += network
+class QNetworkReply;
+
+/**
+ * @brief The WMTSTileSource class fetches tiles from a WMTS server's GoogleMapsCompatible tile matrix set, which
+ * is laid out like OpenStreetMap's tiles (Web Mercator, 256 pixels, tile matrix = zoom level, row 0 at the north).
+ *
+ * Tiles are fetched from a URL template, either RESTful or KVP, in which {TileMatrix}, {TileRow} and {TileCol}
+ * are replaced, e.g. "https://imagery.example/wmts/sat/GoogleMapsCompatible/{TileMatrix}/{TileRow}/{TileCol}.jpg".
+ *
+ * Servers that render metatiles can hand out N×N tiles at once from a second template, which also has
+ * {MetaSize} (N), {MetaCols} and {MetaRows} (N, or fewer at the edges of small zoom levels) replaced, and whose
+ * {TileRow} and {TileCol} are those of the metatile's north-west tile. Metatiles are aligned to multiples of N.
+ * The image that comes back is split into its tiles and every one of them is cached, so a screenful of tiles
+ * costs N² fewer round trips. Tiles that weren't asked for yet are kept until they are, even without caching.
+ */
+class MAPGRAPHICSSHARED_EXPORT WMTSTileSource : public MapTileSource
+{
+    Q_OBJECT
+public:
+    /**
+     * @brief WMTSTileSource
+     * @param name the source's name, which its disk cache is named after
+     * @param urlTemplate the template single tiles are fetched from
+     * @param tileFileExtension the format of the tiles, "jpg" or "png"
+     */
+    WMTSTileSource(const QString& name, const QString& urlTemplate, const QString& tileFileExtension = "jpg");
+    virtual ~WMTSTileSource();
+
+    virtual QPointF ll2qgs(const QPointF& ll, quint8 zoomLevel) const;
+
+    virtual QPointF qgs2ll(const QPointF& qgs, quint8 zoomLevel) const;
+
+    virtual void ll2qgsBatch(const QPointF * ll, QPointF * qgs, int count, quint8 zoomLevel) const;
+
+    virtual void qgs2llBatch(const QPointF * qgs, QPointF * ll, int count, quint8 zoomLevel) const;
+
+    virtual quint64 tilesOnZoomLevel(quint8 zoomLevel) const;
+
+    virtual quint16 tileSize() const;
+
+    virtual quint8 minZoomLevel(QPointF ll);
+
+    virtual quint8 maxZoomLevel(QPointF ll);
+
+    virtual QString name() const;
+
+    virtual QString tileFileExtension() const;
+
+    QString urlTemplate() const;
+    void setUrlTemplate(const QString& urlTemplate);
+
+    /**
+     * @brief metatileSize returns how many tiles on a side are fetched at once. 1 (the default) fetches every
+     * tile on its own from urlTemplate().
+     */
+    int metatileSize() const;
+    QString metatileUrlTemplate() const;
+
+    /**
+     * @brief setMetatiles fetches tiles size×size at a time from urlTemplate from now on
+     * @param size at least 1. 1 turns metatiles off.
+     * @param urlTemplate
+     */
+    void setMetatiles(int size, const QString& urlTemplate);
+
+    void setMaxZoomLevel(quint8 zoomLevel);
+
+protected:
+    //pure-virtual from MapTileSource
+    virtual void fetchTile(quint32 x,
+                           quint32 y,
+                           quint8 z);
+
+    //virtual from MapTileSource
+    virtual void cancelFetch(quint32 x,
+                             quint32 y,
+                             quint8 z);
+
+private:
+    //A request under way, for a metatile or a single tile
+    struct Metatile
+    {
+        //The north-west tile and the size in tiles
+        quint32 x;
+        quint32 y;
+        quint8 z;
+        int columns;
+        int rows;
+
+        //The tiles asked for that are waiting on it
+        QSet<MapTileKey> waiting;
+
+        QNetworkReply * reply;
+    };
+
+    //A tile split from a metatile that hasn't been asked for yet
+    struct SplitTile
+    {
+        QByteArray encodedTile;
+        QDateTime expireTime;
+    };
+
+    //The key of the north-west tile of the metatile holding the tile, and the metatile's size
+    MapTileKey metatileOf(quint32 x, quint32 y, quint8 z, int size, int * columns, int * rows) const;
+
+    static QString fillTemplate(QString urlTemplate, quint32 x, quint32 y, quint8 z, int size, int columns, int rows);
+    static QDateTime expireTimeOf(QNetworkReply * reply);
+
+    //Splits the image of a metatile into its tiles, caches them and hands out the ones waiting on it
+    void splitMetatile(const Metatile& metatile, const QByteArray& bytes, const QDateTime& expireTime);
+
+    const QString _name;
+    const QString _tileFileExtension;
+    const WebMercator _mercator;
+
+    //Set from other threads, read by fetchTile()
+    mutable QMutex _configLock;
+    QString _urlTemplate;
+    QString _metatileUrlTemplate;
+    int _metatileSize;
+    quint8 _maxZoomLevel;
+
+    //Requests under way by their metatile's north-west tile, and which reply belongs to which
+    QHash<MapTileKey, Metatile> _metatiles;
+    QHash<QNetworkReply *, MapTileKey> _pendingReplies;
+
+    //Cost is in bytes
+    QCache<MapTileKey, SplitTile> _splitTiles;
+
+private slots:
+    void handleNetworkRequestFinished();
+
+};
+
+#endif // WMTSTILESOURCE_H
@@ -0,0 +1,50 @@
+#Linkage for the PlanningCore library and the libraries it uses. PlanningCore is static, so the libraries
+#it depends on have to come after it.
+win32:CONFIG(release, debug|release): LIBS += -L$$OUT_PWD/../PlanningCore/release/ -lPlanningCore
+else:win32:CONFIG(debug, debug|release): LIBS += -L$$OUT_PWD/../PlanningCore/debug/ -lPlanningCore
+else:unix: LIBS += -L$$OUT_PWD/../PlanningCore/ -lPlanningCore
+
+win32:CONFIG(release, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../PlanningCore/release/PlanningCore.lib
+else:win32:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../PlanningCore/debug/PlanningCore.lib
+else:unix: PRE_TARGETDEPS += $$OUT_PWD/../PlanningCore/libPlanningCore.a
+
+INCLUDEPATH += $$PWD/../FlightPlanner
+DEPENDPATH += $$PWD/../FlightPlanner
+
+#The GPU fitness backend, if PlanningCore was built with CONFIG += planning_opencl
+planning_opencl {
+    macx: LIBS += -framework OpenCL
+    else: LIBS += -lOpenCL
+}
+
+#Linkage for QVectorND library.
+win32:CONFIG(release, debug|release): LIBS += -L$$OUT_PWD/../QVectorND/release/ -lQVectorND
+else:win32:CONFIG(debug, debug|release): LIBS += -L$$OUT_PWD/../QVectorND/debug/ -lQVectorND
+else:unix: LIBS += -L$$OUT_PWD/../QVectorND/ -lQVectorND
+
+INCLUDEPATH += $$PWD/../QVectorND
+DEPENDPATH += $$PWD/../QVectorND
+
+#Linkage for QKDTree library.
+win32:CONFIG(release, debug|release): LIBS += -L$$OUT_PWD/../QKDTree/release/ -lQKDTree
+else:win32:CONFIG(debug, debug|release): LIBS += -L$$OUT_PWD/../QKDTree/debug/ -lQKDTree
+else:unix: LIBS += -L$$OUT_PWD/../QKDTree/ -lQKDTree
+
+INCLUDEPATH += $$PWD/../QKDTree
+DEPENDPATH += $$PWD/../QKDTree
+
+#Linkage for GPX library.
+win32:CONFIG(release, debug|release): LIBS += -L$$OUT_PWD/../GPX/release/ -lGPX
+else:win32:CONFIG(debug, debug|release): LIBS += -L$$OUT_PWD/../GPX/debug/ -lGPX
+else:unix: LIBS += -L$$OUT_PWD/../GPX/ -lGPX
+
+INCLUDEPATH += $$PWD/../GPX
+DEPENDPATH += $$PWD/../GPX
+
+#Linkage for Dubins library.
+win32:CONFIG(release, debug|release): LIBS += -L$$OUT_PWD/../Dubins/release/ -lDubins
+else:win32:CONFIG(debug, debug|release): LIBS += -L$$OUT_PWD/../Dubins/debug/ -lDubins
+else:unix: LIBS += -L$$OUT_PWD/../Dubins/ -lDubins
+
+INCLUDEPATH += $$PWD/../Dubins
+DEPENDPATH += $$PWD/../Dubins
@@ -0,0 +1,211 @@
+#-------------------------------------------------
+#
+# The planning core: the problem model, the planners, file formats and import/export
+#
+#-------------------------------------------------
+
+#QtGui only for its geometry types (QPolygonF, QVector3D and friends). Nothing in here uses widgets.
+QT       += core gui
+
+TARGET = PlanningCore
+TEMPLATE = lib
+CONFIG += staticlib
+
+#Per-node and per-state log messages in the search loops cost more than the searches. Build with
+#CONFIG += planning_trace to compile them in. See PlanningLog.h.
+planning_trace: DEFINES += PLANNING_TRACE
+
+#Scoring batches of flights on a GPU needs an OpenCL SDK. Build with CONFIG += planning_opencl (here and in
+#whatever links us) to compile it in. Without it, or without a GPU, batches are scored on the CPU. See
+#BatchFitnessEvaluator.h.
+planning_opencl {
+    DEFINES += PLANNING_OPENCL
+    SOURCES += ../FlightPlanner/OpenCLFitnessBackend.cpp
+    HEADERS += ../FlightPlanner/OpenCLFitnessBackend.h
+}
+
+INCLUDEPATH += $$PWD/../FlightPlanner
+DEPENDPATH += $$PWD/../FlightPlanner
+
+#Position and Conversions. Whoever links us provides them, through MapGraphics or MapGraphics/Geographic.pri
+INCLUDEPATH += $$PWD/../MapGraphics
+DEPENDPATH += $$PWD/../MapGraphics
+
+INCLUDEPATH += $$PWD/../QVectorND $$PWD/../QKDTree $$PWD/../GPX $$PWD/../Dubins
+DEPENDPATH += $$PWD/../QVectorND $$PWD/../QKDTree $$PWD/../GPX $$PWD/../Dubins
+
+SOURCES += ../FlightPlanner/FlightTasks/FlightTask.cpp\
+    ../FlightPlanner/Importers/Importer.cpp \
+    ../FlightPlanner/FlightPlanner.cpp \
+    ../FlightPlanner/BatchPlanningRun.cpp \
+    ../FlightPlanner/PlanningRandom.cpp \
+    ../FlightPlanner/PlanningStatistics.cpp \
+    ../FlightPlanner/PlanningStageTimer.cpp \
+    ../FlightPlanner/PlanningContext.cpp \
+    ../FlightPlanner/PlannerTuning.cpp \
+    ../FlightPlanner/PlannerTuningProfile.cpp \
+    ../FlightPlanner/AllocationTracker.cpp \
+    ../FlightPlanner/JobSystem.cpp \
+    ../FlightPlanner/PlanningLog.cpp \
+    ../FlightPlanner/FlightPath.cpp \
+    ../FlightPlanner/PlanningProblem.cpp \
+    ../FlightPlanner/ChangeCoalescer.cpp \
+    ../FlightPlanner/CompiledProblem.cpp \
+    ../FlightPlanner/BatchFitnessEvaluator.cpp \
+    ../FlightPlanner/LocalFrame.cpp \
+    ../FlightPlanner/RectIndex.cpp \
+    ../FlightPlanner/ProblemFile.cpp \
+    ../FlightPlanner/PlanCache.cpp \
+    ../FlightPlanner/UAVOrientation.cpp \
+    ../FlightPlanner/MotionPrimitiveTable.cpp \
+    ../FlightPlanner/FlightTaskArea.cpp \
+    ../FlightPlanner/FlightTasks/FlyThroughTask.cpp \
+    ../FlightPlanner/GreedyPlanner/GreedyFlightPlanner.cpp \
+    ../FlightPlanner/GreedyPlanner/GreedyPlanningNode.cpp \
+    ../FlightPlanner/EvolutionaryPlanner/EvolutionaryFlightPlanner.cpp \
+    ../FlightPlanner/Fitness.cpp \
+    ../FlightPlanner/FlightTasks/NoFlyFlightTask.cpp \
+    ../FlightPlanner/HierarchicalPlanner/HierarchicalPlanner.cpp \
+    ../FlightPlanner/FleetPlanner/FleetPlanner.cpp \
+    ../FlightPlanner/ParameterSweep/ParameterSweep.cpp \
+    ../FlightPlanner/HierarchicalPlanner/SubFlightPlanner/SubFlightPlanner.cpp \
+    ../FlightPlanner/HierarchicalPlanner/SubFlightPlanner/SubFlightNode.cpp \
+    ../FlightPlanner/FlightTasks/CoverageTask.cpp \
+    ../FlightPlanner/HierarchicalPlanner/IntermediatePlanner.cpp \
+    ../FlightPlanner/HierarchicalPlanner/RRTIntermediatePlanner/RRTIntermediatePlanner.cpp \
+    ../FlightPlanner/HierarchicalPlanner/RRTIntermediatePlanner/RRTDistanceMetric.cpp \
+    ../FlightPlanner/HierarchicalPlanner/DubinsDistanceMetric.cpp \
+    ../FlightPlanner/HierarchicalPlanner/RRTStarIntermediatePlanner/RRTStarIntermediatePlanner.cpp \
+    ../FlightPlanner/HierarchicalPlanner/AstarPRMIntermediatePlanner/AstarPRMIntermediatePlanner.cpp \
+    ../FlightPlanner/HierarchicalPlanner/VisibilityGraphIntermediatePlanner/VisibilityGraphIntermediatePlanner.cpp \
+    ../FlightPlanner/HierarchicalPlanner/PhonyIntermediatePlanner/PhonyIntermediatePlanner.cpp \
+    ../FlightPlanner/FlightTasks/TimingConstraint.cpp \
+    ../FlightPlanner/UAVParameters.cpp \
+    ../FlightPlanner/TerrainModel.cpp \
+    ../FlightPlanner/Exporters/Exporter.cpp \
+    ../FlightPlanner/Exporters/GPXExporter.cpp \
+    ../FlightPlanner/Exporters/BinaryExporter.cpp \
+    ../FlightPlanner/Exporters/BinaryFlightPathFormat.cpp \
+    ../FlightPlanner/Exporters/PathCompressor.cpp \
+    ../FlightPlanner/Exporters/SegmentExporter.cpp \
+    ../FlightPlanner/Exporters/FlightPrefixStreamer.cpp \
+    ../FlightPlanner/FlightTasks/SamplingTask.cpp \
+    ../FlightPlanner/HierarchicalPlanner/DubinsIntermediate/DubinsIntermediatePlanner.cpp \
+    ../FlightPlanner/Serializable.cpp \
+    ../FlightPlanner/Importers/GPXImporter.cpp \
+    ../FlightPlanner/Importers/BinaryImporter.cpp \
+    ../FlightPlanner/Importers/NoFlyZoneImporter.cpp \
+    ../FlightPlanner/HierarchicalPlanner/TransitionFlightCache.cpp \
+    ../FlightPlanner/HierarchicalPlanner/PlanningResultCache.cpp \
+    ../FlightPlanner/HierarchicalPlanner/SubFlightPlanner/SubFlightPlanningJob.cpp \
+    ../FlightPlanner/HierarchicalPlanner/TransitionPlanningJob.cpp \
+    ../FlightPlanner/HierarchicalPlanner/TransitionStrategy.cpp \
+    ../FlightPlanner/HierarchicalPlanner/IntermediatePlannerRegistry.cpp \
+    ../FlightPlanner/FlightTasks/FlightTaskScoringState.cpp \
+    ../FlightPlanner/FlightTasks/CoverageBins.cpp \
+    ../FlightPlanner/FlightTasks/CoverageDistanceField.cpp \
+    ../FlightPlanner/FlightTasks/AreaGeometry.cpp \
+    ../FlightPlanner/FlightTasks/AreaScoringContext.cpp \
+    ../FlightPlanner/FlightTasks/PolygonIndex.cpp \
+    ../FlightPlanner/FlightTasks/TimingWindowIndex.cpp \
+    ../FlightPlanner/HierarchicalPlanner/SubFlightPlanner/SubFlightNodeArena.cpp \
+    ../FlightPlanner/HierarchicalPlanner/SubFlightPlanner/SweepPattern.cpp \
+    ../FlightPlanner/HierarchicalPlanner/ConvexHull.cpp \
+    ../FlightPlanner/HierarchicalPlanner/ObstacleMap.cpp \
+    ../FlightPlanner/HierarchicalPlanner/WaypointGraph.cpp \
+    ../FlightPlanner/HierarchicalPlanner/ProbabilisticRoadmap.cpp \
+    ../FlightPlanner/HierarchicalPlanner/VisibilityGraph.cpp \
+    ../FlightPlanner/HierarchicalPlanner/ObstacleEdgeTree.cpp \
+    ../FlightPlanner/HierarchicalPlanner/ScheduleState.cpp \
+    ../FlightPlanner/HierarchicalPlanner/ScheduleLattice.cpp \
+    ../FlightPlanner/HierarchicalPlanner/ScheduleNodeTable.cpp
+
+HEADERS += \
+    ../FlightPlanner/FlightTasks/FlightTask.h \
+    ../FlightPlanner/FlightPlanner.h \
+    ../FlightPlanner/BatchPlanningRun.h \
+    ../FlightPlanner/PlanningRandom.h \
+    ../FlightPlanner/PlanningStatistics.h \
+    ../FlightPlanner/PlanningStageTimer.h \
+    ../FlightPlanner/PlanningContext.h \
+    ../FlightPlanner/PlannerTuning.h \
+    ../FlightPlanner/PlannerTuningProfile.h \
+    ../FlightPlanner/AllocationTracker.h \
+    ../FlightPlanner/JobSystem.h \
+    ../FlightPlanner/PlanningLog.h \
+    ../FlightPlanner/FlightPath.h \
+    ../FlightPlanner/PlanningProblem.h \
+    ../FlightPlanner/ChangeCoalescer.h \
+    ../FlightPlanner/CompiledProblem.h \
+    ../FlightPlanner/BatchFitnessEvaluator.h \
+    ../FlightPlanner/LocalFrame.h \
+    ../FlightPlanner/RectIndex.h \
+    ../FlightPlanner/TranspositionTable.h \
+    ../FlightPlanner/ProblemFile.h \
+    ../FlightPlanner/PlanCache.h \
+    ../FlightPlanner/UAVOrientation.h \
+    ../FlightPlanner/MotionPrimitiveTable.h \
+    ../FlightPlanner/FlightTaskArea.h \
+    ../FlightPlanner/FlightTasks/FlyThroughTask.h \
+    ../FlightPlanner/GreedyPlanner/GreedyFlightPlanner.h \
+    ../FlightPlanner/GreedyPlanner/GreedyPlanningNode.h \
+    ../FlightPlanner/EvolutionaryPlanner/EvolutionaryFlightPlanner.h \
+    ../FlightPlanner/Fitness.h \
+    ../FlightPlanner/FlightTasks/NoFlyFlightTask.h \
+    ../FlightPlanner/HierarchicalPlanner/HierarchicalPlanner.h \
+    ../FlightPlanner/FleetPlanner/FleetPlanner.h \
+    ../FlightPlanner/ParameterSweep/ParameterSweep.h \
+    ../FlightPlanner/HierarchicalPlanner/SubFlightPlanner/SubFlightPlanner.h \
+    ../FlightPlanner/HierarchicalPlanner/SubFlightPlanner/SubFlightNode.h \
+    ../FlightPlanner/FlightTasks/CoverageTask.h \
+    ../FlightPlanner/HierarchicalPlanner/IntermediatePlanner.h \
+    ../FlightPlanner/HierarchicalPlanner/RRTIntermediatePlanner/RRTIntermediatePlanner.h \
+    ../FlightPlanner/HierarchicalPlanner/RRTIntermediatePlanner/RRTDistanceMetric.h \
+    ../FlightPlanner/HierarchicalPlanner/DubinsDistanceMetric.h \
+    ../FlightPlanner/HierarchicalPlanner/RRTStarIntermediatePlanner/RRTStarIntermediatePlanner.h \
+    ../FlightPlanner/HierarchicalPlanner/AstarPRMIntermediatePlanner/AstarPRMIntermediatePlanner.h \
+    ../FlightPlanner/HierarchicalPlanner/VisibilityGraphIntermediatePlanner/VisibilityGraphIntermediatePlanner.h \
+    ../FlightPlanner/HierarchicalPlanner/PhonyIntermediatePlanner/PhonyIntermediatePlanner.h \
+    ../FlightPlanner/FlightTasks/TimingConstraint.h \
+    ../FlightPlanner/UAVParameters.h \
+    ../FlightPlanner/TerrainModel.h \
+    ../FlightPlanner/Exporters/Exporter.h \
+    ../FlightPlanner/Exporters/GPXExporter.h \
+    ../FlightPlanner/Exporters/BinaryExporter.h \
+    ../FlightPlanner/Exporters/BinaryFlightPathFormat.h \
+    ../FlightPlanner/Exporters/PathCompressor.h \
+    ../FlightPlanner/Exporters/SegmentExporter.h \
+    ../FlightPlanner/Exporters/FlightPrefixStreamer.h \
+    ../FlightPlanner/FlightTasks/SamplingTask.h \
+    ../FlightPlanner/HierarchicalPlanner/DubinsIntermediate/DubinsIntermediatePlanner.h \
+    ../FlightPlanner/Serializable.h \
+    ../FlightPlanner/Importers/Importer.h \
+    ../FlightPlanner/Importers/GPXImporter.h \
+    ../FlightPlanner/Importers/BinaryImporter.h \
+    ../FlightPlanner/Importers/NoFlyZoneImporter.h \
+    ../FlightPlanner/HierarchicalPlanner/PriorityQueue.h \
+    ../FlightPlanner/HierarchicalPlanner/BestFirstSearch.h \
+    ../FlightPlanner/HierarchicalPlanner/TransitionFlightCache.h \
+    ../FlightPlanner/HierarchicalPlanner/PlanningResultCache.h \
+    ../FlightPlanner/HierarchicalPlanner/SubFlightPlanner/SubFlightPlanningJob.h \
+    ../FlightPlanner/HierarchicalPlanner/TransitionPlanningJob.h \
+    ../FlightPlanner/HierarchicalPlanner/TransitionStrategy.h \
+    ../FlightPlanner/HierarchicalPlanner/IntermediatePlannerRegistry.h \
+    ../FlightPlanner/FlightTasks/FlightTaskScoringState.h \
+    ../FlightPlanner/FlightTasks/CoverageBins.h \
+    ../FlightPlanner/FlightTasks/CoverageDistanceField.h \
+    ../FlightPlanner/FlightTasks/AreaGeometry.h \
+    ../FlightPlanner/FlightTasks/AreaScoringContext.h \
+    ../FlightPlanner/FlightTasks/PolygonIndex.h \
+    ../FlightPlanner/FlightTasks/TimingWindowIndex.h \
+    ../FlightPlanner/HierarchicalPlanner/SubFlightPlanner/SubFlightNodeArena.h \
+    ../FlightPlanner/HierarchicalPlanner/SubFlightPlanner/SweepPattern.h \
+    ../FlightPlanner/HierarchicalPlanner/ConvexHull.h \
+    ../FlightPlanner/HierarchicalPlanner/ObstacleMap.h \
+    ../FlightPlanner/HierarchicalPlanner/WaypointGraph.h \
+    ../FlightPlanner/HierarchicalPlanner/ProbabilisticRoadmap.h \
+    ../FlightPlanner/HierarchicalPlanner/VisibilityGraph.h \
+    ../FlightPlanner/HierarchicalPlanner/ObstacleEdgeTree.h \
+    ../FlightPlanner/HierarchicalPlanner/ScheduleState.h \
+    ../FlightPlanner/HierarchicalPlanner/ScheduleLattice.h \
+    ../FlightPlanner/HierarchicalPlanner/ScheduleNodeTable.h
@@ -0,0 +1,696 @@
+#include "QFlatKDTree.h"
+
+#include <QVarLengthArray>
+#include <QFile>
+#include <QSaveFile>
+#include <QStringBuilder>
+#include <algorithm>
+#include <limits>
+#include <cstring>
+
+//Queries use a fixed stack of this many entries, so the tree is rebuilt before it gets deeper than that
+const int MAX_STACK = 128;
+const int MAX_DEPTH = 100;
+
+//A saved tree is a FileHeader padded to FILE_HEADER_SIZE, the input hash padded to a multiple of 8 bytes,
+//then the coordinates, left children, right children and dividing dimensions, each as one array
+const quint32 FILE_MAGIC = 0x5444464B;
+const quint32 FILE_VERSION = 1;
+const qint64 FILE_HEADER_SIZE = 64;
+
+//Written as-is, so a file from a machine with other byte order or another qreal won't have these
+const quint32 FILE_BYTE_ORDER = 0x01020304;
+const quint32 FILE_REAL_SIZE = sizeof(qreal);
+
+struct FileHeader
+{
+    quint32 magic;
+    quint32 version;
+    quint32 byteOrder;
+    quint32 realSize;
+    qint32 dimension;
+    qint32 count;
+    qint32 root;
+    qint32 hashSize;
+};
+
+//non-member
+static qint64 fileDataOffset(int hashSize)
+{
+    return FILE_HEADER_SIZE + ((hashSize + 7) / 8) * 8;
+}
+
+//non-member
+static qint64 fileSize(int hashSize, int dimension, int count)
+{
+    return fileDataOffset(hashSize) + (qint64)count * dimension * sizeof(qreal) + 3 * (qint64)count * sizeof(qint32);
+}
+
+//Orders point indices by one of their coordinates
+class FlatIndexLess
+{
+public:
+    FlatIndexLess(const qreal * coords, int dimension, int dim) :
+        _coords(coords), _dimension(dimension), _dim(dim) {}
+    bool operator()(qint32 a, qint32 b) const
+    {
+        return _coords[a * _dimension + _dim] < _coords[b * _dimension + _dim];
+    }
+private:
+    const qreal * _coords;
+    int _dimension;
+    int _dim;
+};
+
+//True for point indices whose coordinate in one dimension is no more than a pivot
+class FlatIndexAtMost
+{
+public:
+    FlatIndexAtMost(const qreal * coords, int dimension, int dim, qreal pivot) :
+        _coords(coords), _dimension(dimension), _dim(dim), _pivot(pivot) {}
+    bool operator()(qint32 a) const
+    {
+        return _coords[a * _dimension + _dim] <= _pivot;
+    }
+private:
+    const qreal * _coords;
+    int _dimension;
+    int _dim;
+    qreal _pivot;
+};
+
+struct FlatBuildRange
+{
+    int begin;
+    int end;
+    qint32 parent;
+    bool isLeft;
+};
+
+struct FlatSearchEntry
+{
+    qint32 node;
+    qreal planeDistance;
+};
+
+QFlatKDTree::QFlatKDTree(int dimension, bool allowDuplicates, QKDTreeDistanceMetric *distanceMetric) :
+    _dimension(qMax<int>(1, dimension)), _allowDuplicates(allowDuplicates), _distanceMetric(distanceMetric),
+    _root(-1), _sizeAtLastRebuild(0),
+    _mappedFile(0), _mapped(0), _mappedCount(0),
+    _mappedCoords(0), _mappedLeft(0), _mappedRight(0), _mappedDivDims(0)
+{
+}
+
+QFlatKDTree::~QFlatKDTree()
+{
+    this->_unmap();
+    delete _distanceMetric;
+    _distanceMetric = 0;
+}
+
+int QFlatKDTree::dimension() const
+{
+    return _dimension;
+}
+
+int QFlatKDTree::size() const
+{
+    if (_mapped)
+        return _mappedCount;
+    return _left.size();
+}
+
+void QFlatKDTree::reserve(int size)
+{
+    this->_detach();
+    _coords.reserve(size * _dimension);
+    _left.reserve(size);
+    _right.reserve(size);
+    _divDims.reserve(size);
+}
+
+qint64 QFlatKDTree::memoryBytes() const
+{
+    qint64 toRet = (qint64)_coords.capacity() * sizeof(qreal);
+    toRet += (qint64)(_left.capacity() + _right.capacity() + _divDims.capacity()) * sizeof(qint32);
+    return toRet;
+}
+
+void QFlatKDTree::clear()
+{
+    this->_unmap();
+    _coords.resize(0);
+    _left.resize(0);
+    _right.resize(0);
+    _divDims.resize(0);
+    _root = -1;
+    _sizeAtLastRebuild = 0;
+}
+
+int QFlatKDTree::add(const QVectorND &position, QString *resultOut)
+{
+    if (position.dimension() != _dimension)
+    {
+        if (resultOut)
+            *resultOut = "Dimension of position does not match that of tree.";
+        return -1;
+    }
+    return this->add(position.values().constData(), resultOut);
+}
+
+int QFlatKDTree::add(const qreal *position, QString *resultOut)
+{
+    if (position == 0)
+    {
+        if (resultOut)
+            *resultOut = "Cannot add null position";
+        return -1;
+    }
+    else if (!_allowDuplicates && _findDuplicate(position) >= 0)
+    {
+        if (resultOut)
+            *resultOut = "Cannot add duplicate";
+        return -1;
+    }
+
+    this->_detach();
+
+    const qint32 index = _left.size();
+    for (int d = 0; d < _dimension; d++)
+        _coords.append(position[d]);
+    _left.append(-1);
+    _right.append(-1);
+    _divDims.append(0);
+
+    if (_root < 0)
+    {
+        _root = index;
+        return index;
+    }
+
+    //Normal insertion, going left on <= like QKDTree
+    qint32 parent = _root;
+    int depth = 1;
+    while (true)
+    {
+        const int divDim = _divDims[parent];
+        qint32& child = (position[divDim] <= _coords[parent * _dimension + divDim]) ? _left[parent] : _right[parent];
+        if (child < 0)
+        {
+            child = index;
+            _divDims[index] = (divDim + 1) % _dimension;
+            break;
+        }
+        parent = child;
+        depth++;
+    }
+
+    if (depth >= MAX_DEPTH || this->size() >= 2 * qMax<int>(_sizeAtLastRebuild, 8))
+        this->rebalance();
+
+    return index;
+}
+
+int QFlatKDTree::nearest(const QVectorND &position, qreal *distanceOut, qreal epsilon, int maxVisits) const
+{
+    if (position.dimension() != _dimension)
+        return -1;
+    return this->nearest(position.values().constData(), distanceOut, epsilon, maxVisits);
+}
+
+int QFlatKDTree::nearest(const qreal *position, qreal *distanceOut, qreal epsilon, int maxVisits) const
+{
+    if (_root < 0 || position == 0)
+        return -1;
+
+    //Scratch point on the splitting hyperplane, so we can use the metric to measure distance to it
+    QVarLengthArray<qreal, 8> planePoint(_dimension);
+    for (int d = 0; d < _dimension; d++)
+        planePoint[d] = position[d];
+
+    FlatSearchEntry stack[MAX_STACK];
+    int stackSize = 0;
+    stack[stackSize].node = _root;
+    stack[stackSize].planeDistance = 0.0;
+    stackSize++;
+
+    const qreal * coords = this->_coordsData();
+    const qint32 * left = this->_leftData();
+    const qint32 * right = this->_rightData();
+    const qint32 * divDims = this->_divDimsData();
+
+    qint32 best = -1;
+    qreal bestDist = std::numeric_limits<qreal>::max();
+
+    //Subtrees are only searched if they could beat this, which is bestDist when epsilon is 0
+    const qreal shrink = 1.0 / (1.0 + qMax<qreal>(0.0, epsilon));
+    qreal pruneDist = bestDist;
+    int visits = 0;
+
+    while (stackSize > 0)
+    {
+        const FlatSearchEntry entry = stack[--stackSize];
+        if (entry.planeDistance > pruneDist)
+            continue;
+
+        const qint32 current = entry.node;
+        const qreal * currentCoords = coords + current * _dimension;
+        const qreal dist = this->distance(currentCoords, position);
+        if (dist < bestDist)
+        {
+            best = current;
+            bestDist = dist;
+            pruneDist = bestDist * shrink;
+        }
+        if (maxVisits > 0 && ++visits >= maxVisits)
+            break;
+
+        const int divDim = divDims[current];
+        const qreal divVal = currentCoords[divDim];
+        planePoint[divDim] = divVal;
+        const qreal planeDistance = this->distance(planePoint.constData(), position);
+        planePoint[divDim] = position[divDim];
+
+        qint32 nearSide = left[current];
+        qint32 farSide = right[current];
+        if (position[divDim] > divVal)
+            qSwap(nearSide, farSide);
+
+        //Far side first so that the near side is searched first. Depth is capped, so we can't overflow.
+        if (farSide >= 0 && planeDistance <= pruneDist)
+        {
+            stack[stackSize].node = farSide;
+            stack[stackSize].planeDistance = planeDistance;
+            stackSize++;
+        }
+        if (nearSide >= 0)
+        {
+            stack[stackSize].node = nearSide;
+            stack[stackSize].planeDistance = entry.planeDistance;
+            stackSize++;
+        }
+    }
+
+    if (distanceOut)
+        *distanceOut = bestDist;
+    return best;
+}
+
+int QFlatKDTree::withinDistance(const QVectorND &position, qreal maxDistance, QVector<int> *indicesOut) const
+{
+    if (position.dimension() != _dimension)
+    {
+        if (indicesOut)
+            indicesOut->clear();
+        return 0;
+    }
+    return this->withinDistance(position.values().constData(), maxDistance, indicesOut);
+}
+
+int QFlatKDTree::withinDistance(const qreal *position, qreal maxDistance, QVector<int> *indicesOut) const
+{
+    if (indicesOut == 0)
+        return 0;
+    indicesOut->clear();
+    if (_root < 0 || position == 0)
+        return 0;
+
+    //Same walk as nearest(), but the bound stays put
+    QVarLengthArray<qreal, 8> planePoint(_dimension);
+    for (int d = 0; d < _dimension; d++)
+        planePoint[d] = position[d];
+
+    const qreal * coords = this->_coordsData();
+    const qint32 * left = this->_leftData();
+    const qint32 * right = this->_rightData();
+    const qint32 * divDims = this->_divDimsData();
+
+    FlatSearchEntry stack[MAX_STACK];
+    int stackSize = 0;
+    stack[stackSize].node = _root;
+    stack[stackSize].planeDistance = 0.0;
+    stackSize++;
+
+    while (stackSize > 0)
+    {
+        const FlatSearchEntry entry = stack[--stackSize];
+        if (entry.planeDistance > maxDistance)
+            continue;
+
+        const qint32 current = entry.node;
+        const qreal * currentCoords = coords + current * _dimension;
+        if (this->distance(currentCoords, position) <= maxDistance)
+            indicesOut->append(current);
+
+        const int divDim = divDims[current];
+        const qreal divVal = currentCoords[divDim];
+        planePoint[divDim] = divVal;
+        const qreal planeDistance = this->distance(planePoint.constData(), position);
+        planePoint[divDim] = position[divDim];
+
+        qint32 nearSide = left[current];
+        qint32 farSide = right[current];
+        if (position[divDim] > divVal)
+            qSwap(nearSide, farSide);
+
+        if (farSide >= 0 && planeDistance <= maxDistance)
+        {
+            stack[stackSize].node = farSide;
+            stack[stackSize].planeDistance = planeDistance;
+            stackSize++;
+        }
+        if (nearSide >= 0)
+        {
+            stack[stackSize].node = nearSide;
+            stack[stackSize].planeDistance = entry.planeDistance;
+            stackSize++;
+        }
+    }
+
+    return indicesOut->size();
+}
+
+const qreal *QFlatKDTree::coordinates(int index) const
+{
+    return this->_coordsData() + index * _dimension;
+}
+
+QVectorND QFlatKDTree::position(int index) const
+{
+    QVectorND toRet(_dimension);
+    const qreal * coords = this->coordinates(index);
+    for (int d = 0; d < _dimension; d++)
+        toRet[d] = coords[d];
+    return toRet;
+}
+
+qreal QFlatKDTree::distance(const qreal *a, const qreal *b) const
+{
+    if (_distanceMetric)
+        return _distanceMetric->distance(a, b, _dimension);
+
+    qreal toRet = 0.0;
+    for (int d = 0; d < _dimension; d++)
+    {
+        const qreal diff = a[d] - b[d];
+        toRet += diff * diff;
+    }
+    return toRet;
+}
+
+void QFlatKDTree::rebalance()
+{
+    this->_detach();
+
+    const int count = this->size();
+    _sizeAtLastRebuild = count;
+    _root = -1;
+    if (count == 0)
+        return;
+
+    QVector<qint32> order(count);
+    for (int i = 0; i < count; i++)
+    {
+        order[i] = i;
+        _left[i] = -1;
+        _right[i] = -1;
+    }
+
+    const qreal * coords = _coords.constData();
+
+    QVarLengthArray<FlatBuildRange, 64> todo;
+    FlatBuildRange all = {0, count, -1, false};
+    todo.append(all);
+
+    while (!todo.isEmpty())
+    {
+        const FlatBuildRange range = todo[todo.size() - 1];
+        todo.removeLast();
+
+        qint32 * begin = order.data() + range.begin;
+        qint32 * end = order.data() + range.end;
+
+        //Split along the dimension with the largest spread
+        int divDim = 0;
+        qreal bestSpread = -1.0;
+        for (int dim = 0; dim < _dimension; dim++)
+        {
+            qreal minVal = std::numeric_limits<qreal>::max();
+            qreal maxVal = -std::numeric_limits<qreal>::max();
+            for (qint32 * iter = begin; iter != end; iter++)
+            {
+                const qreal val = coords[*iter * _dimension + dim];
+                minVal = qMin<qreal>(minVal, val);
+                maxVal = qMax<qreal>(maxVal, val);
+            }
+            if (maxVal - minVal > bestSpread)
+            {
+                bestSpread = maxVal - minVal;
+                divDim = dim;
+            }
+        }
+
+        qint32 * median = begin + (range.end - range.begin) / 2;
+        std::nth_element(begin, median, end, FlatIndexLess(coords, _dimension, divDim));
+
+        //Everything equal to the median has to end up on the left (see QKDTree::_rebuild)
+        const qreal pivot = coords[*median * _dimension + divDim];
+        qint32 * lastEqual = std::partition(median + 1, end, FlatIndexAtMost(coords, _dimension, divDim, pivot)) - 1;
+        std::iter_swap(median, lastEqual);
+        median = lastEqual;
+
+        const qint32 node = *median;
+        _divDims[node] = divDim;
+
+        if (range.parent < 0)
+            _root = node;
+        else if (range.isLeft)
+            _left[range.parent] = node;
+        else
+            _right[range.parent] = node;
+
+        const int medianIndex = median - order.data();
+        if (range.begin < medianIndex)
+        {
+            FlatBuildRange left = {range.begin, medianIndex, node, true};
+            todo.append(left);
+        }
+        if (medianIndex + 1 < range.end)
+        {
+            FlatBuildRange right = {medianIndex + 1, range.end, node, false};
+            todo.append(right);
+        }
+    }
+}
+
+bool QFlatKDTree::save(const QString &filename, const QByteArray &inputHash, QString *resultOut) const
+{
+    const int count = this->size();
+
+    QByteArray header(fileDataOffset(inputHash.size()), '\0');
+    FileHeader * head = (FileHeader *) header.data();
+    head->magic = FILE_MAGIC;
+    head->version = FILE_VERSION;
+    head->byteOrder = FILE_BYTE_ORDER;
+    head->realSize = FILE_REAL_SIZE;
+    head->dimension = _dimension;
+    head->count = count;
+    head->root = _root;
+    head->hashSize = inputHash.size();
+    memcpy(header.data() + FILE_HEADER_SIZE, inputHash.constData(), inputHash.size());
+
+    QSaveFile file(filename);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        if (resultOut)
+            *resultOut = "Failed to open " % filename % ": " % file.errorString();
+        return false;
+    }
+
+    file.write(header);
+    file.write((const char *) this->_coordsData(), (qint64)count * _dimension * sizeof(qreal));
+    file.write((const char *) this->_leftData(), (qint64)count * sizeof(qint32));
+    file.write((const char *) this->_rightData(), (qint64)count * sizeof(qint32));
+    file.write((const char *) this->_divDimsData(), (qint64)count * sizeof(qint32));
+
+    //QSaveFile remembers write errors and won't replace the old file if there were any
+    if (!file.commit())
+    {
+        if (resultOut)
+            *resultOut = "Failed to write " % filename % ": " % file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool QFlatKDTree::openMapped(const QString &filename, const QByteArray &inputHash, QString *resultOut)
+{
+    QFile * file = new QFile(filename);
+    if (!file->open(QIODevice::ReadOnly))
+    {
+        if (resultOut)
+            *resultOut = "Failed to open " % filename % ": " % file->errorString();
+        delete file;
+        return false;
+    }
+
+    const qint64 size = file->size();
+    uchar * mapped = (size >= FILE_HEADER_SIZE) ? file->map(0, size) : 0;
+    if (mapped == 0)
+    {
+        if (resultOut)
+            *resultOut = "Failed to map " % filename;
+        delete file;
+        return false;
+    }
+
+    const FileHeader * head = (const FileHeader *) mapped;
+    QString problem;
+    if (head->magic != FILE_MAGIC)
+        problem = "is not a saved kd-tree";
+    else if (head->version != FILE_VERSION)
+        problem = "is from another version";
+    else if (head->byteOrder != FILE_BYTE_ORDER || head->realSize != FILE_REAL_SIZE)
+        problem = "is from an incompatible machine";
+    else if (head->dimension != _dimension)
+        problem = "has the wrong dimension";
+    else if (head->hashSize != inputHash.size()
+             || size < FILE_HEADER_SIZE + inputHash.size()
+             || memcmp(mapped + FILE_HEADER_SIZE, inputHash.constData(), inputHash.size()) != 0)
+        problem = "was built from different inputs";
+    else if (head->count < 0 || size != fileSize(head->hashSize, _dimension, head->count)
+             || head->root < -1 || head->root >= head->count || (head->root < 0) != (head->count == 0))
+        problem = "is corrupt";
+
+    const int count = problem.isEmpty() ? head->count : 0;
+    const qreal * coords = (const qreal *)(mapped + fileDataOffset(head->hashSize));
+    const qint32 * left = (const qint32 *)(coords + (qint64)count * _dimension);
+    const qint32 * right = left + count;
+    const qint32 * divDims = right + count;
+
+    //Bad links would send queries off the end of the mapping
+    for (int i = 0; problem.isEmpty() && i < count; i++)
+    {
+        if (left[i] < -1 || left[i] >= count || right[i] < -1 || right[i] >= count
+                || divDims[i] < 0 || divDims[i] >= _dimension)
+            problem = "is corrupt";
+    }
+
+    if (!problem.isEmpty())
+    {
+        if (resultOut)
+            *resultOut = filename % " " % problem;
+        delete file;
+        return false;
+    }
+
+    const qint32 root = head->root;
+    this->clear();
+    _mappedFile = file;
+    _mapped = mapped;
+    _mappedCount = count;
+    _mappedCoords = coords;
+    _mappedLeft = left;
+    _mappedRight = right;
+    _mappedDivDims = divDims;
+    _root = root;
+    _sizeAtLastRebuild = count;
+    return true;
+}
+
+bool QFlatKDTree::isMapped() const
+{
+    return _mapped != 0;
+}
+
+//private
+int QFlatKDTree::_findDuplicate(const qreal *position) const
+{
+    const qreal * coords = this->_coordsData();
+    const qint32 * left = this->_leftData();
+    const qint32 * right = this->_rightData();
+    const qint32 * divDims = this->_divDimsData();
+
+    qint32 current = _root;
+    while (current >= 0)
+    {
+        const qreal * currentCoords = coords + current * _dimension;
+
+        bool same = true;
+        for (int d = 0; d < _dimension && same; d++)
+            same = (currentCoords[d] == position[d]);
+        if (same)
+            return current;
+
+        const int divDim = divDims[current];
+        if (position[divDim] <= currentCoords[divDim])
+            current = left[current];
+        else
+            current = right[current];
+    }
+    return -1;
+}
+
+//private
+const qreal *QFlatKDTree::_coordsData() const
+{
+    return _mapped ? _mappedCoords : _coords.constData();
+}
+
+//private
+const qint32 *QFlatKDTree::_leftData() const
+{
+    return _mapped ? _mappedLeft : _left.constData();
+}
+
+//private
+const qint32 *QFlatKDTree::_rightData() const
+{
+    return _mapped ? _mappedRight : _right.constData();
+}
+
+//private
+const qint32 *QFlatKDTree::_divDimsData() const
+{
+    return _mapped ? _mappedDivDims : _divDims.constData();
+}
+
+//private
+void QFlatKDTree::_detach()
+{
+    if (_mapped == 0)
+        return;
+
+    const int count = _mappedCount;
+    QVector<qreal> coords(count * _dimension);
+    QVector<qint32> left(count);
+    QVector<qint32> right(count);
+    QVector<qint32> divDims(count);
+    memcpy(coords.data(), _mappedCoords, (size_t)count * _dimension * sizeof(qreal));
+    memcpy(left.data(), _mappedLeft, (size_t)count * sizeof(qint32));
+    memcpy(right.data(), _mappedRight, (size_t)count * sizeof(qint32));
+    memcpy(divDims.data(), _mappedDivDims, (size_t)count * sizeof(qint32));
+
+    this->_unmap();
+    _coords = coords;
+    _left = left;
+    _right = right;
+    _divDims = divDims;
+}
+
+//private
+void QFlatKDTree::_unmap()
+{
+    if (_mappedFile == 0)
+        return;
+
+    //Deleting the file unmaps it
+    delete _mappedFile;
+    _mappedFile = 0;
+    _mapped = 0;
+    _mappedCount = 0;
+    _mappedCoords = 0;
+    _mappedLeft = 0;
+    _mappedRight = 0;
+    _mappedDivDims = 0;
+}
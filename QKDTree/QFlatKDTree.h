@@ -0,0 +1,169 @@
+#ifndef QFLATKDTREE_H
+#define QFLATKDTREE_H
+
+#include "QKDTree_global.h"
+
+#include <QVector>
+#include <QString>
+#include <QByteArray>
+
+#include "QKDTreeDistanceMetric.h"
+#include "QVectorND.h"
+
+class QFile;
+
+/**
+ * @brief The QFlatKDTree class is a kd-tree that trades QKDTree's per-node objects and QVariant values for
+ * compact, contiguous storage. It is meant for hot loops (e.g., RRT growth) that do many nearest-neighbor
+ * queries on a tree that only grows.
+ *
+ * Coordinates of all points live in one buffer, children are 32-bit indices into it and queries walk the
+ * tree with a fixed-size stack, so neither add() nor nearest() allocate once capacity has been reserved.
+ * Points are identified by the index add() returns. Indices never change, even when the tree rebalances.
+ *
+ * A built tree can be written out with save() and later opened with openMapped(), which maps the file and
+ * queries it where it lies instead of reading it in or rebuilding.
+ */
+class QKDTREESHARED_EXPORT QFlatKDTree
+{
+public:
+    /**
+     * @brief QFlatKDTree constructs a tree of points with the given dimension.
+     * @param dimension
+     * @param allowDuplicates whether or not you can add the same point more than once
+     * @param distanceMetric custom distance metric. The tree takes ownership. If 0, squared euclidean
+     * distance is computed inline.
+     */
+    QFlatKDTree(int dimension, bool allowDuplicates = false, QKDTreeDistanceMetric * distanceMetric = 0);
+    ~QFlatKDTree();
+
+    int dimension() const;
+    int size() const;
+
+    void reserve(int size);
+    void clear();
+
+    /**
+     * @brief memoryBytes returns how many bytes the tree has allocated for its points, used or not. Points in a
+     * mapped file don't count.
+     * @return
+     */
+    qint64 memoryBytes() const;
+
+    /**
+     * @brief add inserts a point into the tree.
+     * @param position
+     * @param resultOut
+     * @return the index of the new point, or -1 on failure
+     */
+    int add(const QVectorND& position, QString * resultOut = 0);
+    int add(const qreal * position, QString * resultOut = 0);
+
+    /**
+     * @brief nearest finds the point nearest to position, or with epsilon or maxVisits set, a point that's
+     * near enough. Callers like RRT extension that only need a nearby point can trade exactness for speed.
+     * @param position
+     * @param distanceOut if not null, receives the distance to the point returned
+     * @param epsilon skip parts of the tree that can't be closer than (distance found so far) / (1 + epsilon),
+     * so the point returned is within (1 + epsilon) times the nearest distance, as measured by the tree's
+     * metric. 0 gives the exact nearest point.
+     * @param maxVisits stop after measuring to this many points and return the best so far. 0 for no limit.
+     * @return the index of the point found, or -1 if the tree is empty or the dimension is wrong
+     */
+    int nearest(const QVectorND& position, qreal * distanceOut = 0, qreal epsilon = 0.0, int maxVisits = 0) const;
+    int nearest(const qreal * position, qreal * distanceOut = 0, qreal epsilon = 0.0, int maxVisits = 0) const;
+
+    /**
+     * @brief withinDistance finds every point no further than maxDistance from position, measured with the
+     * tree's metric (so squared distance with the default one).
+     * @param position
+     * @param maxDistance
+     * @param indicesOut receives the indices of the points found, replacing its contents, in no particular order
+     * @return the number of points found
+     */
+    int withinDistance(const QVectorND& position, qreal maxDistance, QVector<int> * indicesOut) const;
+    int withinDistance(const qreal * position, qreal maxDistance, QVector<int> * indicesOut) const;
+
+    /**
+     * @brief coordinates returns a pointer to the dimension() coordinates of the point at index.
+     * Invalidated by add() if the tree has to grow.
+     * @param index
+     * @return
+     */
+    const qreal * coordinates(int index) const;
+    QVectorND position(int index) const;
+
+    /**
+     * @brief distance measures the distance between two positions the same way the tree does.
+     */
+    qreal distance(const qreal * a, const qreal * b) const;
+
+    /**
+     * @brief rebalance rebuilds the tree's links by median partitioning. Indices are unaffected.
+     * add() does this automatically whenever the size doubles or the tree gets too deep for the query stack.
+     */
+    void rebalance();
+
+    /**
+     * @brief save writes the tree to a file that openMapped() can use directly. The file is in this machine's
+     * byte order and is replaced atomically.
+     * @param filename
+     * @param inputHash identifies what the tree was built from (e.g., a QCryptographicHash of the inputs and
+     * build parameters). openMapped() only accepts the file if it's given the same hash.
+     * @param resultOut
+     * @return false if the file couldn't be written
+     */
+    bool save(const QString& filename, const QByteArray& inputHash, QString * resultOut = 0) const;
+
+    /**
+     * @brief openMapped replaces the contents of the tree with a file written by save(), memory-mapping it
+     * rather than reading it. Queries run on the mapping. The first add(), reserve() or rebalance() copies it
+     * into memory, after which the tree behaves as if it had been built normally. The tree must have the
+     * dimension and metric it was saved with; only the dimension can be checked.
+     * @param filename
+     * @param inputHash must match the hash the file was saved with
+     * @param resultOut
+     * @return false (leaving the tree as it was) if the file is missing, corrupt, from another kind of machine
+     * or built from other inputs. Callers should then build the tree and save() it.
+     */
+    bool openMapped(const QString& filename, const QByteArray& inputHash, QString * resultOut = 0);
+
+    /**
+     * @brief isMapped returns true if the tree's points are still in a file mapped by openMapped()
+     */
+    bool isMapped() const;
+
+private:
+    int _findDuplicate(const qreal * position) const;
+
+    const qreal * _coordsData() const;
+    const qint32 * _leftData() const;
+    const qint32 * _rightData() const;
+    const qint32 * _divDimsData() const;
+    void _detach();
+    void _unmap();
+
+    int _dimension;
+    bool _allowDuplicates;
+    QKDTreeDistanceMetric * _distanceMetric;
+
+    //Point i's coordinates are _coords[i * _dimension] through _coords[i * _dimension + _dimension - 1]
+    QVector<qreal> _coords;
+    QVector<qint32> _left;
+    QVector<qint32> _right;
+    QVector<qint32> _divDims;
+
+    qint32 _root;
+    int _sizeAtLastRebuild;
+
+    //Set while the points are in a mapped file rather than the vectors above
+    QFile * _mappedFile;
+    uchar * _mapped;
+    int _mappedCount;
+    const qreal * _mappedCoords;
+    const qint32 * _mappedLeft;
+    const qint32 * _mappedRight;
+    const qint32 * _mappedDivDims;
+};
+
+#endif // QFLATKDTREE_H
@@ -2,15 +2,114 @@
 
 #include <QQueue>
 #include <QStack>
+#include <QSet>
+#include <QVector>
+#include <QVarLengthArray>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
 #include <QtDebug>
+#include <algorithm>
 #include <limits>
 
 
 const QString ERR_STRING_BAD_DIM = "Dimension of position does not match that of tree.";
 const QString ERR_STRING_BAD_OUTPTR = "You didn't provide a pointer for output.";
+const QString ERR_STRING_NOT_FOUND = "Key not found";
+
+//nearestBatch() doesn't bother with threads for fewer positions than this per thread
+const int MIN_BATCH_PER_THREAD = 256;
+
+//Orders nodes by their value in one dimension. Used to find medians when building balanced trees.
+class NodeDimensionLess
+{
+public:
+    NodeDimensionLess(int dim) : _dim(dim) {}
+    bool operator()(const QKDTreeNode * a, const QKDTreeNode * b) const
+    {
+        return a->position().val(_dim) < b->position().val(_dim);
+    }
+private:
+    int _dim;
+};
+
+//A slice of the node array that still needs to be built into a subtree below parent
+struct BuildRange
+{
+    int begin;
+    int end;
+    QKDTreeNode * parent;
+    bool isLeft;
+};
+
+//An entry on the explicit stack used by kNearest and withinRadius
+struct SearchEntry
+{
+    const QKDTreeNode * node;
+    //distance from the search position to the hyperplane that separates node from the side we came from
+    qreal planeDistance;
+};
+
+//A candidate result for kNearest. The bounded heap keeps the farthest candidate on top.
+struct NeighborCandidate
+{
+    const QKDTreeNode * node;
+    qreal distance;
+
+    bool operator<(const NeighborCandidate& other) const
+    {
+        return distance < other.distance;
+    }
+};
+
+//True for nodes whose value in one dimension is no more than a pivot
+class NodeDimensionAtMost
+{
+public:
+    NodeDimensionAtMost(int dim, qreal pivot) : _dim(dim), _pivot(pivot) {}
+    bool operator()(const QKDTreeNode * a) const
+    {
+        return a->position().val(_dim) <= _pivot;
+    }
+private:
+    int _dim;
+    qreal _pivot;
+};
+
+//Finds the nearest nodes for one slice of a nearestBatch()
+class NearestBatchJob : public QRunnable
+{
+public:
+    NearestBatchJob(const QKDTree * tree,
+                    const QVector<QVectorND> * positions,
+                    QVector<const QKDTreeNode *> * output,
+                    int begin,
+                    int end) :
+        _tree(tree), _positions(positions), _output(output), _begin(begin), _end(end)
+    {
+        this->setAutoDelete(false);
+    }
+
+    //virtual from QRunnable
+    virtual void run()
+    {
+        //Every job writes its own slice of the output, which was sized up front
+        const QKDTreeNode ** out = _output->data();
+        for (int i = _begin; i < _end; i++)
+            out[i] = _tree->_nearest(_positions->at(i), 0.0, 0);
+    }
+
+private:
+    const QKDTree * _tree;
+    const QVector<QVectorND> * _positions;
+    QVector<const QKDTreeNode *> * _output;
+    int _begin;
+    int _end;
+};
 
 QKDTree::QKDTree(int dimension, bool allowDuplicates, QKDTreeDistanceMetric *distanceMetric) :
-    _dimension(dimension), _size(0), _root(0), _allowDuplicates(allowDuplicates)
+    _dimension(dimension), _size(0), _root(0), _allowDuplicates(allowDuplicates),
+    _autoRebalance(false), _sizeAtLastRebuild(0), _removedCount(0)
 {
     //If they don't give us a distance metric, just use the default
     _distanceMetric = distanceMetric;
@@ -20,7 +119,7 @@ QKDTree::QKDTree(int dimension, bool allowDuplicates, QKDTreeDistanceMetric *dis
 
 QKDTree::~QKDTree()
 {
-    if (_size > 0)
+    if (_root != 0)
     {
         QQueue<QKDTreeNode *> deleteQueue;
         deleteQueue.enqueue(_root);
@@ -51,6 +150,13 @@ qint64 QKDTree::size() const
     return _size;
 }
 
+qint64 QKDTree::memoryBytes() const
+{
+    //Each node is a heap allocation with its position's coordinates in another
+    const qint64 nodeBytes = sizeof(QKDTreeNode) + _dimension * sizeof(qreal);
+    return (_size + _removedCount) * nodeBytes;
+}
+
 bool QKDTree::add(QKDTreeNode *node, QString *resultOut)
 {
     if (node == 0)
@@ -79,7 +185,8 @@ bool QKDTree::add(QKDTreeNode *node, QString *resultOut)
     while (true)
     {
         const int divDim = potentialParent->dividingDimension();
-        if (!_allowDuplicates && node->position() == potentialParent->position())
+        if (!_allowDuplicates && !potentialParent->isRemoved()
+                && node->position() == potentialParent->position())
         {
             if (resultOut)
                 *resultOut = "Cannot add duplicate";
@@ -110,6 +217,10 @@ bool QKDTree::add(QKDTreeNode *node, QString *resultOut)
     }
 
     _size++;
+
+    if (_autoRebalance && _size >= 2 * qMax<qint64>(_sizeAtLastRebuild, 8))
+        this->rebalance();
+
     return true;
 }
 
@@ -128,117 +239,190 @@ bool QKDTree::add(const QPointF &position, const QVariant &value, QString *resul
 }
 
 
-bool QKDTree::nearestNode(const QVectorND &searchPos, QKDTreeNode *output, QString *resultOut)
+bool QKDTree::addBatch(const QList<QKDTreeNode *> &nodes, QString *resultOut)
 {
-    if (output == 0)
+    QSet<QVectorND> batchKeys;
+    foreach(QKDTreeNode * node, nodes)
+    {
+        if (node == 0)
+        {
+            if (resultOut)
+                *resultOut = "Cannot add null node";
+            return false;
+        }
+        else if (node->position().dimension() != this->dimension())
+        {
+            if (resultOut)
+                *resultOut = ERR_STRING_BAD_DIM;
+            return false;
+        }
+        else if (!_allowDuplicates)
+        {
+            if (batchKeys.contains(node->position()) || this->containsKey(node->position()))
+            {
+                if (resultOut)
+                    *resultOut = "Cannot add duplicate";
+                return false;
+            }
+            batchKeys.insert(node->position());
+        }
+    }
+
+    QVector<QKDTreeNode *> allNodes;
+    QVector<QKDTreeNode *> removed;
+    allNodes.reserve(_size + nodes.size());
+    _collectNodes(&allNodes, &removed);
+    foreach(QKDTreeNode * node, nodes)
+        allNodes.append(node);
+
+    _rebuild(allNodes);
+    qDeleteAll(removed);
+    return true;
+}
+
+bool QKDTree::remove(const QVectorND &position, QString *resultOut)
+{
+    if (position.dimension() != this->dimension())
     {
         if (resultOut)
-            *resultOut = ERR_STRING_BAD_OUTPTR;
+            *resultOut = ERR_STRING_BAD_DIM;
         return false;
     }
-    else if (searchPos.dimension() != this->dimension())
+
+    QKDTreeNode * node = this->_findNode(position);
+    if (node == 0)
     {
         if (resultOut)
-            *resultOut = ERR_STRING_BAD_DIM;
+            *resultOut = ERR_STRING_NOT_FOUND;
         return false;
     }
-    else if (_size <= 0)
+
+    node->setRemoved(true);
+    _size--;
+    _removedCount++;
+
+    if (_removedCount > _size)
+        this->rebalance();
+    return true;
+}
+
+bool QKDTree::move(const QVectorND &from, const QVectorND &to, QString *resultOut)
+{
+    if (from.dimension() != this->dimension() || to.dimension() != this->dimension())
     {
         if (resultOut)
-            *resultOut = "Tree is empty";
+            *resultOut = ERR_STRING_BAD_DIM;
         return false;
     }
 
-    QQueue<QKDTreeNode *> descend;
-    QStack<QKDTreeNode *> unwindChecks;
+    QVector<QKDTreeNode *> path;
+    QKDTreeNode * node = this->_findNode(from, &path);
+    if (node == 0)
+    {
+        if (resultOut)
+            *resultOut = ERR_STRING_NOT_FOUND;
+        return false;
+    }
+    else if (to == from)
+        return true;
+    else if (!_allowDuplicates && this->containsKey(to))
+    {
+        if (resultOut)
+            *resultOut = "Cannot add duplicate";
+        return false;
+    }
 
-    descend.enqueue(_root);
+    //The node can stay where it is if searches for the new key would still reach it...
+    bool inPlace = true;
+    for (int i = 0; i < path.size() && inPlace; i++)
+    {
+        const QKDTreeNode * ancestor = path[i];
+        const QKDTreeNode * child = (i + 1 < path.size()) ? path[i + 1] : node;
+        const int divDim = ancestor->dividingDimension();
+        const bool wentLeft = (ancestor->left() == child);
+        inPlace = (wentLeft == (to.val(divDim) <= ancestor->position().val(divDim)));
+    }
 
-    QKDTreeNode * bestSoFar = 0;
-    qreal bestDistSoFar = std::numeric_limits<qreal>::max();
+    //...and if it doesn't move its own split out from between its children
+    const int divDim = node->dividingDimension();
+    if (node->left() != 0 || node->right() != 0)
+        inPlace = inPlace && to.val(divDim) == from.val(divDim);
 
-    while (!descend.isEmpty() || !unwindChecks.isEmpty())
+    if (inPlace)
     {
-        if (!descend.isEmpty())
-        {
-            QKDTreeNode * current = descend.dequeue();
-            unwindChecks.push(current);
+        node->setPosition(to);
+        return true;
+    }
 
-            const int divDim = current->dividingDimension();
-            if (searchPos.val(divDim) <= current->position().val(divDim))
-            {
-                if (current->left() != 0)
-                    descend.enqueue(current->left());
-                else
-                {
-                    const qreal dist = _distanceMetric->distance(current->position(), searchPos);
-                    if (dist < bestDistSoFar)
-                    {
-                        bestSoFar = current;
-                        bestDistSoFar = dist;
-                    }
-                }
-            }
-            else
-            {
-                if (current->right() != 0)
-                    descend.enqueue(current->right());
-                else
-                {
-                    const qreal dist = _distanceMetric->distance(current->position(), searchPos);
-                    if (dist < bestDistSoFar)
-                    {
-                        bestSoFar = current;
-                        bestDistSoFar = dist;
-                    }
-                }
-            }
-        }
-        else
-        {
-            //In this branch we "unwind" up the tree, checking those nodes for nearer-ness
-            QKDTreeNode * current = unwindChecks.pop();
-            const int divDim = current->dividingDimension();
-            const qreal dist = _distanceMetric->distance(current->position(), searchPos);
-            if (dist < bestDistSoFar)
-            {
-                bestSoFar = current;
-                bestDistSoFar = dist;
-            }
+    const QVariant value = node->value();
+    node->setRemoved(true);
+    _size--;
+    _removedCount++;
+    this->add(new QKDTreeNode(to, value));
 
-            //Do we need to check other side of hyperplane?
-            QVectorND temp = current->position();
-            temp[divDim] = searchPos.val(divDim);
-            const qreal hyperplaneDistance = this->distanceMetric()->distance(temp, current->position());
-            if (hyperplaneDistance > bestDistSoFar)
-                continue;
+    if (_removedCount > _size)
+        this->rebalance();
+    return true;
+}
 
-            //Search the other side of the dividing node
-            if (searchPos.val(divDim) <= current->position().val(divDim)
-                    && current->right() != 0)
-                descend.enqueue(current->right());
-            else if (current->left() != 0)
-                descend.enqueue(current->left());
+void QKDTree::rebalance()
+{
+    QVector<QKDTreeNode *> allNodes;
+    QVector<QKDTreeNode *> removed;
+    allNodes.reserve(_size);
+    _collectNodes(&allNodes, &removed);
+    _rebuild(allNodes);
+    qDeleteAll(removed);
+}
 
-        }
+bool QKDTree::autoRebalance() const
+{
+    return _autoRebalance;
+}
+
+void QKDTree::setAutoRebalance(bool enabled)
+{
+    _autoRebalance = enabled;
+}
+
+bool QKDTree::nearestNode(const QVectorND &searchPos, QKDTreeNode *output, QString *resultOut,
+                          qreal epsilon, int maxVisits) const
+{
+    if (output == 0)
+    {
+        if (resultOut)
+            *resultOut = ERR_STRING_BAD_OUTPTR;
+        return false;
+    }
+    else if (searchPos.dimension() != this->dimension())
+    {
+        if (resultOut)
+            *resultOut = ERR_STRING_BAD_DIM;
+        return false;
+    }
+    else if (_size <= 0)
+    {
+        if (resultOut)
+            *resultOut = "Tree is empty";
+        return false;
     }
 
-    *output = *bestSoFar;
+    *output = *this->_nearest(searchPos, epsilon, maxVisits);
 
     return true;
 }
 
-bool QKDTree::nearestNode(const QPointF &position, QKDTreeNode *output, QString *resultOut)
+bool QKDTree::nearestNode(const QPointF &position, QKDTreeNode *output, QString *resultOut) const
 {
     return this->nearestNode(QVectorND(position), output, resultOut);
 }
 
-bool QKDTree::nearestNode(QKDTreeNode *node, QKDTreeNode *output, QString *resultOut)
+bool QKDTree::nearestNode(QKDTreeNode *node, QKDTreeNode *output, QString *resultOut) const
 {
     return this->nearestNode(node->position(), output, resultOut);
 }
 
-bool QKDTree::nearestKey(const QVectorND &position, QVectorND *output, QString *resultOut)
+bool QKDTree::nearestKey(const QVectorND &position, QVectorND *output, QString *resultOut) const
 {
     if (output == 0)
     {
@@ -256,30 +440,226 @@ bool QKDTree::nearestKey(const QVectorND &position, QVectorND *output, QString *
     return true;
 }
 
-bool QKDTree::containsKey(const QVectorND &position)
+bool QKDTree::nearestBatch(const QVector<QVectorND> &positions,
+                           QVector<const QKDTreeNode *> *output,
+                           QString *resultOut,
+                           int threads) const
 {
-    if (position.dimension() != this->dimension())
+    if (output == 0)
+    {
+        if (resultOut)
+            *resultOut = ERR_STRING_BAD_OUTPTR;
         return false;
-    else if (_size <= 0)
+    }
+
+    foreach(const QVectorND& position, positions)
+    {
+        if (position.dimension() != this->dimension())
+        {
+            if (resultOut)
+                *resultOut = ERR_STRING_BAD_DIM;
+            return false;
+        }
+    }
+
+    output->resize(positions.size());
+    if (positions.isEmpty())
+        return true;
+
+    if (threads <= 0)
+        threads = QThread::idealThreadCount();
+    threads = qMax<int>(1, qMin<int>(threads, positions.size() / MIN_BATCH_PER_THREAD));
+
+    QList<NearestBatchJob *> jobs;
+    for (int t = 0; t < threads; t++)
+    {
+        const int begin = (qint64)positions.size() * t / threads;
+        const int end = (qint64)positions.size() * (t + 1) / threads;
+        jobs.append(new NearestBatchJob(this, &positions, output, begin, end));
+    }
+
+    if (jobs.size() == 1)
+        jobs.first()->run();
+    else
+    {
+        QThreadPool pool;
+        pool.setMaxThreadCount(jobs.size());
+        foreach(NearestBatchJob * job, jobs)
+            pool.start(job);
+        pool.waitForDone();
+    }
+    qDeleteAll(jobs);
+
+    return true;
+}
+
+bool QKDTree::kNearest(const QVectorND &position,
+                       int k,
+                       QVector<const QKDTreeNode *> *output,
+                       QString *resultOut) const
+{
+    if (output == 0)
+    {
+        if (resultOut)
+            *resultOut = ERR_STRING_BAD_OUTPTR;
+        return false;
+    }
+    else if (position.dimension() != this->dimension())
+    {
+        if (resultOut)
+            *resultOut = ERR_STRING_BAD_DIM;
         return false;
+    }
 
-    QKDTreeNode * current = _root;
+    output->resize(0);
+    if (_root == 0 || k <= 0)
+        return true;
 
-    while (current != 0)
+    QVarLengthArray<NeighborCandidate, 32> heap;
+    QVarLengthArray<SearchEntry, 64> stack;
+
+    //Scratch copy of the search position used to measure distances to hyperplanes
+    QVectorND planePoint = position;
+
+    SearchEntry rootEntry = {_root, 0.0};
+    stack.append(rootEntry);
+
+    while (!stack.isEmpty())
     {
-        if (current->position() == position)
-            return true;
+        const SearchEntry entry = stack.last();
+        stack.removeLast();
+
+        //Can anything on this side of the hyperplane beat what we already have?
+        if (heap.size() == k && entry.planeDistance > heap[0].distance)
+            continue;
+
+        const QKDTreeNode * current = entry.node;
+        if (!current->isRemoved())
+        {
+            const qreal dist = _distanceMetric->distance(current->position(), position);
+            if (heap.size() < k)
+            {
+                NeighborCandidate candidate = {current, dist};
+                heap.append(candidate);
+                std::push_heap(heap.data(), heap.data() + heap.size());
+            }
+            else if (dist < heap[0].distance)
+            {
+                std::pop_heap(heap.data(), heap.data() + heap.size());
+                heap[heap.size() - 1].node = current;
+                heap[heap.size() - 1].distance = dist;
+                std::push_heap(heap.data(), heap.data() + heap.size());
+            }
+        }
 
         const int divDim = current->dividingDimension();
-        if (position.val(divDim) <= current->position().val(divDim))
-            current = current->left();
-        else
-            current = current->right();
+        const qreal divVal = current->position().val(divDim);
+        planePoint[divDim] = divVal;
+        const qreal planeDistance = _distanceMetric->distance(planePoint, position);
+        planePoint[divDim] = position.val(divDim);
+
+        QKDTreeNode * nearSide = current->left();
+        QKDTreeNode * farSide = current->right();
+        if (position.val(divDim) > divVal)
+            qSwap(nearSide, farSide);
+
+        //Push the far side first so that the near side gets searched first
+        if (farSide != 0)
+        {
+            SearchEntry farEntry = {farSide, planeDistance};
+            stack.append(farEntry);
+        }
+        if (nearSide != 0)
+        {
+            SearchEntry nearEntry = {nearSide, entry.planeDistance};
+            stack.append(nearEntry);
+        }
     }
-    return false;
+
+    std::sort(heap.data(), heap.data() + heap.size());
+    for (int i = 0; i < heap.size(); i++)
+        output->append(heap[i].node);
+
+    return true;
 }
 
-bool QKDTree::containsKey(QKDTreeNode *node)
+bool QKDTree::withinRadius(const QVectorND &position,
+                           qreal radius,
+                           QVector<const QKDTreeNode *> *output,
+                           QString *resultOut) const
+{
+    if (output == 0)
+    {
+        if (resultOut)
+            *resultOut = ERR_STRING_BAD_OUTPTR;
+        return false;
+    }
+    else if (position.dimension() != this->dimension())
+    {
+        if (resultOut)
+            *resultOut = ERR_STRING_BAD_DIM;
+        return false;
+    }
+
+    output->resize(0);
+    if (_root == 0)
+        return true;
+
+    QVarLengthArray<SearchEntry, 64> stack;
+    QVectorND planePoint = position;
+
+    SearchEntry rootEntry = {_root, 0.0};
+    stack.append(rootEntry);
+
+    while (!stack.isEmpty())
+    {
+        const SearchEntry entry = stack.last();
+        stack.removeLast();
+
+        if (entry.planeDistance > radius)
+            continue;
+
+        const QKDTreeNode * current = entry.node;
+        if (!current->isRemoved() && _distanceMetric->distance(current->position(), position) <= radius)
+            output->append(current);
+
+        const int divDim = current->dividingDimension();
+        const qreal divVal = current->position().val(divDim);
+        planePoint[divDim] = divVal;
+        const qreal planeDistance = _distanceMetric->distance(planePoint, position);
+        planePoint[divDim] = position.val(divDim);
+
+        QKDTreeNode * nearSide = current->left();
+        QKDTreeNode * farSide = current->right();
+        if (position.val(divDim) > divVal)
+            qSwap(nearSide, farSide);
+
+        if (farSide != 0)
+        {
+            SearchEntry farEntry = {farSide, planeDistance};
+            stack.append(farEntry);
+        }
+        if (nearSide != 0)
+        {
+            SearchEntry nearEntry = {nearSide, entry.planeDistance};
+            stack.append(nearEntry);
+        }
+    }
+
+    return true;
+}
+
+bool QKDTree::containsKey(const QVectorND &position) const
+{
+    if (position.dimension() != this->dimension())
+        return false;
+    else if (_size <= 0)
+        return false;
+
+    return this->_findNode(position) != 0;
+}
+
+bool QKDTree::containsKey(QKDTreeNode *node) const
 {
     if (node == 0)
         return false;
@@ -287,10 +667,8 @@ bool QKDTree::containsKey(QKDTreeNode *node)
     return this->containsKey(node->position());
 }
 
-bool QKDTree::value(const QVectorND &positionKey, QVariant *output, QString *resultOut)
+bool QKDTree::value(const QVectorND &positionKey, QVariant *output, QString *resultOut) const
 {
-    const QString errStringNotFound = "Key not found";
-
     if (output == 0)
     {
         if (resultOut)
@@ -300,7 +678,7 @@ bool QKDTree::value(const QVectorND &positionKey, QVariant *output, QString *res
     else if (this->size() <= 0)
     {
         if (resultOut)
-            *resultOut = errStringNotFound;
+            *resultOut = ERR_STRING_NOT_FOUND;
         return false;
     }
     else if (positionKey.dimension() != this->dimension())
@@ -310,35 +688,219 @@ bool QKDTree::value(const QVectorND &positionKey, QVariant *output, QString *res
         return false;
     }
 
+    const QKDTreeNode * node = this->_findNode(positionKey);
+    if (node != 0)
+    {
+        *output = node->value();
+        return true;
+    }
+
+    if (resultOut)
+        *resultOut = ERR_STRING_NOT_FOUND;
+    return false;
+}
+
+bool QKDTree::value(const QPointF &positionKey, QVariant *output, QString *resultOut) const
+{
+    return this->value(QVectorND(positionKey), output, resultOut);
+}
+
+QKDTreeDistanceMetric *QKDTree::distanceMetric() const
+{
+    return _distanceMetric;
+}
+
+//private
+QKDTreeNode *QKDTree::_findNode(const QVectorND &position, QVector<QKDTreeNode *> *pathOut) const
+{
     QKDTreeNode * current = _root;
     while (current != 0)
     {
-        const int divDim = current->dividingDimension();
+        //Keep going past removed nodes since duplicates (which go left) may still be alive below them
+        if (!current->isRemoved() && current->position() == position)
+            return current;
 
-        if (current->position() == positionKey)
-        {
-            *output = current->value();
-            return true;
-        }
-        else if (positionKey.val(divDim) <= current->position().val(divDim))
+        if (pathOut)
+            pathOut->append(current);
+
+        const int divDim = current->dividingDimension();
+        if (position.val(divDim) <= current->position().val(divDim))
             current = current->left();
         else
             current = current->right();
     }
+    return 0;
+}
 
-    if (resultOut)
-        *resultOut = errStringNotFound;
-    return false;
+//private
+const QKDTreeNode *QKDTree::_nearest(const QVectorND &position, qreal epsilon, int maxVisits) const
+{
+    if (_root == 0)
+        return 0;
+
+    //Same walk as kNearest() with k = 1. Everything is on the stack but planePoint, so calls don't interfere.
+    QVarLengthArray<SearchEntry, 64> stack;
+    QVectorND planePoint = position;
+
+    SearchEntry rootEntry = {_root, 0.0};
+    stack.append(rootEntry);
+
+    const QKDTreeNode * best = 0;
+    qreal bestDist = std::numeric_limits<qreal>::max();
+
+    //The far side of a hyperplane is only searched if it could beat this
+    const qreal shrink = 1.0 / (1.0 + qMax<qreal>(0.0, epsilon));
+    qreal pruneDist = bestDist;
+    int visits = 0;
+
+    while (!stack.isEmpty())
+    {
+        const SearchEntry entry = stack.last();
+        stack.removeLast();
+
+        if (entry.planeDistance > pruneDist)
+            continue;
+
+        const QKDTreeNode * current = entry.node;
+        if (!current->isRemoved())
+        {
+            const qreal dist = _distanceMetric->distance(current->position(), position);
+            if (dist < bestDist)
+            {
+                best = current;
+                bestDist = dist;
+                pruneDist = bestDist * shrink;
+            }
+            if (maxVisits > 0 && ++visits >= maxVisits)
+                break;
+        }
+
+        const int divDim = current->dividingDimension();
+        const qreal divVal = current->position().val(divDim);
+        planePoint[divDim] = divVal;
+        const qreal planeDistance = _distanceMetric->distance(planePoint, position);
+        planePoint[divDim] = position.val(divDim);
+
+        QKDTreeNode * nearSide = current->left();
+        QKDTreeNode * farSide = current->right();
+        if (position.val(divDim) > divVal)
+            qSwap(nearSide, farSide);
+
+        if (farSide != 0 && planeDistance <= pruneDist)
+        {
+            SearchEntry farEntry = {farSide, planeDistance};
+            stack.append(farEntry);
+        }
+        if (nearSide != 0)
+        {
+            SearchEntry nearEntry = {nearSide, entry.planeDistance};
+            stack.append(nearEntry);
+        }
+    }
+
+    return best;
 }
 
-bool QKDTree::value(const QPointF &positionKey, QVariant *output, QString *resultOut)
+//private
+void QKDTree::_rebuild(QVector<QKDTreeNode *> &nodes)
 {
-    return this->value(QVectorND(positionKey), output, resultOut);
+    _root = 0;
+    _size = nodes.size();
+    _sizeAtLastRebuild = _size;
+    _removedCount = 0;
+
+    if (nodes.isEmpty())
+        return;
+
+    QStack<BuildRange> todo;
+    BuildRange all = {0, nodes.size(), 0, false};
+    todo.push(all);
+
+    while (!todo.isEmpty())
+    {
+        const BuildRange range = todo.pop();
+        QVector<QKDTreeNode *>::iterator begin = nodes.begin() + range.begin;
+        QVector<QKDTreeNode *>::iterator end = nodes.begin() + range.end;
+
+        //Split along the dimension with the largest spread
+        int divDim = 0;
+        qreal bestSpread = -1.0;
+        for (int dim = 0; dim < _dimension; dim++)
+        {
+            qreal minVal = std::numeric_limits<qreal>::max();
+            qreal maxVal = -std::numeric_limits<qreal>::max();
+            for (QVector<QKDTreeNode *>::iterator iter = begin; iter != end; iter++)
+            {
+                const qreal val = (*iter)->position().val(dim);
+                minVal = qMin<qreal>(minVal, val);
+                maxVal = qMax<qreal>(maxVal, val);
+            }
+            if (maxVal - minVal > bestSpread)
+            {
+                bestSpread = maxVal - minVal;
+                divDim = dim;
+            }
+        }
+
+        QVector<QKDTreeNode *>::iterator median = begin + (range.end - range.begin) / 2;
+        std::nth_element(begin, median, end, NodeDimensionLess(divDim));
+
+        /*
+         * Searches go left on <= so everything equal to the median has to be on the left. Gather the
+         * equal ones just after the median and make the last of them the dividing node.
+        */
+        const qreal pivot = (*median)->position().val(divDim);
+        QVector<QKDTreeNode *>::iterator lastEqual = std::partition(median + 1, end,
+                                                                    NodeDimensionAtMost(divDim, pivot)) - 1;
+        std::iter_swap(median, lastEqual);
+        median = lastEqual;
+
+        QKDTreeNode * node = *median;
+        node->setLeft(0);
+        node->setRight(0);
+        node->setDividingDimension(divDim);
+
+        if (range.parent == 0)
+            _root = node;
+        else if (range.isLeft)
+            range.parent->setLeft(node);
+        else
+            range.parent->setRight(node);
+
+        const int medianIndex = median - nodes.begin();
+        if (range.begin < medianIndex)
+        {
+            BuildRange left = {range.begin, medianIndex, node, true};
+            todo.push(left);
+        }
+        if (medianIndex + 1 < range.end)
+        {
+            BuildRange right = {medianIndex + 1, range.end, node, false};
+            todo.push(right);
+        }
+    }
 }
 
-QKDTreeDistanceMetric *QKDTree::distanceMetric() const
+//private
+void QKDTree::_collectNodes(QVector<QKDTreeNode *> *output, QVector<QKDTreeNode *> *removedOut) const
 {
-    return _distanceMetric;
+    if (_root == 0)
+        return;
+
+    QStack<QKDTreeNode *> stack;
+    stack.push(_root);
+    while (!stack.isEmpty())
+    {
+        QKDTreeNode * current = stack.pop();
+        if (current->isRemoved())
+            removedOut->append(current);
+        else
+            output->append(current);
+        if (current->left())
+            stack.push(current->left());
+        if (current->right())
+            stack.push(current->right());
+    }
 }
 
 void QKDTree::debugPrint()
@@ -352,7 +914,8 @@ void QKDTree::debugPrint()
     while (!q.isEmpty())
     {
         QKDTreeNode * n = q.dequeue();
-        qDebug() << n->position() << n->value();
+        if (!n->isRemoved())
+            qDebug() << n->position() << n->value();
 
         if (n->left())
             q.enqueue(n->left());
@@ -3,10 +3,19 @@
 
 #include "QKDTree_global.h"
 
+#include <QList>
+#include <QVector>
+
 #include "QKDTreeNode.h"
 #include "QKDTreeDistanceMetric.h"
 #include "QVectorND.h"
 
+/**
+ * @brief The QKDTree class is a kd-tree of QKDTreeNodes, each a QVectorND key with a QVariant value.
+ *
+ * The const members (every query) may be called from many threads at once as long as nothing modifies the
+ * tree meanwhile and the distance metric is safe to call concurrently, which the default one is.
+ */
 class QKDTREESHARED_EXPORT QKDTree
 {
 public:
@@ -33,18 +42,131 @@ public:
      */
     qint64 size() const;
 
+    /**
+     * @brief memoryBytes estimates the bytes the tree's nodes take, removed ones still in the tree included.
+     * Whatever the values point to isn't counted.
+     * @return
+     */
+    qint64 memoryBytes() const;
+
     bool add(QKDTreeNode * node, QString * resultOut = 0);
     bool add(const QVectorND& position, const QVariant& value, QString * resultOut = 0);
     bool add(const QPointF& position, const QVariant& value, QString * resultOut = 0);
 
-    bool nearestNode(const QVectorND& position, QKDTreeNode * output, QString * resultOut = 0);
-    bool nearestNode(const QPointF& position, QKDTreeNode * output, QString * resultOut = 0);
-    bool nearestNode(QKDTreeNode * node, QKDTreeNode * output, QString * resultOut = 0);
+    /**
+     * @brief addBatch adds many nodes at once and rebuilds the whole tree so that it is balanced.
+     * This is much better than calling add() in a loop when the nodes are sorted or clustered.
+     * If duplicates aren't allowed and any of the nodes duplicates another (or an existing key) nothing is
+     * added and the caller keeps ownership of the nodes.
+     * @param nodes
+     * @param resultOut
+     * @return
+     */
+    bool addBatch(const QList<QKDTreeNode *>& nodes, QString * resultOut = 0);
+
+    /**
+     * @brief remove removes a node with the given key (any one of them, if duplicates are allowed).
+     * The node is only marked as removed and is skipped by searches. Once removed nodes outnumber the rest
+     * the tree is rebuilt without them, so searches never wade through more dead nodes than live ones.
+     * @param position
+     * @param resultOut
+     * @return false if there's no node with that key
+     */
+    bool remove(const QVectorND& position, QString * resultOut = 0);
+
+    /**
+     * @brief move changes the key of a node, keeping its value. If the new key still falls on the same side
+     * of every split above the node (and the node's own split doesn't change) the node is updated in place.
+     * Otherwise it's removed as with remove() and added again at the new key.
+     * @param from the node's current key
+     * @param to
+     * @param resultOut
+     * @return false if there's no node at from, or if duplicates aren't allowed and another node is at to
+     */
+    bool move(const QVectorND& from, const QVectorND& to, QString * resultOut = 0);
+
+    /**
+     * @brief rebalance rebuilds the tree by median partitioning so that nearest-neighbor searches stay
+     * logarithmic. Takes O(n log n).
+     */
+    void rebalance();
+
+    /**
+     * @brief autoRebalance returns true if the tree rebalances itself as it grows through add().
+     * The tree is rebuilt every time its size doubles since the last rebuild, so the amortized
+     * cost per add() stays O(log n). Defaults to false.
+     * @return
+     */
+    bool autoRebalance() const;
+    void setAutoRebalance(bool enabled);
+
+    /**
+     * @brief nearestNode finds the node nearest to position. Like QFlatKDTree::nearest(), epsilon and
+     * maxVisits trade exactness for speed: the node found is within (1 + epsilon) times the nearest distance
+     * as measured by distanceMetric(), and the search gives up after measuring to maxVisits nodes (0 for no
+     * limit) and returns the best it has found.
+     * @param position
+     * @param output
+     * @param resultOut
+     * @param epsilon
+     * @param maxVisits
+     * @return
+     */
+    bool nearestNode(const QVectorND& position, QKDTreeNode * output, QString * resultOut = 0,
+                     qreal epsilon = 0.0, int maxVisits = 0) const;
+    bool nearestNode(const QPointF& position, QKDTreeNode * output, QString * resultOut = 0) const;
+    bool nearestNode(QKDTreeNode * node, QKDTreeNode * output, QString * resultOut = 0) const;
 
-    bool nearestKey(const QVectorND& position, QVectorND * output, QString * resultOut = 0);
+    bool nearestKey(const QVectorND& position, QVectorND * output, QString * resultOut = 0) const;
 
-    bool containsKey(const QVectorND& position);
-    bool containsKey(QKDTreeNode * node);
+    /**
+     * @brief nearestBatch finds the node nearest to each of many positions, splitting them across threads.
+     * Meant for bulk work like associating many points with bins or joining up a roadmap.
+     * Buffer and pointer rules are the same as kNearest().
+     * @param positions
+     * @param output receives the node nearest to positions[i] at index i, or null if the tree is empty
+     * @param resultOut
+     * @param threads how many threads to use. 0 for QThread::idealThreadCount().
+     * @return false if any position has the wrong dimension
+     */
+    bool nearestBatch(const QVector<QVectorND>& positions,
+                      QVector<const QKDTreeNode *> * output,
+                      QString * resultOut = 0,
+                      int threads = 0) const;
+
+    /**
+     * @brief kNearest finds the (up to) k nodes nearest to position, nearest first.
+     * The output buffer is emptied first but keeps its capacity, so reusing one buffer across queries
+     * doesn't allocate. The pointers belong to the tree and are invalidated by add(), addBatch(), remove(),
+     * move() or rebalance().
+     * @param position
+     * @param k
+     * @param output
+     * @param resultOut
+     * @return
+     */
+    bool kNearest(const QVectorND& position,
+                  int k,
+                  QVector<const QKDTreeNode *> * output,
+                  QString * resultOut = 0) const;
+
+    /**
+     * @brief withinRadius finds every node whose distance from position is no more than radius.
+     * Distances are measured with distanceMetric(), so with the default metric radius is a *squared*
+     * distance. Results are in no particular order. Buffer and pointer rules are the same as kNearest().
+     * @param position
+     * @param radius
+     * @param output
+     * @param resultOut
+     * @return
+     */
+    bool withinRadius(const QVectorND& position,
+                      qreal radius,
+                      QVector<const QKDTreeNode *> * output,
+                      QString * resultOut = 0) const;
+
+    bool containsKey(const QVectorND& position) const;
+    bool containsKey(QKDTreeNode * node) const;
 
     /**
      * @brief value returns the value of the first node found with the given key
@@ -53,8 +175,8 @@ public:
      * @param resultOut
      * @return
      */
-    bool value(const QVectorND& positionKey, QVariant * output, QString * resultOut = 0);
-    bool value(const QPointF& positionKey, QVariant * output, QString * resultOut = 0);
+    bool value(const QVectorND& positionKey, QVariant * output, QString * resultOut = 0) const;
+    bool value(const QPointF& positionKey, QVariant * output, QString * resultOut = 0) const;
 
     QKDTreeDistanceMetric * distanceMetric() const;
 
@@ -69,8 +191,21 @@ private:
 
     QKDTreeNode * _root;
 
+    void _rebuild(QVector<QKDTreeNode *>& nodes);
+    void _collectNodes(QVector<QKDTreeNode *> * output, QVector<QKDTreeNode *> * removedOut) const;
+    QKDTreeNode * _findNode(const QVectorND& position, QVector<QKDTreeNode *> * pathOut = 0) const;
+    const QKDTreeNode * _nearest(const QVectorND& position, qreal epsilon, int maxVisits) const;
+
     bool _allowDuplicates;
     QKDTreeDistanceMetric * _distanceMetric;
+
+    bool _autoRebalance;
+    qint64 _sizeAtLastRebuild;
+
+    //Nodes that have been removed but are still linked into the tree
+    qint64 _removedCount;
+
+    friend class NearestBatchJob;
 };
 
 #endif // QKDTREE_H
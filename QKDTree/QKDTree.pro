@@ -13,12 +13,15 @@ DEFINES += QKDTREE_LIBRARY
 
 SOURCES += QKDTree.cpp \
     QKDTreeNode.cpp \
-    QKDTreeDistanceMetric.cpp
+    QKDTreeDistanceMetric.cpp \
+    QFlatKDTree.cpp
 
 HEADERS += QKDTree.h\
         QKDTree_global.h \
     QKDTreeNode.h \
-    QKDTreeDistanceMetric.h
+    QKDTreeDistanceMetric.h \
+    QFlatKDTree.h \
+    QKDTreeT.h
 
 unix:!symbian {
     maemo5 {
@@ -17,6 +17,19 @@ qreal QKDTreeDistanceMetric::distance(const QKDTreeNode *const a, const QKDTreeN
     return this->distance(a->position(), b->position());
 }
 
+//virtual
+qreal QKDTreeDistanceMetric::distance(const qreal *a, const qreal *b, int dimension)
+{
+    QVectorND aVec(dimension);
+    QVectorND bVec(dimension);
+    for (int i = 0; i < dimension; i++)
+    {
+        aVec[i] = a[i];
+        bVec[i] = b[i];
+    }
+    return this->distance(aVec, bVec);
+}
+
 //virtual - this one returns euclidean distance
 qreal QKDTreeDistanceMetric::distance(const QVectorND &a, const QVectorND &b)
 {
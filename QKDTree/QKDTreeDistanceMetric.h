@@ -26,6 +26,17 @@ public:
      * @return
      */
     virtual qreal distance(const QVectorND& a, const QVectorND& b);
+
+    /**
+     * @brief distance is used by QFlatKDTree, which stores raw coordinates. The default implementation
+     * wraps them in QVectorNDs and calls the QVectorND version, so custom metrics work unchanged.
+     * Override it too if your metric is used in a hot loop.
+     * @param a
+     * @param b
+     * @param dimension
+     * @return
+     */
+    virtual qreal distance(const qreal * a, const qreal * b, int dimension);
 };
 
 #endif // QKDTREEDISTANCEMETRIC_H
@@ -3,7 +3,7 @@
 #include <QtDebug>
 
 QKDTreeNode::QKDTreeNode(const QVectorND &position, const QVariant &value) :
-    _position(position), _value(value), _left(0), _right(0), _dividingDimension(0)
+    _position(position), _value(value), _left(0), _right(0), _dividingDimension(0), _removed(false)
 {
 }
 
@@ -61,3 +61,21 @@ void QKDTreeNode::setDividingDimension(int nDiv)
 {
     _dividingDimension = nDiv;
 }
+
+//private
+void QKDTreeNode::setPosition(const QVectorND &nPos)
+{
+    _position = nPos;
+}
+
+//private
+bool QKDTreeNode::isRemoved() const
+{
+    return _removed;
+}
+
+//private
+void QKDTreeNode::setRemoved(bool nRemoved)
+{
+    _removed = nRemoved;
+}
@@ -8,6 +8,11 @@
 //forward definition so that we can make QKDTree a "friend" class of QKDTreeNode
 class QKDTree;
 
+/**
+ * @brief The QKDTreeNode class is a QKDTree key/value pair. Values are QVariants so that one tree type can hold
+ * anything. Code that only needs to attach an index or other plain value to each point should use QKDTreeT,
+ * whose payload type is a template parameter and which stores payloads inline rather than in a node object.
+ */
 class QKDTREESHARED_EXPORT QKDTreeNode
 {
 public:
@@ -28,6 +33,12 @@ private:
     int dividingDimension() const;
     void setDividingDimension(int nDiv);
 
+    void setPosition(const QVectorND& nPos);
+
+    //Removed nodes stay in place as tombstones until the tree is rebuilt
+    bool isRemoved() const;
+    void setRemoved(bool nRemoved);
+
 private:
     QVectorND _position;
     QVariant _value;
@@ -35,6 +46,7 @@ private:
     QKDTreeNode * _left;
     QKDTreeNode * _right;
     int _dividingDimension;
+    bool _removed;
 
     friend class QKDTree;
 };
@@ -0,0 +1,512 @@
+#ifndef QKDTREET_H
+#define QKDTREET_H
+
+#include <QtGlobal>
+#include <QVector>
+#include <QVarLengthArray>
+#include <algorithm>
+#include <limits>
+
+/**
+ * @brief The QKDTreeSquaredEuclidean class is the default metric for QKDTreeT: squared euclidean distance.
+ *
+ * A metric for QKDTreeT provides two inline functions. distance(a, b) measures between two Dim-dimensional
+ * positions. axisLowerBound(axis, delta) returns no more than the distance from a query to any position whose
+ * coordinate on axis differs from the query's by delta. The search skips a subtree when that bound is already
+ * worse than what it has found, so a bound that's too high makes searches miss points, and one that's too low
+ * only makes them slower.
+ */
+template <int Dim>
+class QKDTreeSquaredEuclidean
+{
+public:
+    qreal distance(const qreal * a, const qreal * b) const
+    {
+        qreal toRet = 0.0;
+        for (int d = 0; d < Dim; d++)
+        {
+            const qreal diff = a[d] - b[d];
+            toRet += diff * diff;
+        }
+        return toRet;
+    }
+
+    qreal axisLowerBound(int axis, qreal delta) const
+    {
+        Q_UNUSED(axis)
+        return delta * delta;
+    }
+};
+
+/**
+ * @brief The QKDTreeT class is QFlatKDTree with the dimension, metric and per-point payload fixed at compile
+ * time. The metric's functions are called directly (and so can be inlined) rather than through a virtual
+ * QKDTreeDistanceMetric, and a subtree is ruled out with the metric's axisLowerBound() instead of measuring to
+ * a point on the splitting plane, so the search loop makes no calls it can't inline and builds nothing.
+ *
+ * Like QFlatKDTree, points live in contiguous buffers, are identified by the index add() returns, keep that
+ * index when the tree rebalances, and queries walk the tree with a fixed-size stack.
+ */
+template <int Dim, typename Metric = QKDTreeSquaredEuclidean<Dim>, typename Payload = int>
+class QKDTreeT
+{
+public:
+    enum { Dimension = Dim };
+
+    explicit QKDTreeT(const Metric& metric = Metric(), bool allowDuplicates = false) :
+        _metric(metric), _allowDuplicates(allowDuplicates), _root(-1), _sizeAtLastRebuild(0)
+    {
+    }
+
+    const Metric& metric() const
+    {
+        return _metric;
+    }
+
+    int size() const
+    {
+        return _points.size();
+    }
+
+    bool isEmpty() const
+    {
+        return _points.isEmpty();
+    }
+
+    void reserve(int size)
+    {
+        _points.reserve(size);
+        _payloads.reserve(size);
+    }
+
+    /**
+     * @brief memoryBytes returns how many bytes the tree has allocated for its points and payloads, used or not.
+     * Whatever the payloads themselves point to isn't counted.
+     * @return
+     */
+    qint64 memoryBytes() const
+    {
+        return (qint64)_points.capacity() * sizeof(Point) + (qint64)_payloads.capacity() * sizeof(Payload);
+    }
+
+    void clear()
+    {
+        _points.resize(0);
+        _payloads.resize(0);
+        _root = -1;
+        _sizeAtLastRebuild = 0;
+    }
+
+    /**
+     * @brief add inserts a point
+     * @param position Dim coordinates
+     * @param payload
+     * @return the index of the new point, or -1 if it's a duplicate and duplicates aren't allowed
+     */
+    int add(const qreal * position, const Payload& payload = Payload())
+    {
+        if (!_allowDuplicates && this->_findDuplicate(position) >= 0)
+            return -1;
+
+        Point point;
+        for (int d = 0; d < Dim; d++)
+            point.coords[d] = position[d];
+        point.left = -1;
+        point.right = -1;
+        point.divDim = 0;
+
+        const qint32 index = _points.size();
+        _points.append(point);
+        _payloads.append(payload);
+
+        if (_root < 0)
+        {
+            _root = index;
+            return index;
+        }
+
+        //Normal insertion, going left on <= like QKDTree
+        qint32 parent = _root;
+        int depth = 1;
+        while (true)
+        {
+            Point& parentPoint = _points[parent];
+            const int divDim = parentPoint.divDim;
+            qint32& child = (position[divDim] <= parentPoint.coords[divDim]) ? parentPoint.left : parentPoint.right;
+            if (child < 0)
+            {
+                child = index;
+                _points[index].divDim = (divDim + 1) % Dim;
+                break;
+            }
+            parent = child;
+            depth++;
+        }
+
+        if (depth >= MaxDepth || this->size() >= 2 * qMax<int>(_sizeAtLastRebuild, 8))
+            this->rebalance();
+
+        return index;
+    }
+
+    /**
+     * @brief nearest finds the point nearest to position
+     * @param position Dim coordinates
+     * @param distanceOut if not null, receives the metric's distance to the nearest point
+     * @return the index of the nearest point, or -1 if the tree is empty
+     */
+    int nearest(const qreal * position, qreal * distanceOut = 0) const
+    {
+        qint32 best = -1;
+        qreal bestDist = std::numeric_limits<qreal>::max();
+        if (_root < 0)
+            return -1;
+
+        SearchEntry stack[MaxStack];
+        int stackSize = 0;
+        stack[stackSize].node = _root;
+        stack[stackSize].bound = 0.0;
+        stackSize++;
+
+        while (stackSize > 0)
+        {
+            const SearchEntry entry = stack[--stackSize];
+            if (entry.bound > bestDist)
+                continue;
+
+            const Point& point = _points.at(entry.node);
+            const qreal dist = _metric.distance(point.coords, position);
+            if (dist < bestDist)
+            {
+                best = entry.node;
+                bestDist = dist;
+            }
+            this->_pushChildren(point, position, entry.bound, bestDist, stack, &stackSize);
+        }
+
+        if (distanceOut)
+            *distanceOut = bestDist;
+        return best;
+    }
+
+    /**
+     * @brief kNearest finds the (up to) k points nearest to position, nearest first
+     * @param position Dim coordinates
+     * @param k
+     * @param indicesOut receives the points' indices, replacing its contents
+     * @param distancesOut if not null, receives the metric's distance to each of them
+     * @return the number of points found
+     */
+    int kNearest(const qreal * position, int k, QVector<int> * indicesOut, QVector<qreal> * distancesOut = 0) const
+    {
+        if (indicesOut == 0)
+            return 0;
+        indicesOut->resize(0);
+        if (distancesOut)
+            distancesOut->resize(0);
+        if (_root < 0 || k <= 0)
+            return 0;
+
+        //The best so far, sorted nearest first. k is small, so insertion into a flat array is cheapest.
+        QVarLengthArray<qreal, 32> bestDists;
+        QVarLengthArray<qint32, 32> bestIndices;
+
+        SearchEntry stack[MaxStack];
+        int stackSize = 0;
+        stack[stackSize].node = _root;
+        stack[stackSize].bound = 0.0;
+        stackSize++;
+
+        while (stackSize > 0)
+        {
+            const SearchEntry entry = stack[--stackSize];
+            qreal worst = (bestDists.size() < k) ? std::numeric_limits<qreal>::max() : bestDists[bestDists.size() - 1];
+            if (entry.bound > worst)
+                continue;
+
+            const Point& point = _points.at(entry.node);
+            const qreal dist = _metric.distance(point.coords, position);
+            if (dist < worst)
+            {
+                if (bestDists.size() == k)
+                {
+                    bestDists.removeLast();
+                    bestIndices.removeLast();
+                }
+                int slot = bestDists.size();
+                bestDists.append(dist);
+                bestIndices.append(entry.node);
+                for (; slot > 0 && bestDists[slot - 1] > dist; slot--)
+                {
+                    bestDists[slot] = bestDists[slot - 1];
+                    bestIndices[slot] = bestIndices[slot - 1];
+                }
+                bestDists[slot] = dist;
+                bestIndices[slot] = entry.node;
+                worst = (bestDists.size() < k) ? std::numeric_limits<qreal>::max() : bestDists[bestDists.size() - 1];
+            }
+            this->_pushChildren(point, position, entry.bound, worst, stack, &stackSize);
+        }
+
+        indicesOut->resize(bestIndices.size());
+        for (int i = 0; i < bestIndices.size(); i++)
+            (*indicesOut)[i] = bestIndices[i];
+        if (distancesOut)
+        {
+            distancesOut->resize(bestDists.size());
+            for (int i = 0; i < bestDists.size(); i++)
+                (*distancesOut)[i] = bestDists[i];
+        }
+        return indicesOut->size();
+    }
+
+    /**
+     * @brief withinDistance finds every point no further than maxDistance from position, as measured by the
+     * metric (so squared distance with the default one)
+     * @param position Dim coordinates
+     * @param maxDistance
+     * @param indicesOut receives the points' indices, replacing its contents, in no particular order
+     * @return the number of points found
+     */
+    int withinDistance(const qreal * position, qreal maxDistance, QVector<int> * indicesOut) const
+    {
+        if (indicesOut == 0)
+            return 0;
+        indicesOut->resize(0);
+        if (_root < 0)
+            return 0;
+
+        SearchEntry stack[MaxStack];
+        int stackSize = 0;
+        stack[stackSize].node = _root;
+        stack[stackSize].bound = 0.0;
+        stackSize++;
+
+        while (stackSize > 0)
+        {
+            const SearchEntry entry = stack[--stackSize];
+            if (entry.bound > maxDistance)
+                continue;
+
+            const Point& point = _points.at(entry.node);
+            if (_metric.distance(point.coords, position) <= maxDistance)
+                indicesOut->append(entry.node);
+            this->_pushChildren(point, position, entry.bound, maxDistance, stack, &stackSize);
+        }
+        return indicesOut->size();
+    }
+
+    const qreal * coordinates(int index) const
+    {
+        return _points.at(index).coords;
+    }
+
+    const Payload& payload(int index) const
+    {
+        return _payloads.at(index);
+    }
+
+    Payload& payload(int index)
+    {
+        return _payloads[index];
+    }
+
+    /**
+     * @brief rebalance rebuilds the tree's links by median partitioning. Indices are unaffected.
+     * add() does this automatically whenever the size doubles or the tree gets too deep for the query stack.
+     */
+    void rebalance()
+    {
+        const int count = this->size();
+        _sizeAtLastRebuild = count;
+        _root = -1;
+        if (count == 0)
+            return;
+
+        QVector<qint32> order(count);
+        for (int i = 0; i < count; i++)
+        {
+            order[i] = i;
+            _points[i].left = -1;
+            _points[i].right = -1;
+        }
+
+        QVarLengthArray<BuildRange, 64> todo;
+        BuildRange all = {0, count, -1, false};
+        todo.append(all);
+
+        while (!todo.isEmpty())
+        {
+            const BuildRange range = todo[todo.size() - 1];
+            todo.removeLast();
+
+            qint32 * begin = order.data() + range.begin;
+            qint32 * end = order.data() + range.end;
+
+            //Split along the dimension with the largest spread
+            int divDim = 0;
+            qreal bestSpread = -1.0;
+            for (int dim = 0; dim < Dim; dim++)
+            {
+                qreal minVal = std::numeric_limits<qreal>::max();
+                qreal maxVal = -std::numeric_limits<qreal>::max();
+                for (qint32 * iter = begin; iter != end; iter++)
+                {
+                    const qreal val = _points.at(*iter).coords[dim];
+                    minVal = qMin<qreal>(minVal, val);
+                    maxVal = qMax<qreal>(maxVal, val);
+                }
+                if (maxVal - minVal > bestSpread)
+                {
+                    bestSpread = maxVal - minVal;
+                    divDim = dim;
+                }
+            }
+
+            qint32 * median = begin + (range.end - range.begin) / 2;
+            std::nth_element(begin, median, end, IndexLess(_points.constData(), divDim));
+
+            //Everything equal to the median has to end up on the left (see QKDTree::_rebuild)
+            const qreal pivot = _points.at(*median).coords[divDim];
+            qint32 * lastEqual = std::partition(median + 1, end, IndexAtMost(_points.constData(), divDim, pivot)) - 1;
+            std::iter_swap(median, lastEqual);
+            median = lastEqual;
+
+            const qint32 node = *median;
+            _points[node].divDim = divDim;
+
+            if (range.parent < 0)
+                _root = node;
+            else if (range.isLeft)
+                _points[range.parent].left = node;
+            else
+                _points[range.parent].right = node;
+
+            const int medianIndex = median - order.data();
+            if (range.begin < medianIndex)
+            {
+                BuildRange left = {range.begin, medianIndex, node, true};
+                todo.append(left);
+            }
+            if (medianIndex + 1 < range.end)
+            {
+                BuildRange right = {medianIndex + 1, range.end, node, false};
+                todo.append(right);
+            }
+        }
+    }
+
+private:
+    //Queries use a fixed stack of this many entries, so the tree is rebuilt before it gets deeper than that
+    enum { MaxStack = 128, MaxDepth = 100 };
+
+    struct Point
+    {
+        qreal coords[Dim];
+        qint32 left;
+        qint32 right;
+        qint32 divDim;
+    };
+
+    struct SearchEntry
+    {
+        qint32 node;
+        //No point in the subtree can be closer than this
+        qreal bound;
+    };
+
+    struct BuildRange
+    {
+        int begin;
+        int end;
+        qint32 parent;
+        bool isLeft;
+    };
+
+    //Orders point indices by one of their coordinates
+    class IndexLess
+    {
+    public:
+        IndexLess(const Point * points, int dim) : _points(points), _dim(dim) {}
+        bool operator()(qint32 a, qint32 b) const
+        {
+            return _points[a].coords[_dim] < _points[b].coords[_dim];
+        }
+    private:
+        const Point * _points;
+        int _dim;
+    };
+
+    //True for point indices whose coordinate in one dimension is no more than a pivot
+    class IndexAtMost
+    {
+    public:
+        IndexAtMost(const Point * points, int dim, qreal pivot) : _points(points), _dim(dim), _pivot(pivot) {}
+        bool operator()(qint32 a) const
+        {
+            return _points[a].coords[_dim] <= _pivot;
+        }
+    private:
+        const Point * _points;
+        int _dim;
+        qreal _pivot;
+    };
+
+    //Pushes the far side of point's split (if it could hold something within limit) and then the near side,
+    //so that the near side is searched first. Depth is capped, so the stack can't overflow.
+    void _pushChildren(const Point& point, const qreal * position, qreal bound, qreal limit,
+                       SearchEntry * stack, int * stackSize) const
+    {
+        const int divDim = point.divDim;
+        const qreal delta = position[divDim] - point.coords[divDim];
+
+        qint32 nearSide = point.left;
+        qint32 farSide = point.right;
+        if (delta > 0.0)
+            qSwap(nearSide, farSide);
+
+        if (farSide >= 0)
+        {
+            const qreal farBound = qMax<qreal>(bound, _metric.axisLowerBound(divDim, delta));
+            if (farBound <= limit)
+            {
+                stack[*stackSize].node = farSide;
+                stack[*stackSize].bound = farBound;
+                (*stackSize)++;
+            }
+        }
+        if (nearSide >= 0)
+        {
+            stack[*stackSize].node = nearSide;
+            stack[*stackSize].bound = bound;
+            (*stackSize)++;
+        }
+    }
+
+    int _findDuplicate(const qreal * position) const
+    {
+        qint32 current = _root;
+        while (current >= 0)
+        {
+            const Point& point = _points.at(current);
+            bool same = true;
+            for (int d = 0; d < Dim && same; d++)
+                same = (point.coords[d] == position[d]);
+            if (same)
+                return current;
+            current = (position[point.divDim] <= point.coords[point.divDim]) ? point.left : point.right;
+        }
+        return -1;
+    }
+
+    Metric _metric;
+    bool _allowDuplicates;
+
+    QVector<Point> _points;
+    QVector<Payload> _payloads;
+
+    qint32 _root;
+    int _sizeAtLastRebuild;
+};
+
+#endif // QKDTREET_H
@@ -2,6 +2,7 @@
 
 #include <QtDebug>
 #include <cmath>
+#include <cstring>
 
 QVectorND::QVectorND(int dimensions) :_dimensions(dimensions)
 {
@@ -100,6 +101,37 @@ qreal QVectorND::manhattanDistance() const
     return toRet;
 }
 
+qreal QVectorND::manhattanDistanceTo(const QVectorND &other) const
+{
+    if (other._dimensions != _dimensions)
+        return -1.0;
+
+    qreal toRet = 0.0;
+    for (int i = 0; i < _dimensions; i++)
+        toRet += qAbs<qreal>(_data[i] - other._data[i]);
+    return toRet;
+}
+
+qreal QVectorND::distanceSquaredTo(const QVectorND &other) const
+{
+    if (other._dimensions != _dimensions)
+        return -1.0;
+
+    qreal toRet = 0.0;
+    for (int i = 0; i < _dimensions; i++)
+    {
+        const qreal diff = _data[i] - other._data[i];
+        toRet += diff * diff;
+    }
+    return toRet;
+}
+
+qreal QVectorND::distanceTo(const QVectorND &other) const
+{
+    const qreal squared = this->distanceSquaredTo(other);
+    return squared < 0.0 ? -1.0 : sqrt(squared);
+}
+
 void QVectorND::normalize()
 {
     const qreal length = this->length();
@@ -144,6 +176,11 @@ const QVector<qreal> &QVectorND::values() const
     return _data;
 }
 
+const qreal *QVectorND::constData() const
+{
+    return _data.constData();
+}
+
 QVectorND &QVectorND::operator *=(qreal factor)
 {
     for (int i = 0; i < _dimensions; i++)
@@ -238,12 +275,28 @@ qreal QVectorND::operator [](int index) const
 //non-member
 uint qHash(const QVectorND& vec)
 {
-    uint toRet = 0;
-
-    for (int i = 0; i < vec.dimension(); i++)
-        toRet = toRet ^ (uint)vec[i];
+    return qHashReals(vec.constData(), vec.dimension());
+}
 
-    return toRet;
+//non-member
+uint qHashReals(const qreal *values, int count)
+{
+    quint64 toRet = (quint64)count;
+    for (int i = 0; i < count; i++)
+    {
+        //+0.0 so that 0.0 and -0.0 (which compare equal) hash the same
+        const double val = values[i] + 0.0;
+        quint64 bits;
+        memcpy(&bits, &val, sizeof(bits));
+
+        //splitmix64 finalizer
+        toRet ^= bits;
+        toRet += Q_UINT64_C(0x9e3779b97f4a7c15);
+        toRet = (toRet ^ (toRet >> 30)) * Q_UINT64_C(0xbf58476d1ce4e5b9);
+        toRet = (toRet ^ (toRet >> 27)) * Q_UINT64_C(0x94d049bb133111eb);
+        toRet ^= toRet >> 31;
+    }
+    return (uint)(toRet ^ (toRet >> 32));
 }
 
 //non-member
@@ -261,20 +314,3 @@ QDebug operator<<(QDebug dbg, const QVectorND& vec)
 
     return dbg.space();
 }
-
-//non-member
-const QVectorND operator-(const QVectorND& v1, const QVectorND& v2)
-{
-    QVectorND toRet = v1;
-    toRet -= v2;
-    return toRet;
-}
-
-//non-member
-const QVectorND operator-(const QVectorND& v)
-{
-    QVectorND toRet = v;
-    for (int i = 0; i < toRet.dimension(); i++)
-        toRet[i] *= -1;
-    return toRet;
-}
@@ -11,8 +11,9 @@
 #include <QVector>
 
 #include "QVectorND_global.h"
+#include "QVectorNDExpression.h"
 
-class QVECTORNDSHARED_EXPORT QVectorND
+class QVECTORNDSHARED_EXPORT QVectorND : public QVectorNDExpression<QVectorND>
 {
 public:
     QVectorND(int dimensions=2);
@@ -24,6 +25,30 @@ public:
     QVectorND(const QVector4D& vec);
     QVectorND(const QVectorND& other);
 
+    /**
+     * @brief QVectorND evaluates an arithmetic expression, like a - b, in one pass
+     */
+    template <typename E>
+    QVectorND(const QVectorNDExpression<E>& expression) :
+        _dimensions(expression.self().dimension()), _data(_dimensions)
+    {
+        const E& e = expression.self();
+        for (int i = 0; i < _dimensions; i++)
+            _data[i] = e.at(i);
+    }
+
+    template <typename E>
+    QVectorND& operator= (const QVectorNDExpression<E>& expression)
+    {
+        //Element i of an expression only reads element i of its operands, so we may be one of them
+        const E& e = expression.self();
+        _dimensions = e.dimension();
+        _data.resize(_dimensions);
+        for (int i = 0; i < _dimensions; i++)
+            _data[i] = e.at(i);
+        return *this;
+    }
+
     int dimension() const;
 
     bool isNull() const;
@@ -31,13 +56,36 @@ public:
     qreal lengthSquared() const;
     qreal manhattanDistance() const;
 
+    /**
+     * @brief manhattanDistanceTo returns (*this - other).manhattanDistance(), or -1 if the dimensions differ
+     */
+    qreal manhattanDistanceTo(const QVectorND& other) const;
+
+    /**
+     * @brief distanceSquaredTo returns (*this - other).lengthSquared(), or -1 if the dimensions differ
+     */
+    qreal distanceSquaredTo(const QVectorND& other) const;
+    qreal distanceTo(const QVectorND& other) const;
+
     void normalize();
     QVectorND normalized() const;
 
     void setVal(int index, qreal value);
     qreal val(int index) const;
+
+    /**
+     * @brief at returns the value at index without checking it, like QVector::at()
+     */
+    qreal at(int index) const
+    {
+        return _data.at(index);
+    }
+
     const QVector<qreal> &values() const;
 
+    //Same as values().constData(). Shared with QVectorNDFixed so code can take either.
+    const qreal * constData() const;
+
 
     QVectorND& operator*= (qreal factor);
     QVectorND& operator*= (const QVectorND& other);
@@ -45,6 +93,18 @@ public:
     QVectorND& operator-= (const QVectorND& other);
     QVectorND& operator/= (qreal divisor);
 
+    template <typename E>
+    QVectorND& operator+= (const QVectorNDExpression<E>& expression)
+    {
+        return (*this = *this + expression);
+    }
+
+    template <typename E>
+    QVectorND& operator-= (const QVectorNDExpression<E>& expression)
+    {
+        return (*this = *this - expression);
+    }
+
     bool operator==(const QVectorND& other) const;
     bool operator!=(const QVectorND& other) const;
 
@@ -59,8 +119,12 @@ private:
 
 //non-members
 QVECTORNDSHARED_EXPORT uint qHash(const QVectorND& vec);
+
+/**
+ * @brief qHashReals hashes count reals by feeding their bit patterns through a 64-bit mixer, so nearby values
+ * land in unrelated buckets. Used by qHash(QVectorND) and qHash(QVectorNDFixed).
+ */
+QVECTORNDSHARED_EXPORT uint qHashReals(const qreal * values, int count);
 QVECTORNDSHARED_EXPORT QDebug operator<<(QDebug dbg, const QVectorND& vec);
-QVECTORNDSHARED_EXPORT const QVectorND operator-(const QVectorND& v1, const QVectorND& v2);
-QVECTORNDSHARED_EXPORT const QVectorND operator-(const QVectorND& v);
 
 #endif // QVECTORND_H
@@ -14,7 +14,9 @@ SOURCES += \
 
 HEADERS +=\
         QVectorND_global.h \
-    QVectorND.h
+    QVectorND.h \
+    QVectorNDExpression.h \
+    QVectorNDFixed.h
 
 unix:!symbian {
     maemo5 {
@@ -0,0 +1,175 @@
+#ifndef QVECTORNDEXPRESSION_H
+#define QVECTORNDEXPRESSION_H
+
+#include <QtGlobal>
+#include <QtDebug>
+#include <cmath>
+
+class QVectorND;
+
+/**
+ * @brief The QVectorNDExpression class is the base of QVectorND and of the unevaluated results of arithmetic on
+ * QVectorNDs. a - b, 2.0 * (a + b) and so on build small expression objects instead of new vectors, and the
+ * whole expression is evaluated in one pass, element by element, when it's turned into a QVectorND or asked for
+ * its length. So (a - b).manhattanDistance() never allocates.
+ *
+ * Expressions refer to the QVectorNDs they were built from and must not outlive them. Turn one into a
+ * QVectorND rather than keeping it around.
+ *
+ * E is the actual expression type. It provides dimension() and at(i), the i-th element.
+ */
+template <typename E>
+class QVectorNDExpression
+{
+public:
+    const E& self() const
+    {
+        return static_cast<const E&>(*this);
+    }
+
+    qreal lengthSquared() const
+    {
+        const E& e = this->self();
+        qreal toRet = 0.0;
+        for (int i = 0; i < e.dimension(); i++)
+        {
+            const qreal val = e.at(i);
+            toRet += val * val;
+        }
+        return toRet;
+    }
+
+    qreal length() const
+    {
+        return sqrt(this->lengthSquared());
+    }
+
+    qreal manhattanDistance() const
+    {
+        const E& e = this->self();
+        qreal toRet = 0.0;
+        for (int i = 0; i < e.dimension(); i++)
+            toRet += qAbs<qreal>(e.at(i));
+        return toRet;
+    }
+};
+
+/**
+ * @brief QVectorNDExpressionOperand is how expressions hold their operands: vectors by reference and other
+ * expressions (which are small) by value, so that the temporaries of a chained expression can go away.
+ */
+template <typename E>
+struct QVectorNDExpressionOperand
+{
+    typedef const E Type;
+};
+
+template <>
+struct QVectorNDExpressionOperand<QVectorND>
+{
+    typedef const QVectorND& Type;
+};
+
+/**
+ * @brief The QVectorNDBinaryExpression class is the element-wise sum or difference of two expressions. Like
+ * QVectorND::operator+= and operator-=, it warns about operands of different dimensions and leaves the left one
+ * alone in that case.
+ */
+template <typename L, typename R, bool Subtract>
+class QVectorNDBinaryExpression : public QVectorNDExpression<QVectorNDBinaryExpression<L, R, Subtract> >
+{
+public:
+    QVectorNDBinaryExpression(const L& left, const R& right) :
+        _left(left), _right(right), _matched(left.dimension() == right.dimension())
+    {
+        if (!_matched)
+            qWarning() << "Can't" << (Subtract ? "subtract" : "add") << "a" << left.dimension()
+                       << "dimensional vector and a" << right.dimension() << "dimensional one.";
+    }
+
+    int dimension() const
+    {
+        return _left.dimension();
+    }
+
+    qreal at(int i) const
+    {
+        if (!_matched)
+            return _left.at(i);
+        return Subtract ? _left.at(i) - _right.at(i) : _left.at(i) + _right.at(i);
+    }
+
+private:
+    typename QVectorNDExpressionOperand<L>::Type _left;
+    typename QVectorNDExpressionOperand<R>::Type _right;
+    const bool _matched;
+};
+
+/**
+ * @brief The QVectorNDScaledExpression class is an expression multiplied (or divided, if Divide) by a number.
+ * Negation is a scale of -1.
+ */
+template <typename E, bool Divide>
+class QVectorNDScaledExpression : public QVectorNDExpression<QVectorNDScaledExpression<E, Divide> >
+{
+public:
+    QVectorNDScaledExpression(const E& operand, qreal factor) :
+        _operand(operand), _factor(factor)
+    {
+    }
+
+    int dimension() const
+    {
+        return _operand.dimension();
+    }
+
+    qreal at(int i) const
+    {
+        return Divide ? _operand.at(i) / _factor : _operand.at(i) * _factor;
+    }
+
+private:
+    typename QVectorNDExpressionOperand<E>::Type _operand;
+    const qreal _factor;
+};
+
+//non-members
+template <typename L, typename R>
+inline const QVectorNDBinaryExpression<L, R, false> operator+(const QVectorNDExpression<L>& left,
+                                                             const QVectorNDExpression<R>& right)
+{
+    return QVectorNDBinaryExpression<L, R, false>(left.self(), right.self());
+}
+
+template <typename L, typename R>
+inline const QVectorNDBinaryExpression<L, R, true> operator-(const QVectorNDExpression<L>& left,
+                                                            const QVectorNDExpression<R>& right)
+{
+    return QVectorNDBinaryExpression<L, R, true>(left.self(), right.self());
+}
+
+template <typename E>
+inline const QVectorNDScaledExpression<E, false> operator-(const QVectorNDExpression<E>& operand)
+{
+    return QVectorNDScaledExpression<E, false>(operand.self(), -1.0);
+}
+
+template <typename E>
+inline const QVectorNDScaledExpression<E, false> operator*(const QVectorNDExpression<E>& operand, qreal factor)
+{
+    return QVectorNDScaledExpression<E, false>(operand.self(), factor);
+}
+
+template <typename E>
+inline const QVectorNDScaledExpression<E, false> operator*(qreal factor, const QVectorNDExpression<E>& operand)
+{
+    return QVectorNDScaledExpression<E, false>(operand.self(), factor);
+}
+
+template <typename E>
+inline const QVectorNDScaledExpression<E, true> operator/(const QVectorNDExpression<E>& operand, qreal divisor)
+{
+    return QVectorNDScaledExpression<E, true>(operand.self(), divisor);
+}
+
+#endif // QVECTORNDEXPRESSION_H
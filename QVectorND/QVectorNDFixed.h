@@ -0,0 +1,207 @@
+#ifndef QVECTORNDFIXED_H
+#define QVECTORNDFIXED_H
+
+#include <QtGlobal>
+#include <QtDebug>
+#include <cmath>
+
+#include "QVectorND.h"
+
+/**
+ * @brief The QVectorNDFixed class is a QVectorND whose dimension is known at compile time.
+ * Values are stored inline, so copying one (e.g., as a QHash key) never allocates.
+ *
+ * It offers the same interface as QVectorND - dimension(), val(), setVal(), operator[], constData() and
+ * the usual arithmetic - so code templated over "a vector" works with either. Use toVectorND() and the
+ * QVectorND constructor to convert when an API (like QKDTree) only takes QVectorND.
+ */
+template <int N>
+class QVectorNDFixed
+{
+public:
+    enum { Dimension = N };
+
+    QVectorNDFixed()
+    {
+        for (int i = 0; i < N; i++)
+            _data[i] = 0.0;
+    }
+
+    explicit QVectorNDFixed(const qreal * values)
+    {
+        for (int i = 0; i < N; i++)
+            _data[i] = values[i];
+    }
+
+    /**
+     * @brief QVectorNDFixed converts from a QVectorND. Extra dimensions are dropped and missing ones are 0.
+     * @param other
+     */
+    explicit QVectorNDFixed(const QVectorND& other)
+    {
+        if (other.dimension() != N)
+            qWarning() << "Converting a" << other.dimension() << "dimensional QVectorND to" << N << "dimensions";
+        for (int i = 0; i < N; i++)
+            _data[i] = (i < other.dimension()) ? other.val(i) : 0.0;
+    }
+
+    int dimension() const
+    {
+        return N;
+    }
+
+    bool isNull() const
+    {
+        for (int i = 0; i < N; i++)
+        {
+            if (_data[i] != 0.0)
+                return false;
+        }
+        return true;
+    }
+
+    qreal length() const
+    {
+        return sqrt(this->lengthSquared());
+    }
+
+    qreal lengthSquared() const
+    {
+        qreal toRet = 0.0;
+        for (int i = 0; i < N; i++)
+            toRet += _data[i] * _data[i];
+        return toRet;
+    }
+
+    qreal manhattanDistance() const
+    {
+        qreal toRet = 0.0;
+        for (int i = 0; i < N; i++)
+            toRet += qAbs<qreal>(_data[i]);
+        return toRet;
+    }
+
+    void setVal(int index, qreal value)
+    {
+        _data[index] = value;
+    }
+
+    qreal val(int index) const
+    {
+        return _data[index];
+    }
+
+    const qreal * constData() const
+    {
+        return _data;
+    }
+
+    QVectorND toVectorND() const
+    {
+        QVectorND toRet(N);
+        for (int i = 0; i < N; i++)
+            toRet[i] = _data[i];
+        return toRet;
+    }
+
+    QVectorNDFixed& operator*= (qreal factor)
+    {
+        for (int i = 0; i < N; i++)
+            _data[i] *= factor;
+        return *this;
+    }
+
+    QVectorNDFixed& operator+= (const QVectorNDFixed& other)
+    {
+        for (int i = 0; i < N; i++)
+            _data[i] += other._data[i];
+        return *this;
+    }
+
+    QVectorNDFixed& operator-= (const QVectorNDFixed& other)
+    {
+        for (int i = 0; i < N; i++)
+            _data[i] -= other._data[i];
+        return *this;
+    }
+
+    QVectorNDFixed& operator/= (qreal divisor)
+    {
+        for (int i = 0; i < N; i++)
+            _data[i] /= divisor;
+        return *this;
+    }
+
+    bool operator==(const QVectorNDFixed& other) const
+    {
+        for (int i = 0; i < N; i++)
+        {
+            if (_data[i] != other._data[i])
+                return false;
+        }
+        return true;
+    }
+
+    bool operator!=(const QVectorNDFixed& other) const
+    {
+        return !(other == *this);
+    }
+
+    qreal& operator[](int index)
+    {
+        return _data[index];
+    }
+
+    qreal operator[](int index) const
+    {
+        return _data[index];
+    }
+
+private:
+    qreal _data[N];
+};
+
+//non-members
+template <int N>
+const QVectorNDFixed<N> operator-(const QVectorNDFixed<N>& v1, const QVectorNDFixed<N>& v2)
+{
+    QVectorNDFixed<N> toRet = v1;
+    toRet -= v2;
+    return toRet;
+}
+
+template <int N>
+const QVectorNDFixed<N> operator+(const QVectorNDFixed<N>& v1, const QVectorNDFixed<N>& v2)
+{
+    QVectorNDFixed<N> toRet = v1;
+    toRet += v2;
+    return toRet;
+}
+
+//Hashes the same as a QVectorND with the same values
+template <int N>
+uint qHash(const QVectorNDFixed<N>& vec)
+{
+    return qHashReals(vec.constData(), N);
+}
+
+template <int N>
+QDebug operator<<(QDebug dbg, const QVectorNDFixed<N>& vec)
+{
+    dbg.nospace() << "(";
+    for(int i = 0; i < N; i++)
+    {
+        dbg.nospace() << vec.val(i);
+        if (i < N - 1)
+            dbg.nospace() << ",";
+    }
+
+    dbg.nospace() << ")";
+
+    return dbg.space();
+}
+
+typedef QVectorNDFixed<2> QVectorND2;
+typedef QVectorNDFixed<3> QVectorND3;
+
+#endif // QVECTORNDFIXED_H
@@ -0,0 +1,407 @@
+#include "SyntheticTileServer.h"
+
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QHostAddress>
+#include <QImage>
+#include <QMutexLocker>
+#include <QPainter>
+#include <QRegExp>
+#include <QStringList>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QThread>
+#include <QTimer>
+
+//How many different tiles there are. Tiles are picked from them by coordinate
+const int TILE_VARIANTS = 16;
+const int TILE_SIZE = 256;
+
+//How often responses under way are written to, in milliseconds. Latencies are only this accurate
+const int PUMP_INTERVAL = 2;
+
+//The most a link left idle saves up, in seconds of bandwidth, so that bursts stay realistic
+const qreal MAX_SAVED_BANDWIDTH = 0.05;
+
+SyntheticTileServer::Statistics::Statistics() :
+    requests(0), notModified(0), bytesSent(0)
+{
+}
+
+SyntheticTileServer::SyntheticTileServer() :
+    QObject(0), _thread(0), _server(0), _pump(0), _lastPump(0), _budget(0.0), _port(0),
+    _latency(0), _bandwidth(0)
+{
+}
+
+SyntheticTileServer::~SyntheticTileServer()
+{
+    this->stop();
+}
+
+bool SyntheticTileServer::start(QString *errorString)
+{
+    if (_thread != 0)
+        return true;
+
+    if (_tiles.isEmpty())
+        this->renderTiles();
+
+    _thread = new QThread();
+    this->moveToThread(_thread);
+    _thread->start();
+
+    //Sockets and timers have to be created in the thread they're used in
+    bool ok = false;
+    QMetaObject::invokeMethod(this, "listen", Qt::BlockingQueuedConnection, Q_RETURN_ARG(bool, ok));
+    if (!ok)
+    {
+        if (errorString)
+            *errorString = _errorString;
+        this->stop();
+    }
+    return ok;
+}
+
+void SyntheticTileServer::stop()
+{
+    if (_thread == 0)
+        return;
+
+    //Hands us back to this thread once the sockets are gone
+    QMetaObject::invokeMethod(this, "shutDown", Qt::BlockingQueuedConnection);
+    _thread->quit();
+    _thread->wait();
+    delete _thread;
+    _thread = 0;
+}
+
+QString SyntheticTileServer::url() const
+{
+    return QString("http://127.0.0.1:%1").arg(_port);
+}
+
+int SyntheticTileServer::latency() const
+{
+    QMutexLocker lock(&_lock);
+    return _latency;
+}
+
+void SyntheticTileServer::setLatency(int msecs)
+{
+    QMutexLocker lock(&_lock);
+    _latency = qMax(0, msecs);
+}
+
+qint64 SyntheticTileServer::bandwidth() const
+{
+    QMutexLocker lock(&_lock);
+    return _bandwidth;
+}
+
+void SyntheticTileServer::setBandwidth(qint64 bytesPerSecond)
+{
+    QMutexLocker lock(&_lock);
+    _bandwidth = qMax<qint64>(0, bytesPerSecond);
+}
+
+qint64 SyntheticTileServer::averageTileBytes() const
+{
+    if (_tiles.isEmpty())
+        return 0;
+
+    qint64 total = 0;
+    foreach(const QByteArray& tile, _tiles)
+        total += tile.size();
+    return total / _tiles.size();
+}
+
+SyntheticTileServer::Statistics SyntheticTileServer::statistics() const
+{
+    QMutexLocker lock(&_lock);
+    return _statistics;
+}
+
+void SyntheticTileServer::resetStatistics()
+{
+    QMutexLocker lock(&_lock);
+    _statistics = Statistics();
+}
+
+//private slot
+bool SyntheticTileServer::listen()
+{
+    _server = new QTcpServer(this);
+    if (!_server->listen(QHostAddress::LocalHost))
+    {
+        _errorString = "Failed to start the tile server: " + _server->errorString();
+        delete _server;
+        _server = 0;
+        return false;
+    }
+    _port = _server->serverPort();
+    connect(_server,
+            SIGNAL(newConnection()),
+            this,
+            SLOT(handleNewConnection()));
+
+    _pump = new QTimer(this);
+    _pump->setInterval(PUMP_INTERVAL);
+    _pump->setTimerType(Qt::PreciseTimer);
+    connect(_pump,
+            SIGNAL(timeout()),
+            this,
+            SLOT(sendResponses()));
+
+    _clock.start();
+    return true;
+}
+
+//private slot
+void SyntheticTileServer::shutDown()
+{
+    _responses.clear();
+    foreach(QTcpSocket * socket, _buffers.keys())
+    {
+        socket->abort();
+        delete socket;
+    }
+    _buffers.clear();
+
+    delete _pump;
+    _pump = 0;
+    delete _server;
+    _server = 0;
+
+    this->moveToThread(QCoreApplication::instance()->thread());
+}
+
+//private slot
+void SyntheticTileServer::handleNewConnection()
+{
+    while (_server->hasPendingConnections())
+    {
+        QTcpSocket * socket = _server->nextPendingConnection();
+        _buffers.insert(socket, QByteArray());
+        connect(socket,
+                SIGNAL(readyRead()),
+                this,
+                SLOT(handleReadyRead()));
+        connect(socket,
+                SIGNAL(disconnected()),
+                this,
+                SLOT(handleDisconnected()));
+    }
+}
+
+//private slot
+void SyntheticTileServer::handleReadyRead()
+{
+    QTcpSocket * socket = qobject_cast<QTcpSocket *>(QObject::sender());
+    if (socket == 0 || !_buffers.contains(socket))
+        return;
+
+    QByteArray& buffer = _buffers[socket];
+    buffer.append(socket->readAll());
+
+    //Tile requests are GETs without bodies, so a request ends with its headers
+    int end;
+    while ((end = buffer.indexOf("\r\n\r\n")) >= 0)
+    {
+        const QByteArray head = buffer.left(end);
+        buffer.remove(0, end + 4);
+        this->respond(socket, head);
+    }
+}
+
+//private slot
+void SyntheticTileServer::handleDisconnected()
+{
+    QTcpSocket * socket = qobject_cast<QTcpSocket *>(QObject::sender());
+    if (socket == 0)
+        return;
+    _buffers.remove(socket);
+    socket->deleteLater();
+}
+
+//private slot
+void SyntheticTileServer::sendResponses()
+{
+    const qint64 now = _clock.elapsed();
+    const qint64 elapsed = now - _lastPump;
+    _lastPump = now;
+
+    qint64 bandwidth;
+    {
+        QMutexLocker lock(&_lock);
+        bandwidth = _bandwidth;
+    }
+
+    //Responses that are past their latency, one per socket since responses on a connection go in order
+    QList<int> ready;
+    QList<QTcpSocket *> busySockets;
+    for (int i = 0; i < _responses.size(); i++)
+    {
+        const Response& response = _responses.at(i);
+        if (response.socket.isNull() || busySockets.contains(response.socket.data()))
+            continue;
+        busySockets.append(response.socket.data());
+        if (response.readyAt <= now)
+            ready.append(i);
+    }
+
+    if (ready.isEmpty())
+        _budget = 0.0;
+    else if (bandwidth > 0)
+        _budget = qMin(_budget + bandwidth * elapsed / 1000.0, bandwidth * MAX_SAVED_BANDWIDTH);
+
+    //Share the link evenly between the ready responses
+    qint64 bytesSent = 0;
+    foreach(int i, ready)
+    {
+        Response& response = _responses[i];
+        int count = response.data.size() - response.written;
+        if (bandwidth > 0)
+            count = qMin<int>(count, (int) (_budget / ready.size()));
+        if (count <= 0)
+            continue;
+
+        response.socket->write(response.data.constData() + response.written, count);
+        response.written += count;
+        bytesSent += count;
+    }
+    if (bandwidth > 0)
+        _budget = qMax(0.0, _budget - bytesSent);
+
+    //Drop the finished responses, and the ones whose connection has gone away
+    for (int i = _responses.size() - 1; i >= 0; i--)
+    {
+        const Response& response = _responses.at(i);
+        if (response.socket.isNull())
+            _responses.removeAt(i);
+        else if (response.written == response.data.size())
+        {
+            if (response.close)
+                response.socket->disconnectFromHost();
+            _responses.removeAt(i);
+        }
+    }
+
+    if (_responses.isEmpty())
+        _pump->stop();
+
+    QMutexLocker lock(&_lock);
+    _statistics.bytesSent += bytesSent;
+}
+
+//private
+void SyntheticTileServer::renderTiles()
+{
+    //A fixed sequence so that every run serves the same tiles
+    quint32 state = 12345;
+
+    for (int variant = 0; variant < TILE_VARIANTS; variant++)
+    {
+        QImage image(TILE_SIZE, TILE_SIZE, QImage::Format_RGB32);
+        image.fill(QColor::fromHsv((variant * 23) % 360, 20, 235));
+
+        //Roughly what a map tile has: blocks, roads and labels
+        QPainter painter(&image);
+        painter.setRenderHint(QPainter::Antialiasing);
+        for (int i = 0; i < 80; i++)
+        {
+            state = state * 1664525 + 1013904223;
+            const int x = (state >> 8) % TILE_SIZE;
+            const int y = (state >> 16) % TILE_SIZE;
+            const int size = 8 + (state >> 24) % 40;
+            const QColor color = QColor::fromHsv((state >> 4) % 360, 60 + (state >> 12) % 120, 160 + (state >> 20) % 90);
+            if (i % 3 == 0)
+            {
+                painter.setPen(QPen(color.darker(), 1 + (state >> 28) % 5));
+                painter.drawLine(x, y, (x + size * 3) % TILE_SIZE, (y + size * 5) % TILE_SIZE);
+            }
+            else
+            {
+                painter.setPen(color.darker(130));
+                painter.setBrush(color);
+                painter.drawRect(x, y, size, size / 2 + 4);
+            }
+        }
+        painter.setPen(Qt::black);
+        painter.drawText(QRect(0, 0, TILE_SIZE, TILE_SIZE), Qt::AlignCenter, QString("Synthetic tile %1").arg(variant));
+        painter.end();
+
+        QByteArray bytes;
+        QBuffer buffer(&bytes);
+        buffer.open(QIODevice::WriteOnly);
+        image.save(&buffer, "PNG");
+        _tiles.append(bytes);
+    }
+}
+
+//private
+void SyntheticTileServer::respond(QTcpSocket *socket, const QByteArray &head)
+{
+    const QStringList lines = QString::fromLatin1(head).split("\r\n");
+    const QStringList requestLine = lines.value(0).split(' ');
+
+    QString ifNoneMatch;
+    bool close = requestLine.value(2) == "HTTP/1.0";
+    for (int i = 1; i < lines.size(); i++)
+    {
+        const int colon = lines.at(i).indexOf(':');
+        const QString name = lines.at(i).left(colon).trimmed().toLower();
+        const QString value = lines.at(i).mid(colon + 1).trimmed();
+        if (name == "if-none-match")
+            ifNoneMatch = value;
+        else if (name == "connection")
+            close = value.toLower() == "close";
+    }
+
+    QRegExp tilePath("^/(\\d+)/(\\d+)/(\\d+)\\.png$");
+    QByteArray status = "404 Not Found";
+    QByteArray headers;
+    QByteArray body;
+    bool notModified = false;
+    if (requestLine.value(0) == "GET" && tilePath.exactMatch(requestLine.value(1)))
+    {
+        const quint32 z = tilePath.cap(1).toUInt();
+        const quint32 x = tilePath.cap(2).toUInt();
+        const quint32 y = tilePath.cap(3).toUInt();
+        const QByteArray etag = QString("\"%1-%2-%3\"").arg(z).arg(x).arg(y).toLatin1();
+
+        headers = "Content-Type: image/png\r\nCache-Control: max-age=86400\r\nETag: " + etag + "\r\n";
+        if (ifNoneMatch.toLatin1() == etag)
+        {
+            status = "304 Not Modified";
+            notModified = true;
+        }
+        else
+        {
+            status = "200 OK";
+            body = _tiles.at((x * 31 + y * 17 + z) % _tiles.size());
+        }
+    }
+
+    Response response;
+    response.socket = socket;
+    response.data = "HTTP/1.1 " + status + "\r\n" + headers
+            + "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+            + (close ? "Connection: close\r\n" : "") + "\r\n" + body;
+    response.written = 0;
+    response.close = close;
+
+    QMutexLocker lock(&_lock);
+    response.readyAt = _clock.elapsed() + _latency;
+    _statistics.requests++;
+    if (notModified)
+        _statistics.notModified++;
+    lock.unlock();
+
+    _responses.append(response);
+    if (!_pump->isActive())
+    {
+        _lastPump = _clock.elapsed();
+        _pump->start();
+    }
+}
@@ -0,0 +1,122 @@
+#ifndef SYNTHETICTILESERVER_H
+#define SYNTHETICTILESERVER_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+
+class QTcpServer;
+class QTcpSocket;
+class QThread;
+class QTimer;
+
+/**
+ * @brief The SyntheticTileServer class serves made-up OSM-style tiles ("/z/x/y.png") over HTTP on a local port,
+ * with a configurable latency and bandwidth, so the tile pipeline can be timed without depending on (or
+ * hammering) a real tile server.
+ *
+ * Every request waits latency() before its response starts, and all the responses under way share bandwidth()
+ * like they would a real link. Tiles are a handful of pre-rendered PNGs of a typical size, carry an ETag and a
+ * day's max-age, and are revalidated with 304s.
+ *
+ * The server runs in a thread of its own so that serving doesn't compete with the view being timed.
+ * Create it without a parent. Settings and statistics may be used from any thread.
+ */
+class SyntheticTileServer : public QObject
+{
+    Q_OBJECT
+public:
+    struct Statistics
+    {
+        Statistics();
+
+        quint64 requests;
+        quint64 notModified;
+
+        //Everything written to the sockets, headers included
+        quint64 bytesSent;
+    };
+
+public:
+    SyntheticTileServer();
+    ~SyntheticTileServer();
+
+    /**
+     * @brief start begins serving on a free port of 127.0.0.1. Returns true on success, false on failure with
+     * an explanation in errorString.
+     */
+    bool start(QString * errorString = 0);
+    void stop();
+
+    /**
+     * @brief url returns the scheme, host and port to fetch tiles from, e.g. for OSMTileSource::setHosts()
+     */
+    QString url() const;
+
+    /**
+     * @brief latency is how long each request waits before its response starts, in milliseconds
+     */
+    int latency() const;
+    void setLatency(int msecs);
+
+    /**
+     * @brief bandwidth is how many bytes per second all the responses together are sent at. Zero is unlimited.
+     */
+    qint64 bandwidth() const;
+    void setBandwidth(qint64 bytesPerSecond);
+
+    /**
+     * @brief averageTileBytes returns the average size of the PNGs served
+     */
+    qint64 averageTileBytes() const;
+
+    SyntheticTileServer::Statistics statistics() const;
+    void resetStatistics();
+
+private slots:
+    bool listen();
+    void shutDown();
+    void handleNewConnection();
+    void handleReadyRead();
+    void handleDisconnected();
+    void sendResponses();
+
+private:
+    struct Response
+    {
+        QPointer<QTcpSocket> socket;
+        QByteArray data;
+        int written;
+        qint64 readyAt;
+        bool close;
+    };
+
+    void renderTiles();
+    void respond(QTcpSocket * socket, const QByteArray& head);
+
+    QThread * _thread;
+    QTcpServer * _server;
+    QTimer * _pump;
+    QElapsedTimer _clock;
+    qint64 _lastPump;
+    qreal _budget;
+    QString _errorString;
+    quint16 _port;
+
+    QList<QByteArray> _tiles;
+    QHash<QTcpSocket *, QByteArray> _buffers;
+    QList<Response> _responses;
+
+    //Protects the settings and statistics, which other threads use
+    mutable QMutex _lock;
+    int _latency;
+    qint64 _bandwidth;
+    Statistics _statistics;
+};
+
+#endif // SYNTHETICTILESERVER_H
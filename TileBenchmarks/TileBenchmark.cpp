@@ -0,0 +1,299 @@
+#include "TileBenchmark.h"
+
+#include <QDir>
+#include <QTimer>
+#include <cmath>
+
+#include "MapGraphicsScene.h"
+#include "MapGraphicsView.h"
+#include "SyntheticTileServer.h"
+#include "tileSources/CompositeTileSource.h"
+#include "tileSources/OSMTileSource.h"
+
+//Where the script starts and ends: BYU campus, like the application
+const qreal HOME_LONGITUDE = -111.649253;
+const qreal HOME_LATITUDE = 40.249707;
+const quint8 HOME_ZOOM_LEVEL = 15;
+
+//Opacity of the composite's overlay layer
+const qreal OVERLAY_OPACITY = 0.6;
+
+/**
+ * OSM tiles from the synthetic server, cached on disk under a name of their own so the real OSM cache isn't
+ * touched.
+ */
+class BenchmarkTileSource : public OSMTileSource
+{
+public:
+    BenchmarkTileSource(const QString& name, const QString& host) :
+        OSMTileSource(), _name(name)
+    {
+        this->setHosts(QStringList(host));
+    }
+
+    //virtual from OSMTileSource
+    virtual QString name() const
+    {
+        return _name;
+    }
+
+private:
+    QString _name;
+};
+
+TileBenchmark::TileBenchmark(BenchmarkResults *results, SyntheticTileServer *server, int repetitions) :
+    QObject(), _results(results), _server(server), _repetitions(repetitions), _viewportSize(1024, 768),
+    _stepTimeout(30000), _prefetchRingSize(-1), _view(0), _firstTileNsecs(-1), _fullViewportNsecs(-1)
+{
+}
+
+QSize TileBenchmark::viewportSize() const
+{
+    return _viewportSize;
+}
+
+void TileBenchmark::setViewportSize(const QSize &size)
+{
+    _viewportSize = size;
+}
+
+int TileBenchmark::stepTimeout() const
+{
+    return _stepTimeout;
+}
+
+void TileBenchmark::setStepTimeout(int msecs)
+{
+    _stepTimeout = qMax(1, msecs);
+}
+
+int TileBenchmark::prefetchRingSize() const
+{
+    return _prefetchRingSize;
+}
+
+void TileBenchmark::setPrefetchRingSize(int ringSize)
+{
+    _prefetchRingSize = ringSize;
+}
+
+void TileBenchmark::run(TileBenchmark::SourceLayout layout)
+{
+    const QString group = "tiles/" + TileBenchmark::layoutName(layout) + "/";
+
+    for (int rep = 0; rep < _repetitions; rep++)
+    {
+        this->deleteDiskCaches();
+
+        QSharedPointer<MapTileSource> source = this->createSource(layout);
+        this->runPass(source, group + "cold");
+        this->runPass(source, group + "memory");
+
+        //Destroying the sources finishes their disk writes, so the new ones find everything on disk
+        source.clear();
+        source = this->createSource(layout);
+        this->runPass(source, group + "disk");
+    }
+
+    this->deleteDiskCaches();
+}
+
+//private slot
+void TileBenchmark::handleTileDisplayed(quint32 x, quint32 y, quint8 z, bool finished)
+{
+    Q_UNUSED(finished)
+    if (_firstTileNsecs >= 0 || _view == 0 || _view->tileSource().isNull())
+        return;
+
+    //Tiles still arriving for the margin around the last viewport don't count, only ones on screen now
+    const QSharedPointer<MapTileSource> source = _view->tileSource();
+    const qreal tileSize = source->tileSize();
+    const QPointF topLeft = source->ll2qgs(_view->mapToScene(QPoint(0, 0)), z) / tileSize;
+    const QPointF bottomRight = source->ll2qgs(_view->mapToScene(QPoint(_view->width(), _view->height())), z)
+            / tileSize;
+    if (x < floor(topLeft.x()) || x > floor(bottomRight.x()) || y < floor(topLeft.y()) || y > floor(bottomRight.y()))
+        return;
+
+    _firstTileNsecs = _stepClock.nsecsElapsed();
+}
+
+//private slot
+void TileBenchmark::handleVisibleTilesLoaded()
+{
+    if (_fullViewportNsecs >= 0)
+        return;
+
+    _fullViewportNsecs = _stepClock.nsecsElapsed();
+    _loop.quit();
+}
+
+//static
+QList<TileBenchmark::Step> TileBenchmark::script()
+{
+    //Together they revisit some ground and break new
+    const char * names[] = {"panEast", "panEast2", "panSouth", "panWest", "zoomIn", "zoomIn2", "panNorth",
+                            "zoomOut", "zoomOut2", "zoomOut3", "jumpEast"};
+    const qreal pans[][2] = {{0.5, 0.0}, {0.5, 0.0}, {0.0, 0.5}, {-1.0, 0.0}, {0.0, 0.0}, {0.0, 0.0},
+                             {0.0, -0.5}, {0.0, 0.0}, {0.0, 0.0}, {0.0, 0.0}, {3.0, 0.0}};
+    const int zooms[] = {0, 0, 0, 0, 1, 1, 0, -1, -1, -1, 0};
+
+    QList<Step> toRet;
+    for (int i = 0; i < (int) (sizeof(zooms) / sizeof(zooms[0])); i++)
+    {
+        Step step;
+        step.name = names[i];
+        step.panX = pans[i][0];
+        step.panY = pans[i][1];
+        step.zoomChange = zooms[i];
+        toRet.append(step);
+    }
+    return toRet;
+}
+
+//static
+QString TileBenchmark::layoutName(TileBenchmark::SourceLayout layout)
+{
+    if (layout == CompositeSource)
+        return "composite";
+    return "osm";
+}
+
+//private
+QSharedPointer<MapTileSource> TileBenchmark::createSource(TileBenchmark::SourceLayout layout) const
+{
+    QSharedPointer<MapTileSource> base(new BenchmarkTileSource("TileBenchmarks Base", _server->url()));
+    if (layout == SingleSource)
+        return base;
+
+    //Like the application's map: a network layer with another layer blended over it
+    QSharedPointer<CompositeTileSource> composite(new CompositeTileSource());
+    composite->addSourceBottom(base);
+    composite->addSourceTop(QSharedPointer<MapTileSource>(new BenchmarkTileSource("TileBenchmarks Overlay",
+                                                                                  _server->url())),
+                            OVERLAY_OPACITY);
+    return composite;
+}
+
+//private
+void TileBenchmark::runPass(const QSharedPointer<MapTileSource> &source, const QString &group)
+{
+    source->resetCacheStatistics();
+    _server->resetStatistics();
+
+    MapGraphicsScene scene;
+    MapGraphicsView view(&scene);
+    view.resize(_viewportSize);
+    if (_prefetchRingSize >= 0)
+        view.setPrefetchRingSize(_prefetchRingSize);
+    view.show();
+    _view = &view;
+    connect(&view,
+            SIGNAL(tileDisplayed(quint32,quint32,quint8,bool)),
+            this,
+            SLOT(handleTileDisplayed(quint32,quint32,quint8,bool)));
+    connect(&view,
+            SIGNAL(visibleTilesLoaded()),
+            this,
+            SLOT(handleVisibleTilesLoaded()));
+
+    QTimer timeout;
+    timeout.setSingleShot(true);
+    connect(&timeout,
+            SIGNAL(timeout()),
+            &_loop,
+            SLOT(quit()));
+
+    QList<Step> steps;
+    Step home;
+    home.name = "open";
+    home.panX = home.panY = 0.0;
+    home.zoomChange = 0;
+    steps << home << TileBenchmark::script();
+    home.name = "jumpHome";
+    steps << home;
+
+    int timeouts = 0;
+    qint64 totalNsecs = 0;
+    for (int i = 0; i < steps.size(); i++)
+    {
+        const Step& step = steps.at(i);
+
+        _firstTileNsecs = -1;
+        _fullViewportNsecs = -1;
+        _stepClock.start();
+
+        if (i == 0)
+        {
+            view.setTileSource(source);
+            view.setZoomLevel(HOME_ZOOM_LEVEL);
+            view.centerOn(HOME_LONGITUDE, HOME_LATITUDE);
+        }
+        else if (i == steps.size() - 1)
+        {
+            view.setZoomLevel(HOME_ZOOM_LEVEL);
+            view.centerOn(HOME_LONGITUDE, HOME_LATITUDE);
+        }
+        else
+        {
+            if (step.zoomChange > 0)
+                view.zoomIn();
+            else if (step.zoomChange < 0)
+                view.zoomOut();
+
+            if (step.panX != 0.0 || step.panY != 0.0)
+            {
+                const QPointF centerQGS = source->ll2qgs(view.center(), view.zoomLevel());
+                const QPointF panQGS(step.panX * view.width(), step.panY * view.height());
+                view.centerOn(source->qgs2ll(centerQGS + panQGS, view.zoomLevel()));
+            }
+        }
+
+        timeout.start(_stepTimeout);
+        _loop.exec();
+        timeout.stop();
+
+        if (_fullViewportNsecs < 0)
+        {
+            timeouts++;
+            _fullViewportNsecs = _stepClock.nsecsElapsed();
+        }
+
+        //Nothing new to draw means the viewport was complete as soon as it was laid out
+        if (_firstTileNsecs < 0)
+            _firstTileNsecs = _fullViewportNsecs;
+
+        _results->addSample(group, step.name + "/firstTile", _firstTileNsecs);
+        _results->addSample(group, step.name + "/fullViewport", _fullViewportNsecs);
+        totalNsecs += _fullViewportNsecs;
+    }
+    _results->addSample(group, "script/fullViewport", totalNsecs);
+    _view = 0;
+
+    const MapTileSource::CacheStatistics cache = source->cacheStatistics();
+    const SyntheticTileServer::Statistics served = _server->statistics();
+    _results->addValue(group, "cacheHitRate", cache.hitRate(), "fraction");
+    _results->addValue(group, "memoryHits", cache.memoryHits, "tiles");
+    _results->addValue(group, "diskHits", cache.diskHits, "tiles");
+    _results->addValue(group, "misses", cache.misses, "tiles");
+    _results->addValue(group, "staleHits", cache.staleHits, "tiles");
+    _results->addValue(group, "requests", served.requests, "requests");
+    _results->addValue(group, "notModified", served.notModified, "requests");
+    _results->addValue(group, "bytesTransferred", served.bytesSent, "bytes");
+    _results->addValue(group, "timeouts", timeouts, "steps");
+}
+
+//private
+void TileBenchmark::deleteDiskCaches() const
+{
+    //The composite's layers are the only sources that cache on disk
+    QSharedPointer<MapTileSource> source = this->createSource(CompositeSource);
+    QStringList paths;
+    CompositeTileSource * composite = qobject_cast<CompositeTileSource *>(source.data());
+    for (int i = 0; composite != 0 && i < composite->numSources(); i++)
+        paths << composite->getSource(i)->diskCachePath();
+
+    //Sources save their cache bookkeeping as they're destroyed, so only delete once they're gone
+    source.clear();
+    foreach(const QString& path, paths)
+        QDir(path).removeRecursively();
+}
@@ -0,0 +1,106 @@
+#ifndef TILEBENCHMARK_H
+#define TILEBENCHMARK_H
+
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QList>
+#include <QObject>
+#include <QSharedPointer>
+#include <QSize>
+#include <QString>
+
+#include "BenchmarkResults.h"
+
+class MapGraphicsView;
+class MapTileSource;
+class SyntheticTileServer;
+
+/**
+ * @brief The TileBenchmark class times the tile pipeline end to end: a MapGraphicsView showing OSMTileSource
+ * tiles, alone or in a CompositeTileSource, fetched from a SyntheticTileServer. It runs a fixed script of pans
+ * and zooms and times every step from the move until:
+ *  - firstTile: the first tile on screen is drawn (partial composites count)
+ *  - fullViewport: every tile on screen has its finished tile
+ *
+ * The script is run three times per repetition: "cold" with empty caches, "memory" again on the same sources,
+ * and "disk" on new sources sharing the disk cache of the first ones. After each pass the tile sources' cache
+ * hit rate and counters and what the server sent are recorded as values. Results go to a BenchmarkResults
+ * under the group "tiles/<layout>/<pass>".
+ *
+ * The sources use disk caches of their own, which are deleted before and after each repetition, so the
+ * application's real tile cache is never touched.
+ */
+class TileBenchmark : public QObject
+{
+    Q_OBJECT
+public:
+    enum SourceLayout
+    {
+        SingleSource,
+        CompositeSource
+    };
+
+    TileBenchmark(BenchmarkResults * results, SyntheticTileServer * server, int repetitions = 3);
+
+    /**
+     * @brief viewportSize is the size of the view the tiles are drawn in
+     */
+    QSize viewportSize() const;
+    void setViewportSize(const QSize& size);
+
+    /**
+     * @brief stepTimeout is how long a step may wait for its viewport, in milliseconds. Steps that time out
+     * are counted under "timeouts" and recorded as taking the whole timeout.
+     */
+    int stepTimeout() const;
+    void setStepTimeout(int msecs);
+
+    /**
+     * @brief prefetchRingSize is passed to the views, see MapGraphicsView::setPrefetchRingSize(). -1 (the
+     * default) leaves the view's own default.
+     */
+    int prefetchRingSize() const;
+    void setPrefetchRingSize(int ringSize);
+
+    void run(SourceLayout layout);
+
+private slots:
+    void handleTileDisplayed(quint32 x, quint32 y, quint8 z, bool finished);
+    void handleVisibleTilesLoaded();
+
+private:
+    struct Step
+    {
+        QString name;
+
+        //How far to pan east and south, in viewports
+        qreal panX;
+        qreal panY;
+
+        //Zoom levels in (positive) or out (negative)
+        int zoomChange;
+    };
+
+    static QList<Step> script();
+    static QString layoutName(SourceLayout layout);
+
+    QSharedPointer<MapTileSource> createSource(SourceLayout layout) const;
+    void runPass(const QSharedPointer<MapTileSource>& source, const QString& group);
+    void deleteDiskCaches() const;
+
+    BenchmarkResults * _results;
+    SyntheticTileServer * _server;
+    int _repetitions;
+    QSize _viewportSize;
+    int _stepTimeout;
+    int _prefetchRingSize;
+
+    //State of the step under way
+    MapGraphicsView * _view;
+    QEventLoop _loop;
+    QElapsedTimer _stepClock;
+    qint64 _firstTileNsecs;
+    qint64 _fullViewportNsecs;
+};
+
+#endif // TILEBENCHMARK_H
@@ -0,0 +1,32 @@
+#-------------------------------------------------
+#
+# Tile pipeline latency benchmarks against a local synthetic tile server
+#
+#-------------------------------------------------
+
+QT       += core gui network
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+TARGET = TileBenchmarks
+TEMPLATE = app
+CONFIG   -= app_bundle
+
+SOURCES += main.cpp \
+    SyntheticTileServer.cpp \
+    TileBenchmark.cpp \
+    ../Benchmarks/BenchmarkResults.cpp
+
+HEADERS += \
+    SyntheticTileServer.h \
+    TileBenchmark.h \
+    ../Benchmarks/BenchmarkResults.h
+
+INCLUDEPATH += $$PWD/../Benchmarks
+
+#Linkage for MapGraphics library.
+win32:CONFIG(release, debug|release): LIBS += -L$$OUT_PWD/../MapGraphics/release/ -lMapGraphics
+else:win32:CONFIG(debug, debug|release): LIBS += -L$$OUT_PWD/../MapGraphics/debug/ -lMapGraphics
+else:unix: LIBS += -L$$OUT_PWD/../MapGraphics/ -lMapGraphics
+
+INCLUDEPATH += $$PWD/../MapGraphics
+DEPENDPATH += $$PWD/../MapGraphics
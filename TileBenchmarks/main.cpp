@@ -0,0 +1,144 @@
+#include <QApplication>
+#include <QFile>
+#include <QStringList>
+#include <QTextStream>
+
+#include "BenchmarkResults.h"
+#include "SyntheticTileServer.h"
+#include "TileBenchmark.h"
+
+const char * USAGE =
+        "Usage: TileBenchmarks [options]\n"
+        "\n"
+        "Times how long the map takes to fill in while it's panned and zoomed, with tiles fetched from a local\n"
+        "synthetic tile server, and writes the results as JSON. Needs a display, or -platform offscreen.\n"
+        "\n"
+        "Options:\n"
+        "  --layout <osm|composite|all>  Which tile sources to time (default all)\n"
+        "  --repetitions <n>       Run every benchmark n times (default 3)\n"
+        "  --latency <ms>          Time before each tile's response starts (default 50)\n"
+        "  --bandwidth <bytes/s>   Bandwidth all responses share, 0 for unlimited (default 0)\n"
+        "  --viewport <w>x<h>      Size of the map view (default 1024x768)\n"
+        "  --prefetch-ring <n>     Rings of tiles to prefetch around the view (default: the view's)\n"
+        "  --timeout <ms>          Longest a step may wait for its tiles (default 30000)\n"
+        "  --output <file>         Write the JSON there instead of to standard output\n"
+        "  --help                  Show this message\n";
+
+int main(int argc, char *argv[])
+{
+    QApplication a(argc, argv);
+    QTextStream err(stderr);
+
+    int repetitions = 3;
+    QString layout = "all";
+    int latency = 50;
+    qint64 bandwidth = 0;
+    QSize viewportSize(1024, 768);
+    int prefetchRing = -1;
+    int timeout = 30000;
+    QString outputPath;
+
+    const QStringList args = a.arguments();
+    for (int i = 1; i < args.size(); i++)
+    {
+        const QString& arg = args.at(i);
+        const bool hasValue = i + 1 < args.size();
+        bool ok = true;
+        if (arg == "--help" || arg == "-h")
+        {
+            QTextStream(stdout) << USAGE;
+            return 0;
+        }
+        else if (arg == "--layout" && hasValue)
+        {
+            layout = args.at(++i).toLower();
+            ok = layout == "osm" || layout == "composite" || layout == "all";
+        }
+        else if (arg == "--repetitions" && hasValue)
+        {
+            repetitions = args.at(++i).toInt(&ok);
+            ok = ok && repetitions >= 1;
+        }
+        else if (arg == "--latency" && hasValue)
+        {
+            latency = args.at(++i).toInt(&ok);
+            ok = ok && latency >= 0;
+        }
+        else if (arg == "--bandwidth" && hasValue)
+        {
+            bandwidth = args.at(++i).toLongLong(&ok);
+            ok = ok && bandwidth >= 0;
+        }
+        else if (arg == "--viewport" && hasValue)
+        {
+            const QStringList size = args.at(++i).toLower().split('x');
+            bool heightOk = false;
+            viewportSize = QSize(size.value(0).toInt(&ok), size.value(1).toInt(&heightOk));
+            ok = ok && heightOk && size.size() == 2 && !viewportSize.isEmpty();
+        }
+        else if (arg == "--prefetch-ring" && hasValue)
+        {
+            prefetchRing = args.at(++i).toInt(&ok);
+            ok = ok && prefetchRing >= 0;
+        }
+        else if (arg == "--timeout" && hasValue)
+        {
+            timeout = args.at(++i).toInt(&ok);
+            ok = ok && timeout >= 1;
+        }
+        else if (arg == "--output" && hasValue)
+            outputPath = args.at(++i);
+        else
+        {
+            err << "Unexpected argument " << arg << "\n\n" << USAGE;
+            return 2;
+        }
+
+        if (!ok)
+        {
+            err << "Invalid value " << args.at(i) << " for " << arg << "\n";
+            return 2;
+        }
+    }
+
+    SyntheticTileServer server;
+    server.setLatency(latency);
+    server.setBandwidth(bandwidth);
+    QString errorString;
+    if (!server.start(&errorString))
+    {
+        err << errorString << "\n";
+        return 1;
+    }
+
+    BenchmarkResults results;
+    TileBenchmark benchmark(&results, &server, repetitions);
+    benchmark.setViewportSize(viewportSize);
+    benchmark.setPrefetchRingSize(prefetchRing);
+    benchmark.setStepTimeout(timeout);
+    if (layout != "composite")
+        benchmark.run(TileBenchmark::SingleSource);
+    if (layout != "osm")
+        benchmark.run(TileBenchmark::CompositeSource);
+    server.stop();
+
+    QFile output;
+    if (outputPath.isEmpty())
+        output.open(stdout, QFile::WriteOnly);
+    else
+    {
+        output.setFileName(outputPath);
+        if (!output.open(QFile::WriteOnly))
+        {
+            err << "Failed to open " << outputPath << " for writing: " << output.errorString() << "\n";
+            return 1;
+        }
+    }
+
+    if (!results.writeJSON(&output, repetitions, &errorString))
+    {
+        err << errorString << "\n";
+        return 1;
+    }
+    return 0;
+}